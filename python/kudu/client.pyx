@@ -22,6 +22,7 @@ from libcpp.string cimport string
 from libcpp cimport bool as c_bool
 
 cimport cpython
+from cpython.buffer cimport PyBUF_WRITABLE, PyBUF_FORMAT, PyBUF_ND, PyBUF_STRIDES
 from cython.operator cimport dereference as deref
 
 from libkudu_client cimport *
@@ -1021,6 +1022,86 @@ cdef class Row:
         return self.row.IsNull(i)
 
 
+cdef char kEmptyBuffer = 0
+
+
+cdef class ColumnBuffer:
+    """
+    Read-only view of the data of a column of a RowBatch, which it keeps
+    alive. It supports the buffer protocol, so that memoryview,
+    numpy.asarray or pyarrow.py_buffer can wrap it without copying.
+    """
+
+    cdef:
+        RowBatch parent
+        const uint8_t* data
+        bytes format
+        Py_ssize_t itemsize
+        Py_ssize_t shape[1]
+        Py_ssize_t strides[1]
+
+    def __len__(self):
+        return self.shape[0]
+
+    def __getbuffer__(self, Py_buffer* buffer, int flags):
+        if flags & PyBUF_WRITABLE:
+            raise BufferError('ColumnBuffer is read-only')
+        buffer.buf = <void*> self.data
+        if buffer.buf == NULL:
+            buffer.buf = &kEmptyBuffer
+        buffer.obj = self
+        buffer.len = self.shape[0] * self.itemsize
+        buffer.readonly = 1
+        buffer.itemsize = self.itemsize
+        buffer.format = NULL
+        if flags & PyBUF_FORMAT:
+            buffer.format = self.format
+        buffer.ndim = 1
+        buffer.shape = NULL
+        if flags & PyBUF_ND:
+            buffer.shape = self.shape
+        buffer.strides = NULL
+        if flags & PyBUF_STRIDES:
+            buffer.strides = self.strides
+        buffer.suboffsets = NULL
+        buffer.internal = NULL
+
+    def __releasebuffer__(self, Py_buffer* buffer):
+        pass
+
+
+cdef ColumnBuffer _column_buffer(RowBatch parent, Slice data,
+                                 bytes format, Py_ssize_t itemsize):
+    cdef ColumnBuffer buf = ColumnBuffer()
+    buf.parent = parent
+    buf.data = data.data()
+    buf.format = format
+    buf.itemsize = itemsize
+    buf.shape[0] = data.size() // itemsize
+    buf.strides[0] = itemsize
+    return buf
+
+
+# The buffer protocol format and size of the cells of fixed-width types
+_fixed_width_formats = {
+    KUDU_BOOL: (b'?', 1),
+    KUDU_INT8: (b'b', 1),
+    KUDU_INT16: (b'h', 2),
+    KUDU_INT32: (b'i', 4),
+    KUDU_INT64: (b'q', 8),
+    KUDU_UNIXTIME_MICROS: (b'q', 8),
+    KUDU_FLOAT: (b'f', 4),
+    KUDU_DOUBLE: (b'd', 8),
+}
+
+
+def _null_mask(bitmap, int nrows):
+    import numpy as np
+    bits = np.frombuffer(bitmap, dtype=np.uint8)
+    idx = np.arange(nrows)
+    return ((bits[idx >> 3] >> (idx & 7)) & 1) == 0
+
+
 cdef class RowBatch:
     """
     Class holding a batch of rows from a Scanner
@@ -1051,6 +1132,154 @@ cdef class RowBatch:
             tuples.append(self.get_row(i).as_tuple())
         return tuples
 
+    def column(self, int i):
+        """
+        Return the data of a column of a batch scanned in the columnar layout
+        (see Scanner.set_columnar_layout), without copying it.
+
+        Parameters
+        ----------
+        i : index of the column in the projection
+
+        Returns
+        -------
+        data : ColumnBuffer, with one cell per row for fixed-width columns;
+          the contents of NULL cells are undefined. For string and binary
+          columns, a tuple (offsets, data) of ColumnBuffers, in which the
+          value of row j is data[offsets[j]:offsets[j + 1]].
+        """
+        cdef:
+            Slice data, offsets
+            DataType t = self.batch.projection_schema().Column(i).type()
+
+        if t == KUDU_STRING or t == KUDU_BINARY:
+            check_status(self.batch.GetVariableLengthColumn(i, &offsets,
+                                                            &data))
+            return (_column_buffer(self, offsets, b'I', 4),
+                    _column_buffer(self, data, b'B', 1))
+
+        if t not in _fixed_width_formats:
+            raise TypeError(t)
+        fmt, itemsize = _fixed_width_formats[t]
+        check_status(self.batch.GetFixedLengthColumn(i, &data))
+        return _column_buffer(self, data, fmt, itemsize)
+
+    def non_null_bitmap(self, int i):
+        """
+        Return the non-NULL bitmap of a column of a batch scanned in the
+        columnar layout, without copying it. Bit j, starting with the least
+        significant bit of the first byte, is set if the cell of row j is not
+        NULL.
+
+        Returns
+        -------
+        bitmap : ColumnBuffer, or None if the column is not nullable
+        """
+        cdef Slice data
+        check_status(self.batch.GetNonNullBitmapForColumn(i, &data))
+        if not self.batch.projection_schema().Column(i).is_nullable():
+            return None
+        return _column_buffer(self, data, b'B', 1)
+
+    def to_numpy(self):
+        """
+        Return the columns of a batch scanned in the columnar layout as NumPy
+        arrays. Fixed-width columns are not copied: their arrays are
+        read-only views of the batch. String and binary columns are copied
+        into arrays of objects.
+
+        Returns
+        -------
+        columns : dict of column name to numpy.ndarray, or to
+          numpy.ma.MaskedArray masking the NULL cells of nullable columns
+        """
+        import numpy as np
+
+        cdef:
+            int i, j
+            int nrows = self.batch.NumRows()
+            const KuduSchema* schema = self.batch.projection_schema()
+            DataType t
+
+        result = {}
+        for i in range(schema.num_columns()):
+            t = schema.Column(i).type()
+            if t == KUDU_STRING or t == KUDU_BINARY:
+                offsets, data = self.column(i)
+                offsets = np.asarray(offsets)
+                data = bytes(memoryview(data))
+                values = np.empty(nrows, dtype=object)
+                for j in range(nrows):
+                    values[j] = data[offsets[j]:offsets[j + 1]]
+                    if t == KUDU_STRING:
+                        values[j] = frombytes(values[j])
+            else:
+                values = np.asarray(self.column(i))
+                if t == KUDU_UNIXTIME_MICROS:
+                    values = values.view('datetime64[us]')
+
+            bitmap = self.non_null_bitmap(i)
+            if bitmap is not None:
+                values = np.ma.masked_array(values,
+                                            mask=_null_mask(bitmap, nrows))
+            result[frombytes(schema.Column(i).name())] = values
+        return result
+
+    def to_arrow(self):
+        """
+        Return a batch scanned in the columnar layout as an Arrow record
+        batch. The Kudu and Arrow columnar layouts match, so that all columns
+        but BOOL ones are not copied.
+
+        Returns
+        -------
+        batch : pyarrow.RecordBatch
+        """
+        import numpy as np
+        import pyarrow as pa
+
+        arrow_types = {
+            KUDU_INT8: pa.int8(),
+            KUDU_INT16: pa.int16(),
+            KUDU_INT32: pa.int32(),
+            KUDU_INT64: pa.int64(),
+            KUDU_UNIXTIME_MICROS: pa.timestamp('us'),
+            KUDU_FLOAT: pa.float32(),
+            KUDU_DOUBLE: pa.float64(),
+            KUDU_STRING: pa.string(),
+            KUDU_BINARY: pa.binary(),
+        }
+
+        cdef:
+            int i
+            int nrows = self.batch.NumRows()
+            const KuduSchema* schema = self.batch.projection_schema()
+            DataType t
+
+        arrays = []
+        names = []
+        for i in range(schema.num_columns()):
+            t = schema.Column(i).type()
+            bitmap = self.non_null_bitmap(i)
+            validity = None if bitmap is None else pa.py_buffer(bitmap)
+            if t == KUDU_BOOL:
+                # Arrow packs booleans into bits, while Kudu uses a byte for
+                # each.
+                mask = None if bitmap is None else _null_mask(bitmap, nrows)
+                array = pa.array(np.asarray(self.column(i)), mask=mask)
+            elif t == KUDU_STRING or t == KUDU_BINARY:
+                offsets, data = self.column(i)
+                array = pa.Array.from_buffers(
+                    arrow_types[t], nrows,
+                    [validity, pa.py_buffer(offsets), pa.py_buffer(data)])
+            else:
+                array = pa.Array.from_buffers(
+                    arrow_types[t], nrows,
+                    [validity, pa.py_buffer(self.column(i))])
+            arrays.append(array)
+            names.append(frombytes(schema.Column(i).name()))
+        return pa.RecordBatch.from_arrays(arrays, names)
+
     cdef Row get_row(self, i):
         # TODO: boundscheck
 
@@ -1173,6 +1402,22 @@ cdef class Scanner:
         check_status(self.scanner.SetFaultTolerant())
         return self
 
+    def set_columnar_layout(self):
+        """
+        Makes the tablet servers return the rows of each batch column by
+        column. The columns of such batches may then be exported without
+        copying them with RowBatch.column, RowBatch.to_numpy and
+        RowBatch.to_arrow, but their rows may not be read as tuples.
+        Returns a reference to itself to facilitate chaining.
+
+        Returns
+        -------
+        self : Scanner
+        """
+        check_status(self.scanner.SetRowFormatFlags(
+            KuduScanner_COLUMNAR_LAYOUT))
+        return self
+
     def new_bound(self):
         """
         Returns a new instance of a ScanBound (subclass of PartialRow) to be
@@ -1232,8 +1477,11 @@ cdef class Scanner:
         -------
         self : Scanner
         """
+        cdef Status s
         if not self.is_open:
-            check_status(self.scanner.Open())
+            with nogil:
+                s = self.scanner.Open()
+            check_status(s)
             self.is_open = 1
         return self
 
@@ -1274,8 +1522,15 @@ cdef class Scanner:
         if not self.has_more_rows():
             raise StopIteration
 
-        cdef RowBatch batch = RowBatch()
-        check_status(self.scanner.NextBatch(&batch.batch))
+        cdef:
+            RowBatch batch = RowBatch()
+            Status s
+
+        # Release the GIL while waiting for the tablet server, so that other
+        # threads may process the previous batches meanwhile.
+        with nogil:
+            s = self.scanner.NextBatch(&batch.batch)
+        check_status(s)
         return batch
 
 
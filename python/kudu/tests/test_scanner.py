@@ -161,3 +161,46 @@ class TestScanner(KuduTestBase, unittest.TestCase):
             tuples.extend(batch.as_tuples())
 
         self.assertEqual(sorted(tuples), self.tuples[10:90])
+
+    def test_scan_columnar(self):
+        scanner = self.table.scanner()
+        scanner.set_fault_tolerant().set_columnar_layout().open()
+
+        keys = []
+        strings = []
+        while scanner.has_more_rows():
+            batch = scanner.next_batch()
+            self.assertIsNone(batch.non_null_bitmap(0))
+            bitmap = bytearray(memoryview(batch.non_null_bitmap(2)))
+            offsets, data = batch.column(2)
+            offsets = memoryview(offsets).tolist()
+            data = memoryview(data).tobytes()
+            for i, key in enumerate(memoryview(batch.column(0)).tolist()):
+                keys.append(key)
+                if bitmap[i >> 3] & (1 << (i & 7)):
+                    strings.append(data[offsets[i]:offsets[i + 1]].decode())
+                else:
+                    strings.append(None)
+
+        self.assertEqual(sorted(zip(keys, strings)),
+                         [(t[0], t[2]) for t in self.tuples])
+
+    def test_scan_to_numpy(self):
+        try:
+            import numpy as np
+        except ImportError:
+            raise unittest.SkipTest('numpy is not installed')
+
+        scanner = self.table.scanner()
+        scanner.set_fault_tolerant().set_columnar_layout().open()
+
+        tuples = []
+        while scanner.has_more_rows():
+            columns = scanner.next_batch().to_numpy()
+            self.assertFalse(isinstance(columns['key'], np.ma.MaskedArray))
+            for key, int_val, string_val in zip(
+                    columns['key'], columns['int_val'].tolist(),
+                    columns['string_val'].tolist()):
+                tuples.append((int(key), int_val, string_val))
+
+        self.assertEqual(sorted(tuples), self.tuples)
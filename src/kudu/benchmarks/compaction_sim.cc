@@ -0,0 +1,165 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Replays a recorded or synthetic trace of flushes through a compaction
+// policy, and prints how the rowsets of the simulated tablet evolve. No I/O
+// is done, so months of ingest can be simulated in seconds to compare
+// compaction settings.
+//
+// Usage:
+//   compaction_sim -random_fraction=0.1 -tablet_compaction_budget_mb=256
+//   compaction_sim -trace_file=flushes.tsv -policy=time_windowed -window_width=3600000000
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/common/common.pb.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/tablet/compaction_policy.h"
+#include "kudu/tablet/compaction_simulator.h"
+#include "kudu/util/env.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/flags.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/random.h"
+
+DEFINE_string(trace_file, "",
+              "File of the flushes to replay, one per line of the form "
+              "'<size in MB>\\t<min key>\\t<max key>'. If empty, a synthetic trace "
+              "is generated.");
+DEFINE_int32(num_flushes, 1000, "Number of flushes of the synthetic trace.");
+DEFINE_int32(flush_size_mb, 64, "Size of each flush of the synthetic trace.");
+DEFINE_int64(keys_per_flush, 1000000, "Number of keys inserted between flushes.");
+DEFINE_double(random_fraction, 0,
+              "Fraction of the flushes of the synthetic trace whose keys are spread "
+              "over all the keys inserted so far rather than follow the previous "
+              "flush's.");
+DEFINE_string(policy, "budgeted", "Compaction policy: 'budgeted' or 'time_windowed'.");
+DEFINE_int64(window_width, 0, "Window width of the 'time_windowed' policy, in keys.");
+DEFINE_int64(frozen_window_age, 0,
+             "Age past which windows of the 'time_windowed' policy are frozen, in keys. "
+             "0 means windows are never frozen.");
+DEFINE_int32(max_compactions_per_flush, 1,
+             "Maximum number of compactions run after each flush.");
+DEFINE_int32(sample_interval, 100, "Number of flushes between printed samples.");
+
+DECLARE_int32(tablet_compaction_budget_mb);
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace tablet {
+namespace {
+
+Status LoadFlushes(vector<SimulatedFlush>* flushes) {
+  if (FLAGS_trace_file.empty()) {
+    SyntheticTraceOptions opts;
+    opts.num_flushes = FLAGS_num_flushes;
+    opts.flush_size_bytes = FLAGS_flush_size_mb * 1024LL * 1024;
+    opts.keys_per_flush = FLAGS_keys_per_flush;
+    opts.random_fraction = FLAGS_random_fraction;
+    Random rng(1);
+    GenerateCompactionTrace(opts, &rng, flushes);
+    return Status::OK();
+  }
+  faststring data;
+  RETURN_NOT_OK(ReadFileToString(Env::Default(), FLAGS_trace_file, &data));
+  return ParseCompactionTrace(data.ToString(), flushes);
+}
+
+Status CreatePolicy(unique_ptr<CompactionPolicy>* policy) {
+  if (FLAGS_policy == "budgeted") {
+    policy->reset(new BudgetedCompactionPolicy(FLAGS_tablet_compaction_budget_mb));
+    return Status::OK();
+  }
+  if (FLAGS_policy == "time_windowed") {
+    Schema schema({ ColumnSchema("key", INT64) }, 1);
+    CompactionPolicyPB config;
+    config.set_type(CompactionPolicyPB::TIME_WINDOWED);
+    config.set_window_width(FLAGS_window_width);
+    if (FLAGS_frozen_window_age > 0) {
+      config.set_frozen_window_age(FLAGS_frozen_window_age);
+    }
+    RETURN_NOT_OK(TimeWindowedCompactionPolicy::ValidateConfig(schema, config));
+    policy->reset(new TimeWindowedCompactionPolicy(schema, config,
+                                                   FLAGS_tablet_compaction_budget_mb));
+    return Status::OK();
+  }
+  return Status::InvalidArgument("unknown compaction policy", FLAGS_policy);
+}
+
+void PrintSample(const CompactionSimulatorSample& s) {
+  cout << s.num_flushes << "\t" << s.num_compactions << "\t" << s.num_rowsets << "\t"
+       << s.average_height << "\t" << s.max_height << "\t"
+       << s.bytes_compacted / (1024 * 1024) << "\t" << s.write_amplification() << endl;
+}
+
+Status Run() {
+  vector<SimulatedFlush> flushes;
+  RETURN_NOT_OK(LoadFlushes(&flushes));
+  unique_ptr<CompactionPolicy> policy;
+  RETURN_NOT_OK(CreatePolicy(&policy));
+  CompactionSimulator::Options opts;
+  opts.max_compactions_per_flush = FLAGS_max_compactions_per_flush;
+  CompactionSimulator sim(policy.get(), opts);
+
+  vector<CompactionSimulatorSample> samples;
+  RETURN_NOT_OK(sim.Replay(flushes, &samples));
+
+  cout << "flushes\tcompactions\trowsets\tavg_height\tmax_height\tmb_compacted\twrite_amp"
+       << endl;
+  double height_sum = 0;
+  for (int i = 0; i < samples.size(); i++) {
+    height_sum += samples[i].average_height;
+    if ((i + 1) % FLAGS_sample_interval == 0 || i + 1 == samples.size()) {
+      PrintSample(samples[i]);
+    }
+  }
+  if (!samples.empty()) {
+    // The average height over time is the expected number of bloom filter
+    // probes per insert over the whole trace.
+    cout << Substitute("Mean bloom probes per insert: $0",
+                       height_sum / samples.size()) << endl;
+  }
+  return Status::OK();
+}
+
+} // anonymous namespace
+} // namespace tablet
+} // namespace kudu
+
+int main(int argc, char** argv) {
+  kudu::ParseCommandLineFlags(&argc, &argv, true);
+  kudu::InitGoogleLoggingSafe(argv[0]);
+  kudu::Status s = kudu::tablet::Run();
+  if (!s.ok()) {
+    LOG(ERROR) << s.ToString();
+    return 1;
+  }
+  return 0;
+}
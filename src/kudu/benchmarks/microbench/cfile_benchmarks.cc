@@ -0,0 +1,185 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Benchmarks of encoding and decoding CFile blocks with each encoding.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "kudu/benchmarks/microbench/microbench.h"
+#include "kudu/cfile/block_encodings.h"
+#include "kudu/cfile/cfile_util.h"
+#include "kudu/cfile/type_encodings.h"
+#include "kudu/common/columnblock.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/random.h"
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace cfile {
+namespace {
+
+// The number of values encoded per block, which fit in a block of every
+// encoding.
+const int kNumValues = 16 * 1024;
+
+// Values with the repetition and small deltas of typical keys and
+// timestamps, which the RLE and bitshuffle encodings are suited to.
+template<DataType Type>
+vector<typename TypeTraits<Type>::cpp_type> MakeValues() {
+  vector<typename TypeTraits<Type>::cpp_type> values;
+  for (int i = 0; i < kNumValues; i++) {
+    values.push_back(1000000 + i / 4);
+  }
+  return values;
+}
+
+template<>
+vector<Slice> MakeValues<STRING>() {
+  // The strings point into a buffer which is never freed.
+  static auto* strs = new vector<string>();
+  if (strs->empty()) {
+    Random rng(1);
+    for (int i = 0; i < kNumValues; i++) {
+      strs->push_back(StringPrintf("user%012d-%04d", i, rng.Uniform(10000)));
+    }
+  }
+  vector<Slice> values;
+  for (const string& s : *strs) {
+    values.emplace_back(s);
+  }
+  return values;
+}
+
+unique_ptr<WriterOptions> MakeWriterOptions() {
+  unique_ptr<WriterOptions> opts(new WriterOptions());
+  opts->storage_attributes.cfile_block_size = 256 * 1024;
+  return opts;
+}
+
+// Encodes 'values' into a block with 'builder', returning the size of the
+// values added.
+template<class CppType>
+size_t EncodeBlock(BlockBuilder* builder, const vector<CppType>& values, Slice* block) {
+  builder->Reset();
+  size_t added = 0;
+  while (added < values.size()) {
+    added += builder->Add(reinterpret_cast<const uint8_t*>(&values[added]),
+                          values.size() - added);
+  }
+  *block = builder->Finish(0);
+  return added;
+}
+
+template<DataType Type>
+void EncodeBenchmark(EncodingType encoding, microbench::State* state) {
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+  const TypeEncodingInfo* info;
+  CHECK_OK(TypeEncodingInfo::Get(GetTypeInfo(Type), encoding, &info));
+  vector<CppType> values = MakeValues<Type>();
+  unique_ptr<WriterOptions> opts = MakeWriterOptions();
+  BlockBuilder* builder_ptr;
+  CHECK_OK(info->CreateBlockBuilder(&builder_ptr, opts.get()));
+  unique_ptr<BlockBuilder> builder(builder_ptr);
+
+  Slice block;
+  state->ResumeTiming();
+  for (int64_t i = 0; i < state->iterations(); i++) {
+    microbench::DoNotOptimize(EncodeBlock(builder.get(), values, &block));
+  }
+  state->PauseTiming();
+  state->SetItemsProcessed(state->iterations() * kNumValues);
+  state->SetBytesProcessed(state->iterations() * block.size());
+}
+
+template<DataType Type>
+void DecodeBenchmark(EncodingType encoding, microbench::State* state) {
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+  const TypeEncodingInfo* info;
+  CHECK_OK(TypeEncodingInfo::Get(GetTypeInfo(Type), encoding, &info));
+  vector<CppType> values = MakeValues<Type>();
+  unique_ptr<WriterOptions> opts = MakeWriterOptions();
+  BlockBuilder* builder_ptr;
+  CHECK_OK(info->CreateBlockBuilder(&builder_ptr, opts.get()));
+  unique_ptr<BlockBuilder> builder(builder_ptr);
+  Slice block_slice;
+  EncodeBlock(builder.get(), values, &block_slice);
+  const string block = block_slice.ToString();
+
+  vector<CppType> decoded(kNumValues);
+  Arena arena(1024, 4 * 1024 * 1024);
+  state->ResumeTiming();
+  for (int64_t i = 0; i < state->iterations(); i++) {
+    arena.Reset();
+    BlockDecoder* decoder_ptr;
+    CHECK_OK(info->CreateBlockDecoder(&decoder_ptr, block, nullptr));
+    unique_ptr<BlockDecoder> decoder(decoder_ptr);
+    CHECK_OK(decoder->ParseHeader());
+    ColumnBlock cb(GetTypeInfo(Type), nullptr, &decoded[0], kNumValues, &arena);
+    ColumnDataView view(&cb);
+    size_t n = kNumValues;
+    CHECK_OK(decoder->CopyNextValues(&n, &view));
+    CHECK_EQ(kNumValues, n);
+    microbench::DoNotOptimize(decoded[0]);
+  }
+  state->PauseTiming();
+  state->SetItemsProcessed(state->iterations() * kNumValues);
+  state->SetBytesProcessed(state->iterations() * block.size());
+}
+
+template<DataType Type>
+void RegisterEncodingBenchmarks(EncodingType encoding) {
+  string suffix = Substitute("$0/$1", GetTypeInfo(Type)->name(), EncodingType_Name(encoding));
+  microbench::RegisterBenchmark("BM_CFileEncode/" + suffix, [encoding](microbench::State* s) {
+      EncodeBenchmark<Type>(encoding, s);
+    });
+  microbench::RegisterBenchmark("BM_CFileDecode/" + suffix, [encoding](microbench::State* s) {
+      DecodeBenchmark<Type>(encoding, s);
+    });
+}
+
+// The dictionary encoding isn't covered since its blocks can only be
+// decoded along with the dictionary of their CFile.
+bool RegisterAll() {
+  for (EncodingType e : { PLAIN_ENCODING, RLE, BIT_SHUFFLE }) {
+    RegisterEncodingBenchmarks<INT32>(e);
+  }
+  for (EncodingType e : { PLAIN_ENCODING, BIT_SHUFFLE }) {
+    RegisterEncodingBenchmarks<INT64>(e);
+  }
+  for (EncodingType e : { PLAIN_ENCODING, PREFIX_ENCODING }) {
+    RegisterEncodingBenchmarks<STRING>(e);
+  }
+  return true;
+}
+
+const bool registered ATTRIBUTE_UNUSED = RegisterAll();
+
+} // anonymous namespace
+} // namespace cfile
+} // namespace kudu
@@ -0,0 +1,244 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Benchmarks of predicate evaluation, merging, key encoding and the
+// decoding of written rows.
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "kudu/benchmarks/microbench/microbench.h"
+#include "kudu/common/column_materialization_context.h"
+#include "kudu/common/column_predicate.h"
+#include "kudu/common/columnblock.h"
+#include "kudu/common/generic_iterators.h"
+#include "kudu/common/iterator.h"
+#include "kudu/common/key_encoder.h"
+#include "kudu/common/partial_row.h"
+#include "kudu/common/row_operations.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/scan_spec.h"
+#include "kudu/common/schema.h"
+#include "kudu/common/wire_protocol.pb.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/random.h"
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+namespace kudu {
+namespace {
+
+const Schema kIntSchema({ ColumnSchema("val", UINT32) }, 1);
+
+// Yields rows of UINT32s from a vector.
+class VectorIterator : public ColumnwiseIterator {
+ public:
+  explicit VectorIterator(const vector<uint32_t>* ints)
+      : ints_(ints),
+        cur_idx_(0),
+        prepared_(0) {
+  }
+
+  Status Init(ScanSpec* spec) OVERRIDE {
+    return Status::OK();
+  }
+
+  Status PrepareBatch(size_t* nrows) OVERRIDE {
+    prepared_ = std::min(ints_->size() - cur_idx_, *nrows);
+    *nrows = prepared_;
+    return Status::OK();
+  }
+
+  Status InitializeSelectionVector(SelectionVector* sel_vec) OVERRIDE {
+    sel_vec->SetAllTrue();
+    return Status::OK();
+  }
+
+  Status MaterializeColumn(ColumnMaterializationContext* ctx) OVERRIDE {
+    ctx->SetDecoderEvalNotSupported();
+    memcpy(ctx->block()->data(), &(*ints_)[cur_idx_], prepared_ * sizeof(uint32_t));
+    cur_idx_ += prepared_;
+    return Status::OK();
+  }
+
+  Status FinishBatch() OVERRIDE {
+    prepared_ = 0;
+    return Status::OK();
+  }
+
+  bool HasNext() const OVERRIDE {
+    return cur_idx_ < ints_->size();
+  }
+
+  string ToString() const OVERRIDE {
+    return "VectorIterator";
+  }
+
+  const Schema& schema() const OVERRIDE {
+    return kIntSchema;
+  }
+
+  void GetIteratorStats(vector<IteratorStats>* stats) const OVERRIDE {
+    stats->resize(schema().num_columns());
+  }
+
+ private:
+  const vector<uint32_t>* ints_;
+  size_t cur_idx_;
+  size_t prepared_;
+};
+
+const int kNumRows = 64 * 1024;
+
+KUDU_MICROBENCHMARK(BM_ColumnPredicateEvaluateRange) {
+  Random rng(1);
+  vector<uint32_t> values(kNumRows);
+  for (uint32_t& v : values) {
+    v = rng.Next();
+  }
+  // Selects about a quarter of the rows.
+  uint32_t lower = 1U << 30;
+  uint32_t upper = 1U << 31;
+  ColumnPredicate pred = ColumnPredicate::Range(kIntSchema.column(0), &lower, &upper);
+  ColumnBlock block(kIntSchema.column(0).type_info(), nullptr, &values[0], kNumRows, nullptr);
+  SelectionVector sel(kNumRows);
+
+  state->ResumeTiming();
+  for (int64_t i = 0; i < state->iterations(); i++) {
+    sel.SetAllTrue();
+    pred.Evaluate(block, &sel);
+    microbench::DoNotOptimize(sel.bitmap()[0]);
+  }
+  state->PauseTiming();
+  state->SetItemsProcessed(state->iterations() * kNumRows);
+}
+
+// Merges 'num_inputs' sorted, interleaved inputs.
+void Merge(int num_inputs, microbench::State* state) {
+  Random rng(1);
+  vector<vector<uint32_t>> inputs(num_inputs);
+  for (int i = 0; i < kNumRows; i++) {
+    inputs[rng.Uniform(num_inputs)].push_back(i);
+  }
+  RowBlock dst(kIntSchema, 1024, nullptr);
+
+  for (int64_t i = 0; i < state->iterations(); i++) {
+    vector<shared_ptr<RowwiseIterator>> to_merge;
+    for (const auto& input : inputs) {
+      to_merge.emplace_back(new MaterializingIterator(
+          shared_ptr<ColumnwiseIterator>(new VectorIterator(&input))));
+    }
+    state->ResumeTiming();
+    MergeIterator merger(kIntSchema, to_merge);
+    CHECK_OK(merger.Init(nullptr));
+    while (merger.HasNext()) {
+      CHECK_OK(merger.NextBlock(&dst));
+    }
+    state->PauseTiming();
+  }
+  state->SetItemsProcessed(state->iterations() * kNumRows);
+}
+
+KUDU_MICROBENCHMARK(BM_MergeIterator2) {
+  Merge(2, state);
+}
+
+KUDU_MICROBENCHMARK(BM_MergeIterator16) {
+  Merge(16, state);
+}
+
+KUDU_MICROBENCHMARK(BM_MergeIterator128) {
+  Merge(128, state);
+}
+
+KUDU_MICROBENCHMARK(BM_KeyEncoderInt64) {
+  const KeyEncoder<faststring>& encoder = GetKeyEncoder<faststring>(GetTypeInfo(INT64));
+  faststring buf;
+  state->ResumeTiming();
+  for (int64_t i = 0; i < state->iterations(); i++) {
+    encoder.ResetAndEncode(&i, &buf);
+    microbench::DoNotOptimize(buf.data());
+  }
+  state->PauseTiming();
+  state->SetItemsProcessed(state->iterations());
+}
+
+// Encodes the composite key (int64, string, int32).
+KUDU_MICROBENCHMARK(BM_KeyEncoderComposite) {
+  const KeyEncoder<faststring>& int64_encoder = GetKeyEncoder<faststring>(GetTypeInfo(INT64));
+  const KeyEncoder<faststring>& string_encoder = GetKeyEncoder<faststring>(GetTypeInfo(STRING));
+  const KeyEncoder<faststring>& int32_encoder = GetKeyEncoder<faststring>(GetTypeInfo(INT32));
+  Slice host("host-0123.example.com");
+  int32_t metric = 42;
+  faststring buf;
+  state->ResumeTiming();
+  for (int64_t i = 0; i < state->iterations(); i++) {
+    buf.clear();
+    int64_encoder.Encode(&i, false, &buf);
+    string_encoder.Encode(&host, false, &buf);
+    int32_encoder.Encode(&metric, true, &buf);
+    microbench::DoNotOptimize(buf.data());
+  }
+  state->PauseTiming();
+  state->SetItemsProcessed(state->iterations());
+}
+
+// Decodes a batch of inserts of (int64 key, int32, string) rows, as a tablet
+// server does for each write RPC.
+KUDU_MICROBENCHMARK(BM_RowOperationsPBDecodeInserts) {
+  const int kBatchSize = 1000;
+  SchemaBuilder builder;
+  CHECK_OK(builder.AddKeyColumn("key", INT64));
+  CHECK_OK(builder.AddColumn("int_val", INT32));
+  CHECK_OK(builder.AddNullableColumn("string_val", STRING));
+  Schema server_schema = builder.Build();
+  Schema client_schema = builder.BuildWithoutIds();
+
+  RowOperationsPB pb;
+  RowOperationsPBEncoder enc(&pb);
+  for (int i = 0; i < kBatchSize; i++) {
+    KuduPartialRow row(&client_schema);
+    CHECK_OK(row.SetInt64(0, i));
+    CHECK_OK(row.SetInt32(1, i * 2));
+    CHECK_OK(row.SetStringCopy(2, "a string of a typical length"));
+    enc.Add(RowOperationsPB::INSERT, row);
+  }
+
+  Arena arena(32 * 1024, 4 * 1024 * 1024);
+  vector<DecodedRowOperation> ops;
+  state->ResumeTiming();
+  for (int64_t i = 0; i < state->iterations(); i++) {
+    arena.Reset();
+    ops.clear();
+    RowOperationsPBDecoder dec(&pb, &client_schema, &server_schema, &arena);
+    CHECK_OK(dec.DecodeOperations(&ops));
+  }
+  state->PauseTiming();
+  state->SetItemsProcessed(state->iterations() * kBatchSize);
+  state->SetBytesProcessed(state->iterations() *
+                           (pb.rows().size() + pb.indirect_data().size()));
+}
+
+} // anonymous namespace
+} // namespace kudu
@@ -0,0 +1,259 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Runs the registered microbenchmarks and writes their results as JSON.
+//
+// Usage:
+//   microbench -microbench_filter='BM_CFile*' -microbench_out=results.json
+
+#include "kudu/benchmarks/microbench/microbench.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/util.h"
+#include "kudu/gutil/sysinfo.h"
+#include "kudu/gutil/walltime.h"
+#include "kudu/util/flags.h"
+#include "kudu/util/jsonwriter.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/version_info.h"
+#include "kudu/util/version_info.pb.h"
+
+DEFINE_string(microbench_filter, "*",
+              "Glob matching the names of the benchmarks to run. Several globs may be "
+              "given, separated by commas.");
+DEFINE_int32(microbench_min_time_ms, 200,
+             "Minimum duration of a repetition of a benchmark. The number of iterations "
+             "of each repetition is grown until a repetition lasts this long.");
+DEFINE_int32(microbench_warmup_repetitions, 1,
+             "Number of repetitions of each benchmark run before the measured ones.");
+DEFINE_int32(microbench_repetitions, 5,
+             "Number of measured repetitions of each benchmark.");
+DEFINE_string(microbench_out, "",
+              "File to write the JSON results to. The results are written to stdout "
+              "if empty.");
+DEFINE_bool(microbench_list, false, "List the names of the benchmarks and exit.");
+
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace kudu {
+namespace microbench {
+
+namespace {
+
+vector<pair<string, BenchmarkFunc>>* benchmarks() {
+  static auto* benchmarks = new vector<pair<string, BenchmarkFunc>>();
+  return benchmarks;
+}
+
+// The results of a repetition.
+struct Repetition {
+  double ns_per_iter;
+  double items_per_sec;
+  double bytes_per_sec;
+};
+
+Repetition RunRepetition(const BenchmarkFunc& func, int64_t iterations) {
+  State state(iterations);
+  func(&state);
+  double secs = std::max<int64_t>(state.elapsed_ns(), 1) / 1e9;
+  return { static_cast<double>(state.elapsed_ns()) / iterations,
+           state.items_processed() / secs,
+           state.bytes_processed() / secs };
+}
+
+// Writes the minimum, maximum, mean, median and standard deviation of
+// 'values' as an object.
+void WriteStats(vector<double> values, JsonWriter* jw) {
+  std::sort(values.begin(), values.end());
+  double sum = 0;
+  for (double v : values) {
+    sum += v;
+  }
+  double mean = sum / values.size();
+  double sq_sum = 0;
+  for (double v : values) {
+    sq_sum += (v - mean) * (v - mean);
+  }
+  size_t n = values.size();
+  double median = n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+  jw->StartObject();
+  jw->String("min");
+  jw->Double(values.front());
+  jw->String("max");
+  jw->Double(values.back());
+  jw->String("mean");
+  jw->Double(mean);
+  jw->String("median");
+  jw->Double(median);
+  jw->String("stddev");
+  jw->Double(n > 1 ? std::sqrt(sq_sum / (n - 1)) : 0);
+  jw->EndObject();
+}
+
+void RunBenchmark(const string& name, const BenchmarkFunc& func, JsonWriter* jw) {
+  LOG(INFO) << "Running " << name;
+
+  // Growing the number of iterations also warms the benchmark up.
+  const int64_t min_ns = FLAGS_microbench_min_time_ms * 1000000LL;
+  int64_t iterations = 1;
+  while (true) {
+    State state(iterations);
+    func(&state);
+    if (state.elapsed_ns() >= min_ns || iterations >= (1LL << 40)) {
+      break;
+    }
+    // Aim past the minimum time rather than doubling blindly, but don't
+    // trust the estimate of very short repetitions too much.
+    double factor = state.elapsed_ns() > 0
+        ? 1.4 * min_ns / state.elapsed_ns() : 10;
+    iterations = std::max<int64_t>(iterations + 1,
+                                   iterations * std::min(factor, 10.0));
+  }
+
+  for (int i = 0; i < FLAGS_microbench_warmup_repetitions; i++) {
+    RunRepetition(func, iterations);
+  }
+  vector<double> ns_per_iter;
+  vector<double> items_per_sec;
+  vector<double> bytes_per_sec;
+  for (int i = 0; i < FLAGS_microbench_repetitions; i++) {
+    Repetition r = RunRepetition(func, iterations);
+    ns_per_iter.push_back(r.ns_per_iter);
+    items_per_sec.push_back(r.items_per_sec);
+    bytes_per_sec.push_back(r.bytes_per_sec);
+  }
+
+  jw->StartObject();
+  jw->String("name");
+  jw->String(name);
+  jw->String("iterations");
+  jw->Int64(iterations);
+  jw->String("warmup_repetitions");
+  jw->Int(FLAGS_microbench_warmup_repetitions);
+  jw->String("repetitions");
+  jw->Int(FLAGS_microbench_repetitions);
+  jw->String("ns_per_iteration");
+  WriteStats(ns_per_iter, jw);
+  if (items_per_sec.front() > 0) {
+    jw->String("items_per_second");
+    WriteStats(items_per_sec, jw);
+  }
+  if (bytes_per_sec.front() > 0) {
+    jw->String("bytes_per_second");
+    WriteStats(bytes_per_sec, jw);
+  }
+  jw->EndObject();
+}
+
+bool Matches(const string& name, const vector<string>& globs) {
+  for (const string& glob : globs) {
+    if (MatchPattern(name, glob)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // anonymous namespace
+
+bool RegisterBenchmark(string name, BenchmarkFunc func) {
+  benchmarks()->emplace_back(std::move(name), std::move(func));
+  return true;
+}
+
+int MicrobenchMain(int argc, char** argv) {
+  ParseCommandLineFlags(&argc, &argv, true);
+  InitGoogleLoggingSafe(argv[0]);
+  if (FLAGS_microbench_repetitions <= 0) {
+    LOG(ERROR) << "--microbench_repetitions must be positive";
+    return 1;
+  }
+
+  vector<string> globs = strings::Split(FLAGS_microbench_filter, ",", strings::SkipEmpty());
+  std::sort(benchmarks()->begin(), benchmarks()->end(),
+            [] (const pair<string, BenchmarkFunc>& a, const pair<string, BenchmarkFunc>& b) {
+              return a.first < b.first;
+            });
+  if (FLAGS_microbench_list) {
+    for (const auto& b : *benchmarks()) {
+      std::cout << b.first << std::endl;
+    }
+    return 0;
+  }
+
+  std::ostringstream out;
+  JsonWriter jw(&out, JsonWriter::PRETTY);
+  jw.StartObject();
+  VersionInfoPB version;
+  VersionInfo::GetVersionInfoPB(&version);
+  jw.String("context");
+  jw.StartObject();
+  jw.String("version");
+  jw.String(version.version_string());
+  jw.String("git_hash");
+  jw.String(version.git_hash());
+  jw.String("build_type");
+  jw.String(version.build_type());
+  jw.String("num_cpus");
+  jw.Int(base::NumCPUs());
+  jw.String("start_time_usec");
+  jw.Int64(GetCurrentTimeMicros());
+  jw.String("min_time_ms");
+  jw.Int(FLAGS_microbench_min_time_ms);
+  jw.EndObject();
+  jw.String("benchmarks");
+  jw.StartArray();
+  for (const auto& b : *benchmarks()) {
+    if (Matches(b.first, globs)) {
+      RunBenchmark(b.first, b.second, &jw);
+    }
+  }
+  jw.EndArray();
+  jw.EndObject();
+
+  if (FLAGS_microbench_out.empty()) {
+    std::cout << out.str() << std::endl;
+  } else {
+    std::ofstream f(FLAGS_microbench_out.c_str());
+    f << out.str() << std::endl;
+    if (!f.good()) {
+      LOG(ERROR) << "could not write " << FLAGS_microbench_out;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+} // namespace microbench
+} // namespace kudu
+
+int main(int argc, char** argv) {
+  return kudu::microbench::MicrobenchMain(argc, argv);
+}
@@ -0,0 +1,109 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// A minimal framework for the microbenchmarks of the storage engine's hot
+// paths, which are all linked into the 'microbench' binary. Its results are
+// written as JSON, so that runs of different builds can be compared.
+//
+// A benchmark is a function which runs its operation state->iterations()
+// times:
+//
+//   KUDU_MICROBENCHMARK(BM_Foo) {
+//     Foo foo;
+//     state->ResumeTiming();
+//     for (int64_t i = 0; i < state->iterations(); i++) {
+//       DoNotOptimize(foo.Bar());
+//     }
+//     state->PauseTiming();
+//     state->SetItemsProcessed(state->iterations());
+//   }
+//
+// The runner first grows the number of iterations until a repetition takes
+// --microbench_min_time_ms, then runs --microbench_warmup_repetitions
+// repetitions which aren't reported, and finally --microbench_repetitions
+// reported ones.
+#ifndef KUDU_BENCHMARKS_MICROBENCH_MICROBENCH_H
+#define KUDU_BENCHMARKS_MICROBENCH_MICROBENCH_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/monotime.h"
+
+namespace kudu {
+namespace microbench {
+
+// The state of one repetition of a benchmark.
+class State {
+ public:
+  explicit State(int64_t iterations)
+      : iterations_(iterations) {
+  }
+
+  int64_t iterations() const { return iterations_; }
+
+  // Only the time between ResumeTiming() and PauseTiming() is measured, so
+  // that benchmarks can exclude their setup. Timing starts paused.
+  void ResumeTiming() {
+    start_ = MonoTime::Now();
+  }
+  void PauseTiming() {
+    elapsed_ns_ += (MonoTime::Now() - start_).ToNanoseconds();
+  }
+
+  // The number of items or bytes processed by the repetition, if it has a
+  // meaningful throughput.
+  void SetItemsProcessed(int64_t items) { items_processed_ = items; }
+  void SetBytesProcessed(int64_t bytes) { bytes_processed_ = bytes; }
+
+  int64_t elapsed_ns() const { return elapsed_ns_; }
+  int64_t items_processed() const { return items_processed_; }
+  int64_t bytes_processed() const { return bytes_processed_; }
+
+ private:
+  const int64_t iterations_;
+  MonoTime start_;
+  int64_t elapsed_ns_ = 0;
+  int64_t items_processed_ = 0;
+  int64_t bytes_processed_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(State);
+};
+
+typedef std::function<void(State*)> BenchmarkFunc;
+
+// Registers 'func' as the benchmark 'name'. Returns true so that it can
+// initialize a static variable.
+bool RegisterBenchmark(std::string name, BenchmarkFunc func);
+
+#define KUDU_MICROBENCHMARK(name)                                                     \
+  static void name(::kudu::microbench::State* state);                                 \
+  static const bool name##_registered ATTRIBUTE_UNUSED =                              \
+      ::kudu::microbench::RegisterBenchmark(#name, &name);                            \
+  static void name(::kudu::microbench::State* state)
+
+// Keeps the compiler from optimizing away the computation of 'value'.
+template<class T>
+inline void DoNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+} // namespace microbench
+} // namespace kudu
+#endif /* KUDU_BENCHMARKS_MICROBENCH_MICROBENCH_H */
@@ -0,0 +1,144 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Benchmarks of the in-memory stores of a tablet.
+
+#include <memory>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "kudu/benchmarks/microbench/microbench.h"
+#include "kudu/common/row_changelist.h"
+#include "kudu/common/schema.h"
+#include "kudu/common/timestamp.h"
+#include "kudu/consensus/log_anchor_registry.h"
+#include "kudu/consensus/opid_util.h"
+#include "kudu/gutil/endian.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/tablet/concurrent_btree.h"
+#include "kudu/tablet/deltamemstore.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/random.h"
+
+using std::shared_ptr;
+using std::vector;
+
+namespace kudu {
+namespace tablet {
+namespace {
+
+using btree::BTreeTraits;
+using btree::CBTree;
+using btree::CBTreeIterator;
+
+const int kNumEntries = 100 * 1000;
+
+// Applies updates of an int32 column to random rows of a DeltaMemStore, as
+// the updates of a write RPC are.
+KUDU_MICROBENCHMARK(BM_DeltaMemStoreUpdate) {
+  SchemaBuilder builder;
+  CHECK_OK(builder.AddKeyColumn("key", INT32));
+  CHECK_OK(builder.AddColumn("val", INT32));
+  Schema schema = builder.Build();
+  consensus::OpId op_id = consensus::MaximumOpId();
+  scoped_refptr<log::LogAnchorRegistry> registry(new log::LogAnchorRegistry());
+
+  Random rng(1);
+  vector<rowid_t> rows(kNumEntries);
+  for (rowid_t& row : rows) {
+    row = rng.Uniform(kNumEntries * 10);
+  }
+  faststring buf;
+  RowChangeListEncoder update(&buf);
+
+  for (int64_t i = 0; i < state->iterations(); i++) {
+    shared_ptr<DeltaMemStore> dms(new DeltaMemStore(0, 0, registry.get()));
+    CHECK_OK(dms->Init());
+    state->ResumeTiming();
+    for (int j = 0; j < kNumEntries; j++) {
+      update.Reset();
+      int32_t val = j;
+      update.AddColumnUpdate(schema.column(1), schema.column_id(1), &val);
+      CHECK_OK(dms->Update(Timestamp(j), rows[j], RowChangeList(buf), op_id));
+    }
+    state->PauseTiming();
+  }
+  state->SetItemsProcessed(state->iterations() * kNumEntries);
+}
+
+// Inserts big-endian keys, which sort in the order of their values, with
+// an 8-byte value into a tree.
+void InsertKeys(const vector<uint64_t>& keys, CBTree<BTreeTraits>* tree) {
+  uint64_t val = 0;
+  for (uint64_t key : keys) {
+    uint64_t big_endian = BigEndian::FromHost64(key);
+    CHECK(tree->Insert(Slice(reinterpret_cast<const uint8_t*>(&big_endian), sizeof(big_endian)),
+                       Slice(reinterpret_cast<const uint8_t*>(&val), sizeof(val))));
+  }
+}
+
+void CBTreeInsert(bool sequential, microbench::State* state) {
+  vector<uint64_t> keys(kNumEntries);
+  Random rng(1);
+  for (int i = 0; i < kNumEntries; i++) {
+    keys[i] = sequential ? i : rng.Next64();
+  }
+  for (int64_t i = 0; i < state->iterations(); i++) {
+    gscoped_ptr<CBTree<BTreeTraits>> tree(new CBTree<BTreeTraits>());
+    state->ResumeTiming();
+    InsertKeys(keys, tree.get());
+    state->PauseTiming();
+  }
+  state->SetItemsProcessed(state->iterations() * kNumEntries);
+}
+
+KUDU_MICROBENCHMARK(BM_CBTreeInsertSequential) {
+  CBTreeInsert(true, state);
+}
+
+KUDU_MICROBENCHMARK(BM_CBTreeInsertRandom) {
+  CBTreeInsert(false, state);
+}
+
+KUDU_MICROBENCHMARK(BM_CBTreeScan) {
+  vector<uint64_t> keys(kNumEntries);
+  for (int i = 0; i < kNumEntries; i++) {
+    keys[i] = i;
+  }
+  CBTree<BTreeTraits> tree;
+  InsertKeys(keys, &tree);
+
+  state->ResumeTiming();
+  for (int64_t i = 0; i < state->iterations(); i++) {
+    gscoped_ptr<CBTreeIterator<BTreeTraits>> iter(tree.NewIterator());
+    bool exact;
+    iter->SeekAtOrAfter(Slice(""), &exact);
+    Slice k, v;
+    while (iter->IsValid()) {
+      iter->GetCurrentEntry(&k, &v);
+      microbench::DoNotOptimize(k.data());
+      iter->Next();
+    }
+  }
+  state->PauseTiming();
+  state->SetItemsProcessed(state->iterations() * kNumEntries);
+}
+
+} // anonymous namespace
+} // namespace tablet
+} // namespace kudu
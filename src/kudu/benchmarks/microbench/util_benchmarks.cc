@@ -0,0 +1,121 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Benchmarks of the bloom filters and the block cache.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "kudu/benchmarks/microbench/microbench.h"
+#include "kudu/gutil/stringprintf.h"
+#include "kudu/util/bloom_filter.h"
+#include "kudu/util/cache.h"
+#include "kudu/util/random.h"
+#include "kudu/util/slice.h"
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace kudu {
+namespace {
+
+const int kNumKeys = 100 * 1000;
+
+vector<string> MakeKeys(const char* prefix) {
+  vector<string> keys;
+  for (int i = 0; i < kNumKeys; i++) {
+    keys.push_back(StringPrintf("%s%012d", prefix, i));
+  }
+  return keys;
+}
+
+// Probes a filter of kNumKeys keys with keys which are half present and half
+// absent. The probes are hashed up front, as they are when a key is probed
+// against the filters of several rowsets.
+void BloomProbe(BloomFilterLayout layout, microbench::State* state) {
+  vector<string> present = MakeKeys("present");
+  BloomFilterBuilder builder(BloomFilterSizing::ByCountAndFPRate(kNumKeys, 0.01, layout));
+  for (const string& key : present) {
+    builder.AddKey(BloomKeyProbe(Slice(key)));
+  }
+  BloomFilter bf(builder.slice(), builder.n_hashes(), layout);
+
+  vector<string> absent = MakeKeys("absent");
+  vector<BloomKeyProbe> probes;
+  for (int i = 0; i < kNumKeys; i++) {
+    probes.emplace_back(Slice(i % 2 ? present[i] : absent[i]));
+  }
+
+  state->ResumeTiming();
+  for (int64_t i = 0; i < state->iterations(); i++) {
+    int hits = 0;
+    for (const BloomKeyProbe& probe : probes) {
+      hits += bf.MayContainKey(probe);
+    }
+    microbench::DoNotOptimize(hits);
+  }
+  state->PauseTiming();
+  state->SetItemsProcessed(state->iterations() * kNumKeys);
+}
+
+KUDU_MICROBENCHMARK(BM_BloomProbeClassic) {
+  BloomProbe(CLASSIC_BLOOM_LAYOUT, state);
+}
+
+KUDU_MICROBENCHMARK(BM_BloomProbeBlocked) {
+  BloomProbe(BLOCKED_BLOOM_LAYOUT, state);
+}
+
+// Looks up random blocks of a cache which holds all of them, with keys of
+// the size of the keys of the block cache.
+KUDU_MICROBENCHMARK(BM_CacheLookupHit) {
+  const int kValueSize = 64;
+  unique_ptr<Cache> cache(NewLRUCache(DRAM_CACHE, kNumKeys * kValueSize * 2, "microbench"));
+  vector<string> keys;
+  for (uint64_t i = 0; i < kNumKeys; i++) {
+    uint64_t key[2] = { i, i * 4096 };
+    keys.emplace_back(reinterpret_cast<const char*>(key), sizeof(key));
+    Cache::PendingHandle* pending = CHECK_NOTNULL(
+        cache->Allocate(keys.back(), kValueSize, kValueSize));
+    memset(cache->MutableValue(pending), 0, kValueSize);
+    cache->Release(cache->Insert(pending, nullptr));
+  }
+
+  Random rng(1);
+  vector<int> order;
+  for (int i = 0; i < kNumKeys; i++) {
+    order.push_back(rng.Uniform(kNumKeys));
+  }
+
+  state->ResumeTiming();
+  for (int64_t i = 0; i < state->iterations(); i++) {
+    for (int idx : order) {
+      Cache::Handle* h = cache->Lookup(keys[idx], Cache::EXPECT_IN_CACHE);
+      DCHECK(h != nullptr);
+      cache->Release(h);
+    }
+  }
+  state->PauseTiming();
+  state->SetItemsProcessed(state->iterations() * kNumKeys);
+}
+
+} // anonymous namespace
+} // namespace kudu
@@ -22,6 +22,8 @@
 #include <string>
 #include <vector>
 
+#include <glog/logging.h>
+
 #include "kudu/client/schema.h"
 #include "kudu/util/status.h"
 
@@ -113,6 +115,119 @@ inline std::vector<std::string> GetTpchQ1QueryColumns() {
            kTaxColName };
 }
 
+// The eight tables of the TPC-H schema.
+enum class TpchTable {
+  kPart,
+  kSupplier,
+  kPartSupp,
+  kCustomer,
+  kOrders,
+  kLineItem,
+  kNation,
+  kRegion
+};
+
+static const TpchTable kAllTpchTables[] = {
+  TpchTable::kPart, TpchTable::kSupplier, TpchTable::kPartSupp, TpchTable::kCustomer,
+  TpchTable::kOrders, TpchTable::kLineItem, TpchTable::kNation, TpchTable::kRegion
+};
+
+struct TpchColumn {
+  const char* name;
+  client::KuduColumnSchema::DataType type;
+};
+
+// Returns the name of the table, which is also the base name of the file
+// generated by dbgen for it.
+inline const char* GetTpchTableName(TpchTable table) {
+  switch (table) {
+    case TpchTable::kPart: return "part";
+    case TpchTable::kSupplier: return "supplier";
+    case TpchTable::kPartSupp: return "partsupp";
+    case TpchTable::kCustomer: return "customer";
+    case TpchTable::kOrders: return "orders";
+    case TpchTable::kLineItem: return "lineitem";
+    case TpchTable::kNation: return "nation";
+    case TpchTable::kRegion: return "region";
+  }
+  LOG(FATAL) << "unknown TPC-H table";
+  return "";
+}
+
+// Returns the columns of the table in the order of the fields of the lines
+// generated by dbgen. Decimals are doubles and dates are strings, as in the
+// lineitem schema.
+inline std::vector<TpchColumn> GetTpchColumns(TpchTable table) {
+  switch (table) {
+    case TpchTable::kPart:
+      return { { "p_partkey", kInt32 }, { "p_name", kString }, { "p_mfgr", kString },
+               { "p_brand", kString }, { "p_type", kString }, { "p_size", kInt32 },
+               { "p_container", kString }, { "p_retailprice", kDouble },
+               { "p_comment", kString } };
+    case TpchTable::kSupplier:
+      return { { "s_suppkey", kInt32 }, { "s_name", kString }, { "s_address", kString },
+               { "s_nationkey", kInt32 }, { "s_phone", kString }, { "s_acctbal", kDouble },
+               { "s_comment", kString } };
+    case TpchTable::kPartSupp:
+      return { { "ps_partkey", kInt32 }, { "ps_suppkey", kInt32 },
+               { "ps_availqty", kInt32 }, { "ps_supplycost", kDouble },
+               { "ps_comment", kString } };
+    case TpchTable::kCustomer:
+      return { { "c_custkey", kInt32 }, { "c_name", kString }, { "c_address", kString },
+               { "c_nationkey", kInt32 }, { "c_phone", kString }, { "c_acctbal", kDouble },
+               { "c_mktsegment", kString }, { "c_comment", kString } };
+    case TpchTable::kOrders:
+      return { { "o_orderkey", kInt64 }, { "o_custkey", kInt32 },
+               { "o_orderstatus", kString }, { "o_totalprice", kDouble },
+               { "o_orderdate", kString }, { "o_orderpriority", kString },
+               { "o_clerk", kString }, { "o_shippriority", kInt32 },
+               { "o_comment", kString } };
+    case TpchTable::kLineItem:
+      return { { kOrderKeyColName, kInt64 }, { kPartKeyColName, kInt32 },
+               { kSuppKeyColName, kInt32 }, { kLineNumberColName, kInt32 },
+               { kQuantityColName, kInt32 }, { kExtendedPriceColName, kDouble },
+               { kDiscountColName, kDouble }, { kTaxColName, kDouble },
+               { kReturnFlagColName, kString }, { kLineStatusColName, kString },
+               { kShipDateColName, kString }, { kCommitDateColName, kString },
+               { kReceiptDateColName, kString }, { kShipInstructColName, kString },
+               { kShipModeColName, kString }, { kCommentColName, kString } };
+    case TpchTable::kNation:
+      return { { "n_nationkey", kInt32 }, { "n_name", kString }, { "n_regionkey", kInt32 },
+               { "n_comment", kString } };
+    case TpchTable::kRegion:
+      return { { "r_regionkey", kInt32 }, { "r_name", kString }, { "r_comment", kString } };
+  }
+  LOG(FATAL) << "unknown TPC-H table";
+  return {};
+}
+
+// Returns the primary key columns of the table, which it's also range
+// partitioned on.
+inline std::vector<std::string> GetTpchPrimaryKey(TpchTable table) {
+  switch (table) {
+    case TpchTable::kPartSupp:
+      return { "ps_partkey", "ps_suppkey" };
+    case TpchTable::kLineItem:
+      return { kOrderKeyColName, kLineNumberColName };
+    default:
+      return { GetTpchColumns(table)[0].name };
+  }
+}
+
+inline client::KuduSchema CreateTpchSchema(TpchTable table) {
+  if (table == TpchTable::kLineItem) {
+    return CreateLineItemSchema();
+  }
+  client::KuduSchemaBuilder b;
+  client::KuduSchema s;
+  for (const TpchColumn& col : GetTpchColumns(table)) {
+    b.AddColumn(col.name)->Type(col.type)->NotNull();
+  }
+  b.SetPrimaryKey(GetTpchPrimaryKey(table));
+  CHECK_OK(b.Build(&s));
+  return s;
+}
+
 } // namespace tpch
 } // namespace kudu
 #endif
@@ -0,0 +1,231 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/benchmarks/tpch/tpch_loader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "kudu/client/client.h"
+#include "kudu/common/partial_row.h"
+#include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/substitute.h"
+
+using kudu::client::KuduClient;
+using kudu::client::KuduColumnSchema;
+using kudu::client::KuduError;
+using kudu::client::KuduInsert;
+using kudu::client::KuduSchema;
+using kudu::client::KuduSession;
+using kudu::client::KuduTable;
+using kudu::client::KuduTableCreator;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace tpch {
+
+namespace {
+
+// The number of rows written per batch.
+const int kBatchSize = 1000;
+
+// Returns the error of the first failed write of 'session', or 's' if
+// there's none.
+Status SessionError(KuduSession* session, const Status& s) {
+  vector<KuduError*> errors;
+  ElementDeleter d(&errors);
+  bool overflowed;
+  session->GetPendingErrors(&errors, &overflowed);
+  return errors.empty() ? s : errors[0]->status();
+}
+
+Status SetField(const TpchColumn& col, int col_idx, const StringPiece& field,
+                KuduPartialRow* row) {
+  string str = field.ToString();
+  switch (col.type) {
+    case KuduColumnSchema::INT32: {
+      int32_t v;
+      if (!safe_strto32(str, &v)) {
+        return Status::Corruption(Substitute("bad integer in column $0", col.name), str);
+      }
+      return row->SetInt32(col_idx, v);
+    }
+    case KuduColumnSchema::INT64: {
+      int64_t v;
+      if (!safe_strto64(str, &v)) {
+        return Status::Corruption(Substitute("bad integer in column $0", col.name), str);
+      }
+      return row->SetInt64(col_idx, v);
+    }
+    case KuduColumnSchema::DOUBLE: {
+      double v;
+      if (!safe_strtod(str, &v)) {
+        return Status::Corruption(Substitute("bad double in column $0", col.name), str);
+      }
+      return row->SetDouble(col_idx, v);
+    }
+    case KuduColumnSchema::STRING:
+      return row->SetStringCopy(col_idx, field);
+    default:
+      LOG(FATAL) << "unexpected type of TPC-H column " << col.name;
+  }
+  return Status::OK();
+}
+
+} // anonymous namespace
+
+TpchLoader::TpchLoader(client::sp::shared_ptr<KuduClient> client,
+                       double scale_factor,
+                       int num_tablets,
+                       int num_replicas)
+    : client_(std::move(client)),
+      scale_factor_(scale_factor),
+      num_tablets_(num_tablets),
+      num_replicas_(num_replicas) {
+}
+
+int64_t TpchLoader::MaxKey(TpchTable table, double scale_factor) {
+  switch (table) {
+    case TpchTable::kPart:
+    case TpchTable::kPartSupp:
+      return static_cast<int64_t>(200000 * scale_factor);
+    case TpchTable::kSupplier:
+      return static_cast<int64_t>(10000 * scale_factor);
+    case TpchTable::kCustomer:
+      return static_cast<int64_t>(150000 * scale_factor);
+    case TpchTable::kOrders:
+    case TpchTable::kLineItem:
+      // Only the first 8 of every 32 order keys are used.
+      return static_cast<int64_t>(6000000 * scale_factor);
+    case TpchTable::kNation:
+      return 24;
+    case TpchTable::kRegion:
+      return 4;
+  }
+  LOG(FATAL) << "unknown TPC-H table";
+  return 0;
+}
+
+Status TpchLoader::CreateTable(TpchTable table) {
+  KuduSchema schema = CreateTpchSchema(table);
+  const vector<TpchColumn> columns = GetTpchColumns(table);
+  const string& key_col = GetTpchPrimaryKey(table)[0];
+
+  unique_ptr<KuduTableCreator> creator(client_->NewTableCreator());
+  creator->table_name(GetTpchTableName(table))
+      .schema(&schema)
+      .set_range_partition_columns(GetTpchPrimaryKey(table))
+      .num_replicas(num_replicas_);
+
+  // The keys are dense, so splitting their range evenly spreads the rows
+  // evenly over the tablets.
+  int64_t max_key = MaxKey(table, scale_factor_);
+  int num_tablets = (table == TpchTable::kNation || table == TpchTable::kRegion)
+      ? 1 : std::min<int64_t>(num_tablets_, max_key);
+  for (int i = 1; i < num_tablets; i++) {
+    KuduPartialRow* split = schema.NewRow();
+    int64_t key = max_key * i / num_tablets + 1;
+    if (columns[0].type == KuduColumnSchema::INT64) {
+      RETURN_NOT_OK(split->SetInt64(key_col, key));
+    } else {
+      RETURN_NOT_OK(split->SetInt32(key_col, key));
+    }
+    creator->add_range_partition_split(split);
+  }
+  return creator->Create();
+}
+
+Status TpchLoader::Load(TpchTable table, const string& path, int64_t* num_rows) {
+  const char* table_name = GetTpchTableName(table);
+  bool exists;
+  RETURN_NOT_OK(client_->TableExists(table_name, &exists));
+  if (exists) {
+    return Status::AlreadyPresent("TPC-H table already exists", table_name);
+  }
+
+  std::ifstream in(path.c_str());
+  if (!in.is_open()) {
+    return Status::IOError("could not open TPC-H data file", path, errno);
+  }
+  RETURN_NOT_OK_PREPEND(CreateTable(table),
+                        Substitute("could not create TPC-H table $0", table_name));
+  client::sp::shared_ptr<KuduTable> kudu_table;
+  RETURN_NOT_OK(client_->OpenTable(table_name, &kudu_table));
+
+  // The fields of the file aren't in the order of the columns of lineitem.
+  const vector<TpchColumn> columns = GetTpchColumns(table);
+  const KuduSchema& schema = kudu_table->schema();
+  vector<int> col_idxs;
+  for (const TpchColumn& col : columns) {
+    for (int i = 0; i < schema.num_columns(); i++) {
+      if (schema.Column(i).name() == col.name) {
+        col_idxs.push_back(i);
+        break;
+      }
+    }
+  }
+  CHECK_EQ(columns.size(), col_idxs.size());
+
+  client::sp::shared_ptr<KuduSession> session = client_->NewSession();
+  session->SetTimeoutMillis(60000);
+  RETURN_NOT_OK(session->SetFlushMode(KuduSession::MANUAL_FLUSH));
+  *num_rows = 0;
+  string line;
+  int pending = 0;
+  while (getline(in, line)) {
+    if (line.empty()) continue;
+    // dbgen ends every line with a separator, which leaves an empty last
+    // field.
+    vector<StringPiece> fields = strings::Split(line, "|");
+    if (fields.size() < columns.size()) {
+      return Status::Corruption(
+          Substitute("line $0 of $1 has $2 fields, expected $3",
+                     *num_rows + 1, path, fields.size(), columns.size()));
+    }
+    unique_ptr<KuduInsert> insert(kudu_table->NewInsert());
+    for (int i = 0; i < columns.size(); i++) {
+      RETURN_NOT_OK(SetField(columns[i], col_idxs[i], fields[i], insert->mutable_row()));
+    }
+    RETURN_NOT_OK(session->Apply(insert.release()));
+    (*num_rows)++;
+    if (++pending == kBatchSize) {
+      Status s = session->Flush();
+      if (!s.ok()) {
+        return SessionError(session.get(), s);
+      }
+      pending = 0;
+    }
+  }
+  Status s = session->Flush();
+  if (!s.ok()) {
+    return SessionError(session.get(), s);
+  }
+  return Status::OK();
+}
+
+} // namespace tpch
+} // namespace kudu
@@ -0,0 +1,70 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TPCH_TPCH_LOADER_H
+#define KUDU_TPCH_TPCH_LOADER_H
+
+#include <cstdint>
+#include <string>
+
+#include "kudu/benchmarks/tpch/tpch-schemas.h"
+#include "kudu/client/shared_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+namespace client {
+class KuduClient;
+} // namespace client
+
+namespace tpch {
+
+// Creates the TPC-H tables and loads them from the '|' separated files
+// generated by dbgen, such as lineitem.tbl.
+class TpchLoader {
+ public:
+  // 'scale_factor' is that of the data, which sizes the range partitions of
+  // the tables. Each table is split into 'num_tablets' of them, except for
+  // nation and region, which are tiny.
+  TpchLoader(client::sp::shared_ptr<client::KuduClient> client,
+             double scale_factor,
+             int num_tablets,
+             int num_replicas = 1);
+
+  // Creates 'table' and loads the file 'path' into it, setting '*num_rows'
+  // to the number of rows written. Returns AlreadyPresent without loading
+  // anything if the table exists.
+  Status Load(TpchTable table, const std::string& path, int64_t* num_rows);
+
+  // Returns the largest key of the first primary key column of 'table' at
+  // the given scale factor, per the TPC-H specification.
+  static int64_t MaxKey(TpchTable table, double scale_factor);
+
+ private:
+  Status CreateTable(TpchTable table);
+
+  const client::sp::shared_ptr<client::KuduClient> client_;
+  const double scale_factor_;
+  const int num_tablets_;
+  const int num_replicas_;
+
+  DISALLOW_COPY_AND_ASSIGN(TpchLoader);
+};
+
+} // namespace tpch
+} // namespace kudu
+#endif
@@ -0,0 +1,124 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "kudu/benchmarks/tpch/tpch-schemas.h"
+#include "kudu/benchmarks/tpch/tpch_loader.h"
+#include "kudu/benchmarks/tpch/tpch_queries.h"
+#include "kudu/client/client.h"
+#include "kudu/gutil/strings/join.h"
+#include "kudu/integration-tests/mini_cluster.h"
+#include "kudu/master/mini_master.h"
+#include "kudu/util/env.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+namespace kudu {
+namespace tpch {
+
+using client::KuduClient;
+using client::KuduClientBuilder;
+using std::string;
+using std::vector;
+
+class TpchQueriesTest : public KuduTest {
+ public:
+  virtual void SetUp() OVERRIDE {
+    KuduTest::SetUp();
+    cluster_.reset(new MiniCluster(env_.get(), MiniClusterOptions()));
+    ASSERT_OK(cluster_->Start());
+    ASSERT_OK(KuduClientBuilder()
+              .add_master_server_addr(cluster_->mini_master()->bound_rpc_addr_str())
+              .Build(&client_));
+  }
+
+  virtual void TearDown() OVERRIDE {
+    cluster_->Shutdown();
+    KuduTest::TearDown();
+  }
+
+ protected:
+  // Writes 'lines' to the dbgen file of 'table' and loads it.
+  void Load(TpchLoader* loader, TpchTable table, const vector<string>& lines) {
+    string path = GetTestPath(string(GetTpchTableName(table)) + ".tbl");
+    ASSERT_OK(WriteStringToFile(env_.get(), JoinStrings(lines, "\n"), path));
+    int64_t num_rows;
+    ASSERT_OK(loader->Load(table, path, &num_rows));
+    ASSERT_EQ(lines.size(), num_rows);
+  }
+
+  gscoped_ptr<MiniCluster> cluster_;
+  client::sp::shared_ptr<KuduClient> client_;
+};
+
+TEST_F(TpchQueriesTest, TestQueries) {
+  TpchLoader loader(client_, 0.001, 3);
+  NO_FATALS(Load(&loader, TpchTable::kPart, {
+    "1|p1|Manufacturer#1|Brand#12|PROMO BRUSHED TIN|3|SM BOX|901.00|c|",
+    "2|p2|Manufacturer#1|Brand#23|STANDARD POLISHED TIN|7|MED BAG|902.00|c|",
+    "3|p3|Manufacturer#1|Brand#34|PROMO PLATED COPPER|20|LG BOX|903.00|c|",
+  }));
+  NO_FATALS(Load(&loader, TpchTable::kOrders, {
+    "1|1|O|100.00|1994-01-01|1-URGENT|Clerk#1|0|c|",
+    "2|1|O|100.00|1994-01-01|5-LOW|Clerk#1|0|c|",
+  }));
+  NO_FATALS(Load(&loader, TpchTable::kLineItem, {
+    // Matches Q1 and Q12 (MAIL, high), but isn't shipped by air for Q19.
+    "1|1|1|1|5|100.00|0.10|0.00|N|O|1994-03-01|1994-03-05|1994-03-10|"
+        "DELIVER IN PERSON|MAIL|c|",
+    // Matches Q1, Q6 and Q12 (SHIP, low).
+    "2|2|1|1|10|200.00|0.06|0.00|R|F|1994-06-01|1994-06-05|1994-06-10|NONE|SHIP|c|",
+    // Matches Q14 (not promo) and Q19 (part 2).
+    "2|2|1|2|15|300.00|0.00|0.00|N|O|1995-09-10|1995-09-01|1995-09-20|"
+        "DELIVER IN PERSON|AIR|c|",
+    // Matches Q14 (promo), but part 3 is too large for Q19.
+    "2|3|1|3|25|100.00|0.00|0.00|N|O|1995-09-11|1995-09-01|1995-09-20|"
+        "DELIVER IN PERSON|AIR|c|",
+  }));
+
+  // Tables are only loaded once.
+  int64_t num_rows;
+  ASSERT_TRUE(loader.Load(TpchTable::kPart, "/nonexistent", &num_rows).IsAlreadyPresent());
+
+  TpchQueryRunner runner(client_, 2);
+  TpchQueryResult result;
+  ASSERT_OK(runner.Run(1, &result));
+  ASSERT_EQ(2, result.rows.size());
+  ASSERT_EQ("R|F|10.00|200.00|188.00|188.00|10.00|200.00|0.06|1", result.rows[1]);
+  ASSERT_EQ(4, result.rows_scanned);
+  ASSERT_GT(result.bytes_scanned, 0);
+
+  ASSERT_OK(runner.Run(6, &result));
+  ASSERT_EQ(vector<string>({ "12.00" }), result.rows);
+
+  ASSERT_OK(runner.Run(12, &result));
+  ASSERT_EQ(vector<string>({ "MAIL|1|0", "SHIP|0|1" }), result.rows);
+
+  ASSERT_OK(runner.Run(14, &result));
+  ASSERT_EQ(vector<string>({ "25.00" }), result.rows);
+
+  ASSERT_OK(runner.Run(19, &result));
+  ASSERT_EQ(vector<string>({ "300.00" }), result.rows);
+
+  ASSERT_TRUE(runner.Run(2, &result).IsNotSupported());
+}
+
+} // namespace tpch
+} // namespace kudu
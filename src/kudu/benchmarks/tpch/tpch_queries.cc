@@ -0,0 +1,551 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/benchmarks/tpch/tpch_queries.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/benchmarks/tpch/tpch-schemas.h"
+#include "kudu/client/client.h"
+#include "kudu/client/resource_metrics.h"
+#include "kudu/client/scan_batch.h"
+#include "kudu/client/value.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/thread.h"
+
+using kudu::client::KuduClient;
+using kudu::client::KuduPredicate;
+using kudu::client::KuduScanBatch;
+using kudu::client::KuduScanToken;
+using kudu::client::KuduScanTokenBuilder;
+using kudu::client::KuduScanner;
+using kudu::client::KuduTable;
+using kudu::client::KuduValue;
+using std::map;
+using std::pair;
+using std::string;
+using std::unique_ptr;
+using std::unordered_map;
+using std::unordered_set;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace tpch {
+
+namespace {
+
+// The columns of the projections are known, so reading them can't fail.
+int32_t GetInt32(const KuduScanBatch::RowPtr& row, int idx) {
+  int32_t v;
+  CHECK_OK(row.GetInt32(idx, &v));
+  return v;
+}
+
+int64_t GetInt64(const KuduScanBatch::RowPtr& row, int idx) {
+  int64_t v;
+  CHECK_OK(row.GetInt64(idx, &v));
+  return v;
+}
+
+double GetDouble(const KuduScanBatch::RowPtr& row, int idx) {
+  double v;
+  CHECK_OK(row.GetDouble(idx, &v));
+  return v;
+}
+
+Slice GetString(const KuduScanBatch::RowPtr& row, int idx) {
+  Slice v;
+  CHECK_OK(row.GetString(idx, &v));
+  return v;
+}
+
+KuduPredicate* Compare(KuduTable* table, const char* col, KuduPredicate::ComparisonOp op,
+                       KuduValue* value) {
+  return table->NewComparisonPredicate(col, op, value);
+}
+
+KuduPredicate* InList(KuduTable* table, const char* col, const vector<string>& values) {
+  vector<KuduValue*> kudu_values;
+  for (const string& v : values) {
+    kudu_values.push_back(KuduValue::CopyString(v));
+  }
+  return table->NewInListPredicate(col, &kudu_values);
+}
+
+} // anonymous namespace
+
+TpchQueryRunner::TpchQueryRunner(client::sp::shared_ptr<KuduClient> client, int num_threads)
+    : client_(std::move(client)),
+      num_threads_(num_threads) {
+  CHECK_GT(num_threads, 0);
+}
+
+Status TpchQueryRunner::ParallelScan(const string& table_name,
+                                     const vector<string>& columns,
+                                     const PredicateBuilder& predicates,
+                                     const BatchCallback& callback,
+                                     TpchQueryResult* result) {
+  client::sp::shared_ptr<KuduTable> table;
+  RETURN_NOT_OK(client_->OpenTable(table_name, &table));
+  KuduScanTokenBuilder builder(table.get());
+  RETURN_NOT_OK(builder.SetProjectedColumnNames(columns));
+  for (KuduPredicate* pred : predicates(table.get())) {
+    RETURN_NOT_OK(builder.AddConjunctPredicate(pred));
+  }
+  vector<KuduScanToken*> tokens;
+  ElementDeleter deleter(&tokens);
+  RETURN_NOT_OK(builder.Build(&tokens));
+
+  AtomicInt<int32_t> next_token(0);
+  AtomicInt<int64_t> rows_scanned(0);
+  AtomicInt<int64_t> bytes_scanned(0);
+  vector<Status> statuses(num_threads_);
+  vector<scoped_refptr<Thread>> threads;
+  for (int i = 0; i < num_threads_; i++) {
+    scoped_refptr<Thread> thread;
+    RETURN_NOT_OK(Thread::Create("tpch", Substitute("scan-$0", i), [&, i]() {
+          statuses[i] = [&] () -> Status {
+            for (int t = next_token.Increment() - 1; t < tokens.size();
+                 t = next_token.Increment() - 1) {
+              KuduScanner* scanner_ptr;
+              RETURN_NOT_OK(tokens[t]->IntoKuduScanner(&scanner_ptr));
+              unique_ptr<KuduScanner> scanner(scanner_ptr);
+              RETURN_NOT_OK(scanner->Open());
+              KuduScanBatch batch;
+              while (scanner->HasMoreRows()) {
+                RETURN_NOT_OK(scanner->NextBatch(&batch));
+                rows_scanned.IncrementBy(batch.NumRows());
+                RETURN_NOT_OK(callback(i, batch));
+              }
+              const auto& metrics = scanner->GetResourceMetrics();
+              bytes_scanned.IncrementBy(metrics.GetMetric("cfile_cache_miss_bytes") +
+                                        metrics.GetMetric("cfile_cache_hit_bytes"));
+            }
+            return Status::OK();
+          }();
+        }, &thread));
+    threads.push_back(thread);
+  }
+  for (const auto& thread : threads) {
+    thread->Join();
+  }
+  for (const Status& s : statuses) {
+    RETURN_NOT_OK(s);
+  }
+  result->rows_scanned += rows_scanned.Load();
+  result->bytes_scanned += bytes_scanned.Load();
+  return Status::OK();
+}
+
+Status TpchQueryRunner::Run(int query, TpchQueryResult* result) {
+  *result = TpchQueryResult();
+  MonoTime start = MonoTime::Now();
+  switch (query) {
+    case 1: RETURN_NOT_OK(RunQ1(result)); break;
+    case 6: RETURN_NOT_OK(RunQ6(result)); break;
+    case 12: RETURN_NOT_OK(RunQ12(result)); break;
+    case 14: RETURN_NOT_OK(RunQ14(result)); break;
+    case 19: RETURN_NOT_OK(RunQ19(result)); break;
+    default:
+      return Status::NotSupported(Substitute("TPC-H query $0 is not implemented", query));
+  }
+  result->elapsed = MonoTime::Now() - start;
+  return Status::OK();
+}
+
+// select l_returnflag, l_linestatus, sum(l_quantity), sum(l_extendedprice),
+//   sum(l_extendedprice * (1 - l_discount)),
+//   sum(l_extendedprice * (1 - l_discount) * (1 + l_tax)),
+//   avg(l_quantity), avg(l_extendedprice), avg(l_discount), count(*)
+// from lineitem
+// where l_shipdate <= date '1998-12-01' - interval '90' day
+// group by l_returnflag, l_linestatus
+// order by l_returnflag, l_linestatus
+Status TpchQueryRunner::RunQ1(TpchQueryResult* result) {
+  struct Agg {
+    double sum_qty = 0;
+    double sum_base_price = 0;
+    double sum_disc_price = 0;
+    double sum_charge = 0;
+    double sum_disc = 0;
+    int64_t count = 0;
+  };
+  typedef map<pair<string, string>, Agg> AggMap;
+  vector<AggMap> aggs(num_threads_);
+  RETURN_NOT_OK(ParallelScan(
+      GetTpchTableName(TpchTable::kLineItem),
+      { kReturnFlagColName, kLineStatusColName, kQuantityColName, kExtendedPriceColName,
+        kDiscountColName, kTaxColName },
+      [] (KuduTable* t) -> vector<KuduPredicate*> {
+        return { Compare(t, kShipDateColName, KuduPredicate::LESS_EQUAL,
+                         KuduValue::CopyString("1998-09-02")) };
+      },
+      [&] (int thread_idx, const KuduScanBatch& batch) {
+        AggMap& m = aggs[thread_idx];
+        for (const KuduScanBatch::RowPtr& row : batch) {
+          Agg& agg = m[{ GetString(row, 0).ToString(), GetString(row, 1).ToString() }];
+          double price = GetDouble(row, 3);
+          double disc = GetDouble(row, 4);
+          agg.sum_qty += GetInt32(row, 2);
+          agg.sum_base_price += price;
+          agg.sum_disc_price += price * (1 - disc);
+          agg.sum_charge += price * (1 - disc) * (1 + GetDouble(row, 5));
+          agg.sum_disc += disc;
+          agg.count++;
+        }
+        return Status::OK();
+      },
+      result));
+
+  AggMap total;
+  for (const AggMap& m : aggs) {
+    for (const auto& entry : m) {
+      Agg& agg = total[entry.first];
+      agg.sum_qty += entry.second.sum_qty;
+      agg.sum_base_price += entry.second.sum_base_price;
+      agg.sum_disc_price += entry.second.sum_disc_price;
+      agg.sum_charge += entry.second.sum_charge;
+      agg.sum_disc += entry.second.sum_disc;
+      agg.count += entry.second.count;
+    }
+  }
+  for (const auto& entry : total) {
+    const Agg& agg = entry.second;
+    result->rows.push_back(StringPrintf(
+        "%s|%s|%.2f|%.2f|%.2f|%.2f|%.2f|%.2f|%.2f|%lld",
+        entry.first.first.c_str(), entry.first.second.c_str(), agg.sum_qty,
+        agg.sum_base_price, agg.sum_disc_price, agg.sum_charge, agg.sum_qty / agg.count,
+        agg.sum_base_price / agg.count, agg.sum_disc / agg.count,
+        static_cast<long long>(agg.count)));
+  }
+  return Status::OK();
+}
+
+// select sum(l_extendedprice * l_discount) as revenue
+// from lineitem
+// where l_shipdate >= date '1994-01-01'
+//   and l_shipdate < date '1994-01-01' + interval '1' year
+//   and l_discount between 0.06 - 0.01 and 0.06 + 0.01
+//   and l_quantity < 24
+Status TpchQueryRunner::RunQ6(TpchQueryResult* result) {
+  // Everything is pushed down.
+  vector<double> revenue(num_threads_);
+  RETURN_NOT_OK(ParallelScan(
+      GetTpchTableName(TpchTable::kLineItem),
+      { kExtendedPriceColName, kDiscountColName },
+      [] (KuduTable* t) -> vector<KuduPredicate*> {
+        return {
+          Compare(t, kShipDateColName, KuduPredicate::GREATER_EQUAL,
+                  KuduValue::CopyString("1994-01-01")),
+          Compare(t, kShipDateColName, KuduPredicate::LESS, KuduValue::CopyString("1995-01-01")),
+          Compare(t, kDiscountColName, KuduPredicate::GREATER_EQUAL, KuduValue::FromDouble(0.05)),
+          Compare(t, kDiscountColName, KuduPredicate::LESS_EQUAL, KuduValue::FromDouble(0.07)),
+          Compare(t, kQuantityColName, KuduPredicate::LESS, KuduValue::FromInt(24)),
+        };
+      },
+      [&] (int thread_idx, const KuduScanBatch& batch) {
+        for (const KuduScanBatch::RowPtr& row : batch) {
+          revenue[thread_idx] += GetDouble(row, 0) * GetDouble(row, 1);
+        }
+        return Status::OK();
+      },
+      result));
+  double total = 0;
+  for (double r : revenue) {
+    total += r;
+  }
+  result->rows.push_back(StringPrintf("%.2f", total));
+  return Status::OK();
+}
+
+// select l_shipmode,
+//   sum(case when o_orderpriority = '1-URGENT' or o_orderpriority = '2-HIGH'
+//       then 1 else 0 end) as high_line_count,
+//   sum(case when o_orderpriority <> '1-URGENT' and o_orderpriority <> '2-HIGH'
+//       then 1 else 0 end) as low_line_count
+// from orders, lineitem
+// where o_orderkey = l_orderkey
+//   and l_shipmode in ('MAIL', 'SHIP')
+//   and l_commitdate < l_receiptdate
+//   and l_shipdate < l_commitdate
+//   and l_receiptdate >= date '1994-01-01'
+//   and l_receiptdate < date '1994-01-01' + interval '1' year
+// group by l_shipmode
+// order by l_shipmode
+Status TpchQueryRunner::RunQ12(TpchQueryResult* result) {
+  const vector<string> kShipModes = { "MAIL", "SHIP" };
+
+  // The matching line items are counted per order and ship mode, and the
+  // orders are then scanned to split the counts by priority.
+  typedef unordered_map<int64_t, std::array<int64_t, 2>> CountMap;
+  vector<CountMap> counts(num_threads_);
+  RETURN_NOT_OK(ParallelScan(
+      GetTpchTableName(TpchTable::kLineItem),
+      { kOrderKeyColName, kShipModeColName, kShipDateColName, kCommitDateColName,
+        kReceiptDateColName },
+      [&] (KuduTable* t) -> vector<KuduPredicate*> {
+        return {
+          InList(t, kShipModeColName, kShipModes),
+          Compare(t, kReceiptDateColName, KuduPredicate::GREATER_EQUAL,
+                  KuduValue::CopyString("1994-01-01")),
+          Compare(t, kReceiptDateColName, KuduPredicate::LESS,
+                  KuduValue::CopyString("1995-01-01")),
+        };
+      },
+      [&] (int thread_idx, const KuduScanBatch& batch) {
+        for (const KuduScanBatch::RowPtr& row : batch) {
+          Slice commit_date = GetString(row, 3);
+          if (GetString(row, 2).compare(commit_date) >= 0 ||
+              commit_date.compare(GetString(row, 4)) >= 0) {
+            continue;
+          }
+          auto& c = counts[thread_idx][GetInt64(row, 0)];
+          c[GetString(row, 1) == kShipModes[0] ? 0 : 1]++;
+        }
+        return Status::OK();
+      },
+      result));
+
+  CountMap order_counts;
+  int64_t min_key = std::numeric_limits<int64_t>::max();
+  int64_t max_key = std::numeric_limits<int64_t>::min();
+  for (const CountMap& m : counts) {
+    for (const auto& entry : m) {
+      auto& c = order_counts[entry.first];
+      c[0] += entry.second[0];
+      c[1] += entry.second[1];
+      min_key = std::min(min_key, entry.first);
+      max_key = std::max(max_key, entry.first);
+    }
+  }
+
+  // [thread][ship mode][0 = high, 1 = low]
+  vector<std::array<std::array<int64_t, 2>, 2>> line_counts(num_threads_);
+  if (!order_counts.empty()) {
+    RETURN_NOT_OK(ParallelScan(
+        GetTpchTableName(TpchTable::kOrders),
+        { "o_orderkey", "o_orderpriority" },
+        [&] (KuduTable* t) -> vector<KuduPredicate*> {
+          return {
+            Compare(t, "o_orderkey", KuduPredicate::GREATER_EQUAL, KuduValue::FromInt(min_key)),
+            Compare(t, "o_orderkey", KuduPredicate::LESS_EQUAL, KuduValue::FromInt(max_key)),
+          };
+        },
+        [&] (int thread_idx, const KuduScanBatch& batch) {
+          for (const KuduScanBatch::RowPtr& row : batch) {
+            const auto* c = FindOrNull(order_counts, GetInt64(row, 0));
+            if (c == nullptr) continue;
+            Slice priority = GetString(row, 1);
+            int high = (priority == "1-URGENT" || priority == "2-HIGH") ? 0 : 1;
+            for (int mode = 0; mode < 2; mode++) {
+              line_counts[thread_idx][mode][high] += (*c)[mode];
+            }
+          }
+          return Status::OK();
+        },
+        result));
+  }
+
+  for (int mode = 0; mode < 2; mode++) {
+    int64_t high = 0;
+    int64_t low = 0;
+    for (const auto& c : line_counts) {
+      high += c[mode][0];
+      low += c[mode][1];
+    }
+    if (high + low == 0) continue;
+    result->rows.push_back(Substitute("$0|$1|$2", kShipModes[mode], high, low));
+  }
+  return Status::OK();
+}
+
+// select 100.00 * sum(case when p_type like 'PROMO%'
+//                     then l_extendedprice * (1 - l_discount) else 0 end) /
+//        sum(l_extendedprice * (1 - l_discount)) as promo_revenue
+// from lineitem, part
+// where l_partkey = p_partkey
+//   and l_shipdate >= date '1995-09-01'
+//   and l_shipdate < date '1995-09-01' + interval '1' month
+Status TpchQueryRunner::RunQ14(TpchQueryResult* result) {
+  vector<unordered_set<int32_t>> promo(num_threads_);
+  RETURN_NOT_OK(ParallelScan(
+      GetTpchTableName(TpchTable::kPart),
+      { "p_partkey", "p_type" },
+      [] (KuduTable* t) -> vector<KuduPredicate*> { return {}; },
+      [&] (int thread_idx, const KuduScanBatch& batch) {
+        for (const KuduScanBatch::RowPtr& row : batch) {
+          if (GetString(row, 1).starts_with("PROMO")) {
+            promo[thread_idx].insert(GetInt32(row, 0));
+          }
+        }
+        return Status::OK();
+      },
+      result));
+  unordered_set<int32_t> promo_parts;
+  for (const auto& s : promo) {
+    promo_parts.insert(s.begin(), s.end());
+  }
+
+  vector<pair<double, double>> revenue(num_threads_);
+  RETURN_NOT_OK(ParallelScan(
+      GetTpchTableName(TpchTable::kLineItem),
+      { kPartKeyColName, kExtendedPriceColName, kDiscountColName },
+      [] (KuduTable* t) -> vector<KuduPredicate*> {
+        return {
+          Compare(t, kShipDateColName, KuduPredicate::GREATER_EQUAL,
+                  KuduValue::CopyString("1995-09-01")),
+          Compare(t, kShipDateColName, KuduPredicate::LESS, KuduValue::CopyString("1995-10-01")),
+        };
+      },
+      [&] (int thread_idx, const KuduScanBatch& batch) {
+        for (const KuduScanBatch::RowPtr& row : batch) {
+          double r = GetDouble(row, 1) * (1 - GetDouble(row, 2));
+          if (ContainsKey(promo_parts, GetInt32(row, 0))) {
+            revenue[thread_idx].first += r;
+          }
+          revenue[thread_idx].second += r;
+        }
+        return Status::OK();
+      },
+      result));
+  double promo_revenue = 0;
+  double total_revenue = 0;
+  for (const auto& r : revenue) {
+    promo_revenue += r.first;
+    total_revenue += r.second;
+  }
+  result->rows.push_back(StringPrintf(
+      "%.2f", total_revenue > 0 ? 100 * promo_revenue / total_revenue : 0));
+  return Status::OK();
+}
+
+// select sum(l_extendedprice * (1 - l_discount)) as revenue
+// from lineitem, part
+// where (p_partkey = l_partkey and p_brand = 'Brand#12'
+//        and p_container in ('SM CASE', 'SM BOX', 'SM PACK', 'SM PKG')
+//        and l_quantity >= 1 and l_quantity <= 1 + 10
+//        and p_size between 1 and 5
+//        and l_shipmode in ('AIR', 'AIR REG')
+//        and l_shipinstruct = 'DELIVER IN PERSON')
+//    or (... p_brand = 'Brand#23'
+//        and p_container in ('MED BAG', 'MED BOX', 'MED PKG', 'MED PACK')
+//        and l_quantity >= 10 and l_quantity <= 10 + 10
+//        and p_size between 1 and 10 ...)
+//    or (... p_brand = 'Brand#34'
+//        and p_container in ('LG CASE', 'LG BOX', 'LG PACK', 'LG PKG')
+//        and l_quantity >= 20 and l_quantity <= 20 + 10
+//        and p_size between 1 and 15 ...)
+Status TpchQueryRunner::RunQ19(TpchQueryResult* result) {
+  struct Clause {
+    string brand;
+    unordered_set<string> containers;
+    int32_t max_size;
+    int32_t min_quantity;
+  };
+  const Clause kClauses[] = {
+    { "Brand#12", { "SM CASE", "SM BOX", "SM PACK", "SM PKG" }, 5, 1 },
+    { "Brand#23", { "MED BAG", "MED BOX", "MED PKG", "MED PACK" }, 10, 10 },
+    { "Brand#34", { "LG CASE", "LG BOX", "LG PACK", "LG PKG" }, 15, 20 },
+  };
+
+  // The parts are mapped to the only clause they can satisfy, since the
+  // brands of the clauses differ. The predicates pushed down to each scan
+  // are the union of those of the clauses.
+  vector<unordered_map<int32_t, int>> part_clauses(num_threads_);
+  RETURN_NOT_OK(ParallelScan(
+      GetTpchTableName(TpchTable::kPart),
+      { "p_partkey", "p_brand", "p_container", "p_size" },
+      [&] (KuduTable* t) -> vector<KuduPredicate*> {
+        return {
+          InList(t, "p_brand", { kClauses[0].brand, kClauses[1].brand, kClauses[2].brand }),
+          Compare(t, "p_size", KuduPredicate::GREATER_EQUAL, KuduValue::FromInt(1)),
+          Compare(t, "p_size", KuduPredicate::LESS_EQUAL, KuduValue::FromInt(15)),
+        };
+      },
+      [&] (int thread_idx, const KuduScanBatch& batch) {
+        for (const KuduScanBatch::RowPtr& row : batch) {
+          Slice brand = GetString(row, 1);
+          string container = GetString(row, 2).ToString();
+          int32_t size = GetInt32(row, 3);
+          for (int c = 0; c < arraysize(kClauses); c++) {
+            const Clause& clause = kClauses[c];
+            if (brand == clause.brand && size <= clause.max_size &&
+                ContainsKey(clause.containers, container)) {
+              part_clauses[thread_idx][GetInt32(row, 0)] = c;
+            }
+          }
+        }
+        return Status::OK();
+      },
+      result));
+  unordered_map<int32_t, int> parts;
+  for (const auto& m : part_clauses) {
+    parts.insert(m.begin(), m.end());
+  }
+
+  vector<double> revenue(num_threads_);
+  if (!parts.empty()) {
+    RETURN_NOT_OK(ParallelScan(
+        GetTpchTableName(TpchTable::kLineItem),
+        { kPartKeyColName, kQuantityColName, kExtendedPriceColName, kDiscountColName },
+        [&] (KuduTable* t) -> vector<KuduPredicate*> {
+          return {
+            InList(t, kShipModeColName, { "AIR", "AIR REG" }),
+            Compare(t, kShipInstructColName, KuduPredicate::EQUAL,
+                    KuduValue::CopyString("DELIVER IN PERSON")),
+            Compare(t, kQuantityColName, KuduPredicate::GREATER_EQUAL, KuduValue::FromInt(1)),
+            Compare(t, kQuantityColName, KuduPredicate::LESS_EQUAL, KuduValue::FromInt(30)),
+          };
+        },
+        [&] (int thread_idx, const KuduScanBatch& batch) {
+          for (const KuduScanBatch::RowPtr& row : batch) {
+            const int* c = FindOrNull(parts, GetInt32(row, 0));
+            if (c == nullptr) continue;
+            int32_t quantity = GetInt32(row, 1);
+            int32_t min_quantity = kClauses[*c].min_quantity;
+            if (quantity >= min_quantity && quantity <= min_quantity + 10) {
+              revenue[thread_idx] += GetDouble(row, 2) * (1 - GetDouble(row, 3));
+            }
+          }
+          return Status::OK();
+        },
+        result));
+  }
+  double total = 0;
+  for (double r : revenue) {
+    total += r;
+  }
+  result->rows.push_back(StringPrintf("%.2f", total));
+  return Status::OK();
+}
+
+} // namespace tpch
+} // namespace kudu
@@ -0,0 +1,102 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TPCH_TPCH_QUERIES_H
+#define KUDU_TPCH_TPCH_QUERIES_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "kudu/client/shared_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+namespace client {
+class KuduClient;
+class KuduPredicate;
+class KuduScanBatch;
+class KuduTable;
+} // namespace client
+
+namespace tpch {
+
+// The TPC-H queries which are run by TpchQueryRunner.
+static const int kTpchQueries[] = { 1, 6, 12, 14, 19 };
+
+struct TpchQueryResult {
+  // The rows of the result, formatted, in the order of the query.
+  std::vector<std::string> rows;
+
+  // The totals over all of the scans of the query.
+  int64_t rows_scanned = 0;
+  int64_t bytes_scanned = 0;
+
+  MonoDelta elapsed;
+};
+
+// Runs the scan-heavy TPC-H queries against the TPC-H tables, with the
+// default substitution parameters of the specification.
+//
+// Each query scans its tables in parallel through scan tokens, pushing down
+// its projections and whatever predicates Kudu can evaluate. The rest, such
+// as comparisons between columns and joins, are evaluated by the client,
+// joins by building a hash table of the smaller side.
+class TpchQueryRunner {
+ public:
+  TpchQueryRunner(client::sp::shared_ptr<client::KuduClient> client, int num_threads);
+
+  // Runs query number 'query', one of kTpchQueries.
+  Status Run(int query, TpchQueryResult* result);
+
+ private:
+  // Returns the predicates of a scan, which are built once per scan since
+  // the scan takes ownership of them.
+  typedef std::function<std::vector<client::KuduPredicate*>(client::KuduTable*)>
+      PredicateBuilder;
+
+  // Processes a batch of rows in the scanning thread numbered 'thread_idx'.
+  typedef std::function<Status(int thread_idx, const client::KuduScanBatch& batch)>
+      BatchCallback;
+
+  // Scans 'table_name' with 'num_threads_' threads, projecting 'columns'
+  // and calling 'callback' with every batch of rows, and adds the rows and
+  // bytes scanned to 'result'.
+  Status ParallelScan(const std::string& table_name,
+                      const std::vector<std::string>& columns,
+                      const PredicateBuilder& predicates,
+                      const BatchCallback& callback,
+                      TpchQueryResult* result);
+
+  Status RunQ1(TpchQueryResult* result);
+  Status RunQ6(TpchQueryResult* result);
+  Status RunQ12(TpchQueryResult* result);
+  Status RunQ14(TpchQueryResult* result);
+  Status RunQ19(TpchQueryResult* result);
+
+  const client::sp::shared_ptr<client::KuduClient> client_;
+  const int num_threads_;
+
+  DISALLOW_COPY_AND_ASSIGN(TpchQueryRunner);
+};
+
+} // namespace tpch
+} // namespace kudu
+#endif
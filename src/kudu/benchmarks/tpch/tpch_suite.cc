@@ -0,0 +1,141 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Loads the eight TPC-H tables from the files generated by dbgen, unless
+// they're already loaded, then runs the scan-heavy TPC-H queries and reports
+// the time each took and the bytes it scanned.
+//
+// Usage:
+//   dbgen -s 10 && tpch_suite -tpch_data_dir=. -tpch_scale_factor=10
+//                             -use_mini_cluster=false -master_address=master:7051
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "kudu/benchmarks/tpch/tpch-schemas.h"
+#include "kudu/benchmarks/tpch/tpch_loader.h"
+#include "kudu/benchmarks/tpch/tpch_queries.h"
+#include "kudu/client/client.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/integration-tests/mini_cluster.h"
+#include "kudu/master/mini_master.h"
+#include "kudu/util/env.h"
+#include "kudu/util/flags.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/stopwatch.h"
+
+DEFINE_string(tpch_data_dir, ".",
+              "The directory of the '|' separated files generated by dbgen, such as "
+              "lineitem.tbl.");
+DEFINE_double(tpch_scale_factor, 1,
+              "The scale factor of the data, which sizes the range partitions of the tables.");
+DEFINE_string(tpch_queries, "1,6,12,14,19", "Comma-separated numbers of the queries to run.");
+DEFINE_int32(tpch_num_query_iterations, 1, "Number of times each query is run.");
+DEFINE_int32(tpch_num_scan_threads, 8, "Number of threads scanning the tables of a query.");
+DEFINE_int32(tpch_num_tablets, 8, "Number of tablets of each of the large tables.");
+DEFINE_bool(use_mini_cluster, true,
+            "Create a mini cluster for the work to be performed against.");
+DEFINE_string(mini_cluster_base_dir, "/tmp/tpch_suite",
+              "If using a mini cluster, directory for master/ts data.");
+DEFINE_string(master_address, "localhost",
+              "Address of master for the cluster to operate on");
+
+using kudu::client::KuduClient;
+using kudu::client::KuduClientBuilder;
+using kudu::tpch::GetTpchTableName;
+using kudu::tpch::TpchLoader;
+using kudu::tpch::TpchQueryResult;
+using kudu::tpch::TpchQueryRunner;
+using kudu::tpch::TpchTable;
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+int main(int argc, char** argv) {
+  kudu::ParseCommandLineFlags(&argc, &argv, true);
+  kudu::InitGoogleLoggingSafe(argv[0]);
+
+  vector<int> queries;
+  vector<string> query_strs = strings::Split(FLAGS_tpch_queries, ",", strings::SkipEmpty());
+  for (const string& q : query_strs) {
+    int query;
+    CHECK(SimpleAtoi(q.c_str(), &query)) << "bad query number: " << q;
+    queries.push_back(query);
+  }
+
+  gscoped_ptr<kudu::MiniCluster> cluster;
+  string master_address;
+  if (FLAGS_use_mini_cluster) {
+    kudu::Status s = kudu::Env::Default()->CreateDir(FLAGS_mini_cluster_base_dir);
+    CHECK(s.IsAlreadyPresent() || s.ok()) << s.ToString();
+    kudu::MiniClusterOptions options;
+    options.data_root = FLAGS_mini_cluster_base_dir;
+    cluster.reset(new kudu::MiniCluster(kudu::Env::Default(), options));
+    CHECK_OK(cluster->StartSync());
+    master_address = cluster->mini_master()->bound_rpc_addr_str();
+  } else {
+    master_address = FLAGS_master_address;
+  }
+
+  kudu::client::sp::shared_ptr<KuduClient> client;
+  CHECK_OK(KuduClientBuilder()
+           .add_master_server_addr(master_address)
+           .Build(&client));
+
+  TpchLoader loader(client, FLAGS_tpch_scale_factor, FLAGS_tpch_num_tablets);
+  for (TpchTable table : kudu::tpch::kAllTpchTables) {
+    string path = Substitute("$0/$1.tbl", FLAGS_tpch_data_dir, GetTpchTableName(table));
+    int64_t num_rows = 0;
+    kudu::Status s;
+    LOG_TIMING(INFO, Substitute("loading $0", path)) {
+      s = loader.Load(table, path, &num_rows);
+    }
+    if (s.IsAlreadyPresent()) {
+      LOG(INFO) << GetTpchTableName(table) << " is already loaded";
+      continue;
+    }
+    CHECK_OK(s);
+    LOG(INFO) << Substitute("Loaded $0 rows into $1", num_rows, GetTpchTableName(table));
+  }
+
+  TpchQueryRunner runner(client, FLAGS_tpch_num_scan_threads);
+  std::cout << Substitute("Scale factor $0", FLAGS_tpch_scale_factor) << std::endl;
+  for (int query : queries) {
+    for (int i = 0; i < FLAGS_tpch_num_query_iterations; i++) {
+      TpchQueryResult result;
+      CHECK_OK(runner.Run(query, &result));
+      std::cout << Substitute("Q$0: $1 ms, $2 rows scanned, $3 bytes scanned",
+                              query, result.elapsed.ToMilliseconds(),
+                              result.rows_scanned, result.bytes_scanned) << std::endl;
+      if (i == 0) {
+        for (const string& row : result.rows) {
+          std::cout << "  " << row << std::endl;
+        }
+      }
+    }
+  }
+
+  if (cluster) {
+    cluster->Shutdown();
+  }
+  return 0;
+}
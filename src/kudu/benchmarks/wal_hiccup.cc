@@ -15,13 +15,23 @@
 // specific language governing permissions and limitations
 // under the License.
 
+// Measures the latency of fake WAL appends while files are written and synced
+// in the background, under each combination of the ways of writing back the
+// files, and for each of the ways of syncing the WALs.
+
 #include <algorithm>
+#include <string>
 #include <vector>
 
 #include <fcntl.h>
+#include <linux/magic.h>
+#include <sys/vfs.h>
+#include <unistd.h>
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
+#include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/walltime.h"
@@ -53,49 +63,169 @@ DEFINE_bool(fdatasync_at_end, true,
             "fdatasync each file after writing all files");
 
 DEFINE_bool(page_align_wal_writes, false,
-            "write to the fake WAL with exactly 4KB writes to never cross pages");
+            "write to the fake WAL with writes of exactly --wal_batch_size_bytes, "
+            "which are page-aligned when it's a multiple of 4KB");
+
+DEFINE_int32(num_wals, 1,
+             "number of WALs appended to concurrently, as by the tablets of a "
+             "tablet server");
+DEFINE_int32(wal_batch_size_bytes, 4096,
+             "size of each WAL append, i.e. of each group-committed batch of "
+             "operations");
+DEFINE_int32(wal_segment_size_mb, 64,
+             "size of the WAL segments, after which a WAL rolls to a new one; see "
+             "--log_segment_size_mb");
+DEFINE_bool(wal_preallocate_segments, true,
+            "preallocate each WAL segment before writing to it; see "
+            "--log_preallocate_segments");
+DEFINE_bool(wal_async_preallocate_segments, true,
+            "preallocate the next WAL segment in the background rather than when "
+            "rolling to it; see --log_async_preallocate_segments");
+DEFINE_string(wal_sync_strategies, "fdatasync",
+              "comma-separated list of the ways of making the WAL appends durable "
+              "to compare: 'fdatasync', 'sync_file_range' (SYNC_FILE_RANGE_WAIT_BEFORE, "
+              "_WRITE and _WAIT_AFTER on the appended range, which doesn't flush "
+              "the disk's write cache or the file's metadata) and 'o_dsync' "
+              "(opening the segments with O_DSYNC)");
 
 using std::string;
+using std::vector;
 
 namespace kudu {
 
+namespace {
+
+enum SyncStrategy {
+  FDATASYNC,
+  SYNC_FILE_RANGE,
+  O_DSYNC_WRITES,
+  kNumSyncStrategies
+};
+
+const char* const kSyncStrategyNames[] = { "fdatasync", "sync_file_range", "o_dsync" };
+
+// Returns the name of the filesystem holding 'path', so that the results of
+// runs on different filesystems can be told apart.
+string FilesystemName(const string& path) {
+  struct statfs buf;
+  PCHECK(statfs(path.c_str(), &buf) == 0) << "statfs() failed";
+  switch (buf.f_type) {
+    case EXT4_SUPER_MAGIC: return "ext2/3/4";
+    case XFS_SUPER_MAGIC: return "xfs";
+    case BTRFS_SUPER_MAGIC: return "btrfs";
+    case TMPFS_MAGIC: return "tmpfs";
+    default: return StringPrintf("unknown (magic 0x%llx)",
+                                 static_cast<unsigned long long>(buf.f_type)); // NOLINT(*)
+  }
+}
+
+} // anonymous namespace
+
 class WalHiccupBenchmarker {
  public:
   WalHiccupBenchmarker()
     : finished_(1),
-      cur_histo_(NULL) {
+      cur_histo_(NULL),
+      sync_strategy_(FDATASYNC) {
   }
   ~WalHiccupBenchmarker() {
     STLDeleteElements(&wal_histos_);
   }
 
-  void WALThread();
+  void WALThread(int wal_idx);
   void PrintConfig();
   void RunOnce();
   void Run();
  protected:
+  // Opens segment 'seg_idx' of WAL 'wal_idx', preallocating it if configured.
+  int OpenSegment(int wal_idx, int seg_idx);
+
   CountDownLatch finished_;
   std::vector<HdrHistogram*> wal_histos_;
   HdrHistogram* cur_histo_;
+  SyncStrategy sync_strategy_;
 };
 
-
-void WalHiccupBenchmarker::WALThread() {
-  string name = "wal";
+string SegmentPath(int wal_idx, int seg_idx) {
+  string name = strings::Substitute("wal-$0-$1", wal_idx, seg_idx);
   if (!FLAGS_file_path.empty()) {
     name = JoinPathSegments(FLAGS_file_path, name);
   }
-  int fd = open(name.c_str(), O_WRONLY | O_TRUNC | O_CREAT, 0666);
+  return name;
+}
+
+int WalHiccupBenchmarker::OpenSegment(int wal_idx, int seg_idx) {
+  int flags = O_WRONLY | O_TRUNC | O_CREAT;
+  if (sync_strategy_ == O_DSYNC_WRITES) {
+    flags |= O_DSYNC;
+  }
+  int fd = open(SegmentPath(wal_idx, seg_idx).c_str(), flags, 0666);
   PCHECK(fd >= 0) << "open() failed";
-  char buf[4096];
-  memset(buf, 0xFF, sizeof(buf));
+  if (FLAGS_wal_preallocate_segments) {
+    PCHECK(fallocate(fd, 0, 0, FLAGS_wal_segment_size_mb * 1024LL * 1024) == 0)
+        << "fallocate() failed";
+  }
+  return fd;
+}
+
+void WalHiccupBenchmarker::WALThread(int wal_idx) {
+  const size_t num_bytes = FLAGS_page_align_wal_writes ?
+      FLAGS_wal_batch_size_bytes : FLAGS_wal_batch_size_bytes - 1;
+  const off_t segment_size = FLAGS_wal_segment_size_mb * 1024LL * 1024;
+  const bool async_preallocate =
+      FLAGS_wal_preallocate_segments && FLAGS_wal_async_preallocate_segments;
+  vector<char> buf(FLAGS_wal_batch_size_bytes, 0xFF);
+
+  int seg_idx = 0;
+  int fd = OpenSegment(wal_idx, seg_idx);
+  off_t offset = 0;
+
+  // With asynchronous preallocation, the next segment is always being
+  // prepared while the current one is written to.
+  int next_fd = -1;
+  scoped_refptr<Thread> preallocator;
+  auto start_preallocating = [&]() {
+    CHECK_OK(Thread::Create("test", "wal-prealloc", [this, wal_idx, seg_idx, &next_fd]() {
+          next_fd = OpenSegment(wal_idx, seg_idx + 1);
+        }, &preallocator));
+  };
+  if (async_preallocate) {
+    start_preallocating();
+  }
+
   const MonoDelta sleepDelta = MonoDelta::FromMicroseconds(FLAGS_wal_interval_us);
   while (finished_.count() > 0) {
     SleepFor(sleepDelta);
     MicrosecondsInt64 st = GetCurrentTimeMicros();
-    size_t num_bytes = FLAGS_page_align_wal_writes ? sizeof(buf) : sizeof(buf) - 1;
-    PCHECK(write(fd, buf, num_bytes) == num_bytes);
-    PCHECK(fdatasync(fd) == 0);
+    // Rolling is part of the latency of the append which doesn't fit.
+    if (offset + num_bytes > segment_size) {
+      PCHECK(close(fd) == 0);
+      PCHECK(unlink(SegmentPath(wal_idx, seg_idx).c_str()) == 0);
+      if (async_preallocate) {
+        preallocator->Join();
+        fd = next_fd;
+        seg_idx++;
+        start_preallocating();
+      } else {
+        fd = OpenSegment(wal_idx, ++seg_idx);
+      }
+      offset = 0;
+    }
+    PCHECK(pwrite(fd, buf.data(), num_bytes, offset) == num_bytes);
+    switch (sync_strategy_) {
+      case FDATASYNC:
+        PCHECK(fdatasync(fd) == 0);
+        break;
+      case SYNC_FILE_RANGE:
+        PCHECK(sync_file_range(fd, offset, num_bytes,
+                               SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                               SYNC_FILE_RANGE_WAIT_AFTER) == 0);
+        break;
+      default:
+        // The write itself was synchronous.
+        break;
+    }
+    offset += num_bytes;
     MicrosecondsInt64 et = GetCurrentTimeMicros();
     MicrosecondsInt64 value = et - st;
     cur_histo_->IncrementWithExpectedInterval(value, FLAGS_wal_interval_us);
@@ -103,6 +233,14 @@ void WalHiccupBenchmarker::WALThread() {
       LOG(WARNING) << "slow wal write: " <<  value << "us";
     }
   }
+
+  if (async_preallocate) {
+    preallocator->Join();
+    PCHECK(close(next_fd) == 0);
+    PCHECK(unlink(SegmentPath(wal_idx, seg_idx + 1).c_str()) == 0);
+  }
+  PCHECK(close(fd) == 0);
+  PCHECK(unlink(SegmentPath(wal_idx, seg_idx).c_str()) == 0);
 }
 
 void WriteFile(const string& name,
@@ -151,7 +289,20 @@ void SetFlags(uint32_t setup) {
 }
 
 void WalHiccupBenchmarker::Run() {
-  int num_setups = 1 << 7;
+  vector<SyncStrategy> strategies;
+  vector<string> strategy_names = strings::Split(FLAGS_wal_sync_strategies, ",",
+                                                 strings::SkipEmpty());
+  for (const string& name : strategy_names) {
+    auto it = std::find(std::begin(kSyncStrategyNames), std::end(kSyncStrategyNames), name);
+    CHECK(it != std::end(kSyncStrategyNames)) << "unknown WAL sync strategy: " << name;
+    strategies.push_back(static_cast<SyncStrategy>(it - std::begin(kSyncStrategyNames)));
+  }
+  CHECK(!strategies.empty()) << "no WAL sync strategy given";
+  LOG(INFO) << "Filesystem: " << FilesystemName(FLAGS_file_path.empty() ? "." : FLAGS_file_path);
+
+  // Each setup is a combination of the flags set by SetFlags() and of a
+  // strategy, at index (flags * kNumSyncStrategies + strategy).
+  int num_setups = (1 << 7) * kNumSyncStrategies;
   wal_histos_.resize(num_setups);
 
   vector<double> total_time;
@@ -159,8 +310,10 @@ void WalHiccupBenchmarker::Run() {
 
   vector<uint32_t> setups;
   setups.reserve(num_setups);
-  for (uint32_t setup = 0; setup < num_setups; setup++) {
-    setups.push_back(setup);
+  for (uint32_t setup = 0; setup < (1 << 7); setup++) {
+    for (SyncStrategy strategy : strategies) {
+      setups.push_back(setup * kNumSyncStrategies + strategy);
+    }
   }
 
   for (int round = 0; round < FLAGS_num_rounds; round++) {
@@ -168,7 +321,8 @@ void WalHiccupBenchmarker::Run() {
     std::random_shuffle(setups.begin(), setups.end());
 
     for (uint32_t setup : setups) {
-      SetFlags(setup);
+      SetFlags(setup / kNumSyncStrategies);
+      sync_strategy_ = static_cast<SyncStrategy>(setup % kNumSyncStrategies);
       if (!FLAGS_fdatasync_each_file && !FLAGS_fdatasync_at_end) {
         // Skip non-durable configuration
         continue;
@@ -196,8 +350,10 @@ void WalHiccupBenchmarker::Run() {
     LOG(INFO) << "----------------------------------------------------------------------";
   }
 
+  std::sort(setups.begin(), setups.end());
   for (uint32_t setup : setups) {
-    SetFlags(setup);
+    SetFlags(setup / kNumSyncStrategies);
+    sync_strategy_ = static_cast<SyncStrategy>(setup % kNumSyncStrategies);
     if (!FLAGS_fdatasync_each_file && !FLAGS_fdatasync_at_end) {
       // Skip non-durable configuration
       continue;
@@ -215,6 +371,7 @@ void WalHiccupBenchmarker::Run() {
     LOG(INFO) << "throughput: " << throughput;
     LOG(INFO) << "p95: " << cur_histo_->ValueAtPercentile(95.0);
     LOG(INFO) << "p99: " << cur_histo_->ValueAtPercentile(99.0);
+    LOG(INFO) << "p99.9: " << cur_histo_->ValueAtPercentile(99.9);
     LOG(INFO) << "p99.99: " << cur_histo_->ValueAtPercentile(99.99);
     LOG(INFO) << "max: " << cur_histo_->MaxValue();
     LOG(INFO) << "----------------------------------------------------------------------";
@@ -230,13 +387,22 @@ void WalHiccupBenchmarker::PrintConfig() {
   LOG(INFO) << "await_writeback_at_end: " << FLAGS_await_writeback_at_end;
   LOG(INFO) << "fdatasync_at_end: " << FLAGS_fdatasync_at_end;
   LOG(INFO) << "page_align_wal_writes: " << FLAGS_page_align_wal_writes;
+  LOG(INFO) << "wal_sync_strategy: " << kSyncStrategyNames[sync_strategy_];
+  LOG(INFO) << "num_wals: " << FLAGS_num_wals;
+  LOG(INFO) << "wal_batch_size_bytes: " << FLAGS_wal_batch_size_bytes;
+  LOG(INFO) << "wal_preallocate_segments: " << FLAGS_wal_preallocate_segments;
+  LOG(INFO) << "wal_async_preallocate_segments: " << FLAGS_wal_async_preallocate_segments;
 }
 
 void WalHiccupBenchmarker::RunOnce() {
   finished_.Reset(1);
-  scoped_refptr<Thread> thr;
-  CHECK_OK(Thread::Create("test", "wal", &WalHiccupBenchmarker::WALThread, this, &thr));
-
+  vector<scoped_refptr<Thread>> wal_threads;
+  for (int i = 0; i < FLAGS_num_wals; i++) {
+    scoped_refptr<Thread> thr;
+    CHECK_OK(Thread::Create("test", strings::Substitute("wal-$0", i),
+                            &WalHiccupBenchmarker::WALThread, this, i, &thr));
+    wal_threads.emplace_back(std::move(thr));
+  }
 
   int fds[FLAGS_num_files];
   for (int i = 0; i < FLAGS_num_files; i++) {
@@ -272,7 +438,9 @@ void WalHiccupBenchmarker::RunOnce() {
 
   LOG(INFO) << "Done closing...";
   finished_.CountDown();
-  thr->Join();
+  for (const auto& thr : wal_threads) {
+    thr->Join();
+  }
 }
 
 } // namespace kudu
@@ -0,0 +1,125 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Runs one of the YCSB core workloads, A through F, against an external
+// mini cluster it starts or against the cluster of --master_address.
+//
+// Usage:
+//   ycsb -ycsb_workload=a -ycsb_record_count=1000000
+//        -ycsb_operation_count=1000000 -ycsb_threads=16
+//        -master_address=master1:7051,master2:7051
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <glog/logging.h>
+
+#include "kudu/benchmarks/ycsb/ycsb_workload.h"
+#include "kudu/client/client.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/integration-tests/external_mini_cluster.h"
+#include "kudu/util/flags.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/net/sockaddr.h"
+#include "kudu/util/stopwatch.h"
+
+DEFINE_string(ycsb_workload, "a", "The YCSB core workload to run, from 'a' to 'f'.");
+DEFINE_string(ycsb_request_distribution, "",
+              "Overrides the request distribution of the workload, one of 'uniform', "
+              "'zipfian' or 'latest'.");
+DEFINE_int64(ycsb_record_count, 100000, "The number of records to load.");
+DEFINE_int64(ycsb_operation_count, 100000, "The number of operations to run.");
+DEFINE_int32(ycsb_threads, 16, "The number of client threads.");
+DEFINE_int32(ycsb_num_tablets, 8, "The number of tablets of the table, if it's created.");
+DEFINE_int32(ycsb_num_replicas, 1, "The number of replicas of the table, if it's created.");
+DEFINE_int32(ycsb_field_length, 100, "The length of each of the 10 fields of a record.");
+DEFINE_int32(ycsb_max_scan_length, 100, "The maximum number of records read by a scan.");
+DEFINE_int32(ycsb_stats_interval_ms, 1000,
+             "How often the throughput of the workload is sampled.");
+DEFINE_bool(ycsb_load, true, "Whether to load the records before running the workload.");
+DEFINE_string(table_name, "usertable", "The name of the table.");
+DEFINE_bool(use_external_mini_cluster, true,
+            "Whether to run against an external mini cluster rather than --master_address.");
+DEFINE_int32(num_tablet_servers, 3,
+             "The number of tablet servers of the external mini cluster.");
+DEFINE_string(mini_cluster_base_dir, "/tmp/ycsb",
+              "The directory of the data of the external mini cluster.");
+DEFINE_string(master_address, "localhost",
+              "Comma-separated addresses of the masters of the cluster to run against.");
+
+using kudu::client::KuduClient;
+using kudu::client::KuduClientBuilder;
+using kudu::ycsb::ParseWorkloadSpec;
+using kudu::ycsb::WorkloadSpec;
+using kudu::ycsb::YcsbOptions;
+using kudu::ycsb::YcsbWorkload;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+int main(int argc, char** argv) {
+  kudu::ParseCommandLineFlags(&argc, &argv, true);
+  kudu::InitGoogleLoggingSafe(argv[0]);
+
+  WorkloadSpec spec;
+  CHECK_OK(ParseWorkloadSpec(FLAGS_ycsb_workload, FLAGS_ycsb_request_distribution, &spec));
+
+  unique_ptr<kudu::ExternalMiniCluster> cluster;
+  vector<string> master_addrs;
+  if (FLAGS_use_external_mini_cluster) {
+    kudu::ExternalMiniClusterOptions opts;
+    opts.num_tablet_servers = FLAGS_num_tablet_servers;
+    opts.data_root = FLAGS_mini_cluster_base_dir;
+    cluster.reset(new kudu::ExternalMiniCluster(opts));
+    CHECK_OK(cluster->Start());
+    master_addrs.push_back(cluster->master()->bound_rpc_addr().ToString());
+  } else {
+    master_addrs = strings::Split(FLAGS_master_address, ",", strings::SkipEmpty());
+  }
+
+  kudu::client::sp::shared_ptr<KuduClient> client;
+  CHECK_OK(KuduClientBuilder()
+           .master_server_addrs(master_addrs)
+           .Build(&client));
+
+  YcsbOptions options;
+  options.table_name = FLAGS_table_name;
+  options.record_count = FLAGS_ycsb_record_count;
+  options.operation_count = FLAGS_ycsb_operation_count;
+  options.num_threads = FLAGS_ycsb_threads;
+  options.num_tablets = FLAGS_ycsb_num_tablets;
+  options.num_replicas = FLAGS_ycsb_num_replicas;
+  options.field_length = FLAGS_ycsb_field_length;
+  options.max_scan_length = FLAGS_ycsb_max_scan_length;
+  options.stats_interval_ms = FLAGS_ycsb_stats_interval_ms;
+
+  YcsbWorkload workload(client, options, spec);
+  if (FLAGS_ycsb_load) {
+    LOG_TIMING(INFO, "loading the YCSB records") {
+      CHECK_OK(workload.Load());
+    }
+  }
+  LOG_TIMING(INFO, "running YCSB workload " + FLAGS_ycsb_workload) {
+    CHECK_OK(workload.Run());
+  }
+  workload.PrintReport(&std::cout);
+
+  if (cluster) {
+    cluster->Shutdown();
+  }
+  return 0;
+}
@@ -0,0 +1,149 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "kudu/benchmarks/ycsb/ycsb_workload.h"
+#include "kudu/client/client.h"
+#include "kudu/integration-tests/mini_cluster.h"
+#include "kudu/master/mini_master.h"
+#include "kudu/util/random.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+using kudu::client::KuduClient;
+using kudu::client::KuduClientBuilder;
+using std::string;
+using std::vector;
+
+namespace kudu {
+namespace ycsb {
+
+class YcsbWorkloadTest : public KuduTest {};
+
+// Test that the Zipfian generator stays in range and favors the first items.
+TEST_F(YcsbWorkloadTest, TestZipfianGenerator) {
+  const int kNumItems = 1000;
+  const int kNumSamples = 100000;
+  Random rng(SeedRandom());
+  ZipfianGenerator zipfian(kNumItems);
+  vector<int> counts(kNumItems);
+  for (int i = 0; i < kNumSamples; i++) {
+    uint64_t item = zipfian.Next(&rng);
+    ASSERT_LT(item, kNumItems);
+    counts[item]++;
+  }
+  ASSERT_GT(counts[0], counts[1]);
+  ASSERT_GT(counts[1], counts[kNumItems - 1]);
+  // With theta 0.99, the first item gets about an eighth of the samples.
+  ASSERT_GT(counts[0], kNumSamples / 16);
+
+  // Growing the number of items keeps the samples in range.
+  for (uint64_t n = 1; n < 2000; n++) {
+    ASSERT_LT(zipfian.Next(&rng, n), n);
+  }
+}
+
+TEST_F(YcsbWorkloadTest, TestScrambledAndLatestGenerators) {
+  const int kNumItems = 1000;
+  Random rng(SeedRandom());
+  ScrambledZipfianGenerator scrambled(kNumItems);
+  LatestGenerator latest;
+  int num_latest = 0;
+  for (int i = 0; i < 10000; i++) {
+    ASSERT_LT(scrambled.Next(&rng), kNumItems);
+    uint64_t item = latest.Next(&rng, kNumItems - 1);
+    ASSERT_LT(item, kNumItems);
+    if (item == kNumItems - 1) num_latest++;
+  }
+  ASSERT_GT(num_latest, 10000 / 16);
+}
+
+TEST_F(YcsbWorkloadTest, TestWorkloadSpecs) {
+  WorkloadSpec spec;
+  for (const char* name : { "a", "b", "c", "d", "e", "f" }) {
+    ASSERT_OK(ParseWorkloadSpec(name, "", &spec));
+    ASSERT_DOUBLE_EQ(1, spec.read_proportion + spec.update_proportion +
+                     spec.insert_proportion + spec.scan_proportion +
+                     spec.read_modify_write_proportion);
+  }
+  ASSERT_EQ(RequestDistribution::kZipfian, spec.distribution);
+  ASSERT_OK(ParseWorkloadSpec("d", "", &spec));
+  ASSERT_EQ(RequestDistribution::kLatest, spec.distribution);
+  ASSERT_OK(ParseWorkloadSpec("d", "uniform", &spec));
+  ASSERT_EQ(RequestDistribution::kUniform, spec.distribution);
+  ASSERT_TRUE(ParseWorkloadSpec("g", "", &spec).IsInvalidArgument());
+  ASSERT_TRUE(ParseWorkloadSpec("a", "pareto", &spec).IsInvalidArgument());
+
+  // Workload E only scans and inserts.
+  ASSERT_OK(ParseWorkloadSpec("e", "", &spec));
+  Random rng(SeedRandom());
+  for (int i = 0; i < 1000; i++) {
+    YcsbOp op = spec.NextOp(&rng);
+    ASSERT_TRUE(op == YcsbOp::kScan || op == YcsbOp::kInsert);
+  }
+}
+
+// Test that the keys of records are fixed-width and distinct.
+TEST_F(YcsbWorkloadTest, TestKeys) {
+  ASSERT_EQ(24, YcsbWorkload::KeyForRecord(0).size());
+  ASSERT_EQ(24, YcsbWorkload::KeyForRecord(12345).size());
+  ASSERT_NE(YcsbWorkload::KeyForRecord(1), YcsbWorkload::KeyForRecord(2));
+}
+
+// Run each of the workloads against a mini cluster.
+TEST_F(YcsbWorkloadTest, TestRunWorkloads) {
+  MiniClusterOptions opts;
+  opts.num_tablet_servers = 1;
+  MiniCluster cluster(env_.get(), opts);
+  ASSERT_OK(cluster.Start());
+  client::sp::shared_ptr<KuduClient> client;
+  ASSERT_OK(KuduClientBuilder()
+            .add_master_server_addr(cluster.mini_master()->bound_rpc_addr_str())
+            .Build(&client));
+
+  YcsbOptions options;
+  options.record_count = 500;
+  options.operation_count = 200;
+  options.num_threads = 2;
+  options.num_tablets = 3;
+  options.field_length = 10;
+  options.max_scan_length = 20;
+  options.stats_interval_ms = 10;
+  for (const char* name : { "a", "b", "c", "d", "e", "f" }) {
+    SCOPED_TRACE(name);
+    WorkloadSpec spec;
+    ASSERT_OK(ParseWorkloadSpec(name, "", &spec));
+    options.table_name = string("usertable_") + name;
+    YcsbWorkload workload(client, options, spec);
+    ASSERT_OK(workload.Load());
+    ASSERT_OK(workload.Run());
+    int64_t total = 0;
+    for (int i = 0; i < kNumYcsbOps; i++) {
+      YcsbOp op = static_cast<YcsbOp>(i);
+      ASSERT_EQ(0, workload.num_errors(op)) << YcsbOpToString(op);
+      total += workload.num_ops(op);
+    }
+    ASSERT_EQ(options.operation_count, total);
+  }
+}
+
+} // namespace ycsb
+} // namespace kudu
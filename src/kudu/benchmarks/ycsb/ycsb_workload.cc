@@ -0,0 +1,566 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/benchmarks/ycsb/ycsb_workload.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/benchmarks/ycsb-schema.h"
+#include "kudu/client/client.h"
+#include "kudu/client/row_result.h"
+#include "kudu/client/scan_batch.h"
+#include "kudu/client/value.h"
+#include "kudu/common/partial_row.h"
+#include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/random.h"
+#include "kudu/util/stopwatch.h"
+#include "kudu/util/thread.h"
+
+using kudu::client::KuduClient;
+using kudu::client::KuduError;
+using kudu::client::KuduPredicate;
+using kudu::client::KuduScanBatch;
+using kudu::client::KuduScanner;
+using kudu::client::KuduSchema;
+using kudu::client::KuduSession;
+using kudu::client::KuduTableCreator;
+using kudu::client::KuduValue;
+using kudu::client::KuduWriteOperation;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace ycsb {
+
+namespace {
+
+const int kNumFields = 10;
+
+// Latencies are tracked up to a minute.
+const uint64_t kMaxLatencyUs = 60 * 1000 * 1000;
+
+// The item count of the scrambled Zipfian distribution and its zeta, as in
+// YCSB's ScrambledZipfianGenerator, so that the zeta of the actual number of
+// records needn't be computed.
+const uint64_t kScrambledItemCount = 10000000000ULL;
+const double kScrambledZetan = 26.46902820178302;
+
+double Zeta(uint64_t from, uint64_t to, double theta, double initial_sum) {
+  double sum = initial_sum;
+  for (uint64_t i = from; i < to; i++) {
+    sum += 1 / std::pow(i + 1, theta);
+  }
+  return sum;
+}
+
+// Returns the key of the record whose number hashes to 'hash'. The keys are
+// zero-padded so that they sort like their hashes.
+string KeyForHash(uint64_t hash) {
+  return Substitute("user$0", StringPrintf("%020llu", static_cast<unsigned long long>(hash)));
+}
+
+// Returns the error of the failed write operation applied to 'session', or
+// 's' if there's none.
+Status SessionError(KuduSession* session, const Status& s) {
+  vector<KuduError*> errors;
+  ElementDeleter d(&errors);
+  bool overflowed;
+  session->GetPendingErrors(&errors, &overflowed);
+  return errors.empty() ? s : errors[0]->status();
+}
+
+} // anonymous namespace
+
+ZipfianGenerator::ZipfianGenerator(uint64_t num_items, double theta)
+    : ZipfianGenerator(num_items, theta, Zeta(0, num_items, theta, 0)) {
+}
+
+ZipfianGenerator::ZipfianGenerator(uint64_t num_items, double theta, double zetan)
+    : theta_(theta),
+      alpha_(1 / (1 - theta)),
+      zeta2_(Zeta(0, 2, theta, 0)),
+      num_items_(num_items),
+      zetan_(zetan) {
+  CHECK_GT(num_items, 0);
+  eta_ = (1 - std::pow(2.0 / num_items_, 1 - theta_)) / (1 - zeta2_ / zetan_);
+}
+
+void ZipfianGenerator::SetNumItems(uint64_t num_items) {
+  // The zeta is extended incrementally as the number of items grows, which
+  // is the common case.
+  if (num_items > num_items_) {
+    zetan_ = Zeta(num_items_, num_items, theta_, zetan_);
+  } else {
+    zetan_ = Zeta(0, num_items, theta_, 0);
+  }
+  num_items_ = num_items;
+  eta_ = (1 - std::pow(2.0 / num_items_, 1 - theta_)) / (1 - zeta2_ / zetan_);
+}
+
+uint64_t ZipfianGenerator::Next(Random* rng, uint64_t num_items) {
+  DCHECK_GT(num_items, 0);
+  if (num_items != num_items_) {
+    SetNumItems(num_items);
+  }
+  double u = rng->NextDoubleFraction();
+  double uz = u * zetan_;
+  if (uz < 1.0) {
+    return 0;
+  }
+  if (uz < 1.0 + std::pow(0.5, theta_)) {
+    return std::min<uint64_t>(1, num_items_ - 1);
+  }
+  uint64_t item = static_cast<uint64_t>(num_items_ * std::pow(eta_ * u - eta_ + 1, alpha_));
+  return std::min(item, num_items_ - 1);
+}
+
+ScrambledZipfianGenerator::ScrambledZipfianGenerator(uint64_t num_items)
+    : num_items_(num_items),
+      zipfian_(kScrambledItemCount, ZipfianGenerator::kZipfianConstant, kScrambledZetan) {
+  CHECK_GT(num_items, 0);
+}
+
+uint64_t ScrambledZipfianGenerator::Next(Random* rng) {
+  return FnvHash64(zipfian_.Next(rng)) % num_items_;
+}
+
+uint64_t FnvHash64(uint64_t value) {
+  uint64_t hash = 0xCBF29CE484222325ULL;
+  for (int i = 0; i < 8; i++) {
+    hash ^= value & 0xff;
+    hash *= 1099511628211ULL;
+    value >>= 8;
+  }
+  return hash;
+}
+
+const char* YcsbOpToString(YcsbOp op) {
+  switch (op) {
+    case YcsbOp::kRead: return "READ";
+    case YcsbOp::kUpdate: return "UPDATE";
+    case YcsbOp::kInsert: return "INSERT";
+    case YcsbOp::kScan: return "SCAN";
+    case YcsbOp::kReadModifyWrite: return "READ-MODIFY-WRITE";
+  }
+  LOG(FATAL) << "unknown YCSB operation";
+  return "";
+}
+
+YcsbOp WorkloadSpec::NextOp(Random* rng) const {
+  double r = rng->NextDoubleFraction();
+  const std::pair<YcsbOp, double> ops[] = {
+    { YcsbOp::kRead, read_proportion },
+    { YcsbOp::kUpdate, update_proportion },
+    { YcsbOp::kInsert, insert_proportion },
+    { YcsbOp::kScan, scan_proportion },
+    { YcsbOp::kReadModifyWrite, read_modify_write_proportion },
+  };
+  YcsbOp last = YcsbOp::kRead;
+  for (const auto& op : ops) {
+    if (op.second <= 0) continue;
+    if (r < op.second) {
+      return op.first;
+    }
+    r -= op.second;
+    last = op.first;
+  }
+  // Rounding left 'r' past the last proportion.
+  return last;
+}
+
+Status ParseWorkloadSpec(const string& name, const string& distribution, WorkloadSpec* spec) {
+  *spec = WorkloadSpec();
+  if (name == "a") {
+    spec->read_proportion = 0.5;
+    spec->update_proportion = 0.5;
+  } else if (name == "b") {
+    spec->read_proportion = 0.95;
+    spec->update_proportion = 0.05;
+  } else if (name == "c") {
+    spec->read_proportion = 1;
+  } else if (name == "d") {
+    spec->read_proportion = 0.95;
+    spec->insert_proportion = 0.05;
+    spec->distribution = RequestDistribution::kLatest;
+  } else if (name == "e") {
+    spec->scan_proportion = 0.95;
+    spec->insert_proportion = 0.05;
+  } else if (name == "f") {
+    spec->read_proportion = 0.5;
+    spec->read_modify_write_proportion = 0.5;
+  } else {
+    return Status::InvalidArgument("unknown YCSB workload, expected one of a-f", name);
+  }
+
+  if (distribution == "uniform") {
+    spec->distribution = RequestDistribution::kUniform;
+  } else if (distribution == "zipfian") {
+    spec->distribution = RequestDistribution::kZipfian;
+  } else if (distribution == "latest") {
+    spec->distribution = RequestDistribution::kLatest;
+  } else if (!distribution.empty()) {
+    return Status::InvalidArgument(
+        "unknown request distribution, expected uniform, zipfian or latest", distribution);
+  }
+  return Status::OK();
+}
+
+// The statistics of one type of operation.
+struct YcsbWorkload::OpStats {
+  OpStats() : latency_us(kMaxLatencyUs, 2) {}
+
+  HdrHistogram latency_us;
+  int64_t num_errors = 0;
+};
+
+YcsbWorkload::YcsbWorkload(client::sp::shared_ptr<KuduClient> client,
+                           YcsbOptions options, WorkloadSpec spec)
+    : client_(std::move(client)),
+      options_(std::move(options)),
+      spec_(spec),
+      next_record_(0),
+      ops_done_(0) {
+  for (auto& stats : stats_) {
+    stats.reset(new OpStats());
+  }
+}
+
+YcsbWorkload::~YcsbWorkload() {
+}
+
+string YcsbWorkload::KeyForRecord(uint64_t record_num) {
+  return KeyForHash(FnvHash64(record_num));
+}
+
+Status YcsbWorkload::CreateTableIfMissing() {
+  Status s = client_->OpenTable(options_.table_name, &table_);
+  if (s.ok() || !s.IsNotFound()) {
+    return s;
+  }
+
+  // The keys are hashes, so even splits of the hash space spread the
+  // records evenly over the tablets.
+  KuduSchema schema = CreateYCSBSchema();
+  unique_ptr<KuduTableCreator> creator(client_->NewTableCreator());
+  creator->table_name(options_.table_name)
+      .schema(&schema)
+      .set_range_partition_columns({ "key" })
+      .num_replicas(options_.num_replicas);
+  const uint64_t step = std::numeric_limits<uint64_t>::max() / options_.num_tablets;
+  for (int i = 1; i < options_.num_tablets; i++) {
+    KuduPartialRow* split = schema.NewRow();
+    RETURN_NOT_OK(split->SetStringCopy(0, KeyForHash(step * i)));
+    creator->add_range_partition_split(split);
+  }
+  RETURN_NOT_OK_PREPEND(creator->Create(), "could not create the YCSB table");
+  return client_->OpenTable(options_.table_name, &table_);
+}
+
+void YcsbWorkload::FillField(Random* rng, string* buf) const {
+  buf->resize(options_.field_length);
+  for (int i = 0; i < options_.field_length; i++) {
+    (*buf)[i] = 'a' + rng->Uniform(26);
+  }
+}
+
+Status YcsbWorkload::WriteRecord(uint64_t record_num, bool all_fields, Random* rng,
+                                 KuduSession* session, string* buf) {
+  unique_ptr<KuduWriteOperation> op;
+  if (all_fields) {
+    op.reset(table_->NewInsert());
+  } else {
+    op.reset(table_->NewUpdate());
+  }
+  KuduPartialRow* row = op->mutable_row();
+  RETURN_NOT_OK(row->SetStringCopy(0, KeyForRecord(record_num)));
+  if (all_fields) {
+    for (int i = 0; i < kNumFields; i++) {
+      FillField(rng, buf);
+      RETURN_NOT_OK(row->SetStringCopy(i + 1, *buf));
+    }
+  } else {
+    // Like YCSB's default, updates write a single field.
+    FillField(rng, buf);
+    RETURN_NOT_OK(row->SetStringCopy(1 + rng->Uniform(kNumFields), *buf));
+  }
+  Status s = session->Apply(op.release());
+  if (!s.ok()) {
+    return SessionError(session, s);
+  }
+  return Status::OK();
+}
+
+Status YcsbWorkload::ReadRecord(uint64_t record_num) {
+  KuduScanner scanner(table_.get());
+  RETURN_NOT_OK(scanner.AddConjunctPredicate(table_->NewComparisonPredicate(
+      "key", KuduPredicate::EQUAL, KuduValue::CopyString(KeyForRecord(record_num)))));
+  RETURN_NOT_OK(scanner.Open());
+  KuduScanBatch batch;
+  while (scanner.HasMoreRows()) {
+    RETURN_NOT_OK(scanner.NextBatch(&batch));
+  }
+  return Status::OK();
+}
+
+Status YcsbWorkload::ScanRecords(uint64_t record_num, int length) {
+  KuduScanner scanner(table_.get());
+  RETURN_NOT_OK(scanner.AddConjunctPredicate(table_->NewComparisonPredicate(
+      "key", KuduPredicate::GREATER_EQUAL, KuduValue::CopyString(KeyForRecord(record_num)))));
+  RETURN_NOT_OK(scanner.SetOrderMode(KuduScanner::ORDERED));
+  RETURN_NOT_OK(scanner.Open());
+  KuduScanBatch batch;
+  int num_rows = 0;
+  while (num_rows < length && scanner.HasMoreRows()) {
+    RETURN_NOT_OK(scanner.NextBatch(&batch));
+    num_rows += batch.NumRows();
+  }
+  scanner.Close();
+  return Status::OK();
+}
+
+uint64_t YcsbWorkload::NextRecord(Random* rng, ZipfianGenerator* zipfian,
+                                  LatestGenerator* latest) {
+  // Records are picked among those inserted so far, which is how YCSB
+  // spreads reads over the records added by workloads D and E.
+  uint64_t num_records = std::max<int64_t>(next_record_.Load(), 1);
+  switch (spec_.distribution) {
+    case RequestDistribution::kUniform:
+      return rng->Uniform64(num_records);
+    case RequestDistribution::kZipfian:
+      // The popular records are scattered over the key space rather than
+      // clustered at its start, as by ScrambledZipfianGenerator. Its zeta
+      // stays that of a fixed number of items, so the same records remain
+      // popular as records are inserted.
+      return FnvHash64(zipfian->Next(rng)) % num_records;
+    case RequestDistribution::kLatest:
+      return latest->Next(rng, num_records - 1);
+  }
+  LOG(FATAL) << "unknown request distribution";
+  return 0;
+}
+
+Status YcsbWorkload::DoOp(YcsbOp op, uint64_t record_num, Random* rng,
+                          KuduSession* session, string* buf) {
+  switch (op) {
+    case YcsbOp::kRead:
+      return ReadRecord(record_num);
+    case YcsbOp::kUpdate:
+      return WriteRecord(record_num, false, rng, session, buf);
+    case YcsbOp::kInsert:
+      return WriteRecord(record_num, true, rng, session, buf);
+    case YcsbOp::kScan:
+      return ScanRecords(record_num, 1 + rng->Uniform(options_.max_scan_length));
+    case YcsbOp::kReadModifyWrite:
+      RETURN_NOT_OK(ReadRecord(record_num));
+      return WriteRecord(record_num, false, rng, session, buf);
+  }
+  LOG(FATAL) << "unknown YCSB operation";
+  return Status::OK();
+}
+
+Status YcsbWorkload::Load() {
+  RETURN_NOT_OK(CreateTableIfMissing());
+
+  vector<scoped_refptr<Thread>> threads;
+  vector<Status> statuses(options_.num_threads);
+  for (int i = 0; i < options_.num_threads; i++) {
+    scoped_refptr<Thread> thread;
+    RETURN_NOT_OK(Thread::Create("ycsb", Substitute("load-$0", i),
+        [this, i, &statuses]() {
+          client::sp::shared_ptr<KuduSession> session = client_->NewSession();
+          Status s = session->SetFlushMode(KuduSession::MANUAL_FLUSH);
+          Random rng(i);
+          string buf;
+          int pending = 0;
+          for (int64_t r = i; s.ok() && r < options_.record_count; r += options_.num_threads) {
+            s = WriteRecord(r, true, &rng, session.get(), &buf);
+            if (s.ok() && ++pending == 1000) {
+              s = session->Flush();
+              pending = 0;
+            }
+          }
+          if (s.ok()) {
+            s = session->Flush();
+          }
+          if (!s.ok()) {
+            statuses[i] = SessionError(session.get(), s);
+          }
+        }, &thread));
+    threads.push_back(thread);
+  }
+  for (const auto& thread : threads) {
+    thread->Join();
+  }
+  for (const Status& s : statuses) {
+    RETURN_NOT_OK_PREPEND(s, "could not load the YCSB records");
+  }
+  next_record_.Store(options_.record_count);
+  return Status::OK();
+}
+
+void YcsbWorkload::RunThread(int thread_idx, int64_t num_ops, Status* status) {
+  client::sp::shared_ptr<KuduSession> session = client_->NewSession();
+  Status s = session->SetFlushMode(KuduSession::AUTO_FLUSH_SYNC);
+  if (!s.ok()) {
+    *status = s;
+    return;
+  }
+
+  // The statistics of the thread are merged into the workload's once it's
+  // done, so that threads don't contend on the histograms.
+  OpStats stats[kNumYcsbOps];
+  Random rng(options_.record_count + thread_idx);
+  ZipfianGenerator zipfian(kScrambledItemCount, ZipfianGenerator::kZipfianConstant,
+                           kScrambledZetan);
+  LatestGenerator latest;
+  string buf;
+  for (int64_t i = 0; i < num_ops; i++) {
+    YcsbOp op = spec_.NextOp(&rng);
+    uint64_t record_num = op == YcsbOp::kInsert ? next_record_.Increment() - 1
+                                                : NextRecord(&rng, &zipfian, &latest);
+    MonoTime start = MonoTime::Now();
+    s = DoOp(op, record_num, &rng, session.get(), &buf);
+    int64_t latency_us = (MonoTime::Now() - start).ToMicroseconds();
+    OpStats& op_stats = stats[static_cast<int>(op)];
+    op_stats.latency_us.Increment(std::min<int64_t>(latency_us, kMaxLatencyUs));
+    if (!s.ok()) {
+      KLOG_EVERY_N(WARNING, 1000) << YcsbOpToString(op) << " failed: " << s.ToString();
+      op_stats.num_errors++;
+    }
+    ops_done_.Increment();
+  }
+
+  static simple_spinlock lock;
+  std::lock_guard<simple_spinlock> l(lock);
+  for (int i = 0; i < kNumYcsbOps; i++) {
+    stats_[i]->latency_us.MergeFrom(stats[i].latency_us);
+    stats_[i]->num_errors += stats[i].num_errors;
+  }
+}
+
+Status YcsbWorkload::Run() {
+  if (!table_) {
+    RETURN_NOT_OK(client_->OpenTable(options_.table_name, &table_));
+  }
+  if (next_record_.Load() == 0) {
+    next_record_.Store(options_.record_count);
+  }
+  for (auto& stats : stats_) {
+    stats.reset(new OpStats());
+  }
+  ops_done_.Store(0);
+  throughput_series_.clear();
+
+  // Samples the throughput until the workload threads are done.
+  CountDownLatch done(1);
+  scoped_refptr<Thread> reporter;
+  RETURN_NOT_OK(Thread::Create("ycsb", "reporter", [this, &done]() {
+        int64_t last = 0;
+        while (!done.WaitFor(MonoDelta::FromMilliseconds(options_.stats_interval_ms))) {
+          int64_t now = ops_done_.Load();
+          throughput_series_.push_back(now - last);
+          last = now;
+          LOG(INFO) << Substitute("$0 operations done, $1 ops/s", now,
+                                  (throughput_series_.back() * 1000) /
+                                  options_.stats_interval_ms);
+        }
+      }, &reporter));
+
+  Stopwatch sw;
+  sw.start();
+  vector<scoped_refptr<Thread>> threads;
+  vector<Status> statuses(options_.num_threads);
+  Status s;
+  for (int i = 0; i < options_.num_threads; i++) {
+    int64_t num_ops = options_.operation_count / options_.num_threads +
+        (i < options_.operation_count % options_.num_threads ? 1 : 0);
+    scoped_refptr<Thread> thread;
+    s = Thread::Create("ycsb", Substitute("run-$0", i),
+                       &YcsbWorkload::RunThread, this, i, num_ops, &statuses[i], &thread);
+    if (!s.ok()) break;
+    threads.push_back(thread);
+  }
+  for (const auto& thread : threads) {
+    thread->Join();
+  }
+  sw.stop();
+  run_secs_ = sw.elapsed().wall_seconds();
+  done.CountDown();
+  reporter->Join();
+
+  RETURN_NOT_OK(s);
+  for (const Status& status : statuses) {
+    RETURN_NOT_OK(status);
+  }
+  return Status::OK();
+}
+
+int64_t YcsbWorkload::num_ops(YcsbOp op) const {
+  return stats_[static_cast<int>(op)]->latency_us.TotalCount();
+}
+
+int64_t YcsbWorkload::num_errors(YcsbOp op) const {
+  return stats_[static_cast<int>(op)]->num_errors;
+}
+
+const HdrHistogram& YcsbWorkload::latency_us(YcsbOp op) const {
+  return stats_[static_cast<int>(op)]->latency_us;
+}
+
+void YcsbWorkload::PrintReport(std::ostream* out) const {
+  int64_t total = ops_done_.Load();
+  *out << Substitute("[OVERALL] RunTime(s): $0", run_secs_) << std::endl;
+  *out << Substitute("[OVERALL] Throughput(ops/sec): $0",
+                     run_secs_ > 0 ? total / run_secs_ : 0) << std::endl;
+  for (int i = 0; i < kNumYcsbOps; i++) {
+    const HdrHistogram& hist = stats_[i]->latency_us;
+    if (hist.TotalCount() == 0) continue;
+    const char* name = YcsbOpToString(static_cast<YcsbOp>(i));
+    *out << Substitute("[$0] Operations: $1", name, hist.TotalCount()) << std::endl;
+    *out << Substitute("[$0] Errors: $1", name, stats_[i]->num_errors) << std::endl;
+    *out << Substitute("[$0] AverageLatency(us): $1", name, hist.MeanValue()) << std::endl;
+    *out << Substitute("[$0] MinLatency(us): $1", name, hist.MinValue()) << std::endl;
+    *out << Substitute("[$0] MaxLatency(us): $1", name, hist.MaxValue()) << std::endl;
+    for (double p : { 50.0, 95.0, 99.0, 99.9 }) {
+      *out << Substitute("[$0] $1thPercentileLatency(us): $2", name, p,
+                         hist.ValueAtPercentile(p)) << std::endl;
+    }
+  }
+  *out << "[OVERALL] Throughput series (ops per " << options_.stats_interval_ms << "ms):";
+  for (int64_t n : throughput_series_) {
+    *out << " " << n;
+  }
+  *out << std::endl;
+}
+
+} // namespace ycsb
+} // namespace kudu
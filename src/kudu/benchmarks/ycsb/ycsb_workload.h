@@ -0,0 +1,239 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// A native driver of the YCSB core workloads, run against the usertable of
+// benchmarks/ycsb-schema.h.
+#ifndef KUDU_BENCHMARKS_YCSB_YCSB_WORKLOAD_H
+#define KUDU_BENCHMARKS_YCSB_YCSB_WORKLOAD_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kudu/client/shared_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/hdr_histogram.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class Random;
+
+namespace client {
+class KuduClient;
+class KuduSession;
+class KuduTable;
+} // namespace client
+
+namespace ycsb {
+
+// Picks items in [0, num_items) following a Zipfian distribution, in which
+// item 0 is the most popular, as described in "Quickly Generating
+// Billion-Record Synthetic Databases" by Gray et al.
+//
+// The number of items may grow from one call to the next, as it does when
+// picking among the records inserted so far. Not thread-safe.
+class ZipfianGenerator {
+ public:
+  static constexpr double kZipfianConstant = 0.99;
+
+  explicit ZipfianGenerator(uint64_t num_items, double theta = kZipfianConstant);
+
+  // Uses 'zetan', the precomputed zeta of 'num_items', rather than
+  // computing it, which takes time linear in 'num_items'.
+  ZipfianGenerator(uint64_t num_items, double theta, double zetan);
+
+  uint64_t Next(Random* rng) { return Next(rng, num_items_); }
+
+  uint64_t Next(Random* rng, uint64_t num_items);
+
+ private:
+  void SetNumItems(uint64_t num_items);
+
+  const double theta_;
+  const double alpha_;
+  const double zeta2_;
+  uint64_t num_items_;
+  double zetan_;
+  double eta_;
+};
+
+// Picks items in [0, num_items) with Zipfian popularity, but with the
+// popular items scattered over the whole range rather than clustered at its
+// start. Not thread-safe.
+class ScrambledZipfianGenerator {
+ public:
+  explicit ScrambledZipfianGenerator(uint64_t num_items);
+
+  uint64_t Next(Random* rng);
+
+ private:
+  const uint64_t num_items_;
+  ZipfianGenerator zipfian_;
+};
+
+// Picks among items [0, max_item] with Zipfian popularity, the most recent
+// (highest) being the most popular. Not thread-safe.
+class LatestGenerator {
+ public:
+  LatestGenerator() : zipfian_(1) {}
+
+  uint64_t Next(Random* rng, uint64_t max_item) {
+    return max_item - zipfian_.Next(rng, max_item + 1);
+  }
+
+ private:
+  ZipfianGenerator zipfian_;
+};
+
+// Returns the FNV-1a hash of 'value', used to scatter keys.
+uint64_t FnvHash64(uint64_t value);
+
+// The operations of the YCSB workloads.
+enum class YcsbOp {
+  kRead,
+  kUpdate,
+  kInsert,
+  kScan,
+  kReadModifyWrite,
+};
+const int kNumYcsbOps = 5;
+
+const char* YcsbOpToString(YcsbOp op);
+
+// How the records to operate on are picked.
+enum class RequestDistribution {
+  kUniform,
+  kZipfian,
+  kLatest,
+};
+
+// The mix of operations of a workload, as proportions adding up to 1.
+struct WorkloadSpec {
+  double read_proportion = 0;
+  double update_proportion = 0;
+  double insert_proportion = 0;
+  double scan_proportion = 0;
+  double read_modify_write_proportion = 0;
+  RequestDistribution distribution = RequestDistribution::kZipfian;
+
+  // Picks an operation following the proportions.
+  YcsbOp NextOp(Random* rng) const;
+};
+
+// Sets 'spec' to that of the core workload named 'name', from "a" to "f",
+// and overrides its request distribution with 'distribution' unless empty.
+Status ParseWorkloadSpec(const std::string& name, const std::string& distribution,
+                         WorkloadSpec* spec);
+
+struct YcsbOptions {
+  std::string table_name = "usertable";
+
+  // The number of records loaded before running the workload.
+  int64_t record_count = 10000;
+
+  // The number of operations of the workload, over all threads.
+  int64_t operation_count = 100000;
+
+  int num_threads = 4;
+
+  // The number of range partitions of the table when it's created.
+  int num_tablets = 8;
+
+  int num_replicas = 1;
+
+  // The length of each of the fields of a record.
+  int field_length = 100;
+
+  // Scans read a uniformly distributed number of records between 1 and
+  // this.
+  int max_scan_length = 100;
+
+  // How often the throughput of the workload is sampled.
+  int stats_interval_ms = 1000;
+};
+
+// Loads the records of the usertable and runs a YCSB workload against it,
+// tracking the latency of each type of operation and the throughput over
+// time.
+class YcsbWorkload {
+ public:
+  YcsbWorkload(client::sp::shared_ptr<client::KuduClient> client,
+               YcsbOptions options, WorkloadSpec spec);
+
+  ~YcsbWorkload();
+
+  // Creates the table, unless it exists, and writes 'record_count' records.
+  Status Load();
+
+  // Runs 'operation_count' operations of the workload.
+  Status Run();
+
+  // Prints the throughput and latencies of the last run.
+  void PrintReport(std::ostream* out) const;
+
+  int64_t num_ops(YcsbOp op) const;
+  int64_t num_errors(YcsbOp op) const;
+  const HdrHistogram& latency_us(YcsbOp op) const;
+
+  // The number of operations completed in each 'stats_interval_ms' of the
+  // last run.
+  const std::vector<int64_t>& throughput_series() const { return throughput_series_; }
+
+  // Returns the key of the record numbered 'record_num'.
+  static std::string KeyForRecord(uint64_t record_num);
+
+ private:
+  struct OpStats;
+
+  Status CreateTableIfMissing();
+  void RunThread(int thread_idx, int64_t num_ops, Status* status);
+  Status DoOp(YcsbOp op, uint64_t record_num, Random* rng,
+              client::KuduSession* session, std::string* buf);
+  Status ReadRecord(uint64_t record_num);
+  Status WriteRecord(uint64_t record_num, bool all_fields, Random* rng,
+                     client::KuduSession* session, std::string* buf);
+  Status ScanRecords(uint64_t record_num, int length);
+  void FillField(Random* rng, std::string* buf) const;
+
+  // Picks the record for an operation other than an insert.
+  uint64_t NextRecord(Random* rng, ZipfianGenerator* zipfian, LatestGenerator* latest);
+
+  const client::sp::shared_ptr<client::KuduClient> client_;
+  const YcsbOptions options_;
+  const WorkloadSpec spec_;
+  client::sp::shared_ptr<client::KuduTable> table_;
+
+  // One more than the highest record number inserted so far.
+  AtomicInt<int64_t> next_record_;
+
+  // The number of operations completed by the current run.
+  AtomicInt<int64_t> ops_done_;
+
+  std::unique_ptr<OpStats> stats_[kNumYcsbOps];
+  std::vector<int64_t> throughput_series_;
+  double run_secs_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(YcsbWorkload);
+};
+
+} // namespace ycsb
+} // namespace kudu
+#endif /* KUDU_BENCHMARKS_YCSB_YCSB_WORKLOAD_H */
@@ -291,7 +291,9 @@ void BinaryPrefixBlockDecoder::SeekToPositionInBlock(uint pos) {
 
   DCHECK_LE(pos, num_elems_);
 
-  int target_restart = pos/restart_interval_;
+  // When seeking to the very end of a block whose size is a multiple of the
+  // restart interval, there is no restart point at 'pos' itself.
+  int target_restart = std::min(pos / restart_interval_, num_restarts_);
   SeekToRestartPoint(target_restart);
 
   // Seek forward to the right index
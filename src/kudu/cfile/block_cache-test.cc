@@ -19,8 +19,15 @@
 
 #include "kudu/cfile/block_cache.h"
 #include "kudu/util/cache.h"
+#include "kudu/util/metrics.h"
 #include "kudu/util/slice.h"
 
+METRIC_DECLARE_entity(server);
+METRIC_DECLARE_counter(block_cache_compressed_tier_hits);
+METRIC_DECLARE_counter(block_cache_compressed_tier_misses);
+METRIC_DECLARE_counter(block_cache_compressed_tier_evictions);
+METRIC_DECLARE_gauge_uint64(block_cache_compressed_tier_usage);
+
 namespace kudu {
 namespace cfile {
 
@@ -60,6 +67,61 @@ TEST(TestBlockCache, TestBasics) {
   ASSERT_FALSE(cache.Lookup(key1, Cache::EXPECT_IN_CACHE, &retrieved_handle));
 }
 
+// Test that the compressed tier holds its own entries, separately from the
+// decompressed tier, and keeps its own metrics.
+TEST(TestBlockCache, TestCompressedTier) {
+  const size_t data_size = strlen(DATA_TO_CACHE) + 1;
+  ASSERT_FALSE(BlockCache(1024 * 1024).has_compressed_tier());
+
+  // Each shard of a cache this small only has room for a few entries.
+  BlockCache cache(1024 * 1024, 1024);
+  ASSERT_TRUE(cache.has_compressed_tier());
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity = METRIC_ENTITY_server.Instantiate(&registry, "test");
+  cache.StartInstrumentation(entity);
+
+  BlockCache::FileId id(1234);
+  BlockCache::CacheKey key(id, 1);
+  {
+    BlockCacheHandle handle;
+    ASSERT_FALSE(cache.LookupCompressed(key, Cache::EXPECT_IN_CACHE, &handle));
+  }
+  {
+    BlockCache::PendingEntry data = cache.AllocateCompressed(key, data_size);
+    ASSERT_TRUE(data.valid());
+    memcpy(data.val_ptr(), DATA_TO_CACHE, data_size);
+    BlockCacheHandle inserted_handle;
+    cache.InsertCompressed(&data, &inserted_handle);
+    ASSERT_FALSE(data.valid());
+    ASSERT_TRUE(inserted_handle.valid());
+  }
+
+  // The block is only in the compressed tier.
+  BlockCacheHandle handle;
+  ASSERT_FALSE(cache.Lookup(key, Cache::EXPECT_IN_CACHE, &handle));
+  ASSERT_TRUE(cache.LookupCompressed(key, Cache::EXPECT_IN_CACHE, &handle));
+  ASSERT_EQ(0, memcmp(handle.data().data(), DATA_TO_CACHE, data_size));
+  handle.Release();
+
+  ASSERT_EQ(1, METRIC_block_cache_compressed_tier_hits.Instantiate(entity)->value());
+  ASSERT_EQ(1, METRIC_block_cache_compressed_tier_misses.Instantiate(entity)->value());
+  ASSERT_EQ(data_size,
+            METRIC_block_cache_compressed_tier_usage.Instantiate(entity, 0)->value());
+
+  // Filling the compressed tier evicts the block, and the metrics follow.
+  for (int i = 2; i < 2000; i++) {
+    BlockCache::CacheKey other_key(id, i);
+    BlockCache::PendingEntry data = cache.AllocateCompressed(other_key, data_size);
+    ASSERT_TRUE(data.valid());
+    memcpy(data.val_ptr(), DATA_TO_CACHE, data_size);
+    BlockCacheHandle inserted_handle;
+    cache.InsertCompressed(&data, &inserted_handle);
+  }
+  ASSERT_FALSE(cache.LookupCompressed(key, Cache::EXPECT_IN_CACHE, &handle));
+  ASSERT_GT(METRIC_block_cache_compressed_tier_evictions.Instantiate(entity)->value(), 0);
+  ASSERT_LE(METRIC_block_cache_compressed_tier_usage.Instantiate(entity, 0)->value(), 1024);
+}
+
 
 } // namespace cfile
 } // namespace kudu
@@ -15,11 +15,18 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <string.h>
+
+#include <unordered_map>
+#include <unordered_set>
+
 #include <gflags/gflags.h>
 
 #include "kudu/cfile/block_cache.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
 #include "kudu/util/cache.h"
+#include "kudu/util/cache_metrics.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/slice.h"
@@ -35,6 +42,49 @@ DEFINE_string(block_cache_type, "DRAM",
               "in a memory-mapped file using the NVML library.");
 TAG_FLAG(block_cache_type, experimental);
 
+DEFINE_string(block_cache_eviction_policy, "LRU",
+              "Which eviction policy the DRAM block cache uses. Valid choices are "
+              "'LRU', 'SLRU' or 'CLOCK'. 'SLRU' (segmented LRU) keeps blocks which have "
+              "been read more than once, along with index and bloom filter blocks, in a "
+              "protected segment, so that large scans cannot evict them. 'CLOCK' "
+              "approximates LRU with lookups which don't serialize on their cache "
+              "shard, for workloads dominated by concurrent cache hits.");
+TAG_FLAG(block_cache_eviction_policy, experimental);
+
+DEFINE_double(block_cache_protected_ratio, 0.8,
+              "With --block_cache_eviction_policy=SLRU, the fraction of the block "
+              "cache capacity reserved for the protected segment.");
+TAG_FLAG(block_cache_protected_ratio, experimental);
+
+DEFINE_int64(block_cache_compressed_capacity_mb, 0,
+             "Capacity in MB of the block cache's compressed tier, which caches "
+             "blocks of compressed cfiles as they are stored on disk, behind the "
+             "cache of decompressed blocks sized by --block_cache_capacity_mb. "
+             "Blocks missing from the decompressed tier are then decompressed "
+             "from the compressed tier if possible, instead of being read from "
+             "disk. 0 disables the compressed tier.");
+TAG_FLAG(block_cache_compressed_capacity_mb, experimental);
+
+DEFINE_int64(block_cache_dram_tier_capacity_mb, 0,
+             "With --block_cache_type=NVM, capacity in MB of a DRAM tier in front "
+             "of the NVM cache, which holds copies of the blocks most recently "
+             "read from NVM. 0 disables the DRAM tier.");
+TAG_FLAG(block_cache_dram_tier_capacity_mb, experimental);
+
+DEFINE_bool(block_cache_direct_reads, false,
+            "Read cfile data with direct I/O, bypassing the operating system's "
+            "page cache, so that data held by the block cache is not cached "
+            "twice. Only takes effect if the block cache's capacity, including "
+            "its compressed tier, is at least "
+            "--block_cache_direct_reads_min_capacity_mb.");
+TAG_FLAG(block_cache_direct_reads, experimental);
+
+DEFINE_int64(block_cache_direct_reads_min_capacity_mb, 8 * 1024,
+             "The smallest block cache capacity in MB with which "
+             "--block_cache_direct_reads takes effect. A smaller cache "
+             "would leave reads without any effective caching.");
+TAG_FLAG(block_cache_direct_reads_min_capacity_mb, experimental);
+
 namespace kudu {
 
 class MetricEntity;
@@ -54,17 +104,89 @@ Cache* CreateCache(int64_t capacity) {
     LOG(FATAL) << "Unknown block cache type: '" << FLAGS_block_cache_type
                << "' (expected 'DRAM' or 'NVM')";
   }
+
+  ToUpperCase(FLAGS_block_cache_eviction_policy, &FLAGS_block_cache_eviction_policy);
+  if (FLAGS_block_cache_eviction_policy == "SLRU") {
+    if (t != DRAM_CACHE) {
+      LOG(FATAL) << "The SLRU eviction policy is only supported by the DRAM block cache";
+    }
+    return NewSLRUCache(capacity, FLAGS_block_cache_protected_ratio, "block_cache");
+  }
+  if (FLAGS_block_cache_eviction_policy == "CLOCK") {
+    if (t != DRAM_CACHE) {
+      LOG(FATAL) << "The CLOCK eviction policy is only supported by the DRAM block cache";
+    }
+    return NewClockCache(capacity, "block_cache");
+  }
+  if (FLAGS_block_cache_eviction_policy != "LRU") {
+    LOG(FATAL) << "Unknown block cache eviction policy: '"
+               << FLAGS_block_cache_eviction_policy << "' (expected 'LRU', 'SLRU' or 'CLOCK')";
+  }
   return NewLRUCache(t, capacity, "block_cache");
 }
 
 } // anonymous namespace
 
+// Keeps the usage and eviction metrics of the compressed tier up to date.
+class BlockCache::CompressedTierEvictionCallback : public Cache::EvictionCallback {
+ public:
+  explicit CompressedTierEvictionCallback(const BlockCache* cache)
+    : cache_(cache) {
+  }
+
+  void EvictedEntry(Slice key, Slice value) OVERRIDE {
+    CacheMetrics* metrics = cache_->tier_metrics_.get();
+    if (PREDICT_TRUE(metrics)) {
+      metrics->compressed_tier_usage->DecrementBy(value.size());
+      metrics->compressed_tier_evictions->Increment();
+    }
+  }
+
+ private:
+  const BlockCache* const cache_;
+};
+
+bool BlockCache::ShouldUseDirectReads() {
+  if (!FLAGS_block_cache_direct_reads) {
+    return false;
+  }
+  int64_t capacity_mb = FLAGS_block_cache_capacity_mb + FLAGS_block_cache_compressed_capacity_mb;
+  if (capacity_mb < FLAGS_block_cache_direct_reads_min_capacity_mb) {
+    LOG(WARNING) << "Not using direct reads: the block cache capacity of "
+                 << capacity_mb << " MB is below "
+                 << FLAGS_block_cache_direct_reads_min_capacity_mb << " MB";
+    return false;
+  }
+  return true;
+}
+
 BlockCache::BlockCache()
-  : BlockCache(FLAGS_block_cache_capacity_mb * 1024 * 1024) {
+  : BlockCache(FLAGS_block_cache_capacity_mb * 1024 * 1024,
+               FLAGS_block_cache_compressed_capacity_mb * 1024 * 1024) {
 }
 
 BlockCache::BlockCache(size_t capacity)
+  : BlockCache(capacity, 0) {
+}
+
+BlockCache::BlockCache(size_t capacity, size_t compressed_capacity)
   : cache_(CreateCache(capacity)) {
+  if (compressed_capacity > 0) {
+    // Compressed blocks are always kept in DRAM: they are only worth caching
+    // if decompressing them is cheaper than reading them again.
+    compressed_cache_.reset(NewLRUCache(DRAM_CACHE, compressed_capacity,
+                                        "compressed_block_cache"));
+    compressed_eviction_cb_.reset(new CompressedTierEvictionCallback(this));
+  }
+  if (FLAGS_block_cache_type == "NVM" && FLAGS_block_cache_dram_tier_capacity_mb > 0) {
+    dram_tier_.reset(NewLRUCache(DRAM_CACHE, FLAGS_block_cache_dram_tier_capacity_mb * 1024 * 1024,
+                                 "block_cache_dram_tier"));
+  }
+}
+
+BlockCache::~BlockCache() {
+  // Entries freed by the compressed tier call back into this object.
+  compressed_cache_.reset();
 }
 
 BlockCache::PendingEntry BlockCache::Allocate(const CacheKey& key, size_t val_size) {
@@ -75,22 +197,125 @@ BlockCache::PendingEntry BlockCache::Allocate(const CacheKey& key, size_t val_si
 
 bool BlockCache::Lookup(const CacheKey& key, Cache::CacheBehavior behavior,
                         BlockCacheHandle *handle) {
-  Cache::Handle *h = cache_->Lookup(Slice(reinterpret_cast<const uint8_t*>(&key),
-                                          sizeof(key)), behavior);
+  Slice key_slice(reinterpret_cast<const uint8_t*>(&key), sizeof(key));
+  if (dram_tier_) {
+    Cache::Handle* h = dram_tier_->Lookup(key_slice, behavior);
+    if (h != nullptr) {
+      handle->SetHandle(dram_tier_.get(), h);
+      CacheMetrics* metrics = tier_metrics_.get();
+      if (PREDICT_TRUE(metrics)) {
+        metrics->dram_tier_hits->Increment();
+      }
+      return true;
+    }
+  }
+  Cache::Handle *h = cache_->Lookup(key_slice, behavior);
+  if (h == nullptr) {
+    return false;
+  }
+  handle->SetHandle(cache_.get(), h);
+  if (dram_tier_) {
+    PromoteToDramTier(key_slice, handle);
+  }
+  return true;
+}
+
+void BlockCache::PromoteToDramTier(const Slice& key, BlockCacheHandle* handle) {
+  Slice data = handle->data();
+  Cache::PendingHandle* ph = dram_tier_->Allocate(key, data.size(), data.size());
+  if (ph == nullptr) {
+    return;
+  }
+  memcpy(dram_tier_->MutableValue(ph), data.data(), data.size());
+  handle->SetHandle(dram_tier_.get(), dram_tier_->Insert(ph, /* eviction_callback= */ nullptr));
+}
+
+void BlockCache::Insert(BlockCache::PendingEntry* entry, BlockCacheHandle* inserted,
+                        Cache::Priority priority) {
+  Cache::Handle *h = cache_->Insert(entry->handle_, /* eviction_callback= */ nullptr,
+                                    priority);
+  entry->handle_ = nullptr;
+  inserted->SetHandle(cache_.get(), h);
+}
+
+bool BlockCache::LookupCompressed(const CacheKey& key, Cache::CacheBehavior behavior,
+                                  BlockCacheHandle *handle) {
+  DCHECK(has_compressed_tier());
+  Cache::Handle *h = compressed_cache_->Lookup(
+      Slice(reinterpret_cast<const uint8_t*>(&key), sizeof(key)), behavior);
   if (h != nullptr) {
-    handle->SetHandle(cache_.get(), h);
+    handle->SetHandle(compressed_cache_.get(), h);
+  }
+  CacheMetrics* metrics = tier_metrics_.get();
+  if (PREDICT_TRUE(metrics) && behavior == Cache::EXPECT_IN_CACHE) {
+    if (h != nullptr) {
+      metrics->compressed_tier_hits->Increment();
+    } else {
+      metrics->compressed_tier_misses->Increment();
+    }
   }
   return h != nullptr;
 }
 
-void BlockCache::Insert(BlockCache::PendingEntry* entry, BlockCacheHandle* inserted) {
-  Cache::Handle *h = cache_->Insert(entry->handle_, /* eviction_callback= */ nullptr);
+BlockCache::PendingEntry BlockCache::AllocateCompressed(const CacheKey& key, size_t val_size) {
+  DCHECK(has_compressed_tier());
+  Slice key_slice(reinterpret_cast<const uint8_t*>(&key), sizeof(key));
+  int charge = val_size;
+  return PendingEntry(compressed_cache_.get(),
+                      compressed_cache_->Allocate(key_slice, val_size, charge));
+}
+
+void BlockCache::InsertCompressed(BlockCache::PendingEntry* entry, BlockCacheHandle* inserted) {
+  DCHECK(has_compressed_tier());
+  DCHECK_EQ(entry->cache_, compressed_cache_.get());
+  Cache::Handle *h = compressed_cache_->Insert(entry->handle_, compressed_eviction_cb_.get());
   entry->handle_ = nullptr;
-  inserted->SetHandle(cache_.get(), h);
+  inserted->SetHandle(compressed_cache_.get(), h);
+  CacheMetrics* metrics = tier_metrics_.get();
+  if (PREDICT_TRUE(metrics)) {
+    metrics->compressed_tier_usage->IncrementBy(inserted->data().size());
+    metrics->compressed_tier_inserts->Increment();
+  }
+}
+
+void BlockCache::EraseFilesIf(const std::function<bool(uint64_t file_id)>& is_stale) {
+  cache_->EraseMatching([&](const Slice& key) {
+      CacheKey k(FileId(0), 0);
+      if (key.size() != sizeof(k)) {
+        return false;
+      }
+      memcpy(&k, key.data(), sizeof(k));
+      return is_stale(k.file_id_);
+    });
+}
+
+void BlockCache::EraseMissingFiles(const std::function<bool(const FileId&)>& exists) {
+  std::unordered_map<uint64_t, bool> missing;
+  EraseFilesIf([&](uint64_t file_id) {
+      auto it = missing.find(file_id);
+      if (it == missing.end()) {
+        it = missing.emplace(file_id, !exists(FileId(file_id))).first;
+      }
+      return it->second;
+    });
+}
+
+void BlockCache::InvalidateFiles(const std::vector<FileId>& files) {
+  if (files.empty()) {
+    return;
+  }
+  std::unordered_set<uint64_t> ids;
+  for (const FileId& f : files) {
+    ids.insert(f.id());
+  }
+  EraseFilesIf([&](uint64_t file_id) { return ContainsKey(ids, file_id); });
 }
 
 void BlockCache::StartInstrumentation(const scoped_refptr<MetricEntity>& metric_entity) {
   cache_->SetMetrics(metric_entity);
+  if (has_compressed_tier() || dram_tier_) {
+    tier_metrics_.reset(new CacheMetrics(metric_entity));
+  }
 }
 
 } // namespace cfile
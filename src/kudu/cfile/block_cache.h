@@ -18,6 +18,9 @@
 #define KUDU_CFILE_BLOCK_CACHE_H
 
 #include <algorithm>
+#include <functional>
+#include <vector>
+
 #include <glog/logging.h>
 
 #include "kudu/fs/block_id.h"
@@ -30,6 +33,7 @@ DECLARE_string(block_cache_type);
 
 namespace kudu {
 
+struct CacheMetrics;
 class MetricRegistry;
 
 namespace cfile {
@@ -38,6 +42,16 @@ class BlockCacheHandle;
 
 // Wrapper around kudu::Cache specifically for caching blocks of CFiles.
 // Provides a singleton and LRU cache for CFile blocks.
+//
+// Optionally, blocks of compressed CFiles are also cached as they are stored
+// on disk, in a separate "compressed tier" behind the main cache of
+// decompressed blocks. Since compressed blocks are several times smaller, the
+// compressed tier covers more of the data for the same memory, and a miss in
+// the main cache can then be served by decompressing instead of reading from
+// disk.
+//
+// With an NVM main cache, a DRAM tier may also sit in front of it, holding
+// copies of the blocks most recently read from NVM.
 class BlockCache {
  public:
   // BlockId refers to the unique identifier for a Kudu block, that is, for an
@@ -109,8 +123,19 @@ class BlockCache {
     return Singleton<BlockCache>::get();
   }
 
+  // Returns whether cfile data should be read with direct I/O, bypassing
+  // the page cache: only if requested with --block_cache_direct_reads and
+  // the configured cache is large enough to take over from the page cache.
+  static bool ShouldUseDirectReads();
+
   explicit BlockCache(size_t capacity);
 
+  // Create a block cache with a compressed tier of 'compressed_capacity'
+  // bytes, or none if 'compressed_capacity' is 0.
+  BlockCache(size_t capacity, size_t compressed_capacity);
+
+  ~BlockCache();
+
   // Lookup the given block in the cache.
   //
   // If the entry is found, then sets *handle to refer to the entry.
@@ -149,16 +174,68 @@ class BlockCache {
   PendingEntry Allocate(const CacheKey& key, size_t block_size);
 
   // Insert the given block into the cache. 'inserted' is set to refer to the
-  // entry in the cache.
-  void Insert(PendingEntry* entry, BlockCacheHandle* inserted);
+  // entry in the cache. Blocks which are consulted by many lookups, such as
+  // index and bloom blocks, should be inserted with HIGH_PRIORITY.
+  void Insert(PendingEntry* entry, BlockCacheHandle* inserted,
+              Cache::Priority priority = Cache::NORMAL_PRIORITY);
+
+  // Compressed tier
+  // --------------------
+  // Return true if the cache has a compressed tier.
+  bool has_compressed_tier() const {
+    return compressed_cache_ != nullptr;
+  }
+
+  // Same as Lookup(), Allocate() and Insert() above, but for the compressed
+  // tier. The entries of the compressed tier are the blocks as they were read
+  // from disk. Must only be called if has_compressed_tier() is true.
+  bool LookupCompressed(const CacheKey& key, Cache::CacheBehavior behavior,
+                        BlockCacheHandle* handle);
+  PendingEntry AllocateCompressed(const CacheKey& key, size_t block_size);
+  void InsertCompressed(PendingEntry* entry, BlockCacheHandle* inserted);
+
+  // Invalidation
+  // --------------------
+  // Erases the entries of the files for which 'exists' returns false, which
+  // is called once per file. A persistent NVM cache (--nvm_cache_persistent)
+  // may have recovered entries of blocks which were deleted while the server
+  // was down, and whose IDs may be reused, so this must be called once the
+  // block manager is open, before the cache serves any lookups.
+  void EraseMissingFiles(const std::function<bool(const FileId&)>& exists);
+
+  // Erases the entries of 'files', which were deleted.
+  void InvalidateFiles(const std::vector<FileId>& files);
 
  private:
   friend class Singleton<BlockCache>;
   BlockCache();
 
+  class CompressedTierEvictionCallback;
+
+  // Erases the entries of the main cache whose file 'is_stale' returns true
+  // for. Only caches whose entries may outlive their files implement it (see
+  // Cache::EraseMatching()).
+  void EraseFilesIf(const std::function<bool(uint64_t file_id)>& is_stale);
+
+  // Copies the block held by 'handle', which must be an entry of the main
+  // cache, into the DRAM tier, and sets 'handle' to the copy, if there's
+  // room for it.
+  void PromoteToDramTier(const Slice& key, BlockCacheHandle* handle);
+
   DISALLOW_COPY_AND_ASSIGN(BlockCache);
 
   gscoped_ptr<Cache> cache_;
+
+  // The compressed tier, or NULL if there is none.
+  gscoped_ptr<Cache> compressed_cache_;
+  gscoped_ptr<CompressedTierEvictionCallback> compressed_eviction_cb_;
+
+  // The DRAM tier in front of an NVM main cache, or NULL if there is none.
+  gscoped_ptr<Cache> dram_tier_;
+
+  // Metrics of the compressed and DRAM tiers. The metrics of the main cache
+  // are kept by 'cache_' itself. NULL until StartInstrumentation() is called.
+  gscoped_ptr<CacheMetrics> tier_metrics_;
 };
 
 // Scoped reference to a block from the block cache.
@@ -192,6 +192,24 @@ class BlockDecoder {
   DISALLOW_COPY_AND_ASSIGN(BlockDecoder);
 };
 
+// Evaluates 'pred' against the 'n' values which were just copied into 'dst',
+// clearing the bits in 'sel' of the rows that don't satisfy it. Rows which
+// were already deselected are not evaluated.
+//
+// Used by the decoders of fixed-size types to evaluate predicates while the
+// decoded values are still hot in cache.
+template <DataType Type>
+void EvaluateCopiedValues(const ColumnPredicate& pred, size_t n,
+                          SelectionVectorView* sel, const ColumnDataView& dst) {
+  const uint8_t* cell = dst.data();
+  const size_t stride = dst.stride();
+  for (size_t i = 0; i < n; i++, cell += stride) {
+    if (sel->TestBit(i) && !pred.EvaluateCell<Type>(cell)) {
+      sel->ClearBit(i);
+    }
+  }
+}
+
 } // namespace cfile
 } // namespace kudu
 
@@ -18,6 +18,8 @@
 #ifndef KUDU_CFILE_BLOCK_HANDLE_H
 #define KUDU_CFILE_BLOCK_HANDLE_H
 
+#include <glog/logging.h>
+
 #include "kudu/cfile/block_cache.h"
 
 namespace kudu {
@@ -34,8 +36,10 @@ class BlockHandle {
     return BlockHandle(data);
   }
 
-  static BlockHandle WithDataFromCache(BlockCacheHandle *handle) {
-    return BlockHandle(handle);
+  // The last 'trailer_size' bytes of the cached data, e.g. a checksum
+  // trailer cached along with the block, aren't part of the block.
+  static BlockHandle WithDataFromCache(BlockCacheHandle *handle, size_t trailer_size = 0) {
+    return BlockHandle(handle, trailer_size);
   }
 
   // Constructor to use to Pass to.
@@ -56,11 +60,7 @@ class BlockHandle {
   }
 
   Slice data() const {
-    if (is_data_owner_) {
-      return data_;
-    } else {
-      return dblk_data_.data();
-    }
+    return data_;
   }
 
  private:
@@ -73,21 +73,25 @@ class BlockHandle {
         is_data_owner_(true) {
   }
 
-  explicit BlockHandle(BlockCacheHandle *dblk_data)
+  BlockHandle(BlockCacheHandle *dblk_data, size_t trailer_size)
     : is_data_owner_(false) {
     dblk_data_.swap(dblk_data);
+    data_ = dblk_data_.data();
+    DCHECK_GE(data_.size(), trailer_size);
+    data_.truncate(data_.size() - trailer_size);
   }
 
   void TakeState(BlockHandle* other) {
     Reset();
 
     is_data_owner_ = other->is_data_owner_;
+    data_ = other->data_;
     if (is_data_owner_) {
-      data_ = other->data_;
       other->is_data_owner_ = false;
     } else {
       dblk_data_.swap(&other->dblk_data_);
     }
+    other->data_ = "";
   }
 
   void Reset() {
@@ -0,0 +1,191 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/cfile/block_readahead.h"
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/bind.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/util/async_io.h"
+#include "kudu/util/mem_tracker.h"
+
+using std::shared_ptr;
+using std::unique_ptr;
+using std::vector;
+
+namespace kudu {
+namespace cfile {
+
+struct BlockReadahead::Entry {
+  explicit Entry(const BlockPointer& ptr)
+    : ptr(ptr),
+      submitted(false),
+      done(false),
+      discarded(false),
+      memory_consumed(ptr.size()) {
+  }
+
+  const BlockPointer ptr;
+
+  // Whether the read was submitted, rather than waiting in 'pending_'.
+  bool submitted;
+
+  // Whether the read has finished, successfully or not.
+  bool done;
+
+  // Whether the entry was discarded while its read was in flight. Such
+  // entries are owned by the read, and freed when it finishes.
+  bool discarded;
+
+  Status status;
+
+  // Set by the read, and only used once it is done.
+  BlockHandle handle;
+
+  // The number of bytes charged to the MemTracker for this block: its size
+  // on disk until it is read, and then the size of its data.
+  int64_t memory_consumed;
+};
+
+BlockReadahead::BlockReadahead(const CFileReader* reader,
+                               CFileReader::CacheControl cache_control,
+                               shared_ptr<MemTracker> mem_tracker)
+  : reader_(reader),
+    cache_control_(cache_control),
+    mem_tracker_(std::move(mem_tracker)),
+    read_done_(&lock_),
+    num_reading_(0) {
+}
+
+BlockReadahead::~BlockReadahead() {
+  Clear();
+  MutexLock l(lock_);
+  while (num_reading_ > 0) {
+    read_done_.Wait();
+  }
+}
+
+bool BlockReadahead::Prefetch(const BlockPointer& ptr) {
+  MutexLock l(lock_);
+  if (ContainsKey(entries_, ptr.offset())) {
+    return true;
+  }
+  unique_ptr<Entry> entry(new Entry(ptr));
+  if (!mem_tracker_->TryConsume(entry->memory_consumed)) {
+    return false;
+  }
+  pending_.push_back(entry.get());
+  entries_[ptr.offset()] = std::move(entry);
+  return true;
+}
+
+void BlockReadahead::Submit() {
+  MutexLock l(lock_);
+  SubmitUnlocked();
+}
+
+void BlockReadahead::SubmitUnlocked() {
+  lock_.AssertAcquired();
+  if (pending_.empty()) {
+    return;
+  }
+  vector<AsyncIo::Request> requests;
+  requests.reserve(pending_.size());
+  for (Entry* entry : pending_) {
+    entry->submitted = true;
+    requests.push_back(AsyncIo::Request::Custom(
+        Bind(&BlockReadahead::ReadBlock, Unretained(this), Unretained(entry)),
+        Bind(&BlockReadahead::ReadDone, Unretained(this), Unretained(entry))));
+  }
+  num_reading_ += pending_.size();
+  pending_.clear();
+  AsyncIo::Default()->Submit(requests);
+}
+
+bool BlockReadahead::Take(const BlockPointer& ptr, BlockHandle* handle, Status* s) {
+  MutexLock l(lock_);
+  auto it = entries_.find(ptr.offset());
+  if (it == entries_.end()) {
+    return false;
+  }
+  unique_ptr<Entry> entry(std::move(it->second));
+  entries_.erase(it);
+  DCHECK_EQ(entry->ptr.size(), ptr.size());
+  if (!entry->submitted) {
+    SubmitUnlocked();
+  }
+  while (!entry->done) {
+    read_done_.Wait();
+  }
+  mem_tracker_->Release(entry->memory_consumed);
+  *handle = std::move(entry->handle);
+  *s = entry->status;
+  return true;
+}
+
+void BlockReadahead::Clear() {
+  MutexLock l(lock_);
+  for (auto& e : entries_) {
+    DiscardUnlocked(std::move(e.second));
+  }
+  entries_.clear();
+}
+
+void BlockReadahead::DiscardUnlocked(unique_ptr<Entry> entry) {
+  lock_.AssertAcquired();
+  if (!entry->submitted) {
+    pending_.erase(std::find(pending_.begin(), pending_.end(), entry.get()));
+    mem_tracker_->Release(entry->memory_consumed);
+  } else if (entry->done) {
+    mem_tracker_->Release(entry->memory_consumed);
+  } else {
+    entry->discarded = true;
+    ignore_result(entry.release());
+  }
+}
+
+Status BlockReadahead::ReadBlock(Entry* entry) {
+  return reader_->ReadBlock(entry->ptr, cache_control_, &entry->handle);
+}
+
+void BlockReadahead::ReadDone(Entry* entry, const Status& s) {
+  MutexLock l(lock_);
+  num_reading_--;
+  if (entry->discarded) {
+    mem_tracker_->Release(entry->memory_consumed);
+    delete entry;
+  } else {
+    // Charge the block's actual size, which differs from its size on disk
+    // if it is compressed.
+    int64_t delta = entry->handle.data().size() - entry->memory_consumed;
+    if (delta > 0) {
+      mem_tracker_->Consume(delta);
+    } else {
+      mem_tracker_->Release(-delta);
+    }
+    entry->memory_consumed += delta;
+    entry->status = s;
+    entry->done = true;
+  }
+  read_done_.Broadcast();
+}
+
+} // namespace cfile
+} // namespace kudu
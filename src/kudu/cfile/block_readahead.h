@@ -0,0 +1,112 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CFILE_BLOCK_READAHEAD_H
+#define KUDU_CFILE_BLOCK_READAHEAD_H
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "kudu/cfile/block_handle.h"
+#include "kudu/cfile/block_pointer.h"
+#include "kudu/cfile/cfile_reader.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/mutex.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class MemTracker;
+
+namespace cfile {
+
+// Reads data blocks of a cfile in the background, ahead of a sequential
+// scan. The reads are submitted in batches to the process-wide AsyncIo, so
+// that the scans of all cfiles together keep many reads in flight.
+//
+// The blocks held by the readahead, read or still being read, are charged to
+// a MemTracker. Once its limit is reached, no more blocks are prefetched
+// until some are taken or discarded.
+//
+// This class is not thread-safe: it is meant to be used by a single
+// CFileIterator.
+class BlockReadahead {
+ public:
+  BlockReadahead(const CFileReader* reader,
+                 CFileReader::CacheControl cache_control,
+                 std::shared_ptr<MemTracker> mem_tracker);
+
+  // Waits for any reads still in flight.
+  ~BlockReadahead();
+
+  // Queue the block at 'ptr' to be read in the background, once Submit() is
+  // called. Returns false if the memory budget is exhausted.
+  bool Prefetch(const BlockPointer& ptr);
+
+  // Start reading the blocks queued by Prefetch(), as a single batch.
+  void Submit();
+
+  // If the block at 'ptr' was prefetched, wait for its read to finish, set
+  // 'handle' and 's' to its result, and return true. Otherwise, returns false.
+  bool Take(const BlockPointer& ptr, BlockHandle* handle, Status* s);
+
+  // Discard all prefetched blocks.
+  void Clear();
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(BlockReadahead);
+
+  struct Entry;
+
+  // Submit the reads of 'pending_'. 'lock_' must be held.
+  void SubmitUnlocked();
+
+  // Read the block of 'entry'. Runs on an I/O thread.
+  Status ReadBlock(Entry* entry);
+
+  // Called on an I/O thread once the read of 'entry' finished with 's'.
+  void ReadDone(Entry* entry, const Status& s);
+
+  // Drop 'entry', which must no longer be in 'entries_'. If its read is still
+  // in flight, the entry is freed once the read finishes. 'lock_' must be held.
+  void DiscardUnlocked(std::unique_ptr<Entry> entry);
+
+  const CFileReader* const reader_;
+  const CFileReader::CacheControl cache_control_;
+  const std::shared_ptr<MemTracker> mem_tracker_;
+
+  // Protects the fields below, and the entries they point to.
+  Mutex lock_;
+  // Signalled when a read finishes.
+  ConditionVariable read_done_;
+
+  // Blocks which were prefetched and not yet taken or discarded, keyed by
+  // their offset in the cfile.
+  std::map<uint64_t, std::unique_ptr<Entry> > entries_;
+
+  // The entries of 'entries_' whose reads were not submitted yet.
+  std::vector<Entry*> pending_;
+
+  // The number of reads in flight, including those of discarded entries.
+  int num_reading_;
+};
+
+} // namespace cfile
+} // namespace kudu
+
+#endif
@@ -66,6 +66,12 @@ TEST_F(BloomFileTest, TestWriteAndRead) {
   VerifyBloomFile();
 }
 
+TEST_F(BloomFileTest, TestWriteAndReadBlocked) {
+  ASSERT_NO_FATAL_FAILURE(WriteTestBloomFile(BLOCKED_BLOOM_LAYOUT));
+  ASSERT_OK(OpenBloomFile());
+  VerifyBloomFile();
+}
+
 #ifdef NDEBUG
 TEST_F(BloomFileTest, Benchmark) {
   ASSERT_NO_FATAL_FAILURE(WriteTestBloomFile());
@@ -19,6 +19,7 @@
 #include <sched.h>
 #include <string>
 #include <unistd.h>
+#include <vector>
 
 #include "kudu/cfile/bloomfile.h"
 #include "kudu/cfile/cfile_writer.h"
@@ -110,7 +111,12 @@ Status BloomFileWriter::FinishCurrentBloomBlock() {
 
   // Encode the header.
   BloomBlockHeaderPB hdr;
-  hdr.set_num_hash_functions(bloom_builder_.n_hashes());
+  if (bloom_builder_.layout() == BLOCKED_BLOOM_LAYOUT) {
+    hdr.set_layout(BloomBlockHeaderPB::BLOCKED);
+    hdr.set_num_hash_functions(0);
+  } else {
+    hdr.set_num_hash_functions(bloom_builder_.n_hashes());
+  }
   faststring hdr_str;
   PutFixed32(&hdr_str, hdr.ByteSize());
   CHECK(pb_util::AppendToString(hdr, &hdr_str));
@@ -233,6 +239,12 @@ Status BloomFileReader::ParseBlockHeader(const Slice &block,
   }
 
   data.remove_prefix(header_len);
+  if (hdr->layout() == BloomBlockHeaderPB::BLOCKED &&
+      (data.empty() || data.size() % BloomFilter::kBlockedLineBytes != 0)) {
+    return Status::Corruption(
+      StringPrintf("Blocked bloom filter of %ld bytes is not a whole number of lines",
+                   data.size()));
+  }
   *bloom_data = data;
   return Status::OK();
 }
@@ -274,7 +286,8 @@ Status BloomFileReader::CheckKeyPresent(const BloomKeyProbe &probe,
   }
 
   BlockHandle dblk_data;
-  RETURN_NOT_OK(reader_->ReadBlock(bblk_ptr, CFileReader::CACHE_BLOCK, &dblk_data));
+  RETURN_NOT_OK(reader_->ReadBlock(bblk_ptr, CFileReader::CACHE_BLOCK, &dblk_data,
+                                   Cache::HIGH_PRIORITY));
 
   // Parse the header in the block.
   BloomBlockHeaderPB hdr;
@@ -282,11 +295,91 @@ Status BloomFileReader::CheckKeyPresent(const BloomKeyProbe &probe,
   RETURN_NOT_OK(ParseBlockHeader(dblk_data.data(), &hdr, &bloom_data));
 
   // Actually check the bloom filter.
-  BloomFilter bf(bloom_data, hdr.num_hash_functions());
+  BloomFilter bf(bloom_data, hdr.num_hash_functions(),
+                 hdr.layout() == BloomBlockHeaderPB::BLOCKED ?
+                 BLOCKED_BLOOM_LAYOUT : CLASSIC_BLOOM_LAYOUT);
   *maybe_present = bf.MayContainKey(probe);
   return Status::OK();
 }
 
+Status BloomFileReader::CheckKeysPresent(const BloomKeyProbe* const* probes, size_t n,
+                                         bool* maybe_present) {
+  DCHECK(init_once_.initted());
+  if (n == 0) {
+    return Status::OK();
+  }
+
+#if defined(__linux__)
+  int cpu = sched_getcpu();
+#else
+  // Use just one lock if on OS X.
+  int cpu = 0;
+#endif
+
+  // First resolve the bloom block for every key while holding the iterator.
+  // Keys which sort before the first entry in the file are definitely absent
+  // and get no block.
+  std::vector<BlockPointer> bblk_ptrs(n);
+  std::vector<bool> has_block(n);
+  {
+    std::unique_lock<simple_spinlock> lock;
+    while (true) {
+      std::unique_lock<simple_spinlock> l(iter_locks_[cpu], std::try_to_lock);
+      if (l.owns_lock()) {
+        lock.swap(l);
+        break;
+      }
+      cpu = (cpu + 1) % index_iters_.size();
+    }
+
+    cfile::IndexTreeIterator *index_iter = index_iters_[cpu].get();
+    for (size_t i = 0; i < n; i++) {
+      DCHECK(i == 0 || probes[i - 1]->key().compare(probes[i]->key()) <= 0)
+          << "probes must be sorted by key";
+      Status s = index_iter->SeekAtOrBefore(probes[i]->key());
+      if (PREDICT_FALSE(s.IsNotFound())) {
+        has_block[i] = false;
+        continue;
+      }
+      RETURN_NOT_OK(s);
+      bblk_ptrs[i] = index_iter->GetCurrentBlockPointer();
+      has_block[i] = true;
+    }
+  }
+
+  // Then check each run of keys which share a block against that block,
+  // prefetching the next key's bits while testing the current one.
+  size_t i = 0;
+  while (i < n) {
+    if (!has_block[i]) {
+      maybe_present[i++] = false;
+      continue;
+    }
+    size_t run_end = i + 1;
+    while (run_end < n && has_block[run_end] &&
+           bblk_ptrs[run_end].offset() == bblk_ptrs[i].offset()) {
+      run_end++;
+    }
+
+    BlockHandle dblk_data;
+    RETURN_NOT_OK(reader_->ReadBlock(bblk_ptrs[i], CFileReader::CACHE_BLOCK, &dblk_data,
+                                     Cache::HIGH_PRIORITY));
+    BloomBlockHeaderPB hdr;
+    Slice bloom_data;
+    RETURN_NOT_OK(ParseBlockHeader(dblk_data.data(), &hdr, &bloom_data));
+    BloomFilter bf(bloom_data, hdr.num_hash_functions(),
+                   hdr.layout() == BloomBlockHeaderPB::BLOCKED ?
+                   BLOCKED_BLOOM_LAYOUT : CLASSIC_BLOOM_LAYOUT);
+    for (; i < run_end; i++) {
+      if (i + 1 < run_end) {
+        bf.Prefetch(*probes[i + 1]);
+      }
+      maybe_present[i] = bf.MayContainKey(*probes[i]);
+    }
+  }
+  return Status::OK();
+}
+
 size_t BloomFileReader::memory_footprint_excluding_reader() const {
   size_t size = kudu_malloc_usable_size(this);
 
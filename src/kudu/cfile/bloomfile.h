@@ -103,6 +103,15 @@ class BloomFileReader {
   Status CheckKeyPresent(const BloomKeyProbe &probe,
                          bool *maybe_present);
 
+  // Check a batch of 'n' keys against the bloom file, setting
+  // maybe_present[i] as CheckKeyPresent() would for probes[i].
+  //
+  // The probes must be sorted by key. The index is seeked for the whole batch
+  // under a single lock acquisition, and each bloom block is read and parsed
+  // only once for the run of consecutive keys which map to it.
+  Status CheckKeysPresent(const BloomKeyProbe* const* probes, size_t n,
+                          bool* maybe_present);
+
  private:
   DISALLOW_COPY_AND_ASSIGN(BloomFileReader);
 
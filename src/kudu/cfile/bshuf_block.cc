@@ -82,29 +82,10 @@ Slice BShufBlockBuilder<UINT32>::Finish(rowid_t ordinal_pos) {
   return ret;
 }
 
-// Template specialization for UINT32, dynamically decoded blocks of
-// bitshuffled UINT16 OR UINT8 to UINT32.
-template<>
-Status BShufBlockDecoder<UINT32>::Expand() {
-  if (num_elems_ > 0) {
-    int64_t bytes;
-    decoded_.resize(num_elems_after_padding_ * size_of_elem_);
-    uint8_t* in = const_cast<uint8_t*>(&data_[kHeaderSize]);
-
-    bytes = bshuf_decompress_lz4(in, decoded_.data(), num_elems_after_padding_, size_of_elem_, 0);
-    if (PREDICT_FALSE(bytes < 0)) {
-      // Ideally, this should not happen.
-      AbortWithBitShuffleError(bytes);
-      return Status::RuntimeError("Unshuffle Process failed");
-    }
-  }
-
-  return Status::OK();
-}
-
 // Template specialization for UINT32.
 template<>
 Status BShufBlockDecoder<UINT32>::SeekAtOrAfterValue(const void* value_void, bool* exact) {
+  RETURN_NOT_OK(EnsureExpanded());
   uint32_t target = *reinterpret_cast<const uint32_t*>(value_void);
   int32_t left = 0;
   int32_t right = num_elems_;
@@ -154,6 +135,8 @@ Status BShufBlockDecoder<UINT32>::CopyNextValuesToArray(size_t* n, uint8_t* arra
     return Status::OK();
   }
 
+  RETURN_NOT_OK(EnsureExpanded());
+
   // First, copy it to the destination array without any "expansion".
   size_t max_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
   memcpy(array, &decoded_[cur_idx_ * size_of_elem_], max_fetch * size_of_elem_);
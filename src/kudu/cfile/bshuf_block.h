@@ -188,7 +188,8 @@ class BShufBlockDecoder : public BlockDecoder {
         num_elems_(0),
         compressed_size_(0),
         num_elems_after_padding_(0),
-        cur_idx_(0) {
+        cur_idx_(0),
+        expanded_(false) {
   }
 
   Status ParseHeader() OVERRIDE {
@@ -231,8 +232,8 @@ class BShufBlockDecoder : public BlockDecoder {
                                                     size_of_elem_, size_of_type));
     }
 
-    RETURN_NOT_OK(Expand());
-
+    // The block is unshuffled lazily: CopyNextValues() may be able to
+    // unshuffle it directly into the caller's buffer.
     parsed_ = true;
     return Status::OK();
   }
@@ -249,6 +250,7 @@ class BShufBlockDecoder : public BlockDecoder {
   }
 
   Status SeekAtOrAfterValue(const void* value_void, bool* exact) OVERRIDE {
+    RETURN_NOT_OK(EnsureExpanded());
     CppType target = *reinterpret_cast<const CppType*>(value_void);
     int32_t left = 0;
     int32_t right = num_elems_;
@@ -277,9 +279,29 @@ class BShufBlockDecoder : public BlockDecoder {
 
   Status CopyNextValues(size_t* n, ColumnDataView* dst) OVERRIDE {
     DCHECK_EQ(dst->stride(), sizeof(CppType));
+    // If this call consumes the whole block and the destination has room for
+    // the padding elements, unshuffle straight into it rather than
+    // unshuffling into 'decoded_' and copying out of it.
+    if (!expanded_ && cur_idx_ == 0 && num_elems_ > 0 && *n >= num_elems_ &&
+        size_of_elem_ == size_of_type && dst->nrows() >= num_elems_after_padding_) {
+      RETURN_NOT_OK(Unshuffle(dst->data()));
+      *n = num_elems_;
+      cur_idx_ = num_elems_;
+      return Status::OK();
+    }
     return CopyNextValuesToArray(n, dst->data());
   }
 
+  Status CopyNextAndEval(size_t* n,
+                         ColumnMaterializationContext* ctx,
+                         SelectionVectorView* sel,
+                         ColumnDataView* dst) OVERRIDE {
+    ctx->SetDecoderEvalSupported();
+    RETURN_NOT_OK(CopyNextValues(n, dst));
+    EvaluateCopiedValues<Type>(*ctx->pred(), *n, sel, *dst);
+    return Status::OK();
+  }
+
   // Copy the codewords to a temporary buffer.
   // This API provides a more convenient way for the dictionary decoder to copy out
   // integer codewords and then look up the strings. If we use the CopyNextValuesToArray()
@@ -292,6 +314,7 @@ class BShufBlockDecoder : public BlockDecoder {
       return Status::OK();
     }
 
+    RETURN_NOT_OK(EnsureExpanded());
     size_t max_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
     memcpy(array, &decoded_[cur_idx_ * size_of_type], max_fetch * size_of_type);
 
@@ -332,17 +355,28 @@ class BShufBlockDecoder : public BlockDecoder {
     return KUDU_ALIGN_UP(num_elems_, 8) - num_elems_;
   }
 
-  Status Expand() {
-    if (num_elems_ > 0) {
-      int64_t bytes;
-      decoded_.resize(num_elems_after_padding_ * size_of_type);
-      uint8_t* in = const_cast<uint8_t*>(&data_[kHeaderSize]);
-      bytes = bshuf_decompress_lz4(in, decoded_.data(), num_elems_after_padding_, size_of_type, 0);
-      if (PREDICT_FALSE(bytes < 0)) {
-        // Ideally, this should not happen.
-        AbortWithBitShuffleError(bytes);
-        return Status::RuntimeError("Unshuffle Process failed");
+  // Unshuffle all of the block's elements, including padding, into 'out',
+  // which must have room for num_elems_after_padding_ elements of
+  // size_of_elem_ bytes.
+  Status Unshuffle(uint8_t* out) {
+    uint8_t* in = const_cast<uint8_t*>(&data_[kHeaderSize]);
+    int64_t bytes = bshuf_decompress_lz4(in, out, num_elems_after_padding_, size_of_elem_, 0);
+    if (PREDICT_FALSE(bytes < 0)) {
+      // Ideally, this should not happen.
+      AbortWithBitShuffleError(bytes);
+      return Status::RuntimeError("Unshuffle Process failed");
+    }
+    return Status::OK();
+  }
+
+  // Unshuffle the block into 'decoded_', if not already done.
+  Status EnsureExpanded() {
+    if (!expanded_) {
+      if (num_elems_ > 0) {
+        decoded_.resize(num_elems_after_padding_ * size_of_elem_);
+        RETURN_NOT_OK(Unshuffle(decoded_.data()));
       }
+      expanded_ = true;
     }
     return Status::OK();
   }
@@ -368,11 +402,12 @@ class BShufBlockDecoder : public BlockDecoder {
   int size_of_elem_;
 
   size_t cur_idx_;
+
+  // Whether 'decoded_' holds the unshuffled block.
+  bool expanded_;
   faststring decoded_;
 };
 
-template<>
-Status BShufBlockDecoder<UINT32>::Expand();
 template<>
 Status BShufBlockDecoder<UINT32>::SeekAtOrAfterValue(const void* value_void, bool* exact);
 template<>
@@ -305,13 +305,17 @@ class CFileTestBase : public KuduTest {
   // Place a ColumnBlock and SelectionVector into a context. This context will
   // not support decoder evaluation.
   ColumnMaterializationContext CreateNonDecoderEvalContext(ColumnBlock* cb, SelectionVector* sel) {
+    // Select every row so that all of the values are read.
+    sel->SetAllTrue();
     return ColumnMaterializationContext(0, nullptr, cb, sel);
   }
  protected:
   enum Flags {
     NO_FLAGS = 0,
     WRITE_VALIDX = 1,
-    SMALL_BLOCKSIZE = 1 << 1
+    SMALL_BLOCKSIZE = 1 << 1,
+    WRITE_ZONE_MAP = 1 << 2,
+    WRITE_VALUE_BLOOM = 1 << 3
   };
 
   template<class DataGeneratorType>
@@ -334,6 +338,12 @@ class CFileTestBase : public KuduTest {
       // Use a smaller block size to exercise multi-level indexing.
       opts.storage_attributes.cfile_block_size = 1024;
     }
+    if (flags & WRITE_ZONE_MAP) {
+      opts.write_zone_map = true;
+    }
+    if (flags & WRITE_VALUE_BLOOM) {
+      opts.storage_attributes.bloom_filter = true;
+    }
 
     opts.storage_attributes.encoding = encoding;
     opts.storage_attributes.compression = compression;
@@ -396,6 +406,7 @@ template<DataType Type, typename SumType>
 void TimeReadFileForDataType(gscoped_ptr<CFileIterator> &iter, int &count) {
   ScopedColumnBlock<Type> cb(8192);
   SelectionVector sel(cb.nrows());
+  sel.SetAllTrue();
   ColumnMaterializationContext ctx(0, nullptr, &cb, &sel);
   ctx.SetDecoderEvalNotSupported();
   SumType sum = 0;
@@ -414,6 +425,7 @@ template<DataType Type>
 void ReadBinaryFile(CFileIterator* iter, int* count) {
   ScopedColumnBlock<Type> cb(100);
   SelectionVector sel(cb.nrows());
+  sel.SetAllTrue();
   ColumnMaterializationContext ctx(0, nullptr, &cb, &sel);
   ctx.SetDecoderEvalNotSupported();
   uint64_t sum_lens = 0;
@@ -30,12 +30,18 @@
 #include "kudu/fs/fs-test-util.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/stringprintf.h"
+#include "kudu/util/hyperloglog.h"
+#include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/stopwatch.h"
 
 DECLARE_string(block_cache_type);
 DECLARE_string(cfile_do_on_finish);
+DECLARE_int32(cfile_hot_block_sample_interval);
+DECLARE_int32(cfile_value_index_directory_max_blocks);
+DECLARE_bool(cfile_verify_checksums);
+DECLARE_bool(cfile_write_checksums);
 
 #if defined(__linux__)
 DECLARE_string(nvm_cache_path);
@@ -142,6 +148,9 @@ class TestCFile : public CFileTestBase {
 
     TimeReadFile(fs_manager_.get(), block_id, &n);
     ASSERT_EQ(10000, n);
+
+    DataGeneratorType data_generator_sel;
+    ScanSelectedRows(&data_generator_sel, block_id, n);
   }
 
   template <class DataGeneratorType>
@@ -192,11 +201,117 @@ class TestCFile : public CFileTestBase {
     }
   }
 
+  // Seek to random points in the file, evaluating an IS NULL predicate on one
+  // batch and then reading the following batch's values, to check that the
+  // null-bitmap-only evaluation leaves the iterator positioned correctly.
+  template <class DataGeneratorType>
+  void ScanIsNullWithNulls(DataGeneratorType* generator,
+                           const BlockId& block_id, size_t num_entries) {
+    gscoped_ptr<ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+    gscoped_ptr<CFileReader> reader;
+    ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+
+    gscoped_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+
+    ColumnPredicate pred = ColumnPredicate::IsNull(
+        ColumnSchema("c", DataGeneratorType::kDataType, true));
+    ScopedColumnBlock<DataGeneratorType::kDataType> cb(10);
+    SelectionVector sel(10);
+    const int kNumLoops = AllowSlowTests() ? num_entries : 10;
+    for (int loop = 0; loop < kNumLoops; loop++) {
+      int target = AllowSlowTests() ? loop : (random() % (num_entries - 1));
+      SCOPED_TRACE(target);
+      ASSERT_OK(iter->SeekToOrdinal(target));
+
+      ColumnMaterializationContext is_null_ctx(0, &pred, &cb, &sel);
+      sel.SetAllTrue();
+      size_t n = cb.nrows();
+      ASSERT_OK_FAST(iter->CopyNextValues(&n, &is_null_ctx));
+      for (size_t j = 0; j < n; j++) {
+        bool expected_null = generator->TestValueShouldBeNull(target + j);
+        ASSERT_EQ(expected_null, cb.is_null(j));
+        ASSERT_EQ(expected_null, sel.IsRowSelected(j));
+      }
+      if (!iter->HasNext()) {
+        continue;
+      }
+
+      int read_offset = target + n;
+      ColumnMaterializationContext ctx = CreateNonDecoderEvalContext(&cb, &sel);
+      n = cb.nrows();
+      ASSERT_OK_FAST(iter->CopyNextValues(&n, &ctx));
+      generator->Build(read_offset, n);
+      for (size_t j = 0; j < n; j++) {
+        bool expected_null = generator->TestValueShouldBeNull(read_offset + j);
+        ASSERT_EQ(expected_null, cb.is_null(j));
+        if (!expected_null) {
+          ASSERT_EQ((*generator)[j], cb[j]);
+        }
+      }
+      cb.arena()->Reset();
+    }
+  }
+
+  // Scan the whole file with selection vectors in which only some of the rows
+  // are set, as happens when predicates on other columns filter them out, and
+  // check that the values of the selected rows are still read correctly.
+  template <class DataGeneratorType>
+  void ScanSelectedRows(DataGeneratorType* generator,
+                        const BlockId& block_id, size_t num_entries) {
+    gscoped_ptr<ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+    gscoped_ptr<CFileReader> reader;
+    ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+
+    gscoped_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+    ASSERT_OK(iter->SeekToFirst());
+
+    ScopedColumnBlock<DataGeneratorType::kDataType> cb(100);
+    SelectionVector sel(100);
+    size_t fetched = 0;
+    for (int batch = 0; iter->HasNext(); batch++) {
+      // Alternate between sparse selections, runs of selected rows and
+      // batches in which nothing is selected at all.
+      sel.SetAllFalse();
+      for (size_t j = 0; j < sel.nrows(); j++) {
+        bool selected = false;
+        switch (batch % 3) {
+          case 0: selected = (j % 7 == 0); break;
+          case 1: selected = ((j / 10) % 2 == 1); break;
+          default: break;
+        }
+        if (selected) {
+          BitmapSet(sel.mutable_bitmap(), j);
+        }
+      }
+      ColumnMaterializationContext ctx(0, nullptr, &cb, &sel);
+      size_t n = cb.nrows();
+      ASSERT_OK_FAST(iter->CopyNextValues(&n, &ctx));
+      generator->Build(fetched, n);
+      for (size_t j = 0; j < n; j++) {
+        if (!sel.IsRowSelected(j)) {
+          continue;
+        }
+        bool expected_null = generator->TestValueShouldBeNull(fetched + j);
+        ASSERT_EQ(expected_null, cb.is_null(j)) << "row " << (fetched + j);
+        if (!expected_null) {
+          ASSERT_EQ((*generator)[j], cb[j]) << "row " << (fetched + j);
+        }
+      }
+      fetched += n;
+      cb.arena()->Reset();
+    }
+    ASSERT_EQ(num_entries, fetched);
+  }
+
   template <class DataGeneratorType>
   void TestNullTypes(DataGeneratorType* generator, EncodingType encoding,
-                     CompressionType compression) {
+                     CompressionType compression, uint32_t flags = NO_FLAGS) {
     BlockId block_id;
-    WriteTestFile(generator, encoding, compression, 10000, SMALL_BLOCKSIZE, &block_id);
+    WriteTestFile(generator, encoding, compression, 10000, SMALL_BLOCKSIZE | flags, &block_id);
 
     size_t n;
     TimeReadFile(fs_manager_.get(), block_id, &n);
@@ -204,6 +319,12 @@ class TestCFile : public CFileTestBase {
 
     generator->Reset();
     TimeSeekAndReadFileWithNulls(generator, block_id, n);
+
+    generator->Reset();
+    ScanIsNullWithNulls(generator, block_id, n);
+
+    generator->Reset();
+    ScanSelectedRows(generator, block_id, n);
   }
 
 
@@ -337,6 +458,7 @@ void CopyOne(CFileIterator *it,
              Arena *arena) {
   ColumnBlock cb(GetTypeInfo(type), nullptr, ret, 1, arena);
   SelectionVector sel(1);
+  sel.SetAllTrue();
   ColumnMaterializationContext ctx(0, nullptr, &cb, &sel);
   ctx.SetDecoderEvalNotSupported();
   size_t n = 1;
@@ -613,6 +735,67 @@ TEST_P(TestCFileBothCacheTypes, TestReadWriteStringsDictEncoding) {
   TestReadWriteStrings(DICT_ENCODING);
 }
 
+// Test that point lookups through the value index directory find the same
+// rows as seeks through the value index, and that they fall back to the
+// value index when the directory is disabled.
+TEST_P(TestCFileBothCacheTypes, TestLookupKey) {
+  Schema schema({ ColumnSchema("key", STRING) }, 1);
+  const int nrows = 10000;
+  BlockId block_id;
+  StringDataGenerator<false> generator("hello %04zd");
+  WriteTestFile(&generator, PREFIX_ENCODING, NO_COMPRESSION, nrows,
+                SMALL_BLOCKSIZE | WRITE_VALIDX, &block_id);
+
+  for (int max_blocks : { 4096, 0 }) {
+    SCOPED_TRACE(max_blocks);
+    FLAGS_cfile_value_index_directory_max_blocks = max_blocks;
+    gscoped_ptr<ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+    gscoped_ptr<CFileReader> reader;
+    ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+    gscoped_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+    if (max_blocks > 0) {
+      ASSERT_TRUE(reader->GetValueIndexDirectory() != nullptr);
+      ASSERT_GT(reader->GetValueIndexDirectory()->num_blocks(), 1);
+    } else {
+      ASSERT_TRUE(reader->GetValueIndexDirectory() == nullptr);
+    }
+
+    gscoped_ptr<EncodedKey> encoded_key;
+    bool exact;
+    rowid_t ordinal;
+    for (int i = 0; i < nrows; i += 7) {
+      string buf = StringPrintf("hello %04d", i);
+      EncodeStringKey(schema, buf, &encoded_key);
+      ASSERT_OK(iter->LookupKey(*encoded_key, &exact, &ordinal));
+      ASSERT_TRUE(exact);
+      ASSERT_EQ(i, ordinal);
+
+      // Keys between the rows aren't matched.
+      buf.append(".5");
+      EncodeStringKey(schema, buf, &encoded_key);
+      ASSERT_OK(iter->LookupKey(*encoded_key, &exact, &ordinal));
+      ASSERT_FALSE(exact);
+    }
+
+    // Before the first row.
+    EncodeStringKey(schema, "hello", &encoded_key);
+    ASSERT_OK(iter->LookupKey(*encoded_key, &exact, &ordinal));
+    ASSERT_FALSE(exact);
+
+    // After the last row.
+    EncodeStringKey(schema, "hello 9999.x", &encoded_key);
+    ASSERT_OK(iter->LookupKey(*encoded_key, &exact, &ordinal));
+    ASSERT_FALSE(exact);
+
+    // The iterator can still be seeked after lookups.
+    ASSERT_FALSE(iter->seeked());
+    ASSERT_OK(iter->SeekToOrdinal(5000));
+    ASSERT_EQ(5000, iter->GetCurrentOrdinal());
+  }
+}
+
 // Regression test for properly handling cells that are larger
 // than the index block and/or data block size.
 //
@@ -738,6 +921,255 @@ TEST_P(TestCFileBothCacheTypes, TestNullInts) {
   UInt32DataGenerator<true> generator;
   TestNullTypes(&generator, GROUP_VARINT, NO_COMPRESSION);
   TestNullTypes(&generator, GROUP_VARINT, LZ4);
+  TestNullTypes(&generator, RLE, NO_COMPRESSION);
+  TestNullTypes(&generator, RLE, LZ4, WRITE_ZONE_MAP);
+}
+
+// Test that scans with a predicate skip over the data blocks whose zone map
+// entries show they cannot match, without reading them.
+TEST_P(TestCFileBothCacheTypes, TestZoneMapBlockSkipping) {
+  const int kNumEntries = 100000;
+  UInt32DataGenerator<false> generator;
+  BlockId block_id;
+  WriteTestFile(&generator, PLAIN_ENCODING, NO_COMPRESSION, kNumEntries,
+                SMALL_BLOCKSIZE | WRITE_ZONE_MAP, &block_id);
+
+  gscoped_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  gscoped_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+  ASSERT_TRUE(reader->footer().has_zone_map_block_ptr());
+  const ZoneMapEntryPB& file_zone = reader->footer().file_zone_map();
+  ASSERT_EQ(kNumEntries, file_zone.num_rows());
+  ASSERT_EQ(0, file_zone.null_count());
+
+  // Every value is distinct.
+  HyperLogLog sketch;
+  ASSERT_OK(HyperLogLog::Parse(reader->footer().ndv_sketch(), &sketch));
+  ASSERT_NEAR(kNumEntries, sketch.Estimate(), kNumEntries * 0.1);
+
+  // Values are 10 times the row index, so this matches rows 50000-50009,
+  // and the other predicate falls beyond the last value of the file.
+  uint32_t lower = 500000;
+  uint32_t upper = 500100;
+  uint32_t past_end = kNumEntries * 10;
+  ColumnSchema col("c", UINT32);
+  for (const auto& p : { std::make_pair(ColumnPredicate::Range(col, &lower, &upper), 10),
+                         std::make_pair(ColumnPredicate::Range(col, &past_end, nullptr), 0) }) {
+    SCOPED_TRACE(p.first.ToString());
+    gscoped_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+    ASSERT_OK(iter->SeekToFirst());
+
+    ScopedColumnBlock<UINT32> cb(1000);
+    SelectionVector sel(1000);
+    int matched = 0;
+    size_t fetched = 0;
+    while (iter->HasNext()) {
+      sel.SetAllTrue();
+      ColumnMaterializationContext ctx(0, &p.first, &cb, &sel);
+      size_t n = cb.nrows();
+      ASSERT_OK_FAST(iter->CopyNextValues(&n, &ctx));
+      for (size_t j = 0; j < n; j++) {
+        if (sel.IsRowSelected(j)) {
+          ASSERT_EQ((fetched + j) * 10, cb[j]);
+          matched++;
+        }
+      }
+      fetched += n;
+    }
+    ASSERT_EQ(kNumEntries, fetched);
+    ASSERT_EQ(p.second, matched);
+
+    // Only the block read by the seek and the block holding the matching
+    // rows should have been read, out of the hundreds in the file.
+    LOG(INFO) << "Read " << iter->io_statistics().data_blocks_read_from_disk << " blocks";
+    ASSERT_LE(iter->io_statistics().data_blocks_read_from_disk, 3);
+  }
+}
+
+// Test that scans with an equality or IN-list predicate skip the whole file
+// when its value bloom filter rules out the predicate's values, even though
+// they're within the range of the file's values.
+TEST_P(TestCFileBothCacheTypes, TestValueBloomSkipping) {
+  const int kNumEntries = 100000;
+  UInt32DataGenerator<false> generator;
+  BlockId block_id;
+  WriteTestFile(&generator, PLAIN_ENCODING, NO_COMPRESSION, kNumEntries,
+                SMALL_BLOCKSIZE | WRITE_ZONE_MAP | WRITE_VALUE_BLOOM, &block_id);
+
+  gscoped_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  gscoped_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+  ASSERT_TRUE(reader->footer().has_value_bloom_block_ptr());
+
+  // Values are 10 times the row index, so only multiples of 10 match.
+  uint32_t present = 500000;
+  uint32_t absent = 500005;
+  uint32_t other_absent = 123;
+  ColumnSchema col("c", UINT32);
+  vector<const void*> absent_values = { &absent, &other_absent };
+  vector<const void*> mixed_values = { &absent, &present };
+  for (const auto& p : { std::make_pair(ColumnPredicate::Equality(col, &present), 1),
+                         std::make_pair(ColumnPredicate::Equality(col, &absent), 0),
+                         std::make_pair(ColumnPredicate::InList(col, &absent_values), 0),
+                         std::make_pair(ColumnPredicate::InList(col, &mixed_values), 1) }) {
+    SCOPED_TRACE(p.first.ToString());
+    gscoped_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+    ASSERT_OK(iter->SeekToFirst());
+
+    ScopedColumnBlock<UINT32> cb(1000);
+    SelectionVector sel(1000);
+    int matched = 0;
+    size_t fetched = 0;
+    while (iter->HasNext()) {
+      sel.SetAllTrue();
+      ColumnMaterializationContext ctx(0, &p.first, &cb, &sel);
+      size_t n = cb.nrows();
+      ASSERT_OK_FAST(iter->CopyNextValues(&n, &ctx));
+      for (size_t j = 0; j < n; j++) {
+        if (sel.IsRowSelected(j)) {
+          ASSERT_EQ((fetched + j) * 10, cb[j]);
+          matched++;
+        }
+      }
+      fetched += n;
+    }
+    ASSERT_EQ(kNumEntries, fetched);
+    ASSERT_EQ(p.second, matched);
+
+    // Without a match, only the block read by the seek should have been read.
+    if (p.second == 0) {
+      ASSERT_LE(iter->io_statistics().data_blocks_read_from_disk, 1);
+    }
+  }
+}
+
+// Test that the blocks found in the block cache are sampled as hot, and that
+// they warm up the cache for another file with the same layout.
+TEST_P(TestCFileBothCacheTypes, TestHotBlocks) {
+  FLAGS_cfile_hot_block_sample_interval = 1;
+  const int kNumEntries = 100000;
+  UInt32DataGenerator<false> generator;
+  BlockId block_ids[2];
+  for (auto& block_id : block_ids) {
+    WriteTestFile(&generator, PLAIN_ENCODING, NO_COMPRESSION, kNumEntries,
+                  SMALL_BLOCKSIZE, &block_id);
+  }
+  gscoped_ptr<CFileReader> readers[2];
+  for (int i = 0; i < 2; i++) {
+    gscoped_ptr<ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_ids[i], &block));
+    ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &readers[i]));
+  }
+
+  // Nothing was found in the cache yet. The second scan finds every block
+  // in the cache.
+  vector<BlockPointer> hot_blocks;
+  readers[0]->GetHotBlocks(&hot_blocks);
+  ASSERT_TRUE(hot_blocks.empty());
+  for (int i = 0; i < 2; i++) {
+    gscoped_ptr<CFileIterator> iter;
+    ASSERT_OK(readers[0]->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+    ASSERT_OK(iter->SeekToFirst());
+    ScopedColumnBlock<UINT32> cb(1000);
+    SelectionVector sel(1000);
+    while (iter->HasNext()) {
+      ColumnMaterializationContext ctx(0, nullptr, &cb, &sel);
+      size_t n = cb.nrows();
+      ASSERT_OK_FAST(iter->CopyNextValues(&n, &ctx));
+    }
+  }
+  readers[0]->GetHotBlocks(&hot_blocks);
+  ASSERT_EQ(8, hot_blocks.size());
+
+  // The blocks are all in the cache already.
+  int num_loaded = 0;
+  ASSERT_OK(readers[0]->WarmUp(hot_blocks, &num_loaded));
+  ASSERT_EQ(0, num_loaded);
+
+  // The other file has the same layout, but none of its blocks are cached.
+  // Blocks which don't lie within the file are skipped.
+  vector<BlockPointer> blocks = hot_blocks;
+  blocks.emplace_back(readers[1]->file_size(), 100);
+  ASSERT_OK(readers[1]->WarmUp(blocks, &num_loaded));
+  ASSERT_EQ(hot_blocks.size(), num_loaded);
+  num_loaded = 0;
+  ASSERT_OK(readers[1]->WarmUp(blocks, &num_loaded));
+  ASSERT_EQ(0, num_loaded);
+
+  // The root of the index is cached by warming up the index.
+  ASSERT_OK(readers[1]->WarmUpIndex(&num_loaded));
+  BlockCacheHandle handle;
+  ASSERT_TRUE(BlockCache::GetSingleton()->Lookup(
+      BlockCache::CacheKey(block_ids[1], readers[1]->posidx_root().offset()),
+      Cache::EXPECT_IN_CACHE, &handle));
+  num_loaded = 0;
+  ASSERT_OK(readers[1]->WarmUpIndex(&num_loaded));
+  ASSERT_EQ(0, num_loaded);
+
+  // Warming up doesn't count as finding blocks in the cache.
+  hot_blocks.clear();
+  readers[1]->GetHotBlocks(&hot_blocks);
+  ASSERT_TRUE(hot_blocks.empty());
+}
+
+// Test that sequential scans with readahead enabled return the same data,
+// find their blocks already read, and stay within the readahead budget.
+TEST_P(TestCFileBothCacheTypes, TestReadahead) {
+  const int kNumEntries = 100000;
+  UInt32DataGenerator<false> generator;
+  BlockId block_id;
+  WriteTestFile(&generator, PLAIN_ENCODING, NO_COMPRESSION, kNumEntries,
+                SMALL_BLOCKSIZE, &block_id);
+
+  gscoped_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  gscoped_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+
+  // With a budget smaller than any block, nothing can be read ahead.
+  for (int64_t budget : { 1024 * 1024, 1 }) {
+    SCOPED_TRACE(budget);
+    shared_ptr<MemTracker> tracker = MemTracker::CreateTracker(
+        budget, StringPrintf("readahead-%" PRId64, budget));
+    {
+      gscoped_ptr<CFileIterator> iter;
+      ASSERT_OK(reader->NewIterator(&iter, CFileReader::DONT_CACHE_BLOCK));
+      iter->EnableReadahead(tracker);
+      ASSERT_OK(iter->SeekToFirst());
+
+      ScopedColumnBlock<UINT32> cb(1000);
+      SelectionVector sel(1000);
+      size_t fetched = 0;
+      while (iter->HasNext()) {
+        ColumnMaterializationContext ctx = CreateNonDecoderEvalContext(&cb, &sel);
+        size_t n = cb.nrows();
+        ASSERT_OK_FAST(iter->CopyNextValues(&n, &ctx));
+        for (size_t j = 0; j < n; j++) {
+          ASSERT_EQ((fetched + j) * 10, cb[j]);
+        }
+        fetched += n;
+        ASSERT_LE(tracker->consumption(), budget);
+      }
+      ASSERT_EQ(kNumEntries, fetched);
+
+      const IteratorStats& stats = iter->io_statistics();
+      LOG(INFO) << stats.ToString();
+      if (budget > 1) {
+        ASSERT_GT(stats.readahead_hits, 0);
+      } else {
+        ASSERT_EQ(0, stats.readahead_hits);
+        ASSERT_GT(stats.readahead_misses, 0);
+      }
+      ASSERT_LE(stats.readahead_hits + stats.readahead_misses,
+                stats.data_blocks_read_from_disk);
+    }
+    // Destroying the iterator releases any blocks it had read ahead.
+    ASSERT_EQ(0, tracker->consumption());
+  }
 }
 
 TEST_P(TestCFileBothCacheTypes, TestNullFloats) {
@@ -880,6 +1312,65 @@ TEST_P(TestCFileBothCacheTypes, TestCacheKeysAreStable) {
   }
 }
 
+// Tests that a corrupted block is detected when it is read from disk, and that
+// files written without checksums remain readable.
+TEST_P(TestCFileBothCacheTypes, TestChecksumCorruption) {
+  for (bool write_checksums : { true, false }) {
+    FLAGS_cfile_write_checksums = write_checksums;
+    BlockId block_id;
+    {
+      const int nrows = 1000;
+      StringDataGenerator<false> generator("hello %04d");
+      WriteTestFile(&generator, PREFIX_ENCODING, NO_COMPRESSION, nrows,
+                    SMALL_BLOCKSIZE | WRITE_VALIDX, &block_id);
+    }
+
+    // Find the first data block, then copy the file into a new block with
+    // one byte of that data block flipped.
+    gscoped_ptr<ReadableBlock> source;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &source));
+    gscoped_ptr<CFileReader> reader;
+    ASSERT_OK(CFileReader::Open(std::move(source), ReaderOptions(), &reader));
+    ASSERT_EQ(write_checksums ? static_cast<uint32_t>(IncompatibleFeatures::CHECKSUM) : 0,
+              reader->footer().incompatible_features());
+    gscoped_ptr<IndexTreeIterator> iter;
+    iter.reset(IndexTreeIterator::Create(reader.get(), reader->posidx_root()));
+    ASSERT_OK(iter->SeekToFirst());
+    BlockPointer ptr = iter->GetCurrentBlockPointer();
+    BlockHandle bh;
+    ASSERT_OK(reader->ReadBlock(ptr, CFileReader::DONT_CACHE_BLOCK, &bh));
+
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &source));
+    uint64_t file_size;
+    ASSERT_OK(source->Size(&file_size));
+    gscoped_ptr<uint8_t[]> scratch(new uint8_t[file_size]);
+    Slice contents;
+    ASSERT_OK(source->Read(0, file_size, &contents, scratch.get()));
+    string corrupt_contents = contents.ToString();
+    corrupt_contents[ptr.offset() + 1] ^= 0xff;
+    gscoped_ptr<WritableBlock> sink;
+    ASSERT_OK(fs_manager_->CreateNewBlock(&sink));
+    ASSERT_OK(sink->Append(corrupt_contents));
+    BlockId corrupt_id = sink->id();
+    ASSERT_OK(sink->Close());
+
+    ASSERT_OK(fs_manager_->OpenBlock(corrupt_id, &source));
+    ASSERT_OK(CFileReader::Open(std::move(source), ReaderOptions(), &reader));
+    Status s = reader->ReadBlock(ptr, CFileReader::CACHE_BLOCK, &bh);
+    if (!write_checksums) {
+      ASSERT_OK(s);
+      continue;
+    }
+    ASSERT_TRUE(s.IsCorruption()) << s.ToString();
+    ASSERT_STR_CONTAINS(s.ToString(), "checksum mismatch");
+
+    // Verification can be disabled.
+    FLAGS_cfile_verify_checksums = false;
+    ASSERT_OK(reader->ReadBlock(ptr, CFileReader::DONT_CACHE_BLOCK, &bh));
+    FLAGS_cfile_verify_checksums = true;
+  }
+}
+
 #if defined(__linux__)
 // Inject failures in nvm allocation and ensure that we can still read a file.
 TEST_P(TestCFileBothCacheTypes, TestNvmAllocationFailure) {
@@ -20,20 +20,26 @@
 #include <glog/logging.h>
 
 #include <algorithm>
+#include <mutex>
 
 #include "kudu/cfile/block_cache.h"
 #include "kudu/cfile/block_handle.h"
 #include "kudu/cfile/block_pointer.h"
+#include "kudu/cfile/block_readahead.h"
 #include "kudu/cfile/cfile.pb.h"
 #include "kudu/cfile/cfile_writer.h" // for kMagicString
 #include "kudu/cfile/gvint_block.h"
 #include "kudu/cfile/index_block.h"
 #include "kudu/cfile/index_btree.h"
 #include "kudu/cfile/binary_plain_block.h"
+#include "kudu/cfile/zone_map.h"
+#include "kudu/fs/io_throttler.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/mathlimits.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/bloom_filter.h"
 #include "kudu/util/coding.h"
+#include "kudu/util/crc.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/malloc.h"
@@ -48,12 +54,48 @@ DEFINE_bool(cfile_lazy_open, true,
             "Allow lazily opening of cfiles");
 TAG_FLAG(cfile_lazy_open, hidden);
 
+DEFINE_int32(cfile_readahead_blocks, 4,
+             "Number of data blocks to read ahead of sequential scans of a "
+             "cfile, for iterators with readahead enabled. 0 disables readahead.");
+TAG_FLAG(cfile_readahead_blocks, advanced);
+TAG_FLAG(cfile_readahead_blocks, runtime);
+
+DEFINE_bool(cfile_verify_checksums, true,
+            "Verify the checksum of each cfile block read from disk, for files "
+            "written with checksums. Blocks served from the block cache are "
+            "not re-verified.");
+TAG_FLAG(cfile_verify_checksums, evolving);
+TAG_FLAG(cfile_verify_checksums, runtime);
+
+DEFINE_int32(cfile_hot_block_sample_interval, 64,
+             "Every this many block cache hits of a cfile, the block hit is "
+             "sampled as one of the hot blocks of the cfile. The hot blocks "
+             "are used to warm up the block cache when tablets are reopened. "
+             "0 disables sampling.");
+TAG_FLAG(cfile_hot_block_sample_interval, advanced);
+TAG_FLAG(cfile_hot_block_sample_interval, runtime);
+
+DEFINE_int32(cfile_value_index_directory_max_blocks, 4096,
+             "Maximum number of data blocks of a cfile for which point lookups of "
+             "keys use an in-memory copy of the leaves of the value index, searched "
+             "by interpolation, rather than descending the value index. The copy "
+             "takes about 30 bytes plus the size of a key per block. 0 disables it.");
+TAG_FLAG(cfile_value_index_directory_max_blocks, advanced);
+TAG_FLAG(cfile_value_index_directory_max_blocks, experimental);
+
 using kudu::fs::ReadableBlock;
 using strings::Substitute;
 
 namespace kudu {
 namespace cfile {
 
+// The number of blocks a scan must advance over in sequence after a seek
+// before blocks are read ahead of it.
+static const int kReadaheadMinSequentialBlocks = 2;
+
+// The number of hot blocks sampled per cfile.
+static const int kMaxHotBlocks = 8;
+
 const char* CFILE_CACHE_MISS_BYTES_METRIC_NAME = "cfile_cache_miss_bytes";
 const char* CFILE_CACHE_HIT_BYTES_METRIC_NAME = "cfile_cache_hit_bytes";
 
@@ -86,6 +128,8 @@ CFileReader::CFileReader(const ReaderOptions &options,
                          gscoped_ptr<ReadableBlock> block) :
   block_(std::move(block)),
   file_size_(file_size),
+  cache_hits_(0),
+  next_hot_block_(0),
   mem_consumption_(options.parent_mem_tracker, memory_footprint()) {
 }
 
@@ -207,6 +251,13 @@ Status CFileReader::ReadAndParseFooter() {
     return Status::Corruption("Invalid cfile pb footer");
   }
 
+  // Refuse to interpret a file laid out in a way we don't understand.
+  uint32_t unsupported = footer_->incompatible_features() & ~IncompatibleFeatures::CHECKSUM;
+  if (unsupported != 0) {
+    return Status::NotSupported(Substitute(
+        "cfile uses unsupported incompatible features (bitmask $0)", unsupported));
+  }
+
   // Verify if the compression codec is available
   if (footer_->compression() != NO_COMPRESSION) {
     const CompressionCodec* codec;
@@ -219,6 +270,19 @@ Status CFileReader::ReadAndParseFooter() {
   return Status::OK();
 }
 
+Status CFileReader::VerifyChecksum(const BlockPointer& ptr, const Slice& block) const {
+  DCHECK_GE(block.size(), kBlockChecksumSize);
+  size_t data_size = block.size() - kBlockChecksumSize;
+  uint32_t expected = DecodeFixed32(block.data() + data_size);
+  uint32_t actual = crc::Crc32c(block.data(), data_size);
+  if (PREDICT_FALSE(expected != actual)) {
+    return Status::Corruption(Substitute("checksum mismatch in block $0 of $1: "
+                                         "expected $2, got $3",
+                                         ptr.ToString(), ToString(), expected, actual));
+  }
+  return Status::OK();
+}
+
 namespace {
 
 // ScratchMemory acts as a holder for the destination buffer for a block read.
@@ -260,6 +324,20 @@ class ScratchMemory {
     size_ = size;
   }
 
+  // Same as TryAllocateFromCache(), but from the cache's compressed tier.
+  void TryAllocateFromCompressedCache(BlockCache* cache, const BlockCache::CacheKey& key,
+                                      int size) {
+    DCHECK(!ptr_);
+    from_cache_ = cache->AllocateCompressed(key, size);
+    if (!from_cache_.valid()) {
+      AllocateFromHeap(size);
+      return;
+    } else {
+      ptr_ = from_cache_.val_ptr();
+    }
+    size_ = size;
+  }
+
   void AllocateFromHeap(int size) {
     DCHECK(!ptr_);
     from_cache_.reset();
@@ -280,10 +358,6 @@ class ScratchMemory {
     return DCHECK_NOTNULL(ptr_);
   }
 
-  Slice as_slice() {
-    return Slice(ptr_, size_);
-  }
-
   uint8_t* release() {
     uint8_t* ret = ptr_;
     ptr_ = nullptr;
@@ -308,12 +382,23 @@ class ScratchMemory {
 } // anonymous namespace
 
 Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_control,
-                              BlockHandle *ret) const {
+                              BlockHandle *ret, Cache::Priority priority) const {
   DCHECK(init_once_.initted());
   CHECK(ptr.offset() > 0 &&
         ptr.offset() + ptr.size() < file_size_) <<
     "bad offset " << ptr.ToString() << " in file of size "
                   << file_size_;
+  // Blocks are read along with their checksum trailer, if any, which is
+  // then split off in memory. Blocks cached as they were read, i.e.
+  // uncompressed blocks and those of the compressed tier, keep the trailer.
+  const bool has_checksum = footer_->incompatible_features() & IncompatibleFeatures::CHECKSUM;
+  const size_t trailer_size = has_checksum ? kBlockChecksumSize : 0;
+  const size_t cached_trailer_size = block_uncompressor_ == nullptr ? trailer_size : 0;
+  if (PREDICT_FALSE(ptr.size() < trailer_size)) {
+    return Status::Corruption(Substitute("block $0 in $1 is too short for its checksum",
+                                         ptr.ToString(), ToString()));
+  }
+
   BlockCacheHandle bc_handle;
   Cache::CacheBehavior cache_behavior = cache_control == CACHE_BLOCK ?
       Cache::EXPECT_IN_CACHE : Cache::NO_EXPECT_IN_CACHE;
@@ -322,8 +407,9 @@ Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_contro
   if (cache->Lookup(key, cache_behavior, &bc_handle)) {
     TRACE_COUNTER_INCREMENT("cfile_cache_hit", 1);
     TRACE_COUNTER_INCREMENT(CFILE_CACHE_HIT_BYTES_METRIC_NAME, ptr.size());
-    *ret = BlockHandle::WithDataFromCache(&bc_handle);
+    *ret = BlockHandle::WithDataFromCache(&bc_handle, cached_trailer_size);
     // Cache hit
+    MaybeSampleHotBlock(ptr);
     return Status::OK();
   }
 
@@ -337,20 +423,41 @@ Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_contro
   TRACE_COUNTER_INCREMENT(CFILE_CACHE_MISS_BYTES_METRIC_NAME, ptr.size());
 
   ScratchMemory scratch;
-  // If we are reading uncompressed data and plan to cache the result,
-  // then we should allocate our scratch memory directly from the cache.
-  // This avoids an extra memory copy in the case of an NVM cache.
-  if (block_uncompressor_ == nullptr && cache_control == CACHE_BLOCK) {
-    scratch.TryAllocateFromCache(cache, key, ptr.size());
+  Slice block;
+  // A compressed block may still be in the compressed tier of the cache, in
+  // which case it only needs to be decompressed.
+  BlockCacheHandle compressed_handle;
+  const bool use_compressed_tier = block_uncompressor_ != nullptr &&
+      cache->has_compressed_tier();
+  if (use_compressed_tier &&
+      cache->LookupCompressed(key, cache_behavior, &compressed_handle)) {
+    TRACE_COUNTER_INCREMENT("cfile_compressed_cache_hit", 1);
+    block = compressed_handle.data();
+    block.truncate(block.size() - trailer_size);
   } else {
-    scratch.AllocateFromHeap(ptr.size());
-  }
-  uint8_t* buf = scratch.get();
+    // If we are reading uncompressed data and plan to cache the result,
+    // then we should allocate our scratch memory directly from the cache.
+    // This avoids an extra memory copy in the case of an NVM cache.
+    // Compressed data to be cached is likewise read directly into the
+    // compressed tier.
+    if (block_uncompressor_ == nullptr && cache_control == CACHE_BLOCK) {
+      scratch.TryAllocateFromCache(cache, key, ptr.size());
+    } else if (use_compressed_tier && cache_control == CACHE_BLOCK) {
+      scratch.TryAllocateFromCompressedCache(cache, key, ptr.size());
+    } else {
+      scratch.AllocateFromHeap(ptr.size());
+    }
 
-  Slice block;
-  RETURN_NOT_OK(block_->Read(ptr.offset(), ptr.size(), &block, buf));
-  if (block.size() != ptr.size()) {
-    return Status::IOError("Could not read full block length");
+    MonoTime read_start = MonoTime::Now();
+    RETURN_NOT_OK(block_->Read(ptr.offset(), ptr.size(), &block, scratch.get()));
+    fs::IOThrottler::RecordBlockReadLatency(MonoTime::Now() - read_start);
+    if (block.size() != ptr.size()) {
+      return Status::IOError("Could not read full block length");
+    }
+    if (has_checksum && FLAGS_cfile_verify_checksums) {
+      RETURN_NOT_OK(VerifyChecksum(ptr, block));
+    }
+    block.truncate(block.size() - trailer_size);
   }
 
   // Decompress the block
@@ -386,8 +493,16 @@ Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_contro
     // output buffer.
     scratch.Swap(&decompressed_scratch);
 
+    // If the compressed block was read into memory allocated from the
+    // compressed tier, keep it there.
+    if (decompressed_scratch.IsFromCache()) {
+      BlockCacheHandle inserted;
+      cache->InsertCompressed(decompressed_scratch.mutable_pending_entry(), &inserted);
+      ignore_result(decompressed_scratch.release());
+    }
+
     // Set the result block to our decompressed data.
-    block = Slice(buf, uncompressed_size);
+    block = Slice(scratch.get(), uncompressed_size);
   } else {
     // Some of the File implementations from LevelDB attempt to be tricky
     // and just return a Slice into an mmapped region (or in-memory region).
@@ -401,16 +516,16 @@ Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_contro
   // of what the user requested. The scratch memory includes both the
   // generated key and the data read from disk.
   if (cache_control == CACHE_BLOCK && scratch.IsFromCache()) {
-    cache->Insert(scratch.mutable_pending_entry(), &bc_handle);
-    *ret = BlockHandle::WithDataFromCache(&bc_handle);
+    cache->Insert(scratch.mutable_pending_entry(), &bc_handle, priority);
+    *ret = BlockHandle::WithDataFromCache(&bc_handle, cached_trailer_size);
   } else {
     // We get here by either not intending to cache the block or
     // if the entry could not be allocated from the block cache.
     // Since we allocate memory to include the key for the cache entry
     // we must reset the block.
-    DCHECK_EQ(block.data(), buf);
+    DCHECK_EQ(block.data(), scratch.get());
     DCHECK(!scratch.IsFromCache());
-    *ret = BlockHandle::WithOwnedData(scratch.as_slice());
+    *ret = BlockHandle::WithOwnedData(Slice(scratch.get(), block.size()));
   }
 
   // The cache or the BlockHandle now has ownership over the memory, so release
@@ -425,6 +540,70 @@ Status CFileReader::CountRows(rowid_t *count) const {
   return Status::OK();
 }
 
+void CFileReader::GetHotBlocks(std::vector<BlockPointer>* blocks) const {
+  std::lock_guard<simple_spinlock> l(hot_blocks_lock_);
+  int n = hot_blocks_.size();
+  for (int i = 1; i <= n; i++) {
+    blocks->push_back(hot_blocks_[(next_hot_block_ - i + n) % n]);
+  }
+}
+
+Status CFileReader::WarmUp(const std::vector<BlockPointer>& blocks, int* num_loaded) {
+  return WarmUpWithPriority(blocks, Cache::NORMAL_PRIORITY, num_loaded);
+}
+
+Status CFileReader::WarmUpIndex(int* num_loaded) {
+  RETURN_NOT_OK(Init());
+  std::vector<BlockPointer> roots;
+  if (has_posidx()) {
+    roots.push_back(posidx_root());
+  }
+  if (has_validx()) {
+    roots.push_back(validx_root());
+  }
+  return WarmUpWithPriority(roots, Cache::HIGH_PRIORITY, num_loaded);
+}
+
+Status CFileReader::WarmUpWithPriority(const std::vector<BlockPointer>& blocks,
+                                       Cache::Priority priority, int* num_loaded) {
+  RETURN_NOT_OK(Init());
+  BlockCache* cache = BlockCache::GetSingleton();
+  for (const BlockPointer& ptr : blocks) {
+    // The bounds checked by ReadBlock().
+    if (ptr.offset() == 0 || ptr.offset() + ptr.size() >= file_size_) {
+      continue;
+    }
+    BlockCacheHandle bc_handle;
+    if (cache->Lookup(BlockCache::CacheKey(block_->id(), ptr.offset()),
+                      Cache::NO_EXPECT_IN_CACHE, &bc_handle)) {
+      continue;
+    }
+    BlockHandle handle;
+    RETURN_NOT_OK(ReadBlock(ptr, CACHE_BLOCK, &handle, priority));
+    (*num_loaded)++;
+  }
+  return Status::OK();
+}
+
+void CFileReader::MaybeSampleHotBlock(const BlockPointer& ptr) const {
+  int interval = FLAGS_cfile_hot_block_sample_interval;
+  if (interval <= 0 || cache_hits_.Increment() % interval != 0) {
+    return;
+  }
+  std::lock_guard<simple_spinlock> l(hot_blocks_lock_);
+  for (const BlockPointer& hot : hot_blocks_) {
+    if (hot.offset() == ptr.offset()) {
+      return;
+    }
+  }
+  if (static_cast<int>(hot_blocks_.size()) < kMaxHotBlocks) {
+    hot_blocks_.push_back(ptr);
+  } else {
+    hot_blocks_[next_hot_block_] = ptr;
+  }
+  next_hot_block_ = (next_hot_block_ + 1) % kMaxHotBlocks;
+}
+
 bool CFileReader::GetMetadataEntry(const string &key, string *val) {
   for (const FileMetadataPairPB &pair : header().metadata()) {
     if (pair.key() == key) {
@@ -446,10 +625,38 @@ Status CFileReader::NewIterator(CFileIterator **iter, CacheControl cache_control
   return Status::OK();
 }
 
+const ValueIndexDirectory* CFileReader::GetValueIndexDirectory() {
+  DCHECK(init_once_.initted());
+  CHECK_OK(validx_dir_once_.Init(&CFileReader::BuildValueIndexDirectoryOnce, this));
+  return validx_dir_.get();
+}
+
+Status CFileReader::BuildValueIndexDirectoryOnce() {
+  if (!has_validx() || FLAGS_cfile_value_index_directory_max_blocks <= 0) {
+    return Status::OK();
+  }
+  Status s = ValueIndexDirectory::Build(this, validx_root(),
+                                        FLAGS_cfile_value_index_directory_max_blocks,
+                                        &validx_dir_);
+  if (!s.ok()) {
+    // Lookups fall back to the value index itself.
+    LOG(WARNING) << "Unable to build the value index directory of cfile " << ToString()
+                 << ": " << s.ToString();
+    validx_dir_.reset();
+    return Status::OK();
+  }
+  mem_consumption_.Reset(memory_footprint());
+  return Status::OK();
+}
+
 size_t CFileReader::memory_footprint() const {
   size_t size = kudu_malloc_usable_size(this);
   size += block_->memory_footprint();
   size += init_once_.memory_footprint_excluding_this();
+  size += validx_dir_once_.memory_footprint_excluding_this();
+  if (validx_dir_) {
+    size += validx_dir_->memory_footprint();
+  }
 
   // SpaceUsed() uses sizeof() instead of malloc_usable_size() to account for
   // the size of base objects (recursively too), thus not accounting for
@@ -519,13 +726,23 @@ CFileIterator::CFileIterator(CFileReader* reader,
     seeked_(nullptr),
     prepared_(false),
     cache_control_(cache_control),
+    readahead_distance_(0),
+    sequential_blocks_(0),
+    readahead_suspended_(false),
     last_prepare_idx_(-1),
-    last_prepare_count_(-1) {
+    last_prepare_count_(-1),
+    value_bloom_pred_(nullptr),
+    value_bloom_may_match_(true) {
 }
 
 CFileIterator::~CFileIterator() {
 }
 
+void CFileIterator::EnableReadahead(std::shared_ptr<MemTracker> mem_tracker) {
+  DCHECK(!seeked_);
+  readahead_.reset(new BlockReadahead(reader_, cache_control_, std::move(mem_tracker)));
+}
+
 Status CFileIterator::SeekToOrdinal(rowid_t ord_idx) {
   RETURN_NOT_OK(PrepareForNewSeek());
   if (PREDICT_FALSE(posidx_iter_ == nullptr)) {
@@ -567,6 +784,12 @@ Status CFileIterator::SeekToOrdinal(rowid_t ord_idx) {
 }
 
 void CFileIterator::SeekToPositionInBlock(PreparedBlock *pb, uint32_t idx_in_block) {
+  if (!pb->loaded_) {
+    // The position is applied when the block is loaded.
+    pb->idx_in_block_ = idx_in_block;
+    return;
+  }
+
   // Since the data block only holds the non-null values,
   // we need to translate from 'ord_idx' (the absolute row id)
   // to the index within the non-null entries.
@@ -681,6 +904,46 @@ Status CFileIterator::SeekAtOrAfter(const EncodedKey &key,
   return Status::OK();
 }
 
+Status CFileIterator::LookupKey(const EncodedKey &key, bool *exact_match,
+                                rowid_t *ordinal) {
+  RETURN_NOT_OK(PrepareForNewSeek());
+  const ValueIndexDirectory* dir = reader_->GetValueIndexDirectory();
+  if (dir == nullptr) {
+    Status s = SeekAtOrAfter(key, exact_match);
+    if (s.IsNotFound()) {
+      *exact_match = false;
+      s = Status::OK();
+    } else if (s.ok() && *exact_match) {
+      *ordinal = GetCurrentOrdinal();
+    }
+    seeked_ = nullptr;
+    return s;
+  }
+  DCHECK_EQ(reader_->is_nullable(), false);
+
+  pblock_pool_scoped_ptr b = prepared_block_pool_.make_scoped_ptr(
+    prepared_block_pool_.Construct());
+  RETURN_NOT_OK(ReadDataBlock(dir->block(dir->FindBlock(key.encoded_key())), b.get()));
+
+  Status s;
+  if (key.num_key_columns() > 1) {
+    Slice slice = key.encoded_key();
+    s = b->dblk_->SeekAtOrAfterValue(&slice, exact_match);
+  } else {
+    s = b->dblk_->SeekAtOrAfterValue(key.raw_keys()[0], exact_match);
+  }
+  // Keys past the end of their block fall between it and the next one.
+  if (s.IsNotFound()) {
+    *exact_match = false;
+    return Status::OK();
+  }
+  RETURN_NOT_OK(s);
+  if (*exact_match) {
+    *ordinal = b->first_row_idx() + b->dblk_->GetCurrentIndex();
+  }
+  return Status::OK();
+}
+
 Status CFileIterator::PrepareForNewSeek() {
   // Fully open the CFileReader if it was lazily opened earlier.
   //
@@ -703,19 +966,44 @@ Status CFileIterator::PrepareForNewSeek() {
     BlockPointer bp(reader_->footer().dict_block_ptr());
 
     // Cache the dictionary for performance
-    RETURN_NOT_OK_PREPEND(reader_->ReadBlock(bp, CFileReader::CACHE_BLOCK, &dict_block_handle_),
+    RETURN_NOT_OK_PREPEND(reader_->ReadBlock(bp, CFileReader::CACHE_BLOCK, &dict_block_handle_,
+                                             Cache::HIGH_PRIORITY),
                           "Couldn't read dictionary block");
 
     dict_decoder_.reset(new BinaryPlainBlockDecoder(dict_block_handle_.data()));
     RETURN_NOT_OK_PREPEND(dict_decoder_->ParseHeader(), "Couldn't parse dictionary block header");
   }
 
+  // Read the zone map, if the cfile has one.
+  if (!zone_map_ && reader_->footer().has_zone_map_block_ptr()) {
+    BlockPointer bp(reader_->footer().zone_map_block_ptr());
+    BlockHandle zone_map_handle;
+    RETURN_NOT_OK_PREPEND(reader_->ReadBlock(bp, cache_control_, &zone_map_handle,
+                                             Cache::HIGH_PRIORITY),
+                          "Couldn't read zone map block");
+    gscoped_ptr<ZoneMapPB> zone_map(new ZoneMapPB());
+    if (!zone_map->ParseFromArray(zone_map_handle.data().data(),
+                                  zone_map_handle.data().size())) {
+      return Status::Corruption("Invalid cfile zone map block");
+    }
+    zone_map_.swap(zone_map);
+  }
+
   seeked_ = nullptr;
   for (PreparedBlock *pb : prepared_blocks_) {
     prepared_block_pool_.Destroy(pb);
   }
   prepared_blocks_.clear();
 
+  // Blocks read ahead of the previous position are unlikely to be useful.
+  if (readahead_) {
+    readahead_->Clear();
+  }
+  readahead_iter_.reset();
+  readahead_distance_ = 0;
+  sequential_blocks_ = 0;
+  readahead_suspended_ = false;
+
   return Status::OK();
 }
 
@@ -749,8 +1037,23 @@ Status DecodeNullInfo(Slice *data_block, uint32_t *num_rows_in_block, Slice *nul
 
 Status CFileIterator::ReadCurrentDataBlock(const IndexTreeIterator &idx_iter,
                                            PreparedBlock *prep_block) {
-  prep_block->dblk_ptr_ = idx_iter.GetCurrentBlockPointer();
-  RETURN_NOT_OK(reader_->ReadBlock(prep_block->dblk_ptr_, cache_control_, &prep_block->dblk_data_));
+  return ReadDataBlock(idx_iter.GetCurrentBlockPointer(), prep_block);
+}
+
+Status CFileIterator::ReadDataBlock(const BlockPointer &dblk_ptr,
+                                    PreparedBlock *prep_block) {
+  prep_block->dblk_ptr_ = dblk_ptr;
+  Status s;
+  if (readahead_ && readahead_->Take(dblk_ptr, &prep_block->dblk_data_, &s)) {
+    io_stats_.readahead_hits++;
+    RETURN_NOT_OK(s);
+  } else {
+    if (readahead_iter_) {
+      io_stats_.readahead_misses++;
+    }
+    RETURN_NOT_OK(reader_->ReadBlock(prep_block->dblk_ptr_, cache_control_,
+                                     &prep_block->dblk_data_));
+  }
 
   uint32_t num_rows_in_block = 0;
   Slice data_block = prep_block->dblk_data_.data();
@@ -776,6 +1079,9 @@ Status CFileIterator::ReadCurrentDataBlock(const IndexTreeIterator &idx_iter,
   io_stats_.data_blocks_read_from_disk++;
   io_stats_.bytes_read_from_disk += data_block.size();
 
+  prep_block->first_row_idx_ = bd->GetFirstRowId();
+  prep_block->loaded_ = true;
+  prep_block->zone_ = FindZone(prep_block->first_row_idx_);
   prep_block->idx_in_block_ = 0;
   prep_block->num_rows_in_block_ = num_rows_in_block;
   prep_block->needs_rewind_ = false;
@@ -785,14 +1091,139 @@ Status CFileIterator::ReadCurrentDataBlock(const IndexTreeIterator &idx_iter,
   return Status::OK();
 }
 
+Status CFileIterator::LoadDataBlock(PreparedBlock *pb) {
+  DCHECK(!pb->loaded_);
+  const rowid_t expected_first_row = pb->first_row_idx_;
+  const uint32_t expected_num_rows = pb->num_rows_in_block_;
+  const uint32_t idx_in_block = pb->idx_in_block_;
+  const bool needs_rewind = pb->needs_rewind_;
+  const uint32_t rewind_idx = pb->rewind_idx_;
+
+  RETURN_NOT_OK(ReadDataBlock(pb->dblk_ptr_, pb));
+  if (PREDICT_FALSE(pb->first_row_idx() != expected_first_row ||
+                    pb->num_rows_in_block_ != expected_num_rows)) {
+    return Status::Corruption(
+        Substitute("data block $0 does not match its zone map entry (rows $1-$2)",
+                   pb->ToString(), expected_first_row,
+                   expected_first_row + expected_num_rows - 1));
+  }
+  SeekToPositionInBlock(pb, idx_in_block);
+  pb->needs_rewind_ = needs_rewind;
+  pb->rewind_idx_ = rewind_idx;
+  return Status::OK();
+}
+
+const ZoneMapEntryPB* CFileIterator::FindZone(rowid_t first_row_idx) const {
+  if (!zone_map_) {
+    return nullptr;
+  }
+  const auto& blocks = zone_map_->blocks();
+  auto it = std::lower_bound(blocks.begin(), blocks.end(), first_row_idx,
+                             [](const ZoneMapEntryPB& entry, rowid_t row_idx) {
+                               return entry.first_row_id() < row_idx;
+                             });
+  if (it == blocks.end() || it->first_row_id() != first_row_idx) {
+    return nullptr;
+  }
+  return &*it;
+}
+
+Status CFileIterator::CheckValueBloom(const ColumnPredicate& pred, bool* may_match) {
+  if (pred.predicate_type() != PredicateType::Equality &&
+      pred.predicate_type() != PredicateType::InList) {
+    *may_match = true;
+    return Status::OK();
+  }
+  if (value_bloom_pred_ == &pred) {
+    *may_match = value_bloom_may_match_;
+    return Status::OK();
+  }
+  if (!value_bloom_) {
+    const CFileFooterPB& footer = reader_->footer();
+    BlockPointer bp(footer.value_bloom_block_ptr());
+    RETURN_NOT_OK_PREPEND(reader_->ReadBlock(bp, cache_control_, &value_bloom_handle_,
+                                             Cache::HIGH_PRIORITY),
+                          "Couldn't read value bloom filter block");
+    const Slice& data = value_bloom_handle_.data();
+    bool blocked = footer.value_bloom_header().layout() == BloomBlockHeaderPB::BLOCKED;
+    if (blocked && (data.empty() || data.size() % BloomFilter::kBlockedLineBytes != 0)) {
+      return Status::Corruption("Invalid cfile value bloom filter block");
+    }
+    value_bloom_.reset(new BloomFilter(data, footer.value_bloom_header().num_hash_functions(),
+                                       blocked ? BLOCKED_BLOOM_LAYOUT : CLASSIC_BLOOM_LAYOUT));
+  }
+  value_bloom_pred_ = &pred;
+  value_bloom_may_match_ = ValueBloomMayMatch(reader_->type_info(), *value_bloom_, pred);
+  *may_match = value_bloom_may_match_;
+  return Status::OK();
+}
+
 Status CFileIterator::QueueCurrentDataBlock(const IndexTreeIterator &idx_iter) {
   pblock_pool_scoped_ptr b = prepared_block_pool_.make_scoped_ptr(
     prepared_block_pool_.Construct());
-  RETURN_NOT_OK(ReadCurrentDataBlock(idx_iter, b.get()));
+  // Blocks are contiguous, so the new block starts right after the last one.
+  const ZoneMapEntryPB* zone = FindZone(prepared_blocks_.back()->last_row_idx() + 1);
+  if (zone != nullptr) {
+    b->dblk_ptr_ = idx_iter.GetCurrentBlockPointer();
+    b->first_row_idx_ = zone->first_row_id();
+    b->loaded_ = false;
+    b->zone_ = zone;
+    b->idx_in_block_ = 0;
+    b->num_rows_in_block_ = zone->num_rows();
+    b->needs_rewind_ = false;
+    b->rewind_idx_ = 0;
+    DVLOG(2) << "Deferred reading dblk " << b->ToString();
+  } else {
+    RETURN_NOT_OK(ReadCurrentDataBlock(idx_iter, b.get()));
+  }
   prepared_blocks_.push_back(b.release());
   return Status::OK();
 }
 
+Status CFileIterator::ReadAheadOfCurrentBlock() {
+  const int max_distance = FLAGS_cfile_readahead_blocks;
+  if (!readahead_ || readahead_suspended_ || max_distance <= 0) {
+    return Status::OK();
+  }
+  if (!readahead_iter_) {
+    if (++sequential_blocks_ < kReadaheadMinSequentialBlocks) {
+      return Status::OK();
+    }
+    // The scan looks sequential: start a cursor at the current block.
+    BlockPointer root = seeked_ == posidx_iter_.get() ? reader_->posidx_root()
+                                                      : reader_->validx_root();
+    gscoped_ptr<IndexTreeIterator> iter(IndexTreeIterator::Create(reader_, root));
+    RETURN_NOT_OK(iter->SeekAtOrBefore(seeked_->GetCurrentKey()));
+    DCHECK(iter->GetCurrentBlockPointer().offset() ==
+           seeked_->GetCurrentBlockPointer().offset());
+    readahead_iter_.swap(iter);
+    readahead_distance_ = 0;
+  } else if (readahead_distance_ > 0) {
+    readahead_distance_--;
+  }
+
+  while (readahead_distance_ < max_distance && readahead_iter_->HasNext()) {
+    RETURN_NOT_OK(readahead_iter_->Next());
+    readahead_distance_++;
+    if (!readahead_->Prefetch(readahead_iter_->GetCurrentBlockPointer())) {
+      // Over the memory budget; the block will be read on demand.
+      break;
+    }
+  }
+  readahead_->Submit();
+  return Status::OK();
+}
+
+void CFileIterator::ReleaseUnloadedBlock(PreparedBlock *pb) {
+  DCHECK(!pb->loaded_);
+  io_stats_.data_blocks_skipped++;
+  if (readahead_ && !readahead_suspended_) {
+    readahead_->Clear();
+    readahead_iter_.reset();
+    readahead_suspended_ = true;
+  }
+}
+
 bool CFileIterator::HasNext() const {
   CHECK(seeked_) << "not seeked";
   CHECK(!prepared_) << "Cannot call HasNext() mid-batch";
@@ -819,6 +1250,7 @@ Status CFileIterator::PrepareBatch(size_t *n) {
     } else if (!s.ok()) {
       return s;
     }
+    RETURN_NOT_OK(ReadAheadOfCurrentBlock());
     RETURN_NOT_OK(QueueCurrentDataBlock(*seeked_));
   }
 
@@ -862,6 +1294,9 @@ Status CFileIterator::FinishBatch() {
   // relevent data for the next batch.
   for (int i = 0; i < prepared_blocks_.size() - 1; i++) {
     PreparedBlock *b = prepared_blocks_[i];
+    if (!b->loaded_) {
+      ReleaseUnloadedBlock(b);
+    }
     prepared_block_pool_.Destroy(b);
   }
 
@@ -871,6 +1306,9 @@ Status CFileIterator::FinishBatch() {
            << " (" << (last_prepare_idx_ + last_prepare_count_) << ")";
   if (back->last_row_idx() < last_prepare_idx_ + last_prepare_count_) {
     // Last block is irrelevant
+    if (!back->loaded_) {
+      ReleaseUnloadedBlock(back);
+    }
     prepared_block_pool_.Destroy(back);
     prepared_blocks_.clear();
   } else {
@@ -896,12 +1334,39 @@ Status CFileIterator::FinishBatch() {
 Status CFileIterator::Scan(ColumnMaterializationContext* ctx) {
   CHECK(seeked_) << "not seeked";
 
+  // IS NULL predicates only need the null bitmap, so they are evaluated
+  // without decoding any of the values.
+  if (ctx->DecoderEvalNotDisabled() &&
+      ctx->pred()->predicate_type() == PredicateType::IsNull) {
+    return ScanIsNull(ctx);
+  }
+
   // Use views to advance the block and selection vector as we read into them.
   ColumnDataView remaining_dst(ctx->block());
   SelectionVectorView remaining_sel(ctx->sel());
   uint32_t rem = last_prepare_count_;
   DCHECK_LE(rem, ctx->block()->nrows());
 
+  // Columns without a predicate are materialized after the predicated ones,
+  // so only the values of rows which are still selected need to be decoded.
+  const bool decode_selected_only = ctx->pred() == nullptr && ctx->sel() != nullptr;
+
+  // If no row of the file can match the predicate, no block needs to be read.
+  const bool use_zone_map = zone_map_ && ctx->DecoderEvalNotDisabled();
+  if (use_zone_map &&
+      !ZoneMayMatch(reader_->type_info(), reader_->footer().file_zone_map(), *ctx->pred())) {
+    SkipUnloadedRows(ctx, rem, true, &remaining_sel, &remaining_dst);
+    return Status::OK();
+  }
+  if (ctx->DecoderEvalNotDisabled() && reader_->footer().has_value_bloom_block_ptr()) {
+    bool may_match;
+    RETURN_NOT_OK(CheckValueBloom(*ctx->pred(), &may_match));
+    if (!may_match) {
+      SkipUnloadedRows(ctx, rem, true, &remaining_sel, &remaining_dst);
+      return Status::OK();
+    }
+  }
+
   // Determine the matching codewords for dictionary encoding if they haven't
   // yet been determined for this CFile.
   if (dict_decoder_ && ctx->DecoderEvalNotDisabled() && !codewords_matching_pred_) {
@@ -923,6 +1388,23 @@ Status CFileIterator::Scan(ColumnMaterializationContext* ctx) {
       // that might be more efficient (allowing the decoder to save internal state
       // instead of having to reconstruct it)
     }
+    if (!pb->loaded_) {
+      // Blocks which cannot match the predicate, or none of whose rows in this
+      // batch are still selected, are skipped without being read.
+      size_t nrows = std::min(rem, pb->num_rows_in_block_ - pb->idx_in_block_);
+      bool no_match = use_zone_map &&
+          !ZoneMayMatch(reader_->type_info(), *pb->zone_, *ctx->pred());
+      if (no_match || (ctx->sel() != nullptr && !remaining_sel.AnySelected(nrows))) {
+        SkipUnloadedRows(ctx, nrows, no_match, &remaining_sel, &remaining_dst);
+        rem -= nrows;
+        pb->idx_in_block_ += nrows;
+        if (rem == 0) {
+          break;
+        }
+        continue;
+      }
+      RETURN_NOT_OK(LoadDataBlock(pb));
+    }
     if (reader_->is_nullable()) {
       DCHECK(ctx->block()->is_nullable());
 
@@ -946,6 +1428,9 @@ Status CFileIterator::Scan(ColumnMaterializationContext* ctx) {
                                                      ctx,
                                                      &remaining_sel,
                                                      &remaining_dst));
+          } else if (decode_selected_only) {
+            RETURN_NOT_OK(CopySelectedValues(pb->dblk_.get(), this_batch,
+                                             remaining_sel, remaining_dst));
           } else {
             RETURN_NOT_OK(pb->dblk_->CopyNextValues(&this_batch, &remaining_dst));
           }
@@ -977,6 +1462,10 @@ Status CFileIterator::Scan(ColumnMaterializationContext* ctx) {
 
       if (ctx->DecoderEvalNotDisabled()) {
         RETURN_NOT_OK(pb->dblk_->CopyNextAndEval(&this_batch, ctx, &remaining_sel, &remaining_dst));
+      } else if (decode_selected_only) {
+        this_batch = std::min(rem, pb->num_rows_in_block_ - pb->idx_in_block_);
+        RETURN_NOT_OK(CopySelectedValues(pb->dblk_.get(), this_batch,
+                                         remaining_sel, remaining_dst));
       } else {
         RETURN_NOT_OK(pb->dblk_->CopyNextValues(&this_batch, &remaining_dst));
       }
@@ -1008,6 +1497,146 @@ Status CFileIterator::Scan(ColumnMaterializationContext* ctx) {
   return Status::OK();
 }
 
+void CFileIterator::SkipUnloadedRows(ColumnMaterializationContext* ctx, size_t nrows,
+                                     bool clear_selection,
+                                     SelectionVectorView* sel, ColumnDataView* dst) {
+#ifndef NDEBUG
+  kudu::OverwriteWithPattern(reinterpret_cast<char *>(dst->data()),
+                             dst->stride() * nrows,
+                             "SKIPPEDSKIPPEDSKIPPED");
+#endif
+  if (clear_selection) {
+    sel->ClearBits(nrows);
+  }
+  // The cells are left unfilled, so mark them NULL in case the predicate is
+  // still evaluated over the whole block by the caller.
+  if (ctx->block()->is_nullable()) {
+    dst->SetNullBits(nrows, false);
+  }
+  dst->Advance(nrows);
+  sel->Advance(nrows);
+}
+
+Status CFileIterator::CopySelectedValues(BlockDecoder* dblk, size_t n,
+                                         SelectionVectorView sel, ColumnDataView dst) {
+  BitmapIterator runs = sel.IterateRuns(n);
+  bool selected = false;
+  size_t run;
+  while ((run = runs.Next(&selected)) > 0) {
+    if (selected) {
+      size_t this_batch = run;
+      RETURN_NOT_OK(dblk->CopyNextValues(&this_batch, &dst));
+      DCHECK_EQ(run, this_batch);
+    } else {
+      // This also covers whole data blocks when none of their rows in the
+      // batch are selected: the decoder simply seeks over them.
+#ifndef NDEBUG
+      kudu::OverwriteWithPattern(reinterpret_cast<char *>(dst.data()),
+                                 dst.stride() * run,
+                                 "UNSELECTEDUNSELECTED");
+#endif
+      int skipped = run;
+      dblk->SeekForward(&skipped);
+      DCHECK_EQ(run, skipped);
+    }
+    dst.Advance(run);
+  }
+  return Status::OK();
+}
+
+Status CFileIterator::ScanIsNull(ColumnMaterializationContext* ctx) {
+  ctx->SetDecoderEvalSupported();
+  ColumnDataView remaining_dst(ctx->block());
+  SelectionVectorView remaining_sel(ctx->sel());
+  uint32_t rem = last_prepare_count_;
+  DCHECK_LE(rem, ctx->block()->nrows());
+
+  if (!reader_->is_nullable()) {
+    // No row can match. The cells are left unfilled since none of them are
+    // selected.
+    remaining_sel.ClearBits(rem);
+    if (ctx->block()->is_nullable()) {
+      remaining_dst.SetNullBits(rem, true);
+    }
+    return Status::OK();
+  }
+  DCHECK(ctx->block()->is_nullable());
+
+  for (PreparedBlock *pb : prepared_blocks_) {
+    if (pb->needs_rewind_) {
+      SeekToPositionInBlock(pb, pb->rewind_idx_);
+    }
+
+    size_t count = std::min(rem, pb->num_rows_in_block_ - pb->idx_in_block_);
+    if (!pb->loaded_) {
+      if (pb->zone_->null_count() == 0) {
+        // The block has no NULLs, so none of its rows can match.
+        remaining_sel.ClearBits(count);
+#ifndef NDEBUG
+        kudu::OverwriteWithPattern(reinterpret_cast<char *>(remaining_dst.data()),
+                                   remaining_dst.stride() * count,
+                                   "SKIPPEDSKIPPEDSKIPPED");
+#endif
+        remaining_dst.SetNullBits(count, true);
+        rem -= count;
+        pb->idx_in_block_ += count;
+        remaining_dst.Advance(count);
+        remaining_sel.Advance(count);
+        if (rem == 0) {
+          break;
+        }
+        continue;
+      }
+      RETURN_NOT_OK(LoadDataBlock(pb));
+    }
+    // The number of non-null values skipped over in the data block.
+    int nonnull_skipped = 0;
+    while (count > 0) {
+      bool not_null = false;
+      size_t nblock = pb->rle_decoder_.GetNextRun(&not_null, count);
+      DCHECK_LE(nblock, count);
+      if (PREDICT_FALSE(nblock == 0)) {
+        return Status::Corruption(
+          Substitute("Unexpected EOF on NULL bitmap read. Expected at least $0 more rows",
+                     count));
+      }
+      if (not_null) {
+        // Non-null rows never match, so their values are not decoded.
+        remaining_sel.ClearBits(nblock);
+        nonnull_skipped += nblock;
+      }
+#ifndef NDEBUG
+      kudu::OverwriteWithPattern(reinterpret_cast<char *>(remaining_dst.data()),
+                                 remaining_dst.stride() * nblock,
+                                 "NULLNULLNULLNULLNULL");
+#endif
+      remaining_dst.SetNullBits(nblock, not_null);
+
+      rem -= nblock;
+      count -= nblock;
+      pb->idx_in_block_ += nblock;
+      remaining_dst.Advance(nblock);
+      remaining_sel.Advance(nblock);
+    }
+
+    // Keep the data block's position in sync with the null bitmap, since
+    // later seeks within the block rely on it.
+    if (nonnull_skipped > 0) {
+      int skipped = nonnull_skipped;
+      pb->dblk_->SeekForward(&skipped);
+      DCHECK_EQ(nonnull_skipped, skipped);
+      pb->needs_rewind_ = true;
+    }
+
+    if (rem == 0) {
+      break;
+    }
+  }
+
+  DCHECK_EQ(rem, 0) << "Should have fetched exactly the number of prepared rows";
+  return Status::OK();
+}
+
 Status CFileIterator::CopyNextValues(size_t* n, ColumnMaterializationContext* ctx) {
   RETURN_NOT_OK(PrepareBatch(n));
   RETURN_NOT_OK(Scan(ctx));
@@ -18,6 +18,7 @@
 #ifndef KUDU_CFILE_CFILE_READER_H
 #define KUDU_CFILE_CFILE_READER_H
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -35,6 +36,8 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/port.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/object_pool.h"
 #include "kudu/util/once.h"
@@ -44,10 +47,14 @@
 #include "kudu/common/key_encoder.h"
 
 namespace kudu {
+
+class BloomFilter;
+
 namespace cfile {
 
 class BlockCache;
 class BlockDecoder;
+class BlockReadahead;
 class BlockPointer;
 class CFileHeaderPB;
 class CFileFooterPB;
@@ -95,14 +102,35 @@ class CFileReader {
 
   // TODO: make this private? should only be used
   // by the iterator and index tree readers, I think.
+  //
+  // If the block is read from disk and cached, it is inserted into the block
+  // cache with the given priority. Index, bloom and other metadata blocks
+  // which are consulted on every access should use HIGH_PRIORITY.
+  //
+  // For files written with checksums, the block's checksum is verified when
+  // it is read from disk, before it is decompressed or cached.
   Status ReadBlock(const BlockPointer &ptr, CacheControl cache_control,
-                   BlockHandle *ret) const;
+                   BlockHandle *ret,
+                   Cache::Priority priority = Cache::NORMAL_PRIORITY) const;
 
   // Return the number of rows in this cfile.
   // This is assumed to be reasonably fast (i.e does not scan
   // the data)
   Status CountRows(rowid_t *count) const;
 
+  // Appends to 'blocks' a sample of the blocks of this cfile which were
+  // recently found in the block cache, most recently sampled first. See
+  // --cfile_hot_block_sample_interval.
+  void GetHotBlocks(std::vector<BlockPointer>* blocks) const;
+
+  // Reads the given blocks into the block cache, unless they're cached
+  // already, and adds the number of blocks read from disk to 'num_loaded'.
+  // Blocks which don't lie within the file are skipped.
+  Status WarmUp(const std::vector<BlockPointer>& blocks, int* num_loaded);
+
+  // Same as WarmUp(), for the root blocks of the cfile's indexes.
+  Status WarmUpIndex(int* num_loaded);
+
   // Retrieve the given metadata entry into 'val'.
   // Returns true if the entry was found, otherwise returns false.
   //
@@ -161,6 +189,14 @@ class CFileReader {
     return BlockPointer(footer().validx_info().root_block());
   }
 
+  // Return the in-memory directory of the value index, building it on the
+  // first call, or null if there is no value index or it has more entries
+  // than --cfile_value_index_directory_max_blocks. Init() must have been
+  // called.
+  const ValueIndexDirectory* GetValueIndexDirectory();
+
+  const BlockId& block_id() const { return block_->id(); }
+
   std::string ToString() const { return block_->id().ToString(); }
 
  private:
@@ -173,13 +209,30 @@ class CFileReader {
   // Callback used in 'init_once_' to initialize this cfile.
   Status InitOnce();
 
+  // Callback used in 'validx_dir_once_' to build 'validx_dir_'.
+  Status BuildValueIndexDirectoryOnce();
+
   Status ReadMagicAndLength(uint64_t offset, uint32_t *len);
   Status ReadAndParseHeader();
   Status ReadAndParseFooter();
 
+  // Checks the CRC32C trailer of 'block', the block at 'ptr' as read from
+  // disk, against the block's contents. Returns Status::Corruption on
+  // mismatch.
+  Status VerifyChecksum(const BlockPointer& ptr, const Slice& block) const;
+
   // Returns the memory usage of the object including the object itself.
   size_t memory_footprint() const;
 
+  // Reads the given blocks into the block cache with 'priority'. See
+  // WarmUp().
+  Status WarmUpWithPriority(const std::vector<BlockPointer>& blocks,
+                            Cache::Priority priority, int* num_loaded);
+
+  // Records 'ptr', just found in the block cache, as one of the hot blocks
+  // of the cfile if it's sampled.
+  void MaybeSampleHotBlock(const BlockPointer& ptr) const;
+
 #ifdef __clang__
   __attribute__((__unused__))
 #endif
@@ -196,6 +249,20 @@ class CFileReader {
 
   KuduOnceDynamic init_once_;
 
+  KuduOnceDynamic validx_dir_once_;
+  std::unique_ptr<ValueIndexDirectory> validx_dir_;
+
+  // The number of block cache hits, for sampling the hot blocks.
+  mutable AtomicInt<int64_t> cache_hits_;
+
+  // Protects 'hot_blocks_' and 'next_hot_block_'.
+  mutable simple_spinlock hot_blocks_lock_;
+
+  // The sampled hot blocks, as a ring of up to kMaxHotBlocks blocks, the
+  // next of which to replace is at 'next_hot_block_'.
+  mutable std::vector<BlockPointer> hot_blocks_;
+  mutable int next_hot_block_;
+
   ScopedTrackedConsumption mem_consumption_;
 };
 
@@ -319,6 +386,14 @@ class CFileIterator : public ColumnIterator {
   Status SeekAtOrAfter(const EncodedKey &encoded_key,
                        bool *exact_match);
 
+  // Look up a key, as SeekAtOrAfter() would, for a point lookup: sets
+  // *exact_match to whether the key is present and, if it is, *ordinal to
+  // its ordinal index. The iterator is left unseeked.
+  //
+  // If the reader has a value index directory, it locates the key's data
+  // block in memory instead of descending the value index.
+  Status LookupKey(const EncodedKey &encoded_key, bool *exact_match, rowid_t *ordinal);
+
   // Return true if this reader is currently seeked.
   // If the iterator is not seeked, it is an error to call any functions except
   // for seek (including GetCurrentOrdinal).
@@ -358,6 +433,14 @@ class CFileIterator : public ColumnIterator {
   // Return true if the next call to PrepareBatch will return at least one row.
   bool HasNext() const;
 
+  // Once a scan is seen to read the cfile's blocks sequentially, read the
+  // next --cfile_readahead_blocks data blocks ahead of it in the background.
+  // The prefetched blocks are charged to 'mem_tracker', whose limit caps the
+  // memory held by the readahead.
+  //
+  // Must be called before the iterator is first seeked.
+  void EnableReadahead(std::shared_ptr<MemTracker> mem_tracker);
+
   // Convenience method to prepare a batch, scan it, and finish it.
   Status CopyNextValues(size_t* n, ColumnMaterializationContext* ctx);
 
@@ -387,8 +470,17 @@ class CFileIterator : public ColumnIterator {
 
     // The rowid of the first row in this block.
     rowid_t first_row_idx() const {
-      return dblk_->GetFirstRowId();
+      return first_row_idx_;
     }
+    rowid_t first_row_idx_;
+
+    // Whether the block has been read. Blocks which are summarized by the
+    // cfile's zone map are only read once Scan() needs their contents; until
+    // then only the row range and the seeked position of the block are valid.
+    bool loaded_;
+
+    // The zone map entry of this block, or NULL if the cfile has none.
+    const ZoneMapEntryPB* zone_;
 
     // The index of the seeked position, relative to the start of the block.
     // In case of null bitmap present, dblk_->GetCurrentIndex() is not aligned
@@ -423,6 +515,16 @@ class CFileIterator : public ColumnIterator {
   // Seek the given PreparedBlock to the given index within it.
   void SeekToPositionInBlock(PreparedBlock *pb, uint32_t idx_in_block);
 
+  // Evaluates an IS NULL predicate for the prepared rows using only the
+  // null bitmaps of the prepared blocks. Values are never decoded.
+  Status ScanIsNull(ColumnMaterializationContext* ctx);
+
+  // Copies the next 'n' values of 'dblk' into 'dst', decoding only the values
+  // of rows selected in 'sel'. The values of unselected rows are skipped over
+  // and their cells are left unfilled.
+  Status CopySelectedValues(BlockDecoder* dblk, size_t n,
+                            SelectionVectorView sel, ColumnDataView dst);
+
   // Read the data block currently pointed to by idx_iter_
   // into the given PreparedBlock structure.
   //
@@ -430,10 +532,42 @@ class CFileIterator : public ColumnIterator {
   Status ReadCurrentDataBlock(const IndexTreeIterator &idx_iter,
                               PreparedBlock *prep_block);
 
-  // Read the data block currently pointed to by idx_iter_, and enqueue
-  // it onto the end of the prepared_blocks_ deque.
+  // Read the data block at 'dblk_ptr' into the given PreparedBlock structure.
+  Status ReadDataBlock(const BlockPointer &dblk_ptr, PreparedBlock *prep_block);
+
+  // Read a block whose loading was deferred by QueueCurrentDataBlock(),
+  // positioning it at its seeked index.
+  Status LoadDataBlock(PreparedBlock *pb);
+
+  // Enqueue the data block currently pointed to by idx_iter_ onto the end of
+  // the prepared_blocks_ deque. If the block is summarized by the zone map,
+  // reading it is deferred until its values are needed.
   Status QueueCurrentDataBlock(const IndexTreeIterator &idx_iter);
 
+  // Return the zone map entry of the block starting at 'first_row_idx', or
+  // NULL if there is none.
+  const ZoneMapEntryPB* FindZone(rowid_t first_row_idx) const;
+
+  // Set 'may_match' to false if the value bloom filter of the file shows
+  // that none of its values satisfy 'pred'. The filter is read on first use.
+  Status CheckValueBloom(const ColumnPredicate& pred, bool* may_match);
+
+  // Skip the next 'nrows' rows of an unread block, leaving their cells
+  // unfilled. If 'clear_selection' is true, the rows are also deselected.
+  void SkipUnloadedRows(ColumnMaterializationContext* ctx, size_t nrows,
+                        bool clear_selection,
+                        SelectionVectorView* sel, ColumnDataView* dst);
+
+  // Called after 'seeked_' advanced to its next block. Once enough blocks
+  // were read in sequence since the last seek, prefetches the blocks
+  // following the current one.
+  Status ReadAheadOfCurrentBlock();
+
+  // Called when 'pb' is released without having been read, e.g. because the
+  // zone map showed it held no matching rows. The scan is then not reading
+  // every block, so reading ahead is suspended until the next seek.
+  void ReleaseUnloadedBlock(PreparedBlock *pb);
+
   // Fully initialize the underlying cfile reader if needed, and clear any
   // seek-related state.
   Status PrepareForNewSeek();
@@ -450,6 +584,19 @@ class CFileIterator : public ColumnIterator {
   // Set containing the codewords that match the predicate in a dictionary.
   std::unique_ptr<SelectionVector> codewords_matching_pred_;
 
+  // Per-block statistics of the cfile, if it was written with a zone map.
+  gscoped_ptr<ZoneMapPB> zone_map_;
+
+  // The bloom filter of the values of the cfile, if it was written with one
+  // and an equality or IN-list predicate was checked against it.
+  BlockHandle value_bloom_handle_;
+  gscoped_ptr<BloomFilter> value_bloom_;
+
+  // The predicate last checked against 'value_bloom_', and the result. The
+  // predicate is the same for each scan of the iterator.
+  const ColumnPredicate* value_bloom_pred_;
+  bool value_bloom_may_match_;
+
   // The currently in-use index iterator. This is equal to either
   // posidx_iter_.get(), validx_iter_.get(), or NULL if not seeked.
   IndexTreeIterator *seeked_;
@@ -468,6 +615,22 @@ class CFileIterator : public ColumnIterator {
   // Whether this iterator will ask the cfile to cache the blocks it requests or not.
   const CFileReader::CacheControl cache_control_;
 
+  // Reads data blocks ahead of the scan, or NULL if readahead is disabled.
+  gscoped_ptr<BlockReadahead> readahead_;
+
+  // A second cursor over the index of 'seeked_', which leads it by up to
+  // --cfile_readahead_blocks blocks. NULL until a sequential scan is seen.
+  gscoped_ptr<IndexTreeIterator> readahead_iter_;
+
+  // The number of blocks 'readahead_iter_' is ahead of 'seeked_'.
+  int readahead_distance_;
+
+  // The number of blocks 'seeked_' advanced over since the last seek.
+  int sequential_blocks_;
+
+  // Whether a block was skipped without being read since the last seek.
+  bool readahead_suspended_;
+
   // RowID of the current prepared batch, if prepared_ is true.
   // Otherwise, the RowID of the next batch that will be prepared.
   rowid_t last_prepare_idx_;
@@ -46,6 +46,7 @@ Status DumpIterator(const CFileReader& reader,
   uint8_t nulls[BitmapSize(max_rows)];
   ColumnBlock cb(type, reader.is_nullable() ? nulls : nullptr, buf, max_rows, &arena);
   SelectionVector sel(max_rows);
+  sel.SetAllTrue();
   ColumnMaterializationContext ctx(0, nullptr, &cb, &sel);
   string strbuf;
   size_t count = 0;
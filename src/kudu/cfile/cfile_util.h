@@ -60,6 +60,10 @@ struct WriterOptions {
   // instead of entire keys.
   bool optimize_index_keys;
 
+  // Whether to record the min/max value and NULL count of each data block,
+  // allowing readers to skip blocks which cannot match a predicate.
+  bool write_zone_map;
+
   // Column storage attributes.
   //
   // Default: all default values as specified in the constructor in
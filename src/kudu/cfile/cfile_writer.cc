@@ -26,9 +26,13 @@
 #include "kudu/cfile/index_btree.h"
 #include "kudu/cfile/type_encodings.h"
 #include "kudu/cfile/cfile_util.h"
+#include "kudu/cfile/zone_map.h"
+#include "kudu/common/common.pb.h"
 #include "kudu/common/key_encoder.h"
 #include "kudu/gutil/endian.h"
+#include "kudu/util/bloom_filter.h"
 #include "kudu/util/coding.h"
+#include "kudu/util/crc.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/hexdump.h"
@@ -64,6 +68,21 @@ DEFINE_string(cfile_do_on_finish, "flush",
               "Possible values are 'close', 'flush', or 'nothing'.");
 TAG_FLAG(cfile_do_on_finish, experimental);
 
+DEFINE_bool(cfile_write_checksums, false,
+            "Write a CRC32C checksum after each block in newly written cfiles, "
+            "which is verified whenever the block is read from disk. Versions "
+            "which predate the checksums misread these cfiles as corrupt data, "
+            "so enabling it rules out downgrades, and breaks tablet copies to "
+            "servers running older versions. Only enable it once every server "
+            "of the cluster has been upgraded.");
+TAG_FLAG(cfile_write_checksums, advanced);
+TAG_FLAG(cfile_write_checksums, experimental);
+
+DEFINE_double(cfile_value_bloom_fp_rate, 0.01,
+              "Target false-positive rate (between 0 and 1) to size the bloom filters "
+              "of the values of the columns which have them.");
+TAG_FLAG(cfile_value_bloom_fp_rate, advanced);
+
 namespace kudu {
 namespace cfile {
 
@@ -84,7 +103,8 @@ WriterOptions::WriterOptions()
     block_restart_interval(16),
     write_posidx(false),
     write_validx(false),
-    optimize_index_keys(true) {
+    optimize_index_keys(true),
+    write_zone_map(false) {
 }
 
 
@@ -103,6 +123,7 @@ CFileWriter::CFileWriter(const WriterOptions &options,
     options_(options),
     is_nullable_(is_nullable),
     typeinfo_(typeinfo),
+    write_checksums_(FLAGS_cfile_write_checksums),
     key_encoder_(nullptr),
     state_(kWriterInitialized) {
   EncodingType encoding = options_.storage_attributes.encoding;
@@ -140,6 +161,14 @@ CFileWriter::CFileWriter(const WriterOptions &options,
     key_encoder_ = &GetKeyEncoder<faststring>(typeinfo_);
     validx_builder_.reset(new IndexTreeBuilder(&options_, this));
   }
+
+  if (options.write_zone_map) {
+    zone_map_builder_.reset(new ZoneMapBuilder(typeinfo_));
+  }
+
+  if (options_.storage_attributes.bloom_filter) {
+    value_bloom_builder_.reset(new ValueBloomBuilder(typeinfo_));
+  }
 }
 
 CFileWriter::~CFileWriter() {
@@ -152,7 +181,9 @@ Status CFileWriter::Start() {
 
   if (compression_ != NO_COMPRESSION) {
     const CompressionCodec* codec;
-    RETURN_NOT_OK(GetCompressionCodec(compression_, &codec));
+    RETURN_NOT_OK(GetCompressionCodec(compression_,
+                                      options_.storage_attributes.compression_level,
+                                      &codec));
     block_compressor_ .reset(new CompressedBlockBuilder(codec, kBlockSizeLimit));
   }
 
@@ -214,6 +245,9 @@ Status CFileWriter::FinishAndReleaseBlock(ScopedWritableBlockCloser* closer) {
   footer.set_encoding(type_encoding_info_->encoding_type());
   footer.set_num_values(value_count_);
   footer.set_compression(compression_);
+  if (write_checksums_) {
+    footer.set_incompatible_features(IncompatibleFeatures::CHECKSUM);
+  }
 
   // Write out any pending positional index blocks.
   if (options_.write_posidx) {
@@ -229,6 +263,14 @@ Status CFileWriter::FinishAndReleaseBlock(ScopedWritableBlockCloser* closer) {
     footer.mutable_validx_info()->CopyFrom(validx_info);
   }
 
+  if (zone_map_builder_ != nullptr) {
+    RETURN_NOT_OK_PREPEND(WriteZoneMap(&footer), "Couldn't write zone map");
+  }
+
+  if (value_bloom_builder_ != nullptr) {
+    RETURN_NOT_OK_PREPEND(WriteValueBloom(&footer), "Couldn't write value bloom filter");
+  }
+
   // Optionally append extra information to the end of cfile.
   // Example: dictionary block for dictionary encoding
   RETURN_NOT_OK(data_block_->AppendExtraInfo(this, &footer));
@@ -298,6 +340,12 @@ Status CFileWriter::AppendEntries(const void *entries, size_t count) {
     int n = data_block_->Add(ptr, rem);
     DCHECK_GE(n, 0);
 
+    if (zone_map_builder_ != nullptr) {
+      zone_map_builder_->AddValues(ptr, n);
+    }
+    if (value_bloom_builder_ != nullptr) {
+      value_bloom_builder_->AddValues(ptr, n);
+    }
     ptr += typeinfo_->size() * n;
     rem -= n;
     value_count_ += n;
@@ -329,6 +377,12 @@ Status CFileWriter::AppendNullableEntries(const uint8_t *bitmap,
         DCHECK_GE(n, 0);
 
         null_bitmap_builder_->AddRun(true, n);
+        if (zone_map_builder_ != nullptr) {
+          zone_map_builder_->AddValues(ptr, n);
+        }
+        if (value_bloom_builder_ != nullptr) {
+          value_bloom_builder_->AddValues(ptr, n);
+        }
         ptr += n * typeinfo_->size();
         value_count_ += n;
         rem -= n;
@@ -340,6 +394,9 @@ Status CFileWriter::AppendNullableEntries(const uint8_t *bitmap,
       } while (rem > 0);
     } else {
       null_bitmap_builder_->AddRun(false, nblock);
+      if (zone_map_builder_ != nullptr) {
+        zone_map_builder_->AddNulls(nblock);
+      }
       ptr += nblock * typeinfo_->size();
       value_count_ += nblock;
     }
@@ -386,15 +443,23 @@ Status CFileWriter::FinishCurDataBlock() {
     v.push_back(null_bitmap);
   }
   v.push_back(data);
+  BlockPointer block_ptr;
   Status s = AppendRawBlock(v, first_elem_ord,
                             reinterpret_cast<const void *>(key_tmp_space),
                             Slice(last_key_),
-                            "data block");
+                            "data block", &block_ptr);
+  if (s.ok() && data_block_callback_) {
+    data_block_callback_(block_ptr, first_elem_ord, num_elems_in_block);
+  }
 
   if (is_nullable_) {
     null_bitmap_builder_->Reset();
   }
 
+  if (zone_map_builder_ != nullptr) {
+    zone_map_builder_->FinishBlock(first_elem_ord);
+  }
+
   if (validx_builder_ != nullptr) {
     RETURN_NOT_OK(data_block_->GetLastKey(key_tmp_space));
     key_encoder_->ResetAndEncode(key_tmp_space, &last_key_);
@@ -404,11 +469,35 @@ Status CFileWriter::FinishCurDataBlock() {
   return s;
 }
 
+Status CFileWriter::WriteZoneMap(CFileFooterPB* footer) {
+  faststring buf;
+  if (!pb_util::SerializeToString(zone_map_builder_->zone_map(), &buf)) {
+    return Status::Corruption("unable to serialize zone map");
+  }
+  BlockPointer ptr;
+  RETURN_NOT_OK(AddBlock({ Slice(buf) }, &ptr, "zone map"));
+  ptr.CopyToPB(footer->mutable_zone_map_block_ptr());
+  zone_map_builder_->GetFileEntry(footer->mutable_file_zone_map());
+  footer->set_ndv_sketch(zone_map_builder_->ndv_sketch().registers().ToString());
+  return Status::OK();
+}
+
+Status CFileWriter::WriteValueBloom(CFileFooterPB* footer) {
+  gscoped_ptr<BloomFilterBuilder> bloom;
+  value_bloom_builder_->Finish(FLAGS_cfile_value_bloom_fp_rate, &bloom,
+                               footer->mutable_value_bloom_header());
+  BlockPointer ptr;
+  RETURN_NOT_OK(AddBlock({ bloom->slice() }, &ptr, "value bloom filter"));
+  ptr.CopyToPB(footer->mutable_value_bloom_block_ptr());
+  return Status::OK();
+}
+
 Status CFileWriter::AppendRawBlock(const vector<Slice> &data_slices,
                                    size_t ordinal_pos,
                                    const void *validx_curr,
                                    const Slice &validx_prev,
-                                   const char *name_for_log) {
+                                   const char *name_for_log,
+                                   BlockPointer* block_ptr) {
   CHECK_EQ(state_, kWriterWriting);
 
   BlockPointer ptr;
@@ -417,6 +506,9 @@ Status CFileWriter::AppendRawBlock(const vector<Slice> &data_slices,
     LOG(WARNING) << "Unable to append block to file: " << s.ToString();
     return s;
   }
+  if (block_ptr) {
+    *block_ptr = ptr;
+  }
 
   // Now add to the index blocks
   if (posidx_builder_ != nullptr) {
@@ -446,6 +538,22 @@ Status CFileWriter::AppendRawBlock(const vector<Slice> &data_slices,
   return s;
 }
 
+void CFileWriter::GetColumnStatistics(ColumnStatisticsPB* stats) const {
+  CHECK(zone_map_builder_ != nullptr);
+  CHECK_EQ(state_, kWriterFinished);
+  ZoneMapEntryPB entry;
+  zone_map_builder_->GetFileEntry(&entry);
+  stats->Clear();
+  stats->set_num_rows(entry.num_rows());
+  stats->set_null_count(entry.null_count());
+  if (entry.has_min_value() && entry.has_max_value()) {
+    stats->set_min_value(entry.min_value());
+    stats->set_max_value(entry.max_value());
+  }
+  stats->set_ndv_sketch(zone_map_builder_->ndv_sketch().registers().ToString());
+  stats->set_total_bytes(written_size());
+}
+
 size_t CFileWriter::written_size() const {
   // This is a low estimate, but that's OK -- this is checked after every block
   // write during flush/compact, so better to give a fast slightly-inaccurate result
@@ -457,6 +565,8 @@ Status CFileWriter::AddBlock(const vector<Slice> &data_slices,
                              BlockPointer *block_ptr,
                              const char *name_for_log) {
   uint64_t start_offset = off_;
+  uint64_t crc = 0;
+  crc::Crc* crc32c = write_checksums_ ? crc::GetCrc32cInstance() : nullptr;
 
   if (block_compressor_ != nullptr) {
     // Write compressed block
@@ -470,13 +580,25 @@ Status CFileWriter::AddBlock(const vector<Slice> &data_slices,
     }
 
     RETURN_NOT_OK(WriteRawData(cdata));
+    if (crc32c) {
+      crc32c->Compute(cdata.data(), cdata.size(), &crc);
+    }
   } else {
     // Write uncompressed block
     for (const Slice &data : data_slices) {
       RETURN_NOT_OK(WriteRawData(data));
+      if (crc32c) {
+        crc32c->Compute(data.data(), data.size(), &crc);
+      }
     }
   }
 
+  if (crc32c) {
+    uint8_t crc_buf[kBlockChecksumSize];
+    EncodeFixed32(crc_buf, static_cast<uint32_t>(crc));
+    RETURN_NOT_OK(WriteRawData(Slice(crc_buf, kBlockChecksumSize)));
+  }
+
   uint64_t total_size = off_ - start_offset;
 
   *block_ptr = BlockPointer(start_offset, total_size);
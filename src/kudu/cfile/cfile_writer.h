@@ -18,6 +18,7 @@
 #ifndef KUDU_CFILE_CFILE_WRITER_H
 #define KUDU_CFILE_CFILE_WRITER_H
 
+#include <functional>
 #include <unordered_map>
 #include <stdint.h>
 #include <string>
@@ -42,6 +43,7 @@
 
 namespace kudu {
 class Arena;
+class ColumnStatisticsPB;
 
 namespace cfile {
 using std::unordered_map;
@@ -51,6 +53,8 @@ class BTreeInfoPB;
 class GVIntBlockBuilder;
 class BinaryPrefixBlockBuilder;
 class IndexTreeBuilder;
+class ValueBloomBuilder;
+class ZoneMapBuilder;
 
 // Magic used in header/footer
 extern const char kMagicString[];
@@ -58,6 +62,10 @@ extern const char kMagicString[];
 const int kCFileMajorVersion = 1;
 const int kCFileMinorVersion = 0;
 
+// Size of the CRC32C trailer written after each block when the file has the
+// CHECKSUM incompatible feature.
+const size_t kBlockChecksumSize = sizeof(uint32_t);
+
 class NullBitmapBuilder {
  public:
   explicit NullBitmapBuilder(size_t initial_row_capacity)
@@ -95,6 +103,11 @@ class NullBitmapBuilder {
 // Main class used to write a CFile.
 class CFileWriter {
  public:
+  // Called with each data block once it's written: the pointer to the block,
+  // the ordinal of its first value and its number of values.
+  typedef std::function<void(const BlockPointer& ptr, rowid_t first_ordinal,
+                             uint32_t num_values)> DataBlockCallback;
+
   explicit CFileWriter(const WriterOptions &options,
                        const TypeInfo* typeinfo,
                        bool is_nullable,
@@ -142,12 +155,24 @@ class CFileWriter {
   //
   // validx_prev should be a Slice pointing to the last key of the previous block.
   // It will be used to optimize the value index entry for the block.
+  //
+  // If 'block_ptr' isn't NULL, it's set to point to the appended block.
   Status AppendRawBlock(const vector<Slice> &data_slices,
                         size_t ordinal_pos,
                         const void *validx_curr,
                         const Slice &validx_prev,
-                        const char *name_for_log);
+                        const char *name_for_log,
+                        BlockPointer* block_ptr = nullptr);
+
 
+  // Write out the values appended since the last data block, if any, as a
+  // data block of their own.
+  Status FinishCurDataBlock();
+
+  // Set the callback called with each data block written from now on.
+  void set_data_block_callback(DataBlockCallback cb) {
+    data_block_callback_ = std::move(cb);
+  }
 
   // Return the amount of data written so far to this CFile.
   // More data may be written by Finish(), but this is an approximation.
@@ -160,6 +185,13 @@ class CFileWriter {
     return value_count_;
   }
 
+  // Fill 'stats' with the statistics of the values written to the file. Its
+  // total_bytes is the written_size() of the file.
+  //
+  // REQUIRES: the writer was configured with a zone map, and Finish() or
+  // FinishAndReleaseBlock() already called.
+  void GetColumnStatistics(ColumnStatisticsPB* stats) const;
+
   std::string ToString() const { return block_->id().ToString(); }
 
   // Wrapper for AddBlock() to append the dictionary block to the end of a Cfile.
@@ -182,7 +214,12 @@ class CFileWriter {
 
   Status WriteRawData(const Slice& data);
 
-  Status FinishCurDataBlock();
+  // Append the zone map block and record it, along with the file-level
+  // zone map entry, in 'footer'.
+  Status WriteZoneMap(CFileFooterPB* footer);
+
+  // Append the value bloom filter block and record it in 'footer'.
+  Status WriteValueBloom(CFileFooterPB* footer);
 
   // Flush the current unflushed_metadata_ entries into the given protobuf
   // field, clearing the buffer.
@@ -203,6 +240,9 @@ class CFileWriter {
   bool is_nullable_;
   CompressionType compression_;
   const TypeInfo* typeinfo_;
+
+  // Whether each block is followed by a CRC32C of its contents.
+  bool write_checksums_;
   const TypeEncodingInfo* type_encoding_info_;
 
   // The key-encoder. Only set if the writer is writing an embedded
@@ -224,6 +264,10 @@ class CFileWriter {
   gscoped_ptr<IndexTreeBuilder> validx_builder_;
   gscoped_ptr<NullBitmapBuilder> null_bitmap_builder_;
   gscoped_ptr<CompressedBlockBuilder> block_compressor_;
+  gscoped_ptr<ZoneMapBuilder> zone_map_builder_;
+  gscoped_ptr<ValueBloomBuilder> value_bloom_builder_;
+
+  DataBlockCallback data_block_callback_;
 
   enum State {
     kWriterInitialized,
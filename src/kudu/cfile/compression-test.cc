@@ -26,6 +26,7 @@
 #include "kudu/cfile/compression_codec.h"
 #include "kudu/cfile/index_block.h"
 #include "kudu/cfile/index_btree.h"
+#include "kudu/gutil/stringprintf.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 #include "kudu/util/status.h"
@@ -111,6 +112,43 @@ TEST_F(TestCompression, TestZlibCompressionCodec) {
   TestCompressionCodec(ZLIB);
 }
 
+TEST_F(TestCompression, TestZstdCompressionCodec) {
+  TestCompressionCodec(ZSTD);
+}
+
+TEST_F(TestCompression, TestZstdCompressionLevels) {
+  const CompressionCodec* default_codec;
+  const CompressionCodec* codec;
+  ASSERT_OK(GetCompressionCodec(ZSTD, &default_codec));
+  ASSERT_OK(GetCompressionCodec(ZSTD, 0, &codec));
+  ASSERT_EQ(default_codec, codec);
+
+  // Data compressed at any level must be readable by the default codec,
+  // since readers don't know the level a block was written with.
+  string input;
+  for (int i = 0; i < 1000; i++) {
+    input.append(StringPrintf("row %d, value %d;", i, i % 17));
+  }
+  for (int level : { 1, 9, 19 }) {
+    SCOPED_TRACE(level);
+    ASSERT_OK(GetCompressionCodec(ZSTD, level, &codec));
+    gscoped_array<uint8_t> cbuffer(new uint8_t[codec->MaxCompressedLength(input.size())]);
+    size_t compressed;
+    ASSERT_OK(codec->Compress(Slice(input), cbuffer.get(), &compressed));
+    ASSERT_LT(compressed, input.size());
+
+    gscoped_array<uint8_t> ubuffer(new uint8_t[input.size()]);
+    ASSERT_OK(default_codec->Uncompress(Slice(cbuffer.get(), compressed),
+                                        ubuffer.get(), input.size()));
+    ASSERT_EQ(0, memcmp(input.data(), ubuffer.get(), input.size()));
+  }
+
+  Status s = GetCompressionCodec(ZSTD, -1, &codec);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  s = GetCompressionCodec(ZSTD, 1000, &codec);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+}
+
 TEST_F(TestCompression, TestCFileNoCompressionReadWrite) {
   TestReadWriteCompressed(NO_COMPRESSION);
 }
@@ -127,5 +165,9 @@ TEST_F(TestCompression, TestCFileZlibReadWrite) {
   TestReadWriteCompressed(ZLIB);
 }
 
+TEST_F(TestCompression, TestCFileZstdReadWrite) {
+  TestReadWriteCompressed(ZSTD);
+}
+
 } // namespace cfile
 } // namespace kudu
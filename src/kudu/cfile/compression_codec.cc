@@ -20,6 +20,7 @@
 #include <snappy.h>
 #include <zlib.h>
 #include <lz4.h>
+#include <zstd.h>
 #include <string>
 #include <vector>
 
@@ -225,8 +226,92 @@ class ZlibCodec : public CompressionCodec {
   }
 };
 
+class ZstdCodec : public CompressionCodec {
+ public:
+  // The level used when a column does not specify one.
+  static const int kDefaultLevel = 3;
+
+  // Returns the codec for 'level', or nullptr if the level is out of range.
+  // A level of 0 selects kDefaultLevel.
+  static const ZstdCodec* GetInstance(int level) {
+    // One codec per level, created on first use and never destroyed, in
+    // the same way as the Singleton<> codecs above.
+    static const ZstdCodec* const* codecs = CreateInstances();
+    if (level == 0) {
+      level = kDefaultLevel;
+    }
+    if (level < 1 || level > ZSTD_maxCLevel()) {
+      return nullptr;
+    }
+    return codecs[level];
+  }
+
+  Status Compress(const Slice& input,
+                  uint8_t *compressed, size_t *compressed_length) const OVERRIDE {
+    size_t n = ZSTD_compress(compressed, MaxCompressedLength(input.size()),
+                             input.data(), input.size(), level_);
+    if (ZSTD_isError(n)) {
+      return Status::IOError("unable to compress the buffer", ZSTD_getErrorName(n));
+    }
+    *compressed_length = n;
+    return Status::OK();
+  }
+
+  Status Compress(const vector<Slice>& input_slices,
+                  uint8_t *compressed, size_t *compressed_length) const OVERRIDE {
+    if (input_slices.size() == 1) {
+      return Compress(input_slices[0], compressed, compressed_length);
+    }
+
+    SlicesSource source(input_slices);
+    faststring buffer;
+    source.Dump(&buffer);
+    return Compress(Slice(buffer.data(), buffer.size()), compressed, compressed_length);
+  }
+
+  Status Uncompress(const Slice& compressed,
+                    uint8_t *uncompressed, size_t uncompressed_length) const OVERRIDE {
+    size_t n = ZSTD_decompress(uncompressed, uncompressed_length,
+                               compressed.data(), compressed.size());
+    if (ZSTD_isError(n)) {
+      return Status::Corruption("unable to uncompress the buffer", ZSTD_getErrorName(n));
+    }
+    if (n != uncompressed_length) {
+      return Status::Corruption(
+          StringPrintf("uncompressed size mismatch: expected %zu, got %zu",
+                       uncompressed_length, n));
+    }
+    return Status::OK();
+  }
+
+  size_t MaxCompressedLength(size_t source_bytes) const OVERRIDE {
+    return ZSTD_compressBound(source_bytes);
+  }
+
+ private:
+  explicit ZstdCodec(int level) : level_(level) {}
+
+  static const ZstdCodec* const* CreateInstances() {
+    int max_level = ZSTD_maxCLevel();
+    const ZstdCodec** codecs = new const ZstdCodec*[max_level + 1];
+    codecs[0] = nullptr;
+    for (int level = 1; level <= max_level; level++) {
+      codecs[level] = new ZstdCodec(level);
+    }
+    return codecs;
+  }
+
+  const int level_;
+};
+
 Status GetCompressionCodec(CompressionType compression,
                            const CompressionCodec** codec) {
+  return GetCompressionCodec(compression, 0, codec);
+}
+
+Status GetCompressionCodec(CompressionType compression,
+                           int level,
+                           const CompressionCodec** codec) {
   switch (compression) {
     case NO_COMPRESSION:
       *codec = nullptr;
@@ -240,6 +325,14 @@ Status GetCompressionCodec(CompressionType compression,
     case ZLIB:
       *codec = ZlibCodec::GetSingleton();
       break;
+    case ZSTD:
+      *codec = ZstdCodec::GetInstance(level);
+      if (*codec == nullptr) {
+        return Status::InvalidArgument(
+            StringPrintf("bad ZSTD compression level %d (expected 1 to %d)",
+                         level, ZSTD_maxCLevel()));
+      }
+      break;
     default:
       return Status::NotFound("bad compression type");
   }
@@ -253,6 +346,8 @@ CompressionType GetCompressionCodecType(const std::string& name) {
     return LZ4;
   if (name.compare("zlib") == 0)
     return ZLIB;
+  if (name.compare("zstd") == 0)
+    return ZSTD;
   if (name.compare("none") == 0)
     return NO_COMPRESSION;
 
@@ -66,6 +66,13 @@ class CompressionCodec {
 Status GetCompressionCodec(CompressionType compression,
                            const CompressionCodec** codec);
 
+// Same as above, but for codecs which support a compression level. A level
+// of 0 selects the codec's default level; codecs without levels ignore it.
+// Returns InvalidArgument if the level is out of range for the codec.
+Status GetCompressionCodec(CompressionType compression,
+                           int level,
+                           const CompressionCodec** codec);
+
 // Returns the compression codec type given the name
 CompressionType GetCompressionCodecType(const std::string& name);
 
@@ -0,0 +1,98 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/cfile/delta_for_block.h"
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/port.h"
+
+namespace kudu {
+namespace cfile {
+
+namespace {
+
+// Unpack a miniblock of values which are 'kWidth' bits wide. Since the width
+// is a compile-time constant, the shifts and masks of each value are too,
+// which lets the compiler unroll and vectorize the loop.
+template<int kWidth>
+void UnpackMiniBlock(const uint8_t* src, uint64_t* dst) {
+  const uint64_t mask = kWidth == 64 ? ~0ULL : (1ULL << (kWidth % 64)) - 1;
+  for (size_t i = 0; i < kDeltaForMiniBlockSize; i++) {
+    const size_t bit = i * kWidth;
+    const uint8_t* p = src + bit / 8;
+    const int shift = bit % 8;
+    uint64_t v = UNALIGNED_LOAD64(p) >> shift;
+    // Values wider than 56 bits may straddle a ninth byte.
+    if (kWidth > 56 && shift + kWidth > 64) {
+      v |= static_cast<uint64_t>(p[8]) << (64 - shift);
+    }
+    dst[i] = v & mask;
+  }
+}
+
+template<>
+void UnpackMiniBlock<0>(const uint8_t* src, uint64_t* dst) {
+  memset(dst, 0, kDeltaForMiniBlockSize * sizeof(uint64_t));
+}
+
+} // anonymous namespace
+
+void DeltaForPackMiniBlock(const uint64_t* src, int width, faststring* dst) {
+  DCHECK_GE(width, 0);
+  DCHECK_LE(width, 64);
+  uint64_t word = 0;
+  int bits = 0;
+  for (size_t i = 0; i < kDeltaForMiniBlockSize && width > 0; i++) {
+    const uint64_t v = src[i];
+    word |= v << bits;
+    bits += width;
+    if (bits >= 64) {
+      InlinePutFixed64(dst, word);
+      bits -= 64;
+      // Carry over the high bits of 'v' which didn't fit in the word.
+      word = bits == 0 ? 0 : v >> (width - bits);
+    }
+  }
+  // A miniblock always packs into a whole number of 64-bit words.
+  DCHECK_EQ(0, bits);
+}
+
+void DeltaForUnpackMiniBlock(const uint8_t* src, int width, uint64_t* dst) {
+  switch (width) {
+#define UNPACK_CASE(w) case w: UnpackMiniBlock<w>(src, dst); return;
+#define UNPACK_CASE8(w) \
+    UNPACK_CASE(w) UNPACK_CASE(w + 1) UNPACK_CASE(w + 2) UNPACK_CASE(w + 3) \
+    UNPACK_CASE(w + 4) UNPACK_CASE(w + 5) UNPACK_CASE(w + 6) UNPACK_CASE(w + 7)
+    UNPACK_CASE8(0)
+    UNPACK_CASE8(8)
+    UNPACK_CASE8(16)
+    UNPACK_CASE8(24)
+    UNPACK_CASE8(32)
+    UNPACK_CASE8(40)
+    UNPACK_CASE8(48)
+    UNPACK_CASE8(56)
+    UNPACK_CASE(64)
+#undef UNPACK_CASE8
+#undef UNPACK_CASE
+    default:
+      LOG(FATAL) << "invalid bit width: " << width;
+  }
+}
+
+} // namespace cfile
+} // namespace kudu
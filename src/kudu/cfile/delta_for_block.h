@@ -0,0 +1,424 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Delta plus frame-of-reference encoding for integer type blocks.
+//
+// Suited to monotonic and near-monotonic sequences such as timestamps,
+// sequence numbers and auto-increment keys, whose consecutive differences
+// span a much smaller range than the values themselves.
+#ifndef KUDU_CFILE_DELTA_FOR_BLOCK_H
+#define KUDU_CFILE_DELTA_FOR_BLOCK_H
+
+#include <algorithm>
+#include <stdint.h>
+#include <type_traits>
+#include <vector>
+
+#include "kudu/cfile/block_encodings.h"
+#include "kudu/cfile/cfile_util.h"
+#include "kudu/common/columnblock.h"
+#include "kudu/gutil/bits.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/alignment.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/coding-inl.h"
+
+namespace kudu {
+namespace cfile {
+
+// Number of values sharing a frame of reference and a bit width.
+static const size_t kDeltaForMiniBlockSize = 128;
+
+// Append the low 'width' bits of each of the kDeltaForMiniBlockSize values
+// of 'src' to 'dst', packed least significant bit first. Appends exactly
+// 16 * 'width' bytes.
+void DeltaForPackMiniBlock(const uint64_t* src, int width, faststring* dst);
+
+// Unpack kDeltaForMiniBlockSize values of 'width' bits from 'src' into 'dst'.
+// May load up to 8 bytes past the end of the packed values.
+void DeltaForUnpackMiniBlock(const uint8_t* src, int width, uint64_t* dst);
+
+// DeltaForBlockBuilder encodes the differences between consecutive values,
+// split into miniblocks of kDeltaForMiniBlockSize values. Each miniblock
+// bit-packs its differences relative to the smallest of them, using as many
+// bits as the widest one needs.
+//
+// Block layout (little endian):
+// 1. ordinal of the first element within the block (uint32_t).
+// 2. num of elements within the block (uint32_t).
+// 3. a descriptor for each miniblock, of:
+//    a. the value preceding the first element of the miniblock, or the first
+//       element itself for the first miniblock (uint64_t).
+//    b. the smallest difference within the miniblock (uint64_t).
+//    c. the bit width of the packed differences (uint8_t).
+// 4. the packed differences of each miniblock. The last miniblock is padded
+//    with zeros, so that each one takes exactly 16 * width bytes.
+// 5. 8 bytes of padding, so that unpacking may always load 64 bits at once.
+//
+// The difference of the first element of the block is always 0. All
+// arithmetic wraps around within the width of the type.
+template<DataType Type>
+class DeltaForBlockBuilder : public BlockBuilder {
+ public:
+  explicit DeltaForBlockBuilder(const WriterOptions* options)
+    : options_(options) {
+    Reset();
+  }
+
+  void Reset() OVERRIDE {
+    values_.clear();
+    buffer_.clear();
+    finished_size_ = kHeaderSize + kPaddingSize;
+    mini_min_ = 0;
+    mini_max_ = 0;
+  }
+
+  bool IsBlockFull(size_t limit) const OVERRIDE {
+    return EstimateEncodedSize() > limit;
+  }
+
+  int Add(const uint8_t* vals_void, size_t count) OVERRIDE {
+    const CppType* vals = reinterpret_cast<const CppType*>(vals_void);
+    int added = 0;
+    // If the current block is full, stop adding more items.
+    while (!IsBlockFull(options_->storage_attributes.cfile_block_size) && added < count) {
+      AddValue(vals[added]);
+      added++;
+    }
+    return added;
+  }
+
+  size_t Count() const OVERRIDE {
+    return values_.size();
+  }
+
+  Status GetFirstKey(void* key) const OVERRIDE {
+    if (values_.empty()) {
+      return Status::NotFound("no keys in data block");
+    }
+    memcpy(key, &values_.front(), sizeof(CppType));
+    return Status::OK();
+  }
+
+  Status GetLastKey(void* key) const OVERRIDE {
+    if (values_.empty()) {
+      return Status::NotFound("no keys in data block");
+    }
+    memcpy(key, &values_.back(), sizeof(CppType));
+    return Status::OK();
+  }
+
+  Slice Finish(rowid_t ordinal_pos) OVERRIDE {
+    const size_t num_mini = KUDU_ALIGN_UP(values_.size(), kDeltaForMiniBlockSize) /
+                            kDeltaForMiniBlockSize;
+    buffer_.clear();
+    buffer_.resize(kHeaderSize + num_mini * kDescriptorSize);
+    InlineEncodeFixed32(&buffer_[0], ordinal_pos);
+    InlineEncodeFixed32(&buffer_[4], values_.size());
+
+    uint64_t packed[kDeltaForMiniBlockSize];
+    for (size_t m = 0; m < num_mini; m++) {
+      const size_t start = m * kDeltaForMiniBlockSize;
+      const size_t end = std::min(start + kDeltaForMiniBlockSize, values_.size());
+      const UnsignedType base = m == 0 ? values_[0] : values_[start - 1];
+
+      SignedType min_delta = 0;
+      SignedType max_delta = 0;
+      for (size_t i = start; i < end; i++) {
+        SignedType delta = Delta(i);
+        if (i == start || delta < min_delta) min_delta = delta;
+        if (i == start || delta > max_delta) max_delta = delta;
+      }
+      const int width = BitWidth(min_delta, max_delta);
+      for (size_t i = start; i < end; i++) {
+        packed[i - start] = static_cast<UnsignedType>(
+            static_cast<UnsignedType>(Delta(i)) - static_cast<UnsignedType>(min_delta));
+      }
+      std::fill(packed + (end - start), packed + kDeltaForMiniBlockSize, 0);
+
+      uint8_t* desc = &buffer_[kHeaderSize + m * kDescriptorSize];
+      InlineEncodeFixed64(desc, base);
+      InlineEncodeFixed64(desc + 8, static_cast<UnsignedType>(min_delta));
+      desc[16] = width;
+      DeltaForPackMiniBlock(packed, width, &buffer_);
+    }
+    buffer_.resize(buffer_.size() + kPaddingSize);
+    memset(&buffer_[buffer_.size() - kPaddingSize], 0, kPaddingSize);
+    return Slice(buffer_);
+  }
+
+ private:
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+  typedef typename std::make_unsigned<CppType>::type UnsignedType;
+  typedef typename std::make_signed<CppType>::type SignedType;
+
+  static const size_t kHeaderSize = sizeof(uint32_t) * 2;
+  static const size_t kDescriptorSize = sizeof(uint64_t) * 2 + 1;
+  static const size_t kPaddingSize = sizeof(uint64_t);
+
+  // Return the difference between the value at 'idx' and its predecessor.
+  SignedType Delta(size_t idx) const {
+    if (idx == 0) {
+      return 0;
+    }
+    return static_cast<SignedType>(static_cast<UnsignedType>(values_[idx]) -
+                                   static_cast<UnsignedType>(values_[idx - 1]));
+  }
+
+  // Return the number of bits needed to store the differences in
+  // [min_delta, max_delta] relative to 'min_delta'.
+  static int BitWidth(SignedType min_delta, SignedType max_delta) {
+    UnsignedType range = static_cast<UnsignedType>(max_delta) -
+                         static_cast<UnsignedType>(min_delta);
+    return Bits::Log2Floor64(range) + 1;
+  }
+
+  static size_t MiniBlockSize(int width) {
+    return kDescriptorSize + kDeltaForMiniBlockSize * width / 8;
+  }
+
+  void AddValue(CppType val) {
+    values_.push_back(val);
+    const size_t idx = values_.size() - 1;
+    SignedType delta = Delta(idx);
+    if (idx % kDeltaForMiniBlockSize == 0) {
+      mini_min_ = mini_max_ = delta;
+    } else {
+      mini_min_ = std::min(mini_min_, delta);
+      mini_max_ = std::max(mini_max_, delta);
+    }
+    if (values_.size() % kDeltaForMiniBlockSize == 0) {
+      finished_size_ += MiniBlockSize(BitWidth(mini_min_, mini_max_));
+    }
+  }
+
+  // The exact size of the finished miniblocks, plus a pessimistic estimate
+  // for the one being filled.
+  size_t EstimateEncodedSize() const {
+    size_t partial = values_.size() % kDeltaForMiniBlockSize;
+    return finished_size_ + (partial == 0 ? 0 : kDescriptorSize + partial * sizeof(CppType));
+  }
+
+  std::vector<CppType> values_;
+  faststring buffer_;
+  size_t finished_size_;
+
+  // The range of differences in the miniblock being filled.
+  SignedType mini_min_;
+  SignedType mini_max_;
+
+  const WriterOptions* options_;
+};
+
+template<DataType Type>
+class DeltaForBlockDecoder : public BlockDecoder {
+ public:
+  explicit DeltaForBlockDecoder(Slice slice)
+      : data_(std::move(slice)),
+        parsed_(false),
+        ordinal_pos_base_(0),
+        num_elems_(0),
+        cur_idx_(0),
+        decoded_mini_(-1) {
+  }
+
+  Status ParseHeader() OVERRIDE {
+    CHECK(!parsed_);
+    if (data_.size() < kHeaderSize + kPaddingSize) {
+      return Status::Corruption(
+        strings::Substitute("not enough bytes for header: delta block header "
+          "size ($0) less than expected header length ($1)",
+          data_.size(), kHeaderSize + kPaddingSize));
+    }
+
+    ordinal_pos_base_ = DecodeFixed32(&data_[0]);
+    num_elems_        = DecodeFixed32(&data_[4]);
+    const size_t num_mini = KUDU_ALIGN_UP(num_elems_, kDeltaForMiniBlockSize) /
+                            kDeltaForMiniBlockSize;
+    size_t offset = kHeaderSize + num_mini * kDescriptorSize;
+    if (offset + kPaddingSize > data_.size()) {
+      return Status::Corruption("not enough bytes for miniblock descriptors");
+    }
+
+    // Compute where the packed data of each miniblock starts, so that seeking
+    // only needs to unpack the miniblock sought to.
+    offsets_.resize(num_mini);
+    for (size_t m = 0; m < num_mini; m++) {
+      int width = Descriptor(m)[16];
+      if (PREDICT_FALSE(width > size_of_type * 8)) {
+        return Status::Corruption(strings::Substitute("invalid bit width: $0", width));
+      }
+      offsets_[m] = offset;
+      offset += kDeltaForMiniBlockSize * width / 8;
+    }
+    if (offset + kPaddingSize != data_.size()) {
+      return Status::Corruption("Size Information unmatched");
+    }
+
+    parsed_ = true;
+    return Status::OK();
+  }
+
+  void SeekToPositionInBlock(uint pos) OVERRIDE {
+    CHECK(parsed_) << "Must call ParseHeader()";
+    if (PREDICT_FALSE(num_elems_ == 0)) {
+      DCHECK_EQ(0, pos);
+      return;
+    }
+
+    DCHECK_LE(pos, num_elems_);
+    cur_idx_ = pos;
+  }
+
+  Status SeekAtOrAfterValue(const void* value_void, bool* exact) OVERRIDE {
+    CppType target = *reinterpret_cast<const CppType*>(value_void);
+    uint32_t left = 0;
+    uint32_t right = num_elems_;
+    while (left != right) {
+      uint32_t mid = left + (right - left) / 2;
+      CppType mid_key = ValueAt(mid);
+      if (mid_key == target) {
+        cur_idx_ = mid;
+        *exact = true;
+        return Status::OK();
+      } else if (mid_key > target) {
+        right = mid;
+      } else {
+        left = mid + 1;
+      }
+    }
+
+    *exact = false;
+    cur_idx_ = left;
+    if (cur_idx_ == num_elems_) {
+      return Status::NotFound("after last key in block");
+    }
+    return Status::OK();
+  }
+
+  Status CopyNextValues(size_t* n, ColumnDataView* dst) OVERRIDE {
+    DCHECK_EQ(dst->stride(), sizeof(CppType));
+    return CopyNextValuesToArray(n, dst->data());
+  }
+
+  Status CopyNextAndEval(size_t* n,
+                         ColumnMaterializationContext* ctx,
+                         SelectionVectorView* sel,
+                         ColumnDataView* dst) OVERRIDE {
+    ctx->SetDecoderEvalSupported();
+    RETURN_NOT_OK(CopyNextValues(n, dst));
+    EvaluateCopiedValues<Type>(*ctx->pred(), *n, sel, *dst);
+    return Status::OK();
+  }
+
+  Status CopyNextValuesToArray(size_t* n, uint8_t* array) {
+    DCHECK(parsed_);
+    if (PREDICT_FALSE(*n == 0 || cur_idx_ >= num_elems_)) {
+      *n = 0;
+      return Status::OK();
+    }
+
+    size_t max_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
+    size_t fetched = 0;
+    while (fetched < max_fetch) {
+      DecodeMiniBlock(cur_idx_ / kDeltaForMiniBlockSize);
+      size_t idx_in_mini = cur_idx_ % kDeltaForMiniBlockSize;
+      size_t count = std::min(max_fetch - fetched, kDeltaForMiniBlockSize - idx_in_mini);
+      memcpy(array + fetched * size_of_type, &decoded_[idx_in_mini], count * size_of_type);
+      fetched += count;
+      cur_idx_ += count;
+    }
+
+    *n = max_fetch;
+    return Status::OK();
+  }
+
+  size_t GetCurrentIndex() const OVERRIDE {
+    DCHECK(parsed_) << "must parse header first";
+    return cur_idx_;
+  }
+
+  virtual rowid_t GetFirstRowId() const OVERRIDE {
+    return ordinal_pos_base_;
+  }
+
+  size_t Count() const OVERRIDE {
+    return num_elems_;
+  }
+
+  bool HasNext() const OVERRIDE {
+    return (num_elems_ - cur_idx_) > 0;
+  }
+
+ private:
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+  typedef typename std::make_unsigned<CppType>::type UnsignedType;
+
+  static const size_t kHeaderSize = sizeof(uint32_t) * 2;
+  static const size_t kDescriptorSize = sizeof(uint64_t) * 2 + 1;
+  static const size_t kPaddingSize = sizeof(uint64_t);
+  enum {
+    size_of_type = TypeTraits<Type>::size
+  };
+
+  const uint8_t* Descriptor(size_t mini) const {
+    return &data_[kHeaderSize + mini * kDescriptorSize];
+  }
+
+  CppType ValueAt(size_t idx) {
+    DecodeMiniBlock(idx / kDeltaForMiniBlockSize);
+    return decoded_[idx % kDeltaForMiniBlockSize];
+  }
+
+  // Unpack the miniblock 'mini' into 'decoded_', unless it already is.
+  void DecodeMiniBlock(size_t mini) {
+    if (decoded_mini_ == mini) {
+      return;
+    }
+    const uint8_t* desc = Descriptor(mini);
+    UnsignedType value = DecodeFixed64(desc);
+    const UnsignedType min_delta = DecodeFixed64(desc + 8);
+    uint64_t packed[kDeltaForMiniBlockSize];
+    DeltaForUnpackMiniBlock(&data_[offsets_[mini]], desc[16], packed);
+    for (size_t i = 0; i < kDeltaForMiniBlockSize; i++) {
+      packed[i] += min_delta;
+    }
+    for (size_t i = 0; i < kDeltaForMiniBlockSize; i++) {
+      value += static_cast<UnsignedType>(packed[i]);
+      decoded_[i] = static_cast<CppType>(value);
+    }
+    decoded_mini_ = mini;
+  }
+
+  Slice data_;
+  bool parsed_;
+
+  rowid_t ordinal_pos_base_;
+  uint32_t num_elems_;
+  size_t cur_idx_;
+
+  // Offset within 'data_' of the packed differences of each miniblock.
+  std::vector<uint32_t> offsets_;
+
+  // The values of the most recently unpacked miniblock.
+  CppType decoded_[kDeltaForMiniBlockSize];
+  size_t decoded_mini_;
+};
+
+} // namespace cfile
+} // namespace kudu
+#endif
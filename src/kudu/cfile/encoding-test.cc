@@ -24,6 +24,7 @@
 
 #include "kudu/cfile/block_encodings.h"
 #include "kudu/cfile/bshuf_block.h"
+#include "kudu/cfile/delta_for_block.h"
 #include "kudu/cfile/cfile_writer.h"
 #include "kudu/cfile/gvint_block.h"
 #include "kudu/cfile/plain_bitmap_block.h"
@@ -611,6 +612,75 @@ class TestEncoding : public ::testing::Test {
       CopyOne<BOOL>(&bd, &ret);
       EXPECT_EQ(static_cast<bool>(decoded[seek_off]), ret);
     }
+
+    // Decode the block again while evaluating '= true'. Decoders which
+    // support evaluation must deselect exactly the false values.
+    bool true_value = true;
+    ColumnPredicate pred = ColumnPredicate::Equality(ColumnSchema("c", BOOL), &true_value);
+    SelectionVector sel(to_insert.size());
+    sel.SetAllTrue();
+    ColumnMaterializationContext ctx(0, &pred, &dst_block, &sel);
+    std::fill(decoded.begin(), decoded.end(), 0);
+    bd.SeekToPositionInBlock(0);
+    dec_count = 0;
+    while (bd.HasNext()) {
+      size_t n = std::min(to_insert.size() - dec_count,
+                          static_cast<size_t>((random() % 30) + 1));
+      ColumnDataView dst_data(&dst_block, dec_count);
+      SelectionVectorView sel_view(&sel);
+      sel_view.Advance(dec_count);
+      ASSERT_OK_FAST(bd.CopyNextAndEval(&n, &ctx, &sel_view, &dst_data));
+      dec_count += n;
+    }
+    ASSERT_EQ(dec_count, to_insert.size());
+    for (uint i = 0; i < to_insert.size(); i++) {
+      if (ctx.DecoderEvalNotSupported()) {
+        ASSERT_EQ(to_insert[i], decoded[i]) << "Fail at index " << i;
+      } else {
+        ASSERT_EQ(static_cast<bool>(to_insert[i]), sel.IsRowSelected(i)) << "Fail at index " << i;
+        if (sel.IsRowSelected(i)) {
+          ASSERT_TRUE(decoded[i]) << "Fail at index " << i;
+        }
+      }
+    }
+  }
+
+  // Decode a block of 'num_ints' ints 'num_iters' times, in batches of
+  // 'batch_size' rows, and log the rate at which rows were decoded.
+  template<class BlockBuilderType, class BlockDecoderType, DataType IntType>
+  void DoDecodeBenchmark(BlockBuilderType* ibb, int num_ints, int batch_size, int num_iters) {
+    typedef typename TypeTraits<IntType>::cpp_type CppType;
+
+    vector<CppType> data(num_ints);
+    for (int i = 0; i < num_ints; i++) {
+      data[i] = random();
+    }
+    CHECK_EQ(num_ints, ibb->Add(reinterpret_cast<uint8_t *>(&data[0]), num_ints));
+    Slice s = ibb->Finish(0);
+
+    // Leave room for any padding the decoder may write past the last row.
+    vector<CppType> decoded(num_ints + 8);
+    ColumnBlock dst_block(GetTypeInfo(IntType), nullptr, &decoded[0],
+                          decoded.size(), &arena_);
+    Stopwatch sw;
+    sw.start();
+    for (int iter = 0; iter < num_iters; iter++) {
+      BlockDecoderType ibd(s);
+      ASSERT_OK(ibd.ParseHeader());
+      int dec_count = 0;
+      while (ibd.HasNext()) {
+        ColumnDataView dst_data(&dst_block, dec_count);
+        size_t n = batch_size;
+        ASSERT_OK_FAST(ibd.CopyNextValues(&n, &dst_data));
+        dec_count += n;
+      }
+      ASSERT_EQ(num_ints, dec_count);
+    }
+    sw.stop();
+    LOG(INFO) << strings::Substitute("Decoded $0 $1 rows in batches of $2: $3 rows/sec",
+                                     static_cast<int64_t>(num_ints) * num_iters,
+                                     TypeTraits<IntType>::name(), batch_size,
+                                     num_ints * num_iters / sw.elapsed().wall_seconds());
   }
 
   Arena arena_;
@@ -665,6 +735,101 @@ TEST_F(TestEncoding, TestBShufDoubleBlockEncoder) {
                                     BShufBlockDecoder<DOUBLE> >(doubles.get(), kSize);
 }
 
+// Test that a bitshuffle block decoded in a single call into a buffer with
+// room for its padding, which unshuffles straight into the buffer, is
+// decoded correctly and can still be seeked and re-read afterwards.
+TEST_F(TestEncoding, TestBShufDecodeWholeBlock) {
+  const int kSize = 1003;
+  vector<int32_t> ints(kSize);
+  for (int i = 0; i < kSize; i++) {
+    ints[i] = i * 3;
+  }
+  gscoped_ptr<WriterOptions> opts(NewWriterOptions());
+  BShufBlockBuilder<INT32> bb(opts.get());
+  ASSERT_EQ(kSize, bb.Add(reinterpret_cast<const uint8_t*>(&ints[0]), kSize));
+  Slice s = bb.Finish(0);
+
+  BShufBlockDecoder<INT32> bd(s);
+  ASSERT_OK(bd.ParseHeader());
+  vector<int32_t> decoded(KUDU_ALIGN_UP(kSize, 8));
+  ColumnBlock dst_block(GetTypeInfo(INT32), nullptr, &decoded[0], decoded.size(), &arena_);
+  ColumnDataView dst_data(&dst_block);
+  size_t n = decoded.size();
+  ASSERT_OK(bd.CopyNextValues(&n, &dst_data));
+  ASSERT_EQ(kSize, n);
+  ASSERT_FALSE(bd.HasNext());
+  for (int i = 0; i < kSize; i++) {
+    ASSERT_EQ(ints[i], decoded[i]) << "Fail at index " << i;
+  }
+
+  // Seeking and reading again goes through the decoder's own buffer.
+  int32_t target = 301;
+  bool exact;
+  ASSERT_OK(bd.SeekAtOrAfterValue(&target, &exact));
+  ASSERT_FALSE(exact);
+  int32_t got;
+  CopyOne<INT32>(&bd, &got);
+  ASSERT_EQ(303, got);
+  bd.SeekToPositionInBlock(0);
+  CopyOne<INT32>(&bd, &got);
+  ASSERT_EQ(0, got);
+}
+
+// Test the delta block with timestamp-like INT64 values: increasing by
+// varying amounts, with the occasional step backwards or large jump.
+TEST_F(TestEncoding, TestDeltaForTimestampBlockEncoder) {
+  const uint32_t kSize = 10000;
+
+  gscoped_ptr<int64_t[]> ints(new int64_t[kSize]);
+  int64_t ts = 1480000000000000L;
+  for (int i = 0; i < kSize; i++) {
+    ts += random() % 1000;
+    if (random() % 100 == 0) {
+      ts -= 500;
+    }
+    if (random() % 1000 == 0) {
+      ts += 1L << 40;
+    }
+    ints.get()[i] = ts;
+  }
+
+  TestEncodeDecodeTemplateBlockEncoder<INT64, DeltaForBlockBuilder<INT64>,
+                                    DeltaForBlockDecoder<INT64> >(ints.get(), kSize);
+
+  // The differences fit in a few bits per value, compared to 64 bits for
+  // plain encoding.
+  gscoped_ptr<WriterOptions> opts(NewWriterOptions());
+  DeltaForBlockBuilder<INT64> dbb(opts.get());
+  ASSERT_EQ(kSize, dbb.Add(reinterpret_cast<const uint8_t*>(ints.get()), kSize));
+  Slice s = dbb.Finish(0);
+  LOG(INFO) << "Delta encoded size for 10k timestamps: " << s.size();
+  ASSERT_LT(s.size(), kSize * sizeof(int64_t) / 3);
+}
+
+// Test the delta block with values whose differences span the full range
+// of the type, so that every bit width and the wrap-around of differences
+// are exercised.
+TEST_F(TestEncoding, TestDeltaForExtremeValues) {
+  const uint32_t kSize = 128 * 65;
+
+  gscoped_ptr<uint64_t[]> ints(new uint64_t[kSize]);
+  for (int i = 0; i < kSize; i++) {
+    // Each miniblock uses differences of a different bit width.
+    int width = i / 128;
+    uint64_t mask = width == 64 ? ~0ULL : (1ULL << width) - 1;
+    ints.get()[i] = (static_cast<uint64_t>(random()) << 33 ^ random()) & mask;
+  }
+  ints.get()[1] = std::numeric_limits<uint64_t>::max();
+  ints.get()[2] = 0;
+
+  TestEncodeDecodeTemplateBlockEncoder<UINT64, DeltaForBlockBuilder<UINT64>,
+                                    DeltaForBlockDecoder<UINT64> >(ints.get(), kSize);
+}
+
+TEST_F(TestEncoding, TestDeltaForEmptyBlockEncodeDecode) {
+  TestEmptyBlockEncodeDecode<DeltaForBlockBuilder<INT64>, DeltaForBlockDecoder<INT64>>();
+}
+
 TEST_F(TestEncoding, TestIntBlockEncoder) {
   gscoped_ptr<WriterOptions> opts(NewWriterOptions());
   GVIntBlockBuilder ibb(opts.get());
@@ -779,6 +944,18 @@ TEST_F(TestEncoding, GVIntSeekBenchmark) {
   gscoped_ptr<GVIntBlockBuilder> ibb(new GVIntBlockBuilder(opts.get()));
   DoSeekTest<GVIntBlockBuilder, GVIntBlockDecoder, UINT32>(ibb.get(), 32768, 100000, false);
 }
+
+
+// Compare decoding in scan-sized batches against decoding a whole block
+// in one call.
+TEST_F(TestEncoding, GVIntDecodeBenchmark) {
+  gscoped_ptr<WriterOptions> opts(NewWriterOptions());
+  for (int batch_size : { 1000, 32768 }) {
+    gscoped_ptr<GVIntBlockBuilder> ibb(new GVIntBlockBuilder(opts.get()));
+    DoDecodeBenchmark<GVIntBlockBuilder, GVIntBlockDecoder, UINT32>(
+        ibb.get(), 32768, batch_size, 1000);
+  }
+}
 #endif
 
 TEST_F(TestEncoding, GVIntSeekTest) {
@@ -824,7 +1001,15 @@ struct BitshuffleTestTraits {
     typedef BShufBlockDecoder<type> decoder_type;
   };
 };
-typedef testing::Types<RleTestTraits, BitshuffleTestTraits, PlainTestTraits> MyTestFixtures;
+struct DeltaForTestTraits {
+  template<DataType type>
+  struct Classes {
+    typedef DeltaForBlockBuilder<type> encoder_type;
+    typedef DeltaForBlockDecoder<type> decoder_type;
+  };
+};
+typedef testing::Types<RleTestTraits, BitshuffleTestTraits, PlainTestTraits,
+                       DeltaForTestTraits> MyTestFixtures;
 TYPED_TEST_CASE(IntEncodingTest, MyTestFixtures);
 
 template<class TestTraits>
@@ -847,6 +1032,17 @@ class IntEncodingTest : public TestEncoding {
     }
   }
 
+  template <DataType IntType>
+  void DoIntDecodeBenchmark(int batch_size) {
+    typedef typename TestTraits::template Classes<IntType>::encoder_type encoder_type;
+    typedef typename TestTraits::template Classes<IntType>::decoder_type decoder_type;
+
+    gscoped_ptr<WriterOptions> opts(NewWriterOptions());
+    gscoped_ptr<encoder_type> ibb(new encoder_type(opts.get()));
+    this->template DoDecodeBenchmark<encoder_type, decoder_type, IntType>(
+        ibb.get(), 32768, batch_size, 1000);
+  }
+
   template <DataType IntType>
   void DoIntRoundTripTest() {
     typedef typename TestTraits::template Classes<IntType>::encoder_type encoder_type;
@@ -890,6 +1086,11 @@ TYPED_TEST(IntEncodingTest, TestRoundTrip) {
 TYPED_TEST(IntEncodingTest, IntSeekBenchmark) {
   this->template DoIntSeekTest<INT32>(32768, 10000, false);
 }
+
+TYPED_TEST(IntEncodingTest, IntDecodeBenchmark) {
+  this->template DoIntDecodeBenchmark<INT32>(1000);
+  this->template DoIntDecodeBenchmark<INT32>(32768);
+}
 #endif
 
 } // namespace cfile
@@ -30,7 +30,7 @@ using kudu::coding::AppendGroupVarInt32;
 using kudu::coding::CalcRequiredBytes32;
 using kudu::coding::DecodeGroupVarInt32;
 using kudu::coding::DecodeGroupVarInt32_SlowButSafe;
-using kudu::coding::DecodeGroupVarInt32_SSE_Add;
+using kudu::coding::DecodeGroupVarInt32_SSE_AddVector;
 using kudu::coding::AppendGroupVarInt32Sequence;
 
 GVIntBlockBuilder::GVIntBlockBuilder(const WriterOptions *options)
@@ -155,6 +155,8 @@ class NullSink {
  public:
   template <typename T>
   void push_back(T t) {}
+
+  void push_back_vector(__m128i v) {}
 };
 
 template<typename T>
@@ -168,6 +170,13 @@ class PtrSink {
     *ptr_++ = t;
   }
 
+  // Append four uint32s with a single unaligned store.
+  void push_back_vector(__m128i v) {
+    static_assert(sizeof(T) == sizeof(uint32_t), "vector holds four uint32s");
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(ptr_), v);
+    ptr_ += 4;
+  }
+
  private:
   T *ptr_;
 };
@@ -317,19 +326,24 @@ inline Status GVIntBlockDecoder::DoGetNextValues(size_t *n_param, IntSink *sink)
   if (n == 0) goto ret;
 
   // Now grab groups of 4 and append to vector
+  // Away from the end of the block, each group is decoded with a single
+  // shuffle and stored straight to the sink.
+  while (n >= 4 && cur_pos_ < sse_safe_pos) {
+    __m128i results;
+    cur_pos_ = DecodeGroupVarInt32_SSE_AddVector(cur_pos_, min_elem_xmm, &results);
+    sink->push_back_vector(results);
+    cur_idx_ += 4;
+    n -= 4;
+  }
+
   while (n >= 4) {
     uint32_t ints[4];
-    if (cur_pos_ < sse_safe_pos) {
-      cur_pos_ = DecodeGroupVarInt32_SSE_Add(
-        cur_pos_, ints, min_elem_xmm);
-    } else {
-      cur_pos_ = DecodeGroupVarInt32_SlowButSafe(
-        cur_pos_, &ints[0], &ints[1], &ints[2], &ints[3]);
-      ints[0] += min_elem_;
-      ints[1] += min_elem_;
-      ints[2] += min_elem_;
-      ints[3] += min_elem_;
-    }
+    cur_pos_ = DecodeGroupVarInt32_SlowButSafe(
+      cur_pos_, &ints[0], &ints[1], &ints[2], &ints[3]);
+    ints[0] += min_elem_;
+    ints[1] += min_elem_;
+    ints[2] += min_elem_;
+    ints[3] += min_elem_;
     cur_idx_ += 4;
 
     sink->push_back(ints[0]);
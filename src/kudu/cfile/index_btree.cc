@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
 #include <vector>
 
 #include "kudu/cfile/block_cache.h"
@@ -24,6 +25,8 @@
 #include "kudu/common/key_encoder.h"
 #include "kudu/util/debug-util.h"
 
+using std::unique_ptr;
+
 namespace kudu {
 namespace cfile {
 
@@ -267,7 +270,8 @@ Status IndexTreeIterator::LoadBlock(const BlockPointer &block, int depth) {
     seeked = seeked_indexes_.back().get();
   }
 
-  RETURN_NOT_OK(reader_->ReadBlock(block, CFileReader::CACHE_BLOCK, &seeked->data));
+  RETURN_NOT_OK(reader_->ReadBlock(block, CFileReader::CACHE_BLOCK, &seeked->data,
+                                   Cache::HIGH_PRIORITY));
   seeked->block_ptr = block;
 
   // Parse the new block.
@@ -321,6 +325,82 @@ IndexTreeIterator *IndexTreeIterator::IndexTreeIterator::Create(
   return new IndexTreeIterator(reader, root_blockptr);
 }
 
+////////////////////////////////////////////////////////////
+// ValueIndexDirectory
+////////////////////////////////////////////////////////////
+
+Status ValueIndexDirectory::Build(const CFileReader* reader, const BlockPointer& root,
+                                  size_t max_blocks, unique_ptr<ValueIndexDirectory>* dir) {
+  dir->reset();
+  unique_ptr<ValueIndexDirectory> result(new ValueIndexDirectory());
+  IndexTreeIterator iter(reader, root);
+  RETURN_NOT_OK(iter.SeekToFirst());
+  result->key_offsets_.push_back(0);
+  while (true) {
+    if (result->blocks_.size() == max_blocks) {
+      return Status::OK();
+    }
+    Slice key = iter.GetCurrentKey();
+    result->blocks_.push_back(iter.GetCurrentBlockPointer());
+    result->keys_.append(key.data(), key.size());
+    result->key_offsets_.push_back(result->keys_.size());
+    result->prefixes_.push_back(Prefix(key));
+    if (!iter.HasNext()) {
+      break;
+    }
+    RETURN_NOT_OK(iter.Next());
+  }
+  *dir = std::move(result);
+  return Status::OK();
+}
+
+uint64_t ValueIndexDirectory::Prefix(const Slice& key) {
+  uint64_t prefix = 0;
+  for (int i = 0; i < sizeof(prefix); i++) {
+    prefix = (prefix << 8) | (i < key.size() ? key[i] : 0);
+  }
+  return prefix;
+}
+
+size_t ValueIndexDirectory::FindBlock(const Slice& key) const {
+  DCHECK(!blocks_.empty());
+  size_t lo = 0;
+  size_t hi = blocks_.size() - 1;
+  if (this->key(lo).compare(key) >= 0) {
+    return 0;
+  }
+  if (this->key(hi).compare(key) <= 0) {
+    return hi;
+  }
+
+  // Invariant: key(lo) < key < key(hi). Interpolation steps alternate with
+  // bisections, so that badly distributed keys take at most about twice as
+  // many steps as a binary search.
+  const uint64_t key_prefix = Prefix(key);
+  bool interpolate = true;
+  while (hi - lo > 1) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (interpolate && prefixes_[hi] > prefixes_[lo]) {
+      double fraction = static_cast<double>(key_prefix - prefixes_[lo]) /
+          static_cast<double>(prefixes_[hi] - prefixes_[lo]);
+      mid = lo + static_cast<size_t>(fraction * (hi - lo));
+      mid = std::min(std::max(mid, lo + 1), hi - 1);
+    }
+    interpolate = !interpolate;
+    if (this->key(mid).compare(key) <= 0) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+size_t ValueIndexDirectory::memory_footprint() const {
+  return sizeof(*this) + blocks_.capacity() * sizeof(BlockPointer) + keys_.capacity() +
+      key_offsets_.capacity() * sizeof(uint32_t) + prefixes_.capacity() * sizeof(uint64_t);
+}
+
 
 } // namespace cfile
 } // namespace kudu
@@ -25,6 +25,7 @@
 #include "kudu/cfile/cfile.pb.h"
 #include "kudu/cfile/index_block.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/util/faststring.h"
 
 namespace kudu {
 namespace cfile {
@@ -119,6 +120,58 @@ class IndexTreeIterator {
   DISALLOW_COPY_AND_ASSIGN(IndexTreeIterator);
 };
 
+// An in-memory copy of the leaf entries of a value index: the first key of
+// each data block, and the block's pointer.
+//
+// Finding the block which may hold a key then takes a single search of
+// contiguous memory, rather than a descent through the index blocks with a
+// block cache lookup and a binary search at each level. The search
+// interpolates on the keys' first eight bytes: value index keys are encoded
+// to compare as bytes, so these bytes read as a big-endian integer are
+// ordered like the keys, and keys led by an integer column spread over
+// them like the column's values, which a few interpolation steps find.
+class ValueIndexDirectory {
+ public:
+  // Copy the leaf entries of the value index whose root is 'root'. Sets
+  // '*dir' to null, rather than building a directory, if the index has
+  // more than 'max_blocks' entries.
+  static Status Build(const CFileReader* reader, const BlockPointer& root,
+                      size_t max_blocks, std::unique_ptr<ValueIndexDirectory>* dir);
+
+  // Return the index of the last block whose first key is at or before
+  // 'key', or 0 if there is none: the only block which may contain 'key'.
+  size_t FindBlock(const Slice& key) const;
+
+  size_t num_blocks() const { return blocks_.size(); }
+
+  const BlockPointer& block(size_t idx) const { return blocks_[idx]; }
+
+  Slice key(size_t idx) const {
+    return Slice(keys_.data() + key_offsets_[idx], key_offsets_[idx + 1] - key_offsets_[idx]);
+  }
+
+  size_t memory_footprint() const;
+
+ private:
+  ValueIndexDirectory() {}
+
+  // Return the first eight bytes of 'key' as a big-endian integer, padded
+  // with zeros.
+  static uint64_t Prefix(const Slice& key);
+
+  std::vector<BlockPointer> blocks_;
+
+  // The keys of the blocks, concatenated, and the offset of each into
+  // 'keys_', with a final entry for the end of the last.
+  faststring keys_;
+  std::vector<uint32_t> key_offsets_;
+
+  // Prefix() of each key.
+  std::vector<uint64_t> prefixes_;
+
+  DISALLOW_COPY_AND_ASSIGN(ValueIndexDirectory);
+};
+
 } // namespace cfile
 } // namespace kudu
 #endif
@@ -149,7 +149,7 @@ class PlainBitMapBlockDecoder : public BlockDecoder {
       return;
     }
 
-    DCHECK_LT(pos, num_elems_);
+    DCHECK_LE(pos, num_elems_);
 
     reader_.SeekToBit(pos);
 
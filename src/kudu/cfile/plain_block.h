@@ -208,6 +208,16 @@ class PlainBlockDecoder : public BlockDecoder {
     return Status::OK();
   }
 
+  virtual Status CopyNextAndEval(size_t* n,
+                                 ColumnMaterializationContext* ctx,
+                                 SelectionVectorView* sel,
+                                 ColumnDataView* dst) OVERRIDE {
+    ctx->SetDecoderEvalSupported();
+    RETURN_NOT_OK(CopyNextValues(n, dst));
+    EvaluateCopiedValues<Type>(*ctx->pred(), *n, sel, *dst);
+    return Status::OK();
+  }
+
   virtual bool HasNext() const OVERRIDE {
     return cur_idx_ < num_elems_;
   }
@@ -182,6 +182,46 @@ class RleBitMapBlockDecoder : public BlockDecoder {
     return Status::OK();
   }
 
+  // The predicate is evaluated once per run of identical values, and the
+  // values of runs which don't satisfy it are not copied out.
+  virtual Status CopyNextAndEval(size_t* n,
+                                 ColumnMaterializationContext* ctx,
+                                 SelectionVectorView* sel,
+                                 ColumnDataView* dst) OVERRIDE {
+    DCHECK(parsed_);
+    DCHECK_LE(*n, dst->nrows());
+    DCHECK_EQ(dst->stride(), sizeof(bool));
+    ctx->SetDecoderEvalSupported();
+
+    if (PREDICT_FALSE(*n == 0 || cur_idx_ >= num_elems_)) {
+      *n = 0;
+      return Status::OK();
+    }
+
+    size_t bits_to_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
+    size_t remaining = bits_to_fetch;
+    SelectionVectorView run_sel(*sel);
+    bool* data_ptr = reinterpret_cast<bool*>(dst->data());
+    while (remaining > 0) {
+      bool val = false;
+      size_t run = rle_decoder_.GetNextRun(&val, remaining);
+      DCHECK_GT(run, 0);
+      if (ctx->pred()->EvaluateCell<BOOL>(&val)) {
+        std::fill(data_ptr, data_ptr + run, val);
+      } else {
+        run_sel.ClearBits(run);
+      }
+      run_sel.Advance(run);
+      data_ptr += run;
+      remaining -= run;
+    }
+
+    cur_idx_ += bits_to_fetch;
+    *n = bits_to_fetch;
+
+    return Status::OK();
+  }
+
   virtual Status SeekAtOrAfterValue(const void *value,
                                     bool *exact_match) OVERRIDE {
     return Status::NotSupported("BOOL keys are not supported!");
@@ -325,8 +365,8 @@ class RleIntBlockDecoder : public BlockDecoder {
 
   virtual void SeekToPositionInBlock(uint pos) OVERRIDE {
     CHECK(parsed_) << "Must call ParseHeader()";
-    CHECK_LT(pos, num_elems_)
-        << "Tried to seek to " << pos << " which is >= number of elements ("
+    CHECK_LE(pos, num_elems_)
+        << "Tried to seek to " << pos << " which is > number of elements ("
         << num_elems_ << ") in the block!.";
 
     if (cur_idx_ == pos) {
@@ -404,6 +444,45 @@ class RleIntBlockDecoder : public BlockDecoder {
     return Status::OK();
   }
 
+  // The predicate is evaluated once per run of identical values, and the
+  // values of runs which don't satisfy it are not copied out.
+  virtual Status CopyNextAndEval(size_t* n,
+                                 ColumnMaterializationContext* ctx,
+                                 SelectionVectorView* sel,
+                                 ColumnDataView* dst) OVERRIDE {
+    DCHECK(parsed_);
+    DCHECK_LE(*n, dst->nrows());
+    DCHECK_EQ(dst->stride(), sizeof(CppType));
+    ctx->SetDecoderEvalSupported();
+
+    if (PREDICT_FALSE(*n == 0 || cur_idx_ >= num_elems_)) {
+      *n = 0;
+      return Status::OK();
+    }
+
+    size_t to_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
+    size_t remaining = to_fetch;
+    SelectionVectorView run_sel(*sel);
+    CppType* data_ptr = reinterpret_cast<CppType*>(dst->data());
+    while (remaining > 0) {
+      CppType val = 0;
+      size_t run = rle_decoder_.GetNextRun(&val, remaining);
+      DCHECK_GT(run, 0);
+      if (ctx->pred()->EvaluateCell<IntType>(&val)) {
+        std::fill(data_ptr, data_ptr + run, val);
+      } else {
+        run_sel.ClearBits(run);
+      }
+      run_sel.Advance(run);
+      data_ptr += run;
+      remaining -= run;
+    }
+
+    cur_idx_ += to_fetch;
+    *n = to_fetch;
+    return Status::OK();
+  }
+
   virtual bool HasNext() const OVERRIDE {
     return cur_idx_ < num_elems_;
   }
@@ -23,6 +23,7 @@
 #include <glog/logging.h>
 
 #include "kudu/cfile/bshuf_block.h"
+#include "kudu/cfile/delta_for_block.h"
 #include "kudu/cfile/gvint_block.h"
 #include "kudu/cfile/plain_bitmap_block.h"
 #include "kudu/cfile/plain_block.h"
@@ -185,6 +186,22 @@ struct DataTypeEncodingTraits<UINT32, GROUP_VARINT> {
   }
 };
 
+// Delta / frame-of-reference encoding for integer types.
+template<DataType IntType>
+struct DataTypeEncodingTraits<IntType, DELTA_FOR> {
+
+  static Status CreateBlockBuilder(BlockBuilder** bb, const WriterOptions *options) {
+    *bb = new DeltaForBlockBuilder<IntType>(options);
+    return Status::OK();
+  }
+
+  static Status CreateBlockDecoder(BlockDecoder** bd, const Slice& slice,
+                                   CFileIterator *iter) {
+    *bd = new DeltaForBlockDecoder<IntType>(slice);
+    return Status::OK();
+  }
+};
+
 template<DataType IntType>
 struct DataTypeEncodingTraits<IntType, RLE> {
 
@@ -275,13 +292,17 @@ class TypeEncodingResolver {
     AddMapping<UINT32, RLE>();
     AddMapping<UINT32, PLAIN_ENCODING>();
     AddMapping<UINT32, BIT_SHUFFLE>();
+    AddMapping<UINT32, DELTA_FOR>();
     AddMapping<INT32, PLAIN_ENCODING>();
     AddMapping<INT32, RLE>();
     AddMapping<INT32, BIT_SHUFFLE>();
+    AddMapping<INT32, DELTA_FOR>();
     AddMapping<UINT64, PLAIN_ENCODING>();
     AddMapping<UINT64, BIT_SHUFFLE>();
+    AddMapping<UINT64, DELTA_FOR>();
     AddMapping<INT64, PLAIN_ENCODING>();
     AddMapping<INT64, BIT_SHUFFLE>();
+    AddMapping<INT64, DELTA_FOR>();
     AddMapping<FLOAT, PLAIN_ENCODING>();
     AddMapping<FLOAT, BIT_SHUFFLE>();
     AddMapping<DOUBLE, PLAIN_ENCODING>();
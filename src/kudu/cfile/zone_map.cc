@@ -0,0 +1,309 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/cfile/zone_map.h"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "kudu/common/column_predicate.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/hash/city.h"
+#include "kudu/util/bloom_filter.h"
+#include "kudu/util/slice.h"
+
+namespace kudu {
+namespace cfile {
+
+namespace {
+
+// Aligned scratch space for a cell decoded from its zone map encoding.
+struct CellBuffer {
+  uint64_t fixed[2];
+  Slice slice;
+};
+
+const void* DecodeCell(const TypeInfo* type_info, const Slice& encoded, CellBuffer* buf) {
+  if (type_info->physical_type() == BINARY) {
+    buf->slice = encoded;
+    return &buf->slice;
+  }
+  DCHECK_EQ(type_info->size(), encoded.size());
+  DCHECK_LE(encoded.size(), sizeof(buf->fixed));
+  memcpy(buf->fixed, encoded.data(), encoded.size());
+  return buf->fixed;
+}
+
+void EncodeCell(const TypeInfo* type_info, const void* cell, faststring* dst) {
+  if (type_info->physical_type() == BINARY) {
+    const Slice* s = reinterpret_cast<const Slice*>(cell);
+    dst->assign_copy(s->data(), s->size());
+  } else {
+    dst->assign_copy(reinterpret_cast<const uint8_t*>(cell), type_info->size());
+  }
+}
+
+// Hash the cell the way it is encoded, so that equal values hash equally.
+uint64_t HashCell(const TypeInfo* type_info, const void* cell) {
+  if (type_info->physical_type() == BINARY) {
+    const Slice* s = reinterpret_cast<const Slice*>(cell);
+    return util_hash::CityHash64(reinterpret_cast<const char*>(s->data()), s->size());
+  }
+  return util_hash::CityHash64(reinterpret_cast<const char*>(cell), type_info->size());
+}
+
+// Return the probe of the value bloom filter for a value with hash 'hash'.
+// The filter is keyed by the values' hashes, which are all it keeps.
+BloomKeyProbe ValueBloomProbe(const uint64_t* hash) {
+  return BloomKeyProbe(Slice(reinterpret_cast<const uint8_t*>(hash), sizeof(*hash)));
+}
+
+bool IsNaN(const TypeInfo* type_info, const void* cell) {
+  switch (type_info->physical_type()) {
+    case FLOAT:
+      return std::isnan(*reinterpret_cast<const float*>(cell));
+    case DOUBLE:
+      return std::isnan(*reinterpret_cast<const double*>(cell));
+    default:
+      return false;
+  }
+}
+
+} // anonymous namespace
+
+ZoneMapBuilder::Stats::Stats() {
+  Reset();
+}
+
+void ZoneMapBuilder::Stats::Reset() {
+  num_rows = 0;
+  null_count = 0;
+  has_values = false;
+  has_range = true;
+  min.clear();
+  max.clear();
+}
+
+ZoneMapBuilder::ZoneMapBuilder(const TypeInfo* type_info)
+  : type_info_(type_info),
+    ndv_sketch_(kNdvSketchPrecision) {
+}
+
+void ZoneMapBuilder::AddValues(const void* cells, size_t count) {
+  const uint8_t* cell = reinterpret_cast<const uint8_t*>(cells);
+  for (size_t i = 0; i < count; i++) {
+    UpdateRange(cell, &block_stats_);
+    ndv_sketch_.AddHash(HashCell(type_info_, cell));
+    cell += type_info_->size();
+  }
+  block_stats_.num_rows += count;
+}
+
+void ZoneMapBuilder::AddNulls(size_t count) {
+  block_stats_.num_rows += count;
+  block_stats_.null_count += count;
+}
+
+void ZoneMapBuilder::FinishBlock(rowid_t first_row_id) {
+  DCHECK_EQ(file_stats_.num_rows, first_row_id);
+  ZoneMapEntryPB* entry = zone_map_.add_blocks();
+  entry->set_first_row_id(first_row_id);
+  ToPB(block_stats_, entry);
+  Merge(block_stats_, &file_stats_);
+  block_stats_.Reset();
+}
+
+void ZoneMapBuilder::GetFileEntry(ZoneMapEntryPB* entry) const {
+  entry->set_first_row_id(0);
+  ToPB(file_stats_, entry);
+}
+
+void ZoneMapBuilder::UpdateRange(const void* cell, Stats* stats) const {
+  if (!stats->has_range) {
+    return;
+  }
+  if (PREDICT_FALSE(IsNaN(type_info_, cell))) {
+    stats->has_values = true;
+    stats->has_range = false;
+    return;
+  }
+  if (!stats->has_values) {
+    EncodeCell(type_info_, cell, &stats->min);
+    EncodeCell(type_info_, cell, &stats->max);
+    stats->has_values = true;
+    return;
+  }
+  CellBuffer buf;
+  if (type_info_->Compare(cell, DecodeCell(type_info_, Slice(stats->min), &buf)) < 0) {
+    EncodeCell(type_info_, cell, &stats->min);
+  } else if (type_info_->Compare(cell, DecodeCell(type_info_, Slice(stats->max), &buf)) > 0) {
+    EncodeCell(type_info_, cell, &stats->max);
+  }
+}
+
+void ZoneMapBuilder::Merge(const Stats& src, Stats* dst) const {
+  dst->num_rows += src.num_rows;
+  dst->null_count += src.null_count;
+  if (!src.has_values || !dst->has_range) {
+    dst->has_values |= src.has_values;
+    return;
+  }
+  if (!src.has_range) {
+    dst->has_values = true;
+    dst->has_range = false;
+    return;
+  }
+  CellBuffer buf;
+  UpdateRange(DecodeCell(type_info_, Slice(src.min), &buf), dst);
+  UpdateRange(DecodeCell(type_info_, Slice(src.max), &buf), dst);
+}
+
+void ZoneMapBuilder::ToPB(const Stats& stats, ZoneMapEntryPB* entry) const {
+  entry->set_num_rows(stats.num_rows);
+  entry->set_null_count(stats.null_count);
+  if (stats.has_values && stats.has_range) {
+    entry->set_min_value(stats.min.data(), stats.min.size());
+    entry->set_max_value(stats.max.data(), stats.max.size());
+  }
+}
+
+bool ZoneMayMatch(const TypeInfo* type_info,
+                  const ZoneMapEntryPB& entry,
+                  const ColumnPredicate& pred) {
+  switch (pred.predicate_type()) {
+    case PredicateType::None:
+      return false;
+    case PredicateType::IsNull:
+      return entry.null_count() > 0;
+    case PredicateType::IsNotNull:
+      return entry.num_rows() > entry.null_count();
+    default:
+      break;
+  }
+
+  // The remaining predicate types never match a NULL cell.
+  if (entry.num_rows() <= entry.null_count()) {
+    return false;
+  }
+  if (!entry.has_min_value() || !entry.has_max_value()) {
+    return true;
+  }
+
+  CellBuffer min_buf;
+  CellBuffer max_buf;
+  const void* min = DecodeCell(type_info, Slice(entry.min_value()), &min_buf);
+  const void* max = DecodeCell(type_info, Slice(entry.max_value()), &max_buf);
+  auto in_range = [&] (const void* value) {
+    return type_info->Compare(value, min) >= 0 && type_info->Compare(value, max) <= 0;
+  };
+
+  switch (pred.predicate_type()) {
+    case PredicateType::Range:
+    case PredicateType::InBloomFilter:
+      // The bloom filters can't be checked against a range, but the bounds can.
+      if (pred.raw_lower() != nullptr && type_info->Compare(max, pred.raw_lower()) < 0) {
+        return false;
+      }
+      if (pred.raw_upper() != nullptr && type_info->Compare(min, pred.raw_upper()) >= 0) {
+        return false;
+      }
+      return true;
+    case PredicateType::Equality:
+      return in_range(pred.raw_lower());
+    case PredicateType::InList:
+      for (const void* value : pred.raw_values()) {
+        if (in_range(value)) {
+          return true;
+        }
+      }
+      return false;
+    default:
+      LOG(FATAL) << "unknown predicate type";
+  }
+  return true;
+}
+
+// Dedup the hashes once there are enough of them for it to be worth it.
+static const size_t kMinValueBloomDedupSize = 64 * 1024;
+
+ValueBloomBuilder::ValueBloomBuilder(const TypeInfo* type_info)
+  : type_info_(type_info),
+    dedup_size_(kMinValueBloomDedupSize) {
+}
+
+ValueBloomBuilder::~ValueBloomBuilder() {
+}
+
+void ValueBloomBuilder::AddValues(const void* cells, size_t count) {
+  const uint8_t* cell = reinterpret_cast<const uint8_t*>(cells);
+  for (size_t i = 0; i < count; i++) {
+    hashes_.push_back(HashCell(type_info_, cell));
+    cell += type_info_->size();
+  }
+  if (PREDICT_FALSE(hashes_.size() >= dedup_size_)) {
+    Dedup();
+    dedup_size_ = std::max(kMinValueBloomDedupSize, hashes_.size() * 2);
+  }
+}
+
+void ValueBloomBuilder::Dedup() {
+  std::sort(hashes_.begin(), hashes_.end());
+  hashes_.erase(std::unique(hashes_.begin(), hashes_.end()), hashes_.end());
+}
+
+void ValueBloomBuilder::Finish(double fp_rate, gscoped_ptr<BloomFilterBuilder>* bloom,
+                               BloomBlockHeaderPB* header) {
+  Dedup();
+  bloom->reset(new BloomFilterBuilder(
+      BloomFilterSizing::ByCountAndFPRate(std::max<size_t>(1, hashes_.size()), fp_rate,
+                                          BLOCKED_BLOOM_LAYOUT)));
+  for (const uint64_t& hash : hashes_) {
+    (*bloom)->AddKey(ValueBloomProbe(&hash));
+  }
+  header->Clear();
+  header->set_layout(BloomBlockHeaderPB::BLOCKED);
+  header->set_num_hash_functions(0);
+  hashes_.clear();
+  hashes_.shrink_to_fit();
+}
+
+bool ValueBloomMayMatch(const TypeInfo* type_info,
+                        const BloomFilter& bloom,
+                        const ColumnPredicate& pred) {
+  auto may_contain = [&] (const void* value) {
+    uint64_t hash = HashCell(type_info, value);
+    return bloom.MayContainKey(ValueBloomProbe(&hash));
+  };
+  switch (pred.predicate_type()) {
+    case PredicateType::Equality:
+      return may_contain(pred.raw_lower());
+    case PredicateType::InList:
+      for (const void* value : pred.raw_values()) {
+        if (may_contain(value)) {
+          return true;
+        }
+      }
+      return false;
+    default:
+      return true;
+  }
+}
+
+} // namespace cfile
+} // namespace kudu
@@ -0,0 +1,160 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CFILE_ZONE_MAP_H
+#define KUDU_CFILE_ZONE_MAP_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "kudu/cfile/cfile.pb.h"
+#include "kudu/common/rowid.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/hyperloglog.h"
+
+namespace kudu {
+
+class BloomFilter;
+class BloomFilterBuilder;
+class ColumnPredicate;
+class TypeInfo;
+
+namespace cfile {
+
+// Accumulates the minimum value, maximum value and NULL count of the cells
+// written to a CFile, both for each data block and for the file as a whole.
+// For the file as a whole, it also sketches the number of distinct values.
+//
+// The min/max values are stored in ZoneMapEntryPB as the raw cell bytes for
+// fixed size types, and as the value itself for binary types.
+class ZoneMapBuilder {
+ public:
+  // The sketch is kept in the CFile footer, which readers hold in memory, so
+  // it trades some accuracy (a 3.3% standard error) for 1KB per file.
+  static const int kNdvSketchPrecision = 10;
+
+  explicit ZoneMapBuilder(const TypeInfo* type_info);
+
+  // Add 'count' consecutive non-NULL cells, laid out as in a ColumnBlock.
+  void AddValues(const void* cells, size_t count);
+
+  // Add 'count' NULL cells.
+  void AddNulls(size_t count);
+
+  // Record the statistics of the cells added since the last call as the entry
+  // of the data block starting at row 'first_row_id'.
+  void FinishBlock(rowid_t first_row_id);
+
+  // Return the entries of all finished blocks, in row order.
+  const ZoneMapPB& zone_map() const { return zone_map_; }
+
+  // Fill 'entry' with the statistics over all finished blocks.
+  void GetFileEntry(ZoneMapEntryPB* entry) const;
+
+  // Return the sketch of the distinct non-NULL values of all added cells.
+  const HyperLogLog& ndv_sketch() const { return ndv_sketch_; }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ZoneMapBuilder);
+
+  // Statistics over a range of cells.
+  struct Stats {
+    Stats();
+    void Reset();
+
+    int64_t num_rows;
+    int64_t null_count;
+
+    // Whether any non-NULL cell was added.
+    bool has_values;
+
+    // Reset to false once a cell without a total order (i.e a floating point
+    // NaN) is added, in which case 'min' and 'max' are meaningless.
+    bool has_range;
+
+    // Encoded min and max values. Only valid if 'has_values' and 'has_range'.
+    faststring min;
+    faststring max;
+  };
+
+  // Widen the range of 'stats' to include 'cell'.
+  void UpdateRange(const void* cell, Stats* stats) const;
+
+  // Merge the statistics of 'src' into 'dst'.
+  void Merge(const Stats& src, Stats* dst) const;
+
+  void ToPB(const Stats& stats, ZoneMapEntryPB* entry) const;
+
+  const TypeInfo* const type_info_;
+
+  Stats block_stats_;
+  Stats file_stats_;
+  ZoneMapPB zone_map_;
+  HyperLogLog ndv_sketch_;
+};
+
+// Return false if it is certain that no row summarized by 'entry' satisfies
+// 'pred'. 'type_info' is the type the entry's values were encoded from.
+bool ZoneMayMatch(const TypeInfo* type_info,
+                  const ZoneMapEntryPB& entry,
+                  const ColumnPredicate& pred);
+
+// Accumulates the distinct non-NULL values written to a CFile, for a bloom
+// filter of the file's values. Only the hashes of the values are kept, and
+// the filter is sized once they're all known, by their number.
+class ValueBloomBuilder {
+ public:
+  explicit ValueBloomBuilder(const TypeInfo* type_info);
+  ~ValueBloomBuilder();
+
+  // Add 'count' consecutive non-NULL cells, laid out as in a ColumnBlock.
+  void AddValues(const void* cells, size_t count);
+
+  // Build the bloom filter of all added values into 'bloom', with a false
+  // positive rate of 'fp_rate'. Its bitmap is the contents of the bloom
+  // filter block. Fills 'header' with the filter's parameters.
+  void Finish(double fp_rate, gscoped_ptr<BloomFilterBuilder>* bloom,
+              BloomBlockHeaderPB* header);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ValueBloomBuilder);
+
+  // Sort 'hashes_' and remove the duplicates.
+  void Dedup();
+
+  const TypeInfo* const type_info_;
+
+  std::vector<uint64_t> hashes_;
+
+  // The size of 'hashes_' at which its duplicates are next removed, so that
+  // columns with few distinct values use little memory.
+  size_t dedup_size_;
+};
+
+// Return false if it is certain that no value added to the bloom filter
+// 'bloom' by a ValueBloomBuilder satisfies 'pred'. Only equality and IN-list
+// predicates can be ruled out.
+bool ValueBloomMayMatch(const TypeInfo* type_info,
+                        const BloomFilter& bloom,
+                        const ColumnPredicate& pred);
+
+} // namespace cfile
+} // namespace kudu
+
+#endif
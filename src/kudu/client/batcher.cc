@@ -49,7 +49,9 @@
 #include "kudu/rpc/request_tracker.h"
 #include "kudu/rpc/retriable_rpc.h"
 #include "kudu/rpc/rpc.h"
+#include "kudu/rpc/rpc_sidecar.h"
 #include "kudu/tserver/tserver_service.proxy.h"
+#include "kudu/util/bitmap.h"
 #include "kudu/util/debug-util.h"
 #include "kudu/util/logging.h"
 
@@ -70,7 +72,12 @@ using rpc::RetriableRpc;
 using rpc::RetriableRpcStatus;
 using rpc::Rpc;
 using rpc::RpcController;
+using rpc::RpcSidecar;
 using rpc::ServerPicker;
+using tserver::MultiWriteRequestPB;
+using tserver::MultiWriteResponsePB;
+using tserver::TabletServerErrorPB;
+using tserver::TabletServerFeatures;
 using tserver::WriteRequestPB;
 using tserver::WriteResponsePB;
 using tserver::WriteResponsePB_PerRowErrorPB;
@@ -207,12 +214,35 @@ class WriteRpc : public RetriableRpc<RemoteTabletServer, WriteRequestPB, WriteRe
   const WriteResponsePB& resp() const { return resp_; }
   const string& tablet_id() const { return tablet_id_; }
 
+  // Fills in 'req' as this RPC's section of a MultiWrite RPC to 'ts', whose
+  // controller is 'controller'.
+  void PrepareMultiWrite(RemoteTabletServer* ts, RpcController* controller,
+                         WriteRequestPB* req);
+
+  // Completes this RPC with its section 'resp' of a MultiWrite response.
+  // Deletes this RPC.
+  void FinishFromMultiWrite(const WriteResponsePB& resp);
+
+  // If the replica which rejected the write in 'resp' named the leader,
+  // marks it as the leader in the meta cache so that the retry goes there
+  // without looking the tablet up from the master.
+  void ApplyLeaderHint(const WriteResponsePB& resp);
+
  protected:
   void Try(RemoteTabletServer* replica, const ResponseCallback& callback) override;
   RetriableRpcStatus AnalyzeResponse(const Status& rpc_cb_status) override;
   void Finish(const Status& status) override;
 
  private:
+  // Attaches the encoded rows and their indirect data to the next attempt as
+  // RPC sidecars, so they needn't be serialized into the request. Returns
+  // false if they couldn't be attached.
+  bool AddRowSidecars(RpcController* controller);
+
+  // Copies the encoded rows into 'req_', for servers which don't accept them
+  // in sidecars.
+  void CopyRowsIntoRequest();
+
   // Pointer back to the batcher. Processes the write response when it
   // completes, regardless of success or failure.
   scoped_refptr<Batcher> batcher_;
@@ -223,6 +253,17 @@ class WriteRpc : public RetriableRpc<RemoteTabletServer, WriteRequestPB, WriteRe
 
   // The id of the tablet being written to.
   string tablet_id_;
+
+  // The encoded operations and their indirect data, shared by the sidecars of
+  // all the attempts. They're copied into 'req_' only for servers which don't
+  // accept them in sidecars.
+  shared_ptr<const string> encoded_rows_;
+  shared_ptr<const string> encoded_indirect_data_;
+
+  // The replica of the latest attempt, and whether that attempt sent the rows
+  // in sidecars.
+  RemoteTabletServer* last_replica_;
+  bool rows_in_sidecars_;
 };
 
 WriteRpc::WriteRpc(const scoped_refptr<Batcher>& batcher,
@@ -235,7 +276,9 @@ WriteRpc::WriteRpc(const scoped_refptr<Batcher>& batcher,
     : RetriableRpc(replica_picker, request_tracker, deadline, messenger),
       batcher_(batcher),
       ops_(std::move(ops)),
-      tablet_id_(tablet_id) {
+      tablet_id_(tablet_id),
+      last_replica_(nullptr),
+      rows_in_sidecars_(false) {
   const Schema* schema = table()->schema().schema_;
 
   req_.set_tablet_id(tablet_id_);
@@ -255,11 +298,18 @@ WriteRpc::WriteRpc(const scoped_refptr<Batcher>& batcher,
   CHECK_OK(SchemaToPB(*schema, req_.mutable_schema(),
                       SCHEMA_PB_WITHOUT_STORAGE_ATTRIBUTES | SCHEMA_PB_WITHOUT_IDS));
 
-  RowOperationsPB* requested = req_.mutable_row_operations();
-
-  // Add the rows
+  // Add the rows. The space for them is reserved up front, rather than
+  // growing the buffer as each row is encoded. Each operation's size is an
+  // upper bound on its encoded row, with its strings, plus enough slack for
+  // the encoder's scratch space.
+  int64_t encoded_size = 1 + schema->byte_size() + 2 * BitmapSize(schema->num_columns());
+  for (InFlightOp* op : ops_) {
+    encoded_size += op->write_op->SizeInBuffer();
+  }
+  RowOperationsPB encoded_ops;
+  encoded_ops.mutable_rows()->reserve(encoded_size);
   int ctr = 0;
-  RowOperationsPBEncoder enc(requested);
+  RowOperationsPBEncoder enc(&encoded_ops);
   for (InFlightOp* op : ops_) {
 #ifndef NDEBUG
     const Partition& partition = op->tablet->partition();
@@ -283,8 +333,17 @@ WriteRpc::WriteRpc(const scoped_refptr<Batcher>& batcher,
   }
 
   if (VLOG_IS_ON(3)) {
-    VLOG(3) << "Created batch for " << tablet_id << ":\n" << req_.ShortDebugString();
+    VLOG(3) << "Created batch for " << tablet_id << ":\n" << req_.ShortDebugString()
+            << "\n" << encoded_ops.ShortDebugString();
   }
+
+  // Move the encoded data out of the protobuf, to share it with the sidecars.
+  shared_ptr<string> rows(new string);
+  rows->swap(*encoded_ops.mutable_rows());
+  encoded_rows_ = std::move(rows);
+  shared_ptr<string> indirect_data(new string);
+  indirect_data->swap(*encoded_ops.mutable_indirect_data());
+  encoded_indirect_data_ = std::move(indirect_data);
 }
 
 WriteRpc::~WriteRpc() {
@@ -298,11 +357,84 @@ string WriteRpc::ToString() const {
 
 void WriteRpc::Try(RemoteTabletServer* replica, const ResponseCallback& callback) {
   VLOG(2) << "Tablet " << tablet_id_ << ": Writing batch to replica " << replica->ToString();
+  last_replica_ = replica;
+  rows_in_sidecars_ = replica->supports_write_rows_in_sidecars() &&
+      AddRowSidecars(mutable_retrier()->mutable_controller());
+  if (rows_in_sidecars_) {
+    req_.clear_row_operations();
+  } else {
+    req_.clear_rows_sidecar();
+    req_.clear_indirect_data_sidecar();
+    if (!req_.has_row_operations()) {
+      CopyRowsIntoRequest();
+    }
+  }
   replica->proxy()->WriteAsync(req_, &resp_,
                                mutable_retrier()->mutable_controller(),
                                callback);
 }
 
+bool WriteRpc::AddRowSidecars(RpcController* controller) {
+  int rows_idx;
+  int indirect_idx = -1;
+  Status s = controller->AddOutboundSidecar(
+      make_gscoped_ptr(new RpcSidecar(encoded_rows_)), &rows_idx);
+  if (s.ok() && !encoded_indirect_data_->empty()) {
+    s = controller->AddOutboundSidecar(
+        make_gscoped_ptr(new RpcSidecar(encoded_indirect_data_)), &indirect_idx);
+  }
+  if (PREDICT_FALSE(!s.ok())) {
+    LOG(WARNING) << "Unable to send rows in sidecars: " << s.ToString();
+    return false;
+  }
+  req_.set_rows_sidecar(rows_idx);
+  if (indirect_idx >= 0) {
+    req_.set_indirect_data_sidecar(indirect_idx);
+  } else {
+    req_.clear_indirect_data_sidecar();
+  }
+  controller->RequireServerFeature(TabletServerFeatures::WRITE_ROWS_IN_SIDECAR);
+  return true;
+}
+
+void WriteRpc::CopyRowsIntoRequest() {
+  RowOperationsPB* ops = req_.mutable_row_operations();
+  ops->set_rows(*encoded_rows_);
+  if (!encoded_indirect_data_->empty()) {
+    ops->set_indirect_data(*encoded_indirect_data_);
+  }
+}
+
+void WriteRpc::PrepareMultiWrite(RemoteTabletServer* ts, RpcController* controller,
+                                 WriteRequestPB* req) {
+  last_replica_ = ts;
+  rows_in_sidecars_ = ts->supports_write_rows_in_sidecars() && AddRowSidecars(controller);
+  if (!rows_in_sidecars_) {
+    req_.clear_rows_sidecar();
+    req_.clear_indirect_data_sidecar();
+    CopyRowsIntoRequest();
+  }
+  req->CopyFrom(req_);
+  // Should the section need to be retried through its own RPC, its rows are
+  // copied in again there as needed.
+  req_.clear_row_operations();
+}
+
+void WriteRpc::FinishFromMultiWrite(const WriteResponsePB& resp) {
+  resp_.CopyFrom(resp);
+  Finish(resp_.has_error() ? StatusFromPB(resp_.error().status()) : Status::OK());
+}
+
+void WriteRpc::ApplyLeaderHint(const WriteResponsePB& resp) {
+  if (!resp.has_error() || !resp.error().has_leader_uuid()) {
+    return;
+  }
+  const string& leader_uuid = resp.error().leader_uuid();
+  if (ops_[0]->tablet->MarkTServerAsLeaderByUuid(leader_uuid)) {
+    VLOG(1) << ToString() << ": retrying on hinted leader " << leader_uuid;
+  }
+}
+
 void WriteRpc::Finish(const Status& status) {
   unique_ptr<WriteRpc> this_instance(this);
   Status final_status = status;
@@ -333,6 +465,20 @@ RetriableRpcStatus WriteRpc::AnalyzeResponse(const Status& rpc_cb_status) {
       result.result = RetriableRpcStatus::SERVER_BUSY;
       return result;
     }
+
+    // A server which doesn't accept the rows in sidecars rejects the request
+    // as a whole; retry it there with the rows in the request itself.
+    if (rows_in_sidecars_ && err &&
+        std::find(err->unsupported_feature_flags().begin(),
+                  err->unsupported_feature_flags().end(),
+                  TabletServerFeatures::WRITE_ROWS_IN_SIDECAR) !=
+            err->unsupported_feature_flags().end()) {
+      VLOG(1) << "Replica " << last_replica_->ToString()
+              << " does not support rows in sidecars";
+      last_replica_->set_write_rows_in_sidecars_unsupported();
+      result.result = RetriableRpcStatus::SERVER_BUSY;
+      return result;
+    }
   }
 
   // Failover to a replica in the event of any network failure or of a DNS resolution problem.
@@ -344,6 +490,11 @@ RetriableRpcStatus WriteRpc::AnalyzeResponse(const Status& rpc_cb_status) {
     return result;
   }
 
+  // Hold back the following writes to the server if it's short of memory.
+  if (resp_.has_admission_backoff_ms() && last_replica_) {
+    last_replica_->SetWriteBackoff(MonoDelta::FromMilliseconds(resp_.admission_backoff_ms()));
+  }
+
   // Prefer controller failures over response failures.
   if (result.status.ok() && resp_.has_error()) {
     result.status = StatusFromPB(resp_.error().status());
@@ -365,6 +516,7 @@ RetriableRpcStatus WriteRpc::AnalyzeResponse(const Status& rpc_cb_status) {
   // require some server-side changes). For example, IllegalState is
   // obviously way too broad an error category for this case.
   if (result.status.IsIllegalState() || result.status.IsAborted()) {
+    ApplyLeaderHint(resp_);
     result.result = RetriableRpcStatus::REPLICA_NOT_LEADER;
     return result;
   }
@@ -377,6 +529,126 @@ RetriableRpcStatus WriteRpc::AnalyzeResponse(const Status& rpc_cb_status) {
   return result;
 }
 
+// A MultiWrite RPC, carrying the writes of several tablets whose leader
+// replicas are on the same tablet server.
+//
+// The writes aren't retried as a whole: each write which fails for a reason
+// that a retry may fix, or all of them if the RPC itself fails, are resent as
+// their own Write RPCs. Deletes itself once sent.
+class MultiWriteRpc {
+ public:
+  MultiWriteRpc(KuduClient* client,
+                RemoteTabletServer* ts,
+                vector<unique_ptr<WriteRpc>> writes,
+                const MonoTime& deadline)
+      : client_(client),
+        ts_(ts),
+        writes_(std::move(writes)),
+        deadline_(deadline) {
+  }
+
+  void SendRpc() {
+    ts_->InitProxy(client_, Bind(&MultiWriteRpc::InitProxyCb, Unretained(this)));
+  }
+
+  string ToString() const {
+    return Substitute("MultiWrite(tserver: $0, num_tablets: $1)",
+                      ts_->ToString(), writes_.size());
+  }
+
+ private:
+  void InitProxyCb(const Status& status) {
+    if (PREDICT_FALSE(!status.ok())) {
+      VLOG(1) << ToString() << ": unable to reach tablet server: " << status.ToString();
+      FallBackAll();
+      delete this;
+      return;
+    }
+    for (const auto& write : writes_) {
+      write->PrepareMultiWrite(ts_, &controller_, req_.add_writes());
+    }
+    controller_.RequireServerFeature(TabletServerFeatures::MULTI_TABLET_WRITES);
+    controller_.set_deadline(deadline_);
+    ts_->proxy()->MultiWriteAsync(req_, &resp_, &controller_,
+                                  boost::bind(&MultiWriteRpc::SendRpcCb, this));
+  }
+
+  void SendRpcCb() {
+    unique_ptr<MultiWriteRpc> this_instance(this);
+    const Status& s = controller_.status();
+    if (PREDICT_FALSE(!s.ok())) {
+      const ErrorStatusPB* err = controller_.error_response();
+      if (err &&
+          std::find(err->unsupported_feature_flags().begin(),
+                    err->unsupported_feature_flags().end(),
+                    TabletServerFeatures::MULTI_TABLET_WRITES) !=
+              err->unsupported_feature_flags().end()) {
+        VLOG(1) << "Tablet server " << ts_->ToString()
+                << " does not support multi-tablet writes";
+        ts_->set_multi_tablet_writes_unsupported();
+      } else {
+        VLOG(1) << ToString() << " failed: " << s.ToString();
+      }
+      FallBackAll();
+      return;
+    }
+    if (PREDICT_FALSE(resp_.writes_size() != static_cast<int>(writes_.size()))) {
+      LOG(WARNING) << ToString() << ": got " << resp_.writes_size()
+                   << " responses for " << writes_.size() << " writes";
+      FallBackAll();
+      return;
+    }
+    for (int i = 0; i < resp_.writes_size(); i++) {
+      const WriteResponsePB& write_resp = resp_.writes(i);
+      if (write_resp.has_admission_backoff_ms()) {
+        ts_->SetWriteBackoff(MonoDelta::FromMilliseconds(write_resp.admission_backoff_ms()));
+      }
+      WriteRpc* write = writes_[i].release();
+      if (ShouldRetry(write_resp)) {
+        write->ApplyLeaderHint(write_resp);
+        write->SendRpc();
+      } else {
+        write->FinishFromMultiWrite(write_resp);
+      }
+    }
+  }
+
+  // Whether the write with response 'resp' failed in a way which resending it
+  // through a Write RPC, picking its leader again, may fix.
+  static bool ShouldRetry(const WriteResponsePB& resp) {
+    if (!resp.has_error()) {
+      return false;
+    }
+    // Same as WriteRpc::AnalyzeResponse().
+    if (resp.error().code() == TabletServerErrorPB::TABLET_NOT_FOUND) {
+      return true;
+    }
+    Status s = StatusFromPB(resp.error().status());
+    return s.IsIllegalState() || s.IsAborted();
+  }
+
+  void FallBackAll() {
+    for (auto& write : writes_) {
+      write.release()->SendRpc();
+    }
+    writes_.clear();
+  }
+
+  KuduClient* const client_;
+  RemoteTabletServer* const ts_;
+
+  // The writes in this RPC, in the order of their sections.
+  vector<unique_ptr<WriteRpc>> writes_;
+
+  const MonoTime deadline_;
+
+  MultiWriteRequestPB req_;
+  MultiWriteResponsePB resp_;
+  RpcController controller_;
+
+  DISALLOW_COPY_AND_ASSIGN(MultiWriteRpc);
+};
+
 Batcher::Batcher(KuduClient* client,
                  scoped_refptr<ErrorCollector> error_collector,
                  sp::weak_ptr<KuduSession> session,
@@ -388,6 +660,7 @@ Batcher::Batcher(KuduClient* client,
     error_collector_(std::move(error_collector)),
     had_errors_(false),
     flush_callback_(nullptr),
+    multi_tablet_writes_(false),
     next_op_sequence_number_(0),
     outstanding_lookups_(0),
     buffer_bytes_used_(0) {
@@ -673,7 +946,27 @@ void Batcher::FlushBuffersIfReady() {
     ops_copy.swap(per_tablet_ops_);
   }
 
-  // Now flush the ops for each tablet.
+  // Group the tablets whose leaders are known to be on the same tablet
+  // server, so their ops may be sent in a single RPC.
+  unordered_map<RemoteTabletServer*, vector<RemoteTablet*>> tablets_by_leader;
+  if (multi_tablet_writes_) {
+    for (const OpsMap::value_type& e : ops_copy) {
+      RemoteTabletServer* leader = e.first->LeaderTServer();
+      if (leader && leader->supports_multi_tablet_writes()) {
+        tablets_by_leader[leader].push_back(e.first);
+      }
+    }
+    for (const auto& e : tablets_by_leader) {
+      if (e.second.size() < 2) {
+        continue;
+      }
+      VLOG(3) << "FlushBuffersIfReady: flushing " << e.second.size()
+              << " tablets to " << e.first->ToString() << " in a single RPC";
+      FlushBuffersToServer(e.first, e.second, &ops_copy);
+    }
+  }
+
+  // Now flush the ops for each remaining tablet.
   for (const OpsMap::value_type& e : ops_copy) {
     RemoteTablet* tablet = e.first;
     const vector<InFlightOp*>& ops = e.second;
@@ -684,12 +977,46 @@ void Batcher::FlushBuffersIfReady() {
   }
 }
 
+void Batcher::FlushBuffersToServer(RemoteTabletServer* ts,
+                                   const vector<RemoteTablet*>& tablets,
+                                   OpsMap* ops) {
+  vector<unique_ptr<WriteRpc>> writes;
+  for (RemoteTablet* tablet : tablets) {
+    auto it = ops->find(tablet);
+    DCHECK(it != ops->end());
+    writes.emplace_back(CreateWriteRpc(tablet, it->second));
+    ops->erase(it);
+  }
+  // The RPC is freed when its callback completes.
+  MultiWriteRpc* rpc = new MultiWriteRpc(client_, ts, std::move(writes), deadline_);
+  SendAfterWriteBackoff(ts, boost::bind(&MultiWriteRpc::SendRpc, rpc));
+}
+
 void Batcher::FlushBuffer(RemoteTablet* tablet, const vector<InFlightOp*>& ops) {
   CHECK(!ops.empty());
 
   // Create and send an RPC that aggregates the ops. The RPC is freed when
   // its callback completes.
-  //
+  WriteRpc* rpc = CreateWriteRpc(tablet, ops);
+  SendAfterWriteBackoff(tablet->LeaderTServer(), boost::bind(&WriteRpc::SendRpc, rpc));
+}
+
+void Batcher::SendAfterWriteBackoff(RemoteTabletServer* ts, const boost::function<void()>& send) {
+  MonoDelta backoff = ts ? ts->WriteBackoff() : MonoDelta::FromNanoseconds(0);
+  // Past the deadline, the server might as well reject the write itself.
+  if (backoff.ToNanoseconds() <= 0 || MonoTime::Now() + backoff >= deadline_) {
+    send();
+    return;
+  }
+  VLOG(2) << "Holding back writes to " << ts->ToString() << " for " << backoff.ToString();
+  // Should the messenger be shut down first, the RPC fails when sent.
+  client_->data_->messenger_->ScheduleOnReactor(
+      [send](const Status& /* status */) { send(); }, backoff);
+}
+
+WriteRpc* Batcher::CreateWriteRpc(RemoteTablet* tablet, const vector<InFlightOp*>& ops) {
+  CHECK(!ops.empty());
+
   // The RPC object takes ownership of the ops.
 
   // TODO Keep a replica picker per tablet and share it across writes
@@ -699,14 +1026,13 @@ void Batcher::FlushBuffer(RemoteTablet* tablet, const vector<InFlightOp*>& ops)
                                 client_->data_->meta_cache_,
                                 ops[0]->write_op->table(),
                                 tablet));
-  WriteRpc* rpc = new WriteRpc(this,
-                               server_picker,
-                               client_->data_->request_tracker_,
-                               ops,
-                               deadline_,
-                               client_->data_->messenger_,
-                               tablet->tablet_id());
-  rpc->SendRpc();
+  return new WriteRpc(this,
+                      server_picker,
+                      client_->data_->request_tracker_,
+                      ops,
+                      deadline_,
+                      client_->data_->messenger_,
+                      tablet->tablet_id());
 }
 
 void Batcher::ProcessWriteResponse(const WriteRpc& rpc,
@@ -17,6 +17,7 @@
 #ifndef KUDU_CLIENT_BATCHER_H
 #define KUDU_CLIENT_BATCHER_H
 
+#include <boost/function.hpp>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -45,6 +46,7 @@ struct InFlightOp;
 
 class ErrorCollector;
 class RemoteTablet;
+class RemoteTabletServer;
 class WriteRpc;
 
 // A Batcher is the class responsible for collecting row operations, routing them to the
@@ -82,6 +84,12 @@ class Batcher : public RefCountedThreadSafe<Batcher> {
   // may time out before even sending an op). TODO: implement that
   void SetTimeoutMillis(int millis);
 
+  // Whether to send the ops of tablets whose leaders are on the same tablet
+  // server in a single RPC. See KuduSession::SetMultiTabletWrites().
+  void set_multi_tablet_writes(bool enabled) {
+    multi_tablet_writes_ = enabled;
+  }
+
   // Add a new operation to the batch. Requires that the batch has not yet been flushed.
   //
   // NOTE: If this returns not-OK, does not take ownership of 'write_op'.
@@ -130,6 +138,8 @@ class Batcher : public RefCountedThreadSafe<Batcher> {
   friend class RefCountedThreadSafe<Batcher>;
   friend class WriteRpc;
 
+  typedef std::unordered_map<RemoteTablet*, std::vector<InFlightOp*> > OpsMap;
+
   ~Batcher();
 
   // Add an op to the in-flight set and increment the ref-count.
@@ -155,6 +165,19 @@ class Batcher : public RefCountedThreadSafe<Batcher> {
   void FlushBuffersIfReady();
   void FlushBuffer(RemoteTablet* tablet, const std::vector<InFlightOp*>& ops);
 
+  // Sends the ops of 'tablets', whose leaders are on 'ts', in a single RPC.
+  // Removes them from 'ops'.
+  void FlushBuffersToServer(RemoteTabletServer* ts,
+                            const std::vector<RemoteTablet*>& tablets,
+                            OpsMap* ops);
+
+  // Creates the RPC which writes 'ops' to 'tablet', without sending it.
+  WriteRpc* CreateWriteRpc(RemoteTablet* tablet, const std::vector<InFlightOp*>& ops);
+
+  // Calls 'send' to send a write to 'ts' (which may be NULL) once the
+  // server's write backoff, if any, has passed.
+  void SendAfterWriteBackoff(RemoteTabletServer* ts, const boost::function<void()>& send);
+
   // Cleans up an RPC response, scooping out any errors and passing them up
   // to the batcher.
   void ProcessWriteResponse(const WriteRpc& rpc, const Status& s);
@@ -198,10 +221,12 @@ class Batcher : public RefCountedThreadSafe<Batcher> {
   // will be called exactly once (and the state changed to kFlushed).
   KuduStatusCallback* flush_callback_;
 
+  // Set by set_multi_tablet_writes().
+  bool multi_tablet_writes_;
+
   // All buffered or in-flight ops.
   std::unordered_set<InFlightOp*> ops_;
   // Each tablet's buffered ops.
-  typedef std::unordered_map<RemoteTablet*, std::vector<InFlightOp*> > OpsMap;
   OpsMap per_tablet_ops_;
 
   // When each operation is added to the batcher, it is assigned a sequence number
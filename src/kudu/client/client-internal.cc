@@ -83,6 +83,7 @@ using strings::Substitute;
 namespace client {
 
 using internal::GetTableSchemaRpc;
+using internal::RemoteReplica;
 using internal::RemoteTablet;
 using internal::RemoteTabletServer;
 
@@ -300,32 +301,63 @@ RemoteTabletServer* KuduClient::Data::SelectTServer(const scoped_refptr<RemoteTa
       break;
     }
     case CLOSEST_REPLICA:
-    case FIRST_REPLICA: {
-      rt->GetRemoteTabletServers(candidates);
+    case FIRST_REPLICA:
+    case LEAST_LOADED_REPLICA:
+    case LEARNER_REPLICA: {
+      vector<RemoteReplica> replicas;
+      rt->GetRemoteReplicas(&replicas);
       // Filter out all the blacklisted candidates.
       vector<RemoteTabletServer*> filtered;
-      for (RemoteTabletServer* rts : *candidates) {
+      vector<RemoteTabletServer*> learners;
+      for (const RemoteReplica& replica : replicas) {
+        RemoteTabletServer* rts = replica.ts;
+        candidates->push_back(rts);
         if (!ContainsKey(blacklist, rts->permanent_uuid())) {
           filtered.push_back(rts);
+          if (replica.role == RaftPeerPB::LEARNER) {
+            learners.push_back(rts);
+          }
         } else {
           VLOG(1) << "Excluding blacklisted tserver " << rts->permanent_uuid();
         }
       }
+      // Chooses a local server among 'servers', or a random one if none are
+      // local.
+      auto pick_closest = [this](const vector<RemoteTabletServer*>& servers) {
+        for (RemoteTabletServer* rts : servers) {
+          if (IsTabletServerLocal(*rts)) {
+            return rts;
+          }
+        }
+        return servers.empty() ? nullptr : servers[rand() % servers.size()];
+      };
       if (selection == FIRST_REPLICA) {
         if (!filtered.empty()) {
           ret = filtered[0];
         }
       } else if (selection == CLOSEST_REPLICA) {
-        // Choose a local replica.
-        for (RemoteTabletServer* rts : filtered) {
-          if (IsTabletServerLocal(*rts)) {
-            ret = rts;
-            break;
-          }
+        ret = pick_closest(filtered);
+      } else if (selection == LEARNER_REPLICA) {
+        ret = pick_closest(learners);
+        if (ret == nullptr) {
+          ret = pick_closest(filtered);
         }
-        // Fallback to a random replica if none are local.
-        if (ret == nullptr && !filtered.empty()) {
-          ret = filtered[rand() % filtered.size()];
+      } else if (selection == LEAST_LOADED_REPLICA) {
+        // Compare two random replicas rather than all of them, so that many
+        // clients with similar views of the servers don't all pile onto the
+        // same one.
+        if (filtered.size() == 1) {
+          ret = filtered[0];
+        } else if (filtered.size() > 1) {
+          int first = rand() % filtered.size();
+          int second = rand() % (filtered.size() - 1);
+          if (second >= first) {
+            second++;
+          }
+          ret = filtered[first];
+          if (filtered[second]->LoadScore() < ret->LoadScore()) {
+            ret = filtered[second];
+          }
         }
       }
       break;
@@ -416,6 +448,10 @@ Status KuduClient::Data::IsCreateTableInProgress(KuduClient* client,
   }
 
   *create_in_progress = !resp.done();
+  if (*create_in_progress) {
+    VLOG(1) << "Table " << table_name << " has " << resp.num_running_tablets()
+            << " of " << resp.num_tablets() << " tablets running";
+  }
   return Status::OK();
 }
 
@@ -449,24 +485,24 @@ Status KuduClient::Data::DeleteTable(KuduClient* client,
 Status KuduClient::Data::AlterTable(KuduClient* client,
                                     const AlterTableRequestPB& req,
                                     const MonoTime& deadline,
-                                    bool has_add_drop_partition) {
+                                    bool has_add_drop_partition,
+                                    AlterTableResponsePB* resp) {
   vector<uint32_t> required_feature_flags;
   if (has_add_drop_partition) {
     required_feature_flags.push_back(MasterFeatures::ADD_DROP_RANGE_PARTITIONS);
   }
-  AlterTableResponsePB resp;
   Status s =
       SyncLeaderMasterRpc<AlterTableRequestPB, AlterTableResponsePB>(
           deadline,
           client,
           req,
-          &resp,
+          resp,
           "AlterTable",
           &MasterServiceProxy::AlterTable,
           std::move(required_feature_flags));
   RETURN_NOT_OK(s);
-  if (resp.has_error()) {
-    return StatusFromPB(resp.error().status());
+  if (resp->has_error()) {
+    return StatusFromPB(resp->error().status());
   }
   return Status::OK();
 }
@@ -37,6 +37,7 @@ class HostPort;
 
 namespace master {
 class AlterTableRequestPB;
+class AlterTableResponsePB;
 class CreateTableRequestPB;
 class GetLeaderMasterRpc;
 class MasterServiceProxy;
@@ -92,7 +93,8 @@ class KuduClient::Data {
   Status AlterTable(KuduClient* client,
                     const master::AlterTableRequestPB& req,
                     const MonoTime& deadline,
-                    bool has_add_drop_partition);
+                    bool has_add_drop_partition,
+                    master::AlterTableResponsePB* resp);
 
   Status IsAlterTableInProgress(KuduClient* client,
                                 const std::string& table_name,
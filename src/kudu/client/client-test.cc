@@ -59,6 +59,7 @@
 #include "kudu/tserver/scanners.h"
 #include "kudu/tserver/tablet_server.h"
 #include "kudu/tserver/ts_tablet_manager.h"
+#include "kudu/util/bitmap.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/scoped_cleanup.h"
@@ -86,6 +87,8 @@ METRIC_DECLARE_counter(rpcs_queue_overflow);
 METRIC_DECLARE_histogram(handler_latency_kudu_master_MasterService_GetMasterRegistration);
 METRIC_DECLARE_histogram(handler_latency_kudu_master_MasterService_GetTableLocations);
 METRIC_DECLARE_histogram(handler_latency_kudu_master_MasterService_GetTabletLocations);
+METRIC_DECLARE_histogram(handler_latency_kudu_tserver_TabletServerService_MultiWrite);
+METRIC_DECLARE_histogram(handler_latency_kudu_tserver_TabletServerService_Write);
 
 using std::bind;
 using std::for_each;
@@ -111,6 +114,7 @@ using master::GetTableLocationsRequestPB;
 using master::GetTableLocationsResponsePB;
 using master::TabletLocationsPB;
 using sp::shared_ptr;
+using tablet::Tablet;
 using tablet::TabletPeer;
 using tserver::MiniTabletServer;
 
@@ -187,7 +191,7 @@ class ClientTest : public KuduTest {
                                        int64_t* result_max_size) {
     int64_t max_size = 0;
     while (!run_ctl->WaitFor(MonoDelta::FromMilliseconds(1))) {
-      int size = session->data_->GetPendingOperationsSizeForTests();
+      int size = session->data_->GetPendingOperationsSize();
       if (size > max_size) {
         max_size = size;
       }
@@ -844,6 +848,95 @@ TEST_F(ClientTest, TestScanMultiTablet) {
   ASSERT_EQ(0, CountRowsFromClient(table.get(), 50, kNoBound));
 }
 
+// Reverse-ordered scans visit the tablets last to first, so their limits
+// keep the highest keys of the whole table.
+TEST_F(ClientTest, TestReverseOrderedScanMultiTablet) {
+  vector<unique_ptr<KuduPartialRow>> rows;
+  for (int i = 1; i < 4; i++) {
+    unique_ptr<KuduPartialRow> row(schema_.NewRow());
+    CHECK_OK(row->SetInt32(0, i * 10));
+    rows.push_back(std::move(row));
+  }
+  shared_ptr<KuduTable> table;
+  NO_FATALS(CreateTable("TestReverseOrderedScanMultiTablet", 1, std::move(rows), {}, &table));
+  NO_FATALS(InsertTestRows(table.get(), 40));
+
+  auto scan_keys = [&](int limit, int upper_bound, vector<int32_t>* keys) {
+    KuduScanner scanner(table.get());
+    ASSERT_OK(scanner.SetOrderMode(KuduScanner::REVERSE_ORDERED));
+    if (limit >= 0) {
+      ASSERT_OK(scanner.SetLimit(limit));
+    }
+    if (upper_bound != kNoBound) {
+      ASSERT_OK(scanner.AddConjunctPredicate(table->NewComparisonPredicate(
+          "key", KuduPredicate::LESS, KuduValue::FromInt(upper_bound))));
+    }
+    ASSERT_OK(scanner.Open());
+    KuduScanBatch batch;
+    while (scanner.HasMoreRows()) {
+      ASSERT_OK(scanner.NextBatch(&batch));
+      for (const KuduScanBatch::RowPtr& row : batch) {
+        int32_t key;
+        ASSERT_OK(row.GetInt32(0, &key));
+        keys->push_back(key);
+      }
+    }
+  };
+
+  vector<int32_t> keys;
+  NO_FATALS(scan_keys(-1, kNoBound, &keys));
+  ASSERT_EQ(40, keys.size());
+  for (int i = 0; i < 40; i++) {
+    ASSERT_EQ(39 - i, keys[i]);
+  }
+
+  keys.clear();
+  NO_FATALS(scan_keys(5, kNoBound, &keys));
+  ASSERT_EQ((vector<int32_t>{ 39, 38, 37, 36, 35 }), keys);
+
+  // The limit spans tablets.
+  keys.clear();
+  NO_FATALS(scan_keys(4, 22, &keys));
+  ASSERT_EQ((vector<int32_t>{ 21, 20, 19, 18 }), keys);
+}
+
+// The profile of a scan tells the rows read from disk from those read from
+// the MemRowSet.
+TEST_F(ClientTest, TestScanProfile) {
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), 1000));
+  vector<scoped_refptr<TabletPeer>> peers;
+  cluster_->mini_tablet_server(0)->server()->tablet_manager()->GetTabletPeers(&peers);
+  for (const auto& peer : peers) {
+    ASSERT_OK(peer->tablet()->Flush());
+  }
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), 100, 1000));
+
+  KuduScanner scanner(client_table_.get());
+  ASSERT_OK(scanner.SetProjectedColumns({ "key", "int_val" }));
+  ASSERT_OK(scanner.SetProfilingEnabled(true));
+  ASSERT_OK(scanner.Open());
+  KuduScanBatch batch;
+  int rows = 0;
+  while (scanner.HasMoreRows()) {
+    ASSERT_OK(scanner.NextBatch(&batch));
+    rows += batch.NumRows();
+  }
+  ASSERT_EQ(1100, rows);
+  ASSERT_FALSE(scanner.SetProfilingEnabled(false).ok());
+
+  std::map<std::string, int64_t> key_profile = scanner.GetColumnProfile("key");
+  ASSERT_EQ(1000, key_profile["cells_read_from_disk"]);
+  ASSERT_EQ(100, key_profile["cells_read_from_memrowset"]);
+  ASSERT_GT(key_profile["data_blocks_read_from_disk"], 0);
+  ASSERT_TRUE(scanner.GetColumnProfile("string_val").empty());
+
+  std::map<std::string, int64_t> profile = scanner.GetProfile().Get();
+  ASSERT_TRUE(ContainsKey(profile, "queue_time_us"));
+  ASSERT_TRUE(ContainsKey(profile, "scan_time_us"));
+  ASSERT_EQ(2000, profile["cells_read_from_disk"]);
+  ASSERT_EQ(200, profile["cells_read_from_memrowset"]);
+}
+
 TEST_F(ClientTest, TestScanEmptyTable) {
   KuduScanner scanner(client_table_.get());
   ASSERT_OK(scanner.SetProjectedColumns(vector<string>()));
@@ -882,6 +975,338 @@ TEST_F(ClientTest, TestScanEmptyProjection) {
   }
 }
 
+TEST_F(ClientTest, TestScanColumnarLayout) {
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(),
+                                         FLAGS_test_scan_num_rows));
+  KuduScanner scanner(client_table_.get());
+  ASSERT_OK(scanner.SetProjectedColumns({ "key", "string_val" }));
+  ASSERT_OK(scanner.SetRowFormatFlags(KuduScanner::COLUMNAR_LAYOUT));
+  ASSERT_OK(scanner.Open());
+
+  // Changing the format of an open scanner is not allowed.
+  Status s = scanner.SetRowFormatFlags(KuduScanner::NO_FLAGS);
+  ASSERT_TRUE(s.IsIllegalState()) << s.ToString();
+
+  KuduScanBatch batch;
+  uint64_t count = 0;
+  while (scanner.HasMoreRows()) {
+    ASSERT_OK(scanner.NextBatch(&batch));
+
+    Slice keys;
+    ASSERT_OK(batch.GetFixedLengthColumn(0, &keys));
+    ASSERT_EQ(batch.NumRows() * sizeof(int32_t), keys.size());
+    s = batch.GetFixedLengthColumn(1, &keys);
+    ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+
+    Slice offsets_slice, strings;
+    ASSERT_OK(batch.GetVariableLengthColumn(1, &offsets_slice, &strings));
+    ASSERT_EQ((batch.NumRows() + 1) * sizeof(uint32_t), offsets_slice.size());
+    Slice non_null;
+    ASSERT_OK(batch.GetNonNullBitmapForColumn(1, &non_null));
+
+    const int32_t* key_cells = reinterpret_cast<const int32_t*>(keys.data());
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(offsets_slice.data());
+    for (int i = 0; i < batch.NumRows(); i++) {
+      ASSERT_TRUE(BitmapTest(non_null.data(), i));
+      Slice str(strings.data() + offsets[i], offsets[i + 1] - offsets[i]);
+      ASSERT_EQ(StringPrintf("hello %d", key_cells[i]), str.ToString());
+    }
+    count += batch.NumRows();
+  }
+  ASSERT_EQ(FLAGS_test_scan_num_rows, count);
+}
+
+TEST_F(ClientTest, TestScanRowwiseColumnViews) {
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(),
+                                         FLAGS_test_scan_num_rows));
+  KuduScanner scanner(client_table_.get());
+  ASSERT_OK(scanner.SetProjectedColumns({ "key", "string_val" }));
+  ASSERT_OK(scanner.Open());
+
+  KuduScanBatch batch;
+  uint64_t count = 0;
+  while (scanner.HasMoreRows()) {
+    ASSERT_OK(scanner.NextBatch(&batch));
+
+    const uint8_t* keys;
+    const uint8_t* strings;
+    const uint8_t* key_nulls;
+    const uint8_t* string_nulls;
+    size_t key_stride, string_stride;
+    ASSERT_OK(batch.GetRowwiseColumn(0, &keys, &key_nulls, &key_stride));
+    ASSERT_OK(batch.GetRowwiseColumn(1, &strings, &string_nulls, &string_stride));
+    ASSERT_EQ(key_stride, string_stride);
+    ASSERT_TRUE(key_nulls == nullptr);
+    Status s = batch.GetRowwiseColumn(2, &keys, &key_nulls, &key_stride);
+    ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+
+    for (int i = 0; i < batch.NumRows(); i++) {
+      int32_t key;
+      memcpy(&key, keys + i * key_stride, sizeof(key));
+      int32_t row_key;
+      ASSERT_OK(batch.Row(i).GetInt32(0, &row_key));
+      ASSERT_EQ(row_key, key);
+      ASSERT_FALSE(BitmapTest(string_nulls + i * string_stride, 1));
+      const Slice* str = reinterpret_cast<const Slice*>(strings + i * string_stride);
+      ASSERT_EQ(StringPrintf("hello %d", key), str->ToString());
+    }
+    count += batch.NumRows();
+  }
+  ASSERT_EQ(FLAGS_test_scan_num_rows, count);
+}
+
+TEST_F(ClientTest, TestScanAggregates) {
+  const int kNumRows = FLAGS_test_scan_num_rows;
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), kNumRows));
+
+  KuduScanner scanner(client_table_.get());
+  ASSERT_OK(scanner.AddAggregate(KuduScanner::AGGREGATE_COUNT, ""));
+  ASSERT_OK(scanner.AddAggregate(KuduScanner::AGGREGATE_MIN, "key"));
+  ASSERT_OK(scanner.AddAggregate(KuduScanner::AGGREGATE_MAX, "key"));
+  ASSERT_OK(scanner.AddAggregate(KuduScanner::AGGREGATE_SUM, "int_val"));
+  ASSERT_OK(scanner.AddAggregate(KuduScanner::AGGREGATE_COUNT, "string_val"));
+  ASSERT_OK(scanner.AddAggregate(KuduScanner::AGGREGATE_MIN, "string_val"));
+  ASSERT_OK(scanner.AddConjunctPredicate(client_table_->NewComparisonPredicate(
+      "key", KuduPredicate::GREATER_EQUAL, KuduValue::FromInt(5))));
+  ASSERT_EQ(3, scanner.GetProjectionSchema().num_columns());
+
+  // Invalid aggregates are rejected.
+  Status s = scanner.AddAggregate(KuduScanner::AGGREGATE_SUM, "string_val");
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  s = scanner.AddAggregate(KuduScanner::AGGREGATE_MAX, "");
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  s = scanner.SetProjectedColumns({ "key" });
+  ASSERT_TRUE(s.IsIllegalState()) << s.ToString();
+
+  ASSERT_OK(scanner.Open());
+  const KuduPartialRow* result;
+  ASSERT_OK(scanner.ComputeAggregates(&result));
+
+  int64_t count;
+  ASSERT_OK(result->GetInt64("count(*)", &count));
+  ASSERT_EQ(kNumRows - 5, count);
+  int32_t min_key, max_key;
+  ASSERT_OK(result->GetInt32("min(key)", &min_key));
+  ASSERT_EQ(5, min_key);
+  ASSERT_OK(result->GetInt32("max(key)", &max_key));
+  ASSERT_EQ(kNumRows - 1, max_key);
+  int64_t sum;
+  ASSERT_OK(result->GetInt64("sum(int_val)", &sum));
+  int64_t expected_sum = 0;
+  for (int i = 5; i < kNumRows; i++) {
+    expected_sum += i * 2;
+  }
+  ASSERT_EQ(expected_sum, sum);
+  ASSERT_OK(result->GetInt64("count(string_val)", &count));
+  ASSERT_EQ(kNumRows - 5, count);
+  Slice min_string;
+  ASSERT_OK(result->GetString("min(string_val)", &min_string));
+  ASSERT_EQ(kNumRows > 10 ? "hello 10" : "hello 5", min_string.ToString());
+
+  // An aggregating scan which matches no rows returns a zero count and NULL
+  // for the other aggregates.
+  KuduScanner empty_scanner(client_table_.get());
+  ASSERT_OK(empty_scanner.AddAggregate(KuduScanner::AGGREGATE_COUNT, ""));
+  ASSERT_OK(empty_scanner.AddAggregate(KuduScanner::AGGREGATE_MAX, "key"));
+  ASSERT_OK(empty_scanner.AddConjunctPredicate(client_table_->NewComparisonPredicate(
+      "key", KuduPredicate::LESS, KuduValue::FromInt(0))));
+  ASSERT_OK(empty_scanner.Open());
+  ASSERT_OK(empty_scanner.ComputeAggregates(&result));
+  ASSERT_OK(result->GetInt64("count(*)", &count));
+  ASSERT_EQ(0, count);
+  ASSERT_TRUE(result->IsNull("max(key)"));
+}
+
+TEST_F(ClientTest, TestScanGroupedAggregates) {
+  const int kNumRows = FLAGS_test_scan_num_rows;
+  const int kNumGroups = 3;
+  shared_ptr<KuduSession> session = client_->NewSession();
+  ASSERT_OK(session->SetFlushMode(KuduSession::MANUAL_FLUSH));
+  map<string, pair<int64_t, int64_t>> expected;
+  for (int i = 0; i < kNumRows; i++) {
+    gscoped_ptr<KuduInsert> insert(client_table_->NewInsert());
+    KuduPartialRow* row = insert->mutable_row();
+    string group = Substitute("group $0", i % kNumGroups);
+    ASSERT_OK(row->SetInt32("key", i));
+    ASSERT_OK(row->SetInt32("int_val", i));
+    ASSERT_OK(row->SetStringCopy("string_val", group));
+    ASSERT_OK(row->SetInt32("non_null_with_default", 0));
+    ASSERT_OK(session->Apply(insert.release()));
+    if (i >= 5) {
+      expected[group].first++;
+      expected[group].second += i;
+    }
+  }
+  FlushSessionOrDie(session);
+
+  KuduScanner scanner(client_table_.get());
+  Status s = scanner.SetGroupByColumns({ "string_val" });
+  ASSERT_TRUE(s.IsIllegalState()) << s.ToString();
+  ASSERT_OK(scanner.AddAggregate(KuduScanner::AGGREGATE_COUNT, ""));
+  ASSERT_OK(scanner.AddAggregate(KuduScanner::AGGREGATE_SUM, "int_val"));
+  s = scanner.SetGroupByColumns({ "missing" });
+  ASSERT_TRUE(s.IsNotFound()) << s.ToString();
+  ASSERT_OK(scanner.SetGroupByColumns({ "string_val" }));
+  ASSERT_OK(scanner.AddConjunctPredicate(client_table_->NewComparisonPredicate(
+      "key", KuduPredicate::GREATER_EQUAL, KuduValue::FromInt(5))));
+  ASSERT_EQ(2, scanner.GetProjectionSchema().num_columns());
+  ASSERT_EQ("string_val", scanner.GetProjectionSchema().Column(0).name());
+
+  ASSERT_OK(scanner.Open());
+  const KuduPartialRow* result;
+  s = scanner.ComputeAggregates(&result);
+  ASSERT_TRUE(s.IsIllegalState()) << s.ToString();
+  vector<const KuduPartialRow*> groups;
+  ASSERT_OK(scanner.ComputeGroupedAggregates(&groups));
+
+  ASSERT_EQ(std::min<size_t>(kNumGroups, kNumRows - 5), groups.size());
+  for (const KuduPartialRow* group : groups) {
+    Slice name;
+    ASSERT_OK(group->GetString("string_val", &name));
+    SCOPED_TRACE(name.ToString());
+    ASSERT_EQ(1, expected.count(name.ToString()));
+    int64_t count, sum;
+    ASSERT_OK(group->GetInt64("count(*)", &count));
+    ASSERT_EQ(expected[name.ToString()].first, count);
+    ASSERT_OK(group->GetInt64("sum(int_val)", &sum));
+    ASSERT_EQ(expected[name.ToString()].second, sum);
+  }
+}
+
+// Test that scans which only count rows agree with the rows written, whether
+// the deletes are in memory or flushed.
+TEST_F(ClientTest, TestCountOnlyScans) {
+  const int kNumRows = FLAGS_test_scan_num_rows;
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), kNumRows));
+  auto for_each_tablet = [&](const std::function<Status(Tablet*)>& f) {
+    for (int i = 0; i < cluster_->num_tablet_servers(); i++) {
+      vector<scoped_refptr<TabletPeer>> peers;
+      cluster_->mini_tablet_server(i)->server()->tablet_manager()->GetTabletPeers(&peers);
+      for (const auto& peer : peers) {
+        ASSERT_OK(f(peer->tablet()));
+      }
+    }
+  };
+  NO_FATALS(for_each_tablet([](Tablet* t) { return t->Flush(); }));
+  ASSERT_NO_FATAL_FAILURE(DeleteTestRows(client_table_.get(), 0, 5));
+
+  auto count_aggregate = [&](KuduScanner::ReadMode read_mode, int64_t* count) {
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.SetReadMode(read_mode));
+    ASSERT_OK(scanner.AddAggregate(KuduScanner::AGGREGATE_COUNT, ""));
+    ASSERT_OK(scanner.Open());
+    const KuduPartialRow* result;
+    ASSERT_OK(scanner.ComputeAggregates(&result));
+    ASSERT_OK(result->GetInt64("count(*)", count));
+  };
+  for (int flushed = 0; flushed < 2; flushed++) {
+    SCOPED_TRACE(flushed ? "flushed deletes" : "deletes in memory");
+    ASSERT_EQ(kNumRows - 5, CountRowsFromClient(client_table_.get()));
+    int64_t count;
+    NO_FATALS(count_aggregate(KuduScanner::READ_LATEST, &count));
+    ASSERT_EQ(kNumRows - 5, count);
+    NO_FATALS(count_aggregate(KuduScanner::READ_AT_SNAPSHOT, &count));
+    ASSERT_EQ(kNumRows - 5, count);
+    NO_FATALS(for_each_tablet([](Tablet* t) { return t->FlushBiggestDMS(); }));
+  }
+}
+
+TEST_F(ClientTest, TestGetColumnStatistics) {
+  const int kNumRows = FLAGS_test_scan_num_rows;
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), kNumRows));
+
+  // Rows which haven't been flushed yet aren't described.
+  vector<KuduColumnStatistics*> stats;
+  ElementDeleter deleter(&stats);
+  ASSERT_OK(client_table_->GetColumnStatistics(&stats));
+  ASSERT_EQ(client_table_->schema().num_columns(), stats.size());
+  ASSERT_EQ("key", stats[0]->column_name());
+  ASSERT_EQ(0, stats[0]->num_rows());
+  const KuduPartialRow* range;
+  stats[0]->GetRange(&range);
+  ASSERT_TRUE(range->IsNull("min"));
+  ASSERT_TRUE(range->IsNull("max"));
+  STLDeleteElements(&stats);
+
+  // The statistics of every tablet are merged once they are flushed.
+  for (int i = 0; i < cluster_->num_tablet_servers(); i++) {
+    vector<scoped_refptr<TabletPeer>> peers;
+    cluster_->mini_tablet_server(i)->server()->tablet_manager()->GetTabletPeers(&peers);
+    for (const auto& peer : peers) {
+      ASSERT_OK(peer->tablet()->Flush());
+    }
+  }
+  ASSERT_OK(client_table_->GetColumnStatistics(&stats));
+  ASSERT_EQ(client_table_->schema().num_columns(), stats.size());
+  for (const KuduColumnStatistics* s : stats) {
+    SCOPED_TRACE(s->column_name());
+    ASSERT_EQ(kNumRows, s->num_rows());
+    ASSERT_EQ(0, s->null_count());
+    ASSERT_GT(s->total_bytes(), 0);
+    int64_t ndv;
+    ASSERT_OK(s->GetEstimatedDistinctCount(&ndv));
+    ASSERT_NEAR(kNumRows, ndv, std::max(2.0, kNumRows * 0.1));
+  }
+
+  int32_t min_int, max_int;
+  stats[1]->GetRange(&range);
+  ASSERT_EQ("int_val", stats[1]->column_name());
+  ASSERT_OK(range->GetInt32("min", &min_int));
+  ASSERT_OK(range->GetInt32("max", &max_int));
+  ASSERT_EQ(0, min_int);
+  ASSERT_EQ((kNumRows - 1) * 2, max_int);
+
+  string min_string = "hello 0";
+  string max_string = min_string;
+  for (int i = 0; i < kNumRows; i++) {
+    max_string = std::max(max_string, StringPrintf("hello %d", i));
+  }
+  Slice min_slice, max_slice;
+  stats[2]->GetRange(&range);
+  ASSERT_EQ("string_val", stats[2]->column_name());
+  ASSERT_OK(range->GetString("min", &min_slice));
+  ASSERT_OK(range->GetString("max", &max_slice));
+  ASSERT_EQ(min_string, min_slice.ToString());
+  ASSERT_EQ(max_string, max_slice.ToString());
+}
+
+TEST_F(ClientTest, TestLookupRows) {
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), 20));
+
+  // The keys span both tablets, and one of them has no row.
+  vector<unique_ptr<KuduPartialRow>> rows;
+  vector<const KuduPartialRow*> keys;
+  for (int key : { 15, 3, 100, 12 }) {
+    unique_ptr<KuduPartialRow> row(client_table_->schema().NewRow());
+    ASSERT_OK(row->SetInt32("key", key));
+    keys.push_back(row.get());
+    rows.push_back(std::move(row));
+  }
+  vector<KuduScanBatch*> batches;
+  ElementDeleter deleter(&batches);
+  ASSERT_OK(client_table_->LookupRows(keys, { "key", "string_val" }, &batches));
+
+  // One batch per tablet, each in key order.
+  vector<string> results;
+  for (KuduScanBatch* batch : batches) {
+    for (KuduScanBatch::RowPtr row : *batch) {
+      results.push_back(row.ToString());
+    }
+  }
+  ASSERT_EQ(2, batches.size());
+  ASSERT_EQ((vector<string>{ "(int32 key=3, string string_val=hello 3)",
+                             "(int32 key=12, string string_val=hello 12)",
+                             "(int32 key=15, string string_val=hello 15)" }),
+            results);
+
+  // Keys must be fully specified, and the projection must exist.
+  unique_ptr<KuduPartialRow> unset(client_table_->schema().NewRow());
+  Status s = client_table_->LookupRows({ unset.get() }, { "key" }, &batches);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  s = client_table_->LookupRows(keys, { "column-doesnt-exist" }, &batches);
+  ASSERT_TRUE(s.IsNotFound()) << s.ToString();
+}
+
 TEST_F(ClientTest, TestProjectInvalidColumn) {
   KuduScanner scanner(client_table_.get());
   Status s = scanner.SetProjectedColumns({ "column-doesnt-exist" });
@@ -1040,12 +1465,21 @@ static void ReadBatchToStrings(KuduScanner* scanner, vector<string>* rows) {
   }
 }
 
+// Scans 'table', calling 'cb' part way through. If 'fault_tolerant' is false,
+// the scan is an unordered snapshot scan, which relies on resume tokens rather
+// than on its order to recover, and its rows are compared without regard to
+// their order.
 static void DoScanWithCallback(KuduTable* table,
                                const vector<string>& expected_rows,
-                               const boost::function<Status(const string&)>& cb) {
-  // Initialize fault-tolerant snapshot scanner.
+                               const boost::function<Status(const string&)>& cb,
+                               bool fault_tolerant = true) {
+  // Initialize the snapshot scanner.
   KuduScanner scanner(table);
-  ASSERT_OK(scanner.SetFaultTolerant());
+  if (fault_tolerant) {
+    ASSERT_OK(scanner.SetFaultTolerant());
+  } else {
+    ASSERT_OK(scanner.SetReadMode(KuduScanner::READ_AT_SNAPSHOT));
+  }
   // Set a small batch size so it reads in multiple batches.
   ASSERT_OK(scanner.SetBatchSizeBytes(1));
 
@@ -1081,8 +1515,13 @@ static void DoScanWithCallback(KuduTable* table,
 
   // Verify results from the scan.
   LOG(INFO) << "Verifying results from scan.";
+  vector<string> sorted_expected_rows = expected_rows;
+  if (!fault_tolerant) {
+    std::sort(rows.begin(), rows.end());
+    std::sort(sorted_expected_rows.begin(), sorted_expected_rows.end());
+  }
   for (int i = 0; i < rows.size(); i++) {
-    EXPECT_EQ(expected_rows[i], rows[i]);
+    EXPECT_EQ(sorted_expected_rows[i], rows[i]);
   }
   ASSERT_EQ(expected_rows.size(), rows.size());
 }
@@ -1153,6 +1592,29 @@ TEST_F(ClientTest, TestScanFaultTolerance) {
   }
 }
 
+// Test that unordered snapshot scans resume from where they left off when the
+// tablet server serving them restarts, without returning any row twice.
+TEST_F(ClientTest, TestUnorderedScanResume) {
+  const string kScanTable = "TestUnorderedScanResume";
+  shared_ptr<KuduTable> table;
+  ASSERT_NO_FATAL_FAILURE(CreateTable(kScanTable, 1, {}, {}, &table));
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(table.get(), FLAGS_test_scan_num_rows));
+
+  vector<string> expected_rows;
+  ScanTableToStrings(table.get(), &expected_rows);
+
+  for (int with_flush = 0; with_flush <= 1; with_flush++) {
+    SCOPED_TRACE((with_flush == 1) ? "with flush" : "without flush");
+    if (with_flush) {
+      FlushTablet(GetFirstTabletId(table.get()));
+    }
+    // The restart loses the scanner, which the scan resumes from its token.
+    ASSERT_NO_FATAL_FAILURE(internal::DoScanWithCallback(table.get(), expected_rows,
+        boost::bind(&ClientTest_TestUnorderedScanResume_Test::RestartTServerAndWait,
+                    this, _1), false));
+  }
+}
+
 TEST_F(ClientTest, TestNonCoveringRangePartitions) {
   // Create test table and insert test rows.
   const string kTableName = "TestNonCoveringRangePartitions";
@@ -1401,6 +1863,103 @@ TEST_F(ClientTest, TestMetaCacheExpiry) {
   ASSERT_FALSE(entry.stale());
 }
 
+// Test that adding a range partition clears only the altered key range from
+// the meta cache.
+TEST_F(ClientTest, TestAlterPartitioningClearsOnlyAlteredRanges) {
+  const string table_name = "TestAlterPartitioningClearsOnlyAlteredRanges";
+  unique_ptr<KuduPartialRow> lower_bound(schema_.NewRow());
+  ASSERT_OK(lower_bound->SetInt32("key", 0));
+  unique_ptr<KuduPartialRow> upper_bound(schema_.NewRow());
+  ASSERT_OK(upper_bound->SetInt32("key", 100));
+  gscoped_ptr<KuduTableCreator> table_creator(client_->NewTableCreator());
+  table_creator->add_range_partition(lower_bound.release(), upper_bound.release());
+  ASSERT_OK(table_creator->table_name(table_name)
+                          .schema(&schema_)
+                          .num_replicas(1)
+                          .set_range_partition_columns({ "key" })
+                          .Create());
+  shared_ptr<KuduTable> table;
+  ASSERT_OK(client_->OpenTable(table_name, &table));
+
+  // Prime the cache with both tables.
+  auto& meta_cache = client_->data_->meta_cache_;
+  meta_cache->ClearCache();
+  CHECK_NOTNULL(MetaCacheLookup(client_table_.get(), "").get());
+  scoped_refptr<internal::RemoteTablet> rt = MetaCacheLookup(table.get(), "");
+  const string tablet_start = rt->partition().partition_key_start();
+  const string tablet_end = rt->partition().partition_key_end();
+  internal::MetaCacheEntry entry;
+  ASSERT_TRUE(meta_cache->LookupTabletByKeyFastPath(table.get(), tablet_start, &entry));
+  ASSERT_TRUE(meta_cache->LookupTabletByKeyFastPath(table.get(), tablet_end, &entry));
+  ASSERT_TRUE(entry.is_non_covered_range());
+
+  lower_bound.reset(schema_.NewRow());
+  ASSERT_OK(lower_bound->SetInt32("key", 100));
+  upper_bound.reset(schema_.NewRow());
+  ASSERT_OK(upper_bound->SetInt32("key", 200));
+  unique_ptr<KuduTableAlterer> alterer(client_->NewTableAlterer(table_name));
+  alterer->AddRangePartition(lower_bound.release(), upper_bound.release());
+  ASSERT_OK(alterer->Alter());
+
+  // The non-covered range the new partition was added to is gone, while the
+  // existing tablet and the other table are still cached.
+  ASSERT_FALSE(meta_cache->LookupTabletByKeyFastPath(table.get(), tablet_end, &entry));
+  ASSERT_TRUE(meta_cache->LookupTabletByKeyFastPath(table.get(), tablet_start, &entry));
+  ASSERT_EQ(rt->tablet_id(), entry.tablet()->tablet_id());
+  ASSERT_TRUE(meta_cache->LookupTabletByKeyFastPath(client_table_.get(), "", &entry));
+
+  // The new partition can be written to right away.
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(table.get(), 100, 100));
+  ASSERT_EQ(100, CountTableRows(table.get()));
+}
+
+// Test that the locations of a table are fetched from the master in bulk,
+// whether prefetched or looked up by concurrent writes.
+TEST_F(ClientTest, TestBulkTabletLocationLookups) {
+  const int kNumTablets = 30;
+  vector<unique_ptr<KuduPartialRow>> split_rows;
+  for (int i = 1; i < kNumTablets; i++) {
+    unique_ptr<KuduPartialRow> row(schema_.NewRow());
+    ASSERT_OK(row->SetInt32(0, i * 10));
+    split_rows.push_back(std::move(row));
+  }
+  shared_ptr<KuduTable> table;
+  NO_FATALS(CreateTable("many_tablets", 1, std::move(split_rows), {}, &table));
+
+  auto& meta_cache = client_->data_->meta_cache_;
+  scoped_refptr<Histogram> lookups =
+      METRIC_handler_latency_kudu_master_MasterService_GetTableLocations.Instantiate(
+          cluster_->mini_master()->master()->metric_entity());
+
+  // A prefetch takes a single lookup, after which every tablet is cached.
+  meta_cache->ClearCache();
+  int64_t lookups_before = lookups->TotalCount();
+  ASSERT_OK(table->PrefetchTabletLocations());
+  ASSERT_EQ(lookups_before + 1, lookups->TotalCount());
+  for (int i = 0; i < kNumTablets; i++) {
+    unique_ptr<KuduPartialRow> row(schema_.NewRow());
+    ASSERT_OK(row->SetInt32(0, i * 10));
+    string partition_key;
+    ASSERT_OK(table->partition_schema().EncodeKey(*row, &partition_key));
+    internal::MetaCacheEntry entry;
+    ASSERT_TRUE(meta_cache->LookupTabletByKeyFastPath(table.get(), partition_key, &entry));
+  }
+
+  // The lookups of a batch for every tablet, while the cache is empty, wait
+  // for the first of them rather than each going to the master.
+  meta_cache->ClearCache();
+  lookups_before = lookups->TotalCount();
+  shared_ptr<KuduSession> session = client_->NewSession();
+  ASSERT_OK(session->SetFlushMode(KuduSession::MANUAL_FLUSH));
+  for (int i = 0; i < kNumTablets; i++) {
+    gscoped_ptr<KuduInsert> insert(BuildTestRow(table.get(), i * 10));
+    ASSERT_OK(session->Apply(insert.release()));
+  }
+  FlushSessionOrDie(session);
+  ASSERT_EQ(lookups_before + 1, lookups->TotalCount());
+  ASSERT_EQ(kNumTablets, CountRowsFromClient(table.get()));
+}
+
 TEST_F(ClientTest, TestGetTabletServerBlacklist) {
   shared_ptr<KuduTable> table;
   ASSERT_NO_FATAL_FAILURE(CreateTable("blacklist",
@@ -1442,6 +2001,11 @@ TEST_F(ClientTest, TestGetTabletServerBlacklist) {
                                                blacklist, &candidates, &rts);
     ASSERT_TRUE(s.IsServiceUnavailable());
   }
+  // With no learner replicas, learner selection falls back to the others.
+  ASSERT_OK(client_->data_->GetTabletServer(client_.get(), rt,
+                                            KuduClient::LEARNER_REPLICA,
+                                            blacklist, &candidates, &rts));
+  ASSERT_FALSE(ContainsKey(blacklist, rts->permanent_uuid()));
   // Keep blacklisting replicas until we run out.
   ASSERT_OK(client_->data_->GetTabletServer(client_.get(), rt,
                                             KuduClient::CLOSEST_REPLICA,
@@ -1459,6 +2023,8 @@ TEST_F(ClientTest, TestGetTabletServerBlacklist) {
   selections.push_back(KuduClient::LEADER_ONLY);
   selections.push_back(KuduClient::CLOSEST_REPLICA);
   selections.push_back(KuduClient::FIRST_REPLICA);
+  selections.push_back(KuduClient::LEAST_LOADED_REPLICA);
+  selections.push_back(KuduClient::LEARNER_REPLICA);
   for (KuduClient::ReplicaSelection selection : selections) {
     Status s = client_->data_->GetTabletServer(client_.get(), rt, selection,
                                                blacklist, &candidates, &rts);
@@ -1478,6 +2044,53 @@ TEST_F(ClientTest, TestGetTabletServerBlacklist) {
   }
 }
 
+TEST_F(ClientTest, TestLeastLoadedReplicaSelection) {
+  shared_ptr<KuduTable> table;
+  ASSERT_NO_FATAL_FAILURE(CreateTable("least-loaded", 3, {}, {}, &table));
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(table.get(), 100));
+
+  scoped_refptr<internal::RemoteTablet> rt;
+  vector<internal::RemoteTabletServer*> tservers;
+  while (true) {
+    rt = MetaCacheLookup(table.get(), "");
+    ASSERT_TRUE(rt.get() != nullptr);
+    rt->GetRemoteTabletServers(&tservers);
+    if (tservers.size() == 3) {
+      break;
+    }
+    rt->MarkStale();
+    SleepFor(MonoDelta::FromMilliseconds(10));
+  }
+
+  // Make one server look slow and another busy. Since each selection
+  // compares two distinct replicas, the worst one is never picked.
+  internal::RemoteTabletServer* slow = tservers[0];
+  internal::RemoteTabletServer* busy = tservers[1];
+  for (internal::RemoteTabletServer* ts : tservers) {
+    ts->RpcStarted();
+    ts->RpcFinished(MonoDelta::FromMilliseconds(ts == slow ? 1000 : 1));
+  }
+  for (int i = 0; i < 10; i++) {
+    busy->RpcStarted();
+  }
+  set<string> blacklist;
+  vector<internal::RemoteTabletServer*> candidates;
+  for (int i = 0; i < 100; i++) {
+    internal::RemoteTabletServer* ts;
+    ASSERT_OK(client_->data_->GetTabletServer(client_.get(), rt,
+                                              KuduClient::LEAST_LOADED_REPLICA,
+                                              blacklist, &candidates, &ts));
+    ASSERT_NE(slow, ts);
+  }
+  for (int i = 0; i < 10; i++) {
+    busy->RpcFinished(MonoDelta::FromMilliseconds(1));
+  }
+
+  // Scans with the policy see all the rows.
+  ASSERT_EQ(100, CountRowsFromClient(table.get(), KuduClient::LEAST_LOADED_REPLICA,
+                                     kNoBound, kNoBound));
+}
+
 TEST_F(ClientTest, TestScanWithEncodedRangePredicate) {
   shared_ptr<KuduTable> table;
   ASSERT_NO_FATAL_FAILURE(CreateTable("split-table",
@@ -1670,6 +2283,93 @@ TEST_F(ClientTest, TestScannerKeepAlive) {
   ASSERT_EQ(sum, 499500);
 }
 
+// Test scans which prefetch batches in the background, both with a budget
+// small enough to pause the prefetching and with one that isn't.
+TEST_F(ClientTest, TestScanWithPrefetching) {
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), 1000));
+
+  for (uint32_t budget_bytes : { 1, 1024 * 1024 }) {
+    SCOPED_TRACE(budget_bytes);
+    KuduScanner scanner(client_table_.get());
+    // Many small batches from each tablet, so that several are prefetched.
+    ASSERT_OK(scanner.SetBatchSizeBytes(100));
+    ASSERT_OK(scanner.SetPrefetchBudgetBytes(budget_bytes));
+    ASSERT_OK(scanner.Open());
+
+    KuduScanBatch batch;
+    int64_t sum = 0;
+    int num_rows = 0;
+    while (scanner.HasMoreRows()) {
+      ASSERT_OK(scanner.NextBatch(&batch));
+      sum += SumResults(batch);
+      num_rows += batch.NumRows();
+    }
+    ASSERT_EQ(1000, num_rows);
+    ASSERT_EQ(499500, sum);
+  }
+
+  // Closing the scanner while a prefetch may be in flight must be safe.
+  KuduScanner scanner(client_table_.get());
+  ASSERT_OK(scanner.SetBatchSizeBytes(100));
+  ASSERT_OK(scanner.SetPrefetchBudgetBytes(1024 * 1024));
+  ASSERT_OK(scanner.Open());
+  KuduScanBatch batch;
+  while (scanner.HasMoreRows()) {
+    ASSERT_OK(scanner.NextBatch(&batch));
+    if (batch.NumRows() > 0) break;
+  }
+  scanner.Close();
+}
+
+TEST_F(ClientTest, TestParallelScan) {
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), 1000));
+
+  for (bool ordered : { false, true }) {
+    SCOPED_TRACE(ordered);
+    KuduScanTokenBuilder builder(client_table_.get());
+    ASSERT_OK(builder.SetBatchSizeBytes(100));
+    KuduParallelScanner scanner(&builder);
+    ASSERT_OK(scanner.SetParallelism(2));
+    // A single buffered batch makes the tablets' scans wait on each other.
+    ASSERT_OK(scanner.SetMaxBufferedBatches(1));
+    if (ordered) {
+      ASSERT_OK(scanner.SetOrdered());
+    }
+    ASSERT_OK(scanner.Open());
+
+    KuduScanBatch batch;
+    int64_t sum = 0;
+    int num_rows = 0;
+    bool saw_second_tablet = false;
+    while (scanner.HasMoreRows()) {
+      ASSERT_OK(scanner.NextBatch(&batch));
+      for (const KuduScanBatch::RowPtr& row : batch) {
+        int32_t key;
+        ASSERT_OK(row.GetInt32(0, &key));
+        // The table is split at key 9.
+        if (ordered && saw_second_tablet) {
+          ASSERT_GE(key, 9);
+        }
+        saw_second_tablet |= key >= 9;
+        sum += key;
+        num_rows++;
+      }
+    }
+    ASSERT_EQ(1000, num_rows);
+    ASSERT_EQ(499500, sum);
+  }
+
+  // Closing the scanner with scans in progress must stop them.
+  KuduScanTokenBuilder builder(client_table_.get());
+  ASSERT_OK(builder.SetBatchSizeBytes(100));
+  KuduParallelScanner scanner(&builder);
+  ASSERT_OK(scanner.SetMaxBufferedBatches(1));
+  ASSERT_OK(scanner.Open());
+  KuduScanBatch batch;
+  ASSERT_OK(scanner.NextBatch(&batch));
+  scanner.Close();
+}
+
 // Test cleanup of scanners on the server side when closed.
 TEST_F(ClientTest, TestCloseScanner) {
   ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), 10));
@@ -2021,6 +2721,45 @@ TEST_F(ClientTest, TestMultipleMultiRowManualBatches) {
             , rows[0]);
 }
 
+// Test that with multi-tablet writes enabled, a batch for both tablets of
+// the test table (whose leaders are on the same server) is sent in a single
+// RPC, and the per-tablet errors are still reported.
+TEST_F(ClientTest, TestMultiTabletWrites) {
+  // Populate the meta cache, so the leaders are known when flushing.
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), 1));
+
+  auto ent = cluster_->mini_tablet_server(0)->server()->metric_entity();
+  scoped_refptr<Histogram> multi_writes =
+      METRIC_handler_latency_kudu_tserver_TabletServerService_MultiWrite.Instantiate(ent);
+  scoped_refptr<Histogram> writes =
+      METRIC_handler_latency_kudu_tserver_TabletServerService_Write.Instantiate(ent);
+  int64_t writes_before = writes->TotalCount();
+
+  shared_ptr<KuduSession> session = client_->NewSession();
+  ASSERT_OK(session->SetFlushMode(KuduSession::MANUAL_FLUSH));
+  session->SetMultiTabletWrites(true);
+  session->SetTimeoutMillis(60000);
+  // The table is split at key 9, so these rows are for both tablets. Row 0
+  // was already inserted.
+  const int kNumRows = 1000;
+  for (int i = 0; i < kNumRows; i++) {
+    ASSERT_OK(ApplyInsertToSession(session.get(), client_table_, i, i * 2, "hello"));
+  }
+  Status s = session->Flush();
+  ASSERT_TRUE(s.IsIOError()) << s.ToString();
+  vector<KuduError*> errors;
+  ElementDeleter d(&errors);
+  bool overflow;
+  session->GetPendingErrors(&errors, &overflow);
+  ASSERT_FALSE(overflow);
+  ASSERT_EQ(1, errors.size());
+  ASSERT_TRUE(errors[0]->status().IsAlreadyPresent()) << errors[0]->status().ToString();
+
+  ASSERT_EQ(1, multi_writes->TotalCount());
+  ASSERT_EQ(writes_before, writes->TotalCount());
+  ASSERT_EQ(kNumRows, CountRowsFromClient(client_table_.get()));
+}
+
 // Test a batch where one of the inserted rows succeeds while another
 // fails.
 TEST_F(ClientTest, TestBatchWithPartialError) {
@@ -2702,6 +3441,45 @@ TEST_F(ClientTest, TestAutoFlushBackgroundApplyBlocks) {
   EXPECT_LT(wait_timeout_ms / 2, sw.elapsed().wall_millis());
 }
 
+// Test that TryApply() returns instead of blocking when the buffer is full,
+// and keeps the operation for a later retry.
+TEST_F(ClientTest, TestAutoFlushBackgroundTryApply) {
+  const size_t kBufferSizeBytes = 8 * 1024;
+  const size_t kStringLenBytes = 2 * kBufferSizeBytes / 3;
+
+  shared_ptr<KuduSession> session(client_->NewSession());
+  ASSERT_OK(session->SetMutationBufferSpace(kBufferSizeBytes));
+  ASSERT_OK(session->SetMutationBufferFlushWatermark(1.0));
+  session->data_->buffer_pre_flush_enabled_ = false;
+  ASSERT_OK(session->SetMutationBufferFlushInterval(60 * 1000));
+  ASSERT_OK(session->SetFlushMode(KuduSession::AUTO_FLUSH_BACKGROUND));
+
+  vector<unique_ptr<KuduInsert>> inserts;
+  for (int i = 0; i < 2; i++) {
+    unique_ptr<KuduInsert> insert(client_table_->NewInsert());
+    ASSERT_OK(insert->mutable_row()->SetInt32("key", i));
+    ASSERT_OK(insert->mutable_row()->SetInt32("int_val", i));
+    ASSERT_OK(insert->mutable_row()->SetStringCopy("string_val", string(kStringLenBytes, 'x')));
+    inserts.emplace_back(std::move(insert));
+  }
+  ASSERT_OK(session->TryApply(inserts[0].get()));
+  inserts[0].release();
+  ASSERT_GT(session->GetMutationBufferSpaceUsed(), static_cast<int64_t>(kStringLenBytes));
+
+  // The second operation doesn't fit until the first one is flushed.
+  Status s = session->TryApply(inserts[1].get());
+  ASSERT_TRUE(s.IsServiceUnavailable()) << s.ToString();
+  ASSERT_EQ(0, session->CountPendingErrors());
+  ASSERT_OK(session->Flush());
+  ASSERT_EQ(0, session->GetMutationBufferSpaceUsed());
+
+  ASSERT_OK(session->TryApply(inserts[1].get()));
+  inserts[1].release();
+  ASSERT_OK(session->Flush());
+  ASSERT_EQ(0, session->CountPendingErrors());
+  EXPECT_EQ(2, CountRowsFromClient(client_table_.get()));
+}
+
 // Test that update updates and delete deletes with expected use
 TEST_F(ClientTest, TestMutationsWork) {
   shared_ptr<KuduSession> session = client_->NewSession();
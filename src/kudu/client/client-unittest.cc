@@ -129,6 +129,104 @@ TEST(ClientUnitTest, TestSchemaBuilder_DefaultValueString) {
   ASSERT_EQ("OK", b.Build(&s).ToString());
 }
 
+TEST(ClientUnitTest, TestSchemaBuilder_Decimal) {
+  {
+    KuduSchema s;
+    KuduSchemaBuilder b;
+    b.AddColumn("a")->Type(KuduColumnSchema::DECIMAL)->Precision(9)->Scale(2)
+      ->NotNull()->PrimaryKey();
+    b.AddColumn("b")->Type(KuduColumnSchema::DECIMAL)->Precision(18)
+      ->Default(KuduValue::FromInt(-123));
+    ASSERT_EQ("OK", b.Build(&s).ToString());
+    ASSERT_EQ(KuduColumnSchema::DECIMAL, s.Column(0).type());
+    ASSERT_EQ(9, s.Column(0).precision());
+    ASSERT_EQ(2, s.Column(0).scale());
+    ASSERT_EQ(18, s.Column(1).precision());
+    ASSERT_EQ(0, s.Column(1).scale());
+    ASSERT_FALSE(s.Column(0).Equals(s.Column(1)));
+  }
+  {
+    KuduSchema s;
+    KuduSchemaBuilder b;
+    b.AddColumn("a")->Type(KuduColumnSchema::DECIMAL)->NotNull()->PrimaryKey();
+    ASSERT_EQ("Invalid argument: no precision provided for decimal column: a",
+              b.Build(&s).ToString());
+  }
+  {
+    KuduSchema s;
+    KuduSchemaBuilder b;
+    b.AddColumn("a")->Type(KuduColumnSchema::DECIMAL)->Precision(19)->NotNull()->PrimaryKey();
+    ASSERT_EQ("Invalid argument: precision must be between 1 and 18: a",
+              b.Build(&s).ToString());
+  }
+  {
+    KuduSchema s;
+    KuduSchemaBuilder b;
+    b.AddColumn("a")->Type(KuduColumnSchema::DECIMAL)->Precision(4)->Scale(5)
+      ->NotNull()->PrimaryKey();
+    ASSERT_FALSE(b.Build(&s).ok());
+  }
+  {
+    KuduSchema s;
+    KuduSchemaBuilder b;
+    b.AddColumn("a")->Type(KuduColumnSchema::DECIMAL)->Precision(4)->NotNull()->PrimaryKey()
+      ->Default(KuduValue::FromInt(10000));
+    ASSERT_FALSE(b.Build(&s).ok());
+  }
+  {
+    KuduSchema s;
+    KuduSchemaBuilder b;
+    b.AddColumn("a")->Type(KuduColumnSchema::INT32)->Precision(4)->NotNull()->PrimaryKey();
+    ASSERT_EQ("Invalid argument: precision and scale are only valid for decimal columns: a",
+              b.Build(&s).ToString());
+  }
+}
+
+TEST(ClientUnitTest, TestSchemaBuilder_CompressionLevel) {
+  {
+    KuduSchema s;
+    KuduSchemaBuilder b;
+    b.AddColumn("a")->Type(KuduColumnSchema::INT32)->NotNull()->PrimaryKey();
+    b.AddColumn("b")->Type(KuduColumnSchema::STRING)
+      ->Compression(KuduColumnStorageAttributes::ZSTD)->CompressionLevel(19);
+    ASSERT_EQ("OK", b.Build(&s).ToString());
+  }
+  {
+    KuduSchema s;
+    KuduSchemaBuilder b;
+    b.AddColumn("a")->Type(KuduColumnSchema::INT32)->NotNull()->PrimaryKey();
+    b.AddColumn("b")->Type(KuduColumnSchema::STRING)
+      ->Compression(KuduColumnStorageAttributes::ZSTD)->CompressionLevel(99);
+    ASSERT_EQ("Invalid argument: bad compression level 99 (expected 0 to 22): b",
+              b.Build(&s).ToString());
+  }
+  {
+    KuduSchema s;
+    KuduSchemaBuilder b;
+    b.AddColumn("a")->Type(KuduColumnSchema::INT32)->NotNull()->PrimaryKey();
+    b.AddColumn("b")->Type(KuduColumnSchema::STRING)->CompressionLevel(-1);
+    ASSERT_FALSE(b.Build(&s).ok());
+  }
+}
+
+TEST(ClientUnitTest, TestSchemaBuilder_BloomFilter) {
+  {
+    KuduSchema s;
+    KuduSchemaBuilder b;
+    b.AddColumn("a")->Type(KuduColumnSchema::INT32)->NotNull()->PrimaryKey();
+    b.AddColumn("b")->Type(KuduColumnSchema::STRING)->BloomFilter();
+    ASSERT_EQ("OK", b.Build(&s).ToString());
+  }
+  {
+    KuduSchema s;
+    KuduSchemaBuilder b;
+    b.AddColumn("a")->Type(KuduColumnSchema::INT32)->NotNull()->PrimaryKey();
+    b.AddColumn("b")->Type(KuduColumnSchema::DOUBLE)->BloomFilter();
+    ASSERT_EQ("Invalid argument: bloom filters are not supported for floating point columns: b",
+              b.Build(&s).ToString());
+  }
+}
+
 TEST(ClientUnitTest, TestSchemaBuilder_CompoundKey_KeyNotFirst) {
   KuduSchema s;
   KuduSchemaBuilder b;
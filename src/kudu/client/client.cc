@@ -18,6 +18,7 @@
 #include "kudu/client/client.h"
 
 #include <algorithm>
+#include <map>
 #include <memory>
 #include <set>
 #include <string>
@@ -31,9 +32,11 @@
 #include "kudu/client/callbacks.h"
 #include "kudu/client/client-internal.h"
 #include "kudu/client/client_builder-internal.h"
+#include "kudu/client/column_statistics-internal.h"
 #include "kudu/client/error-internal.h"
 #include "kudu/client/error_collector.h"
 #include "kudu/client/meta_cache.h"
+#include "kudu/client/parallel_scanner-internal.h"
 #include "kudu/client/replica-internal.h"
 #include "kudu/client/row_result.h"
 #include "kudu/client/scan_predicate-internal.h"
@@ -47,16 +50,19 @@
 #include "kudu/client/tablet-internal.h"
 #include "kudu/client/tablet_server-internal.h"
 #include "kudu/client/write_op.h"
+#include "kudu/common/column_statistics.h"
 #include "kudu/common/common.pb.h"
 #include "kudu/common/partition.h"
 #include "kudu/common/row_operations.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/gutil/map-util.h"
+#include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/master/master.pb.h"
 #include "kudu/master/master.proxy.h"
 #include "kudu/rpc/messenger.h"
 #include "kudu/rpc/request_tracker.h"
+#include "kudu/util/async_util.h"
 #include "kudu/util/init.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/net/dns_resolver.h"
@@ -85,7 +91,10 @@ using kudu::master::TSInfoPB;
 using kudu::rpc::Messenger;
 using kudu::rpc::MessengerBuilder;
 using kudu::rpc::RpcController;
+using kudu::tserver::MultiGetRequestPB;
+using kudu::tserver::MultiGetResponsePB;
 using kudu::tserver::ScanResponsePB;
+using std::map;
 using std::pair;
 using std::set;
 using std::string;
@@ -103,11 +112,11 @@ MAKE_ENUM_LIMITS(kudu::client::KuduSession::ExternalConsistencyMode,
 
 MAKE_ENUM_LIMITS(kudu::client::KuduScanner::ReadMode,
                  kudu::client::KuduScanner::READ_LATEST,
-                 kudu::client::KuduScanner::READ_AT_SNAPSHOT);
+                 kudu::client::KuduScanner::READ_BOUNDED_STALENESS);
 
 MAKE_ENUM_LIMITS(kudu::client::KuduScanner::OrderMode,
                  kudu::client::KuduScanner::UNORDERED,
-                 kudu::client::KuduScanner::ORDERED);
+                 kudu::client::KuduScanner::REVERSE_ORDERED);
 
 namespace kudu {
 namespace client {
@@ -556,6 +565,30 @@ KuduTableCreator& KuduTableCreator::num_replicas(int num_replicas) {
   return *this;
 }
 
+KuduTableCreator& KuduTableCreator::time_windowed_compaction(int64_t window_width,
+                                                             int64_t frozen_window_age) {
+  data_->compaction_policy_.set_type(CompactionPolicyPB::TIME_WINDOWED);
+  data_->compaction_policy_.set_window_width(window_width);
+  data_->compaction_policy_.set_frozen_window_age(frozen_window_age);
+  return *this;
+}
+
+KuduTableCreator& KuduTableCreator::row_ttl(const MonoDelta& ttl) {
+  data_->compaction_policy_.set_row_ttl_usec(ttl.ToMicroseconds());
+  return *this;
+}
+
+KuduTableCreator& KuduTableCreator::range_partition_interval(const MonoDelta& interval,
+                                                             int num_ahead,
+                                                             const MonoDelta& retention) {
+  data_->range_partition_interval_.set_interval_usec(interval.ToMicroseconds());
+  data_->range_partition_interval_.set_num_ahead(num_ahead);
+  if (retention.Initialized()) {
+    data_->range_partition_interval_.set_retention_usec(retention.ToMicroseconds());
+  }
+  return *this;
+}
+
 KuduTableCreator& KuduTableCreator::timeout(const MonoDelta& timeout) {
   data_->timeout_ = timeout;
   return *this;
@@ -618,6 +651,13 @@ Status KuduTableCreator::Create() {
   }
 
   req.mutable_partition_schema()->CopyFrom(data_->partition_schema_);
+  if (data_->compaction_policy_.ByteSize() > 0) {
+    req.mutable_compaction_policy()->CopyFrom(data_->compaction_policy_);
+  }
+  bool has_range_partition_interval = data_->range_partition_interval_.has_interval_usec();
+  if (has_range_partition_interval) {
+    req.mutable_range_partition_interval()->CopyFrom(data_->range_partition_interval_);
+  }
 
   MonoTime deadline = MonoTime::Now();
   if (data_->timeout_.Initialized()) {
@@ -630,7 +670,8 @@ Status KuduTableCreator::Create() {
                                                            req,
                                                            *data_->schema_,
                                                            deadline,
-                                                           !data_->range_partition_bounds_.empty()),
+                                                           !data_->range_partition_bounds_.empty() ||
+                                                           has_range_partition_interval),
                         Substitute("Error creating table $0 on the master",
                                    data_->table_name_));
 
@@ -694,6 +735,10 @@ KuduDelete* KuduTable::NewDelete() {
   return new KuduDelete(shared_from_this());
 }
 
+KuduIncrement* KuduTable::NewIncrement() {
+  return new KuduIncrement(shared_from_this());
+}
+
 KuduClient* KuduTable::client() const {
   return data_->client_.get();
 }
@@ -702,6 +747,106 @@ const PartitionSchema& KuduTable::partition_schema() const {
   return data_->partition_schema_;
 }
 
+Status KuduTable::PrefetchTabletLocations() {
+  MonoTime deadline = MonoTime::Now() + client()->default_admin_operation_timeout();
+  return client()->data_->meta_cache_->PrefetchTableLocations(this, deadline);
+}
+
+Status KuduTable::LookupRows(const vector<const KuduPartialRow*>& keys,
+                             const vector<string>& projected_column_names,
+                             vector<KuduScanBatch*>* batches) {
+  const Schema& schema = *data_->schema_.schema_;
+  MonoTime deadline = MonoTime::Now() + client()->default_admin_operation_timeout();
+
+  vector<ColumnSchema> cols;
+  for (const string& name : projected_column_names) {
+    int idx = schema.find_column(name);
+    if (idx == Schema::kColumnNotFound) {
+      return Status::NotFound("column not found", name);
+    }
+    cols.push_back(schema.column(idx));
+  }
+  // Shared by the returned batches, which may outlive this table.
+  std::shared_ptr<Schema> projection(new Schema);
+  RETURN_NOT_OK(projection->Reset(cols, 0));
+  std::shared_ptr<const KuduSchema> client_projection(new KuduSchema(*projection));
+
+  // Group the keys by tablet, in partition key order.
+  struct TabletRequest {
+    scoped_refptr<internal::RemoteTablet> tablet;
+    MultiGetRequestPB req;
+  };
+  std::map<string, TabletRequest> requests;
+  for (const KuduPartialRow* key : keys) {
+    if (!key->IsKeySet()) {
+      return Status::InvalidArgument("key columns not set", key->ToString());
+    }
+    string partition_key;
+    RETURN_NOT_OK(data_->partition_schema_.EncodeKey(*key, &partition_key));
+    scoped_refptr<internal::RemoteTablet> tablet;
+    Synchronizer sync;
+    client()->data_->meta_cache_->LookupTabletByKey(this, partition_key, deadline,
+                                                    &tablet, sync.AsStatusCallback());
+    RETURN_NOT_OK(sync.Wait());
+    TabletRequest* r = &requests[tablet->partition().partition_key_start()];
+    if (!r->tablet) {
+      r->tablet = tablet;
+      r->req.set_tablet_id(tablet->tablet_id());
+    }
+    RETURN_NOT_OK(key->EncodeRowKey(r->req.add_encoded_keys()));
+  }
+
+  vector<KuduScanBatch*> ret;
+  ElementDeleter deleter(&ret);
+  for (auto& e : requests) {
+    MultiGetRequestPB* req = &e.second.req;
+    RETURN_NOT_OK(SchemaToColumnPBs(*projection, req->mutable_projected_columns(),
+                                    SCHEMA_PB_WITHOUT_STORAGE_ATTRIBUTES | SCHEMA_PB_WITHOUT_IDS));
+    MultiGetResponsePB resp;
+    RpcController rpc;
+    RETURN_NOT_OK(data_->MultiGet(e.second.tablet, *req, deadline, &resp, &rpc));
+    if (resp.key_indexes_size() == 0) {
+      continue;
+    }
+
+    // The rows are laid out as in a scan response.
+    ScanResponsePB scan_resp;
+    scan_resp.mutable_data()->Swap(resp.mutable_data());
+    unique_ptr<KuduScanBatch> batch(new KuduScanBatch);
+    batch->data_->owned_projection_ = projection;
+    batch->data_->owned_client_projection_ = client_projection;
+    RETURN_NOT_OK(batch->data_->Reset(&rpc, projection.get(), client_projection.get(),
+                                      &scan_resp));
+    ret.push_back(batch.release());
+  }
+  batches->clear();
+  batches->swap(ret);
+  return Status::OK();
+}
+
+Status KuduTable::GetColumnStatistics(vector<KuduColumnStatistics*>* stats) {
+  const Schema& schema = *data_->schema_.schema_;
+  MonoTime deadline = MonoTime::Now() + client()->default_admin_operation_timeout();
+  std::map<string, ColumnStatisticsPB> merged;
+  RETURN_NOT_OK(data_->GetColumnStatistics(this, schema, deadline, &merged));
+
+  vector<KuduColumnStatistics*> ret;
+  ElementDeleter deleter(&ret);
+  for (int i = 0; i < schema.num_columns(); i++) {
+    const ColumnSchema& col = schema.column(i);
+    ColumnStatisticsPB* col_stats = FindOrNull(merged, col.name());
+    if (col_stats) {
+      unique_ptr<KuduColumnStatistics> s(new KuduColumnStatistics);
+      s->data_ = new KuduColumnStatistics::Data(col, std::move(*col_stats));
+      RETURN_NOT_OK(s->data_->Init());
+      ret.push_back(s.release());
+    }
+  }
+  stats->clear();
+  stats->swap(ret);
+  return Status::OK();
+}
+
 KuduPredicate* KuduTable::NewComparisonPredicate(const Slice& col_name,
                                                  KuduPredicate::ComparisonOp op,
                                                  KuduValue* value) {
@@ -721,6 +866,50 @@ KuduPredicate* KuduTable::NewComparisonPredicate(const Slice& col_name,
   return new KuduPredicate(new ComparisonPredicateData(s->column(col_idx), op, value));
 }
 
+KuduPredicate* KuduTable::NewInListPredicate(const Slice& col_name,
+                                             vector<KuduValue*>* values) {
+  StringPiece name_sp(reinterpret_cast<const char*>(col_name.data()), col_name.size());
+  const Schema* s = data_->schema_.schema_;
+  int col_idx = s->find_column(name_sp);
+  if (col_idx == Schema::kColumnNotFound) {
+    // As with comparison predicates, return a special predicate which returns
+    // the error when it is added to the scanner.
+    STLDeleteElements(values); // we always take ownership of 'values'.
+    return new KuduPredicate(new ErrorPredicateData(
+                                 Status::NotFound("column not found", col_name)));
+  }
+
+  return new KuduPredicate(new InListPredicateData(s->column(col_idx), values));
+}
+
+KuduPredicate* KuduTable::NewInBloomFilterPredicate(const Slice& col_name,
+                                                    vector<KuduValue*>* values,
+                                                    double false_positive_rate) {
+  StringPiece name_sp(reinterpret_cast<const char*>(col_name.data()), col_name.size());
+  const Schema* s = data_->schema_.schema_;
+  int col_idx = s->find_column(name_sp);
+  if (col_idx == Schema::kColumnNotFound) {
+    STLDeleteElements(values); // we always take ownership of 'values'.
+    return new KuduPredicate(new ErrorPredicateData(
+                                 Status::NotFound("column not found", col_name)));
+  }
+
+  return new KuduPredicate(new InBloomFilterPredicateData(s->column(col_idx), values,
+                                                          false_positive_rate));
+}
+
+KuduPredicate* KuduTable::NewIsNullPredicate(const Slice& col_name) {
+  StringPiece name_sp(reinterpret_cast<const char*>(col_name.data()), col_name.size());
+  const Schema* s = data_->schema_.schema_;
+  int col_idx = s->find_column(name_sp);
+  if (col_idx == Schema::kColumnNotFound) {
+    return new KuduPredicate(new ErrorPredicateData(
+                                 Status::NotFound("column not found", col_name)));
+  }
+
+  return new KuduPredicate(new IsNullPredicateData(s->column(col_idx)));
+}
+
 ////////////////////////////////////////////////////////////
 // Error
 ////////////////////////////////////////////////////////////
@@ -807,6 +996,10 @@ void KuduSession::SetTimeoutMillis(int timeout_ms) {
   data_->SetTimeoutMillis(timeout_ms);
 }
 
+void KuduSession::SetMultiTabletWrites(bool enabled) {
+  data_->SetMultiTabletWrites(enabled);
+}
+
 Status KuduSession::Flush() {
   return data_->Flush();
 }
@@ -820,7 +1013,7 @@ bool KuduSession::HasPendingOperations() const {
 }
 
 Status KuduSession::Apply(KuduWriteOperation* write_op) {
-  RETURN_NOT_OK(data_->ApplyWriteOp(shared_from_this(), write_op));
+  RETURN_NOT_OK(data_->ApplyWriteOp(shared_from_this(), write_op, true));
   // Thread-safety note: this method should not be called concurrently
   // with other methods which modify the KuduSession::Data members, so it
   // should be safe to read KuduSession::Data members without protection.
@@ -830,6 +1023,18 @@ Status KuduSession::Apply(KuduWriteOperation* write_op) {
   return Status::OK();
 }
 
+Status KuduSession::TryApply(KuduWriteOperation* write_op) {
+  RETURN_NOT_OK(data_->ApplyWriteOp(shared_from_this(), write_op, false));
+  if (data_->flush_mode_ == AUTO_FLUSH_SYNC) {
+    RETURN_NOT_OK(data_->Flush());
+  }
+  return Status::OK();
+}
+
+int64_t KuduSession::GetMutationBufferSpaceUsed() const {
+  return data_->GetPendingOperationsSize();
+}
+
 int KuduSession::CountBufferedOperations() const {
   return data_->CountBufferedOperations();
 }
@@ -846,6 +1051,42 @@ KuduClient* KuduSession::client() const {
   return data_->client_.get();
 }
 
+////////////////////////////////////////////////////////////
+// KuduColumnStatistics
+////////////////////////////////////////////////////////////
+
+KuduColumnStatistics::KuduColumnStatistics()
+  : data_(nullptr) {
+}
+
+KuduColumnStatistics::~KuduColumnStatistics() {
+  delete data_;
+}
+
+const string& KuduColumnStatistics::column_name() const {
+  return data_->column_name_;
+}
+
+int64_t KuduColumnStatistics::num_rows() const {
+  return data_->stats_.num_rows();
+}
+
+int64_t KuduColumnStatistics::null_count() const {
+  return data_->stats_.null_count();
+}
+
+int64_t KuduColumnStatistics::total_bytes() const {
+  return data_->stats_.total_bytes();
+}
+
+Status KuduColumnStatistics::GetEstimatedDistinctCount(int64_t* count) const {
+  return EstimateDistinctValues(data_->stats_, count);
+}
+
+void KuduColumnStatistics::GetRange(const KuduPartialRow** range) const {
+  *range = data_->range_.get();
+}
+
 ////////////////////////////////////////////////////////////
 // KuduTableAlterer
 ////////////////////////////////////////////////////////////
@@ -958,18 +1199,19 @@ Status KuduTableAlterer::Alter() {
     data_->timeout_ :
     data_->client_->default_admin_operation_timeout();
   MonoTime deadline = MonoTime::Now() + timeout;
+  master::AlterTableResponsePB resp;
   RETURN_NOT_OK(data_->client_->data_->AlterTable(data_->client_, req, deadline,
-                                                  data_->has_alter_partitioning_steps));
+                                                  data_->has_alter_partitioning_steps,
+                                                  &resp));
 
   if (data_->has_alter_partitioning_steps) {
-    // If the table partitions change, clear the local meta cache so that the
-    // new tablets can immediately be written to and scanned, and the old
-    // tablets won't be seen again. This also prevents rows being batched for
-    // the wrong tablet when a partition is dropped and added in the same alter
-    // table transaction. We could clear the meta cache for just the table being
-    // altered or just the partition key ranges being changed, but that would
-    // require opening the table in order to get the ID, schema, and partition
-    // schema.
+    // If the table partitions change, clear the key ranges of the added and
+    // dropped tablets from the local meta cache so that the new tablets can
+    // immediately be written to and scanned, and the old tablets won't be seen
+    // again. This also prevents rows being batched for the wrong tablet when a
+    // partition is dropped and added in the same alter table transaction.
+    // Masters which don't return the altered partitions get the whole meta
+    // cache cleared.
     //
     // It is not necessary to wait for the alteration to be completed before
     // clearing the cache (i.e. the tablets to be created), because the master
@@ -978,7 +1220,15 @@ Status KuduTableAlterer::Alter() {
     // write or scan, the master will return a ServiceUnavailable response if
     // the new tablets are not yet running. The meta cache will automatically
     // retry after a delay when it encounters this error.
-    data_->client_->data_->meta_cache_->ClearCache();
+    MetaCache* meta_cache = data_->client_->data_->meta_cache_.get();
+    if (resp.has_table_id() && resp.altered_partitions_size() > 0) {
+      for (const PartitionPB& partition : resp.altered_partitions()) {
+        meta_cache->ClearRange(resp.table_id(), partition.partition_key_start(),
+                               partition.partition_key_end());
+      }
+    } else {
+      meta_cache->ClearCache();
+    }
   }
 
   if (data_->wait_) {
@@ -994,6 +1244,10 @@ Status KuduTableAlterer::Alter() {
 // KuduScanner
 ////////////////////////////////////////////////////////////
 
+const uint64_t KuduScanner::NO_FLAGS;
+const uint64_t KuduScanner::COLUMNAR_LAYOUT;
+const uint64_t KuduScanner::COLUMNAR_DICTIONARY;
+
 KuduScanner::KuduScanner(KuduTable* table)
   : data_(new KuduScanner::Data(table)) {
 }
@@ -1025,6 +1279,13 @@ Status KuduScanner::SetBatchSizeBytes(uint32_t batch_size) {
   return data_->mutable_configuration()->SetBatchSizeBytes(batch_size);
 }
 
+Status KuduScanner::SetPrefetchBudgetBytes(uint32_t budget_bytes) {
+  if (data_->open_) {
+    return Status::IllegalState("Prefetching must be set before Open()");
+  }
+  return data_->mutable_configuration()->SetPrefetchBudgetBytes(budget_bytes);
+}
+
 Status KuduScanner::SetReadMode(ReadMode read_mode) {
   if (data_->open_) {
     return Status::IllegalState("Read mode must be set before Open()");
@@ -1035,6 +1296,13 @@ Status KuduScanner::SetReadMode(ReadMode read_mode) {
   return data_->mutable_configuration()->SetReadMode(read_mode);
 }
 
+Status KuduScanner::SetMaxStalenessMillis(int millis) {
+  if (data_->open_) {
+    return Status::IllegalState("Maximum staleness must be set before Open()");
+  }
+  return data_->mutable_configuration()->SetMaxStalenessMillis(millis);
+}
+
 Status KuduScanner::SetOrderMode(OrderMode order_mode) {
   if (data_->open_) {
     return Status::IllegalState("Order mode must be set before Open()");
@@ -1042,7 +1310,15 @@ Status KuduScanner::SetOrderMode(OrderMode order_mode) {
   if (!tight_enum_test<OrderMode>(order_mode)) {
     return Status::InvalidArgument("Bad order mode");
   }
-  return data_->mutable_configuration()->SetFaultTolerant(order_mode == ORDERED);
+  data_->mutable_configuration()->SetReverseOrdered(order_mode == REVERSE_ORDERED);
+  return data_->mutable_configuration()->SetFaultTolerant(order_mode != UNORDERED);
+}
+
+Status KuduScanner::SetLimit(int64_t limit) {
+  if (data_->open_) {
+    return Status::IllegalState("Limit must be set before Open()");
+  }
+  return data_->mutable_configuration()->SetLimit(limit);
 }
 
 Status KuduScanner::SetFaultTolerant() {
@@ -1083,6 +1359,129 @@ Status KuduScanner::SetTimeoutMillis(int millis) {
   return Status::OK();
 }
 
+Status KuduScanner::SetRowFormatFlags(uint64_t flags) {
+  if (data_->open_) {
+    return Status::IllegalState("Row format flags must be set before Open()");
+  }
+  return data_->mutable_configuration()->SetRowFormatFlags(flags);
+}
+
+Status KuduScanner::AddAggregate(AggregateFunction function, const string& col_name) {
+  if (data_->open_) {
+    return Status::IllegalState("Aggregates must be added before Open()");
+  }
+  return data_->mutable_configuration()->AddAggregate(function, col_name);
+}
+
+Status KuduScanner::ComputeAggregates(const KuduPartialRow** result) {
+  CHECK(data_->open_);
+  const ScanConfiguration& configuration = data_->configuration();
+  if (configuration.aggregates().empty()) {
+    return Status::IllegalState("No aggregates were added to the scanner");
+  }
+  if (configuration.group_by()) {
+    return Status::IllegalState(
+        "Grouped aggregates must be computed with ComputeGroupedAggregates()");
+  }
+  if (configuration.row_format_flags() & COLUMNAR_LAYOUT) {
+    return Status::NotSupported("Aggregates can't be computed by columnar scans");
+  }
+  if (configuration.limit() >= 0) {
+    return Status::NotSupported("Aggregates can't be computed by scans with a limit");
+  }
+
+  if (!data_->aggregate_result_) {
+    vector<ScanAggregate> aggregates = configuration.aggregates();
+    KuduScanBatch batch;
+    while (HasMoreRows()) {
+      RETURN_NOT_OK(NextBatch(&batch));
+      for (int r = 0; r < batch.NumRows(); r++) {
+        KuduScanBatch::RowPtr row = batch.Row(r);
+        for (int i = 0; i < aggregates.size(); i++) {
+          aggregates[i].Merge(row.IsNull(i) ? nullptr : row.cell(i));
+        }
+      }
+    }
+
+    gscoped_ptr<KuduPartialRow> aggregate_result(
+        new KuduPartialRow(configuration.result_schema()));
+    for (int i = 0; i < aggregates.size(); i++) {
+      // Large enough, and suitably aligned, for a cell of any type.
+      uint64_t cell[2];
+      if (aggregates[i].GetResult(cell)) {
+        RETURN_NOT_OK(aggregate_result->Set(i, reinterpret_cast<const uint8_t*>(cell)));
+      } else {
+        RETURN_NOT_OK(aggregate_result->SetNull(i));
+      }
+    }
+    data_->aggregate_result_ = std::move(aggregate_result);
+  }
+  *result = data_->aggregate_result_.get();
+  return Status::OK();
+}
+
+Status KuduScanner::SetGroupByColumns(const vector<string>& col_names) {
+  if (data_->open_) {
+    return Status::IllegalState("Grouping columns must be set before Open()");
+  }
+  return data_->mutable_configuration()->SetGroupByColumns(col_names);
+}
+
+Status KuduScanner::ComputeGroupedAggregates(vector<const KuduPartialRow*>* groups) {
+  CHECK(data_->open_);
+  const ScanConfiguration& configuration = data_->configuration();
+  if (!configuration.group_by()) {
+    return Status::IllegalState("No grouping columns were set on the scanner");
+  }
+  if (configuration.row_format_flags() & COLUMNAR_LAYOUT) {
+    return Status::NotSupported("Aggregates can't be computed by columnar scans");
+  }
+  if (configuration.limit() >= 0) {
+    return Status::NotSupported("Aggregates can't be computed by scans with a limit");
+  }
+
+  if (!data_->group_results_computed_) {
+    unique_ptr<ScanGroupBy> group_by = configuration.group_by()->CloneEmpty();
+    const Schema* result_schema = configuration.result_schema();
+    KuduScanBatch batch;
+    vector<const void*> cells(result_schema->num_columns());
+    while (HasMoreRows()) {
+      RETURN_NOT_OK(NextBatch(&batch));
+      for (int r = 0; r < batch.NumRows(); r++) {
+        KuduScanBatch::RowPtr row = batch.Row(r);
+        for (int i = 0; i < cells.size(); i++) {
+          cells[i] = row.IsNull(i) ? nullptr : row.cell(i);
+        }
+        group_by->Merge(cells);
+      }
+    }
+
+    vector<unique_ptr<KuduPartialRow>> group_results;
+    group_results.reserve(group_by->num_groups());
+    for (size_t g = 0; g < group_by->num_groups(); g++) {
+      unique_ptr<KuduPartialRow> group_result(new KuduPartialRow(result_schema));
+      for (int i = 0; i < result_schema->num_columns(); i++) {
+        // Large enough, and suitably aligned, for a cell of any type.
+        uint64_t cell[2];
+        if (group_by->GetResult(g, i, cell)) {
+          // BINARY cells, which point into 'group_by', are copied.
+          RETURN_NOT_OK(group_result->Set(i, reinterpret_cast<const uint8_t*>(cell)));
+        } else {
+          RETURN_NOT_OK(group_result->SetNull(i));
+        }
+      }
+      group_results.push_back(std::move(group_result));
+    }
+    data_->group_results_ = std::move(group_results);
+    data_->group_results_computed_ = true;
+  }
+  groups->clear();
+  for (const auto& group_result : data_->group_results_) {
+    groups->push_back(group_result.get());
+  }
+  return Status::OK();
+}
+
 Status KuduScanner::AddConjunctPredicate(KuduPredicate* pred) {
   if (data_->open_) {
     // Take ownership even if we return a bad status.
@@ -1131,6 +1530,22 @@ const ResourceMetrics& KuduScanner::GetResourceMetrics() const {
   return data_->resource_metrics_;
 }
 
+Status KuduScanner::SetProfilingEnabled(bool enabled) {
+  if (data_->open_) {
+    return Status::IllegalState("Profiling must be set before Open()");
+  }
+  data_->mutable_configuration()->SetProfilingEnabled(enabled);
+  return Status::OK();
+}
+
+const ResourceMetrics& KuduScanner::GetProfile() const {
+  return data_->profile_;
+}
+
+map<string, int64_t> KuduScanner::GetColumnProfile(const string& col_name) const {
+  return FindWithDefault(data_->column_profiles_, col_name, map<string, int64_t>());
+}
+
 namespace {
 // Callback for the RPC sent by Close().
 // We can't use the KuduScanner response and RPC controller members for this
@@ -1174,11 +1589,23 @@ Status KuduScanner::Open() {
     return Status::OK();
   }
 
-  VLOG(1) << "Beginning scan " << ToString();
-
   MonoTime deadline = MonoTime::Now() + data_->configuration().timeout();
   set<string> blacklist;
 
+  // Reverse-ordered scans visit the tablets last to first, so that a limit
+  // is spent on the end of the key range.
+  if (data_->configuration().is_reverse_ordered()) {
+    RETURN_NOT_OK(data_->LookupReverseOrderedTablets(deadline));
+    if (data_->reverse_partition_keys_.empty()) {
+      VLOG(1) << "Short circuiting scan " << ToString();
+      data_->open_ = true;
+      data_->short_circuit_ = true;
+      return Status::OK();
+    }
+  }
+
+  VLOG(1) << "Beginning scan " << ToString();
+
   RETURN_NOT_OK(data_->OpenNextTablet(deadline, &blacklist));
 
   data_->open_ = true;
@@ -1194,6 +1621,10 @@ void KuduScanner::Close() {
 
   VLOG(1) << "Ending scan " << ToString();
 
+  // Wait for any background RPC, which uses the proxy and advances the call
+  // sequence ID of the server-side scanner.
+  data_->StopPrefetching();
+
   // Close the scanner on the server-side, if necessary.
   //
   // If the scan did not match any rows, the tserver will not assign a scanner ID.
@@ -1218,22 +1649,25 @@ void KuduScanner::Close() {
 bool KuduScanner::HasMoreRows() const {
   CHECK(data_->open_);
   return !data_->short_circuit_ &&                 // The scan is not short circuited
+      !data_->LimitReached() &&                    // nor has it returned all its rows
       (data_->data_in_open_ ||                     // more data in hand
        data_->last_response_.has_more_results() || // more data in this tablet
        data_->MoreTablets());                      // more tablets to scan, possibly with more data
 }
 
 Status KuduScanner::NextBatch(vector<KuduRowResult>* rows) {
+  if (data_->configuration().row_format_flags() & COLUMNAR_LAYOUT) {
+    return Status::NotSupported("Columnar scans must use NextBatch(KuduScanBatch*)");
+  }
   RETURN_NOT_OK(NextBatch(&data_->batch_for_old_api_));
   data_->batch_for_old_api_.data_->ExtractRows(rows);
   return Status::OK();
 }
 
 Status KuduScanner::NextBatch(KuduScanBatch* batch) {
-  // TODO: do some double-buffering here -- when we return this batch
-  // we should already have fired off the RPC for the next batch, but
-  // need to do some swapping of the response objects around to avoid
-  // stomping on the memory the user is looking at.
+  // If prefetching is enabled, the RPC for the next batch is fired off before
+  // returning this one. Prefetched responses are kept in their own buffers, so
+  // they don't stomp on the memory the user is looking at.
   CHECK(data_->open_);
   CHECK(data_->proxy_);
 
@@ -1247,31 +1681,50 @@ Status KuduScanner::NextBatch(KuduScanBatch* batch) {
     // We have data from a previous scan.
     VLOG(1) << "Extracting data from scan " << ToString();
     data_->data_in_open_ = false;
-    return batch->data_->Reset(&data_->controller_,
-                               data_->configuration().projection(),
-                               data_->configuration().client_projection(),
-                                make_gscoped_ptr(data_->last_response_.release_data()));
+    data_->MaybeStartPrefetch();
+    RETURN_NOT_OK(batch->data_->Reset(&data_->controller_,
+                                      data_->configuration().result_schema(),
+                                      data_->configuration().client_result_schema(),
+                                      &data_->last_response_));
+    data_->rows_returned_ += batch->NumRows();
+    return Status::OK();
   } else if (data_->last_response_.has_more_results()) {
     // More data is available in this tablet.
     VLOG(1) << "Continuing scan " << ToString();
 
     MonoTime batch_deadline = MonoTime::Now() + data_->configuration().timeout();
-    data_->PrepareRequest(KuduScanner::Data::CONTINUE);
+
+    // A prefetched response, if any, was sent for the next call sequence ID.
+    ScanRpcStatus prefetch_result;
+    bool prefetched = data_->TakePrefetchedResponse(&prefetch_result);
+    if (!prefetched) {
+      data_->PrepareRequest(KuduScanner::Data::CONTINUE);
+    }
 
     while (true) {
-      bool allow_time_for_failover = data_->configuration().is_fault_tolerant();
-      ScanRpcStatus result = data_->SendScanRpc(batch_deadline, allow_time_for_failover);
+      ScanRpcStatus result;
+      if (prefetched) {
+        result = prefetch_result;
+        prefetched = false;
+      } else {
+        bool allow_time_for_failover = data_->configuration().is_fault_tolerant();
+        result = data_->SendScanRpc(batch_deadline, allow_time_for_failover);
+      }
 
       // Success case.
       if (result.result == ScanRpcStatus::OK) {
         if (data_->last_response_.has_last_primary_key()) {
           data_->last_primary_key_ = data_->last_response_.last_primary_key();
         }
+        data_->resume_token_ = data_->last_response_.resume_token();
         data_->scan_attempts_ = 0;
-        return batch->data_->Reset(&data_->controller_,
-                                   data_->configuration().projection(),
-                                   data_->configuration().client_projection(),
-                                   make_gscoped_ptr(data_->last_response_.release_data()));
+        data_->MaybeStartPrefetch();
+        RETURN_NOT_OK(batch->data_->Reset(&data_->controller_,
+                                          data_->configuration().result_schema(),
+                                          data_->configuration().client_result_schema(),
+                                          &data_->last_response_));
+        data_->rows_returned_ += batch->NumRows();
+        return Status::OK();
       }
 
       data_->scan_attempts_++;
@@ -1288,6 +1741,11 @@ Status KuduScanner::NextBatch(KuduScanBatch* batch) {
         return data_->ReopenCurrentTablet(batch_deadline, &blacklist);
       }
 
+      if (!data_->resume_token_.empty()) {
+        LOG(WARNING) << "Attempting to resume scan of tablet " << ToString() << ".";
+        return data_->ReopenCurrentTablet(batch_deadline, &blacklist);
+      }
+
       if (blacklist.empty()) {
         // If we didn't blacklist the current server, we can just retry again.
         continue;
@@ -1296,12 +1754,13 @@ Status KuduScanner::NextBatch(KuduScanBatch* batch) {
       // retry anywhere, so just propagate the error.
       return result.status;
     }
-  } else if (data_->MoreTablets()) {
+  } else if (data_->MoreTablets() && !data_->LimitReached()) {
     // More data may be available in other tablets.
     // No need to close the current tablet; we scanned all the data so the
     // server closed it for us.
     VLOG(1) << "Scanning next tablet " << ToString();
     data_->last_primary_key_.clear();
+    data_->resume_token_.clear();
     MonoTime deadline = MonoTime::Now() + data_->configuration().timeout();
     set<string> blacklist;
 
@@ -1393,6 +1852,10 @@ Status KuduScanTokenBuilder::SetReadMode(KuduScanner::ReadMode read_mode) {
   return data_->mutable_configuration()->SetReadMode(read_mode);
 }
 
+Status KuduScanTokenBuilder::SetMaxStalenessMillis(int millis) {
+  return data_->mutable_configuration()->SetMaxStalenessMillis(millis);
+}
+
 Status KuduScanTokenBuilder::SetFaultTolerant() {
   return data_->mutable_configuration()->SetFaultTolerant(true);
 }
@@ -1416,6 +1879,11 @@ Status KuduScanTokenBuilder::SetTimeoutMillis(int millis) {
   return Status::OK();
 }
 
+Status KuduScanTokenBuilder::SetSplitSizeBytes(uint64_t split_size_bytes) {
+  data_->set_split_size_bytes(split_size_bytes);
+  return Status::OK();
+}
+
 Status KuduScanTokenBuilder::AddConjunctPredicate(KuduPredicate* pred) {
   return data_->mutable_configuration()->AddConjunctPredicate(pred);
 }
@@ -1436,6 +1904,53 @@ Status KuduScanTokenBuilder::Build(vector<KuduScanToken*>* tokens) {
   return data_->Build(tokens);
 }
 
+////////////////////////////////////////////////////////////
+// KuduParallelScanner
+////////////////////////////////////////////////////////////
+
+KuduParallelScanner::KuduParallelScanner(KuduScanTokenBuilder* builder)
+    : data_(new KuduParallelScanner::Data(builder)) {
+}
+
+KuduParallelScanner::~KuduParallelScanner() {
+  delete data_;
+}
+
+Status KuduParallelScanner::SetParallelism(int num_tablets) {
+  return data_->SetParallelism(num_tablets);
+}
+
+Status KuduParallelScanner::SetMaxBufferedBatches(int max_batches) {
+  return data_->SetMaxBufferedBatches(max_batches);
+}
+
+Status KuduParallelScanner::SetOrdered() {
+  data_->SetOrdered();
+  return Status::OK();
+}
+
+Status KuduParallelScanner::Open() {
+  return data_->Open();
+}
+
+void KuduParallelScanner::Close() {
+  data_->Close();
+}
+
+bool KuduParallelScanner::HasMoreRows() const {
+  return data_->HasMoreRows();
+}
+
+Status KuduParallelScanner::NextBatch(KuduScanBatch* batch) {
+  batch->data_->Clear();
+  unique_ptr<KuduScanBatch> next;
+  RETURN_NOT_OK(data_->NextBatch(&next));
+  if (next) {
+    std::swap(batch->data_, next->data_);
+  }
+  return Status::OK();
+}
+
 ////////////////////////////////////////////////////////////
 // KuduReplica
 ////////////////////////////////////////////////////////////
@@ -372,7 +372,17 @@ class KUDU_EXPORT KuduClient : public sp::enable_shared_from_this<KuduClient> {
     CLOSEST_REPLICA,  ///< Select the closest replica to the client,
                       ///< or a random one if all replicas are equidistant.
 
-    FIRST_REPLICA     ///< Select the first replica in the list.
+    FIRST_REPLICA,    ///< Select the first replica in the list.
+
+    LEAST_LOADED_REPLICA, ///< Select the replica expected to respond first,
+                          ///< based on the latency and the number of
+                          ///< outstanding requests the client observed for
+                          ///< each replica's server.
+
+    LEARNER_REPLICA  ///< Select the closest of the non-voting learner
+                     ///< replicas, so that heavy scans stay off the servers
+                     ///< of the write path. Falls back to the closest
+                     ///< replica if the tablet has no learner available.
   };
 
   /// @return @c true iff client is configured to talk to multiple
@@ -431,7 +441,10 @@ class KUDU_EXPORT KuduClient : public sp::enable_shared_from_this<KuduClient> {
   friend class KuduTableCreator;
 
   FRIEND_TEST(kudu::ClientStressTest, TestUniqueClientIds);
+  FRIEND_TEST(ClientTest, TestAlterPartitioningClearsOnlyAlteredRanges);
+  FRIEND_TEST(ClientTest, TestBulkTabletLocationLookups);
   FRIEND_TEST(ClientTest, TestGetTabletServerBlacklist);
+  FRIEND_TEST(ClientTest, TestLeastLoadedReplicaSelection);
   FRIEND_TEST(ClientTest, TestMasterDown);
   FRIEND_TEST(ClientTest, TestMasterLookupPermits);
   FRIEND_TEST(ClientTest, TestMetaCacheExpiry);
@@ -540,6 +553,59 @@ class KUDU_EXPORT KuduTablet {
   DISALLOW_COPY_AND_ASSIGN(KuduTablet);
 };
 
+/// @brief Statistics over the values of a table's column.
+///
+/// The statistics are kept by the tablet servers as data is flushed to disk,
+/// and only describe flushed data: recently written rows, and updates and
+/// deletes which have not been compacted yet, are not reflected. They are
+/// intended for planning queries, not as exact answers.
+class KUDU_EXPORT KuduColumnStatistics {
+ public:
+  ~KuduColumnStatistics();
+
+  /// @return Name of the column.
+  const std::string& column_name() const;
+
+  /// @return The number of rows described, including those whose value
+  ///   is NULL.
+  int64_t num_rows() const;
+
+  /// @return The number of rows described whose value is NULL.
+  int64_t null_count() const;
+
+  /// @return The size of the column's data on disk, in bytes.
+  int64_t total_bytes() const;
+
+  /// Get the estimated number of distinct non-NULL values.
+  ///
+  /// @param [out] count
+  ///   The estimate, which has a relative error of a few percent.
+  /// @return Operation result status. Returns NotFound if the estimate
+  ///   is not known.
+  Status GetEstimatedDistinctCount(int64_t* count) const;
+
+  /// Get the range of the non-NULL values.
+  ///
+  /// @param [out] range
+  ///   Set to a row with a @c min and a @c max column of the column's type,
+  ///   holding the smallest and largest non-NULL values. Both are @c NULL if
+  ///   every value is NULL, or if the range is not known (e.g. if a NaN was
+  ///   written to a floating point column). The row is owned by this object.
+  void GetRange(const KuduPartialRow** range) const;
+
+ private:
+  friend class KuduTable;
+
+  class KUDU_NO_EXPORT Data;
+
+  KuduColumnStatistics();
+
+  // Owned.
+  Data* data_;
+
+  DISALLOW_COPY_AND_ASSIGN(KuduColumnStatistics);
+};
+
 /// @brief A helper class to create a new table with the desired options.
 class KUDU_EXPORT KuduTableCreator {
  public:
@@ -688,6 +754,60 @@ class KUDU_EXPORT KuduTableCreator {
   /// @return Reference to the modified table creator.
   KuduTableCreator& num_replicas(int n_replicas);
 
+  /// Compact the table's data in windows of its leading primary key column.
+  ///
+  /// Intended for append-mostly tables keyed by time: rowsets are grouped
+  /// into windows of @c window_width consecutive values of the leading key
+  /// column, and only rowsets of the same window are compacted together.
+  /// The leading key column must be an integer or @c UNIXTIME_MICROS column.
+  /// If not called, the table uses the default compaction policy, which
+  /// optimizes over the whole key space.
+  ///
+  /// @param [in] window_width
+  ///   Width of each window, in units of the leading key column
+  ///   (e.g. microseconds for a @c UNIXTIME_MICROS column). Must be positive.
+  /// @param [in] frozen_window_age
+  ///   Windows which end more than this many units before the largest key
+  ///   of a tablet are no longer compacted. If 0, windows are never frozen.
+  /// @return Reference to the modified table creator.
+  KuduTableCreator& time_windowed_compaction(int64_t window_width,
+                                             int64_t frozen_window_age = 0);
+
+  /// Expire the table's rows once they are older than @c ttl.
+  ///
+  /// The age of a row is given by its leading primary key column, which
+  /// must be a @c UNIXTIME_MICROS column. Expired rows are no longer
+  /// returned by scans and can't be updated or deleted; inserting them
+  /// fails. Their storage is reclaimed by flushes and compactions, without
+  /// writing any deletes. If not called, rows never expire.
+  ///
+  /// @param [in] ttl
+  ///   How long rows are retained. Must not be negative.
+  /// @return Reference to the modified table creator.
+  KuduTableCreator& row_ttl(const MonoDelta& ttl);
+
+  /// Let the master create the table's range partitions as time goes by,
+  /// one for each @c interval, so that ingest doesn't depend on them being
+  /// added ahead of time.
+  ///
+  /// The table must be range partitioned on a single @c UNIXTIME_MICROS
+  /// column. Range partitions are aligned to multiples of @c interval since
+  /// the Unix epoch. If no range partitions are added to the table creator,
+  /// the table is created with the current and upcoming range partitions.
+  /// Otherwise, the master adds those that don't overlap the given ones.
+  ///
+  /// @param [in] interval
+  ///   Width of each range partition, e.g. a day. Must be positive.
+  /// @param [in] num_ahead
+  ///   Number of range partitions after the current one to keep created.
+  /// @param [in] retention
+  ///   If positive, range partitions which ended more than @c retention ago
+  ///   are dropped, along with their rows.
+  /// @return Reference to the modified table creator.
+  KuduTableCreator& range_partition_interval(const MonoDelta& interval,
+                                             int num_ahead = 3,
+                                             const MonoDelta& retention = MonoDelta());
+
   /// Set the timeout for the table creation operation.
   ///
   /// This includes any waiting after the create has been submitted
@@ -754,6 +874,9 @@ class KUDU_EXPORT KuduTableCreator {
 ///     Updates an existing row. Fails if the row does not exist.
 ///   @li DELETE
 ///     Deletes an existing row. Fails if the row does not exist.
+///   @li INCREMENT
+///     Adds to the numeric columns of an existing row. Fails if the row
+///     does not exist.
 ///
 /// @note This class is thread-safe.
 class KUDU_EXPORT KuduTable : public sp::enable_shared_from_this<KuduTable> {
@@ -798,6 +921,11 @@ class KUDU_EXPORT KuduTable : public sp::enable_shared_from_this<KuduTable> {
   ///   KuduSession::Apply().
   KuduDelete* NewDelete();
 
+  /// @return New @c INCREMENT operation for this table. It is the caller's
+  ///   responsibility to free the result, unless it is passed to
+  ///   KuduSession::Apply().
+  KuduIncrement* NewIncrement();
+
   /// Create a new comparison predicate.
   ///
   /// This method creates new instance of a comparison predicate which
@@ -825,6 +953,85 @@ class KUDU_EXPORT KuduTable : public sp::enable_shared_from_this<KuduTable> {
                                         KuduPredicate::ComparisonOp op,
                                         KuduValue* value);
 
+  /// Create a new IN list predicate which can be used for scanners on this
+  /// table.
+  ///
+  /// The IN list predicate is used to specify a list of values that a column
+  /// must match. A row is filtered from the scan if the value of the column
+  /// does not equal any value from the list.
+  ///
+  /// The type of entries in the list must correspond to the type of the column
+  /// to which the predicate is to be applied. For example, if the given column
+  /// is any type of integer, the KuduValues should also be integers, with the
+  /// values in the valid range for the column type. No attempt is made to cast
+  /// between floating point and integer values, or numeric and string values.
+  ///
+  /// @param [in] col_name
+  ///   Name of the column to which the predicate applies.
+  /// @param [in] values
+  ///   Vector of values which the column will be matched against.
+  /// @return Raw pointer to an IN list predicate. The caller owns the
+  ///   predicate until it is passed into KuduScanner::AddConjunctPredicate().
+  ///   The returned predicate takes ownership of the values vector and its
+  ///   elements, and the vector is cleared on return. Non-NULL is returned
+  ///   both in success and error cases. In the case of an error (e.g. an
+  ///   invalid column name), a non-NULL value is still returned. The error
+  ///   will be returned when attempting to add this predicate to a
+  ///   KuduScanner.
+  KuduPredicate* NewInListPredicate(const Slice& col_name,
+                                    std::vector<KuduValue*>* values);
+
+  /// Create a new IN bloom filter predicate which can be used for scanners
+  /// on this table.
+  ///
+  /// Like an IN list predicate, this predicate matches the rows whose value
+  /// of the column equals one of the given values. However, instead of the
+  /// list of values, a bloom filter built from them is sent to the tablet
+  /// servers, which makes the predicate much more compact for large sets of
+  /// values, e.g. the keys of a semi-join. In exchange, a fraction of the rows
+  /// whose value is not in the set may be returned too: callers which need
+  /// exact results must check the returned rows against the set.
+  ///
+  /// The type of entries in the list must correspond to the type of the
+  /// column, as for NewInListPredicate().
+  ///
+  /// @param [in] col_name
+  ///   Name of the column to which the predicate applies.
+  /// @param [in] values
+  ///   Vector of values which the column will be matched against.
+  /// @param [in] false_positive_rate
+  ///   The target fraction of values not in the set which the predicate
+  ///   matches anyway, between 0 and 1 exclusive. Lower rates make for
+  ///   larger filters.
+  /// @return Raw pointer to an IN bloom filter predicate. The caller owns
+  ///   the predicate until it is passed into
+  ///   KuduScanner::AddConjunctPredicate(). The returned predicate takes
+  ///   ownership of the values vector and its elements, and the vector is
+  ///   cleared on return. Non-NULL is returned both in success and error
+  ///   cases. In the case of an error (e.g. an invalid column name), a
+  ///   non-NULL value is still returned. The error will be returned when
+  ///   attempting to add this predicate to a KuduScanner.
+  KuduPredicate* NewInBloomFilterPredicate(const Slice& col_name,
+                                           std::vector<KuduValue*>* values,
+                                           double false_positive_rate);
+
+  /// Create a new IS NULL predicate which can be used for scanners on this
+  /// table.
+  ///
+  /// The IS NULL predicate filters out every row whose value in the given
+  /// column is not NULL. It is evaluated on the tablet servers using only the
+  /// column's null bitmap, so the column's values are never decoded.
+  ///
+  /// @param [in] col_name
+  ///   Name of the column to which the predicate applies.
+  /// @return Raw pointer to an IS NULL predicate. The caller owns the
+  ///   predicate until it is passed into KuduScanner::AddConjunctPredicate().
+  ///   Non-NULL is returned both in success and error cases. In the case of
+  ///   an error (e.g. an invalid column name), a non-NULL value is still
+  ///   returned. The error will be returned when attempting to add this
+  ///   predicate to a KuduScanner.
+  KuduPredicate* NewIsNullPredicate(const Slice& col_name);
+
   /// @return The KuduClient object associated with the table. The caller
   ///   should not free the returned pointer.
   KuduClient* client() const;
@@ -832,6 +1039,51 @@ class KUDU_EXPORT KuduTable : public sp::enable_shared_from_this<KuduTable> {
   /// @return The partition schema for the table.
   const PartitionSchema& partition_schema() const;
 
+  /// Get statistics over the values of the table's columns, merged over all
+  /// of its tablets.
+  ///
+  /// Each tablet is asked for its statistics by a replica; see
+  /// KuduColumnStatistics for what they describe. A column is omitted if some
+  /// tablet has data without statistics for it, e.g. data written by a tablet
+  /// server which predates column statistics.
+  ///
+  /// @param [out] stats
+  ///   The statistics of the columns, in schema order. The caller takes
+  ///   ownership of the elements.
+  /// @return Operation result status.
+  Status GetColumnStatistics(std::vector<KuduColumnStatistics*>* stats);
+
+  /// Fetch the locations of all the table's tablets into the client's cache.
+  ///
+  /// Without this, the locations are fetched from the master as operations
+  /// need them, a few tablets at a time. A client about to use many tablets
+  /// of a table, e.g. writing to all of it, may start faster by prefetching
+  /// them in bulk. Cached locations expire like any others.
+  ///
+  /// @return Operation result status.
+  Status PrefetchTabletLocations();
+
+  /// Look up rows by their primary keys.
+  ///
+  /// The keys are grouped by tablet, and each tablet is asked for all of its
+  /// rows in one round trip, rather than opening a scanner per key. Rows are
+  /// read as of the latest writes the serving replica has applied, as a scan
+  /// in the READ_LATEST mode would.
+  ///
+  /// @param [in] keys
+  ///   The keys of the rows to look up. Every primary key column of each of
+  ///   them must be set; other columns are ignored.
+  /// @param [in] projected_column_names
+  ///   The names of the columns to return, in order.
+  /// @param [out] batches
+  ///   One batch per tablet holding any of the rows, each with its rows in
+  ///   key order. Keys without rows are skipped. The caller takes ownership
+  ///   of the elements.
+  /// @return Operation result status.
+  Status LookupRows(const std::vector<const KuduPartialRow*>& keys,
+                    const std::vector<std::string>& projected_column_names,
+                    std::vector<KuduScanBatch*>* batches);
+
  private:
   class KUDU_NO_EXPORT Data;
 
@@ -1320,6 +1572,19 @@ class KUDU_EXPORT KuduSession : public sp::enable_shared_from_this<KuduSession>
   ///   If the parameter value is less than 0, it's implicitly set to 0.
   void SetTimeoutMillis(int millis);
 
+  /// Send the writes to tablets whose leaders are on the same tablet server
+  /// in a single RPC, rather than an RPC per tablet. This cuts the number of
+  /// RPCs made by sessions whose batches span many small tablets.
+  ///
+  /// @warning Unlike the per-tablet writes, these RPCs are not tracked
+  ///   by the servers for exactly-once semantics: should one fail as a whole,
+  ///   e.g. on a network error, its writes are retried one tablet at a time,
+  ///   and some of them may end up applied twice. This is disabled by default.
+  ///
+  /// @param [in] enabled
+  ///   Whether to group the writes by tablet server.
+  void SetMultiTabletWrites(bool enabled);
+
   /// @todo
   ///   Add "doAs" ability here for proxy servers to be able to act on behalf of
   ///   other users, assuming access rights.
@@ -1349,6 +1614,26 @@ class KUDU_EXPORT KuduSession : public sp::enable_shared_from_this<KuduSession>
   /// @return Operation result status.
   Status Apply(KuduWriteOperation* write_op) WARN_UNUSED_RESULT;
 
+  /// Apply the write operation unless that would block.
+  ///
+  /// This is like Apply(), except that instead of waiting for mutation buffer
+  /// space in @c AUTO_FLUSH_BACKGROUND mode, or for a free mutation buffer
+  /// in any mode, it returns immediately. This lets
+  /// a pipelined application keep preparing operations while its earlier
+  /// ones are being sent, and retry once GetMutationBufferSpaceUsed() shows
+  /// that there is room. Every operation the session takes keeps its errors
+  /// in the session's error collector, so each failure can be attributed
+  /// to its operation by KuduError::failed_op().
+  ///
+  /// @param [in] write_op
+  ///   Operation to apply. Unless the method returns
+  ///   Status::ServiceUnavailable(), this method transfers the write_op's
+  ///   ownership to the KuduSession.
+  /// @return Operation result status. Returns Status::ServiceUnavailable()
+  ///   if applying the operation would block, in which case the caller keeps
+  ///   the ownership of the write_op and may apply it again later.
+  Status TryApply(KuduWriteOperation* write_op) WARN_UNUSED_RESULT;
+
   /// Flush any pending writes.
   ///
   /// This method initiates flushing of the current batch of buffered
@@ -1434,6 +1719,15 @@ class KUDU_EXPORT KuduSession : public sp::enable_shared_from_this<KuduSession>
   ///   not yet been flushed -- i.e. they are not en-route yet.
   int CountBufferedOperations() const;
 
+  /// Get the mutation buffer space used by the session's pending operations.
+  ///
+  /// This includes both the freshly applied operations and the operations
+  /// being flushed, which are freed once their tablet servers respond.
+  ///
+  /// @return The number of bytes used, out of the space set by
+  ///   SetMutationBufferSpace().
+  int64_t GetMutationBufferSpaceUsed() const;
+
   /// Get error count for pending operations.
   ///
   /// Errors may accumulate in session's lifetime; use this method to
@@ -1464,6 +1758,7 @@ class KUDU_EXPORT KuduSession : public sp::enable_shared_from_this<KuduSession>
   friend class internal::Batcher;
   friend class ClientTest;
   FRIEND_TEST(ClientTest, TestAutoFlushBackgroundApplyBlocks);
+  FRIEND_TEST(ClientTest, TestAutoFlushBackgroundTryApply);
 
   explicit KuduSession(const sp::shared_ptr<KuduClient>& client);
 
@@ -1509,7 +1804,21 @@ class KUDU_EXPORT KuduScanner {
     ///   by which writes are sometimes not externally consistent even when
     ///   action was taken to make them so. In these cases Isolation may
     ///   degenerate to mode "Read Committed". See KUDU-430.
-    READ_AT_SNAPSHOT
+    READ_AT_SNAPSHOT,
+
+    /// When @c READ_BOUNDED_STALENESS is specified any replica, including
+    /// a follower, may serve the scan without waiting for in-flight
+    /// transactions. The scan reads at the replica's "safe time": a timestamp
+    /// below which the tablet's leader guarantees no further writes, which
+    /// leaders propagate to followers along with their heartbeats. Reads are
+    /// repeatable at the snapshot timestamp returned by the scan, but may
+    /// miss the most recent writes. Use SetMaxStalenessMillis() to bound how
+    /// far behind the current time that snapshot may be, and SetSelection()
+    /// to choose which replicas serve the scan.
+    ///
+    /// @note Followers only serve fresh data when the tablet servers run
+    ///   with @c --raft_propagate_safe_time.
+    READ_BOUNDED_STALENESS
   };
 
   /// Whether the rows should be returned in order.
@@ -1527,7 +1836,18 @@ class KUDU_EXPORT KuduScanner {
     /// additional overhead on the tablet server, but means that scans are
     /// fault-tolerant and will be resumed at another tablet server
     /// in the case of a failure.
-    ORDERED
+    ORDERED,
+
+    /// Like ORDERED, but the rows of each tablet are returned in descending
+    /// primary key order, and the tablets are scanned in descending partition
+    /// order. The rows are thus ordered across tablets if the table is only
+    /// range partitioned, on a prefix of its primary key; with hash
+    /// partitioning, each hash bucket is scanned in turn.
+    ///
+    /// A reverse-ordered scan with a limit (see SetLimit()) reads only
+    /// the end of the key range, which makes it an efficient way to fetch
+    /// the latest rows of a key range.
+    REVERSE_ORDERED
   };
 
   /// Default scanner timeout.
@@ -1535,6 +1855,50 @@ class KUDU_EXPORT KuduScanner {
   /// KuduClientBuilder::default_rpc_timeout().
   enum { kScanTimeoutMillis = 30000 };
 
+  /// @name Row format flags.
+  ///
+  /// Flags which control the layout of the rows returned by the scan. They
+  /// may be combined with bitwise OR and passed to SetRowFormatFlags().
+  ///
+  ///@{
+  /// The default row-wise layout.
+  static const uint64_t NO_FLAGS = 0;
+  /// Return the rows of each batch in a column-major layout, which may be
+  /// accessed with KuduScanBatch::GetFixedLengthColumn(),
+  /// KuduScanBatch::GetVariableLengthColumn() and
+  /// KuduScanBatch::GetNonNullBitmapForColumn(). Row-wise accessors such as
+  /// KuduScanBatch::Row() may not be used on such batches.
+  static const uint64_t COLUMNAR_LAYOUT = 1 << 0;
+  /// Together with COLUMNAR_LAYOUT, allow the tablet servers to send string
+  /// and binary columns as dictionary codes wherever that makes a batch
+  /// smaller. The codes may be accessed with
+  /// KuduScanBatch::GetDictionaryEncodedColumn(); the other columnar accessors
+  /// decode them as needed.
+  static const uint64_t COLUMNAR_DICTIONARY = 1 << 1;
+  ///@}
+
+  /// Aggregate functions which may be computed by the tablet servers.
+  ///
+  /// @see AddAggregate().
+  enum AggregateFunction {
+    /// The number of rows, or of non-null values of a column. The result is
+    /// an INT64.
+    AGGREGATE_COUNT,
+
+    /// The minimum non-null value of a column. The result has the type of
+    /// the column.
+    AGGREGATE_MIN,
+
+    /// The maximum non-null value of a column. The result has the type of
+    /// the column.
+    AGGREGATE_MAX,
+
+    /// The sum of the non-null values of an integer or floating point
+    /// column. The result is an INT64 (which wraps on overflow) for integer
+    /// columns, and a DOUBLE for floating point columns.
+    AGGREGATE_SUM
+  };
+
   /// Constructor for KuduScanner.
   ///
   /// @param [in] table
@@ -1727,6 +2091,36 @@ class KUDU_EXPORT KuduScanner {
   /// @return Cumulative resource metrics since the scan was started.
   const ResourceMetrics& GetResourceMetrics() const;
 
+  /// Have the tablet servers profile the work done for the scan.
+  ///
+  /// Profiles tell why a scan is slow: whether its requests waited to run,
+  /// and how much of each column was read from disk, from MemRowSets or
+  /// skipped, and with how many delta stores. They are aggregated over all
+  /// the tablets read by the scan. See GetProfile() and GetColumnProfile().
+  ///
+  /// @param [in] enabled
+  ///   Whether to collect a profile. Default is @c false.
+  /// @return Operation result status.
+  Status SetProfilingEnabled(bool enabled) WARN_UNUSED_RESULT;
+
+  /// @return The cumulative profile of the scan since it was started, if
+  ///   profiling is enabled: the time its requests waited to run on the
+  ///   tablet servers (@c queue_time_us), and spent reading rows once
+  ///   admitted (@c scan_time_us), and the statistics of
+  ///   GetColumnProfile() summed over all columns.
+  const ResourceMetrics& GetProfile() const;
+
+  /// @param [in] col_name
+  ///   The name of a projected column.
+  /// @return The cumulative profile of the reads of the column since the
+  ///   scan was started, if profiling is enabled: the cells and bytes read
+  ///   from disk (@c cells_read_from_disk, @c bytes_read_from_disk), the
+  ///   data blocks read and skipped (@c data_blocks_read_from_disk,
+  ///   @c data_blocks_skipped), the cells read from MemRowSets
+  ///   (@c cells_read_from_memrowset), and the delta stores whose updates
+  ///   were applied, as counted per rowset (@c delta_stores_read).
+  std::map<std::string, int64_t> GetColumnProfile(const std::string& col_name) const;
+
   /// Set the hint for the size of the next batch in bytes.
   ///
   /// @param [in] batch_size
@@ -1735,6 +2129,22 @@ class KUDU_EXPORT KuduScanner {
   /// @return Operation result status.
   Status SetBatchSizeBytes(uint32_t batch_size);
 
+  /// Enable prefetching of batches in the background.
+  ///
+  /// By default, the scanner asks the tablet server for the next batch only
+  /// when NextBatch() is called. With prefetching enabled, the request for the
+  /// next batch is sent as soon as the previous one is returned, so that the
+  /// tablet server scans while the application processes rows. Further batches
+  /// are requested one at a time until the buffered, not yet returned, batches
+  /// take up more than @c budget_bytes.
+  ///
+  /// @param [in] budget_bytes
+  ///   The maximum number of bytes of prefetched batches to buffer before
+  ///   pausing the prefetching. Setting to 0 (the default) disables
+  ///   prefetching.
+  /// @return Operation result status.
+  Status SetPrefetchBudgetBytes(uint32_t budget_bytes) WARN_UNUSED_RESULT;
+
   /// Set the replica selection policy while scanning.
   ///
   /// @param [in] selection
@@ -1752,13 +2162,40 @@ class KUDU_EXPORT KuduScanner {
   /// @return Operation result status.
   Status SetReadMode(ReadMode read_mode) WARN_UNUSED_RESULT;
 
-  /// @deprecated Use SetFaultTolerant() instead.
+  /// Set the maximum staleness of scans in @c READ_BOUNDED_STALENESS mode.
+  ///
+  /// A replica whose safe time is further behind its current time than this
+  /// rejects the scan, which is then retried on another replica until the
+  /// scan's timeout expires. By default any staleness is accepted.
+  ///
+  /// @param [in] millis
+  ///   The maximum staleness (in milliseconds). Must not be negative.
+  /// @return Operation result status.
+  Status SetMaxStalenessMillis(int millis) WARN_UNUSED_RESULT;
+
+  /// Set the order in which the rows are returned.
+  ///
+  /// Use SetFaultTolerant() rather than the ORDERED mode, which this is
+  /// deprecated for. REVERSE_ORDERED scans require tablet servers which
+  /// support them, and are fault-tolerant like ORDERED ones.
   ///
   /// @param [in] order_mode
-  ///   Result record orderind mode to set.
+  ///   Result record ordering mode to set.
   /// @return Operation result status.
   Status SetOrderMode(OrderMode order_mode) WARN_UNUSED_RESULT;
 
+  /// Set the maximum number of rows returned by the scan.
+  ///
+  /// Each tablet server stops scanning once it has returned the rows still
+  /// allowed, and no further tablets are scanned once the limit is reached.
+  /// Limits require tablet servers which support them, and may not be
+  /// combined with aggregates.
+  ///
+  /// @param [in] limit
+  ///   The maximum number of rows. Must not be negative.
+  /// @return Operation result status.
+  Status SetLimit(int64_t limit) WARN_UNUSED_RESULT;
+
   /// Make scans resumable at another tablet server if current server fails.
   ///
   /// Scans are by default non fault-tolerant, and scans will fail
@@ -1795,6 +2232,85 @@ class KUDU_EXPORT KuduScanner {
   /// @return Operation result status.
   Status SetTimeoutMillis(int millis);
 
+  /// Set the layout of the rows returned by the scan.
+  ///
+  /// If any flags are set, the scan will fail with an error against tablet
+  /// servers which do not support them.
+  ///
+  /// @param [in] flags
+  ///   A bitwise OR of the row format flags, for example
+  ///   KuduScanner::COLUMNAR_LAYOUT. Default is KuduScanner::NO_FLAGS.
+  /// @return Operation result status.
+  Status SetRowFormatFlags(uint64_t flags) WARN_UNUSED_RESULT;
+
+  /// Add an aggregate to compute over the rows matched by the scan.
+  ///
+  /// The aggregates are computed by the tablet servers, which return a
+  /// partial result per batch instead of the matching rows. Once an
+  /// aggregate is added, the projection consists of the aggregated columns
+  /// and may no longer be changed, and the scan should be run with
+  /// ComputeAggregates(). NextBatch() may still be called, but returns the
+  /// unmerged partial results.
+  ///
+  /// If any aggregates are added, the scan will fail with an error against
+  /// tablet servers which do not support aggregates.
+  ///
+  /// @param [in] function
+  ///   The aggregate function.
+  /// @param [in] col_name
+  ///   Name of the column to aggregate. May be empty for AGGREGATE_COUNT,
+  ///   in which case all matching rows are counted.
+  /// @return Operation result status.
+  Status AddAggregate(AggregateFunction function,
+                      const std::string& col_name) WARN_UNUSED_RESULT;
+
+  /// Run the scan to completion and merge the partial results of the
+  /// aggregates added with AddAggregate().
+  ///
+  /// Must be called after Open().
+  ///
+  /// @param [out] result
+  ///   A row with one column per aggregate, in the order in which they were
+  ///   added, named e.g. "count(*)" or "max(col)". MIN, MAX and SUM are
+  ///   @c NULL if no non-null values were aggregated. The row is owned by the
+  ///   scanner and remains valid until the scanner is destroyed.
+  /// @return Operation result status.
+  Status ComputeAggregates(const KuduPartialRow** result) WARN_UNUSED_RESULT;
+
+  /// Group the rows matched by the scan by the values of some columns, as
+  /// with GROUP BY, and compute the aggregates added with AddAggregate()
+  /// over each group.
+  ///
+  /// The tablet servers return the partial results of each group they see,
+  /// instead of a single partial result per batch. The projection then
+  /// consists of the grouping columns followed by the aggregated columns,
+  /// and the scan should be run with ComputeGroupedAggregates(). Grouping is
+  /// most effective by columns with few distinct values.
+  ///
+  /// Must be called after AddAggregate(). If any grouping columns are set,
+  /// the scan will fail with an error against tablet servers which do not
+  /// support grouped aggregates.
+  ///
+  /// @param [in] col_names
+  ///   Names of the columns by which to group the rows. Replaces any
+  ///   grouping columns set before; if empty, the rows aren't grouped.
+  /// @return Operation result status.
+  Status SetGroupByColumns(const std::vector<std::string>& col_names) WARN_UNUSED_RESULT;
+
+  /// Run the scan to completion and merge the partial results of the
+  /// groups returned by the tablet servers.
+  ///
+  /// Must be called after Open(), on a scan with grouping columns.
+  ///
+  /// @param [out] groups
+  ///   One row per group, in no particular order, holding the grouping
+  ///   values followed by one column per aggregate as with
+  ///   ComputeAggregates(). The rows are owned by the scanner and remain
+  ///   valid until the scanner is destroyed.
+  /// @return Operation result status.
+  Status ComputeGroupedAggregates(
+      std::vector<const KuduPartialRow*>* groups) WARN_UNUSED_RESULT;
+
   /// @return Schema of the projection being scanned.
   KuduSchema GetProjectionSchema() const;
 
@@ -1963,6 +2479,9 @@ class KUDU_EXPORT KuduScanTokenBuilder {
   /// @copydoc KuduScanner::SetReadMode()
   Status SetReadMode(KuduScanner::ReadMode read_mode) WARN_UNUSED_RESULT;
 
+  /// @copydoc KuduScanner::SetMaxStalenessMillis
+  Status SetMaxStalenessMillis(int millis) WARN_UNUSED_RESULT;
+
   /// @copydoc KuduScanner::SetFaultTolerant
   Status SetFaultTolerant() WARN_UNUSED_RESULT;
 
@@ -1976,6 +2495,20 @@ class KUDU_EXPORT KuduScanTokenBuilder {
   /// @copydoc KuduScanner::SetTimeoutMillis
   Status SetTimeoutMillis(int millis) WARN_UNUSED_RESULT;
 
+  /// Set the approximate amount of data to scan per token.
+  ///
+  /// By default, Build() returns a token per tablet. With a split size set,
+  /// a tablet which holds more data gets several tokens, each covering a
+  /// consecutive range of its primary keys with about this much data. The
+  /// ranges are chosen by the tablet servers, from samples of the keys of
+  /// the tablets' on-disk data; data not yet flushed isn't accounted for.
+  ///
+  /// @param [in] split_size_bytes
+  ///   The target size of each token's data, in bytes. Use @c 0 to return
+  ///   a single token per tablet.
+  /// @return Operation result status.
+  Status SetSplitSizeBytes(uint64_t split_size_bytes) WARN_UNUSED_RESULT;
+
   /// Build the set of scan tokens.
   ///
   /// The builder may be reused after this call.
@@ -1998,6 +2531,94 @@ class KUDU_EXPORT KuduScanTokenBuilder {
   DISALLOW_COPY_AND_ASSIGN(KuduScanTokenBuilder);
 };
 
+/// @brief Scans the tablets of a table concurrently.
+///
+/// A KuduParallelScanner builds scan tokens with a KuduScanTokenBuilder and
+/// scans several of them at a time from background threads, each with its
+/// own KuduScanner. The batches are handed out through NextBatch(), either in
+/// the order they arrive or, if SetOrdered() is called, in the order of the
+/// tokens, i.e. by partition. At most SetMaxBufferedBatches() batches are
+/// buffered before the background scans pause.
+///
+/// Failover and retries of each tablet's scan work as for a single
+/// KuduScanner configured the same way. If a tablet's scan fails, NextBatch()
+/// returns its error and the scan should be closed.
+///
+/// @note This class is not thread-safe.
+class KUDU_EXPORT KuduParallelScanner {
+ public:
+  /// Construct an instance of the class.
+  ///
+  /// @param [in] builder
+  ///   The configuration of the scan. The given object must remain valid
+  ///   until Open() returns.
+  explicit KuduParallelScanner(KuduScanTokenBuilder* builder);
+
+  /// Close the scanner, if it is open, and release its resources.
+  ~KuduParallelScanner();
+
+  /// Set the number of tablets to scan concurrently. Default is 4.
+  ///
+  /// @param [in] num_tablets
+  ///   The number of concurrent tablet scans. Must be positive.
+  /// @return Operation result status.
+  Status SetParallelism(int num_tablets) WARN_UNUSED_RESULT;
+
+  /// Set the maximum number of batches to buffer. Default is 16.
+  ///
+  /// @param [in] max_batches
+  ///   The maximum number of batches buffered by the background scans before
+  ///   they wait for NextBatch() to catch up. Must be positive. An ordered
+  ///   scan may buffer up to twice as many, to make progress on the tablet
+  ///   whose batches are returned next.
+  /// @return Operation result status.
+  Status SetMaxBufferedBatches(int max_batches) WARN_UNUSED_RESULT;
+
+  /// Return the batches in the order of the tablets' partitions.
+  ///
+  /// By default, batches are returned as soon as any tablet's scan returns
+  /// them. If this method is called, all the batches of a tablet are returned
+  /// before those of the next tablet in partition order.
+  ///
+  /// @return Operation result status.
+  Status SetOrdered() WARN_UNUSED_RESULT;
+
+  /// Build the scan tokens and start scanning.
+  ///
+  /// @return Operation result status.
+  Status Open() WARN_UNUSED_RESULT;
+
+  /// Close the scanner, stopping the background scans.
+  ///
+  /// This releases resources on the servers. It is called automatically
+  /// upon destruction.
+  void Close();
+
+  /// Check whether there may be rows to be fetched from this scanner.
+  ///
+  /// @note Like KuduScanner::NextBatch(), NextBatch() may return an empty
+  ///   batch even if this method returned @c true.
+  ///
+  /// @return @c true if there may be rows to be fetched from this scanner.
+  bool HasMoreRows() const;
+
+  /// Get the next batch of rows, waiting for one if none is buffered.
+  ///
+  /// @param [out] batch
+  ///   Placeholder for the result. The batch remains valid until the next
+  ///   call to NextBatch() on it, or until this scanner is destroyed.
+  /// @return Operation result status.
+  Status NextBatch(KuduScanBatch* batch) WARN_UNUSED_RESULT;
+
+ private:
+  class KUDU_NO_EXPORT Data;
+
+  // Owned.
+  Data* data_;
+
+  DISALLOW_COPY_AND_ASSIGN(KuduParallelScanner);
+};
+
 } // namespace client
 } // namespace kudu
 #endif
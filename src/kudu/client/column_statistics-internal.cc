@@ -0,0 +1,109 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/client/column_statistics-internal.h"
+
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include "kudu/common/types.h"
+#include "kudu/gutil/strings/substitute.h"
+
+using std::string;
+using strings::Substitute;
+
+namespace kudu {
+namespace client {
+
+namespace {
+
+Schema RangeSchema(const ColumnSchema& col) {
+  return Schema({ ColumnSchema("min", col.type_info()->type(), true),
+                  ColumnSchema("max", col.type_info()->type(), true) }, 0);
+}
+
+template<typename T>
+T DecodeFixed(const string& encoded) {
+  T value;
+  memcpy(&value, encoded.data(), sizeof(value));
+  return value;
+}
+
+} // anonymous namespace
+
+KuduColumnStatistics::Data::Data(const ColumnSchema& col, ColumnStatisticsPB stats)
+    : column_name_(col.name()),
+      stats_(std::move(stats)),
+      range_schema_(RangeSchema(col)) {
+}
+
+KuduColumnStatistics::Data::~Data() {
+}
+
+Status KuduColumnStatistics::Data::Init() {
+  range_.reset(new KuduPartialRow(&range_schema_));
+  if (stats_.has_min_value() && stats_.has_max_value()) {
+    RETURN_NOT_OK(SetRangeValue(0, stats_.min_value()));
+    RETURN_NOT_OK(SetRangeValue(1, stats_.max_value()));
+  } else {
+    RETURN_NOT_OK(range_->SetNull(0));
+    RETURN_NOT_OK(range_->SetNull(1));
+  }
+  return Status::OK();
+}
+
+Status KuduColumnStatistics::Data::SetRangeValue(int idx, const string& encoded) {
+  const TypeInfo* type_info = range_schema_.column(idx).type_info();
+  if (type_info->physical_type() != BINARY && encoded.size() != type_info->size()) {
+    return Status::Corruption(
+        Substitute("invalid $0 statistics value of $1 bytes for column $2",
+                   type_info->name(), encoded.size(), column_name_));
+  }
+  switch (type_info->type()) {
+    case BOOL:
+      return range_->SetBool(idx, DecodeFixed<bool>(encoded));
+    case INT8:
+      return range_->SetInt8(idx, DecodeFixed<int8_t>(encoded));
+    case INT16:
+      return range_->SetInt16(idx, DecodeFixed<int16_t>(encoded));
+    case INT32:
+      return range_->SetInt32(idx, DecodeFixed<int32_t>(encoded));
+    case INT64:
+      return range_->SetInt64(idx, DecodeFixed<int64_t>(encoded));
+    case UNIXTIME_MICROS:
+      return range_->SetUnixTimeMicros(idx, DecodeFixed<int64_t>(encoded));
+    case DECIMAL32:
+      return range_->SetUnscaledDecimal(idx, DecodeFixed<int32_t>(encoded));
+    case DECIMAL64:
+      return range_->SetUnscaledDecimal(idx, DecodeFixed<int64_t>(encoded));
+    case FLOAT:
+      return range_->SetFloat(idx, DecodeFixed<float>(encoded));
+    case DOUBLE:
+      return range_->SetDouble(idx, DecodeFixed<double>(encoded));
+    case STRING:
+      return range_->SetStringCopy(idx, encoded);
+    case BINARY:
+      return range_->SetBinaryCopy(idx, encoded);
+    default:
+      return Status::NotSupported(
+          Substitute("statistics values of type $0 are not supported", type_info->name()));
+  }
+}
+
+} // namespace client
+} // namespace kudu
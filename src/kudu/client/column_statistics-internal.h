@@ -0,0 +1,59 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CLIENT_COLUMN_STATISTICS_INTERNAL_H
+#define KUDU_CLIENT_COLUMN_STATISTICS_INTERNAL_H
+
+#include <memory>
+#include <string>
+
+#include "kudu/client/client.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/common/partial_row.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/macros.h"
+
+namespace kudu {
+
+namespace client {
+
+class KuduColumnStatistics::Data {
+ public:
+  Data(const ColumnSchema& col, ColumnStatisticsPB stats);
+  ~Data();
+
+  // Decodes the range of 'stats_' into 'range_'.
+  Status Init();
+
+  const std::string column_name_;
+  const ColumnStatisticsPB stats_;
+
+  // The schema of 'range_': a nullable "min" and "max" column of the type of
+  // the column.
+  const Schema range_schema_;
+  std::unique_ptr<KuduPartialRow> range_;
+
+ private:
+  // Sets column 'idx' of 'range_' to the value encoded in 'encoded'.
+  Status SetRangeValue(int idx, const std::string& encoded);
+
+  DISALLOW_COPY_AND_ASSIGN(Data);
+};
+
+} // namespace client
+} // namespace kudu
+
+#endif
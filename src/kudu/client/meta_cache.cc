@@ -17,6 +17,7 @@
 
 #include "kudu/client/meta_cache.h"
 
+#include <algorithm>
 #include <boost/bind.hpp>
 #include <glog/logging.h>
 #include <mutex>
@@ -61,12 +62,25 @@ namespace internal {
 
 namespace {
 const int MAX_RETURNED_TABLE_LOCATIONS = 10;
+
+// The number of locations to request in a lookup with nothing cached for the
+// table yet, and in each page of MetaCache::PrefetchTableLocations(). A
+// client which just started using a table is likely to need many of them.
+const int MAX_RETURNED_TABLE_LOCATIONS_BULK = 1000;
+
+// The weight of each new sample in a tablet server's moving average latency.
+const double LATENCY_EWMA_WEIGHT = 0.2;
 } // anonymous namespace
 
 ////////////////////////////////////////////////////////////
 
 RemoteTabletServer::RemoteTabletServer(const master::TSInfoPB& pb)
-  : uuid_(pb.permanent_uuid()) {
+  : uuid_(pb.permanent_uuid()),
+    latency_ewma_us_(0),
+    rpcs_in_flight_(0),
+    write_rows_in_sidecars_unsupported_(false),
+    multi_tablet_writes_unsupported_(false),
+    write_backoff_until_(MonoTime::Min()) {
 
   Update(pb);
 }
@@ -139,6 +153,49 @@ const string& RemoteTabletServer::permanent_uuid() const {
   return uuid_;
 }
 
+void RemoteTabletServer::RpcStarted() {
+  rpcs_in_flight_.Increment();
+}
+
+void RemoteTabletServer::RpcFinished(const MonoDelta& latency) {
+  int32_t in_flight = rpcs_in_flight_.IncrementBy(-1);
+  DCHECK_GE(in_flight, 0);
+  double latency_us = latency.ToMicroseconds();
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (latency_ewma_us_ == 0) {
+    latency_ewma_us_ = latency_us;
+  } else {
+    latency_ewma_us_ += LATENCY_EWMA_WEIGHT * (latency_us - latency_ewma_us_);
+  }
+}
+
+void RemoteTabletServer::SetWriteBackoff(const MonoDelta& backoff) {
+  MonoTime until = MonoTime::Now() + backoff;
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (write_backoff_until_ < until) {
+    write_backoff_until_ = until;
+  }
+}
+
+MonoDelta RemoteTabletServer::WriteBackoff() const {
+  MonoTime now = MonoTime::Now();
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (write_backoff_until_ <= now) {
+    return MonoDelta::FromNanoseconds(0);
+  }
+  return write_backoff_until_ - now;
+}
+
+double RemoteTabletServer::LoadScore() const {
+  double latency_ewma_us;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    latency_ewma_us = latency_ewma_us_;
+  }
+  // Servers which were not used yet score lowest, so that they are tried.
+  return latency_ewma_us * (rpcs_in_flight_.Load() + 1);
+}
+
 shared_ptr<TabletServerServiceProxy> RemoteTabletServer::proxy() const {
   std::lock_guard<simple_spinlock> l(lock_);
   CHECK(proxy_);
@@ -268,6 +325,26 @@ void RemoteTablet::MarkTServerAsLeader(const RemoteTabletServer* server) {
                 << server->ToString() << ". Replicas: " << ReplicasAsStringUnlocked();
 }
 
+bool RemoteTablet::MarkTServerAsLeaderByUuid(const string& permanent_uuid) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  auto it = std::find_if(replicas_.begin(), replicas_.end(),
+                         [&](const RemoteReplica& replica) {
+                           return replica.ts->permanent_uuid() == permanent_uuid;
+                         });
+  if (it == replicas_.end()) {
+    return false;
+  }
+  for (RemoteReplica& replica : replicas_) {
+    if (&replica == &*it) {
+      replica.role = RaftPeerPB::LEADER;
+    } else if (replica.role == RaftPeerPB::LEADER) {
+      replica.role = RaftPeerPB::FOLLOWER;
+    }
+  }
+  VLOG(3) << "Latest replicas: " << ReplicasAsStringUnlocked();
+  return true;
+}
+
 void RemoteTablet::MarkTServerAsFollower(const RemoteTabletServer* server) {
   bool found = false;
   std::lock_guard<simple_spinlock> l(lock_);
@@ -526,7 +603,8 @@ class LookupRpc : public Rpc {
             scoped_refptr<RemoteTablet>* remote_tablet,
             const MonoTime& deadline,
             const shared_ptr<Messenger>& messenger,
-            bool is_exact_lookup);
+            bool is_exact_lookup,
+            int max_returned_locations);
   virtual ~LookupRpc();
   virtual void SendRpc() OVERRIDE;
   virtual string ToString() const OVERRIDE;
@@ -585,6 +663,16 @@ class LookupRpc : public Rpc {
   // partition key. If false, the next tablet after the partition key should be
   // returned if the partition key falls in a non-covered partition range.
   bool is_exact_lookup_;
+
+  // The number of locations to request, or 0 to pick based on what is
+  // already cached for the table.
+  int max_returned_locations_;
+
+  // Whether this lookup is registered as in-flight to the master, so that
+  // other lookups of the table may wait for it rather than send their own.
+  // It is registered under 'in_flight_partition_key_'.
+  bool in_flight_;
+  string in_flight_partition_key_;
 };
 
 LookupRpc::LookupRpc(const scoped_refptr<MetaCache>& meta_cache,
@@ -593,7 +681,8 @@ LookupRpc::LookupRpc(const scoped_refptr<MetaCache>& meta_cache,
                      scoped_refptr<RemoteTablet>* remote_tablet,
                      const MonoTime& deadline,
                      const shared_ptr<Messenger>& messenger,
-                     bool is_exact_lookup)
+                     bool is_exact_lookup,
+                     int max_returned_locations)
     : Rpc(deadline, messenger),
       meta_cache_(meta_cache),
       user_cb_(std::move(user_cb)),
@@ -601,7 +690,9 @@ LookupRpc::LookupRpc(const scoped_refptr<MetaCache>& meta_cache,
       partition_key_(std::move(partition_key)),
       remote_tablet_(remote_tablet),
       has_permit_(false),
-      is_exact_lookup_(is_exact_lookup) {
+      is_exact_lookup_(is_exact_lookup),
+      max_returned_locations_(max_returned_locations),
+      in_flight_(false) {
   DCHECK(deadline.Initialized());
 }
 
@@ -609,6 +700,10 @@ LookupRpc::~LookupRpc() {
   if (has_permit_) {
     meta_cache_->ReleaseMasterLookupPermit();
   }
+  if (in_flight_) {
+    // Now that the response is cached, resume the lookups waiting for it.
+    meta_cache_->FinishMasterLookup(table_->id(), in_flight_partition_key_);
+  }
 }
 
 void LookupRpc::SendRpc() {
@@ -638,6 +733,21 @@ void LookupRpc::SendRpc() {
   VLOG(4) << "Fast lookup: no cache entry for " << ToString()
           << ": refreshing our metadata from the Master";
 
+  // Rather than send another lookup of the table to the master, wait for
+  // the one in flight which is the likeliest to cover our partition key.
+  if (!in_flight_) {
+    if (meta_cache_->WaitForOrStartMasterLookup(this)) {
+      VLOG(4) << ToString() << ": waiting for a lookup of the table in flight";
+      return;
+    }
+    in_flight_ = true;
+    in_flight_partition_key_ = partition_key_;
+    if (max_returned_locations_ == 0) {
+      max_returned_locations_ = meta_cache_->HasCachedLocations(table_->id()) ?
+          MAX_RETURNED_TABLE_LOCATIONS : MAX_RETURNED_TABLE_LOCATIONS_BULK;
+    }
+  }
+
   if (!has_permit_) {
     has_permit_ = meta_cache_->AcquireMasterLookupPermit();
   }
@@ -651,7 +761,7 @@ void LookupRpc::SendRpc() {
   // Fill out the request.
   req_.mutable_table()->set_table_id(table_->id());
   req_.set_partition_key_start(partition_key_);
-  req_.set_max_returned_locations(MAX_RETURNED_TABLE_LOCATIONS);
+  req_.set_max_returned_locations(max_returned_locations_);
 
   // The end partition key is left unset intentionally so that we'll prefetch
   // some additional tablets.
@@ -897,7 +1007,8 @@ Status MetaCache::ProcessLookupResponse(const LookupRpc& rpc,
       InsertOrDie(&tablets_by_key, tablet_lower_bound, std::move(entry));
     }
 
-    if (!last_upper_bound.empty() && tablet_locations.size() < MAX_RETURNED_TABLE_LOCATIONS) {
+    if (!last_upper_bound.empty() &&
+        tablet_locations.size() < rpc.req().max_returned_locations()) {
       // There is a non-covered range between the last tablet and the end of the
       // partition key space, such as F.
 
@@ -958,6 +1069,31 @@ void MetaCache::ClearCache() {
   tablets_by_table_and_key_.clear();
 }
 
+void MetaCache::ClearRange(const string& table_id,
+                           const string& partition_key_start,
+                           const string& partition_key_end) {
+  VLOG(3) << "Clearing cache of table " << table_id << " in a partition key range";
+  std::lock_guard<rw_spinlock> l(lock_);
+  TabletMap* tablets_by_key = FindOrNull(tablets_by_table_and_key_, table_id);
+  if (!tablets_by_key) {
+    return;
+  }
+  auto it = tablets_by_key->upper_bound(partition_key_start);
+  if (it != tablets_by_key->begin()) {
+    const string& prev_end = std::prev(it)->second.upper_bound_partition_key();
+    if (prev_end.empty() || prev_end > partition_key_start) {
+      --it;
+    }
+  }
+  while (it != tablets_by_key->end() &&
+         (partition_key_end.empty() || it->first < partition_key_end)) {
+    if (!it->second.is_non_covered_range()) {
+      tablets_by_id_.erase(it->second.tablet()->tablet_id());
+    }
+    it = tablets_by_key->erase(it);
+  }
+}
+
 void MetaCache::LookupTabletByKey(const KuduTable* table,
                                   string partition_key,
                                   const MonoTime& deadline,
@@ -970,7 +1106,8 @@ void MetaCache::LookupTabletByKey(const KuduTable* table,
                                  remote_tablet,
                                  deadline,
                                  client_->data_->messenger_,
-                                 true);
+                                 true,
+                                 0);
   rpc->SendRpc();
 }
 
@@ -986,10 +1123,81 @@ void MetaCache::LookupTabletByKeyOrNext(const KuduTable* table,
                                  remote_tablet,
                                  deadline,
                                  client_->data_->messenger_,
-                                 false);
+                                 false,
+                                 0);
   rpc->SendRpc();
 }
 
+Status MetaCache::PrefetchTableLocations(const KuduTable* table, const MonoTime& deadline) {
+  string partition_key;
+  while (true) {
+    // Only the partition keys missing from the cache cost a master lookup,
+    // and each of those fetches a large page of locations.
+    scoped_refptr<RemoteTablet> tablet;
+    Synchronizer sync;
+    LookupRpc* rpc = new LookupRpc(this,
+                                   sync.AsStatusCallback(),
+                                   table,
+                                   partition_key,
+                                   &tablet,
+                                   deadline,
+                                   client_->data_->messenger_,
+                                   false,
+                                   MAX_RETURNED_TABLE_LOCATIONS_BULK);
+    rpc->SendRpc();
+    Status s = sync.Wait();
+    if (s.IsNotFound()) {
+      // No more tablets in the table.
+      return Status::OK();
+    }
+    RETURN_NOT_OK(s);
+    partition_key = tablet->partition().partition_key_end();
+    if (partition_key.empty()) {
+      return Status::OK();
+    }
+  }
+}
+
+bool MetaCache::HasCachedLocations(const string& table_id) {
+  shared_lock<rw_spinlock> l(lock_);
+  return ContainsKey(tablets_by_table_and_key_, table_id);
+}
+
+bool MetaCache::WaitForOrStartMasterLookup(LookupRpc* rpc) {
+  std::lock_guard<simple_spinlock> l(in_flight_lookups_lock_);
+  auto& lookups = in_flight_lookups_[rpc->table_id()];
+  // A lookup returns the locations from its partition key onwards, so wait
+  // for the in-flight one which starts closest before ours.
+  auto it = lookups.upper_bound(rpc->partition_key());
+  if (it != lookups.begin()) {
+    --it;
+    it->second.push_back(rpc);
+    return true;
+  }
+  InsertOrDie(&lookups, rpc->partition_key(), vector<LookupRpc*>());
+  return false;
+}
+
+void MetaCache::FinishMasterLookup(const string& table_id, const string& partition_key) {
+  vector<LookupRpc*> waiters;
+  {
+    std::lock_guard<simple_spinlock> l(in_flight_lookups_lock_);
+    auto& lookups = FindOrDie(in_flight_lookups_, table_id);
+    auto it = lookups.find(partition_key);
+    DCHECK(it != lookups.end());
+    waiters.swap(it->second);
+    lookups.erase(it);
+    if (lookups.empty()) {
+      in_flight_lookups_.erase(table_id);
+    }
+  }
+  // The waiters either find their tablets in the cache now, or send or wait
+  // for another lookup.
+  for (LookupRpc* waiter : waiters) {
+    waiter->SendRpc();
+  }
+}
+
 void MetaCache::MarkTSFailed(RemoteTabletServer* ts,
                              const Status& status) {
   LOG(INFO) << "Marking tablet server " << ts->ToString() << " as failed.";
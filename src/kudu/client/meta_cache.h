@@ -33,6 +33,7 @@
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/rpc/rpc.h"
 #include "kudu/util/async_util.h"
+#include "kudu/util/atomic.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/monotime.h"
@@ -56,6 +57,8 @@ class TSInfoPB;
 
 namespace client {
 
+class ClientTest_TestAlterPartitioningClearsOnlyAlteredRanges_Test;
+class ClientTest_TestBulkTabletLocationLookups_Test;
 class ClientTest_TestMasterLookupPermits_Test;
 class ClientTest_TestMetaCacheExpiry_Test;
 class KuduClient;
@@ -94,6 +97,41 @@ class RemoteTabletServer {
   // Returns the remote server's uuid.
   const std::string& permanent_uuid() const;
 
+  // Whether write requests to this server may carry their rows in RPC
+  // sidecars. True until the server rejects such a request.
+  bool supports_write_rows_in_sidecars() const {
+    return !write_rows_in_sidecars_unsupported_.Load();
+  }
+  void set_write_rows_in_sidecars_unsupported() {
+    write_rows_in_sidecars_unsupported_.Store(true);
+  }
+
+  // Whether this server accepts MultiWrite RPCs. True until the server
+  // rejects one.
+  bool supports_multi_tablet_writes() const {
+    return !multi_tablet_writes_unsupported_.Load();
+  }
+  void set_multi_tablet_writes_unsupported() {
+    multi_tablet_writes_unsupported_.Store(true);
+  }
+
+  // Holds back new writes to this server for 'backoff', as it asked while
+  // under memory pressure.
+  void SetWriteBackoff(const MonoDelta& backoff);
+
+  // Returns how much longer new writes to this server should be held back.
+  MonoDelta WriteBackoff() const;
+
+  // Record the start and the end of a read RPC to this server, which took
+  // 'latency'. Used for LEAST_LOADED_REPLICA selection.
+  void RpcStarted();
+  void RpcFinished(const MonoDelta& latency);
+
+  // The expected latency of a new read RPC to this server, in microseconds:
+  // the moving average of the observed latencies, scaled by the number of
+  // RPCs in flight. Lower is better.
+  double LoadScore() const;
+
  private:
   // Internal callback for DNS resolution.
   void DnsResolutionFinished(const HostPort& hp,
@@ -108,6 +146,18 @@ class RemoteTabletServer {
   std::vector<HostPort> rpc_hostports_;
   std::shared_ptr<tserver::TabletServerServiceProxy> proxy_;
 
+  // Exponentially weighted moving average of the read RPC latencies, in
+  // microseconds. Protected by 'lock_'.
+  double latency_ewma_us_;
+  AtomicInt<int32_t> rpcs_in_flight_;
+
+  AtomicBool write_rows_in_sidecars_unsupported_;
+  AtomicBool multi_tablet_writes_unsupported_;
+
+  // Until when new writes to this server should be held back. Protected by
+  // 'lock_'.
+  MonoTime write_backoff_until_;
+
   DISALLOW_COPY_AND_ASSIGN(RemoteTabletServer);
 };
 
@@ -233,6 +283,11 @@ class RemoteTablet : public RefCountedThreadSafe<RemoteTablet> {
   // Mark the specified tablet server as a follower in the cache.
   void MarkTServerAsFollower(const RemoteTabletServer* server);
 
+  // Mark the replica with the given permanent UUID as the leader in the
+  // cache, as hinted by a replica which rejected a write. Returns false if
+  // no replica in the cache has that UUID, e.g. because the config changed.
+  bool MarkTServerAsLeaderByUuid(const std::string& permanent_uuid);
+
   // Return stringified representation of the list of replicas for this tablet.
   std::string ReplicasAsString() const;
 
@@ -377,9 +432,20 @@ class MetaCache : public RefCountedThreadSafe<MetaCache> {
                                scoped_refptr<RemoteTablet>* remote_tablet,
                                const StatusCallback& callback);
 
+  // Fetch the locations of all the tablets of 'table' which aren't cached
+  // yet, with as few master lookups as possible.
+  Status PrefetchTableLocations(const KuduTable* table, const MonoTime& deadline);
+
   // Clears the meta cache.
   void ClearCache();
 
+  // Clears the cached tablets and non-covered ranges of table 'table_id'
+  // which overlap the partition key range [partition_key_start,
+  // partition_key_end). An empty 'partition_key_end' is unbounded.
+  void ClearRange(const std::string& table_id,
+                  const std::string& partition_key_start,
+                  const std::string& partition_key_end);
+
   // Mark any replicas of any tablets hosted by 'ts' as failed. They will
   // not be returned in future cache lookups.
   void MarkTSFailed(RemoteTabletServer* ts, const Status& status);
@@ -394,6 +460,8 @@ class MetaCache : public RefCountedThreadSafe<MetaCache> {
  private:
   friend class LookupRpc;
 
+  FRIEND_TEST(client::ClientTest, TestAlterPartitioningClearsOnlyAlteredRanges);
+  FRIEND_TEST(client::ClientTest, TestBulkTabletLocationLookups);
   FRIEND_TEST(client::ClientTest, TestMasterLookupPermits);
   FRIEND_TEST(client::ClientTest, TestMetaCacheExpiry);
 
@@ -407,6 +475,23 @@ class MetaCache : public RefCountedThreadSafe<MetaCache> {
                                  const std::string& partition_key,
                                  MetaCacheEntry* entry);
 
+  // Whether any locations of the table with id 'table_id' are cached.
+  bool HasCachedLocations(const std::string& table_id);
+
+  // Concurrent lookups of a table which miss the cache are coalesced: when a
+  // lookup is about to be sent to the master while another of the same table
+  // is in flight from a partition key at or before its own, it waits for that
+  // one instead, and then retries the cache.
+  //
+  // If such a lookup is in flight, queues 'rpc' to be resent once it
+  // finishes and returns true. Otherwise, registers 'rpc' as in flight and
+  // returns false.
+  bool WaitForOrStartMasterLookup(LookupRpc* rpc);
+
+  // Unregisters a lookup registered by WaitForOrStartMasterLookup(), and
+  // resends the lookups waiting for it.
+  void FinishMasterLookup(const std::string& table_id, const std::string& partition_key);
+
   // Update our information about the given tablet server.
   //
   // This is called when we get some response from the master which contains
@@ -447,6 +532,14 @@ class MetaCache : public RefCountedThreadSafe<MetaCache> {
   // permits have been acquired.
   Semaphore master_lookup_sem_;
 
+  // The lookups in flight to the master, keyed by table id and then by
+  // partition key, with the lookups waiting for each of them.
+  //
+  // Protected by in_flight_lookups_lock_.
+  simple_spinlock in_flight_lookups_lock_;
+  std::unordered_map<std::string, std::map<std::string, std::vector<LookupRpc*>>>
+      in_flight_lookups_;
+
   DISALLOW_COPY_AND_ASSIGN(MetaCache);
 };
 
@@ -0,0 +1,245 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/client/parallel_scanner-internal.h"
+
+#include <boost/bind.hpp>
+#include <glog/logging.h>
+
+#include "kudu/gutil/strings/substitute.h"
+
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace client {
+
+KuduParallelScanner::Data::Data(KuduScanTokenBuilder* builder)
+    : builder_(DCHECK_NOTNULL(builder)),
+      parallelism_(4),
+      max_buffered_batches_(16),
+      ordered_(false),
+      open_(false),
+      cond_(&lock_),
+      next_scan_idx_(0),
+      num_buffered_batches_(0),
+      closing_(false) {
+}
+
+KuduParallelScanner::Data::~Data() {
+  Close();
+}
+
+Status KuduParallelScanner::Data::SetParallelism(int num_tablets) {
+  if (num_tablets <= 0) {
+    return Status::InvalidArgument(
+        Substitute("Parallelism must be positive, got $0", num_tablets));
+  }
+  parallelism_ = num_tablets;
+  return Status::OK();
+}
+
+Status KuduParallelScanner::Data::SetMaxBufferedBatches(int max_batches) {
+  if (max_batches <= 0) {
+    return Status::InvalidArgument(
+        Substitute("Maximum number of buffered batches must be positive, got $0", max_batches));
+  }
+  max_buffered_batches_ = max_batches;
+  return Status::OK();
+}
+
+Status KuduParallelScanner::Data::Open() {
+  CHECK(!open_) << "Scanner already open";
+  vector<KuduScanToken*> tokens;
+  RETURN_NOT_OK(builder_->Build(&tokens));
+  builder_ = nullptr;
+  for (KuduScanToken* token : tokens) {
+    unique_ptr<TabletScan> scan(new TabletScan);
+    scan->token.reset(token);
+    scans_.emplace_back(std::move(scan));
+  }
+
+  RETURN_NOT_OK(ThreadPoolBuilder("parallel-scan")
+                .set_min_threads(0)
+                .set_max_threads(parallelism_)
+                .Build(&pool_));
+  open_ = true;
+  // The pool runs the scans in submission order, so the tablet whose
+  // batches are returned next in an ordered scan is always running or done.
+  for (const auto& scan : scans_) {
+    Status s = pool_->SubmitFunc(boost::bind(&Data::ScanTablet, this, scan.get()));
+    if (PREDICT_FALSE(!s.ok())) {
+      Close();
+      return s;
+    }
+  }
+  return Status::OK();
+}
+
+void KuduParallelScanner::Data::Close() {
+  if (!open_) {
+    return;
+  }
+  {
+    MutexLock l(lock_);
+    closing_ = true;
+    cond_.Broadcast();
+  }
+  pool_->Shutdown();
+  open_ = false;
+}
+
+bool KuduParallelScanner::Data::HasMoreRows() const {
+  CHECK(open_);
+  MutexLock l(lock_);
+  return !AllDoneUnlocked();
+}
+
+Status KuduParallelScanner::Data::NextBatch(unique_ptr<KuduScanBatch>* batch) {
+  CHECK(open_);
+  MutexLock l(lock_);
+  while (true) {
+    if (ordered_) {
+      // Drain the scans one at a time, in order.
+      while (next_scan_idx_ < scans_.size()) {
+        TabletScan* scan = scans_[next_scan_idx_].get();
+        if (!scan->batches.empty()) {
+          break;
+        }
+        if (!scan->done) {
+          break;
+        }
+        RETURN_NOT_OK(scan->status);
+        next_scan_idx_++;
+        // The next scan may now buffer beyond the shared limit.
+        cond_.Broadcast();
+      }
+      if (next_scan_idx_ < scans_.size() &&
+          !scans_[next_scan_idx_]->batches.empty()) {
+        TabletScan* scan = scans_[next_scan_idx_].get();
+        *batch = std::move(scan->batches.front());
+        scan->batches.pop_front();
+        num_buffered_batches_--;
+        cond_.Broadcast();
+        return Status::OK();
+      }
+    } else {
+      // Return any buffered batch, favoring the earliest scans so that they
+      // finish and free their threads for the remaining tablets.
+      bool all_done = true;
+      for (size_t i = next_scan_idx_; i < scans_.size(); i++) {
+        TabletScan* scan = scans_[i].get();
+        if (!scan->batches.empty()) {
+          *batch = std::move(scan->batches.front());
+          scan->batches.pop_front();
+          num_buffered_batches_--;
+          cond_.Broadcast();
+          return Status::OK();
+        }
+        RETURN_NOT_OK(scan->status);
+        if (scan->done && all_done) {
+          // Every scan up to this one has returned all its batches.
+          next_scan_idx_ = i + 1;
+        } else {
+          all_done = false;
+        }
+      }
+    }
+
+    if (AllDoneUnlocked()) {
+      batch->reset();
+      return Status::OK();
+    }
+    cond_.Wait();
+  }
+}
+
+void KuduParallelScanner::Data::ScanTablet(TabletScan* scan) {
+  Status s = DoScanTablet(scan);
+  if (scan->scanner) {
+    scan->scanner->Close();
+  }
+  if (!s.ok()) {
+    LOG(WARNING) << "Scan of tablet " << scan->token->tablet().id()
+                 << " failed: " << s.ToString();
+  }
+  MutexLock l(lock_);
+  scan->status = s;
+  scan->done = true;
+  cond_.Broadcast();
+}
+
+Status KuduParallelScanner::Data::DoScanTablet(TabletScan* scan) {
+  {
+    MutexLock l(lock_);
+    if (closing_) {
+      return Status::Aborted("Scanner closed");
+    }
+  }
+  KuduScanner* scanner;
+  RETURN_NOT_OK(scan->token->IntoKuduScanner(&scanner));
+  scan->scanner.reset(scanner);
+  RETURN_NOT_OK(scanner->Open());
+
+  while (scanner->HasMoreRows()) {
+    unique_ptr<KuduScanBatch> batch(new KuduScanBatch);
+    RETURN_NOT_OK(scanner->NextBatch(batch.get()));
+    if (batch->NumRows() == 0) {
+      continue;
+    }
+    MutexLock l(lock_);
+    while (!closing_ && !CanBufferUnlocked(*scan)) {
+      cond_.Wait();
+    }
+    if (closing_) {
+      return Status::Aborted("Scanner closed");
+    }
+    scan->batches.emplace_back(std::move(batch));
+    num_buffered_batches_++;
+    cond_.Broadcast();
+  }
+  return Status::OK();
+}
+
+bool KuduParallelScanner::Data::CanBufferUnlocked(const TabletScan& scan) const {
+  lock_.AssertAcquired();
+  if (num_buffered_batches_ < max_buffered_batches_) {
+    return true;
+  }
+  // In an ordered scan, the scan whose batches are returned next must make
+  // progress even if the later scans filled the buffer, but it is bounded by
+  // the same limit on its own.
+  return ordered_ &&
+      next_scan_idx_ < scans_.size() &&
+      scans_[next_scan_idx_].get() == &scan &&
+      static_cast<int>(scan.batches.size()) < max_buffered_batches_;
+}
+
+bool KuduParallelScanner::Data::AllDoneUnlocked() const {
+  lock_.AssertAcquired();
+  for (size_t i = next_scan_idx_; i < scans_.size(); i++) {
+    const TabletScan& scan = *scans_[i];
+    if (!scan.done || !scan.batches.empty() || !scan.status.ok()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace client
+} // namespace kudu
@@ -0,0 +1,127 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "kudu/client/client.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/mutex.h"
+#include "kudu/util/status.h"
+#include "kudu/util/threadpool.h"
+
+namespace kudu {
+namespace client {
+
+class KuduParallelScanner::Data {
+ public:
+  explicit Data(KuduScanTokenBuilder* builder);
+  ~Data();
+
+  Status SetParallelism(int num_tablets);
+
+  Status SetMaxBufferedBatches(int max_batches);
+
+  void SetOrdered() {
+    ordered_ = true;
+  }
+
+  Status Open();
+
+  void Close();
+
+  bool HasMoreRows() const;
+
+  // Waits for the next batch to return, or for all the tablets to be done.
+  // Sets 'batch' to the next batch, or to nullptr if there are no more.
+  Status NextBatch(std::unique_ptr<KuduScanBatch>* batch);
+
+ private:
+  // The scan of one tablet, by one of the pool's threads.
+  struct TabletScan {
+    std::unique_ptr<KuduScanToken> token;
+
+    // The scanner is kept until destruction, since the batches it returned
+    // refer to its projection.
+    std::unique_ptr<KuduScanner> scanner;
+
+    // Batches returned by the scanner and not yet taken by NextBatch().
+    std::deque<std::unique_ptr<KuduScanBatch>> batches;
+
+    // Whether the scan finished, successfully or not.
+    bool done = false;
+
+    // The error which stopped the scan, if any.
+    Status status;
+  };
+
+  // Scans the tablet of 'scan', buffering its batches. Runs on 'pool_'.
+  void ScanTablet(TabletScan* scan);
+
+  // Opens the scanner of 'scan' and buffers its batches, until the scan is
+  // done or the scanner is closed.
+  Status DoScanTablet(TabletScan* scan);
+
+  // Whether the thread scanning 'scan' may buffer another batch.
+  //
+  // REQUIRES: 'lock_' is held.
+  bool CanBufferUnlocked(const TabletScan& scan) const;
+
+  // Whether all the batches of all the tablets were returned.
+  //
+  // REQUIRES: 'lock_' is held.
+  bool AllDoneUnlocked() const;
+
+  // Not owned. Only used until Open().
+  KuduScanTokenBuilder* builder_;
+
+  int parallelism_;
+  int max_buffered_batches_;
+  bool ordered_;
+  bool open_;
+
+  gscoped_ptr<ThreadPool> pool_;
+
+  // Protects the members below, and the batches and state of each TabletScan.
+  mutable Mutex lock_;
+
+  // Signalled when a batch is buffered or taken, when a tablet scan is done,
+  // and on Close().
+  ConditionVariable cond_;
+
+  // The scans, in the order of their tokens, i.e. by partition.
+  std::vector<std::unique_ptr<TabletScan>> scans_;
+
+  // The index of the first scan which may still have batches to return.
+  size_t next_scan_idx_;
+
+  // The total number of batches buffered by all the scans.
+  int num_buffered_batches_;
+
+  // Set by Close() to stop the background scans.
+  bool closing_;
+
+  DISALLOW_COPY_AND_ASSIGN(Data);
+};
+
+} // namespace client
+} // namespace kudu
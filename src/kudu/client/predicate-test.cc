@@ -32,6 +32,7 @@
 #include "kudu/util/test_util.h"
 
 using std::count_if;
+using std::find;
 using std::numeric_limits;
 using std::string;
 using std::unique_ptr;
@@ -288,6 +289,67 @@ class PredicateTest : public KuduTest {
         }));
       }
     }
+
+    { // value IN (test_values)
+      int count = count_if(values.begin(), values.end(), [&] (T value) {
+          return find(test_values.begin(), test_values.end(), value) != test_values.end();
+      });
+      vector<KuduValue*> in_list;
+      for (T v : test_values) {
+        in_list.push_back(KuduValue::FromInt(v));
+      }
+      ASSERT_EQ(count, CountRows(table, { table->NewInListPredicate("value", &in_list) }));
+    }
+
+    { // value IN (test_values)
+      // value >= 0
+      int count = count_if(values.begin(), values.end(), [&] (T value) {
+          return value >= 0 &&
+                 find(test_values.begin(), test_values.end(), value) != test_values.end();
+      });
+      vector<KuduValue*> in_list;
+      for (T v : test_values) {
+        in_list.push_back(KuduValue::FromInt(v));
+      }
+      ASSERT_EQ(count, CountRows(table, {
+            table->NewInListPredicate("value", &in_list),
+            table->NewComparisonPredicate("value",
+                                          KuduPredicate::GREATER_EQUAL,
+                                          KuduValue::FromInt(0)),
+      }));
+    }
+
+    { // value IN ()
+      vector<KuduValue*> in_list;
+      ASSERT_EQ(0, CountRows(table, { table->NewInListPredicate("value", &in_list) }));
+    }
+
+    { // key IN (0, 5, values.size() + 100)
+      vector<KuduValue*> in_list = {
+        KuduValue::FromInt(0),
+        KuduValue::FromInt(5),
+        KuduValue::FromInt(values.size() + 100),
+      };
+      ASSERT_EQ(2, CountRows(table, { table->NewInListPredicate("key", &in_list) }));
+    }
+
+    { // value IS NULL
+      ASSERT_EQ(1, CountRows(table, { table->NewIsNullPredicate("value") }));
+    }
+
+    { // value IS NULL
+      // value >= 0
+      ASSERT_EQ(0, CountRows(table, {
+            table->NewIsNullPredicate("value"),
+            table->NewComparisonPredicate("value",
+                                          KuduPredicate::GREATER_EQUAL,
+                                          KuduValue::FromInt(0)),
+      }));
+    }
+
+    { // key IS NULL
+      ASSERT_EQ(0, CountRows(table, { table->NewIsNullPredicate("key") }));
+    }
   }
 
   // Check string predicates against the specified table.
@@ -383,6 +445,21 @@ class PredicateTest : public KuduTest {
         }));
       }
     }
+
+    { // value IN (test_values)
+      int count = count_if(values.begin(), values.end(), [&] (const string& value) {
+          return find(test_values.begin(), test_values.end(), value) != test_values.end();
+      });
+      vector<KuduValue*> in_list;
+      for (const string& v : test_values) {
+        in_list.push_back(KuduValue::CopyString(v));
+      }
+      ASSERT_EQ(count, CountRows(table, { table->NewInListPredicate("value", &in_list) }));
+    }
+
+    { // value IS NULL
+      ASSERT_EQ(1, CountRows(table, { table->NewIsNullPredicate("value") }));
+    }
   }
 
   shared_ptr<KuduClient> client_;
@@ -54,6 +54,71 @@ const KuduSchema* KuduScanBatch::projection_schema() const {
   return data_->client_projection_;
 }
 
+Status KuduScanBatch::GetFixedLengthColumn(int idx, Slice* data) const {
+  RETURN_NOT_OK(data_->CheckColumnarColumn(idx));
+  const ColumnSchema& col = data_->projection_->column(idx);
+  if (PREDICT_FALSE(col.type_info()->physical_type() == BINARY)) {
+    return Status::InvalidArgument("column is variable-length", col.ToString());
+  }
+  *data = data_->columns_[idx].data;
+  return Status::OK();
+}
+
+Status KuduScanBatch::GetVariableLengthColumn(int idx, Slice* offsets, Slice* data) const {
+  RETURN_NOT_OK(data_->CheckColumnarColumn(idx));
+  const ColumnSchema& col = data_->projection_->column(idx);
+  if (PREDICT_FALSE(col.type_info()->physical_type() != BINARY)) {
+    return Status::InvalidArgument("column is not variable-length", col.ToString());
+  }
+  data_->GetVariableLengthColumn(idx, offsets, data);
+  return Status::OK();
+}
+
+Status KuduScanBatch::GetDictionaryEncodedColumn(int idx, Slice* codes, Slice* dict_offsets,
+                                                 Slice* dict_data) const {
+  RETURN_NOT_OK(data_->CheckColumnarColumn(idx));
+  const ColumnSchema& col = data_->projection_->column(idx);
+  if (PREDICT_FALSE(col.type_info()->physical_type() != BINARY)) {
+    return Status::InvalidArgument("column is not variable-length", col.ToString());
+  }
+  const ColumnarColumnSlices& slices = data_->columns_[idx];
+  if (slices.dictionary_offsets.empty()) {
+    return Status::NotFound("column is not dictionary-encoded in this batch", col.ToString());
+  }
+  *codes = slices.data;
+  *dict_offsets = slices.dictionary_offsets;
+  *dict_data = slices.varlen_data;
+  return Status::OK();
+}
+
+Status KuduScanBatch::GetNonNullBitmapForColumn(int idx, Slice* data) const {
+  RETURN_NOT_OK(data_->CheckColumnarColumn(idx));
+  *data = data_->columns_[idx].non_null_bitmap;
+  return Status::OK();
+}
+
+Status KuduScanBatch::GetRowwiseColumn(int idx, const uint8_t** cells,
+                                       const uint8_t** null_bitmaps, size_t* stride) const {
+  if (PREDICT_FALSE(data_->columnar_)) {
+    return Status::IllegalState("batch is in the columnar layout");
+  }
+  const Schema& projection = *data_->projection_;
+  if (PREDICT_FALSE(idx < 0 || idx >= projection.num_columns())) {
+    return Status::InvalidArgument(Substitute("invalid column index: $0", idx));
+  }
+  *stride = data_->projected_row_size_;
+  if (PREDICT_FALSE(NumRows() == 0)) {
+    *cells = nullptr;
+    *null_bitmaps = nullptr;
+    return Status::OK();
+  }
+  const uint8_t* first_row = data_->direct_data_.data();
+  *cells = first_row + projection.column_offset(idx);
+  *null_bitmaps = projection.column(idx).is_nullable() ? first_row + projection.byte_size()
+                                                       : nullptr;
+  return Status::OK();
+}
+
 ////////////////////////////////////////////////////////////
 // KuduScanBatch::RowPtr
 ////////////////////////////////////////////////////////////
@@ -187,6 +252,22 @@ Status KuduScanBatch::RowPtr::GetBinary(int col_idx, Slice* val) const {
   return Get<TypeTraits<BINARY> >(col_idx, val);
 }
 
+Status KuduScanBatch::RowPtr::GetUnscaledDecimal(const Slice& col_name, int64_t* val) const {
+  int col_idx;
+  RETURN_NOT_OK(FindColumn(*schema_, col_name, &col_idx));
+  return GetUnscaledDecimal(col_idx, val);
+}
+
+Status KuduScanBatch::RowPtr::GetUnscaledDecimal(int col_idx, int64_t* val) const {
+  if (schema_->column(col_idx).type_info()->type() == DECIMAL32) {
+    int32_t val32;
+    RETURN_NOT_OK(Get<TypeTraits<DECIMAL32> >(col_idx, &val32));
+    *val = val32;
+    return Status::OK();
+  }
+  return Get<TypeTraits<DECIMAL64> >(col_idx, val);
+}
+
 template<typename T>
 Status KuduScanBatch::RowPtr::Get(const Slice& col_name, typename T::cpp_type* val) const {
   int col_idx;
@@ -284,6 +365,12 @@ Status KuduScanBatch::RowPtr::Get<TypeTraits<STRING> >(int col_idx, Slice* val)
 template
 Status KuduScanBatch::RowPtr::Get<TypeTraits<BINARY> >(int col_idx, Slice* val) const;
 
+template
+Status KuduScanBatch::RowPtr::Get<TypeTraits<DECIMAL32> >(int col_idx, int32_t* val) const;
+
+template
+Status KuduScanBatch::RowPtr::Get<TypeTraits<DECIMAL64> >(int col_idx, int64_t* val) const;
+
 string KuduScanBatch::RowPtr::ToString() const {
   string ret;
   ret.append("(");
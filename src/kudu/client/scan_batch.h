@@ -99,6 +99,9 @@ class KUDU_EXPORT KuduScanBatch {
 
   /// Get a row at the specified index.
   ///
+  /// @note Rows may not be accessed in batches returned in the columnar
+  ///   layout (see KuduScanner::COLUMNAR_LAYOUT).
+  ///
   /// @param [in] idx
   ///   The index of the row to return.
   /// @return A reference to one of the rows in this batch.
@@ -116,9 +119,108 @@ class KUDU_EXPORT KuduScanBatch {
   ///   to have this schema.
   const KuduSchema* projection_schema() const;
 
+  /// @name Accessors for batches in the columnar layout.
+  ///
+  /// These may only be used if the scanner was configured with the
+  /// KuduScanner::COLUMNAR_LAYOUT row format flag. The returned slices point
+  /// directly into the data received from the tablet server: they are not
+  /// copied, and are valid only for as long as this batch is valid and has
+  /// not been used for a new KuduScanner::NextBatch() call.
+  ///
+  /// Each buffer is 8-byte aligned relative to the start of the data
+  /// received from the server, but callers must not rely on any absolute
+  /// alignment of the returned pointers.
+  ///
+  /// @param [in] idx
+  ///   The index of the column in the projection schema.
+  /// @return Operation result status. Returns a bad Status if the batch is
+  ///   not in the columnar layout, the column index is out of range, or the
+  ///   column type does not match the accessor.
+  ///
+  ///@{
+
+  /// Get the cells of a fixed-width column.
+  ///
+  /// @param [out] data
+  ///   The NumRows() cells of the column, packed back to back in their
+  ///   native in-memory representation. The contents of NULL cells are
+  ///   undefined.
+  Status GetFixedLengthColumn(int idx, Slice* data) const WARN_UNUSED_RESULT;
+
+  /// Get the cells of a STRING or BINARY column.
+  ///
+  /// If the column was sent dictionary-encoded, it is decoded into a buffer
+  /// owned by the batch on the first call.
+  ///
+  /// @param [out] offsets
+  ///   NumRows() + 1 uint32_t offsets into @c data. The value of row @c i
+  ///   occupies the range [offsets[i], offsets[i + 1]) of @c data.
+  ///   NULL cells have zero length.
+  /// @param [out] data
+  ///   The concatenated values of the column.
+  Status GetVariableLengthColumn(int idx, Slice* offsets, Slice* data)
+      const WARN_UNUSED_RESULT;
+
+  /// Get the dictionary codes of a STRING or BINARY column, if the tablet
+  /// server sent the column dictionary-encoded (see
+  /// KuduScanner::COLUMNAR_DICTIONARY). Unlike GetVariableLengthColumn(),
+  /// this doesn't decode the column.
+  ///
+  /// @param [out] codes
+  ///   NumRows() uint32_t codes, indexing the dictionary. The codes of NULL
+  ///   cells are undefined.
+  /// @param [out] dict_offsets
+  ///   The offsets of the dictionary values into @c dict_data, one more
+  ///   than the number of values. The value of code @c c occupies the range
+  ///   [dict_offsets[c], dict_offsets[c + 1]) of @c dict_data.
+  /// @param [out] dict_data
+  ///   The concatenated values of the dictionary.
+  /// @return Status::NotFound() if the column isn't dictionary-encoded in
+  ///   this batch, in which case GetVariableLengthColumn() must be used.
+  Status GetDictionaryEncodedColumn(int idx, Slice* codes, Slice* dict_offsets,
+                                    Slice* dict_data) const WARN_UNUSED_RESULT;
+
+  /// Get the non-NULL bitmap of a column.
+  ///
+  /// @param [out] data
+  ///   A bitmap with one bit per row, starting with the least significant
+  ///   bit of the first byte, in which a set bit indicates that the cell is
+  ///   not NULL. Empty if the column is not nullable.
+  Status GetNonNullBitmapForColumn(int idx, Slice* data) const WARN_UNUSED_RESULT;
+  ///@}
+
+  /// Get a strided view of a column of a batch in the row-wise layout.
+  ///
+  /// This gives bulk consumers access to the cells in place, without the
+  /// per-cell type and NULL checks of the KuduScanBatch::RowPtr getters.
+  /// The returned pointers are valid only for as long as this batch is valid
+  /// and has not been used for a new KuduScanner::NextBatch() call.
+  ///
+  /// @param [in] idx
+  ///   The index of the column in the projection schema.
+  /// @param [out] cells
+  ///   The cell of the first row, in the native in-memory representation of
+  ///   the column's type. The cell of row @c i starts @c i * @c stride bytes
+  ///   after it. Cells of STRING and BINARY columns are Slice objects
+  ///   pointing into the batch's data. The contents of NULL cells are
+  ///   undefined.
+  /// @param [out] null_bitmaps
+  ///   If the column is nullable, the NULL bitmap of the first row, and NULL
+  ///   otherwise. The bitmap of row @c i starts @c i * @c stride bytes after
+  ///   it, and bit @c idx of it, starting with the least significant bit of
+  ///   the first byte, is set iff the cell is NULL.
+  /// @param [out] stride
+  ///   The number of bytes between consecutive rows.
+  /// @return Operation result status. Returns a bad Status if the batch is
+  ///   in the columnar layout or the column index is out of range.
+  Status GetRowwiseColumn(int idx, const uint8_t** cells, const uint8_t** null_bitmaps,
+                          size_t* stride) const WARN_UNUSED_RESULT;
+
  private:
   class KUDU_NO_EXPORT Data;
+  friend class KuduParallelScanner;
   friend class KuduScanner;
+  friend class KuduTable;
   friend class tools::ReplicaDumper;
 
   Data* data_;
@@ -197,6 +299,21 @@ class KUDU_EXPORT KuduScanBatch::RowPtr {
   Status GetDouble(int col_idx, double* val) const WARN_UNUSED_RESULT;
   ///@}
 
+  /// @name Getters for decimal columns.
+  ///
+  /// Get the unscaled value of a decimal column by name or index: for
+  /// example, 12.34 in a column with a scale of 2 is returned as 1234.
+  ///
+  /// @return Operation result status. Return a bad Status if at least one
+  ///   of the following is @c true:
+  ///     @li The column is not a decimal.
+  ///     @li The value is @c NULL.
+  ///
+  ///@{
+  Status GetUnscaledDecimal(const Slice& col_name, int64_t* val) const WARN_UNUSED_RESULT;
+  Status GetUnscaledDecimal(int col_idx, int64_t* val) const WARN_UNUSED_RESULT;
+  ///@}
+
   /// @name Getters for string/binary column by column name.
   ///
   /// Get the string/binary value for a column by its name.
@@ -17,6 +17,7 @@
 
 #include "kudu/client/scan_configuration.h"
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <vector>
@@ -38,11 +39,16 @@ ScanConfiguration::ScanConfiguration(KuduTable* table)
       client_projection_(*table->schema().schema_),
       has_batch_size_bytes_(false),
       batch_size_bytes_(0),
+      prefetch_budget_bytes_(0),
       selection_(KuduClient::CLOSEST_REPLICA),
       read_mode_(KuduScanner::READ_LATEST),
       is_fault_tolerant_(false),
+      is_reverse_ordered_(false),
+      limit_(-1),
       snapshot_timestamp_(kNoTimestamp),
       timeout_(MonoDelta::FromMilliseconds(KuduScanner::kScanTimeoutMillis)),
+      row_format_flags_(KuduScanner::NO_FLAGS),
+      profiling_enabled_(false),
       arena_(1024, 1024 * 1024) {
 }
 
@@ -62,6 +68,19 @@ Status ScanConfiguration::SetProjectedColumnNames(const vector<string>& col_name
 }
 
 Status ScanConfiguration::SetProjectedColumnIndexes(const vector<int>& col_indexes) {
+  if (!aggregates_.empty()) {
+    return Status::IllegalState(
+        "The projection of a scan with aggregates consists of the aggregated columns");
+  }
+  unique_ptr<Schema> s;
+  RETURN_NOT_OK(CreateProjection(col_indexes, &s));
+  projection_ = pool_.Add(s.release());
+  client_projection_ = KuduSchema(*projection_);
+  return Status::OK();
+}
+
+Status ScanConfiguration::CreateProjection(const vector<int>& col_indexes,
+                                           unique_ptr<Schema>* projection) const {
   const Schema* table_schema = table_->schema().schema_;
   vector<ColumnSchema> cols;
   cols.reserve(col_indexes.size());
@@ -75,8 +94,7 @@ Status ScanConfiguration::SetProjectedColumnIndexes(const vector<int>& col_index
 
   unique_ptr<Schema> s(new Schema());
   RETURN_NOT_OK(s->Reset(cols, 0));
-  projection_ = pool_.Add(s.release());
-  client_projection_ = KuduSchema(*projection_);
+  *projection = std::move(s);
   return Status::OK();
 }
 
@@ -143,6 +161,11 @@ Status ScanConfiguration::SetBatchSizeBytes(uint32_t batch_size) {
   return Status::OK();
 }
 
+Status ScanConfiguration::SetPrefetchBudgetBytes(uint32_t budget_bytes) {
+  prefetch_budget_bytes_ = budget_bytes;
+  return Status::OK();
+}
+
 Status ScanConfiguration::SetSelection(KuduClient::ReplicaSelection selection) {
   selection_ = selection;
   return Status::OK();
@@ -153,12 +176,32 @@ Status ScanConfiguration::SetReadMode(KuduScanner::ReadMode read_mode) {
   return Status::OK();
 }
 
+Status ScanConfiguration::SetMaxStalenessMillis(int millis) {
+  if (millis < 0) {
+    return Status::InvalidArgument("Maximum staleness must not be negative");
+  }
+  max_staleness_ = MonoDelta::FromMilliseconds(millis);
+  return Status::OK();
+}
+
 Status ScanConfiguration::SetFaultTolerant(bool fault_tolerant) {
   RETURN_NOT_OK(SetReadMode(KuduScanner::READ_AT_SNAPSHOT));
   is_fault_tolerant_ = true;
   return Status::OK();
 }
 
+void ScanConfiguration::SetReverseOrdered(bool reverse_ordered) {
+  is_reverse_ordered_ = reverse_ordered;
+}
+
+Status ScanConfiguration::SetLimit(int64_t limit) {
+  if (limit < 0) {
+    return Status::InvalidArgument("Limit must not be negative");
+  }
+  limit_ = limit;
+  return Status::OK();
+}
+
 void ScanConfiguration::SetSnapshotMicros(uint64_t snapshot_timestamp_micros) {
   // Shift the HT timestamp bits to get well-formed HT timestamp with the
   // logical bits zeroed out.
@@ -173,6 +216,100 @@ void ScanConfiguration::SetTimeoutMillis(int millis) {
   timeout_ = MonoDelta::FromMilliseconds(millis);
 }
 
+void ScanConfiguration::SetProfilingEnabled(bool enabled) {
+  profiling_enabled_ = enabled;
+}
+
+Status ScanConfiguration::SetRowFormatFlags(uint64_t flags) {
+  if (flags & ~(KuduScanner::COLUMNAR_LAYOUT | KuduScanner::COLUMNAR_DICTIONARY)) {
+    return Status::InvalidArgument(strings::Substitute("Unknown row format flags: $0", flags));
+  }
+  if ((flags & KuduScanner::COLUMNAR_DICTIONARY) && !(flags & KuduScanner::COLUMNAR_LAYOUT)) {
+    return Status::InvalidArgument("COLUMNAR_DICTIONARY requires COLUMNAR_LAYOUT");
+  }
+  row_format_flags_ = flags;
+  return Status::OK();
+}
+
+Status ScanConfiguration::AddAggregate(KuduScanner::AggregateFunction function,
+                                       const string& col_name) {
+  ScanAggregatePB pb;
+  switch (function) {
+    case KuduScanner::AGGREGATE_COUNT: pb.set_function(ScanAggregatePB::COUNT); break;
+    case KuduScanner::AGGREGATE_MIN: pb.set_function(ScanAggregatePB::MIN); break;
+    case KuduScanner::AGGREGATE_MAX: pb.set_function(ScanAggregatePB::MAX); break;
+    case KuduScanner::AGGREGATE_SUM: pb.set_function(ScanAggregatePB::SUM); break;
+    default: return Status::InvalidArgument("Unknown aggregate function");
+  }
+  if (!col_name.empty()) {
+    pb.set_column(col_name);
+  }
+  vector<ScanAggregatePB> aggregate_pbs = aggregate_pbs_;
+  aggregate_pbs.push_back(pb);
+  return ResolveAggregates(std::move(aggregate_pbs), group_by_columns_);
+}
+
+Status ScanConfiguration::SetGroupByColumns(const vector<string>& col_names) {
+  if (aggregates_.empty()) {
+    return Status::IllegalState("Aggregates must be added before the grouping columns");
+  }
+  return ResolveAggregates(aggregate_pbs_, col_names);
+}
+
+Status ScanConfiguration::ResolveAggregates(vector<ScanAggregatePB> aggregate_pbs,
+                                            vector<string> group_by_columns) {
+  // The projection consists of the grouping columns, followed by the
+  // distinct aggregated columns in the order in which they were first
+  // aggregated.
+  const Schema& schema = *table().schema().schema_;
+  vector<int> col_indexes;
+  auto add_column = [&](const string& name) {
+    int idx = schema.find_column(name);
+    if (idx == Schema::kColumnNotFound) {
+      return Status::NotFound(strings::Substitute(
+            "Column: \"$0\" was not found in the table schema.", name));
+    }
+    if (std::find(col_indexes.begin(), col_indexes.end(), idx) == col_indexes.end()) {
+      col_indexes.push_back(idx);
+    }
+    return Status::OK();
+  };
+  for (const string& name : group_by_columns) {
+    RETURN_NOT_OK(add_column(name));
+  }
+  for (const ScanAggregatePB& aggregate_pb : aggregate_pbs) {
+    if (!aggregate_pb.has_column()) continue;
+    RETURN_NOT_OK(add_column(aggregate_pb.column()));
+  }
+  unique_ptr<Schema> projection;
+  RETURN_NOT_OK(CreateProjection(col_indexes, &projection));
+
+  // Resolve the aggregates in the same way as the tablet servers do, which
+  // also validates them.
+  vector<ScanAggregate> aggregates;
+  for (const ScanAggregatePB& aggregate_pb : aggregate_pbs) {
+    RETURN_NOT_OK(ScanAggregate::FromPB(aggregate_pb, *projection, &aggregates));
+  }
+  Schema result_schema;
+  unique_ptr<ScanGroupBy> group_by;
+  if (!group_by_columns.empty()) {
+    RETURN_NOT_OK(ScanGroupBy::Create(group_by_columns, *projection, aggregates, &group_by));
+    RETURN_NOT_OK(group_by->ResultSchema(&result_schema));
+  } else {
+    RETURN_NOT_OK(ScanAggregate::ResultSchema(aggregates, &result_schema));
+  }
+
+  aggregate_pbs_ = std::move(aggregate_pbs);
+  aggregates_ = std::move(aggregates);
+  group_by_columns_ = std::move(group_by_columns);
+  group_by_ = std::move(group_by);
+  aggregate_result_schema_ = std::move(result_schema);
+  client_aggregate_result_schema_ = KuduSchema(aggregate_result_schema_);
+  projection_ = pool_.Add(projection.release());
+  client_projection_ = KuduSchema(*projection_);
+  return Status::OK();
+}
+
 void ScanConfiguration::OptimizeScanSpec() {
   spec_.OptimizeScan(*table_->schema().schema_,
                      &arena_,
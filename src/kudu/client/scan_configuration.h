@@ -23,6 +23,8 @@
 
 #include "kudu/client/client.h"
 #include "kudu/common/column_predicate.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/common/scan_aggregate.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/util/auto_release_pool.h"
 #include "kudu/util/memory/arena.h"
@@ -67,18 +69,35 @@ class ScanConfiguration {
 
   Status SetBatchSizeBytes(uint32_t batch_size);
 
+  Status SetPrefetchBudgetBytes(uint32_t budget_bytes);
+
   Status SetSelection(KuduClient::ReplicaSelection selection) WARN_UNUSED_RESULT;
 
   Status SetReadMode(KuduScanner::ReadMode read_mode) WARN_UNUSED_RESULT;
 
+  Status SetMaxStalenessMillis(int millis) WARN_UNUSED_RESULT;
+
   Status SetFaultTolerant(bool fault_tolerant) WARN_UNUSED_RESULT;
 
+  void SetReverseOrdered(bool reverse_ordered);
+
+  Status SetLimit(int64_t limit) WARN_UNUSED_RESULT;
+
   void SetSnapshotMicros(uint64_t snapshot_timestamp_micros);
 
   void SetSnapshotRaw(uint64_t snapshot_timestamp);
 
   void SetTimeoutMillis(int millis);
 
+  void SetProfilingEnabled(bool enabled);
+
+  Status SetRowFormatFlags(uint64_t flags) WARN_UNUSED_RESULT;
+
+  Status AddAggregate(KuduScanner::AggregateFunction function,
+                      const std::string& col_name) WARN_UNUSED_RESULT;
+
+  Status SetGroupByColumns(const std::vector<std::string>& col_names) WARN_UNUSED_RESULT;
+
   void OptimizeScanSpec();
 
   const KuduTable& table() {
@@ -99,6 +118,40 @@ class ScanConfiguration {
     return &client_projection_;
   }
 
+  // Returns the schema of the rows returned by the tablet servers: the
+  // aggregate result schema for aggregating scans, and the projection
+  // otherwise.
+  //
+  // The ScanConfiguration retains ownership of the schema.
+  const Schema* result_schema() const {
+    return aggregates_.empty() ? projection_ : &aggregate_result_schema_;
+  }
+
+  // Returns the KuduSchema version of result_schema().
+  const KuduSchema* client_result_schema() const {
+    return aggregates_.empty() ? &client_projection_ : &client_aggregate_result_schema_;
+  }
+
+  const std::vector<ScanAggregatePB>& aggregate_pbs() const {
+    return aggregate_pbs_;
+  }
+
+  // Returns the aggregates added by AddAggregate(), which are resolved
+  // against the projection.
+  const std::vector<ScanAggregate>& aggregates() const {
+    return aggregates_;
+  }
+
+  const std::vector<std::string>& group_by_columns() const {
+    return group_by_columns_;
+  }
+
+  // Returns the grouping of the aggregates, resolved against the projection,
+  // or NULL if the aggregates aren't grouped.
+  const ScanGroupBy* group_by() const {
+    return group_by_.get();
+  }
+
   const ScanSpec& spec() const {
     return spec_;
   }
@@ -112,6 +165,12 @@ class ScanConfiguration {
     return batch_size_bytes_;
   }
 
+  // The maximum number of bytes of prefetched batches; 0 if prefetching is
+  // disabled.
+  uint32_t prefetch_budget_bytes() const {
+    return prefetch_budget_bytes_;
+  }
+
   KuduClient::ReplicaSelection selection() const {
     return selection_;
   }
@@ -120,10 +179,27 @@ class ScanConfiguration {
     return read_mode_;
   }
 
+  // The maximum staleness of READ_BOUNDED_STALENESS scans; uninitialized if
+  // any staleness is acceptable.
+  const MonoDelta& max_staleness() const {
+    return max_staleness_;
+  }
+
   bool is_fault_tolerant() const {
     return is_fault_tolerant_;
   }
 
+  // Whether the rows of each tablet are returned in descending key order.
+  // Only set for fault-tolerant scans.
+  bool is_reverse_ordered() const {
+    return is_reverse_ordered_;
+  }
+
+  // The maximum number of rows returned by the scan, or -1 if unlimited.
+  int64_t limit() const {
+    return limit_;
+  }
+
   int64_t snapshot_timestamp() const {
     return snapshot_timestamp_;
   }
@@ -132,6 +208,14 @@ class ScanConfiguration {
     return timeout_;
   }
 
+  uint64_t row_format_flags() const {
+    return row_format_flags_;
+  }
+
+  bool profiling_enabled() const {
+    return profiling_enabled_;
+  }
+
   Arena* arena() {
     return &arena_;
   }
@@ -139,6 +223,16 @@ class ScanConfiguration {
  private:
   friend class KuduScanTokenBuilder;
 
+  // Creates a projection of the table columns with the given indexes.
+  Status CreateProjection(const std::vector<int>& col_indexes,
+                          std::unique_ptr<Schema>* projection) const;
+
+  // Resolves 'aggregate_pbs' grouped by 'group_by_columns' (if any), and
+  // replaces the aggregates, their grouping, the result schema and the
+  // projection with those of the resolved aggregates.
+  Status ResolveAggregates(std::vector<ScanAggregatePB> aggregate_pbs,
+                           std::vector<std::string> group_by_columns);
+
   // Non-owned, non-null table.
   KuduTable* table_;
 
@@ -153,16 +247,38 @@ class ScanConfiguration {
   bool has_batch_size_bytes_;
   uint32 batch_size_bytes_;
 
+  uint32 prefetch_budget_bytes_;
+
   KuduClient::ReplicaSelection selection_;
 
   KuduScanner::ReadMode read_mode_;
 
+  MonoDelta max_staleness_;
+
   bool is_fault_tolerant_;
 
+  bool is_reverse_ordered_;
+
+  int64_t limit_;
+
   int64_t snapshot_timestamp_;
 
   MonoDelta timeout_;
 
+  uint64_t row_format_flags_;
+
+  bool profiling_enabled_;
+
+  // The aggregates to compute, if any, both as sent to the tablet servers and
+  // resolved against the projection, the columns by which they're grouped
+  // and their grouping, and the schema of their results.
+  std::vector<ScanAggregatePB> aggregate_pbs_;
+  std::vector<ScanAggregate> aggregates_;
+  std::vector<std::string> group_by_columns_;
+  std::unique_ptr<ScanGroupBy> group_by_;
+  Schema aggregate_result_schema_;
+  KuduSchema client_aggregate_result_schema_;
+
   // Manages interior allocations for the scan spec and copied bounds.
   Arena arena_;
 
@@ -17,11 +17,15 @@
 #ifndef KUDU_CLIENT_SCAN_PREDICATE_INTERNAL_H
 #define KUDU_CLIENT_SCAN_PREDICATE_INTERNAL_H
 
+#include <vector>
+
 #include "kudu/client/scan_predicate.h"
 #include "kudu/client/value.h"
 #include "kudu/client/value-internal.h"
 #include "kudu/common/scan_spec.h"
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/util/bloom_filter.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/status.h"
 
@@ -88,6 +92,62 @@ class ComparisonPredicateData : public KuduPredicate::Data {
   gscoped_ptr<KuduValue> val_;
 };
 
+// A predicate that matches rows whose column value is one of a list of values.
+class InListPredicateData : public KuduPredicate::Data {
+ public:
+  // Takes ownership of the values in 'values', and clears the vector.
+  InListPredicateData(ColumnSchema col, std::vector<KuduValue*>* values);
+  virtual ~InListPredicateData();
+
+  Status AddToScanSpec(ScanSpec* spec, Arena* arena) override;
+
+  InListPredicateData* Clone() const override;
+
+ private:
+  ColumnSchema col_;
+  std::vector<KuduValue*> vals_;
+};
+
+// A predicate that matches rows whose column value may be one of a set of
+// values, according to a bloom filter built from the values.
+class InBloomFilterPredicateData : public KuduPredicate::Data {
+ public:
+  // Takes ownership of the values in 'values', and clears the vector.
+  InBloomFilterPredicateData(ColumnSchema col, std::vector<KuduValue*>* values,
+                             double false_positive_rate);
+  virtual ~InBloomFilterPredicateData();
+
+  Status AddToScanSpec(ScanSpec* spec, Arena* arena) override;
+
+  InBloomFilterPredicateData* Clone() const override;
+
+ private:
+  ColumnSchema col_;
+  std::vector<KuduValue*> vals_;
+  double false_positive_rate_;
+
+  // The filter built from the values by the first AddToScanSpec() call. The
+  // column predicates added to scan specs refer to its data.
+  gscoped_ptr<BloomFilterBuilder> bloom_filter_;
+};
+
+// A predicate that matches rows whose column value is NULL.
+class IsNullPredicateData : public KuduPredicate::Data {
+ public:
+  explicit IsNullPredicateData(ColumnSchema col)
+      : col_(std::move(col)) {
+  }
+
+  Status AddToScanSpec(ScanSpec* spec, Arena* arena) override;
+
+  IsNullPredicateData* Clone() const override {
+    return new IsNullPredicateData(col_);
+  }
+
+ private:
+  ColumnSchema col_;
+};
+
 } // namespace client
 } // namespace kudu
 #endif /* KUDU_CLIENT_SCAN_PREDICATE_INTERNAL_H */
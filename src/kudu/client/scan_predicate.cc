@@ -19,14 +19,17 @@
 
 #include <boost/optional.hpp>
 #include <utility>
+#include <vector>
 
 #include "kudu/client/scan_predicate-internal.h"
 #include "kudu/client/value-internal.h"
 #include "kudu/client/value.h"
 #include "kudu/common/scan_spec.h"
+#include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
 
 using std::move;
+using std::vector;
 using boost::optional;
 
 namespace kudu {
@@ -104,5 +107,98 @@ Status ComparisonPredicateData::AddToScanSpec(ScanSpec* spec, Arena* arena) {
   return Status::OK();
 }
 
+InListPredicateData::InListPredicateData(ColumnSchema col,
+                                         vector<KuduValue*>* values)
+    : col_(move(col)) {
+  vals_.swap(*values);
+}
+
+InListPredicateData::~InListPredicateData() {
+  STLDeleteElements(&vals_);
+}
+
+Status InListPredicateData::AddToScanSpec(ScanSpec* spec, Arena* /*arena*/) {
+  vector<const void*> vals_list;
+  vals_list.reserve(vals_.size());
+  for (KuduValue* val : vals_) {
+    void* val_void;
+    // The values are owned by this predicate data, and must outlive the
+    // column predicate added to the scan spec.
+    RETURN_NOT_OK(val->data_->CheckTypeAndGetPointer(col_.name(),
+                                                     col_.type_info()->physical_type(),
+                                                     &val_void));
+    vals_list.push_back(val_void);
+  }
+  spec->AddPredicate(ColumnPredicate::InList(col_, &vals_list));
+  return Status::OK();
+}
+
+InListPredicateData* InListPredicateData::Clone() const {
+  vector<KuduValue*> values;
+  values.reserve(vals_.size());
+  for (KuduValue* val : vals_) {
+    values.push_back(val->Clone());
+  }
+  return new InListPredicateData(col_, &values);
+}
+
+InBloomFilterPredicateData::InBloomFilterPredicateData(ColumnSchema col,
+                                                       vector<KuduValue*>* values,
+                                                       double false_positive_rate)
+    : col_(move(col)),
+      false_positive_rate_(false_positive_rate) {
+  vals_.swap(*values);
+}
+
+InBloomFilterPredicateData::~InBloomFilterPredicateData() {
+  STLDeleteElements(&vals_);
+}
+
+Status InBloomFilterPredicateData::AddToScanSpec(ScanSpec* spec, Arena* /*arena*/) {
+  if (vals_.empty()) {
+    // No value can match.
+    vector<const void*> no_values;
+    spec->AddPredicate(ColumnPredicate::InList(col_, &no_values));
+    return Status::OK();
+  }
+  if (!bloom_filter_) {
+    if (false_positive_rate_ <= 0 || false_positive_rate_ >= 1) {
+      return Status::InvalidArgument(
+          Substitute("invalid bloom filter false positive rate: $0", false_positive_rate_));
+    }
+    gscoped_ptr<BloomFilterBuilder> bloom_filter(new BloomFilterBuilder(
+        BloomFilterSizing::ByCountAndFPRate(vals_.size(), false_positive_rate_,
+                                            BLOCKED_BLOOM_LAYOUT)));
+    for (KuduValue* val : vals_) {
+      void* val_void;
+      RETURN_NOT_OK(val->data_->CheckTypeAndGetPointer(col_.name(),
+                                                       col_.type_info()->physical_type(),
+                                                       &val_void));
+      bloom_filter->AddKey(BloomKeyProbe(
+          ColumnPredicate::BloomFilterKey(col_.type_info(), val_void)));
+    }
+    bloom_filter_ = std::move(bloom_filter);
+  }
+  vector<BloomFilter> bloom_filters;
+  bloom_filters.emplace_back(bloom_filter_->slice(), bloom_filter_->n_hashes(),
+                             bloom_filter_->layout());
+  spec->AddPredicate(ColumnPredicate::InBloomFilter(col_, &bloom_filters, nullptr, nullptr));
+  return Status::OK();
+}
+
+InBloomFilterPredicateData* InBloomFilterPredicateData::Clone() const {
+  vector<KuduValue*> values;
+  values.reserve(vals_.size());
+  for (KuduValue* val : vals_) {
+    values.push_back(val->Clone());
+  }
+  return new InBloomFilterPredicateData(col_, &values, false_positive_rate_);
+}
+
+Status IsNullPredicateData::AddToScanSpec(ScanSpec* spec, Arena* /*arena*/) {
+  spec->AddPredicate(ColumnPredicate::IsNull(col_));
+  return Status::OK();
+}
+
 } // namespace client
 } // namespace kudu
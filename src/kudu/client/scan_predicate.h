@@ -32,7 +32,8 @@ namespace client {
 
 /// @brief A representation of comparison predicate for Kudu queries.
 ///
-/// Call KuduTable::NewComparisonPredicate() to create a predicate object.
+/// Call KuduTable::NewComparisonPredicate(), KuduTable::NewInListPredicate()
+/// or KuduTable::NewIsNullPredicate() to create a predicate object.
 class KUDU_EXPORT KuduPredicate {
  public:
   /// @brief Supported comparison operators.
@@ -57,6 +58,9 @@ class KUDU_EXPORT KuduPredicate {
  private:
   friend class ComparisonPredicateData;
   friend class ErrorPredicateData;
+  friend class InBloomFilterPredicateData;
+  friend class InListPredicateData;
+  friend class IsNullPredicateData;
   friend class KuduTable;
   friend class ScanConfiguration;
 
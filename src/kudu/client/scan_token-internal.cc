@@ -18,6 +18,7 @@
 #include "kudu/client/scan_token-internal.h"
 
 #include <boost/optional.hpp>
+#include <set>
 #include <vector>
 #include <string>
 #include <memory>
@@ -30,16 +31,23 @@
 #include "kudu/client/tablet-internal.h"
 #include "kudu/client/tablet_server-internal.h"
 #include "kudu/common/wire_protocol.h"
+#include "kudu/rpc/rpc_controller.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/pb_util.h"
+#include "kudu/tserver/tserver_service.proxy.h"
 #include "kudu/util/status.h"
 
+using std::set;
 using std::string;
 using std::unique_ptr;
 using std::vector;
 using strings::Substitute;
 
+using kudu::rpc::RpcController;
+using kudu::tserver::SplitKeyRangeRequestPB;
+using kudu::tserver::SplitKeyRangeResponsePB;
+
 namespace kudu {
 namespace client {
 
@@ -143,10 +151,18 @@ Status KuduScanToken::Data::PBIntoScanner(KuduClient* client,
         RETURN_NOT_OK(scan_builder->SetReadMode(KuduScanner::READ_AT_SNAPSHOT));
         break;
       }
+      case ReadMode::READ_BOUNDED_STALENESS: {
+        RETURN_NOT_OK(scan_builder->SetReadMode(KuduScanner::READ_BOUNDED_STALENESS));
+        break;
+      }
       default: return Status::InvalidArgument("scan token has unrecognized read mode");
     }
   }
 
+  if (message.has_max_staleness_usec()) {
+    RETURN_NOT_OK(scan_builder->SetMaxStalenessMillis(message.max_staleness_usec() / 1000));
+  }
+
   if (message.fault_tolerant()) {
     RETURN_NOT_OK(scan_builder->SetFaultTolerant());
   }
@@ -166,7 +182,58 @@ Status KuduScanToken::Data::PBIntoScanner(KuduClient* client,
 }
 
 KuduScanTokenBuilder::Data::Data(KuduTable* table)
-    : configuration_(table) {
+    : configuration_(table),
+      split_size_bytes_(0) {
+}
+
+Status KuduScanTokenBuilder::Data::SplitTablet(
+    const scoped_refptr<internal::RemoteTablet>& tablet,
+    const ScanTokenPB& pb,
+    const MonoTime& deadline,
+    vector<string>* split_keys) {
+  KuduClient* client = configuration_.table_->client();
+  SplitKeyRangeRequestPB req;
+  req.set_tablet_id(tablet->tablet_id());
+  if (pb.has_lower_bound_primary_key()) {
+    req.set_start_primary_key(pb.lower_bound_primary_key());
+  }
+  if (pb.has_upper_bound_primary_key()) {
+    req.set_stop_primary_key(pb.upper_bound_primary_key());
+  }
+  req.set_target_chunk_size_bytes(split_size_bytes_);
+
+  set<string> blacklist;
+  Status last_error;
+  while (true) {
+    internal::RemoteTabletServer* ts;
+    vector<internal::RemoteTabletServer*> candidates;
+    Status s = client->data_->GetTabletServer(client, tablet,
+                                              KuduClient::CLOSEST_REPLICA,
+                                              blacklist, &candidates, &ts);
+    if (!s.ok()) {
+      // Once every replica has failed, return the error of the last one.
+      return last_error.ok() ? s : last_error;
+    }
+
+    RpcController rpc;
+    rpc.set_deadline(deadline);
+    SplitKeyRangeResponsePB resp;
+    s = ts->proxy()->SplitKeyRange(req, &resp, &rpc);
+    if (s.ok() && resp.has_error()) {
+      s = StatusFromPB(resp.error().status());
+    }
+    if (s.ok()) {
+      split_keys->assign(resp.split_keys().begin(), resp.split_keys().end());
+      return Status::OK();
+    }
+    last_error = s.CloneAndPrepend(
+        Substitute("unable to split tablet $0 on $1", tablet->tablet_id(), ts->ToString()));
+    if (MonoTime::Now() >= deadline) {
+      return last_error;
+    }
+    VLOG(1) << last_error.ToString();
+    blacklist.insert(ts->permanent_uuid());
+  }
 }
 
 Status KuduScanTokenBuilder::Data::Build(vector<KuduScanToken*>* tokens) {
@@ -202,9 +269,16 @@ Status KuduScanTokenBuilder::Data::Build(vector<KuduScanToken*>* tokens) {
   switch (configuration_.read_mode()) {
     case KuduScanner::READ_LATEST: pb.set_read_mode(kudu::READ_LATEST); break;
     case KuduScanner::READ_AT_SNAPSHOT: pb.set_read_mode(kudu::READ_AT_SNAPSHOT); break;
+    case KuduScanner::READ_BOUNDED_STALENESS:
+      pb.set_read_mode(kudu::READ_BOUNDED_STALENESS);
+      break;
     default: LOG(FATAL) << "Unexpected read mode.";
   }
 
+  if (configuration_.max_staleness().Initialized()) {
+    pb.set_max_staleness_usec(configuration_.max_staleness().ToMicroseconds());
+  }
+
   if (configuration_.snapshot_timestamp() != ScanConfiguration::kNoTimestamp) {
     if (PREDICT_FALSE(configuration_.read_mode() != KuduScanner::READ_AT_SNAPSHOT)) {
       LOG(WARNING) << "Scan token snapshot timestamp set but read mode was READ_LATEST."
@@ -248,49 +322,70 @@ Status KuduScanTokenBuilder::Data::Build(vector<KuduScanToken*>* tokens) {
       continue;
     }
 
+    // Split large tablets into several tokens, by primary key range. Should
+    // that fail, the scan is still correct with a single token.
+    vector<string> split_keys;
+    if (split_size_bytes_ > 0) {
+      Status s = SplitTablet(tablet, pb, deadline, &split_keys);
+      if (!s.ok()) {
+        LOG(WARNING) << "Unable to split scan of tablet " << tablet->tablet_id()
+                     << ", using a single token: " << s.ToString();
+        split_keys.clear();
+      }
+    }
+
     vector<internal::RemoteReplica> replicas;
     tablet->GetRemoteReplicas(&replicas);
 
-    vector<const KuduReplica*> client_replicas;
-    ElementDeleter deleter(&client_replicas);
-
-    // Convert the replicas from their internal format to something appropriate
-    // for clients.
-    for (const auto& r : replicas) {
-      vector<HostPort> host_ports;
-      r.ts->GetHostPorts(&host_ports);
-      if (host_ports.empty()) {
-        return Status::IllegalState(Substitute(
-            "No host found for tablet server $0", r.ts->ToString()));
+    for (size_t i = 0; i <= split_keys.size(); i++) {
+      vector<const KuduReplica*> client_replicas;
+      ElementDeleter deleter(&client_replicas);
+
+      // Convert the replicas from their internal format to something appropriate
+      // for clients.
+      for (const auto& r : replicas) {
+        vector<HostPort> host_ports;
+        r.ts->GetHostPorts(&host_ports);
+        if (host_ports.empty()) {
+          return Status::IllegalState(Substitute(
+              "No host found for tablet server $0", r.ts->ToString()));
+        }
+        unique_ptr<KuduTabletServer> client_ts(new KuduTabletServer);
+        client_ts->data_ = new KuduTabletServer::Data(r.ts->permanent_uuid(),
+                                                      host_ports[0]);
+        bool is_leader = r.role == consensus::RaftPeerPB::LEADER;
+        unique_ptr<KuduReplica> client_replica(new KuduReplica);
+        client_replica->data_ = new KuduReplica::Data(is_leader,
+                                                      std::move(client_ts));
+        client_replicas.push_back(client_replica.release());
       }
-      unique_ptr<KuduTabletServer> client_ts(new KuduTabletServer);
-      client_ts->data_ = new KuduTabletServer::Data(r.ts->permanent_uuid(),
-                                                    host_ports[0]);
-      bool is_leader = r.role == consensus::RaftPeerPB::LEADER;
-      unique_ptr<KuduReplica> client_replica(new KuduReplica);
-      client_replica->data_ = new KuduReplica::Data(is_leader,
-                                                    std::move(client_ts));
-      client_replicas.push_back(client_replica.release());
-    }
 
-    unique_ptr<KuduTablet> client_tablet(new KuduTablet);
-    client_tablet->data_ = new KuduTablet::Data(tablet->tablet_id(),
-                                                std::move(client_replicas));
-    client_replicas.clear();
-
-    // Create the scan token itself.
-    ScanTokenPB message;
-    message.CopyFrom(pb);
-    message.set_lower_bound_partition_key(
-        tablet->partition().partition_key_start());
-    message.set_upper_bound_partition_key(
-        tablet->partition().partition_key_end());
-    unique_ptr<KuduScanToken> client_scan_token(new KuduScanToken);
-    client_scan_token->data_ =
-        new KuduScanToken::Data(table,
-                                std::move(message),
-                                std::move(client_tablet));
-    tokens->push_back(client_scan_token.release());
+      unique_ptr<KuduTablet> client_tablet(new KuduTablet);
+      client_tablet->data_ = new KuduTablet::Data(tablet->tablet_id(),
+                                                  std::move(client_replicas));
+      client_replicas.clear();
+
+      // Create the scan token itself.
+      ScanTokenPB message;
+      message.CopyFrom(pb);
+      message.set_lower_bound_partition_key(
+          tablet->partition().partition_key_start());
+      message.set_upper_bound_partition_key(
+          tablet->partition().partition_key_end());
+      // The split keys fall within the scan's primary key bounds.
+      if (i > 0) {
+        message.set_lower_bound_primary_key(split_keys[i - 1]);
+      }
+      if (i < split_keys.size()) {
+        message.set_upper_bound_primary_key(split_keys[i]);
+      }
+      unique_ptr<KuduScanToken> client_scan_token(new KuduScanToken);
+      client_scan_token->data_ =
+          new KuduScanToken::Data(table,
+                                  std::move(message),
+                                  std::move(client_tablet));
+      tokens->push_back(client_scan_token.release());
+    }
     pruner.RemovePartitionKeyRange(tablet->partition().partition_key_end());
   }
   return Status::OK();
@@ -24,10 +24,16 @@
 #include "kudu/client/client.h"
 #include "kudu/client/client.pb.h"
 #include "kudu/client/scan_configuration.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/monotime.h"
 
 namespace kudu {
 namespace client {
 
+namespace internal {
+class RemoteTablet;
+} // namespace internal
+
 class KuduScanToken::Data {
  public:
   explicit Data(KuduTable* table,
@@ -72,8 +78,23 @@ class KuduScanTokenBuilder::Data {
     return &configuration_;
   }
 
+  void set_split_size_bytes(uint64_t split_size_bytes) {
+    split_size_bytes_ = split_size_bytes;
+  }
+
  private:
+  // Sets 'split_keys' to the primary keys which split the part of the scan
+  // in 'tablet' into chunks of about 'split_size_bytes_', as chosen by one
+  // of its replicas.
+  Status SplitTablet(const scoped_refptr<internal::RemoteTablet>& tablet,
+                     const ScanTokenPB& pb,
+                     const MonoTime& deadline,
+                     std::vector<std::string>* split_keys);
+
   ScanConfiguration configuration_;
+
+  // The target size of the data of each token, or 0 for a token per tablet.
+  uint64_t split_size_bytes_;
 };
 
 } // namespace client
@@ -25,8 +25,10 @@
 #include "kudu/client/client.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/integration-tests/mini_cluster.h"
+#include "kudu/tablet/tablet_peer.h"
 #include "kudu/tserver/mini_tablet_server.h"
 #include "kudu/tserver/tablet_server.h"
+#include "kudu/tserver/ts_tablet_manager.h"
 #include "kudu/util/test_util.h"
 
 namespace kudu {
@@ -39,6 +41,7 @@ using std::thread;
 using std::unique_ptr;
 using std::unordered_set;
 using std::vector;
+using tablet::TabletPeer;
 using tserver::MiniTabletServer;
 
 class ScanTokenTest : public KuduTest {
@@ -218,6 +221,81 @@ TEST_F(ScanTokenTest, TestScanTokens) {
   }
 }
 
+TEST_F(ScanTokenTest, TestSplitScanTokens) {
+  KuduSchema schema;
+  {
+    KuduSchemaBuilder builder;
+    builder.AddColumn("col")->NotNull()->Type(KuduColumnSchema::INT64)->PrimaryKey();
+    builder.AddColumn("val")->NotNull()->Type(KuduColumnSchema::STRING);
+    ASSERT_OK(builder.Build(&schema));
+  }
+
+  // A single tablet.
+  shared_ptr<KuduTable> table;
+  {
+    unique_ptr<client::KuduTableCreator> table_creator(client_->NewTableCreator());
+    ASSERT_OK(table_creator->table_name("table")
+                            .schema(&schema)
+                            .set_range_partition_columns({ "col" })
+                            .num_replicas(1)
+                            .Create());
+    ASSERT_OK(client_->OpenTable("table", &table));
+  }
+
+  const int kNumRows = 2000;
+  shared_ptr<KuduSession> session = CreateSession();
+  for (int i = 0; i < kNumRows; i++) {
+    unique_ptr<KuduInsert> insert(table->NewInsert());
+    ASSERT_OK(insert->mutable_row()->SetInt64("col", i));
+    ASSERT_OK(insert->mutable_row()->SetStringCopy("val", string(100, 'x')));
+    ASSERT_OK(session->Apply(insert.release()));
+  }
+  ASSERT_OK(session->Flush());
+
+  // Only flushed data is accounted for when splitting.
+  vector<scoped_refptr<TabletPeer>> peers;
+  cluster_->mini_tablet_server(0)->server()->tablet_manager()->GetTabletPeers(&peers);
+  ASSERT_EQ(1, peers.size());
+  ASSERT_OK(peers[0]->tablet()->Flush());
+  uint64_t size = peers[0]->tablet()->EstimateOnDiskSize();
+
+  { // no split size
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    ASSERT_OK(KuduScanTokenBuilder(table.get()).Build(&tokens));
+    ASSERT_EQ(1, tokens.size());
+  }
+
+  { // about four chunks
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    KuduScanTokenBuilder builder(table.get());
+    ASSERT_OK(builder.SetSplitSizeBytes(size / 4));
+    ASSERT_OK(builder.Build(&tokens));
+
+    ASSERT_GE(tokens.size(), 3);
+    ASSERT_LE(tokens.size(), 5);
+    for (const KuduScanToken* token : tokens) {
+      ASSERT_EQ(peers[0]->tablet_id(), token->tablet().id());
+    }
+    ASSERT_EQ(kNumRows, CountRows(tokens));
+  }
+
+  { // primary key bound
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    KuduScanTokenBuilder builder(table.get());
+    unique_ptr<KuduPartialRow> lower_bound(schema.NewRow());
+    ASSERT_OK(lower_bound->SetInt64("col", kNumRows / 2));
+    ASSERT_OK(builder.AddLowerBound(*lower_bound));
+    ASSERT_OK(builder.SetSplitSizeBytes(size / 4));
+    ASSERT_OK(builder.Build(&tokens));
+
+    ASSERT_GE(tokens.size(), 2);
+    ASSERT_EQ(kNumRows / 2, CountRows(tokens));
+  }
+}
+
 TEST_F(ScanTokenTest, TestScanTokensWithNonCoveringRange) {
   // Create schema
   KuduSchema schema;
@@ -20,6 +20,7 @@
 #include <algorithm>
 #include <boost/bind.hpp>
 #include <cmath>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -36,8 +37,10 @@
 using google::protobuf::FieldDescriptor;
 using google::protobuf::Reflection;
 
+using std::map;
 using std::set;
 using std::string;
+using std::unique_ptr;
 
 namespace kudu {
 
@@ -45,6 +48,7 @@ using rpc::RpcController;
 using strings::Substitute;
 using strings::SubstituteAndAppend;
 using tserver::NewScanRequestPB;
+using tserver::ScanResponsePB;
 using tserver::TabletServerFeatures;
 
 namespace client {
@@ -56,11 +60,19 @@ KuduScanner::Data::Data(KuduTable* table)
     open_(false),
     data_in_open_(false),
     short_circuit_(false),
+    rows_returned_(0),
+    resume_snap_timestamp_(0),
     table_(DCHECK_NOTNULL(table)->shared_from_this()),
-    scan_attempts_(0) {
+    scan_attempts_(0),
+    group_results_computed_(false),
+    prefetch_cond_(&prefetch_lock_),
+    prefetch_in_flight_(false),
+    prefetched_bytes_(0),
+    prefetch_stopped_(false) {
 }
 
 KuduScanner::Data::~Data() {
+  StopPrefetching();
 }
 
 Status KuduScanner::Data::HandleError(const ScanRpcStatus& err,
@@ -103,6 +115,10 @@ Status KuduScanner::Data::HandleError(const ScanRpcStatus& err,
       mark_locations_stale = true;
       blacklist_location = true;
       break;
+    case ScanRpcStatus::REPLICA_TOO_STALE:
+      // Another replica may have a more recent safe time.
+      blacklist_location = true;
+      break;
     default:
       can_retry = false;
       break;
@@ -142,17 +158,40 @@ Status KuduScanner::Data::HandleError(const ScanRpcStatus& err,
   return err.status;
 }
 
+namespace {
+// Calls 'f' with the name and value of each int64 field set in 'msg'.
+template<class F>
+void ForEachInt64Field(const google::protobuf::Message& msg, const F& f) {
+  const Reflection* reflection = msg.GetReflection();
+  vector<const FieldDescriptor*> fields;
+  reflection->ListFields(msg, &fields);
+  for (const FieldDescriptor* field : fields) {
+    if (!field->is_repeated() && reflection->HasField(msg, field) &&
+        field->cpp_type() == FieldDescriptor::CPPTYPE_INT64) {
+      f(field->name(), reflection->GetInt64(msg, field));
+    }
+  }
+}
+} // anonymous namespace
+
 void KuduScanner::Data::UpdateResourceMetrics() {
   if (last_response_.has_resource_metrics()) {
-    tserver::ResourceMetricsPB resource_metrics = last_response_.resource_metrics();
-    const Reflection* reflection = resource_metrics.GetReflection();
-    vector<const FieldDescriptor*> fields;
-    reflection->ListFields(resource_metrics, &fields);
-    for (const FieldDescriptor* field : fields) {
-      if (reflection->HasField(resource_metrics, field) &&
-          field->cpp_type() == FieldDescriptor::CPPTYPE_INT64) {
-        resource_metrics_.Increment(field->name(), reflection->GetInt64(resource_metrics, field));
-      }
+    ForEachInt64Field(last_response_.resource_metrics(),
+                      [&](const string& name, int64_t value) {
+                        resource_metrics_.Increment(name, value);
+                      });
+  }
+  if (last_response_.has_profile()) {
+    const tserver::ScanProfilePB& profile = last_response_.profile();
+    ForEachInt64Field(profile, [&](const string& name, int64_t value) {
+      profile_.Increment(name, value);
+    });
+    for (const tserver::ColumnScanProfilePB& col : profile.columns()) {
+      map<string, int64_t>* col_profile = &column_profiles_[col.column_name()];
+      ForEachInt64Field(col, [&](const string& name, int64_t value) {
+        (*col_profile)[name] += value;
+        profile_.Increment(name, value);
+      });
     }
   }
 }
@@ -202,6 +241,8 @@ ScanRpcStatus KuduScanner::Data::AnalyzeResponse(const Status& rpc_status,
       return ScanRpcStatus{ScanRpcStatus::TABLET_NOT_RUNNING, server_status};
     case tserver::TabletServerErrorPB::TABLET_NOT_FOUND:
       return ScanRpcStatus{ScanRpcStatus::TABLET_NOT_FOUND, server_status};
+    case tserver::TabletServerErrorPB::REPLICA_TOO_STALE:
+      return ScanRpcStatus{ScanRpcStatus::REPLICA_TOO_STALE, server_status};
     default:
       return ScanRpcStatus{ScanRpcStatus::OTHER_TS_ERROR, server_status};
   }
@@ -209,11 +250,49 @@ ScanRpcStatus KuduScanner::Data::AnalyzeResponse(const Status& rpc_status,
 
 Status KuduScanner::Data::OpenNextTablet(const MonoTime& deadline,
                                          std::set<std::string>* blacklist) {
+  if (configuration_.is_reverse_ordered()) {
+    CHECK(!reverse_partition_keys_.empty());
+    string partition_key = std::move(reverse_partition_keys_.back());
+    reverse_partition_keys_.pop_back();
+    return OpenTablet(partition_key, deadline, blacklist);
+  }
   return OpenTablet(partition_pruner_.NextPartitionKey(),
                     deadline,
                     blacklist);
 }
 
+Status KuduScanner::Data::LookupReverseOrderedTablets(const MonoTime& deadline) {
+  // The meta cache can only be walked forward, so the tablets are looked up
+  // up front. Should one of them be dropped before it's scanned, OpenTablet()
+  // skips it, since the drained pruner prunes any other tablet it finds.
+  reverse_partition_keys_.clear();
+  while (partition_pruner_.HasMorePartitionKeyRanges()) {
+    scoped_refptr<internal::RemoteTablet> tablet;
+    Synchronizer sync;
+    const string& partition_key = partition_pruner_.NextPartitionKey();
+    table_->client()->data_->meta_cache_->LookupTabletByKeyOrNext(table_.get(),
+                                                                  partition_key,
+                                                                  deadline,
+                                                                  &tablet,
+                                                                  sync.AsStatusCallback());
+    Status s = sync.Wait();
+    if (s.IsNotFound()) {
+      // No more tablets in the table.
+      partition_pruner_.RemovePartitionKeyRange("");
+      break;
+    }
+    RETURN_NOT_OK(s);
+
+    // See the similar check in OpenTablet().
+    if (partition_key >= tablet->partition().partition_key_start() ||
+        !partition_pruner_.ShouldPrune(tablet->partition())) {
+      reverse_partition_keys_.push_back(tablet->partition().partition_key_start());
+    }
+    partition_pruner_.RemovePartitionKeyRange(tablet->partition().partition_key_end());
+  }
+  return Status::OK();
+}
+
 Status KuduScanner::Data::ReopenCurrentTablet(const MonoTime& deadline,
                                               std::set<std::string>* blacklist) {
   return OpenTablet(remote_->partition().partition_key_start(),
@@ -221,6 +300,39 @@ Status KuduScanner::Data::ReopenCurrentTablet(const MonoTime& deadline,
                     blacklist);
 }
 
+void KuduScanner::Data::PrepareController(RpcController* controller,
+                                          const MonoTime& rpc_deadline) const {
+  controller->Reset();
+  controller->set_deadline(rpc_deadline);
+  if (!configuration_.spec().predicates().empty()) {
+    controller->RequireServerFeature(TabletServerFeatures::COLUMN_PREDICATES);
+  }
+  if (configuration_.row_format_flags() & KuduScanner::COLUMNAR_LAYOUT) {
+    controller->RequireServerFeature(TabletServerFeatures::COLUMNAR_LAYOUT_FEATURE);
+  }
+  if (configuration_.limit() >= 0) {
+    controller->RequireServerFeature(TabletServerFeatures::SCAN_LIMITS);
+  }
+  if (configuration_.is_reverse_ordered()) {
+    controller->RequireServerFeature(TabletServerFeatures::REVERSE_ORDERED_SCANS);
+  }
+  if (configuration_.row_format_flags() & KuduScanner::COLUMNAR_DICTIONARY) {
+    controller->RequireServerFeature(TabletServerFeatures::COLUMNAR_DICTIONARY_FEATURE);
+  }
+  if (!configuration_.aggregates().empty()) {
+    controller->RequireServerFeature(TabletServerFeatures::SCAN_AGGREGATES);
+  }
+  if (!configuration_.group_by_columns().empty()) {
+    controller->RequireServerFeature(TabletServerFeatures::GROUPED_SCAN_AGGREGATES);
+  }
+  if (configuration_.read_mode() == READ_BOUNDED_STALENESS) {
+    controller->RequireServerFeature(TabletServerFeatures::BOUNDED_STALENESS_READS);
+  }
+  if (next_req_.has_new_scan_request() && next_req_.new_scan_request().has_resume_token()) {
+    controller->RequireServerFeature(TabletServerFeatures::RESUMABLE_SCANS);
+  }
+}
+
 ScanRpcStatus KuduScanner::Data::SendScanRpc(const MonoTime& overall_deadline,
                                              bool allow_time_for_failover) {
   // The user has specified a timeout which should apply to the total time for each call
@@ -236,16 +348,12 @@ ScanRpcStatus KuduScanner::Data::SendScanRpc(const MonoTime& overall_deadline,
     rpc_deadline = overall_deadline;
   }
 
-  controller_.Reset();
-  controller_.set_deadline(rpc_deadline);
-  if (!configuration_.spec().predicates().empty()) {
-    controller_.RequireServerFeature(TabletServerFeatures::COLUMN_PREDICATES);
-  }
-  ScanRpcStatus scan_status = AnalyzeResponse(
-      proxy_->Scan(next_req_,
-                   &last_response_,
-                   &controller_),
-      rpc_deadline, overall_deadline);
+  PrepareController(&controller_, rpc_deadline);
+  MonoTime start = MonoTime::Now();
+  ts_->RpcStarted();
+  Status rpc_status = proxy_->Scan(next_req_, &last_response_, &controller_);
+  ts_->RpcFinished(MonoTime::Now() - start);
+  ScanRpcStatus scan_status = AnalyzeResponse(rpc_status, rpc_deadline, overall_deadline);
   if (scan_status.result == ScanRpcStatus::OK) {
     UpdateResourceMetrics();
   }
@@ -262,22 +370,58 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
   switch (configuration_.read_mode()) {
     case READ_LATEST: scan->set_read_mode(kudu::READ_LATEST); break;
     case READ_AT_SNAPSHOT: scan->set_read_mode(kudu::READ_AT_SNAPSHOT); break;
+    case READ_BOUNDED_STALENESS: scan->set_read_mode(kudu::READ_BOUNDED_STALENESS); break;
     default: LOG(FATAL) << "Unexpected read mode.";
   }
+  if (configuration_.read_mode() == READ_BOUNDED_STALENESS &&
+      configuration_.max_staleness().Initialized()) {
+    scan->set_max_staleness_usec(configuration_.max_staleness().ToMicroseconds());
+  } else {
+    scan->clear_max_staleness_usec();
+  }
 
-  if (configuration_.is_fault_tolerant()) {
+  if (configuration_.is_reverse_ordered()) {
+    scan->set_order_mode(kudu::REVERSE_ORDERED);
+  } else if (configuration_.is_fault_tolerant()) {
     scan->set_order_mode(kudu::ORDERED);
   } else {
     scan->set_order_mode(kudu::UNORDERED);
   }
 
+  // Tablet scans, including those retried elsewhere, may only return the
+  // rows which the previous ones left to the limit.
+  if (configuration_.limit() >= 0) {
+    scan->set_limit(std::max<int64_t>(0, configuration_.limit() - rows_returned_));
+  } else {
+    scan->clear_limit();
+  }
+
   if (last_primary_key_.length() > 0) {
     VLOG(1) << "Setting NewScanRequestPB last_primary_key to hex value "
         << HexDump(last_primary_key_);
     scan->set_last_primary_key(last_primary_key_);
   }
 
+  // A resume token is only valid at the server which issued it.
+  bool resuming = !resume_token_.empty();
+  if (resuming) {
+    VLOG(1) << "Resuming scan at " << ts_->ToString();
+    scan->set_resume_token(resume_token_);
+    scan->set_snap_timestamp(resume_snap_timestamp_);
+  } else {
+    scan->clear_resume_token();
+  }
+
   scan->set_cache_blocks(configuration_.spec().cache_blocks());
+  scan->set_row_format_flags(configuration_.row_format_flags());
+  scan->clear_aggregates();
+  for (const ScanAggregatePB& aggregate_pb : configuration_.aggregate_pbs()) {
+    *scan->add_aggregates() = aggregate_pb;
+  }
+  scan->clear_group_by_columns();
+  for (const string& column : configuration_.group_by_columns()) {
+    scan->add_group_by_columns(column);
+  }
 
   if (configuration_.snapshot_timestamp() != ScanConfiguration::kNoTimestamp) {
     if (PREDICT_FALSE(configuration_.read_mode() != READ_AT_SNAPSHOT)) {
@@ -338,6 +482,25 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
 
     scan->set_tablet_id(remote_->tablet_id());
 
+    if (resuming) {
+      // Keep trying the same server, e.g. while it restarts.
+      ScanRpcStatus scan_status = SendScanRpc(deadline, true);
+      if (scan_status.result == ScanRpcStatus::OK) {
+        last_error_ = Status::OK();
+        scan_attempts_ = 0;
+        break;
+      }
+      scan_attempts_++;
+      RETURN_NOT_OK(HandleError(scan_status, deadline, blacklist));
+      MonoDelta sleep = KuduClient::Data::ComputeExponentialBackoff(scan_attempts_);
+      if (deadline < MonoTime::Now() + sleep) {
+        return Status::TimedOut("unable to resume scan before timeout",
+                                last_error_.ToString());
+      }
+      SleepFor(sleep);
+      continue;
+    }
+
     RemoteTabletServer *ts;
     vector<RemoteTabletServer*> candidates;
     Status lookup_status = table_->client()->data_->GetTabletServer(
@@ -383,12 +546,14 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
   partition_pruner_.RemovePartitionKeyRange(remote_->partition().partition_key_end());
 
   next_req_.clear_new_scan_request();
-  data_in_open_ = last_response_.has_data();
+  resume_token_ = last_response_.resume_token();
+  resume_snap_timestamp_ = last_response_.snap_timestamp();
+  data_in_open_ = last_response_.has_data() || last_response_.has_columnar_data();
   if (last_response_.has_more_results()) {
     next_req_.set_scanner_id(last_response_.scanner_id());
     VLOG(1) << "Opened tablet " << remote_->tablet_id()
             << ", scanner ID " << last_response_.scanner_id();
-  } else if (last_response_.has_data()) {
+  } else if (data_in_open_) {
     VLOG(1) << "Opened tablet " << remote_->tablet_id() << ", no scanner ID assigned";
   } else {
     VLOG(1) << "Opened tablet " << remote_->tablet_id() << " (no rows), no scanner ID assigned";
@@ -423,7 +588,10 @@ Status KuduScanner::Data::KeepAlive() {
   RpcController controller;
   controller.set_timeout(configuration_.timeout());
   tserver::ScannerKeepAliveRequestPB request;
-  request.set_scanner_id(next_req_.scanner_id());
+  {
+    MutexLock l(prefetch_lock_);
+    request.set_scanner_id(next_req_.scanner_id());
+  }
   tserver::ScannerKeepAliveResponsePB response;
   RETURN_NOT_OK(proxy_->ScannerKeepAlive(request, &response, &controller));
   if (response.has_error()) {
@@ -434,6 +602,9 @@ Status KuduScanner::Data::KeepAlive() {
 
 bool KuduScanner::Data::MoreTablets() const {
   CHECK(open_);
+  if (configuration_.is_reverse_ordered()) {
+    return !reverse_partition_keys_.empty();
+  }
   // TODO(KUDU-565): add a test which has a scan end on a tablet boundary
   return partition_pruner_.HasMorePartitionKeyRanges();
 }
@@ -447,6 +618,12 @@ void KuduScanner::Data::PrepareRequest(RequestType state) {
     next_req_.clear_batch_size_bytes();
   }
 
+  if (configuration_.profiling_enabled()) {
+    next_req_.set_profile(true);
+  } else {
+    next_req_.clear_profile();
+  }
+
   if (state == KuduScanner::Data::NEW) {
     next_req_.set_call_seq_id(0);
   } else {
@@ -460,11 +637,131 @@ void KuduScanner::Data::UpdateLastError(const Status& error) {
   }
 }
 
+void KuduScanner::Data::MaybeStartPrefetch() {
+  PrefetchedResponse* prefetch;
+  {
+    MutexLock l(prefetch_lock_);
+    if (prefetch_in_flight_) {
+      return;
+    }
+    // Only continue from the newest response we know of.
+    const ScanResponsePB& newest =
+        prefetched_.empty() ? last_response_ : prefetched_.back()->response;
+    if (!newest.has_more_results() ||
+        (!prefetched_.empty() && !prefetched_.back()->succeeded())) {
+      return;
+    }
+    prefetch = QueuePrefetchUnlocked();
+  }
+  if (prefetch) {
+    SendPrefetch(prefetch);
+  }
+}
+
+KuduScanner::Data::PrefetchedResponse* KuduScanner::Data::QueuePrefetchUnlocked() {
+  prefetch_lock_.AssertAcquired();
+  DCHECK(!prefetch_in_flight_);
+  if (prefetch_stopped_ ||
+      configuration_.prefetch_budget_bytes() == 0 ||
+      prefetched_bytes_ >= configuration_.prefetch_budget_bytes()) {
+    return nullptr;
+  }
+  PrepareRequest(KuduScanner::Data::CONTINUE);
+  unique_ptr<PrefetchedResponse> prefetch(new PrefetchedResponse);
+  prefetch->request = next_req_;
+  prefetch->overall_deadline = MonoTime::Now() + configuration_.timeout();
+  prefetch->rpc_deadline = prefetch->overall_deadline;
+  if (configuration_.is_fault_tolerant()) {
+    // See SendScanRpc().
+    prefetch->rpc_deadline = MonoTime::Earliest(
+        prefetch->overall_deadline, MonoTime::Now() + table_->client()->default_rpc_timeout());
+  }
+  PrepareController(&prefetch->controller, prefetch->rpc_deadline);
+  prefetch_in_flight_ = true;
+  prefetched_.emplace_back(std::move(prefetch));
+  return prefetched_.back().get();
+}
+
+void KuduScanner::Data::SendPrefetch(PrefetchedResponse* prefetch) {
+  VLOG(2) << "Prefetching call_seq_id " << prefetch->request.call_seq_id()
+          << " of scanner " << prefetch->request.scanner_id();
+  prefetch->ts = ts_;
+  prefetch->send_time = MonoTime::Now();
+  prefetch->ts->RpcStarted();
+  proxy_->ScanAsync(prefetch->request, &prefetch->response, &prefetch->controller,
+                    boost::bind(&KuduScanner::Data::PrefetchDone, this, prefetch));
+}
+
+void KuduScanner::Data::PrefetchDone(PrefetchedResponse* prefetch) {
+  prefetch->ts->RpcFinished(MonoTime::Now() - prefetch->send_time);
+  PrefetchedResponse* next = nullptr;
+  {
+    MutexLock l(prefetch_lock_);
+    DCHECK(prefetch_in_flight_);
+    DCHECK_EQ(prefetch, prefetched_.back().get());
+    prefetch->done = true;
+    prefetch_in_flight_ = false;
+
+    prefetch->size_bytes = prefetch->response.ByteSize();
+    Slice sidecar;
+    for (int i = 0; prefetch->controller.GetSidecar(i, &sidecar).ok(); i++) {
+      prefetch->size_bytes += sidecar.size();
+    }
+    prefetched_bytes_ += prefetch->size_bytes;
+
+    // Keep going while the tablet has more results, stopping at the first
+    // failure so that it can be retried in order.
+    if (prefetch->succeeded() && prefetch->response.has_more_results()) {
+      next = QueuePrefetchUnlocked();
+    }
+    prefetch_cond_.Broadcast();
+  }
+  if (next) {
+    SendPrefetch(next);
+  }
+}
+
+bool KuduScanner::Data::TakePrefetchedResponse(ScanRpcStatus* status) {
+  unique_ptr<PrefetchedResponse> prefetch;
+  {
+    MutexLock l(prefetch_lock_);
+    if (prefetched_.empty()) {
+      return false;
+    }
+    while (!prefetched_.front()->done) {
+      prefetch_cond_.Wait();
+    }
+    prefetch = std::move(prefetched_.front());
+    prefetched_.pop_front();
+    prefetched_bytes_ -= prefetch->size_bytes;
+  }
+
+  controller_.Swap(&prefetch->controller);
+  last_response_.Swap(&prefetch->response);
+  *status = AnalyzeResponse(controller_.status(), prefetch->overall_deadline,
+                            prefetch->rpc_deadline);
+  if (status->result == ScanRpcStatus::OK) {
+    UpdateResourceMetrics();
+  }
+  return true;
+}
+
+void KuduScanner::Data::StopPrefetching() {
+  MutexLock l(prefetch_lock_);
+  prefetch_stopped_ = true;
+  while (prefetch_in_flight_) {
+    prefetch_cond_.Wait();
+  }
+  prefetched_.clear();
+  prefetched_bytes_ = 0;
+  prefetch_stopped_ = false;
+}
+
 ////////////////////////////////////////////////////////////
 // KuduScanBatch
 ////////////////////////////////////////////////////////////
 
-KuduScanBatch::Data::Data() : projection_(NULL) {}
+KuduScanBatch::Data::Data() : columnar_(false), projection_(NULL) {}
 
 KuduScanBatch::Data::~Data() {}
 
@@ -476,11 +773,19 @@ size_t KuduScanBatch::Data::CalculateProjectedRowSize(const Schema& proj) {
 Status KuduScanBatch::Data::Reset(RpcController* controller,
                                   const Schema* projection,
                                   const KuduSchema* client_projection,
-                                  gscoped_ptr<RowwiseRowBlockPB> data) {
+                                  ScanResponsePB* response) {
   CHECK(controller->finished());
   controller_.Swap(controller);
   projection_ = projection;
   client_projection_ = client_projection;
+  columnar_ = response->has_columnar_data();
+  if (columnar_) {
+    return ResetColumnar(make_gscoped_ptr(response->release_columnar_data()));
+  }
+  return ResetRowwise(make_gscoped_ptr(response->release_data()));
+}
+
+Status KuduScanBatch::Data::ResetRowwise(gscoped_ptr<RowwiseRowBlockPB> data) {
   resp_data_.Swap(data.get());
 
   // First, rewrite the relative addresses into absolute ones.
@@ -508,7 +813,27 @@ Status KuduScanBatch::Data::Reset(RpcController* controller,
   return Status::OK();
 }
 
+Status KuduScanBatch::Data::ResetColumnar(gscoped_ptr<ColumnarRowBlockPB> data) {
+  columnar_data_.Swap(data.get());
+  decoded_columns_.clear();
+
+  if (PREDICT_FALSE(!columnar_data_.has_sidecar())) {
+    return Status::Corruption("Server sent invalid response: no columnar data");
+  }
+  Slice sidecar;
+  Status s = controller_.GetSidecar(columnar_data_.sidecar(), &sidecar);
+  if (!s.ok()) {
+    return Status::Corruption("Server sent invalid response: columnar data "
+                              "sidecar index corrupt", s.ToString());
+  }
+
+  // Unlike the row-wise layout, no pointers need to be rewritten: the
+  // column buffers are handed out in place.
+  return ExtractColumnsFromColumnarRowBlockPB(*projection_, columnar_data_, sidecar, &columns_);
+}
+
 void KuduScanBatch::Data::ExtractRows(vector<KuduScanBatch::RowPtr>* rows) {
+  DCHECK(!columnar_) << "rows may not be extracted from a columnar batch";
   int n_rows = resp_data_.num_rows();
   rows->resize(n_rows);
 
@@ -533,8 +858,42 @@ void KuduScanBatch::Data::ExtractRows(vector<KuduScanBatch::RowPtr>* rows) {
   VLOG(1) << "Extracted " << rows->size() << " rows";
 }
 
+Status KuduScanBatch::Data::CheckColumnarColumn(int idx) const {
+  if (PREDICT_FALSE(!columnar_)) {
+    return Status::IllegalState("batch is not in the columnar layout");
+  }
+  if (PREDICT_FALSE(idx < 0 || idx >= columns_.size())) {
+    return Status::InvalidArgument(Substitute("invalid column index: $0", idx));
+  }
+  return Status::OK();
+}
+
+void KuduScanBatch::Data::GetVariableLengthColumn(int idx, Slice* offsets, Slice* data) {
+  const ColumnarColumnSlices& col = columns_[idx];
+  if (col.dictionary_offsets.empty()) {
+    *offsets = col.data;
+    *data = col.varlen_data;
+    return;
+  }
+  if (decoded_columns_.empty()) {
+    decoded_columns_.resize(columns_.size());
+  }
+  unique_ptr<DecodedColumn>& decoded = decoded_columns_[idx];
+  if (!decoded) {
+    decoded.reset(new DecodedColumn());
+    DecodeDictionaryColumn(col.data, col.dictionary_offsets, col.varlen_data,
+                           col.non_null_bitmap, num_rows(), &decoded->offsets, &decoded->data);
+  }
+  *offsets = Slice(decoded->offsets);
+  *data = Slice(decoded->data);
+}
+
 void KuduScanBatch::Data::Clear() {
+  columnar_ = false;
   resp_data_.Clear();
+  columnar_data_.Clear();
+  columns_.clear();
+  decoded_columns_.clear();
   controller_.Reset();
 }
 
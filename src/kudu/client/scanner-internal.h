@@ -17,6 +17,9 @@
 #ifndef KUDU_CLIENT_SCANNER_INTERNAL_H
 #define KUDU_CLIENT_SCANNER_INTERNAL_H
 
+#include <deque>
+#include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
@@ -27,9 +30,13 @@
 #include "kudu/client/scan_configuration.h"
 #include "kudu/common/partition_pruner.h"
 #include "kudu/common/scan_spec.h"
+#include "kudu/common/wire_protocol.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/tserver/tserver_service.proxy.h"
 #include "kudu/util/auto_release_pool.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/mutex.h"
 
 namespace kudu {
 
@@ -68,6 +75,10 @@ struct ScanRpcStatus {
     // The destination tablet does not exist (e.g. because the replica was deleted).
     TABLET_NOT_FOUND,
 
+    // The replica's safe time was older than the maximum staleness of a
+    // bounded-staleness scan.
+    REPLICA_TOO_STALE,
+
     // Some other unknown tablet server error. This indicates that the TS was running
     // but some problem occurred other than the ones enumerated above.
     OTHER_TS_ERROR
@@ -112,6 +123,11 @@ class KuduScanner::Data {
   // This blacklist may be modified by the callee.
   Status OpenNextTablet(const MonoTime& deadline, std::set<std::string>* blacklist);
 
+  // Looks up the tablets which a reverse-ordered scan must visit, and
+  // records their partition keys in 'reverse_partition_keys_'. This drains
+  // the partition pruner.
+  Status LookupReverseOrderedTablets(const MonoTime& deadline);
+
   // Open the current tablet in the scan again.
   // See OpenNextTablet for options.
   Status ReopenCurrentTablet(const MonoTime& deadline, std::set<std::string>* blacklist);
@@ -152,6 +168,25 @@ class KuduScanner::Data {
   // non-fatal (i.e. retriable) scan error is encountered.
   void UpdateLastError(const Status& error);
 
+  // If prefetching is enabled, the current tablet has more results, and the
+  // prefetch budget allows it, sends the next continuation RPC in the
+  // background. At most one prefetch RPC is in flight at a time, so that the
+  // tablet server receives the continuations in call_seq_id order.
+  void MaybeStartPrefetch();
+
+  // Waits for the oldest prefetched response and makes it the current one, in
+  // 'controller_' and 'last_response_'. Returns false if there is no
+  // prefetched response queued or in flight, otherwise returns true and sets
+  // 'status' to the result of the prefetched RPC.
+  //
+  // A failed prefetch leaves 'next_req_' as it was sent, so that the caller
+  // can retry it like any other failed continuation.
+  bool TakePrefetchedResponse(ScanRpcStatus* status);
+
+  // Stops prefetching: waits for the in-flight prefetch RPC, if any, and
+  // discards all prefetched responses.
+  void StopPrefetching();
+
   const ScanConfiguration& configuration() const {
     return configuration_;
   }
@@ -169,9 +204,26 @@ class KuduScanner::Data {
   // primary key bounds.
   bool short_circuit_;
 
+  // Whether the scan has returned as many rows as its limit allows.
+  bool LimitReached() const {
+    return configuration_.limit() >= 0 && rows_returned_ >= configuration_.limit();
+  }
+
+  // The number of rows returned so far, across all tablets.
+  int64_t rows_returned_;
+
   // The encoded last primary key from the most recent tablet scan response.
   std::string last_primary_key_;
 
+  // The token from which the scan of the current tablet may be resumed on
+  // 'ts_' should the scanner be lost, from the most recent response of an
+  // unordered snapshot scan. Empty if the scan can't be resumed.
+  std::string resume_token_;
+
+  // The snapshot timestamp of the scan of the current tablet, at which it
+  // must be resumed.
+  uint64_t resume_snap_timestamp_;
+
   internal::RemoteTabletServer* ts_;
 
   // The proxy can be derived from the RemoteTabletServer, but this involves retaking the
@@ -194,6 +246,10 @@ class KuduScanner::Data {
 
   PartitionPruner partition_pruner_;
 
+  // The lower bound partition keys of the tablets which a reverse-ordered
+  // scan has yet to visit, in ascending order. The last one is scanned next.
+  std::vector<std::string> reverse_partition_keys_;
+
   // The tablet we're scanning.
   scoped_refptr<internal::RemoteTablet> remote_;
 
@@ -205,6 +261,15 @@ class KuduScanner::Data {
   // actual storage for the batch that is returned.
   KuduScanBatch batch_for_old_api_;
 
+  // The merged results of the aggregates, once computed by
+  // KuduScanner::ComputeAggregates().
+  gscoped_ptr<KuduPartialRow> aggregate_result_;
+
+  // The merged results of the groups of grouped aggregates, once computed
+  // by KuduScanner::ComputeGroupedAggregates().
+  bool group_results_computed_;
+  std::vector<std::unique_ptr<KuduPartialRow>> group_results_;
+
   // The latest error experienced by this scan that provoked a retry. If the
   // scan times out, this error will be incorporated into the status that is
   // passed back to the client.
@@ -215,6 +280,11 @@ class KuduScanner::Data {
   // The scanner's cumulative resource metrics since the scan was started.
   ResourceMetrics resource_metrics_;
 
+  // The scanner's cumulative profile, and that of each column, since the
+  // scan was started, if profiling is enabled.
+  ResourceMetrics profile_;
+  std::map<std::string, std::map<std::string, int64_t>> column_profiles_;
+
  private:
   // Analyze the response of the last Scan RPC made by this scanner.
   //
@@ -234,6 +304,61 @@ class KuduScanner::Data {
 
   void UpdateResourceMetrics();
 
+  // Sets up 'controller' for a Scan RPC with the given deadline.
+  void PrepareController(rpc::RpcController* controller, const MonoTime& rpc_deadline) const;
+
+  // A continuation RPC sent in the background by MaybeStartPrefetch().
+  struct PrefetchedResponse {
+    tserver::ScanRequestPB request;
+    tserver::ScanResponsePB response;
+    rpc::RpcController controller;
+    MonoTime overall_deadline;
+    MonoTime rpc_deadline;
+    bool done = false;
+
+    // The server the prefetch was sent to, and when.
+    internal::RemoteTabletServer* ts = nullptr;
+    MonoTime send_time;
+
+    // The size of the response and its sidecars, once done.
+    int64_t size_bytes = 0;
+
+    bool succeeded() const {
+      return controller.status().ok() && !response.has_error();
+    }
+  };
+
+  // Advances 'next_req_' and queues a new prefetch for it, if prefetching is
+  // allowed. Returns the queued prefetch, which the caller must send with
+  // SendPrefetch() after releasing 'prefetch_lock_', or nullptr.
+  //
+  // REQUIRES: 'prefetch_lock_' is held.
+  PrefetchedResponse* QueuePrefetchUnlocked();
+
+  void SendPrefetch(PrefetchedResponse* prefetch);
+
+  // Callback for a prefetch RPC sent by SendPrefetch().
+  void PrefetchDone(PrefetchedResponse* prefetch);
+
+  // Protects the prefetching state below, and 'next_req_' while a prefetch
+  // may be queued from an RPC callback.
+  Mutex prefetch_lock_;
+
+  // Signalled when a prefetch RPC completes.
+  ConditionVariable prefetch_cond_;
+
+  // Prefetched responses, oldest first. Only the newest may still be in flight.
+  std::deque<std::unique_ptr<PrefetchedResponse>> prefetched_;
+
+  // Whether the newest entry of 'prefetched_' is still in flight.
+  bool prefetch_in_flight_;
+
+  // The total size of the completed responses in 'prefetched_'.
+  int64_t prefetched_bytes_;
+
+  // Set while StopPrefetching() waits, so that no further prefetches are sent.
+  bool prefetch_stopped_;
+
   DISALLOW_COPY_AND_ASSIGN(Data);
 };
 
@@ -242,16 +367,20 @@ class KuduScanBatch::Data {
   Data();
   ~Data();
 
+  // Takes the rows returned in 'response', in either the row-wise or the
+  // columnar layout. The sidecars holding the row data are taken from
+  // 'controller'.
   Status Reset(rpc::RpcController* controller,
                const Schema* projection,
                const KuduSchema* client_projection,
-               gscoped_ptr<RowwiseRowBlockPB> resp_data);
+               tserver::ScanResponsePB* response);
 
   int num_rows() const {
-    return resp_data_.num_rows();
+    return columnar_ ? columnar_data_.num_rows() : resp_data_.num_rows();
   }
 
   KuduRowResult row(int idx) {
+    DCHECK(!columnar_) << "rows may not be accessed in a columnar batch";
     DCHECK_GE(idx, 0);
     DCHECK_LT(idx, num_rows());
     int offset = idx * projected_row_size_;
@@ -260,6 +389,15 @@ class KuduScanBatch::Data {
 
   void ExtractRows(vector<KuduScanBatch::RowPtr>* rows);
 
+  // Returns a bad Status unless this is a columnar batch with a column at
+  // index 'idx'.
+  Status CheckColumnarColumn(int idx) const;
+
+  // Sets 'offsets' and 'data' to the plain layout of the BINARY column at
+  // index 'idx' of a columnar batch, decoding it first if it's
+  // dictionary-encoded.
+  void GetVariableLengthColumn(int idx, Slice* offsets, Slice* data);
+
   void Clear();
 
   // Returns the size of a row for the given projection 'proj'.
@@ -270,6 +408,11 @@ class KuduScanBatch::Data {
   // which contains the rows.
   rpc::RpcController controller_;
 
+  // Whether the batch was returned in the columnar layout, in which case
+  // 'columnar_data_' and 'columns_' are set instead of 'resp_data_' and the
+  // direct and indirect data.
+  bool columnar_;
+
   // The PB which contains the "direct data" slice.
   RowwiseRowBlockPB resp_data_;
 
@@ -277,13 +420,38 @@ class KuduScanBatch::Data {
   // by the members above.
   Slice direct_data_, indirect_data_;
 
+  // The PB which describes the column buffers of a columnar batch.
+  ColumnarRowBlockPB columnar_data_;
+
+  // Slices into the column buffers of a columnar batch, one per column of
+  // the projection.
+  std::vector<ColumnarColumnSlices> columns_;
+
+  // The plain layout of dictionary-encoded columns, decoded on first access.
+  // Indexed like 'columns_', with null entries for columns not yet decoded.
+  struct DecodedColumn {
+    faststring offsets;
+    faststring data;
+  };
+  std::vector<std::unique_ptr<DecodedColumn>> decoded_columns_;
+
   // The projection being scanned.
   const Schema* projection_;
   // The KuduSchema version of 'projection_'
   const KuduSchema* client_projection_;
 
+  // Keep the projections alive for batches which don't come from a scanner,
+  // such as those returned by KuduTable::LookupRows(). Unset otherwise.
+  std::shared_ptr<const Schema> owned_projection_;
+  std::shared_ptr<const KuduSchema> owned_client_projection_;
+
   // The number of bytes of direct data for each row.
   size_t projected_row_size_;
+
+ private:
+  Status ResetRowwise(gscoped_ptr<RowwiseRowBlockPB> resp_data);
+
+  Status ResetColumnar(gscoped_ptr<ColumnarRowBlockPB> columnar_data);
 };
 
 } // namespace client
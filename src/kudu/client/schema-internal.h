@@ -48,9 +48,13 @@ class KuduColumnSpec::Data {
   explicit Data(std::string name)
       : name(std::move(name)),
         has_type(false),
+        has_precision(false),
+        has_scale(false),
         has_encoding(false),
         has_compression(false),
         has_block_size(false),
+        has_compression_level(false),
+        bloom_filter(false),
         has_nullable(false),
         primary_key(false),
         has_default(false),
@@ -68,6 +72,12 @@ class KuduColumnSpec::Data {
   bool has_type;
   KuduColumnSchema::DataType type;
 
+  bool has_precision;
+  int8_t precision;
+
+  bool has_scale;
+  int8_t scale;
+
   bool has_encoding;
   KuduColumnStorageAttributes::EncodingType encoding;
 
@@ -77,6 +87,11 @@ class KuduColumnSpec::Data {
   bool has_block_size;
   int32_t block_size;
 
+  bool has_compression_level;
+  int32_t compression_level;
+
+  bool bloom_filter;
+
   bool has_nullable;
   bool nullable;
 
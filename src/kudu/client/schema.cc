@@ -33,7 +33,7 @@ MAKE_ENUM_LIMITS(kudu::client::KuduColumnStorageAttributes::EncodingType,
 
 MAKE_ENUM_LIMITS(kudu::client::KuduColumnStorageAttributes::CompressionType,
                  kudu::client::KuduColumnStorageAttributes::DEFAULT_COMPRESSION,
-                 kudu::client::KuduColumnStorageAttributes::ZLIB);
+                 kudu::client::KuduColumnStorageAttributes::ZSTD);
 
 MAKE_ENUM_LIMITS(kudu::client::KuduColumnSchema::DataType,
                  kudu::client::KuduColumnSchema::INT8,
@@ -46,6 +46,15 @@ using strings::Substitute;
 namespace kudu {
 namespace client {
 
+namespace {
+
+// The highest ZSTD level, as documented by KuduColumnSpec::CompressionLevel().
+// The client isn't linked with the codecs, so the master makes the final
+// check against those the servers run.
+const int32_t kMaxZstdCompressionLevel = 22;
+
+} // anonymous namespace
+
 kudu::EncodingType ToInternalEncodingType(KuduColumnStorageAttributes::EncodingType type) {
   switch (type) {
     case KuduColumnStorageAttributes::AUTO_ENCODING: return kudu::AUTO_ENCODING;
@@ -55,6 +64,7 @@ kudu::EncodingType ToInternalEncodingType(KuduColumnStorageAttributes::EncodingT
     case KuduColumnStorageAttributes::GROUP_VARINT: return kudu::GROUP_VARINT;
     case KuduColumnStorageAttributes::RLE: return kudu::RLE;
     case KuduColumnStorageAttributes::BIT_SHUFFLE: return kudu::BIT_SHUFFLE;
+    case KuduColumnStorageAttributes::DELTA_FOR: return kudu::DELTA_FOR;
     default: LOG(FATAL) << "Unexpected encoding type: " << type;
   }
 }
@@ -68,6 +78,7 @@ KuduColumnStorageAttributes::EncodingType FromInternalEncodingType(kudu::Encodin
     case kudu::GROUP_VARINT: return KuduColumnStorageAttributes::GROUP_VARINT;
     case kudu::RLE: return KuduColumnStorageAttributes::RLE;
     case kudu::BIT_SHUFFLE: return KuduColumnStorageAttributes::BIT_SHUFFLE;
+    case kudu::DELTA_FOR: return KuduColumnStorageAttributes::DELTA_FOR;
     default: LOG(FATAL) << "Unexpected internal encoding type: " << type;
   }
 }
@@ -79,6 +90,7 @@ kudu::CompressionType ToInternalCompressionType(KuduColumnStorageAttributes::Com
     case KuduColumnStorageAttributes::SNAPPY: return kudu::SNAPPY;
     case KuduColumnStorageAttributes::LZ4: return kudu::LZ4;
     case KuduColumnStorageAttributes::ZLIB: return kudu::ZLIB;
+    case KuduColumnStorageAttributes::ZSTD: return kudu::ZSTD;
     default: LOG(FATAL) << "Unexpected compression type" << type;
   }
 }
@@ -91,6 +103,7 @@ KuduColumnStorageAttributes::CompressionType FromInternalCompressionType(
     case kudu::SNAPPY: return KuduColumnStorageAttributes::SNAPPY;
     case kudu::LZ4: return KuduColumnStorageAttributes::LZ4;
     case kudu::ZLIB: return KuduColumnStorageAttributes::ZLIB;
+    case kudu::ZSTD: return KuduColumnStorageAttributes::ZSTD;
     default: LOG(FATAL) << "Unexpected internal compression type: " << type;
   }
 }
@@ -107,6 +120,9 @@ kudu::DataType ToInternalDataType(KuduColumnSchema::DataType type) {
     case KuduColumnSchema::STRING: return kudu::STRING;
     case KuduColumnSchema::BINARY: return kudu::BINARY;
     case KuduColumnSchema::BOOL: return kudu::BOOL;
+    // Decimal columns use the narrowest type fitting their precision (see
+    // KuduColumnSpec::ToColumnSchema()); without one, use the widest.
+    case KuduColumnSchema::DECIMAL: return kudu::DECIMAL64;
     default: LOG(FATAL) << "Unexpected data type: " << type;
   }
 }
@@ -123,6 +139,8 @@ KuduColumnSchema::DataType FromInternalDataType(kudu::DataType type) {
     case kudu::STRING: return KuduColumnSchema::STRING;
     case kudu::BINARY: return KuduColumnSchema::BINARY;
     case kudu::BOOL: return KuduColumnSchema::BOOL;
+    case kudu::DECIMAL32: return KuduColumnSchema::DECIMAL;
+    case kudu::DECIMAL64: return KuduColumnSchema::DECIMAL;
     default: LOG(FATAL) << "Unexpected internal data type: " << type;
   }
 }
@@ -145,6 +163,18 @@ KuduColumnSpec* KuduColumnSpec::Type(KuduColumnSchema::DataType type) {
   return this;
 }
 
+KuduColumnSpec* KuduColumnSpec::Precision(int8_t precision) {
+  data_->has_precision = true;
+  data_->precision = precision;
+  return this;
+}
+
+KuduColumnSpec* KuduColumnSpec::Scale(int8_t scale) {
+  data_->has_scale = true;
+  data_->scale = scale;
+  return this;
+}
+
 KuduColumnSpec* KuduColumnSpec::Default(KuduValue* v) {
   data_->has_default = true;
   delete data_->default_val;
@@ -172,6 +202,17 @@ KuduColumnSpec* KuduColumnSpec::BlockSize(int32_t block_size) {
   return this;
 }
 
+KuduColumnSpec* KuduColumnSpec::CompressionLevel(int32_t level) {
+  data_->has_compression_level = true;
+  data_->compression_level = level;
+  return this;
+}
+
+KuduColumnSpec* KuduColumnSpec::BloomFilter() {
+  data_->bloom_filter = true;
+  return this;
+}
+
 KuduColumnSpec* KuduColumnSpec::PrimaryKey() {
   data_->primary_key = true;
   return this;
@@ -219,6 +260,45 @@ Status KuduColumnSpec::ToColumnSchema(KuduColumnSchema* col) const {
   }
   DataType internal_type = ToInternalDataType(data_->type);
 
+  ColumnTypeAttributes type_attributes;
+  if (data_->type == KuduColumnSchema::DECIMAL) {
+    if (!data_->has_precision) {
+      return Status::InvalidArgument("no precision provided for decimal column", data_->name);
+    }
+    if (data_->precision < 1 || data_->precision > kMaxDecimal64Precision) {
+      return Status::InvalidArgument(
+          Substitute("precision must be between 1 and $0", kMaxDecimal64Precision),
+          data_->name);
+    }
+    type_attributes.precision = data_->precision;
+    type_attributes.scale = data_->has_scale ? data_->scale : 0;
+    internal_type = DecimalTypeForPrecision(type_attributes.precision);
+    RETURN_NOT_OK_PREPEND(type_attributes.Validate(internal_type), data_->name);
+  } else if (data_->has_precision || data_->has_scale) {
+    return Status::InvalidArgument("precision and scale are only valid for decimal columns",
+                                   data_->name);
+  }
+  if (data_->bloom_filter &&
+      (data_->type == KuduColumnSchema::FLOAT || data_->type == KuduColumnSchema::DOUBLE)) {
+    return Status::InvalidArgument("bloom filters are not supported for floating point columns",
+                                   data_->name);
+  }
+
+  if (data_->has_compression_level) {
+    // Codecs without levels ignore them, but with the default codec the
+    // servers may pick ZSTD.
+    bool leveled = !data_->has_compression ||
+        data_->compression == KuduColumnStorageAttributes::DEFAULT_COMPRESSION ||
+        data_->compression == KuduColumnStorageAttributes::ZSTD;
+    if (data_->compression_level < 0 ||
+        (leveled && data_->compression_level > kMaxZstdCompressionLevel)) {
+      return Status::InvalidArgument(
+          Substitute("bad compression level $0 (expected 0 to $1)",
+                     data_->compression_level, kMaxZstdCompressionLevel),
+          data_->name);
+    }
+  }
+
   bool nullable = data_->has_nullable ? data_->nullable : true;
 
   void* default_val = nullptr;
@@ -226,6 +306,16 @@ Status KuduColumnSpec::ToColumnSchema(KuduColumnSchema* col) const {
   if (data_->has_default) {
     RETURN_NOT_OK(data_->default_val->data_->CheckTypeAndGetPointer(
                       data_->name, internal_type, &default_val));
+    if (IsDecimalType(internal_type)) {
+      int64_t unscaled = *reinterpret_cast<const int64_t*>(default_val);
+      int64_t max = MaxUnscaledDecimal(type_attributes.precision);
+      if (unscaled > max || unscaled < -max) {
+        return Status::InvalidArgument(
+            Substitute("default value $0 out of range for decimal$1 column",
+                       unscaled, type_attributes.ToString()),
+            data_->name);
+      }
+    }
   }
 
 
@@ -251,6 +341,24 @@ Status KuduColumnSpec::ToColumnSchema(KuduColumnSchema* col) const {
                           default_val,
                           KuduColumnStorageAttributes(encoding, compression, block_size));
 
+  // The compression level, the bloom filter and the decimal type attributes
+  // aren't part of the public KuduColumnSchema constructor (adding them
+  // would change its signature), so apply them directly to the internal
+  // column schema.
+  if (data_->has_compression_level || data_->bloom_filter || IsDecimalType(internal_type)) {
+    const ColumnSchema* internal = col->col_;
+    ColumnStorageAttributes attributes = internal->attributes();
+    if (data_->has_compression_level) {
+      attributes.compression_level = data_->compression_level;
+    }
+    attributes.bloom_filter = data_->bloom_filter;
+    col->col_ = new ColumnSchema(internal->name(), internal_type,
+                                 internal->is_nullable(),
+                                 default_val, default_val,
+                                 attributes, type_attributes);
+    delete internal;
+  }
+
   return Status::OK();
 }
 
@@ -388,6 +496,9 @@ Status KuduSchemaBuilder::Build(KuduSchema* schema) {
 ////////////////////////////////////////////////////////////
 
 std::string KuduColumnSchema::DataTypeToString(DataType type) {
+  if (type == DECIMAL) {
+    return "DECIMAL";
+  }
   return DataType_Name(ToInternalDataType(type));
 }
 
@@ -449,6 +560,14 @@ KuduColumnSchema::DataType KuduColumnSchema::type() const {
   return FromInternalDataType(DCHECK_NOTNULL(col_)->type_info()->type());
 }
 
+int8_t KuduColumnSchema::precision() const {
+  return DCHECK_NOTNULL(col_)->type_attributes().precision;
+}
+
+int8_t KuduColumnSchema::scale() const {
+  return DCHECK_NOTNULL(col_)->type_attributes().scale;
+}
+
 
 ////////////////////////////////////////////////////////////
 // KuduSchema
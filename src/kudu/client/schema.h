@@ -61,7 +61,8 @@ class KUDU_EXPORT KuduColumnStorageAttributes {
     GROUP_VARINT = 3,
     RLE = 4,
     DICT_ENCODING = 5,
-    BIT_SHUFFLE = 6
+    BIT_SHUFFLE = 6,
+    DELTA_FOR = 7
   };
 
   /// @brief Column compression types.
@@ -71,6 +72,7 @@ class KUDU_EXPORT KuduColumnStorageAttributes {
     SNAPPY = 2,
     LZ4 = 3,
     ZLIB = 4,
+    ZSTD = 5,
   };
 
 
@@ -127,7 +129,8 @@ class KUDU_EXPORT KuduColumnSchema {
     DOUBLE = 7,
     BINARY = 8,
     UNIXTIME_MICROS = 9,
-    TIMESTAMP = UNIXTIME_MICROS //!< deprecated, use UNIXTIME_MICROS
+    TIMESTAMP = UNIXTIME_MICROS, //!< deprecated, use UNIXTIME_MICROS
+    DECIMAL = 10 //!< see KuduColumnSpec::Precision() and KuduColumnSpec::Scale()
   };
 
   /// @param [in] type
@@ -197,6 +200,12 @@ class KUDU_EXPORT KuduColumnSchema {
 
   /// @return @c true iff the column schema has the nullable attribute set.
   bool is_nullable() const;
+
+  /// @return The precision of a DECIMAL column, or 0 for other types.
+  int8_t precision() const;
+
+  /// @return The scale of a DECIMAL column, or 0 for other types.
+  int8_t scale() const;
   ///@}
 
  private:
@@ -273,6 +282,28 @@ class KUDU_EXPORT KuduColumnSpec {
   /// @return Pointer to the modified object.
   KuduColumnSpec* BlockSize(int32_t block_size);
 
+  /// Set the compression level for the column.
+  ///
+  /// Only meaningful for codecs which support levels (currently only ZSTD,
+  /// which accepts levels 1 to 22). Higher levels compress better but write
+  /// more slowly; decompression speed is largely unaffected.
+  ///
+  /// @param [in] level
+  ///   Compression level to use, or 0 for the codec's default level.
+  /// @return Pointer to the modified object.
+  KuduColumnSpec* CompressionLevel(int32_t level);
+
+  /// Keep a bloom filter of the column's values in each of its data files.
+  ///
+  /// Scans with an equality or IN-list predicate on the column skip the
+  /// files whose bloom filter rules out the predicate's values, which makes
+  /// selective predicates on columns outside the primary key much cheaper.
+  /// The filters take about 10 bits per distinct value of each file, and
+  /// aren't supported for FLOAT and DOUBLE columns.
+  ///
+  /// @return Pointer to the modified object.
+  KuduColumnSpec* BloomFilter();
+
   /// @name Operations only relevant for Create Table
   ///
   ///@{
@@ -309,6 +340,31 @@ class KUDU_EXPORT KuduColumnSpec {
   ///   The data type to set.
   /// @return Pointer to the modified object.
   KuduColumnSpec* Type(KuduColumnSchema::DataType type);
+
+  /// Set the precision of a DECIMAL column.
+  ///
+  /// This is the total number of digits of the column's values, between 1
+  /// and 18; it must be set for DECIMAL columns. Columns with a precision
+  /// of at most 9 are stored in 32-bit integers, the others in 64-bit ones.
+  ///
+  /// @note The precision may not be changed once a table is created.
+  ///
+  /// @param [in] precision
+  ///   The precision to set.
+  /// @return Pointer to the modified object.
+  KuduColumnSpec* Precision(int8_t precision);
+
+  /// Set the scale of a DECIMAL column.
+  ///
+  /// This is the number of digits after the decimal point, between 0 (the
+  /// default) and the precision.
+  ///
+  /// @note The scale may not be changed once a table is created.
+  ///
+  /// @param [in] scale
+  ///   The scale to set.
+  /// @return Pointer to the modified object.
+  KuduColumnSpec* Scale(int8_t scale);
   ///@}
 
   /// @name Operations only relevant for Alter Table
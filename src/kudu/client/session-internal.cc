@@ -46,6 +46,7 @@ KuduSession::Data::Data(shared_ptr<KuduClient> client,
       error_collector_(new ErrorCollector()),
       external_consistency_mode_(CLIENT_PROPAGATED),
       timeout_ms_(-1),
+      multi_tablet_writes_(false),
       flush_interval_(MonoDelta::FromMilliseconds(1000)),
       flush_task_active_(false),
       flush_mode_(AUTO_FLUSH_SYNC),
@@ -210,6 +211,14 @@ Status KuduSession::Data::SetMaxBatchersNum(unsigned int max_num) {
   return Status::OK();
 }
 
+void KuduSession::Data::SetMultiTabletWrites(bool enabled) {
+  std::lock_guard<Mutex> l(mutex_);
+  multi_tablet_writes_ = enabled;
+  if (batcher_) {
+    batcher_->set_multi_tablet_writes(enabled);
+  }
+}
+
 void KuduSession::Data::SetTimeoutMillis(int timeout_ms) {
   if (timeout_ms < 0) {
     timeout_ms = 0;
@@ -321,7 +330,8 @@ MonoDelta KuduSession::Data::FlushCurrentBatcher(const MonoDelta& max_age) {
 // it would be a memory leak.
 Status KuduSession::Data::ApplyWriteOp(
     const sp::weak_ptr<KuduSession>& weak_session,
-    KuduWriteOperation* write_op) {
+    KuduWriteOperation* write_op,
+    bool block) {
 
   if (!write_op) {
     return Status::InvalidArgument("NULL operation");
@@ -402,6 +412,12 @@ Status KuduSession::Data::ApplyWriteOp(
       // buffer space is over the limit. Once amount of buffered data drops
       // below the limit, a blocking call to Apply() is unblocked.
       while (buffer_bytes_used_ + required_size > max_size) {
+        if (!block) {
+          return Status::ServiceUnavailable(strings::Substitute(
+              "not enough mutation buffer space remaining for operation: "
+              "required additional $0 when $1 of $2 already used",
+              required_size, buffer_bytes_used_, max_size));
+        }
         condition_.Wait();
       }
     } else if (PREDICT_FALSE(buffer_bytes_used_ + required_size > max_size)) {
@@ -421,6 +437,10 @@ Status KuduSession::Data::ApplyWriteOp(
              batchers_num_ >= batchers_num_limit_) {
         // Wait until it's possible to add a new batcher given the limit
         // on the maximum outstanding batchers per session.
+        if (!block) {
+          return Status::ServiceUnavailable(strings::Substitute(
+              "all $0 mutation buffers are in use", batchers_num_limit_));
+        }
         condition_.Wait();
       }
       DCHECK(!batcher_);
@@ -434,6 +454,7 @@ Status KuduSession::Data::ApplyWriteOp(
       if (timeout_ms_ != -1) {
         batcher->SetTimeoutMillis(timeout_ms_);
       }
+      batcher->set_multi_tablet_writes(multi_tablet_writes_);
       batcher.swap(batcher_);
       ++batchers_num_;
     }
@@ -519,7 +540,7 @@ void KuduSession::Data::TimeBasedFlushTask(
   }
 }
 
-int64_t KuduSession::Data::GetPendingOperationsSizeForTests() const {
+int64_t KuduSession::Data::GetPendingOperationsSize() const {
   std::lock_guard<Mutex> l(mutex_);
   return buffer_bytes_used_;
 }
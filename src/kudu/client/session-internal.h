@@ -88,6 +88,9 @@ class KuduSession::Data {
   // Set timeout for write operations, in milliseconds.
   void SetTimeoutMillis(int timeout_ms);
 
+  // Set whether to write to the tablets sharing a leader in a single RPC.
+  void SetMultiTabletWrites(bool enabled);
+
   // Initiate flushing of the current batcher and invoke the specified callback
   // once the flushing is finished.
   void FlushAsync(KuduStatusCallback* cb);
@@ -123,8 +126,13 @@ class KuduSession::Data {
   MonoDelta FlushCurrentBatcher(const MonoDelta& max_age);
 
   // Apply a write operation, i.e. push it through the batcher chain.
+  //
+  // If 'block' is false, returns Status::ServiceUnavailable() instead of
+  // waiting for buffer space or for a batcher; the operation is then neither
+  // taken nor added to the error collector.
   Status ApplyWriteOp(const sp::weak_ptr<KuduSession>& session,
-                      KuduWriteOperation* write_op);
+                      KuduWriteOperation* write_op,
+                      bool block);
 
   // Check and start the time-based flush task in background, if necessary.
   void TimeBasedFlushInit(sp::weak_ptr<KuduSession> weak_session);
@@ -141,8 +149,8 @@ class KuduSession::Data {
                                  bool do_startup_check);
 
   // Get the total size of pending (i.e. both freshly added and
-  // in process of being flushed) operations. This method is used by tests only.
-  int64_t GetPendingOperationsSizeForTests() const;
+  // in process of being flushed) operations.
+  int64_t GetPendingOperationsSize() const;
 
   // Get the total number of batchers in the session.
   // This method is used by tests only.
@@ -170,6 +178,9 @@ class KuduSession::Data {
   // Timeout for the next batch.
   int timeout_ms_;
 
+  // Whether the batchers group their writes by tablet server.
+  bool multi_tablet_writes_;
+
   // Interval for the max-wait flush background task.
   MonoDelta flush_interval_;  // protected by mutex_
 
@@ -220,6 +231,7 @@ class KuduSession::Data {
 
  private:
   FRIEND_TEST(ClientTest, TestAutoFlushBackgroundApplyBlocks);
+  FRIEND_TEST(ClientTest, TestAutoFlushBackgroundTryApply);
 
   bool buffer_pre_flush_enabled_; // Set to 'false' only in test scenarios.
 
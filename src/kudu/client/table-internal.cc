@@ -17,12 +17,39 @@
 
 #include "kudu/client/table-internal.h"
 
+#include <set>
 #include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "kudu/client/client-internal.h"
+#include "kudu/client/meta_cache.h"
+#include "kudu/common/column_statistics.h"
+#include "kudu/common/schema.h"
+#include "kudu/common/wire_protocol.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/rpc_controller.h"
+#include "kudu/tserver/tserver_service.proxy.h"
+#include "kudu/util/async_util.h"
 
 namespace kudu {
 namespace client {
 
+using internal::RemoteTablet;
+using internal::RemoteTabletServer;
+using rpc::RpcController;
 using sp::shared_ptr;
+using std::map;
+using std::set;
+using std::string;
+using std::vector;
+using strings::Substitute;
+using tserver::GetColumnStatisticsRequestPB;
+using tserver::GetColumnStatisticsResponsePB;
+using tserver::MultiGetRequestPB;
+using tserver::MultiGetResponsePB;
 
 KuduTable::Data::Data(shared_ptr<KuduClient> client,
                       string name,
@@ -41,5 +68,148 @@ KuduTable::Data::Data(shared_ptr<KuduClient> client,
 KuduTable::Data::~Data() {
 }
 
+Status KuduTable::Data::GetTabletColumnStatistics(const scoped_refptr<RemoteTablet>& tablet,
+                                                  const MonoTime& deadline,
+                                                  GetColumnStatisticsResponsePB* resp) {
+  GetColumnStatisticsRequestPB req;
+  req.set_tablet_id(tablet->tablet_id());
+
+  set<string> blacklist;
+  Status last_error;
+  while (true) {
+    RemoteTabletServer* ts;
+    vector<RemoteTabletServer*> candidates;
+    Status s = client_->data_->GetTabletServer(client_.get(), tablet,
+                                               KuduClient::CLOSEST_REPLICA,
+                                               blacklist, &candidates, &ts);
+    if (!s.ok()) {
+      // Once every replica has failed, return the error of the last one.
+      return last_error.ok() ? s : last_error;
+    }
+
+    RpcController rpc;
+    rpc.set_deadline(deadline);
+    resp->Clear();
+    s = ts->proxy()->GetColumnStatistics(req, resp, &rpc);
+    if (s.ok() && resp->has_error()) {
+      s = StatusFromPB(resp->error().status());
+    }
+    if (s.ok()) {
+      return Status::OK();
+    }
+    last_error = s.CloneAndPrepend(
+        Substitute("unable to get column statistics of tablet $0 from $1",
+                   tablet->tablet_id(), ts->ToString()));
+    if (MonoTime::Now() >= deadline) {
+      return last_error;
+    }
+    VLOG(1) << last_error.ToString();
+    blacklist.insert(ts->permanent_uuid());
+  }
+}
+
+Status KuduTable::Data::MultiGet(const scoped_refptr<RemoteTablet>& tablet,
+                                 const MultiGetRequestPB& req,
+                                 const MonoTime& deadline,
+                                 MultiGetResponsePB* resp,
+                                 RpcController* rpc) {
+  set<string> blacklist;
+  Status last_error;
+  // Start with the leader, so that a READ_LATEST lookup sees the latest
+  // writes if it can.
+  KuduClient::ReplicaSelection selection = KuduClient::LEADER_ONLY;
+  while (true) {
+    RemoteTabletServer* ts;
+    vector<RemoteTabletServer*> candidates;
+    Status s = client_->data_->GetTabletServer(client_.get(), tablet, selection,
+                                               blacklist, &candidates, &ts);
+    if (!s.ok() && selection == KuduClient::LEADER_ONLY) {
+      selection = KuduClient::CLOSEST_REPLICA;
+      s = client_->data_->GetTabletServer(client_.get(), tablet, selection,
+                                          blacklist, &candidates, &ts);
+    }
+    if (!s.ok()) {
+      // Once every replica has failed, return the error of the last one.
+      return last_error.ok() ? s : last_error;
+    }
+
+    rpc->Reset();
+    rpc->set_deadline(deadline);
+    resp->Clear();
+    s = ts->proxy()->MultiGet(req, resp, rpc);
+    if (s.ok() && resp->has_error()) {
+      s = StatusFromPB(resp->error().status());
+    }
+    if (s.ok()) {
+      return Status::OK();
+    }
+    last_error = s.CloneAndPrepend(
+        Substitute("unable to look up rows of tablet $0 on $1",
+                   tablet->tablet_id(), ts->ToString()));
+    if (MonoTime::Now() >= deadline) {
+      return last_error;
+    }
+    VLOG(1) << last_error.ToString();
+    blacklist.insert(ts->permanent_uuid());
+  }
+}
+
+Status KuduTable::Data::GetColumnStatistics(const KuduTable* table,
+                                            const Schema& schema,
+                                            const MonoTime& deadline,
+                                            map<string, ColumnStatisticsPB>* stats) {
+  // The merged statistics, and the number of tablets which reported them.
+  map<string, ColumnStatisticsPB> merged;
+  map<string, int> num_tablets_by_column;
+  int num_tablets = 0;
+
+  string partition_key;
+  while (true) {
+    scoped_refptr<RemoteTablet> tablet;
+    Synchronizer sync;
+    client_->data_->meta_cache_->LookupTabletByKeyOrNext(table,
+                                                         partition_key,
+                                                         deadline,
+                                                         &tablet,
+                                                         sync.AsStatusCallback());
+    Status s = sync.Wait();
+    if (s.IsNotFound()) {
+      // No more tablets in the table.
+      break;
+    }
+    RETURN_NOT_OK(s);
+
+    GetColumnStatisticsResponsePB resp;
+    RETURN_NOT_OK(GetTabletColumnStatistics(tablet, deadline, &resp));
+    num_tablets++;
+    for (const GetColumnStatisticsResponsePB::ColumnPB& col : resp.columns()) {
+      int idx = schema.find_column(col.name());
+      if (idx == Schema::kColumnNotFound) {
+        // The column was dropped after the table was opened.
+        continue;
+      }
+      RETURN_NOT_OK_PREPEND(MergeColumnStatistics(schema.column(idx).type_info(),
+                                                  col.stats(), &merged[col.name()]),
+                            Substitute("unable to merge statistics of column $0 of tablet $1",
+                                       col.name(), tablet->tablet_id()));
+      num_tablets_by_column[col.name()]++;
+    }
+
+    partition_key = tablet->partition().partition_key_end();
+    if (partition_key.empty()) {
+      // The tablet covers the end of the table.
+      break;
+    }
+  }
+
+  stats->clear();
+  for (auto& e : merged) {
+    if (FindWithDefault(num_tablets_by_column, e.first, 0) == num_tablets) {
+      (*stats)[e.first].Swap(&e.second);
+    }
+  }
+  return Status::OK();
+}
+
 } // namespace client
 } // namespace kudu
@@ -17,15 +17,33 @@
 #ifndef KUDU_CLIENT_TABLE_INTERNAL_H
 #define KUDU_CLIENT_TABLE_INTERNAL_H
 
+#include <map>
 #include <string>
 
+#include "kudu/common/common.pb.h"
 #include "kudu/common/partition.h"
 #include "kudu/client/client.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/monotime.h"
 
 namespace kudu {
 
+namespace rpc {
+class RpcController;
+} // namespace rpc
+
+namespace tserver {
+class GetColumnStatisticsResponsePB;
+class MultiGetRequestPB;
+class MultiGetResponsePB;
+} // namespace tserver
+
 namespace client {
 
+namespace internal {
+class RemoteTablet;
+} // namespace internal
+
 class KuduTable::Data {
  public:
   Data(sp::shared_ptr<KuduClient> client,
@@ -36,6 +54,28 @@ class KuduTable::Data {
        PartitionSchema partition_schema);
   ~Data();
 
+  // Asks every tablet of 'table' for its column statistics, and merges them
+  // into 'stats', keyed by column name. Columns for which some tablet has no
+  // statistics are absent. 'schema' is the table's schema.
+  Status GetColumnStatistics(const KuduTable* table,
+                             const Schema& schema,
+                             const MonoTime& deadline,
+                             std::map<std::string, ColumnStatisticsPB>* stats);
+
+  // Fetches the column statistics of 'tablet' from one of its replicas,
+  // trying the others if a replica fails.
+  Status GetTabletColumnStatistics(const scoped_refptr<internal::RemoteTablet>& tablet,
+                                   const MonoTime& deadline,
+                                   tserver::GetColumnStatisticsResponsePB* resp);
+
+  // Sends 'req' to the leader of 'tablet', trying the others in turn if it
+  // fails. On success, 'rpc' holds the sidecars of the rows in 'resp'.
+  Status MultiGet(const scoped_refptr<internal::RemoteTablet>& tablet,
+                  const tserver::MultiGetRequestPB& req,
+                  const MonoTime& deadline,
+                  tserver::MultiGetResponsePB* resp,
+                  rpc::RpcController* rpc);
+
   sp::shared_ptr<KuduClient> client_;
 
   const std::string name_;
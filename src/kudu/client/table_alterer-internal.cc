@@ -90,6 +90,7 @@ Status KuduTableAlterer::Data::ToRequest(AlterTableRequestPB* req) {
         if (s.spec->data_->has_type ||
             s.spec->data_->has_encoding ||
             s.spec->data_->has_compression ||
+            s.spec->data_->bloom_filter ||
             s.spec->data_->has_nullable ||
             s.spec->data_->primary_key ||
             s.spec->data_->has_default ||
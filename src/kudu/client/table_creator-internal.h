@@ -24,6 +24,7 @@
 
 #include "kudu/client/client.h"
 #include "kudu/common/common.pb.h"
+#include "kudu/master/master.pb.h"
 
 namespace kudu {
 
@@ -55,6 +56,10 @@ class KuduTableCreator::Data {
 
   int num_replicas_;
 
+  CompactionPolicyPB compaction_policy_;
+
+  master::RangePartitionIntervalPB range_partition_interval_;
+
   MonoDelta timeout_;
 
   bool wait_;
@@ -33,6 +33,7 @@ RowOperationsPB_Type ToInternalWriteType(KuduWriteOperation::Type type) {
     case KuduWriteOperation::UPDATE: return RowOperationsPB_Type_UPDATE;
     case KuduWriteOperation::DELETE: return RowOperationsPB_Type_DELETE;
     case KuduWriteOperation::UPSERT: return RowOperationsPB_Type_UPSERT;
+    case KuduWriteOperation::INCREMENT: return RowOperationsPB_Type_INCREMENT;
     default: LOG(FATAL) << "Unexpected write operation type: " << type;
   }
 }
@@ -119,6 +120,14 @@ KuduUpsert::KuduUpsert(const shared_ptr<KuduTable>& table)
 
 KuduUpsert::~KuduUpsert() {}
 
+// Increment --------------------------------------------------------------------
+
+KuduIncrement::KuduIncrement(const shared_ptr<KuduTable>& table)
+  : KuduWriteOperation(table) {
+}
+
+KuduIncrement::~KuduIncrement() {}
+
 
 } // namespace client
 } // namespace kudu
@@ -59,7 +59,8 @@ class KUDU_EXPORT KuduWriteOperation {
     INSERT = 1,
     UPDATE = 2,
     DELETE = 3,
-    UPSERT = 4
+    UPSERT = 4,
+    INCREMENT = 5
   };
   virtual ~KuduWriteOperation();
 
@@ -224,6 +225,39 @@ class KUDU_EXPORT KuduDelete : public KuduWriteOperation {
   explicit KuduDelete(const sp::shared_ptr<KuduTable>& table);
 };
 
+
+/// @brief A single row increment to be sent to the cluster.
+///
+/// The values of the non-key columns set in the embedded KuduPartialRow
+/// object are added to the current values of the row on the tablet server,
+/// atomically with respect to other writes of the row.
+///
+/// @pre An increment requires the key columns and at least one other column
+///   in the schema to be set in the embedded KuduPartialRow object. The other
+///   columns must be integer or floating point columns, and can't be set
+///   to NULL.
+class KUDU_EXPORT KuduIncrement : public KuduWriteOperation {
+ public:
+  virtual ~KuduIncrement();
+
+  /// @copydoc KuduWriteOperation::ToString()
+  virtual std::string ToString() const OVERRIDE { return "INCREMENT " + row_.ToString(); }
+
+ protected:
+  /// @cond PROTECTED_MEMBERS_DOCUMENTED
+
+  /// @copydoc KuduWriteOperation::type()
+  virtual Type type() const OVERRIDE {
+    return INCREMENT;
+  }
+
+  /// @endcond
+
+ private:
+  friend class KuduTable;
+  explicit KuduIncrement(const sp::shared_ptr<KuduTable>& table);
+};
+
 } // namespace client
 } // namespace kudu
 
@@ -18,6 +18,9 @@
 #ifndef KUDU_CODEGEN_CODE_GENERATOR_H
 #define KUDU_CODEGEN_CODE_GENERATOR_H
 
+#include <vector>
+
+#include "kudu/codegen/predicate_evaluator.h"
 #include "kudu/codegen/row_projector.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
@@ -34,6 +37,7 @@ class Schema;
 
 namespace codegen {
 
+class PredicateEvaluatorFunctions;
 class RowProjectorFunctions;
 
 // CodeGenerator is a top-level class that manages a per-module
@@ -71,6 +75,11 @@ class CodeGenerator {
   Status CompileRowProjector(const Schema& base, const Schema& proj,
                              scoped_refptr<RowProjectorFunctions>* out);
 
+  // Attempts to initialize predicate evaluator functions by compiling code
+  // for the parameter predicate shapes. Writes to 'out' upon success.
+  Status CompilePredicateEvaluator(const std::vector<PredicateShape>& shapes,
+                                   scoped_refptr<PredicateEvaluatorFunctions>* out);
+
  private:
   static void GlobalInit();
 
@@ -22,17 +22,26 @@
 #include <glog/logging.h>
 #include <glog/stl_logging.h>
 #include <gmock/gmock.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/MemoryBuffer.h>
 
 #include "kudu/codegen/code_generator.h"
 #include "kudu/codegen/compilation_manager.h"
+#include "kudu/codegen/object_cache.h"
+#include "kudu/codegen/predicate_evaluator.h"
 #include "kudu/codegen/row_projector.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/row.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/bitmap.h"
+#include "kudu/util/env.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/logging_test_util.h"
+#include "kudu/util/path_util.h"
 #include "kudu/util/random.h"
 #include "kudu/util/random_util.h"
 #include "kudu/util/test_util.h"
@@ -49,6 +58,7 @@ typedef RowProjector NoCodegenRP;
 typedef codegen::RowProjector CodegenRP;
 
 using codegen::CompilationManager;
+using codegen::PersistentObjectCache;
 
 class CodegenTest : public KuduTest {
  public:
@@ -107,6 +117,10 @@ class CodegenTest : public KuduTest {
   // Generates a new row projector for the given projection schema.
   Status Generate(const Schema* proj, gscoped_ptr<CodegenRP>* out);
 
+  // Compares the selection made by a codegenned evaluator for 'predicates'
+  // over the test rows with evaluating each predicate in turn.
+  void TestPredicates(const vector<ColumnPredicate>& predicates);
+
   enum {
     // Base schema column indices
     kKeyCol,
@@ -226,6 +240,33 @@ Status CodegenTest::Generate(const Schema* proj, gscoped_ptr<CodegenRP>* out) {
   return Status::OK();
 }
 
+void CodegenTest::TestPredicates(const vector<ColumnPredicate>& predicates) {
+  RowBlock rb(base_, kNumTestRows, &projections_arena_);
+  projections_arena_.Reset();
+  NoCodegenRP identity(&base_, &base_);
+  ASSERT_OK(identity.Init());
+  ProjectTestRows<true>(&identity, &rb);
+
+  vector<codegen::PredicateShape> shapes;
+  ASSERT_OK(codegen::PredicateEvaluatorFunctions::BuildShapes(base_, predicates, &shapes));
+  scoped_refptr<codegen::PredicateEvaluatorFunctions> functions;
+  ASSERT_OK(generator_.CompilePredicateEvaluator(shapes, &functions));
+  codegen::PredicateEvaluator evaluator(predicates, functions);
+
+  SelectionVector expected(kNumTestRows);
+  expected.SetAllTrue();
+  for (const ColumnPredicate& pred : predicates) {
+    pred.Evaluate(rb.column_block(base_.find_column(pred.column().name())), &expected);
+  }
+
+  rb.selection_vector()->SetAllTrue();
+  evaluator.Evaluate(&rb);
+  for (int i = 0; i < kNumTestRows; i++) {
+    ASSERT_EQ(expected.IsRowSelected(i), rb.selection_vector()->IsRowSelected(i))
+      << "row " << i;
+  }
+}
+
 Status CodegenTest::CreatePartialSchema(const vector<size_t>& col_indexes,
                                         Schema* out) {
   vector<ColumnId> col_ids;
@@ -365,6 +406,92 @@ TEST_F(CodegenTest, TestDumpMC) {
   EXPECT_THAT(msgs[0], testing::ContainsRegex("retq"));
 }
 
+TEST_F(CodegenTest, TestPredicateEvaluation) {
+  const uint64_t key = 3;
+  const int32_t i32_lower = -(1 << 30);
+  const int32_t i32_upper = 1 << 30;
+  const Slice str_lower("a");
+  const Slice str_upper("n");
+
+  const ColumnSchema& key_col = base_.column(kKeyCol);
+  const ColumnSchema& i32_col = base_.column(kI32Col);
+  const ColumnSchema& i32_null_val_col = base_.column(kI32NullValCol);
+  const ColumnSchema& i32_null_col = base_.column(kI32NullCol);
+  const ColumnSchema& str_col = base_.column(kStrCol);
+  const ColumnSchema& str_null_val_col = base_.column(kStrNullValCol);
+
+  NO_FATALS(TestPredicates({ ColumnPredicate::Equality(key_col, &key) }));
+  NO_FATALS(TestPredicates({ ColumnPredicate::Range(i32_col, &i32_lower, &i32_upper) }));
+  NO_FATALS(TestPredicates({ ColumnPredicate::Range(i32_col, &i32_lower, nullptr),
+                             ColumnPredicate::Range(i32_null_val_col, nullptr, &i32_upper) }));
+  NO_FATALS(TestPredicates({ ColumnPredicate::IsNull(i32_null_col),
+                             ColumnPredicate::IsNotNull(str_null_val_col) }));
+  NO_FATALS(TestPredicates({ ColumnPredicate::IsNotNull(i32_null_col) }));
+  NO_FATALS(TestPredicates({ ColumnPredicate::Range(str_col, &str_lower, &str_upper),
+                             ColumnPredicate::Range(str_null_val_col, &str_lower, nullptr),
+                             ColumnPredicate::Range(i32_col, nullptr, &i32_upper) }));
+}
+
+// Predicate evaluators are compiled asynchronously and shared between
+// predicates of the same shape, whatever their values.
+TEST_F(CodegenTest, TestPredicateEvaluatorCache) {
+  Singleton<CompilationManager>::UnsafeReset();
+  CompilationManager* cm = CompilationManager::GetSingleton();
+
+  const int32_t lower1 = 10, upper1 = 20, lower2 = -5, upper2 = 5;
+  const ColumnSchema& i32_col = base_.column(kI32Col);
+  vector<ColumnPredicate> preds1 = { ColumnPredicate::Range(i32_col, &lower1, &upper1) };
+  vector<ColumnPredicate> preds2 = { ColumnPredicate::Range(i32_col, &lower2, &upper2) };
+
+  gscoped_ptr<codegen::PredicateEvaluator> evaluator;
+  ASSERT_FALSE(cm->RequestPredicateEvaluator(&base_, preds1, &evaluator));
+  cm->Wait();
+  ASSERT_TRUE(cm->RequestPredicateEvaluator(&base_, preds1, &evaluator));
+  ASSERT_TRUE(cm->RequestPredicateEvaluator(&base_, preds2, &evaluator));
+
+  // A different shape (here, a missing upper bound) needs its own code.
+  vector<ColumnPredicate> preds3 = { ColumnPredicate::Range(i32_col, &lower1, nullptr) };
+  ASSERT_FALSE(cm->RequestPredicateEvaluator(&base_, preds3, &evaluator));
+
+  // IN-list predicates are never code-generated.
+  vector<const void*> values = { &lower1, &upper1 };
+  vector<ColumnPredicate> in_list = { ColumnPredicate::InList(i32_col, &values) };
+  ASSERT_FALSE(cm->RequestPredicateEvaluator(&base_, in_list, &evaluator));
+  cm->Wait();
+  ASSERT_FALSE(cm->RequestPredicateEvaluator(&base_, in_list, &evaluator));
+}
+
+// Object code persisted for a module is loaded back for that module only,
+// and only if its checksum matches.
+TEST_F(CodegenTest, TestPersistentObjectCache) {
+  PersistentObjectCache cache(env_.get(), GetTestPath("jit"));
+  ASSERT_OK(cache.Init());
+
+  const string key = PersistentObjectCache::ComputeKey("module ir", "target");
+  ASSERT_NE(key, PersistentObjectCache::ComputeKey("other module ir", "target"));
+  ASSERT_NE(key, PersistentObjectCache::ComputeKey("module ir", "other target"));
+  llvm::LLVMContext context;
+  llvm::Module module(key, context);
+  ASSERT_FALSE(cache.Contains(key));
+  ASSERT_TRUE(cache.getObject(&module) == nullptr);
+
+  const string object = "not really object code";
+  cache.notifyObjectCompiled(&module, llvm::MemoryBufferRef(object, key));
+  ASSERT_TRUE(cache.Contains(key));
+  std::unique_ptr<llvm::MemoryBuffer> buf = cache.getObject(&module);
+  ASSERT_TRUE(buf != nullptr);
+  ASSERT_EQ(object, buf->getBuffer().str());
+
+  // Flip a byte of the object code: the file is ignored and removed.
+  string path = JoinPathSegments(GetTestPath("jit"), key + ".o");
+  faststring contents;
+  ASSERT_OK(ReadFileToString(env_.get(), path, &contents));
+  contents.data()[contents.size() - 1] ^= 1;
+  ASSERT_OK(WriteStringToFile(env_.get(), Slice(contents), path));
+  ASSERT_TRUE(cache.getObject(&module) == nullptr);
+  ASSERT_FALSE(cache.Contains(key));
+}
+
 // Basic test for the CompilationManager code cache.
 // This runs a bunch of compilation tasks and ensures that the cache
 // sometimes hits on the second attempt for the same projection.
@@ -23,11 +23,15 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "kudu/codegen/code_cache.h"
 #include "kudu/codegen/code_generator.h"
 #include "kudu/codegen/jit_wrapper.h"
+#include "kudu/codegen/predicate_evaluator.h"
 #include "kudu/codegen/row_projector.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/schema.h"
 #include "kudu/gutil/casts.h"
 #include "kudu/gutil/gscoped_ptr.h"
@@ -43,6 +47,7 @@
 #include "kudu/util/threadpool.h"
 
 using std::shared_ptr;
+using std::vector;
 
 DEFINE_bool(codegen_time_compilation, false, "Whether to print time that each code "
             "generation request took.");
@@ -119,6 +124,45 @@ class CompilationTask : public Runnable {
   DISALLOW_COPY_AND_ASSIGN(CompilationTask);
 };
 
+// The analogous task for predicate evaluators. Only the predicates' shapes
+// are kept, since the requesting scan (and the predicate values it owns) may
+// be gone by the time the task runs.
+class PredicateCompilationTask : public Runnable {
+ public:
+  PredicateCompilationTask(vector<PredicateShape> shapes, CodeCache* cache,
+                           CodeGenerator* generator)
+    : shapes_(std::move(shapes)),
+      cache_(cache),
+      generator_(generator) {}
+
+  void Run() override {
+    WARN_NOT_OK(RunWithStatus(), "Failed compilation of predicate evaluator");
+  }
+
+ private:
+  Status RunWithStatus() {
+    faststring key;
+    RETURN_NOT_OK(PredicateEvaluatorFunctions::EncodeKey(shapes_, &key));
+
+    // Requests for the same shape may have queued up behind the first one.
+    if (cache_->Lookup(key)) return Status::OK();
+
+    scoped_refptr<PredicateEvaluatorFunctions> functions;
+    LOG_TIMING_IF(INFO, FLAGS_codegen_time_compilation, "code-generating predicate evaluator") {
+      RETURN_NOT_OK(generator_->CompilePredicateEvaluator(shapes_, &functions));
+    }
+
+    RETURN_NOT_OK(cache_->AddEntry(functions));
+    return Status::OK();
+  }
+
+  const vector<PredicateShape> shapes_;
+  CodeCache* const cache_;
+  CodeGenerator* const generator_;
+
+  DISALLOW_COPY_AND_ASSIGN(PredicateCompilationTask);
+};
+
 } // anonymous namespace
 
 CompilationManager::CompilationManager()
@@ -196,5 +240,36 @@ bool CompilationManager::RequestRowProjector(const Schema* base_schema,
   return true;
 }
 
+bool CompilationManager::RequestPredicateEvaluator(const Schema* schema,
+                                                   const vector<ColumnPredicate>& predicates,
+                                                   gscoped_ptr<PredicateEvaluator>* out) {
+  vector<PredicateShape> shapes;
+  if (!PredicateEvaluatorFunctions::BuildShapes(*schema, predicates, &shapes).ok()) {
+    // Not an error: the caller simply keeps using the interpreted path.
+    return false;
+  }
+  faststring key;
+  Status s = PredicateEvaluatorFunctions::EncodeKey(shapes, &key);
+  WARN_NOT_OK(s, "PredicateEvaluator compilation request failed");
+  if (!s.ok()) return false;
+  query_counter_.Increment();
+
+  scoped_refptr<PredicateEvaluatorFunctions> cached(
+    down_cast<PredicateEvaluatorFunctions*>(cache_.Lookup(key).get()));
+
+  if (!cached) {
+    shared_ptr<Runnable> task(
+      new PredicateCompilationTask(std::move(shapes), &cache_, &generator_));
+    WARN_NOT_OK(pool_->Submit(task),
+                "PredicateEvaluator compilation request failed");
+    return false;
+  }
+
+  hit_counter_.Increment();
+
+  out->reset(new PredicateEvaluator(predicates, cached));
+  return true;
+}
+
 } // namespace codegen
 } // namespace kudu
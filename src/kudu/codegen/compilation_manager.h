@@ -18,6 +18,8 @@
 #ifndef KUDU_CODEGEN_COMPILATION_MANAGER_H
 #define KUDU_CODEGEN_COMPILATION_MANAGER_H
 
+#include <vector>
+
 #include "kudu/codegen/code_generator.h"
 #include "kudu/codegen/code_cache.h"
 #include "kudu/gutil/gscoped_ptr.h"
@@ -30,11 +32,13 @@ namespace kudu {
 
 class Counter;
 class MetricEntity;
+class ColumnPredicate;
 class MetricRegistry;
 class ThreadPool;
 
 namespace codegen {
 
+class PredicateEvaluator;
 class RowProjector;
 
 // The compilation manager is a top-level class which manages the actual
@@ -76,6 +80,19 @@ class CompilationManager {
                            const Schema* projection,
                            gscoped_ptr<RowProjector>* out);
 
+  // If a codegenned evaluator for a conjunction of predicates with the same
+  // shape (see codegen::PredicateShape) over 'schema' is ready, then it is
+  // written to 'out' and true is returned. Otherwise, this enqueues a
+  // compilation task for the shape and returns false, and the caller should
+  // keep evaluating the predicates itself until a later request succeeds.
+  // Upon any failure (including predicates which cannot be code-generated),
+  // false is returned. Does not write to 'out' if false is returned.
+  //
+  // The predicates must outlive the evaluator.
+  bool RequestPredicateEvaluator(const Schema* schema,
+                                 const std::vector<ColumnPredicate>& predicates,
+                                 gscoped_ptr<PredicateEvaluator>* out);
+
   // Waits for all asynchronous compilation tasks to finish.
   void Wait();
 
@@ -41,8 +41,10 @@
 #include <llvm/Transforms/IPO.h>
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
 
+#include "kudu/codegen/object_cache.h"
 #include "kudu/codegen/precompiled.ll.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/status.h"
 
@@ -121,7 +123,9 @@ bool ModuleContains(const Module& m, const Function* fptr) {
 ModuleBuilder::ModuleBuilder()
   : state_(kUninitialized),
     context_(new LLVMContext()),
-    builder_(*context_) {}
+    builder_(*context_),
+    target_(nullptr),
+    embeds_pointers_(false) {}
 
 ModuleBuilder::~ModuleBuilder() {}
 
@@ -179,8 +183,9 @@ Type* ModuleBuilder::GetType(const string& name) {
   return CHECK_NOTNULL(module_->getTypeByName(name));
 }
 
-Value* ModuleBuilder::GetPointerValue(void* ptr) const {
+Value* ModuleBuilder::GetPointerValue(void* ptr) {
   CHECK_EQ(state_, kBuilding);
+  embeds_pointers_ = true;
   // No direct way of creating constant pointer values in LLVM, so
   // first a constant int has to be created and then casted to a pointer
   IntegerType* llvm_uintptr_t = Type::getIntNTy(*context_, 8 * sizeof(ptr));
@@ -266,12 +271,28 @@ Status ModuleBuilder::Compile(unique_ptr<ExecutionEngine>* out) {
 #else
   Level opt_level = llvm::CodeGenOpt::None;
 #endif
+  string cpu = llvm::sys::getHostCPUName();
+  vector<string> attrs = GetHostCPUAttrs();
+
+  // Key the module by its IR before any optimization, so that a cached object
+  // also spares running the optimization passes.
+  PersistentObjectCache* object_cache =
+      embeds_pointers_ ? nullptr : PersistentObjectCache::GetSingleton();
+  bool cached = false;
+  if (object_cache) {
+    string target_desc = Substitute("$0 $1 -O$2", cpu, JoinStrings(attrs, ","),
+                                    static_cast<int>(opt_level));
+    string key = PersistentObjectCache::ComputeKey(ToString(*module_), target_desc);
+    module_->setModuleIdentifier(key);
+    cached = object_cache->Contains(key);
+  }
+
   Module* module = module_.get();
   EngineBuilder ebuilder(move(module_));
   ebuilder.setErrorStr(&str);
   ebuilder.setOptLevel(opt_level);
-  ebuilder.setMCPU(llvm::sys::getHostCPUName());
-  ebuilder.setMAttrs(GetHostCPUAttrs());
+  ebuilder.setMCPU(cpu);
+  ebuilder.setMAttrs(attrs);
   target_ = ebuilder.selectTarget();
   unique_ptr<ExecutionEngine> local_engine(ebuilder.create(target_));
   if (!local_engine) {
@@ -280,9 +301,14 @@ Status ModuleBuilder::Compile(unique_ptr<ExecutionEngine>* out) {
                                       str);
   }
   module->setDataLayout(target_->createDataLayout());
+  if (object_cache) {
+    local_engine->setObjectCache(object_cache);
+  }
 
 #if CODEGEN_MODULE_BUILDER_DO_OPTIMIZATIONS
-  DoOptimizations(local_engine.get(), module, GetFunctionNames());
+  if (!cached) {
+    DoOptimizations(local_engine.get(), module, GetFunctionNames());
+  }
 #endif
 
   // Compile the module
@@ -83,8 +83,10 @@ class ModuleBuilder {
   llvm::Type* GetType(const std::string& name);
   // Retrieve a precompiled function
   llvm::Function* GetFunction(const std::string& name);
-  // Get the LLVM wrapper for a constant pointer value of type i8*
-  llvm::Value* GetPointerValue(void* ptr) const;
+  // Get the LLVM wrapper for a constant pointer value of type i8*. Since the
+  // compiled code is then only valid in this process, it isn't persisted
+  // to the codegen object cache (see PersistentObjectCache).
+  llvm::Value* GetPointerValue(void* ptr);
 
   LLVMBuilder* builder() { return &builder_; }
 
@@ -106,6 +108,9 @@ class ModuleBuilder {
   // this method, only destructed. Upon success, releases ownership
   // of the execution engine through the 'out' parameter.
   //
+  // If --codegen_object_cache_dir is set, object code compiled for the same
+  // module by an earlier process is loaded rather than compiled again.
+  //
   // After this method has been called, the jit-compiled code may be
   // called as long as 'out' remains alive. Once 'out' destructs,
   // the code will be freed.
@@ -143,6 +148,9 @@ class ModuleBuilder {
   LLVMBuilder builder_;
   llvm::TargetMachine* target_; // not owned
 
+  // Whether the module embeds addresses from this process.
+  bool embeds_pointers_;
+
   DISALLOW_COPY_AND_ASSIGN(ModuleBuilder);
 };
 
@@ -0,0 +1,188 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/codegen/object_cache.h"
+
+#include <cstring>
+#include <utility>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include "kudu/gutil/endian.h"
+#include "kudu/gutil/hash/city.h"
+#include "kudu/gutil/once.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/crc.h"
+#include "kudu/util/env.h"
+#include "kudu/util/env_util.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/path_util.h"
+#include "kudu/util/version_info.h"
+
+DEFINE_string(codegen_object_cache_dir, "",
+              "Directory in which the object code of code-generated functions is persisted, "
+              "so that it is only compiled once rather than on every start of the server. "
+              "If empty, compiled code is only cached in memory.");
+TAG_FLAG(codegen_object_cache_dir, experimental);
+
+using std::string;
+using std::unique_ptr;
+using strings::Substitute;
+
+namespace kudu {
+namespace codegen {
+
+namespace {
+
+// Each file holds the magic, the object code's length and CRC32C, all
+// little-endian, then the object code.
+const char kMagic[] = "kudujit1";
+const size_t kMagicLen = sizeof(kMagic) - 1;
+const size_t kHeaderLen = kMagicLen + 2 * sizeof(uint32_t);
+
+PersistentObjectCache* g_cache = nullptr;
+GoogleOnceType g_cache_once = GOOGLE_ONCE_INIT;
+
+void InitSingleton() {
+  if (FLAGS_codegen_object_cache_dir.empty()) {
+    return;
+  }
+  unique_ptr<PersistentObjectCache> cache(
+      new PersistentObjectCache(Env::Default(), FLAGS_codegen_object_cache_dir));
+  Status s = cache->Init();
+  if (!s.ok()) {
+    LOG(WARNING) << "Unable to open the codegen object cache, compiled code "
+                 << "will not be persisted: " << s.ToString();
+    return;
+  }
+  // Never deleted, since execution engines may use it until exit.
+  g_cache = cache.release();
+}
+
+} // anonymous namespace
+
+PersistentObjectCache* PersistentObjectCache::GetSingleton() {
+  GoogleOnceInit(&g_cache_once, &InitSingleton);
+  return g_cache;
+}
+
+PersistentObjectCache::PersistentObjectCache(Env* env, string dir)
+    : env_(env),
+      dir_(std::move(dir)) {
+}
+
+PersistentObjectCache::~PersistentObjectCache() {}
+
+Status PersistentObjectCache::Init() {
+  return env_util::CreateDirIfMissing(env_, dir_);
+}
+
+string PersistentObjectCache::ComputeKey(const string& module_ir, const string& target_desc) {
+  string build = Substitute("$0\n$1\n$2\n", VersionInfo::GetShortVersionString(),
+                            LLVM_VERSION_STRING, target_desc);
+  uint128 build_hash = util_hash::CityHash128(build.data(), build.size());
+  return Uint128ToHexString(
+      util_hash::CityHash128WithSeed(module_ir.data(), module_ir.size(), build_hash));
+}
+
+string PersistentObjectCache::PathForKey(const string& key) const {
+  return JoinPathSegments(dir_, key + ".o");
+}
+
+bool PersistentObjectCache::Contains(const string& key) const {
+  return env_->FileExists(PathForKey(key));
+}
+
+void PersistentObjectCache::notifyObjectCompiled(const llvm::Module* module,
+                                                 llvm::MemoryBufferRef obj) {
+  const string& key = module->getModuleIdentifier();
+  WARN_NOT_OK(Write(key, obj.getBufferStart(), obj.getBufferSize()),
+              Substitute("Unable to persist the object code of module $0", key));
+}
+
+unique_ptr<llvm::MemoryBuffer> PersistentObjectCache::getObject(const llvm::Module* module) {
+  const string& key = module->getModuleIdentifier();
+  string object;
+  Status s = Read(key, &object);
+  if (s.IsNotFound()) {
+    return nullptr;
+  }
+  if (!s.ok()) {
+    LOG(WARNING) << "Ignoring the cached object code of module " << key << ": " << s.ToString();
+    WARN_NOT_OK(env_->DeleteFile(PathForKey(key)), "Unable to delete cached object code");
+    return nullptr;
+  }
+  VLOG(1) << "Loaded the cached object code of module " << key;
+  return llvm::MemoryBuffer::getMemBufferCopy(object, key);
+}
+
+Status PersistentObjectCache::Write(const string& key, const char* data, size_t size) {
+  uint8_t header[kHeaderLen];
+  memcpy(header, kMagic, kMagicLen);
+  LittleEndian::Store32(header + kMagicLen, size);
+  LittleEndian::Store32(header + kMagicLen + sizeof(uint32_t), crc::Crc32c(data, size));
+
+  // Write to a temporary file first, so that concurrent readers, possibly in
+  // other processes, never see a partial file.
+  const string path = PathForKey(key);
+  string tmp_path;
+  gscoped_ptr<WritableFile> file;
+  RETURN_NOT_OK(env_->NewTempWritableFile(WritableFileOptions(), path + ".tmp.XXXXXX",
+                                          &tmp_path, &file));
+  Status s = file->Append(Slice(header, kHeaderLen));
+  if (s.ok()) s = file->Append(Slice(data, size));
+  if (s.ok()) s = file->Close();
+  if (s.ok()) s = env_->RenameFile(tmp_path, path);
+  if (!s.ok()) {
+    WARN_NOT_OK(env_->DeleteFile(tmp_path), "Unable to delete temporary file");
+  }
+  return s;
+}
+
+Status PersistentObjectCache::Read(const string& key, string* object) {
+  const string path = PathForKey(key);
+  if (!env_->FileExists(path)) {
+    return Status::NotFound("no cached object code", key);
+  }
+  faststring buf;
+  RETURN_NOT_OK(ReadFileToString(env_, path, &buf));
+  if (buf.size() < kHeaderLen || memcmp(buf.data(), kMagic, kMagicLen) != 0) {
+    return Status::Corruption("bad header", path);
+  }
+  uint32_t size = LittleEndian::Load32(buf.data() + kMagicLen);
+  uint32_t crc = LittleEndian::Load32(buf.data() + kMagicLen + sizeof(uint32_t));
+  if (buf.size() != kHeaderLen + size) {
+    return Status::Corruption(Substitute("expected $0 bytes of object code, found $1",
+                                         size, buf.size() - kHeaderLen), path);
+  }
+  const uint8_t* data = buf.data() + kHeaderLen;
+  if (crc::Crc32c(data, size) != crc) {
+    return Status::Corruption("checksum mismatch", path);
+  }
+  object->assign(reinterpret_cast<const char*>(data), size);
+  return Status::OK();
+}
+
+} // namespace codegen
+} // namespace kudu
@@ -0,0 +1,93 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef KUDU_CODEGEN_OBJECT_CACHE_H
+#define KUDU_CODEGEN_OBJECT_CACHE_H
+
+#include <memory>
+#include <string>
+
+#include <llvm/ExecutionEngine/ObjectCache.h>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/status.h"
+
+namespace llvm {
+class MemoryBuffer;
+class MemoryBufferRef;
+class Module;
+} // namespace llvm
+
+namespace kudu {
+
+class Env;
+
+namespace codegen {
+
+// An LLVM object cache which persists the object code compiled for modules to
+// files in a directory, so that a module compiled by an earlier process
+// needn't be compiled again.
+//
+// Modules are looked up by their identifier, which must be set to the key
+// returned by ComputeKey(). Since the key hashes the module's IR along with
+// the Kudu and LLVM builds and the target, code compiled for one build or
+// CPU is never loaded by another. Each file also holds a checksum of its
+// object code, and files failing it are ignored and removed.
+//
+// Only modules which don't embed addresses of the process which built them
+// may be cached.
+//
+// This class is thread-safe.
+class PersistentObjectCache : public llvm::ObjectCache {
+ public:
+  // Returns the cache in --codegen_object_cache_dir, or null if the flag
+  // is empty or the directory can't be created.
+  static PersistentObjectCache* GetSingleton();
+
+  PersistentObjectCache(Env* env, std::string dir);
+  ~PersistentObjectCache();
+
+  // Creates the cache directory if it's missing.
+  Status Init();
+
+  // Returns the key of a module with the IR 'module_ir', compiled for the
+  // target described by 'target_desc'.
+  static std::string ComputeKey(const std::string& module_ir, const std::string& target_desc);
+
+  // Returns true if object code was cached under 'key'.
+  bool Contains(const std::string& key) const;
+
+  void notifyObjectCompiled(const llvm::Module* module, llvm::MemoryBufferRef obj) override;
+
+  std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module* module) override;
+
+ private:
+  std::string PathForKey(const std::string& key) const;
+
+  Status Write(const std::string& key, const char* data, size_t size);
+  Status Read(const std::string& key, std::string* object);
+
+  Env* const env_;
+  const std::string dir_;
+
+  DISALLOW_COPY_AND_ASSIGN(PersistentObjectCache);
+};
+
+} // namespace codegen
+} // namespace kudu
+
+#endif
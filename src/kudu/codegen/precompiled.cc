@@ -36,7 +36,9 @@
 #include <cstdlib>
 #include <cstring>
 
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/rowblock.h"
+#include "kudu/common/types.h"
 #include "kudu/util/bitmap.h"
 #include "kudu/util/memory/arena.h"
 
@@ -85,6 +87,53 @@ IR_ALWAYS_INLINE static bool BasicCopyCell(
   return true;
 }
 
+// Evaluates a single column predicate over every selected row of 'block',
+// clearing the selection bit of rows which don't match. The column index,
+// nullability and predicate type are constants in the generated code, as is
+// a missing bound (passed as NULL), so after inlining only the comparisons
+// that the predicate actually needs remain in the loop.
+template <DataType PhysicalType>
+IR_ALWAYS_INLINE static void EvaluatePredicateForType(
+    RowBlock* block, uint64_t col, bool nullable, uint32_t pred_type,
+    const uint8_t* lower, const uint8_t* upper, SelectionVector* sel) {
+  typedef DataTypeTraits<PhysicalType> Traits;
+  typedef typename Traits::cpp_type cpp_type;
+  const PredicateType type = static_cast<PredicateType>(pred_type);
+  const cpp_type* cells = reinterpret_cast<const cpp_type*>(block->column_data_base_ptr(col));
+  const uint8_t* null_bitmap = nullable ? block->column_null_bitmap_ptr(col) : nullptr;
+  uint8_t* sel_bitmap = sel->mutable_bitmap();
+  const size_t nrows = block->nrows();
+
+  for (size_t i = 0; i < nrows; i++) {
+    if (!BitmapTest(sel_bitmap, i)) continue;
+    // A set bit in the null bitmap indicates a non-null cell.
+    bool is_null = nullable && !BitmapTest(null_bitmap, i);
+    bool match;
+    switch (type) {
+      case PredicateType::IsNull:
+        match = is_null;
+        break;
+      case PredicateType::IsNotNull:
+        match = !is_null;
+        break;
+      case PredicateType::Equality:
+        match = !is_null && Traits::Compare(&cells[i], lower) == 0;
+        break;
+      case PredicateType::Range:
+        match = !is_null &&
+            (lower == nullptr || Traits::Compare(&cells[i], lower) >= 0) &&
+            (upper == nullptr || Traits::Compare(&cells[i], upper) < 0);
+        break;
+      default:
+        match = false;
+        break;
+    }
+    if (!match) {
+      BitmapClear(sel_bitmap, i);
+    }
+  }
+}
+
 extern "C" {
 
 // Preface all used functions with _Precompiled to avoid the possibility
@@ -160,5 +209,36 @@ IR_ALWAYS_INLINE void _PrecompiledCopyCellToRowBlockSetNull(
   dst->cell(col).set_null(is_null);
 }
 
+// declare void @_PrecompiledEvaluatePredicate_<physical type>(
+//   RowBlock* block, i64 col, i1 nullable, i32 pred_type,
+//   i8* lower, i8* upper, SelectionVector* sel)
+//
+//   Evaluates a predicate of type 'pred_type' (a PredicateType value) on
+//   column 'col' of 'block', ANDing the result into 'sel'. 'lower' is the
+//   inclusive lower bound of a range or the value of an equality predicate,
+//   'upper' the exclusive upper bound of a range. Either may be NULL.
+#define DEFINE_PRECOMPILED_PREDICATE(type)                                   \
+  IR_ALWAYS_INLINE void _PrecompiledEvaluatePredicate_##type(               \
+      RowBlock* block, uint64_t col, bool nullable, uint32_t pred_type,      \
+      uint8_t* lower, uint8_t* upper, SelectionVector* sel) {                \
+    EvaluatePredicateForType<type>(block, col, nullable, pred_type,          \
+                                   lower, upper, sel);                       \
+  }
+
+DEFINE_PRECOMPILED_PREDICATE(BOOL)
+DEFINE_PRECOMPILED_PREDICATE(INT8)
+DEFINE_PRECOMPILED_PREDICATE(INT16)
+DEFINE_PRECOMPILED_PREDICATE(INT32)
+DEFINE_PRECOMPILED_PREDICATE(INT64)
+DEFINE_PRECOMPILED_PREDICATE(UINT8)
+DEFINE_PRECOMPILED_PREDICATE(UINT16)
+DEFINE_PRECOMPILED_PREDICATE(UINT32)
+DEFINE_PRECOMPILED_PREDICATE(UINT64)
+DEFINE_PRECOMPILED_PREDICATE(FLOAT)
+DEFINE_PRECOMPILED_PREDICATE(DOUBLE)
+DEFINE_PRECOMPILED_PREDICATE(BINARY)
+
+#undef DEFINE_PRECOMPILED_PREDICATE
+
 } // extern "C"
 } // namespace kudu
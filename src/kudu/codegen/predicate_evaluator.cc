@@ -0,0 +1,291 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/codegen/predicate_evaluator.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/IR/Argument.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Type.h>
+
+#include "kudu/codegen/jit_wrapper.h"
+#include "kudu/codegen/module_builder.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/strings/strcat.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/status.h"
+
+using llvm::Argument;
+using llvm::BasicBlock;
+using llvm::ConstantPointerNull;
+using llvm::Function;
+using llvm::FunctionType;
+using llvm::LLVMContext;
+using llvm::PointerType;
+using llvm::Type;
+using llvm::Value;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+DECLARE_bool(codegen_dump_functions);
+
+namespace kudu {
+namespace codegen {
+
+namespace {
+
+// Whether the precompiled module has an evaluation function for the type.
+bool IsSupportedPhysicalType(DataType type) {
+  switch (type) {
+    case BOOL:
+    case INT8:
+    case INT16:
+    case INT32:
+    case INT64:
+    case UINT8:
+    case UINT16:
+    case UINT32:
+    case UINT64:
+    case FLOAT:
+    case DOUBLE:
+    case BINARY:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Generates a predicate evaluation function of the form:
+// void(RowBlock* block, i8** bounds, SelectionVector* sel)
+//
+// The function body is a straight-line sequence of calls to the precompiled,
+// per-type evaluation functions, with the column index, nullability and
+// predicate type of each call known at JIT time:
+//
+// define void @name(RowBlock* %block, i8** %bounds, SelectionVector* %sel)
+// entry:
+//   <for each predicate i>
+//     %lower_i = load i8** (getelementptr i8** %bounds, i64 <2 * i>)*
+//     %upper_i = load i8** (getelementptr i8** %bounds, i64 <2 * i + 1>)*
+//     call void @_PrecompiledEvaluatePredicate_<type>(
+//       RowBlock* %block, i64 <column index>, i1 <nullable>,
+//       i32 <predicate type>, i8* %lower_i, i8* %upper_i, SelectionVector* %sel)
+//   <end implicit for each>
+//   ret void
+//
+// *If the predicate has no such bound, a null constant is passed instead so
+// the corresponding comparison is folded away after inlining.
+llvm::Function* MakeEvaluation(const string& name,
+                               ModuleBuilder* mbuilder,
+                               const vector<PredicateShape>& shapes) {
+  ModuleBuilder::LLVMBuilder* builder = mbuilder->builder();
+  LLVMContext& context = builder->getContext();
+
+  Type* i8_ptr = Type::getInt8PtrTy(context);
+  vector<Type*> argtypes = {
+    PointerType::getUnqual(mbuilder->GetType("class.kudu::RowBlock")),
+    PointerType::getUnqual(i8_ptr),
+    PointerType::getUnqual(mbuilder->GetType("class.kudu::SelectionVector")) };
+  FunctionType* fty = FunctionType::get(Type::getVoidTy(context), argtypes, false);
+  Function* f = mbuilder->Create(fty, name);
+
+  Function::arg_iterator it = f->arg_begin();
+  Argument* block = &*it++;
+  Argument* bounds = &*it++;
+  Argument* sel = &*it++;
+  DCHECK(it == f->arg_end());
+
+  block->setName("block");
+  bounds->setName("bounds");
+  sel->setName("sel");
+
+  f->setDoesNotAlias(1);
+  f->setDoesNotAlias(2);
+  f->setDoesNotAlias(3);
+
+  builder->SetInsertPoint(BasicBlock::Create(context, "entry", f));
+  Value* null_bound = ConstantPointerNull::get(PointerType::getUnqual(Type::getInt8Ty(context)));
+
+  for (size_t i = 0; i < shapes.size(); i++) {
+    const PredicateShape& shape = shapes[i];
+    Function* eval = mbuilder->GetFunction(
+        StrCat("_PrecompiledEvaluatePredicate_", DataType_Name(shape.physical_type)));
+
+    Value* lower = null_bound;
+    if (shape.has_lower) {
+      lower = builder->CreateLoad(builder->CreateConstGEP1_64(bounds, 2 * i));
+      lower->setName(StrCat("lower", i));
+    }
+    Value* upper = null_bound;
+    if (shape.has_upper) {
+      upper = builder->CreateLoad(builder->CreateConstGEP1_64(bounds, 2 * i + 1));
+      upper->setName(StrCat("upper", i));
+    }
+
+    vector<Value*> args = { block,
+                            builder->getInt64(shape.col_idx),
+                            builder->getInt1(shape.nullable),
+                            builder->getInt32(static_cast<uint32_t>(shape.predicate_type)),
+                            lower,
+                            upper,
+                            sel };
+    builder->CreateCall(eval, args);
+  }
+
+  builder->CreateRetVoid();
+
+  if (FLAGS_codegen_dump_functions) {
+    LOG(INFO) << "Dumping predicate evaluation:";
+    f->dump();
+  }
+
+  return f;
+}
+
+// Convenience method which appends to a faststring
+template<typename T>
+void AddNext(faststring* fs, const T& val) {
+  fs->append(&val, sizeof(T));
+}
+
+} // anonymous namespace
+
+PredicateEvaluatorFunctions::PredicateEvaluatorFunctions(vector<PredicateShape> shapes,
+                                                         EvaluationFunction evaluate_f,
+                                                         unique_ptr<JITCodeOwner> owner)
+  : JITWrapper(std::move(owner)),
+    shapes_(std::move(shapes)),
+    evaluate_f_(evaluate_f) {
+  CHECK(evaluate_f != nullptr)
+    << "Promise to compile evaluation function not fulfilled by ModuleBuilder";
+}
+
+Status PredicateEvaluatorFunctions::BuildShapes(const Schema& schema,
+                                                const vector<ColumnPredicate>& predicates,
+                                                vector<PredicateShape>* shapes) {
+  shapes->clear();
+  shapes->reserve(predicates.size());
+  for (const ColumnPredicate& pred : predicates) {
+    int col_idx = schema.find_column(pred.column().name());
+    if (col_idx == Schema::kColumnNotFound) {
+      return Status::NotFound("predicate column not in schema", pred.ToString());
+    }
+    const ColumnSchema& col = schema.column(col_idx);
+    DataType type = col.type_info()->physical_type();
+    if (!IsSupportedPhysicalType(type)) {
+      return Status::NotSupported("unsupported column type for codegen", pred.ToString());
+    }
+
+    PredicateShape shape;
+    shape.col_idx = col_idx;
+    shape.physical_type = type;
+    shape.nullable = col.is_nullable();
+    shape.predicate_type = pred.predicate_type();
+    switch (pred.predicate_type()) {
+      case PredicateType::Range:
+        shape.has_lower = pred.raw_lower() != nullptr;
+        shape.has_upper = pred.raw_upper() != nullptr;
+        break;
+      case PredicateType::Equality:
+        shape.has_lower = true;
+        shape.has_upper = false;
+        break;
+      case PredicateType::None:
+      case PredicateType::IsNotNull:
+      case PredicateType::IsNull:
+        shape.has_lower = false;
+        shape.has_upper = false;
+        break;
+      default:
+        return Status::NotSupported("unsupported predicate type for codegen", pred.ToString());
+    }
+    shapes->push_back(shape);
+  }
+  return Status::OK();
+}
+
+Status PredicateEvaluatorFunctions::Create(const vector<PredicateShape>& shapes,
+                                           scoped_refptr<PredicateEvaluatorFunctions>* out,
+                                           llvm::TargetMachine** tm) {
+  ModuleBuilder builder;
+  RETURN_NOT_OK(builder.Init());
+
+  Function* evaluate = MakeEvaluation("PredEval", &builder, shapes);
+
+  EvaluationFunction evaluate_f;
+  builder.AddJITPromise(evaluate, &evaluate_f);
+
+  unique_ptr<JITCodeOwner> owner;
+  RETURN_NOT_OK(builder.Compile(&owner));
+
+  if (tm) {
+    *tm = builder.GetTargetMachine();
+  }
+  out->reset(new PredicateEvaluatorFunctions(shapes, evaluate_f, std::move(owner)));
+  return Status::OK();
+}
+
+// Generates a key for a list of predicate shapes, encoded as follows:
+//
+// (1 byte) unique type identifier for PredicateEvaluatorFunctions
+// (8 bytes) number, as unsigned long, of predicates
+// for each predicate, in order:
+//   (8 bytes) column index
+//   (4 bytes) physical type of the column
+//   (1 byte) nullability of the column
+//   (4 bytes) predicate type
+//   (1 byte each) whether the lower and upper bounds are present
+//
+// Two predicate lists with the same key generate identical code, whatever
+// their column names and bound values.
+Status PredicateEvaluatorFunctions::EncodeKey(const vector<PredicateShape>& shapes,
+                                              faststring* out) {
+  AddNext(out, JITWrapper::PREDICATE_EVALUATOR);
+  AddNext(out, shapes.size());
+  for (const PredicateShape& shape : shapes) {
+    AddNext(out, shape.col_idx);
+    AddNext(out, shape.physical_type);
+    AddNext(out, shape.nullable);
+    AddNext(out, shape.predicate_type);
+    AddNext(out, shape.has_lower);
+    AddNext(out, shape.has_upper);
+  }
+  return Status::OK();
+}
+
+PredicateEvaluator::PredicateEvaluator(const vector<ColumnPredicate>& predicates,
+                                       const scoped_refptr<PredicateEvaluatorFunctions>& functions)
+  : functions_(functions) {
+  DCHECK_EQ(predicates.size(), functions_->shapes().size());
+  bounds_.reserve(2 * predicates.size());
+  for (const ColumnPredicate& pred : predicates) {
+    bounds_.push_back(pred.raw_lower());
+    bounds_.push_back(pred.predicate_type() == PredicateType::Range ? pred.raw_upper() : nullptr);
+  }
+}
+
+} // namespace codegen
+} // namespace kudu
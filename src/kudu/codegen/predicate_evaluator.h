@@ -0,0 +1,127 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef KUDU_CODEGEN_PREDICATE_EVALUATOR_H
+#define KUDU_CODEGEN_PREDICATE_EVALUATOR_H
+
+#include <memory>
+#include <vector>
+
+#include "kudu/codegen/jit_wrapper.h"
+#include "kudu/common/column_predicate.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/status.h"
+
+namespace llvm {
+class TargetMachine;
+} // namespace llvm
+
+namespace kudu {
+namespace codegen {
+
+// The parts of a column predicate which determine the code generated for it:
+// the column it applies to, the column's physical type and nullability, the
+// predicate type, and which bounds are present. The bound values themselves
+// are not part of the shape; they're passed in at evaluation time, so that
+// scans which differ only in their predicate values share the same code.
+struct PredicateShape {
+  size_t col_idx;
+  DataType physical_type;
+  bool nullable;
+  PredicateType predicate_type;
+  bool has_lower;
+  bool has_upper;
+};
+
+// The JITWrapper for codegen::PredicateEvaluator functions. Contains the
+// compiled evaluation function for a conjunction of column predicates as
+// well as the shapes used to generate it.
+class PredicateEvaluatorFunctions : public JITWrapper {
+ public:
+  // Evaluates all of the predicates over the given block, ANDing the results
+  // into the selection vector. The second argument holds two bound pointers
+  // (lower, then upper) per predicate, in the order of the shapes.
+  typedef void(*EvaluationFunction)(RowBlock*, const void* const*, SelectionVector*);
+
+  // Computes the shapes of 'predicates', resolving their columns in 'schema'.
+  // Returns Status::NotSupported if any predicate can't be code-generated
+  // (e.g. IN-list predicates) and Status::NotFound if a predicate's column
+  // is not in 'schema'.
+  static Status BuildShapes(const Schema& schema,
+                            const std::vector<ColumnPredicate>& predicates,
+                            std::vector<PredicateShape>* shapes);
+
+  // Compiles the evaluation function for the given predicate shapes.
+  // Writes the llvm::TargetMachine* used to 'tm' (if not NULL)
+  // and the functions to 'out' upon success.
+  static Status Create(const std::vector<PredicateShape>& shapes,
+                       scoped_refptr<PredicateEvaluatorFunctions>* out,
+                       llvm::TargetMachine** tm = NULL);
+
+  const std::vector<PredicateShape>& shapes() const { return shapes_; }
+
+  EvaluationFunction evaluate() const { return evaluate_f_; }
+
+  virtual Status EncodeOwnKey(faststring* out) OVERRIDE {
+    return EncodeKey(shapes_, out);
+  }
+
+  static Status EncodeKey(const std::vector<PredicateShape>& shapes,
+                          faststring* out);
+
+ private:
+  PredicateEvaluatorFunctions(std::vector<PredicateShape> shapes,
+                              EvaluationFunction evaluate_f,
+                              std::unique_ptr<JITCodeOwner> owner);
+
+  const std::vector<PredicateShape> shapes_;
+  const EvaluationFunction evaluate_f_;
+};
+
+// Evaluates a fixed conjunction of column predicates over row blocks using
+// code-generated functions, with the same semantics as calling
+// ColumnPredicate::Evaluate() for each predicate in turn.
+class PredicateEvaluator {
+ public:
+  // Requires that the predicates (and the bound values they point to) remain
+  // valid for the lifetime of this object, and that their shapes match the
+  // shapes used to create 'functions'.
+  PredicateEvaluator(const std::vector<ColumnPredicate>& predicates,
+                     const scoped_refptr<PredicateEvaluatorFunctions>& functions);
+
+  // Evaluate the predicates over 'block', clearing the selection vector bits
+  // of the rows which do not match.
+  void Evaluate(RowBlock* block) const {
+    functions_->evaluate()(block, bounds_.data(), block->selection_vector());
+  }
+
+ private:
+  scoped_refptr<PredicateEvaluatorFunctions> functions_;
+
+  // Lower and upper bound for each predicate.
+  std::vector<const void*> bounds_;
+
+  DISALLOW_COPY_AND_ASSIGN(PredicateEvaluator);
+};
+
+} // namespace codegen
+} // namespace kudu
+
+#endif
@@ -19,10 +19,15 @@
 
 #include <glog/logging.h>
 #include <gtest/gtest.h>
+#include <limits>
+#include <memory>
 #include <vector>
 
+#include "kudu/common/columnblock.h"
+#include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/types.h"
+#include "kudu/util/bloom_filter.h"
 #include "kudu/util/test_util.h"
 
 namespace kudu {
@@ -379,6 +384,223 @@ class TestColumnPredicate : public KuduTest {
               ColumnPredicate::Range(column, &values[2], nullptr),
               ColumnPredicate::Range(column, &values[2], nullptr),
               PredicateType::Range);
+
+    // IN list
+
+    vector<const void*> in_1_3_5 = { &values[5], &values[1], &values[3] };
+    ColumnPredicate in_list_1_3_5 = ColumnPredicate::InList(column, &in_1_3_5);
+    ASSERT_EQ(PredicateType::InList, in_list_1_3_5.predicate_type());
+    ASSERT_EQ(3, in_list_1_3_5.raw_values().size());
+
+    // IN (1, 3, 5) AND
+    // IN (1, 3, 5)
+    // =
+    // IN (1, 3, 5)
+    TestMerge(in_list_1_3_5, in_list_1_3_5, in_list_1_3_5, PredicateType::InList);
+
+    // IN (1, 3, 5) AND
+    // IN (0, 3, 5, 6)
+    // =
+    // IN (3, 5)
+    vector<const void*> in_0_3_5_6 = { &values[0], &values[3], &values[5], &values[6] };
+    vector<const void*> in_3_5 = { &values[3], &values[5] };
+    TestMerge(in_list_1_3_5,
+              ColumnPredicate::InList(column, &in_0_3_5_6),
+              ColumnPredicate::InList(column, &in_3_5),
+              PredicateType::InList);
+
+    // IN (1, 3, 5) AND
+    // IN (3, 4)
+    // =
+    // |
+    vector<const void*> in_3_4 = { &values[3], &values[4] };
+    TestMerge(in_list_1_3_5,
+              ColumnPredicate::InList(column, &in_3_4),
+              ColumnPredicate::Equality(column, &values[3]),
+              PredicateType::Equality);
+
+    // IN (1, 3, 5) AND
+    // IN (0, 2)
+    // =
+    // None
+    vector<const void*> in_0_2 = { &values[0], &values[2] };
+    TestMerge(in_list_1_3_5,
+              ColumnPredicate::InList(column, &in_0_2),
+              ColumnPredicate::None(column),
+              PredicateType::None);
+
+    // IN (1, 3, 5) AND
+    //  [-------)
+    // =
+    // IN (3, 5)
+    in_3_5 = { &values[3], &values[5] };
+    TestMerge(in_list_1_3_5,
+              ColumnPredicate::Range(column, &values[2], &values[6]),
+              ColumnPredicate::InList(column, &in_3_5),
+              PredicateType::InList);
+
+    // IN (1, 3, 5) AND
+    //  [--->
+    // =
+    // |
+    TestMerge(in_list_1_3_5,
+              ColumnPredicate::Range(column, &values[4], nullptr),
+              ColumnPredicate::Equality(column, &values[5]),
+              PredicateType::Equality);
+
+    // IN (1, 3, 5) AND
+    //       <---)
+    // =
+    // None
+    TestMerge(in_list_1_3_5,
+              ColumnPredicate::Range(column, nullptr, &values[1]),
+              ColumnPredicate::None(column),
+              PredicateType::None);
+
+    // IN (1, 3, 5) AND
+    //     |
+    // =
+    //     |
+    TestMerge(in_list_1_3_5,
+              ColumnPredicate::Equality(column, &values[3]),
+              ColumnPredicate::Equality(column, &values[3]),
+              PredicateType::Equality);
+
+    // IN (1, 3, 5) AND
+    //    |
+    // =
+    // None
+    TestMerge(in_list_1_3_5,
+              ColumnPredicate::Equality(column, &values[2]),
+              ColumnPredicate::None(column),
+              PredicateType::None);
+
+    // IN (1, 3, 5) AND
+    // IS NOT NULL
+    // =
+    // IN (1, 3, 5)
+    TestMerge(in_list_1_3_5,
+              ColumnPredicate::IsNotNull(column),
+              in_list_1_3_5,
+              PredicateType::InList);
+
+    // IN (1, 3, 5) AND
+    // None
+    // =
+    // None
+    TestMerge(in_list_1_3_5,
+              ColumnPredicate::None(column),
+              ColumnPredicate::None(column),
+              PredicateType::None);
+
+    // IN (1, 3, 5) AND
+    // IS NULL
+    // =
+    // None
+    TestMerge(in_list_1_3_5,
+              ColumnPredicate::IsNull(column),
+              ColumnPredicate::None(column),
+              PredicateType::None);
+
+    // IS NULL
+
+    // IS NULL AND
+    // IS NULL
+    // =
+    // IS NULL
+    TestMerge(ColumnPredicate::IsNull(column),
+              ColumnPredicate::IsNull(column),
+              ColumnPredicate::IsNull(column),
+              PredicateType::IsNull);
+
+    // IS NULL AND
+    // IS NOT NULL
+    // =
+    // None
+    TestMerge(ColumnPredicate::IsNull(column),
+              ColumnPredicate::IsNotNull(column),
+              ColumnPredicate::None(column),
+              PredicateType::None);
+
+    // IS NULL AND
+    // None
+    // =
+    // None
+    TestMerge(ColumnPredicate::IsNull(column),
+              ColumnPredicate::None(column),
+              ColumnPredicate::None(column),
+              PredicateType::None);
+
+    // IS NULL AND
+    // |
+    // =
+    // None
+    TestMerge(ColumnPredicate::IsNull(column),
+              ColumnPredicate::Equality(column, &values[0]),
+              ColumnPredicate::None(column),
+              PredicateType::None);
+
+    // IS NULL AND
+    // [------)
+    // =
+    // None
+    TestMerge(ColumnPredicate::IsNull(column),
+              ColumnPredicate::Range(column, &values[0], &values[2]),
+              ColumnPredicate::None(column),
+              PredicateType::None);
+
+    // IS NULL AND
+    // [------>
+    // =
+    // None
+    TestMerge(ColumnPredicate::IsNull(column),
+              ColumnPredicate::Range(column, &values[2], nullptr),
+              ColumnPredicate::None(column),
+              PredicateType::None);
+  }
+
+  // Check that evaluating range and equality predicates on a block of cells
+  // taken from 'values' (which must be sorted and have at least four entries)
+  // selects exactly the rows which match cell-by-cell evaluation. 'extra_value'
+  // is mixed into the cells but never used as a bound.
+  template <DataType PhysicalType>
+  void TestEvaluateComparisons(
+      const vector<typename DataTypeTraits<PhysicalType>::cpp_type>& values,
+      typename DataTypeTraits<PhysicalType>::cpp_type extra_value) {
+    typedef typename DataTypeTraits<PhysicalType>::cpp_type T;
+    ColumnSchema column("c", PhysicalType, true);
+    vector<ColumnPredicate> predicates = {
+      ColumnPredicate::Equality(column, &values[1]),
+      ColumnPredicate::Range(column, &values[1], &values[3]),
+      ColumnPredicate::Range(column, &values[2], nullptr),
+      ColumnPredicate::Range(column, nullptr, &values[2]),
+    };
+
+    // Exercise both the 32-row words and the trailing rows of the kernels.
+    for (int num_rows : { 1, 31, 32, 67, 128, 203 }) {
+      ScopedColumnBlock<PhysicalType> block(num_rows);
+      for (int i = 0; i < num_rows; i++) {
+        block.SetCellIsNull(i, i % 7 == 0);
+        block[i] = i % 11 == 0 ? extra_value : values[(i * 3) % values.size()];
+      }
+      for (const ColumnPredicate& predicate : predicates) {
+        SelectionVector sel(num_rows);
+        sel.SetAllTrue();
+        // Rows which are deselected up front must stay deselected.
+        for (int i = 0; i < num_rows; i += 5) {
+          BitmapClear(sel.mutable_bitmap(), i);
+        }
+        predicate.Evaluate(block, &sel);
+
+        for (int i = 0; i < num_rows; i++) {
+          T cell = block[i];
+          bool expected = i % 5 != 0 && i % 7 != 0 &&
+                          predicate.EvaluateCell<PhysicalType>(&cell);
+          ASSERT_EQ(expected, sel.IsRowSelected(i))
+              << predicate.ToString() << ", row " << i << " of " << num_rows;
+        }
+      }
+    }
   }
 };
 
@@ -518,10 +740,203 @@ TEST_F(TestColumnPredicate, TestExclusive) {
   }
 }
 
+// Test that the IN list constructor sorts, de-duplicates and simplifies.
+TEST_F(TestColumnPredicate, TestInListConstructor) {
+  ColumnSchema column("c", INT32);
+  int32_t zero = 0;
+  int32_t one = 1;
+  int32_t other_one = 1;
+  int32_t two = 2;
+
+  vector<const void*> values = { &two, &one, &zero, &other_one };
+  ColumnPredicate pred = ColumnPredicate::InList(column, &values);
+  ASSERT_EQ(PredicateType::InList, pred.predicate_type());
+  ASSERT_EQ(3, pred.raw_values().size());
+  ASSERT_EQ(0, *static_cast<const int32_t*>(pred.raw_values()[0]));
+  ASSERT_EQ(1, *static_cast<const int32_t*>(pred.raw_values()[1]));
+  ASSERT_EQ(2, *static_cast<const int32_t*>(pred.raw_values()[2]));
+  ASSERT_EQ("`c` IN (0, 1, 2)", pred.ToString());
+
+  values = { &one, &other_one };
+  ASSERT_EQ(ColumnPredicate::Equality(column, &one), ColumnPredicate::InList(column, &values));
+
+  values.clear();
+  ASSERT_EQ(PredicateType::None, ColumnPredicate::InList(column, &values).predicate_type());
+}
+
+// Test that IN list predicates are evaluated correctly against a column block
+// containing null values.
+TEST_F(TestColumnPredicate, TestInListEvaluate) {
+  const int kNumRows = 100;
+  ColumnSchema column("c", INT32, true);
+  ScopedColumnBlock<INT32> block(kNumRows);
+  for (int i = 0; i < kNumRows; i++) {
+    block.SetCellIsNull(i, i % 10 == 0);
+    block[i] = i;
+  }
+
+  int32_t ten = 10;
+  int32_t eleven = 11;
+  int32_t twelve = 12;
+  int32_t fifty_one = 51;
+  int32_t missing = 1000;
+  vector<const void*> values = { &ten, &eleven, &fifty_one, &missing };
+  ColumnPredicate pred = ColumnPredicate::InList(column, &values);
+
+  SelectionVector sel(kNumRows);
+  sel.SetAllTrue();
+  pred.Evaluate(block, &sel);
+
+  // Row 10 is null, so only rows 11 and 51 are selected.
+  ASSERT_EQ(2, sel.CountSelected());
+  ASSERT_FALSE(sel.IsRowSelected(10));
+  ASSERT_TRUE(sel.IsRowSelected(11));
+  ASSERT_FALSE(sel.IsRowSelected(12));
+  ASSERT_TRUE(sel.IsRowSelected(51));
+
+  ASSERT_TRUE(pred.EvaluateCell<INT32>(&eleven));
+  ASSERT_FALSE(pred.EvaluateCell<INT32>(&twelve));
+}
+
+// Test that IN bloom filter predicates are evaluated and merged correctly.
+TEST_F(TestColumnPredicate, TestInBloomFilter) {
+  const int kNumRows = 100;
+  ColumnSchema column("c", INT32, true);
+  ScopedColumnBlock<INT32> block(kNumRows);
+  for (int i = 0; i < kNumRows; i++) {
+    block.SetCellIsNull(i, i % 10 == 0);
+    block[i] = i;
+  }
+
+  // Filters of [10, 20) and [15, 25), sized so that false positives are
+  // practically impossible.
+  auto build_filter = [&] (int32_t begin, int32_t end) {
+    std::unique_ptr<BloomFilterBuilder> builder(new BloomFilterBuilder(
+        BloomFilterSizing::ByCountAndFPRate(end - begin, 0.000001, BLOCKED_BLOOM_LAYOUT)));
+    for (int32_t i = begin; i < end; i++) {
+      builder->AddKey(BloomKeyProbe(ColumnPredicate::BloomFilterKey(column.type_info(), &i)));
+    }
+    return builder;
+  };
+  std::unique_ptr<BloomFilterBuilder> builder_a = build_filter(10, 20);
+  std::unique_ptr<BloomFilterBuilder> builder_b = build_filter(15, 25);
+  auto bloom_predicate = [&] (const BloomFilterBuilder& builder,
+                              const void* lower, const void* upper) {
+    vector<BloomFilter> filters;
+    filters.emplace_back(builder.slice(), builder.n_hashes(), builder.layout());
+    return ColumnPredicate::InBloomFilter(column, &filters, lower, upper);
+  };
+  auto count_selected = [&] (const ColumnPredicate& pred) {
+    SelectionVector sel(kNumRows);
+    sel.SetAllTrue();
+    pred.Evaluate(block, &sel);
+    return sel.CountSelected();
+  };
+
+  // Row 10 is null.
+  ColumnPredicate pred = bloom_predicate(*builder_a, nullptr, nullptr);
+  ASSERT_EQ(PredicateType::InBloomFilter, pred.predicate_type());
+  ASSERT_EQ(9, count_selected(pred));
+  int32_t twelve = 12;
+  int32_t fifteen = 15;
+  int32_t fifty = 50;
+  ASSERT_TRUE(pred.EvaluateCell<INT32>(&twelve));
+  ASSERT_FALSE(pred.EvaluateCell<INT32>(&fifty));
+  ASSERT_EQ("`c` IN 1 BLOOM FILTER(S)", pred.ToString());
+
+  // Merging with a range keeps the filter within the range's bounds.
+  ColumnPredicate merged(pred);
+  merged.Merge(ColumnPredicate::Range(column, &fifteen, &fifty));
+  ASSERT_EQ(bloom_predicate(*builder_a, &fifteen, &fifty), merged);
+  ASSERT_EQ(5, count_selected(merged));
+
+  // Merging with another filter requires values to be in both.
+  merged = pred;
+  merged.Merge(bloom_predicate(*builder_b, nullptr, nullptr));
+  ASSERT_EQ(PredicateType::InBloomFilter, merged.predicate_type());
+  ASSERT_EQ(5, count_selected(merged));
+
+  // Equality, IN list and IS NULL predicates are checked against the filter.
+  // An empty range is simplified to None.
+  ColumnPredicate none = ColumnPredicate::Range(column, &fifty, &fifty);
+  TestMerge(pred, ColumnPredicate::Equality(column, &twelve),
+            ColumnPredicate::Equality(column, &twelve), PredicateType::Equality);
+  TestMerge(pred, ColumnPredicate::Equality(column, &fifty),
+            none, PredicateType::None);
+  vector<const void*> values = { &twelve, &fifty };
+  TestMerge(pred, ColumnPredicate::InList(column, &values),
+            ColumnPredicate::Equality(column, &twelve), PredicateType::Equality);
+  TestMerge(pred, ColumnPredicate::IsNull(column), none, PredicateType::None);
+  TestMerge(pred, ColumnPredicate::IsNotNull(column), pred, PredicateType::InBloomFilter);
+
+  // Empty bounds match nothing.
+  ASSERT_EQ(PredicateType::None,
+            bloom_predicate(*builder_a, &fifty, &fifteen).predicate_type());
+}
+
+// Test that IS NULL and IS NOT NULL predicates are evaluated correctly using
+// only the null bitmap of a column block.
+TEST_F(TestColumnPredicate, TestNullPredicatesEvaluate) {
+  // Use a row count which is not a multiple of 8 to exercise the trailing bits.
+  const int kNumRows = 101;
+  ColumnSchema column("c", INT32, true);
+  ScopedColumnBlock<INT32> block(kNumRows);
+  for (int i = 0; i < kNumRows; i++) {
+    block.SetCellIsNull(i, i % 3 == 0);
+    block[i] = i;
+  }
+
+  // Deselect one matching row up front in each vector, to check that it stays
+  // deselected.
+  SelectionVector is_null_sel(kNumRows);
+  is_null_sel.SetAllTrue();
+  BitmapClear(is_null_sel.mutable_bitmap(), 3);
+  ColumnPredicate::IsNull(column).Evaluate(block, &is_null_sel);
+
+  SelectionVector is_not_null_sel(kNumRows);
+  is_not_null_sel.SetAllTrue();
+  BitmapClear(is_not_null_sel.mutable_bitmap(), 1);
+  ColumnPredicate::IsNotNull(column).Evaluate(block, &is_not_null_sel);
+
+  for (int i = 0; i < kNumRows; i++) {
+    bool is_null = i % 3 == 0;
+    ASSERT_EQ(is_null && i != 3, is_null_sel.IsRowSelected(i)) << i;
+    ASSERT_EQ(!is_null && i != 1, is_not_null_sel.IsRowSelected(i)) << i;
+  }
+  ASSERT_EQ(33, is_null_sel.CountSelected());
+  ASSERT_EQ(66, is_not_null_sel.CountSelected());
+}
+
+// Test that range and equality predicates evaluated by the vectorized kernels
+// agree with cell-by-cell evaluation for all fixed-width types.
+TEST_F(TestColumnPredicate, TestEvaluateComparisons) {
+  TestEvaluateComparisons<INT8>({ -100, -1, 0, 5, 100 }, 127);
+  TestEvaluateComparisons<INT16>({ -1000, -1, 0, 5, 1000 }, -32768);
+  TestEvaluateComparisons<INT32>({ -1000000, -1, 0, 5, 1000000 }, 42);
+  TestEvaluateComparisons<INT64>({ -10000000000, -1, 0, 5, 10000000000 }, 42);
+  TestEvaluateComparisons<UINT8>({ 0, 1, 7, 200, 255 }, 100);
+  TestEvaluateComparisons<UINT16>({ 0, 1, 7, 2000, 65535 }, 100);
+  TestEvaluateComparisons<UINT32>({ 0, 1, 7, 2000000, 4000000000 }, 100);
+  TestEvaluateComparisons<UINT64>({ 0, 1, 7, 2000000, 10000000000000 }, 100);
+  TestEvaluateComparisons<FLOAT>({ -1.5f, -0.0f, 0.5f, 3.25f, 100.0f },
+                                 std::numeric_limits<float>::quiet_NaN());
+  TestEvaluateComparisons<DOUBLE>({ -1.5, -0.0, 0.5, 3.25, 100.0 },
+                                  std::numeric_limits<double>::quiet_NaN());
+}
+
+// Test that an IS NULL predicate on a non-nullable column is simplified.
+TEST_F(TestColumnPredicate, TestIsNullConstructor) {
+  ASSERT_EQ(PredicateType::None,
+            ColumnPredicate::IsNull(ColumnSchema("c", INT32)).predicate_type());
+  ASSERT_EQ(PredicateType::IsNull,
+            ColumnPredicate::IsNull(ColumnSchema("c", INT32, true)).predicate_type());
+}
+
 // Test that column predicate comparison works correctly: ordered by predicate
 // type first, then size of the column type.
 TEST_F(TestColumnPredicate, TestSelectivity) {
   int32_t one_32 = 1;
+  int32_t two_32 = 2;
   int64_t one_64 = 1;
   double_t one_d = 1.0;
   Slice one_s("one", 3);
@@ -542,6 +957,19 @@ TEST_F(TestColumnPredicate, TestSelectivity) {
                                   ColumnPredicate::IsNotNull(column_i32)),
             0);
 
+  ASSERT_LT(SelectivityComparator(ColumnPredicate::IsNull(column_s),
+                                  ColumnPredicate::Equality(column_i32, &one_32)),
+            0);
+
+  vector<const void*> in_list_values = { &one_32, &two_32 };
+  ASSERT_LT(SelectivityComparator(ColumnPredicate::Equality(column_i32, &one_32),
+                                  ColumnPredicate::InList(column_i32, &in_list_values)),
+            0);
+  in_list_values = { &one_32, &two_32 };
+  ASSERT_LT(SelectivityComparator(ColumnPredicate::InList(column_i32, &in_list_values),
+                                  ColumnPredicate::Range(column_i32, &one_32, nullptr)),
+            0);
+
   // Size of column type
   ASSERT_LT(SelectivityComparator(ColumnPredicate::Equality(column_i32, &one_32),
                                   ColumnPredicate::Equality(column_i64, &one_64)),
@@ -17,15 +17,24 @@
 
 #include "kudu/common/column_predicate.h"
 
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "kudu/common/key_util.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/types.h"
+#include "kudu/gutil/cpu.h"
+#include "kudu/gutil/port.h"
+#include "kudu/gutil/strings/join.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/memory/arena.h"
 
 using std::move;
+using std::vector;
 
 namespace kudu {
 
@@ -112,6 +121,56 @@ ColumnPredicate ColumnPredicate::IsNotNull(ColumnSchema column) {
   return ColumnPredicate(PredicateType::IsNotNull, move(column), nullptr, nullptr);
 }
 
+ColumnPredicate ColumnPredicate::IsNull(ColumnSchema column) {
+  if (!column.is_nullable()) {
+    // A non-nullable column can never contain a null value.
+    return None(move(column));
+  }
+  return ColumnPredicate(PredicateType::IsNull, move(column), nullptr, nullptr);
+}
+
+ColumnPredicate ColumnPredicate::InList(ColumnSchema column,
+                                        vector<const void*>* values) {
+  CHECK(values != nullptr);
+
+  // Sort the values and remove duplicates, so that membership can be checked
+  // with a binary search and merges can be done with a linear intersection.
+  const TypeInfo* type_info = column.type_info();
+  std::sort(values->begin(), values->end(),
+            [type_info] (const void* a, const void* b) {
+              return type_info->Compare(a, b) < 0;
+            });
+  values->erase(std::unique(values->begin(), values->end(),
+                            [type_info] (const void* a, const void* b) {
+                              return type_info->Compare(a, b) == 0;
+                            }),
+                values->end());
+
+  ColumnPredicate pred(PredicateType::InList, move(column), nullptr, nullptr);
+  pred.values_.swap(*values);
+  pred.Simplify();
+  return pred;
+}
+
+ColumnPredicate ColumnPredicate::InBloomFilter(ColumnSchema column,
+                                               vector<BloomFilter>* bloom_filters,
+                                               const void* lower,
+                                               const void* upper) {
+  CHECK(bloom_filters != nullptr);
+  CHECK(!bloom_filters->empty());
+  ColumnPredicate pred(PredicateType::InBloomFilter, move(column), lower, upper);
+  pred.bloom_filters_.swap(*bloom_filters);
+  pred.Simplify();
+  return pred;
+}
+
+Slice ColumnPredicate::BloomFilterKey(const TypeInfo* type_info, const void* cell) {
+  if (type_info->physical_type() == BINARY) {
+    return *reinterpret_cast<const Slice*>(cell);
+  }
+  return Slice(reinterpret_cast<const uint8_t*>(cell), type_info->size());
+}
+
 ColumnPredicate ColumnPredicate::None(ColumnSchema column) {
   return ColumnPredicate(PredicateType::None, move(column), nullptr, nullptr);
 }
@@ -120,13 +179,30 @@ void ColumnPredicate::SetToNone() {
   predicate_type_ = PredicateType::None;
   lower_ = nullptr;
   upper_ = nullptr;
+  values_.clear();
+  bloom_filters_.clear();
+}
+
+void ColumnPredicate::IntersectBounds(const void* lower, const void* upper) {
+  // Set the lower bound to the larger of the two.
+  if (lower != nullptr &&
+      (lower_ == nullptr || column_.type_info()->Compare(lower_, lower) < 0)) {
+    lower_ = lower;
+  }
+
+  // Set the upper bound to the smaller of the two.
+  if (upper != nullptr &&
+      (upper_ == nullptr || column_.type_info()->Compare(upper_, upper) > 0)) {
+    upper_ = upper;
+  }
 }
 
 void ColumnPredicate::Simplify() {
   switch (predicate_type_) {
     case PredicateType::None:
     case PredicateType::Equality:
-    case PredicateType::IsNotNull: return;
+    case PredicateType::IsNotNull:
+    case PredicateType::IsNull: return;
     case PredicateType::Range: {
       if (lower_ != nullptr && upper_ != nullptr) {
         if (column_.type_info()->Compare(lower_, upper_) >= 0) {
@@ -140,6 +216,36 @@ void ColumnPredicate::Simplify() {
       }
       return;
     };
+    case PredicateType::InList: {
+      if (values_.empty()) {
+        // If the list is empty then no results can be returned.
+        SetToNone();
+      } else if (values_.size() == 1) {
+        // If the list has a single value, then it is an equality predicate.
+        predicate_type_ = PredicateType::Equality;
+        lower_ = values_[0];
+        values_.clear();
+      }
+      return;
+    };
+    case PredicateType::InBloomFilter: {
+      if (lower_ != nullptr && upper_ != nullptr) {
+        if (column_.type_info()->Compare(lower_, upper_) >= 0) {
+          // If the range bounds are empty then no results can be returned.
+          SetToNone();
+        } else if (column_.type_info()->AreConsecutive(lower_, upper_)) {
+          // If the values are consecutive, then only the lower bound may match.
+          if (CheckValueInBloomFilters(lower_)) {
+            predicate_type_ = PredicateType::Equality;
+            upper_ = nullptr;
+            bloom_filters_.clear();
+          } else {
+            SetToNone();
+          }
+        }
+      }
+      return;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
@@ -157,15 +263,30 @@ void ColumnPredicate::Merge(const ColumnPredicate& other) {
       return;
     };
     case PredicateType::IsNotNull: {
-      // NOT NULL is less selective than all other predicate types, so the
-      // intersection of NOT NULL with any other predicate is just the other
-      // predicate.
-      //
-      // Note: this will no longer be true when an IS NULL predicate type is
-      // added.
-      predicate_type_ = other.predicate_type_;
-      lower_ = other.lower_;
-      upper_ = other.upper_;
+      // IS NOT NULL is less selective than all other predicate types except
+      // IS NULL, so the intersection of IS NOT NULL with any predicate other
+      // than IS NULL is just the other predicate.
+      if (other.predicate_type_ == PredicateType::IsNull) {
+        SetToNone();
+      } else {
+        predicate_type_ = other.predicate_type_;
+        lower_ = other.lower_;
+        upper_ = other.upper_;
+        values_ = other.values_;
+        bloom_filters_ = other.bloom_filters_;
+      }
+      return;
+    };
+    case PredicateType::InList: {
+      MergeIntoInList(other);
+      return;
+    };
+    case PredicateType::IsNull: {
+      MergeIntoIsNull(other);
+      return;
+    };
+    case PredicateType::InBloomFilter: {
+      MergeIntoBloomFilter(other);
       return;
     };
   }
@@ -182,18 +303,7 @@ void ColumnPredicate::MergeIntoRange(const ColumnPredicate& other) {
     };
 
     case PredicateType::Range: {
-      // Set the lower bound to the larger of the two.
-      if (other.lower_ != nullptr &&
-          (lower_ == nullptr || column_.type_info()->Compare(lower_, other.lower_) < 0)) {
-        lower_ = other.lower_;
-      }
-
-      // Set the upper bound to the smaller of the two.
-      if (other.upper_ != nullptr &&
-          (upper_ == nullptr || column_.type_info()->Compare(upper_, other.upper_) > 0)) {
-        upper_ = other.upper_;
-      }
-
+      IntersectBounds(other.lower_, other.upper_);
       Simplify();
       return;
     };
@@ -211,6 +321,33 @@ void ColumnPredicate::MergeIntoRange(const ColumnPredicate& other) {
       return;
     };
     case PredicateType::IsNotNull: return;
+    case PredicateType::IsNull: {
+      SetToNone();
+      return;
+    };
+    case PredicateType::InList: {
+      // Keep only the IN list values which fall in this range.
+      vector<const void*> values;
+      for (const void* value : other.values_) {
+        if (CheckValueInRange(value)) {
+          values.push_back(value);
+        }
+      }
+      predicate_type_ = PredicateType::InList;
+      lower_ = nullptr;
+      upper_ = nullptr;
+      values_.swap(values);
+      Simplify();
+      return;
+    };
+    case PredicateType::InBloomFilter: {
+      // Keep this range as the bounds of the other bloom filter predicate.
+      predicate_type_ = PredicateType::InBloomFilter;
+      bloom_filters_ = other.bloom_filters_;
+      IntersectBounds(other.lower_, other.upper_);
+      Simplify();
+      return;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
@@ -238,31 +375,374 @@ void ColumnPredicate::MergeIntoEquality(const ColumnPredicate& other) {
       return;
     };
     case PredicateType::IsNotNull: return;
+    case PredicateType::IsNull: {
+      SetToNone();
+      return;
+    };
+    case PredicateType::InList: {
+      if (!other.CheckValueInList(lower_)) {
+        // This equality value is not in the other IN list.
+        SetToNone();
+      }
+      return;
+    };
+    case PredicateType::InBloomFilter: {
+      if (!other.CheckValueInBloomFilters(lower_)) {
+        // This equality value is not matched by the other bloom filters.
+        SetToNone();
+      }
+      return;
+    };
+  }
+  LOG(FATAL) << "unknown predicate type";
+}
+
+void ColumnPredicate::MergeIntoInList(const ColumnPredicate& other) {
+  CHECK(predicate_type_ == PredicateType::InList);
+
+  switch (other.predicate_type()) {
+    case PredicateType::None: {
+      SetToNone();
+      return;
+    };
+    case PredicateType::Range: {
+      // Keep only the values which fall in the other range.
+      values_.erase(std::remove_if(values_.begin(), values_.end(),
+                                   [&other] (const void* value) {
+                                     return !other.CheckValueInRange(value);
+                                   }),
+                    values_.end());
+      Simplify();
+      return;
+    };
+    case PredicateType::Equality: {
+      if (CheckValueInList(other.lower_)) {
+        predicate_type_ = PredicateType::Equality;
+        lower_ = other.lower_;
+        values_.clear();
+      } else {
+        SetToNone();
+      }
+      return;
+    };
+    case PredicateType::IsNotNull: return;
+    case PredicateType::IsNull: {
+      SetToNone();
+      return;
+    };
+    case PredicateType::InList: {
+      // Both lists are sorted, so the intersection can be found in a single
+      // pass over the two lists.
+      const TypeInfo* type_info = column_.type_info();
+      vector<const void*> values;
+      std::set_intersection(values_.begin(), values_.end(),
+                            other.values_.begin(), other.values_.end(),
+                            std::back_inserter(values),
+                            [type_info] (const void* a, const void* b) {
+                              return type_info->Compare(a, b) < 0;
+                            });
+      values_.swap(values);
+      Simplify();
+      return;
+    };
+    case PredicateType::InBloomFilter: {
+      // Keep only the values which may match the other bloom filters.
+      values_.erase(std::remove_if(values_.begin(), values_.end(),
+                                   [&other] (const void* value) {
+                                     return !other.CheckValueInBloomFilters(value);
+                                   }),
+                    values_.end());
+      Simplify();
+      return;
+    };
+  }
+  LOG(FATAL) << "unknown predicate type";
+}
+
+void ColumnPredicate::MergeIntoIsNull(const ColumnPredicate& other) {
+  CHECK(predicate_type_ == PredicateType::IsNull);
+
+  switch (other.predicate_type()) {
+    // The intersection of IS NULL with any predicate other than IS NULL is
+    // None, since all other predicates only match non-null values.
+    case PredicateType::None:
+    case PredicateType::Range:
+    case PredicateType::Equality:
+    case PredicateType::IsNotNull:
+    case PredicateType::InList:
+    case PredicateType::InBloomFilter: {
+      SetToNone();
+      return;
+    };
+    case PredicateType::IsNull: return;
+  }
+  LOG(FATAL) << "unknown predicate type";
+}
+
+void ColumnPredicate::MergeIntoBloomFilter(const ColumnPredicate& other) {
+  CHECK(predicate_type_ == PredicateType::InBloomFilter);
+
+  switch (other.predicate_type()) {
+    case PredicateType::None:
+    case PredicateType::IsNull: {
+      SetToNone();
+      return;
+    };
+    case PredicateType::Range: {
+      IntersectBounds(other.lower_, other.upper_);
+      Simplify();
+      return;
+    };
+    case PredicateType::Equality: {
+      if (CheckValueInBloomFilters(other.lower_)) {
+        predicate_type_ = PredicateType::Equality;
+        lower_ = other.lower_;
+        upper_ = nullptr;
+        bloom_filters_.clear();
+      } else {
+        SetToNone();
+      }
+      return;
+    };
+    case PredicateType::IsNotNull: return;
+    case PredicateType::InList: {
+      // Keep only the IN list values which may match this predicate.
+      vector<const void*> values;
+      for (const void* value : other.values_) {
+        if (CheckValueInBloomFilters(value)) {
+          values.push_back(value);
+        }
+      }
+      predicate_type_ = PredicateType::InList;
+      lower_ = nullptr;
+      upper_ = nullptr;
+      bloom_filters_.clear();
+      values_.swap(values);
+      Simplify();
+      return;
+    };
+    case PredicateType::InBloomFilter: {
+      // A value must be in all of the filters.
+      bloom_filters_.insert(bloom_filters_.end(),
+                            other.bloom_filters_.begin(), other.bloom_filters_.end());
+      IntersectBounds(other.lower_, other.upper_);
+      Simplify();
+      return;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
 
+bool ColumnPredicate::CheckValueInRange(const void* value) const {
+  CHECK(predicate_type_ == PredicateType::Range);
+  return (lower_ == nullptr || column_.type_info()->Compare(lower_, value) <= 0) &&
+         (upper_ == nullptr || column_.type_info()->Compare(upper_, value) > 0);
+}
+
+bool ColumnPredicate::CheckValueInList(const void* value) const {
+  CHECK(predicate_type_ == PredicateType::InList);
+  const TypeInfo* type_info = column_.type_info();
+  return std::binary_search(values_.begin(), values_.end(), value,
+                            [type_info] (const void* a, const void* b) {
+                              return type_info->Compare(a, b) < 0;
+                            });
+}
+
+bool ColumnPredicate::CheckValueInBounds(const void* value) const {
+  DCHECK(predicate_type_ == PredicateType::InBloomFilter);
+  return (lower_ == nullptr || column_.type_info()->Compare(lower_, value) <= 0) &&
+         (upper_ == nullptr || column_.type_info()->Compare(upper_, value) > 0);
+}
+
+bool ColumnPredicate::CheckValueInBloomFilters(const void* value) const {
+  DCHECK(predicate_type_ == PredicateType::InBloomFilter);
+  if (!CheckValueInBounds(value)) {
+    return false;
+  }
+  BloomKeyProbe probe(BloomFilterKey(column_.type_info(), value));
+  for (const BloomFilter& bloom_filter : bloom_filters_) {
+    if (!bloom_filter.MayContainKey(probe)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 namespace {
+// Evaluates an IS NULL or IS NOT NULL predicate directly against the null
+// bitmap of the column block, a word at a time, without inspecting any cell
+// values.
+void ApplyNullPredicate(const ColumnBlock& block, bool is_not_null, SelectionVector* sel) {
+  uint8_t* sel_bitmap = sel->mutable_bitmap();
+  if (!block.is_nullable()) {
+    // Every value is non-null: IS NOT NULL selects everything, and IS NULL
+    // selects nothing.
+    if (!is_not_null) {
+      BitmapChangeBits(sel_bitmap, 0, block.nrows(), false);
+    }
+    return;
+  }
+
+  // In the null bitmap, set bits correspond to non-null cells.
+  const uint8_t* null_bitmap = block.null_bitmap();
+  size_t nbytes = block.nrows() / 8;
+  if (is_not_null) {
+    BitmapMergeAnd(sel_bitmap, null_bitmap, nbytes * 8);
+  } else {
+    BitmapMergeAndNot(sel_bitmap, null_bitmap, nbytes * 8);
+  }
+  for (size_t i = nbytes * 8; i < block.nrows(); i++) {
+    if (BitmapTest(null_bitmap, i) != is_not_null) {
+      BitmapClear(sel_bitmap, i);
+    }
+  }
+}
+
 template <typename P>
 void ApplyPredicate(const ColumnBlock& block, SelectionVector* sel, P p) {
+  // Only the selected rows are visited, skipping whole words of unselected
+  // rows at a time.
+  uint8_t* sel_bitmap = sel->mutable_bitmap();
   if (block.is_nullable()) {
-    for (size_t i = 0; i < block.nrows(); i++) {
-      if (!sel->IsRowSelected(i)) continue;
+    sel->ForEachSelectedRow([&](size_t i) {
       const void *cell = block.nullable_cell_ptr(i);
       if (cell == nullptr || !p(cell)) {
-        BitmapClear(sel->mutable_bitmap(), i);
+        BitmapClear(sel_bitmap, i);
       }
-    }
+    });
   } else {
-    for (size_t i = 0; i < block.nrows(); i++) {
-      if (!sel->IsRowSelected(i)) continue;
-      const void *cell = block.cell_ptr(i);
-      if (!p(cell)) {
-        BitmapClear(sel->mutable_bitmap(), i);
+    sel->ForEachSelectedRow([&](size_t i) {
+      if (!p(block.cell_ptr(i))) {
+        BitmapClear(sel_bitmap, i);
       }
+    });
+  }
+}
+
+// The comparison evaluated by the vectorized kernels below.
+enum class ComparisonMode {
+  kLowerBound,  // lower <= cell
+  kUpperBound,  // cell < upper
+  kRange,       // lower <= cell < upper
+  kEquality,    // cell == lower
+};
+
+// Returns true if 'cell' satisfies the comparison. The comparisons are
+// expressed in terms of operator< so that the results (notably for NaN floating
+// point values) are identical to those of DataTypeTraits<>::Compare().
+template <typename T, ComparisonMode MODE>
+ATTRIBUTE_ALWAYS_INLINE inline bool CellMatches(T cell, T lower, T upper) {
+  // 'MODE' is a compile time constant, so all but one branch are eliminated.
+  if (MODE == ComparisonMode::kLowerBound) return !(cell < lower);
+  if (MODE == ComparisonMode::kUpperBound) return cell < upper;
+  if (MODE == ComparisonMode::kRange) return !(cell < lower) & (cell < upper);
+  return !(cell < lower) & !(lower < cell);
+}
+
+// Evaluates the comparison against every cell and ANDs the results into
+// 'sel_bitmap'. The main loop is branch-free and produces a full 32-row word
+// of the selection bitmap per iteration, which lets the compiler turn the
+// comparisons into packed compares and mask extractions.
+template <typename T, ComparisonMode MODE>
+ATTRIBUTE_ALWAYS_INLINE inline void EvaluateComparisonImpl(const T* cells, size_t nrows,
+                                                          T lower, T upper,
+                                                          uint8_t* sel_bitmap) {
+  const size_t kRowsPerWord = 32;
+  size_t nwords = nrows / kRowsPerWord;
+  for (size_t w = 0; w < nwords; w++) {
+    uint32_t mask = 0;
+    for (size_t j = 0; j < kRowsPerWord; j++) {
+      mask |= static_cast<uint32_t>(CellMatches<T, MODE>(cells[j], lower, upper)) << j;
+    }
+    uint8_t* sel_word = sel_bitmap + w * (kRowsPerWord / 8);
+    // Bit 'j' of the mask corresponds to bit 'j % 8' of byte 'j / 8'.
+    sel_word[0] &= mask;
+    sel_word[1] &= mask >> 8;
+    sel_word[2] &= mask >> 16;
+    sel_word[3] &= mask >> 24;
+    cells += kRowsPerWord;
+  }
+  for (size_t i = nwords * kRowsPerWord; i < nrows; i++, cells++) {
+    if (!CellMatches<T, MODE>(*cells, lower, upper)) {
+      BitmapClear(sel_bitmap, i);
     }
   }
 }
+
+// The same kernel compiled for the baseline instruction set (SSE4.2) and for
+// AVX2. The AVX2 variant is only called if the CPU supports it.
+template <typename T, ComparisonMode MODE>
+void EvaluateComparisonSSE4(const T* cells, size_t nrows, T lower, T upper,
+                            uint8_t* sel_bitmap) {
+  EvaluateComparisonImpl<T, MODE>(cells, nrows, lower, upper, sel_bitmap);
+}
+
+template <typename T, ComparisonMode MODE>
+__attribute__((target("avx2")))
+void EvaluateComparisonAVX2(const T* cells, size_t nrows, T lower, T upper,
+                            uint8_t* sel_bitmap) {
+  EvaluateComparisonImpl<T, MODE>(cells, nrows, lower, upper, sel_bitmap);
+}
+
+bool CPUHasAVX2() {
+  static const bool has_avx2 = base::CPU().has_avx2();
+  return has_avx2;
+}
+
+template <typename T, ComparisonMode MODE>
+void EvaluateComparison(const ColumnBlock& block, const void* lower, const void* upper,
+                        SelectionVector* sel) {
+  const T* cells = reinterpret_cast<const T*>(block.data());
+  T lower_val = lower == nullptr ? T() : *reinterpret_cast<const T*>(lower);
+  T upper_val = upper == nullptr ? T() : *reinterpret_cast<const T*>(upper);
+  if (CPUHasAVX2()) {
+    EvaluateComparisonAVX2<T, MODE>(cells, block.nrows(), lower_val, upper_val,
+                                    sel->mutable_bitmap());
+  } else {
+    EvaluateComparisonSSE4<T, MODE>(cells, block.nrows(), lower_val, upper_val,
+                                    sel->mutable_bitmap());
+  }
+  // The kernels compare the (undefined) contents of null cells too, so apply
+  // the null bitmap afterwards: null cells never match a comparison.
+  ApplyNullPredicate(block, true, sel);
+}
+
+// Whether the range and equality predicates for a physical type are evaluated
+// by the vectorized kernels: true for the fixed-width integer and floating
+// point types.
+template <DataType PhysicalType>
+struct IsVectorizedComparisonType {
+  typedef typename DataTypeTraits<PhysicalType>::cpp_type cpp_type;
+  static const bool value = PhysicalType != BOOL &&
+      (std::is_integral<cpp_type>::value || std::is_floating_point<cpp_type>::value);
+};
+
+// Evaluates a range or equality predicate using the vectorized kernels.
+// Returns false without modifying 'sel' if the physical type is not supported.
+template <DataType PhysicalType>
+typename std::enable_if<IsVectorizedComparisonType<PhysicalType>::value, bool>::type
+ApplyVectorizedComparison(const ColumnBlock& block, PredicateType type,
+                          const void* lower, const void* upper, SelectionVector* sel) {
+  typedef typename DataTypeTraits<PhysicalType>::cpp_type T;
+  if (type == PredicateType::Equality) {
+    EvaluateComparison<T, ComparisonMode::kEquality>(block, lower, nullptr, sel);
+  } else if (lower == nullptr) {
+    EvaluateComparison<T, ComparisonMode::kUpperBound>(block, nullptr, upper, sel);
+  } else if (upper == nullptr) {
+    EvaluateComparison<T, ComparisonMode::kLowerBound>(block, lower, nullptr, sel);
+  } else {
+    EvaluateComparison<T, ComparisonMode::kRange>(block, lower, upper, sel);
+  }
+  return true;
+}
+
+template <DataType PhysicalType>
+typename std::enable_if<!IsVectorizedComparisonType<PhysicalType>::value, bool>::type
+ApplyVectorizedComparison(const ColumnBlock& /* block */, PredicateType /* type */,
+                          const void* /* lower */, const void* /* upper */,
+                          SelectionVector* /* sel */) {
+  return false;
+}
 } // anonymous namespace
 
 template <DataType PhysicalType>
@@ -270,6 +750,9 @@ void ColumnPredicate::EvaluateForPhysicalType(const ColumnBlock& block,
                                               SelectionVector* sel) const {
   switch (predicate_type()) {
     case PredicateType::Range: {
+      if (ApplyVectorizedComparison<PhysicalType>(block, predicate_type(), lower_, upper_, sel)) {
+        return;
+      }
       if (lower_ == nullptr) {
         ApplyPredicate(block, sel, [this] (const void* cell) {
           return DataTypeTraits<PhysicalType>::Compare(cell, this->upper_) < 0;
@@ -287,22 +770,37 @@ void ColumnPredicate::EvaluateForPhysicalType(const ColumnBlock& block,
       return;
     };
     case PredicateType::Equality: {
+      if (ApplyVectorizedComparison<PhysicalType>(block, predicate_type(), lower_, upper_, sel)) {
+        return;
+      }
       ApplyPredicate(block, sel, [this] (const void* cell) {
         return DataTypeTraits<PhysicalType>::Compare(cell, this->lower_) == 0;
       });
       return;
     };
     case PredicateType::IsNotNull: {
-      if (!block.is_nullable()) return;
-      // TODO: make this more efficient by using bitwise operations on the
-      // null and selection vectors.
-      for (size_t i = 0; i < block.nrows(); i++) {
-        if (sel->IsRowSelected(i) && block.is_null(i)) {
-          BitmapClear(sel->mutable_bitmap(), i);
-        }
-      }
+      ApplyNullPredicate(block, true, sel);
       return;
-    }
+    };
+    case PredicateType::IsNull: {
+      ApplyNullPredicate(block, false, sel);
+      return;
+    };
+    case PredicateType::InList: {
+      ApplyPredicate(block, sel, [this] (const void* cell) {
+        return std::binary_search(this->values_.begin(), this->values_.end(), cell,
+                                  [] (const void* lhs, const void* rhs) {
+                                    return DataTypeTraits<PhysicalType>::Compare(lhs, rhs) < 0;
+                                  });
+      });
+      return;
+    };
+    case PredicateType::InBloomFilter: {
+      ApplyPredicate(block, sel, [this] (const void* cell) {
+        return this->CheckValueInBloomFilters(cell);
+      });
+      return;
+    };
     default:
       LOG(FATAL) << "unknown predicate type";
   }
@@ -348,6 +846,30 @@ string ColumnPredicate::ToString() const {
     case PredicateType::IsNotNull: {
       return strings::Substitute("`$0` IS NOT NULL", column_.name());
     };
+    case PredicateType::IsNull: {
+      return strings::Substitute("`$0` IS NULL", column_.name());
+    };
+    case PredicateType::InList: {
+      vector<string> values;
+      values.reserve(values_.size());
+      for (const void* value : values_) {
+        values.push_back(column_.Stringify(value));
+      }
+      return strings::Substitute("`$0` IN ($1)", column_.name(), JoinStrings(values, ", "));
+    };
+    case PredicateType::InBloomFilter: {
+      string ret = strings::Substitute("`$0` IN $1 BLOOM FILTER(S)",
+                                       column_.name(), bloom_filters_.size());
+      if (lower_ != nullptr) {
+        strings::SubstituteAndAppend(&ret, " AND `$0` >= $1",
+                                     column_.name(), column_.Stringify(lower_));
+      }
+      if (upper_ != nullptr) {
+        strings::SubstituteAndAppend(&ret, " AND `$0` < $1",
+                                     column_.name(), column_.Stringify(upper_));
+      }
+      return ret;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
@@ -358,13 +880,30 @@ bool ColumnPredicate::operator==(const ColumnPredicate& other) const {
     return false;
   } else if (predicate_type_ == PredicateType::Equality) {
     return column_.type_info()->Compare(lower_, other.lower_) == 0;
-  } else if (predicate_type_ == PredicateType::Range) {
-    return (lower_ == other.lower_ ||
-            (lower_ != nullptr && other.lower_ != nullptr &&
-             column_.type_info()->Compare(lower_, other.lower_) == 0)) &&
-           (upper_ == other.upper_ ||
-            (upper_ != nullptr && other.upper_ != nullptr &&
-             column_.type_info()->Compare(upper_, other.upper_) == 0));
+  } else if (predicate_type_ == PredicateType::Range ||
+             predicate_type_ == PredicateType::InBloomFilter) {
+    bool bounds_equal =
+        (lower_ == other.lower_ ||
+         (lower_ != nullptr && other.lower_ != nullptr &&
+          column_.type_info()->Compare(lower_, other.lower_) == 0)) &&
+        (upper_ == other.upper_ ||
+         (upper_ != nullptr && other.upper_ != nullptr &&
+          column_.type_info()->Compare(upper_, other.upper_) == 0));
+    if (!bounds_equal || bloom_filters_.size() != other.bloom_filters_.size()) return false;
+    for (int i = 0; i < bloom_filters_.size(); i++) {
+      const BloomFilter& a = bloom_filters_[i];
+      const BloomFilter& b = other.bloom_filters_[i];
+      if (a.layout() != b.layout() || a.n_hashes() != b.n_hashes() || a.data() != b.data()) {
+        return false;
+      }
+    }
+    return true;
+  } else if (predicate_type_ == PredicateType::InList) {
+    if (values_.size() != other.values_.size()) return false;
+    for (int i = 0; i < values_.size(); i++) {
+      if (column_.type_info()->Compare(values_[i], other.values_[i]) != 0) return false;
+    }
+    return true;
   } else {
     return true;
   }
@@ -375,9 +914,12 @@ int SelectivityRank(const ColumnPredicate& predicate) {
   int rank;
   switch (predicate.predicate_type()) {
     case PredicateType::None: rank = 0; break;
-    case PredicateType::Equality: rank = 1; break;
-    case PredicateType::Range: rank = 2; break;
-    case PredicateType::IsNotNull: rank = 3; break;
+    case PredicateType::IsNull: rank = 1; break;
+    case PredicateType::Equality: rank = 2; break;
+    case PredicateType::InList: rank = 3; break;
+    case PredicateType::InBloomFilter: rank = 4; break;
+    case PredicateType::Range: rank = 5; break;
+    case PredicateType::IsNotNull: rank = 6; break;
     default: LOG(FATAL) << "unknown predicate type";
   }
   return rank * (kLargestTypeSize + 1) + predicate.column().type_info()->size();
@@ -17,10 +17,14 @@
 
 #pragma once
 
+#include <algorithm>
 #include <boost/optional.hpp>
 #include <string>
+#include <vector>
 
 #include "kudu/common/schema.h"
+#include "kudu/util/bloom_filter.h"
+#include "kudu/util/slice.h"
 
 namespace kudu {
 
@@ -44,6 +48,18 @@ enum class PredicateType {
 
   // A predicate which evaluates to true if the value is not null.
   IsNotNull,
+
+  // A predicate which evaluates to true if the column value is present in
+  // a set of known values.
+  InList,
+
+  // A predicate which evaluates to true if the value is null.
+  IsNull,
+
+  // A predicate which evaluates to true if the column value may be present
+  // in each of a set of bloom filters, and falls within optional range
+  // bounds.
+  InBloomFilter,
 };
 
 // A predicate which can be evaluated over a block of column values.
@@ -107,6 +123,42 @@ class ColumnPredicate {
   // Creates a new IS NOT NULL predicate for the column.
   static ColumnPredicate IsNotNull(ColumnSchema column);
 
+  // Creates a new IS NULL predicate for the column.
+  //
+  // If the column is not nullable, a None predicate is returned.
+  static ColumnPredicate IsNull(ColumnSchema column);
+
+  // Creates a new IN list predicate for the column.
+  //
+  // The values are not copied, and must outlive the returned predicate. The
+  // vector of values is sorted and de-duplicated in place, and its contents
+  // are moved into the returned predicate.
+  //
+  // The IN list will be simplified into an Equality or None predicate type if
+  // possible.
+  static ColumnPredicate InList(ColumnSchema column, std::vector<const void*>* values);
+
+  // Creates a new IN bloom filter predicate for the column, which matches
+  // the values which may be in all of the bloom filters, and fall within the
+  // inclusive lower bound and exclusive upper bound, either of which may be
+  // nullptr. Values are added to and probed against the filters with the key
+  // returned by BloomFilterKey().
+  //
+  // The filters' data and the bounds are not copied, and must outlive the
+  // returned predicate. The vector of filters is moved into the predicate.
+  //
+  // The predicate will be simplified into a None predicate if the bounds are
+  // empty.
+  static ColumnPredicate InBloomFilter(ColumnSchema column,
+                                       std::vector<BloomFilter>* bloom_filters,
+                                       const void* lower,
+                                       const void* upper);
+
+  // Returns the key of the cell 'cell' of a column of type 'type_info' in the
+  // bloom filters of an InBloomFilter predicate: the value itself for STRING
+  // and BINARY columns, and the cell's in-memory representation otherwise.
+  static Slice BloomFilterKey(const TypeInfo* type_info, const void* cell);
+
   // Returns the type of this predicate.
   PredicateType predicate_type() const {
     return predicate_type_;
@@ -160,7 +212,20 @@ class ColumnPredicate {
       };
       case PredicateType::IsNotNull: {
         return true;
-      }
+      };
+      case PredicateType::IsNull: {
+        // Cells are only evaluated when they are not null.
+        return false;
+      };
+      case PredicateType::InList: {
+        return std::binary_search(values_.begin(), values_.end(), cell,
+                                  [] (const void* lhs, const void* rhs) {
+                                    return DataTypeTraits<PhysicalType>::Compare(lhs, rhs) < 0;
+                                  });
+      };
+      case PredicateType::InBloomFilter: {
+        return CheckValueInBloomFilters(cell);
+      };
     }
     LOG(FATAL) << "unknown predicate type";
   }
@@ -173,17 +238,29 @@ class ColumnPredicate {
   // Predicates over different columns are not equal.
   bool operator==(const ColumnPredicate& other) const;
 
-  // Returns the raw lower bound value if this is a range predicate, or the
-  // equality value if this is an equality predicate.
+  // Returns the raw lower bound value if this is a range or IN bloom filter
+  // predicate, or the equality value if this is an equality predicate.
   const void* raw_lower() const {
     return lower_;
   }
 
-  // Returns the raw upper bound if this is a range predicate.
+  // Returns the raw upper bound if this is a range or IN bloom filter
+  // predicate.
   const void* raw_upper() const {
     return upper_;
   }
 
+  // Returns the sorted, de-duplicated list of values if this is an InList
+  // predicate.
+  const std::vector<const void*>& raw_values() const {
+    return values_;
+  }
+
+  // Returns the bloom filters if this is an InBloomFilter predicate.
+  const std::vector<BloomFilter>& bloom_filters() const {
+    return bloom_filters_;
+  }
+
   // Returns the column schema of the column on which this predicate applies.
   const ColumnSchema& column() const {
     return column_;
@@ -205,6 +282,10 @@ class ColumnPredicate {
   // Transition to a None predicate type.
   void SetToNone();
 
+  // Intersects the bounds of this Range or InBloomFilter predicate with the
+  // given bounds, either of which may be nullptr.
+  void IntersectBounds(const void* lower, const void* upper);
+
   // Simplifies this predicate if possible.
   void Simplify();
 
@@ -214,6 +295,28 @@ class ColumnPredicate {
   // Merge another predicate into this Equality predicate.
   void MergeIntoEquality(const ColumnPredicate& other);
 
+  // Merge another predicate into this InList predicate.
+  void MergeIntoInList(const ColumnPredicate& other);
+
+  // Merge another predicate into this IS NULL predicate.
+  void MergeIntoIsNull(const ColumnPredicate& other);
+
+  // Merge another predicate into this InBloomFilter predicate.
+  void MergeIntoBloomFilter(const ColumnPredicate& other);
+
+  // Returns true if the value falls within the bounds of this Range predicate.
+  bool CheckValueInRange(const void* value) const;
+
+  // Returns true if the value is a member of this InList predicate.
+  bool CheckValueInList(const void* value) const;
+
+  // Returns true if the value falls within the bounds of this InBloomFilter
+  // predicate.
+  bool CheckValueInBounds(const void* value) const;
+
+  // Returns true if the value may match this InBloomFilter predicate.
+  bool CheckValueInBloomFilters(const void* value) const;
+
   // Templated evaluation to inline the dispatch of comparator. Templating this
   // allows dispatch to occur only once per batch.
   template <DataType PhysicalType>
@@ -226,12 +329,19 @@ class ColumnPredicate {
   // The data type of the column. TypeInfo instances have a static lifetime.
   ColumnSchema column_;
 
-  // The inclusive lower bound value if this is a Range predicate, or the
-  // equality value if this is an Equality predicate.
+  // The inclusive lower bound value if this is a Range or InBloomFilter
+  // predicate, or the equality value if this is an Equality predicate.
   const void* lower_;
 
-  // The exclusive upper bound value if this is a Range predicate.
+  // The exclusive upper bound value if this is a Range or InBloomFilter
+  // predicate.
   const void* upper_;
+
+  // The sorted, de-duplicated set of values if this is an InList predicate.
+  std::vector<const void*> values_;
+
+  // The bloom filters if this is an InBloomFilter predicate.
+  std::vector<BloomFilter> bloom_filters_;
 };
 
 // Compares predicates according to selectivity. Predicates that match fewer
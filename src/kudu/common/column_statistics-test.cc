@@ -0,0 +1,123 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#include "kudu/common/column_statistics.h"
+
+#include <gtest/gtest.h>
+#include <string>
+
+#include "kudu/common/types.h"
+#include "kudu/gutil/hash/city.h"
+#include "kudu/util/hyperloglog.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+using std::string;
+
+namespace kudu {
+
+class TestColumnStatistics : public KuduTest {
+ protected:
+  // Returns the statistics of 'num_values' consecutive INT32 values starting
+  // at 'min', plus 'null_count' NULLs.
+  static ColumnStatisticsPB MakeStats(int32_t min, int32_t num_values, int64_t null_count) {
+    ColumnStatisticsPB stats;
+    stats.set_num_rows(num_values + null_count);
+    stats.set_null_count(null_count);
+    stats.set_total_bytes(num_values * sizeof(int32_t));
+    HyperLogLog sketch;
+    for (int32_t v = min; v < min + num_values; v++) {
+      sketch.AddHash(util_hash::CityHash64(reinterpret_cast<const char*>(&v), sizeof(v)));
+    }
+    stats.set_ndv_sketch(sketch.registers().ToString());
+    if (num_values > 0) {
+      int32_t max = min + num_values - 1;
+      stats.set_min_value(string(reinterpret_cast<const char*>(&min), sizeof(min)));
+      stats.set_max_value(string(reinterpret_cast<const char*>(&max), sizeof(max)));
+    }
+    return stats;
+  }
+
+  static int32_t DecodeInt32(const string& encoded) {
+    CHECK_EQ(sizeof(int32_t), encoded.size());
+    return *reinterpret_cast<const int32_t*>(encoded.data());
+  }
+
+  const TypeInfo* type_info_ = GetTypeInfo(INT32);
+};
+
+TEST_F(TestColumnStatistics, TestMerge) {
+  ColumnStatisticsPB merged;
+  ASSERT_OK(MergeColumnStatistics(type_info_, MakeStats(100, 1000, 5), &merged));
+  ASSERT_OK(MergeColumnStatistics(type_info_, MakeStats(-50, 500, 0), &merged));
+  ASSERT_OK(MergeColumnStatistics(type_info_, MakeStats(0, 0, 20), &merged));
+
+  ASSERT_EQ(1525, merged.num_rows());
+  ASSERT_EQ(25, merged.null_count());
+  ASSERT_EQ(1500 * sizeof(int32_t), merged.total_bytes());
+  ASSERT_EQ(-50, DecodeInt32(merged.min_value()));
+  ASSERT_EQ(1099, DecodeInt32(merged.max_value()));
+
+  // The inputs overlap on [100, 450).
+  int64_t ndv;
+  ASSERT_OK(EstimateDistinctValues(merged, &ndv));
+  ASSERT_NEAR(1150, ndv, 1150 * 0.1);
+}
+
+TEST_F(TestColumnStatistics, TestAllNulls) {
+  ColumnStatisticsPB merged;
+  ASSERT_OK(MergeColumnStatistics(type_info_, MakeStats(0, 0, 10), &merged));
+  ASSERT_FALSE(merged.has_min_value());
+  ASSERT_FALSE(merged.has_max_value());
+  int64_t ndv;
+  ASSERT_OK(EstimateDistinctValues(merged, &ndv));
+  ASSERT_EQ(0, ndv);
+
+  // The range of rowsets with values is kept.
+  ASSERT_OK(MergeColumnStatistics(type_info_, MakeStats(7, 3, 0), &merged));
+  ASSERT_EQ(7, DecodeInt32(merged.min_value()));
+  ASSERT_EQ(9, DecodeInt32(merged.max_value()));
+  ASSERT_OK(EstimateDistinctValues(merged, &ndv));
+  ASSERT_EQ(3, ndv);
+}
+
+TEST_F(TestColumnStatistics, TestUnknown) {
+  // Rowsets with values but no range or sketch make the merged ones unknown.
+  ColumnStatisticsPB unknown = MakeStats(0, 10, 0);
+  unknown.clear_min_value();
+  unknown.clear_max_value();
+  unknown.clear_ndv_sketch();
+
+  ColumnStatisticsPB merged;
+  ASSERT_OK(MergeColumnStatistics(type_info_, MakeStats(0, 10, 0), &merged));
+  ASSERT_OK(MergeColumnStatistics(type_info_, unknown, &merged));
+  ASSERT_OK(MergeColumnStatistics(type_info_, MakeStats(20, 10, 0), &merged));
+  ASSERT_EQ(30, merged.num_rows());
+  ASSERT_FALSE(merged.has_min_value());
+  ASSERT_FALSE(merged.has_max_value());
+  int64_t ndv;
+  Status s = EstimateDistinctValues(merged, &ndv);
+  ASSERT_TRUE(s.IsNotFound()) << s.ToString();
+
+  // Corrupt values are reported rather than merged.
+  ColumnStatisticsPB corrupt = MakeStats(0, 10, 0);
+  corrupt.set_min_value("x");
+  merged = MakeStats(0, 10, 0);
+  s = MergeColumnStatistics(type_info_, corrupt, &merged);
+  ASSERT_TRUE(s.IsCorruption()) << s.ToString();
+}
+
+} // namespace kudu
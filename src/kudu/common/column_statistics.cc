@@ -0,0 +1,155 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/common/column_statistics.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <glog/logging.h>
+
+#include "kudu/common/types.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/hyperloglog.h"
+#include "kudu/util/slice.h"
+
+using std::string;
+using strings::Substitute;
+
+namespace kudu {
+
+namespace {
+
+// Aligned scratch space for a cell decoded from its statistics encoding.
+struct CellBuffer {
+  uint64_t fixed[2];
+  Slice slice;
+};
+
+Status DecodeCell(const TypeInfo* type_info, const string& encoded,
+                  CellBuffer* buf, const void** cell) {
+  if (type_info->physical_type() == BINARY) {
+    buf->slice = Slice(encoded);
+    *cell = &buf->slice;
+    return Status::OK();
+  }
+  if (PREDICT_FALSE(encoded.size() != type_info->size())) {
+    return Status::Corruption(
+        Substitute("invalid $0 statistics value of $1 bytes",
+                   type_info->name(), encoded.size()));
+  }
+  memcpy(buf->fixed, encoded.data(), encoded.size());
+  *cell = buf->fixed;
+  return Status::OK();
+}
+
+bool HasValues(const ColumnStatisticsPB& stats) {
+  return stats.num_rows() > stats.null_count();
+}
+
+bool HasRange(const ColumnStatisticsPB& stats) {
+  return stats.has_min_value() && stats.has_max_value();
+}
+
+Status MergeRange(const TypeInfo* type_info,
+                  const ColumnStatisticsPB& src,
+                  ColumnStatisticsPB* dst) {
+  if (!HasValues(src)) {
+    return Status::OK();
+  }
+  if (!HasValues(*dst)) {
+    if (HasRange(src)) {
+      dst->set_min_value(src.min_value());
+      dst->set_max_value(src.max_value());
+    }
+    return Status::OK();
+  }
+  if (!HasRange(src) || !HasRange(*dst)) {
+    dst->clear_min_value();
+    dst->clear_max_value();
+    return Status::OK();
+  }
+
+  CellBuffer src_buf;
+  CellBuffer dst_buf;
+  const void* src_cell;
+  const void* dst_cell;
+  RETURN_NOT_OK(DecodeCell(type_info, src.min_value(), &src_buf, &src_cell));
+  RETURN_NOT_OK(DecodeCell(type_info, dst->min_value(), &dst_buf, &dst_cell));
+  bool new_min = type_info->Compare(src_cell, dst_cell) < 0;
+  RETURN_NOT_OK(DecodeCell(type_info, src.max_value(), &src_buf, &src_cell));
+  RETURN_NOT_OK(DecodeCell(type_info, dst->max_value(), &dst_buf, &dst_cell));
+  bool new_max = type_info->Compare(src_cell, dst_cell) > 0;
+  if (new_min) {
+    dst->set_min_value(src.min_value());
+  }
+  if (new_max) {
+    dst->set_max_value(src.max_value());
+  }
+  return Status::OK();
+}
+
+Status MergeSketch(const ColumnStatisticsPB& src, ColumnStatisticsPB* dst) {
+  if (dst->num_rows() == 0) {
+    if (src.has_ndv_sketch()) {
+      dst->set_ndv_sketch(src.ndv_sketch());
+    }
+    return Status::OK();
+  }
+  if (!src.has_ndv_sketch() || !dst->has_ndv_sketch()) {
+    dst->clear_ndv_sketch();
+    return Status::OK();
+  }
+  HyperLogLog src_sketch;
+  HyperLogLog dst_sketch;
+  RETURN_NOT_OK(HyperLogLog::Parse(Slice(src.ndv_sketch()), &src_sketch));
+  RETURN_NOT_OK(HyperLogLog::Parse(Slice(dst->ndv_sketch()), &dst_sketch));
+  RETURN_NOT_OK(dst_sketch.Merge(src_sketch));
+  dst->set_ndv_sketch(dst_sketch.registers().ToString());
+  return Status::OK();
+}
+
+} // anonymous namespace
+
+Status MergeColumnStatistics(const TypeInfo* type_info,
+                             const ColumnStatisticsPB& src,
+                             ColumnStatisticsPB* dst) {
+  dst->set_total_bytes(dst->total_bytes() + src.total_bytes());
+  if (src.num_rows() == 0) {
+    return Status::OK();
+  }
+  // The range and sketch are merged based on the row counts of 'dst' before
+  // it absorbs 'src'.
+  RETURN_NOT_OK(MergeRange(type_info, src, dst));
+  RETURN_NOT_OK(MergeSketch(src, dst));
+  dst->set_num_rows(dst->num_rows() + src.num_rows());
+  dst->set_null_count(dst->null_count() + src.null_count());
+  return Status::OK();
+}
+
+Status EstimateDistinctValues(const ColumnStatisticsPB& stats, int64_t* count) {
+  if (!stats.has_ndv_sketch()) {
+    return Status::NotFound("no distinct value sketch");
+  }
+  HyperLogLog sketch;
+  RETURN_NOT_OK(HyperLogLog::Parse(Slice(stats.ndv_sketch()), &sketch));
+  // The estimate can exceed the number of values it was built from.
+  *count = std::min(sketch.Estimate(), stats.num_rows() - stats.null_count());
+  return Status::OK();
+}
+
+} // namespace kudu
@@ -0,0 +1,45 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_COMMON_COLUMN_STATISTICS_H
+#define KUDU_COMMON_COLUMN_STATISTICS_H
+
+#include <stdint.h>
+
+#include "kudu/common/common.pb.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class TypeInfo;
+
+// Merges 'src', the statistics of some rows of a column of type 'type_info',
+// into 'dst', so that 'dst' describes the union of the rows. A default
+// constructed 'dst' describes no rows.
+//
+// The range or the distinct value sketch of 'dst' becomes unknown if either
+// side has non-NULL values but doesn't know them.
+Status MergeColumnStatistics(const TypeInfo* type_info,
+                             const ColumnStatisticsPB& src,
+                             ColumnStatisticsPB* dst);
+
+// Estimates the number of distinct non-NULL values described by 'stats'.
+// Returns NotFound if 'stats' has no distinct value sketch.
+Status EstimateDistinctValues(const ColumnStatisticsPB& stats, int64_t* count);
+
+} // namespace kudu
+
+#endif
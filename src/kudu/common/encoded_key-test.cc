@@ -19,6 +19,7 @@
 
 #include <gtest/gtest.h>
 
+#include "kudu/common/row.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/stopwatch.h"
@@ -242,6 +243,53 @@ TEST_F(EncodedKeyTest, TestConstructFromEncodedString) {
   }
 }
 
+// Test that keys encoded straight from a row match those built column by
+// column, whether they fit inline or not.
+TEST_F(EncodedKeyTest, TestFromContiguousRow) {
+  Schema schema({ ColumnSchema("key0", INT32),
+                  ColumnSchema("key1", STRING),
+                  ColumnSchema("val", INT32) }, 2);
+  for (const string& s : { string("short"), string(100, 'x') }) {
+    RowBuilder rb(schema);
+    rb.AddInt32(12345);
+    rb.AddString(s);
+    rb.AddInt32(0);
+    ConstContiguousRow row = rb.row();
+
+    EncodedKeyBuilder kb(&schema);
+    kb.AddColumnKey(row.cell_ptr(0));
+    kb.AddColumnKey(row.cell_ptr(1));
+    gscoped_ptr<EncodedKey> expected(kb.BuildEncodedKey());
+
+    gscoped_ptr<EncodedKey> key = EncodedKey::FromContiguousRow(row);
+    ASSERT_EQ(expected->encoded_key(), key->encoded_key());
+    ASSERT_EQ(2, key->raw_keys().size());
+    ASSERT_EQ(row.cell_ptr(1), key->raw_keys()[1]);
+    EXPECT_ROWKEY_EQ(schema, strings::Substitute("(int32 key0=12345, string key1=$0)", s),
+                     *key);
+  }
+}
+
+// Test that swapping faststrings hands over their contents, whether inline
+// or on the heap.
+TEST_F(EncodedKeyTest, TestFaststringSwap) {
+  const string long_str(100, 'x');
+  faststring a;
+  faststring b;
+  a.append("inline");
+  b.append(long_str);
+  const uint8_t* heap_data = b.data();
+  a.swap(b);
+  ASSERT_EQ(long_str, a.ToString());
+  ASSERT_EQ(heap_data, a.data());
+  ASSERT_EQ("inline", b.ToString());
+  b.swap(a);
+  ASSERT_EQ("inline", a.ToString());
+  ASSERT_EQ(long_str, b.ToString());
+  b.swap(b);
+  ASSERT_EQ(long_str, b.ToString());
+}
+
 // Test encoding random strings and ensure that the decoded string
 // matches the input.
 TEST_F(EncodedKeyTest, TestRandomStringEncoding) {
@@ -271,6 +319,32 @@ TEST_F(EncodedKeyTest, TestRandomStringEncoding) {
   }
 }
 
+// Test that '\0' bytes are escaped wherever they are, including in chunks
+// following or preceding ones without any.
+TEST_F(EncodedKeyTest, TestStringEncodingWithZeros) {
+  for (int len = 1; len < 48; len++) {
+    for (int zero_pos = 0; zero_pos < len; zero_pos++) {
+      string in(len, 'x');
+      in[zero_pos] = '\0';
+      in[len - 1 - zero_pos] = '\0';
+
+      string expected;
+      for (char c : in) {
+        expected.push_back(c);
+        if (c == '\0') {
+          expected.push_back('\1');
+        }
+      }
+      expected.append(2, '\0');
+
+      faststring encoded;
+      KeyEncoderTraits<BINARY, faststring>::EncodeWithSeparators(Slice(in), false, &encoded);
+      ASSERT_EQ(Slice(expected).ToDebugString(), Slice(encoded).ToDebugString())
+          << "len=" << len << " zero_pos=" << zero_pos;
+    }
+  }
+}
+
 #ifdef NDEBUG
 
 // Without this wrapper function, small changes to the code size of
@@ -297,5 +371,48 @@ TEST_F(EncodedKeyTest, BenchmarkStringEncoding) {
     }
   }
 }
+
+// Benchmark encoding the keys of rows, as RowSetKeyProbe does for every
+// row written, for a few common key shapes.
+TEST_F(EncodedKeyTest, BenchmarkFromContiguousRow) {
+  const int kNumRows = 1000000;
+  const Slice kHost("host-0001.example.com");
+  const Slice kHostWithZeros("host\0\0001.example\0com", 22);
+  struct KeyShape {
+    const char* name;
+    Schema schema;
+  };
+  vector<KeyShape> shapes = {
+    { "int64", Schema({ ColumnSchema("k0", INT64) }, 1) },
+    { "int32,int64", Schema({ ColumnSchema("k0", INT32), ColumnSchema("k1", INT64) }, 2) },
+    { "int32,string", Schema({ ColumnSchema("k0", INT32), ColumnSchema("k1", STRING) }, 2) },
+    { "string,int64", Schema({ ColumnSchema("k0", STRING), ColumnSchema("k1", INT64) }, 2) },
+    { "string with zeros,int64",
+      Schema({ ColumnSchema("k0", BINARY), ColumnSchema("k1", INT64) }, 2) },
+  };
+  for (const auto& shape : shapes) {
+    RowBuilder rb(shape.schema);
+    for (int i = 0; i < shape.schema.num_key_columns(); i++) {
+      switch (shape.schema.column(i).type_info()->type()) {
+        case INT32: rb.AddInt32(12345); break;
+        case INT64: rb.AddInt64(1234567890123); break;
+        case STRING: rb.AddString(kHost); break;
+        case BINARY: rb.AddBinary(kHostWithZeros); break;
+        default: LOG(FATAL) << "unexpected key type";
+      }
+    }
+    ConstContiguousRow row = rb.row();
+
+    Stopwatch sw;
+    sw.start();
+    for (int i = 0; i < kNumRows; i++) {
+      EncodedKey key(row);
+      CHECK_GT(key.encoded_key().size(), 0);
+    }
+    sw.stop();
+    LOG(INFO) << strings::Substitute("Key shape ($0): $1 rows/sec", shape.name,
+                                     static_cast<int64_t>(kNumRows / sw.elapsed().wall_seconds()));
+  }
+}
 #endif
 } // namespace kudu
@@ -31,22 +31,27 @@ EncodedKey::EncodedKey(faststring* data,
                        vector<const void *> *raw_keys,
                        size_t num_key_cols)
   : num_key_cols_(num_key_cols) {
-  int len = data->size();
-  data_.reset(data->release());
-  encoded_key_ = Slice(data_.get(), len);
+  data_.swap(*data);
+  encoded_key_ = Slice(data_);
 
   DCHECK_LE(raw_keys->size(), num_key_cols);
 
   raw_keys_.swap(*raw_keys);
 }
 
-gscoped_ptr<EncodedKey> EncodedKey::FromContiguousRow(const ConstContiguousRow& row) {
-  EncodedKeyBuilder kb(row.schema());
-  for (int i = 0; i < row.schema()->num_key_columns(); i++) {
-    kb.AddColumnKey(row.cell_ptr(i));
+EncodedKey::EncodedKey(const ConstContiguousRow& row)
+  : num_key_cols_(row.schema()->num_key_columns()) {
+  const Schema* schema = row.schema();
+  raw_keys_.reserve(num_key_cols_);
+  for (int i = 0; i < num_key_cols_; i++) {
+    raw_keys_.push_back(row.cell_ptr(i));
   }
-  return make_gscoped_ptr(kb.BuildEncodedKey());
+  data_.reserve(schema->key_byte_size());
+  encoded_key_ = schema->EncodeComparableKey(row, &data_);
+}
 
+gscoped_ptr<EncodedKey> EncodedKey::FromContiguousRow(const ConstContiguousRow& row) {
+  return make_gscoped_ptr(new EncodedKey(row));
 }
 
 Status EncodedKey::DecodeEncodedString(const Schema& schema,
@@ -150,9 +155,8 @@ void EncodedKeyBuilder::AddColumnKey(const void *raw_key) {
   const ColumnSchema &col = schema_->column(idx_);
   DCHECK(!col.is_nullable());
 
-  const TypeInfo* ti = col.type_info();
   bool is_last = idx_ == num_key_cols_ - 1;
-  GetKeyEncoder<faststring>(ti).Encode(raw_key, is_last, &encoded_key_);
+  schema_->key_encoder(idx_).Encode(raw_key, is_last, &encoded_key_);
   raw_keys_.push_back(raw_key);
 
   ++idx_;
@@ -39,6 +39,14 @@ class EncodedKey {
              vector<const void *> *raw_keys,
              size_t num_key_cols);
 
+  // Constructs the EncodedKey of the key columns of 'row', which must remain
+  // valid for the lifetime of the key.
+  //
+  // Keys which encode to no more than 32 bytes are held inline, so that keys
+  // built on the stack (e.g. by RowSetKeyProbe) only allocate for their
+  // raw_keys().
+  explicit EncodedKey(const ConstContiguousRow& row);
+
   static gscoped_ptr<EncodedKey> FromContiguousRow(const ConstContiguousRow& row);
 
   // Decode the encoded key specified in 'encoded', which must correspond to the
@@ -82,9 +90,11 @@ class EncodedKey {
 
 
  private:
+  DISALLOW_COPY_AND_ASSIGN(EncodedKey);
+
   const int num_key_cols_;
   Slice encoded_key_;
-  gscoped_ptr<uint8_t[]> data_;
+  faststring data_;
   vector<const void *> raw_keys_;
 };
 
@@ -24,14 +24,18 @@
 #include "kudu/common/iterator.h"
 #include "kudu/common/generic_iterators.h"
 #include "kudu/common/column_materialization_context.h"
+#include "kudu/common/key_encoder.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/common/schema.h"
 #include "kudu/gutil/casts.h"
 #include "kudu/gutil/mathlimits.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/mem_tracker.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_int32(num_lists, 3, "Number of lists to merge");
 DEFINE_int32(num_rows, 1000, "Number of entries per list");
@@ -228,6 +232,125 @@ TEST(TestMergeIterator, TestMergePredicate2) {
   TestMerge(predicate);
 }
 
+// Test merging many overlapping inputs whose lower bounds are known, so that
+// most of them are only activated part way through the merge.
+TEST(TestMergeIterator, TestMergeWithBounds) {
+  const int kNumLists = 50;
+  const KeyEncoder<faststring>& encoder = GetKeyEncoder<faststring>(GetTypeInfo(UINT32));
+
+  vector<IterWithBounds> to_merge;
+  vector<uint32_t> expected;
+  for (int i = 0; i < kNumLists; i++) {
+    // Each list overlaps the next couple of lists.
+    vector<uint32_t> ints;
+    uint32_t first = i * 20;
+    for (uint32_t entry = first; entry < first + 50; entry += 1 + (i % 3)) {
+      ints.push_back(entry);
+      expected.push_back(entry);
+    }
+    shared_ptr<VectorIterator> it(new VectorIterator(ints));
+    it->set_block_size(7);
+
+    // Leave a few inputs unbounded, and underestimate the bounds of others.
+    string bound;
+    if (i % 7 != 0) {
+      faststring encoded;
+      uint32_t lower = i % 5 == 0 ? first / 2 : first;
+      encoder.Encode(&lower, &encoded);
+      bound = encoded.ToString();
+    }
+    to_merge.push_back({ shared_ptr<RowwiseIterator>(new MaterializingIterator(it)), bound });
+  }
+  // An empty input with a bound past all the others must not make
+  // HasNext() return true once the rest are exhausted.
+  faststring encoded;
+  uint32_t past_end = kNumLists * 100;
+  encoder.Encode(&past_end, &encoded);
+  to_merge.push_back({ shared_ptr<RowwiseIterator>(new MaterializingIterator(
+      shared_ptr<ColumnwiseIterator>(new VectorIterator({})))), encoded.ToString() });
+  std::sort(expected.begin(), expected.end());
+
+  MergeIterator merger(kIntSchema, std::move(to_merge));
+  ASSERT_OK(merger.Init(nullptr));
+
+  vector<uint32_t> results;
+  RowBlock dst(kIntSchema, 100, nullptr);
+  while (merger.HasNext()) {
+    ASSERT_OK(merger.NextBlock(&dst));
+    ASSERT_GT(dst.nrows(), 0) << "if HasNext() returns true, must return some rows";
+    for (int i = 0; i < dst.nrows(); i++) {
+      results.push_back(*kIntSchema.ExtractColumnFromRow<UINT32>(dst.row(i), 0));
+    }
+  }
+  ASSERT_EQ(expected, results);
+}
+
+// Test that the ParallelUnionIterator yields exactly the rows of its inputs
+// which pass the predicate, reading them from several threads.
+TEST(TestParallelUnionIterator, TestUnionPredicate) {
+  const int kNumLists = 10;
+  TestIntRangePredicate predicate(FLAGS_num_rows / 4, FLAGS_num_rows * 2);
+  ScanSpec spec;
+  spec.AddPredicate(predicate.pred_);
+
+  vector<shared_ptr<RowwiseIterator>> iters;
+  vector<uint32_t> expected;
+  for (int i = 0; i < kNumLists; i++) {
+    vector<uint32_t> ints;
+    for (int j = 0; j < FLAGS_num_rows; j++) {
+      uint32_t entry = j * 3 + i;
+      ints.push_back(entry);
+      if (entry >= predicate.lower_ && entry < predicate.upper_) {
+        expected.push_back(entry);
+      }
+    }
+    shared_ptr<VectorIterator> it(new VectorIterator(ints));
+    it->set_block_size(7);
+    iters.emplace_back(new MaterializingIterator(it));
+  }
+  std::sort(expected.begin(), expected.end());
+
+  gscoped_ptr<ThreadPool> pool;
+  ASSERT_OK(ThreadPoolBuilder("scan").set_max_threads(4).Build(&pool));
+  shared_ptr<MemTracker> tracker = MemTracker::CreateTracker(-1, "test");
+  {
+    ParallelUnionIterator iter(iters, pool.get(), 3, tracker);
+    ASSERT_OK(iter.Init(&spec));
+    ASSERT_TRUE(spec.predicates().empty()) << "Should have accepted all predicates";
+
+    // Read with a block smaller than the batches read ahead, so that batches
+    // are returned in pieces.
+    vector<uint32_t> results;
+    RowBlock dst(kIntSchema, 100, nullptr);
+    while (iter.HasNext()) {
+      ASSERT_OK(iter.NextBlock(&dst));
+      ASSERT_GT(dst.nrows(), 0);
+      for (int i = 0; i < dst.nrows(); i++) {
+        if (dst.selection_vector()->IsRowSelected(i)) {
+          results.push_back(*kIntSchema.ExtractColumnFromRow<UINT32>(dst.row(i), 0));
+        }
+      }
+    }
+    std::sort(results.begin(), results.end());
+    ASSERT_EQ(expected, results);
+    ASSERT_EQ(0, tracker->consumption());
+  }
+
+  // Destroying the iterator while batches are still being read ahead waits
+  // for them and releases their memory.
+  iters.clear();
+  for (int i = 0; i < kNumLists; i++) {
+    iters.emplace_back(new MaterializingIterator(
+        shared_ptr<ColumnwiseIterator>(new VectorIterator(vector<uint32_t>(1000, i)))));
+  }
+  {
+    ParallelUnionIterator iter(iters, pool.get(), 3, tracker);
+    ASSERT_OK(iter.Init(nullptr));
+    ASSERT_TRUE(iter.HasNext());
+  }
+  ASSERT_EQ(0, tracker->consumption());
+}
+
 // Test that the MaterializingIterator properly evaluates predicates when they apply
 // to single columns.
 TEST(TestMaterializingIterator, TestMaterializingPredicatePushdown) {
@@ -16,6 +16,7 @@
 // under the License.
 
 #include <algorithm>
+#include <boost/bind.hpp>
 #include <memory>
 #include <string>
 #include <tuple>
@@ -23,6 +24,7 @@
 
 #include "kudu/common/column_materialization_context.h"
 #include "kudu/common/column_predicate.h"
+#include "kudu/common/encoded_key.h"
 #include "kudu/common/generic_iterators.h"
 #include "kudu/common/row.h"
 #include "kudu/common/rowblock.h"
@@ -30,11 +32,15 @@
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/mem_tracker.h"
 #include "kudu/util/memory/arena.h"
+#include "kudu/util/threadpool.h"
 
 using std::all_of;
 using std::get;
 using std::move;
+using std::pop_heap;
+using std::push_heap;
 using std::remove_if;
 using std::shared_ptr;
 using std::sort;
@@ -86,13 +92,9 @@ class MergeIterState {
     } else {
       // Seek to the next selected row.
       SelectionVector *selection = read_block_.selection_vector();
-      for (++next_row_idx_; next_row_idx_ < read_block_.nrows(); next_row_idx_++) {
-        if (selection->IsRowSelected(next_row_idx_)) {
-          next_row_.Reset(&read_block_, next_row_idx_);
-          break;
-        }
-      }
-      DCHECK_NE(next_row_idx_, read_block_.nrows()+1) << "No selected rows found!";
+      next_row_idx_ = selection->FindFirstSelected(next_row_idx_ + 1);
+      DCHECK_LT(next_row_idx_, read_block_.nrows()) << "No selected rows found!";
+      next_row_.Reset(&read_block_, next_row_idx_);
       return Status::OK();
     }
   }
@@ -115,15 +117,14 @@ class MergeIterState {
       // Honor the selection vector of the read_block_, since not all rows are necessarily selected.
       SelectionVector *selection = read_block_.selection_vector();
       DCHECK_EQ(selection->nrows(), read_block_.nrows());
-      DCHECK_LE(selection->CountSelected(), read_block_.nrows());
       num_valid_ = selection->CountSelected();
-      VLOG(2) << selection->CountSelected() << "/" << read_block_.nrows() << " rows selected";
+      DCHECK_LE(num_valid_, read_block_.nrows());
+      VLOG(2) << num_valid_ << "/" << read_block_.nrows() << " rows selected";
       // Seek next_row_ to the first selected row.
-      for (next_row_idx_ = 0; next_row_idx_ < read_block_.nrows(); next_row_idx_++) {
-        if (selection->IsRowSelected(next_row_idx_)) {
-          next_row_.Reset(&read_block_, next_row_idx_);
-          return Status::OK();
-        }
+      if (num_valid_ > 0) {
+        next_row_idx_ = selection->FindFirstSelected(0);
+        next_row_.Reset(&read_block_, next_row_idx_);
+        return Status::OK();
       }
       // The block may have had no selected rows, in which case we need to continue
       // to the next block.
@@ -156,15 +157,54 @@ class MergeIterState {
   size_t num_valid_;
 };
 
+namespace {
+
+// Orders the heap of hot MergeIterStates so that the one with the smallest
+// next row is at the front.
+struct MergeIterStateGreater {
+  explicit MergeIterStateGreater(const Schema* schema) : schema_(schema) {}
+
+  bool operator()(const unique_ptr<MergeIterState>& a,
+                  const unique_ptr<MergeIterState>& b) const {
+    return schema_->Compare(a->next_row(), b->next_row()) > 0;
+  }
+
+  const Schema* schema_;
+};
+
+// Compare the decoded key 'key' with the key columns of 'row'.
+int CompareKeyToRow(const Schema& schema, const EncodedKey& key, const RowBlockRow& row) {
+  for (size_t col = 0; col < schema.num_key_columns(); col++) {
+    int cmp = schema.column(col).Compare(key.raw_keys()[col], row.cell_ptr(col));
+    if (cmp != 0) {
+      return cmp;
+    }
+  }
+  return 0;
+}
+
+} // anonymous namespace
 
 MergeIterator::MergeIterator(
   const Schema &schema,
   const vector<shared_ptr<RowwiseIterator> > &iters)
   : schema_(schema),
-    initted_(false) {
+    initted_(false),
+    bounds_arena_(256, 1024*1024) {
   CHECK_GT(iters.size(), 0);
   CHECK_GT(schema.num_key_columns(), 0);
-  orig_iters_.assign(iters.begin(), iters.end());
+  for (const shared_ptr<RowwiseIterator>& iter : iters) {
+    orig_iters_.push_back({ iter, "" });
+  }
+}
+
+MergeIterator::MergeIterator(const Schema &schema, vector<IterWithBounds> iters)
+  : schema_(schema),
+    initted_(false),
+    orig_iters_(move(iters)),
+    bounds_arena_(256, 1024*1024) {
+  CHECK_GT(orig_iters_.size(), 0);
+  CHECK_GT(schema.num_key_columns(), 0);
 }
 
 MergeIterator::~MergeIterator() {}
@@ -175,18 +215,11 @@ Status MergeIterator::Init(ScanSpec *spec) {
 
   RETURN_NOT_OK(InitSubIterators(spec));
 
-  for (unique_ptr<MergeIterState> &state : iters_) {
-    RETURN_NOT_OK(state->PullNextBlock());
-  }
-
-  // Before we copy any rows, clean up any iterators which were empty
-  // to start with. Otherwise, HasNext() won't properly return false
-  // if we were passed only empty iterators.
-  iters_.erase(
-      remove_if(iters_.begin(), iters_.end(), [] (const unique_ptr<MergeIterState>& iter) {
-        return PREDICT_FALSE(iter->IsFullyExhausted());
-      }),
-      iters_.end());
+  // Before we copy any rows, activate the iterators which may return the
+  // smallest key. Iterators which were empty to start with are dropped, so
+  // that HasNext() properly returns false if we were passed only empty
+  // iterators.
+  RETURN_NOT_OK(ActivateColdIterators());
 
   initted_ = true;
   return Status::OK();
@@ -194,17 +227,39 @@ Status MergeIterator::Init(ScanSpec *spec) {
 
 bool MergeIterator::HasNext() const {
   CHECK(initted_);
-  return !iters_.empty();
+  return !hot_.empty() || !cold_.empty();
 }
 
 Status MergeIterator::InitSubIterators(ScanSpec *spec) {
   // Initialize all the sub iterators.
-  for (shared_ptr<RowwiseIterator> &iter : orig_iters_) {
+  for (IterWithBounds& sub : orig_iters_) {
     ScanSpec *spec_copy = spec != nullptr ? scan_spec_copies_.Construct(*spec) : nullptr;
-    RETURN_NOT_OK(PredicateEvaluatingIterator::InitAndMaybeWrap(&iter, spec_copy));
-    iters_.push_back(unique_ptr<MergeIterState>(new MergeIterState(iter)));
+    RETURN_NOT_OK(PredicateEvaluatingIterator::InitAndMaybeWrap(&sub.iter, spec_copy));
+
+    ColdIter cold;
+    cold.iter = sub.iter;
+    if (!sub.encoded_lower_bound.empty()) {
+      gscoped_ptr<EncodedKey> key;
+      RETURN_NOT_OK(EncodedKey::DecodeEncodedString(schema_, &bounds_arena_,
+                                                    sub.encoded_lower_bound, &key));
+      cold.lower_bound.reset(key.release());
+    }
+    cold_.push_back(move(cold));
   }
 
+  // Sort the cold iterators so that the one with the smallest bound is last.
+  // Encoded keys sort like the keys themselves, and unbounded iterators sort
+  // as the smallest.
+  sort(cold_.begin(), cold_.end(), [] (const ColdIter& a, const ColdIter& b) {
+    if (!a.lower_bound) {
+      return false;
+    }
+    if (!b.lower_bound) {
+      return true;
+    }
+    return a.lower_bound->encoded_key().compare(b.lower_bound->encoded_key()) > 0;
+  });
+
   // Since we handle predicates in all the wrapped iterators, we can clear
   // them here.
   if (spec != nullptr) {
@@ -213,6 +268,26 @@ Status MergeIterator::InitSubIterators(ScanSpec *spec) {
   return Status::OK();
 }
 
+Status MergeIterator::ActivateColdIterators() {
+  MergeIterStateGreater greater(&schema_);
+  while (!cold_.empty()) {
+    const ColdIter& next = cold_.back();
+    if (!hot_.empty() && next.lower_bound &&
+        CompareKeyToRow(schema_, *next.lower_bound, hot_.front()->next_row()) > 0) {
+      break;
+    }
+    unique_ptr<MergeIterState> state(new MergeIterState(next.iter));
+    cold_.pop_back();
+    RETURN_NOT_OK(state->PullNextBlock());
+    if (PREDICT_FALSE(state->IsFullyExhausted())) {
+      continue;
+    }
+    hot_.push_back(move(state));
+    push_heap(hot_.begin(), hot_.end(), greater);
+  }
+  return Status::OK();
+}
+
 Status MergeIterator::NextBlock(RowBlock* dst) {
   CHECK(initted_);
   DCHECK_SCHEMA_EQ(dst->schema(), schema());
@@ -231,7 +306,7 @@ void MergeIterator::PrepareBatch(RowBlock* dst) {
   // We can always provide at least as many rows as are remaining
   // in the currently queued up blocks.
   size_t available = 0;
-  for (unique_ptr<MergeIterState> &iter : iters_) {
+  for (unique_ptr<MergeIterState> &iter : hot_) {
     available += iter->remaining_in_block();
   }
 
@@ -242,40 +317,40 @@ void MergeIterator::PrepareBatch(RowBlock* dst) {
 // and such around the comparisons. A simple experiment indicated there's some
 // 2x to be gained.
 Status MergeIterator::MaterializeBlock(RowBlock *dst) {
+  MergeIterStateGreater greater(&schema_);
+
   // Initialize the selection vector.
   // MergeIterState only returns selected rows.
   dst->selection_vector()->SetAllTrue();
   for (size_t dst_row_idx = 0; dst_row_idx < dst->nrows(); dst_row_idx++) {
     RowBlockRow dst_row = dst->row(dst_row_idx);
 
-    // Find the sub-iterator which is currently smallest
-    MergeIterState *smallest = nullptr;
-    ssize_t smallest_idx = -1;
-
-    // Typically the number of iters_ is not that large, so using a priority
-    // queue is not worth it
-    for (size_t i = 0; i < iters_.size(); i++) {
-      unique_ptr<MergeIterState> &state = iters_[i];
-
-      if (smallest == nullptr ||
-          schema_.Compare(state->next_row(), smallest->next_row()) < 0) {
-        smallest = state.get();
-        smallest_idx = i;
-      }
+    // Any cold iterator whose range has been reached may hold the next row.
+    if (!cold_.empty()) {
+      RETURN_NOT_OK(ActivateColdIterators());
     }
 
     // If no iterators had any row left, then we're done iterating.
-    if (PREDICT_FALSE(smallest == nullptr)) break;
+    if (PREDICT_FALSE(hot_.empty())) break;
 
     // Otherwise, copy the row from the smallest one, and advance it
+    pop_heap(hot_.begin(), hot_.end(), greater);
+    MergeIterState* smallest = hot_.back().get();
     RETURN_NOT_OK(CopyRow(smallest->next_row(), &dst_row, dst->arena()));
     RETURN_NOT_OK(smallest->Advance());
 
     if (smallest->IsFullyExhausted()) {
-      iters_.erase(iters_.begin() + smallest_idx);
+      hot_.pop_back();
+    } else {
+      push_heap(hot_.begin(), hot_.end(), greater);
     }
   }
 
+  // Make sure HasNext() doesn't return true when only empty cold iterators
+  // remain.
+  if (hot_.empty()) {
+    RETURN_NOT_OK(ActivateColdIterators());
+  }
   return Status::OK();
 }
 
@@ -283,8 +358,8 @@ string MergeIterator::ToString() const {
   string s;
   s.append("Merge(");
   bool first = true;
-  for (const shared_ptr<RowwiseIterator> &iter : orig_iters_) {
-    s.append(iter->ToString());
+  for (const IterWithBounds &sub : orig_iters_) {
+    s.append(sub.iter->ToString());
     if (!first) {
       s.append(", ");
     }
@@ -302,9 +377,9 @@ const Schema& MergeIterator::schema() const {
 void MergeIterator::GetIteratorStats(vector<IteratorStats>* stats) const {
   CHECK(initted_);
   vector<vector<IteratorStats> > stats_by_iter;
-  for (const shared_ptr<RowwiseIterator>& iter : orig_iters_) {
+  for (const IterWithBounds& sub : orig_iters_) {
     vector<IteratorStats> stats_for_iter;
-    iter->GetIteratorStats(&stats_for_iter);
+    sub.iter->GetIteratorStats(&stats_for_iter);
     stats_by_iter.push_back(stats_for_iter);
   }
   for (size_t idx = 0; idx < schema_.num_columns(); ++idx) {
@@ -436,6 +511,241 @@ void UnionIterator::GetIteratorStats(std::vector<IteratorStats>* stats) const {
   }
 }
 
+////////////////////////////////////////////////////////////
+// Parallel union iterator
+////////////////////////////////////////////////////////////
+
+// The number of rows read from a sub-iterator at a time.
+static const size_t kParallelUnionBatchRows = 1000;
+
+// The number of batches which may be read ahead per reading thread.
+static const int kParallelUnionReadAheadPerThread = 2;
+
+struct ParallelUnionIterator::SubIterator {
+  explicit SubIterator(shared_ptr<RowwiseIterator> iter)
+      : iter(move(iter)) {
+  }
+
+  shared_ptr<RowwiseIterator> iter;
+
+  // The stats of 'iter' as of its last read. They are copied after each
+  // read since 'iter' may be in use by another thread when they are needed.
+  vector<IteratorStats> stats;
+};
+
+struct ParallelUnionIterator::Batch {
+  explicit Batch(const Schema& schema)
+      : arena(32 * 1024, 1 * 1024 * 1024),
+        block(schema, kParallelUnionBatchRows, &arena),
+        memory_consumed(0) {
+  }
+
+  Arena arena;
+  RowBlock block;
+
+  // The bytes consumed from the iterator's MemTracker for this batch.
+  int64_t memory_consumed;
+};
+
+ParallelUnionIterator::ParallelUnionIterator(const vector<shared_ptr<RowwiseIterator> > &iters,
+                                             ThreadPool* pool,
+                                             int max_parallelism,
+                                             shared_ptr<MemTracker> mem_tracker)
+  : initted_(false),
+    pool_(DCHECK_NOTNULL(pool)),
+    max_parallelism_(max_parallelism),
+    mem_tracker_(move(mem_tracker)),
+    read_done_(&lock_),
+    num_reading_(0),
+    front_rows_returned_(0),
+    shutting_down_(false) {
+  CHECK_GT(iters.size(), 0);
+  CHECK_GT(max_parallelism, 0);
+  for (const shared_ptr<RowwiseIterator>& iter : iters) {
+    subs_.emplace_back(new SubIterator(iter));
+  }
+}
+
+ParallelUnionIterator::~ParallelUnionIterator() {
+  MutexLock l(lock_);
+  shutting_down_ = true;
+  while (num_reading_ > 0) {
+    read_done_.Wait();
+  }
+  for (const unique_ptr<Batch>& batch : ready_) {
+    mem_tracker_->Release(batch->memory_consumed);
+  }
+}
+
+Status ParallelUnionIterator::Init(ScanSpec *spec) {
+  CHECK(!initted_);
+
+  // Initialize the underlying iterators, as in UnionIterator.
+  for (const unique_ptr<SubIterator>& sub : subs_) {
+    ScanSpec *spec_copy = spec != nullptr ? scan_spec_copies_.Construct(*spec) : nullptr;
+    RETURN_NOT_OK(PredicateEvaluatingIterator::InitAndMaybeWrap(&sub->iter, spec_copy));
+  }
+  if (spec != nullptr) {
+    spec->RemovePredicates();
+  }
+
+  schema_.reset(new Schema(subs_.front()->iter->schema()));
+  for (const unique_ptr<SubIterator>& sub : subs_) {
+    if (!sub->iter->schema().Equals(*schema_)) {
+      return Status::InvalidArgument(
+        string("Schemas do not match: ") + schema_->ToString()
+        + " vs " + sub->iter->schema().ToString());
+    }
+  }
+  initted_ = true;
+
+  // Start reading ahead right away.
+  MutexLock l(lock_);
+  for (const unique_ptr<SubIterator>& sub : subs_) {
+    sub->iter->GetIteratorStats(&sub->stats);
+    if (sub->iter->HasNext()) {
+      idle_.push_back(sub.get());
+    }
+  }
+  ScheduleReadsUnlocked();
+  return Status::OK();
+}
+
+void ParallelUnionIterator::ScheduleReadsUnlocked() {
+  lock_.AssertAcquired();
+  const int max_buffered = max_parallelism_ * kParallelUnionReadAheadPerThread;
+  while (!shutting_down_ && status_.ok() && !idle_.empty() &&
+         num_reading_ < max_parallelism_ &&
+         num_reading_ + ready_.size() < max_buffered) {
+    // Stop reading ahead when over the memory limit, but always keep at
+    // least one batch coming so that the scan makes progress.
+    if (num_reading_ + ready_.size() > 0 && mem_tracker_->AnyLimitExceeded()) {
+      break;
+    }
+    SubIterator* sub = idle_.front();
+    Status s = pool_->SubmitFunc(boost::bind(&ParallelUnionIterator::ReadBatch, this, sub));
+    if (PREDICT_FALSE(!s.ok())) {
+      status_ = s.CloneAndPrepend("Unable to schedule scan");
+      read_done_.Broadcast();
+      return;
+    }
+    idle_.pop_front();
+    num_reading_++;
+  }
+}
+
+void ParallelUnionIterator::ReadBatch(SubIterator* sub) {
+  unique_ptr<Batch> batch(new Batch(*schema_));
+  Status s = sub->iter->NextBlock(&batch->block);
+  bool has_next = s.ok() && sub->iter->HasNext();
+  vector<IteratorStats> stats;
+  sub->iter->GetIteratorStats(&stats);
+
+  MutexLock l(lock_);
+  num_reading_--;
+  sub->stats.swap(stats);
+  if (PREDICT_FALSE(!s.ok())) {
+    if (status_.ok()) {
+      status_ = s;
+    }
+  } else {
+    if (batch->block.nrows() > 0) {
+      batch->memory_consumed = batch->arena.memory_footprint() +
+          kParallelUnionBatchRows * schema_->byte_size();
+      mem_tracker_->Consume(batch->memory_consumed);
+      ready_.emplace_back(std::move(batch));
+    }
+    if (has_next) {
+      idle_.push_back(sub);
+    }
+  }
+  ScheduleReadsUnlocked();
+  read_done_.Broadcast();
+}
+
+void ParallelUnionIterator::WaitForBatchUnlocked() const {
+  lock_.AssertAcquired();
+  while (ready_.empty() && num_reading_ > 0 && status_.ok()) {
+    read_done_.Wait();
+  }
+}
+
+bool ParallelUnionIterator::HasNext() const {
+  CHECK(initted_);
+  MutexLock l(lock_);
+  WaitForBatchUnlocked();
+  // On failure, report that there is more so that NextBlock() returns the error.
+  return !ready_.empty() || !status_.ok();
+}
+
+Status ParallelUnionIterator::NextBlock(RowBlock* dst) {
+  CHECK(initted_);
+  Batch* batch;
+  {
+    MutexLock l(lock_);
+    WaitForBatchUnlocked();
+    RETURN_NOT_OK(status_);
+    CHECK(!ready_.empty()) << "NextBlock() called with no rows remaining";
+    // Sub-iterator reads only ever append to 'ready_', so the front batch
+    // can be copied from without holding the lock.
+    batch = ready_.front().get();
+  }
+
+  const RowBlock& src = batch->block;
+  size_t n = std::min(dst->row_capacity(), src.nrows() - front_rows_returned_);
+  dst->Resize(n);
+  uint8_t* dst_sel = dst->selection_vector()->mutable_bitmap();
+  for (size_t i = 0; i < n; i++) {
+    size_t src_idx = front_rows_returned_ + i;
+    if (!src.selection_vector()->IsRowSelected(src_idx)) {
+      BitmapClear(dst_sel, i);
+      continue;
+    }
+    BitmapSet(dst_sel, i);
+    RowBlockRow dst_row = dst->row(i);
+    RETURN_NOT_OK(CopyRow(src.row(src_idx), &dst_row, dst->arena()));
+  }
+  front_rows_returned_ += n;
+
+  if (front_rows_returned_ == src.nrows()) {
+    unique_ptr<Batch> done;
+    MutexLock l(lock_);
+    done = std::move(ready_.front());
+    ready_.pop_front();
+    front_rows_returned_ = 0;
+    mem_tracker_->Release(done->memory_consumed);
+    ScheduleReadsUnlocked();
+  }
+  return Status::OK();
+}
+
+string ParallelUnionIterator::ToString() const {
+  string s;
+  s.append("ParallelUnion(");
+  bool first = true;
+  for (const unique_ptr<SubIterator>& sub : subs_) {
+    if (!first) {
+      s.append(", ");
+    }
+    first = false;
+    s.append(sub->iter->ToString());
+  }
+  s.append(")");
+  return s;
+}
+
+void ParallelUnionIterator::GetIteratorStats(std::vector<IteratorStats>* stats) const {
+  CHECK(initted_);
+  MutexLock l(lock_);
+  for (size_t idx = 0; idx < schema_->num_columns(); ++idx) {
+    IteratorStats stats_for_col;
+    for (const unique_ptr<SubIterator>& sub : subs_) {
+      stats_for_col.AddStats(sub->stats[idx]);
+    }
+    stats->push_back(stats_for_col);
+  }
+}
+
 ////////////////////////////////////////////////////////////
 // Materializing iterator
 ////////////////////////////////////////////////////////////
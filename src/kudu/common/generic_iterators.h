@@ -27,15 +27,33 @@
 
 #include "kudu/common/iterator.h"
 #include "kudu/common/scan_spec.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/mutex.h"
 #include "kudu/util/object_pool.h"
 
 namespace kudu {
 
 class Arena;
+class EncodedKey;
+class MemTracker;
 class MergeIterState;
+class ThreadPool;
+
+// A sub-iterator of a MergeIterator, along with the smallest encoded key it
+// may return. An empty bound means the iterator may return any key.
+struct IterWithBounds {
+  std::shared_ptr<RowwiseIterator> iter;
+  std::string encoded_lower_bound;
+};
 
 // An iterator which merges the results of other iterators, comparing
 // based on keys.
+//
+// The sub-iterators which may return the next key are kept in a heap. A
+// sub-iterator with a lower bound only starts buffering rows once the merge
+// reaches that bound, so merging many rowsets which overlap little holds few
+// decoded blocks at a time.
 class MergeIterator : public RowwiseIterator {
  public:
   // TODO: clarify whether schema is just the projection, or must include the merge
@@ -43,6 +61,7 @@ class MergeIterator : public RowwiseIterator {
   // a subset of the columns in 'iters'.
   MergeIterator(const Schema &schema,
                 const std::vector<std::shared_ptr<RowwiseIterator> > &iters);
+  MergeIterator(const Schema &schema, std::vector<IterWithBounds> iters);
   virtual ~MergeIterator();
 
   // The passed-in iterators should be already initialized.
@@ -59,18 +78,39 @@ class MergeIterator : public RowwiseIterator {
   virtual Status NextBlock(RowBlock* dst) OVERRIDE;
 
  private:
+  // A sub-iterator which has not buffered any rows yet.
+  struct ColdIter {
+    std::shared_ptr<RowwiseIterator> iter;
+    // The decoded lower bound, or null if the iterator may return any key.
+    std::unique_ptr<EncodedKey> lower_bound;
+  };
+
   void PrepareBatch(RowBlock* dst);
   Status MaterializeBlock(RowBlock* dst);
   Status InitSubIterators(ScanSpec *spec);
 
+  // Move to 'hot_' every cold sub-iterator whose lower bound is not greater
+  // than the next row to be returned, dropping those which turn out empty.
+  // If no sub-iterator is hot, the one with the smallest bound is activated.
+  Status ActivateColdIterators();
+
   const Schema schema_;
 
   bool initted_;
 
   // Holds the subiterators until Init is called.
   // This is required because we can't create a MergeIterState of an uninitialized iterator.
-  std::deque<std::shared_ptr<RowwiseIterator> > orig_iters_;
-  std::vector<std::unique_ptr<MergeIterState> > iters_;
+  std::vector<IterWithBounds> orig_iters_;
+
+  // The sub-iterators with buffered rows, as a heap whose front holds the
+  // smallest next row.
+  std::vector<std::unique_ptr<MergeIterState> > hot_;
+
+  // The sub-iterators yet to be activated, in descending order of lower bound.
+  std::vector<ColdIter> cold_;
+
+  // Holds the decoded lower bounds of 'cold_'.
+  Arena bounds_arena_;
 
   // When the underlying iterators are initialized, each needs its own
   // copy of the scan spec in order to do its own pushdown calculations, etc.
@@ -132,6 +172,93 @@ class UnionIterator : public RowwiseIterator {
   ObjectPool<ScanSpec> scan_spec_copies_;
 };
 
+// An iterator which, like UnionIterator, yields the rows of several iterators
+// in no particular order, but reads up to 'max_parallelism' of them at once on
+// the threads of 'pool'.
+//
+// Each sub-iterator is read by at most one thread at a time. Batches are read
+// ahead of the caller up to a bounded depth, and the memory they hold is
+// accounted to 'mem_tracker'; no further batches are read ahead while any of
+// its limits are exceeded.
+//
+// The passed-in iterators should not yet be initialized, and must be fully
+// able to evaluate all predicates. 'pool' must outlive this iterator.
+class ParallelUnionIterator : public RowwiseIterator {
+ public:
+  ParallelUnionIterator(const std::vector<std::shared_ptr<RowwiseIterator> > &iters,
+                        ThreadPool* pool,
+                        int max_parallelism,
+                        std::shared_ptr<MemTracker> mem_tracker);
+
+  // Waits for any batches still being read.
+  virtual ~ParallelUnionIterator();
+
+  Status Init(ScanSpec *spec) OVERRIDE;
+
+  bool HasNext() const OVERRIDE;
+
+  string ToString() const OVERRIDE;
+
+  const Schema &schema() const OVERRIDE {
+    CHECK(initted_);
+    return *CHECK_NOTNULL(schema_.get());
+  }
+
+  virtual void GetIteratorStats(std::vector<IteratorStats>* stats) const OVERRIDE;
+
+  virtual Status NextBlock(RowBlock* dst) OVERRIDE;
+
+ private:
+  struct SubIterator;
+  struct Batch;
+
+  // Start reading the next batch of idle sub-iterators, as far as the
+  // parallelism, read-ahead and memory bounds allow. 'lock_' must be held.
+  void ScheduleReadsUnlocked();
+
+  // Read the next batch of 'sub'. Runs on a thread of 'pool_'.
+  void ReadBatch(SubIterator* sub);
+
+  // Wait until a batch is ready, all sub-iterators are exhausted, or a read
+  // failed. 'lock_' must be held.
+  void WaitForBatchUnlocked() const;
+
+  gscoped_ptr<Schema> schema_;
+  bool initted_;
+
+  ThreadPool* const pool_;
+  const int max_parallelism_;
+  std::shared_ptr<MemTracker> mem_tracker_;
+
+  std::vector<std::unique_ptr<SubIterator> > subs_;
+
+  // See UnionIterator::scan_spec_copies_.
+  ObjectPool<ScanSpec> scan_spec_copies_;
+
+  // Protects the fields below, as well as the stats of 'subs_'.
+  mutable Mutex lock_;
+  // Signalled when a read finishes.
+  mutable ConditionVariable read_done_;
+
+  // Sub-iterators with more rows which are not currently being read.
+  std::deque<SubIterator*> idle_;
+  int num_reading_;
+
+  // Batches which have been read but not yet returned, in the order they
+  // were read.
+  std::deque<std::unique_ptr<Batch> > ready_;
+
+  // The number of rows of ready_.front() already returned. Only accessed by
+  // the thread calling NextBlock().
+  size_t front_rows_returned_;
+
+  // The first failure to read a batch.
+  Status status_;
+
+  // Set on destruction to stop further reads from being scheduled.
+  bool shutting_down_;
+};
+
 // An iterator which wraps a ColumnwiseIterator, materializing it into full rows.
 //
 // Column predicates are pushed down into this iterator. While materializing a
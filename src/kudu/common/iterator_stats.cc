@@ -28,22 +28,42 @@ using strings::Substitute;
 IteratorStats::IteratorStats()
     : data_blocks_read_from_disk(0),
       bytes_read_from_disk(0),
-      cells_read_from_disk(0) {
+      cells_read_from_disk(0),
+      readahead_hits(0),
+      readahead_misses(0),
+      data_blocks_skipped(0),
+      cells_read_from_memrowset(0),
+      delta_stores_read(0) {
 }
 
 string IteratorStats::ToString() const {
   return Substitute("data_blocks_read_from_disk=$0 "
                     "bytes_read_from_disk=$1 "
-                    "cells_read_from_disk=$2",
+                    "cells_read_from_disk=$2 "
+                    "readahead_hits=$3 "
+                    "readahead_misses=$4 "
+                    "data_blocks_skipped=$5 "
+                    "cells_read_from_memrowset=$6 "
+                    "delta_stores_read=$7",
                     data_blocks_read_from_disk,
                     bytes_read_from_disk,
-                    cells_read_from_disk);
+                    cells_read_from_disk,
+                    readahead_hits,
+                    readahead_misses,
+                    data_blocks_skipped,
+                    cells_read_from_memrowset,
+                    delta_stores_read);
 }
 
 void IteratorStats::AddStats(const IteratorStats& other) {
   data_blocks_read_from_disk += other.data_blocks_read_from_disk;
   bytes_read_from_disk += other.bytes_read_from_disk;
   cells_read_from_disk += other.cells_read_from_disk;
+  readahead_hits += other.readahead_hits;
+  readahead_misses += other.readahead_misses;
+  data_blocks_skipped += other.data_blocks_skipped;
+  cells_read_from_memrowset += other.cells_read_from_memrowset;
+  delta_stores_read += other.delta_stores_read;
   DCheckNonNegative();
 }
 
@@ -51,6 +71,11 @@ void IteratorStats::SubtractStats(const IteratorStats& other) {
   data_blocks_read_from_disk -= other.data_blocks_read_from_disk;
   bytes_read_from_disk -= other.bytes_read_from_disk;
   cells_read_from_disk -= other.cells_read_from_disk;
+  readahead_hits -= other.readahead_hits;
+  readahead_misses -= other.readahead_misses;
+  data_blocks_skipped -= other.data_blocks_skipped;
+  cells_read_from_memrowset -= other.cells_read_from_memrowset;
+  delta_stores_read -= other.delta_stores_read;
   DCheckNonNegative();
 }
 
@@ -58,6 +83,11 @@ void IteratorStats::DCheckNonNegative() const {
   DCHECK_GE(data_blocks_read_from_disk, 0);
   DCHECK_GE(bytes_read_from_disk, 0);
   DCHECK_GE(cells_read_from_disk, 0);
+  DCHECK_GE(readahead_hits, 0);
+  DCHECK_GE(readahead_misses, 0);
+  DCHECK_GE(data_blocks_skipped, 0);
+  DCHECK_GE(cells_read_from_memrowset, 0);
+  DCHECK_GE(delta_stores_read, 0);
 }
 
 
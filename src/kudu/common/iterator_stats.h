@@ -37,6 +37,25 @@ struct IteratorStats {
   // they were decoded/materialized.
   int64_t cells_read_from_disk;
 
+  // The number of data blocks which had already been read ahead in the
+  // background by the time the iterator needed them.
+  int64_t readahead_hits;
+
+  // The number of data blocks which were read on demand while the iterator
+  // was reading ahead, because they had not been prefetched.
+  int64_t readahead_misses;
+
+  // The number of data blocks which were passed over without being read,
+  // because none of their rows were selected.
+  int64_t data_blocks_skipped;
+
+  // The number of cells which were read from MemRowSets.
+  int64_t cells_read_from_memrowset;
+
+  // The number of delta stores whose updates were applied to the column, as
+  // counted by the rowsets scanned so far.
+  int64_t delta_stores_read;
+
   // Add statistics contained 'other' to this object (for each field
   // in this object, increment it by the value of the equivalent field
   // in 'other').
@@ -151,37 +151,38 @@ struct KeyEncoderTraits<BINARY, Buffer> {
       int len = s.size();
       int rem = len;
 
+      // Chunks with '\0' bytes are escaped one byte at a time, going back to
+      // the fast path for the next chunk, so that a few '\0' bytes don't
+      // slow down the encoding of the rest of the slice.
+      bool last_chunk_escaped = false;
       while (rem >= 16) {
-        if (!SSEEncodeChunk<16>(&srcp, &dstp)) {
-          goto slow_path;
+        last_chunk_escaped = !SSEEncodeChunk<16>(&srcp, &dstp);
+        if (last_chunk_escaped) {
+          EncodeChunkLoop(&srcp, &dstp, 16);
         }
         rem -= 16;
       }
       while (rem >= 8) {
-        if (!SSEEncodeChunk<8>(&srcp, &dstp)) {
-          goto slow_path;
+        last_chunk_escaped = !SSEEncodeChunk<8>(&srcp, &dstp);
+        if (last_chunk_escaped) {
+          EncodeChunkLoop(&srcp, &dstp, 8);
         }
         rem -= 8;
       }
-      // Roll back to operate in 8 bytes at a time.
-      if (len > 8 && rem > 0) {
+      // Roll back to operate in 8 bytes at a time. This re-encodes the tail
+      // of the last chunk, which is only possible if it was copied as is.
+      if (len > 8 && rem > 0 && !last_chunk_escaped) {
         dstp -= 8 - rem;
         srcp -= 8 - rem;
         if (!SSEEncodeChunk<8>(&srcp, &dstp)) {
-          // TODO: optimize for the case where the input slice has '\0'
-          // bytes. (e.g. move the pointer to the first zero byte.)
           dstp += 8 - rem;
           srcp += 8 - rem;
-          goto slow_path;
+          EncodeChunkLoop(&srcp, &dstp, rem);
         }
-        rem = 0;
-        goto done;
+      } else {
+        EncodeChunkLoop(&srcp, &dstp, rem);
       }
 
-      slow_path:
-      EncodeChunkLoop(&srcp, &dstp, rem);
-
-      done:
       *dstp++ = 0;
       *dstp++ = 0;
       dst->resize(dstp - reinterpret_cast<uint8_t*>(&(*dst)[0]));
@@ -166,6 +166,21 @@ int PushUpperBoundKeyPredicates(ColIdxIter first,
       // to the remaining columns (below), which is the maximally tight
       // constraint.
       break;
+    } else if (predicate->predicate_type() == PredicateType::InList) {
+      // The IN list values are sorted, so the last value is an inclusive
+      // upper bound on the column, which can be treated like an equality.
+      memcpy(row->mutable_cell_ptr(*col_idx_it), predicate->raw_values().back(), size);
+      pushed_predicates++;
+      final_predicate = predicate;
+    } else if (predicate->predicate_type() == PredicateType::InBloomFilter) {
+      // Only the bounds of a bloom filter predicate constrain the key, like
+      // those of a range predicate.
+      if (predicate->raw_upper() != nullptr) {
+        memcpy(row->mutable_cell_ptr(*col_idx_it), predicate->raw_upper(), size);
+        pushed_predicates++;
+        final_predicate = predicate;
+      }
+      break;
     } else {
       LOG(FATAL) << "unexpected predicate type can not be pushed into key";
     }
@@ -174,9 +189,10 @@ int PushUpperBoundKeyPredicates(ColIdxIter first,
   // If no predicates were pushed, no need to do any more work.
   if (pushed_predicates == 0) { return 0; }
 
-  // Step 2: If the final predicate is an equality predicate, increment the
-  // key to convert it to an exclusive upper bound.
-  if (final_predicate->predicate_type() == PredicateType::Equality) {
+  // Step 2: If the final predicate is an equality or IN list predicate,
+  // increment the key to convert it to an exclusive upper bound.
+  if (final_predicate->predicate_type() == PredicateType::Equality ||
+      final_predicate->predicate_type() == PredicateType::InList) {
     if (!IncrementKey(first, std::next(first, pushed_predicates), row, arena)) {
       // If the increment fails then this bound is is not constraining the keyspace.
       return 0;
@@ -215,6 +231,20 @@ int PushLowerBoundKeyPredicates(ColIdxIter first,
       } else {
         break;
       }
+    } else if (predicate->predicate_type() == PredicateType::InList) {
+      // The IN list values are sorted, so the first value is an inclusive
+      // lower bound on the column.
+      memcpy(row->mutable_cell_ptr(*col_idx_it), predicate->raw_values().front(), size);
+      pushed_predicates++;
+    } else if (predicate->predicate_type() == PredicateType::InBloomFilter) {
+      // Only the lower bound of a bloom filter predicate constrains the key,
+      // like that of a range predicate.
+      if (predicate->raw_lower() != nullptr) {
+        memcpy(row->mutable_cell_ptr(*col_idx_it), predicate->raw_lower(), size);
+        pushed_predicates++;
+      } else {
+        break;
+      }
     } else {
       LOG(FATAL) << "unexpected predicate type can not be pushed into key";
     }
@@ -304,4 +304,53 @@ TEST_F(PartialRowTest, TestSetString) {
       2, COPY);
 }
 
+TEST_F(PartialRowTest, TestDecimal) {
+  Schema schema({ ColumnSchema("key", DECIMAL32, false, nullptr, nullptr,
+                               ColumnStorageAttributes(), ColumnTypeAttributes(5, 2)),
+                  ColumnSchema("val", DECIMAL64, true, nullptr, nullptr,
+                               ColumnStorageAttributes(), ColumnTypeAttributes(18, 4)) },
+                1);
+  KuduPartialRow row(&schema);
+
+  // Values are set and got unscaled, and printed with their scale.
+  ASSERT_OK(row.SetUnscaledDecimal("key", -12345));
+  ASSERT_OK(row.SetUnscaledDecimal(1, 999999999999999999LL));
+  int64_t val;
+  ASSERT_OK(row.GetUnscaledDecimal("key", &val));
+  ASSERT_EQ(-12345, val);
+  ASSERT_OK(row.GetUnscaledDecimal(1, &val));
+  ASSERT_EQ(999999999999999999LL, val);
+  ASSERT_EQ("decimal32 key=-123.45, decimal64 val=99999999999999.9999", row.ToString());
+  string enc_key;
+  ASSERT_OK(row.EncodeRowKey(&enc_key));
+
+  // Values with more digits than the precision are rejected.
+  Status s = row.SetUnscaledDecimal("key", 100000);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  s = row.SetUnscaledDecimal("key", -100000);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+
+  // So are the other types' setters and getters.
+  s = row.SetInt32("key", 1);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  int32_t i32;
+  s = row.GetInt32("key", &i32);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  s = KuduPartialRow(&schema_).SetUnscaledDecimal("key", 1);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+
+  // Schemas with invalid precisions or scales are rejected.
+  Schema bad_schema;
+  s = bad_schema.Reset({ ColumnSchema("key", DECIMAL32, false, nullptr, nullptr,
+                                      ColumnStorageAttributes(), ColumnTypeAttributes(10, 2)) },
+                       1);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  s = bad_schema.Reset({ ColumnSchema("key", DECIMAL64, false, nullptr, nullptr,
+                                      ColumnStorageAttributes(), ColumnTypeAttributes(10, 11)) },
+                       1);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  s = bad_schema.Reset({ ColumnSchema("key", DECIMAL64) }, 1);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+}
+
 } // namespace kudu
@@ -37,6 +37,7 @@
 namespace kudu {
 class ColumnSchema;
 namespace client {
+class KuduScanner;
 class KuduWriteOperation;
 template<typename KeyTypeWrapper> struct SliceKeysTestSetup;
 template<typename KeyTypeWrapper> struct IntKeysTestSetup;
@@ -124,6 +125,25 @@ class KUDU_EXPORT KuduPartialRow {
   Status SetDouble(int col_idx, double val) WARN_UNUSED_RESULT;
   ///@}
 
+  /// @name Setters for decimal columns.
+  ///
+  /// Set the value of a decimal column by name or index, as its unscaled
+  /// value: for example, 12.34 in a column with a scale of 2 is set as 1234.
+  ///
+  /// @param [in] col_name
+  ///   Name of the target column.
+  /// @param [in] col_idx
+  ///   The index of the target column.
+  /// @param [in] val
+  ///   The unscaled value to set. It must have no more digits than the
+  ///   precision of the column.
+  /// @return Operation result status.
+  ///
+  ///@{
+  Status SetUnscaledDecimal(const Slice& col_name, int64_t val) WARN_UNUSED_RESULT;
+  Status SetUnscaledDecimal(int col_idx, int64_t val) WARN_UNUSED_RESULT;
+  ///@}
+
   /// @name Setters for binary/string columns by name (copying).
   ///
   /// Set the binary/string value for a column by name, copying the specified
@@ -375,6 +395,21 @@ class KUDU_EXPORT KuduPartialRow {
   Status GetDouble(int col_idx, double* val) const WARN_UNUSED_RESULT;
   ///@}
 
+  /// @name Getters for decimal columns.
+  ///
+  /// Get the unscaled value of a decimal column by name or index.
+  ///
+  /// @return Operation result status. Return a bad Status if at least one
+  ///   of the following is @c true:
+  ///     @li The column is not a decimal.
+  ///     @li The value is unset.
+  ///     @li The value is @c NULL.
+  ///
+  ///@{
+  Status GetUnscaledDecimal(const Slice& col_name, int64_t* val) const WARN_UNUSED_RESULT;
+  Status GetUnscaledDecimal(int col_idx, int64_t* val) const WARN_UNUSED_RESULT;
+  ///@}
+
   /// @name Getters for string/binary column by column name.
   ///
   /// Get the string/binary value for a column by its name.
@@ -464,6 +499,7 @@ class KUDU_EXPORT KuduPartialRow {
   const Schema* schema() const { return schema_; }
 
  private:
+  friend class client::KuduScanner;          // for Set() of aggregate results.
   friend class client::KuduWriteOperation;   // for row_data_.
   friend class KeyUtilTest;
   friend class PartitionSchema;
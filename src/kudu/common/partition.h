@@ -205,6 +205,11 @@ class PartitionSchema {
   // Returns true if the other partition schema is equivalent to this one.
   bool Equals(const PartitionSchema& other) const;
 
+  // Returns the IDs of the range partition columns, in order.
+  const std::vector<ColumnId>& range_column_ids() const {
+    return range_schema_.column_ids;
+  }
+
   // Transforms an exclusive lower bound range partition key into an inclusive
   // lower bound range partition key.
   Status MakeLowerBoundRangePartitionKeyInclusive(KuduPartialRow* row) const;
@@ -433,6 +433,24 @@ TEST(TestPartitionPruner, TestRangePruning) {
   Check({ ColumnPredicate::Equality(schema.column(2), &zero),
           ColumnPredicate::Range(schema.column(1), nullptr, &m0) },
         2);
+
+  // c IN (5, 100)
+  vector<const void*> five_hundred = { &five, &hundred };
+  Check({ ColumnPredicate::InList(schema.column(2), &five_hundred) }, 2);
+
+  // c IN (-10, 0)
+  // b < "m"
+  vector<const void*> neg_ten_zero = { &neg_ten, &zero };
+  Check({ ColumnPredicate::InList(schema.column(2), &neg_ten_zero),
+          ColumnPredicate::Range(schema.column(1), nullptr, &m) },
+        1);
+
+  // c IN (0, 5)
+  // b < "m"
+  vector<const void*> zero_five = { &zero, &five };
+  Check({ ColumnPredicate::InList(schema.column(2), &zero_five),
+          ColumnPredicate::Range(schema.column(1), nullptr, &m) },
+        2);
 }
 
 TEST(TestPartitionPruner, TestHashPruning) {
@@ -479,6 +497,7 @@ TEST(TestPartitionPruner, TestHashPruning) {
   int8_t zero = 0;
   int8_t one = 1;
   int8_t two = 2;
+  int8_t three = 3;
 
   // No Bounds
   Check({}, 4);
@@ -495,7 +514,12 @@ TEST(TestPartitionPruner, TestHashPruning) {
 
   // a >= 0;
   // a < 2;
-  Check({ ColumnPredicate::Range(schema.column(0), &zero, &two) }, 4);
+  // Both values hash to the same bucket.
+  Check({ ColumnPredicate::Range(schema.column(0), &zero, &two) }, 2);
+
+  // a >= 0;
+  // a < 3;
+  Check({ ColumnPredicate::Range(schema.column(0), &zero, &three) }, 4);
 
   // b = 1;
   Check({ ColumnPredicate::Equality(schema.column(1), &one) }, 4);
@@ -515,6 +539,213 @@ TEST(TestPartitionPruner, TestHashPruning) {
         1);
 }
 
+TEST(TestPartitionPruner, TestInListHashPruning) {
+  // CREATE TABLE t
+  // (a INT8, b INT8, c INT8)
+  // PRIMARY KEY (a, b, c)
+  // DISTRIBUTE BY HASH(a) INTO 4 BUCKETS,
+  //               HASH(b, c) INTO 4 BUCKETS;
+  Schema schema({ ColumnSchema("a", INT8),
+                  ColumnSchema("b", INT8),
+                  ColumnSchema("c", INT8) },
+                { ColumnId(0), ColumnId(1), ColumnId(2) },
+                3);
+
+  PartitionSchema partition_schema;
+  auto pb = PartitionSchemaPB();
+  pb.mutable_range_schema()->Clear();
+  auto hash_component_1 = pb.add_hash_bucket_schemas();
+  hash_component_1->add_columns()->set_name("a");
+  hash_component_1->set_num_buckets(4);
+  auto hash_component_2 = pb.add_hash_bucket_schemas();
+  hash_component_2->add_columns()->set_name("b");
+  hash_component_2->add_columns()->set_name("c");
+  hash_component_2->set_num_buckets(4);
+
+  ASSERT_OK(PartitionSchema::FromPB(pb, schema, &partition_schema));
+
+  vector<Partition> partitions;
+  ASSERT_OK(partition_schema.CreatePartitions(vector<KuduPartialRow>(), {}, schema, &partitions));
+
+  // Returns the set of partitions which are not pruned by the predicates.
+  auto Remaining = [&] (const vector<ColumnPredicate>& predicates) {
+    ScanSpec spec;
+    for (const auto& pred : predicates) {
+      spec.AddPredicate(pred);
+    }
+    PartitionPruner pruner;
+    pruner.Init(schema, partition_schema, spec);
+    vector<bool> remaining;
+    for (const auto& partition : partitions) {
+      remaining.push_back(!pruner.ShouldPrune(partition));
+    }
+    return remaining;
+  };
+
+  // Checks that the partitions remaining after pruning with an IN list on
+  // 'in_column' are exactly the union of the partitions remaining after
+  // pruning with an equality predicate on each of the IN list values.
+  auto Check = [&] (int in_column,
+                    vector<int8_t> values,
+                    const vector<ColumnPredicate>& other_predicates) {
+    vector<bool> expected(partitions.size(), false);
+    for (const int8_t& value : values) {
+      vector<ColumnPredicate> predicates = other_predicates;
+      predicates.push_back(ColumnPredicate::Equality(schema.column(in_column), &value));
+      vector<bool> remaining = Remaining(predicates);
+      for (int i = 0; i < partitions.size(); i++) {
+        expected[i] = expected[i] || remaining[i];
+      }
+    }
+
+    vector<const void*> value_ptrs;
+    for (const int8_t& value : values) {
+      value_ptrs.push_back(&value);
+    }
+    vector<ColumnPredicate> predicates = other_predicates;
+    predicates.push_back(ColumnPredicate::InList(schema.column(in_column), &value_ptrs));
+    ASSERT_EQ(expected, Remaining(predicates));
+  };
+
+  int8_t zero = 0;
+  int8_t one = 1;
+
+  // a IN (0, 1, 2)
+  Check(0, { 0, 1, 2 }, {});
+
+  // a IN (0, 1, 2, 3, 4, 5, 6, 7)
+  Check(0, { 0, 1, 2, 3, 4, 5, 6, 7 }, {});
+
+  // a = 0
+  // b IN (0, 1, 2)
+  Check(1, { 0, 1, 2 }, { ColumnPredicate::Equality(schema.column(0), &zero) });
+
+  // b IN (0, 1, 2)
+  // c = 1
+  Check(1, { 0, 1, 2 }, { ColumnPredicate::Equality(schema.column(2), &one) });
+
+  // a = 0
+  // b = 1
+  // c IN (0, 1, 2, 3)
+  Check(2, { 0, 1, 2, 3 }, { ColumnPredicate::Equality(schema.column(0), &zero),
+                             ColumnPredicate::Equality(schema.column(1), &one) });
+
+  // a IN (0, 1)
+  // b = 0
+  // c = 1
+  Check(0, { 0, 1 }, { ColumnPredicate::Equality(schema.column(1), &zero),
+                       ColumnPredicate::Equality(schema.column(2), &one) });
+}
+
+TEST(TestPartitionPruner, TestRangeHashPruning) {
+  // CREATE TABLE t
+  // (a INT8, b INT8, c INT8)
+  // PRIMARY KEY (a, b, c)
+  // DISTRIBUTE BY HASH(a) INTO 4 BUCKETS,
+  //               HASH(b, c) INTO 4 BUCKETS;
+  Schema schema({ ColumnSchema("a", INT8),
+                  ColumnSchema("b", INT8),
+                  ColumnSchema("c", INT8) },
+                { ColumnId(0), ColumnId(1), ColumnId(2) },
+                3);
+
+  PartitionSchema partition_schema;
+  auto pb = PartitionSchemaPB();
+  pb.mutable_range_schema()->Clear();
+  auto hash_component_1 = pb.add_hash_bucket_schemas();
+  hash_component_1->add_columns()->set_name("a");
+  hash_component_1->set_num_buckets(4);
+  auto hash_component_2 = pb.add_hash_bucket_schemas();
+  hash_component_2->add_columns()->set_name("b");
+  hash_component_2->add_columns()->set_name("c");
+  hash_component_2->set_num_buckets(4);
+
+  ASSERT_OK(PartitionSchema::FromPB(pb, schema, &partition_schema));
+
+  vector<Partition> partitions;
+  ASSERT_OK(partition_schema.CreatePartitions(vector<KuduPartialRow>(), {}, schema, &partitions));
+
+  // Returns the set of partitions which are not pruned by the predicates.
+  auto Remaining = [&] (const vector<ColumnPredicate>& predicates) {
+    ScanSpec spec;
+    for (const auto& pred : predicates) {
+      spec.AddPredicate(pred);
+    }
+    PartitionPruner pruner;
+    pruner.Init(schema, partition_schema, spec);
+    vector<bool> remaining;
+    for (const auto& partition : partitions) {
+      remaining.push_back(!pruner.ShouldPrune(partition));
+    }
+    return remaining;
+  };
+
+  // Checks that the partitions remaining after pruning with a range
+  // predicate [lower, upper) on 'range_column' are exactly those remaining
+  // after pruning with an IN list of every value in the range.
+  auto Check = [&] (int range_column,
+                    int8_t lower,
+                    int8_t upper,
+                    const vector<ColumnPredicate>& other_predicates) {
+    vector<int8_t> values;
+    for (int value = lower; value < upper; value++) {
+      values.push_back(value);
+    }
+    vector<const void*> value_ptrs;
+    for (const int8_t& value : values) {
+      value_ptrs.push_back(&value);
+    }
+    vector<ColumnPredicate> in_list_predicates = other_predicates;
+    in_list_predicates.push_back(ColumnPredicate::InList(schema.column(range_column),
+                                                         &value_ptrs));
+
+    vector<ColumnPredicate> range_predicates = other_predicates;
+    range_predicates.push_back(ColumnPredicate::Range(schema.column(range_column),
+                                                      &lower, &upper));
+    ASSERT_EQ(Remaining(in_list_predicates), Remaining(range_predicates));
+  };
+
+  int8_t zero = 0;
+  int8_t one = 1;
+
+  // a >= 0
+  // a < 3
+  Check(0, 0, 3, {});
+
+  // a >= -100
+  // a < 100
+  Check(0, -100, 100, {});
+
+  // a = 0
+  // b >= 0
+  // b < 3
+  Check(1, 0, 3, { ColumnPredicate::Equality(schema.column(0), &zero) });
+
+  // b >= 0
+  // b < 2
+  // c = 1
+  Check(1, 0, 2, { ColumnPredicate::Equality(schema.column(2), &one) });
+
+  // b IN (0, 1)
+  // c >= 0
+  // c < 3
+  int8_t values[] = { 0, 1 };
+  vector<const void*> value_ptrs = { &values[0], &values[1] };
+  Check(2, 0, 3, { ColumnPredicate::InList(schema.column(1), &value_ptrs) });
+
+  // Ranges with more combinations of values than are hashed leave the
+  // component unconstrained.
+  // b >= -100
+  // b < 100
+  // c >= -100
+  // c < 100
+  int8_t lower = -100;
+  int8_t upper = 100;
+  vector<bool> all(partitions.size(), true);
+  ASSERT_EQ(all, Remaining({ ColumnPredicate::Range(schema.column(1), &lower, &upper),
+                             ColumnPredicate::Range(schema.column(2), &lower, &upper) }));
+}
+
 TEST(TestPartitionPruner, TestPruning) {
   // CREATE TABLE timeseries
   // (host STRING, metric STRING, time UNIXTIME_MICROS, value DOUBLE)
@@ -18,7 +18,6 @@
 #include "kudu/common/partition_pruner.h"
 
 #include <algorithm>
-#include <boost/optional.hpp>
 #include <cstring>
 #include <memory>
 #include <numeric>
@@ -32,11 +31,11 @@
 #include "kudu/common/partition.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/common/schema.h"
+#include "kudu/common/types.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/substitute.h"
 
-using boost::optional;
 using std::distance;
 using std::find;
 using std::get;
@@ -55,6 +54,59 @@ using std::vector;
 namespace kudu {
 namespace {
 
+// The maximum number of combinations of IN list values which will be hashed
+// in order to prune the buckets of a multi-column hash component. Beyond this,
+// the component is treated as unconstrained.
+const int kMaxHashPruningCombinations = 4096;
+
+// Appends the values in [lower, upper) of an integer range predicate to
+// 'storage', unless there are more than 'max_values' of them. Returns whether
+// the values were appended.
+template<DataType Type>
+bool EnumerateRangeValues(const ColumnPredicate& predicate,
+                          size_t max_values,
+                          string* storage) {
+  typedef typename DataTypeTraits<Type>::cpp_type T;
+  T lower = *static_cast<const T*>(predicate.raw_lower());
+  T upper = *static_cast<const T*>(predicate.raw_upper());
+  // The difference can't overflow when computed in unsigned arithmetic.
+  uint64_t num_values = static_cast<uint64_t>(upper) - static_cast<uint64_t>(lower);
+  if (num_values > max_values) {
+    return false;
+  }
+  storage->reserve(num_values * sizeof(T));
+  for (T value = lower; value < upper; value++) {
+    storage->append(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+  return true;
+}
+
+// Sets 'values' to the values of a bounded range predicate on an integer
+// column, stored in 'storage', if there are at most 'max_values' of them.
+void EnumerateRangePredicate(const ColumnPredicate& predicate,
+                             size_t max_values,
+                             string* storage,
+                             vector<const void*>* values) {
+  if (predicate.raw_lower() == nullptr || predicate.raw_upper() == nullptr) {
+    return;
+  }
+  const TypeInfo* type_info = predicate.column().type_info();
+  bool enumerated;
+  switch (type_info->physical_type()) {
+    case INT8: enumerated = EnumerateRangeValues<INT8>(predicate, max_values, storage); break;
+    case INT16: enumerated = EnumerateRangeValues<INT16>(predicate, max_values, storage); break;
+    case INT32: enumerated = EnumerateRangeValues<INT32>(predicate, max_values, storage); break;
+    case INT64: enumerated = EnumerateRangeValues<INT64>(predicate, max_values, storage); break;
+    default: return;
+  }
+  if (!enumerated) {
+    return;
+  }
+  for (size_t offset = 0; offset < storage->size(); offset += type_info->size()) {
+    values->push_back(storage->data() + offset);
+  }
+}
+
 // Returns true if the partition schema's range columns are a prefix of the
 // primary key columns.
 bool AreRangeColumnsPrefixOfPrimaryKey(const Schema& schema,
@@ -220,7 +272,10 @@ void PartitionPruner::Init(const Schema& schema,
   // 3) The number of partition key ranges in the result is equal to the product
   //    of the number of buckets of each unconstrained hash component which come
   //    before a final constrained component. If there are no unconstrained hash
-  //    components, then the number of partition key ranges is one.
+  //    components, then the number of partition key ranges is one. Ranges
+  //    which end where the next one begins are then merged, e.g. an IN list on
+  //    a whose values hash to buckets 0 and 1 results in the single range
+  //    [(bucket=0), (bucket=2)).
 
   // Step 1: Build the range portion of the partition key.
   string range_lower_bound;
@@ -244,33 +299,72 @@ void PartitionPruner::Init(const Schema& schema,
 
   // Step 2: Create the hash bucket portion of the partition key.
 
-  // The list of hash buckets per hash component, or none if the component is
-  // not constrained.
-  vector<optional<uint32_t>> hash_buckets;
+  // The list of possible hash buckets per hash component, in ascending order,
+  // or empty if the component is not constrained.
+  vector<vector<uint32_t>> hash_buckets;
   hash_buckets.reserve(partition_schema.hash_bucket_schemas_.size());
   for (int hash_idx = 0; hash_idx < partition_schema.hash_bucket_schemas_.size(); hash_idx++) {
     const auto& hash_bucket_schema = partition_schema.hash_bucket_schemas_[hash_idx];
-    string encoded_columns;
+
+    // The encoded hash columns of every combination of predicate values on
+    // the hash component's columns. A column constrained by an equality
+    // predicate contributes a single value, a column constrained by an IN
+    // list contributes one value per list element, and an integer column
+    // constrained by a small enough bounded range contributes every value in
+    // the range.
+    vector<string> encoded_columns(1);
     bool can_prune = true;
     for (int col_offset = 0; col_offset < hash_bucket_schema.column_ids.size(); col_offset++) {
       const ColumnSchema& column = schema.column_by_id(hash_bucket_schema.column_ids[col_offset]);
       const ColumnPredicate* predicate = FindOrNull(scan_spec.predicates(), column.name());
-      if (predicate == nullptr || predicate->predicate_type() != PredicateType::Equality) {
+      vector<const void*> values;
+      string range_values;
+      if (predicate != nullptr && predicate->predicate_type() == PredicateType::Equality) {
+        values.push_back(predicate->raw_lower());
+      } else if (predicate != nullptr && predicate->predicate_type() == PredicateType::InList) {
+        values = predicate->raw_values();
+      } else if (predicate != nullptr && predicate->predicate_type() == PredicateType::Range) {
+        EnumerateRangePredicate(*predicate,
+                                kMaxHashPruningCombinations / encoded_columns.size(),
+                                &range_values,
+                                &values);
+      }
+      if (values.empty() ||
+          encoded_columns.size() * values.size() > kMaxHashPruningCombinations) {
         can_prune = false;
         break;
       }
 
       const KeyEncoder<string>& encoder = GetKeyEncoder<string>(column.type_info());
-      encoder.Encode(predicate->raw_lower(),
-                     col_offset + 1 == hash_bucket_schema.column_ids.size(),
-                     &encoded_columns);
+      bool is_last = col_offset + 1 == hash_bucket_schema.column_ids.size();
+      vector<string> new_encoded_columns;
+      new_encoded_columns.reserve(encoded_columns.size() * values.size());
+      for (const string& prefix : encoded_columns) {
+        for (const void* value : values) {
+          string encoded = prefix;
+          encoder.Encode(value, is_last, &encoded);
+          new_encoded_columns.push_back(move(encoded));
+        }
+      }
+      encoded_columns.swap(new_encoded_columns);
     }
+
+    vector<uint32_t> buckets;
     if (can_prune) {
-      hash_buckets.push_back(partition_schema.BucketForEncodedColumns(encoded_columns,
-                                                                      hash_bucket_schema));
-    } else {
-      hash_buckets.push_back(boost::none);
+      vector<bool> bucket_selected(hash_bucket_schema.num_buckets, false);
+      for (const string& encoded : encoded_columns) {
+        bucket_selected[partition_schema.BucketForEncodedColumns(encoded, hash_bucket_schema)] =
+            true;
+      }
+      for (uint32_t bucket = 0; bucket < hash_bucket_schema.num_buckets; bucket++) {
+        if (bucket_selected[bucket]) buckets.push_back(bucket);
+      }
+      // If every bucket is possible then the component is not constrained.
+      if (buckets.size() == hash_bucket_schema.num_buckets) {
+        buckets.clear();
+      }
     }
+    hash_buckets.push_back(move(buckets));
   }
 
   // The index of the final constrained component in the partition key.
@@ -285,17 +379,20 @@ void PartitionPruner::Init(const Schema& schema,
                         distance(hash_buckets.rbegin(),
                                  find_if(hash_buckets.rbegin(),
                                          hash_buckets.rend(),
-                                         [] (const optional<uint32_t>& x) { return x; }));
+                                         [] (const vector<uint32_t>& x) { return !x.empty(); }));
   }
 
   // Build up a set of partition key ranges out of the hash components.
   //
-  // Each constrained hash component simply appends its bucket number to the
-  // partition key ranges (possibly incrementing the upper bound by one bucket
-  // number if this is the final constraint, see note 2 in the example above).
+  // Each hash component constrained to a single bucket simply appends its
+  // bucket number to the partition key ranges (possibly incrementing the
+  // upper bound by one bucket number if this is the final constraint, see
+  // note 2 in the example above).
   //
-  // Each unconstrained hash component results in creating a new partition key
-  // range for each bucket of the hash component.
+  // Each hash component constrained to multiple buckets by IN list predicates
+  // results in creating a new partition key range for each of those buckets,
+  // and each unconstrained hash component results in creating a new
+  // partition key range for each bucket of the hash component.
   vector<tuple<string, string>> partition_key_ranges(1);
   const KeyEncoder<string>& hash_encoder = GetKeyEncoder<string>(GetTypeInfo(UINT32));
   for (int hash_idx = 0; hash_idx < constrained_index; hash_idx++) {
@@ -305,10 +402,10 @@ void PartitionPruner::Init(const Schema& schema,
     // exclusive.
     bool is_last = hash_idx + 1 == constrained_index && range_upper_bound.empty();
 
-    if (hash_buckets[hash_idx]) {
+    if (hash_buckets[hash_idx].size() == 1) {
       // This hash component is constrained by equality predicates to a single
       // hash bucket.
-      uint32_t bucket = *hash_buckets[hash_idx];
+      uint32_t bucket = hash_buckets[hash_idx][0];
       uint32_t bucket_upper = is_last ? bucket + 1 : bucket;
       for (auto& partition_key_range : partition_key_ranges) {
         hash_encoder.Encode(&bucket, &get<0>(partition_key_range));
@@ -316,10 +413,16 @@ void PartitionPruner::Init(const Schema& schema,
       }
     } else {
       const auto& hash_bucket_schema = partition_schema.hash_bucket_schemas_[hash_idx];
+      vector<uint32_t> buckets = hash_buckets[hash_idx];
+      if (buckets.empty()) {
+        buckets.resize(hash_bucket_schema.num_buckets);
+        iota(buckets.begin(), buckets.end(), 0);
+      }
       // Add a partition key range for each possible hash bucket.
       vector<tuple<string, string>> new_partition_key_ranges;
+      new_partition_key_ranges.reserve(partition_key_ranges.size() * buckets.size());
       for (const auto& partition_key_range : partition_key_ranges) {
-        for (uint32_t bucket = 0; bucket < hash_bucket_schema.num_buckets; bucket++) {
+        for (uint32_t bucket : buckets) {
           uint32_t bucket_upper = is_last ? bucket + 1 : bucket;
           string lower = get<0>(partition_key_range);
           string upper = get<1>(partition_key_range);
@@ -338,6 +441,22 @@ void PartitionPruner::Init(const Schema& schema,
     get<1>(range).append(range_upper_bound);
   }
 
+  // Coalesce adjacent partition key ranges, such as those of consecutive
+  // buckets of the final constrained hash component, so that the scan looks
+  // up as few ranges as possible. The ranges are in ascending order.
+  if (partition_key_ranges.size() > 1) {
+    size_t merged = 0;
+    for (size_t i = 1; i < partition_key_ranges.size(); i++) {
+      string& upper = get<1>(partition_key_ranges[merged]);
+      if (!upper.empty() && upper == get<0>(partition_key_ranges[i])) {
+        upper = move(get<1>(partition_key_ranges[i]));
+      } else {
+        partition_key_ranges[++merged] = move(partition_key_ranges[i]);
+      }
+    }
+    partition_key_ranges.resize(merged + 1);
+  }
+
   // Step 4: remove all partition key ranges past the scan spec's upper bound partition key.
   if (!scan_spec.exclusive_upper_bound_partition_key().empty()) {
     for (auto range = partition_key_ranges.rbegin();
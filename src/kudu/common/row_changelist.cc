@@ -15,8 +15,11 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <limits>
 #include <string>
 
+#include <gflags/gflags.h>
+
 #include "kudu/common/columnblock.h"
 #include "kudu/common/row.h"
 #include "kudu/common/rowblock.h"
@@ -26,12 +29,86 @@
 #include "kudu/util/coding.h"
 #include "kudu/util/coding-inl.h"
 #include "kudu/util/faststring.h"
+#include "kudu/util/flag_tags.h"
+
+DEFINE_bool(rowchangelist_compact_encoding, false,
+            "Whether to encode updates in the compact changelist format, which "
+            "varint-encodes integer values. Versions which predate this format "
+            "reject the changelists written in it, e.g. in WAL entries and delta "
+            "files, so enabling it rules out downgrades, and breaks tablet copies "
+            "and replication to servers running older versions. Only enable it "
+            "once every server of the cluster has been upgraded.");
+TAG_FLAG(rowchangelist_compact_encoding, advanced);
+TAG_FLAG(rowchangelist_compact_encoding, experimental);
 
 using strings::Substitute;
 using strings::SubstituteAndAppend;
 
 namespace kudu {
 
+namespace {
+
+const int kCompactKindBits = 3;
+
+uint64_t ZigZagEncode(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t ZigZagDecode(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Returns the width in bytes of the integers of the given kind, or 0 if the
+// kind isn't an integer one.
+size_t CompactIntWidth(RowChangeList::CompactValueKind kind) {
+  switch (kind) {
+    case RowChangeList::kCompactInt8: return 1;
+    case RowChangeList::kCompactInt16: return 2;
+    case RowChangeList::kCompactInt32: return 4;
+    case RowChangeList::kCompactInt64: return 8;
+    default: return 0;
+  }
+}
+
+// Appends the compact encoding of the update SET [col_id] = 'new_val' (or
+// NULL, if 'is_null') to 'dst'.
+void PutCompactColumnUpdate(faststring* dst, int col_id, bool is_null, const Slice& new_val) {
+  uint64_t header = static_cast<uint64_t>(col_id) << kCompactKindBits;
+  if (is_null) {
+    PutVarint64(dst, header | RowChangeList::kCompactNull);
+    return;
+  }
+
+  // Values which could be integers are encoded as such when that isn't
+  // larger, whatever their type: the encoding round-trips their bytes.
+  RowChangeList::CompactValueKind int_kind;
+  switch (new_val.size()) {
+    case 1: int_kind = RowChangeList::kCompactInt8; break;
+    case 2: int_kind = RowChangeList::kCompactInt16; break;
+    case 4: int_kind = RowChangeList::kCompactInt32; break;
+    case 8: int_kind = RowChangeList::kCompactInt64; break;
+    default: int_kind = RowChangeList::kCompactRaw; break;
+  }
+  if (int_kind != RowChangeList::kCompactRaw) {
+    uint64_t bits = 0;
+    memcpy(&bits, new_val.data(), new_val.size());
+    // Sign-extend from the width of the value.
+    int shift = 64 - 8 * new_val.size();
+    int64_t value = static_cast<int64_t>(bits << shift) >> shift;
+    uint64_t zigzag = ZigZagEncode(value);
+    if (VarintLength(zigzag) <= static_cast<int>(new_val.size())) {
+      PutVarint64(dst, header | int_kind);
+      PutVarint64(dst, zigzag);
+      return;
+    }
+  }
+  PutVarint64(dst, header | RowChangeList::kCompactRaw);
+  InlinePutVarint32(dst, new_val.size());
+  dst->append(new_val.data(), new_val.size());
+}
+
+} // anonymous namespace
+
 string RowChangeList::ToString(const Schema &schema) const {
   DCHECK_GT(encoded_data_.size(), 0);
   RowChangeListDecoder decoder(*this);
@@ -98,11 +175,16 @@ string RowChangeList::ToString(const Schema &schema) const {
 void RowChangeListEncoder::AddRawColumnUpdate(
     int col_id, bool is_null, Slice new_val) {
   if (type_ == RowChangeList::kUninitialized) {
-    SetType(RowChangeList::kUpdate);
+    SetType(FLAGS_rowchangelist_compact_encoding ? RowChangeList::kCompactUpdate
+                                                 : RowChangeList::kUpdate);
   } else {
-    DCHECK_EQ(RowChangeList::kUpdate, type_);
+    DCHECK(type_ == RowChangeList::kUpdate || type_ == RowChangeList::kCompactUpdate) << type_;
   }
 
+  if (type_ == RowChangeList::kCompactUpdate) {
+    PutCompactColumnUpdate(dst_, col_id, is_null, new_val);
+    return;
+  }
   InlinePutVarint32(dst_, col_id);
   if (is_null) {
     dst_->push_back(0);
@@ -241,16 +323,27 @@ Status RowChangeListDecoder::ApplyRowUpdate(RowBlockRow *dst_row,
 Status RowChangeListDecoder::ApplyToOneColumn(size_t row_idx, ColumnBlock* dst_col,
                                               const Schema& dst_schema,
                                               int col_idx, Arena *arena) {
-  DCHECK_EQ(RowChangeList::kUpdate, type_);
+  DCHECK(is_update());
 
   const ColumnSchema& col_schema = dst_schema.column(col_idx);
   ColumnId col_id = dst_schema.column_id(col_idx);
 
   while (HasNext()) {
     DecodedUpdate dec;
-    RETURN_NOT_OK(DecodeNext(&dec));
-    if (dec.col_id != col_id) {
-      continue;
+    if (type_ == RowChangeList::kCompactUpdate) {
+      // Skip the updates to other columns without decoding their values.
+      RowChangeList::CompactValueKind kind;
+      RETURN_NOT_OK(DecodeCompactHeader(&dec.col_id, &kind));
+      if (dec.col_id != col_id) {
+        RETURN_NOT_OK(SkipCompactValue(kind));
+        continue;
+      }
+      RETURN_NOT_OK(DecodeCompactValue(kind, &dec));
+    } else {
+      RETURN_NOT_OK(DecodeNext(&dec));
+      if (dec.col_id != col_id) {
+        continue;
+      }
     }
 
     int junk_col_idx;
@@ -288,8 +381,102 @@ Status RowChangeListDecoder::RemoveColumnIdsFromChangeList(const RowChangeList&
   return Status::OK();
 }
 
+Status RowChangeListDecoder::GetIncludedColumnIds(std::vector<ColumnId>* column_ids) {
+  column_ids->clear();
+  DCHECK(is_update());
+  while (HasNext()) {
+    if (type_ == RowChangeList::kCompactUpdate) {
+      ColumnId col_id;
+      RowChangeList::CompactValueKind kind;
+      RETURN_NOT_OK(DecodeCompactHeader(&col_id, &kind));
+      RETURN_NOT_OK(SkipCompactValue(kind));
+      column_ids->push_back(col_id);
+    } else {
+      DecodedUpdate dec;
+      RETURN_NOT_OK(DecodeNext(&dec));
+      column_ids->push_back(dec.col_id);
+    }
+  }
+  return Status::OK();
+}
+
+Status RowChangeListDecoder::DecodeCompactHeader(ColumnId* col_id,
+                                                 RowChangeList::CompactValueKind* kind) {
+  uint64_t header;
+  if (PREDICT_FALSE(!GetVarint64(&remaining_, &header))) {
+    return Status::Corruption("Invalid column update header varint in delta");
+  }
+  uint64_t id = header >> kCompactKindBits;
+  uint8_t kind_value = header & ((1 << kCompactKindBits) - 1);
+  if (PREDICT_FALSE(id > std::numeric_limits<int32_t>::max() ||
+                    kind_value > RowChangeList::kCompactInt64)) {
+    return Status::Corruption(Substitute("Invalid column update header $0 in delta", header));
+  }
+  *col_id = ColumnId(static_cast<int32_t>(id));
+  *kind = static_cast<RowChangeList::CompactValueKind>(kind_value);
+  return Status::OK();
+}
+
+Status RowChangeListDecoder::DecodeCompactValue(RowChangeList::CompactValueKind kind,
+                                                DecodedUpdate* dec) {
+  dec->null = kind == RowChangeList::kCompactNull;
+  if (dec->null) {
+    return Status::OK();
+  }
+
+  size_t width = CompactIntWidth(kind);
+  if (width > 0) {
+    uint64_t zigzag;
+    if (PREDICT_FALSE(!GetVarint64(&remaining_, &zigzag))) {
+      return Status::Corruption(
+          Substitute("Invalid integer varint for column id $0 in delta", dec->col_id));
+    }
+    int64_t value = ZigZagDecode(zigzag);
+    memcpy(int_value_, &value, sizeof(int_value_));
+    dec->raw_value = Slice(int_value_, width);
+    return Status::OK();
+  }
+
+  uint32_t size;
+  if (PREDICT_FALSE(!GetVarint32(&remaining_, &size))) {
+    return Status::Corruption("Invalid size varint in delta");
+  }
+  if (PREDICT_FALSE(remaining_.size() < size)) {
+    return Status::Corruption(
+        Substitute("truncated value for column id $0, expected $1 bytes, only $2 remaining",
+                   dec->col_id, size, remaining_.size()));
+  }
+  dec->raw_value = Slice(remaining_.data(), size);
+  remaining_.remove_prefix(size);
+  return Status::OK();
+}
+
+Status RowChangeListDecoder::SkipCompactValue(RowChangeList::CompactValueKind kind) {
+  if (kind == RowChangeList::kCompactNull) {
+    return Status::OK();
+  }
+  if (CompactIntWidth(kind) > 0) {
+    uint64_t unused;
+    if (PREDICT_FALSE(!GetVarint64(&remaining_, &unused))) {
+      return Status::Corruption("Invalid integer varint in delta");
+    }
+    return Status::OK();
+  }
+  uint32_t size;
+  if (PREDICT_FALSE(!GetVarint32(&remaining_, &size) || remaining_.size() < size)) {
+    return Status::Corruption("Invalid or truncated value in delta");
+  }
+  remaining_.remove_prefix(size);
+  return Status::OK();
+}
+
 Status RowChangeListDecoder::DecodeNext(DecodedUpdate* dec) {
   DCHECK_NE(type_, RowChangeList::kUninitialized) << "Must call Init()";
+  if (type_ == RowChangeList::kCompactUpdate) {
+    RowChangeList::CompactValueKind kind;
+    RETURN_NOT_OK(DecodeCompactHeader(&dec->col_id, &kind));
+    return DecodeCompactValue(kind, dec);
+  }
   // Decode the column id.
   uint32_t id;
   if (PREDICT_FALSE(!GetVarint32(&remaining_, &id))) {
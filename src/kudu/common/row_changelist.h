@@ -87,6 +87,26 @@ class Schema;
 //   0x01    0x03      0x00
 //   UPDATE  col_id=3  NULL
 //
+//   If type == kCompactUpdate, then a sequence of column updates follow in a
+//   more compact format, used once --rowchangelist_compact_encoding is
+//   enabled. Each update has the format:
+//
+//     <header>     -- varint64
+//       (column id << 3) | kind, where kind is one of CompactValueKind below.
+//
+//     <value>      -- determined by kind
+//       Nothing for kCompactNull. For kCompactRaw, a varint32 length followed
+//       by the value as above. Otherwise, the 1, 2, 4 or 8-byte value is
+//       sign-extended and encoded as a zigzag varint64, so that small integers
+//       take a single byte whatever the width of their column.
+//
+//   The header alone determines how many bytes of value follow, so updates to
+//   other columns can be skipped without decoding their values.
+//
+// 4) UPDATE SET [col_id 3] = 33  (assuming INT32 column)
+//   0x04            0x1c                        0x42
+//   COMPACT_UPDATE  col_id=3, kind=kCompactInt32  zigzag(33)
+//
 class RowChangeList {
  public:
   RowChangeList() {}
@@ -129,7 +149,18 @@ class RowChangeList {
     kUpdate = 1,
     kDelete = 2,
     kReinsert = 3,
-    ChangeType_max = 3
+    kCompactUpdate = 4,
+    ChangeType_max = 4
+  };
+
+  // The kinds of values of kCompactUpdate column updates.
+  enum CompactValueKind {
+    kCompactNull = 0,
+    kCompactRaw = 1,
+    kCompactInt8 = 2,
+    kCompactInt16 = 3,
+    kCompactInt32 = 4,
+    kCompactInt64 = 5
   };
 
   Slice encoded_data_;
@@ -191,6 +222,7 @@ class RowChangeListEncoder {
  private:
   FRIEND_TEST(TestRowChangeList, TestInvalid_SetNullForNonNullableColumn);
   FRIEND_TEST(TestRowChangeList, TestInvalid_SetWrongSizeForIntColumn);
+  FRIEND_TEST(TestRowChangeList, TestCompactEncoding);
   friend class RowChangeListDecoder;
 
   void SetType(RowChangeList::ChangeType type) {
@@ -248,7 +280,7 @@ class RowChangeListDecoder {
   }
 
   bool is_update() const {
-    return type_ == RowChangeList::kUpdate;
+    return type_ == RowChangeList::kUpdate || type_ == RowChangeList::kCompactUpdate;
   }
 
   bool is_delete() const {
@@ -266,16 +298,8 @@ class RowChangeListDecoder {
   // Append an entry to *column_ids for each column that is updated
   // in this RCL.
   // This 'consumes' the remainder of the encoded RowChangeList.
-  Status GetIncludedColumnIds(std::vector<ColumnId>* column_ids) {
-    column_ids->clear();
-    DCHECK(is_update());
-    while (HasNext()) {
-      DecodedUpdate dec;
-      RETURN_NOT_OK(DecodeNext(&dec));
-      column_ids->push_back(dec.col_id);
-    }
-    return Status::OK();
-  }
+  // Values aren't decoded.
+  Status GetIncludedColumnIds(std::vector<ColumnId>* column_ids);
 
   // Applies changes in this decoder to the specified row and saves the old
   // state of the row into the undo_encoder.
@@ -338,6 +362,9 @@ class RowChangeListDecoder {
     //     the slice will point to the new string value (i.e not to a
     //     "wrapper" slice.
     // 'raw_value' is only relevant in the case that 'null' is not true.
+    //
+    // The slice may point into the decoder rather than the source buffer, in
+    // which case it is only valid until the next call to DecodeNext().
     Slice raw_value;
 
     // Resolve the decoded update against the given Schema.
@@ -361,12 +388,23 @@ class RowChangeListDecoder {
   // See the docs on DecodedUpdate above for field information.
   //
   // The update->raw_value slice points to memory within the buffer
-  // being decoded by this object. No copies are made.
+  // being decoded by this object, or for compactly encoded integers, to
+  // the decoded value within this object.
   //
   // REQUIRES: is_update()
   Status DecodeNext(DecodedUpdate* update);
 
  private:
+  // Decodes the header of the next kCompactUpdate column update.
+  Status DecodeCompactHeader(ColumnId* col_id, RowChangeList::CompactValueKind* kind);
+
+  // Decodes the value of a kCompactUpdate column update of the given kind,
+  // following its header, into 'update'.
+  Status DecodeCompactValue(RowChangeList::CompactValueKind kind, DecodedUpdate* update);
+
+  // Skips over the value of a kCompactUpdate column update of the given kind.
+  Status SkipCompactValue(RowChangeList::CompactValueKind kind);
+
   FRIEND_TEST(TestRowChangeList, TestEncodeDecodeUpdates);
   friend class RowChangeList;
 
@@ -375,6 +413,9 @@ class RowChangeListDecoder {
   Slice remaining_;
 
   RowChangeList::ChangeType type_;
+
+  // The little-endian value of the last compactly encoded integer decoded.
+  uint8_t int_value_[sizeof(uint64_t)];
 };
 
 
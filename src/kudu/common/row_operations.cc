@@ -39,6 +39,10 @@ string DecodedRowOperation::ToString(const Schema& schema) const {
       return "INSERT " + schema.DebugRow(ConstContiguousRow(&schema, row_data));
     case RowOperationsPB::UPSERT:
       return "UPSERT " + schema.DebugRow(ConstContiguousRow(&schema, row_data));
+    case RowOperationsPB::INCREMENT:
+      return Substitute("INCREMENT $0 $1",
+                        schema.DebugRowKey(ConstContiguousRow(&schema, row_data)),
+                        changelist.ToString(schema));
     case RowOperationsPB::UPDATE:
     case RowOperationsPB::DELETE:
       return Substitute("MUTATE $0 $1",
@@ -128,13 +132,22 @@ RowOperationsPBDecoder::RowOperationsPBDecoder(const RowOperationsPB* pb,
                                                const Schema* client_schema,
                                                const Schema* tablet_schema,
                                                Arena* dst_arena)
-  : pb_(pb),
+  : RowOperationsPBDecoder(pb->rows(), pb->indirect_data(),
+                           client_schema, tablet_schema, dst_arena) {
+}
+
+RowOperationsPBDecoder::RowOperationsPBDecoder(const Slice& rows,
+                                               const Slice& indirect_data,
+                                               const Schema* client_schema,
+                                               const Schema* tablet_schema,
+                                               Arena* dst_arena)
+  : indirect_data_(indirect_data),
     client_schema_(client_schema),
     tablet_schema_(tablet_schema),
     dst_arena_(dst_arena),
     bm_size_(BitmapSize(client_schema_->num_columns())),
     tablet_row_size_(ContiguousRowHelper::row_size(*tablet_schema_)),
-    src_(pb->rows().data(), pb->rows().size()) {
+    src_(rows) {
 }
 
 RowOperationsPBDecoder::~RowOperationsPBDecoder() {
@@ -185,11 +198,11 @@ Status RowOperationsPBDecoder::GetColumnSlice(const ColumnSchema& col, Slice* sl
     size_t offset_in_indirect = reinterpret_cast<uintptr_t>(ptr_slice->data());
     bool overflowed = false;
     size_t max_offset = AddWithOverflowCheck(offset_in_indirect, ptr_slice->size(), &overflowed);
-    if (PREDICT_FALSE(overflowed || max_offset > pb_->indirect_data().size())) {
+    if (PREDICT_FALSE(overflowed || max_offset > indirect_data_.size())) {
       return Status::Corruption("Bad indirect slice");
     }
 
-    *slice = Slice(&pb_->indirect_data()[offset_in_indirect], ptr_slice->size());
+    *slice = Slice(indirect_data_.data() + offset_in_indirect, ptr_slice->size());
   } else {
     *slice = Slice(src_.data(), size);
   }
@@ -435,7 +448,10 @@ Status RowOperationsPBDecoder::DecodeUpdateOrDelete(const ClientServerMapping& m
   // For UPDATE, we expect at least one other column to be set, indicating the
   // update to perform.
   // For DELETE, we expect no other columns to be set (and we verify that).
-  if (op->type == RowOperationsPB::UPDATE) {
+  // INCREMENT is like UPDATE, but its values are the amounts to add to the
+  // columns.
+  if (op->type == RowOperationsPB::UPDATE || op->type == RowOperationsPB::INCREMENT) {
+    const bool is_increment = op->type == RowOperationsPB::INCREMENT;
     faststring buf;
     RowChangeListEncoder rcl_encoder(&buf);
 
@@ -448,6 +464,18 @@ Status RowOperationsPBDecoder::DecodeUpdateOrDelete(const ClientServerMapping& m
       if (BitmapTest(client_isset_map, client_col_idx)) {
         bool client_set_to_null = client_schema_->has_nullables() &&
           BitmapTest(client_null_map, client_col_idx);
+        if (is_increment) {
+          switch (col.type_info()->physical_type()) {
+            case INT8: case INT16: case INT32: case INT64: case FLOAT: case DOUBLE:
+              break;
+            default:
+              return Status::InvalidArgument("INCREMENT of non-numeric column",
+                                             col.ToString());
+          }
+          if (PREDICT_FALSE(client_set_to_null)) {
+            return Status::InvalidArgument("INCREMENT by NULL value", col.ToString());
+          }
+        }
         uint8_t scratch[kLargestTypeSize];
         uint8_t* val_to_add;
         if (!client_set_to_null) {
@@ -494,7 +522,7 @@ Status RowOperationsPBDecoder::DecodeUpdateOrDelete(const ClientServerMapping& m
     }
     op->changelist = RowChangeList::CreateDelete();
   } else {
-    LOG(FATAL) << "Should only call this method with UPDATE or DELETE";
+    LOG(FATAL) << "Should only call this method with UPDATE, DELETE or INCREMENT";
   }
 
   return Status::OK();
@@ -576,6 +604,7 @@ Status RowOperationsPBDecoder::DecodeOperations(vector<DecodedRowOperation>* ops
         break;
       case RowOperationsPB::UPDATE:
       case RowOperationsPB::DELETE:
+      case RowOperationsPB::INCREMENT:
         RETURN_NOT_OK(DecodeUpdateOrDelete(mapping, &op));
         break;
       case RowOperationsPB::SPLIT_ROW:
@@ -24,6 +24,7 @@
 #include "kudu/common/row_changelist.h"
 #include "kudu/common/wire_protocol.pb.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
@@ -52,7 +53,7 @@ struct DecodedRowOperation {
   RowOperationsPB::Type type;
 
   // For INSERT or UPSERT, the whole projected row.
-  // For UPDATE or DELETE, the row key.
+  // For UPDATE, DELETE or INCREMENT, the row key.
   const uint8_t* row_data;
 
   // For INSERT or UPDATE, a bitmap indicating which of the cells were
@@ -60,7 +61,9 @@ struct DecodedRowOperation {
   // A set bit indicates that the client explicitly set the cell.
   const uint8_t* isset_bitmap;
 
-  // For UPDATE and DELETE types, the changelist
+  // For UPDATE and DELETE types, the changelist. For INCREMENT, a changelist
+  // of the amounts to add to the columns, which the tablet turns into an
+  // update of their new values.
   RowChangeList changelist;
 
   // For SPLIT_ROW, the partial row to split on.
@@ -75,6 +78,15 @@ class RowOperationsPBDecoder {
                          const Schema* client_schema,
                          const Schema* tablet_schema,
                          Arena* dst_arena);
+
+  // Decodes rows which were encoded into a RowOperationsPB's 'rows' and
+  // 'indirect_data' but are held elsewhere (e.g. in RPC sidecars). The data
+  // must outlive the decoded operations.
+  RowOperationsPBDecoder(const Slice& rows,
+                         const Slice& indirect_data,
+                         const Schema* client_schema,
+                         const Schema* tablet_schema,
+                         Arena* dst_arena);
   ~RowOperationsPBDecoder();
 
   Status DecodeOperations(std::vector<DecodedRowOperation>* ops);
@@ -94,7 +106,7 @@ class RowOperationsPBDecoder {
   // Serialization/deserialization support
   //------------------------------------------------------------
 
-  // Decode the next encoded operation, which must be UPDATE or DELETE.
+  // Decode the next encoded operation, which must be UPDATE, DELETE or INCREMENT.
   Status DecodeUpdateOrDelete(const ClientServerMapping& mapping,
                               DecodedRowOperation* op);
 
@@ -102,7 +114,7 @@ class RowOperationsPBDecoder {
   Status DecodeSplitRow(const ClientServerMapping& mapping,
                         DecodedRowOperation* op);
 
-  const RowOperationsPB* const pb_;
+  const Slice indirect_data_;
   const Schema* const client_schema_;
   const Schema* const tablet_schema_;
   Arena* const dst_arena_;
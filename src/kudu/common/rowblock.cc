@@ -34,40 +34,40 @@ void SelectionVector::Resize(size_t n_rows) {
   CHECK_LE(new_bytes, bytes_capacity_);
   n_rows_ = n_rows;
   n_bytes_ = new_bytes;
-  // Pad with zeroes up to the next byte in order to give CountSelected()
-  // and AnySelected() the assumption that the size is an even byte
-  size_t bits_in_last_byte = n_rows & 7;
+  ClearPadding();
+}
+
+void SelectionVector::ClearPadding() {
+  // Pad with zeroes up to the next byte, so that merging whole bytes of the
+  // bitmap with another vector doesn't select rows past the end.
+  size_t bits_in_last_byte = n_rows_ & 7;
   if (bits_in_last_byte > 0) {
     BitmapChangeBits(&bitmap_[0], n_rows_, 8 - bits_in_last_byte, 0);
   }
 }
 
 size_t SelectionVector::CountSelected() const {
-  return Bits::Count(&bitmap_[0], n_bytes_);
+  return BitmapCount(&bitmap_[0], n_rows_);
 }
 
 bool SelectionVector::AnySelected() const {
-  size_t rem = n_bytes_;
-  const uint32_t *p32 = reinterpret_cast<const uint32_t *>(
-    &bitmap_[0]);
-  while (rem >= 4) {
-    if (*p32 != 0) {
-      return true;
-    }
-    p32++;
-    rem -= 4;
-  }
+  return FindFirstSelected(0) != n_rows_;
+}
 
-  const uint8_t *p8 = reinterpret_cast<const uint8_t *>(p32);
-  while (rem > 0) {
-    if (*p8 != 0) {
-      return true;
-    }
-    p8++;
-    rem--;
-  }
+void SelectionVector::And(const SelectionVector& other) {
+  DCHECK_GE(other.nrows(), n_rows_);
+  BitmapMergeAnd(&bitmap_[0], other.bitmap(), n_rows_);
+}
+
+void SelectionVector::Or(const SelectionVector& other) {
+  DCHECK_GE(other.nrows(), n_rows_);
+  BitmapMergeOr(&bitmap_[0], other.bitmap(), n_rows_);
+  ClearPadding();
+}
 
-  return false;
+void SelectionVector::AndNot(const SelectionVector& other) {
+  DCHECK_GE(other.nrows(), n_rows_);
+  BitmapMergeAndNot(&bitmap_[0], other.bitmap(), n_rows_);
 }
 
 //////////////////////////////
@@ -78,6 +78,35 @@ class SelectionVector {
     BitmapClear(&bitmap_[0], row);
   }
 
+  // Unselect the rows which aren't also selected in 'other'.
+  // 'other' must have at least as many rows as this vector.
+  void And(const SelectionVector& other);
+
+  // Select the rows which are selected in 'other'.
+  // 'other' must have at least as many rows as this vector.
+  void Or(const SelectionVector& other);
+
+  // Unselect the rows which are selected in 'other'.
+  // 'other' must have at least as many rows as this vector.
+  void AndNot(const SelectionVector& other);
+
+  // Call 'f' with the index of each selected row, in increasing order.
+  // 'f' may unselect the row it's called for.
+  template<class F>
+  void ForEachSelectedRow(const F& f) const {
+    BitmapForEachSetBit(&bitmap_[0], n_rows_, f);
+  }
+
+  // Return the index of the first selected row at or after 'row', or
+  // nrows() if there are none.
+  size_t FindFirstSelected(size_t row) const {
+    size_t idx;
+    if (row >= n_rows_ || !BitmapFindFirstSet(&bitmap_[0], row, n_rows_, &idx)) {
+      return n_rows_;
+    }
+    return idx;
+  }
+
   uint8_t *mutable_bitmap() {
     return &bitmap_[0];
   }
@@ -109,6 +138,9 @@ class SelectionVector {
  private:
   DISALLOW_COPY_AND_ASSIGN(SelectionVector);
 
+  // Clear the bits of the last byte past n_rows_.
+  void ClearPadding();
+
   // The number of allocated bytes in bitmap_
   size_t bytes_capacity_;
 
@@ -147,6 +179,20 @@ class SelectionVectorView {
     DCHECK_LE(nrows, sel_vec_->nrows() - row_offset_);
     BitmapChangeBits(sel_vec_->mutable_bitmap(), row_offset_, nrows, false);
   }
+  // Returns true if any of the next 'nrows' rows of the view is selected.
+  bool AnySelected(size_t nrows) const {
+    DCHECK_LE(nrows, sel_vec_->nrows() - row_offset_);
+    return nrows > 0 &&
+        !BitmapIsAllZero(sel_vec_->bitmap(), row_offset_, row_offset_ + nrows);
+  }
+  // Returns an iterator over the runs of selected and unselected rows among
+  // the next 'nrows' rows of the view.
+  BitmapIterator IterateRuns(size_t nrows) const {
+    DCHECK_LE(nrows, sel_vec_->nrows() - row_offset_);
+    BitmapIterator iter(sel_vec_->bitmap(), row_offset_ + nrows);
+    iter.SeekTo(row_offset_);
+    return iter;
+  }
  private:
   SelectionVector* sel_vec_;
   size_t row_offset_;
@@ -211,6 +257,13 @@ class RowBlock {
     return columns_data_[col_idx];
   }
 
+  // Return the null bitmap for the given column, or NULL if the column is
+  // not nullable. Like column_data_base_ptr(), this is used by codegen.
+  uint8_t* column_null_bitmap_ptr(size_t col_idx) const {
+    DCHECK_LT(col_idx, column_null_bitmaps_.size());
+    return column_null_bitmaps_[col_idx];
+  }
+
   // Return the number of rows in the row block. Note that this includes
   // rows which were filtered out by the selection vector.
   size_t nrows() const { return nrows_; }
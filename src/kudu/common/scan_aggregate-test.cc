@@ -0,0 +1,341 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#include "kudu/common/scan_aggregate.h"
+
+#include <glog/logging.h>
+#include <deque>
+#include <gtest/gtest.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kudu/common/rowblock.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/bitmap.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+using std::map;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+
+class TestScanAggregate : public KuduTest {
+ public:
+  TestScanAggregate()
+      : schema_({ ColumnSchema("key", INT32),
+                  ColumnSchema("nullable_int", INT64, true),
+                  ColumnSchema("string", STRING, true),
+                  ColumnSchema("double", DOUBLE) },
+                1),
+        arena_(1024, 1024 * 1024) {
+  }
+
+ protected:
+  // Adds the aggregate of 'function' over 'column' (or COUNT(*) if 'column'
+  // is empty) to 'aggregates_'.
+  Status AddAggregate(ScanAggregatePB::Function function, const string& column) {
+    ScanAggregatePB pb;
+    pb.set_function(function);
+    if (!column.empty()) {
+      pb.set_column(column);
+    }
+    return ScanAggregate::FromPB(pb, schema_, &aggregates_);
+  }
+
+  // Fills 'block' with rows 'first_row' to 'first_row + block->nrows()'.
+  // Every third row has NULL nullable columns, and every fifth row is
+  // deselected.
+  void FillBlock(int first_row, RowBlock* block) {
+    block->selection_vector()->SetAllTrue();
+    for (int i = 0; i < block->nrows(); i++) {
+      int val = first_row + i;
+      RowBlockRow row = block->row(i);
+      *reinterpret_cast<int32_t*>(row.mutable_cell_ptr(0)) = val;
+      row.cell(1).set_null(val % 3 == 0);
+      *reinterpret_cast<int64_t*>(row.mutable_cell_ptr(1)) = val * 10;
+      row.cell(2).set_null(val % 3 == 0);
+      strings_.push_back(Substitute("row $0", val));
+      *reinterpret_cast<Slice*>(row.mutable_cell_ptr(2)) = Slice(strings_.back());
+      *reinterpret_cast<double*>(row.mutable_cell_ptr(3)) = val * 0.5;
+      if (val % 5 == 0) {
+        BitmapClear(block->selection_vector()->mutable_bitmap(), i);
+      }
+    }
+  }
+
+  Schema schema_;
+  Arena arena_;
+  vector<ScanAggregate> aggregates_;
+  std::deque<string> strings_;
+};
+
+TEST_F(TestScanAggregate, TestFromPB) {
+  ASSERT_OK(AddAggregate(ScanAggregatePB::COUNT, ""));
+  ASSERT_OK(AddAggregate(ScanAggregatePB::COUNT, "nullable_int"));
+  ASSERT_OK(AddAggregate(ScanAggregatePB::MIN, "string"));
+  ASSERT_OK(AddAggregate(ScanAggregatePB::MAX, "key"));
+  ASSERT_OK(AddAggregate(ScanAggregatePB::SUM, "double"));
+  ASSERT_OK(AddAggregate(ScanAggregatePB::SUM, "key"));
+
+  Schema result_schema;
+  ASSERT_OK(ScanAggregate::ResultSchema(aggregates_, &result_schema));
+  ASSERT_EQ("Schema [\n"
+            "\tcount(*)[int64 NOT NULL],\n"
+            "\tcount(nullable_int)[int64 NOT NULL],\n"
+            "\tmin(string)[string NULLABLE],\n"
+            "\tmax(key)[int32 NULLABLE],\n"
+            "\tsum(double)[double NULLABLE],\n"
+            "\tsum(key)[int64 NULLABLE]\n"
+            "]",
+            result_schema.ToString());
+
+  Status s = AddAggregate(ScanAggregatePB::SUM, "string");
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  ASSERT_STR_CONTAINS(s.ToString(), "Cannot compute the sum of string column string");
+
+  s = AddAggregate(ScanAggregatePB::MIN, "");
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  ASSERT_STR_CONTAINS(s.ToString(), "Aggregate min requires a column");
+
+  s = AddAggregate(ScanAggregatePB::MAX, "missing");
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  ASSERT_STR_CONTAINS(s.ToString(), "Aggregated column missing is not part of the projection");
+
+  s = AddAggregate(ScanAggregatePB::UNKNOWN_FUNCTION, "key");
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+
+  // Duplicate aggregates would result in duplicate column names.
+  ASSERT_OK(AddAggregate(ScanAggregatePB::COUNT, ""));
+  ASSERT_FALSE(ScanAggregate::ResultSchema(aggregates_, &result_schema).ok());
+}
+
+// Accumulate two blocks of rows in separate aggregates (as though they were
+// scanned by separate RPCs), merge the partial results, and check the result
+// against the expected values.
+TEST_F(TestScanAggregate, TestAccumulateAndMerge) {
+  ASSERT_OK(AddAggregate(ScanAggregatePB::COUNT, ""));
+  ASSERT_OK(AddAggregate(ScanAggregatePB::COUNT, "nullable_int"));
+  ASSERT_OK(AddAggregate(ScanAggregatePB::MIN, "string"));
+  ASSERT_OK(AddAggregate(ScanAggregatePB::MAX, "string"));
+  ASSERT_OK(AddAggregate(ScanAggregatePB::MIN, "nullable_int"));
+  ASSERT_OK(AddAggregate(ScanAggregatePB::MAX, "key"));
+  ASSERT_OK(AddAggregate(ScanAggregatePB::SUM, "double"));
+  ASSERT_OK(AddAggregate(ScanAggregatePB::SUM, "nullable_int"));
+  Schema result_schema;
+  ASSERT_OK(ScanAggregate::ResultSchema(aggregates_, &result_schema));
+
+  const int kRowsPerBlock = 50;
+  const int kNumBlocks = 2;
+  vector<ScanAggregate> merged = aggregates_;
+  int64_t count = 0;
+  int64_t non_null_count = 0;
+  int64_t int_sum = 0;
+  double double_sum = 0;
+  int min_int = -1;
+  for (int b = 0; b < kNumBlocks; b++) {
+    RowBlock block(schema_, kRowsPerBlock, &arena_);
+    FillBlock(b * kRowsPerBlock, &block);
+    for (int i = 0; i < kRowsPerBlock; i++) {
+      int val = b * kRowsPerBlock + i;
+      if (val % 5 == 0) continue;
+      count++;
+      double_sum += val * 0.5;
+      if (val % 3 == 0) continue;
+      non_null_count++;
+      int_sum += val * 10;
+      if (min_int == -1) min_int = val * 10;
+    }
+
+    vector<ScanAggregate> partials = aggregates_;
+    for (ScanAggregate& partial : partials) {
+      partial.Accumulate(block);
+    }
+
+    // Route the partial results through a row of the result schema, as the
+    // tablet server does.
+    RowBlock result_block(result_schema, 1, &arena_);
+    RowBlockRow result_row = result_block.row(0);
+    for (int i = 0; i < partials.size(); i++) {
+      ColumnBlockCell cell = result_row.cell(i);
+      bool is_null = !partials[i].GetResult(cell.mutable_ptr());
+      if (cell.is_nullable()) {
+        cell.set_null(is_null);
+      }
+    }
+    for (int i = 0; i < merged.size(); i++) {
+      merged[i].Merge(result_row.nullable_cell_ptr(i));
+    }
+  }
+
+  int64_t int64_result;
+  ASSERT_TRUE(merged[0].GetResult(&int64_result));
+  ASSERT_EQ(count, int64_result);
+  ASSERT_TRUE(merged[1].GetResult(&int64_result));
+  ASSERT_EQ(non_null_count, int64_result);
+
+  // Strings compare lexicographically: "row 1" < "row 10" < ... < "row 98".
+  Slice slice_result;
+  ASSERT_TRUE(merged[2].GetResult(&slice_result));
+  ASSERT_EQ("row 1", slice_result.ToString());
+  ASSERT_TRUE(merged[3].GetResult(&slice_result));
+  ASSERT_EQ("row 98", slice_result.ToString());
+
+  ASSERT_TRUE(merged[4].GetResult(&int64_result));
+  ASSERT_EQ(min_int, int64_result);
+  int32_t int32_result;
+  ASSERT_TRUE(merged[5].GetResult(&int32_result));
+  ASSERT_EQ(99, int32_result);
+  double double_result;
+  ASSERT_TRUE(merged[6].GetResult(&double_result));
+  ASSERT_DOUBLE_EQ(double_sum, double_result);
+  ASSERT_TRUE(merged[7].GetResult(&int64_result));
+  ASSERT_EQ(int_sum, int64_result);
+}
+
+// MIN, MAX and SUM of no values are NULL, whereas COUNT is zero.
+TEST_F(TestScanAggregate, TestNoValues) {
+  ASSERT_OK(AddAggregate(ScanAggregatePB::COUNT, "nullable_int"));
+  ASSERT_OK(AddAggregate(ScanAggregatePB::MIN, "nullable_int"));
+  ASSERT_OK(AddAggregate(ScanAggregatePB::MAX, "string"));
+  ASSERT_OK(AddAggregate(ScanAggregatePB::SUM, "nullable_int"));
+
+  RowBlock block(schema_, 10, &arena_);
+  FillBlock(0, &block);
+  // Only select the rows where the nullable columns are NULL.
+  for (int i = 0; i < block.nrows(); i++) {
+    if (i % 3 != 0) {
+      BitmapClear(block.selection_vector()->mutable_bitmap(), i);
+    }
+  }
+
+  for (ScanAggregate& aggregate : aggregates_) {
+    aggregate.Accumulate(block);
+  }
+  // Merging NULL partial results has no effect either.
+  for (int i = 1; i < aggregates_.size(); i++) {
+    aggregates_[i].Merge(nullptr);
+  }
+  int64_t count;
+  ASSERT_TRUE(aggregates_[0].GetResult(&count));
+  ASSERT_EQ(0, count);
+  Slice unused[1];
+  for (int i = 1; i < aggregates_.size(); i++) {
+    ASSERT_FALSE(aggregates_[i].GetResult(unused)) << i;
+  }
+}
+
+// Accumulate two blocks of rows into separate groupings, merge the partial
+// results of their groups, and check the result of each group.
+TEST_F(TestScanAggregate, TestGroupBy) {
+  ASSERT_OK(AddAggregate(ScanAggregatePB::COUNT, ""));
+  ASSERT_OK(AddAggregate(ScanAggregatePB::SUM, "double"));
+  ASSERT_OK(AddAggregate(ScanAggregatePB::MAX, "key"));
+
+  unique_ptr<ScanGroupBy> group_by;
+  Status s = ScanGroupBy::Create({ "missing" }, schema_, aggregates_, &group_by);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  ASSERT_STR_CONTAINS(s.ToString(), "Grouping column missing is not part of the projection");
+  s = ScanGroupBy::Create({ "string", "string" }, schema_, aggregates_, &group_by);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  ASSERT_STR_CONTAINS(s.ToString(), "Duplicate grouping column string");
+
+  ASSERT_OK(ScanGroupBy::Create({ "string" }, schema_, aggregates_, &group_by));
+  Schema result_schema;
+  ASSERT_OK(group_by->ResultSchema(&result_schema));
+  ASSERT_EQ("Schema [\n"
+            "\tstring[string NULLABLE],\n"
+            "\tcount(*)[int64 NOT NULL],\n"
+            "\tsum(double)[double NULLABLE],\n"
+            "\tmax(key)[int32 NULLABLE]\n"
+            "]",
+            result_schema.ToString());
+
+  // The expected count, sum and max of each group, keyed by the grouping
+  // value or "NULL".
+  struct Expected {
+    int64_t count = 0;
+    double sum = 0;
+    int32_t max = 0;
+  };
+  map<string, Expected> expected;
+
+  const int kRowsPerBlock = 50;
+  const int kNumBlocks = 2;
+  unique_ptr<ScanGroupBy> merged = group_by->CloneEmpty();
+  for (int b = 0; b < kNumBlocks; b++) {
+    RowBlock block(schema_, kRowsPerBlock, &arena_);
+    FillBlock(b * kRowsPerBlock, &block);
+    for (int i = 0; i < kRowsPerBlock; i++) {
+      int val = b * kRowsPerBlock + i;
+      strings_.push_back(Substitute("group $0", val % 4));
+      *reinterpret_cast<Slice*>(block.row(i).mutable_cell_ptr(2)) = Slice(strings_.back());
+      if (val % 5 == 0) continue;
+      Expected& e = expected[val % 3 == 0 ? "NULL" : strings_.back()];
+      e.count++;
+      e.sum += val * 0.5;
+      e.max = val;
+    }
+
+    unique_ptr<ScanGroupBy> partial = group_by->CloneEmpty();
+    partial->Accumulate(block);
+    ASSERT_GT(partial->memory_footprint(), 0);
+
+    // Route the partial results through rows of the result schema, as the
+    // tablet server does.
+    RowBlock result_block(result_schema, partial->num_groups(), &arena_);
+    for (int g = 0; g < partial->num_groups(); g++) {
+      RowBlockRow result_row = result_block.row(g);
+      vector<const void*> cells;
+      for (int i = 0; i < result_schema.num_columns(); i++) {
+        ColumnBlockCell cell = result_row.cell(i);
+        bool is_null = !partial->GetResult(g, i, cell.mutable_ptr());
+        if (cell.is_nullable()) {
+          cell.set_null(is_null);
+        }
+        cells.push_back(result_row.nullable_cell_ptr(i));
+      }
+      merged->Merge(cells);
+    }
+  }
+
+  ASSERT_EQ(expected.size(), merged->num_groups());
+  for (int g = 0; g < merged->num_groups(); g++) {
+    Slice group;
+    string name = merged->GetResult(g, 0, &group) ? group.ToString() : "NULL";
+    SCOPED_TRACE(name);
+    ASSERT_EQ(1, expected.count(name));
+    const Expected& e = expected[name];
+    int64_t count;
+    ASSERT_TRUE(merged->GetResult(g, 1, &count));
+    ASSERT_EQ(e.count, count);
+    double sum;
+    ASSERT_TRUE(merged->GetResult(g, 2, &sum));
+    ASSERT_DOUBLE_EQ(e.sum, sum);
+    int32_t max;
+    ASSERT_TRUE(merged->GetResult(g, 3, &max));
+    ASSERT_EQ(e.max, max);
+  }
+}
+
+} // namespace kudu
@@ -0,0 +1,524 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#include "kudu/common/scan_aggregate.h"
+
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/common/columnblock.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/substitute.h"
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+
+namespace {
+
+const char* FunctionName(ScanAggregatePB::Function function) {
+  switch (function) {
+    case ScanAggregatePB::COUNT: return "count";
+    case ScanAggregatePB::MIN: return "min";
+    case ScanAggregatePB::MAX: return "max";
+    case ScanAggregatePB::SUM: return "sum";
+    default: return "unknown";
+  }
+}
+
+// Returns true if SUM may be computed over columns of 'type'. Decimals are
+// summed as their unscaled values, which share the column's scale.
+bool IsSummableType(DataType type) {
+  switch (type) {
+    case DECIMAL32:
+    case DECIMAL64:
+    case INT8:
+    case INT16:
+    case INT32:
+    case INT64:
+    case UINT8:
+    case UINT16:
+    case UINT32:
+    case UINT64:
+    case FLOAT:
+    case DOUBLE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool IsFloatingPointType(DataType type) {
+  return type == FLOAT || type == DOUBLE;
+}
+
+// Adds 'val' to the integer sum, wrapping on overflow.
+void AddToIntSum(int64_t val, int64_t* sum) {
+  *sum = static_cast<int64_t>(static_cast<uint64_t>(*sum) + static_cast<uint64_t>(val));
+}
+
+// Adds 'val' to the sum for its type. FromPB() guarantees that SUM is only
+// evaluated over integer and floating point columns, so the overload for
+// other types is never called.
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value>::type
+AddToSum(T val, int64_t* /* int_sum */, double* double_sum) {
+  *double_sum += val;
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value>::type
+AddToSum(T val, int64_t* int_sum, double* /* double_sum */) {
+  AddToIntSum(static_cast<int64_t>(val), int_sum);
+}
+
+template <typename T>
+typename std::enable_if<!std::is_arithmetic<T>::value>::type
+AddToSum(const T& /* val */, int64_t* /* int_sum */, double* /* double_sum */) {
+  LOG(DFATAL) << "SUM evaluated over a non-numeric column";
+}
+
+} // anonymous namespace
+
+ScanAggregate::ScanAggregate(ScanAggregatePB::Function function, int column_idx,
+                             const TypeInfo* column_type, string result_name)
+    : function_(function),
+      column_idx_(column_idx),
+      column_type_(column_type),
+      result_name_(std::move(result_name)) {
+  Reset();
+}
+
+Status ScanAggregate::FromPB(const ScanAggregatePB& pb, const Schema& projection,
+                             vector<ScanAggregate>* aggregates) {
+  switch (pb.function()) {
+    case ScanAggregatePB::COUNT:
+    case ScanAggregatePB::MIN:
+    case ScanAggregatePB::MAX:
+    case ScanAggregatePB::SUM:
+      break;
+    default:
+      return Status::InvalidArgument(Substitute("Unknown aggregate function: $0",
+                                                pb.function()));
+  }
+  const char* name = FunctionName(pb.function());
+
+  if (!pb.has_column()) {
+    if (pb.function() != ScanAggregatePB::COUNT) {
+      return Status::InvalidArgument(Substitute("Aggregate $0 requires a column", name));
+    }
+    aggregates->emplace_back(ScanAggregate(pb.function(), -1, nullptr, "count(*)"));
+    return Status::OK();
+  }
+
+  int idx = projection.find_column(pb.column());
+  if (idx == Schema::kColumnNotFound) {
+    return Status::InvalidArgument(Substitute(
+        "Aggregated column $0 is not part of the projection", pb.column()));
+  }
+  const TypeInfo* type = projection.column(idx).type_info();
+  if (pb.function() == ScanAggregatePB::SUM && !IsSummableType(type->type())) {
+    return Status::InvalidArgument(Substitute("Cannot compute the sum of $0 column $1",
+                                              type->name(), pb.column()));
+  }
+  aggregates->emplace_back(ScanAggregate(pb.function(), idx, type,
+                                         Substitute("$0($1)", name, pb.column())));
+  return Status::OK();
+}
+
+Status ScanAggregate::ResultSchema(const vector<ScanAggregate>& aggregates, Schema* schema) {
+  vector<ColumnSchema> columns;
+  columns.reserve(aggregates.size());
+  for (const ScanAggregate& aggregate : aggregates) {
+    columns.push_back(aggregate.ResultColumn());
+  }
+  return schema->Reset(columns, 0);
+}
+
+ColumnSchema ScanAggregate::ResultColumn() const {
+  switch (function_) {
+    case ScanAggregatePB::COUNT:
+      return ColumnSchema(result_name_, INT64);
+    case ScanAggregatePB::SUM:
+      return ColumnSchema(result_name_,
+                          IsFloatingPointType(column_type_->type()) ? DOUBLE : INT64,
+                          true);
+    default:
+      return ColumnSchema(result_name_, column_type_->type(), true);
+  }
+}
+
+void ScanAggregate::Reset() {
+  has_value_ = false;
+  count_ = 0;
+  int_sum_ = 0;
+  double_sum_ = 0;
+  min_max_cell_.i = 0;
+  min_max_binary_.clear();
+}
+
+void ScanAggregate::Accumulate(const RowBlock& block) {
+  const SelectionVector& sel = *block.selection_vector();
+  if (column_idx_ == -1) {
+    count_ += sel.CountSelected();
+    return;
+  }
+
+  ColumnBlock column = block.column_block(column_idx_);
+  if (function_ == ScanAggregatePB::COUNT && !column.is_nullable()) {
+    count_ += sel.CountSelected();
+    return;
+  }
+
+  switch (column_type_->physical_type()) {
+    case BOOL: return AccumulateColumn<BOOL>(column, sel);
+    case INT8: return AccumulateColumn<INT8>(column, sel);
+    case INT16: return AccumulateColumn<INT16>(column, sel);
+    case INT32: return AccumulateColumn<INT32>(column, sel);
+    case INT64: return AccumulateColumn<INT64>(column, sel);
+    case UINT8: return AccumulateColumn<UINT8>(column, sel);
+    case UINT16: return AccumulateColumn<UINT16>(column, sel);
+    case UINT32: return AccumulateColumn<UINT32>(column, sel);
+    case UINT64: return AccumulateColumn<UINT64>(column, sel);
+    case FLOAT: return AccumulateColumn<FLOAT>(column, sel);
+    case DOUBLE: return AccumulateColumn<DOUBLE>(column, sel);
+    case BINARY: return AccumulateColumn<BINARY>(column, sel);
+    default: LOG(FATAL) << "unknown physical type: " << column_type_->physical_type();
+  }
+}
+
+template <DataType PhysicalType>
+void ScanAggregate::AccumulateColumn(const ColumnBlock& block, const SelectionVector& sel) {
+  for (size_t i = 0; i < block.nrows(); i++) {
+    if (!sel.IsRowSelected(i)) continue;
+    if (block.is_nullable() && block.is_null(i)) continue;
+    AccumulateCell<PhysicalType>(block.cell_ptr(i));
+  }
+}
+
+void ScanAggregate::AccumulateRow(const RowBlock& block, size_t row_idx) {
+  if (column_idx_ == -1) {
+    count_++;
+    return;
+  }
+  ColumnBlock column = block.column_block(column_idx_);
+  if (column.is_nullable() && column.is_null(row_idx)) {
+    return;
+  }
+  AccumulateCellForType(column.cell_ptr(row_idx));
+}
+
+template <DataType PhysicalType>
+void ScanAggregate::AccumulateCell(const void* cell) {
+  typedef typename DataTypeTraits<PhysicalType>::cpp_type T;
+  switch (function_) {
+    case ScanAggregatePB::COUNT:
+      count_++;
+      break;
+    case ScanAggregatePB::SUM:
+      has_value_ = true;
+      AddToSum(*reinterpret_cast<const T*>(cell), &int_sum_, &double_sum_);
+      break;
+    default:
+      UpdateMinMax<PhysicalType>(cell);
+      break;
+  }
+}
+
+void ScanAggregate::AccumulateCellForType(const void* cell) {
+  switch (column_type_->physical_type()) {
+    case BOOL: return AccumulateCell<BOOL>(cell);
+    case INT8: return AccumulateCell<INT8>(cell);
+    case INT16: return AccumulateCell<INT16>(cell);
+    case INT32: return AccumulateCell<INT32>(cell);
+    case INT64: return AccumulateCell<INT64>(cell);
+    case UINT8: return AccumulateCell<UINT8>(cell);
+    case UINT16: return AccumulateCell<UINT16>(cell);
+    case UINT32: return AccumulateCell<UINT32>(cell);
+    case UINT64: return AccumulateCell<UINT64>(cell);
+    case FLOAT: return AccumulateCell<FLOAT>(cell);
+    case DOUBLE: return AccumulateCell<DOUBLE>(cell);
+    case BINARY: return AccumulateCell<BINARY>(cell);
+    default: LOG(FATAL) << "unknown physical type: " << column_type_->physical_type();
+  }
+}
+
+template <DataType PhysicalType>
+void ScanAggregate::UpdateMinMax(const void* cell) {
+  if (has_value_) {
+    Slice binary(min_max_binary_);
+    const void* current = PhysicalType == BINARY ?
+        static_cast<const void*>(&binary) : static_cast<const void*>(min_max_cell_.bytes);
+    int cmp = DataTypeTraits<PhysicalType>::Compare(cell, current);
+    if (function_ == ScanAggregatePB::MIN ? cmp >= 0 : cmp <= 0) {
+      return;
+    }
+  }
+  has_value_ = true;
+  if (PhysicalType == BINARY) {
+    const Slice* s = reinterpret_cast<const Slice*>(cell);
+    min_max_binary_.assign(reinterpret_cast<const char*>(s->data()), s->size());
+  } else {
+    memcpy(min_max_cell_.bytes, cell, sizeof(typename DataTypeTraits<PhysicalType>::cpp_type));
+  }
+}
+
+void ScanAggregate::UpdateMinMaxForType(const void* cell) {
+  switch (column_type_->physical_type()) {
+    case BOOL: return UpdateMinMax<BOOL>(cell);
+    case INT8: return UpdateMinMax<INT8>(cell);
+    case INT16: return UpdateMinMax<INT16>(cell);
+    case INT32: return UpdateMinMax<INT32>(cell);
+    case INT64: return UpdateMinMax<INT64>(cell);
+    case UINT8: return UpdateMinMax<UINT8>(cell);
+    case UINT16: return UpdateMinMax<UINT16>(cell);
+    case UINT32: return UpdateMinMax<UINT32>(cell);
+    case UINT64: return UpdateMinMax<UINT64>(cell);
+    case FLOAT: return UpdateMinMax<FLOAT>(cell);
+    case DOUBLE: return UpdateMinMax<DOUBLE>(cell);
+    case BINARY: return UpdateMinMax<BINARY>(cell);
+    default: LOG(FATAL) << "unknown physical type: " << column_type_->physical_type();
+  }
+}
+
+void ScanAggregate::Merge(const void* cell) {
+  switch (function_) {
+    case ScanAggregatePB::COUNT:
+      DCHECK(cell != nullptr);
+      count_ += *reinterpret_cast<const int64_t*>(cell);
+      return;
+    case ScanAggregatePB::SUM:
+      if (cell == nullptr) return;
+      has_value_ = true;
+      if (IsFloatingPointType(column_type_->type())) {
+        double_sum_ += *reinterpret_cast<const double*>(cell);
+      } else {
+        AddToIntSum(*reinterpret_cast<const int64_t*>(cell), &int_sum_);
+      }
+      return;
+    default:
+      if (cell == nullptr) return;
+      UpdateMinMaxForType(cell);
+      return;
+  }
+}
+
+bool ScanAggregate::GetResult(void* cell) const {
+  if (function_ == ScanAggregatePB::COUNT) {
+    memcpy(cell, &count_, sizeof(count_));
+    return true;
+  }
+  if (!has_value_) {
+    return false;
+  }
+  if (function_ == ScanAggregatePB::SUM) {
+    if (IsFloatingPointType(column_type_->type())) {
+      memcpy(cell, &double_sum_, sizeof(double_sum_));
+    } else {
+      memcpy(cell, &int_sum_, sizeof(int_sum_));
+    }
+  } else if (column_type_->physical_type() == BINARY) {
+    *reinterpret_cast<Slice*>(cell) = Slice(min_max_binary_);
+  } else {
+    memcpy(cell, min_max_cell_.bytes, column_type_->size());
+  }
+  return true;
+}
+
+namespace {
+
+// An estimate of the memory used by an entry of a hash table, besides its
+// key and value.
+const int64_t kHashEntryOverhead = 2 * sizeof(void*);
+
+} // anonymous namespace
+
+ScanGroupBy::ScanGroupBy(vector<GroupColumn> group_columns, vector<ScanAggregate> aggregates)
+    : group_columns_(std::move(group_columns)),
+      aggregates_(std::move(aggregates)),
+      key_size_(0),
+      last_group_idx_(-1),
+      memory_footprint_(0) {
+  for (GroupColumn& col : group_columns_) {
+    col.offset = key_size_;
+    if (col.schema.is_nullable()) {
+      key_size_++;
+    }
+    const TypeInfo* type = col.schema.type_info();
+    key_size_ += type->physical_type() == BINARY ? sizeof(uint32_t) : type->size();
+  }
+  key_buf_.reserve(key_size_);
+}
+
+Status ScanGroupBy::Create(const vector<string>& group_columns, const Schema& projection,
+                           vector<ScanAggregate> aggregates, unique_ptr<ScanGroupBy>* group_by) {
+  vector<GroupColumn> cols;
+  for (const string& name : group_columns) {
+    int idx = projection.find_column(name);
+    if (idx == Schema::kColumnNotFound) {
+      return Status::InvalidArgument(Substitute(
+          "Grouping column $0 is not part of the projection", name));
+    }
+    for (const GroupColumn& col : cols) {
+      if (col.column_idx == idx) {
+        return Status::InvalidArgument(Substitute("Duplicate grouping column $0", name));
+      }
+    }
+    cols.push_back(GroupColumn{ idx, projection.column(idx), 0, {}, {}, -1 });
+  }
+  group_by->reset(new ScanGroupBy(std::move(cols), std::move(aggregates)));
+  return Status::OK();
+}
+
+unique_ptr<ScanGroupBy> ScanGroupBy::CloneEmpty() const {
+  vector<GroupColumn> cols;
+  cols.reserve(group_columns_.size());
+  for (const GroupColumn& col : group_columns_) {
+    cols.push_back(GroupColumn{ col.column_idx, col.schema, 0, {}, {}, -1 });
+  }
+  return unique_ptr<ScanGroupBy>(new ScanGroupBy(std::move(cols), aggregates_));
+}
+
+Status ScanGroupBy::ResultSchema(Schema* schema) const {
+  vector<ColumnSchema> columns;
+  columns.reserve(group_columns_.size() + aggregates_.size());
+  for (const GroupColumn& col : group_columns_) {
+    columns.push_back(col.schema);
+  }
+  for (const ScanAggregate& aggregate : aggregates_) {
+    columns.push_back(aggregate.ResultColumn());
+  }
+  return schema->Reset(columns, 0);
+}
+
+void ScanGroupBy::AppendToKey(const void* cell, GroupColumn* col, string* key) {
+  const TypeInfo* type = col->schema.type_info();
+  if (col->schema.is_nullable()) {
+    key->push_back(cell == nullptr ? 1 : 0);
+  }
+  if (type->physical_type() != BINARY) {
+    if (cell == nullptr) {
+      key->append(type->size(), '\0');
+    } else {
+      key->append(reinterpret_cast<const char*>(cell), type->size());
+    }
+    return;
+  }
+
+  uint32_t code = 0;
+  if (cell != nullptr) {
+    const Slice* s = reinterpret_cast<const Slice*>(cell);
+    StringPiece value(reinterpret_cast<const char*>(s->data()), s->size());
+    if (col->last_code != -1 && col->values[col->last_code] == value) {
+      code = col->last_code;
+    } else {
+      uint32_t* existing = FindOrNull(col->codes, value);
+      if (existing) {
+        code = *existing;
+      } else {
+        code = col->values.size();
+        col->values.emplace_back(value.data(), value.size());
+        InsertOrDie(&col->codes, StringPiece(col->values.back()), code);
+        memory_footprint_ += sizeof(string) + value.size() +
+            sizeof(StringPiece) + sizeof(uint32_t) + kHashEntryOverhead;
+      }
+      col->last_code = code;
+    }
+  }
+  key->append(reinterpret_cast<const char*>(&code), sizeof(code));
+}
+
+size_t ScanGroupBy::FindOrAddGroup(const string& key) {
+  DCHECK_EQ(key_size_, key.size());
+  if (last_group_idx_ != -1 && groups_[last_group_idx_].key == key) {
+    return last_group_idx_;
+  }
+  auto result = group_idx_by_key_.emplace(key, groups_.size());
+  if (result.second) {
+    groups_.push_back({ key, aggregates_ });
+    memory_footprint_ += sizeof(Group) + aggregates_.size() * sizeof(ScanAggregate) +
+        sizeof(string) + sizeof(size_t) + kHashEntryOverhead + 2 * key.size();
+  }
+  last_group_idx_ = result.first->second;
+  return last_group_idx_;
+}
+
+void ScanGroupBy::Accumulate(const RowBlock& block) {
+  vector<ColumnBlock> columns;
+  columns.reserve(group_columns_.size());
+  for (const GroupColumn& col : group_columns_) {
+    columns.push_back(block.column_block(col.column_idx));
+  }
+  const SelectionVector& sel = *block.selection_vector();
+  for (size_t i = 0; i < block.nrows(); i++) {
+    if (!sel.IsRowSelected(i)) continue;
+    key_buf_.clear();
+    for (int c = 0; c < group_columns_.size(); c++) {
+      const ColumnBlock& column = columns[c];
+      const void* cell = column.is_nullable() && column.is_null(i) ? nullptr : column.cell_ptr(i);
+      AppendToKey(cell, &group_columns_[c], &key_buf_);
+    }
+    Group& group = groups_[FindOrAddGroup(key_buf_)];
+    for (ScanAggregate& aggregate : group.aggregates) {
+      aggregate.AccumulateRow(block, i);
+    }
+  }
+}
+
+void ScanGroupBy::Merge(const vector<const void*>& cells) {
+  DCHECK_EQ(group_columns_.size() + aggregates_.size(), cells.size());
+  key_buf_.clear();
+  for (int c = 0; c < group_columns_.size(); c++) {
+    AppendToKey(cells[c], &group_columns_[c], &key_buf_);
+  }
+  Group& group = groups_[FindOrAddGroup(key_buf_)];
+  for (int i = 0; i < group.aggregates.size(); i++) {
+    group.aggregates[i].Merge(cells[group_columns_.size() + i]);
+  }
+}
+
+bool ScanGroupBy::GetResult(size_t group_idx, int col_idx, void* cell) const {
+  const Group& group = groups_[group_idx];
+  if (col_idx >= group_columns_.size()) {
+    return group.aggregates[col_idx - group_columns_.size()].GetResult(cell);
+  }
+  const GroupColumn& col = group_columns_[col_idx];
+  const char* value = group.key.data() + col.offset;
+  if (col.schema.is_nullable()) {
+    if (*value) {
+      return false;
+    }
+    value++;
+  }
+  if (col.schema.type_info()->physical_type() == BINARY) {
+    uint32_t code;
+    memcpy(&code, value, sizeof(code));
+    *reinterpret_cast<Slice*>(cell) = Slice(col.values[code]);
+  } else {
+    memcpy(cell, value, col.schema.type_info()->size());
+  }
+  return true;
+}
+
+} // namespace kudu
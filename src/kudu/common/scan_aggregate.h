@@ -0,0 +1,269 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kudu/common/common.pb.h"
+#include "kudu/common/schema.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/strings/stringpiece.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class ColumnBlock;
+class RowBlock;
+class SelectionVector;
+
+// An aggregate function (COUNT, MIN, MAX or SUM) evaluated over the rows
+// matched by a scan.
+//
+// Aggregates are evaluated in two phases. The tablet server accumulates the
+// rows it scans while serving a single scan RPC, and returns the partial
+// result as a single row of the aggregate result schema (see ResultSchema()).
+// The client merges the partial results of every scan RPC to every tablet.
+//
+// The results have the following types:
+//   COUNT: a non-nullable INT64.
+//   MIN, MAX: the type of the aggregated column.
+//   SUM: INT64 for integer columns (which wraps on overflow), and DOUBLE for
+//        floating point columns.
+// MIN, MAX and SUM are NULL if there were no non-null values to aggregate.
+class ScanAggregate {
+ public:
+  // Creates the aggregate described by 'pb', whose column is looked up in
+  // 'projection', and appends it to 'aggregates'.
+  static Status FromPB(const ScanAggregatePB& pb, const Schema& projection,
+                       std::vector<ScanAggregate>* aggregates);
+
+  // Builds the schema of the row in which the partial and final results of
+  // 'aggregates' are returned, with one column per aggregate.
+  static Status ResultSchema(const std::vector<ScanAggregate>& aggregates, Schema* schema);
+
+  ScanAggregatePB::Function function() const {
+    return function_;
+  }
+
+  // The index of the aggregated column in the projection, or -1 for COUNT(*).
+  int column_idx() const {
+    return column_idx_;
+  }
+
+  // Returns the column of the result schema for this aggregate.
+  ColumnSchema ResultColumn() const;
+
+  // Discards everything accumulated or merged so far.
+  void Reset();
+
+  // Accumulates the selected rows of 'block'. The block's schema must begin
+  // with the columns of the projection the aggregate was created from.
+  void Accumulate(const RowBlock& block);
+
+  // Accumulates the row at index 'row_idx' of 'block', regardless of whether
+  // it is selected.
+  void AccumulateRow(const RowBlock& block, size_t row_idx);
+
+  // Merges a partial result, which is a cell of ResultColumn()'s type, or
+  // nullptr if the partial result is NULL.
+  void Merge(const void* cell);
+
+  // Writes the result into 'cell', which must have room for a value of
+  // ResultColumn()'s type. Returns false, without modifying 'cell', if the
+  // result is NULL.
+  //
+  // BINARY results point into this object and are valid until it is next
+  // modified.
+  bool GetResult(void* cell) const;
+
+ private:
+  ScanAggregate(ScanAggregatePB::Function function, int column_idx,
+                const TypeInfo* column_type, std::string result_name);
+
+  // Accumulates the selected non-null cells of 'block'.
+  template <DataType PhysicalType>
+  void AccumulateColumn(const ColumnBlock& block, const SelectionVector& sel);
+
+  // Accumulates a non-null 'cell' of the aggregated column.
+  template <DataType PhysicalType>
+  void AccumulateCell(const void* cell);
+
+  // Calls AccumulateCell() for the physical type of the aggregated column.
+  void AccumulateCellForType(const void* cell);
+
+  // Updates the MIN or MAX with a non-null 'cell'.
+  template <DataType PhysicalType>
+  void UpdateMinMax(const void* cell);
+
+  // Calls UpdateMinMax() for the physical type of the aggregated column.
+  void UpdateMinMaxForType(const void* cell);
+
+  ScanAggregatePB::Function function_;
+  int column_idx_;
+
+  // The logical type of the aggregated column, or nullptr for COUNT(*).
+  const TypeInfo* column_type_;
+
+  std::string result_name_;
+
+  // Whether a non-null value has been accumulated for MIN, MAX or SUM.
+  bool has_value_;
+
+  int64_t count_;
+  int64_t int_sum_;
+  double double_sum_;
+
+  // The current MIN or MAX. Fixed-width values are stored in 'min_max_cell_'
+  // and BINARY values in 'min_max_binary_'.
+  union {
+    int64_t i;
+    double d;
+    uint8_t bytes[sizeof(int64_t)];
+  } min_max_cell_;
+  std::string min_max_binary_;
+};
+
+// Aggregates evaluated separately over each group of the rows with equal
+// values of some grouping columns, as with GROUP BY.
+//
+// As with ungrouped aggregates, the tablet server accumulates the rows it
+// scans while serving a single scan RPC, and returns the partial results of
+// every group it saw, one row of the result schema (see ResultSchema()) per
+// group. The client merges the partial results of the groups returned by
+// every scan RPC to every tablet.
+//
+// The groups are kept in a hash table keyed by the fixed-width tuple of the
+// grouping values of their rows. BINARY grouping values are replaced in the
+// tuple by their code in a dictionary of the distinct values of the column,
+// so that the tuples of rows grouped by low-cardinality string columns are
+// small and cheap to compare. Runs of rows with the same grouping values,
+// common in sorted or low-cardinality data, are accumulated into their group
+// without any lookup.
+class ScanGroupBy {
+ public:
+  // Creates the grouping of 'aggregates' by 'group_columns', which are
+  // looked up in 'projection'.
+  static Status Create(const std::vector<std::string>& group_columns,
+                       const Schema& projection,
+                       std::vector<ScanAggregate> aggregates,
+                       std::unique_ptr<ScanGroupBy>* group_by);
+
+  // Returns a grouping of the same aggregates by the same columns, without
+  // any of the groups accumulated or merged so far.
+  std::unique_ptr<ScanGroupBy> CloneEmpty() const;
+
+  // Builds the schema of the rows in which the partial and final results of
+  // the groups are returned: the grouping columns, followed by one column
+  // per aggregate as with ScanAggregate::ResultSchema().
+  Status ResultSchema(Schema* schema) const;
+
+  int num_group_columns() const {
+    return group_columns_.size();
+  }
+
+  // Accumulates the selected rows of 'block' into their groups. The block's
+  // schema must begin with the columns of the projection the grouping was
+  // created from.
+  void Accumulate(const RowBlock& block);
+
+  // Merges the partial results of a group, given as the cells of a row of
+  // the result schema, with nullptr for NULL cells.
+  void Merge(const std::vector<const void*>& cells);
+
+  // Returns the number of groups accumulated or merged so far.
+  size_t num_groups() const {
+    return groups_.size();
+  }
+
+  // Writes the cell of column 'col_idx' of the result schema for the group
+  // at index 'group_idx' into 'cell', which must have room for a value of
+  // the column's type. Returns false, without modifying 'cell', if the cell
+  // is NULL.
+  //
+  // BINARY results point into this object and are valid until it is next
+  // modified.
+  bool GetResult(size_t group_idx, int col_idx, void* cell) const;
+
+  // Returns an estimate of the memory used by the groups.
+  int64_t memory_footprint() const {
+    return memory_footprint_;
+  }
+
+ private:
+  struct GroupColumn {
+    // The column in the projection, and its schema.
+    int column_idx;
+    ColumnSchema schema;
+
+    // The offset of the column's value in the tuples of grouping values. The
+    // value is preceded by a null byte if the column is nullable.
+    size_t offset;
+
+    // For BINARY columns, the distinct values seen so far, numbered by
+    // their code, and the code of each value.
+    std::deque<std::string> values;
+    std::unordered_map<StringPiece, uint32_t, GoodFastHash<StringPiece>> codes;
+
+    // The code of the BINARY value of the previous row, or -1.
+    int64_t last_code;
+  };
+
+  struct Group {
+    std::string key;
+    std::vector<ScanAggregate> aggregates;
+  };
+
+  ScanGroupBy(std::vector<GroupColumn> group_columns, std::vector<ScanAggregate> aggregates);
+
+  // Appends the value of 'cell' (nullptr for NULL) of 'col' to the tuple of
+  // grouping values in 'key'.
+  void AppendToKey(const void* cell, GroupColumn* col, std::string* key);
+
+  // Returns the index of the group with tuple 'key', adding it if it's new.
+  size_t FindOrAddGroup(const std::string& key);
+
+  std::vector<GroupColumn> group_columns_;
+
+  // The aggregates of every group, as created: nothing is accumulated into
+  // these.
+  const std::vector<ScanAggregate> aggregates_;
+
+  // The size of the tuples of grouping values.
+  size_t key_size_;
+
+  std::vector<Group> groups_;
+  std::unordered_map<std::string, size_t> group_idx_by_key_;
+
+  // The index of the group to which the previous row belonged, or -1.
+  int64_t last_group_idx_;
+
+  // Scratch space for the tuple of the current row.
+  std::string key_buf_;
+
+  int64_t memory_footprint_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanGroupBy);
+};
+
+} // namespace kudu
@@ -70,6 +70,21 @@ class TestScanSpec : public KuduTest {
     }
   }
 
+  template<class T>
+  void AddInPredicate(ScanSpec* spec, StringPiece col, const vector<T>& values) {
+    int idx = schema_.find_column(col);
+    CHECK(idx != Schema::kColumnNotFound);
+
+    vector<const void*> copied_values;
+    for (const T& val : values) {
+      void* val_void = arena_.AllocateBytes(sizeof(val));
+      memcpy(val_void, &val, sizeof(val));
+      copied_values.push_back(val_void);
+    }
+
+    spec->AddPredicate(ColumnPredicate::InList(schema_.column(idx), &copied_values));
+  }
+
   // Set the lower bound of the spec to the provided row. The row must outlive
   // the spec.
   void SetLowerBound(ScanSpec* spec, const KuduPartialRow& row) {
@@ -207,6 +222,43 @@ TEST_F(CompositeIntKeysTest, TestEqualityAndConsecutiveRangePredicates) {
             "`c` >= 5 AND `c` < 16", spec.ToString(schema_));
 }
 
+// Predicate: a IN (5, 1, 3)
+TEST_F(CompositeIntKeysTest, TestPrefixInList) {
+  ScanSpec spec;
+  AddInPredicate<int8_t>(&spec, "a", { 5, 1, 3 });
+  SCOPED_TRACE(spec.ToString(schema_));
+  spec.OptimizeScan(schema_, &arena_, &pool_, true);
+
+  // The IN list bounds the primary key, but must still be evaluated.
+  EXPECT_EQ("PK >= (int8 a=1, int8 b=-128, int8 c=-128) AND "
+            "PK < (int8 a=6, int8 b=-128, int8 c=-128) AND "
+            "`a` IN (1, 3, 5)",
+            spec.ToString(schema_));
+}
+
+// Predicates: a = 3 AND b IN (10, 4)
+TEST_F(CompositeIntKeysTest, TestEqualityAndInList) {
+  ScanSpec spec;
+  AddPredicate<int8_t>(&spec, "a", EQ, 3);
+  AddInPredicate<int8_t>(&spec, "b", { 10, 4 });
+  SCOPED_TRACE(spec.ToString(schema_));
+  spec.OptimizeScan(schema_, &arena_, &pool_, true);
+  EXPECT_EQ("PK >= (int8 a=3, int8 b=4, int8 c=-128) AND "
+            "PK < (int8 a=3, int8 b=11, int8 c=-128) AND "
+            "`b` IN (4, 10)",
+            spec.ToString(schema_));
+}
+
+// Predicates: b IN (1, 2, 3) AND b >= 2
+TEST_F(CompositeIntKeysTest, TestInListAndRange) {
+  ScanSpec spec;
+  AddInPredicate<int8_t>(&spec, "b", { 1, 2, 3 });
+  AddPredicate<int8_t>(&spec, "b", GE, 2);
+  SCOPED_TRACE(spec.ToString(schema_));
+  spec.OptimizeScan(schema_, &arena_, &pool_, true);
+  EXPECT_EQ("`b` IN (2, 3)", spec.ToString(schema_));
+}
+
 // Test a predicate on a non-prefix part of the key. Can't be pushed.
 //
 // Predicate: b == 64
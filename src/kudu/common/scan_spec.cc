@@ -27,6 +27,7 @@
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/join.h"
 #include "kudu/util/auto_release_pool.h"
+#include "kudu/util/hash_util.h"
 
 using std::any_of;
 using std::max;
@@ -36,6 +37,15 @@ using std::vector;
 
 namespace kudu {
 
+bool ScanSample::Samples(const Slice& unit) const {
+  if (!is_sampled()) {
+    return true;
+  }
+  uint64_t h = HashUtil::MurmurHash2_64(unit.data(), unit.size(), seed);
+  // Compare the top 53 bits, which a double represents exactly, to the rate.
+  return static_cast<double>(h >> 11) < rate * static_cast<double>(1ULL << 53);
+}
+
 void ScanSpec::AddPredicate(ColumnPredicate pred) {
   ColumnPredicate* predicate = FindOrNull(predicates_, pred.column().name());
   if (predicate != nullptr) {
@@ -144,7 +154,10 @@ void ScanSpec::PushPredicatesIntoPrimaryKeyBounds(const Schema& schema,
       predicates_, &upper_key, arena);
 
   // Step 2: Erase pushed predicates
-  // Predicates through the first range predicate may be erased.
+  // Predicates through the first range predicate may be erased. IN list and
+  // IN bloom filter predicates are only loosely bounded by the primary key
+  // bounds, so they must be retained, and no further predicates may be erased
+  // after them.
   if (remove_pushed_predicates) {
     for (int32_t col_idx = 0;
          col_idx < max(lower_bound_predicates_pushed, upper_bound_predicates_pushed);
@@ -156,6 +169,8 @@ void ScanSpec::PushPredicatesIntoPrimaryKeyBounds(const Schema& schema,
       } else if (type == PredicateType::Range) {
         RemovePredicate(column);
         break;
+      } else if (type == PredicateType::InList || type == PredicateType::InBloomFilter) {
+        break;
       } else {
         LOG(FATAL) << "Can not remove unknown predicate type";
       }
@@ -17,6 +17,9 @@
 #ifndef KUDU_COMMON_SCAN_SPEC_H
 #define KUDU_COMMON_SCAN_SPEC_H
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <unordered_map>
 
@@ -28,6 +31,36 @@ namespace kudu {
 
 class AutoReleasePool;
 class Arena;
+class MemTracker;
+
+// The sampling of a scan: each run of rows is scanned with probability
+// 'rate', as chosen by a hash of the run's identity seeded with 'seed'.
+struct ScanSample {
+  double rate = 1;
+  uint64_t seed = 0;
+
+  bool is_sampled() const {
+    return rate < 1;
+  }
+
+  // Returns whether the run of rows identified by 'unit' is scanned. The
+  // choice only depends on 'unit', the rate and the seed.
+  bool Samples(const Slice& unit) const;
+};
+
+// The rows considered and sampled by the iterators of a sampled scan.
+struct ScanSamplingStats {
+  std::atomic<int64_t> rows_considered { 0 };
+  std::atomic<int64_t> rows_sampled { 0 };
+
+  // The fraction of the rows considered which were sampled, or 1 if no rows
+  // were considered yet.
+  double effective_rate() const {
+    int64_t considered = rows_considered.load(std::memory_order_relaxed);
+    return considered == 0 ? 1 :
+        static_cast<double>(rows_sampled.load(std::memory_order_relaxed)) / considered;
+  }
+};
 
 class ScanSpec {
  public:
@@ -118,6 +151,40 @@ class ScanSpec {
     cache_blocks_ = cache_blocks;
   }
 
+  // The tracker charged for the data blocks read ahead of the scan, whose
+  // limit bounds the memory they hold. NULL if blocks are not read ahead.
+  //
+  // Only used on the server.
+  const std::shared_ptr<MemTracker>& readahead_mem_tracker() const {
+    return readahead_mem_tracker_;
+  }
+
+  void set_readahead_mem_tracker(std::shared_ptr<MemTracker> mem_tracker) {
+    readahead_mem_tracker_ = std::move(mem_tracker);
+  }
+
+  // The sampling of the scan, whose rate is 1 if the scan isn't sampled.
+  // Iterators which don't support sampling ignore it.
+  const ScanSample& sample() const {
+    return sample_;
+  }
+
+  void set_sample(ScanSample sample) {
+    sample_ = sample;
+  }
+
+  // Where the iterators of a sampled scan count the rows they consider and
+  // sample. May be NULL.
+  //
+  // Only used on the server.
+  const std::shared_ptr<ScanSamplingStats>& sampling_stats() const {
+    return sampling_stats_;
+  }
+
+  void set_sampling_stats(std::shared_ptr<ScanSamplingStats> stats) {
+    sampling_stats_ = std::move(stats);
+  }
+
   std::string ToString(const Schema& s) const;
 
  private:
@@ -148,6 +215,9 @@ class ScanSpec {
   std::string lower_bound_partition_key_;
   std::string exclusive_upper_bound_partition_key_;
   bool cache_blocks_;
+  std::shared_ptr<MemTracker> readahead_mem_tracker_;
+  ScanSample sample_;
+  std::shared_ptr<ScanSamplingStats> sampling_stats_;
 };
 
 } // namespace kudu
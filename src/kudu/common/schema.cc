@@ -46,10 +46,39 @@ static const ColumnId  kFirstColumnId(10);
 #endif
 
 string ColumnStorageAttributes::ToString() const {
-  return strings::Substitute("encoding=$0, compression=$1, cfile_block_size=$2",
+  return strings::Substitute("encoding=$0, compression=$1, cfile_block_size=$2, "
+                             "compression_level=$3, bloom_filter=$4",
                              EncodingType_Name(encoding),
                              CompressionType_Name(compression),
-                             cfile_block_size);
+                             cfile_block_size,
+                             compression_level,
+                             bloom_filter);
+}
+
+Status ColumnTypeAttributes::Validate(DataType type) const {
+  if (!IsDecimalType(type)) {
+    if (precision != 0 || scale != 0) {
+      return Status::InvalidArgument(
+          strings::Substitute("precision and scale are only valid for decimals, not $0",
+                              DataType_Name(type)));
+    }
+    return Status::OK();
+  }
+  int max_precision = type == DECIMAL32 ? kMaxDecimal32Precision : kMaxDecimal64Precision;
+  if (precision < 1 || precision > max_precision) {
+    return Status::InvalidArgument(
+        strings::Substitute("invalid precision $0 for $1: must be between 1 and $2",
+                            precision, DataType_Name(type), max_precision));
+  }
+  if (scale < 0 || scale > precision) {
+    return Status::InvalidArgument(
+        strings::Substitute("invalid scale $0 for decimal with precision $1", scale, precision));
+  }
+  return Status::OK();
+}
+
+string ColumnTypeAttributes::ToString() const {
+  return strings::Substitute("($0, $1)", precision, scale);
 }
 
 // TODO: include attributes_.ToString() -- need to fix unit tests
@@ -61,11 +90,27 @@ string ColumnSchema::ToString() const {
 }
 
 string ColumnSchema::TypeToString() const {
-  return strings::Substitute("$0 $1",
+  return strings::Substitute("$0$1 $2",
                              type_info_->name(),
+                             IsDecimalType(type_info_->type()) ? type_attributes_.ToString() : "",
                              is_nullable_ ? "NULLABLE" : "NOT NULL");
 }
 
+void ColumnSchema::AppendDebugStringForValue(const void* cell, string* ret) const {
+  switch (type_info_->type()) {
+    case DECIMAL32:
+      ret->append(DecimalToString(*reinterpret_cast<const int32_t*>(cell),
+                                  type_attributes_.scale));
+      break;
+    case DECIMAL64:
+      ret->append(DecimalToString(*reinterpret_cast<const int64_t*>(cell),
+                                  type_attributes_.scale));
+      break;
+    default:
+      type_info_->AppendDebugStringForValue(cell, ret);
+  }
+}
+
 size_t ColumnSchema::memory_footprint_excluding_this() const {
   // Rough approximation.
   return name_.capacity();
@@ -109,6 +154,7 @@ void Schema::CopyFrom(const Schema& other) {
   }
 
   has_nullables_ = other.has_nullables_;
+  key_encoders_ = other.key_encoders_;
 }
 
 void Schema::swap(Schema& other) {
@@ -119,6 +165,7 @@ void Schema::swap(Schema& other) {
   name_to_index_.swap(other.name_to_index_);
   id_to_index_.swap(other.id_to_index_);
   std::swap(has_nullables_, other.has_nullables_);
+  key_encoders_.swap(other.key_encoders_);
 }
 
 Status Schema::Reset(const vector<ColumnSchema>& cols,
@@ -161,6 +208,16 @@ Status Schema::Reset(const vector<ColumnSchema>& cols,
     if (!InsertIfNotPresent(&name_to_index_, col.name(), i++)) {
       return Status::InvalidArgument("Duplicate column name", col.name());
     }
+    RETURN_NOT_OK_PREPEND(col.type_attributes().Validate(col.type_info()->type()),
+                          strings::Substitute("Bad schema for column $0", col.name()));
+    // Floating point values which compare equal, like 0.0 and -0.0, don't
+    // hash equally.
+    DataType physical_type = col.type_info()->physical_type();
+    if (col.attributes().bloom_filter && (physical_type == FLOAT || physical_type == DOUBLE)) {
+      return Status::InvalidArgument(
+          strings::Substitute("Bad schema for column $0", col.name()),
+          "bloom filters are not supported for floating point columns");
+    }
 
     col_offsets_.push_back(off);
     off += col.type_info()->size();
@@ -190,6 +247,12 @@ Status Schema::Reset(const vector<ColumnSchema>& cols,
     }
   }
 
+  key_encoders_.clear();
+  for (int i = 0; i < key_columns; ++i) {
+    const TypeInfo* ti = cols_[i].type_info();
+    key_encoders_.push_back(IsTypeAllowableInKey(ti) ? &GetKeyEncoder<faststring>(ti) : nullptr);
+  }
+
   return Status::OK();
 }
 
@@ -318,9 +381,8 @@ Status Schema::DecodeRowKey(Slice encoded_key,
 
   for (size_t col_idx = 0; col_idx < num_key_columns(); ++col_idx) {
     const ColumnSchema& col = column(col_idx);
-    const KeyEncoder<faststring>& key_encoder = GetKeyEncoder<faststring>(col.type_info());
     bool is_last = col_idx == (num_key_columns() - 1);
-    RETURN_NOT_OK_PREPEND(key_encoder.Decode(&encoded_key,
+    RETURN_NOT_OK_PREPEND(key_encoder(col_idx).Decode(&encoded_key,
                                              is_last,
                                              arena,
                                              row.mutable_cell_ptr(col_idx)),
@@ -85,13 +85,17 @@ struct ColumnStorageAttributes {
   ColumnStorageAttributes()
     : encoding(AUTO_ENCODING),
       compression(DEFAULT_COMPRESSION),
-      cfile_block_size(0) {
+      cfile_block_size(0),
+      compression_level(0),
+      bloom_filter(false) {
   }
 
   ColumnStorageAttributes(EncodingType enc, CompressionType cmp)
     : encoding(enc),
       compression(cmp),
-      cfile_block_size(0) {
+      cfile_block_size(0),
+      compression_level(0),
+      bloom_filter(false) {
   }
 
   string ToString() const;
@@ -102,6 +106,44 @@ struct ColumnStorageAttributes {
   // The preferred block size for cfile blocks. If 0, uses the
   // server-wide default.
   int32_t cfile_block_size;
+
+  // The compression level passed to codecs which support one (currently
+  // only ZSTD). If 0, uses the codec's default level.
+  int32_t compression_level;
+
+  // Whether each CFile of the column has a bloom filter of its values, which
+  // scans use to skip the files which can't match an equality or IN-list
+  // predicate. Not supported for floating point columns.
+  bool bloom_filter;
+};
+
+// Attributes which complete the type of a column, for the types which need
+// them. Currently only decimals do, with their precision and scale.
+struct ColumnTypeAttributes {
+ public:
+  ColumnTypeAttributes()
+    : precision(0),
+      scale(0) {
+  }
+
+  ColumnTypeAttributes(int32_t precision, int32_t scale)
+    : precision(precision),
+      scale(scale) {
+  }
+
+  bool operator==(const ColumnTypeAttributes& other) const {
+    return precision == other.precision && scale == other.scale;
+  }
+
+  // Returns an error unless the attributes are valid for a column of 'type'.
+  Status Validate(DataType type) const;
+
+  string ToString() const;
+
+  // The total number of decimal digits, and the number of them after the
+  // decimal point.
+  int32_t precision;
+  int32_t scale;
 };
 
 // The schema for a given column.
@@ -129,12 +171,14 @@ class ColumnSchema {
   ColumnSchema(string name, DataType type, bool is_nullable = false,
                const void* read_default = NULL,
                const void* write_default = NULL,
-               ColumnStorageAttributes attributes = ColumnStorageAttributes())
+               ColumnStorageAttributes attributes = ColumnStorageAttributes(),
+               ColumnTypeAttributes type_attributes = ColumnTypeAttributes())
       : name_(std::move(name)),
         type_info_(GetTypeInfo(type)),
         is_nullable_(is_nullable),
         read_default_(read_default ? new Variant(type, read_default) : NULL),
-        attributes_(std::move(attributes)) {
+        attributes_(std::move(attributes)),
+        type_attributes_(type_attributes) {
     if (write_default == read_default) {
       write_default_ = read_default_;
     } else if (write_default != NULL) {
@@ -208,7 +252,8 @@ class ColumnSchema {
 
   bool EqualsType(const ColumnSchema &other) const {
     return is_nullable_ == other.is_nullable_ &&
-           type_info()->type() == other.type_info()->type();
+           type_info()->type() == other.type_info()->type() &&
+           type_attributes_ == other.type_attributes_;
   }
 
   bool Equals(const ColumnSchema &other, bool check_defaults) const {
@@ -242,6 +287,12 @@ class ColumnSchema {
     return attributes_;
   }
 
+  // Returns the attributes completing the column's type, such as the
+  // precision and scale of decimals.
+  const ColumnTypeAttributes& type_attributes() const {
+    return type_attributes_;
+  }
+
   int Compare(const void *lhs, const void *rhs) const {
     return type_info_->Compare(lhs, rhs);
   }
@@ -250,7 +301,7 @@ class ColumnSchema {
   // and doesn't include the column name or type.
   string Stringify(const void *cell) const {
     string ret;
-    type_info_->AppendDebugStringForValue(cell, &ret);
+    AppendDebugStringForValue(cell, &ret);
     return ret;
   }
 
@@ -265,7 +316,7 @@ class ColumnSchema {
     if (is_nullable_ && cell.is_null()) {
       ret->append("NULL");
     } else {
-      type_info_->AppendDebugStringForValue(cell.ptr(), ret);
+      AppendDebugStringForValue(cell.ptr(), ret);
     }
   }
 
@@ -284,6 +335,10 @@ class ColumnSchema {
     name_ = name;
   }
 
+  // Like TypeInfo::AppendDebugStringForValue(), but formats decimals with
+  // their scale.
+  void AppendDebugStringForValue(const void* cell, string* ret) const;
+
   string name_;
   const TypeInfo *type_info_;
   bool is_nullable_;
@@ -291,6 +346,7 @@ class ColumnSchema {
   std::shared_ptr<Variant> read_default_;
   std::shared_ptr<Variant> write_default_;
   ColumnStorageAttributes attributes_;
+  ColumnTypeAttributes type_attributes_;
 };
 
 class ContiguousRow;
@@ -609,13 +665,21 @@ class Schema {
     dst->clear();
     for (size_t i = 0; i < num_key_columns_; i++) {
       DCHECK(!cols_[i].is_nullable());
-      const TypeInfo* ti = cols_[i].type_info();
       bool is_last = i == num_key_columns_ - 1;
-      GetKeyEncoder<faststring>(ti).Encode(row.cell_ptr(i), is_last, dst);
+      key_encoder(i).Encode(row.cell_ptr(i), is_last, dst);
     }
     return Slice(*dst);
   }
 
+  // Returns the encoder of the key column at 'col_idx'. Encoders are
+  // resolved once per schema rather than once per encoded cell.
+  const KeyEncoder<faststring>& key_encoder(size_t col_idx) const {
+    DCHECK_LT(col_idx, num_key_columns_);
+    DCHECK(key_encoders_[col_idx] != nullptr)
+        << "no key encoder for column " << cols_[col_idx].ToString();
+    return *key_encoders_[col_idx];
+  }
+
   // Stringify this Schema. This is not particularly efficient,
   // so should only be used when necessary for output.
   string ToString() const;
@@ -790,6 +854,10 @@ class Schema {
   // Cached indicator whether any columns are nullable.
   bool has_nullables_;
 
+  // The encoders of the key columns, or null for columns of types which
+  // can't be in keys.
+  vector<const KeyEncoder<faststring>*> key_encoders_;
+
   // NOTE: if you add more members, make sure to add the appropriate
   // code to swap() and CopyFrom() as well to prevent subtle bugs.
 };
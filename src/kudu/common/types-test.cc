@@ -129,4 +129,23 @@ TEST(TestTypes, TestAreConsecutiveString) {
   TestAreConsecutive(STRING, test_cases);
 }
 
+TEST(TestTypes, TestDecimal) {
+  ASSERT_EQ(INT32, GetTypeInfo(DECIMAL32)->physical_type());
+  ASSERT_EQ(INT64, GetTypeInfo(DECIMAL64)->physical_type());
+  ASSERT_EQ(DECIMAL32, DecimalTypeForPrecision(1));
+  ASSERT_EQ(DECIMAL32, DecimalTypeForPrecision(kMaxDecimal32Precision));
+  ASSERT_EQ(DECIMAL64, DecimalTypeForPrecision(kMaxDecimal32Precision + 1));
+  ASSERT_EQ(9, MaxUnscaledDecimal(1));
+  ASSERT_EQ(999999999, MaxUnscaledDecimal(kMaxDecimal32Precision));
+  ASSERT_EQ(999999999999999999LL, MaxUnscaledDecimal(kMaxDecimal64Precision));
+
+  ASSERT_EQ("12345", DecimalToString(12345, 0));
+  ASSERT_EQ("123.45", DecimalToString(12345, 2));
+  ASSERT_EQ("-123.45", DecimalToString(-12345, 2));
+  ASSERT_EQ("0.05", DecimalToString(5, 2));
+  ASSERT_EQ("-0.005", DecimalToString(-5, 3));
+  ASSERT_EQ("0.00", DecimalToString(0, 2));
+  ASSERT_EQ("-9223372036854775808", DecimalToString(MathLimits<int64_t>::kMin, 0));
+}
+
 } // namespace kudu
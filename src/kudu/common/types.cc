@@ -76,6 +76,8 @@ class TypeInfoResolver {
     AddMapping<FLOAT>();
     AddMapping<DOUBLE>();
     AddMapping<BINARY>();
+    AddMapping<DECIMAL32>();
+    AddMapping<DECIMAL64>();
   }
 
   template<DataType type> void AddMapping() {
@@ -95,4 +97,38 @@ const TypeInfo* GetTypeInfo(DataType type) {
   return Singleton<TypeInfoResolver>::get()->GetTypeInfo(type);
 }
 
+DataType DecimalTypeForPrecision(int precision) {
+  DCHECK_GE(precision, 1);
+  DCHECK_LE(precision, kMaxDecimal64Precision);
+  return precision <= kMaxDecimal32Precision ? DECIMAL32 : DECIMAL64;
+}
+
+int64_t MaxUnscaledDecimal(int precision) {
+  DCHECK_GE(precision, 1);
+  DCHECK_LE(precision, kMaxDecimal64Precision);
+  int64_t max = 1;
+  for (int i = 0; i < precision; i++) {
+    max *= 10;
+  }
+  return max - 1;
+}
+
+string DecimalToString(int64_t unscaled, int scale) {
+  DCHECK_GE(scale, 0);
+  // Work on the magnitude as an unsigned value, which can't overflow.
+  uint64_t magnitude = unscaled < 0 ? -static_cast<uint64_t>(unscaled) : unscaled;
+  string digits = SimpleItoa(magnitude);
+  int num_digits = digits.size();
+  if (num_digits <= scale) {
+    digits.insert(0, scale - num_digits + 1, '0');
+  }
+  if (scale > 0) {
+    digits.insert(digits.size() - scale, ".");
+  }
+  if (unscaled < 0) {
+    digits.insert(0, "-");
+  }
+  return digits;
+}
+
 } // namespace kudu
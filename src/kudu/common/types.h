@@ -447,6 +447,43 @@ struct DataTypeTraits<UNIXTIME_MICROS> : public DerivedTypeTraits<INT64>{
   }
 };
 
+// Decimals are stored as their unscaled value. Their scale is a column type
+// attribute, so debug strings of bare values show the unscaled value; see
+// ColumnSchema::Stringify() for the scaled form.
+template<>
+struct DataTypeTraits<DECIMAL32> : public DerivedTypeTraits<INT32>{
+  static const char* name() {
+    return "decimal32";
+  }
+};
+
+template<>
+struct DataTypeTraits<DECIMAL64> : public DerivedTypeTraits<INT64>{
+  static const char* name() {
+    return "decimal64";
+  }
+};
+
+// The largest precision of the decimals stored in each decimal type.
+const int kMaxDecimal32Precision = 9;
+const int kMaxDecimal64Precision = 18;
+
+// Returns true if 'type' is one of the decimal types.
+inline bool IsDecimalType(DataType type) {
+  return type == DECIMAL32 || type == DECIMAL64;
+}
+
+// Returns the type storing decimals of 'precision', which must be between 1
+// and kMaxDecimal64Precision.
+DataType DecimalTypeForPrecision(int precision);
+
+// Returns the largest unscaled value of a decimal of 'precision'.
+int64_t MaxUnscaledDecimal(int precision);
+
+// Returns the decimal with unscaled value 'unscaled' and 'scale' as a
+// string, e.g. "-12.340" for -12340 with a scale of 3.
+string DecimalToString(int64_t unscaled, int scale);
+
 // Instantiate this template to get static access to the type traits.
 template<DataType datatype>
 struct TypeTraits : public DataTypeTraits<datatype> {
@@ -503,6 +540,7 @@ class Variant {
       case UINT16:
         numeric_.u16 = *static_cast<const uint16_t *>(value);
         break;
+      case DECIMAL32:
       case INT32:
         numeric_.i32 = *static_cast<const int32_t *>(value);
         break;
@@ -510,6 +548,7 @@ class Variant {
         numeric_.u32 = *static_cast<const uint32_t *>(value);
         break;
       case UNIXTIME_MICROS:
+      case DECIMAL64:
       case INT64:
         numeric_.i64 = *static_cast<const int64_t *>(value);
         break;
@@ -580,6 +619,8 @@ class Variant {
       case UINT32:       return &(numeric_.u32);
       case INT64:        return &(numeric_.i64);
       case UNIXTIME_MICROS:    return &(numeric_.i64);
+      case DECIMAL32:    return &(numeric_.i32);
+      case DECIMAL64:    return &(numeric_.i64);
       case UINT64:       return &(numeric_.u64);
       case FLOAT:        return (&numeric_.float_val);
       case DOUBLE:       return (&numeric_.double_val);
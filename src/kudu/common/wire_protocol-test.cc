@@ -15,11 +15,14 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <boost/optional.hpp>
 #include <gtest/gtest.h>
 #include "kudu/common/row.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/wire_protocol.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/bitmap.h"
 #include "kudu/util/status.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_macros.h"
@@ -220,6 +223,203 @@ TEST_F(WireProtocolTest, TestColumnarRowBlockToPB) {
   }
 }
 
+// Test that a columnar serialization of several row blocks, with some rows
+// deselected and some cells null, round-trips through the protobuf.
+TEST_F(WireProtocolTest, TestColumnarLayoutRoundTrip) {
+  Arena arena(1024, 1024 * 1024);
+  RowBlock block(schema_, 10, &arena);
+  ColumnarSerializedBatch batch;
+  vector<string> expected_col1;
+  vector<boost::optional<uint32_t>> expected_col3;
+
+  // Serialize the block twice, with different selections and nulls, so that
+  // the second block is appended at a row which is not byte-aligned in the
+  // null bitmap.
+  for (int pass = 0; pass < 2; pass++) {
+    FillRowBlockWithTestRows(&block);
+    for (int i = 0; i < block.nrows(); i++) {
+      if (i % 3 == pass) {
+        block.selection_vector()->SetRowUnselected(i);
+        continue;
+      }
+      RowBlockRow row = block.row(i);
+      bool is_null = i % 4 == 0;
+      row.cell(2).set_null(is_null);
+      expected_col1.push_back("hello world col1");
+      expected_col3.push_back(is_null ? boost::none : boost::optional<uint32_t>(i));
+    }
+    SerializeRowBlockColumnar(block, nullptr, &batch);
+  }
+  ASSERT_EQ(expected_col1.size(), batch.num_rows);
+  ASSERT_EQ(3, batch.columns.size());
+
+  ColumnarRowBlockPB pb;
+  faststring sidecar;
+  FinishColumnarSerializedBatch(batch, &pb, &sidecar);
+  SCOPED_TRACE(pb.DebugString());
+  ASSERT_EQ(batch.num_rows, pb.num_rows());
+
+  vector<ColumnarColumnSlices> columns;
+  ASSERT_OK(ExtractColumnsFromColumnarRowBlockPB(schema_, pb, sidecar, &columns));
+  ASSERT_EQ(3, columns.size());
+  for (const auto& col_pb : pb.columns()) {
+    ASSERT_EQ(0, col_pb.data().offset() % 8);
+  }
+
+  // Check the string column.
+  const uint32_t* offsets = reinterpret_cast<const uint32_t*>(columns[0].data.data());
+  ASSERT_TRUE(columns[0].non_null_bitmap.empty());
+  for (int i = 0; i < expected_col1.size(); i++) {
+    Slice cell(columns[0].varlen_data.data() + offsets[i], offsets[i + 1] - offsets[i]);
+    ASSERT_EQ(expected_col1[i], cell.ToString());
+  }
+
+  // Check the nullable integer column.
+  const uint32_t* cells = reinterpret_cast<const uint32_t*>(columns[2].data.data());
+  ASSERT_TRUE(columns[2].varlen_data.empty());
+  for (int i = 0; i < expected_col3.size(); i++) {
+    bool not_null = BitmapTest(columns[2].non_null_bitmap.data(), i);
+    ASSERT_EQ(static_cast<bool>(expected_col3[i]), not_null) << i;
+    if (not_null) {
+      ASSERT_EQ(*expected_col3[i], cells[i]);
+    }
+  }
+}
+
+// Test that a block whose rows were all filtered out, as is common in a
+// selective scan, adds nothing to the string columns' offsets.
+TEST_F(WireProtocolTest, TestColumnarLayoutSkipsFilteredBlock) {
+  Arena arena(1024, 1024 * 1024);
+  RowBlock block(schema_, 10, &arena);
+  ColumnarSerializedBatch batch;
+
+  FillRowBlockWithTestRows(&block);
+  block.selection_vector()->SetAllFalse();
+  SerializeRowBlockColumnar(block, nullptr, &batch);
+  ASSERT_EQ(0, batch.num_rows);
+  FillRowBlockWithTestRows(&block);
+  SerializeRowBlockColumnar(block, nullptr, &batch);
+  ASSERT_EQ(block.nrows(), batch.num_rows);
+
+  ColumnarRowBlockPB pb;
+  faststring sidecar;
+  FinishColumnarSerializedBatch(batch, &pb, &sidecar);
+  vector<ColumnarColumnSlices> columns;
+  ASSERT_OK(ExtractColumnsFromColumnarRowBlockPB(schema_, pb, sidecar, &columns));
+  ASSERT_EQ((block.nrows() + 1) * sizeof(uint32_t), columns[0].data.size());
+  const uint32_t* offsets = reinterpret_cast<const uint32_t*>(columns[0].data.data());
+  for (int i = 0; i < block.nrows(); i++) {
+    Slice cell(columns[0].varlen_data.data() + offsets[i], offsets[i + 1] - offsets[i]);
+    ASSERT_EQ("hello world col1", cell.ToString());
+  }
+}
+
+// Test that a dictionary-encoded columnar serialization keeps the dictionary
+// of a column with few distinct values, falls back to the plain layout for a
+// column of unique values, and decodes to the original cells.
+TEST_F(WireProtocolTest, TestColumnarDictionaryRoundTrip) {
+  Schema schema({ ColumnSchema("key", INT32),
+                  ColumnSchema("low", STRING, true /* nullable */),
+                  ColumnSchema("high", STRING) },
+                1);
+  const int kNumRows = 2000;
+  Arena arena(1024, 1024 * 1024);
+  RowBlock block(schema, kNumRows, &arena);
+  block.selection_vector()->SetAllTrue();
+  vector<boost::optional<string>> expected_low;
+  vector<string> expected_high;
+  for (int i = 0; i < kNumRows; i++) {
+    RowBlockRow row = block.row(i);
+    string low = strings::Substitute("value-$0", i % 5);
+    string high = strings::Substitute("unique-$0", i);
+    Slice low_cell, high_cell;
+    CHECK(arena.RelocateSlice(low, &low_cell));
+    CHECK(arena.RelocateSlice(high, &high_cell));
+    *reinterpret_cast<int32_t*>(row.mutable_cell_ptr(0)) = i;
+    *reinterpret_cast<Slice*>(row.mutable_cell_ptr(1)) = low_cell;
+    *reinterpret_cast<Slice*>(row.mutable_cell_ptr(2)) = high_cell;
+    bool is_null = i % 4 == 0;
+    row.cell(1).set_null(is_null);
+    if (i % 7 == 0) {
+      block.selection_vector()->SetRowUnselected(i);
+      continue;
+    }
+    expected_low.push_back(is_null ? boost::none : boost::optional<string>(low));
+    expected_high.push_back(high);
+  }
+
+  ColumnarSerializedBatch batch;
+  batch.dictionary_encode = true;
+  SerializeRowBlockColumnar(block, nullptr, &batch);
+  ASSERT_EQ(expected_high.size(), batch.num_rows);
+  ASSERT_TRUE(batch.columns[1]->dict);
+  ASSERT_FALSE(batch.columns[2]->dict);
+  ASSERT_TRUE(batch.columns[2]->dict_abandoned);
+
+  ColumnarRowBlockPB pb;
+  faststring sidecar;
+  FinishColumnarSerializedBatch(batch, &pb, &sidecar);
+  ASSERT_FALSE(pb.columns(0).has_dictionary_offsets());
+  ASSERT_TRUE(pb.columns(1).has_dictionary_offsets());
+  ASSERT_FALSE(pb.columns(2).has_dictionary_offsets());
+
+  vector<ColumnarColumnSlices> columns;
+  ASSERT_OK(ExtractColumnsFromColumnarRowBlockPB(schema, pb, sidecar, &columns));
+  ASSERT_EQ(5 * sizeof(uint32_t) + sizeof(uint32_t), columns[1].dictionary_offsets.size());
+
+  faststring offsets, data;
+  DecodeDictionaryColumn(columns[1].data, columns[1].dictionary_offsets, columns[1].varlen_data,
+                         columns[1].non_null_bitmap, batch.num_rows, &offsets, &data);
+  const uint32_t* low_offsets = reinterpret_cast<const uint32_t*>(offsets.data());
+  for (int i = 0; i < expected_low.size(); i++) {
+    bool not_null = BitmapTest(columns[1].non_null_bitmap.data(), i);
+    ASSERT_EQ(static_cast<bool>(expected_low[i]), not_null) << i;
+    Slice cell(data.data() + low_offsets[i], low_offsets[i + 1] - low_offsets[i]);
+    ASSERT_EQ(not_null ? *expected_low[i] : "", cell.ToString()) << i;
+  }
+  const uint32_t* high_offsets = reinterpret_cast<const uint32_t*>(columns[2].data.data());
+  for (int i = 0; i < expected_high.size(); i++) {
+    Slice cell(columns[2].varlen_data.data() + high_offsets[i],
+               high_offsets[i + 1] - high_offsets[i]);
+    ASSERT_EQ(expected_high[i], cell.ToString());
+  }
+
+  // A code past the end of the dictionary is rejected. The first row is
+  // non-NULL.
+  string corrupt = sidecar.ToString();
+  uint32_t bad_code = 5;
+  memcpy(&corrupt[pb.columns(1).data().offset()], &bad_code, sizeof(bad_code));
+  Status s = ExtractColumnsFromColumnarRowBlockPB(schema, pb, corrupt, &columns);
+  ASSERT_STR_CONTAINS(s.ToString(), "Corruption: Row #0 contained bad dictionary code 5");
+}
+
+// Test that extracting columns from an invalid columnar block correctly
+// returns Corruption statuses.
+TEST_F(WireProtocolTest, TestInvalidColumnarRowBlock) {
+  Schema schema({ ColumnSchema("col1", STRING) }, 1);
+  ColumnarRowBlockPB pb;
+  vector<ColumnarColumnSlices> columns;
+  pb.set_num_rows(1);
+
+  // Missing columns.
+  Status s = ExtractColumnsFromColumnarRowBlockPB(schema, pb, Slice(), &columns);
+  ASSERT_STR_CONTAINS(s.ToString(), "Corruption: Columnar row block has 0 columns");
+
+  // A buffer past the end of the sidecar.
+  uint32_t offsets[] = { 0, 10 };
+  Slice sidecar(reinterpret_cast<const uint8_t*>(offsets), sizeof(offsets));
+  auto* col_pb = pb.add_columns();
+  col_pb->mutable_data()->set_offset(0);
+  col_pb->mutable_data()->set_size(sizeof(offsets) + 1);
+  s = ExtractColumnsFromColumnarRowBlockPB(schema, pb, sidecar, &columns);
+  ASSERT_STR_CONTAINS(s.ToString(), "Corruption: Columnar buffer (0, 9)");
+
+  // An offset past the end of the varlen data.
+  col_pb->mutable_data()->set_size(sizeof(offsets));
+  s = ExtractColumnsFromColumnarRowBlockPB(schema, pb, sidecar, &columns);
+  ASSERT_STR_CONTAINS(s.ToString(), "Corruption: Row #1 contained bad varlen offset 10");
+}
+
 #ifdef NDEBUG
 TEST_F(WireProtocolTest, TestColumnarRowBlockToPBBenchmark) {
   Arena arena(1024, 1024 * 1024);
@@ -330,4 +530,22 @@ TEST_F(WireProtocolTest, TestColumnDefaultValue) {
   ASSERT_EQ(write_default_u32, *static_cast<const uint32_t *>(col5fpb.write_default_value()));
 }
 
+TEST_F(WireProtocolTest, TestDecimalColumn) {
+  ColumnSchema col("col", DECIMAL64, true, nullptr, nullptr,
+                   ColumnStorageAttributes(), ColumnTypeAttributes(12, 3));
+  ColumnSchemaPB pb;
+  ColumnSchemaToPB(col, &pb);
+  ASSERT_EQ(12, pb.type_attributes().precision());
+  ASSERT_EQ(3, pb.type_attributes().scale());
+  ColumnSchema colfpb = ColumnSchemaFromPB(pb);
+  ASSERT_TRUE(colfpb.EqualsType(col));
+  ASSERT_EQ("decimal64(12, 3) NULLABLE", colfpb.TypeToString());
+  int64_t val = -1234567;
+  ASSERT_EQ("-1234.567", colfpb.Stringify(&val));
+
+  // Other types have no type attributes.
+  ColumnSchemaToPB(ColumnSchema("col", INT64), &pb);
+  ASSERT_FALSE(pb.has_type_attributes());
+}
+
 } // namespace kudu
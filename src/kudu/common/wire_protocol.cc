@@ -18,6 +18,7 @@
 #include "kudu/common/wire_protocol.h"
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "kudu/common/column_predicate.h"
@@ -26,7 +27,10 @@
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/fastmem.h"
+#include "kudu/gutil/strings/stringpiece.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/alignment.h"
+#include "kudu/util/bitmap.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/net/net_util.h"
@@ -197,10 +201,17 @@ void ColumnSchemaToPB(const ColumnSchema& col_schema, ColumnSchemaPB *pb, int fl
   pb->set_name(col_schema.name());
   pb->set_type(col_schema.type_info()->type());
   pb->set_is_nullable(col_schema.is_nullable());
+  if (IsDecimalType(col_schema.type_info()->type())) {
+    ColumnTypeAttributesPB* type_attributes = pb->mutable_type_attributes();
+    type_attributes->set_precision(col_schema.type_attributes().precision);
+    type_attributes->set_scale(col_schema.type_attributes().scale);
+  }
   if (!(flags & SCHEMA_PB_WITHOUT_STORAGE_ATTRIBUTES)) {
     pb->set_encoding(col_schema.attributes().encoding);
     pb->set_compression(col_schema.attributes().compression);
     pb->set_cfile_block_size(col_schema.attributes().cfile_block_size);
+    pb->set_compression_level(col_schema.attributes().compression_level);
+    pb->set_bloom_filter(col_schema.attributes().bloom_filter);
   }
   if (col_schema.has_read_default()) {
     if (col_schema.type_info()->physical_type() == BINARY) {
@@ -255,9 +266,20 @@ ColumnSchema ColumnSchemaFromPB(const ColumnSchemaPB& pb) {
   if (pb.has_cfile_block_size()) {
     attributes.cfile_block_size = pb.cfile_block_size();
   }
+  if (pb.has_compression_level()) {
+    attributes.compression_level = pb.compression_level();
+  }
+  if (pb.has_bloom_filter()) {
+    attributes.bloom_filter = pb.bloom_filter();
+  }
+  ColumnTypeAttributes type_attributes;
+  if (pb.has_type_attributes()) {
+    type_attributes.precision = pb.type_attributes().precision();
+    type_attributes.scale = pb.type_attributes().scale();
+  }
   return ColumnSchema(pb.name(), pb.type(), pb.is_nullable(),
                       read_default_ptr, write_default_ptr,
-                      attributes);
+                      attributes, type_attributes);
 }
 
 Status ColumnPBsToSchema(const RepeatedPtrField<ColumnSchemaPB>& column_pbs,
@@ -389,6 +411,37 @@ void ColumnPredicateToPB(const ColumnPredicate& predicate,
       pb->mutable_is_not_null();
       return;
     };
+    case PredicateType::IsNull: {
+      pb->mutable_is_null();
+      return;
+    };
+    case PredicateType::InList: {
+      auto* values = pb->mutable_in_list()->mutable_values();
+      for (const void* value : predicate.raw_values()) {
+        CopyPredicateBoundToPB(predicate.column(), value, values->Add());
+      }
+      return;
+    };
+    case PredicateType::InBloomFilter: {
+      auto* bloom_pred = pb->mutable_in_bloom_filter();
+      for (const BloomFilter& bloom_filter : predicate.bloom_filters()) {
+        auto* bloom_filter_pb = bloom_pred->add_bloom_filters();
+        bloom_filter_pb->set_nhash(bloom_filter.n_hashes());
+        bloom_filter_pb->set_bloom_data(bloom_filter.data().ToString());
+        bloom_filter_pb->set_blocked_layout(bloom_filter.layout() == BLOCKED_BLOOM_LAYOUT);
+      }
+      if (predicate.raw_lower() != nullptr) {
+        CopyPredicateBoundToPB(predicate.column(),
+                               predicate.raw_lower(),
+                               bloom_pred->mutable_lower());
+      }
+      if (predicate.raw_upper() != nullptr) {
+        CopyPredicateBoundToPB(predicate.column(),
+                               predicate.raw_upper(),
+                               bloom_pred->mutable_upper());
+      }
+      return;
+    };
     case PredicateType::None: LOG(FATAL) << "None predicate may not be converted to protobuf";
   }
   LOG(FATAL) << "unknown predicate type";
@@ -444,6 +497,56 @@ Status ColumnPredicateFromPB(const Schema& schema,
       *predicate = ColumnPredicate::IsNotNull(col);
       break;
     };
+    case ColumnPredicatePB::kIsNull: {
+      *predicate = ColumnPredicate::IsNull(col);
+      break;
+    };
+    case ColumnPredicatePB::kInList: {
+      const auto& in_list = pb.in_list();
+      vector<const void*> values;
+      values.reserve(in_list.values_size());
+      for (const string& pb_value : in_list.values()) {
+        const void* value = nullptr;
+        RETURN_NOT_OK(CopyPredicateBoundFromPB(col, pb_value, arena, &value));
+        values.push_back(value);
+      }
+      *predicate = ColumnPredicate::InList(col, &values);
+      break;
+    };
+    case ColumnPredicatePB::kInBloomFilter: {
+      const auto& bloom_pred = pb.in_bloom_filter();
+      if (bloom_pred.bloom_filters_size() == 0) {
+        return Status::InvalidArgument("Invalid IN bloom filter predicate on column: "
+                                       "no bloom filters", col.name());
+      }
+      vector<BloomFilter> bloom_filters;
+      bloom_filters.reserve(bloom_pred.bloom_filters_size());
+      for (const auto& bloom_filter_pb : bloom_pred.bloom_filters()) {
+        const string& data = bloom_filter_pb.bloom_data();
+        BloomFilterLayout layout = bloom_filter_pb.blocked_layout() ? BLOCKED_BLOOM_LAYOUT
+                                                                    : CLASSIC_BLOOM_LAYOUT;
+        if (data.empty() ||
+            (layout == BLOCKED_BLOOM_LAYOUT && data.size() % BloomFilter::kBlockedLineBytes != 0) ||
+            (layout == CLASSIC_BLOOM_LAYOUT && bloom_filter_pb.nhash() == 0)) {
+          return Status::InvalidArgument("Invalid bloom filter in predicate on column",
+                                         col.name());
+        }
+        // Copy the filter's data from the protobuf into the Arena.
+        uint8_t* data_copy = static_cast<uint8_t*>(arena->AllocateBytes(data.size()));
+        memcpy(data_copy, data.data(), data.size());
+        bloom_filters.emplace_back(Slice(data_copy, data.size()), bloom_filter_pb.nhash(), layout);
+      }
+      const void* lower = nullptr;
+      const void* upper = nullptr;
+      if (bloom_pred.has_lower()) {
+        RETURN_NOT_OK(CopyPredicateBoundFromPB(col, bloom_pred.lower(), arena, &lower));
+      }
+      if (bloom_pred.has_upper()) {
+        RETURN_NOT_OK(CopyPredicateBoundFromPB(col, bloom_pred.upper(), arena, &upper));
+      }
+      *predicate = ColumnPredicate::InBloomFilter(col, &bloom_filters, lower, upper);
+      break;
+    };
     default: return Status::InvalidArgument("Unknown predicate type for column", col.name());
   }
   return Status::OK();
@@ -697,4 +800,472 @@ void SerializeRowBlock(const RowBlock& block, RowwiseRowBlockPB* rowblock_pb,
   rowblock_pb->set_num_rows(rowblock_pb->num_rows() + num_rows);
 }
 
+// The distinct values of a BINARY column being dictionary-encoded.
+struct ColumnarSerializedBatch::Dictionary {
+  Dictionary() : arena(1024, 1024 * 1024) {}
+
+  // The code of each distinct value. The keys point into 'arena'.
+  std::unordered_map<StringPiece, uint32_t, GoodFastHash<StringPiece>> codes;
+
+  // The distinct values, by code.
+  vector<Slice> values;
+  Arena arena;
+
+  // The total size of the distinct values.
+  int64_t values_size = 0;
+
+  // The total size of the non-NULL cells, as they would be sent without
+  // dictionary encoding.
+  int64_t cells_size = 0;
+};
+
+ColumnarSerializedBatch::Column::Column() {}
+
+ColumnarSerializedBatch::Column::~Column() {}
+
+namespace {
+
+// The number of rows a column must have before it's judged on its number of
+// distinct values, and dictionary encoding maybe abandoned.
+const int64_t kMinRowsToJudgeDictionary = 1024;
+
+// Copy a column worth of data from the given RowBlock into the columnar
+// serialization of that column. See CopyColumn() above for the meaning of
+// the template parameters.
+template<bool IS_NULLABLE, bool IS_VARLEN>
+void CopyColumnColumnar(const RowBlock& block, int col_idx, int64_t dst_row_idx,
+                        ColumnarSerializedBatch::Column* dst) {
+  ColumnBlock cblock = block.column_block(col_idx);
+  size_t cell_size = cblock.stride();
+  const uint8_t* src = cblock.cell_ptr(0);
+
+  // Varlen columns store the offsets as cells, with the end offset of the
+  // previous row already present. Blocks whose rows were all filtered out
+  // don't advance 'dst_row_idx', so seed the leading offset only once.
+  if (IS_VARLEN && dst->data.size() == 0) {
+    uint32_t zero = 0;
+    dst->data.append(&zero, sizeof(zero));
+  }
+
+  BitmapIterator selected_row_iter(block.selection_vector()->bitmap(),
+                                   block.nrows());
+  int run_size;
+  bool selected;
+  int row_idx = 0;
+  while ((run_size = selected_row_iter.Next(&selected))) {
+    if (!selected) {
+      src += run_size * cell_size;
+      row_idx += run_size;
+      continue;
+    }
+
+    if (IS_NULLABLE) {
+      for (int i = 0; i < run_size; i++) {
+        BitmapChange(dst->non_null_bitmap.data(), dst_row_idx + i,
+                     !cblock.is_null(row_idx + i));
+      }
+    }
+
+    if (IS_VARLEN) {
+      for (int i = 0; i < run_size; i++) {
+        if (!IS_NULLABLE || !cblock.is_null(row_idx + i)) {
+          const Slice* slice = reinterpret_cast<const Slice*>(src + i * cell_size);
+          dst->varlen_data.append(slice->data(), slice->size());
+        }
+        uint32_t end_offset = dst->varlen_data.size();
+        dst->data.append(&end_offset, sizeof(end_offset));
+      }
+    } else {
+      size_t old_size = dst->data.size();
+      dst->data.append(src, run_size * cell_size);
+      if (IS_NULLABLE) {
+        // Zero the NULL cells, which improves RPC compression.
+        uint8_t* dst_cell = dst->data.data() + old_size;
+        for (int i = 0; i < run_size; i++, dst_cell += cell_size) {
+          if (cblock.is_null(row_idx + i)) {
+            memset(dst_cell, 0, cell_size);
+          }
+        }
+      }
+    }
+    src += run_size * cell_size;
+    row_idx += run_size;
+    dst_row_idx += run_size;
+  }
+}
+
+// Like CopyColumnColumnar<IS_NULLABLE, true>, but appends the dictionary codes
+// of the cells to a column being dictionary-encoded.
+template<bool IS_NULLABLE>
+void CopyColumnColumnarDictionary(const RowBlock& block, int col_idx, int64_t dst_row_idx,
+                                  ColumnarSerializedBatch::Column* dst) {
+  ColumnBlock cblock = block.column_block(col_idx);
+  ColumnarSerializedBatch::Dictionary* dict = dst->dict.get();
+  BitmapIterator selected_row_iter(block.selection_vector()->bitmap(),
+                                   block.nrows());
+  int run_size;
+  bool selected;
+  int row_idx = 0;
+  while ((run_size = selected_row_iter.Next(&selected))) {
+    if (!selected) {
+      row_idx += run_size;
+      continue;
+    }
+    for (int i = 0; i < run_size; i++, row_idx++, dst_row_idx++) {
+      uint32_t code = 0;
+      bool is_null = IS_NULLABLE && cblock.is_null(row_idx);
+      if (IS_NULLABLE) {
+        BitmapChange(dst->non_null_bitmap.data(), dst_row_idx, !is_null);
+      }
+      if (!is_null) {
+        const Slice* cell = reinterpret_cast<const Slice*>(cblock.cell_ptr(row_idx));
+        StringPiece value(reinterpret_cast<const char*>(cell->data()), cell->size());
+        auto it = dict->codes.find(value);
+        if (it == dict->codes.end()) {
+          code = dict->values.size();
+          Slice copy;
+          CHECK(dict->arena.RelocateSlice(*cell, &copy));
+          dict->codes.emplace(StringPiece(reinterpret_cast<const char*>(copy.data()),
+                                          copy.size()), code);
+          dict->values.push_back(copy);
+          dict->values_size += copy.size();
+        } else {
+          code = it->second;
+        }
+        dict->cells_size += cell->size();
+      }
+      dst->data.append(&code, sizeof(code));
+    }
+  }
+}
+
+// Lays out the values of 'dict' as 'dictionary_offsets' and
+// 'dictionary_data' buffers (see ColumnarColumnSlices).
+void LayOutDictionary(const ColumnarSerializedBatch::Dictionary& dict,
+                      faststring* offsets, faststring* data) {
+  offsets->reserve((dict.values.size() + 1) * sizeof(uint32_t));
+  data->reserve(dict.values_size);
+  uint32_t zero = 0;
+  offsets->append(&zero, sizeof(zero));
+  for (const Slice& value : dict.values) {
+    data->append(value.data(), value.size());
+    uint32_t end_offset = data->size();
+    offsets->append(&end_offset, sizeof(end_offset));
+  }
+}
+
+// Decodes the 'num_rows' cells of a column being dictionary-encoded into the
+// plain layout, and stops encoding it.
+void AbandonDictionary(int64_t num_rows, ColumnarSerializedBatch::Column* col) {
+  faststring dict_offsets;
+  faststring dict_data;
+  LayOutDictionary(*col->dict, &dict_offsets, &dict_data);
+  faststring offsets;
+  faststring varlen_data;
+  DecodeDictionaryColumn(Slice(col->data), Slice(dict_offsets), Slice(dict_data),
+                         Slice(col->non_null_bitmap), num_rows, &offsets, &varlen_data);
+  col->data.swap(offsets);
+  col->varlen_data.swap(varlen_data);
+  col->dict.reset();
+  col->dict_abandoned = true;
+}
+
+// Rounds 'offset' up to the alignment of the buffers in a columnar sidecar.
+size_t AlignColumnarOffset(size_t offset) {
+  return KUDU_ALIGN_UP(offset, 8);
+}
+
+// Appends 'buf' to 'sidecar' at an aligned offset, recording the offset and
+// size in 'buffer_pb'.
+void AppendColumnarBuffer(const faststring& buf,
+                          ColumnarRowBlockPB::Buffer* buffer_pb,
+                          faststring* sidecar) {
+  size_t offset = AlignColumnarOffset(sidecar->size());
+  sidecar->resize(offset + buf.size());
+  if (buf.size() > 0) {
+    memcpy(sidecar->data() + offset, buf.data(), buf.size());
+  }
+  buffer_pb->set_offset(offset);
+  buffer_pb->set_size(buf.size());
+}
+
+// Sets 'slice' to the range of 'sidecar' described by 'buffer_pb'.
+Status ColumnarBufferFromPB(const ColumnarRowBlockPB::Buffer& buffer_pb,
+                            const Slice& sidecar,
+                            Slice* slice) {
+  bool overflowed = false;
+  int64_t end = AddWithOverflowCheck(buffer_pb.offset(), buffer_pb.size(), &overflowed);
+  if (PREDICT_FALSE(overflowed || buffer_pb.offset() < 0 || buffer_pb.size() < 0 ||
+                    end > sidecar.size())) {
+    return Status::Corruption(
+        strings::Substitute("Columnar buffer ($0, $1) is outside of the $2 byte sidecar",
+                            buffer_pb.offset(), buffer_pb.size(), sidecar.size()));
+  }
+  *slice = Slice(sidecar.data() + buffer_pb.offset(), buffer_pb.size());
+  return Status::OK();
+}
+
+} // anonymous namespace
+
+void SerializeRowBlockColumnar(const RowBlock& block,
+                               const Schema* projection_schema,
+                               ColumnarSerializedBatch* batch) {
+  const Schema& tablet_schema = block.schema();
+  if (projection_schema == nullptr) {
+    projection_schema = &tablet_schema;
+  }
+
+  if (batch->columns.empty()) {
+    for (int i = 0; i < projection_schema->num_columns(); i++) {
+      batch->columns.emplace_back(new ColumnarSerializedBatch::Column());
+      if (batch->dictionary_encode &&
+          projection_schema->column(i).type_info()->physical_type() == BINARY) {
+        batch->columns.back()->dict.reset(new ColumnarSerializedBatch::Dictionary());
+      }
+    }
+  }
+  DCHECK_EQ(projection_schema->num_columns(), batch->columns.size());
+
+  int64_t num_rows = block.selection_vector()->CountSelected();
+  int64_t dst_row_idx = batch->num_rows;
+  for (int t_schema_idx = 0; t_schema_idx < tablet_schema.num_columns(); t_schema_idx++) {
+    const ColumnSchema& col = tablet_schema.column(t_schema_idx);
+    int proj_schema_idx = projection_schema->find_column(col.name());
+    if (proj_schema_idx == Schema::kColumnNotFound) {
+      continue;
+    }
+    ColumnarSerializedBatch::Column* dst = batch->columns[proj_schema_idx].get();
+
+    if (col.is_nullable()) {
+      // Grow the bitmap, clearing the new bytes so that no bits past the
+      // last row are left uninitialized.
+      size_t old_size = dst->non_null_bitmap.size();
+      size_t new_size = BitmapSize(dst_row_idx + num_rows);
+      dst->non_null_bitmap.resize(new_size);
+      if (new_size > old_size) {
+        memset(dst->non_null_bitmap.data() + old_size, 0, new_size - old_size);
+      }
+    }
+
+    if (dst->dict) {
+      if (col.is_nullable()) {
+        CopyColumnColumnarDictionary<true>(block, t_schema_idx, dst_row_idx, dst);
+      } else {
+        CopyColumnColumnarDictionary<false>(block, t_schema_idx, dst_row_idx, dst);
+      }
+      // Columns with many distinct values gain little from the dictionary,
+      // which costs a lookup per cell.
+      int64_t total_rows = dst_row_idx + num_rows;
+      if (total_rows >= kMinRowsToJudgeDictionary &&
+          dst->dict->values.size() * 2 > total_rows) {
+        AbandonDictionary(total_rows, dst);
+      }
+      continue;
+    }
+
+    // As in SerializeRowBlock(), branch on the column properties once
+    // outside of the copy loop.
+    bool is_varlen = col.type_info()->physical_type() == BINARY;
+    if (col.is_nullable() && is_varlen) {
+      CopyColumnColumnar<true, true>(block, t_schema_idx, dst_row_idx, dst);
+    } else if (col.is_nullable() && !is_varlen) {
+      CopyColumnColumnar<true, false>(block, t_schema_idx, dst_row_idx, dst);
+    } else if (!col.is_nullable() && is_varlen) {
+      CopyColumnColumnar<false, true>(block, t_schema_idx, dst_row_idx, dst);
+    } else {
+      CopyColumnColumnar<false, false>(block, t_schema_idx, dst_row_idx, dst);
+    }
+  }
+  batch->num_rows += num_rows;
+}
+
+size_t ColumnarSerializedBatchSize(const ColumnarSerializedBatch& batch) {
+  size_t size = 0;
+  for (const auto& col : batch.columns) {
+    size += col->data.size() + col->varlen_data.size() + col->non_null_bitmap.size();
+    if (col->dict) {
+      size += col->dict->values_size + (col->dict->values.size() + 1) * sizeof(uint32_t);
+    }
+  }
+  return size;
+}
+
+void FinishColumnarSerializedBatch(const ColumnarSerializedBatch& batch,
+                                   ColumnarRowBlockPB* columnar_pb,
+                                   faststring* sidecar) {
+  // Reserve space for all of the buffers, including worst-case alignment
+  // padding, to avoid repeatedly growing the sidecar.
+  sidecar->reserve(sidecar->size() + ColumnarSerializedBatchSize(batch) +
+                   batch.columns.size() * 4 * 8);
+
+  columnar_pb->set_num_rows(batch.num_rows);
+  for (const auto& col : batch.columns) {
+    ColumnarRowBlockPB::Column* col_pb = columnar_pb->add_columns();
+    if (col->dict) {
+      faststring dict_offsets;
+      faststring dict_data;
+      LayOutDictionary(*col->dict, &dict_offsets, &dict_data);
+      int64_t plain_size = (batch.num_rows + 1) * sizeof(uint32_t) + col->dict->cells_size;
+      if (col->data.size() + dict_offsets.size() + dict_data.size() < plain_size) {
+        AppendColumnarBuffer(col->data, col_pb->mutable_data(), sidecar);
+        AppendColumnarBuffer(dict_data, col_pb->mutable_varlen_data(), sidecar);
+        AppendColumnarBuffer(dict_offsets, col_pb->mutable_dictionary_offsets(), sidecar);
+      } else {
+        faststring offsets;
+        faststring varlen_data;
+        DecodeDictionaryColumn(Slice(col->data), Slice(dict_offsets), Slice(dict_data),
+                               Slice(col->non_null_bitmap), batch.num_rows,
+                               &offsets, &varlen_data);
+        AppendColumnarBuffer(offsets, col_pb->mutable_data(), sidecar);
+        if (varlen_data.size() > 0) {
+          AppendColumnarBuffer(varlen_data, col_pb->mutable_varlen_data(), sidecar);
+        }
+      }
+    } else {
+      AppendColumnarBuffer(col->data, col_pb->mutable_data(), sidecar);
+      if (col->varlen_data.size() > 0) {
+        AppendColumnarBuffer(col->varlen_data, col_pb->mutable_varlen_data(), sidecar);
+      }
+    }
+    if (col->non_null_bitmap.size() > 0) {
+      AppendColumnarBuffer(col->non_null_bitmap, col_pb->mutable_non_null_bitmap(), sidecar);
+    }
+  }
+}
+
+void DecodeDictionaryColumn(const Slice& codes, const Slice& dictionary_offsets,
+                            const Slice& dictionary_data, const Slice& non_null_bitmap,
+                            int64_t num_rows, faststring* offsets, faststring* varlen_data) {
+  offsets->clear();
+  varlen_data->clear();
+  offsets->reserve((num_rows + 1) * sizeof(uint32_t));
+  uint32_t offset = 0;
+  offsets->append(&offset, sizeof(offset));
+  for (int64_t row = 0; row < num_rows; row++) {
+    if (non_null_bitmap.empty() || BitmapTest(non_null_bitmap.data(), row)) {
+      uint32_t code = UNALIGNED_LOAD32(codes.data() + row * sizeof(uint32_t));
+      const uint8_t* value_offsets = dictionary_offsets.data() + code * sizeof(uint32_t);
+      uint32_t start = UNALIGNED_LOAD32(value_offsets);
+      uint32_t end = UNALIGNED_LOAD32(value_offsets + sizeof(uint32_t));
+      varlen_data->append(dictionary_data.data() + start, end - start);
+      offset = varlen_data->size();
+    }
+    offsets->append(&offset, sizeof(offset));
+  }
+}
+
+Status ExtractColumnsFromColumnarRowBlockPB(const Schema& schema,
+                                            const ColumnarRowBlockPB& columnar_pb,
+                                            const Slice& sidecar,
+                                            vector<ColumnarColumnSlices>* columns) {
+  int64_t num_rows = columnar_pb.num_rows();
+  if (PREDICT_FALSE(num_rows < 0)) {
+    return Status::Corruption("Columnar row block has a negative number of rows");
+  }
+  if (PREDICT_FALSE(columnar_pb.columns_size() != schema.num_columns())) {
+    return Status::Corruption(
+        strings::Substitute("Columnar row block has $0 columns but expected $1",
+                            columnar_pb.columns_size(), schema.num_columns()));
+  }
+
+  columns->clear();
+  columns->resize(columnar_pb.columns_size());
+  for (int i = 0; i < columnar_pb.columns_size(); i++) {
+    const ColumnSchema& col = schema.column(i);
+    const ColumnarRowBlockPB::Column& col_pb = columnar_pb.columns(i);
+    ColumnarColumnSlices* slices = &(*columns)[i];
+
+    RETURN_NOT_OK(ColumnarBufferFromPB(col_pb.data(), sidecar, &slices->data));
+    // The null bitmap is needed to validate the codes of dictionary-encoded
+    // columns, so it's extracted first.
+    if (col.is_nullable()) {
+      RETURN_NOT_OK(ColumnarBufferFromPB(col_pb.non_null_bitmap(), sidecar,
+                                         &slices->non_null_bitmap));
+      if (PREDICT_FALSE(slices->non_null_bitmap.size() != BitmapSize(num_rows))) {
+        return Status::Corruption(
+            strings::Substitute("Column $0 has a $1 byte null bitmap but expected $2 for $3 rows",
+                                col.ToString(), slices->non_null_bitmap.size(),
+                                BitmapSize(num_rows), num_rows));
+      }
+    }
+
+    bool is_varlen = col.type_info()->physical_type() == BINARY;
+    if (is_varlen && col_pb.has_dictionary_offsets()) {
+      if (PREDICT_FALSE(slices->data.size() != num_rows * sizeof(uint32_t))) {
+        return Status::Corruption(
+            strings::Substitute("Column $0 has $1 bytes of codes but expected $2 for $3 rows",
+                                col.ToString(), slices->data.size(),
+                                num_rows * sizeof(uint32_t), num_rows));
+      }
+      RETURN_NOT_OK(ColumnarBufferFromPB(col_pb.dictionary_offsets(), sidecar,
+                                         &slices->dictionary_offsets));
+      if (col_pb.has_varlen_data()) {
+        RETURN_NOT_OK(ColumnarBufferFromPB(col_pb.varlen_data(), sidecar, &slices->varlen_data));
+      }
+      const Slice& dict_offsets = slices->dictionary_offsets;
+      if (PREDICT_FALSE(dict_offsets.size() < sizeof(uint32_t) ||
+                        dict_offsets.size() % sizeof(uint32_t) != 0)) {
+        return Status::Corruption(
+            strings::Substitute("Column $0 has a bad $1 byte dictionary",
+                                col.ToString(), dict_offsets.size()));
+      }
+      // Ensure that every value lies within the dictionary data, and every
+      // code within the dictionary.
+      uint32_t dict_size = dict_offsets.size() / sizeof(uint32_t) - 1;
+      uint32_t prev_offset = 0;
+      for (uint32_t code = 0; code <= dict_size; code++) {
+        uint32_t offset = UNALIGNED_LOAD32(dict_offsets.data() + code * sizeof(uint32_t));
+        if (PREDICT_FALSE(offset < prev_offset || offset > slices->varlen_data.size() ||
+                          (code == 0 && offset != 0) ||
+                          (code == dict_size && offset != slices->varlen_data.size()))) {
+          return Status::Corruption(
+              strings::Substitute("Dictionary entry #$0 contained bad offset $1 for column $2",
+                                  code, offset, col.ToString()));
+        }
+        prev_offset = offset;
+      }
+      for (int64_t row = 0; row < num_rows; row++) {
+        if (!slices->non_null_bitmap.empty() &&
+            !BitmapTest(slices->non_null_bitmap.data(), row)) {
+          continue;
+        }
+        uint32_t code = UNALIGNED_LOAD32(slices->data.data() + row * sizeof(uint32_t));
+        if (PREDICT_FALSE(code >= dict_size)) {
+          return Status::Corruption(
+              strings::Substitute("Row #$0 contained bad dictionary code $1 for column $2",
+                                  row, code, col.ToString()));
+        }
+      }
+    } else if (is_varlen) {
+      if (PREDICT_FALSE(slices->data.size() != (num_rows + 1) * sizeof(uint32_t))) {
+        return Status::Corruption(
+            strings::Substitute("Column $0 has $1 bytes of offsets but expected $2 for $3 rows",
+                                col.ToString(), slices->data.size(),
+                                (num_rows + 1) * sizeof(uint32_t), num_rows));
+      }
+      if (col_pb.has_varlen_data()) {
+        RETURN_NOT_OK(ColumnarBufferFromPB(col_pb.varlen_data(), sidecar, &slices->varlen_data));
+      }
+      // Ensure that every cell lies within the varlen data.
+      uint32_t prev_offset = 0;
+      for (int64_t row = 0; row <= num_rows; row++) {
+        uint32_t offset = UNALIGNED_LOAD32(slices->data.data() + row * sizeof(uint32_t));
+        if (PREDICT_FALSE(offset < prev_offset || offset > slices->varlen_data.size() ||
+                          (row == num_rows && offset != slices->varlen_data.size()))) {
+          return Status::Corruption(
+              strings::Substitute("Row #$0 contained bad varlen offset $1 for column $2",
+                                  row, offset, col.ToString()));
+        }
+        prev_offset = offset;
+      }
+    } else if (PREDICT_FALSE(slices->data.size() != num_rows * col.type_info()->size())) {
+      return Status::Corruption(
+          strings::Substitute("Column $0 has $1 bytes of data but expected $2 for $3 rows",
+                              col.ToString(), slices->data.size(),
+                              num_rows * col.type_info()->size(), num_rows));
+    }
+  }
+  return Status::OK();
+}
+
 } // namespace kudu
@@ -20,9 +20,12 @@
 #define KUDU_COMMON_WIRE_PROTOCOL_H
 
 #include <boost/optional.hpp>
+#include <memory>
 #include <vector>
 
 #include "kudu/common/wire_protocol.pb.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
 using boost::optional;
@@ -33,13 +36,11 @@ class Arena;
 class ColumnPredicate;
 class ColumnSchema;
 class ConstContiguousRow;
-class faststring;
 class HostPort;
 class RowBlock;
 class RowBlockRow;
 class RowChangeList;
 class Schema;
-class Slice;
 class Sockaddr;
 
 // Convert the given C++ Status object into the equivalent Protobuf.
@@ -126,6 +127,101 @@ void SerializeRowBlock(const RowBlock& block, RowwiseRowBlockPB* rowblock_pb,
                        const Schema* client_projection_schema,
                        faststring* data_buf, faststring* indirect_data);
 
+// The columnar serialization of one or more RowBlocks, accumulated before
+// being sent as a ColumnarRowBlockPB. See wire_protocol.proto for the layout
+// of each column's buffers.
+struct ColumnarSerializedBatch {
+  struct Dictionary;
+
+  struct Column {
+    Column();
+    ~Column();
+
+    // The fixed-width cells, or the varlen offsets for BINARY columns. The
+    // dictionary codes of BINARY columns which are being dictionary-encoded.
+    faststring data;
+
+    // The cell data of BINARY columns. Empty for other types, and for BINARY
+    // columns which are being dictionary-encoded, whose distinct values are
+    // held by 'dict'.
+    faststring varlen_data;
+
+    // The non-null bitmap of nullable columns. Empty for other columns.
+    faststring non_null_bitmap;
+
+    // Set while a BINARY column is being dictionary-encoded.
+    std::unique_ptr<Dictionary> dict;
+
+    // Whether dictionary encoding was tried and given up on for this column,
+    // because it had too many distinct values.
+    bool dict_abandoned = false;
+  };
+
+  // One entry per column of the projection.
+  std::vector<std::unique_ptr<Column>> columns;
+
+  // The number of rows serialized so far.
+  int64_t num_rows = 0;
+
+  // Whether to dictionary-encode BINARY columns, for those columns for which
+  // it makes the batch smaller. Must be set before any rows are serialized.
+  bool dictionary_encode = false;
+};
+
+// Encode the selected rows of the given row block in columnar layout,
+// appending them to 'batch'.
+//
+// As with SerializeRowBlock(), if 'client_projection_schema' is not NULL then
+// only the columns specified in it are serialized, and all data is copied so
+// that the original block may be destroyed safely after this returns.
+void SerializeRowBlockColumnar(const RowBlock& block,
+                               const Schema* client_projection_schema,
+                               ColumnarSerializedBatch* batch);
+
+// Returns the number of bytes of column data buffered in 'batch'.
+size_t ColumnarSerializedBatchSize(const ColumnarSerializedBatch& batch);
+
+// Lays out every column buffer of 'batch' in 'sidecar', and describes them in
+// 'columnar_pb'. The caller is responsible for attaching 'sidecar' to the RPC
+// and setting its index in 'columnar_pb'.
+void FinishColumnarSerializedBatch(const ColumnarSerializedBatch& batch,
+                                   ColumnarRowBlockPB* columnar_pb,
+                                   faststring* sidecar);
+
+// The buffers of a single column of a ColumnarRowBlockPB. See
+// wire_protocol.proto for their layout. The slices point into the sidecar
+// which they were extracted from.
+struct ColumnarColumnSlices {
+  Slice data;
+  Slice varlen_data;
+  Slice non_null_bitmap;
+
+  // Only set for dictionary-encoded columns, in which case 'data' holds the
+  // codes and 'varlen_data' the dictionary values.
+  Slice dictionary_offsets;
+};
+
+// Decodes the 'num_rows' cells of a dictionary-encoded column (see
+// ColumnarColumnSlices), setting 'offsets' and 'varlen_data' to the
+// 'num_rows + 1' offsets and the cell data of the plain layout.
+// 'non_null_bitmap' is empty for non-nullable columns.
+//
+// The codes of non-NULL cells must be valid, as verified by
+// ExtractColumnsFromColumnarRowBlockPB().
+void DecodeDictionaryColumn(const Slice& codes, const Slice& dictionary_offsets,
+                            const Slice& dictionary_data, const Slice& non_null_bitmap,
+                            int64_t num_rows, faststring* offsets, faststring* varlen_data);
+
+// Extract the column buffers of a ColumnarRowBlockPB with the given schema
+// from 'sidecar', validating that they are consistent with the schema and
+// the number of rows in the block.
+//
+// Returns a bad Status if the provided data is invalid or corrupt.
+Status ExtractColumnsFromColumnarRowBlockPB(const Schema& schema,
+                                            const ColumnarRowBlockPB& columnar_pb,
+                                            const Slice& sidecar,
+                                            std::vector<ColumnarColumnSlices>* columns);
+
 // Rewrites the data pointed-to by row data slice 'row_data_slice' by replacing
 // relative indirect data pointers with absolute ones in 'indirect_data_slice'.
 // At the time of this writing, this rewriting is only done for STRING types.
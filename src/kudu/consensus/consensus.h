@@ -23,6 +23,7 @@
 #include <string>
 #include <vector>
 
+#include "kudu/common/timestamp.h"
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/consensus/ref_counted_replicate.h"
 #include "kudu/gutil/callback.h"
@@ -333,6 +334,20 @@ class ReplicaTransactionFactory {
  public:
   virtual Status StartReplicaTransaction(const scoped_refptr<ConsensusRound>& context) = 0;
 
+  // Returns the leader's safe time, to be propagated to followers along with
+  // the committed index: no transaction that is replicated after this call
+  // will be assigned a timestamp at or below the returned one. Returns
+  // Timestamp::kInvalidTimestamp if no safe time is available.
+  virtual Timestamp GetSafeTimestampForFollowers() {
+    return Timestamp::kInvalidTimestamp;
+  }
+
+  // Called on followers once every operation up to 'committed_index' has
+  // been received and committed, with the safe time the leader sent along
+  // with that index. Implementations may ignore the update if operations at
+  // or below 'committed_index' are still being applied.
+  virtual void AdvanceSafeTimestamp(int64_t committed_index, Timestamp safe_timestamp) {}
+
   virtual ~ReplicaTransactionFactory() {}
 };
 
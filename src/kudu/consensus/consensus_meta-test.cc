@@ -17,8 +17,10 @@
 #include "kudu/consensus/consensus_meta.h"
 
 #include <memory>
+#include <thread>
 #include <vector>
 
+#include <gflags/gflags.h>
 #include <gtest/gtest.h>
 
 #include "kudu/common/wire_protocol.h"
@@ -26,10 +28,13 @@
 #include "kudu/consensus/opid_util.h"
 #include "kudu/consensus/quorum_util.h"
 #include "kudu/fs/fs_manager.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_bool(log_force_fsync_all);
+
 #define ASSERT_VALUES_EQUAL(cmeta, opid_index, uuid, term) \
   ASSERT_NO_FATAL_FAILURE(AssertValuesEqual(cmeta, opid_index, uuid, term))
 
@@ -39,6 +44,7 @@ namespace consensus {
 using std::string;
 using std::unique_ptr;
 using std::vector;
+using strings::Substitute;
 
 const char* kTabletId = "test-consensus-metadata";
 const int64_t kInitialTerm = 3;
@@ -132,6 +138,43 @@ TEST_F(ConsensusMetadataTest, TestFlush) {
   }
 }
 
+// Check that the consensus metadata of many tablets flushed at once, with
+// their directory fsyncs coalesced, are all durable.
+TEST_F(ConsensusMetadataTest, TestConcurrentFlushes) {
+  FLAGS_log_force_fsync_all = true;
+  const int kNumTablets = 16;
+  const int kNumFlushes = 10;
+  vector<unique_ptr<ConsensusMetadata>> cmetas(kNumTablets);
+  for (int i = 0; i < kNumTablets; i++) {
+    ASSERT_OK(ConsensusMetadata::Create(&fs_manager_, Substitute("$0-$1", kTabletId, i),
+                                        fs_manager_.uuid(), config_, kInitialTerm,
+                                        &cmetas[i]));
+  }
+
+  vector<std::thread> threads;
+  vector<Status> statuses(kNumTablets);
+  for (int i = 0; i < kNumTablets; i++) {
+    threads.emplace_back([&, i]() {
+      for (int j = 1; j <= kNumFlushes && statuses[i].ok(); j++) {
+        cmetas[i]->set_current_term(kInitialTerm + j);
+        statuses[i] = cmetas[i]->Flush();
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  for (int i = 0; i < kNumTablets; i++) {
+    ASSERT_OK(statuses[i]);
+    unique_ptr<ConsensusMetadata> cmeta_read;
+    ASSERT_OK(ConsensusMetadata::Load(&fs_manager_, Substitute("$0-$1", kTabletId, i),
+                                      fs_manager_.uuid(), &cmeta_read));
+    ASSERT_VALUES_EQUAL(*cmeta_read, kInvalidOpIdIndex, fs_manager_.uuid(),
+                        kInitialTerm + kNumFlushes);
+  }
+}
+
 // Builds a distributed configuration of voters with the given uuids.
 RaftConfigPB BuildConfig(const vector<string>& uuids) {
   RaftConfigPB config;
@@ -17,6 +17,9 @@
 #include "kudu/consensus/consensus_meta.h"
 
 #include <memory>
+#include <unordered_map>
+
+#include <gflags/gflags.h>
 
 #include "kudu/consensus/log_util.h"
 #include "kudu/consensus/metadata.pb.h"
@@ -24,17 +27,107 @@
 #include "kudu/consensus/quorum_util.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/mutex.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/stopwatch.h"
 
+DEFINE_bool(cmeta_coalesce_dir_fsyncs, true,
+            "Whether concurrent flushes of the consensus metadata of different "
+            "tablets share the fsyncs of their common directory when "
+            "--log_force_fsync_all is set, rather than each fsyncing it on its own.");
+TAG_FLAG(cmeta_coalesce_dir_fsyncs, advanced);
+TAG_FLAG(cmeta_coalesce_dir_fsyncs, runtime);
+
 namespace kudu {
 namespace consensus {
 
 using std::string;
 using std::unique_ptr;
+using std::unordered_map;
 using strings::Substitute;
 
+namespace {
+
+// Makes renames into a directory durable, sharing each fsync of the directory
+// among all of the threads which renamed a file into it before it started.
+//
+// During an election storm, every tablet of the server flushes its consensus
+// metadata at once, and all of the files live in the same directory. Rather
+// than each of these flushes fsyncing the directory in turn, the flushes
+// which arrive while an fsync is in progress wait for it, and the next fsync
+// covers all of them together.
+class DirSyncer {
+ public:
+  explicit DirSyncer(string dir)
+      : dir_(std::move(dir)),
+        cond_(&lock_),
+        requested_seq_(0),
+        synced_seq_(0),
+        syncing_(false) {
+  }
+
+  // Returns once the directory has been fsynced after the call began.
+  Status Sync(Env* env) {
+    MutexLock l(lock_);
+    const int64_t seq = ++requested_seq_;
+    while (synced_seq_ < seq) {
+      if (syncing_) {
+        cond_.Wait();
+        continue;
+      }
+      // Sync on behalf of every caller which arrived so far.
+      syncing_ = true;
+      const int64_t target_seq = requested_seq_;
+      lock_.Release();
+      Status s = env->SyncDir(dir_);
+      lock_.Acquire();
+      syncing_ = false;
+      synced_seq_ = target_seq;
+      // A later successful fsync also covers the earlier renames, so only
+      // the status of the last one matters.
+      last_status_ = s;
+      cond_.Broadcast();
+    }
+    return last_status_;
+  }
+
+  // Returns the syncer of 'dir', which lives for the lifetime of the process.
+  static DirSyncer* Get(const string& dir) {
+    static simple_spinlock map_lock;
+    static auto* syncers = new unordered_map<string, unique_ptr<DirSyncer>>();
+    std::lock_guard<simple_spinlock> l(map_lock);
+    unique_ptr<DirSyncer>& syncer = (*syncers)[dir];
+    if (!syncer) {
+      syncer.reset(new DirSyncer(dir));
+    }
+    return syncer.get();
+  }
+
+ private:
+  const string dir_;
+
+  // Protects the members below.
+  Mutex lock_;
+
+  // Broadcast when an fsync completes.
+  ConditionVariable cond_;
+
+  // The fsync of the directory covers the callers whose sequence numbers are
+  // at most 'synced_seq_'.
+  int64_t requested_seq_;
+  int64_t synced_seq_;
+  bool syncing_;
+  Status last_status_;
+
+  DISALLOW_COPY_AND_ASSIGN(DirSyncer);
+};
+
+} // anonymous namespace
+
 Status ConsensusMetadata::Create(FsManager* fs_manager,
                                  const string& tablet_id,
                                  const std::string& peer_uuid,
@@ -203,6 +296,15 @@ Status ConsensusMetadata::Flush() {
   }
 
   string meta_file_path = fs_manager_->GetConsensusMetadataPath(tablet_id_);
+  if (FLAGS_log_force_fsync_all && FLAGS_cmeta_coalesce_dir_fsyncs) {
+    RETURN_NOT_OK_PREPEND(pb_util::WritePBContainerToPathWithoutDirSync(
+        fs_manager_->env(), meta_file_path, pb_, pb_util::OVERWRITE),
+            Substitute("Unable to write consensus meta file for tablet $0 to path $1",
+                       tablet_id_, meta_file_path));
+    RETURN_NOT_OK_PREPEND(DirSyncer::Get(dir)->Sync(fs_manager_->env()),
+                          "Unable to fsync consensus metadata dir " + dir);
+    return Status::OK();
+  }
   RETURN_NOT_OK_PREPEND(pb_util::WritePBContainerToPath(
       fs_manager_->env(), meta_file_path, pb_,
       pb_util::OVERWRITE,
@@ -31,6 +31,9 @@
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_int32(consensus_max_batch_size_bytes);
+DECLARE_int32(consensus_max_inflight_requests_per_peer);
+
 METRIC_DECLARE_entity(tablet);
 
 namespace kudu {
@@ -165,6 +168,38 @@ TEST_F(ConsensusPeersTest, TestRemotePeer) {
   CheckLastRemoteEntry(proxy, 2, 20);
 }
 
+// Like the above, but with several small batches pipelined to the peer.
+TEST_F(ConsensusPeersTest, TestPipelinedRemotePeer) {
+  google::FlagSaver saver;
+  FLAGS_consensus_max_inflight_requests_per_peer = 4;
+  FLAGS_consensus_max_batch_size_bytes = 1024;
+
+  message_queue_->Init(MinimumOpId());
+  message_queue_->SetLeaderMode(kMinimumOpIdIndex,
+                                kMinimumTerm,
+                                BuildRaftConfigPBForTests(3));
+
+  RaftPeerPB peer_pb = FakeRaftPeerPB(kFollowerUuid);
+  auto proxy = new NoOpTestPeerProxy(pool_.get(), peer_pb);
+  gscoped_ptr<Peer> remote_peer;
+  ASSERT_OK(Peer::NewRemotePeer(peer_pb,
+                                kTabletId,
+                                kLeaderUuid,
+                                message_queue_.get(),
+                                pool_.get(),
+                                gscoped_ptr<PeerProxy>(proxy),
+                                &remote_peer));
+
+  // Signal the peer as each batch is appended, as consensus would.
+  for (int i = 0; i < 10; i++) {
+    AppendReplicateMessagesToQueue(message_queue_.get(), clock_, i * 20 + 1, 20, 100);
+    remote_peer->SignalRequest(true);
+  }
+  WaitForCommitIndex(200);
+  OpId last = proxy->last_received();
+  ASSERT_EQ(200, last.index());
+}
+
 TEST_F(ConsensusPeersTest, TestRemotePeers) {
   message_queue_->Init(MinimumOpId());
   message_queue_->SetLeaderMode(kMinimumOpIdIndex,
@@ -29,10 +29,12 @@
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/consensus_peers.h"
 #include "kudu/consensus/consensus_queue.h"
+#include "kudu/consensus/heartbeat_batcher.h"
 #include "kudu/consensus/log.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/rpc_sidecar.h"
 #include "kudu/util/fault_injection.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
@@ -48,6 +50,15 @@ DEFINE_int32(raft_get_node_instance_timeout_ms, 30000,
              "Timeout for retrieving node instance data over RPC.");
 TAG_FLAG(consensus_rpc_timeout_ms, hidden);
 
+DEFINE_bool(consensus_send_ops_in_sidecar, false,
+            "Whether the leader sends the operations of UpdateConsensus requests "
+            "in an RPC sidecar, copying their cached encodings instead of "
+            "serializing them again for every follower. Followers which don't "
+            "support it are sent the operations in the request itself.");
+TAG_FLAG(consensus_send_ops_in_sidecar, advanced);
+TAG_FLAG(consensus_send_ops_in_sidecar, experimental);
+
+DECLARE_int32(consensus_max_inflight_requests_per_peer);
 DECLARE_int32(raft_heartbeat_interval_ms);
 
 DEFINE_double(fault_crash_on_leader_request_fraction, 0.0,
@@ -107,16 +118,29 @@ Peer::Peer(const RaftPeerPB& peer_pb, string tablet_id, string leader_uuid,
       proxy_(std::move(proxy)),
       queue_(queue),
       failed_attempts_(0),
-      sem_(1),
+      max_inflight_(std::max(1, FLAGS_consensus_max_inflight_requests_per_peer)),
+      next_seq_(0),
+      last_response_seq_(-1),
+      last_request_committed_index_(kMinimumOpIdIndex),
+      tc_in_flight_(false),
+      ops_sidecar_unsupported_(false),
+      sem_(max_inflight_),
       heartbeater_(
           peer_pb.permanent_uuid(),
           MonoDelta::FromMilliseconds(FLAGS_raft_heartbeat_interval_ms),
           boost::bind(&Peer::SignalRequest, this, true)),
       thread_pool_(thread_pool),
-      state_(kPeerCreated) {}
+      state_(kPeerCreated) {
+  for (int i = 0; i < max_inflight_; i++) {
+    rpcs_.emplace_back(new UpdateRpc());
+    free_rpcs_.push_back(rpcs_.back().get());
+  }
+}
 
 void Peer::SetTermForTest(int term) {
-  response_.set_responder_term(term);
+  for (const auto& rpc : rpcs_) {
+    rpc->response.set_responder_term(term);
+  }
 }
 
 Status Peer::Init() {
@@ -172,42 +196,84 @@ Status Peer::SignalRequest(bool even_if_queue_empty) {
   return Status::OK();
 }
 
+Peer::UpdateRpc* Peer::TakeRpc(bool* others_in_flight) {
+  std::lock_guard<simple_spinlock> l(peer_lock_);
+  DCHECK(!free_rpcs_.empty());
+  UpdateRpc* rpc = free_rpcs_.back();
+  free_rpcs_.pop_back();
+  *others_in_flight = free_rpcs_.size() + 1 < rpcs_.size();
+  return rpc;
+}
+
+void Peer::ReturnRpc(UpdateRpc* rpc, bool release_permit) {
+  {
+    std::lock_guard<simple_spinlock> l(peer_lock_);
+    free_rpcs_.push_back(rpc);
+  }
+  if (release_permit) {
+    sem_.Release();
+  }
+}
+
 void Peer::SendNextRequest(bool even_if_queue_empty) {
-  // The peer has no pending request nor is sending: send the request.
+  // The peer has fewer than 'max_inflight_' requests pending: send the request.
+  MutexLock send_lock(send_lock_);
+  bool others_in_flight;
+  UpdateRpc* rpc = TakeRpc(&others_in_flight);
+  ConsensusRequestPB* request = &rpc->request;
+
   bool needs_tablet_copy = false;
-  int64_t commit_index_before = request_.has_committed_index() ?
-      request_.committed_index() : kMinimumOpIdIndex;
-  Status s = queue_->RequestForPeer(peer_pb_.permanent_uuid(), &request_,
-                                    &replicate_msg_refs_, &needs_tablet_copy);
-  int64_t commit_index_after = request_.has_committed_index() ?
-      request_.committed_index() : kMinimumOpIdIndex;
+  int64_t commit_index_before = last_request_committed_index_;
+  Status s = queue_->RequestForPeer(peer_pb_.permanent_uuid(), request,
+                                    &rpc->replicate_msg_refs, &needs_tablet_copy);
+  int64_t commit_index_after = request->has_committed_index() ?
+      request->committed_index() : kMinimumOpIdIndex;
+  last_request_committed_index_ = commit_index_after;
 
   if (PREDICT_FALSE(!s.ok())) {
     LOG_WITH_PREFIX_UNLOCKED(INFO) << "Could not obtain request from queue for peer: "
         << peer_pb_.permanent_uuid() << ". Status: " << s.ToString();
-    sem_.Release();
+    ReturnRpc(rpc, true);
     return;
   }
 
   if (PREDICT_FALSE(needs_tablet_copy)) {
+    // Tablet copy has its own request, so the permit stays with it.
+    ReturnRpc(rpc, false);
+    bool tc_in_flight;
+    {
+      std::lock_guard<simple_spinlock> l(peer_lock_);
+      tc_in_flight = tc_in_flight_;
+      tc_in_flight_ = true;
+    }
+    if (tc_in_flight) {
+      sem_.Release();
+      return;
+    }
     Status s = SendTabletCopyRequest();
     if (!s.ok()) {
       LOG_WITH_PREFIX_UNLOCKED(WARNING) << "Unable to generate Tablet Copy request for peer: "
                                         << s.ToString();
+      {
+        std::lock_guard<simple_spinlock> l(peer_lock_);
+        tc_in_flight_ = false;
+      }
       sem_.Release();
     }
     return;
   }
 
-  request_.set_tablet_id(tablet_id_);
-  request_.set_caller_uuid(leader_uuid_);
-  request_.set_dest_uuid(peer_pb_.permanent_uuid());
+  request->set_tablet_id(tablet_id_);
+  request->set_caller_uuid(leader_uuid_);
+  request->set_dest_uuid(peer_pb_.permanent_uuid());
 
-  bool req_has_ops = request_.ops_size() > 0 || (commit_index_after > commit_index_before);
+  bool req_has_ops = request->ops_size() > 0 || (commit_index_after > commit_index_before);
   // If the queue is empty, check if we were told to send a status-only
-  // message, if not just return.
-  if (PREDICT_FALSE(!req_has_ops && !even_if_queue_empty)) {
-    sem_.Release();
+  // message, if not just return. There's no need for a status-only message
+  // while other requests are outstanding, their responses serve the same
+  // purpose.
+  if (PREDICT_FALSE(!req_has_ops && (!even_if_queue_empty || others_in_flight))) {
+    ReturnRpc(rpc, true);
     return;
   }
 
@@ -221,23 +287,61 @@ void Peer::SendNextRequest(bool even_if_queue_empty) {
 
 
   VLOG_WITH_PREFIX_UNLOCKED(2) << "Sending to peer " << peer_pb().permanent_uuid() << ": "
-      << request_.ShortDebugString();
-  controller_.Reset();
+      << request->ShortDebugString();
+  rpc->controller.Reset();
+  bool use_ops_sidecar;
+  {
+    std::lock_guard<simple_spinlock> l(peer_lock_);
+    rpc->seq = next_seq_++;
+    use_ops_sidecar = !ops_sidecar_unsupported_;
+  }
+  request->clear_ops_sidecar_idx();
+  if (use_ops_sidecar && request->ops_size() > 0 && proxy_->SupportsOpsSidecar()) {
+    MoveOpsToSidecar(rpc);
+  }
 
-  proxy_->UpdateAsync(&request_, &response_, &controller_,
-                      boost::bind(&Peer::ProcessResponse, this));
+  proxy_->UpdateAsync(request, &rpc->response, &rpc->controller,
+                      boost::bind(&Peer::ProcessResponse, this, rpc));
 }
 
-void Peer::ProcessResponse() {
+void Peer::MoveOpsToSidecar(UpdateRpc* rpc) {
+  ConsensusRequestPB* request = &rpc->request;
+  DCHECK_EQ(request->ops_size(), rpc->replicate_msg_refs.size());
+
+  size_t sidecar_size = 0;
+  for (const ReplicateRefPtr& msg : rpc->replicate_msg_refs) {
+    sidecar_size += msg->EncodedAsOp().size();
+  }
+  gscoped_ptr<faststring> buf(new faststring(sidecar_size));
+  for (const ReplicateRefPtr& msg : rpc->replicate_msg_refs) {
+    buf->append(msg->EncodedAsOp());
+  }
+
+  int idx;
+  Status s = rpc->controller.AddOutboundSidecar(
+      gscoped_ptr<rpc::RpcSidecar>(new rpc::RpcSidecar(std::move(buf))), &idx);
+  if (PREDICT_FALSE(!s.ok())) {
+    LOG_WITH_PREFIX_UNLOCKED(WARNING) << "Unable to send ops in a sidecar: " << s.ToString();
+    return;
+  }
+  // We don't own the ops (the queue does).
+  request->mutable_ops()->ExtractSubrange(0, request->ops_size(), nullptr);
+  request->set_ops_sidecar_idx(idx);
+  rpc->controller.RequireServerFeature(ConsensusServiceFeatures::OPS_IN_SIDECAR);
+}
+
+void Peer::ProcessResponse(UpdateRpc* rpc) {
   // Note: This method runs on the reactor thread.
 
-  DCHECK_EQ(0, sem_.GetValue())
+  DCHECK_LT(sem_.GetValue(), max_inflight_)
     << "Got a response when nothing was pending";
 
   MAYBE_FAULT(FLAGS_fault_crash_after_leader_request_fraction);
 
-  if (!controller_.status().ok()) {
-    if (controller_.status().IsRemoteError()) {
+  const rpc::RpcController& controller = rpc->controller;
+  const ConsensusResponsePB& response = rpc->response;
+  if (!controller.status().ok()) {
+    if (controller.status().IsRemoteError()) {
       // Most controller errors are caused by network issues or corner cases
       // like shutdown and failure to serialize a protobuf. Therefore, we
       // generally consider these errors to indicate an unreachable peer.
@@ -245,21 +349,33 @@ void Peer::ProcessResponse() {
       // remote peer, so we know the remote is alive. Therefore, we will let
       // the queue know that the remote is responsive.
       queue_->NotifyPeerIsResponsiveDespiteError(peer_pb_.permanent_uuid());
+
+      // A peer which doesn't support ops in a sidecar rejects the request;
+      // the next attempt sends them in the request itself.
+      const rpc::ErrorStatusPB* err = controller.error_response();
+      if (err && std::find(err->unsupported_feature_flags().begin(),
+                           err->unsupported_feature_flags().end(),
+                           ConsensusServiceFeatures::OPS_IN_SIDECAR) !=
+                 err->unsupported_feature_flags().end()) {
+        LOG_WITH_PREFIX_UNLOCKED(INFO) << "Peer does not support ops in a sidecar";
+        std::lock_guard<simple_spinlock> l(peer_lock_);
+        ops_sidecar_unsupported_ = true;
+      }
     }
-    ProcessResponseError(controller_.status());
+    ProcessResponseError(rpc, controller.status());
     return;
   }
 
   // Pass through errors we can respond to, like not found, since in that case
   // we will need to start a Tablet Copy. TODO: Handle DELETED response once implemented.
-  if ((response_.has_error() &&
-      response_.error().code() != TabletServerErrorPB::TABLET_NOT_FOUND) ||
-      (response_.status().has_error() &&
-          response_.status().error().code() == consensus::ConsensusErrorPB::CANNOT_PREPARE)) {
+  if ((response.has_error() &&
+      response.error().code() != TabletServerErrorPB::TABLET_NOT_FOUND) ||
+      (response.status().has_error() &&
+          response.status().error().code() == consensus::ConsensusErrorPB::CANNOT_PREPARE)) {
     // Again, let the queue know that the remote is still responsive, since we
     // will not be sending this error response through to the queue.
     queue_->NotifyPeerIsResponsiveDespiteError(peer_pb_.permanent_uuid());
-    ProcessResponseError(StatusFromPB(response_.error().status()));
+    ProcessResponseError(rpc, StatusFromPB(response.error().status()));
     return;
   }
 
@@ -267,22 +383,43 @@ void Peer::ProcessResponse() {
   // the WAL) and SendNextRequest() may do the same thing. So we run the rest
   // of the response handling logic on our thread pool and not on the reactor
   // thread.
-  Status s = thread_pool_->SubmitClosure(Bind(&Peer::DoProcessResponse, Unretained(this)));
+  Status s = thread_pool_->SubmitClosure(Bind(&Peer::DoProcessResponse, Unretained(this),
+                                              Unretained(rpc)));
   if (PREDICT_FALSE(!s.ok())) {
     LOG_WITH_PREFIX_UNLOCKED(WARNING) << "Unable to process peer response: " << s.ToString()
-        << ": " << response_.ShortDebugString();
-    sem_.Release();
+        << ": " << response.ShortDebugString();
+    queue_->NotifyPeerRequestFailed(peer_pb_.permanent_uuid());
+    ReturnRpc(rpc, true);
   }
 }
 
-void Peer::DoProcessResponse() {
-  failed_attempts_ = 0;
+void Peer::DoProcessResponse(UpdateRpc* rpc) {
+  bool stale;
+  {
+    std::lock_guard<simple_spinlock> l(peer_lock_);
+    failed_attempts_ = 0;
+    stale = rpc->seq < last_response_seq_;
+    if (!stale) {
+      last_response_seq_ = rpc->seq;
+    }
+  }
 
   VLOG_WITH_PREFIX_UNLOCKED(2) << "Response from peer " << peer_pb().permanent_uuid() << ": "
-      << response_.ShortDebugString();
+      << rpc->response.ShortDebugString();
+
+  if (PREDICT_FALSE(stale)) {
+    // The response to a later request was already processed, and the peer's
+    // state reported in it is at least as recent as this one's.
+    VLOG_WITH_PREFIX_UNLOCKED(1) << "Ignoring out-of-order response from peer "
+                                 << peer_pb().permanent_uuid();
+    queue_->NotifyPeerIsResponsiveDespiteError(peer_pb_.permanent_uuid());
+    ReturnRpc(rpc, true);
+    return;
+  }
 
   bool more_pending;
-  queue_->ResponseFromPeer(peer_pb_.permanent_uuid(), response_, &more_pending);
+  queue_->ResponseFromPeer(peer_pb_.permanent_uuid(), rpc->response, &more_pending);
+  ReturnRpc(rpc, false);
 
   // We're OK to read the state_ without a lock here -- if we get a race,
   // the worst thing that could happen is that we'll make one more request before
@@ -296,19 +433,20 @@ void Peer::DoProcessResponse() {
 
 Status Peer::SendTabletCopyRequest() {
   if (!FLAGS_enable_tablet_copy) {
+    std::lock_guard<simple_spinlock> l(peer_lock_);
     failed_attempts_++;
     return Status::NotSupported("Tablet Copy is disabled");
   }
 
   RETURN_NOT_OK(queue_->GetTabletCopyRequestForPeer(peer_pb_.permanent_uuid(), &tc_request_));
-  controller_.Reset();
-  proxy_->StartTabletCopy(&tc_request_, &tc_response_, &controller_,
+  tc_controller_.Reset();
+  proxy_->StartTabletCopy(&tc_request_, &tc_response_, &tc_controller_,
                           boost::bind(&Peer::ProcessTabletCopyResponse, this));
   return Status::OK();
 }
 
 void Peer::ProcessTabletCopyResponse() {
-  if (controller_.status().ok() && tc_response_.has_error()) {
+  if (tc_controller_.status().ok() && tc_response_.has_error()) {
     // ALREADY_INPROGRESS is expected, so we do not log this error.
     if (tc_response_.error().code() ==
         TabletServerErrorPB::TabletServerErrorPB::ALREADY_INPROGRESS) {
@@ -318,24 +456,34 @@ void Peer::ProcessTabletCopyResponse() {
                                         << tc_response_.ShortDebugString();
     }
   }
+  {
+    std::lock_guard<simple_spinlock> l(peer_lock_);
+    tc_in_flight_ = false;
+  }
   sem_.Release();
 }
 
-void Peer::ProcessResponseError(const Status& status) {
-  failed_attempts_++;
+void Peer::ProcessResponseError(UpdateRpc* rpc, const Status& status) {
+  uint64_t failed_attempts;
+  {
+    std::lock_guard<simple_spinlock> l(peer_lock_);
+    failed_attempts = ++failed_attempts_;
+  }
+  queue_->NotifyPeerRequestFailed(peer_pb_.permanent_uuid());
   string resp_err_info;
-  if (response_.has_error()) {
+  const ConsensusResponsePB& response = rpc->response;
+  if (response.has_error()) {
     resp_err_info = Substitute(" Error code: $0 ($1).",
-                               TabletServerErrorPB::Code_Name(response_.error().code()),
-                               response_.error().code());
+                               TabletServerErrorPB::Code_Name(response.error().code()),
+                               response.error().code());
   }
   LOG_WITH_PREFIX_UNLOCKED(WARNING) << "Couldn't send request to peer " << peer_pb_.permanent_uuid()
       << " for tablet " << tablet_id_ << "."
       << resp_err_info
       << " Status: " << status.ToString() << "."
       << " Retrying in the next heartbeat period."
-      << " Already tried " << failed_attempts_ << " times.";
-  sem_.Release();
+      << " Already tried " << failed_attempts << " times.";
+  ReturnRpc(rpc, true);
 }
 
 string Peer::LogPrefixUnlocked() const {
@@ -356,13 +504,20 @@ void Peer::Close() {
   }
   LOG_WITH_PREFIX_UNLOCKED(INFO) << "Closing peer: " << peer_pb_.permanent_uuid();
 
-  // Acquire the semaphore to wait for any concurrent request to finish.
-  // They will see the state_ == kPeerClosed and not start any new requests,
-  // but we can't currently cancel the already-sent ones. (see KUDU-699)
-  std::lock_guard<Semaphore> l(sem_);
+  // Acquire all of the semaphore's permits to wait for any concurrent requests
+  // to finish. They will see the state_ == kPeerClosed and not start any new
+  // requests, but we can't currently cancel the already-sent ones. (see KUDU-699)
+  for (int i = 0; i < max_inflight_; i++) {
+    sem_.Acquire();
+  }
   queue_->UntrackPeer(peer_pb_.permanent_uuid());
   // We don't own the ops (the queue does).
-  request_.mutable_ops()->ExtractSubrange(0, request_.ops_size(), nullptr);
+  for (const auto& rpc : rpcs_) {
+    rpc->request.mutable_ops()->ExtractSubrange(0, rpc->request.ops_size(), nullptr);
+  }
+  for (int i = 0; i < max_inflight_; i++) {
+    sem_.Release();
+  }
 }
 
 Peer::~Peer() {
@@ -371,9 +526,11 @@ Peer::~Peer() {
 
 
 RpcPeerProxy::RpcPeerProxy(gscoped_ptr<HostPort> hostport,
-                           gscoped_ptr<ConsensusServiceProxy> consensus_proxy)
+                           gscoped_ptr<ConsensusServiceProxy> consensus_proxy,
+                           shared_ptr<HeartbeatBatcher> heartbeat_batcher)
     : hostport_(std::move(hostport)),
-      consensus_proxy_(std::move(consensus_proxy)) {
+      consensus_proxy_(std::move(consensus_proxy)),
+      heartbeat_batcher_(std::move(heartbeat_batcher)) {
 }
 
 void RpcPeerProxy::UpdateAsync(const ConsensusRequestPB* request,
@@ -381,6 +538,10 @@ void RpcPeerProxy::UpdateAsync(const ConsensusRequestPB* request,
                                rpc::RpcController* controller,
                                const rpc::ResponseCallback& callback) {
   controller->set_timeout(MonoDelta::FromMilliseconds(FLAGS_consensus_rpc_timeout_ms));
+  if (heartbeat_batcher_ && request->ops_size() == 0 && !request->has_ops_sidecar_idx()) {
+    heartbeat_batcher_->UpdateAsync(request, response, controller, callback);
+    return;
+  }
   consensus_proxy_->UpdateConsensusAsync(*request, response, controller, callback);
 }
 
@@ -398,13 +559,15 @@ void RpcPeerProxy::StartTabletCopy(const StartTabletCopyRequestPB* request,
   consensus_proxy_->StartTabletCopyAsync(*request, response, controller, callback);
 }
 
+bool RpcPeerProxy::SupportsOpsSidecar() const {
+  return FLAGS_consensus_send_ops_in_sidecar;
+}
+
 RpcPeerProxy::~RpcPeerProxy() {}
 
 namespace {
 
-Status CreateConsensusServiceProxyForHost(const shared_ptr<Messenger>& messenger,
-                                          const HostPort& hostport,
-                                          gscoped_ptr<ConsensusServiceProxy>* new_proxy) {
+Status ResolvePeerAddress(const HostPort& hostport, Sockaddr* addr) {
   vector<Sockaddr> addrs;
   RETURN_NOT_OK(hostport.ResolveAddresses(&addrs));
   if (addrs.size() > 1) {
@@ -412,7 +575,16 @@ Status CreateConsensusServiceProxyForHost(const shared_ptr<Messenger>& messenger
     << "resolves to " << addrs.size() << " different addresses. Using "
     << addrs[0].ToString();
   }
-  new_proxy->reset(new ConsensusServiceProxy(messenger, addrs[0]));
+  *addr = addrs[0];
+  return Status::OK();
+}
+
+Status CreateConsensusServiceProxyForHost(const shared_ptr<Messenger>& messenger,
+                                          const HostPort& hostport,
+                                          gscoped_ptr<ConsensusServiceProxy>* new_proxy) {
+  Sockaddr addr;
+  RETURN_NOT_OK(ResolvePeerAddress(hostport, &addr));
+  new_proxy->reset(new ConsensusServiceProxy(messenger, addr));
   return Status::OK();
 }
 
@@ -425,9 +597,12 @@ Status RpcPeerProxyFactory::NewProxy(const RaftPeerPB& peer_pb,
                                      gscoped_ptr<PeerProxy>* proxy) {
   gscoped_ptr<HostPort> hostport(new HostPort);
   RETURN_NOT_OK(HostPortFromPB(peer_pb.last_known_addr(), hostport.get()));
-  gscoped_ptr<ConsensusServiceProxy> new_proxy;
-  RETURN_NOT_OK(CreateConsensusServiceProxyForHost(messenger_, *hostport, &new_proxy));
-  proxy->reset(new RpcPeerProxy(std::move(hostport), std::move(new_proxy)));
+  Sockaddr addr;
+  RETURN_NOT_OK(ResolvePeerAddress(*hostport, &addr));
+  gscoped_ptr<ConsensusServiceProxy> new_proxy(new ConsensusServiceProxy(messenger_, addr));
+  shared_ptr<HeartbeatBatcher> batcher =
+      HeartbeatBatcher::GetOrCreate(messenger_, addr, peer_pb.permanent_uuid());
+  proxy->reset(new RpcPeerProxy(std::move(hostport), std::move(new_proxy), std::move(batcher)));
   return Status::OK();
 }
 
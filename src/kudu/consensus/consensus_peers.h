@@ -29,6 +29,7 @@
 #include "kudu/rpc/rpc_controller.h"
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/mutex.h"
 #include "kudu/util/resettable_heartbeater.h"
 #include "kudu/util/semaphore.h"
 #include "kudu/util/status.h"
@@ -48,6 +49,7 @@ class RpcController;
 
 namespace consensus {
 class ConsensusServiceProxy;
+class HeartbeatBatcher;
 class OpId;
 class PeerProxy;
 class PeerProxyFactory;
@@ -106,6 +108,11 @@ class VoteResponsePB;
 //        v                               v
 //  SignalRequest()                    return
 //
+// With --consensus_max_inflight_requests_per_peer greater than 1, "processing"
+// only blocks SignalRequest() once that many requests are outstanding, so
+// batches of operations are pipelined to the peer. Responses that arrive after
+// the response to a later request are ignored, since the later response
+// already reflects the peer's progress.
 class Peer {
  public:
   // Initializes a peer and get its status.
@@ -149,16 +156,45 @@ class Peer {
        gscoped_ptr<PeerProxy> proxy, PeerMessageQueue* queue,
        ThreadPool* thread_pool);
 
+  // A consensus update request sent to the peer, along with its response.
+  struct UpdateRpc {
+    ConsensusRequestPB request;
+    ConsensusResponsePB response;
+
+    // Reference-counted pointers to any ReplicateMsgs which are in-flight to the peer. We
+    // may have loaded these messages from the LogCache, in which case we are potentially
+    // sharing the same object as other peers. Since the PB request itself can't hold
+    // reference counts, this holds them.
+    std::vector<ReplicateRefPtr> replicate_msg_refs;
+
+    rpc::RpcController controller;
+
+    // The order in which the request was sent, among all the requests to the peer.
+    int64_t seq = 0;
+  };
+
   void SendNextRequest(bool even_if_queue_empty);
 
   // Signals that a response was received from the peer.
   // This method is called from the reactor thread and calls
   // DoProcessResponse() on thread_pool_ to do any work that requires IO or
   // lock-taking.
-  void ProcessResponse();
+  void ProcessResponse(UpdateRpc* rpc);
 
   // Run on 'thread_pool'. Does response handling that requires IO or may block.
-  void DoProcessResponse();
+  void DoProcessResponse(UpdateRpc* rpc);
+
+  // Moves the ops of 'rpc's request into an RPC sidecar, built from the
+  // cached encodings of its replicate messages. Leaves the request as it
+  // is if the sidecar can't be attached.
+  void MoveOpsToSidecar(UpdateRpc* rpc);
+
+  // Takes an unused UpdateRpc. The caller must hold a permit of 'sem_'.
+  UpdateRpc* TakeRpc(bool* others_in_flight);
+
+  // Makes 'rpc' available for the next request. If 'release_permit' is true,
+  // also releases the caller's permit of 'sem_'.
+  void ReturnRpc(UpdateRpc* rpc, bool release_permit);
 
   // Fetch the desired tablet copy request from the queue and send it
   // to the peer. The callback goes to ProcessTabletCopyResponse().
@@ -171,7 +207,7 @@ class Peer {
   void ProcessTabletCopyResponse();
 
   // Signals there was an error sending the request to the peer.
-  void ProcessResponseError(const Status& status);
+  void ProcessResponseError(UpdateRpc* rpc, const Status& status);
 
   std::string LogPrefixUnlocked() const;
 
@@ -185,27 +221,43 @@ class Peer {
   gscoped_ptr<PeerProxy> proxy_;
 
   PeerMessageQueue* queue_;
-  uint64_t failed_attempts_;
+  uint64_t failed_attempts_; // Protected by peer_lock_.
 
-  // The latest consensus update request and response.
-  ConsensusRequestPB request_;
-  ConsensusResponsePB response_;
+  // The maximum number of outstanding requests to the peer.
+  const int max_inflight_;
+
+  // One UpdateRpc per permit of 'sem_'. Those not in use are in 'free_rpcs_'.
+  std::vector<std::unique_ptr<UpdateRpc>> rpcs_;
+  std::vector<UpdateRpc*> free_rpcs_; // Protected by peer_lock_.
+
+  // The sequence number of the next request, and of the latest request whose
+  // response was processed. Protected by peer_lock_.
+  int64_t next_seq_;
+  int64_t last_response_seq_;
+
+  // Serializes the assembly and sending of update requests, so that
+  // pipelined requests carry consecutive ranges of operations.
+  Mutex send_lock_;
+
+  // The committed index included in the last assembled request.
+  // Protected by send_lock_.
+  int64_t last_request_committed_index_;
 
   // The latest tablet copy request and response.
   StartTabletCopyRequestPB tc_request_;
   StartTabletCopyResponsePB tc_response_;
+  rpc::RpcController tc_controller_;
 
-  // Reference-counted pointers to any ReplicateMsgs which are in-flight to the peer. We
-  // may have loaded these messages from the LogCache, in which case we are potentially
-  // sharing the same object as other peers. Since the PB request_ itself can't hold
-  // reference counts, this holds them.
-  std::vector<ReplicateRefPtr> replicate_msg_refs_;
+  // Whether a tablet copy request is outstanding. Protected by peer_lock_.
+  bool tc_in_flight_;
 
-  rpc::RpcController controller_;
+  // Set once the peer rejected a request because it doesn't support ops in
+  // a sidecar. Protected by peer_lock_.
+  bool ops_sidecar_unsupported_;
 
-  // Held if there is an outstanding request.
-  // This is used in order to ensure that we only have a single request
-  // oustanding at a time, and to wait for the outstanding requests
+  // A permit is held for each outstanding request.
+  // This is used in order to ensure that we have at most 'max_inflight_'
+  // requests outstanding at a time, and to wait for the outstanding requests
   // at Close().
   Semaphore sem_;
 
@@ -257,6 +309,10 @@ class PeerProxy {
     LOG(DFATAL) << "Not implemented";
   }
 
+  // Whether UpdateAsync() may be passed requests whose ops were moved into an
+  // RPC sidecar of the controller (see ConsensusRequestPB.ops_sidecar_idx).
+  virtual bool SupportsOpsSidecar() const { return false; }
+
   virtual ~PeerProxy() {}
 };
 
@@ -272,10 +328,14 @@ class PeerProxyFactory {
 };
 
 // PeerProxy implementation that does RPC calls
+//
+// If 'heartbeat_batcher' is set, status-only update requests are sent through
+// it, batched with those of other tablets to the same server.
 class RpcPeerProxy : public PeerProxy {
  public:
   RpcPeerProxy(gscoped_ptr<HostPort> hostport,
-               gscoped_ptr<ConsensusServiceProxy> consensus_proxy);
+               gscoped_ptr<ConsensusServiceProxy> consensus_proxy,
+               std::shared_ptr<HeartbeatBatcher> heartbeat_batcher = nullptr);
 
   virtual void UpdateAsync(const ConsensusRequestPB* request,
                            ConsensusResponsePB* response,
@@ -292,11 +352,14 @@ class RpcPeerProxy : public PeerProxy {
                                     rpc::RpcController* controller,
                                     const rpc::ResponseCallback& callback) OVERRIDE;
 
+  virtual bool SupportsOpsSidecar() const OVERRIDE;
+
   virtual ~RpcPeerProxy();
 
  private:
   gscoped_ptr<HostPort> hostport_;
   gscoped_ptr<ConsensusServiceProxy> consensus_proxy_;
+  std::shared_ptr<HeartbeatBatcher> heartbeat_batcher_;
 };
 
 // PeerProxyFactory implementation that generates RPCPeerProxies
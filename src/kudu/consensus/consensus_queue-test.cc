@@ -28,6 +28,7 @@
 #include "kudu/consensus/log_reader.h"
 #include "kudu/consensus/log-test-base.h"
 #include "kudu/fs/fs_manager.h"
+#include "kudu/gutil/bind.h"
 #include "kudu/server/hybrid_clock.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/test_macros.h"
@@ -35,6 +36,9 @@
 
 DECLARE_bool(enable_data_block_fsync);
 DECLARE_int32(consensus_max_batch_size_bytes);
+DECLARE_int32(consensus_max_inflight_requests_per_peer);
+DECLARE_bool(raft_propagate_safe_time);
+DECLARE_bool(tablet_copy_from_followers);
 
 METRIC_DECLARE_entity(tablet);
 
@@ -301,6 +305,112 @@ TEST_F(ConsensusQueueTest, TestGetPagedMessages) {
   request.mutable_ops()->ExtractSubrange(0, request.ops_size(), nullptr);
 }
 
+// Tests that requests pipelined to a peer carry consecutive batches of ops,
+// and that a failed request makes the queue resend everything the peer
+// hasn't acknowledged.
+TEST_F(ConsensusQueueTest, TestPipelinedRequests) {
+  google::FlagSaver saver;
+  FLAGS_consensus_max_inflight_requests_per_peer = 3;
+
+  queue_->Init(MinimumOpId());
+  queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm, BuildRaftConfigPBForTests(2));
+
+  // Size the batches so that each request carries 9 ops, as in TestGetPagedMessages.
+  ConsensusRequestPB page_size_estimator;
+  page_size_estimator.set_caller_term(14);
+  page_size_estimator.set_committed_index(0);
+  page_size_estimator.set_all_replicated_index(0);
+  page_size_estimator.mutable_preceding_id()->CopyFrom(MinimumOpId());
+  const int kOpsPerRequest = 9;
+  for (int i = 0; i < kOpsPerRequest; i++) {
+    page_size_estimator.mutable_ops()->AddAllocated(
+        CreateDummyReplicate(0, 0, clock_->Now(), 0).release());
+  }
+  FLAGS_consensus_max_batch_size_bytes = page_size_estimator.ByteSize();
+
+  ConsensusRequestPB first;
+  ConsensusRequestPB second;
+  ConsensusResponsePB response;
+  response.set_responder_uuid(kPeerUuid);
+  bool more_pending = false;
+  UpdatePeerWatermarkToOp(&first, &response, MinimumOpId(), MinimumOpId(), &more_pending);
+  AppendReplicateMessagesToQueue(queue_.get(), clock_, 1, 100);
+
+  // Nothing is pipelined until an exchange with the peer succeeds.
+  vector<ReplicateRefPtr> first_refs;
+  vector<ReplicateRefPtr> second_refs;
+  bool needs_tablet_copy;
+  ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &first, &first_refs, &needs_tablet_copy));
+  ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &second, &second_refs, &needs_tablet_copy));
+  ASSERT_EQ(kOpsPerRequest, first.ops_size());
+  ASSERT_EQ(0, second.ops_size());
+  SetLastReceivedAndLastCommitted(&response, first.ops(kOpsPerRequest - 1).id());
+  queue_->ResponseFromPeer(kPeerUuid, response, &more_pending);
+  ASSERT_TRUE(more_pending);
+
+  // Two requests sent back to back then carry consecutive batches.
+  ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &first, &first_refs, &needs_tablet_copy));
+  ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &second, &second_refs, &needs_tablet_copy));
+  ASSERT_EQ(kOpsPerRequest, first.ops_size());
+  ASSERT_EQ(kOpsPerRequest, second.ops_size());
+  ASSERT_EQ(kOpsPerRequest + 1, first.ops(0).id().index());
+  ASSERT_EQ(2 * kOpsPerRequest, second.preceding_id().index());
+  ASSERT_EQ(2 * kOpsPerRequest + 1, second.ops(0).id().index());
+  ASSERT_EQ(2, queue_->GetTrackedPeerForTests(kPeerUuid).in_flight_requests.size());
+
+  // Acknowledging the first one leaves the second outstanding, and the next
+  // request continues after it.
+  SetLastReceivedAndLastCommitted(&response, first.ops(kOpsPerRequest - 1).id());
+  queue_->ResponseFromPeer(kPeerUuid, response, &more_pending);
+  ASSERT_TRUE(more_pending);
+  PeerMessageQueue::TrackedPeer peer = queue_->GetTrackedPeerForTests(kPeerUuid);
+  ASSERT_EQ(1, peer.in_flight_requests.size());
+  ASSERT_EQ(3 * kOpsPerRequest + 1, peer.next_index);
+
+  // If the second one fails, its ops are sent again.
+  queue_->NotifyPeerRequestFailed(kPeerUuid);
+  PeerMessageQueue::TrackedPeer reset_peer = queue_->GetTrackedPeerForTests(kPeerUuid);
+  ASSERT_TRUE(reset_peer.in_flight_requests.empty());
+  ASSERT_EQ(2 * kOpsPerRequest + 1, reset_peer.next_index);
+  ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &first, &first_refs, &needs_tablet_copy));
+  ASSERT_EQ(2 * kOpsPerRequest + 1, first.ops(0).id().index());
+
+  // The messages still belong to the queue so we have to release them.
+  first.mutable_ops()->ExtractSubrange(0, first.ops_size(), nullptr);
+  second.mutable_ops()->ExtractSubrange(0, second.ops_size(), nullptr);
+}
+
+static Timestamp FixedSafeTimestamp() {
+  return Timestamp(12345);
+}
+
+// Tests that requests carry the leader's safe time only when
+// --raft_propagate_safe_time is set.
+TEST_F(ConsensusQueueTest, TestRequestsCarrySafeTimestamp) {
+  google::FlagSaver saver;
+  queue_->SetSafeTimestampCallback(Bind(&FixedSafeTimestamp));
+  queue_->Init(MinimumOpId());
+  queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm, BuildRaftConfigPBForTests(2));
+  queue_->TrackPeer(kPeerUuid);
+
+  ConsensusRequestPB request;
+  vector<ReplicateRefPtr> refs;
+  bool needs_tablet_copy;
+  FLAGS_raft_propagate_safe_time = false;
+  ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &request, &refs, &needs_tablet_copy));
+  ASSERT_FALSE(request.has_safe_timestamp());
+
+  FLAGS_raft_propagate_safe_time = true;
+  ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &request, &refs, &needs_tablet_copy));
+  ASSERT_TRUE(request.has_safe_timestamp());
+  ASSERT_EQ(12345, request.safe_timestamp());
+
+  // A reused request doesn't keep a stale safe time.
+  FLAGS_raft_propagate_safe_time = false;
+  ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &request, &refs, &needs_tablet_copy));
+  ASSERT_FALSE(request.has_safe_timestamp());
+}
+
 TEST_F(ConsensusQueueTest, TestPeersDontAckBeyondWatermarks) {
   queue_->Init(MinimumOpId());
   queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm, BuildRaftConfigPBForTests(3));
@@ -445,6 +555,46 @@ TEST_F(ConsensusQueueTest, TestQueueAdvancesCommittedIndex) {
   ASSERT_EQ(queue_->GetAllReplicatedIndex(), 5);
 }
 
+// NON_VOTER learners are fed by the queue, but their acks never count toward
+// the majority.
+TEST_F(ConsensusQueueTest, TestNonVotersDontAdvanceCommittedIndex) {
+  queue_->Init(MinimumOpId());
+  RaftConfigPB config = BuildRaftConfigPBForTests(5);
+  config.mutable_peers(3)->set_member_type(RaftPeerPB::NON_VOTER);
+  config.mutable_peers(4)->set_member_type(RaftPeerPB::NON_VOTER);
+  queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm, config);
+  queue_->TrackPeer("peer-1");
+  queue_->TrackPeer("peer-2");
+  queue_->TrackPeer("peer-3");
+  queue_->TrackPeer("peer-4");
+
+  AppendReplicateMessagesToQueue(queue_.get(), clock_, 1, 10);
+  WaitForLocalPeerToAckIndex(10);
+
+  ConsensusResponsePB response;
+  response.set_responder_term(1);
+  bool more_pending;
+  SetLastReceivedAndLastCommitted(&response, MakeOpId(1, 10), MinimumOpId().index());
+
+  // Both learners have all the operations, but with the local peer that's
+  // still a single voter out of a majority of two.
+  response.set_responder_uuid("peer-3");
+  queue_->ResponseFromPeer(response.responder_uuid(), response, &more_pending);
+  response.set_responder_uuid("peer-4");
+  queue_->ResponseFromPeer(response.responder_uuid(), response, &more_pending);
+  ASSERT_EQ(queue_->GetMajorityReplicatedIndexForTests(), 0);
+  ASSERT_EQ(queue_->GetCommittedIndex(), 0);
+
+  // A second voter makes the majority.
+  response.set_responder_uuid("peer-1");
+  queue_->ResponseFromPeer(response.responder_uuid(), response, &more_pending);
+  ASSERT_EQ(queue_->GetMajorityReplicatedIndexForTests(), 10);
+  ASSERT_EQ(queue_->GetCommittedIndex(), 10);
+
+  // The all-replicated index still waits on every peer, learners included.
+  ASSERT_EQ(queue_->GetAllReplicatedIndex(), 0);
+}
+
 // In this test we append a sequence of operations to a log
 // and then start tracking a peer whose first required operation
 // is before the first operation in the queue.
@@ -815,6 +965,55 @@ TEST_F(ConsensusQueueTest, TestTriggerTabletCopyIfTabletNotFound) {
             tc_req.copy_peer_addr().ShortDebugString());
 }
 
+// Test that a peer which needs a tablet copy is sent to an up-to-date
+// follower rather than to the leader, unless disabled.
+TEST_F(ConsensusQueueTest, TestTabletCopyFromFollower) {
+  const string kFollowerUuid = "peer-2";
+  queue_->Init(MinimumOpId());
+  queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm, BuildRaftConfigPBForTests(3));
+  AppendReplicateMessagesToQueue(queue_.get(), clock_, 1, 100);
+
+  // The follower has all the operations.
+  ConsensusRequestPB request;
+  ConsensusResponsePB response;
+  vector<ReplicateRefPtr> refs;
+  bool needs_tablet_copy;
+  bool more_pending = false;
+  queue_->TrackPeer(kFollowerUuid);
+  ASSERT_OK(queue_->RequestForPeer(kFollowerUuid, &request, &refs, &needs_tablet_copy));
+  response.set_responder_uuid(kFollowerUuid);
+  SetLastReceivedAndLastCommitted(&response, MakeOpId(14, 100), 0);
+  queue_->ResponseFromPeer(kFollowerUuid, response, &more_pending);
+
+  // The other peer doesn't have the tablet.
+  queue_->TrackPeer(kPeerUuid);
+  for (bool from_followers : { true, false }) {
+    FLAGS_tablet_copy_from_followers = from_followers;
+    request.Clear();
+    ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &request, &refs, &needs_tablet_copy));
+    response.Clear();
+    response.set_responder_uuid(kPeerUuid);
+    response.mutable_error()->set_code(tserver::TabletServerErrorPB::TABLET_NOT_FOUND);
+    StatusToPB(Status::NotFound("No such tablet"), response.mutable_error()->mutable_status());
+    queue_->ResponseFromPeer(kPeerUuid, response, &more_pending);
+    request.Clear();
+    ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &request, &refs, &needs_tablet_copy));
+    ASSERT_TRUE(needs_tablet_copy);
+
+    StartTabletCopyRequestPB tc_req;
+    ASSERT_OK(queue_->GetTabletCopyRequestForPeer(kPeerUuid, &tc_req));
+    ASSERT_TRUE(tc_req.IsInitialized()) << tc_req.ShortDebugString();
+    if (from_followers) {
+      ASSERT_EQ(kFollowerUuid, tc_req.copy_peer_uuid());
+      ASSERT_EQ("peer-2.fake-domain-for-tests", tc_req.copy_peer_addr().host());
+      ASSERT_EQ(kLeaderUuid, tc_req.fallback_peer_uuid());
+    } else {
+      ASSERT_EQ(kLeaderUuid, tc_req.copy_peer_uuid());
+      ASSERT_FALSE(tc_req.has_fallback_peer_uuid());
+    }
+  }
+}
+
 TEST_F(ConsensusQueueTest, TestFollowerCommittedIndexAndMetrics) {
   queue_->Init(MinimumOpId());
   queue_->SetNonLeaderMode();
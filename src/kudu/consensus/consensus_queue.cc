@@ -52,12 +52,35 @@ DEFINE_int32(consensus_max_batch_size_bytes, 1024 * 1024,
              "The maximum per-tablet RPC batch size when updating peers.");
 TAG_FLAG(consensus_max_batch_size_bytes, advanced);
 
+DEFINE_int32(consensus_max_inflight_requests_per_peer, 1,
+             "The maximum number of UpdateConsensus requests a leader keeps "
+             "outstanding to each follower. Values greater than 1 pipeline "
+             "batches of operations to a follower without waiting for the "
+             "previous batch to be acknowledged.");
+TAG_FLAG(consensus_max_inflight_requests_per_peer, advanced);
+TAG_FLAG(consensus_max_inflight_requests_per_peer, experimental);
+
 DEFINE_int32(follower_unavailable_considered_failed_sec, 300,
              "Seconds that a leader is unable to successfully heartbeat to a "
              "follower after which the follower is considered to be failed and "
              "evicted from the config.");
 TAG_FLAG(follower_unavailable_considered_failed_sec, advanced);
 
+DEFINE_bool(tablet_copy_from_followers, true,
+            "Whether a leader asks a replica which needs a tablet copy to copy "
+            "from a healthy, up-to-date follower rather than from the leader, "
+            "which is usually the busiest replica. The leader remains the "
+            "fallback source.");
+TAG_FLAG(tablet_copy_from_followers, advanced);
+TAG_FLAG(tablet_copy_from_followers, runtime);
+
+DEFINE_bool(raft_propagate_safe_time, false,
+            "Whether leaders send their safe time to followers along with the "
+            "committed index, allowing followers to serve READ_BOUNDED_STALENESS "
+            "scans.");
+TAG_FLAG(raft_propagate_safe_time, advanced);
+TAG_FLAG(raft_propagate_safe_time, experimental);
+
 DEFINE_int32(consensus_inject_latency_ms_in_notifications, 0,
              "Injects a random sleep between 0 and this many milliseconds into "
              "asynchronous notifications from the consensus queue back to the "
@@ -84,11 +107,11 @@ METRIC_DEFINE_gauge_int64(tablet, in_progress_ops, "Operations in Progress",
 std::string PeerMessageQueue::TrackedPeer::ToString() const {
   return Substitute("Peer: $0, Is new: $1, Last received: $2, Next index: $3, "
                     "Last known committed idx: $4, Last exchange result: $5, "
-                    "Needs tablet copy: $6",
+                    "Needs tablet copy: $6, Requests in flight: $7",
                     uuid, is_new, OpIdToString(last_received), next_index,
                     last_known_committed_index,
                     is_last_exchange_successful ? "SUCCESS" : "ERROR",
-                    needs_tablet_copy);
+                    needs_tablet_copy, in_flight_requests.size());
 }
 
 #define INSTANTIATE_METRIC(x) \
@@ -298,6 +321,14 @@ Status PeerMessageQueue::RequestForPeer(const string& uuid,
                                         bool* needs_tablet_copy) {
   TrackedPeer* peer = nullptr;
   OpId preceding_id;
+
+  // The safe time must be taken before reading the committed index: every
+  // transaction with a timestamp at or below it has then been applied, and
+  // therefore committed, by the time the index is read.
+  Timestamp safe_timestamp = Timestamp::kInvalidTimestamp;
+  if (FLAGS_raft_propagate_safe_time && !safe_timestamp_callback_.is_null()) {
+    safe_timestamp = safe_timestamp_callback_.Run();
+  }
   {
     std::lock_guard<simple_spinlock> lock(queue_lock_);
     DCHECK_EQ(queue_state_.state, kQueueOpen);
@@ -315,6 +346,11 @@ Status PeerMessageQueue::RequestForPeer(const string& uuid,
     // log entry preceding the first one in 'messages' if messages are found for the peer.
     preceding_id = queue_state_.last_appended;
     request->set_committed_index(queue_state_.committed_index);
+    if (safe_timestamp != Timestamp::kInvalidTimestamp) {
+      request->set_safe_timestamp(safe_timestamp.ToUint64());
+    } else {
+      request->clear_safe_timestamp();
+    }
     request->set_all_replicated_index(queue_state_.all_replicated_index);
     request->set_caller_term(queue_state_.current_term);
   }
@@ -345,14 +381,27 @@ Status PeerMessageQueue::RequestForPeer(const string& uuid,
   // If we've never communicated with the peer, we don't know what messages to
   // send, so we'll send a status-only request. Otherwise, we grab requests
   // from the log starting at the last_received point.
-  if (!peer->is_new) {
+  //
+  // When pipelining, we only send ops behind outstanding requests if the
+  // last exchange with the peer succeeded; otherwise the outstanding requests
+  // are likely to fail too, and we wait for them to resolve.
+  bool pipelining = FLAGS_consensus_max_inflight_requests_per_peer > 1;
+  int64_t next_index;
+  bool send_ops;
+  {
+    std::lock_guard<simple_spinlock> lock(queue_lock_);
+    next_index = peer->next_index;
+    send_ops = !peer->is_new &&
+        (peer->in_flight_requests.empty() || peer->is_last_exchange_successful);
+  }
+  if (send_ops) {
 
     // The batch of messages to send to the peer.
     vector<ReplicateRefPtr> messages;
     int max_batch_size = FLAGS_consensus_max_batch_size_bytes - request->ByteSize();
 
     // We try to get the follower's next_index from our log.
-    Status s = log_cache_.ReadOps(peer->next_index - 1,
+    Status s = log_cache_.ReadOps(next_index - 1,
                                   max_batch_size,
                                   &messages,
                                   &preceding_id);
@@ -389,6 +438,20 @@ Status PeerMessageQueue::RequestForPeer(const string& uuid,
     }
     msg_refs->swap(messages);
     DCHECK_LE(request->ByteSize(), FLAGS_consensus_max_batch_size_bytes);
+
+    // Track the request and move on to the following ops, so that the next
+    // request can be sent before this one is acknowledged. Callers send
+    // requests to a given peer one at a time, so 'next_index' can't have
+    // been changed by another request in the meantime, but a response may
+    // have moved it, in which case this request is not tracked.
+    if (pipelining && request->ops_size() > 0) {
+      std::lock_guard<simple_spinlock> lock(queue_lock_);
+      if (peer->next_index == next_index) {
+        int64_t last_index = request->ops(request->ops_size() - 1).id().index();
+        peer->in_flight_requests.push_back({ next_index, last_index });
+        peer->next_index = last_index + 1;
+      }
+    }
   }
 
   DCHECK(preceding_id.IsInitialized());
@@ -425,6 +488,8 @@ Status PeerMessageQueue::RequestForPeer(const string& uuid,
 Status PeerMessageQueue::GetTabletCopyRequestForPeer(const string& uuid,
                                                           StartTabletCopyRequestPB* req) {
   TrackedPeer* peer = nullptr;
+  RaftPeerPB source;
+  bool copy_from_follower = false;
   {
     std::lock_guard<simple_spinlock> lock(queue_lock_);
     DCHECK_EQ(queue_state_.state, kQueueOpen);
@@ -433,6 +498,11 @@ Status PeerMessageQueue::GetTabletCopyRequestForPeer(const string& uuid,
     if (PREDICT_FALSE(peer == nullptr || queue_state_.mode == NON_LEADER)) {
       return Status::NotFound("Peer not tracked or queue not in leader mode.");
     }
+    const RaftPeerPB* follower = PickTabletCopySourceUnlocked(uuid);
+    if (follower) {
+      source = *follower;
+      copy_from_follower = true;
+    }
   }
 
   if (PREDICT_FALSE(!peer->needs_tablet_copy)) {
@@ -441,18 +511,54 @@ Status PeerMessageQueue::GetTabletCopyRequestForPeer(const string& uuid,
   req->Clear();
   req->set_dest_uuid(uuid);
   req->set_tablet_id(tablet_id_);
-  req->set_copy_peer_uuid(local_peer_pb_.permanent_uuid());
-  *req->mutable_copy_peer_addr() = local_peer_pb_.last_known_addr();
+  if (copy_from_follower) {
+    req->set_copy_peer_uuid(source.permanent_uuid());
+    *req->mutable_copy_peer_addr() = source.last_known_addr();
+    req->set_fallback_peer_uuid(local_peer_pb_.permanent_uuid());
+    *req->mutable_fallback_peer_addr() = local_peer_pb_.last_known_addr();
+  } else {
+    req->set_copy_peer_uuid(local_peer_pb_.permanent_uuid());
+    *req->mutable_copy_peer_addr() = local_peer_pb_.last_known_addr();
+  }
   req->set_caller_term(queue_state_.current_term);
   peer->needs_tablet_copy = false; // Now reset the flag.
   return Status::OK();
 }
 
+const RaftPeerPB* PeerMessageQueue::PickTabletCopySourceUnlocked(const string& dest_uuid) const {
+  if (!FLAGS_tablet_copy_from_followers || !queue_state_.active_config) {
+    return nullptr;
+  }
+  // The leader has no view of the location or the load of its followers, so
+  // it picks the follower furthest ahead among those it last reached. Having
+  // every committed operation, the copy only needs to be caught up with what
+  // the leader appended since.
+  const RaftPeerPB* source = nullptr;
+  int64_t source_index = queue_state_.committed_index - 1;
+  for (const RaftPeerPB& peer_pb : queue_state_.active_config->peers()) {
+    const string& peer_uuid = peer_pb.permanent_uuid();
+    if (peer_uuid == dest_uuid || peer_uuid == local_peer_pb_.permanent_uuid() ||
+        !peer_pb.has_last_known_addr()) {
+      continue;
+    }
+    const TrackedPeer* peer = FindPtrOrNull(peers_map_, peer_uuid);
+    if (peer == nullptr || !peer->is_last_exchange_successful || peer->needs_tablet_copy) {
+      continue;
+    }
+    if (peer->last_received.index() > source_index) {
+      source = &peer_pb;
+      source_index = peer->last_received.index();
+    }
+  }
+  return source;
+}
+
 void PeerMessageQueue::AdvanceQueueWatermark(const char* type,
                                              int64_t* watermark,
                                              const OpId& replicated_before,
                                              const OpId& replicated_after,
                                              int num_peers_required,
+                                             ReplicaTypes replica_types,
                                              const TrackedPeer* peer) {
 
   if (VLOG_IS_ON(2)) {
@@ -491,6 +597,13 @@ void PeerMessageQueue::AdvanceQueueWatermark(const char* type,
     // was an error (LMP mismatch, for example), the 'last_received' is _not_ usable
     // for watermark calculation. This could be fixed by separately storing the
     // 'match_index' on a per-peer basis and using that for watermark calculation.
+    //
+    // NON_VOTER learners are fed like any other peer, but their acks must not
+    // count toward the majority, or they could commit an op no voter has.
+    if (replica_types == VOTER_REPLICAS &&
+        !IsRaftConfigVoter(peer.first, *queue_state_.active_config)) {
+      continue;
+    }
     if (peer.second->is_last_exchange_successful) {
       watermarks.push_back(peer.second->last_received.index());
     }
@@ -537,6 +650,16 @@ void PeerMessageQueue::NotifyPeerIsResponsiveDespiteError(const std::string& pee
   peer->last_successful_communication_time = MonoTime::Now();
 }
 
+void PeerMessageQueue::NotifyPeerRequestFailed(const std::string& peer_uuid) {
+  std::lock_guard<simple_spinlock> l(queue_lock_);
+  TrackedPeer* peer = FindPtrOrNull(peers_map_, peer_uuid);
+  if (!peer || peer->in_flight_requests.empty()) return;
+  // We don't know which of the outstanding requests failed, so resend all of
+  // them. The peer ignores ops it has already received.
+  peer->next_index = peer->in_flight_requests.front().first_index;
+  peer->in_flight_requests.clear();
+}
+
 void PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
                                         const ConsensusResponsePB& response,
                                         bool* more_pending) {
@@ -564,6 +687,7 @@ void PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
           << response.ShortDebugString();
 
       peer->needs_tablet_copy = true;
+      peer->in_flight_requests.clear();
       VLOG_WITH_PREFIX_UNLOCKED(1) << "Marked peer as needing tablet copy: "
                                      << peer->ToString();
       *more_pending = true;
@@ -634,6 +758,9 @@ void PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
 
     if (PREDICT_FALSE(status.has_error())) {
       peer->is_last_exchange_successful = false;
+      // Whatever was pipelined behind the failed request has to be resent
+      // starting at the index computed above.
+      peer->in_flight_requests.clear();
       switch (status.error().code()) {
         case ConsensusErrorPB::PRECEDING_ENTRY_DIDNT_MATCH: {
           DCHECK(status.has_last_received());
@@ -664,6 +791,17 @@ void PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
 
     peer->is_last_exchange_successful = true;
 
+    // Forget the requests the peer has now acknowledged, and keep sending
+    // after the ones that are still outstanding.
+    while (!peer->in_flight_requests.empty() &&
+           peer->in_flight_requests.front().last_index <= peer->last_received.index()) {
+      peer->in_flight_requests.pop_front();
+    }
+    if (!peer->in_flight_requests.empty()) {
+      peer->next_index = std::max(peer->next_index,
+                                  peer->in_flight_requests.back().last_index + 1);
+    }
+
     if (response.has_responder_term()) {
       // The peer must have responded with a term that is greater than or equal to
       // the last known term for that peer.
@@ -693,6 +831,7 @@ void PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
                             previous.last_received,
                             peer->last_received,
                             queue_state_.majority_size_,
+                            VOTER_REPLICAS,
                             peer);
 
       // Advance the all replicated index.
@@ -701,6 +840,7 @@ void PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
                             previous.last_received,
                             peer->last_received,
                             peers_map_.size(),
+                            ALL_REPLICAS,
                             peer);
 
       // If the majority-replicated index is in our current term,
@@ -851,6 +991,10 @@ void PeerMessageQueue::RegisterObserver(PeerMessageQueueObserver* observer) {
   }
 }
 
+void PeerMessageQueue::SetSafeTimestampCallback(const SafeTimestampCallback& callback) {
+  safe_timestamp_callback_ = callback;
+}
+
 Status PeerMessageQueue::UnRegisterObserver(PeerMessageQueueObserver* observer) {
   std::lock_guard<simple_spinlock> lock(queue_lock_);
   auto iter = std::find(observers_.begin(), observers_.end(), observer);
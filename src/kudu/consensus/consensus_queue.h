@@ -19,6 +19,7 @@
 #define KUDU_CONSENSUS_CONSENSUS_QUEUE_H_
 
 #include <boost/optional.hpp>
+#include <deque>
 #include <iosfwd>
 #include <map>
 #include <string>
@@ -31,6 +32,8 @@
 #include "kudu/consensus/log_util.h"
 #include "kudu/consensus/opid_util.h"
 #include "kudu/consensus/ref_counted_replicate.h"
+#include "kudu/common/timestamp.h"
+#include "kudu/gutil/callback.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/logging.h"
@@ -62,12 +65,20 @@ extern const char kConsensusQueueParentTrackerId[];
 //
 // This class is used only on the LEADER side.
 //
-// TODO Right now this class is able to track one outstanding operation
-// per peer. If we want to have more than one outstanding RPC we need to
-// modify it.
+// Up to --consensus_max_inflight_requests_per_peer requests may be
+// outstanding to a peer at once. Requests sent behind others optimistically
+// advance the peer's 'next_index', and the ranges they carry are tracked
+// until the peer acknowledges them or one of them fails.
 class PeerMessageQueue {
  public:
   struct TrackedPeer {
+    // The range of ops carried by a request that was sent to the peer but
+    // whose response hasn't been processed yet.
+    struct InFlightRequest {
+      int64_t first_index;
+      int64_t last_index;
+    };
+
     explicit TrackedPeer(std::string uuid)
         : uuid(std::move(uuid)),
           is_new(true),
@@ -116,6 +127,11 @@ class PeerMessageQueue {
     // Whether the follower was detected to need tablet copy.
     bool needs_tablet_copy;
 
+    // The requests with ops that are outstanding to this peer, oldest first.
+    // Only tracked when pipelining is enabled, in which case 'next_index'
+    // points past the last of them.
+    std::deque<InFlightRequest> in_flight_requests;
+
     // Throttler for how often we will log status messages pertaining to this
     // peer (eg when it is lagging, etc).
     logging::LogThrottler status_log_throttler;
@@ -204,6 +220,10 @@ class PeerMessageQueue {
   // Fill in a StartTabletCopyRequest for the specified peer.
   // If that peer should not initiate Tablet Copy, returns a non-OK status.
   // On success, also internally resets peer->needs_tablet_copy to false.
+  //
+  // With --tablet_copy_from_followers, the copy source is a healthy follower
+  // which has all the committed operations, if there is one, with this
+  // leader as the fallback source.
   virtual Status GetTabletCopyRequestForPeer(const std::string& uuid,
                                                   StartTabletCopyRequestPB* req);
 
@@ -213,6 +233,12 @@ class PeerMessageQueue {
   // may not be fully up and running or able to accept updates.
   void NotifyPeerIsResponsiveDespiteError(const std::string& peer_uuid);
 
+  // Notifies the queue that a request sent to the peer failed without a
+  // response the queue could use. Any requests pipelined to the peer are
+  // forgotten and the peer's 'next_index' is rewound to the first op that
+  // hasn't been acknowledged, so those ops are sent again.
+  virtual void NotifyPeerRequestFailed(const std::string& peer_uuid);
+
   // Updates the request queue with the latest response of a peer, returns
   // whether this peer has more requests pending.
   virtual void ResponseFromPeer(const std::string& peer_uuid,
@@ -257,6 +283,14 @@ class PeerMessageQueue {
 
   virtual Status UnRegisterObserver(PeerMessageQueueObserver* observer);
 
+  // Sets the callback used to obtain the leader's safe time, which is sent to
+  // followers along with the committed index when --raft_propagate_safe_time
+  // is set. The callback may return Timestamp::kInvalidTimestamp if there is no
+  // safe time to propagate. Must be called before the queue is put in leader
+  // mode.
+  typedef Callback<Timestamp(void)> SafeTimestampCallback;
+  void SetSafeTimestampCallback(const SafeTimestampCallback& callback);
+
   struct Metrics {
     // Keeps track of the number of ops. that are completed by a majority but still need
     // to be replicated to a minority (IsDone() is true, IsAllDone() is false).
@@ -283,6 +317,14 @@ class PeerMessageQueue {
     NON_LEADER
   };
 
+  // The peers whose progress counts toward a watermark.
+  // ALL_REPLICAS - Every tracked peer, including the NON_VOTER learners.
+  // VOTER_REPLICAS - Only the VOTER peers of the active config.
+  enum ReplicaTypes {
+    ALL_REPLICAS,
+    VOTER_REPLICAS
+  };
+
   enum State {
     kQueueConstructed,
     kQueueOpen,
@@ -369,6 +411,10 @@ class PeerMessageQueue {
 
   void TrackPeerUnlocked(const std::string& uuid);
 
+  // Returns the follower to copy the tablet to peer 'dest_uuid' from, or
+  // NULL if this leader should be the source.
+  const RaftPeerPB* PickTabletCopySourceUnlocked(const std::string& dest_uuid) const;
+
   // Checks that if the queue is in LEADER mode then all registered peers are
   // in the active config. Crashes with a FATAL log message if this invariant
   // does not hold. If the queue is in NON_LEADER mode, does nothing.
@@ -379,16 +425,20 @@ class PeerMessageQueue {
                                const StatusCallback& callback,
                                const Status& status);
 
-  // Advances 'watermark' to the smallest op that 'num_peers_required' have.
+  // Advances 'watermark' to the smallest op that 'num_peers_required' of the
+  // peers of 'replica_types' have.
   void AdvanceQueueWatermark(const char* type,
                              int64_t* watermark,
                              const OpId& replicated_before,
                              const OpId& replicated_after,
                              int num_peers_required,
+                             ReplicaTypes replica_types,
                              const TrackedPeer* who_caused);
 
   std::vector<PeerMessageQueueObserver*> observers_;
 
+  SafeTimestampCallback safe_timestamp_callback_;
+
   // The pool which executes observer notifications.
   // TODO consider reusing a another pool.
   gscoped_ptr<ThreadPool> observers_pool_;
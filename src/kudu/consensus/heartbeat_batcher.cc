@@ -0,0 +1,215 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#include "kudu/consensus/heartbeat_batcher.h"
+
+#include <boost/bind.hpp>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include "kudu/gutil/once.h"
+#include "kudu/rpc/messenger.h"
+#include "kudu/rpc/rpc_header.pb.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/net/sockaddr.h"
+
+DEFINE_int32(raft_heartbeat_batch_window_ms, 0,
+             "If greater than 0, status-only consensus requests (such as "
+             "heartbeats) from the leaders of all tablets on this server to the "
+             "same follower server are held for up to this many milliseconds "
+             "and sent together in a single RPC.");
+TAG_FLAG(raft_heartbeat_batch_window_ms, advanced);
+TAG_FLAG(raft_heartbeat_batch_window_ms, experimental);
+
+DECLARE_int32(consensus_rpc_timeout_ms);
+
+using std::shared_ptr;
+using std::string;
+using std::weak_ptr;
+
+namespace kudu {
+namespace consensus {
+
+namespace {
+
+// The most requests sent in a single batch. Upon reaching it, the pending
+// requests are sent without waiting for the end of the batching window.
+const int kMaxRequestsPerBatch = 1024;
+
+// The batchers of this process, by messenger and destination server.
+typedef std::map<std::pair<const rpc::Messenger*, string>, weak_ptr<HeartbeatBatcher>>
+    BatcherMap;
+
+simple_spinlock* batchers_lock = nullptr;
+BatcherMap* batchers = nullptr;
+GoogleOnceType batchers_once = GOOGLE_ONCE_INIT;
+
+void InitBatchers() {
+  batchers_lock = new simple_spinlock();
+  batchers = new BatcherMap();
+}
+
+} // anonymous namespace
+
+HeartbeatBatcher::HeartbeatBatcher(shared_ptr<rpc::Messenger> messenger,
+                                   const Sockaddr& addr,
+                                   string dest_uuid)
+    : messenger_(std::move(messenger)),
+      proxy_(messenger_, addr),
+      dest_uuid_(std::move(dest_uuid)),
+      flush_scheduled_(false),
+      batching_unsupported_(false) {
+}
+
+HeartbeatBatcher::~HeartbeatBatcher() {
+  DCHECK(pending_.empty());
+}
+
+shared_ptr<HeartbeatBatcher> HeartbeatBatcher::GetOrCreate(
+    const shared_ptr<rpc::Messenger>& messenger,
+    const Sockaddr& addr,
+    const string& dest_uuid) {
+  if (FLAGS_raft_heartbeat_batch_window_ms <= 0) {
+    return nullptr;
+  }
+  GoogleOnceInit(&batchers_once, &InitBatchers);
+  std::lock_guard<simple_spinlock> l(*batchers_lock);
+
+  // Forget the batchers no longer in use by any peer.
+  for (auto it = batchers->begin(); it != batchers->end();) {
+    if (it->second.expired()) {
+      it = batchers->erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  weak_ptr<HeartbeatBatcher>& entry =
+      (*batchers)[std::make_pair(messenger.get(), dest_uuid + "@" + addr.ToString())];
+  shared_ptr<HeartbeatBatcher> batcher = entry.lock();
+  if (!batcher) {
+    batcher = std::make_shared<HeartbeatBatcher>(messenger, addr, dest_uuid);
+    entry = batcher;
+  }
+  return batcher;
+}
+
+void HeartbeatBatcher::UpdateAsync(const ConsensusRequestPB* request,
+                                   ConsensusResponsePB* response,
+                                   rpc::RpcController* controller,
+                                   const rpc::ResponseCallback& callback) {
+  DCHECK_EQ(0, request->ops_size());
+  bool flush_now = false;
+  bool schedule_flush = false;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    pending_.push_back({ request, response, controller, callback });
+    if (pending_.size() >= kMaxRequestsPerBatch) {
+      flush_now = true;
+    } else if (!flush_scheduled_) {
+      flush_scheduled_ = true;
+      schedule_flush = true;
+    }
+  }
+  if (flush_now) {
+    Flush();
+  } else if (schedule_flush) {
+    messenger_->ScheduleOnReactor(
+        boost::bind(&HeartbeatBatcher::ScheduledFlush, shared_from_this(), _1),
+        MonoDelta::FromMilliseconds(FLAGS_raft_heartbeat_batch_window_ms));
+  }
+}
+
+void HeartbeatBatcher::ScheduledFlush(const Status& status) {
+  // Even if the reactor is shutting down, the pending requests have to be
+  // sent so that their callbacks run; they then fail like any other RPC.
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    flush_scheduled_ = false;
+  }
+  Flush();
+}
+
+void HeartbeatBatcher::Flush() {
+  std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+  bool batching_unsupported;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    batch->pending.swap(pending_);
+    batching_unsupported = batching_unsupported_;
+  }
+  if (batch->pending.empty()) {
+    return;
+  }
+  if (batch->pending.size() == 1 || batching_unsupported) {
+    for (const PendingRequest& pending : batch->pending) {
+      SendOnItsOwn(pending);
+    }
+    return;
+  }
+
+  batch->request.set_dest_uuid(dest_uuid_);
+  for (const PendingRequest& pending : batch->pending) {
+    batch->request.add_requests()->CopyFrom(*pending.request);
+  }
+  batch->controller.set_timeout(MonoDelta::FromMilliseconds(FLAGS_consensus_rpc_timeout_ms));
+  proxy_.MultiUpdateConsensusAsync(batch->request, &batch->response, &batch->controller,
+                                   boost::bind(&HeartbeatBatcher::BatchDone,
+                                               shared_from_this(), batch));
+}
+
+void HeartbeatBatcher::BatchDone(const std::shared_ptr<Batch>& batch) {
+  const Status& s = batch->controller.status();
+  if (PREDICT_FALSE(!s.ok() || batch->response.has_error() ||
+                    batch->response.responses_size() != batch->pending.size())) {
+    const rpc::ErrorStatusPB* err = batch->controller.error_response();
+    if (s.IsRemoteError() && err && err->has_code() &&
+        err->code() == rpc::ErrorStatusPB::ERROR_NO_SUCH_METHOD) {
+      LOG(INFO) << "Server " << dest_uuid_ << " doesn't support batched consensus "
+                << "requests, sending them one by one";
+      std::lock_guard<simple_spinlock> l(lock_);
+      batching_unsupported_ = true;
+    } else {
+      VLOG(1) << "Batch of " << batch->pending.size() << " consensus requests to "
+              << dest_uuid_ << " failed, resending them one by one: "
+              << (s.ok() ? batch->response.ShortDebugString() : s.ToString());
+    }
+    for (const PendingRequest& pending : batch->pending) {
+      SendOnItsOwn(pending);
+    }
+    return;
+  }
+
+  // The callers' controllers never carried an RPC of their own, so their
+  // status is OK, as it is for a successful RPC.
+  for (int i = 0; i < batch->pending.size(); i++) {
+    const PendingRequest& pending = batch->pending[i];
+    pending.response->Swap(batch->response.mutable_responses(i));
+    pending.callback();
+  }
+}
+
+void HeartbeatBatcher::SendOnItsOwn(const PendingRequest& pending) {
+  proxy_.UpdateConsensusAsync(*pending.request, pending.response, pending.controller,
+                              pending.callback);
+}
+
+} // namespace consensus
+} // namespace kudu
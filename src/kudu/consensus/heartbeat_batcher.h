@@ -0,0 +1,129 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CONSENSUS_HEARTBEAT_BATCHER_H
+#define KUDU_CONSENSUS_HEARTBEAT_BATCHER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kudu/consensus/consensus.pb.h"
+#include "kudu/consensus/consensus.proxy.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/rpc/response_callback.h"
+#include "kudu/rpc/rpc_controller.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class Sockaddr;
+
+namespace rpc {
+class Messenger;
+}
+
+namespace consensus {
+
+// Combines the status-only UpdateConsensus requests that the leaders of many
+// tablets send to the same server into MultiUpdateConsensus RPCs.
+//
+// A request handed to the batcher waits for at most
+// --raft_heartbeat_batch_window_ms, to be sent along with the other requests
+// to the same server that arrive in the meantime. The responses are then
+// handed back to each request's callback as if it had been sent on its own.
+//
+// If a batch fails as a whole, each of its requests is resent in its own
+// UpdateConsensus RPC, so that every peer sees the failure (or success) of an
+// RPC of its own. Servers that don't support MultiUpdateConsensus get all
+// further requests that way.
+//
+// This class is thread-safe.
+class HeartbeatBatcher : public std::enable_shared_from_this<HeartbeatBatcher> {
+ public:
+  HeartbeatBatcher(std::shared_ptr<rpc::Messenger> messenger,
+                   const Sockaddr& addr,
+                   std::string dest_uuid);
+  ~HeartbeatBatcher();
+
+  // Returns the batcher for the requests sent through 'messenger' to the
+  // server with 'dest_uuid' at 'addr', creating it if there is none.
+  // Returns nullptr if --raft_heartbeat_batch_window_ms is 0.
+  static std::shared_ptr<HeartbeatBatcher> GetOrCreate(
+      const std::shared_ptr<rpc::Messenger>& messenger,
+      const Sockaddr& addr,
+      const std::string& dest_uuid);
+
+  // Sends 'request' as part of the next batch. Has the same contract as
+  // PeerProxy::UpdateAsync(). 'request' must not contain any ops.
+  void UpdateAsync(const ConsensusRequestPB* request,
+                   ConsensusResponsePB* response,
+                   rpc::RpcController* controller,
+                   const rpc::ResponseCallback& callback);
+
+ private:
+  // A request waiting to be sent. Owned by the caller of UpdateAsync().
+  struct PendingRequest {
+    const ConsensusRequestPB* request;
+    ConsensusResponsePB* response;
+    rpc::RpcController* controller;
+    rpc::ResponseCallback callback;
+  };
+
+  // A MultiUpdateConsensus RPC and the requests it carries.
+  struct Batch {
+    MultiConsensusRequestPB request;
+    MultiConsensusResponsePB response;
+    rpc::RpcController controller;
+    std::vector<PendingRequest> pending;
+  };
+
+  // Sends all of the pending requests.
+  void Flush();
+
+  // Called on the reactor thread once the batching window elapses.
+  void ScheduledFlush(const Status& status);
+
+  // Hands the responses in 'batch' back to the callers, or resends its
+  // requests one by one if it failed.
+  void BatchDone(const std::shared_ptr<Batch>& batch);
+
+  // Sends 'pending' in its own UpdateConsensus RPC.
+  void SendOnItsOwn(const PendingRequest& pending);
+
+  const std::shared_ptr<rpc::Messenger> messenger_;
+  ConsensusServiceProxy proxy_;
+  const std::string dest_uuid_;
+
+  // Protects the members below.
+  simple_spinlock lock_;
+
+  std::vector<PendingRequest> pending_;
+
+  // Whether a flush has been scheduled on the reactor.
+  bool flush_scheduled_;
+
+  // Whether the server was found not to support MultiUpdateConsensus.
+  bool batching_unsupported_;
+
+  DISALLOW_COPY_AND_ASSIGN(HeartbeatBatcher);
+};
+
+} // namespace consensus
+} // namespace kudu
+
+#endif // KUDU_CONSENSUS_HEARTBEAT_BATCHER_H
@@ -164,6 +164,8 @@ LeaderElection::LeaderElection(const RaftConfigPB& config,
       decision_callback_(std::move(decision_callback)) {
   for (const RaftPeerPB& peer : config.peers()) {
     if (request.candidate_uuid() == peer.permanent_uuid()) continue;
+    // Only voters are asked for their vote, NON_VOTER learners have none.
+    if (peer.member_type() != RaftPeerPB::VOTER) continue;
     follower_uuids_.push_back(peer.permanent_uuid());
 
     gscoped_ptr<VoterState> state(new VoterState());
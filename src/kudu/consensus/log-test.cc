@@ -25,11 +25,13 @@
 #include "kudu/consensus/consensus-test-util.h"
 #include "kudu/consensus/log-test-base.h"
 #include "kudu/consensus/log_index.h"
+#include "kudu/consensus/log_sync_coordinator.h"
 #include "kudu/consensus/opid_util.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/tablet/mvcc.h"
 #include "kudu/util/random.h"
+#include "kudu/util/thread.h"
 
 DEFINE_int32(num_batches, 10000,
              "Number of batches to write to/read from the Log in TestWriteManyBatches");
@@ -39,6 +41,9 @@ DECLARE_int32(log_max_segments_to_retain);
 DECLARE_double(log_inject_io_error_on_preallocate_fraction);
 DECLARE_int64(fs_wal_dir_reserved_bytes);
 DECLARE_int64(disk_reserved_bytes_free_for_testing);
+DECLARE_string(log_compression_codec);
+DECLARE_int32(log_reader_readahead_bytes);
+DECLARE_int32(log_thread_idle_threshold_ms);
 
 namespace kudu {
 namespace log {
@@ -206,6 +211,52 @@ TEST_F(LogTest, TestFsync) {
   ASSERT_OK(log_->Close());
 }
 
+// Tests that the sync coordinator makes the files of many concurrent writers
+// durable, combining their syncs into shared rounds.
+TEST_F(LogTest, TestSyncCoordinator) {
+  const int kNumWriters = 8;
+  const int kNumSyncsPerWriter = 20;
+  LogSyncCoordinator coordinator(2);
+  ASSERT_OK(coordinator.Init());
+
+  vector<scoped_refptr<Thread>> threads;
+  vector<Status> statuses(kNumWriters);
+  for (int i = 0; i < kNumWriters; i++) {
+    scoped_refptr<Thread> thread;
+    ASSERT_OK(Thread::Create("test", "writer", [&, i]() {
+      gscoped_ptr<WritableFile> file;
+      Status s = env_->NewWritableFile(GetTestPath(Substitute("file-$0", i)), &file);
+      for (int j = 0; s.ok() && j < kNumSyncsPerWriter; j++) {
+        s = file->Append(Substitute("data-$0", j));
+        int round_size = 0;
+        if (s.ok()) {
+          s = coordinator.Sync(file.get(), &round_size);
+        }
+        if (s.ok()) {
+          CHECK_GE(round_size, 1);
+          CHECK_LE(round_size, kNumWriters);
+        }
+      }
+      statuses[i] = s;
+    }, &thread));
+    threads.push_back(thread);
+  }
+  for (const scoped_refptr<Thread>& thread : threads) {
+    thread->Join();
+  }
+  for (const Status& s : statuses) {
+    ASSERT_OK(s);
+  }
+
+  // Once shut down, files are synced on the calling thread.
+  coordinator.Shutdown();
+  gscoped_ptr<WritableFile> file;
+  ASSERT_OK(env_->NewWritableFile(GetTestPath("file-after-shutdown"), &file));
+  int round_size;
+  ASSERT_OK(coordinator.Sync(file.get(), &round_size));
+  ASSERT_EQ(1, round_size);
+}
+
 // Regression test for part of KUDU-735:
 // if a log is not preallocated, we should properly track its on-disk size as we append to
 // it.
@@ -383,6 +434,61 @@ TEST_F(LogTest, TestSegmentRollover) {
   ASSERT_EQ(num_entries, entries_.size());
 }
 
+// Test that entries appended around the time the idle append thread exits
+// are all written.
+TEST_F(LogTest, TestAppendThreadRestartsWhenIdle) {
+  FLAGS_log_thread_idle_threshold_ms = 5;
+  ASSERT_OK(BuildLog());
+  OpId op_id = MakeOpId(1, 1);
+  const int kNumBatches = 30;
+  for (int i = 0; i < kNumBatches; i++) {
+    ASSERT_OK(AppendNoOps(&op_id, 2));
+    SleepFor(MonoDelta::FromMilliseconds(i % 10));
+  }
+  ASSERT_OK(log_->Close());
+
+  shared_ptr<LogReader> reader;
+  ASSERT_OK(LogReader::Open(fs_manager_.get(), NULL, kTestTablet, NULL, &reader));
+  SegmentSequence segments;
+  ASSERT_OK(reader->GetSegmentsSnapshot(&segments));
+  for (const scoped_refptr<ReadableLogSegment>& segment : segments) {
+    ASSERT_OK(segment->ReadEntries(&entries_));
+  }
+  ASSERT_EQ(kNumBatches * 2, entries_.size());
+}
+
+// Test that a log whose segments were written with different compression
+// codecs, including none at all, can be read back in full.
+TEST_F(LogTest, TestReadMixedCompressedSegments) {
+  ASSERT_OK(BuildLog());
+  const int kNumEntriesPerSegment = 10;
+  OpId op_id = MakeOpId(1, 1);
+
+  // The first segment is uncompressed, the following ones use a codec each.
+  ASSERT_OK(AppendNoOps(&op_id, kNumEntriesPerSegment));
+  for (const char* codec : { "lz4", "snappy", "zlib" }) {
+    FLAGS_log_compression_codec = codec;
+    ASSERT_OK(RollLog());
+    ASSERT_OK(AppendNoOps(&op_id, kNumEntriesPerSegment));
+  }
+  ASSERT_OK(log_->Close());
+
+  shared_ptr<LogReader> reader;
+  ASSERT_OK(LogReader::Open(fs_manager_.get(), NULL, kTestTablet, NULL, &reader));
+  SegmentSequence segments;
+  ASSERT_OK(reader->GetSegmentsSnapshot(&segments));
+  ASSERT_EQ(4, segments.size()) << DumpSegmentsToString(segments);
+  ASSERT_FALSE(segments[0]->header().has_compression_codec());
+  ASSERT_EQ(kEntryHeaderSize, segments[0]->entry_header_size());
+  ASSERT_EQ(LZ4, segments[1]->header().compression_codec());
+  ASSERT_EQ(kEntryHeaderSizeV2, segments[1]->entry_header_size());
+
+  for (const scoped_refptr<ReadableLogSegment>& segment : segments) {
+    ASSERT_OK(segment->ReadEntries(&entries_));
+  }
+  ASSERT_EQ(4 * kNumEntriesPerSegment, entries_.size());
+}
+
 TEST_F(LogTest, TestWriteAndReadToAndFromInProgressSegment) {
   const int kNumEntries = 4;
   ASSERT_OK(BuildLog());
@@ -973,6 +1079,38 @@ TEST_F(LogTest, TestReadLogWithReplacedReplicates) {
   }
 }
 
+// Test that range reads return the same REPLICATE messages whatever the size
+// of their readahead, including when batches straddle the readahead buffer
+// or a segment boundary, and when they are served from the batch cache.
+TEST_F(LogTest, TestReadReplicatesInRangeWithReadahead) {
+  const int kNumOps = 50;
+  ASSERT_OK(BuildLog());
+  AppendReplicateBatchAndCommitEntryPairsToLog(kNumOps / 2);
+  ASSERT_OK(RollLog());
+  AppendReplicateBatchAndCommitEntryPairsToLog(kNumOps / 2);
+
+  for (int readahead : { 1, 100, 1024 * 1024 }) {
+    SCOPED_TRACE(Substitute("readahead: $0", readahead));
+    FLAGS_log_reader_readahead_bytes = readahead;
+
+    // Use a new reader so that the first read misses the batch cache, and
+    // read every range twice so that the second read hits it.
+    shared_ptr<LogReader> reader;
+    ASSERT_OK(LogReader::Open(fs_manager_.get(), log_->log_index_, kTestTablet,
+                              nullptr, &reader));
+    for (int i = 0; i < 2; i++) {
+      vector<ReplicateMsg*> repls;
+      ElementDeleter d(&repls);
+      ASSERT_OK(reader->ReadReplicatesInRange(1, kNumOps, LogReader::kNoSizeLimit, &repls));
+      ASSERT_EQ(kNumOps, repls.size());
+      for (int j = 0; j < kNumOps; j++) {
+        ASSERT_EQ(j + 1, repls[j]->id().index());
+        ASSERT_EQ(kTestTablet, repls[j]->write_request().tablet_id());
+      }
+    }
+  }
+}
+
 // Test various situations where we expect different segments depending on what the
 // min log index is.
 TEST_F(LogTest, TestGetMaxIndexesToSegmentSizeMap) {
@@ -21,10 +21,12 @@
 #include <mutex>
 #include <limits>
 
+#include "kudu/cfile/compression_codec.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/log_index.h"
 #include "kudu/consensus/log_metrics.h"
 #include "kudu/consensus/log_reader.h"
+#include "kudu/consensus/log_sync_coordinator.h"
 #include "kudu/consensus/log_util.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/map-util.h"
@@ -73,6 +75,17 @@ DEFINE_int32(group_commit_queue_size_bytes, 4 * 1024 * 1024,
              "Maximum size of the group commit queue in bytes");
 TAG_FLAG(group_commit_queue_size_bytes, advanced);
 
+DEFINE_int32(group_commit_queue_max_batches, 16384,
+             "Maximum number of entry batches in the group commit queue");
+TAG_FLAG(group_commit_queue_max_batches, advanced);
+
+DEFINE_int32(log_thread_idle_threshold_ms, 1000,
+             "Number of milliseconds after which the log append thread of a "
+             "tablet which received no writes exits. It's started again on the "
+             "next write. If 0, the thread never exits.");
+TAG_FLAG(log_thread_idle_threshold_ms, advanced);
+TAG_FLAG(log_thread_idle_threshold_ms, experimental);
+
 // Fault/latency injection flags.
 // -----------------------------
 DEFINE_bool(log_inject_latency, false,
@@ -110,6 +123,14 @@ DEFINE_int64(fs_wal_dir_reserved_bytes, 0,
 TAG_FLAG(fs_wal_dir_reserved_bytes, runtime);
 TAG_FLAG(fs_wal_dir_reserved_bytes, evolving);
 
+DEFINE_string(log_compression_codec, "none",
+              "Codec with which to compress the entry batches of newly created WAL "
+              "segments: one of 'none', 'snappy', 'lz4', 'zlib' or 'zstd'. Segments "
+              "written with a codec cannot be read by versions of Kudu which predate "
+              "this flag. Existing segments are read regardless of this setting.");
+TAG_FLAG(log_compression_codec, runtime);
+TAG_FLAG(log_compression_codec, experimental);
+
 // Validate that log_min_segments_to_retain >= 1
 static bool ValidateLogsToRetain(const char* flagname, int value) {
   if (value >= 1) {
@@ -136,13 +157,21 @@ using strings::Substitute;
 
 // This class is responsible for managing the thread that appends to
 // the log file.
+//
+// The thread exits once the log has been idle for
+// --log_thread_idle_threshold_ms, and is started again by the next Wake(),
+// so that the logs of idle tablets don't each hold a thread.
 class Log::AppendThread {
  public:
   explicit AppendThread(Log* log);
 
-  // Initializes the objects and starts the thread.
+  // Initializes the objects. The thread starts on the first Wake().
   Status Init();
 
+  // Starts the thread if it isn't running. Must be called after each
+  // entry is added to the queue.
+  void Wake();
+
   // Waits until the last enqueued elements are processed, sets the
   // Appender thread to closing state. If any entries are added to the
   // queue during the process, invoke their callbacks' 'OnFailure()'
@@ -152,24 +181,51 @@ class Log::AppendThread {
  private:
   void RunThread();
 
+  // Starts the thread, after joining the previous one if it exited.
+  // Requires 'lock_'. Crashes if the thread can't be created, since the
+  // entries already in the queue would never be appended.
+  void StartThreadUnlocked();
+
   Log* const log_;
 
-  // Lock to protect access to thread_ during shutdown.
+  // Protects the fields below.
   mutable std::mutex lock_;
   scoped_refptr<Thread> thread_;
+  bool running_;
+  bool closing_;
 };
 
 
 Log::AppendThread::AppendThread(Log *log)
-  : log_(log) {
+  : log_(log),
+    running_(false),
+    closing_(false) {
 }
 
 Status Log::AppendThread::Init() {
+  std::lock_guard<std::mutex> lock_guard(lock_);
   DCHECK(!thread_) << "Already initialized";
+  closing_ = false;
+  return Status::OK();
+}
+
+void Log::AppendThread::Wake() {
+  std::lock_guard<std::mutex> lock_guard(lock_);
+  if (!running_ && !closing_) {
+    StartThreadUnlocked();
+  }
+}
+
+void Log::AppendThread::StartThreadUnlocked() {
+  if (thread_) {
+    // The previous thread exited on its own once idle.
+    CHECK_OK(ThreadJoiner(thread_.get()).Join());
+    thread_.reset();
+  }
   VLOG(1) << "Starting log append thread for tablet " << log_->tablet_id();
-  RETURN_NOT_OK(kudu::Thread::Create("log", "appender",
+  CHECK_OK(kudu::Thread::Create("log", "appender",
       &AppendThread::RunThread, this, &thread_));
-  return Status::OK();
+  running_ = true;
 }
 
 void Log::AppendThread::RunThread() {
@@ -183,9 +239,25 @@ void Log::AppendThread::RunThread() {
     // the entry_batches vector with the final set of log entry batches that
     // were enqueued. We finish processing this last bunch of log entry batches
     // before exiting the main RunThread() loop.
-    if (PREDICT_FALSE(!log_->entry_queue()->BlockingDrainTo(&entry_batches))) {
+    MonoTime deadline;
+    if (FLAGS_log_thread_idle_threshold_ms > 0) {
+      deadline = MonoTime::Now() +
+          MonoDelta::FromMilliseconds(FLAGS_log_thread_idle_threshold_ms);
+    }
+    if (PREDICT_FALSE(!log_->entry_queue()->BlockingDrainTo(&entry_batches, deadline))) {
       shutting_down = true;
     }
+    if (entry_batches.empty() && !shutting_down) {
+      // Idle: exit, unless an entry was added since the drain, in which
+      // case its Wake() saw the thread running.
+      std::lock_guard<std::mutex> lock_guard(lock_);
+      if (log_->entry_queue()->empty()) {
+        VLOG(1) << "Log append thread for tablet " << log_->tablet_id() << " is idle";
+        running_ = false;
+        return;
+      }
+      continue;
+    }
 
     if (log_->metrics_) {
       log_->metrics_->entry_batches_per_group->Increment(entry_batches.size());
@@ -248,13 +320,26 @@ void Log::AppendThread::RunThread() {
 
 void Log::AppendThread::Shutdown() {
   log_->entry_queue()->Shutdown();
-  std::lock_guard<std::mutex> lock_guard(lock_);
-  if (thread_) {
+  scoped_refptr<Thread> thread;
+  {
+    std::lock_guard<std::mutex> lock_guard(lock_);
+    if (!running_ && !closing_) {
+      // Process the entries added before the queue was shut down, including
+      // those of puts still in flight, which won't wake the thread.
+      StartThreadUnlocked();
+    }
+    closing_ = true;
+    thread.swap(thread_);
+  }
+  // The thread may need 'lock_' to find out it's idle, so it's joined
+  // without holding it.
+  if (thread) {
     VLOG(1) << "Shutting down log append thread for tablet " << log_->tablet_id();
-    CHECK_OK(ThreadJoiner(thread_.get()).Join());
+    CHECK_OK(ThreadJoiner(thread.get()).Join());
     VLOG(1) << "Log append thread for tablet " << log_->tablet_id() << " is shut down";
-    thread_.reset();
   }
+  std::lock_guard<std::mutex> lock_guard(lock_);
+  running_ = false;
 }
 
 // This task is submitted to allocation_pool_ in order to
@@ -303,10 +388,12 @@ Log::Log(LogOptions options, FsManager* fs_manager, string log_path,
       active_segment_sequence_number_(0),
       log_state_(kLogInitialized),
       max_segment_size_(options_.segment_size_mb * 1024 * 1024),
-      entry_batch_queue_(FLAGS_group_commit_queue_size_bytes),
+      entry_batch_queue_(FLAGS_group_commit_queue_size_bytes,
+                         FLAGS_group_commit_queue_max_batches),
       append_thread_(new AppendThread(this)),
       force_sync_all_(options_.force_fsync_all),
       sync_disabled_(false),
+      sync_coordinator_(force_sync_all_ ? LogSyncCoordinator::GetShared() : nullptr),
       allocation_state_(kAllocationNotStarted),
       metric_entity_(metric_entity) {
   CHECK_OK(ThreadPoolBuilder("log-alloc").set_max_threads(1).Build(&allocation_pool_));
@@ -334,7 +421,7 @@ Status Log::Init() {
   // sequence numbers.
   if (reader_->num_segments() != 0) {
     VLOG(1) << "Using existing " << reader_->num_segments()
-            << " segments from path: " << fs_manager_->GetWalsRootDir();
+            << " segments from path: " << log_dir_;
 
     vector<scoped_refptr<ReadableLogSegment> > segments;
     RETURN_NOT_OK(reader_->GetSegmentsSnapshot(&segments));
@@ -424,12 +511,13 @@ Status Log::Reserve(LogEntryTypePB type,
   if (PREDICT_FALSE(!entry_batch_queue_.BlockingPut(new_entry_batch.get()))) {
     return kLogShutdownStatus;
   }
+  append_thread_->Wake();
 
   // Release the memory back to the caller: this will be freed when
   // the entry is removed from the queue.
   //
-  // TODO (perf) Use a ring buffer instead of a blocking queue and set
-  // 'reserved_entry' to a pre-allocated slot in the buffer.
+  // TODO (perf) Set 'reserved_entry' to a pre-allocated slot of the
+  // queue's ring.
   *reserved_entry = new_entry_batch.release();
   return Status::OK();
 }
@@ -612,7 +700,16 @@ Status Log::Sync() {
 
   if (force_sync_all_ && !sync_disabled_) {
     LOG_SLOW_EXECUTION(WARNING, 50, "Fsync log took a long time") {
-      RETURN_NOT_OK(active_segment_->Sync());
+      if (sync_coordinator_) {
+        int round_size;
+        RETURN_NOT_OK(sync_coordinator_->Sync(active_segment_->writable_file().get(),
+                                              &round_size));
+        if (metrics_) {
+          metrics_->sync_round_size->Increment(round_size);
+        }
+      } else {
+        RETURN_NOT_OK(active_segment_->Sync());
+      }
 
       if (log_hooks_) {
         RETURN_NOT_OK_PREPEND(log_hooks_->PostSyncIfFsyncEnabled(),
@@ -899,6 +996,10 @@ Status Log::SwitchToAllocatedSegment() {
   header.set_minor_version(kLogMinorVersion);
   header.set_sequence_number(active_segment_sequence_number_);
   header.set_tablet_id(tablet_id_);
+  CompressionType codec = cfile::GetCompressionCodecType(FLAGS_log_compression_codec);
+  if (codec != NO_COMPRESSION) {
+    header.set_compression_codec(codec);
+  }
 
   // Set up the new footer. This will be maintained as the segment is written.
   footer_builder_.Clear();
@@ -31,8 +31,8 @@
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/spinlock.h"
 #include "kudu/util/async_util.h"
-#include "kudu/util/blocking_queue.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/mpmc_queue.h"
 #include "kudu/util/rw_mutex.h"
 #include "kudu/util/promise.h"
 #include "kudu/util/status.h"
@@ -51,8 +51,9 @@ struct RetentionIndexes;
 class LogEntryBatch;
 class LogIndex;
 class LogReader;
+class LogSyncCoordinator;
 
-typedef BlockingQueue<LogEntryBatch*, LogEntryBatchLogicalSize> LogEntryBatchQueue;
+typedef MpmcQueue<LogEntryBatch*, LogEntryBatchLogicalSize> LogEntryBatchQueue;
 
 // Log interface, inspired by Raft's (logcabin) Log. Provides durability to
 // Kudu as a normal Write Ahead Log and also plays the role of persistent
@@ -234,6 +235,7 @@ class Log : public RefCountedThreadSafe<Log> {
   friend class LogTestBase;
   FRIEND_TEST(LogTest, TestMultipleEntriesInABatch);
   FRIEND_TEST(LogTest, TestReadLogWithReplacedReplicates);
+  FRIEND_TEST(LogTest, TestReadReplicatesInRangeWithReadahead);
   FRIEND_TEST(LogTest, TestWriteAndReadToAndFromInProgressSegment);
 
   class AppendThread;
@@ -385,6 +387,10 @@ class Log : public RefCountedThreadSafe<Log> {
   // This is used to disable fsync during bootstrap.
   bool sync_disabled_;
 
+  // Syncs the active segment together with those of other logs, if
+  // 'force_sync_all_' is set. If NULL, the segment is synced directly.
+  LogSyncCoordinator* sync_coordinator_;
+
   // The status of the most recent log-allocation action.
   Promise<Status> allocation_status_;
 
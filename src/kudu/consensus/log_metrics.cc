@@ -31,7 +31,7 @@ METRIC_DEFINE_histogram(tablet, log_sync_latency, "Log Sync Latency",
 METRIC_DEFINE_histogram(tablet, log_append_latency, "Log Append Latency",
                         kudu::MetricUnit::kMicroseconds,
                         "Microseconds spent on appending to the log segment file",
-                        60000000LU, 2);
+                        60000000LU, 2, kudu::SHARDED_HISTOGRAM);
 
 METRIC_DEFINE_histogram(tablet, log_group_commit_latency, "Log Group Commit Latency",
                         kudu::MetricUnit::kMicroseconds,
@@ -48,6 +48,12 @@ METRIC_DEFINE_histogram(tablet, log_entry_batches_per_group, "Log Group Commit B
                         "Number of log entry batches in a group commit group",
                         1024, 2);
 
+METRIC_DEFINE_histogram(tablet, log_sync_round_size, "Log Sync Round Size",
+                        kudu::MetricUnit::kUnits,
+                        "Number of log segments, across all tablets, which were synced "
+                        "in the same round as this tablet's log segment",
+                        1024, 2);
+
 namespace kudu {
 namespace log {
 
@@ -58,7 +64,8 @@ LogMetrics::LogMetrics(const scoped_refptr<MetricEntity>& metric_entity)
       MINIT(append_latency),
       MINIT(group_commit_latency),
       MINIT(roll_latency),
-      MINIT(entry_batches_per_group) {
+      MINIT(entry_batches_per_group),
+      MINIT(sync_round_size) {
 }
 #undef MINIT
 
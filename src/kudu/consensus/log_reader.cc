@@ -20,19 +20,35 @@
 #include <algorithm>
 #include <mutex>
 
+#include <gflags/gflags.h>
+
 #include "kudu/consensus/log_index.h"
 #include "kudu/consensus/opid_util.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/util.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/cache.h"
 #include "kudu/util/coding.h"
 #include "kudu/util/env_util.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/hexdump.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/path_util.h"
 #include "kudu/util/pb_util.h"
 
+DEFINE_int32(log_reader_readahead_bytes, 1024 * 1024,
+             "When reading a range of operations from the WAL, e.g. to catch up "
+             "a lagging follower, read at least this many bytes from a log "
+             "segment at a time.");
+TAG_FLAG(log_reader_readahead_bytes, advanced);
+
+DEFINE_int32(log_reader_cache_capacity_mb, 16,
+             "Capacity of the process-wide cache of log entry batches read "
+             "back from the WAL, which lets several lagging followers of a "
+             "tablet share the same reads. Set to 0 to disable the cache.");
+TAG_FLAG(log_reader_cache_capacity_mb, advanced);
+
 METRIC_DEFINE_counter(tablet, log_reader_bytes_read, "Bytes Read From Log",
                       kudu::MetricUnit::kBytes,
                       "Data read from the WAL since tablet start");
@@ -56,8 +72,30 @@ struct LogSegmentSeqnoComparator {
     return a->header().sequence_number() < b->header().sequence_number();
   }
 };
+
+// Returns the cache of verified and uncompressed log entry batches shared by
+// all LogReaders, or NULL if it is disabled.
+Cache* DecodedBatchCache() {
+  static Cache* cache = FLAGS_log_reader_cache_capacity_mb > 0 ?
+      NewLRUCache(DRAM_CACHE, FLAGS_log_reader_cache_capacity_mb * 1024 * 1024,
+                  "log_reader_cache") :
+      nullptr;
+  return cache;
 }
 
+// Key of a batch in the decoded batch cache. Batches are never rewritten in
+// place, so a segment and an offset identify a batch for a given reader.
+struct DecodedBatchCacheKey {
+  uint64_t reader_id;
+  int64_t segment_seqno;
+  int64_t offset_in_segment;
+
+  Slice slice() const {
+    return Slice(reinterpret_cast<const uint8_t*>(this), sizeof(*this));
+  }
+};
+} // anonymous namespace
+
 using consensus::OpId;
 using consensus::ReplicateMsg;
 using env_util::ReadFully;
@@ -105,6 +143,7 @@ LogReader::LogReader(FsManager* fs_manager,
     : fs_manager_(fs_manager),
       log_index_(index),
       tablet_id_(std::move(tablet_id)),
+      cache_id_(DecodedBatchCache() ? DecodedBatchCache()->NewId() : 0),
       state_(kLogReaderInitialized) {
   if (metric_entity) {
     bytes_read_ = METRIC_log_reader_bytes_read.Instantiate(metric_entity);
@@ -230,7 +269,7 @@ scoped_refptr<ReadableLogSegment> LogReader::GetSegmentBySequenceNumber(int64_t
 }
 
 Status LogReader::ReadBatchUsingIndexEntry(const LogIndexEntry& index_entry,
-                                           faststring* tmp_buf,
+                                           RangeReadState* state,
                                            gscoped_ptr<LogEntryBatchPB>* batch) const {
   const int index = index_entry.op_id.index();
 
@@ -243,20 +282,64 @@ Status LogReader::ReadBatchUsingIndexEntry(const LogIndexEntry& index_entry,
   }
 
   CHECK_GT(index_entry.offset_in_segment, 0);
-  int64_t offset = index_entry.offset_in_segment;
   ScopedLatencyMetric scoped(read_batch_latency_.get());
-  RETURN_NOT_OK_PREPEND(segment->ReadEntryHeaderAndBatch(&offset, tmp_buf, batch),
-                        Substitute("Failed to read LogEntry for index $0 from log segment "
-                                   "$1 offset $2",
-                                   index,
-                                   index_entry.segment_sequence_number,
-                                   index_entry.offset_in_segment));
+  Cache* cache = DecodedBatchCache();
+  DecodedBatchCacheKey key = { cache_id_,
+                               index_entry.segment_sequence_number,
+                               index_entry.offset_in_segment };
+  Cache::Handle* handle = cache ? cache->Lookup(key.slice(), Cache::EXPECT_IN_CACHE) : nullptr;
+
+  Slice batch_data;
+  if (handle) {
+    batch_data = cache->Value(handle);
+  } else {
+    if (state->segment_seqno != index_entry.segment_sequence_number) {
+      state->segment_seqno = index_entry.segment_sequence_number;
+      state->readahead.data.clear();
+    }
+    int64_t file_bytes_read = 0;
+    RETURN_NOT_OK_PREPEND(segment->ReadEntryHeaderAndBatchBuffered(
+                              index_entry.offset_in_segment,
+                              FLAGS_log_reader_readahead_bytes,
+                              &state->readahead,
+                              &state->uncompressed_buf,
+                              &batch_data,
+                              &file_bytes_read),
+                          Substitute("Failed to read LogEntry for index $0 from log segment "
+                                     "$1 offset $2",
+                                     index,
+                                     index_entry.segment_sequence_number,
+                                     index_entry.offset_in_segment));
+    if (cache) {
+      Cache::PendingHandle* pending = cache->Allocate(key.slice(), batch_data.size(),
+                                                      batch_data.size());
+      if (pending) {
+        memcpy(cache->MutableValue(pending), batch_data.data(), batch_data.size());
+        cache->Release(cache->Insert(pending, nullptr));
+      }
+    }
+  }
+
+  gscoped_ptr<LogEntryBatchPB> read_batch(new LogEntryBatchPB());
+  Status s = pb_util::ParseFromArray(read_batch.get(), batch_data.data(), batch_data.size());
+  if (handle) {
+    cache->Release(handle);
+  }
+  if (!s.ok()) {
+    return Status::Corruption(Substitute("Could not parse LogEntry for index $0 from log "
+                                         "segment $1 offset $2: $3",
+                                         index,
+                                         index_entry.segment_sequence_number,
+                                         index_entry.offset_in_segment,
+                                         s.ToString()));
+  }
 
   if (bytes_read_) {
-    bytes_read_->IncrementBy(kEntryHeaderSize + tmp_buf->length());
-    entries_read_->IncrementBy((**batch).entry_size());
+    bytes_read_->IncrementBy(segment->entry_header_size() + batch_data.size());
+    entries_read_->IncrementBy(read_batch->entry_size());
   }
 
+  batch->reset(read_batch.release());
   return Status::OK();
 }
 
@@ -274,7 +357,7 @@ Status LogReader::ReadReplicatesInRange(const int64_t starting_at,
 
   int64_t total_size = 0;
   bool limit_exceeded = false;
-  faststring tmp_buf;
+  RangeReadState read_state;
   gscoped_ptr<LogEntryBatchPB> batch;
   for (int index = starting_at; index <= up_to && !limit_exceeded; index++) {
     LogIndexEntry index_entry;
@@ -288,7 +371,7 @@ Status LogReader::ReadReplicatesInRange(const int64_t starting_at,
     if (index == starting_at ||
         index_entry.segment_sequence_number != prev_index_entry.segment_sequence_number ||
         index_entry.offset_in_segment != prev_index_entry.offset_in_segment) {
-      RETURN_NOT_OK(ReadBatchUsingIndexEntry(index_entry, &tmp_buf, &batch));
+      RETURN_NOT_OK(ReadBatchUsingIndexEntry(index_entry, &read_state, &batch));
 
       // Sanity-check the property that a batch should only have increasing indexes.
       int64_t prev_index = 0;
@@ -146,10 +146,23 @@ class LogReader {
   // written to.
   void UpdateLastSegmentOffset(int64_t readable_to_offset);
 
+  // State carried between the ReadBatchUsingIndexEntry() calls of one range
+  // read.
+  struct RangeReadState {
+    // The sequence number of the segment 'readahead' holds data from.
+    int64_t segment_seqno = -1;
+    ReadableLogSegment::ReadAheadBuffer readahead;
+    faststring uncompressed_buf;
+  };
+
   // Read the LogEntryBatchPB pointed to by the provided index entry.
-  // 'tmp_buf' is used as scratch space to avoid extra allocation.
+  //
+  // The batch is served from the process-wide cache of decoded batches if
+  // possible. Otherwise it is read through the readahead buffer in 'state',
+  // so that consecutive calls for nearby batches of the same segment share
+  // large sequential reads, and then added to the cache.
   Status ReadBatchUsingIndexEntry(const LogIndexEntry& index_entry,
-                                  faststring* tmp_buf,
+                                  RangeReadState* state,
                                   gscoped_ptr<LogEntryBatchPB>* batch) const;
 
   LogReader(FsManager* fs_manager, const scoped_refptr<LogIndex>& index,
@@ -166,6 +179,9 @@ class LogReader {
   const scoped_refptr<LogIndex> log_index_;
   const std::string tablet_id_;
 
+  // Prefix of this reader's keys in the decoded batch cache.
+  const uint64_t cache_id_;
+
   // Metrics
   scoped_refptr<Counter> bytes_read_;
   scoped_refptr<Counter> entries_read_;
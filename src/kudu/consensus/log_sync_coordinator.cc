@@ -0,0 +1,155 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/consensus/log_sync_coordinator.h"
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/once.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/debug/trace_event.h"
+#include "kudu/util/env.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/thread.h"
+
+DEFINE_int32(log_sync_threads, 4,
+             "Number of threads which fsync the log segments of all tablets when "
+             "--log_force_fsync_all is set. Syncs requested while all of them are "
+             "busy are combined into their next round. If 0, each log fsyncs its "
+             "own segments on its append thread.");
+TAG_FLAG(log_sync_threads, experimental);
+
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace log {
+
+namespace {
+
+LogSyncCoordinator* shared_coordinator = nullptr;
+GoogleOnceType shared_coordinator_once = GOOGLE_ONCE_INIT;
+
+void CreateSharedCoordinator() {
+  if (FLAGS_log_sync_threads > 0) {
+    shared_coordinator = new LogSyncCoordinator(FLAGS_log_sync_threads);
+    CHECK_OK(shared_coordinator->Init());
+  }
+}
+
+} // anonymous namespace
+
+LogSyncCoordinator* LogSyncCoordinator::GetShared() {
+  GoogleOnceInit(&shared_coordinator_once, &CreateSharedCoordinator);
+  return shared_coordinator;
+}
+
+LogSyncCoordinator::LogSyncCoordinator(int num_threads)
+    : num_threads_(num_threads),
+      pending_cond_(&lock_),
+      done_cond_(&lock_),
+      shutting_down_(false) {
+  CHECK_GT(num_threads_, 0);
+}
+
+LogSyncCoordinator::~LogSyncCoordinator() {
+  Shutdown();
+}
+
+Status LogSyncCoordinator::Init() {
+  for (int i = 0; i < num_threads_; i++) {
+    scoped_refptr<Thread> thread;
+    RETURN_NOT_OK(Thread::Create("log", Substitute("log-sync-$0", i),
+                                 &LogSyncCoordinator::RunThread, this, &thread));
+    threads_.push_back(thread);
+  }
+  return Status::OK();
+}
+
+void LogSyncCoordinator::Shutdown() {
+  {
+    MutexLock l(lock_);
+    shutting_down_ = true;
+    pending_cond_.Broadcast();
+  }
+  for (const scoped_refptr<Thread>& thread : threads_) {
+    CHECK_OK(ThreadJoiner(thread.get()).Join());
+  }
+  threads_.clear();
+}
+
+Status LogSyncCoordinator::Sync(WritableFile* file, int* round_size) {
+  Request req;
+  req.file = file;
+  req.round_size = 0;
+  req.done = false;
+
+  MutexLock l(lock_);
+  if (PREDICT_FALSE(shutting_down_)) {
+    l.Unlock();
+    *round_size = 1;
+    return file->Sync();
+  }
+  pending_.push_back(&req);
+  pending_cond_.Signal();
+  while (!req.done) {
+    done_cond_.Wait();
+  }
+  *round_size = req.round_size;
+  return req.status;
+}
+
+void LogSyncCoordinator::RunThread() {
+  while (true) {
+    vector<Request*> round;
+    {
+      MutexLock l(lock_);
+      while (pending_.empty() && !shutting_down_) {
+        pending_cond_.Wait();
+      }
+      if (pending_.empty()) {
+        return;
+      }
+      round.swap(pending_);
+    }
+
+    TRACE_EVENT1("log", "LogSyncCoordinator::Round", "files", round.size());
+    // Start the writeback of every file before waiting for any of them, so
+    // that the device receives all of their dirty pages together.
+    for (Request* req : round) {
+      req->status = req->file->Flush(WritableFile::FLUSH_ASYNC);
+    }
+    for (Request* req : round) {
+      if (req->status.ok()) {
+        req->status = req->file->Sync();
+      }
+    }
+
+    {
+      MutexLock l(lock_);
+      for (Request* req : round) {
+        req->round_size = round.size();
+        req->done = true;
+      }
+    }
+    done_cond_.Broadcast();
+  }
+}
+
+} // namespace log
+} // namespace kudu
@@ -0,0 +1,105 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef KUDU_CONSENSUS_LOG_SYNC_COORDINATOR_H
+#define KUDU_CONSENSUS_LOG_SYNC_COORDINATOR_H
+
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/mutex.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class Thread;
+class WritableFile;
+
+namespace log {
+
+// Makes the segments of many logs durable together.
+//
+// Rather than each log's append thread fsyncing its own active segment,
+// append threads hand their segment to the coordinator and wait. Each of the
+// coordinator's threads repeatedly takes all of the requests pending at that
+// time, starts the writeback of all of their files at once, waits for each of
+// them to be durable, and then wakes up all of their waiters together.
+//
+// Syncs requested while every thread is busy accumulate into the next round,
+// in the same way that a log's group commit accumulates entry batches. With
+// many tablets under write load, the device then sees a few large rounds of
+// flushes rather than many small, independent ones.
+//
+// This class is thread-safe.
+class LogSyncCoordinator {
+ public:
+  explicit LogSyncCoordinator(int num_threads);
+  ~LogSyncCoordinator();
+
+  // Starts the coordinator's threads.
+  Status Init();
+
+  // Stops the coordinator's threads once the pending requests are done.
+  // Files passed to Sync() afterwards are synced on the calling thread.
+  void Shutdown();
+
+  // Makes 'file' durable as part of the next round of syncs, and waits for
+  // that round to complete. Sets '*round_size' to the number of files synced
+  // in the round.
+  Status Sync(WritableFile* file, int* round_size);
+
+  // Returns the coordinator shared by the logs of all tablets of this
+  // process, or nullptr if --log_sync_threads is 0 and logs should sync their
+  // own segments.
+  static LogSyncCoordinator* GetShared();
+
+ private:
+  struct Request {
+    WritableFile* file;
+    Status status;
+    int round_size;
+    bool done;
+  };
+
+  void RunThread();
+
+  const int num_threads_;
+  std::vector<scoped_refptr<Thread>> threads_;
+
+  // Protects the members below.
+  Mutex lock_;
+
+  // Signaled when a request is added, or when the coordinator shuts down.
+  ConditionVariable pending_cond_;
+
+  // Broadcast when a round of syncs completes.
+  ConditionVariable done_cond_;
+
+  // Requests waiting for the next round. Owned by their callers.
+  std::vector<Request*> pending_;
+
+  bool shutting_down_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogSyncCoordinator);
+};
+
+} // namespace log
+} // namespace kudu
+
+#endif // KUDU_CONSENSUS_LOG_SYNC_COORDINATOR_H
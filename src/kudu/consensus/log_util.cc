@@ -25,6 +25,7 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include "kudu/cfile/compression_codec.h"
 #include "kudu/consensus/opid_util.h"
 #include "kudu/consensus/ref_counted_replicate.h"
 #include "kudu/fs/fs_manager.h"
@@ -85,6 +86,7 @@ const size_t kLogSegmentHeaderMagicAndHeaderLength = 12;
 const size_t kLogSegmentFooterMagicAndFooterLength  = 12;
 
 const size_t kEntryHeaderSize = 12;
+const size_t kEntryHeaderSizeV2 = 16;
 
 const int kLogMajorVersion = 1;
 const int kLogMinorVersion = 0;
@@ -144,7 +146,7 @@ Status LogEntryReader::ReadNextEntry(LogEntryPB* entry) {
 
     // Read and validate the entry header first.
     Status s;
-    if (offset_ + kEntryHeaderSize < read_up_to_) {
+    if (offset_ + seg_->entry_header_size() < read_up_to_) {
       s = seg_->ReadEntryHeaderAndBatch(&offset_, &tmp_buf_, &current_batch);
     } else {
       s = Status::Corruption(Substitute("Truncated log entry at offset $0", offset_));
@@ -205,7 +207,7 @@ Status LogEntryReader::HandleReadError(const Status& s) const {
   // if not, we just WARN it, since it's OK for the last entry to be partially
   // written.
   bool has_valid_entries;
-  RETURN_NOT_OK_PREPEND(seg_->ScanForValidEntryHeaders(offset_ + kEntryHeaderSize,
+  RETURN_NOT_OK_PREPEND(seg_->ScanForValidEntryHeaders(offset_ + seg_->entry_header_size(),
                                                        &has_valid_entries),
                         "Scanning forward for valid entries");
   if (has_valid_entries) {
@@ -255,6 +257,28 @@ Status ReadableLogSegment::Open(Env* env,
   return Status::OK();
 }
 
+namespace {
+
+// Determines how the entries of a segment with header 'header' are encoded:
+// the codec their batches are compressed with (nullptr if none), and the size
+// of their headers.
+Status GetEntryFormat(const LogSegmentHeaderPB& header,
+                      const cfile::CompressionCodec** codec,
+                      size_t* entry_header_size) {
+  if (!header.has_compression_codec()) {
+    *codec = nullptr;
+    *entry_header_size = kEntryHeaderSize;
+    return Status::OK();
+  }
+  RETURN_NOT_OK_PREPEND(cfile::GetCompressionCodec(header.compression_codec(), codec),
+                        Substitute("Unsupported WAL compression codec $0",
+                                   CompressionType_Name(header.compression_codec())));
+  *entry_header_size = kEntryHeaderSizeV2;
+  return Status::OK();
+}
+
+} // anonymous namespace
+
 ReadableLogSegment::ReadableLogSegment(
     std::string path, shared_ptr<RandomAccessFile> readable_file)
     : path_(std::move(path)),
@@ -262,7 +286,9 @@ ReadableLogSegment::ReadableLogSegment(
       readable_to_offset_(0),
       readable_file_(std::move(readable_file)),
       is_initialized_(false),
-      footer_was_rebuilt_(false) {}
+      footer_was_rebuilt_(false),
+      codec_(nullptr),
+      entry_header_size_(kEntryHeaderSize) {}
 
 Status ReadableLogSegment::Init(const LogSegmentHeaderPB& header,
                                 const LogSegmentFooterPB& footer,
@@ -272,6 +298,7 @@ Status ReadableLogSegment::Init(const LogSegmentHeaderPB& header,
   DCHECK(footer.IsInitialized()) << "Log segment footer must be initialized";
 
   RETURN_NOT_OK(ReadFileSize());
+  RETURN_NOT_OK(GetEntryFormat(header, &codec_, &entry_header_size_));
 
   header_.CopyFrom(header);
   footer_.CopyFrom(footer);
@@ -288,6 +315,7 @@ Status ReadableLogSegment::Init(const LogSegmentHeaderPB& header,
   DCHECK(header.IsInitialized()) << "Log segment header must be initialized";
 
   RETURN_NOT_OK(ReadFileSize());
+  RETURN_NOT_OK(GetEntryFormat(header, &codec_, &entry_header_size_));
 
   header_.CopyFrom(header);
   first_entry_offset_ = first_entry_offset;
@@ -414,6 +442,8 @@ Status ReadableLogSegment::ReadHeader() {
                                                 header_size),
                         "Unable to parse protobuf");
 
+  RETURN_NOT_OK_PREPEND(GetEntryFormat(header, &codec_, &entry_header_size_),
+                        Substitute("Unable to read log segment $0", path_));
   header_.CopyFrom(header);
   first_entry_offset_ = header_size + kLogSegmentHeaderMagicAndHeaderLength;
 
@@ -582,8 +612,8 @@ Status ReadableLogSegment::ScanForValidEntryHeaders(int64_t offset, bool* has_va
   // We overlap the reads by the size of the header, so that if a header
   // spans chunks, we don't miss it.
   for (;
-       offset < file_size() - kEntryHeaderSize;
-       offset += kChunkSize - kEntryHeaderSize) {
+       offset < file_size() - entry_header_size_;
+       offset += kChunkSize - entry_header_size_) {
     int rem = std::min<int64_t>(file_size() - offset, kChunkSize);
     Slice chunk;
     RETURN_NOT_OK(ReadFully(readable_file().get(), offset, rem, &chunk, &buf[0]));
@@ -596,9 +626,9 @@ Status ReadableLogSegment::ScanForValidEntryHeaders(int64_t offset, bool* has_va
 
     // Check if this chunk has a valid entry header.
     for (int off_in_chunk = 0;
-         off_in_chunk < chunk.size() - kEntryHeaderSize;
+         off_in_chunk < chunk.size() - entry_header_size_;
          off_in_chunk++) {
-      Slice potential_header = Slice(&chunk[off_in_chunk], kEntryHeaderSize);
+      Slice potential_header = Slice(&chunk[off_in_chunk], entry_header_size_);
 
       EntryHeader header;
       if (DecodeEntryHeader(potential_header, &header)) {
@@ -625,9 +655,9 @@ Status ReadableLogSegment::ReadEntryHeaderAndBatch(int64_t* offset, faststring*
 
 
 Status ReadableLogSegment::ReadEntryHeader(int64_t *offset, EntryHeader* header) {
-  uint8_t scratch[kEntryHeaderSize];
+  uint8_t scratch[kEntryHeaderSizeV2];
   Slice slice;
-  RETURN_NOT_OK_PREPEND(ReadFully(readable_file().get(), *offset, kEntryHeaderSize,
+  RETURN_NOT_OK_PREPEND(ReadFully(readable_file().get(), *offset, entry_header_size_,
                                   &slice, scratch),
                         "Could not read log entry header");
 
@@ -639,13 +669,22 @@ Status ReadableLogSegment::ReadEntryHeader(int64_t *offset, EntryHeader* header)
 }
 
 bool ReadableLogSegment::DecodeEntryHeader(const Slice& data, EntryHeader* header) {
-  DCHECK_EQ(kEntryHeaderSize, data.size());
-  header->msg_length = DecodeFixed32(&data[0]);
-  header->msg_crc    = DecodeFixed32(&data[4]);
-  header->header_crc = DecodeFixed32(&data[8]);
+  DCHECK_EQ(entry_header_size_, data.size());
+  int off = 0;
+  header->msg_length = DecodeFixed32(&data[off]);
+  off += 4;
+  if (entry_header_size_ == kEntryHeaderSizeV2) {
+    header->msg_length_uncompressed = DecodeFixed32(&data[off]);
+    off += 4;
+  } else {
+    header->msg_length_uncompressed = header->msg_length;
+  }
+  header->msg_crc = DecodeFixed32(&data[off]);
+  off += 4;
+  header->header_crc = DecodeFixed32(&data[off]);
 
   // Verify the header.
-  uint32_t computed_crc = crc::Crc32c(&data[0], 8);
+  uint32_t computed_crc = crc::Crc32c(&data[0], off);
   return computed_crc == header->header_crc;
 }
 
@@ -683,41 +722,127 @@ Status ReadableLogSegment::ReadEntryBatch(int64_t *offset,
   if (!s.ok()) return Status::IOError(Substitute("Could not read entry. Cause: $0",
                                                  s.ToString()));
 
+  faststring uncompressed_buf;
+  Slice batch_data;
+  RETURN_NOT_OK(VerifyAndUncompressBatch(*offset, header, entry_batch_slice,
+                                         &uncompressed_buf, &batch_data));
+
+  gscoped_ptr<LogEntryBatchPB> read_entry_batch(new LogEntryBatchPB());
+  s = pb_util::ParseFromArray(read_entry_batch.get(),
+                              batch_data.data(),
+                              batch_data.size());
+
+  if (!s.ok()) return Status::Corruption(Substitute("Could parse PB. Cause: $0",
+                                                    s.ToString()));
+
+  *offset += entry_batch_slice.size();
+  entry_batch->reset(read_entry_batch.release());
+  return Status::OK();
+}
+
+Status ReadableLogSegment::VerifyAndUncompressBatch(int64_t offset,
+                                                    const EntryHeader& header,
+                                                    const Slice& data,
+                                                    faststring* uncompressed_buf,
+                                                    Slice* batch_data) {
   // Verify the CRC.
-  uint32_t read_crc = crc::Crc32c(entry_batch_slice.data(), entry_batch_slice.size());
+  uint32_t read_crc = crc::Crc32c(data.data(), data.size());
   if (PREDICT_FALSE(read_crc != header.msg_crc)) {
     return Status::Corruption(Substitute("Entry CRC mismatch in byte range $0-$1: "
                                          "expected CRC=$2, computed=$3",
-                                         *offset, *offset + header.msg_length,
+                                         offset, offset + header.msg_length,
                                          header.msg_crc, read_crc));
   }
 
+  // Uncompress the batch if the segment was written with a codec.
+  if (codec_) {
+    uncompressed_buf->resize(header.msg_length_uncompressed);
+    Status s = codec_->Uncompress(data, uncompressed_buf->data(),
+                                  header.msg_length_uncompressed);
+    if (!s.ok()) {
+      return Status::Corruption(Substitute("Could not uncompress entry in byte range $0-$1: $2",
+                                           offset, offset + header.msg_length,
+                                           s.ToString()));
+    }
+    *batch_data = Slice(*uncompressed_buf);
+  } else {
+    *batch_data = data;
+  }
+  return Status::OK();
+}
 
-  gscoped_ptr<LogEntryBatchPB> read_entry_batch(new LogEntryBatchPB());
-  s = pb_util::ParseFromArray(read_entry_batch.get(),
-                              entry_batch_slice.data(),
-                              header.msg_length);
+Status ReadableLogSegment::FillReadAheadBuffer(int64_t offset,
+                                               int64_t length,
+                                               int64_t readahead_bytes,
+                                               ReadAheadBuffer* buf,
+                                               int64_t* bytes_read) {
+  if (offset >= buf->offset &&
+      offset + length <= buf->offset + static_cast<int64_t>(buf->data.size())) {
+    return Status::OK();
+  }
 
-  if (!s.ok()) return Status::Corruption(Substitute("Could parse PB. Cause: $0",
-                                                    s.ToString()));
+  int64_t limit = readable_up_to();
+  if (PREDICT_FALSE(offset + length > limit)) {
+    // The log was likely truncated during writing.
+    return Status::Corruption(
+        Substitute("Could not read $0 bytes from offset $1 in $2: "
+                   "log only readable up to offset $3",
+                   length, offset, path_, limit));
+  }
 
-  *offset += entry_batch_slice.size();
-  entry_batch->reset(read_entry_batch.release());
+  int64_t to_read = std::min(std::max(length, readahead_bytes), limit - offset);
+  buf->scratch.resize(to_read);
+  Status s = ReadFully(readable_file().get(), offset, to_read, &buf->data,
+                       buf->scratch.data());
+  if (!s.ok()) {
+    buf->data.clear();
+    return Status::IOError(Substitute("Could not read entry. Cause: $0", s.ToString()));
+  }
+  buf->offset = offset;
+  *bytes_read += to_read;
   return Status::OK();
 }
 
+Status ReadableLogSegment::ReadEntryHeaderAndBatchBuffered(int64_t offset,
+                                                           int64_t readahead_bytes,
+                                                           ReadAheadBuffer* buf,
+                                                           faststring* uncompressed_buf,
+                                                           Slice* batch_data,
+                                                           int64_t* bytes_read) {
+  RETURN_NOT_OK_PREPEND(FillReadAheadBuffer(offset, entry_header_size_, readahead_bytes,
+                                            buf, bytes_read),
+                        "Could not read log entry header");
+  EntryHeader header;
+  Slice header_slice(buf->data.data() + (offset - buf->offset), entry_header_size_);
+  if (PREDICT_FALSE(!DecodeEntryHeader(header_slice, &header))) {
+    return Status::Corruption("CRC mismatch in log entry header");
+  }
+  if (header.msg_length == 0) {
+    return Status::Corruption("Invalid 0 entry length");
+  }
+
+  int64_t data_offset = offset + entry_header_size_;
+  RETURN_NOT_OK(FillReadAheadBuffer(data_offset, header.msg_length, readahead_bytes,
+                                    buf, bytes_read));
+  Slice data(buf->data.data() + (data_offset - buf->offset), header.msg_length);
+  return VerifyAndUncompressBatch(data_offset, header, data, uncompressed_buf, batch_data);
+}
+
 WritableLogSegment::WritableLogSegment(string path,
                                        shared_ptr<WritableFile> writable_file)
     : path_(std::move(path)),
       writable_file_(std::move(writable_file)),
       is_header_written_(false),
       is_footer_written_(false),
-      written_offset_(0) {}
+      written_offset_(0),
+      codec_(nullptr),
+      entry_header_size_(kEntryHeaderSize) {}
 
 Status WritableLogSegment::WriteHeaderAndOpen(const LogSegmentHeaderPB& new_header) {
   DCHECK(!IsHeaderWritten()) << "Can only call WriteHeader() once";
   DCHECK(new_header.IsInitialized())
       << "Log segment header must be initialized" << new_header.InitializationErrorString();
+  RETURN_NOT_OK(GetEntryFormat(new_header, &codec_, &entry_header_size_));
   faststring buf;
 
   // First the magic.
@@ -769,26 +894,44 @@ Status WritableLogSegment::WriteFooterAndClose(const LogSegmentFooterPB& footer)
 Status WritableLogSegment::WriteEntryBatch(const Slice& data) {
   DCHECK(is_header_written_);
   DCHECK(!is_footer_written_);
-  uint8_t header_buf[kEntryHeaderSize];
+  uint8_t header_buf[kEntryHeaderSizeV2];
+
+  Slice batch_data = data;
+  if (codec_) {
+    compress_buf_.resize(codec_->MaxCompressedLength(data.size()));
+    size_t compressed_len;
+    RETURN_NOT_OK_PREPEND(codec_->Compress(data, compress_buf_.data(), &compressed_len),
+                          "Could not compress log entry batch");
+    batch_data = Slice(compress_buf_.data(), compressed_len);
+  }
 
-  // First encode the length of the message.
-  uint32_t len = data.size();
-  InlineEncodeFixed32(&header_buf[0], len);
+  // First encode the length of the message, and its uncompressed length if
+  // the segment's header format has room for it.
+  int off = 0;
+  InlineEncodeFixed32(&header_buf[off], batch_data.size());
+  off += 4;
+  if (entry_header_size_ == kEntryHeaderSizeV2) {
+    InlineEncodeFixed32(&header_buf[off], data.size());
+    off += 4;
+  }
 
   // Then the CRC of the message.
-  uint32_t msg_crc = crc::Crc32c(&data[0], data.size());
-  InlineEncodeFixed32(&header_buf[4], msg_crc);
+  uint32_t msg_crc = crc::Crc32c(batch_data.data(), batch_data.size());
+  InlineEncodeFixed32(&header_buf[off], msg_crc);
+  off += 4;
 
   // Then the CRC of the header
-  uint32_t header_crc = crc::Crc32c(&header_buf, 8);
-  InlineEncodeFixed32(&header_buf[8], header_crc);
+  uint32_t header_crc = crc::Crc32c(&header_buf, off);
+  InlineEncodeFixed32(&header_buf[off], header_crc);
+  off += 4;
+  DCHECK_EQ(entry_header_size_, off);
 
   // Write the header to the file, followed by the batch data itself.
-  RETURN_NOT_OK(writable_file_->Append(Slice(header_buf, sizeof(header_buf))));
-  written_offset_ += sizeof(header_buf);
+  RETURN_NOT_OK(writable_file_->Append(Slice(header_buf, off)));
+  written_offset_ += off;
 
-  RETURN_NOT_OK(writable_file_->Append(data));
-  written_offset_ += data.size();
+  RETURN_NOT_OK(writable_file_->Append(batch_data));
+  written_offset_ += batch_data.size();
 
   return Status::OK();
 }
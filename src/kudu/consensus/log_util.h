@@ -39,6 +39,10 @@ DECLARE_bool(log_force_fsync_all);
 
 namespace kudu {
 
+namespace cfile {
+class CompressionCodec;
+} // namespace cfile
+
 namespace consensus {
 struct OpIdBiggerThanFunctor;
 } // namespace consensus
@@ -52,6 +56,10 @@ extern const char kTmpSuffix[];
 // and checksum of the other two fields (see EntryHeader struct below).
 extern const size_t kEntryHeaderSize;
 
+// In segments whose header sets a compression codec, each entry's length is
+// followed by the batch's uncompressed length (4 bytes).
+extern const size_t kEntryHeaderSizeV2;
+
 extern const int kLogMajorVersion;
 extern const int kLogMinorVersion;
 
@@ -245,6 +253,11 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
   // ends.
   const int64_t readable_up_to() const;
 
+  // Returns the size of the header preceding each entry batch in this segment.
+  size_t entry_header_size() const {
+    return entry_header_size_;
+  }
+
  private:
   friend class RefCountedThreadSafe<ReadableLogSegment>;
   friend class LogEntryReader;
@@ -252,9 +265,13 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
   FRIEND_TEST(LogTest, TestWriteAndReadToAndFromInProgressSegment);
 
   struct EntryHeader {
-    // The length of the batch data.
+    // The length of the batch data, as written in the segment.
     uint32_t msg_length;
 
+    // The length of the batch data once uncompressed. Equal to 'msg_length'
+    // if the segment isn't compressed.
+    uint32_t msg_length_uncompressed;
+
     // The CRC32C of the batch data.
     uint32_t msg_crc;
 
@@ -262,6 +279,19 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
     uint32_t header_crc;
   };
 
+  // Holds data read ahead from this segment by
+  // ReadEntryHeaderAndBatchBuffered().
+  struct ReadAheadBuffer {
+    faststring scratch;
+
+    // The buffered data. Points into 'scratch' or into the file's own
+    // memory.
+    Slice data;
+
+    // The offset in the segment of the first byte of 'data'.
+    int64_t offset = 0;
+  };
+
   ~ReadableLogSegment() {}
 
   // Helper functions called by Init().
@@ -297,8 +327,8 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
   // Also increments the passed offset* by the length of the entry.
   Status ReadEntryHeader(int64_t *offset, EntryHeader* header);
 
-  // Decode a log entry header from the given slice, which must be kEntryHeaderSize
-  // bytes long. Returns true if successful, false if corrupt.
+  // Decode a log entry header from the given slice, which must be
+  // entry_header_size_ bytes long. Returns true if successful, false if corrupt.
   //
   // NOTE: this is performance-critical since it is used by ScanForValidEntryHeaders
   // and thus returns bool instead of Status.
@@ -312,6 +342,38 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
                         faststring* tmp_buf,
                         gscoped_ptr<LogEntryBatchPB>* entry_batch);
 
+  // Verifies the CRC of the batch 'data' described by 'header', which was read
+  // from 'offset', and uncompresses it if the segment has a codec. On success,
+  // 'batch_data' points to the serialized LogEntryBatchPB, either in 'data'
+  // or in 'uncompressed_buf'.
+  Status VerifyAndUncompressBatch(int64_t offset,
+                                  const EntryHeader& header,
+                                  const Slice& data,
+                                  faststring* uncompressed_buf,
+                                  Slice* batch_data);
+
+  // Like ReadEntryHeaderAndBatch(), but reads the segment through 'buf' at
+  // least 'readahead_bytes' at a time, so that reading many nearby batches
+  // costs a few large sequential reads rather than two small reads per batch.
+  //
+  // On success, 'batch_data' points to the serialized LogEntryBatchPB and is
+  // only valid until the next call with the same 'buf' or 'uncompressed_buf'.
+  // The number of bytes read from the file, if any, is added to 'bytes_read'.
+  Status ReadEntryHeaderAndBatchBuffered(int64_t offset,
+                                         int64_t readahead_bytes,
+                                         ReadAheadBuffer* buf,
+                                         faststring* uncompressed_buf,
+                                         Slice* batch_data,
+                                         int64_t* bytes_read);
+
+  // Makes sure that 'length' bytes at 'offset' are in 'buf', reading at least
+  // 'readahead_bytes' from the file if they are not.
+  Status FillReadAheadBuffer(int64_t offset,
+                             int64_t length,
+                             int64_t readahead_bytes,
+                             ReadAheadBuffer* buf,
+                             int64_t* bytes_read);
+
   void UpdateReadableToOffset(int64_t readable_to_offset);
 
   const std::string path_;
@@ -345,6 +407,14 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
   // the offset of the first entry in the log
   int64_t first_entry_offset_;
 
+  // The codec the entry batches were compressed with, or nullptr if they
+  // weren't. Set along with 'header_'.
+  const cfile::CompressionCodec* codec_;
+
+  // The size of the header preceding each entry batch, which depends on
+  // whether 'header_' sets a compression codec.
+  size_t entry_header_size_;
+
   DISALLOW_COPY_AND_ASSIGN(ReadableLogSegment);
 };
 
@@ -379,6 +449,10 @@ class WritableLogSegment {
     return writable_file_->Sync();
   }
 
+  const std::shared_ptr<WritableFile>& writable_file() const {
+    return writable_file_;
+  }
+
   // Returns true if the segment header has already been written to disk.
   bool IsHeaderWritten() const {
     return is_header_written_;
@@ -412,11 +486,6 @@ class WritableLogSegment {
   }
 
  private:
-
-  const std::shared_ptr<WritableFile>& writable_file() const {
-    return writable_file_;
-  }
-
   // The path to the log file.
   const std::string path_;
 
@@ -437,6 +506,15 @@ class WritableLogSegment {
   // The offset where the last written entry ends.
   int64_t written_offset_;
 
+  // The codec with which entry batches are compressed, or nullptr if they
+  // aren't, and the size of the header written before each batch. Both are
+  // set from the segment header.
+  const cfile::CompressionCodec* codec_;
+  size_t entry_header_size_;
+
+  // Buffer for the compressed form of the batch being written.
+  faststring compress_buf_;
+
   DISALLOW_COPY_AND_ASSIGN(WritableLogSegment);
 };
 
@@ -57,6 +57,27 @@ TEST(QuorumUtilTest, TestMemberExtraction) {
   ASSERT_EQ("B", peer_pb.permanent_uuid());
 }
 
+TEST(QuorumUtilTest, TestNonVoters) {
+  ConsensusStatePB cstate;
+  cstate.set_current_term(1);
+  SetPeerInfo("A", RaftPeerPB::VOTER, cstate.mutable_config()->add_peers());
+  SetPeerInfo("B", RaftPeerPB::NON_VOTER, cstate.mutable_config()->add_peers());
+  cstate.set_leader_uuid("A");
+  ASSERT_OK(VerifyConsensusState(cstate, UNCOMMITTED_QUORUM));
+  ASSERT_EQ(1, CountVoters(cstate.config()));
+  ASSERT_FALSE(IsRaftConfigVoter("B", cstate.config()));
+  ASSERT_EQ(RaftPeerPB::LEARNER, GetConsensusRole("B", cstate));
+
+  // A learner can't lead.
+  cstate.set_leader_uuid("B");
+  ASSERT_TRUE(VerifyConsensusState(cstate, UNCOMMITTED_QUORUM).IsIllegalState());
+
+  // A config needs a voter to elect a leader and commit anything.
+  cstate.clear_leader_uuid();
+  cstate.mutable_config()->mutable_peers(0)->set_member_type(RaftPeerPB::NON_VOTER);
+  ASSERT_TRUE(VerifyConsensusState(cstate, UNCOMMITTED_QUORUM).IsIllegalState());
+}
+
 TEST(QuorumUtilTest, TestDiffConsensusStates) {
   ConsensusStatePB old_cs;
   SetPeerInfo("A", RaftPeerPB::VOTER, old_cs.mutable_config()->add_peers());
@@ -33,6 +33,7 @@
 #include "kudu/consensus/peer_manager.h"
 #include "kudu/consensus/quorum_util.h"
 #include "kudu/consensus/raft_consensus_state.h"
+#include "kudu/gutil/bind.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/stringprintf.h"
@@ -243,6 +244,8 @@ RaftConsensus::RaftConsensus(
                                 peer_uuid,
                                 std::move(cmeta),
                                 DCHECK_NOTNULL(txn_factory)));
+  queue_->SetSafeTimestampCallback(
+      Bind(&ReplicaTransactionFactory::GetSafeTimestampForFollowers, Unretained(txn_factory)));
 }
 
 RaftConsensus::~RaftConsensus() {
@@ -365,6 +368,11 @@ Status RaftConsensus::StartElection(ElectionMode mode) {
       return Status::IllegalState("Not starting election: Node is currently "
                                   "a non-participant in the raft config",
                                   state_->GetActiveConfigUnlocked().ShortDebugString());
+    } else if (active_role == RaftPeerPB::LEARNER) {
+      // NON_VOTER learners only follow the leader's log, they never run for
+      // leadership. The failure detector keeps running so that a learner
+      // promoted to VOTER later on starts watching the leader right away.
+      return SnoozeFailureDetectorUnlocked();
     }
 
     if (state_->HasLeaderUnlocked()) {
@@ -689,6 +697,16 @@ Status RaftConsensus::Update(const ConsensusRequestPB* request,
   }
   RETURN_NOT_OK(s);
 
+  // Only adopt the leader's safe time once this replica has received and
+  // committed everything up to the index it was sent with.
+  if (request->has_safe_timestamp() &&
+      !response->status().has_error() &&
+      response->status().last_committed_idx() >= request->committed_index()) {
+    Timestamp safe_timestamp(request->safe_timestamp());
+    state_->GetReplicaTransactionFactoryUnlocked()->AdvanceSafeTimestamp(
+        request->committed_index(), safe_timestamp);
+  }
+
   RETURN_NOT_OK(ExecuteHook(POST_UPDATE));
   return Status::OK();
 }
@@ -0,0 +1,57 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/consensus/ref_counted_replicate.h"
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/wire_format_lite.h>
+
+using google::protobuf::internal::WireFormatLite;
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::io::StringOutputStream;
+
+namespace kudu {
+namespace consensus {
+
+const std::string& RefCountedReplicate::EncodedAsOp() {
+  CHECK_OK(encode_once_.Init(&RefCountedReplicate::EncodeAsOp, this));
+  return encoded_op_;
+}
+
+Status RefCountedReplicate::EncodeAsOp() {
+  // WriteMessage() relies on the cached size.
+  int msg_size = msg_->ByteSize();
+  // Leave room for the field tag and the length prefix, at most 5 bytes each.
+  encoded_op_.reserve(msg_size + 10);
+  bool had_error;
+  {
+    // The string is only trimmed to the encoded size once the streams are
+    // destroyed.
+    StringOutputStream sos(&encoded_op_);
+    CodedOutputStream cos(&sos);
+    WireFormatLite::WriteMessage(ConsensusRequestPB::kOpsFieldNumber, *msg_, &cos);
+    had_error = cos.HadError();
+  }
+  if (PREDICT_FALSE(had_error)) {
+    return Status::Corruption("unable to encode replicate message", msg_->id().ShortDebugString());
+  }
+  return Status::OK();
+}
+
+} // namespace consensus
+} // namespace kudu
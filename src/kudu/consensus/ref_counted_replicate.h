@@ -18,9 +18,12 @@
 #ifndef KUDU_CONSENSUS_REF_COUNTED_REPLICATE_H_
 #define KUDU_CONSENSUS_REF_COUNTED_REPLICATE_H_
 
+#include <string>
+
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/util/once.h"
 
 namespace kudu {
 namespace consensus {
@@ -34,8 +37,21 @@ class RefCountedReplicate : public RefCountedThreadSafe<RefCountedReplicate> {
     return msg_.get();
   }
 
+  // Returns the message encoded as one entry of the 'ops' field of a
+  // ConsensusRequestPB, i.e. field tag, length and message bytes, such that
+  // the concatenated encodings of several messages can be merged into a
+  // request. The encoding is computed on first use and then shared between
+  // all the peers the message is sent to, so the message must not be
+  // modified after this is called.
+  const std::string& EncodedAsOp();
+
  private:
+  Status EncodeAsOp();
+
   gscoped_ptr<ReplicateMsg> msg_;
+
+  KuduOnceDynamic encode_once_;
+  std::string encoded_op_;
 };
 
 typedef scoped_refptr<RefCountedReplicate> ReplicateRefPtr;
@@ -17,6 +17,7 @@
 
 #include <memory>
 
+#include "kudu/fs/data_dir_latency_tracker.h"
 #include "kudu/fs/file_block_manager.h"
 #include "kudu/fs/fs.pb.h"
 #include "kudu/fs/log_block_manager.h"
@@ -54,8 +55,14 @@ DECLARE_int64(fs_data_dirs_reserved_bytes);
 DECLARE_int64(disk_reserved_bytes_free_for_testing);
 
 DECLARE_int32(log_block_manager_full_disk_cache_seconds);
+DECLARE_int32(log_container_metadata_compact_min_records);
 DECLARE_string(block_manager);
 
+DECLARE_int32(fs_data_dir_latency_window_ms);
+
+DECLARE_int64(fs_background_write_bytes_per_sec);
+DECLARE_int32(fs_background_write_read_latency_target_ms);
+
 // Generic block manager metrics.
 METRIC_DECLARE_gauge_uint64(block_manager_blocks_open_reading);
 METRIC_DECLARE_gauge_uint64(block_manager_blocks_open_writing);
@@ -63,6 +70,12 @@ METRIC_DECLARE_counter(block_manager_total_writable_blocks);
 METRIC_DECLARE_counter(block_manager_total_readable_blocks);
 METRIC_DECLARE_counter(block_manager_total_bytes_written);
 METRIC_DECLARE_counter(block_manager_total_bytes_read);
+METRIC_DECLARE_counter(block_manager_background_bytes_throttled);
+METRIC_DECLARE_counter(block_manager_background_write_throttled_time_us);
+METRIC_DECLARE_gauge_int64(block_manager_background_write_budget);
+METRIC_DECLARE_histogram(block_manager_group_close_flush_time_us);
+METRIC_DECLARE_histogram(block_manager_group_close_data_sync_time_us);
+METRIC_DECLARE_histogram(block_manager_group_close_metadata_sync_time_us);
 
 // Log block manager metrics.
 METRIC_DECLARE_gauge_uint64(log_block_manager_bytes_under_management);
@@ -476,6 +489,55 @@ TYPED_TEST(BlockManagerTest, CloseManyBlocksTest) {
   }
 }
 
+// Tests that a group of blocks spread over several paths is closed in
+// phases, and that every block of the group is durable afterwards.
+TYPED_TEST(BlockManagerTest, GroupCloseTest) {
+  vector<string> paths;
+  for (int i = 0; i < 3; i++) {
+    paths.push_back(this->GetTestPath(Substitute("path$0", i)));
+  }
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity = METRIC_ENTITY_server.Instantiate(&registry, "test");
+  ASSERT_OK(this->ReopenBlockManager(entity,
+                                     shared_ptr<MemTracker>(),
+                                     paths,
+                                     true));
+
+  vector<BlockId> ids;
+  {
+    ScopedWritableBlockCloser closer;
+    for (int i = 0; i < 20; i++) {
+      gscoped_ptr<WritableBlock> block;
+      ASSERT_OK(this->bm_->CreateBlock(&block));
+      ASSERT_OK(block->Append(Substitute("block $0", i)));
+      ids.push_back(block->id());
+      closer.AddBlock(std::move(block));
+    }
+    ASSERT_OK(closer.CloseBlocks());
+  }
+  for (HistogramPrototype* prototype : { &METRIC_block_manager_group_close_flush_time_us,
+                                         &METRIC_block_manager_group_close_data_sync_time_us,
+                                         &METRIC_block_manager_group_close_metadata_sync_time_us }) {
+    ASSERT_EQ(1, down_cast<Histogram*>(entity->FindOrNull(*prototype).get())->TotalCount())
+        << prototype->name();
+  }
+
+  // Every block can be read back once the block manager is reopened.
+  ASSERT_OK(this->ReopenBlockManager(scoped_refptr<MetricEntity>(),
+                                     shared_ptr<MemTracker>(),
+                                     paths,
+                                     false));
+  for (int i = 0; i < ids.size(); i++) {
+    gscoped_ptr<ReadableBlock> block;
+    ASSERT_OK(this->bm_->OpenBlock(ids[i], &block));
+    string expected = Substitute("block $0", i);
+    Slice data;
+    gscoped_ptr<uint8_t[]> scratch(new uint8_t[expected.size()]);
+    ASSERT_OK(block->Read(0, expected.size(), &data, scratch.get()));
+    ASSERT_EQ(expected, data.ToString());
+  }
+}
+
 // We can't really test that FlushDataAsync() "works", but we can test that
 // it doesn't break anything.
 TYPED_TEST(BlockManagerTest, FlushDataAsyncTest) {
@@ -634,6 +696,44 @@ TYPED_TEST(BlockManagerTest, MultiPathTest) {
   ASSERT_NO_FATAL_FAILURE(this->RunMultipathTest(paths));
 }
 
+// Tests that no new blocks are placed in a degraded data directory.
+TYPED_TEST(BlockManagerTest, DegradedDataDirTest) {
+  vector<string> paths;
+  for (int i = 0; i < 3; i++) {
+    paths.push_back(this->GetTestPath(Substitute("path$0", i)));
+  }
+  ASSERT_OK(this->ReopenBlockManager(scoped_refptr<MetricEntity>(),
+                                     shared_ptr<MemTracker>(),
+                                     paths,
+                                     true));
+
+  // Degrade the first path with a few windows of slow reads.
+  DataDirLatencyTracker* tracker = this->bm_->latency_tracker();
+  MonoTime now = MonoTime::Now();
+  for (int w = 0; w < 4; w++) {
+    for (int i = 0; i < 3; i++) {
+      tracker->RecordLatency(paths[0], DataDirLatencyTracker::READ,
+                             MonoDelta::FromSeconds(1), now);
+    }
+    now += MonoDelta::FromMilliseconds(FLAGS_fs_data_dir_latency_window_ms + 1);
+  }
+  vector<string> degraded;
+  this->bm_->GetDegradedRootPaths(&degraded);
+  ASSERT_EQ(vector<string>({ paths[0] }), degraded);
+
+  vector<string> children_before;
+  ASSERT_OK(this->env_->GetChildren(paths[0], &children_before));
+  for (int i = 0; i < 10; i++) {
+    gscoped_ptr<WritableBlock> writer;
+    ASSERT_OK(this->bm_->CreateBlock(&writer));
+    ASSERT_OK(writer->Append("test data"));
+    ASSERT_OK(writer->Close());
+  }
+  vector<string> children_after;
+  ASSERT_OK(this->env_->GetChildren(paths[0], &children_after));
+  ASSERT_EQ(children_before.size(), children_after.size());
+}
+
 static void CloseHelper(ReadableBlock* block) {
   CHECK_OK(block->Close());
 }
@@ -709,6 +809,49 @@ TYPED_TEST(BlockManagerTest, MetricsTest) {
   }
 }
 
+// Appends to background blocks are rate limited; appends to other blocks are not.
+TYPED_TEST(BlockManagerTest, BackgroundWriteThrottleTest) {
+  const int64_t kBytesPerSec = 1024 * 1024;
+  FLAGS_fs_background_write_bytes_per_sec = kBytesPerSec;
+  FLAGS_fs_background_write_read_latency_target_ms = 0;
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity = METRIC_ENTITY_server.Instantiate(&registry, "test");
+  ASSERT_OK(this->ReopenBlockManager(entity,
+                                     shared_ptr<MemTracker>(),
+                                     { GetTestDataDirectory() },
+                                     false));
+  scoped_refptr<Counter> bytes_throttled =
+      METRIC_block_manager_background_bytes_throttled.Instantiate(entity);
+  scoped_refptr<Counter> time_throttled =
+      METRIC_block_manager_background_write_throttled_time_us.Instantiate(entity);
+  scoped_refptr<AtomicGauge<int64_t>> budget =
+      METRIC_block_manager_background_write_budget.Instantiate(entity, 0);
+
+  const string kChunk(kBytesPerSec / 20, 'x');
+  gscoped_ptr<WritableBlock> writer;
+  ASSERT_OK(this->bm_->CreateBlock(&writer));
+  for (int i = 0; i < 20; i++) {
+    ASSERT_OK(writer->Append(kChunk));
+  }
+  ASSERT_OK(writer->Close());
+  ASSERT_EQ(0, bytes_throttled->value());
+
+  // Half a second's worth of budget, of which only the first refill period
+  // is available right away.
+  ASSERT_OK(this->bm_->CreateBlock(CreateBlockOptions::Background(), &writer));
+  Stopwatch sw;
+  sw.start();
+  for (int i = 0; i < 10; i++) {
+    ASSERT_OK(writer->Append(kChunk));
+  }
+  sw.stop();
+  ASSERT_OK(writer->Close());
+  ASSERT_GE(sw.elapsed().wall_seconds(), 0.3);
+  ASSERT_GT(bytes_throttled->value(), 0);
+  ASSERT_GT(time_throttled->value(), 0);
+  ASSERT_EQ(kBytesPerSec, budget->value());
+}
+
 TYPED_TEST(BlockManagerTest, LogMetricsTest) {
   ASSERT_NO_FATAL_FAILURE(this->RunLogMetricsTest());
 }
@@ -727,6 +870,46 @@ class LogBlockManagerTest : public BlockManagerTest<LogBlockManager> {
 
 // Regression test for KUDU-1190, a crash at startup when a block ID has been
 // reused.
+// Tests that a data directory is degraded after persistently slow I/O and
+// recovers once its I/O is fast again.
+TEST(DataDirLatencyTrackerTest, TestDegradeAndRecover) {
+  DataDirLatencyTracker tracker((scoped_refptr<MetricEntity>()));
+  const MonoDelta kWindow =
+      MonoDelta::FromMilliseconds(FLAGS_fs_data_dir_latency_window_ms + 1);
+  MonoTime now = MonoTime::Now();
+  auto run_window = [&](const string& root_path, const MonoDelta& latency) {
+    for (int i = 0; i < 3; i++) {
+      tracker.RecordLatency(root_path, DataDirLatencyTracker::READ, latency, now);
+    }
+    now += kWindow;
+  };
+
+  // Each window is judged once the next one starts.
+  for (int w = 0; w < 3; w++) {
+    run_window("slow", MonoDelta::FromSeconds(1));
+    run_window("fast", MonoDelta::FromMilliseconds(1));
+  }
+  ASSERT_FALSE(tracker.IsDegraded("slow"));
+  run_window("slow", MonoDelta::FromSeconds(1));
+  run_window("fast", MonoDelta::FromMilliseconds(1));
+  ASSERT_TRUE(tracker.IsDegraded("slow"));
+  ASSERT_FALSE(tracker.IsDegraded("fast"));
+  vector<string> degraded;
+  tracker.GetDegradedRootPaths(&degraded);
+  ASSERT_EQ(vector<string>({ "slow" }), degraded);
+  ASSERT_NEAR(1000000, tracker.LatencyPercentileMicros("slow", DataDirLatencyTracker::READ, 99),
+              10000);
+
+  // Windows with too little I/O don't count.
+  tracker.RecordLatency("slow", DataDirLatencyTracker::READ, MonoDelta::FromMilliseconds(1), now);
+  now += kWindow;
+  for (int w = 0; w < 4; w++) {
+    ASSERT_TRUE(tracker.IsDegraded("slow"));
+    run_window("slow", MonoDelta::FromMilliseconds(1));
+  }
+  ASSERT_FALSE(tracker.IsDegraded("slow"));
+}
+
 TEST_F(LogBlockManagerTest, TestReuseBlockIds) {
   RETURN_NOT_LOG_BLOCK_MANAGER();
 
@@ -978,6 +1161,147 @@ TEST_F(LogBlockManagerTest, TestMetadataTruncation) {
                                      false));
 }
 
+// Test that the metadata of a container with mostly deleted blocks is
+// compacted at startup, keeping the live blocks.
+TEST_F(LogBlockManagerTest, TestCompactMetadata) {
+  RETURN_NOT_LOG_BLOCK_MANAGER();
+  FLAGS_log_container_metadata_compact_min_records = 0;
+
+  // Write 10 blocks to a single container, then delete all but two.
+  vector<BlockId> block_ids;
+  for (int i = 0; i < 10; i++) {
+    gscoped_ptr<WritableBlock> writer;
+    ASSERT_OK(bm_->CreateBlock(&writer));
+    ASSERT_OK(writer->Append(Substitute("block $0", i)));
+    ASSERT_OK(writer->Close());
+    block_ids.push_back(writer->id());
+  }
+  ASSERT_EQ(1, bm_->all_containers_.size());
+  for (int i = 2; i < 10; i++) {
+    ASSERT_OK(bm_->DeleteBlock(block_ids[i]));
+  }
+  string metadata_path = LogBlockManager::ContainerPathForTests(bm_->all_containers_[0]) +
+      LogBlockManager::kContainerMetadataFileSuffix;
+  uint64_t old_meta_size;
+  ASSERT_OK(env_->GetFileSize(metadata_path, &old_meta_size));
+
+  ASSERT_OK(ReopenBlockManager(scoped_refptr<MetricEntity>(),
+                               shared_ptr<MemTracker>(),
+                               { GetTestDataDirectory() },
+                               false));
+  uint64_t new_meta_size;
+  ASSERT_OK(env_->GetFileSize(metadata_path, &new_meta_size));
+  ASSERT_LT(new_meta_size, old_meta_size);
+  ASSERT_EQ(2, bm_->CountBlocksForTests());
+  for (int i = 0; i < 2; i++) {
+    gscoped_ptr<ReadableBlock> block;
+    ASSERT_OK(bm_->OpenBlock(block_ids[i], &block));
+    string expected = Substitute("block $0", i);
+    Slice data;
+    gscoped_ptr<uint8_t[]> scratch(new uint8_t[expected.size()]);
+    ASSERT_OK(block->Read(0, expected.size(), &data, scratch.get()));
+    ASSERT_EQ(expected, data.ToString());
+  }
+  ASSERT_TRUE(bm_->OpenBlock(block_ids[5], nullptr).IsNotFound());
+
+  // Only the live blocks remain, along with the last block and its DELETE,
+  // which preserve the container's size and the block ID sequence.
+  {
+    gscoped_ptr<RandomAccessFile> file;
+    ASSERT_OK(env_->NewRandomAccessFile(metadata_path, &file));
+    ReadablePBContainerFile reader(std::move(file));
+    ASSERT_OK(reader.Open());
+    vector<BlockRecordPB> records;
+    BlockRecordPB record;
+    while (reader.ReadNextPB(&record).ok()) {
+      records.push_back(record);
+    }
+    ASSERT_EQ(4, records.size());
+    ASSERT_EQ(block_ids[9].id(), records[2].block_id().id());
+    ASSERT_EQ(DELETE, records[3].op_type());
+  }
+
+  // New blocks are appended to the compacted metadata, and survive another
+  // restart.
+  {
+    gscoped_ptr<WritableBlock> writer;
+    ASSERT_OK(bm_->CreateBlock(&writer));
+    ASSERT_GT(writer->id().id(), block_ids[9].id());
+    ASSERT_OK(writer->Close());
+  }
+  ASSERT_OK(ReopenBlockManager(scoped_refptr<MetricEntity>(),
+                               shared_ptr<MemTracker>(),
+                               { GetTestDataDirectory() },
+                               false));
+  ASSERT_EQ(3, bm_->CountBlocksForTests());
+}
+
+TEST_F(LogBlockManagerTest, TestCompactContainer) {
+  RETURN_NOT_LOG_BLOCK_MANAGER();
+
+  // Write 10 blocks to a single container, then make it full and delete all
+  // but two of them.
+  vector<BlockId> block_ids;
+  for (int i = 0; i < 10; i++) {
+    gscoped_ptr<WritableBlock> writer;
+    ASSERT_OK(bm_->CreateBlock(&writer));
+    ASSERT_OK(writer->Append(Substitute("block $0", i)));
+    ASSERT_OK(writer->Close());
+    block_ids.push_back(writer->id());
+  }
+  uint64_t max_size = FLAGS_log_container_max_size;
+  FLAGS_log_container_max_size = 1;
+  ASSERT_OK(ReopenBlockManager(scoped_refptr<MetricEntity>(),
+                               shared_ptr<MemTracker>(),
+                               { GetTestDataDirectory() },
+                               false));
+  ASSERT_EQ(1, bm_->all_containers_.size());
+  internal::LogBlockContainer* container = bm_->all_containers_[0];
+  for (int i = 2; i < 10; i++) {
+    ASSERT_OK(bm_->DeleteBlock(block_ids[i]));
+  }
+  double live_ratio;
+  ASSERT_EQ(container, bm_->FindContainerToCompact(&live_ratio));
+  ASSERT_LT(live_ratio, 0.1);
+
+  // A block open for reading can still be read once it is relocated. The
+  // blocks are relocated into a new container, which isn't full.
+  FLAGS_log_container_max_size = max_size;
+  gscoped_ptr<ReadableBlock> open_block;
+  ASSERT_OK(bm_->OpenBlock(block_ids[0], &open_block));
+  ASSERT_OK(bm_->CompactContainer(container));
+  ASSERT_GT(bm_->all_containers_.size(), 1);
+  ASSERT_TRUE(bm_->FindContainerToCompact(&live_ratio) == nullptr);
+
+  auto check_blocks = [&]() {
+    ASSERT_EQ(2, bm_->CountBlocksForTests());
+    for (int i = 0; i < 2; i++) {
+      gscoped_ptr<ReadableBlock> block;
+      ASSERT_OK(bm_->OpenBlock(block_ids[i], &block));
+      string expected = Substitute("block $0", i);
+      Slice data;
+      gscoped_ptr<uint8_t[]> scratch(new uint8_t[expected.size()]);
+      ASSERT_OK(block->Read(0, expected.size(), &data, scratch.get()));
+      ASSERT_EQ(expected, data.ToString());
+    }
+  };
+  {
+    Slice data;
+    uint8_t scratch[7];
+    ASSERT_OK(open_block->Read(0, sizeof(scratch), &data, scratch));
+    ASSERT_EQ("block 0", data.ToString());
+    ASSERT_OK(open_block->Close());
+  }
+  NO_FATALS(check_blocks());
+
+  // The relocated blocks are found in their new containers after a restart.
+  ASSERT_OK(ReopenBlockManager(scoped_refptr<MetricEntity>(),
+                               shared_ptr<MemTracker>(),
+                               { GetTestDataDirectory() },
+                               false));
+  NO_FATALS(check_blocks());
+}
+
 TEST_F(LogBlockManagerTest, TestDiskSpaceCheck) {
   RETURN_NOT_LOG_BLOCK_MANAGER();
 
@@ -19,9 +19,11 @@
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/metrics.h"
 
-DEFINE_bool(block_coalesce_close, false,
-            "Coalesce synchronization of data during CloseBlocks()");
-TAG_FLAG(block_coalesce_close, experimental);
+DEFINE_bool(block_coalesce_close, true,
+            "Coalesce synchronization of data during CloseBlocks(): write out "
+            "all of the blocks first, then sync each of their files once and "
+            "concurrently, then sync their metadata.");
+TAG_FLAG(block_coalesce_close, advanced);
 
 DEFINE_bool(block_manager_lock_dirs, true,
             "Lock the data block directories to prevent concurrent usage. "
@@ -34,7 +36,8 @@ namespace fs {
 const char* BlockManager::kInstanceMetadataFileName = "block_manager_instance";
 
 BlockManagerOptions::BlockManagerOptions()
-  : read_only(false) {
+  : read_only(false),
+    direct_reads(false) {
 }
 
 BlockManagerOptions::~BlockManagerOptions() {
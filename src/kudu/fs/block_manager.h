@@ -22,6 +22,7 @@
 #include <memory>
 #include <stdint.h>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "kudu/fs/block_id.h"
@@ -35,6 +36,7 @@ DECLARE_bool(block_coalesce_close);
 
 namespace kudu {
 
+class MaintenanceManager;
 class MemTracker;
 class MetricEntity;
 class Slice;
@@ -68,8 +70,9 @@ class Block {
 // 1. FlushDataAsync() before Close(). If there's enough work to be done
 //    between the two calls, there will be less outstanding I/O to wait for
 //    during Close().
-// 2. CloseBlocks() on a group of blocks. This at least ensures that, when
-//    waiting on outstanding I/O, the waiting is done in parallel.
+// 2. CloseBlocks() on a group of blocks. With --block_coalesce_close, their
+//    data is written out together and each underlying file is synced once,
+//    concurrently with the others, followed by their metadata.
 //
 // NOTE: if a WritableBlock is not explicitly Close()ed, it will be aborted
 // (i.e. deleted).
@@ -158,6 +161,37 @@ class ReadableBlock : public Block {
 
 // Provides options and hints for block placement.
 struct CreateBlockOptions {
+  CreateBlockOptions() : background(false) {}
+
+  // Returns options for a block written by a flush or compaction.
+  static CreateBlockOptions Background() {
+    CreateBlockOptions opts;
+    opts.background = true;
+    return opts;
+  }
+
+  // Returns options for a block written by a flush or compaction of tablet
+  // 'tablet_id'.
+  static CreateBlockOptions Background(std::string tablet_id) {
+    CreateBlockOptions opts = Background();
+    opts.tablet_id = std::move(tablet_id);
+    return opts;
+  }
+
+  // Whether the block is written by background maintenance (flushes and
+  // compactions) rather than on behalf of a client. Appends to background
+  // blocks are rate limited per data directory; see IOThrottler.
+  //
+  // Defaults to false.
+  bool background;
+
+  // The tablet the block belongs to, if any. The FsManager places the
+  // block in the tablet's data dir group by setting 'root_paths'.
+  std::string tablet_id;
+
+  // If not empty, the block is placed in one of these root paths, unless
+  // all of them are full. Otherwise it may be placed in any root path.
+  std::vector<std::string> root_paths;
 };
 
 // Block manager creation options.
@@ -180,6 +214,10 @@ struct BlockManagerOptions {
 
   // Whether the block manager should only allow reading. Defaults to false.
   bool read_only;
+
+  // Whether blocks should be read with direct I/O, bypassing the page cache.
+  // Useful when the caller caches block contents itself. Defaults to false.
+  bool direct_reads;
 };
 
 // Utilities for Kudu block lifecycle management. All methods are
@@ -232,11 +270,28 @@ class BlockManager {
   // On success, guarantees that outstanding data is durable.
   virtual Status CloseBlocks(const std::vector<WritableBlock*>& blocks) = 0;
 
+  // Registers the maintenance ops which reorganize the block manager's
+  // storage in the background, if it has any, with 'manager'. They must be
+  // unregistered with UnregisterMaintenanceOps() before either the block
+  // manager or 'manager' is destroyed.
+  virtual void RegisterMaintenanceOps(MaintenanceManager* manager) {}
+
+  // Unregisters the ops registered by RegisterMaintenanceOps(), waiting for
+  // those running to finish.
+  virtual void UnregisterMaintenanceOps() {}
+
+  // Sets 'root_paths' to the root paths whose I/O is persistently slow. New
+  // blocks are placed elsewhere while other root paths have room.
+  virtual void GetDegradedRootPaths(std::vector<std::string>* root_paths) const {
+    root_paths->clear();
+  }
+
  protected:
   static const char* kInstanceMetadataFileName;
 };
 
-// Closes a group of blocks.
+// Closes a group of blocks with BlockManager::CloseBlocks(), so that their
+// syncs are batched.
 //
 // Blocks must be closed explicitly via CloseBlocks(), otherwise they will
 // be deleted in the in the destructor.
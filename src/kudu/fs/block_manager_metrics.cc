@@ -49,6 +49,27 @@ METRIC_DEFINE_counter(server, block_manager_total_bytes_read,
                       kudu::MetricUnit::kBytes,
                       "Number of bytes of block data read since service start");
 
+METRIC_DEFINE_histogram(server, block_manager_group_close_flush_time_us,
+                        "Block Group Close Flush Time",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Time spent writing out the data and metadata of a group of "
+                        "blocks being closed together, before syncing them",
+                        60000000LU, 2);
+
+METRIC_DEFINE_histogram(server, block_manager_group_close_data_sync_time_us,
+                        "Block Group Close Data Sync Time",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Time spent syncing the data of a group of blocks being closed "
+                        "together, with one concurrent sync per file",
+                        60000000LU, 2);
+
+METRIC_DEFINE_histogram(server, block_manager_group_close_metadata_sync_time_us,
+                        "Block Group Close Metadata Sync Time",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Time spent syncing the metadata of a group of blocks being "
+                        "closed together, once their data was synced",
+                        60000000LU, 2);
+
 namespace kudu {
 namespace fs {
 namespace internal {
@@ -61,7 +82,10 @@ BlockManagerMetrics::BlockManagerMetrics(const scoped_refptr<MetricEntity>& enti
     MINIT(total_readable_blocks),
     MINIT(total_writable_blocks),
     MINIT(total_bytes_read),
-    MINIT(total_bytes_written) {
+    MINIT(total_bytes_written),
+    MINIT(group_close_flush_time_us),
+    MINIT(group_close_data_sync_time_us),
+    MINIT(group_close_metadata_sync_time_us) {
 }
 #undef GINIT
 #undef MINIT
@@ -26,6 +26,7 @@ namespace kudu {
 class Counter;
 template<class T>
 class AtomicGauge;
+class Histogram;
 class MetricEntity;
 
 namespace fs {
@@ -41,6 +42,11 @@ struct BlockManagerMetrics {
   scoped_refptr<Counter> total_writable_blocks;
   scoped_refptr<Counter> total_bytes_read;
   scoped_refptr<Counter> total_bytes_written;
+
+  // The phases of closing a group of blocks with CloseBlocks().
+  scoped_refptr<Histogram> group_close_flush_time_us;
+  scoped_refptr<Histogram> group_close_data_sync_time_us;
+  scoped_refptr<Histogram> group_close_metadata_sync_time_us;
 };
 
 } // namespace internal
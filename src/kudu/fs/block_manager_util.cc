@@ -23,9 +23,11 @@
 #include <gflags/gflags.h>
 
 #include "kudu/fs/fs.pb.h"
+#include "kudu/gutil/bind.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/async_io.h"
 #include "kudu/util/env.h"
 #include "kudu/util/path_util.h"
 #include "kudu/util/pb_util.h"
@@ -171,5 +173,21 @@ Status PathInstanceMetadataFile::CheckIntegrity(
   return Status::OK();
 }
 
+Status SyncConcurrently(const vector<StatusClosure>& syncs) {
+  if (syncs.empty()) {
+    return Status::OK();
+  }
+  // A single sync gains nothing from being handed off.
+  if (syncs.size() == 1) {
+    return syncs[0].Run();
+  }
+  vector<AsyncIo::Request> requests;
+  requests.reserve(syncs.size());
+  for (const StatusClosure& sync : syncs) {
+    requests.push_back(AsyncIo::Request::Custom(sync, Bind(&DoNothingStatusCB)));
+  }
+  return AsyncIo::Default()->SubmitAndWait(requests);
+}
+
 } // namespace fs
 } // namespace kudu
@@ -23,6 +23,7 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/util/path_util.h"
 #include "kudu/util/status.h"
+#include "kudu/util/status_callback.h"
 
 namespace kudu {
 
@@ -85,6 +86,13 @@ class PathInstanceMetadataFile {
   gscoped_ptr<FileLock> lock_;
 };
 
+// Runs each of 'syncs' concurrently on the shared AsyncIo, and waits for all
+// of them to complete. Returns the first error any of them had.
+//
+// Used when closing a group of blocks, so that the time spent syncing the
+// group is that of its slowest sync rather than their sum.
+Status SyncConcurrently(const std::vector<StatusClosure>& syncs);
+
 } // namespace fs
 } // namespace kudu
 #endif
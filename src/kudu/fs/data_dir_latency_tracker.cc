@@ -0,0 +1,228 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/fs/data_dir_latency_tracker.h"
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <mutex>
+
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/hdr_histogram.h"
+#include "kudu/util/metrics.h"
+
+DEFINE_int32(fs_data_dir_latency_window_ms, 10000,
+             "Length of the windows over which the I/O latency of each data "
+             "directory is averaged to detect slow directories.");
+TAG_FLAG(fs_data_dir_latency_window_ms, experimental);
+
+DEFINE_int32(fs_data_dir_slow_latency_ms, 500,
+             "Average I/O latency of a data directory over a window above which "
+             "the window counts as slow. Data directories slow for "
+             "--fs_data_dir_slow_windows windows in a row are degraded: no new "
+             "blocks are placed there and compactions of the tablets with data "
+             "there are deprioritized. 0 disables degrading data directories.");
+TAG_FLAG(fs_data_dir_slow_latency_ms, experimental);
+TAG_FLAG(fs_data_dir_slow_latency_ms, runtime);
+
+DEFINE_int32(fs_data_dir_slow_windows, 3,
+             "Number of slow windows in a row after which a data directory is "
+             "degraded, and of fast ones after which it recovers.");
+TAG_FLAG(fs_data_dir_slow_windows, experimental);
+TAG_FLAG(fs_data_dir_slow_windows, runtime);
+
+METRIC_DEFINE_histogram(server, block_manager_data_dir_read_latency,
+                        "Data Directory Read Latency",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Latency of the block reads from data directories.",
+                        60000000LU, 2);
+METRIC_DEFINE_histogram(server, block_manager_data_dir_write_latency,
+                        "Data Directory Write Latency",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Latency of the block writes to data directories.",
+                        60000000LU, 2);
+METRIC_DEFINE_histogram(server, block_manager_data_dir_sync_latency,
+                        "Data Directory Sync Latency",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Latency of the syncs of block data and metadata to data "
+                        "directories.", 60000000LU, 2);
+METRIC_DEFINE_gauge_uint32(server, block_manager_data_dirs_degraded,
+                           "Data Directories Degraded",
+                           kudu::MetricUnit::kUnits,
+                           "Number of data directories marked degraded because "
+                           "their I/O was persistently slow");
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace fs {
+
+namespace {
+
+// The fewest I/Os a window needs for its latency to be judged.
+const int64_t kMinOpsPerWindow = 3;
+
+// The highest latency tracked by the per-directory histograms.
+const uint64_t kMaxLatencyUs = 60000000LU;
+
+} // anonymous namespace
+
+struct DataDirLatencyTracker::DirState {
+  explicit DirState(MonoTime now)
+    : window_start(now),
+      window_latency_us(0),
+      window_ops(0),
+      slow_windows(0),
+      fast_windows(0),
+      degraded(false) {
+    for (auto& h : histograms) {
+      h.reset(new HdrHistogram(kMaxLatencyUs, 2));
+    }
+  }
+
+  // The latencies of all I/O, by IOType.
+  unique_ptr<HdrHistogram> histograms[SYNC + 1];
+
+  // The current window and its I/O.
+  MonoTime window_start;
+  int64_t window_latency_us;
+  int64_t window_ops;
+
+  // The number of slow and fast windows in a row.
+  int slow_windows;
+  int fast_windows;
+
+  bool degraded;
+};
+
+DataDirLatencyTracker::DataDirLatencyTracker(const scoped_refptr<MetricEntity>& metric_entity)
+    : num_degraded_(0) {
+  if (metric_entity) {
+    read_latency_ = METRIC_block_manager_data_dir_read_latency.Instantiate(metric_entity);
+    write_latency_ = METRIC_block_manager_data_dir_write_latency.Instantiate(metric_entity);
+    sync_latency_ = METRIC_block_manager_data_dir_sync_latency.Instantiate(metric_entity);
+    degraded_gauge_ = METRIC_block_manager_data_dirs_degraded.Instantiate(metric_entity, 0);
+  }
+}
+
+DataDirLatencyTracker::~DataDirLatencyTracker() {
+}
+
+void DataDirLatencyTracker::RecordLatency(const string& root_path, IOType type,
+                                          const MonoDelta& latency, MonoTime now) {
+  int64_t latency_us = std::max<int64_t>(0, latency.ToMicroseconds());
+  Histogram* metric = type == READ ? read_latency_.get() :
+                      type == WRITE ? write_latency_.get() : sync_latency_.get();
+  if (metric) {
+    metric->Increment(latency_us);
+  }
+
+  std::lock_guard<simple_spinlock> l(lock_);
+  unique_ptr<DirState>& dir = dirs_[root_path];
+  if (!dir) {
+    dir.reset(new DirState(now));
+  }
+  dir->histograms[type]->Increment(latency_us);
+  if (now - dir->window_start >=
+      MonoDelta::FromMilliseconds(FLAGS_fs_data_dir_latency_window_ms)) {
+    EndWindowUnlocked(root_path, dir.get(), now);
+  }
+  dir->window_latency_us += latency_us;
+  dir->window_ops++;
+}
+
+void DataDirLatencyTracker::EndWindowUnlocked(const string& root_path, DirState* dir,
+                                              MonoTime now) {
+  DCHECK(lock_.is_locked());
+  if (dir->window_ops >= kMinOpsPerWindow) {
+    const int64_t threshold_us = FLAGS_fs_data_dir_slow_latency_ms * 1000L;
+    int64_t avg_latency_us = dir->window_latency_us / dir->window_ops;
+    if (threshold_us > 0 && avg_latency_us > threshold_us) {
+      dir->slow_windows++;
+      dir->fast_windows = 0;
+    } else {
+      dir->fast_windows++;
+      dir->slow_windows = 0;
+    }
+
+    const int num_windows = std::max(1, FLAGS_fs_data_dir_slow_windows);
+    if (!dir->degraded && dir->slow_windows >= num_windows) {
+      dir->degraded = true;
+      num_degraded_++;
+      LOG(WARNING) << Substitute(
+          "Data directory $0 is degraded: its average I/O latency was over $1 ms "
+          "for $2 windows in a row (p99 latency: read $3 us, write $4 us, sync $5 us). "
+          "No new blocks will be placed there until it recovers",
+          root_path, FLAGS_fs_data_dir_slow_latency_ms, dir->slow_windows,
+          dir->histograms[READ]->ValueAtPercentile(99),
+          dir->histograms[WRITE]->ValueAtPercentile(99),
+          dir->histograms[SYNC]->ValueAtPercentile(99));
+    } else if (dir->degraded && dir->fast_windows >= num_windows) {
+      dir->degraded = false;
+      num_degraded_--;
+      LOG(INFO) << Substitute("Data directory $0 recovered: its I/O latency was "
+                              "normal for $1 windows in a row",
+                              root_path, dir->fast_windows);
+    }
+    if (degraded_gauge_) {
+      degraded_gauge_->set_value(num_degraded_);
+    }
+  }
+  dir->window_start = now;
+  dir->window_latency_us = 0;
+  dir->window_ops = 0;
+}
+
+bool DataDirLatencyTracker::IsDegraded(const string& root_path) const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (num_degraded_ == 0) {
+    return false;
+  }
+  const unique_ptr<DirState>* dir = FindOrNull(dirs_, root_path);
+  return dir && (*dir)->degraded;
+}
+
+void DataDirLatencyTracker::GetDegradedRootPaths(vector<string>* root_paths) const {
+  root_paths->clear();
+  std::lock_guard<simple_spinlock> l(lock_);
+  for (const auto& e : dirs_) {
+    if (e.second->degraded) {
+      root_paths->push_back(e.first);
+    }
+  }
+}
+
+int64_t DataDirLatencyTracker::LatencyPercentileMicros(const string& root_path,
+                                                       IOType type,
+                                                       double percentile) const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  const unique_ptr<DirState>* dir = FindOrNull(dirs_, root_path);
+  if (!dir || (*dir)->histograms[type]->TotalCount() == 0) {
+    return 0;
+  }
+  return (*dir)->histograms[type]->ValueAtPercentile(percentile);
+}
+
+} // namespace fs
+} // namespace kudu
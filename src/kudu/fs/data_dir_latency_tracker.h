@@ -0,0 +1,132 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_FS_DATA_DIR_LATENCY_TRACKER_H
+#define KUDU_FS_DATA_DIR_LATENCY_TRACKER_H
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+
+namespace kudu {
+
+template<class T>
+class AtomicGauge;
+class HdrHistogram;
+class Histogram;
+class MetricEntity;
+
+namespace fs {
+
+// Tracks the latency of the reads, writes and syncs of a block manager in
+// each of its data directories, and marks directories which are persistently
+// slow as degraded.
+//
+// The I/O of each directory is looked at in windows of
+// --fs_data_dir_latency_window_ms. A directory whose average I/O latency
+// exceeds --fs_data_dir_slow_latency_ms for --fs_data_dir_slow_windows
+// windows in a row is degraded; it recovers after as many windows in a row
+// below the threshold. Windows with too little I/O to judge are skipped.
+//
+// This class is thread-safe.
+class DataDirLatencyTracker {
+ public:
+  enum IOType {
+    READ,
+    WRITE,
+    SYNC,
+  };
+
+  // 'metric_entity' may be NULL, in which case no metrics are produced.
+  explicit DataDirLatencyTracker(const scoped_refptr<MetricEntity>& metric_entity);
+  ~DataDirLatencyTracker();
+
+  // Records an I/O of 'type' to the data directory 'root_path' which took
+  // 'latency' and completed at 'now'.
+  void RecordLatency(const std::string& root_path, IOType type,
+                     const MonoDelta& latency, MonoTime now = MonoTime::Now());
+
+  // Returns whether 'root_path' is degraded.
+  bool IsDegraded(const std::string& root_path) const;
+
+  // Sets 'root_paths' to the degraded data directories.
+  void GetDegradedRootPaths(std::vector<std::string>* root_paths) const;
+
+  // Returns the latency in microseconds under which 'percentile' percent of
+  // the I/O of 'type' to 'root_path' completed, or 0 if there was none.
+  int64_t LatencyPercentileMicros(const std::string& root_path, IOType type,
+                                  double percentile) const;
+
+ private:
+  struct DirState;
+
+  // Judges the window of 'dir' which ended at 'now', and starts the next one.
+  void EndWindowUnlocked(const std::string& root_path, DirState* dir, MonoTime now);
+
+  mutable simple_spinlock lock_;
+
+  // The state of each directory with recorded I/O. Protected by 'lock_'.
+  std::unordered_map<std::string, std::unique_ptr<DirState>> dirs_;
+
+  // The number of degraded directories. Protected by 'lock_'.
+  uint32_t num_degraded_;
+
+  scoped_refptr<Histogram> read_latency_;
+  scoped_refptr<Histogram> write_latency_;
+  scoped_refptr<Histogram> sync_latency_;
+  scoped_refptr<AtomicGauge<uint32_t>> degraded_gauge_;
+
+  DISALLOW_COPY_AND_ASSIGN(DataDirLatencyTracker);
+};
+
+// Records the latency of an I/O to a data directory when it goes out of
+// scope.
+class ScopedDataDirLatency {
+ public:
+  ScopedDataDirLatency(DataDirLatencyTracker* tracker, const std::string& root_path,
+                       DataDirLatencyTracker::IOType type)
+    : tracker_(tracker),
+      root_path_(root_path),
+      type_(type),
+      start_(MonoTime::Now()) {
+  }
+
+  ~ScopedDataDirLatency() {
+    MonoTime now = MonoTime::Now();
+    tracker_->RecordLatency(root_path_, type_, now - start_, now);
+  }
+
+ private:
+  DataDirLatencyTracker* const tracker_;
+  const std::string& root_path_;
+  const DataDirLatencyTracker::IOType type_;
+  const MonoTime start_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedDataDirLatency);
+};
+
+} // namespace fs
+} // namespace kudu
+
+#endif // KUDU_FS_DATA_DIR_LATENCY_TRACKER_H
@@ -17,20 +17,27 @@
 
 #include "kudu/fs/file_block_manager.h"
 
+#include <algorithm>
 #include <deque>
+#include <limits>
 #include <string>
+#include <sys/resource.h>
 #include <unordered_set>
 #include <vector>
 
 #include "kudu/fs/block_manager_metrics.h"
 #include "kudu/fs/block_manager_util.h"
 #include "kudu/fs/fs.pb.h"
+#include "kudu/gutil/bind.h"
+#include "kudu/gutil/casts.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/atomic.h"
 #include "kudu/util/env.h"
 #include "kudu/util/env_util.h"
+#include "kudu/util/file_cache.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/malloc.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
@@ -49,9 +56,34 @@ using strings::Substitute;
 DECLARE_bool(enable_data_block_fsync);
 DECLARE_bool(block_manager_lock_dirs);
 
+DEFINE_int32(block_manager_max_open_files, -1,
+             "Maximum number of block files the file block manager keeps open for "
+             "reading at once. Readers of other blocks reopen their files as needed. "
+             "If -1, 40% of the process's limit on open files is used.");
+TAG_FLAG(block_manager_max_open_files, advanced);
+
 namespace kudu {
 namespace fs {
 
+namespace {
+
+// Returns the number of block files to keep open, per
+// --block_manager_max_open_files.
+int GetMaxOpenFiles() {
+  if (FLAGS_block_manager_max_open_files > 0) {
+    return FLAGS_block_manager_max_open_files;
+  }
+  struct rlimit lim;
+  PCHECK(getrlimit(RLIMIT_NOFILE, &lim) == 0);
+  if (lim.rlim_cur == RLIM_INFINITY) {
+    return std::numeric_limits<int>::max();
+  }
+  return std::max<int64_t>(1, std::min<int64_t>(lim.rlim_cur * 2 / 5,
+                                                std::numeric_limits<int>::max()));
+}
+
+} // anonymous namespace
+
 namespace internal {
 
 ////////////////////////////////////////////////////////////
@@ -213,7 +245,7 @@ void FileBlockLocation::GetAllParentDirs(vector<string>* parent_dirs) const {
 class FileWritableBlock : public WritableBlock {
  public:
   FileWritableBlock(FileBlockManager* block_manager, FileBlockLocation location,
-                    shared_ptr<WritableFile> writer);
+                    shared_ptr<WritableFile> writer, bool background);
 
   virtual ~FileWritableBlock();
 
@@ -233,7 +265,6 @@ class FileWritableBlock : public WritableBlock {
 
   virtual State state() const OVERRIDE;
 
- private:
   enum SyncMode {
     SYNC,
     NO_SYNC
@@ -242,6 +273,12 @@ class FileWritableBlock : public WritableBlock {
   // Close the block, optionally synchronizing dirty data and metadata.
   Status Close(SyncMode mode);
 
+  // Synchronize the block's data with the disk, but not its metadata.
+  Status SyncData();
+
+  const FileBlockLocation& location() const { return location_; }
+
+ private:
   // Back pointer to the block manager.
   //
   // Should remain alive for the lifetime of this block.
@@ -253,6 +290,9 @@ class FileWritableBlock : public WritableBlock {
   // The underlying opened file backing this block.
   shared_ptr<WritableFile> writer_;
 
+  // Whether appends are rate limited by the block manager's IOThrottler.
+  const bool background_;
+
   State state_;
 
   // The number of bytes successfully appended to the block.
@@ -263,10 +303,12 @@ class FileWritableBlock : public WritableBlock {
 
 FileWritableBlock::FileWritableBlock(FileBlockManager* block_manager,
                                      FileBlockLocation location,
-                                     shared_ptr<WritableFile> writer)
+                                     shared_ptr<WritableFile> writer,
+                                     bool background)
     : block_manager_(block_manager),
       location_(std::move(location)),
       writer_(std::move(writer)),
+      background_(background),
       state_(CLEAN),
       bytes_appended_(0) {
   if (block_manager_->metrics_) {
@@ -303,7 +345,14 @@ Status FileWritableBlock::Append(const Slice& data) {
   DCHECK(state_ == CLEAN || state_ == DIRTY)
       << "Invalid state: " << state_;
 
-  RETURN_NOT_OK(writer_->Append(data));
+  if (background_) {
+    block_manager_->io_throttler_.Throttle(location_.root_path(), data.size());
+  }
+  {
+    ScopedDataDirLatency latency(&block_manager_->latency_tracker_, location_.root_path(),
+                                 DataDirLatencyTracker::WRITE);
+    RETURN_NOT_OK(writer_->Append(data));
+  }
   state_ = DIRTY;
   bytes_appended_ += data.size();
   return Status::OK();
@@ -329,6 +378,15 @@ WritableBlock::State FileWritableBlock::state() const {
   return state_;
 }
 
+Status FileWritableBlock::SyncData() {
+  if (FLAGS_enable_data_block_fsync) {
+    ScopedDataDirLatency latency(&block_manager_->latency_tracker_, location_.root_path(),
+                                 DataDirLatencyTracker::SYNC);
+    return writer_->Sync();
+  }
+  return Status::OK();
+}
+
 Status FileWritableBlock::Close(SyncMode mode) {
   if (state_ == CLOSED) {
     return Status::OK();
@@ -339,9 +397,7 @@ Status FileWritableBlock::Close(SyncMode mode) {
       (state_ == CLEAN || state_ == DIRTY || state_ == FLUSHING)) {
     // Safer to synchronize data first, then metadata.
     VLOG(3) << "Syncing block " << id();
-    if (FLAGS_enable_data_block_fsync) {
-      sync = writer_->Sync();
-    }
+    sync = SyncData();
     if (sync.ok()) {
       sync = block_manager_->SyncMetadata(location_);
     }
@@ -448,7 +504,15 @@ Status FileReadableBlock::Read(uint64_t offset, size_t length,
                                Slice* result, uint8_t* scratch) const {
   DCHECK(!closed_.Load());
 
-  RETURN_NOT_OK(env_util::ReadFully(reader_.get(), offset, length, result, scratch));
+  {
+    const PathInstanceMetadataFile* root = FindPtrOrNull(
+        block_manager_->root_paths_by_idx_,
+        internal::FileBlockLocation::GetRootPathIdx(block_id_));
+    DCHECK(root);
+    ScopedDataDirLatency latency(&block_manager_->latency_tracker_, root->path(),
+                                 DataDirLatencyTracker::READ);
+    RETURN_NOT_OK(env_util::ReadFully(reader_.get(), offset, length, result, scratch));
+  }
   if (block_manager_->metrics_) {
     block_manager_->metrics_->total_bytes_read->IncrementBy(length);
   }
@@ -473,25 +537,30 @@ static const int kMaxPaths = (1 << 16) - 1;
 Status FileBlockManager::SyncMetadata(const internal::FileBlockLocation& location) {
   vector<string> parent_dirs;
   location.GetAllParentDirs(&parent_dirs);
+  return SyncDirtyDirs(parent_dirs);
+}
 
+Status FileBlockManager::SyncDirtyDirs(const vector<string>& dirs) {
   // Figure out what directories to sync.
   vector<string> to_sync;
   {
     std::lock_guard<simple_spinlock> l(lock_);
-    for (const string& parent_dir : parent_dirs) {
-      if (dirty_dirs_.erase(parent_dir)) {
-        to_sync.push_back(parent_dir);
+    for (const string& dir : dirs) {
+      if (dirty_dirs_.erase(dir)) {
+        to_sync.push_back(dir);
       }
     }
   }
 
   // Sync them.
-  if (FLAGS_enable_data_block_fsync) {
-    for (const string& s : to_sync) {
-      RETURN_NOT_OK(env_->SyncDir(s));
-    }
+  if (!FLAGS_enable_data_block_fsync) {
+    return Status::OK();
   }
-  return Status::OK();
+  vector<StatusClosure> syncs;
+  for (const string& dir : to_sync) {
+    syncs.push_back(Bind(&Env::SyncDir, Unretained(env_), dir));
+  }
+  return SyncConcurrently(syncs);
 }
 
 bool FileBlockManager::FindBlockPath(const BlockId& block_id,
@@ -508,12 +577,16 @@ bool FileBlockManager::FindBlockPath(const BlockId& block_id,
 FileBlockManager::FileBlockManager(Env* env, const BlockManagerOptions& opts)
   : env_(DCHECK_NOTNULL(env)),
     read_only_(opts.read_only),
+    direct_reads_(opts.direct_reads),
     root_paths_(opts.root_paths),
     rand_(GetRandomSeed32()),
     next_block_id_(rand_.Next64()),
     mem_tracker_(MemTracker::CreateTracker(-1,
                                            "file_block_manager",
-                                           opts.parent_mem_tracker)) {
+                                           opts.parent_mem_tracker)),
+    io_throttler_(opts.metric_entity),
+    latency_tracker_(opts.metric_entity),
+    file_cache_(env_, GetMaxOpenFiles(), opts.metric_entity) {
   DCHECK_GT(root_paths_.size(), 0);
   if (opts.metric_entity) {
     metrics_.reset(new internal::BlockManagerMetrics(opts.metric_entity));
@@ -646,16 +719,41 @@ Status FileBlockManager::CreateBlock(const CreateBlockOptions& opts,
                                      gscoped_ptr<WritableBlock>* block) {
   CHECK(!read_only_);
 
-  // Pick a root path using a simple round-robin block placement strategy.
+  // Pick a root path using a simple round-robin block placement strategy,
+  // preferring those in 'opts.root_paths' which aren't degraded, then any
+  // which isn't degraded, then any at all.
+  vector<string> degraded;
+  latency_tracker_.GetDegradedRootPaths(&degraded);
   uint16_t root_path_idx;
   string root_path;
   {
     std::lock_guard<simple_spinlock> l(lock_);
-    root_path_idx = next_root_path_->first;
-    root_path = next_root_path_->second->path();
-    next_root_path_++;
-    if (next_root_path_ == root_paths_by_idx_.end()) {
-      next_root_path_ = root_paths_by_idx_.begin();
+    int best_rank = -1;
+    PathMap::iterator it = next_root_path_;
+    for (int i = 0; i < root_paths_by_idx_.size(); i++) {
+      const string& path = it->second->path();
+      int rank = 0;
+      if (std::find(degraded.begin(), degraded.end(), path) == degraded.end()) {
+        rank++;
+        if (opts.root_paths.empty() ||
+            std::find(opts.root_paths.begin(), opts.root_paths.end(), path) !=
+                opts.root_paths.end()) {
+          rank++;
+        }
+      }
+      PathMap::iterator cur = it++;
+      if (it == root_paths_by_idx_.end()) {
+        it = root_paths_by_idx_.begin();
+      }
+      if (rank > best_rank) {
+        best_rank = rank;
+        root_path_idx = cur->first;
+        root_path = path;
+        next_root_path_ = it;
+      }
+      if (rank == 2) {
+        break;
+      }
     }
   }
 
@@ -703,7 +801,7 @@ Status FileBlockManager::CreateBlock(const CreateBlockOptions& opts,
       }
       dirty_dirs_.insert(DirName(path));
     }
-    block->reset(new internal::FileWritableBlock(this, location, writer));
+    block->reset(new internal::FileWritableBlock(this, location, writer, opts.background));
   }
   return s;
 }
@@ -712,6 +810,10 @@ Status FileBlockManager::CreateBlock(gscoped_ptr<WritableBlock>* block) {
   return CreateBlock(CreateBlockOptions(), block);
 }
 
+void FileBlockManager::GetDegradedRootPaths(vector<string>* root_paths) const {
+  latency_tracker_.GetDegradedRootPaths(root_paths);
+}
+
 Status FileBlockManager::OpenBlock(const BlockId& block_id,
                                    gscoped_ptr<ReadableBlock>* block) {
   string path;
@@ -723,7 +825,9 @@ Status FileBlockManager::OpenBlock(const BlockId& block_id,
   VLOG(1) << "Opening block with id " << block_id.ToString() << " at " << path;
 
   shared_ptr<RandomAccessFile> reader;
-  RETURN_NOT_OK(env_util::OpenFileForRandom(env_, path, &reader));
+  RandomAccessFileOptions opts;
+  opts.direct_io = direct_reads_;
+  RETURN_NOT_OK(file_cache_.OpenExistingFile(path, opts, &reader));
   block->reset(new internal::FileReadableBlock(this, block_id, reader));
   return Status::OK();
 }
@@ -736,7 +840,8 @@ Status FileBlockManager::DeleteBlock(const BlockId& block_id) {
     return Status::NotFound(
         Substitute("Block $0 not found", block_id.ToString()));
   }
-  RETURN_NOT_OK(env_->DeleteFile(path));
+  // Blocks still open for reading keep their file until they're closed.
+  RETURN_NOT_OK(file_cache_.DeleteFile(path));
 
   // We don't bother fsyncing the parent directory as there's nothing to be
   // gained by ensuring that the deletion is made durable. Even if we did
@@ -752,18 +857,67 @@ Status FileBlockManager::DeleteBlock(const BlockId& block_id) {
 
 Status FileBlockManager::CloseBlocks(const vector<WritableBlock*>& blocks) {
   VLOG(3) << "Closing " << blocks.size() << " blocks";
-  if (FLAGS_block_coalesce_close) {
-    // Ask the kernel to begin writing out each block's dirty data. This is
-    // done up-front to give the kernel opportunities to coalesce contiguous
-    // dirty pages.
+  if (!FLAGS_block_coalesce_close) {
     for (WritableBlock* block : blocks) {
-      RETURN_NOT_OK(block->FlushDataAsync());
+      RETURN_NOT_OK(block->Close());
     }
+    return Status::OK();
   }
 
-  // Now close each block, waiting for each to become durable.
+  // Close the group in phases:
+  // 1. Ask the kernel to begin writing out every block's dirty data, giving
+  //    it opportunities to coalesce contiguous dirty pages.
+  // 2. Sync every block's file, concurrently.
+  // 3. Sync the dirty parent directories of all of the blocks, each once.
+  // 4. Close every block.
+  vector<internal::FileWritableBlock*> group;
   for (WritableBlock* block : blocks) {
-    RETURN_NOT_OK(block->Close());
+    internal::FileWritableBlock* fwb = down_cast<internal::FileWritableBlock*>(block);
+    if (fwb->state() != WritableBlock::CLOSED) {
+      group.push_back(fwb);
+    }
+  }
+  if (group.empty()) {
+    return Status::OK();
+  }
+
+  MonoTime start = MonoTime::Now();
+  for (internal::FileWritableBlock* block : group) {
+    RETURN_NOT_OK(block->FlushDataAsync());
+  }
+  MonoTime flushed = MonoTime::Now();
+
+  vector<StatusClosure> syncs;
+  for (internal::FileWritableBlock* block : group) {
+    syncs.push_back(Bind(&internal::FileWritableBlock::SyncData, Unretained(block)));
+  }
+  RETURN_NOT_OK(SyncConcurrently(syncs));
+  MonoTime data_synced = MonoTime::Now();
+
+  vector<string> dirs;
+  unordered_set<string> seen;
+  for (internal::FileWritableBlock* block : group) {
+    vector<string> parent_dirs;
+    block->location().GetAllParentDirs(&parent_dirs);
+    for (string& dir : parent_dirs) {
+      if (InsertIfNotPresent(&seen, dir)) {
+        dirs.emplace_back(std::move(dir));
+      }
+    }
+  }
+  RETURN_NOT_OK(SyncDirtyDirs(dirs));
+  MonoTime metadata_synced = MonoTime::Now();
+
+  if (metrics_) {
+    metrics_->group_close_flush_time_us->Increment((flushed - start).ToMicroseconds());
+    metrics_->group_close_data_sync_time_us->Increment(
+        (data_synced - flushed).ToMicroseconds());
+    metrics_->group_close_metadata_sync_time_us->Increment(
+        (metadata_synced - data_synced).ToMicroseconds());
+  }
+
+  for (internal::FileWritableBlock* block : group) {
+    RETURN_NOT_OK(block->Close(internal::FileWritableBlock::NO_SYNC));
   }
   return Status::OK();
 }
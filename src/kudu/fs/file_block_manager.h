@@ -26,7 +26,10 @@
 
 #include "kudu/fs/block_id.h"
 #include "kudu/fs/block_manager.h"
+#include "kudu/fs/data_dir_latency_tracker.h"
+#include "kudu/fs/io_throttler.h"
 #include "kudu/util/atomic.h"
+#include "kudu/util/file_cache.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/random.h"
 
@@ -92,6 +95,11 @@ class FileBlockManager : public BlockManager {
 
   virtual Status CloseBlocks(const std::vector<WritableBlock*>& blocks) OVERRIDE;
 
+  virtual void GetDegradedRootPaths(std::vector<std::string>* root_paths) const OVERRIDE;
+
+  // Tracks the I/O latency of each root path.
+  DataDirLatencyTracker* latency_tracker() { return &latency_tracker_; }
+
  private:
   friend class internal::FileBlockLocation;
   friend class internal::FileReadableBlock;
@@ -100,6 +108,9 @@ class FileBlockManager : public BlockManager {
   // Synchronizes the metadata for a block with the given id.
   Status SyncMetadata(const internal::FileBlockLocation& block_id);
 
+  // Synchronizes those of 'dirs' which are dirty, concurrently.
+  Status SyncDirtyDirs(const std::vector<std::string>& dirs);
+
   // Looks up the path of the file backing a particular block ID.
   //
   // On success, overwrites 'path' with the file's path.
@@ -114,6 +125,9 @@ class FileBlockManager : public BlockManager {
   // If true, only read operations are allowed.
   const bool read_only_;
 
+  // If true, blocks are read with direct I/O.
+  const bool direct_reads_;
+
   // Filesystem paths where all block directories are found.
   const std::vector<std::string> root_paths_;
 
@@ -146,6 +160,16 @@ class FileBlockManager : public BlockManager {
   // interesting.
   std::shared_ptr<MemTracker> mem_tracker_;
 
+  // Rate limits appends to background blocks.
+  IOThrottler io_throttler_;
+
+  // Tracks the I/O latency of each root path, to avoid the degraded ones.
+  mutable DataDirLatencyTracker latency_tracker_;
+
+  // Bounds the number of block files open for reading. Readable blocks hold
+  // descriptors from it rather than open files.
+  FileCache file_cache_;
+
   DISALLOW_COPY_AND_ASSIGN(FileBlockManager);
 };
 
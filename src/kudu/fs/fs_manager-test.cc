@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <glog/stl_logging.h>
 #include <gtest/gtest.h>
@@ -25,9 +26,13 @@
 #include "kudu/gutil/strings/util.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/oid_generator.h"
+#include "kudu/util/path_util.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_int32(fs_target_data_dirs_per_tablet);
+
+using std::map;
 using std::shared_ptr;
 using strings::Substitute;
 
@@ -48,12 +53,14 @@ class FsManagerTestBase : public KuduTest {
     ReinitFsManager(GetTestPath("fs_root"), { GetTestPath("fs_root")} );
   }
 
-  void ReinitFsManager(const string& wal_path, const vector<string>& data_paths) {
+  void ReinitFsManager(const string& wal_path, const vector<string>& data_paths,
+                       const vector<string>& extra_wal_paths = {}) {
     // Blow away the old memtrackers first.
     fs_manager_.reset();
 
     FsManagerOpts opts;
     opts.wal_path = wal_path;
+    opts.extra_wal_paths = extra_wal_paths;
     opts.data_paths = data_paths;
     fs_manager_.reset(new FsManager(env_.get(), opts));
   }
@@ -178,6 +185,112 @@ TEST_F(FsManagerTestBase, TestOnlyWALPath) {
   ASSERT_TRUE(HasPrefixString(data_dirs[0], path));
 }
 
+TEST_F(FsManagerTestBase, TestMultipleWALPaths) {
+  vector<string> wal_paths = { GetTestPath("wal-a"), GetTestPath("wal-b"), GetTestPath("wal-c") };
+  ReinitFsManager(wal_paths[0], { GetTestPath("data") }, { wal_paths[1], wal_paths[2] });
+  ASSERT_OK(fs_manager()->CreateInitialFileSystemLayout());
+  ASSERT_OK(fs_manager()->Open());
+
+  vector<string> wal_dirs = fs_manager()->GetWalsRootDirs();
+  ASSERT_EQ(3, wal_dirs.size());
+  ASSERT_EQ(fs_manager()->GetWalsRootDir(), wal_dirs[0]);
+  for (const string& dir : wal_dirs) {
+    ASSERT_TRUE(env_->FileExists(dir)) << dir;
+  }
+
+  // Tablets without an assignment use the first WAL root.
+  ASSERT_TRUE(HasPrefixString(fs_manager()->GetTabletWalDir("unassigned"), wal_dirs[0]));
+
+  // New tablets are spread evenly over the WAL roots.
+  map<string, int> tablets_by_root;
+  for (int i = 0; i < 6; i++) {
+    string tablet_id = Substitute("tablet-$0", i);
+    string wal_root;
+    fs_manager()->AssignTabletWalRoot(tablet_id, &wal_root);
+    ASSERT_EQ(wal_root, fs_manager()->GetTabletWalRoot(tablet_id));
+    ASSERT_TRUE(HasPrefixString(fs_manager()->GetTabletWalDir(tablet_id), wal_root));
+    tablets_by_root[wal_root]++;
+  }
+  ASSERT_EQ(3, tablets_by_root.size());
+  for (const auto& e : tablets_by_root) {
+    ASSERT_EQ(2, e.second) << e.first;
+  }
+
+  // Assignments may only be registered against configured WAL roots.
+  string wal_root = fs_manager()->GetTabletWalRoot("tablet-0");
+  ASSERT_OK(fs_manager()->RegisterTabletWalRoot("tablet-6", wal_root));
+  ASSERT_EQ(wal_root, fs_manager()->GetTabletWalRoot("tablet-6"));
+  Status s = fs_manager()->RegisterTabletWalRoot("tablet-7", GetTestPath("elsewhere"));
+  ASSERT_TRUE(s.IsNotFound()) << s.ToString();
+
+  fs_manager()->UnregisterTabletWalRoot("tablet-6");
+  ASSERT_TRUE(HasPrefixString(fs_manager()->GetTabletWalDir("tablet-6"), wal_dirs[0]));
+}
+
+TEST_F(FsManagerTestBase, TestTabletDataDirs) {
+  FLAGS_fs_target_data_dirs_per_tablet = 1;
+  vector<string> data_paths = { GetTestPath("data-a"), GetTestPath("data-b"),
+                                GetTestPath("data-c") };
+  ReinitFsManager(data_paths[0], data_paths);
+  ASSERT_OK(fs_manager()->CreateInitialFileSystemLayout());
+  ASSERT_OK(fs_manager()->Open());
+
+  // New tablets are spread evenly over the data roots.
+  map<string, int> tablets_by_root;
+  for (int i = 0; i < 6; i++) {
+    vector<string> data_dirs;
+    fs_manager()->AssignTabletDataDirs(Substitute("tablet-$0", i), &data_dirs);
+    ASSERT_EQ(1, data_dirs.size());
+    tablets_by_root[data_dirs[0]]++;
+  }
+  ASSERT_EQ(3, tablets_by_root.size());
+  for (const auto& e : tablets_by_root) {
+    ASSERT_EQ(2, e.second) << e.first;
+  }
+
+  // The blocks of a tablet are placed in its data dirs.
+  vector<string> data_dirs;
+  fs_manager()->AssignTabletDataDirs("tablet-6", &data_dirs);
+  ASSERT_EQ(1, data_dirs.size());
+  map<string, int> children_by_root;
+  for (const auto& e : tablets_by_root) {
+    vector<string> children;
+    ASSERT_OK(env_->GetChildren(JoinPathSegments(e.first, "data"),
+                                &children));
+    children_by_root[e.first] = children.size();
+  }
+  for (int i = 0; i < 3; i++) {
+    gscoped_ptr<fs::WritableBlock> block;
+    ASSERT_OK(fs_manager()->CreateNewBlock(fs::CreateBlockOptions::Background("tablet-6"),
+                                           &block));
+    ASSERT_OK(block->Append("data"));
+    ASSERT_OK(block->Close());
+  }
+  for (const auto& e : children_by_root) {
+    vector<string> children;
+    ASSERT_OK(env_->GetChildren(JoinPathSegments(e.first, "data"),
+                                &children));
+    if (e.first == data_dirs[0]) {
+      ASSERT_GT(children.size(), e.second) << e.first;
+    } else {
+      ASSERT_EQ(e.second, children.size()) << e.first;
+    }
+  }
+
+  // Registered data dirs which aren't configured are skipped, and tablets
+  // without data dirs use all of them.
+  fs_manager()->RegisterTabletDataDirs("tablet-7", { GetTestPath("elsewhere") });
+  gscoped_ptr<fs::WritableBlock> block;
+  ASSERT_OK(fs_manager()->CreateNewBlock(fs::CreateBlockOptions::Background("tablet-7"),
+                                         &block));
+  ASSERT_OK(block->Close());
+
+  // With as many target dirs as there are data roots, tablets use all of them.
+  FLAGS_fs_target_data_dirs_per_tablet = 3;
+  fs_manager()->AssignTabletDataDirs("tablet-8", &data_dirs);
+  ASSERT_TRUE(data_dirs.empty());
+}
+
 TEST_F(FsManagerTestBase, TestFormatWithSpecificUUID) {
   string path = GetTestPath("new_fs_root");
   ReinitFsManager(path, {});
@@ -17,9 +17,11 @@
 
 #include "kudu/fs/fs_manager.h"
 
+#include <algorithm>
 #include <deque>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <unordered_set>
 
 #include <boost/optional.hpp>
@@ -35,6 +37,7 @@
 #include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/strcat.h"
 #include "kudu/gutil/strings/strip.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/strings/util.h"
@@ -71,6 +74,19 @@ DEFINE_string(fs_data_dirs, "",
               "is not specified, fs_wal_dir will be used as the sole data "
               "block directory.");
 TAG_FLAG(fs_data_dirs, stable);
+DEFINE_string(fs_extra_wal_dirs, "",
+              "Comma-separated list of additional directories with write-ahead "
+              "logs. The write-ahead log of each new tablet is placed in "
+              "whichever of fs_wal_dir and these directories hosts the fewest "
+              "tablets, which spreads log writes and fsyncs across devices.");
+TAG_FLAG(fs_extra_wal_dirs, experimental);
+DEFINE_int32(fs_target_data_dirs_per_tablet, 3,
+             "Number of data directories the blocks of each new tablet are placed "
+             "in, chosen among those hosting the fewest tablets and then with the "
+             "most free space. Confines each tablet's scans to fewer disks, and "
+             "the tablets affected by a disk to fewer tablets. If 0 or at least "
+             "the number of data directories, tablets use all of them.");
+TAG_FLAG(fs_target_data_dirs_per_tablet, experimental);
 
 using google::protobuf::Message;
 using kudu::env_util::ScopedFileDeleter;
@@ -93,6 +109,8 @@ const char *FsManager::kWalDirName = "wals";
 const char *FsManager::kWalFileNamePrefix = "wal";
 const char *FsManager::kWalsRecoveryDirSuffix = ".recovery";
 const char *FsManager::kTabletMetadataDirName = "tablet-meta";
+const char *FsManager::kTabletMetadataLogSuffix = ".log";
+const char *FsManager::kTabletHotBlocksSuffix = ".hot-blocks";
 const char *FsManager::kDataDirName = "data";
 const char *FsManager::kCorruptedSuffix = ".corrupted";
 const char *FsManager::kInstanceMetadataFileName = "instance";
@@ -102,7 +120,9 @@ static const char* const kTmpInfix = ".tmp";
 
 FsManagerOpts::FsManagerOpts()
   : wal_path(FLAGS_fs_wal_dir),
-    read_only(false) {
+    read_only(false),
+    direct_reads(false) {
+  extra_wal_paths = strings::Split(FLAGS_fs_extra_wal_dirs, ",", strings::SkipEmpty());
   data_paths = strings::Split(FLAGS_fs_data_dirs, ",", strings::SkipEmpty());
 }
 
@@ -112,6 +132,7 @@ FsManagerOpts::~FsManagerOpts() {
 FsManager::FsManager(Env* env, const string& root_path)
   : env_(DCHECK_NOTNULL(env)),
     read_only_(false),
+    direct_reads_(false),
     wal_fs_root_(root_path),
     data_fs_roots_({ root_path }),
     metric_entity_(nullptr),
@@ -122,7 +143,9 @@ FsManager::FsManager(Env* env,
                      const FsManagerOpts& opts)
   : env_(DCHECK_NOTNULL(env)),
     read_only_(opts.read_only),
+    direct_reads_(opts.direct_reads),
     wal_fs_root_(opts.wal_path),
+    extra_wal_fs_roots_(opts.extra_wal_paths),
     data_fs_roots_(opts.data_paths),
     metric_entity_(opts.metric_entity),
     parent_mem_tracker_(opts.parent_mem_tracker),
@@ -145,6 +168,9 @@ Status FsManager::Init() {
   // Deduplicate all of the roots.
   set<string> all_roots;
   all_roots.insert(wal_fs_root_);
+  for (const string& wal_fs_root : extra_wal_fs_roots_) {
+    all_roots.insert(wal_fs_root);
+  }
   for (const string& data_fs_root : data_fs_roots_) {
     all_roots.insert(data_fs_root);
   }
@@ -180,6 +206,14 @@ Status FsManager::Init() {
 
   // All done, use the map to set the canonicalized state.
   canonicalized_wal_fs_root_ = FindOrDie(canonicalized_roots, wal_fs_root_);
+  canonicalized_wal_fs_roots_ = { canonicalized_wal_fs_root_ };
+  for (const string& wal_fs_root : extra_wal_fs_roots_) {
+    const string& canonicalized = FindOrDie(canonicalized_roots, wal_fs_root);
+    if (std::find(canonicalized_wal_fs_roots_.begin(), canonicalized_wal_fs_roots_.end(),
+                  canonicalized) == canonicalized_wal_fs_roots_.end()) {
+      canonicalized_wal_fs_roots_.push_back(canonicalized);
+    }
+  }
   if (!data_fs_roots_.empty()) {
     canonicalized_metadata_fs_root_ = FindOrDie(canonicalized_roots, data_fs_roots_[0]);
     for (const string& data_fs_root : data_fs_roots_) {
@@ -196,7 +230,7 @@ Status FsManager::Init() {
   }
 
   if (VLOG_IS_ON(1)) {
-    VLOG(1) << "WAL root: " << canonicalized_wal_fs_root_;
+    VLOG(1) << "WAL roots: " << canonicalized_wal_fs_roots_;
     VLOG(1) << "Metadata root: " << canonicalized_metadata_fs_root_;
     VLOG(1) << "Data roots: " << canonicalized_data_fs_roots_;
     VLOG(1) << "All roots: " << canonicalized_all_fs_roots_;
@@ -215,6 +249,7 @@ void FsManager::InitBlockManager() {
   opts.parent_mem_tracker = parent_mem_tracker_;
   opts.root_paths = GetDataRootDirs();
   opts.read_only = read_only_;
+  opts.direct_reads = direct_reads_;
   if (FLAGS_block_manager == "file") {
     block_manager_.reset(new FileBlockManager(env_, opts));
   } else if (FLAGS_block_manager == "log") {
@@ -289,9 +324,9 @@ Status FsManager::CreateInitialFileSystemLayout(boost::optional<string> uuid) {
   }
 
   // Initialize ancillary directories.
-  vector<string> ancillary_dirs = { GetWalsRootDir(),
-                                    GetTabletMetadataDir(),
-                                    GetConsensusMetadataDir() };
+  vector<string> ancillary_dirs = GetWalsRootDirs();
+  ancillary_dirs.push_back(GetTabletMetadataDir());
+  ancillary_dirs.push_back(GetConsensusMetadataDir());
   for (const string& dir : ancillary_dirs) {
     bool created;
     RETURN_NOT_OK_PREPEND(CreateDirIfMissing(dir, &created),
@@ -388,6 +423,165 @@ vector<string> FsManager::GetDataRootDirs() const {
   return data_paths;
 }
 
+vector<string> FsManager::GetWalsRootDirs() const {
+  DCHECK(initted_);
+  vector<string> wal_dirs;
+  for (const string& wal_fs_root : canonicalized_wal_fs_roots_) {
+    wal_dirs.push_back(JoinPathSegments(wal_fs_root, kWalDirName));
+  }
+  return wal_dirs;
+}
+
+string FsManager::GetTabletWalRoot(const string& tablet_id) const {
+  DCHECK(initted_);
+  std::lock_guard<simple_spinlock> l(wal_roots_lock_);
+  const string* wal_root = FindOrNull(tablet_wal_roots_, tablet_id);
+  return wal_root ? *wal_root : canonicalized_wal_fs_root_;
+}
+
+void FsManager::AssignTabletWalRoot(const string& tablet_id, string* wal_root) {
+  DCHECK(initted_);
+  std::lock_guard<simple_spinlock> l(wal_roots_lock_);
+  map<string, int> tablets_by_root;
+  for (const string& root : canonicalized_wal_fs_roots_) {
+    tablets_by_root[root] = 0;
+  }
+  for (const auto& e : tablet_wal_roots_) {
+    if (e.first != tablet_id) {
+      tablets_by_root[e.second]++;
+    }
+  }
+  // Break ties in favor of the earlier roots.
+  const string* least_loaded = &canonicalized_wal_fs_roots_[0];
+  for (const string& root : canonicalized_wal_fs_roots_) {
+    if (tablets_by_root[root] < tablets_by_root[*least_loaded]) {
+      least_loaded = &root;
+    }
+  }
+  tablet_wal_roots_[tablet_id] = *least_loaded;
+  *wal_root = *least_loaded;
+}
+
+Status FsManager::RegisterTabletWalRoot(const string& tablet_id, const string& wal_root) {
+  DCHECK(initted_);
+  if (std::find(canonicalized_wal_fs_roots_.begin(), canonicalized_wal_fs_roots_.end(),
+                wal_root) == canonicalized_wal_fs_roots_.end()) {
+    return Status::NotFound(Substitute("WAL root $0 of tablet $1 is not configured",
+                                       wal_root, tablet_id),
+                            JoinStrings(canonicalized_wal_fs_roots_, ","));
+  }
+  std::lock_guard<simple_spinlock> l(wal_roots_lock_);
+  tablet_wal_roots_[tablet_id] = wal_root;
+  return Status::OK();
+}
+
+void FsManager::UnregisterTabletWalRoot(const string& tablet_id) {
+  std::lock_guard<simple_spinlock> l(wal_roots_lock_);
+  tablet_wal_roots_.erase(tablet_id);
+}
+
+void FsManager::AssignTabletDataDirs(const string& tablet_id, vector<string>* data_dirs) {
+  DCHECK(initted_);
+  data_dirs->clear();
+  int num_dirs = FLAGS_fs_target_data_dirs_per_tablet;
+  if (num_dirs <= 0 || num_dirs >= static_cast<int>(canonicalized_data_fs_roots_.size())) {
+    UnregisterTabletDataDirs(tablet_id);
+    return;
+  }
+
+  // Look up the free space before taking the lock.
+  map<string, int64_t> bytes_free_by_root;
+  for (const string& root : canonicalized_data_fs_roots_) {
+    int64_t bytes_free;
+    Status s = env_->GetBytesFree(root, &bytes_free);
+    if (!s.ok()) {
+      WARN_NOT_OK(s, "Could not get free space of data root " + root);
+      bytes_free = 0;
+    }
+    bytes_free_by_root[root] = bytes_free;
+  }
+
+  std::lock_guard<simple_spinlock> l(data_dirs_lock_);
+  map<string, int> tablets_by_root;
+  for (const string& root : canonicalized_data_fs_roots_) {
+    tablets_by_root[root] = 0;
+  }
+  for (const auto& e : tablet_data_dirs_) {
+    if (e.first == tablet_id) {
+      continue;
+    }
+    for (const string& root : e.second) {
+      tablets_by_root[root]++;
+    }
+  }
+  vector<string> roots(canonicalized_data_fs_roots_.begin(),
+                       canonicalized_data_fs_roots_.end());
+  std::stable_sort(roots.begin(), roots.end(), [&](const string& a, const string& b) {
+      if (tablets_by_root[a] != tablets_by_root[b]) {
+        return tablets_by_root[a] < tablets_by_root[b];
+      }
+      return bytes_free_by_root[a] > bytes_free_by_root[b];
+    });
+  data_dirs->assign(roots.begin(), roots.begin() + num_dirs);
+  std::sort(data_dirs->begin(), data_dirs->end());
+  tablet_data_dirs_[tablet_id] = *data_dirs;
+}
+
+void FsManager::RegisterTabletDataDirs(const string& tablet_id,
+                                       const vector<string>& data_dirs) {
+  DCHECK(initted_);
+  vector<string> known_dirs;
+  for (const string& dir : data_dirs) {
+    if (ContainsKey(canonicalized_data_fs_roots_, dir)) {
+      known_dirs.push_back(dir);
+    } else {
+      LOG(WARNING) << Substitute("Data root $0 of tablet $1 is not configured, "
+                                 "placing its new blocks elsewhere", dir, tablet_id);
+    }
+  }
+  std::lock_guard<simple_spinlock> l(data_dirs_lock_);
+  if (known_dirs.empty()) {
+    tablet_data_dirs_.erase(tablet_id);
+  } else {
+    tablet_data_dirs_[tablet_id] = std::move(known_dirs);
+  }
+}
+
+void FsManager::UnregisterTabletDataDirs(const string& tablet_id) {
+  std::lock_guard<simple_spinlock> l(data_dirs_lock_);
+  tablet_data_dirs_.erase(tablet_id);
+}
+
+void FsManager::GetDegradedDataRoots(vector<string>* data_roots) const {
+  DCHECK(initted_);
+  vector<string> root_paths;
+  block_manager_->GetDegradedRootPaths(&root_paths);
+  data_roots->clear();
+  for (const string& root_path : root_paths) {
+    data_roots->push_back(DirName(root_path));
+  }
+}
+
+bool FsManager::TabletHasDegradedDataRoot(const string& tablet_id) const {
+  vector<string> degraded;
+  GetDegradedDataRoots(&degraded);
+  if (degraded.empty()) {
+    return false;
+  }
+  std::lock_guard<simple_spinlock> l(data_dirs_lock_);
+  const vector<string>* data_dirs = FindOrNull(tablet_data_dirs_, tablet_id);
+  if (!data_dirs) {
+    // The tablet may use all data roots.
+    return true;
+  }
+  for (const string& root : degraded) {
+    if (std::find(data_dirs->begin(), data_dirs->end(), root) != data_dirs->end()) {
+      return true;
+    }
+  }
+  return false;
+}
+
 string FsManager::GetTabletMetadataDir() const {
   DCHECK(initted_);
   return JoinPathSegments(canonicalized_metadata_fs_root_, kTabletMetadataDirName);
@@ -397,6 +591,17 @@ string FsManager::GetTabletMetadataPath(const string& tablet_id) const {
   return JoinPathSegments(GetTabletMetadataDir(), tablet_id);
 }
 
+string FsManager::GetTabletMetadataLogPath(const string& tablet_id) const {
+  return StrCat(GetTabletMetadataPath(tablet_id), kTabletMetadataLogSuffix);
+}
+
+string FsManager::GetTabletHotBlocksPath(const string& tablet_id) const {
+  // Hidden, since versions which predate the file take anything else in the
+  // metadata dir for a tablet.
+  return JoinPathSegments(GetTabletMetadataDir(),
+                          StrCat(".", tablet_id, kTabletHotBlocksSuffix));
+}
+
 namespace {
 // Return true if 'fname' is a valid tablet ID.
 bool IsValidTabletId(const std::string& fname) {
@@ -411,6 +616,11 @@ bool IsValidTabletId(const std::string& fname) {
     return false;
   }
 
+  if (HasSuffixString(fname, FsManager::kTabletMetadataLogSuffix)) {
+    // The log of a tablet's superblock, not a superblock.
+    return false;
+  }
+
   return true;
 }
 } // anonymous namespace
@@ -436,7 +646,7 @@ string FsManager::GetInstanceMetadataPath(const string& root) const {
 }
 
 string FsManager::GetTabletWalRecoveryDir(const string& tablet_id) const {
-  string path = JoinPathSegments(GetWalsRootDir(), tablet_id);
+  string path = GetTabletWalDir(tablet_id);
   StrAppend(&path, kWalsRecoveryDirSuffix);
   return path;
 }
@@ -498,6 +708,27 @@ Status FsManager::CreateNewBlock(gscoped_ptr<WritableBlock>* block) {
   return block_manager_->CreateBlock(block);
 }
 
+Status FsManager::CreateNewBlock(const CreateBlockOptions& opts,
+                                 gscoped_ptr<WritableBlock>* block) {
+  CHECK(!read_only_);
+
+  if (opts.tablet_id.empty() || !opts.root_paths.empty()) {
+    return block_manager_->CreateBlock(opts, block);
+  }
+  // Place the block in its tablet's data dir group.
+  CreateBlockOptions placed_opts(opts);
+  {
+    std::lock_guard<simple_spinlock> l(data_dirs_lock_);
+    const vector<string>* data_dirs = FindOrNull(tablet_data_dirs_, opts.tablet_id);
+    if (data_dirs) {
+      for (const string& root : *data_dirs) {
+        placed_opts.root_paths.push_back(JoinPathSegments(root, kDataDirName));
+      }
+    }
+  }
+  return block_manager_->CreateBlock(placed_opts, block);
+}
+
 Status FsManager::OpenBlock(const BlockId& block_id, gscoped_ptr<ReadableBlock>* block) {
   return block_manager_->OpenBlock(block_id, block);
 }
@@ -25,11 +25,13 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/env.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/path_util.h"
 
 DECLARE_bool(enable_data_block_fsync);
@@ -49,6 +51,7 @@ namespace fs {
 class BlockManager;
 class ReadableBlock;
 class WritableBlock;
+struct CreateBlockOptions;
 } // namespace fs
 
 namespace itest {
@@ -75,11 +78,20 @@ struct FsManagerOpts {
   // The path where WALs will be stored. Cannot be empty.
   std::string wal_path;
 
+  // Additional paths where WALs may be stored. The WALs of each new tablet
+  // are placed under whichever of 'wal_path' and these paths hosts the
+  // fewest tablets.
+  std::vector<std::string> extra_wal_paths;
+
   // The paths where data blocks will be stored. Cannot be empty.
   std::vector<std::string> data_paths;
 
   // Whether or not read-write operations should be allowed. Defaults to false.
   bool read_only;
+
+  // Whether data blocks should be read with direct I/O, bypassing the page
+  // cache. Defaults to false.
+  bool direct_reads;
 };
 
 // FsManager provides helpers to read data and metadata files,
@@ -130,6 +142,8 @@ class FsManager {
   //
   // Block will be synced on close.
   Status CreateNewBlock(gscoped_ptr<fs::WritableBlock>* block);
+  Status CreateNewBlock(const fs::CreateBlockOptions& opts,
+                        gscoped_ptr<fs::WritableBlock>* block);
 
   Status OpenBlock(const BlockId& block_id,
                    gscoped_ptr<fs::ReadableBlock>* block);
@@ -143,13 +157,57 @@ class FsManager {
   // ==========================================================================
   std::vector<std::string> GetDataRootDirs() const;
 
+  // Return the WAL directory of the first WAL root.
   std::string GetWalsRootDir() const {
     DCHECK(initted_);
     return JoinPathSegments(canonicalized_wal_fs_root_, kWalDirName);
   }
 
+  // Return the WAL directories of all WAL roots, starting with GetWalsRootDir().
+  std::vector<std::string> GetWalsRootDirs() const;
+
+  // Return the WAL root hosting the WALs of tablet 'tablet_id'. Tablets which
+  // were never assigned a WAL root use the first one.
+  std::string GetTabletWalRoot(const std::string& tablet_id) const;
+
+  // Assign the WALs of the new tablet 'tablet_id' to the WAL root hosting the
+  // fewest tablets, and set 'wal_root' to that root.
+  void AssignTabletWalRoot(const std::string& tablet_id, std::string* wal_root);
+
+  // Record that the WALs of tablet 'tablet_id' are hosted by 'wal_root', as
+  // found in the tablet's metadata. Returns NotFound if 'wal_root' is not a
+  // WAL root of this filesystem.
+  Status RegisterTabletWalRoot(const std::string& tablet_id, const std::string& wal_root);
+
+  // Forget the WAL root assignment of tablet 'tablet_id', if there is one.
+  void UnregisterTabletWalRoot(const std::string& tablet_id);
+
+  // Assign the new tablet 'tablet_id' a group of
+  // --fs_target_data_dirs_per_tablet data roots, hosting the fewest tablets
+  // and then with the most free space, and set 'data_dirs' to them. The
+  // blocks created for the tablet are placed in them. Sets 'data_dirs' to
+  // be empty if the tablet may use all data roots.
+  void AssignTabletDataDirs(const std::string& tablet_id, std::vector<std::string>* data_dirs);
+
+  // Record that the blocks of tablet 'tablet_id' are placed in 'data_dirs',
+  // as found in the tablet's metadata. Data roots which are no longer
+  // configured are skipped.
+  void RegisterTabletDataDirs(const std::string& tablet_id,
+                              const std::vector<std::string>& data_dirs);
+
+  // Forget the data root assignment of tablet 'tablet_id', if there is one.
+  void UnregisterTabletDataDirs(const std::string& tablet_id);
+
+  // Sets 'data_roots' to the data roots whose I/O is persistently slow.
+  void GetDegradedDataRoots(std::vector<std::string>* data_roots) const;
+
+  // Returns whether the blocks of tablet 'tablet_id' may be placed in a
+  // degraded data root.
+  bool TabletHasDegradedDataRoot(const std::string& tablet_id) const;
+
   std::string GetTabletWalDir(const std::string& tablet_id) const {
-    return JoinPathSegments(GetWalsRootDir(), tablet_id);
+    return JoinPathSegments(JoinPathSegments(GetTabletWalRoot(tablet_id), kWalDirName),
+                            tablet_id);
   }
 
   std::string GetTabletWalRecoveryDir(const std::string& tablet_id) const;
@@ -163,6 +221,14 @@ class FsManager {
   // Return the path for a specific tablet's superblock.
   std::string GetTabletMetadataPath(const std::string& tablet_id) const;
 
+  // Return the path of the log of incremental updates to a specific tablet's
+  // superblock, beside the superblock.
+  std::string GetTabletMetadataLogPath(const std::string& tablet_id) const;
+
+  // Return the path of the hot blocks of a specific tablet, a hidden file
+  // beside its superblock. See HotBlocksPB.
+  std::string GetTabletHotBlocksPath(const std::string& tablet_id) const;
+
   // List the tablet IDs in the metadata directory.
   Status ListTabletIds(std::vector<std::string>* tablet_ids);
 
@@ -240,6 +306,8 @@ class FsManager {
 
   static const char *kDataDirName;
   static const char *kTabletMetadataDirName;
+  static const char *kTabletMetadataLogSuffix;
+  static const char *kTabletHotBlocksSuffix;
   static const char *kWalDirName;
   static const char *kCorruptedSuffix;
   static const char *kInstanceMetadataFileName;
@@ -252,21 +320,27 @@ class FsManager {
   // If false, operations that mutate on-disk state are prohibited.
   const bool read_only_;
 
+  // Whether data blocks are read with direct I/O.
+  const bool direct_reads_;
+
   // These roots are the constructor input verbatim. None of them are used
   // as-is; they are first canonicalized during Init().
   const std::string wal_fs_root_;
+  const std::vector<std::string> extra_wal_fs_roots_;
   const std::vector<std::string> data_fs_roots_;
 
   scoped_refptr<MetricEntity> metric_entity_;
 
   std::shared_ptr<MemTracker> parent_mem_tracker_;
 
-  // Canonicalized forms of 'wal_fs_root_ and 'data_fs_roots_'. Constructed
-  // during Init().
+  // Canonicalized forms of 'wal_fs_root_', 'extra_wal_fs_roots_' and
+  // 'data_fs_roots_'. Constructed during Init().
   //
   // - The first data root is used as the metadata root.
+  // - 'canonicalized_wal_fs_roots_' starts with 'canonicalized_wal_fs_root_'.
   // - Common roots in the collections have been deduplicated.
   std::string canonicalized_wal_fs_root_;
+  std::vector<std::string> canonicalized_wal_fs_roots_;
   std::string canonicalized_metadata_fs_root_;
   std::set<std::string> canonicalized_data_fs_roots_;
   std::set<std::string> canonicalized_all_fs_roots_;
@@ -275,6 +349,19 @@ class FsManager {
 
   gscoped_ptr<fs::BlockManager> block_manager_;
 
+  // Protects 'tablet_wal_roots_'.
+  mutable simple_spinlock wal_roots_lock_;
+
+  // The WAL root of each tablet whose metadata was created or loaded.
+  std::unordered_map<std::string, std::string> tablet_wal_roots_;
+
+  // Protects 'tablet_data_dirs_'.
+  mutable simple_spinlock data_dirs_lock_;
+
+  // The data roots of each tablet whose metadata was created or loaded,
+  // unless the tablet uses all of them.
+  std::unordered_map<std::string, std::vector<std::string>> tablet_data_dirs_;
+
   bool initted_;
 
   DISALLOW_COPY_AND_ASSIGN(FsManager);
@@ -0,0 +1,202 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/fs/io_throttler.h"
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <mutex>
+
+#include "kudu/gutil/map-util.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/throttler.h"
+
+DEFINE_int64(fs_background_write_bytes_per_sec, 0,
+             "Maximum rate (bytes/s) at which flushes and compactions may write "
+             "to each data directory. The actual budget backs off below this "
+             "when disk reads become slow. 0 means no limit.");
+TAG_FLAG(fs_background_write_bytes_per_sec, experimental);
+TAG_FLAG(fs_background_write_bytes_per_sec, runtime);
+
+DEFINE_int64(fs_background_write_min_bytes_per_sec, 1024 * 1024,
+             "The lowest rate (bytes/s) the background write budget of a data "
+             "directory backs off to when disk reads are slow.");
+TAG_FLAG(fs_background_write_min_bytes_per_sec, experimental);
+TAG_FLAG(fs_background_write_min_bytes_per_sec, runtime);
+
+DEFINE_int32(fs_background_write_read_latency_target_ms, 20,
+             "Average latency of block reads which miss the block cache above "
+             "which the background write budget is halved. 0 disables adapting "
+             "the budget to read latency.");
+TAG_FLAG(fs_background_write_read_latency_target_ms, experimental);
+TAG_FLAG(fs_background_write_read_latency_target_ms, runtime);
+
+METRIC_DEFINE_counter(server, block_manager_background_bytes_throttled,
+                      "Background Write Bytes Throttled",
+                      kudu::MetricUnit::kBytes,
+                      "Number of bytes written by flushes and compactions which "
+                      "had to wait for their data directory's I/O budget");
+
+METRIC_DEFINE_counter(server, block_manager_background_write_throttled_time_us,
+                      "Background Write Throttled Time",
+                      kudu::MetricUnit::kMicroseconds,
+                      "Time spent by flushes and compactions waiting for their "
+                      "data directory's I/O budget");
+
+METRIC_DEFINE_gauge_int64(server, block_manager_background_write_budget,
+                          "Background Write Budget",
+                          kudu::MetricUnit::kBytes,
+                          "Current number of bytes per second flushes and "
+                          "compactions may write to each data directory");
+
+namespace kudu {
+namespace fs {
+
+namespace {
+
+// How often the budget is adapted to the block read latency.
+const int64_t kAdjustPeriodMs = 1000;
+
+// Cumulative latency and count of block reads which went to disk, across all
+// block managers of the process.
+AtomicInt<int64_t> block_read_latency_us(0);
+AtomicInt<int64_t> block_read_count(0);
+
+} // anonymous namespace
+
+IOThrottler::IOThrottler(const scoped_refptr<MetricEntity>& metric_entity)
+    : budget_(0),
+      next_adjust_(MonoTime::Now()),
+      last_read_latency_us_(block_read_latency_us.Load()),
+      last_read_count_(block_read_count.Load()) {
+  if (metric_entity) {
+    bytes_throttled_ =
+        METRIC_block_manager_background_bytes_throttled.Instantiate(metric_entity);
+    time_throttled_us_ =
+        METRIC_block_manager_background_write_throttled_time_us.Instantiate(metric_entity);
+    budget_gauge_ =
+        METRIC_block_manager_background_write_budget.Instantiate(metric_entity, 0);
+  }
+}
+
+IOThrottler::~IOThrottler() {
+}
+
+void IOThrottler::RecordBlockReadLatency(const MonoDelta& latency) {
+  block_read_latency_us.IncrementBy(latency.ToMicroseconds());
+  block_read_count.Increment();
+}
+
+int64_t IOThrottler::budget_bytes_per_sec() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return budget_;
+}
+
+void IOThrottler::AdjustBudgetUnlocked(MonoTime now) {
+  DCHECK(lock_.is_locked());
+  next_adjust_ = now + MonoDelta::FromMilliseconds(kAdjustPeriodMs);
+
+  int64_t latency_us = block_read_latency_us.Load();
+  int64_t count = block_read_count.Load();
+  int64_t avg_latency_us = 0;
+  if (count > last_read_count_) {
+    avg_latency_us = (latency_us - last_read_latency_us_) / (count - last_read_count_);
+  }
+  last_read_latency_us_ = latency_us;
+  last_read_count_ = count;
+
+  const int64_t max_rate = FLAGS_fs_background_write_bytes_per_sec;
+  const int64_t min_rate = std::min(FLAGS_fs_background_write_min_bytes_per_sec, max_rate);
+  const int64_t target_us =
+      static_cast<int64_t>(FLAGS_fs_background_write_read_latency_target_ms) * 1000;
+  int64_t rate;
+  if (budget_ <= 0 || budget_ > max_rate) {
+    // First use, or the limit was lowered.
+    rate = max_rate;
+  } else if (target_us > 0 && avg_latency_us > target_us) {
+    rate = std::max(min_rate, budget_ / 2);
+  } else {
+    rate = std::min(max_rate, budget_ + std::max<int64_t>(max_rate / 10, 1));
+  }
+  if (rate != budget_) {
+    VLOG(1) << "Adjusting background write budget from " << budget_ << " to " << rate
+            << " bytes/s per data dir (average block read latency: "
+            << avg_latency_us << "us)";
+    budget_ = rate;
+    for (const auto& e : throttlers_) {
+      e.second->SetByteRate(budget_);
+    }
+    if (budget_gauge_) {
+      budget_gauge_->set_value(budget_);
+    }
+  }
+}
+
+Throttler* IOThrottler::GetThrottler(const std::string& data_dir, MonoTime now) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (now >= next_adjust_ || budget_ <= 0 ||
+      budget_ > FLAGS_fs_background_write_bytes_per_sec) {
+    AdjustBudgetUnlocked(now);
+  }
+  std::unique_ptr<Throttler>* t = FindOrNull(throttlers_, data_dir);
+  if (t) {
+    return t->get();
+  }
+  Throttler* ret = new Throttler(now, 0, budget_, 1.0);
+  throttlers_.emplace(data_dir, std::unique_ptr<Throttler>(ret));
+  return ret;
+}
+
+void IOThrottler::Throttle(const std::string& data_dir, uint64_t bytes) {
+  if (FLAGS_fs_background_write_bytes_per_sec <= 0) {
+    return;
+  }
+  MonoTime start = MonoTime::Now();
+  Throttler* throttler = GetThrottler(data_dir, start);
+
+  // A take can't exceed what the bucket holds after one refill period, so
+  // large appends are admitted in pieces.
+  const int64_t kPeriodsPerSecond =
+      MonoTime::kMicrosecondsPerSecond / Throttler::kRefillPeriodMicros;
+  bool waited = false;
+  uint64_t remaining = bytes;
+  while (remaining > 0) {
+    uint64_t chunk = std::min<uint64_t>(
+        remaining, std::max<int64_t>(budget_bytes_per_sec() / kPeriodsPerSecond, 1));
+    MonoTime now = MonoTime::Now();
+    if (throttler->Take(now, 0, chunk)) {
+      remaining -= chunk;
+      continue;
+    }
+    waited = true;
+    SleepFor(MonoDelta::FromMicroseconds(Throttler::kRefillPeriodMicros / 10));
+    // Let the budget recover while we wait.
+    GetThrottler(data_dir, MonoTime::Now());
+  }
+
+  if (waited && bytes_throttled_) {
+    bytes_throttled_->IncrementBy(bytes);
+    time_throttled_us_->IncrementBy((MonoTime::Now() - start).ToMicroseconds());
+  }
+}
+
+} // namespace fs
+} // namespace kudu
@@ -0,0 +1,104 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_FS_IO_THROTTLER_H
+#define KUDU_FS_IO_THROTTLER_H
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+
+namespace kudu {
+
+class Counter;
+template<class T>
+class AtomicGauge;
+class MetricEntity;
+class Throttler;
+
+namespace fs {
+
+// Rate limits the background writes (flushes and compactions) of a block
+// manager, with a token bucket for each data directory.
+//
+// All directories share a byte rate budget which adapts to the latency of
+// block reads that had to go to disk: when the average read latency over an
+// adjustment period exceeds --fs_background_write_read_latency_target_ms,
+// the budget is halved (down to --fs_background_write_min_bytes_per_sec),
+// otherwise it grows back by a tenth of
+// --fs_background_write_bytes_per_sec per period.
+//
+// This class is thread-safe.
+class IOThrottler {
+ public:
+  // 'metric_entity' may be NULL, in which case no metrics are produced.
+  explicit IOThrottler(const scoped_refptr<MetricEntity>& metric_entity);
+  ~IOThrottler();
+
+  // Blocks the calling thread until 'bytes' more background bytes may be
+  // written to 'data_dir'. Returns immediately if background writes are not
+  // rate limited.
+  void Throttle(const std::string& data_dir, uint64_t bytes);
+
+  // Records the latency of a block read which missed the block cache.
+  static void RecordBlockReadLatency(const MonoDelta& latency);
+
+  // Returns the current per-directory budget in bytes per second, or 0 if
+  // the budget hasn't been set yet.
+  int64_t budget_bytes_per_sec() const;
+
+ private:
+  // Returns the token bucket for 'data_dir', creating it if needed, after
+  // adjusting the budget to the recent read latency if it is due.
+  Throttler* GetThrottler(const std::string& data_dir, MonoTime now);
+
+  // Recomputes 'budget_' from the block reads since the last adjustment.
+  void AdjustBudgetUnlocked(MonoTime now);
+
+  mutable simple_spinlock lock_;
+
+  // Per-directory token buckets. Protected by 'lock_'.
+  std::unordered_map<std::string, std::unique_ptr<Throttler>> throttlers_;
+
+  // The current per-directory budget in bytes per second. Protected by 'lock_'.
+  int64_t budget_;
+
+  // When the budget is next due for adjustment. Protected by 'lock_'.
+  MonoTime next_adjust_;
+
+  // The cumulative block read latency and count as of the last adjustment.
+  // Protected by 'lock_'.
+  int64_t last_read_latency_us_;
+  int64_t last_read_count_;
+
+  scoped_refptr<Counter> bytes_throttled_;
+  scoped_refptr<Counter> time_throttled_us_;
+  scoped_refptr<AtomicGauge<int64_t>> budget_gauge_;
+
+  DISALLOW_COPY_AND_ASSIGN(IOThrottler);
+};
+
+} // namespace fs
+} // namespace kudu
+
+#endif // KUDU_FS_IO_THROTTLER_H
@@ -23,6 +23,7 @@
 #include "kudu/fs/block_manager_metrics.h"
 #include "kudu/fs/block_manager_util.h"
 #include "kudu/gutil/callback.h"
+#include "kudu/gutil/casts.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/strcat.h"
 #include "kudu/gutil/strings/strip.h"
@@ -34,6 +35,7 @@
 #include "kudu/util/env_util.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/maintenance_manager.h"
 #include "kudu/util/malloc.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/mutex.h"
@@ -41,6 +43,7 @@
 #include "kudu/util/pb_util.h"
 #include "kudu/util/random_util.h"
 #include "kudu/util/scoped_cleanup.h"
+#include "kudu/util/semaphore.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_util_prod.h"
 #include "kudu/util/threadpool.h"
@@ -77,6 +80,32 @@ DEFINE_int64(fs_data_dirs_reserved_bytes, 0,
 TAG_FLAG(fs_data_dirs_reserved_bytes, runtime);
 TAG_FLAG(fs_data_dirs_reserved_bytes, evolving);
 
+DEFINE_double(log_container_live_metadata_before_compact_ratio, 0.5,
+              "If the ratio of live blocks to block records in a log container's "
+              "metadata falls below this value at startup, the metadata is rewritten "
+              "with only the live blocks, so that later startups read fewer records. "
+              "Set to 0 to disable metadata compaction.");
+TAG_FLAG(log_container_live_metadata_before_compact_ratio, experimental);
+
+DEFINE_int32(log_container_metadata_compact_min_records, 1000,
+             "Minimum number of block records in a log container's metadata before "
+             "it is considered for compaction.");
+TAG_FLAG(log_container_metadata_compact_min_records, experimental);
+
+DEFINE_double(log_container_compaction_live_ratio, 0.2,
+              "Full log containers whose live blocks take up less than this fraction "
+              "of their data are compacted in the background, by copying the live "
+              "blocks into other containers so that the container's data file is left "
+              "entirely hole punched. Set to 0 to disable container compaction.");
+TAG_FLAG(log_container_compaction_live_ratio, runtime);
+TAG_FLAG(log_container_compaction_live_ratio, experimental);
+
+DEFINE_int32(log_container_compaction_progress_interval_blocks, 1000,
+             "Number of blocks relocated between progress messages when compacting "
+             "a log container.");
+TAG_FLAG(log_container_compaction_progress_interval_blocks, runtime);
+TAG_FLAG(log_container_compaction_progress_interval_blocks, advanced);
+
 METRIC_DEFINE_gauge_uint64(server, log_block_manager_bytes_under_management,
                            "Bytes Under Management",
                            kudu::MetricUnit::kBytes,
@@ -103,6 +132,32 @@ METRIC_DEFINE_counter(server, log_block_manager_unavailable_containers,
                       "Number of non-full log block containers that are under root paths "
                       "whose disks are full");
 
+METRIC_DEFINE_counter(server, log_block_manager_containers_compacted,
+                      "Number of Compacted Log Block Containers",
+                      kudu::MetricUnit::kLogBlockContainers,
+                      "Number of sparse full log block containers whose live blocks "
+                      "were relocated into other containers");
+
+METRIC_DEFINE_counter(server, log_block_manager_blocks_relocated,
+                      "Blocks Relocated",
+                      kudu::MetricUnit::kBlocks,
+                      "Number of blocks relocated by log block container compaction");
+
+METRIC_DEFINE_counter(server, log_block_manager_bytes_relocated,
+                      "Bytes Relocated",
+                      kudu::MetricUnit::kBytes,
+                      "Number of bytes of blocks relocated by log block container compaction");
+
+METRIC_DEFINE_gauge_uint32(server, log_block_manager_container_compaction_running,
+                           "Log Block Container Compactions Running",
+                           kudu::MetricUnit::kMaintenanceOperations,
+                           "Number of log block container compactions currently running");
+
+METRIC_DEFINE_histogram(server, log_block_manager_container_compaction_duration,
+                        "Log Block Container Compaction Duration",
+                        kudu::MetricUnit::kMilliseconds,
+                        "Time spent compacting log block containers.", 60000LU * 60, 1);
+
 using kudu::env_util::ScopedFileDeleter;
 using kudu::fs::internal::LogBlock;
 using kudu::fs::internal::LogBlockContainer;
@@ -137,6 +192,12 @@ struct LogBlockManagerMetrics {
   scoped_refptr<Counter> containers;
   scoped_refptr<Counter> full_containers;
   scoped_refptr<Counter> unavailable_containers;
+
+  scoped_refptr<Counter> containers_compacted;
+  scoped_refptr<Counter> blocks_relocated;
+  scoped_refptr<Counter> bytes_relocated;
+  scoped_refptr<AtomicGauge<uint32_t> > container_compaction_running;
+  scoped_refptr<Histogram> container_compaction_duration;
 };
 
 #define MINIT(x) x(METRIC_log_block_manager_##x.Instantiate(metric_entity))
@@ -147,7 +208,12 @@ LogBlockManagerMetrics::LogBlockManagerMetrics(const scoped_refptr<MetricEntity>
     GINIT(blocks_under_management),
     MINIT(containers),
     MINIT(full_containers),
-    MINIT(unavailable_containers) {
+    MINIT(unavailable_containers),
+    MINIT(containers_compacted),
+    MINIT(blocks_relocated),
+    MINIT(bytes_relocated),
+    GINIT(container_compaction_running),
+    MINIT(container_compaction_duration) {
 }
 #undef GINIT
 #undef MINIT
@@ -189,14 +255,15 @@ class LogBlockContainer {
                      gscoped_ptr<LogBlockContainer>* container);
 
   // Indicates that the writing of 'block' is finished. If successful,
-  // adds the block to the block manager's in-memory maps.
+  // adds the block to the block manager's in-memory maps, unless 'relocated'
+  // is set: the copy of a relocated block is swapped in by its caller.
   //
   // Returns a status that is either the same as 's' (if !s.ok()) or
   // potentially different (if s.ok() and FinishBlock() failed).
   //
   // After returning, this container has been released to the block manager
   // and may no longer be used in the context of writing 'block'.
-  Status FinishBlock(const Status& s, WritableBlock* block);
+  Status FinishBlock(const Status& s, WritableBlock* block, bool relocated);
 
   // Frees the space associated with a block at 'offset' and 'length'. This
   // is a physical operation, not a logical one; a separate AppendMetadata()
@@ -265,6 +332,23 @@ class LogBlockContainer {
   // This function is thread unsafe.
   void UpdateBytesWritten(int64_t more_bytes);
 
+  // Updates 'total_bytes_written_' for a block found in the metadata at
+  // startup, so that it covers the block at 'offset' with 'length' bytes.
+  // Unlike summing the lengths of the blocks, this holds even if the
+  // metadata was compacted.
+  //
+  // This function is thread unsafe.
+  void UpdateBytesWrittenForBlockRecord(int64_t offset, int64_t length);
+
+  // Atomically replaces the container's metadata with 'records', which must
+  // describe the same live blocks.
+  //
+  // This function is thread unsafe.
+  Status CompactMetadata(const vector<BlockRecordPB>& records);
+
+  // Accounts for 'delta' more bytes of live blocks in the container.
+  void UpdateLiveBytes(int64_t delta) { live_bytes_.IncrementBy(delta); }
+
   // Run a task on this container's root path thread pool.
   //
   // Normally the task is performed asynchronously. However, if submission to
@@ -276,6 +360,7 @@ class LogBlockContainer {
   const std::string& ToString() const { return path_; }
   LogBlockManager* block_manager() const { return block_manager_; }
   int64_t total_bytes_written() const { return total_bytes_written_; }
+  int64_t live_bytes() const { return live_bytes_.Load(); }
   bool full() const {
     return total_bytes_written_ >= FLAGS_log_container_max_size;
   }
@@ -289,6 +374,9 @@ class LogBlockContainer {
                     gscoped_ptr<WritablePBContainerFile> metadata_writer,
                     gscoped_ptr<RWFile> data_file);
 
+  // If the block manager reads with direct I/O, opens 'direct_reader_'.
+  Status OpenDirectReader();
+
   // Performs sanity checks on a block record.
   void CheckBlockRecord(const BlockRecordPB& record,
                         uint64_t data_file_size) const;
@@ -317,9 +405,17 @@ class LogBlockContainer {
   Mutex data_writer_lock_;
   gscoped_ptr<RWFile> data_file_;
 
+  // A second, read-only handle to the data file opened for direct I/O, used
+  // for reads instead of 'data_file_' if set.
+  gscoped_ptr<RandomAccessFile> direct_reader_;
+
   // The amount of data written thus far in the container.
   int64_t total_bytes_written_ = 0;
 
+  // The length of the container's blocks in the block manager's block map.
+  // Deleted blocks are excluded, even if their space has yet to be freed.
+  AtomicInt<int64_t> live_bytes_;
+
   // The metrics. Not owned by the log container; it has the same lifespan
   // as the block manager.
   const LogBlockManagerMetrics* metrics_;
@@ -338,6 +434,7 @@ LogBlockContainer::LogBlockContainer(
       path_(std::move(path)),
       metadata_pb_writer_(std::move(metadata_writer)),
       data_file_(std::move(data_file)),
+      live_bytes_(0),
       metrics_(block_manager->metrics()),
       instance_(instance) {}
 
@@ -388,6 +485,7 @@ Status LogBlockContainer::Create(LogBlockManager* block_manager,
                                            common_path,
                                            std::move(metadata_pb_writer),
                                            std::move(data_file)));
+    RETURN_NOT_OK((*container)->OpenDirectReader());
     VLOG(1) << "Created log block container " << (*container)->ToString();
   }
 
@@ -460,11 +558,21 @@ Status LogBlockContainer::Open(LogBlockManager* block_manager,
                                                                       common_path,
                                                                       std::move(metadata_pb_writer),
                                                                       std::move(data_file)));
+  RETURN_NOT_OK(open_container->OpenDirectReader());
   VLOG(1) << "Opened log block container " << open_container->ToString();
   container->reset(open_container.release());
   return Status::OK();
 }
 
+Status LogBlockContainer::OpenDirectReader() {
+  if (!block_manager_->direct_reads()) {
+    return Status::OK();
+  }
+  RandomAccessFileOptions opts;
+  opts.direct_io = true;
+  return block_manager_->env()->NewRandomAccessFile(opts, DataFilePath(), &direct_reader_);
+}
+
 string LogBlockContainer::MetadataFilePath() const {
   return StrCat(path_, LogBlockManager::kContainerMetadataFileSuffix);
 }
@@ -536,7 +644,8 @@ void LogBlockContainer::CheckBlockRecord(const BlockRecordPB& record,
   }
 }
 
-Status LogBlockContainer::FinishBlock(const Status& s, WritableBlock* block) {
+Status LogBlockContainer::FinishBlock(const Status& s, WritableBlock* block,
+                                      bool relocated) {
   auto cleanup = MakeScopedCleanup([&]() {
       block_manager_->MakeContainerAvailable(this);
     });
@@ -553,8 +662,10 @@ Status LogBlockContainer::FinishBlock(const Status& s, WritableBlock* block) {
   // will have written some garbage that can be expunged during a GC.
   RETURN_NOT_OK(block_manager()->SyncContainer(*this));
 
-  CHECK(block_manager()->AddLogBlock(this, block->id(),
-                                     total_bytes_written(), block->BytesAppended()));
+  if (!relocated) {
+    CHECK(block_manager()->AddLogBlock(this, block->id(),
+                                       total_bytes_written(), block->BytesAppended()));
+  }
   UpdateBytesWritten(block->BytesAppended());
   if (full() && block_manager()->metrics()) {
     block_manager()->metrics()->full_containers->Increment();
@@ -587,6 +698,8 @@ Status LogBlockContainer::WriteData(int64_t offset, const Slice& data) {
   DCHECK_GE(offset, 0);
 
   std::lock_guard<Mutex> l(data_writer_lock_);
+  ScopedDataDirLatency latency(&block_manager_->latency_tracker_, root_path_,
+                               DataDirLatencyTracker::WRITE);
   return data_file_->Write(offset, data);
 }
 
@@ -594,6 +707,11 @@ Status LogBlockContainer::ReadData(int64_t offset, size_t length,
                                    Slice* result, uint8_t* scratch) const {
   DCHECK_GE(offset, 0);
 
+  ScopedDataDirLatency latency(&block_manager_->latency_tracker_, root_path_,
+                               DataDirLatencyTracker::READ);
+  if (direct_reader_) {
+    return direct_reader_->Read(offset, length, result, scratch);
+  }
   return data_file_->Read(offset, length, result, scratch);
 }
 
@@ -620,6 +738,8 @@ Status LogBlockContainer::FlushMetadata() {
 Status LogBlockContainer::SyncData() {
   if (FLAGS_enable_data_block_fsync) {
     std::lock_guard<Mutex> l(data_writer_lock_);
+    ScopedDataDirLatency latency(&block_manager_->latency_tracker_, root_path_,
+                                 DataDirLatencyTracker::SYNC);
     return data_file_->Sync();
   }
   return Status::OK();
@@ -628,6 +748,8 @@ Status LogBlockContainer::SyncData() {
 Status LogBlockContainer::SyncMetadata() {
   if (FLAGS_enable_data_block_fsync) {
     std::lock_guard<Mutex> l(metadata_pb_writer_lock_);
+    ScopedDataDirLatency latency(&block_manager_->latency_tracker_, root_path_,
+                                 DataDirLatencyTracker::SYNC);
     return metadata_pb_writer_->Sync();
   }
   return Status::OK();
@@ -655,6 +777,56 @@ void LogBlockContainer::UpdateBytesWritten(int64_t more_bytes) {
   }
 }
 
+void LogBlockContainer::UpdateBytesWrittenForBlockRecord(int64_t offset, int64_t length) {
+  DCHECK_GE(length, 0);
+  total_bytes_written_ = std::max(
+      total_bytes_written_,
+      offset + static_cast<int64_t>(KUDU_ALIGN_UP(length,
+                                                  instance()->filesystem_block_size_bytes())));
+  if (full()) {
+    VLOG(1) << "Container " << ToString() << " with size "
+            << total_bytes_written_ << " is now full, max size is "
+            << FLAGS_log_container_max_size;
+  }
+}
+
+Status LogBlockContainer::CompactMetadata(const vector<BlockRecordPB>& records) {
+  Env* env = block_manager_->env();
+  const string metadata_path = MetadataFilePath();
+  string tmp_path;
+  gscoped_ptr<RWFile> tmp_file;
+  RETURN_NOT_OK(env->NewTempRWFile(RWFileOptions(),
+                                   StrCat(metadata_path, LogBlockManager::kContainerTmpInfix,
+                                          "XXXXXX"),
+                                   &tmp_path, &tmp_file));
+  env_util::ScopedFileDeleter tmp_deleter(env, tmp_path);
+  {
+    WritablePBContainerFile pb_file(std::move(tmp_file));
+    RETURN_NOT_OK(pb_file.Init(BlockRecordPB()));
+    for (const BlockRecordPB& record : records) {
+      RETURN_NOT_OK(pb_file.Append(record));
+    }
+    RETURN_NOT_OK(pb_file.Sync());
+    RETURN_NOT_OK(pb_file.Close());
+  }
+  RETURN_NOT_OK_PREPEND(env->RenameFile(tmp_path, metadata_path),
+                        "Failed to rename compacted metadata to " + metadata_path);
+  tmp_deleter.Cancel();
+  RETURN_NOT_OK(env->SyncDir(dir()));
+
+  // Appends must now go to the new file.
+  gscoped_ptr<RWFile> metadata_writer;
+  RWFileOptions wr_opts;
+  wr_opts.mode = Env::OPEN_EXISTING;
+  RETURN_NOT_OK(env->NewRWFile(wr_opts, metadata_path, &metadata_writer));
+  gscoped_ptr<WritablePBContainerFile> metadata_pb_writer(
+      new WritablePBContainerFile(std::move(metadata_writer)));
+  RETURN_NOT_OK(metadata_pb_writer->Reopen());
+  std::lock_guard<Mutex> l(metadata_pb_writer_lock_);
+  metadata_pb_writer_.swap(metadata_pb_writer);
+  return Status::OK();
+}
+
 void LogBlockContainer::ExecClosure(const Closure& task) {
   ThreadPool* pool = FindOrDie(block_manager()->thread_pools_by_root_path_,
                                dir());
@@ -758,7 +930,8 @@ void LogBlock::Delete() {
 // A log-backed block that has been opened for writing.
 //
 // There's no reference to a LogBlock as this block has yet to be
-// persisted.
+// persisted, unless the block is the copy of a block being relocated into
+// another container, which shares the relocated block's ID.
 class LogWritableBlock : public WritableBlock {
  public:
   enum SyncMode {
@@ -767,7 +940,8 @@ class LogWritableBlock : public WritableBlock {
   };
 
   LogWritableBlock(LogBlockContainer* container, BlockId block_id,
-                   int64_t block_offset);
+                   int64_t block_offset, bool background,
+                   scoped_refptr<LogBlock> relocated_from);
 
   virtual ~LogWritableBlock();
 
@@ -796,6 +970,10 @@ class LogWritableBlock : public WritableBlock {
   // Does not synchronize the written data; that takes place in Close().
   Status AppendMetadata();
 
+  LogBlockContainer* container() const { return container_; }
+  int64_t block_offset() const { return block_offset_; }
+  bool relocated() const { return relocated_from_.get() != nullptr; }
+
  private:
   // The owning container. Must outlive the block.
   LogBlockContainer* container_;
@@ -810,6 +988,12 @@ class LogWritableBlock : public WritableBlock {
   // The block's length. Changes with each Append().
   int64_t block_length_;
 
+  // Whether appends are rate limited by the block manager's IOThrottler.
+  const bool background_;
+
+  // The block this block is a copy of, if it's being relocated.
+  const scoped_refptr<LogBlock> relocated_from_;
+
   // The state of the block describing where it is in the write lifecycle,
   // for example, has it been synchronized to disk?
   WritableBlock::State state_;
@@ -818,11 +1002,15 @@ class LogWritableBlock : public WritableBlock {
 };
 
 LogWritableBlock::LogWritableBlock(LogBlockContainer* container,
-                                   BlockId block_id, int64_t block_offset)
+                                   BlockId block_id, int64_t block_offset,
+                                   bool background,
+                                   scoped_refptr<LogBlock> relocated_from)
     : container_(container),
       block_id_(std::move(block_id)),
       block_offset_(block_offset),
       block_length_(0),
+      background_(background),
+      relocated_from_(std::move(relocated_from)),
       state_(CLEAN) {
   DCHECK_GE(block_offset, 0);
   DCHECK_EQ(0, block_offset % container->instance()->filesystem_block_size_bytes());
@@ -846,6 +1034,11 @@ Status LogWritableBlock::Close() {
 Status LogWritableBlock::Abort() {
   RETURN_NOT_OK(DoClose(NO_SYNC));
 
+  // The ID of a relocated block's copy still belongs to the original.
+  if (relocated_from_) {
+    return Status::OK();
+  }
+
   // DoClose() has unlocked the container; it may be locked by someone else.
   // But block_manager_ is immutable, so this is safe.
   return container_->block_manager()->DeleteBlock(id());
@@ -867,6 +1060,10 @@ Status LogWritableBlock::Append(const Slice& data) {
   // whichever comes first. We can't do it now because the block's
   // length is still in flux.
 
+  if (background_) {
+    container_->block_manager()->io_throttler_.Throttle(container_->root_path(),
+                                                        data.size());
+  }
   MicrosecondsInt64 start_time = GetMonoTimeMicros();
   RETURN_NOT_OK(container_->WriteData(block_offset_ + block_length_, data));
   MicrosecondsInt64 end_time = GetMonoTimeMicros();
@@ -884,6 +1081,7 @@ Status LogWritableBlock::Append(const Slice& data) {
 Status LogWritableBlock::FlushDataAsync() {
   DCHECK(state_ == CLEAN || state_ == DIRTY || state_ == FLUSHING)
       << "Invalid state: " << state_;
+  DCHECK(!relocated_from_) << "The copy of a relocated block is only recorded on Close()";
   if (state_ == DIRTY) {
     VLOG(3) << "Flushing block " << id();
     RETURN_NOT_OK(container_->FlushData(block_offset_, block_length_));
@@ -929,10 +1127,19 @@ Status LogWritableBlock::DoClose(SyncMode mode) {
         }
 
         state_ = CLOSED;
-        s = container_->FinishBlock(s, this);
+        s = container_->FinishBlock(s, this, relocated_from_.get() != nullptr);
       });
     // FlushDataAsync() was not called; append the metadata now.
-    if (state_ == CLEAN || state_ == DIRTY) {
+    //
+    // The copy of a relocated block is only recorded once its data is
+    // durable, and not at all if it's aborted. Otherwise a crash could leave
+    // a record of garbage data beside the original's record, with nothing to
+    // tell the two apart.
+    if ((state_ == CLEAN || state_ == DIRTY) && (!relocated_from_ || mode == SYNC)) {
+      if (relocated_from_) {
+        s = container_->SyncData();
+        RETURN_NOT_OK(s);
+      }
       s = AppendMetadata();
       RETURN_NOT_OK_PREPEND(s, "Unable to flush block during close");
     }
@@ -1075,6 +1282,59 @@ size_t LogReadableBlock::memory_footprint() const {
   return kudu_malloc_usable_size(this);
 }
 
+////////////////////////////////////////////////////////////
+// LogBlockContainerCompactionOp
+////////////////////////////////////////////////////////////
+
+// Maintenance op which compacts the sparsest full container of a block
+// manager. See --log_container_compaction_live_ratio.
+class LogBlockContainerCompactionOp : public MaintenanceOp {
+ public:
+  explicit LogBlockContainerCompactionOp(LogBlockManager* block_manager)
+      : MaintenanceOp("LogBlockContainerCompactionOp", MaintenanceOp::HIGH_IO_USAGE),
+        block_manager_(block_manager),
+        sem_(1) {
+  }
+
+  virtual void UpdateStats(MaintenanceOpStats* stats) OVERRIDE {
+    double live_ratio;
+    bool found = block_manager_->FindContainerToCompact(&live_ratio) != nullptr;
+    stats->set_runnable(found && sem_.GetValue() == 1);
+    stats->set_perf_improvement(found ? 1 - live_ratio : 0);
+  }
+
+  virtual bool Prepare() OVERRIDE {
+    return sem_.try_lock();
+  }
+
+  virtual void Perform() OVERRIDE {
+    CHECK(!sem_.try_lock());
+    double live_ratio;
+    LogBlockContainer* container = block_manager_->FindContainerToCompact(&live_ratio);
+    if (container) {
+      WARN_NOT_OK(block_manager_->CompactContainer(container),
+                  "Could not compact container " + container->ToString());
+    }
+    sem_.unlock();
+  }
+
+  virtual scoped_refptr<Histogram> DurationHistogram() const OVERRIDE {
+    return block_manager_->metrics()->container_compaction_duration;
+  }
+
+  virtual scoped_refptr<AtomicGauge<uint32_t> > RunningGauge() const OVERRIDE {
+    return block_manager_->metrics()->container_compaction_running;
+  }
+
+ private:
+  LogBlockManager* const block_manager_;
+
+  // Held while the op runs.
+  Semaphore sem_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogBlockContainerCompactionOp);
+};
+
 } // namespace internal
 
 ////////////////////////////////////////////////////////////
@@ -1083,6 +1343,7 @@ size_t LogReadableBlock::memory_footprint() const {
 
 const char* LogBlockManager::kContainerMetadataFileSuffix = ".metadata";
 const char* LogBlockManager::kContainerDataFileSuffix = ".data";
+const char* LogBlockManager::kContainerTmpInfix = ".tmp.";
 
 static const char* kBlockManagerType = "log";
 
@@ -1097,9 +1358,12 @@ LogBlockManager::LogBlockManager(Env* env, const BlockManagerOptions& opts)
                         BlockAllocator(mem_tracker_)),
     env_(DCHECK_NOTNULL(env)),
     read_only_(opts.read_only),
+    direct_reads_(opts.direct_reads),
     root_paths_(opts.root_paths),
     root_paths_idx_(0),
-    next_block_id_(1) {
+    next_block_id_(1),
+    io_throttler_(opts.metric_entity),
+    latency_tracker_(opts.metric_entity) {
 
   // HACK: when running in a test environment, we often instantiate many
   // LogBlockManagers in the same process, eg corresponding to different
@@ -1253,6 +1517,12 @@ Status LogBlockManager::Open() {
 
 Status LogBlockManager::CreateBlock(const CreateBlockOptions& opts,
                                     gscoped_ptr<WritableBlock>* block) {
+  return CreateBlockInternal(opts, nullptr, block);
+}
+
+Status LogBlockManager::CreateBlockInternal(const CreateBlockOptions& opts,
+                                            const scoped_refptr<LogBlock>& relocated_from,
+                                            gscoped_ptr<WritableBlock>* block) {
   CHECK(!read_only_);
 
   // Root paths that are below their reserved space threshold. Initialize the
@@ -1265,6 +1535,22 @@ Status LogBlockManager::CreateBlock(const CreateBlockOptions& opts,
     }
   }
 
+  // Root paths outside of the ones the block should be placed in, if any,
+  // and degraded root paths. The block only goes there if no other root path
+  // has room for it.
+  vector<string> degraded;
+  latency_tracker_.GetDegradedRootPaths(&degraded);
+  unordered_set<string> degraded_root_paths(degraded.begin(), degraded.end());
+  unordered_set<string> excluded_root_paths(degraded_root_paths);
+  if (!opts.root_paths.empty()) {
+    for (const string& root_path : root_paths_) {
+      if (std::find(opts.root_paths.begin(), opts.root_paths.end(), root_path) ==
+          opts.root_paths.end()) {
+        excluded_root_paths.insert(root_path);
+      }
+    }
+  }
+
   // Find a free container. If one cannot be found, create a new one.
   // In case one or more root paths have hit their reserved space limit, we
   // retry until we have exhausted all root paths.
@@ -1273,7 +1559,7 @@ Status LogBlockManager::CreateBlock(const CreateBlockOptions& opts,
   // callers to block if we've reached it?
   LogBlockContainer* container = nullptr;
   while (!container) {
-    container = GetAvailableContainer(full_root_paths);
+    container = GetAvailableContainer(full_root_paths, excluded_root_paths);
     if (!container) {
       // If all root paths are full, we cannot allocate a block.
       if (full_root_paths.size() == root_paths_.size()) {
@@ -1282,6 +1568,28 @@ Status LogBlockManager::CreateBlock(const CreateBlockOptions& opts,
                                "fs_data_dirs_reserved_bytes configuration parameter",
                                "", ENOSPC);
       }
+      // If the root paths the block should be placed in are full, place it
+      // in any other.
+      int num_usable = 0;
+      for (const string& root_path : root_paths_) {
+        if (!ContainsKey(full_root_paths, root_path) &&
+            !ContainsKey(excluded_root_paths, root_path)) {
+          num_usable++;
+        }
+      }
+      if (num_usable == 0) {
+        if (excluded_root_paths.size() > degraded_root_paths.size()) {
+          LOG_EVERY_N(WARNING, 100) << "All data directories of the block's data dir group "
+                                    << "are full, placing it in another data directory";
+          excluded_root_paths = degraded_root_paths;
+        } else {
+          LOG_EVERY_N(WARNING, 100) << "All data directories with room for the block are "
+                                    << "degraded, placing it in a degraded one";
+          excluded_root_paths.clear();
+          degraded_root_paths.clear();
+        }
+        continue;
+      }
       // Round robin through the root paths to select where the next
       // container should live.
       // TODO: Consider a more random scheme for block placement.
@@ -1291,7 +1599,8 @@ Status LogBlockManager::CreateBlock(const CreateBlockOptions& opts,
         cur_idx = root_paths_idx_.Load();
         next_idx = (cur_idx + 1) % root_paths_.size();
       } while (!root_paths_idx_.CompareAndSet(cur_idx, next_idx) ||
-               ContainsKey(full_root_paths, root_paths_[cur_idx]));
+               ContainsKey(full_root_paths, root_paths_[cur_idx]) ||
+               ContainsKey(excluded_root_paths, root_paths_[cur_idx]));
       string root_path = root_paths_[cur_idx];
       if (full_disk_cache_.IsRootFull(root_path)) {
         InsertOrDie(&full_root_paths, root_path);
@@ -1344,17 +1653,23 @@ Status LogBlockManager::CreateBlock(const CreateBlockOptions& opts,
     }
   }
 
-  // Generate a free block ID.
+  // Generate a free block ID, unless the block is a relocated block's copy.
   // We have to loop here because earlier versions used non-sequential block IDs,
   // and thus we may have to "skip over" some block IDs that are claimed.
   BlockId new_block_id;
-  do {
-    new_block_id.SetId(next_block_id_.Increment());
-  } while (!TryUseBlockId(new_block_id));
+  if (relocated_from) {
+    new_block_id = relocated_from->block_id();
+  } else {
+    do {
+      new_block_id.SetId(next_block_id_.Increment());
+    } while (!TryUseBlockId(new_block_id));
+  }
 
   block->reset(new internal::LogWritableBlock(container,
                                               new_block_id,
-                                              container->total_bytes_written()));
+                                              container->total_bytes_written(),
+                                              opts.background,
+                                              relocated_from));
   VLOG(3) << "Created block " << (*block)->id() << " in container "
           << container->ToString();
   return Status::OK();
@@ -1412,22 +1727,245 @@ Status LogBlockManager::DeleteBlock(const BlockId& block_id) {
 
 Status LogBlockManager::CloseBlocks(const std::vector<WritableBlock*>& blocks) {
   VLOG(3) << "Closing " << blocks.size() << " blocks";
-  if (FLAGS_block_coalesce_close) {
-    // Ask the kernel to begin writing out each block's dirty data. This is
-    // done up-front to give the kernel opportunities to coalesce contiguous
-    // dirty pages.
+  if (!FLAGS_block_coalesce_close) {
     for (WritableBlock* block : blocks) {
-      RETURN_NOT_OK(block->FlushDataAsync());
+      RETURN_NOT_OK(block->Close());
     }
+    return Status::OK();
   }
 
-  // Now close each block, waiting for each to become durable.
+  // Close the group in phases, so that each container is synced once for
+  // all of its blocks, and concurrently with the other containers:
+  // 1. Write out the data and metadata of every block.
+  // 2. Sync the data file of every container.
+  // 3. Sync the metadata file of every container. The metadata is only
+  //    synced once the data it describes is durable.
+  // 4. Close every block, making its container available again.
+  //
+  // The copy of a relocated block must be durable before it's recorded, so
+  // it's closed on its own.
+  std::vector<internal::LogWritableBlock*> group;
+  std::vector<LogBlockContainer*> containers;
+  unordered_set<LogBlockContainer*> seen;
   for (WritableBlock* block : blocks) {
-    RETURN_NOT_OK(block->Close());
+    internal::LogWritableBlock* lwb = down_cast<internal::LogWritableBlock*>(block);
+    if (lwb->state() == WritableBlock::CLOSED) {
+      continue;
+    }
+    if (lwb->relocated()) {
+      RETURN_NOT_OK(lwb->Close());
+      continue;
+    }
+    group.push_back(lwb);
+    if (InsertIfNotPresent(&seen, lwb->container())) {
+      containers.push_back(lwb->container());
+    }
+  }
+  if (group.empty()) {
+    return Status::OK();
+  }
+
+  const internal::BlockManagerMetrics* m = metrics() ? &metrics()->generic_metrics : nullptr;
+  MonoTime start = MonoTime::Now();
+  for (internal::LogWritableBlock* block : group) {
+    RETURN_NOT_OK(block->FlushDataAsync());
+  }
+  MonoTime flushed = MonoTime::Now();
+
+  std::vector<StatusClosure> syncs;
+  for (LogBlockContainer* container : containers) {
+    syncs.push_back(Bind(&LogBlockContainer::SyncData, Unretained(container)));
+  }
+  RETURN_NOT_OK(SyncConcurrently(syncs));
+  MonoTime data_synced = MonoTime::Now();
+
+  syncs.clear();
+  for (LogBlockContainer* container : containers) {
+    syncs.push_back(Bind(&LogBlockContainer::SyncMetadata, Unretained(container)));
+  }
+  RETURN_NOT_OK(SyncConcurrently(syncs));
+  MonoTime metadata_synced = MonoTime::Now();
+
+  if (m) {
+    m->group_close_flush_time_us->Increment((flushed - start).ToMicroseconds());
+    m->group_close_data_sync_time_us->Increment(
+        (data_synced - flushed).ToMicroseconds());
+    m->group_close_metadata_sync_time_us->Increment(
+        (metadata_synced - data_synced).ToMicroseconds());
+  }
+
+  for (internal::LogWritableBlock* block : group) {
+    RETURN_NOT_OK(block->DoClose(internal::LogWritableBlock::NO_SYNC));
   }
   return Status::OK();
 }
 
+void LogBlockManager::RegisterMaintenanceOps(MaintenanceManager* manager) {
+  // The op's metrics live with the block manager's.
+  if (read_only_ || !metrics()) {
+    return;
+  }
+  CHECK(!compaction_op_);
+  compaction_op_.reset(new internal::LogBlockContainerCompactionOp(this));
+  manager->RegisterOp(compaction_op_.get());
+}
+
+void LogBlockManager::UnregisterMaintenanceOps() {
+  if (compaction_op_) {
+    compaction_op_->Unregister();
+    compaction_op_.reset();
+  }
+}
+
+void LogBlockManager::GetDegradedRootPaths(vector<string>* root_paths) const {
+  latency_tracker_.GetDegradedRootPaths(root_paths);
+}
+
+LogBlockContainer* LogBlockManager::FindContainerToCompact(double* live_ratio) const {
+  LogBlockContainer* sparsest = nullptr;
+  double sparsest_ratio = FLAGS_log_container_compaction_live_ratio;
+  std::lock_guard<simple_spinlock> l(lock_);
+  for (LogBlockContainer* container : full_containers_) {
+    // Containers without live blocks have nothing to relocate.
+    int64_t live_bytes = container->live_bytes();
+    if (live_bytes == 0) {
+      continue;
+    }
+    double ratio = static_cast<double>(live_bytes) / container->total_bytes_written();
+    if (ratio < sparsest_ratio) {
+      sparsest = container;
+      sparsest_ratio = ratio;
+    }
+  }
+  *live_ratio = sparsest_ratio;
+  return sparsest;
+}
+
+Status LogBlockManager::CompactContainer(LogBlockContainer* container) {
+  CHECK(!read_only_);
+
+  vector<scoped_refptr<LogBlock>> blocks;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    for (const auto& e : blocks_by_block_id_) {
+      if (e.second->container() == container) {
+        blocks.push_back(e.second);
+      }
+    }
+  }
+  // Read the container sequentially.
+  std::sort(blocks.begin(), blocks.end(),
+            [](const scoped_refptr<LogBlock>& a, const scoped_refptr<LogBlock>& b) {
+              return a->offset() < b->offset();
+            });
+  LOG(INFO) << Substitute("Compacting container $0: relocating $1 blocks ($2 bytes) "
+                          "of $3 bytes of data", container->ToString(), blocks.size(),
+                          container->live_bytes(), container->total_bytes_written());
+
+  // The relocated blocks are only deleted from 'container' once their
+  // DELETE records are durable: until then, a crash would bring them back.
+  vector<scoped_refptr<LogBlock>> relocated;
+  int64_t relocated_bytes = 0;
+  Status s;
+  LOG_TIMING(INFO, "compacting container " + container->ToString()) {
+    int num_done = 0;
+    for (const scoped_refptr<LogBlock>& lb : blocks) {
+      bool replaced;
+      s = RelocateBlock(lb, &replaced);
+      if (!s.ok()) {
+        break;
+      }
+      if (replaced) {
+        relocated.push_back(lb);
+        relocated_bytes += lb->length();
+        if (metrics()) {
+          metrics()->blocks_relocated->Increment();
+          metrics()->bytes_relocated->IncrementBy(lb->length());
+        }
+      }
+      int interval = FLAGS_log_container_compaction_progress_interval_blocks;
+      if (interval > 0 && ++num_done % interval == 0) {
+        LOG(INFO) << Substitute("Compacting container $0: relocated $1 of $2 blocks",
+                                container->ToString(), num_done, blocks.size());
+      }
+    }
+
+    if (!relocated.empty()) {
+      Status sync = container->SyncMetadata();
+      if (sync.ok()) {
+        for (const scoped_refptr<LogBlock>& lb : relocated) {
+          lb->Delete();
+        }
+      } else {
+        // The space of the relocated blocks leaks, but is left intact.
+        WARN_NOT_OK(sync, "Could not persist the deletion of the blocks relocated "
+                    "out of container " + container->ToString());
+      }
+      if (s.ok()) {
+        s = sync;
+      }
+    }
+  }
+  LOG(INFO) << Substitute("Relocated $0 blocks ($1 bytes) out of container $2",
+                          relocated.size(), relocated_bytes, container->ToString());
+  if (s.ok() && metrics()) {
+    metrics()->containers_compacted->Increment();
+  }
+  return s;
+}
+
+Status LogBlockManager::RelocateBlock(const scoped_refptr<LogBlock>& lb, bool* relocated) {
+  *relocated = false;
+  gscoped_ptr<WritableBlock> block;
+  // The copy stays on the same disk, and so in the data dir group of the
+  // block's tablet.
+  CreateBlockOptions opts = CreateBlockOptions::Background();
+  opts.root_paths.push_back(lb->container()->root_path());
+  RETURN_NOT_OK(CreateBlockInternal(opts, lb, &block));
+
+  // The copy is appended in chunks, so that its writes are throttled
+  // smoothly.
+  static const int64_t kChunkSize = 1024 * 1024;
+  gscoped_ptr<uint8_t[]> scratch(new uint8_t[std::min(kChunkSize, lb->length())]);
+  for (int64_t pos = 0; pos < lb->length(); pos += kChunkSize) {
+    size_t length = std::min(kChunkSize, lb->length() - pos);
+    Slice data;
+    RETURN_NOT_OK(lb->container()->ReadData(lb->offset() + pos, length, &data, scratch.get()));
+    RETURN_NOT_OK(block->Append(data));
+  }
+  RETURN_NOT_OK(block->Close());
+
+  internal::LogWritableBlock* copy = down_cast<internal::LogWritableBlock*>(block.get());
+  scoped_refptr<LogBlock> new_lb(new LogBlock(copy->container(), lb->block_id(),
+                                              copy->block_offset(), lb->length()));
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    scoped_refptr<LogBlock>* current = FindOrNull(blocks_by_block_id_, lb->block_id());
+    if (current && current->get() == lb.get()) {
+      *current = new_lb;
+      lb->container()->UpdateLiveBytes(-lb->length());
+      new_lb->container()->UpdateLiveBytes(new_lb->length());
+      *relocated = true;
+    }
+  }
+
+  BlockRecordPB record;
+  lb->block_id().CopyToPB(record.mutable_block_id());
+  record.set_op_type(DELETE);
+  record.set_timestamp_us(GetCurrentTimeMicros());
+  if (!*relocated) {
+    // The block was deleted in the meantime; so is its copy.
+    new_lb->Delete();
+    return new_lb->container()->AppendMetadata(record);
+  }
+  Status s = lb->container()->AppendMetadata(record);
+  if (!s.ok()) {
+    // Without its DELETE record, the original mustn't be freed.
+    *relocated = false;
+  }
+  return s;
+}
+
 int64_t LogBlockManager::CountBlocksForTests() const {
   std::lock_guard<simple_spinlock> l(lock_);
   return blocks_by_block_id_.size();
@@ -1445,7 +1983,8 @@ void LogBlockManager::AddNewContainerUnlocked(LogBlockContainer* container) {
 }
 
 LogBlockContainer* LogBlockManager::GetAvailableContainer(
-    const unordered_set<string>& full_root_paths) {
+    const unordered_set<string>& full_root_paths,
+    const unordered_set<string>& excluded_root_paths) {
   LogBlockContainer* container = nullptr;
   int64_t disk_full_containers_delta = 0;
   MonoTime now = MonoTime::Now();
@@ -1460,10 +1999,16 @@ LogBlockContainer* LogBlockManager::GetAvailableContainer(
     }
 
     // Return the first currently-available non-full-disk container (according to
-    // our full-disk cache).
-    while (!container && !available_containers_.empty()) {
-      container = available_containers_.front();
-      available_containers_.pop_front();
+    // our full-disk cache) outside of the excluded root paths.
+    auto it = available_containers_.begin();
+    while (!container && it != available_containers_.end()) {
+      container = *it;
+      if (ContainsKey(excluded_root_paths, container->root_path())) {
+        container = nullptr;
+        ++it;
+        continue;
+      }
+      it = available_containers_.erase(it);
       MonoTime expires;
       // Note: We must check 'full_disk_cache_' before 'full_root_paths' in
       // order to correctly use the expiry time provided by 'full_disk_cache_'.
@@ -1498,6 +2043,7 @@ void LogBlockManager::MakeContainerAvailable(LogBlockContainer* container) {
 void LogBlockManager::MakeContainerAvailableUnlocked(LogBlockContainer* container) {
   DCHECK(lock_.is_locked());
   if (container->full()) {
+    full_containers_.push_back(container);
     return;
   }
   available_containers_.push_back(container);
@@ -1562,6 +2108,7 @@ bool LogBlockManager::AddLogBlockUnlocked(const scoped_refptr<LogBlock>& lb) {
   // There may already be an entry in open_block_ids_ (e.g. we just finished
   // writing out a block).
   open_block_ids_.erase(lb->block_id());
+  lb->container()->UpdateLiveBytes(lb->length());
   if (metrics()) {
     metrics()->blocks_under_management->Increment();
     metrics()->bytes_under_management->IncrementBy(lb->length());
@@ -1575,6 +2122,7 @@ scoped_refptr<LogBlock> LogBlockManager::RemoveLogBlock(const BlockId& block_id)
       EraseKeyReturnValuePtr(&blocks_by_block_id_, block_id);
   if (result) {
     mem_tracker_->Release(kudu_malloc_usable_size(result.get()));
+    result->container()->UpdateLiveBytes(-result->length());
 
     if (metrics()) {
       metrics()->blocks_under_management->Decrement();
@@ -1631,6 +2179,14 @@ void LogBlockManager::OpenRootPath(const string& root_path,
     return;
   }
   for (const string& child : children) {
+    // Remove the leftovers of metadata compactions which didn't complete.
+    if (!read_only_ &&
+        child.find(StrCat(kContainerMetadataFileSuffix, kContainerTmpInfix)) != string::npos) {
+      string tmp_path = JoinPathSegments(root_path, child);
+      LOG(INFO) << "Deleting incomplete container metadata " << tmp_path;
+      WARN_NOT_OK(env_->DeleteFile(tmp_path), "Could not delete " + tmp_path);
+      continue;
+    }
     string id;
     if (!TryStripSuffixString(child, LogBlockManager::kContainerMetadataFileSuffix, &id)) {
       continue;
@@ -1678,8 +2234,13 @@ void LogBlockManager::OpenRootPath(const string& root_path,
     }
     next_block_id_.StoreMax(max_block_id + 1);
 
+    if (!read_only_) {
+      MaybeCompactContainerMetadata(container.get(), records, blocks_in_container);
+    }
+
     // Under the lock, merge this map into the main block map and add
     // the container.
+    vector<scoped_refptr<LogBlock>> duplicates;
     {
       std::lock_guard<simple_spinlock> l(lock_);
       // To avoid cacheline contention during startup, we aggregate all of the
@@ -1688,9 +2249,17 @@ void LogBlockManager::OpenRootPath(const string& root_path,
       int64_t mem_usage = 0;
       for (const UntrackedBlockMap::value_type& e : blocks_in_container) {
         if (!AddLogBlockUnlocked(e.second)) {
-          LOG(FATAL) << "Found duplicate CREATE record for block " << e.first
-                     << " which already is alive from another container when "
-                     << " processing container " << container->ToString();
+          // A block relocated by container compaction is alive in both its
+          // old and new containers if the DELETE record in the old one was
+          // lost in a crash. Both copies are intact then, so either will do.
+          const scoped_refptr<LogBlock>& existing = FindOrDie(blocks_by_block_id_, e.first);
+          if (existing->length() != e.second->length()) {
+            LOG(FATAL) << "Found duplicate CREATE record for block " << e.first
+                       << " which already is alive from another container when "
+                       << " processing container " << container->ToString();
+          }
+          duplicates.push_back(e.second);
+          continue;
         }
         mem_usage += kudu_malloc_usable_size(e.second.get());
       }
@@ -1699,12 +2268,84 @@ void LogBlockManager::OpenRootPath(const string& root_path,
       AddNewContainerUnlocked(container.get());
       MakeContainerAvailableUnlocked(container.release());
     }
+
+    // Record the deletion of the duplicate copies, so that they aren't found
+    // again. Their space isn't freed, as the other copies' records may not
+    // be durable either.
+    for (const scoped_refptr<LogBlock>& lb : duplicates) {
+      LOG(WARNING) << "Found block " << lb->block_id() << " alive in container "
+                   << lb->container()->ToString() << " and another container, "
+                   << "likely left over from an interrupted container compaction; "
+                   << "dropping the copy in " << lb->container()->ToString();
+      if (read_only_) {
+        continue;
+      }
+      BlockRecordPB record;
+      lb->block_id().CopyToPB(record.mutable_block_id());
+      record.set_op_type(DELETE);
+      record.set_timestamp_us(GetCurrentTimeMicros());
+      WARN_NOT_OK(lb->container()->AppendMetadata(record),
+                  "Unable to append deletion record to block metadata");
+    }
   }
 
   *result_status = Status::OK();
   *result_metadata = metadata.release();
 }
 
+void LogBlockManager::MaybeCompactContainerMetadata(LogBlockContainer* container,
+                                                    const deque<BlockRecordPB>& records,
+                                                    const UntrackedBlockMap& live_blocks) {
+  if (static_cast<int64_t>(records.size()) < FLAGS_log_container_metadata_compact_min_records ||
+      live_blocks.size() >=
+          records.size() * FLAGS_log_container_live_metadata_before_compact_ratio) {
+    return;
+  }
+
+  // Keep the CREATE records of the live blocks. The dead blocks with the
+  // largest ID and the furthest end are kept too, along with a DELETE, so
+  // that the next block ID and the container's size are derived as before.
+  const BlockRecordPB* last_create = nullptr;
+  const BlockRecordPB* max_id_create = nullptr;
+  for (const BlockRecordPB& r : records) {
+    if (r.op_type() != CREATE) {
+      continue;
+    }
+    if (!last_create || r.offset() > last_create->offset()) {
+      last_create = &r;
+    }
+    if (!max_id_create || r.block_id().id() > max_id_create->block_id().id()) {
+      max_id_create = &r;
+    }
+  }
+  vector<BlockRecordPB> compacted;
+  for (const BlockRecordPB& r : records) {
+    if (r.op_type() != CREATE) {
+      continue;
+    }
+    const scoped_refptr<LogBlock>* live = FindOrNull(live_blocks,
+                                                     BlockId::FromPB(r.block_id()));
+    if (live && (*live)->offset() == r.offset()) {
+      compacted.push_back(r);
+    } else if (&r == last_create || &r == max_id_create) {
+      compacted.push_back(r);
+      BlockRecordPB deleted;
+      deleted.mutable_block_id()->CopyFrom(r.block_id());
+      deleted.set_op_type(DELETE);
+      deleted.set_timestamp_us(r.timestamp_us());
+      compacted.push_back(deleted);
+    }
+  }
+
+  Status s;
+  LOG_TIMING(INFO, Substitute("compacting metadata of container $0 from $1 to $2 records",
+                              container->ToString(), records.size(), compacted.size())) {
+    s = container->CompactMetadata(compacted);
+  }
+  // On failure, the original metadata is left in place.
+  WARN_NOT_OK(s, "Could not compact metadata of container " + container->ToString());
+}
+
 void LogBlockManager::ProcessBlockRecord(const BlockRecordPB& record,
                                          LogBlockContainer* container,
                                          UntrackedBlockMap* block_map) {
@@ -1731,7 +2372,7 @@ void LogBlockManager::ProcessBlockRecord(const BlockRecordPB& record,
       //
       // If we ignored deleted blocks, we would end up reusing the space
       // belonging to the last deleted block in the container.
-      container->UpdateBytesWritten(record.length());
+      container->UpdateBytesWrittenForBlockRecord(record.offset(), record.length());
       break;
     }
     case DELETE:
@@ -30,7 +30,9 @@
 
 #include "kudu/fs/block_id.h"
 #include "kudu/fs/block_manager.h"
+#include "kudu/fs/data_dir_latency_tracker.h"
 #include "kudu/fs/fs.pb.h"
+#include "kudu/fs/io_throttler.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/atomic.h"
@@ -49,6 +51,8 @@ class PathInstanceMetadataFile;
 namespace internal {
 class LogBlock;
 class LogBlockContainer;
+class LogBlockContainerCompactionOp;
+class LogWritableBlock;
 
 struct LogBlockManagerMetrics;
 } // namespace internal
@@ -80,6 +84,13 @@ struct LogBlockManagerMetrics;
 // compacted, as it is expected to remain quite small even after a great
 // many create/delete cycles.
 //
+// A full container whose blocks have mostly been deleted is compacted in
+// the background by a maintenance op, which copies its live blocks into
+// other containers. Each copy keeps its block's ID; it's made durable
+// before it replaces the original in memory, and the original is only
+// freed once its DELETE record is durable. A crash in between leaves two
+// intact copies of the block, one of which is dropped on the next startup.
+//
 // Data and metadata operations are carefully ordered to ensure the
 // correctness of the persistent representation at all times. During the
 // writable block lifecycle (i.e. when a block is being created), data
@@ -171,6 +182,10 @@ class LogBlockManager : public BlockManager {
   static const char* kContainerMetadataFileSuffix;
   static const char* kContainerDataFileSuffix;
 
+  // Infix of the temporary files metadata is compacted into, following the
+  // metadata file suffix.
+  static const char* kContainerTmpInfix;
+
   LogBlockManager(Env* env, const BlockManagerOptions& opts);
 
   virtual ~LogBlockManager();
@@ -191,13 +206,26 @@ class LogBlockManager : public BlockManager {
 
   virtual Status CloseBlocks(const std::vector<WritableBlock*>& blocks) OVERRIDE;
 
+  virtual void RegisterMaintenanceOps(MaintenanceManager* manager) OVERRIDE;
+
+  virtual void UnregisterMaintenanceOps() OVERRIDE;
+
+  virtual void GetDegradedRootPaths(std::vector<std::string>* root_paths) const OVERRIDE;
+
+  // Tracks the I/O latency of each root path.
+  DataDirLatencyTracker* latency_tracker() { return &latency_tracker_; }
+
   // Return the number of blocks stored in the block manager.
   int64_t CountBlocksForTests() const;
 
  private:
+  FRIEND_TEST(LogBlockManagerTest, TestCompactContainer);
+  FRIEND_TEST(LogBlockManagerTest, TestCompactMetadata);
   FRIEND_TEST(LogBlockManagerTest, TestReuseBlockIds);
   FRIEND_TEST(LogBlockManagerTest, TestMetadataTruncation);
   friend class internal::LogBlockContainer;
+  friend class internal::LogBlockContainerCompactionOp;
+  friend class internal::LogWritableBlock;
 
   // Simpler typedef for a block map which isn't tracked in the memory tracker.
   // Used during startup.
@@ -225,6 +253,26 @@ class LogBlockManager : public BlockManager {
     }
   };
 
+  // Like CreateBlock(), but if 'relocated_from' is set, the new block is a
+  // copy of it with the same ID, to be swapped in by RelocateBlock().
+  Status CreateBlockInternal(const CreateBlockOptions& opts,
+                             const scoped_refptr<internal::LogBlock>& relocated_from,
+                             gscoped_ptr<WritableBlock>* block);
+
+  // Returns the full container with the smallest ratio of live bytes to
+  // bytes written, if below --log_container_compaction_live_ratio, setting
+  // 'live_ratio' to the ratio. Returns null if there's none.
+  internal::LogBlockContainer* FindContainerToCompact(double* live_ratio) const;
+
+  // Relocates the live blocks of 'container' into other containers.
+  Status CompactContainer(internal::LogBlockContainer* container);
+
+  // Copies 'lb' into another container and swaps the copy in for it,
+  // setting 'relocated' if it did. 'lb' isn't relocated if it was deleted
+  // meanwhile. On success, the caller must delete 'lb' once its container's
+  // metadata is synchronized.
+  Status RelocateBlock(const scoped_refptr<internal::LogBlock>& lb, bool* relocated);
+
   // Adds an as of yet unseen container to this block manager.
   void AddNewContainerUnlocked(internal::LogBlockContainer* container);
 
@@ -236,9 +284,11 @@ class LogBlockManager : public BlockManager {
   // available to other writers.
   //
   // 'full_root_paths' is a blacklist containing root paths that are full.
-  // Containers with root paths in this list will not be returned.
+  // Containers with root paths in this list will not be returned, nor will
+  // those with root paths in 'excluded_root_paths'.
   internal::LogBlockContainer* GetAvailableContainer(
-      const std::unordered_set<std::string>& full_root_paths);
+      const std::unordered_set<std::string>& full_root_paths,
+      const std::unordered_set<std::string>& excluded_root_paths);
 
   // Indicate that this container is no longer in use and can be handed out
   // to other writers.
@@ -280,6 +330,13 @@ class LogBlockManager : public BlockManager {
                           internal::LogBlockContainer* container,
                           UntrackedBlockMap* block_map);
 
+  // Rewrites the metadata of 'container', read as 'records' at startup, if
+  // few enough of them describe 'live_blocks'.
+  // See --log_container_live_metadata_before_compact_ratio.
+  void MaybeCompactContainerMetadata(internal::LogBlockContainer* container,
+                                     const std::deque<BlockRecordPB>& records,
+                                     const UntrackedBlockMap& live_blocks);
+
   // Open a particular root path belonging to the block manager.
   //
   // Success or failure is set in 'result_status'. On success, also sets
@@ -298,6 +355,8 @@ class LogBlockManager : public BlockManager {
 
   Env* env() const { return env_; }
 
+  bool direct_reads() const { return direct_reads_; }
+
   // Return the path of the given container. Only for use by tests.
   static std::string ContainerPathForTests(internal::LogBlockContainer* container);
 
@@ -331,6 +390,11 @@ class LogBlockManager : public BlockManager {
   // Does not own the containers.
   std::deque<internal::LogBlockContainer*> available_containers_;
 
+  // Holds the containers that are full, in the order they filled up.
+  //
+  // Does not own the containers.
+  std::vector<internal::LogBlockContainer*> full_containers_;
+
   // Holds only those containers that would be available, were they not on
   // disks that are past their capacity. This priority queue consists of pairs
   // of containers and timestamps. Those timestamps represent the next time
@@ -350,6 +414,9 @@ class LogBlockManager : public BlockManager {
   // If true, only read operations are allowed.
   const bool read_only_;
 
+  // If true, block data is read with direct I/O.
+  const bool direct_reads_;
+
   // Filesystem paths where all block directories are found.
   const std::vector<std::string> root_paths_;
 
@@ -380,6 +447,16 @@ class LogBlockManager : public BlockManager {
   // May be null if instantiated without metrics.
   gscoped_ptr<internal::LogBlockManagerMetrics> metrics_;
 
+  // Rate limits appends to background blocks.
+  IOThrottler io_throttler_;
+
+  // Tracks the I/O latency of each root path, to avoid the degraded ones.
+  mutable DataDirLatencyTracker latency_tracker_;
+
+  // Compacts sparse full containers. Only set while registered with a
+  // maintenance manager.
+  gscoped_ptr<internal::LogBlockContainerCompactionOp> compaction_op_;
+
   DISALLOW_COPY_AND_ASSIGN(LogBlockManager);
 };
 
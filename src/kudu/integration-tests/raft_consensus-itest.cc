@@ -540,6 +540,11 @@ TEST_F(RaftConsensusITest, TestInsertOnNonLeader) {
   // TODO: need to change the error code to be something like REPLICA_NOT_LEADER
   // so that the client can properly handle this case! plumbing this is a little difficult
   // so not addressing at the moment.
+
+  // The follower points the client at the leader.
+  TServerDetails* leader = nullptr;
+  ASSERT_OK(GetLeaderReplicaWithRetries(tablet_id_, &leader));
+  ASSERT_EQ(leader->uuid(), resp.error().leader_uuid());
   ASSERT_ALL_REPLICAS_AGREE(0);
 }
 
@@ -0,0 +1,180 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <vector>
+
+#include "kudu/common/partial_row.h"
+#include "kudu/common/partition.h"
+#include "kudu/common/schema.h"
+#include "kudu/master/auto_range_partitioner.h"
+#include "kudu/master/master.pb.h"
+#include "kudu/util/test_macros.h"
+
+using std::numeric_limits;
+using std::vector;
+
+namespace kudu {
+namespace master {
+
+typedef AutoRangePartitioner::Range Range;
+
+namespace {
+
+RangePartitionIntervalPB MakePolicy(int64_t interval, int num_ahead, int64_t retention) {
+  RangePartitionIntervalPB policy;
+  policy.set_interval_usec(interval);
+  policy.set_num_ahead(num_ahead);
+  policy.set_retention_usec(retention);
+  return policy;
+}
+
+} // anonymous namespace
+
+// Test that the current and upcoming range partitions are added, aligned to
+// the interval, unless they overlap existing ones.
+TEST(AutoRangePartitionerTest, TestAddRanges) {
+  vector<Range> to_add;
+  vector<Range> to_drop;
+  AutoRangePartitioner::Plan(MakePolicy(100, 2, 0), 250, {}, &to_add, &to_drop);
+  ASSERT_EQ(3, to_add.size());
+  ASSERT_EQ(200, to_add[0].lower);
+  ASSERT_EQ(300, to_add[0].upper);
+  ASSERT_EQ(400, to_add[2].lower);
+  ASSERT_EQ(500, to_add[2].upper);
+  ASSERT_TRUE(to_drop.empty());
+
+  // Times before the epoch are aligned down too.
+  to_add.clear();
+  AutoRangePartitioner::Plan(MakePolicy(100, 0, 0), -50, {}, &to_add, &to_drop);
+  ASSERT_EQ(1, to_add.size());
+  ASSERT_EQ(-100, to_add[0].lower);
+
+  // Existing ranges, even unaligned ones, are left alone.
+  to_add.clear();
+  AutoRangePartitioner::Plan(MakePolicy(100, 2, 0), 250,
+                             { { 200, 300 }, { 200, 300 }, { 350, 420 } },
+                             &to_add, &to_drop);
+  ASSERT_TRUE(to_add.empty());
+
+  to_add.clear();
+  AutoRangePartitioner::Plan(MakePolicy(100, 3, 0), 250, { { 200, 300 } }, &to_add, &to_drop);
+  ASSERT_EQ(3, to_add.size());
+  ASSERT_EQ(300, to_add[0].lower);
+
+  // An unbounded range leaves no room for more.
+  to_add.clear();
+  AutoRangePartitioner::Plan(MakePolicy(100, 2, 0), 250,
+                             { { numeric_limits<int64_t>::min(), numeric_limits<int64_t>::max() } },
+                             &to_add, &to_drop);
+  ASSERT_TRUE(to_add.empty());
+  ASSERT_TRUE(to_drop.empty());
+}
+
+// Test that range partitions are dropped once they're older than the
+// retention, except for unbounded ones.
+TEST(AutoRangePartitionerTest, TestDropRanges) {
+  vector<Range> existing = {
+    { numeric_limits<int64_t>::min(), 0 },
+    { 0, 100 },
+    { 0, 100 },
+    { 100, 200 },
+    { 200, 300 },
+  };
+  vector<Range> to_add;
+  vector<Range> to_drop;
+  AutoRangePartitioner::Plan(MakePolicy(100, 0, 50), 250, existing, &to_add, &to_drop);
+  ASSERT_TRUE(to_add.empty());
+  ASSERT_EQ(2, to_drop.size());
+  ASSERT_EQ(0, to_drop[0].lower);
+  ASSERT_EQ(100, to_drop[1].lower);
+
+  // Without a retention, nothing is dropped.
+  to_drop.clear();
+  AutoRangePartitioner::Plan(MakePolicy(100, 0, 0), 250, existing, &to_add, &to_drop);
+  ASSERT_TRUE(to_drop.empty());
+}
+
+TEST(AutoRangePartitionerTest, TestValidatePolicy) {
+  Schema schema({ ColumnSchema("ts", UNIXTIME_MICROS),
+                  ColumnSchema("id", INT64),
+                  ColumnSchema("v", INT32) },
+                { ColumnId(0), ColumnId(1), ColumnId(2) }, 2);
+  PartitionSchemaPB pb;
+  pb.mutable_range_schema()->add_columns()->set_name("ts");
+  PartitionSchema partition_schema;
+  ASSERT_OK(PartitionSchema::FromPB(pb, schema, &partition_schema));
+  ASSERT_OK(AutoRangePartitioner::ValidatePolicy(schema, partition_schema,
+                                                 MakePolicy(100, 3, 0)));
+  for (const auto& policy : { MakePolicy(0, 3, 0), MakePolicy(100, -1, 0),
+                              MakePolicy(100, 3, -1) }) {
+    Status s = AutoRangePartitioner::ValidatePolicy(schema, partition_schema, policy);
+    ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  }
+
+  // The range partition column must be a single UNIXTIME_MICROS column.
+  pb.mutable_range_schema()->mutable_columns(0)->set_name("id");
+  ASSERT_OK(PartitionSchema::FromPB(pb, schema, &partition_schema));
+  Status s = AutoRangePartitioner::ValidatePolicy(schema, partition_schema,
+                                                  MakePolicy(100, 3, 0));
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+
+  ASSERT_OK(PartitionSchema::FromPB(PartitionSchemaPB(), schema, &partition_schema));
+  s = AutoRangePartitioner::ValidatePolicy(schema, partition_schema, MakePolicy(100, 3, 0));
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+}
+
+// Test that the range bounds of partitions are decoded, including those of
+// hash partitioned tables.
+TEST(AutoRangePartitionerTest, TestDecodeRange) {
+  Schema schema({ ColumnSchema("ts", UNIXTIME_MICROS), ColumnSchema("v", INT32) },
+                { ColumnId(0), ColumnId(1) }, 2);
+  PartitionSchemaPB pb;
+  pb.mutable_range_schema()->add_columns()->set_name("ts");
+  auto* hash = pb.add_hash_bucket_schemas();
+  hash->add_columns()->set_name("v");
+  hash->set_num_buckets(2);
+  PartitionSchema partition_schema;
+  ASSERT_OK(PartitionSchema::FromPB(pb, schema, &partition_schema));
+
+  KuduPartialRow lower(&schema);
+  KuduPartialRow upper(&schema);
+  ASSERT_OK(lower.SetUnixTimeMicros(0, -100));
+  ASSERT_OK(upper.SetUnixTimeMicros(0, 200));
+  vector<Partition> partitions;
+  ASSERT_OK(partition_schema.CreatePartitions({}, { { lower, upper } }, schema, &partitions));
+  ASSERT_EQ(2, partitions.size());
+  for (const auto& partition : partitions) {
+    Range range;
+    ASSERT_OK(AutoRangePartitioner::DecodeRange(partition, &range));
+    ASSERT_EQ(-100, range.lower);
+    ASSERT_EQ(200, range.upper);
+  }
+
+  // Unbounded ranges decode to the limits.
+  partitions.clear();
+  ASSERT_OK(partition_schema.CreatePartitions({}, {}, schema, &partitions));
+  Range range;
+  ASSERT_OK(AutoRangePartitioner::DecodeRange(partitions[0], &range));
+  ASSERT_EQ(numeric_limits<int64_t>::min(), range.lower);
+  ASSERT_EQ(numeric_limits<int64_t>::max(), range.upper);
+}
+
+} // namespace master
+} // namespace kudu
@@ -0,0 +1,136 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/master/auto_range_partitioner.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "kudu/common/key_encoder.h"
+#include "kudu/common/partition.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/master/master.pb.h"
+#include "kudu/util/faststring.h"
+
+using std::numeric_limits;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace master {
+
+// Bounds the number of range partitions created ahead of time, which are
+// all created at once.
+static const int kMaxNumAhead = 1000;
+
+Status AutoRangePartitioner::ValidatePolicy(const Schema& schema,
+                                            const PartitionSchema& partition_schema,
+                                            const RangePartitionIntervalPB& policy) {
+  if (policy.interval_usec() <= 0) {
+    return Status::InvalidArgument(
+        Substitute("range partition interval must be positive: $0", policy.interval_usec()));
+  }
+  if (policy.num_ahead() < 0 || policy.num_ahead() > kMaxNumAhead) {
+    return Status::InvalidArgument(
+        Substitute("number of range partitions created ahead must be between 0 and $0: $1",
+                   kMaxNumAhead, policy.num_ahead()));
+  }
+  if (policy.retention_usec() < 0) {
+    return Status::InvalidArgument(
+        Substitute("range partition retention must not be negative: $0",
+                   policy.retention_usec()));
+  }
+  const vector<ColumnId>& column_ids = partition_schema.range_column_ids();
+  if (column_ids.size() != 1) {
+    return Status::InvalidArgument(
+        Substitute("range partition interval requires a single range partition column, "
+                   "but the table has $0", column_ids.size()));
+  }
+  const ColumnSchema& col = schema.column_by_id(column_ids[0]);
+  if (col.type_info()->type() != UNIXTIME_MICROS) {
+    return Status::InvalidArgument(
+        Substitute("range partition interval requires a UNIXTIME_MICROS range partition "
+                   "column, but column $0 has type $1", col.name(), col.type_info()->name()));
+  }
+  return Status::OK();
+}
+
+void AutoRangePartitioner::Plan(const RangePartitionIntervalPB& policy,
+                                int64_t now_usec,
+                                vector<Range> existing,
+                                vector<Range>* to_add,
+                                vector<Range>* to_drop) {
+  const int64_t interval = policy.interval_usec();
+  DCHECK_GT(interval, 0);
+
+  // The tablets of hash partitioned tables share their ranges.
+  std::sort(existing.begin(), existing.end(), [] (const Range& a, const Range& b) {
+    return a.lower < b.lower || (a.lower == b.lower && a.upper < b.upper);
+  });
+  existing.erase(std::unique(existing.begin(), existing.end(),
+                             [] (const Range& a, const Range& b) {
+                               return a.lower == b.lower && a.upper == b.upper;
+                             }), existing.end());
+
+  int64_t lower = now_usec - ((now_usec % interval) + interval) % interval;
+  for (int i = 0; i <= policy.num_ahead(); i++) {
+    if (lower > numeric_limits<int64_t>::max() - interval) {
+      break;
+    }
+    Range range = { lower, lower + interval };
+    bool overlaps = std::any_of(existing.begin(), existing.end(), [&] (const Range& r) {
+      return r.lower < range.upper && range.lower < r.upper;
+    });
+    if (!overlaps) {
+      to_add->push_back(range);
+    }
+    lower = range.upper;
+  }
+
+  if (policy.retention_usec() > 0 &&
+      now_usec > numeric_limits<int64_t>::min() + policy.retention_usec()) {
+    int64_t cutoff = now_usec - policy.retention_usec();
+    for (const Range& r : existing) {
+      if (r.lower != numeric_limits<int64_t>::min() &&
+          r.upper != numeric_limits<int64_t>::max() &&
+          r.upper <= cutoff) {
+        to_drop->push_back(r);
+      }
+    }
+  }
+}
+
+Status AutoRangePartitioner::DecodeRange(const Partition& partition, Range* range) {
+  const KeyEncoder<faststring>& encoder = GetKeyEncoder<faststring>(GetTypeInfo(INT64));
+  range->lower = numeric_limits<int64_t>::min();
+  range->upper = numeric_limits<int64_t>::max();
+  Slice lower = partition.range_key_start();
+  if (!lower.empty()) {
+    RETURN_NOT_OK(encoder.Decode(&lower, true, nullptr,
+                                 reinterpret_cast<uint8_t*>(&range->lower)));
+  }
+  Slice upper = partition.range_key_end();
+  if (!upper.empty()) {
+    RETURN_NOT_OK(encoder.Decode(&upper, true, nullptr,
+                                 reinterpret_cast<uint8_t*>(&range->upper)));
+  }
+  return Status::OK();
+}
+
+} // namespace master
+} // namespace kudu
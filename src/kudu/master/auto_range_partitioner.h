@@ -0,0 +1,76 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_MASTER_AUTO_RANGE_PARTITIONER_H
+#define KUDU_MASTER_AUTO_RANGE_PARTITIONER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class Partition;
+class PartitionSchema;
+class Schema;
+
+namespace master {
+
+class RangePartitionIntervalPB;
+
+// Plans the range partitions which the master creates and drops for a table
+// with a RangePartitionIntervalPB, so that time-sliced tables don't depend
+// on an external job to add a range partition before rows reach it.
+//
+// The table must be range partitioned on a single UNIXTIME_MICROS column.
+// Its range partitions are aligned to multiples of the interval, except for
+// those created otherwise, which are left alone unless they're too old.
+class AutoRangePartitioner {
+ public:
+  // The inclusive lower bound and exclusive upper bound of a range
+  // partition, in microseconds. Unbounded sides are the minimum or maximum
+  // int64_t.
+  struct Range {
+    int64_t lower;
+    int64_t upper;
+  };
+
+  // Returns an error unless 'policy' is valid and can manage the range
+  // partitions of a table with the given schema and partition schema.
+  static Status ValidatePolicy(const Schema& schema,
+                               const PartitionSchema& partition_schema,
+                               const RangePartitionIntervalPB& policy);
+
+  // Plans, given the 'existing' range partitions of a table, the range
+  // partitions to add so that the one containing 'now_usec' and the next
+  // 'num_ahead' exist, and the ones to drop since they end more than the
+  // retention before 'now_usec'. Aligned range partitions which overlap an
+  // existing one aren't added, and unbounded ones are never dropped.
+  static void Plan(const RangePartitionIntervalPB& policy,
+                   int64_t now_usec,
+                   std::vector<Range> existing,
+                   std::vector<Range>* to_add,
+                   std::vector<Range>* to_drop);
+
+  // Decodes the range bounds of 'partition', of a table whose range
+  // partition column is a single 64-bit integer column.
+  static Status DecodeRange(const Partition& partition, Range* range);
+};
+
+} // namespace master
+} // namespace kudu
+#endif /* KUDU_MASTER_AUTO_RANGE_PARTITIONER_H */
@@ -83,6 +83,33 @@ TEST(TableInfoTest, TestAssignmentRanges) {
   }
 }
 
+// Test that cached tablet locations are dropped once the tablet's metadata
+// is mutated.
+TEST(TableInfoTest, TestCachedLocations) {
+  scoped_refptr<TableInfo> table(new TableInfo(CURRENT_TEST_NAME()));
+  scoped_refptr<TabletInfo> tablet(new TabletInfo(table, "tablet"));
+  ASSERT_EQ(nullptr, tablet->GetCachedLocations());
+
+  std::shared_ptr<TabletLocationsPB> locations(new TabletLocationsPB);
+  locations->set_tablet_id(tablet->tablet_id());
+  tablet->SetCachedLocations(tablet->metadata().version(), locations);
+  ASSERT_EQ(locations, tablet->GetCachedLocations());
+
+  // An aborted mutation leaves the locations current.
+  {
+    TabletMetadataLock l(tablet.get(), TabletMetadataLock::WRITE);
+    l.mutable_data()->pb.set_state(SysTabletsEntryPB::RUNNING);
+  }
+  ASSERT_EQ(locations, tablet->GetCachedLocations());
+
+  {
+    TabletMetadataLock l(tablet.get(), TabletMetadataLock::WRITE);
+    l.mutable_data()->pb.set_state(SysTabletsEntryPB::RUNNING);
+    l.Commit();
+  }
+  ASSERT_EQ(nullptr, tablet->GetCachedLocations());
+}
+
 TEST(TestTSDescriptor, TestReplicaCreationsDecay) {
   TSDescriptor ts("test");
   ASSERT_EQ(0, ts.RecentReplicaCreations());
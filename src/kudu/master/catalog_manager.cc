@@ -52,6 +52,7 @@
 #include <utility>
 #include <vector>
 
+#include "kudu/cfile/compression_codec.h"
 #include "kudu/cfile/type_encodings.h"
 #include "kudu/common/key_util.h"
 #include "kudu/common/partial_row.h"
@@ -71,6 +72,7 @@
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/sysinfo.h"
 #include "kudu/gutil/walltime.h"
+#include "kudu/master/auto_range_partitioner.h"
 #include "kudu/master/master.h"
 #include "kudu/master/master.pb.h"
 #include "kudu/master/sys_catalog.h"
@@ -78,6 +80,7 @@
 #include "kudu/master/ts_manager.h"
 #include "kudu/rpc/messenger.h"
 #include "kudu/rpc/rpc_context.h"
+#include "kudu/tablet/compaction_policy.h"
 #include "kudu/tserver/tserver_admin.proxy.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/flag_tags.h"
@@ -100,6 +103,13 @@ DEFINE_int32(tablet_creation_timeout_ms, 30 * 1000, // 30 sec
              "replicas during table creation.");
 TAG_FLAG(tablet_creation_timeout_ms, advanced);
 
+DEFINE_int32(master_create_tablets_batch_size, 100,
+             "Maximum number of new tablet replicas the master creates on a "
+             "tablet server in one CreateTablets RPC. If 1, tablet replicas are "
+             "created with one CreateTablet RPC each.");
+TAG_FLAG(master_create_tablets_batch_size, advanced);
+TAG_FLAG(master_create_tablets_batch_size, runtime);
+
 DEFINE_bool(catalog_manager_wait_for_new_tablets_to_elect_leader, true,
             "Whether the catalog manager should wait for a newly created tablet to "
             "elect a leader before considering it successfully created. "
@@ -167,6 +177,114 @@ DEFINE_bool(catalog_manager_delete_orphaned_tablets, false,
             "master failures!");
 TAG_FLAG(catalog_manager_delete_orphaned_tablets, advanced);
 
+DEFINE_double(replica_placement_replicas_weight, 1.0,
+              "Weight given to the number of tablet replicas on, and recently "
+              "placed on, a tablet server when choosing where to place a new replica.");
+TAG_FLAG(replica_placement_replicas_weight, advanced);
+TAG_FLAG(replica_placement_replicas_weight, runtime);
+
+DEFINE_double(replica_placement_disk_weight, 1.0,
+              "Weight given to the free space of a tablet server's data "
+              "directories when choosing where to place a new replica.");
+TAG_FLAG(replica_placement_disk_weight, advanced);
+TAG_FLAG(replica_placement_disk_weight, runtime);
+
+DEFINE_double(replica_placement_cpu_weight, 0.0,
+              "Weight given to the CPU utilization of a tablet server when "
+              "choosing where to place a new replica.");
+TAG_FLAG(replica_placement_cpu_weight, experimental);
+TAG_FLAG(replica_placement_cpu_weight, runtime);
+
+DEFINE_double(replica_placement_memory_weight, 0.0,
+              "Weight given to the memory pressure of a tablet server when "
+              "choosing where to place a new replica.");
+TAG_FLAG(replica_placement_memory_weight, experimental);
+TAG_FLAG(replica_placement_memory_weight, runtime);
+
+DEFINE_double(replica_placement_write_rate_weight, 0.0,
+              "Weight given to the rate of rows written to a tablet server "
+              "when choosing where to place a new replica.");
+TAG_FLAG(replica_placement_write_rate_weight, experimental);
+TAG_FLAG(replica_placement_write_rate_weight, runtime);
+
+DEFINE_double(replica_placement_scan_rate_weight, 0.0,
+              "Weight given to the rate of rows scanned from a tablet server "
+              "when choosing where to place a new replica.");
+TAG_FLAG(replica_placement_scan_rate_weight, experimental);
+TAG_FLAG(replica_placement_scan_rate_weight, runtime);
+
+DEFINE_double(replica_placement_leaders_weight, 0.0,
+              "Weight given to the number of leader replicas on a tablet "
+              "server when choosing where to place a new replica.");
+TAG_FLAG(replica_placement_leaders_weight, experimental);
+TAG_FLAG(replica_placement_leaders_weight, runtime);
+
+DEFINE_bool(master_rebalancer_enabled, false,
+            "Whether the leader master should move tablet replicas and "
+            "leaders between tablet servers to even out the number of "
+            "replicas and leaders per tablet server, overall and per table.");
+TAG_FLAG(master_rebalancer_enabled, experimental);
+TAG_FLAG(master_rebalancer_enabled, runtime);
+
+DEFINE_int32(master_rebalancer_interval_ms, 10 * 1000,
+             "How often the rebalancer checks the balance of the tablet servers.");
+TAG_FLAG(master_rebalancer_interval_ms, advanced);
+
+DEFINE_int32(master_auto_range_partition_interval_ms, 60 * 1000,
+             "How often the leader master creates and drops the range partitions "
+             "of tables with a range partition interval.");
+TAG_FLAG(master_auto_range_partition_interval_ms, advanced);
+
+DEFINE_int32(master_rebalancer_max_concurrent_moves, 1,
+             "The maximum number of tablet replicas the rebalancer moves at "
+             "a time. Each move copies a replica to another tablet server.");
+TAG_FLAG(master_rebalancer_max_concurrent_moves, advanced);
+TAG_FLAG(master_rebalancer_max_concurrent_moves, runtime);
+
+DEFINE_int32(master_rebalancer_max_leader_step_downs, 5,
+             "The maximum number of leaders the rebalancer asks to step down "
+             "each time it checks the balance of the tablet servers.");
+TAG_FLAG(master_rebalancer_max_leader_step_downs, advanced);
+TAG_FLAG(master_rebalancer_max_leader_step_downs, runtime);
+
+DEFINE_int32(master_rebalancer_move_timeout_ms, 30 * 60 * 1000,
+             "The time after which the rebalancer abandons a replica move "
+             "which hasn't completed.");
+TAG_FLAG(master_rebalancer_move_timeout_ms, advanced);
+TAG_FLAG(master_rebalancer_move_timeout_ms, runtime);
+
+DEFINE_bool(master_preload_catalog_on_followers, true,
+            "Whether follower masters should keep a copy of the table and "
+            "tablet metadata loaded in memory, so that they don't need to load "
+            "the whole sys catalog once elected leader.");
+TAG_FLAG(master_preload_catalog_on_followers, advanced);
+TAG_FLAG(master_preload_catalog_on_followers, runtime);
+
+DEFINE_int32(master_preload_catalog_interval_ms, 1000,
+             "How often follower masters reload their copy of the table and "
+             "tablet metadata, if the sys catalog was written to.");
+TAG_FLAG(master_preload_catalog_interval_ms, advanced);
+
+DEFINE_int64(master_split_tablet_size_threshold_mb, 10 * 1024,
+             "On-disk size of a tablet, in MB, above which the master reports "
+             "it as a candidate for splitting. If 0, the size isn't considered.");
+TAG_FLAG(master_split_tablet_size_threshold_mb, advanced);
+TAG_FLAG(master_split_tablet_size_threshold_mb, runtime);
+
+DEFINE_double(master_split_tablet_write_rate_threshold, 50000,
+              "Rate of rows written to a tablet, per second, above which the "
+              "master reports it as a candidate for splitting. If 0, the write "
+              "rate isn't considered.");
+TAG_FLAG(master_split_tablet_write_rate_threshold, advanced);
+TAG_FLAG(master_split_tablet_write_rate_threshold, runtime);
+
+DEFINE_double(master_split_tablet_scan_rate_threshold, 1000000,
+              "Rate of rows returned by scans of a tablet, per second, above "
+              "which the master reports it as a candidate for splitting. If 0, "
+              "the scan rate isn't considered.");
+TAG_FLAG(master_split_tablet_scan_rate_threshold, advanced);
+TAG_FLAG(master_split_tablet_scan_rate_threshold, runtime);
+
 using std::pair;
 using std::shared_ptr;
 using std::string;
@@ -203,13 +321,13 @@ using tserver::TabletServerErrorPB;
 
 class TableLoader : public TableVisitor {
  public:
-  explicit TableLoader(CatalogManager *catalog_manager)
-    : catalog_manager_(catalog_manager) {
+  explicit TableLoader(CatalogManager::LoadedCatalog* catalog)
+    : catalog_(catalog) {
   }
 
   virtual Status VisitTable(const std::string& table_id,
                             const SysTablesEntryPB& metadata) OVERRIDE {
-    CHECK(!ContainsKey(catalog_manager_->table_ids_map_, table_id))
+    CHECK(!ContainsKey(catalog_->table_ids_map, table_id))
           << "Table already exists: " << table_id;
 
     // Set up the table info.
@@ -218,9 +336,9 @@ class TableLoader : public TableVisitor {
     l.mutable_data()->pb.CopyFrom(metadata);
 
     // Add the tablet to the IDs map and to the name map (if the table is not deleted).
-    catalog_manager_->table_ids_map_[table->id()] = table;
+    catalog_->table_ids_map[table->id()] = table;
     if (!l.data().is_deleted()) {
-      catalog_manager_->table_names_map_[l.data().name()] = table;
+      catalog_->table_names_map[l.data().name()] = table;
     }
     l.Commit();
 
@@ -230,7 +348,7 @@ class TableLoader : public TableVisitor {
   }
 
  private:
-  CatalogManager *catalog_manager_;
+  CatalogManager::LoadedCatalog* catalog_;
 
   DISALLOW_COPY_AND_ASSIGN(TableLoader);
 };
@@ -241,16 +359,15 @@ class TableLoader : public TableVisitor {
 
 class TabletLoader : public TabletVisitor {
  public:
-  explicit TabletLoader(CatalogManager *catalog_manager)
-    : catalog_manager_(catalog_manager) {
+  explicit TabletLoader(CatalogManager::LoadedCatalog* catalog)
+    : catalog_(catalog) {
   }
 
   virtual Status VisitTablet(const std::string& table_id,
                              const std::string& tablet_id,
                              const SysTabletsEntryPB& metadata) OVERRIDE {
     // Lookup the table.
-    scoped_refptr<TableInfo> table(FindPtrOrNull(
-        catalog_manager_->table_ids_map_, table_id));
+    scoped_refptr<TableInfo> table(FindPtrOrNull(catalog_->table_ids_map, table_id));
     if (table == nullptr) {
       // Tables and tablets are always created/deleted in one operation, so
       // this shouldn't be possible.
@@ -265,7 +382,7 @@ class TabletLoader : public TabletVisitor {
     l.mutable_data()->pb.CopyFrom(metadata);
 
     // Add the tablet to the tablet manager.
-    catalog_manager_->tablet_map_[tablet->tablet_id()] = tablet;
+    catalog_->tablet_map[tablet->tablet_id()] = tablet;
 
     // Add the tablet to the Tablet.
     bool is_deleted = l.mutable_data()->is_deleted();
@@ -274,14 +391,15 @@ class TabletLoader : public TabletVisitor {
       table->AddTablet(tablet);
     }
 
-    LOG(INFO) << "Loaded metadata for tablet " << tablet_id
-              << " (table " << table->ToString() << ")";
+    // With many tablets, logging each of them slows down the load.
+    VLOG(1) << "Loaded metadata for tablet " << tablet_id
+            << " (table " << table->ToString() << ")";
     VLOG(2) << "Metadata for tablet " << tablet_id << ": " << metadata.ShortDebugString();
     return Status::OK();
   }
 
  private:
-  CatalogManager *catalog_manager_;
+  CatalogManager::LoadedCatalog* catalog_;
 
   DISALLOW_COPY_AND_ASSIGN(TabletLoader);
 };
@@ -358,7 +476,11 @@ void CatalogManagerBgTasks::Shutdown() {
 }
 
 void CatalogManagerBgTasks::Run() {
+  MonoTime last_rebalance;
+  MonoTime last_auto_range_partition;
+  MonoTime last_preload;
   while (!NoBarrier_Load(&closing_)) {
+    bool preload = false;
     {
       CatalogManager::ScopedLeaderSharedLock l(catalog_manager_);
       if (!l.catalog_status().ok()) {
@@ -384,9 +506,39 @@ void CatalogManagerBgTasks::Run() {
                        << s.ToString();
           }
         }
+
+        MonoTime now = MonoTime::Now();
+        if (FLAGS_master_rebalancer_enabled &&
+            (!last_rebalance.Initialized() ||
+             now - last_rebalance >=
+                 MonoDelta::FromMilliseconds(FLAGS_master_rebalancer_interval_ms))) {
+          catalog_manager_->RunRebalancer();
+          last_rebalance = now;
+        }
+        if (!last_auto_range_partition.Initialized() ||
+            now - last_auto_range_partition >=
+                MonoDelta::FromMilliseconds(FLAGS_master_auto_range_partition_interval_ms)) {
+          catalog_manager_->RunAutoRangePartitioning();
+          last_auto_range_partition = now;
+        }
+      } else if (FLAGS_master_preload_catalog_on_followers &&
+                 catalog_manager_->Role() == consensus::RaftPeerPB::FOLLOWER) {
+        MonoTime now = MonoTime::Now();
+        if (!last_preload.Initialized() ||
+            now - last_preload >=
+                MonoDelta::FromMilliseconds(FLAGS_master_preload_catalog_interval_ms)) {
+          preload = true;
+          last_preload = now;
+        }
       }
     }
 
+    // Preload without holding leader_lock_, which a newly elected leader
+    // acquires exclusively.
+    if (preload) {
+      catalog_manager_->PreloadCatalog();
+    }
+
     // Wait for a notification or a timeout expiration.
     //  - CreateTable will call Wake() to notify about the tablets to add
     //  - HandleReportedTablet/ProcessPendingAssignments will call WakeIfHasPendingUpdates()
@@ -550,6 +702,7 @@ Status CheckIfTableDeletedOrNotRunning(TableMetadataLock* lock, RespClass* resp)
 CatalogManager::CatalogManager(Master *master)
   : master_(master),
     rng_(GetRandomSeed32()),
+    rebalancer_(new Rebalancer(master->metric_entity())),
     state_(kConstructed),
     leader_ready_term_(-1),
     leader_lock_(RWMutex::Priority::PREFER_WRITING) {
@@ -669,8 +822,25 @@ Status CatalogManager::VisitTablesAndTablets() {
   // Block new catalog operations, and wait for existing operations to finish.
   std::lock_guard<RWMutex> leader_lock_guard(leader_lock_);
 
-  // This lock is held for the entirety of the function because the calls to
-  // VisitTables and VisitTablets mutate global maps.
+  // Use the preloaded metadata if the sys catalog wasn't written to since it
+  // was loaded. The writes replicated by the previous leader are all applied
+  // by now: WaitUntilCaughtUpAsLeader() waited for their transactions to
+  // finish, and with them the update of the count of written rows.
+  unique_ptr<LoadedCatalog> catalog;
+  {
+    std::lock_guard<simple_spinlock> l(preloaded_catalog_lock_);
+    catalog = std::move(preloaded_catalog_);
+  }
+  if (catalog && catalog->num_rows_written != -1 &&
+      catalog->num_rows_written == sys_catalog_->NumRowsWritten()) {
+    LOG_WITH_PREFIX(INFO) << "Using preloaded table and tablet metadata";
+  } else {
+    catalog.reset(new LoadedCatalog());
+    RETURN_NOT_OK(LoadCatalog(catalog.get()));
+  }
+
+  // Only held to swap in the loaded metadata, so that readers of the maps
+  // aren't blocked while the sys catalog is visited.
   std::lock_guard<LockType> lock(lock_);
 
   // Abort any outstanding tasks. All TableInfos are orphaned below, so
@@ -680,21 +850,52 @@ Status CatalogManager::VisitTablesAndTablets() {
   AppendValuesFromMap(table_ids_map_, &tables);
   AbortAndWaitForAllTasks(tables);
 
-  // Clear the existing state.
-  table_names_map_.clear();
-  table_ids_map_.clear();
-  tablet_map_.clear();
+  table_names_map_.swap(catalog->table_names_map);
+  table_ids_map_.swap(catalog->table_ids_map);
+  tablet_map_.swap(catalog->tablet_map);
+  return Status::OK();
+}
 
-  // Visit tables and tablets, load them into memory.
-  TableLoader table_loader(this);
+Status CatalogManager::LoadCatalog(LoadedCatalog* catalog) {
+  // Read the count before visiting, so that a write missed by the visit
+  // changes it.
+  catalog->num_rows_written = sys_catalog_->NumRowsWritten();
+
+  TableLoader table_loader(catalog);
   RETURN_NOT_OK_PREPEND(sys_catalog_->VisitTables(&table_loader),
                         "Failed while visiting tables in sys catalog");
-  TabletLoader tablet_loader(this);
+  TabletLoader tablet_loader(catalog);
   RETURN_NOT_OK_PREPEND(sys_catalog_->VisitTablets(&tablet_loader),
                         "Failed while visiting tablets in sys catalog");
+  LOG_WITH_PREFIX(INFO) << Substitute("Loaded metadata for $0 tables and $1 tablets",
+                                      catalog->table_ids_map.size(),
+                                      catalog->tablet_map.size());
   return Status::OK();
 }
 
+void CatalogManager::PreloadCatalog() {
+  int64_t num_rows_written = sys_catalog_->NumRowsWritten();
+  if (num_rows_written == -1) {
+    return;
+  }
+  {
+    std::lock_guard<simple_spinlock> l(preloaded_catalog_lock_);
+    if (preloaded_catalog_ && preloaded_catalog_->num_rows_written == num_rows_written) {
+      return;
+    }
+  }
+
+  unique_ptr<LoadedCatalog> catalog(new LoadedCatalog());
+  Status s = LoadCatalog(catalog.get());
+  if (!s.ok()) {
+    LOG_WITH_PREFIX(WARNING) << "Failed to preload table and tablet metadata: "
+                             << s.ToString();
+    return;
+  }
+  std::lock_guard<simple_spinlock> l(preloaded_catalog_lock_);
+  preloaded_catalog_ = std::move(catalog);
+}
+
 Status CatalogManager::InitSysCatalogAsync(bool is_first_run) {
   std::lock_guard<LockType> l(lock_);
   unique_ptr<SysCatalogTable> new_catalog(
@@ -768,6 +969,28 @@ static void SetupError(MasterErrorPB* error,
   error->set_code(code);
 }
 
+// Checks that the tablet servers will be able to compress the column with
+// its compression level, which they only find out when flushing it. A
+// column with the default codec may end up with any codec, so it must have
+// a level every codec accepts.
+static Status ValidateCompressionLevel(const ColumnSchema& col) {
+  const ColumnStorageAttributes& attributes = col.attributes();
+  if (attributes.compression_level == 0) {
+    return Status::OK();
+  }
+  CompressionType compression = attributes.compression;
+  if (compression == DEFAULT_COMPRESSION) {
+    compression = ZSTD;
+  }
+  const cfile::CompressionCodec* codec;
+  Status s = cfile::GetCompressionCodec(compression, attributes.compression_level, &codec);
+  if (!s.ok()) {
+    return Status::InvalidArgument(
+        Substitute("column `$0`: invalid compression level", col.name()), s.message());
+  }
+  return Status::OK();
+}
+
 Status CatalogManager::CheckOnline() const {
   if (PREDICT_FALSE(!IsInitialized())) {
     return Status::ServiceUnavailable("CatalogManager is not running");
@@ -810,6 +1033,13 @@ Status CatalogManager::CreateTable(const CreateTableRequestPB* orig_req,
         return s;
     }
   }
+  for (int i = 0; i < client_schema.num_columns(); i++) {
+    s = ValidateCompressionLevel(client_schema.column(i));
+    if (!s.ok()) {
+      SetupError(resp->mutable_error(), MasterErrorPB::INVALID_SCHEMA, s);
+      return s;
+    }
+  }
   Schema schema = client_schema.CopyWithColumnIds();
 
   // If the client did not set a partition schema in the create table request,
@@ -822,6 +1052,27 @@ Status CatalogManager::CreateTable(const CreateTableRequestPB* orig_req,
     return s;
   }
 
+  if (req.compaction_policy().type() == CompactionPolicyPB::TIME_WINDOWED) {
+    s = tablet::TimeWindowedCompactionPolicy::ValidateConfig(schema, req.compaction_policy());
+    if (!s.ok()) {
+      SetupError(resp->mutable_error(), MasterErrorPB::INVALID_SCHEMA, s);
+      return s;
+    }
+  }
+  s = tablet::ValidateRowTtl(schema, req.compaction_policy());
+  if (!s.ok()) {
+    SetupError(resp->mutable_error(), MasterErrorPB::INVALID_SCHEMA, s);
+    return s;
+  }
+  if (req.has_range_partition_interval()) {
+    s = AutoRangePartitioner::ValidatePolicy(schema, partition_schema,
+                                             req.range_partition_interval());
+    if (!s.ok()) {
+      SetupError(resp->mutable_error(), MasterErrorPB::INVALID_SCHEMA, s);
+      return s;
+    }
+  }
+
   // Decode split rows.
   vector<KuduPartialRow> split_rows;
   vector<pair<KuduPartialRow, KuduPartialRow>> range_bounds;
@@ -866,6 +1117,24 @@ Status CatalogManager::CreateTable(const CreateTableRequestPB* orig_req,
     }
   }
 
+  // Tables with a range partition interval which don't specify their range
+  // partitions start with the current and upcoming ones, rather than with
+  // an unbounded range partition which would leave no room for more.
+  if (req.has_range_partition_interval() && range_bounds.empty()) {
+    vector<AutoRangePartitioner::Range> to_add;
+    vector<AutoRangePartitioner::Range> to_drop;
+    AutoRangePartitioner::Plan(req.range_partition_interval(), GetCurrentTimeMicros(),
+                               {}, &to_add, &to_drop);
+    int col_idx = schema.find_column_by_id(partition_schema.range_column_ids()[0]);
+    for (const auto& range : to_add) {
+      KuduPartialRow lower(&schema);
+      KuduPartialRow upper(&schema);
+      RETURN_NOT_OK(lower.SetUnixTimeMicros(col_idx, range.lower));
+      RETURN_NOT_OK(upper.SetUnixTimeMicros(col_idx, range.upper));
+      range_bounds.emplace_back(std::move(lower), std::move(upper));
+    }
+  }
+
   // Create partitions based on specified partition schema and split rows.
   vector<Partition> partitions;
   RETURN_NOT_OK(partition_schema.CreatePartitions(split_rows, range_bounds, schema, &partitions));
@@ -1015,6 +1284,20 @@ Status CatalogManager::IsCreateTableDone(const IsCreateTableDoneRequestPB* req,
   // 2. Verify if the create is in-progress
   TRACE("Verify if the table creation is in progress for $0", table->ToString());
   resp->set_done(!table->IsCreateInProgress());
+  l.Unlock();
+
+  // 3. Report the progress of the creation.
+  vector<scoped_refptr<TabletInfo>> tablets;
+  table->GetAllTablets(&tablets);
+  int num_running = 0;
+  for (const scoped_refptr<TabletInfo>& tablet : tablets) {
+    TabletMetadataLock tablet_lock(tablet.get(), TabletMetadataLock::READ);
+    if (tablet_lock.data().is_running()) {
+      num_running++;
+    }
+  }
+  resp->set_num_tablets(tablets.size());
+  resp->set_num_running_tablets(num_running);
 
   return Status::OK();
 }
@@ -1035,6 +1318,12 @@ TableInfo *CatalogManager::CreateTableInfo(const CreateTableRequestPB& req,
   // whereas the user request PB does not.
   CHECK_OK(SchemaToPB(schema, metadata->mutable_schema()));
   partition_schema.ToPB(metadata->mutable_partition_schema());
+  if (req.has_compaction_policy()) {
+    metadata->mutable_compaction_policy()->CopyFrom(req.compaction_policy());
+  }
+  if (req.has_range_partition_interval()) {
+    metadata->mutable_range_partition_interval()->CopyFrom(req.range_partition_interval());
+  }
   return table;
 }
 
@@ -1187,6 +1476,7 @@ Status CatalogManager::ApplyAlterSchemaSteps(const SysTablesEntryPB& current_pb,
         RETURN_NOT_OK(TypeEncodingInfo::Get(new_col.type_info(),
                                             new_col.attributes().encoding,
                                             &dummy));
+        RETURN_NOT_OK(ValidateCompressionLevel(new_col));
 
         // can't accept a NOT NULL column without read default
         if (!new_col.is_nullable() && !new_col.has_read_default()) {
@@ -1252,7 +1542,10 @@ Status CatalogManager::ApplyAlterPartitioningSteps(
   PartitionSchema partition_schema;
   RETURN_NOT_OK(PartitionSchema::FromPB(l.data().pb.partition_schema(), schema, &partition_schema));
 
-  map<string, TabletInfo*> existing_tablets = table->tablet_map();
+  // The existing tablets are looked up in the table's tablet map, which is
+  // ordered by partition key start, rather than copied: the table lock keeps
+  // it from changing. The tablets dropped by earlier steps are still in it.
+  std::unordered_set<TabletInfo*> dropped_tablets;
   map<string, scoped_refptr<TabletInfo>> new_tablets;
 
   for (const auto& step : steps) {
@@ -1302,20 +1595,10 @@ Status CatalogManager::ApplyAlterPartitioningSteps(
           const string& upper_bound = partition.partition_key_end();
 
           // Check that the new tablet doesn't overlap with the existing tablets.
-          // Iter points at the tablet directly *after* the lower bound (or to
-          // existing_tablets.end(), if such a tablet does not exist).
-          auto existing_iter = existing_tablets.upper_bound(lower_bound);
-          if (existing_iter != existing_tablets.end()) {
-            TabletMetadataLock metadata(existing_iter->second, TabletMetadataLock::READ);
-            if (metadata.data().pb.partition().partition_key_start() < upper_bound) {
-              return Status::InvalidArgument(
-                  "New range partition conflicts with existing range partition",
-                  partition_schema.RangePartitionDebugString(*ops[0].split_row, *ops[1].split_row));
-            }
-          }
-          if (existing_iter != existing_tablets.begin()) {
-            TabletMetadataLock metadata(std::prev(existing_iter)->second, TabletMetadataLock::READ);
-            if (metadata.data().pb.partition().partition_key_end() > lower_bound) {
+          vector<scoped_refptr<TabletInfo>> overlapping;
+          table->GetTabletsOverlapping(lower_bound, upper_bound, &overlapping);
+          for (const auto& existing : overlapping) {
+            if (!ContainsKey(dropped_tablets, existing.get())) {
               return Status::InvalidArgument(
                   "New range partition conflicts with existing range partition",
                   partition_schema.RangePartitionDebugString(*ops[0].split_row, *ops[1].split_row));
@@ -1353,19 +1636,31 @@ Status CatalogManager::ApplyAlterPartitioningSteps(
           const string& lower_bound = partition.partition_key_start();
           const string& upper_bound = partition.partition_key_end();
 
-          // Iter points to the tablet if it exists, or the next tablet, or the end.
-          auto existing_iter = existing_tablets.lower_bound(lower_bound);
+          // The first existing tablet starting at or after the lower bound is
+          // the tablet if it exists.
+          vector<scoped_refptr<TabletInfo>> overlapping;
+          table->GetTabletsOverlapping(lower_bound, upper_bound, &overlapping);
+          TabletInfo* existing = nullptr;
+          for (const auto& tablet : overlapping) {
+            if (ContainsKey(dropped_tablets, tablet.get())) {
+              continue;
+            }
+            TabletMetadataLock metadata(tablet.get(), TabletMetadataLock::READ);
+            const auto& partition = metadata.data().pb.partition();
+            if (partition.partition_key_start() < lower_bound) {
+              continue;
+            }
+            if (partition.partition_key_start() == lower_bound ||
+                partition.partition_key_end() == upper_bound) {
+              existing = tablet.get();
+            }
+            break;
+          }
           auto new_iter = new_tablets.lower_bound(lower_bound);
 
-          bool found_existing = false;
+          bool found_existing = existing != nullptr;
           bool found_new = false;
 
-          if (existing_iter != existing_tablets.end()) {
-            TabletMetadataLock metadata(existing_iter->second, TabletMetadataLock::READ);
-            const auto& partition = metadata.data().pb.partition();
-            found_existing = partition.partition_key_start() == lower_bound ||
-                             partition.partition_key_end() == upper_bound;
-          }
           if (new_iter != new_tablets.end()) {
             const auto& partition = new_iter->second->mutable_metadata()->dirty().pb.partition();
             found_new = partition.partition_key_start() == lower_bound ||
@@ -1374,8 +1669,8 @@ Status CatalogManager::ApplyAlterPartitioningSteps(
 
           DCHECK(!found_existing || !found_new);
           if (found_existing) {
-            tablets_to_drop->emplace_back(existing_iter->second);
-            existing_tablets.erase(existing_iter);
+            tablets_to_drop->emplace_back(existing);
+            dropped_tablets.insert(existing);
           } else if (found_new) {
             new_tablets.erase(new_iter);
           } else {
@@ -1651,6 +1946,11 @@ Status CatalogManager::AlterTable(const AlterTableRequestPB* req,
   for (const auto& tablet : tablets_to_drop) {
     TabletMetadataLock l(tablet.get(), TabletMetadataLock::READ);
     SendDeleteTabletRequest(tablet, l, deletion_msg);
+    *resp->add_altered_partitions() = l.data().pb.partition();
+  }
+  for (const auto& tablet : tablets_to_add) {
+    TabletMetadataLock l(tablet.get(), TabletMetadataLock::READ);
+    *resp->add_altered_partitions() = l.data().pb.partition();
   }
 
   background_tasks_->Wake();
@@ -1788,6 +2088,99 @@ void CatalogManager::NotifyTabletDeleteSuccess(const string& permanent_uuid,
   // tablet.
 }
 
+void CatalogManager::ProcessTabletStats(TSDescriptor* ts_desc,
+                                        const TSHeartbeatRequestPB& req) {
+  leader_lock_.AssertAcquiredForReading();
+  vector<scoped_refptr<TabletInfo>> tablets;
+  {
+    shared_lock<LockType> l(lock_);
+    for (const TabletStatsPB& stats : req.tablet_stats()) {
+      tablets.emplace_back(FindPtrOrNull(tablet_map_, stats.tablet_id()));
+    }
+  }
+
+  const int64_t size_threshold = FLAGS_master_split_tablet_size_threshold_mb * 1024 * 1024;
+  const double write_rate_threshold = FLAGS_master_split_tablet_write_rate_threshold;
+  const double scan_rate_threshold = FLAGS_master_split_tablet_scan_rate_threshold;
+  for (int i = 0; i < req.tablet_stats_size(); i++) {
+    const scoped_refptr<TabletInfo>& tablet = tablets[i];
+    if (!tablet) {
+      continue;
+    }
+    tablet->UpdateLoad(ts_desc->permanent_uuid(), req.tablet_stats(i));
+    TabletInfo::Load load = tablet->load();
+    bool split_candidate =
+        (size_threshold > 0 && load.on_disk_size >= size_threshold) ||
+        (write_rate_threshold > 0 && load.rows_written_per_sec >= write_rate_threshold) ||
+        (scan_rate_threshold > 0 && load.rows_scanned_per_sec >= scan_rate_threshold);
+    if (tablet->set_split_candidate(split_candidate)) {
+      LOG(INFO) << Substitute("Tablet $0 is a candidate for splitting at key $1: "
+                              "$2 bytes on disk, $3 rows written/s, $4 rows scanned/s",
+                              tablet->ToString(),
+                              load.split_key.empty() ? "<none>" : strings::CHexEscape(load.split_key),
+                              load.on_disk_size, load.rows_written_per_sec,
+                              load.rows_scanned_per_sec);
+    }
+  }
+}
+
+Status CatalogManager::GetClusterLoadSummary(ClusterLoadSummary* summary) {
+  vector<scoped_refptr<TableInfo>> tables;
+  RETURN_NOT_OK(GetAllTables(&tables));
+
+  for (const auto& table : tables) {
+    Schema schema;
+    PartitionSchema partition_schema;
+    TableLoadSummary* table_summary = &summary->tables[table->id()];
+    {
+      TableMetadataLock l(table.get(), TableMetadataLock::READ);
+      if (!l.data().is_running()) {
+        summary->tables.erase(table->id());
+        continue;
+      }
+      table_summary->table_name = l.data().name();
+      RETURN_NOT_OK(SchemaFromPB(l.data().pb.schema(), &schema));
+      RETURN_NOT_OK(PartitionSchema::FromPB(l.data().pb.partition_schema(), schema,
+                                            &partition_schema));
+    }
+
+    vector<scoped_refptr<TabletInfo>> tablets;
+    table->GetAllTablets(&tablets);
+    for (const auto& tablet : tablets) {
+      Partition partition;
+      {
+        TabletMetadataLock l(tablet.get(), TabletMetadataLock::READ);
+        Partition::FromPB(l.data().pb.partition(), &partition);
+      }
+      TabletInfo::Load load = tablet->load();
+      table_summary->total.Add(load);
+
+      const string range_start = partition.range_key_start().ToString();
+      auto range = table_summary->ranges.find(range_start);
+      if (range == table_summary->ranges.end()) {
+        range = table_summary->ranges.emplace(range_start, TableLoadSummary::Range()).first;
+        range->second.description = partition_schema.RangePartitionDebugString(
+            range_start, partition.range_key_end().ToString(), schema);
+      }
+      range->second.load.Add(load);
+
+      if (!load.ts_uuid.empty()) {
+        summary->tablet_servers[load.ts_uuid].Add(load);
+      }
+    }
+  }
+  return Status::OK();
+}
+
+void LoadSummary::Add(const TabletInfo::Load& load) {
+  num_tablets++;
+  on_disk_size += load.on_disk_size;
+  rows_written_per_sec += load.rows_written_per_sec;
+  rows_scanned_per_sec += load.rows_scanned_per_sec;
+  bytes_scanned_per_sec += load.bytes_scanned_per_sec;
+  max_write_latency_p99_us = std::max(max_write_latency_p99_us, load.write_latency_p99_us);
+}
+
 Status CatalogManager::ProcessTabletReport(TSDescriptor* ts_desc,
                                            const TabletReportPB& report,
                                            TabletReportUpdatesPB *report_update,
@@ -1810,7 +2203,18 @@ Status CatalogManager::ProcessTabletReport(TSDescriptor* ts_desc,
   for (const ReportedTabletPB& reported : report.updated_tablets()) {
     ReportedTabletUpdatesPB *tablet_report = report_update->add_tablets();
     tablet_report->set_tablet_id(reported.tablet_id());
-    RETURN_NOT_OK_PREPEND(HandleReportedTablet(ts_desc, reported, tablet_report),
+    const ReportedTabletPB* to_handle = &reported;
+    ReportedTabletPB expanded;
+    if (reported.has_compact_consensus_state()) {
+      if (!ExpandCompactConsensusState(reported, &expanded)) {
+        VLOG(1) << "Asking " << ts_desc->ToString() << " for the consensus state of tablet "
+                << reported.tablet_id();
+        tablet_report->set_needs_consensus_state(true);
+        continue;
+      }
+      to_handle = &expanded;
+    }
+    RETURN_NOT_OK_PREPEND(HandleReportedTablet(ts_desc, *to_handle, tablet_report),
                           Substitute("Error handling $0", reported.ShortDebugString()));
   }
 
@@ -1821,6 +2225,38 @@ Status CatalogManager::ProcessTabletReport(TSDescriptor* ts_desc,
   return Status::OK();
 }
 
+bool CatalogManager::ExpandCompactConsensusState(const ReportedTabletPB& report,
+                                                 ReportedTabletPB* expanded) {
+  const CompactConsensusStatePB& compact = report.compact_consensus_state();
+  *expanded = report;
+  expanded->clear_compact_consensus_state();
+
+  scoped_refptr<TabletInfo> tablet;
+  {
+    shared_lock<LockType> l(lock_);
+    tablet = FindPtrOrNull(tablet_map_, report.tablet_id());
+  }
+  if (!tablet) {
+    // HandleReportedTablet() doesn't need the consensus state of unknown
+    // tablets.
+    return true;
+  }
+
+  TabletMetadataLock l(tablet.get(), TabletMetadataLock::READ);
+  const ConsensusStatePB& cstate = l.data().pb.committed_consensus_state();
+  if (!cstate.config().has_opid_index() ||
+      cstate.config().opid_index() != compact.config_opid_index()) {
+    return false;
+  }
+  ConsensusStatePB* expanded_cstate = expanded->mutable_committed_consensus_state();
+  expanded_cstate->set_current_term(compact.current_term());
+  if (compact.has_leader_uuid()) {
+    expanded_cstate->set_leader_uuid(compact.leader_uuid());
+  }
+  *expanded_cstate->mutable_config() = cstate.config();
+  return true;
+}
+
 namespace {
 // Return true if receiving 'report' for a tablet in CREATING state should
 // transition it to the RUNNING state.
@@ -1873,6 +2309,10 @@ Status CatalogManager::HandleReportedTablet(TSDescriptor* ts_desc,
 
   VLOG(3) << "tablet report: " << report.ShortDebugString();
 
+  if (report.state() == tablet::RUNNING) {
+    rebalancer_->MarkReplicaRunning(report.tablet_id(), ts_desc->permanent_uuid());
+  }
+
   // TODO: we don't actually need to do the COW here until we see we're going
   // to change the state. Can we change CowedObject to lazily do the copy?
   TableMetadataLock table_lock(tablet->table().get(), TableMetadataLock::READ);
@@ -2270,6 +2710,12 @@ class RetryingTSRpcTask : public MonitoredTask {
   // Runs on the reactor thread, so must not block or perform any IO.
   virtual void HandleResponse(int attempt) = 0;
 
+  // Handle the failure of the RPC itself, as opposed to an error in its
+  // response. Retries are attempted as for HandleResponse().
+  //
+  // Runs on the reactor thread, so must not block or perform any IO.
+  virtual void HandleRpcError() {}
+
   // Return the id of the tablet that is the subject of the async request.
   virtual string tablet_id() const = 0;
 
@@ -2301,6 +2747,9 @@ class RetryingTSRpcTask : public MonitoredTask {
       LOG(WARNING) << "TS " << target_ts_desc_->ToString() << ": "
                    << type_name() << " RPC failed for tablet "
                    << tablet_id() << ": " << rpc_.status().ToString();
+      if (state() != kStateAborted) {
+        HandleRpcError(); // May modify state_.
+      }
     } else if (state() != kStateAborted) {
       HandleResponse(attempt_); // Modifies state_.
     }
@@ -2439,6 +2888,35 @@ class RetrySpecificTSRpcTask : public RetryingTSRpcTask {
   const string permanent_uuid_;
 };
 
+namespace {
+
+// Fills in 'req' to create a replica of 'tablet' on the tablet server with
+// UUID 'permanent_uuid'.
+//
+// The tablet lock must be acquired for reading before making this call.
+void BuildCreateTabletRequest(const string& permanent_uuid,
+                              const scoped_refptr<TabletInfo>& tablet,
+                              const TabletMetadataLock& tablet_lock,
+                              tserver::CreateTabletRequestPB* req) {
+  TableMetadataLock table_lock(tablet->table().get(), TableMetadataLock::READ);
+  req->set_dest_uuid(permanent_uuid);
+  req->set_table_id(tablet->table()->id());
+  req->set_tablet_id(tablet->tablet_id());
+  req->mutable_partition()->CopyFrom(tablet_lock.data().pb.partition());
+  req->set_table_name(table_lock.data().pb.name());
+  req->mutable_schema()->CopyFrom(table_lock.data().pb.schema());
+  req->mutable_partition_schema()->CopyFrom(
+      table_lock.data().pb.partition_schema());
+  if (table_lock.data().pb.has_compaction_policy()) {
+    req->mutable_compaction_policy()->CopyFrom(
+        table_lock.data().pb.compaction_policy());
+  }
+  req->mutable_config()->CopyFrom(
+      tablet_lock.data().pb.committed_consensus_state().config());
+}
+
+} // anonymous namespace
+
 // Fire off the async create tablet.
 // This requires that the new tablet info is locked for write, and the
 // consensus configuration information has been filled into the 'dirty' data.
@@ -2453,18 +2931,18 @@ class AsyncCreateReplica : public RetrySpecificTSRpcTask {
     : RetrySpecificTSRpcTask(master, permanent_uuid, tablet->table()),
       tablet_id_(tablet->tablet_id()) {
     deadline_ = start_ts_ + MonoDelta::FromMilliseconds(FLAGS_tablet_creation_timeout_ms);
+    BuildCreateTabletRequest(permanent_uuid, tablet, tablet_lock, &req_);
+  }
 
-    TableMetadataLock table_lock(tablet->table().get(), TableMetadataLock::READ);
-    req_.set_dest_uuid(permanent_uuid);
-    req_.set_table_id(tablet->table()->id());
-    req_.set_tablet_id(tablet->tablet_id());
-    req_.mutable_partition()->CopyFrom(tablet_lock.data().pb.partition());
-    req_.set_table_name(table_lock.data().pb.name());
-    req_.mutable_schema()->CopyFrom(table_lock.data().pb.schema());
-    req_.mutable_partition_schema()->CopyFrom(
-        table_lock.data().pb.partition_schema());
-    req_.mutable_config()->CopyFrom(
-        tablet_lock.data().pb.committed_consensus_state().config());
+  // Sends an already built request.
+  AsyncCreateReplica(Master *master,
+                     const string& permanent_uuid,
+                     const scoped_refptr<TableInfo>& table,
+                     tserver::CreateTabletRequestPB req)
+    : RetrySpecificTSRpcTask(master, permanent_uuid, table),
+      tablet_id_(req.tablet_id()),
+      req_(std::move(req)) {
+    deadline_ = start_ts_ + MonoDelta::FromMilliseconds(FLAGS_tablet_creation_timeout_ms);
   }
 
   virtual string type_name() const OVERRIDE { return "Create Tablet"; }
@@ -2509,6 +2987,106 @@ class AsyncCreateReplica : public RetrySpecificTSRpcTask {
   tserver::CreateTabletResponsePB resp_;
 };
 
+// Fire off the async creation of a batch of tablets of the same table on a
+// tablet server. If the tablet server doesn't support the CreateTablets RPC,
+// falls back to an AsyncCreateReplica per tablet.
+class AsyncCreateReplicas : public RetrySpecificTSRpcTask {
+ public:
+  AsyncCreateReplicas(Master *master,
+                      const string& permanent_uuid,
+                      const scoped_refptr<TableInfo>& table,
+                      tserver::CreateTabletsRequestPB req)
+    : RetrySpecificTSRpcTask(master, permanent_uuid, table),
+      req_(std::move(req)) {
+    DCHECK_GT(req_.tablets_size(), 0);
+    deadline_ = start_ts_ + MonoDelta::FromMilliseconds(FLAGS_tablet_creation_timeout_ms);
+  }
+
+  virtual string type_name() const OVERRIDE { return "Create Tablets"; }
+
+  virtual string description() const OVERRIDE {
+    return Substitute("CreateTablets RPC for $0 tablets of table $1 on TS $2",
+                      req_.tablets_size(), table_->ToString(), permanent_uuid_);
+  }
+
+ protected:
+  // The first of the tablets.
+  virtual string tablet_id() const OVERRIDE { return req_.tablets(0).tablet_id(); }
+
+  virtual void HandleResponse(int attempt) OVERRIDE {
+    if (resp_.has_error()) {
+      LOG(WARNING) << description() << " failed: "
+                   << StatusFromPB(resp_.error().status()).ToString();
+      return;
+    }
+    if (resp_.tablets_size() != req_.tablets_size()) {
+      LOG(WARNING) << description() << " returned " << resp_.tablets_size()
+                   << " responses";
+      return;
+    }
+
+    // Retry the tablets which failed for another reason than already being
+    // present.
+    tserver::CreateTabletsRequestPB retry_req;
+    retry_req.set_dest_uuid(req_.dest_uuid());
+    for (int i = 0; i < req_.tablets_size(); i++) {
+      const tserver::CreateTabletResponsePB& tablet_resp = resp_.tablets(i);
+      if (!tablet_resp.has_error()) {
+        continue;
+      }
+      const string& tablet_id = req_.tablets(i).tablet_id();
+      Status s = StatusFromPB(tablet_resp.error().status());
+      if (s.IsAlreadyPresent()) {
+        LOG(INFO) << "CreateTablet RPC for tablet " << tablet_id
+                  << " on TS " << target_ts_desc_->ToString() << " returned already present: "
+                  << s.ToString();
+      } else {
+        LOG(WARNING) << "CreateTablet RPC for tablet " << tablet_id
+                     << " on TS " << target_ts_desc_->ToString() << " failed: " << s.ToString();
+        *retry_req.add_tablets() = req_.tablets(i);
+      }
+    }
+    if (retry_req.tablets_size() == 0) {
+      MarkComplete();
+    } else {
+      req_.Swap(&retry_req);
+    }
+  }
+
+  virtual void HandleRpcError() OVERRIDE {
+    const rpc::ErrorStatusPB* err = rpc_.error_response();
+    if (!err ||
+        std::find(err->unsupported_feature_flags().begin(),
+                  err->unsupported_feature_flags().end(),
+                  tserver::TabletServerAdminFeatures::CREATE_TABLETS) ==
+            err->unsupported_feature_flags().end()) {
+      return;
+    }
+    LOG(INFO) << "TS " << target_ts_desc_->ToString() << " does not support "
+              << "CreateTablets, sending a CreateTablet RPC per tablet";
+    for (const tserver::CreateTabletRequestPB& tablet_req : req_.tablets()) {
+      AsyncCreateReplica* task = new AsyncCreateReplica(master_, permanent_uuid_,
+                                                        table_, tablet_req);
+      table_->AddTask(task);
+      WARN_NOT_OK(task->Run(), "Failed to send new tablet request");
+    }
+    MarkComplete();
+  }
+
+  virtual bool SendRequest(int attempt) OVERRIDE {
+    VLOG(1) << "Send " << description() << " (attempt " << attempt << ")";
+    resp_.Clear();
+    rpc_.RequireServerFeature(tserver::TabletServerAdminFeatures::CREATE_TABLETS);
+    ts_proxy_->CreateTabletsAsync(req_, &resp_, &rpc_,
+                                  boost::bind(&AsyncCreateReplicas::RpcCallback, this));
+    return true;
+  }
+
+ private:
+  tserver::CreateTabletsRequestPB req_;
+  tserver::CreateTabletsResponsePB resp_;
+};
+
 // Send a DeleteTablet() RPC request.
 class AsyncDeleteReplica : public RetrySpecificTSRpcTask {
  public:
@@ -2708,44 +3286,47 @@ bool SelectRandomTSForReplica(const TSDescriptorVector& ts_descs,
 
 } // anonymous namespace
 
-class AsyncAddServerTask : public RetryingTSRpcTask {
+// Base class of the tasks which change the Raft config of a tablet through its
+// leader replica.
+class AsyncChangeConfigTask : public RetryingTSRpcTask {
  public:
-  AsyncAddServerTask(Master *master,
-                     const scoped_refptr<TabletInfo>& tablet,
-                     const ConsensusStatePB& cstate)
+  AsyncChangeConfigTask(Master *master,
+                        const scoped_refptr<TabletInfo>& tablet,
+                        const ConsensusStatePB& cstate)
     : RetryingTSRpcTask(master,
                         gscoped_ptr<TSPicker>(new PickLeaderReplica(tablet)),
                         tablet->table()),
       tablet_(tablet),
       cstate_(cstate) {
-    deadline_ = MonoTime::Max(); // Never time out.
   }
 
-  virtual string type_name() const OVERRIDE { return "AddServer ChangeConfig"; }
-
   virtual string description() const OVERRIDE {
-    return Substitute("AddServer ChangeConfig RPC for tablet $0 on TS $1 "
-                      "with cas_config_opid_index $2",
+    return Substitute("$0 RPC for tablet $1 on TS $2 "
+                      "with cas_config_opid_index $3",
+                      type_name(),
                       tablet_->tablet_id(),
                       target_ts_desc_->ToString(),
                       cstate_.config().opid_index());
   }
 
  protected:
-  virtual bool SendRequest(int attempt) OVERRIDE;
   virtual void HandleResponse(int attempt) OVERRIDE;
 
- private:
-  virtual string tablet_id() const OVERRIDE { return tablet_->tablet_id(); }
+  // Returns false and aborts the task if the tablet's config changed since
+  // 'cstate_', since the request would then fail anyway.
+  bool CheckConfigUnchanged();
 
   const scoped_refptr<TabletInfo> tablet_;
   const ConsensusStatePB cstate_;
 
   consensus::ChangeConfigRequestPB req_;
   consensus::ChangeConfigResponsePB resp_;
+
+ private:
+  virtual string tablet_id() const OVERRIDE { return tablet_->tablet_id(); }
 };
 
-bool AsyncAddServerTask::SendRequest(int attempt) {
+bool AsyncChangeConfigTask::CheckConfigUnchanged() {
   // Bail if we're retrying in vain.
   int64_t latest_index;
   {
@@ -2759,6 +3340,63 @@ bool AsyncAddServerTask::SendRequest(int attempt) {
     MarkAborted();
     return false;
   }
+  return true;
+}
+
+void AsyncChangeConfigTask::HandleResponse(int attempt) {
+  if (!resp_.has_error()) {
+    MarkComplete();
+    LOG_WITH_PREFIX(INFO) << "Change config succeeded";
+    return;
+  }
+
+  Status status = StatusFromPB(resp_.error().status());
+
+  // Do not retry on a CAS error, otherwise retry forever or until cancelled.
+  switch (resp_.error().code()) {
+    case TabletServerErrorPB::CAS_FAILED:
+      LOG_WITH_PREFIX(WARNING) << "ChangeConfig() failed with leader "\
+                               << target_ts_desc_->ToString()
+                               << " due to CAS failure. No further retry: "
+                               << status.ToString();
+      MarkFailed();
+      break;
+    default:
+      LOG_WITH_PREFIX(INFO) << "ChangeConfig() failed with leader "
+                            << target_ts_desc_->ToString()
+                            << " due to error "
+                            << TabletServerErrorPB::Code_Name(resp_.error().code())
+                            << ". This operation will be retried. Error detail: "
+                            << status.ToString();
+      break;
+  }
+}
+
+class AsyncAddServerTask : public AsyncChangeConfigTask {
+ public:
+  // Adds a voter on 'replica_uuid', or on a random tablet server if it's empty.
+  AsyncAddServerTask(Master *master,
+                     const scoped_refptr<TabletInfo>& tablet,
+                     const ConsensusStatePB& cstate,
+                     string replica_uuid)
+    : AsyncChangeConfigTask(master, tablet, cstate),
+      replica_uuid_(std::move(replica_uuid)) {
+    deadline_ = MonoTime::Max(); // Never time out.
+  }
+
+  virtual string type_name() const OVERRIDE { return "AddServer ChangeConfig"; }
+
+ protected:
+  virtual bool SendRequest(int attempt) OVERRIDE;
+
+ private:
+  const string replica_uuid_;
+};
+
+bool AsyncAddServerTask::SendRequest(int attempt) {
+  if (!CheckConfigUnchanged()) {
+    return false;
+  }
 
   // Select the replica we wish to add to the config.
   // Do not include current members of the config.
@@ -2766,13 +3404,24 @@ bool AsyncAddServerTask::SendRequest(int attempt) {
   for (const RaftPeerPB& peer : cstate_.config().peers()) {
     InsertOrDie(&replica_uuids, peer.permanent_uuid());
   }
-  TSDescriptorVector ts_descs;
-  master_->ts_manager()->GetAllLiveDescriptors(&ts_descs);
   shared_ptr<TSDescriptor> replacement_replica;
-  if (PREDICT_FALSE(!SelectRandomTSForReplica(ts_descs, replica_uuids, &replacement_replica))) {
-    KLOG_EVERY_N(WARNING, 100) << LogPrefix() << "No candidate replacement replica found "
-                               << "for tablet " << tablet_->ToString();
-    return false;
+  if (!replica_uuid_.empty()) {
+    if (PREDICT_FALSE(ContainsKey(replica_uuids, replica_uuid_) ||
+                      !master_->ts_manager()->LookupTSByUUID(replica_uuid_,
+                                                             &replacement_replica))) {
+      LOG_WITH_PREFIX(WARNING) << "Cannot add a replica of tablet " << tablet_->ToString()
+                               << " on TS " << replica_uuid_ << ". Aborting task.";
+      MarkAborted();
+      return false;
+    }
+  } else {
+    TSDescriptorVector ts_descs;
+    master_->ts_manager()->GetAllLiveDescriptors(&ts_descs);
+    if (PREDICT_FALSE(!SelectRandomTSForReplica(ts_descs, replica_uuids, &replacement_replica))) {
+      KLOG_EVERY_N(WARNING, 100) << LogPrefix() << "No candidate replacement replica found "
+                                 << "for tablet " << tablet_->ToString();
+      return false;
+    }
   }
 
   req_.set_dest_uuid(target_ts_desc_->permanent_uuid());
@@ -2794,35 +3443,91 @@ bool AsyncAddServerTask::SendRequest(int attempt) {
   return true;
 }
 
-void AsyncAddServerTask::HandleResponse(int attempt) {
-  if (!resp_.has_error()) {
-    MarkComplete();
-    LOG_WITH_PREFIX(INFO) << "Change config succeeded";
-    return;
+// Removes the voter on a given tablet server from a tablet's config. Unlike
+// AsyncAddServerTask, it times out, since the rebalancer retries it.
+class AsyncRemoveServerTask : public AsyncChangeConfigTask {
+ public:
+  AsyncRemoveServerTask(Master *master,
+                        const scoped_refptr<TabletInfo>& tablet,
+                        const ConsensusStatePB& cstate,
+                        string replica_uuid)
+    : AsyncChangeConfigTask(master, tablet, cstate),
+      replica_uuid_(std::move(replica_uuid)) {
   }
 
-  Status status = StatusFromPB(resp_.error().status());
+  virtual string type_name() const OVERRIDE { return "RemoveServer ChangeConfig"; }
 
-  // Do not retry on a CAS error, otherwise retry forever or until cancelled.
-  switch (resp_.error().code()) {
-    case TabletServerErrorPB::CAS_FAILED:
-      LOG_WITH_PREFIX(WARNING) << "ChangeConfig() failed with leader "\
-                               << target_ts_desc_->ToString()
-                               << " due to CAS failure. No further retry: "
-                               << status.ToString();
-      MarkFailed();
-      break;
-    default:
-      LOG_WITH_PREFIX(INFO) << "ChangeConfig() failed with leader "
-                            << target_ts_desc_->ToString()
-                            << " due to error "
-                            << TabletServerErrorPB::Code_Name(resp_.error().code())
-                            << ". This operation will be retried. Error detail: "
-                            << status.ToString();
-      break;
+ protected:
+  virtual bool SendRequest(int attempt) OVERRIDE;
+
+ private:
+  const string replica_uuid_;
+};
+
+bool AsyncRemoveServerTask::SendRequest(int attempt) {
+  if (!CheckConfigUnchanged()) {
+    return false;
   }
+
+  req_.set_dest_uuid(target_ts_desc_->permanent_uuid());
+  req_.set_tablet_id(tablet_->tablet_id());
+  req_.set_type(consensus::REMOVE_SERVER);
+  req_.set_cas_config_opid_index(cstate_.config().opid_index());
+  req_.mutable_server()->set_permanent_uuid(replica_uuid_);
+  VLOG(1) << "Sending RemoveServer ChangeConfig request to "
+          << target_ts_desc_->ToString() << ":\n"
+          << req_.DebugString();
+  consensus_proxy_->ChangeConfigAsync(req_, &resp_, &rpc_,
+                                      boost::bind(&AsyncRemoveServerTask::RpcCallback, this));
+  return true;
 }
 
+// Asks the leader replica of a tablet to step down. It isn't retried: the
+// rebalancer picks the leaders to move again each time it runs.
+class AsyncLeaderStepDownTask : public RetrySpecificTSRpcTask {
+ public:
+  AsyncLeaderStepDownTask(Master *master,
+                          const scoped_refptr<TabletInfo>& tablet,
+                          const string& leader_uuid)
+    : RetrySpecificTSRpcTask(master, leader_uuid, tablet->table()),
+      tablet_(tablet) {
+  }
+
+  virtual string type_name() const OVERRIDE { return "LeaderStepDown"; }
+
+  virtual string description() const OVERRIDE {
+    return Substitute("LeaderStepDown RPC for tablet $0 on TS $1",
+                      tablet_->tablet_id(), permanent_uuid_);
+  }
+
+ protected:
+  virtual bool SendRequest(int attempt) OVERRIDE {
+    req_.set_dest_uuid(permanent_uuid_);
+    req_.set_tablet_id(tablet_->tablet_id());
+    consensus_proxy_->LeaderStepDownAsync(
+        req_, &resp_, &rpc_, boost::bind(&AsyncLeaderStepDownTask::RpcCallback, this));
+    return true;
+  }
+
+  virtual void HandleResponse(int attempt) OVERRIDE {
+    if (resp_.has_error()) {
+      LOG_WITH_PREFIX(INFO) << "LeaderStepDown() failed: "
+                            << StatusFromPB(resp_.error().status()).ToString();
+      MarkFailed();
+    } else {
+      MarkComplete();
+    }
+  }
+
+ private:
+  virtual string tablet_id() const OVERRIDE { return tablet_->tablet_id(); }
+
+  const scoped_refptr<TabletInfo> tablet_;
+
+  consensus::LeaderStepDownRequestPB req_;
+  consensus::LeaderStepDownResponsePB resp_;
+};
+
 void CatalogManager::SendAlterTableRequest(const scoped_refptr<TableInfo>& table) {
   vector<scoped_refptr<TabletInfo> > tablets;
   table->GetAllTablets(&tablets);
@@ -2892,8 +3597,9 @@ void CatalogManager::SendDeleteReplicaRequest(
 }
 
 void CatalogManager::SendAddServerRequest(const scoped_refptr<TabletInfo>& tablet,
-                                          const ConsensusStatePB& cstate) {
-  auto task = new AsyncAddServerTask(master_, tablet, cstate);
+                                          const ConsensusStatePB& cstate,
+                                          const string& replica_uuid) {
+  auto task = new AsyncAddServerTask(master_, tablet, cstate, replica_uuid);
   tablet->table()->AddTask(task);
   WARN_NOT_OK(task->Run(), "Failed to send new AddServer request");
 
@@ -2902,6 +3608,263 @@ void CatalogManager::SendAddServerRequest(const scoped_refptr<TabletInfo>& table
   LOG(INFO) << "Started AddServer task for tablet " << tablet->tablet_id();
 }
 
+void CatalogManager::SendRemoveServerRequest(const scoped_refptr<TabletInfo>& tablet,
+                                             const ConsensusStatePB& cstate,
+                                             const string& replica_uuid) {
+  auto task = new AsyncRemoveServerTask(master_, tablet, cstate, replica_uuid);
+  tablet->table()->AddTask(task);
+  WARN_NOT_OK(task->Run(), "Failed to send new RemoveServer request");
+  LOG(INFO) << "Started RemoveServer task for tablet " << tablet->tablet_id()
+            << " to remove TS " << replica_uuid;
+}
+
+void CatalogManager::SendLeaderStepDownRequest(const scoped_refptr<TabletInfo>& tablet,
+                                               const string& leader_uuid) {
+  auto task = new AsyncLeaderStepDownTask(master_, tablet, leader_uuid);
+  tablet->table()->AddTask(task);
+  WARN_NOT_OK(task->Run(), "Failed to send new LeaderStepDown request");
+  rebalancer_->RecordLeaderStepDown();
+}
+
+namespace {
+
+// Appends to 'req' a step of 'type' for the range partition 'range' of the
+// UNIXTIME_MICROS column 'col_idx' of 'schema'.
+Status AddRangePartitionStep(AlterTableRequestPB::StepType type,
+                             const Schema& schema,
+                             int col_idx,
+                             const AutoRangePartitioner::Range& range,
+                             AlterTableRequestPB* req) {
+  KuduPartialRow lower(&schema);
+  KuduPartialRow upper(&schema);
+  RETURN_NOT_OK(lower.SetUnixTimeMicros(col_idx, range.lower));
+  RETURN_NOT_OK(upper.SetUnixTimeMicros(col_idx, range.upper));
+  AlterTableRequestPB::Step* step = req->add_alter_schema_steps();
+  step->set_type(type);
+  RowOperationsPB* range_bounds = type == AlterTableRequestPB::ADD_RANGE_PARTITION ?
+      step->mutable_add_range_partition()->mutable_range_bounds() :
+      step->mutable_drop_range_partition()->mutable_range_bounds();
+  RowOperationsPBEncoder encoder(range_bounds);
+  encoder.Add(RowOperationsPB::RANGE_LOWER_BOUND, lower);
+  encoder.Add(RowOperationsPB::RANGE_UPPER_BOUND, upper);
+  return Status::OK();
+}
+
+} // anonymous namespace
+
+void CatalogManager::RunAutoRangePartitioning() {
+  leader_lock_.AssertAcquiredForReading();
+
+  vector<scoped_refptr<TableInfo>> tables;
+  {
+    shared_lock<LockType> l(lock_);
+    AppendValuesFromMap(table_ids_map_, &tables);
+  }
+
+  int64_t now_usec = GetCurrentTimeMicros();
+  for (const auto& table : tables) {
+    RangePartitionIntervalPB policy;
+    Schema schema;
+    int col_idx;
+    {
+      TableMetadataLock l(table.get(), TableMetadataLock::READ);
+      if (!l.data().is_running() || !l.data().pb.has_range_partition_interval()) {
+        continue;
+      }
+      policy = l.data().pb.range_partition_interval();
+      PartitionSchema partition_schema;
+      Schema table_schema;
+      Status s = SchemaFromPB(l.data().pb.schema(), &table_schema);
+      if (s.ok()) {
+        s = PartitionSchema::FromPB(l.data().pb.partition_schema(), table_schema,
+                                    &partition_schema);
+      }
+      if (!s.ok()) {
+        LOG(WARNING) << "Unable to decode the schema of table " << table->ToString()
+                     << ": " << s.ToString();
+        continue;
+      }
+      // Range bounds are sent like a client's, without column IDs; the
+      // columns keep their indexes.
+      schema = table_schema.CopyWithoutColumnIds();
+      col_idx = table_schema.find_column_by_id(partition_schema.range_column_ids()[0]);
+    }
+
+    vector<AutoRangePartitioner::Range> existing;
+    vector<scoped_refptr<TabletInfo>> tablets;
+    table->GetAllTablets(&tablets);
+    for (const auto& tablet : tablets) {
+      TabletMetadataLock l(tablet.get(), TabletMetadataLock::READ);
+      if (l.data().is_deleted()) {
+        continue;
+      }
+      Partition partition;
+      Partition::FromPB(l.data().pb.partition(), &partition);
+      AutoRangePartitioner::Range range;
+      CHECK_OK(AutoRangePartitioner::DecodeRange(partition, &range));
+      existing.push_back(range);
+    }
+
+    vector<AutoRangePartitioner::Range> to_add;
+    vector<AutoRangePartitioner::Range> to_drop;
+    AutoRangePartitioner::Plan(policy, now_usec, std::move(existing), &to_add, &to_drop);
+    if (to_add.empty() && to_drop.empty()) {
+      continue;
+    }
+
+    // All of the table's range partitions are added and dropped at once.
+    AlterTableRequestPB req;
+    AlterTableResponsePB resp;
+    req.mutable_table()->set_table_id(table->id());
+    CHECK_OK(SchemaToPB(schema, req.mutable_schema()));
+    for (const auto& range : to_add) {
+      CHECK_OK(AddRangePartitionStep(AlterTableRequestPB::ADD_RANGE_PARTITION,
+                                     schema, col_idx, range, &req));
+    }
+    for (const auto& range : to_drop) {
+      CHECK_OK(AddRangePartitionStep(AlterTableRequestPB::DROP_RANGE_PARTITION,
+                                     schema, col_idx, range, &req));
+    }
+    LOG(INFO) << Substitute("Adding $0 and dropping $1 range partitions of table $2",
+                            to_add.size(), to_drop.size(), table->ToString());
+    Status s = AlterTable(&req, &resp, nullptr);
+    if (!s.ok()) {
+      LOG(WARNING) << "Unable to alter the range partitions of table " << table->ToString()
+                   << ": " << s.ToString();
+    }
+  }
+}
+
+void CatalogManager::RunRebalancer() {
+  leader_lock_.AssertAcquiredForReading();
+
+  TSDescriptorVector ts_descs;
+  master_->ts_manager()->GetAllLiveDescriptors(&ts_descs);
+  vector<string> ts_uuids;
+  for (const auto& ts : ts_descs) {
+    ts_uuids.push_back(ts->permanent_uuid());
+  }
+
+  vector<scoped_refptr<TableInfo>> tables;
+  {
+    shared_lock<LockType> l(lock_);
+    AppendValuesFromMap(table_ids_map_, &tables);
+  }
+
+  // The committed configs of the running tablets. 'tablets' and 'cstates'
+  // are indexed like 'replicas'.
+  vector<Rebalancer::TabletReplicas> replicas;
+  vector<scoped_refptr<TabletInfo>> tablets;
+  vector<ConsensusStatePB> cstates;
+  unordered_map<string, int> index_by_tablet_id;
+  for (const auto& table : tables) {
+    int num_replicas;
+    {
+      TableMetadataLock l(table.get(), TableMetadataLock::READ);
+      if (!l.data().is_running()) {
+        continue;
+      }
+      num_replicas = l.data().pb.num_replicas();
+    }
+    vector<scoped_refptr<TabletInfo>> table_tablets;
+    table->GetAllTablets(&table_tablets);
+    for (const auto& tablet : table_tablets) {
+      TabletMetadataLock l(tablet.get(), TabletMetadataLock::READ);
+      if (!l.data().is_running()) {
+        continue;
+      }
+      const ConsensusStatePB& cstate = l.data().pb.committed_consensus_state();
+      Rebalancer::TabletReplicas tablet_replicas;
+      tablet_replicas.tablet_id = tablet->tablet_id();
+      tablet_replicas.table_id = table->id();
+      tablet_replicas.leader_uuid = cstate.leader_uuid();
+      tablet_replicas.num_replicas = num_replicas;
+      TabletInfo::Load load = tablet->load();
+      tablet_replicas.load = load.rows_written_per_sec + load.rows_scanned_per_sec;
+      for (const RaftPeerPB& peer : cstate.config().peers()) {
+        if (peer.member_type() == RaftPeerPB::VOTER) {
+          tablet_replicas.voters.push_back(peer.permanent_uuid());
+        }
+      }
+      InsertOrDie(&index_by_tablet_id, tablet->tablet_id(), replicas.size());
+      replicas.emplace_back(std::move(tablet_replicas));
+      tablets.push_back(tablet);
+      cstates.push_back(cstate);
+    }
+  }
+
+  // Make progress on the pending moves: once the new replica runs, remove
+  // the one it replaces.
+  auto has_voter = [](const Rebalancer::TabletReplicas& r, const string& uuid) {
+    return std::find(r.voters.begin(), r.voters.end(), uuid) != r.voters.end();
+  };
+  vector<Rebalancer::PendingMove> pending_moves;
+  rebalancer_->GetPendingMoves(&pending_moves);
+  vector<string> busy_tablets;
+  MonoTime now = MonoTime::Now();
+  MonoDelta move_timeout = MonoDelta::FromMilliseconds(FLAGS_master_rebalancer_move_timeout_ms);
+  for (const auto& pending : pending_moves) {
+    const Rebalancer::ReplicaMove& move = pending.move;
+    const int* idx = FindOrNull(index_by_tablet_id, move.tablet_id);
+    if (!idx) {
+      LOG(INFO) << "Abandoning move of deleted tablet " << move.tablet_id;
+      rebalancer_->RemovePendingMove(move.tablet_id, false);
+      continue;
+    }
+    const Rebalancer::TabletReplicas& r = replicas[*idx];
+    bool has_from = has_voter(r, move.from_uuid);
+    bool has_to = has_voter(r, move.to_uuid);
+    if (!has_from) {
+      LOG(INFO) << Substitute("Finished move of tablet $0 from TS $1 to TS $2",
+                              move.tablet_id, move.from_uuid, move.to_uuid);
+      rebalancer_->RemovePendingMove(move.tablet_id, has_to);
+      continue;
+    }
+    if (now - pending.start_time > move_timeout ||
+        (!has_to && cstates[*idx].config().opid_index() > pending.config_opid_index)) {
+      // The move took too long, or the new replica wasn't added and won't be.
+      LOG(WARNING) << Substitute("Abandoning move of tablet $0 from TS $1 to TS $2",
+                                 move.tablet_id, move.from_uuid, move.to_uuid);
+      rebalancer_->RemovePendingMove(move.tablet_id, false);
+      continue;
+    }
+    busy_tablets.push_back(move.tablet_id);
+    if (!has_to || !pending.target_running ||
+        static_cast<int>(r.voters.size()) <= r.num_replicas) {
+      continue;
+    }
+    if (r.leader_uuid == move.from_uuid) {
+      // A leader can't remove itself from the config.
+      SendLeaderStepDownRequest(tablets[*idx], move.from_uuid);
+    } else {
+      SendRemoveServerRequest(tablets[*idx], cstates[*idx], move.from_uuid);
+    }
+  }
+
+  // Start new moves, up to the limit.
+  int max_moves = FLAGS_master_rebalancer_max_concurrent_moves -
+                  static_cast<int>(busy_tablets.size());
+  if (max_moves > 0) {
+    vector<Rebalancer::ReplicaMove> moves;
+    Rebalancer::PlanReplicaMoves(ts_uuids, replicas, busy_tablets, max_moves, &moves);
+    for (const auto& move : moves) {
+      int idx = FindOrDie(index_by_tablet_id, move.tablet_id);
+      LOG(INFO) << Substitute("Moving replica of tablet $0 from TS $1 to TS $2",
+                              move.tablet_id, move.from_uuid, move.to_uuid);
+      rebalancer_->AddPendingMove(move, cstates[idx].config().opid_index());
+      SendAddServerRequest(tablets[idx], cstates[idx], move.to_uuid);
+      busy_tablets.push_back(move.tablet_id);
+    }
+  }
+
+  vector<int> step_downs;
+  Rebalancer::PlanLeaderStepDowns(ts_uuids, replicas, busy_tablets,
+                                  FLAGS_master_rebalancer_max_leader_step_downs, &step_downs);
+  for (int idx : step_downs) {
+    SendLeaderStepDownRequest(tablets[idx], replicas[idx].leader_uuid);
+  }
+}
+
 void CatalogManager::ExtractTabletsToProcess(
     vector<scoped_refptr<TabletInfo>>* tablets_to_process) {
 
@@ -3141,9 +4104,13 @@ Status CatalogManager::ProcessPendingAssignments(
     }
   }
   // Send the CreateTablet() requests to the servers. This is asynchronous / non-blocking.
-  for (TabletInfo* tablet : deferred.needs_create_rpc) {
-    TabletMetadataLock l(tablet, TabletMetadataLock::READ);
-    SendCreateTabletRequest(tablet, l);
+  if (FLAGS_master_create_tablets_batch_size > 1) {
+    SendCreateTabletsRequests(deferred.needs_create_rpc);
+  } else {
+    for (TabletInfo* tablet : deferred.needs_create_rpc) {
+      TabletMetadataLock l(tablet, TabletMetadataLock::READ);
+      SendCreateTabletRequest(tablet, l);
+    }
   }
   return Status::OK();
 }
@@ -3199,6 +4166,65 @@ void CatalogManager::SendCreateTabletRequest(const scoped_refptr<TabletInfo>& ta
   }
 }
 
+void CatalogManager::SendCreateTabletsRequests(const vector<TabletInfo*>& tablets) {
+  // The tablets are batched by table and by tablet server, so that each
+  // server gets its requests at once, with all servers in parallel.
+  typedef pair<TableInfo*, string> BatchKey;
+  map<BatchKey, tserver::CreateTabletsRequestPB> batches;
+  auto send_batch = [&](const BatchKey& key, tserver::CreateTabletsRequestPB* req) {
+    scoped_refptr<TableInfo> table(key.first);
+    AsyncCreateReplicas* task = new AsyncCreateReplicas(master_, key.second, table,
+                                                        std::move(*req));
+    table->AddTask(task);
+    WARN_NOT_OK(task->Run(), "Failed to send new tablets request");
+    req->Clear();
+  };
+
+  const MonoTime now = MonoTime::Now();
+  for (TabletInfo* tablet : tablets) {
+    TabletMetadataLock l(tablet, TabletMetadataLock::READ);
+    tablet->set_last_create_tablet_time(now);
+    for (const RaftPeerPB& peer : l.data().pb.committed_consensus_state().config().peers()) {
+      BatchKey key(tablet->table().get(), peer.permanent_uuid());
+      tserver::CreateTabletsRequestPB* req = &batches[key];
+      req->set_dest_uuid(peer.permanent_uuid());
+      BuildCreateTabletRequest(peer.permanent_uuid(), tablet, l, req->add_tablets());
+      if (req->tablets_size() >= FLAGS_master_create_tablets_batch_size) {
+        send_batch(key, req);
+      }
+    }
+  }
+  for (auto& e : batches) {
+    if (e.second.tablets_size() > 0) {
+      send_batch(e.first, &e.second);
+    }
+  }
+}
+
+namespace {
+
+// Returns the share of 'a' in the sum of 'a' and 'b', and 0.5 if both are 0.
+// Values which differ by less than 'tolerance' of the larger one are
+// considered equal, so that noise in the load statistics doesn't decide
+// between otherwise equal servers.
+double LoadShare(double a, double b, double tolerance = 0) {
+  double sum = a + b;
+  if (sum <= 0 || std::abs(a - b) <= tolerance * std::max(a, b)) {
+    return 0.5;
+  }
+  return a / sum;
+}
+
+double TotalBytesFree(const TServerLoadPB& load) {
+  double total = 0;
+  for (int64_t bytes_free : load.data_dir_bytes_free()) {
+    total += bytes_free;
+  }
+  return total;
+}
+
+} // anonymous namespace
+
 shared_ptr<TSDescriptor> CatalogManager::PickBetterReplicaLocation(
     const TSDescriptorVector& two_choices) {
   DCHECK_EQ(two_choices.size(), 2);
@@ -3220,10 +4246,60 @@ shared_ptr<TSDescriptor> CatalogManager::PickBetterReplicaLocation(
   // we batch the selection process before sending any creation commands to the
   // servers themselves.
   //
-  // TODO: in the future we may want to factor in other items such as available disk space,
-  // actual request load, etc.
-  double load_a = a->RecentReplicaCreations() + a->num_live_replicas();
-  double load_b = b->RecentReplicaCreations() + b->num_live_replicas();
+  // Each server's share of the load in other dimensions reported by the
+  // servers, such as free disk space and request rates, is weighed in as
+  // well. Using the shares of the pair's total, each between 0 and 1, lets
+  // dimensions with different units be weighted against each other. A
+  // dimension which either server didn't report is ignored.
+  double replicas_a = a->RecentReplicaCreations() + a->num_live_replicas();
+  double replicas_b = b->RecentReplicaCreations() + b->num_live_replicas();
+  double share_a = LoadShare(replicas_a, replicas_b);
+  double load_a = FLAGS_replica_placement_replicas_weight * share_a;
+  double load_b = FLAGS_replica_placement_replicas_weight * (1 - share_a);
+
+  const double kTolerance = 0.05;
+  TServerLoadPB stats_a;
+  TServerLoadPB stats_b;
+  a->GetLoad(&stats_a);
+  b->GetLoad(&stats_b);
+  // A server with degraded data directories is avoided whatever its load,
+  // unless both are degraded.
+  bool degraded_a = stats_a.num_degraded_data_dirs() > 0;
+  bool degraded_b = stats_b.num_degraded_data_dirs() > 0;
+  if (degraded_a != degraded_b) {
+    return degraded_a ? b : a;
+  }
+  auto add_dimension = [&](double weight, double value_a, double value_b) {
+    double share = LoadShare(value_a, value_b, kTolerance);
+    load_a += weight * share;
+    load_b += weight * (1 - share);
+  };
+  if (stats_a.data_dir_bytes_free_size() > 0 && stats_b.data_dir_bytes_free_size() > 0) {
+    // Less free space is more load.
+    add_dimension(FLAGS_replica_placement_disk_weight,
+                  TotalBytesFree(stats_b), TotalBytesFree(stats_a));
+  }
+  if (stats_a.has_cpu_utilization() && stats_b.has_cpu_utilization()) {
+    add_dimension(FLAGS_replica_placement_cpu_weight,
+                  stats_a.cpu_utilization(), stats_b.cpu_utilization());
+  }
+  if (stats_a.has_memory_pressure() && stats_b.has_memory_pressure()) {
+    add_dimension(FLAGS_replica_placement_memory_weight,
+                  stats_a.memory_pressure(), stats_b.memory_pressure());
+  }
+  if (stats_a.has_rows_written_per_sec() && stats_b.has_rows_written_per_sec()) {
+    add_dimension(FLAGS_replica_placement_write_rate_weight,
+                  stats_a.rows_written_per_sec(), stats_b.rows_written_per_sec());
+  }
+  if (stats_a.has_rows_scanned_per_sec() && stats_b.has_rows_scanned_per_sec()) {
+    add_dimension(FLAGS_replica_placement_scan_rate_weight,
+                  stats_a.rows_scanned_per_sec(), stats_b.rows_scanned_per_sec());
+  }
+  if (stats_a.has_num_leaders() && stats_b.has_num_leaders()) {
+    add_dimension(FLAGS_replica_placement_leaders_weight,
+                  stats_a.num_leaders(), stats_b.num_leaders());
+  }
+
   if (load_a < load_b) {
     return a;
   } else if (load_b < load_a) {
@@ -3312,6 +4388,14 @@ void CatalogManager::SelectReplicas(const TSDescriptorVector& ts_descs,
 
 Status CatalogManager::BuildLocationsForTablet(const scoped_refptr<TabletInfo>& tablet,
                                                TabletLocationsPB* locs_pb) {
+  // Only running tablets have their locations cached, so a cache hit needs
+  // none of the checks below.
+  shared_ptr<const TabletLocationsPB> cached = tablet->GetCachedLocations();
+  if (cached) {
+    locs_pb->CopyFrom(*cached);
+    return Status::OK();
+  }
+
   TabletMetadataLock l_tablet(tablet.get(), TabletMetadataLock::READ);
   if (PREDICT_FALSE(l_tablet.data().is_deleted())) {
     return Status::NotFound("Tablet deleted", l_tablet.data().pb.state_msg());
@@ -3324,6 +4408,10 @@ Status CatalogManager::BuildLocationsForTablet(const scoped_refptr<TabletInfo>&
   // Guaranteed because the tablet is RUNNING.
   DCHECK(l_tablet.data().pb.has_committed_consensus_state());
 
+  // The metadata can't be mutated while it's locked for read.
+  int64_t version = tablet->metadata().version();
+  bool all_registered = true;
+
   const ConsensusStatePB& cstate = l_tablet.data().pb.committed_consensus_state();
   for (const consensus::RaftPeerPB& peer : cstate.config().peers()) {
     // TODO: GetConsensusRole() iterates over all of the peers, making this an
@@ -3345,6 +4433,7 @@ Status CatalogManager::BuildLocationsForTablet(const scoped_refptr<TabletInfo>&
       //
       // TODO: We should track these RPC addresses in the master table itself.
       tsinfo_pb->add_rpc_addresses()->CopyFrom(peer.last_known_addr());
+      all_registered = false;
     }
   }
 
@@ -3354,6 +4443,14 @@ Status CatalogManager::BuildLocationsForTablet(const scoped_refptr<TabletInfo>&
   // No longer used; always set to false.
   locs_pb->set_deprecated_stale(false);
 
+  // A tablet server can't re-register with different addresses, so the
+  // locations stay valid until the tablet's metadata is next mutated. The
+  // fallback addresses of unregistered servers aren't cached, so that their
+  // registered addresses are returned once they heartbeat.
+  if (all_registered) {
+    tablet->SetCachedLocations(
+        version, shared_ptr<const TabletLocationsPB>(new TabletLocationsPB(*locs_pb)));
+  }
   return Status::OK();
 }
 
@@ -3608,7 +4705,8 @@ TabletInfo::TabletInfo(const scoped_refptr<TableInfo>& table,
     : tablet_id_(std::move(tablet_id)),
       table_(table),
       last_create_tablet_time_(MonoTime::Now()),
-      reported_schema_version_(0) {}
+      reported_schema_version_(0),
+      split_candidate_(false) {}
 
 TabletInfo::~TabletInfo() {
 }
@@ -3637,6 +4735,66 @@ uint32_t TabletInfo::reported_schema_version() const {
   return reported_schema_version_;
 }
 
+void TabletInfo::UpdateLoad(const string& ts_uuid, const TabletStatsPB& stats) {
+  MonoTime now = MonoTime::Now();
+  std::lock_guard<simple_spinlock> l(lock_);
+  load_.ts_uuid = ts_uuid;
+  load_.on_disk_size = stats.on_disk_size();
+  load_.write_latency_p99_us = stats.write_latency_p99_us();
+  load_.split_key = stats.split_key();
+  if (ts_uuid == last_stats_uuid_ && last_stats_time_.Initialized()) {
+    double elapsed_secs = (now - last_stats_time_).ToSeconds();
+    if (elapsed_secs > 0) {
+      // The totals restart when the replica is reopened.
+      load_.rows_written_per_sec =
+          std::max<int64_t>(0, stats.rows_written() - last_stats_.rows_written()) / elapsed_secs;
+      load_.rows_scanned_per_sec =
+          std::max<int64_t>(0, stats.rows_scanned() - last_stats_.rows_scanned()) / elapsed_secs;
+      load_.bytes_scanned_per_sec =
+          std::max<int64_t>(0, stats.bytes_scanned() - last_stats_.bytes_scanned()) / elapsed_secs;
+    }
+  } else {
+    // The rates of another replica aren't comparable.
+    load_.rows_written_per_sec = 0;
+    load_.rows_scanned_per_sec = 0;
+    load_.bytes_scanned_per_sec = 0;
+  }
+  last_stats_uuid_ = ts_uuid;
+  last_stats_ = stats;
+  last_stats_time_ = now;
+}
+
+TabletInfo::Load TabletInfo::load() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return load_;
+}
+
+bool TabletInfo::set_split_candidate(bool split_candidate) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  bool newly = split_candidate && !split_candidate_;
+  split_candidate_ = split_candidate;
+  return newly;
+}
+
+bool TabletInfo::split_candidate() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return split_candidate_;
+}
+
+shared_ptr<const TabletLocationsPB> TabletInfo::GetCachedLocations() const {
+  shared_ptr<const CachedLocations> cached = std::atomic_load(&cached_locations_);
+  if (!cached || cached->version != metadata_.version()) {
+    return nullptr;
+  }
+  return cached->locations;
+}
+
+void TabletInfo::SetCachedLocations(int64_t version,
+                                    shared_ptr<const TabletLocationsPB> locations) {
+  std::atomic_store(&cached_locations_, shared_ptr<const CachedLocations>(
+      new CachedLocations { version, std::move(locations) }));
+}
+
 std::string TabletInfo::ToString() const {
   return Substitute("$0 (table $1)", tablet_id_,
                     (table_ != nullptr ? table_->ToString() : "MISSING"));
@@ -3730,6 +4888,27 @@ void TableInfo::GetTabletsInRange(const GetTableLocationsRequestPB* req,
   }
 }
 
+void TableInfo::GetTabletsOverlapping(const string& partition_key_start,
+                                      const string& partition_key_end,
+                                      vector<scoped_refptr<TabletInfo>>* ret) const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  auto it = tablet_map_.upper_bound(partition_key_start);
+  if (it != tablet_map_.begin()) {
+    // The tablet starting at or before the start key overlaps the range
+    // unless it ends before it.
+    TabletInfo* prev = std::prev(it)->second;
+    TabletMetadataLock tablet_lock(prev, TabletMetadataLock::READ);
+    const string& prev_end = tablet_lock.data().pb.partition().partition_key_end();
+    if (prev_end.empty() || prev_end > partition_key_start) {
+      ret->push_back(make_scoped_refptr(prev));
+    }
+  }
+  for (; it != tablet_map_.end() &&
+         (partition_key_end.empty() || it->first < partition_key_end); ++it) {
+    ret->push_back(make_scoped_refptr(it->second));
+  }
+}
+
 bool TableInfo::IsAlterInProgress(uint32_t version) const {
   std::lock_guard<simple_spinlock> l(lock_);
   for (const TableInfo::TabletInfoMap::value_type& e : tablet_map_) {
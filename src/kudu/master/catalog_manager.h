@@ -19,6 +19,7 @@
 
 #include <boost/optional/optional_fwd.hpp>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -29,6 +30,7 @@
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/master/master.pb.h"
+#include "kudu/master/rebalancer.h"
 #include "kudu/master/ts_manager.h"
 #include "kudu/server/monitored_task.h"
 #include "kudu/tserver/tablet_peer_lookup.h"
@@ -120,6 +122,43 @@ class TabletInfo : public RefCountedThreadSafe<TabletInfo> {
   bool set_reported_schema_version(uint32_t version);
   uint32_t reported_schema_version() const;
 
+  // The load of the tablet, from the statistics reported by its leader.
+  struct Load {
+    // The UUID of the tablet server of the leader which reported it.
+    std::string ts_uuid;
+
+    int64_t on_disk_size = 0;
+    double rows_written_per_sec = 0;
+    double rows_scanned_per_sec = 0;
+    double bytes_scanned_per_sec = 0;
+    int64_t write_latency_p99_us = 0;
+
+    // An encoded primary key splitting the tablet in about equal halves, or
+    // empty if unknown.
+    std::string split_key;
+  };
+
+  // Updates the load from 'stats', reported by the leader on the tablet
+  // server 'ts_uuid'. The rates are computed against the previous statistics
+  // reported by the same server.
+  void UpdateLoad(const std::string& ts_uuid, const TabletStatsPB& stats);
+  Load load() const;
+
+  // Accessors for whether the tablet is a candidate for splitting. The
+  // setter returns true if the tablet wasn't a candidate before.
+  bool set_split_candidate(bool split_candidate);
+  bool split_candidate() const;
+
+  // Returns the locations cached by SetCachedLocations(), or nullptr if there
+  // are none or the metadata was mutated since they were built.
+  //
+  // No synchronization needed.
+  std::shared_ptr<const TabletLocationsPB> GetCachedLocations() const;
+
+  // Caches 'locations', built from the metadata at version 'version'.
+  void SetCachedLocations(int64_t version,
+                          std::shared_ptr<const TabletLocationsPB> locations);
+
   // No synchronization needed.
   std::string ToString() const;
 
@@ -142,6 +181,24 @@ class TabletInfo : public RefCountedThreadSafe<TabletInfo> {
   // Reported schema version (in-memory only).
   uint32_t reported_schema_version_;
 
+  // The load and the statistics it was last updated from (in-memory only).
+  Load load_;
+  std::string last_stats_uuid_;
+  TabletStatsPB last_stats_;
+  MonoTime last_stats_time_;
+
+  bool split_candidate_;
+
+  struct CachedLocations {
+    // The version of 'metadata_' the locations were built from.
+    int64_t version;
+    std::shared_ptr<const TabletLocationsPB> locations;
+  };
+
+  // Not protected by 'lock_': swapped with std::atomic_store() so that
+  // location lookups don't contend with each other.
+  std::shared_ptr<const CachedLocations> cached_locations_;
+
   DISALLOW_COPY_AND_ASSIGN(TabletInfo);
 };
 
@@ -205,6 +262,13 @@ class TableInfo : public RefCountedThreadSafe<TableInfo> {
   void GetTabletsInRange(const GetTableLocationsRequestPB* req,
                          std::vector<scoped_refptr<TabletInfo> > *ret) const;
 
+  // Appends the tablets whose partitions overlap the partition key range
+  // [partition_key_start, partition_key_end), in partition key sorted order.
+  // An empty 'partition_key_end' is unbounded.
+  void GetTabletsOverlapping(const std::string& partition_key_start,
+                             const std::string& partition_key_end,
+                             std::vector<scoped_refptr<TabletInfo>>* ret) const;
+
   // Adds all tablets to the vector in partition key sorted order.
   void GetAllTablets(std::vector<scoped_refptr<TabletInfo> > *ret) const;
 
@@ -278,6 +342,44 @@ class MetadataLock : public CowLock<typename MetadataClass::cow_state> {
 typedef MetadataLock<TabletInfo> TabletMetadataLock;
 typedef MetadataLock<TableInfo> TableMetadataLock;
 
+// The load of a set of tablets, summed from the loads of the tablets.
+struct LoadSummary {
+  void Add(const TabletInfo::Load& load);
+
+  int num_tablets = 0;
+  int64_t on_disk_size = 0;
+  double rows_written_per_sec = 0;
+  double rows_scanned_per_sec = 0;
+  double bytes_scanned_per_sec = 0;
+
+  // The highest p99 write latency of the tablets.
+  int64_t max_write_latency_p99_us = 0;
+};
+
+// The load of the tablets of a table, in total and per range partition.
+struct TableLoadSummary {
+  struct Range {
+    // A text description of the range partition.
+    std::string description;
+    LoadSummary load;
+  };
+
+  std::string table_name;
+  LoadSummary total;
+
+  // Keyed by the encoded start range key of the range partitions.
+  std::map<std::string, Range> ranges;
+};
+
+// The load of the tablets of the cluster, per table and per tablet server.
+struct ClusterLoadSummary {
+  // Keyed by table ID.
+  std::map<std::string, TableLoadSummary> tables;
+
+  // The load of the tablets led by each tablet server, keyed by UUID.
+  std::map<std::string, LoadSummary> tablet_servers;
+};
+
 // The component of the master which tracks the state and location
 // of tables/tablets in the cluster.
 //
@@ -461,6 +563,14 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
                              TabletReportUpdatesPB *report_update,
                              rpc::RpcContext* rpc);
 
+  // Update the load of the tablets with the statistics in heartbeat 'req'
+  // from the given tablet server, and log the tablets which become
+  // candidates for splitting.
+  void ProcessTabletStats(TSDescriptor* ts_desc, const TSHeartbeatRequestPB& req);
+
+  // Sums the load of the tablets of the running tables into 'summary'.
+  Status GetClusterLoadSummary(ClusterLoadSummary* summary);
+
   SysCatalogTable* sys_catalog() { return sys_catalog_.get(); }
 
   // Dump all of the current state about tables and tablets to the
@@ -479,6 +589,9 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
   // NOTE: This should only be used by tests or web-ui
   Status GetAllTables(std::vector<scoped_refptr<TableInfo>>* tables);
 
+  // Returns the rebalancer, for its status and pending moves.
+  const Rebalancer* rebalancer() const { return rebalancer_.get(); }
+
   // Check if a table exists by name, setting 'exist' appropriately. May fail
   // if the catalog manager is not yet running. Caller must hold leader_lock_.
   //
@@ -516,12 +629,25 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
   // This test calls VisitTablesAndTablets() directly.
   FRIEND_TEST(kudu::CreateTableStressTest, TestConcurrentCreateTableAndReloadMetadata);
 
+  // This test calls PreloadCatalog() and VisitTablesAndTablets() directly.
+  FRIEND_TEST(MasterTest, TestPreloadCatalog);
+
   friend class TableLoader;
   friend class TabletLoader;
 
   typedef std::unordered_map<std::string, scoped_refptr<TableInfo>> TableInfoMap;
   typedef std::unordered_map<std::string, scoped_refptr<TabletInfo>> TabletInfoMap;
 
+  // Table and tablet metadata loaded from the sys catalog.
+  struct LoadedCatalog {
+    TableInfoMap table_names_map;
+    TableInfoMap table_ids_map;
+    TabletInfoMap tablet_map;
+
+    // The sys catalog's NumRowsWritten() before it was visited.
+    int64_t num_rows_written;
+  };
+
   // Called by SysCatalog::SysCatalogStateChanged when this node
   // becomes the leader of a consensus configuration. Executes VisitTablesAndTabletsTask
   // via 'worker_pool_'.
@@ -543,11 +669,23 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
   // reload table/tablet metadata into memory.
   void VisitTablesAndTabletsTask();
 
-  // Clears out the existing metadata ('table_names_map_', 'table_ids_map_',
-  // and 'tablet_map_'), loads tables metadata into memory and if successful
-  // loads the tablets metadata.
+  // Replaces the existing metadata ('table_names_map_', 'table_ids_map_',
+  // and 'tablet_map_') with the tables and tablets metadata of the sys
+  // catalog. The metadata preloaded by PreloadCatalog() is used if the sys
+  // catalog hasn't been written to since; otherwise it is loaded anew.
+  //
+  // 'lock_' is only held to swap in the new metadata.
   Status VisitTablesAndTablets();
 
+  // Loads the tables and tablets metadata of the sys catalog into 'catalog'.
+  Status LoadCatalog(LoadedCatalog* catalog);
+
+  // Loads the tables and tablets metadata of the sys catalog into
+  // 'preloaded_catalog_', unless it's already up to date. Called on
+  // followers, so that a newly elected leader doesn't need to reload the
+  // whole catalog while holding 'leader_lock_'.
+  void PreloadCatalog();
+
   // Helper for initializing 'sys_catalog_'. After calling this
   // method, the caller should call WaitUntilRunning() on sys_catalog_
   // WITHOUT holding 'lock_' to wait for consensus to start for
@@ -572,6 +710,10 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
   // Builds the TabletLocationsPB for a tablet based on the provided TabletInfo.
   // Populates locs_pb and returns true on success.
   // Returns Status::ServiceUnavailable if tablet is not running.
+  //
+  // The locations are cached in the TabletInfo until its metadata is next
+  // mutated, so repeated lookups skip the metadata lock and the tablet server
+  // registrations.
   Status BuildLocationsForTablet(const scoped_refptr<TabletInfo>& tablet,
                                  TabletLocationsPB* locs_pb);
 
@@ -584,6 +726,13 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
                               const ReportedTabletPB& report,
                               ReportedTabletUpdatesPB *report_updates);
 
+  // Sets 'expanded' to a copy of 'report' whose 'compact_consensus_state' is
+  // replaced by the committed consensus state it stands for, rebuilt from the
+  // master's copy of the tablet's config. Returns false if that copy has a
+  // different opid_index, in which case the full consensus state is needed.
+  bool ExpandCompactConsensusState(const ReportedTabletPB& report,
+                                   ReportedTabletPB* expanded);
+
   Status HandleRaftConfigChanged(const ReportedTabletPB& report,
                                  const scoped_refptr<TabletInfo>& tablet,
                                  TabletMetadataLock* tablet_lock,
@@ -664,6 +813,12 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
   void SendCreateTabletRequest(const scoped_refptr<TabletInfo>& tablet,
                                const TabletMetadataLock& tablet_lock);
 
+  // Like SendCreateTabletRequest() for each of 'tablets', but batches the
+  // requests in CreateTablets RPCs by table and tablet server.
+  //
+  // The tablet locks must not be held.
+  void SendCreateTabletsRequests(const std::vector<TabletInfo*>& tablets);
+
   // Send the "alter table request" to all tablets of the specified table.
   void SendAlterTableRequest(const scoped_refptr<TableInfo>& table);
 
@@ -694,8 +849,34 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
 
   // Start a task to change the config to add an additional voter because the
   // specified tablet is under-replicated.
+  //
+  // If 'replica_uuid' is not empty, the voter is added on that tablet server
+  // instead of a randomly selected one.
   void SendAddServerRequest(const scoped_refptr<TabletInfo>& tablet,
-                            const consensus::ConsensusStatePB& cstate);
+                            const consensus::ConsensusStatePB& cstate,
+                            const std::string& replica_uuid = "");
+
+  // Start a task to change the config to remove the voter on 'replica_uuid'.
+  void SendRemoveServerRequest(const scoped_refptr<TabletInfo>& tablet,
+                               const consensus::ConsensusStatePB& cstate,
+                               const std::string& replica_uuid);
+
+  // Start a task to ask the leader replica of 'tablet', on 'leader_uuid', to
+  // step down.
+  void SendLeaderStepDownRequest(const scoped_refptr<TabletInfo>& tablet,
+                                 const std::string& leader_uuid);
+
+  // Makes progress on the rebalancer's pending replica moves, and starts new
+  // replica moves and leader step downs if the tablet servers are unbalanced.
+  //
+  // Caller must hold leader_lock_ for reading.
+  void RunRebalancer();
+
+  // Adds the upcoming range partitions, and drops the expired ones, of the
+  // tables with a range partition interval.
+  //
+  // Caller must hold leader_lock_ for reading.
+  void RunAutoRangePartitioning();
 
   std::string GenerateId() { return oid_generator_.Next(); }
 
@@ -740,6 +921,8 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
   // Random number generator used for selecting replica locations.
   ThreadSafeRandom rng_;
 
+  gscoped_ptr<Rebalancer> rebalancer_;
+
   gscoped_ptr<SysCatalogTable> sys_catalog_;
 
   // Background thread, used to execute the catalog manager tasks
@@ -758,6 +941,13 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
   mutable simple_spinlock state_lock_;
   State state_;
 
+  // Lock protecting preloaded_catalog_.
+  simple_spinlock preloaded_catalog_lock_;
+
+  // The metadata last loaded by PreloadCatalog(), consumed by the next
+  // VisitTablesAndTablets().
+  std::unique_ptr<LoadedCatalog> preloaded_catalog_;
+
   // Singleton pool that serializes invocations of ElectedAsLeaderCb().
   gscoped_ptr<ThreadPool> leader_election_pool_;
 
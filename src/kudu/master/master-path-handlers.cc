@@ -28,6 +28,7 @@
 #include <vector>
 
 #include <boost/bind.hpp>
+#include <gflags/gflags.h>
 
 #include "kudu/common/partition.h"
 #include "kudu/common/schema.h"
@@ -36,17 +37,21 @@
 #include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/human_readable.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/server/webui_util.h"
 #include "kudu/master/catalog_manager.h"
 #include "kudu/master/master.h"
 #include "kudu/master/master.pb.h"
+#include "kudu/master/rebalancer.h"
 #include "kudu/master/sys_catalog.h"
 #include "kudu/master/ts_descriptor.h"
 #include "kudu/master/ts_manager.h"
 #include "kudu/util/string_case.h"
 #include "kudu/util/url-coding.h"
 
+DECLARE_bool(master_rebalancer_enabled);
+
 namespace kudu {
 
 using consensus::ConsensusStatePB;
@@ -232,7 +237,7 @@ void MasterPathHandlers::HandleTablePage(const Webserver::WebRequest& req,
   tablets_output << "<h3>Tablets</h3>";
   tablets_output << "<table class='table table-striped'>\n";
   tablets_output << "  <tr><th>Tablet ID</th><th>Partition</th><th>State</th>"
-      "<th>Message</th><th>Peers</th></tr>\n";
+      "<th>Message</th><th>Peers</th><th>Load</th></tr>\n";
   for (const scoped_refptr<TabletInfo>& tablet : tablets) {
     vector<pair<string, RaftPeerPB::Role>> sorted_replicas;
     TabletMetadataLock l(tablet.get(), TabletMetadataLock::READ);
@@ -274,13 +279,22 @@ void MasterPathHandlers::HandleTablePage(const Webserver::WebRequest& req,
 
     string state = SysTabletsEntryPB_State_Name(l.data().pb.state());
     Capitalize(&state);
+    TabletInfo::Load load = tablet->load();
+    string load_html = Substitute("$0 on disk<br>$1 rows written/s<br>$2 rows scanned/s",
+                                  HumanReadableNumBytes::ToString(load.on_disk_size),
+                                  StringPrintf("%.1f", load.rows_written_per_sec),
+                                  StringPrintf("%.1f", load.rows_scanned_per_sec));
+    if (tablet->split_candidate()) {
+      load_html += "<br><b>Split candidate</b>";
+    }
     tablets_output << Substitute(
-        "<tr><th>$0</th><td>$1</td><td>$2</td><td>$3</td><td>$4</td></tr>\n",
+        "<tr><th>$0</th><td>$1</td><td>$2</td><td>$3</td><td>$4</td><td>$5</td></tr>\n",
         tablet->tablet_id(),
         EscapeForHtmlToString(partition_schema.PartitionDebugString(partition, schema)),
         state,
         EscapeForHtmlToString(l.data().pb.state_msg()),
-        raft_config_html.str());
+        raft_config_html.str(),
+        load_html);
   }
   tablets_output << "</table>\n";
 
@@ -502,6 +516,186 @@ void MasterPathHandlers::HandleDumpEntities(const Webserver::WebRequest& req,
   jw.EndObject();
 }
 
+void MasterPathHandlers::HandleRebalancer(const Webserver::WebRequest& req,
+                                          ostringstream* output) {
+  const Rebalancer* rebalancer = master_->catalog_manager()->rebalancer();
+  *output << "<h1>Rebalancer</h1>\n";
+  *output << Substitute("<p>The rebalancer is $0. It only runs on the leader master.</p>\n",
+                        FLAGS_master_rebalancer_enabled ? "enabled" : "disabled");
+
+  *output << "<table class='table table-striped'>\n";
+  *output << Substitute("<tr><th>Replica moves started</th><td>$0</td></tr>\n",
+                        rebalancer->num_moves_started());
+  *output << Substitute("<tr><th>Replica moves completed</th><td>$0</td></tr>\n",
+                        rebalancer->num_moves_completed());
+  *output << Substitute("<tr><th>Replica moves abandoned</th><td>$0</td></tr>\n",
+                        rebalancer->num_moves_abandoned());
+  *output << Substitute("<tr><th>Leader step downs</th><td>$0</td></tr>\n",
+                        rebalancer->num_leader_step_downs());
+  *output << "</table>\n";
+
+  vector<Rebalancer::PendingMove> moves;
+  rebalancer->GetPendingMoves(&moves);
+  *output << "<h2>Replica Moves in Progress</h2>\n";
+  if (moves.empty()) {
+    *output << "<p>There are no replica moves in progress.</p>\n";
+    return;
+  }
+  *output << "<table class='table table-striped'>\n";
+  *output << "<tr><th>Tablet</th><th>From</th><th>To</th><th>Time Elapsed</th>"
+          << "<th>New Replica Running</th></tr>\n";
+  MonoTime now = MonoTime::Now();
+  for (const Rebalancer::PendingMove& pending : moves) {
+    *output << Substitute(
+        "<tr><td>$0</td><td>$1</td><td>$2</td><td>$3</td><td>$4</td></tr>\n",
+        EscapeForHtmlToString(pending.move.tablet_id),
+        EscapeForHtmlToString(pending.move.from_uuid),
+        EscapeForHtmlToString(pending.move.to_uuid),
+        StringPrintf("%.1fs", (now - pending.start_time).ToSeconds()),
+        pending.target_running ? "yes" : "no");
+  }
+  *output << "</table>\n";
+}
+
+namespace {
+
+// Returns the cells of 'load' in a row of the load page.
+string LoadSummaryToHtmlCells(const LoadSummary& load) {
+  return Substitute("<td>$0</td><td>$1</td><td>$2</td><td>$3</td><td>$4</td><td>$5</td>",
+                    load.num_tablets,
+                    HumanReadableNumBytes::ToString(load.on_disk_size),
+                    StringPrintf("%.1f", load.rows_written_per_sec),
+                    StringPrintf("%.1f", load.rows_scanned_per_sec),
+                    HumanReadableNumBytes::ToString(load.bytes_scanned_per_sec),
+                    load.max_write_latency_p99_us);
+}
+
+const char* const kLoadSummaryHeaders =
+    "<th>Tablets</th><th>On Disk</th><th>Rows Written/s</th><th>Rows Scanned/s</th>"
+    "<th>Bytes Scanned/s</th><th>Max p99 Write Latency (us)</th>";
+
+void LoadSummaryToJson(const LoadSummary& load, JsonWriter* jw) {
+  jw->StartObject();
+  jw->String("num_tablets");
+  jw->Int(load.num_tablets);
+  jw->String("on_disk_size");
+  jw->Int64(load.on_disk_size);
+  jw->String("rows_written_per_sec");
+  jw->Double(load.rows_written_per_sec);
+  jw->String("rows_scanned_per_sec");
+  jw->Double(load.rows_scanned_per_sec);
+  jw->String("bytes_scanned_per_sec");
+  jw->Double(load.bytes_scanned_per_sec);
+  jw->String("max_write_latency_p99_us");
+  jw->Int64(load.max_write_latency_p99_us);
+  jw->EndObject();
+}
+
+} // anonymous namespace
+
+void MasterPathHandlers::HandleLoad(const Webserver::WebRequest& req,
+                                    ostringstream* output) {
+  CatalogManager::ScopedLeaderSharedLock l(master_->catalog_manager());
+  if (!l.first_failed_status().ok()) {
+    *output << "Master is not ready: " << l.first_failed_status().ToString();
+    return;
+  }
+  ClusterLoadSummary summary;
+  Status s = master_->catalog_manager()->GetClusterLoadSummary(&summary);
+  if (!s.ok()) {
+    *output << "Unable to summarize the load: " << s.ToString();
+    return;
+  }
+
+  *output << "<h1>Load</h1>\n";
+  *output << "<p>The load of the tablets, as reported by their leaders to the leader "
+          << "master. It is also available as <a href=\"/load-json\">JSON</a>.</p>\n";
+
+  *output << "<h2>Tablet Servers</h2>\n";
+  *output << "<table class='table table-striped'>\n";
+  *output << "<tr><th>UUID</th>" << kLoadSummaryHeaders << "</tr>\n";
+  for (const auto& e : summary.tablet_servers) {
+    *output << Substitute("<tr><td>$0</td>$1</tr>\n", EscapeForHtmlToString(e.first),
+                          LoadSummaryToHtmlCells(e.second));
+  }
+  *output << "</table>\n";
+
+  *output << "<h2>Tables</h2>\n";
+  *output << "<table class='table table-striped'>\n";
+  *output << "<tr><th>Table</th><th>Range Partition</th>" << kLoadSummaryHeaders << "</tr>\n";
+  for (const auto& e : summary.tables) {
+    const TableLoadSummary& table = e.second;
+    *output << Substitute("<tr><th><a href=\"/table?id=$0\">$1</a></th><td>All</td>$2</tr>\n",
+                          EscapeForHtmlToString(e.first),
+                          EscapeForHtmlToString(table.table_name),
+                          LoadSummaryToHtmlCells(table.total));
+    if (table.ranges.size() < 2) {
+      continue;
+    }
+    for (const auto& range : table.ranges) {
+      *output << Substitute("<tr><td></td><td>$0</td>$1</tr>\n",
+                            EscapeForHtmlToString(range.second.description),
+                            LoadSummaryToHtmlCells(range.second.load));
+    }
+  }
+  *output << "</table>\n";
+}
+
+void MasterPathHandlers::HandleLoadJson(const Webserver::WebRequest& req,
+                                        ostringstream* output) {
+  CatalogManager::ScopedLeaderSharedLock l(master_->catalog_manager());
+  if (!l.first_failed_status().ok()) {
+    JsonError(l.first_failed_status(), output);
+    return;
+  }
+  ClusterLoadSummary summary;
+  Status s = master_->catalog_manager()->GetClusterLoadSummary(&summary);
+  if (!s.ok()) {
+    JsonError(s, output);
+    return;
+  }
+
+  JsonWriter jw(output, JsonWriter::COMPACT);
+  jw.StartObject();
+  jw.String("tablet_servers");
+  jw.StartArray();
+  for (const auto& e : summary.tablet_servers) {
+    jw.StartObject();
+    jw.String("uuid");
+    jw.String(e.first);
+    jw.String("load");
+    LoadSummaryToJson(e.second, &jw);
+    jw.EndObject();
+  }
+  jw.EndArray();
+
+  jw.String("tables");
+  jw.StartArray();
+  for (const auto& e : summary.tables) {
+    jw.StartObject();
+    jw.String("table_id");
+    jw.String(e.first);
+    jw.String("table_name");
+    jw.String(e.second.table_name);
+    jw.String("load");
+    LoadSummaryToJson(e.second.total, &jw);
+    jw.String("range_partitions");
+    jw.StartArray();
+    for (const auto& range : e.second.ranges) {
+      jw.StartObject();
+      jw.String("range_partition");
+      jw.String(range.second.description);
+      jw.String("load");
+      LoadSummaryToJson(range.second.load, &jw);
+      jw.EndObject();
+    }
+    jw.EndArray();
+    jw.EndObject();
+  }
+  jw.EndArray();
+  jw.EndObject();
+}
+
 Status MasterPathHandlers::Register(Webserver* server) {
   bool is_styled = true;
   bool is_on_nav_bar = true;
@@ -517,6 +711,15 @@ Status MasterPathHandlers::Register(Webserver* server) {
   server->RegisterPathHandler("/masters", "Masters",
                               boost::bind(&MasterPathHandlers::HandleMasters, this, _1, _2),
                               is_styled, is_on_nav_bar);
+  server->RegisterPathHandler("/rebalancer", "Rebalancer",
+                              boost::bind(&MasterPathHandlers::HandleRebalancer, this, _1, _2),
+                              is_styled, is_on_nav_bar);
+  server->RegisterPathHandler("/load", "Load",
+                              boost::bind(&MasterPathHandlers::HandleLoad, this, _1, _2),
+                              is_styled, is_on_nav_bar);
+  server->RegisterPathHandler("/load-json", "",
+                              boost::bind(&MasterPathHandlers::HandleLoadJson, this, _1, _2),
+                              false, false);
   server->RegisterPathHandler("/dump-entities", "Dump Entities",
                               boost::bind(&MasterPathHandlers::HandleDumpEntities, this, _1, _2),
                               false, false);
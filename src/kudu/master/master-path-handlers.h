@@ -56,6 +56,12 @@ class MasterPathHandlers {
                      std::ostringstream* output);
   void HandleDumpEntities(const Webserver::WebRequest& req,
                           std::ostringstream* output);
+  void HandleRebalancer(const Webserver::WebRequest& req,
+                        std::ostringstream* output);
+  void HandleLoad(const Webserver::WebRequest& req,
+                  std::ostringstream* output);
+  void HandleLoadJson(const Webserver::WebRequest& req,
+                      std::ostringstream* output);
 
   // Convert the specified TSDescriptor to HTML, adding a link to the
   // tablet server's own webserver if specified in 'desc'.
@@ -26,7 +26,9 @@
 #include "kudu/common/partial_row.h"
 #include "kudu/common/row_operations.h"
 #include "kudu/generated/version_defines.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/join.h"
+#include "kudu/master/catalog_manager.h"
 #include "kudu/master/master.h"
 #include "kudu/master/master.proxy.h"
 #include "kudu/master/master-test-util.h"
@@ -189,6 +191,21 @@ TEST_F(MasterTest, TestRegisterAndHeartbeat) {
     ASSERT_FALSE(resp.has_tablet_report());
   }
 
+  // The load statistics in a heartbeat are kept for replica placement.
+  {
+    TSHeartbeatRequestPB req;
+    TSHeartbeatResponsePB resp;
+    RpcController rpc;
+    req.mutable_common()->CopyFrom(common);
+    req.mutable_load()->add_data_dir_bytes_free(1024);
+    req.mutable_load()->set_num_leaders(3);
+    ASSERT_OK(proxy_->TSHeartbeat(req, &resp, &rpc));
+
+    TServerLoadPB load;
+    ts_desc->GetLoad(&load);
+    ASSERT_EQ(req.load().ShortDebugString(), load.ShortDebugString());
+  }
+
   // If we send the registration RPC while the master isn't the leader, it
   // shouldn't ask for a full tablet report.
   {
@@ -606,6 +623,35 @@ TEST_F(MasterTest, TestCreateTableInvalidKeyType) {
   }
 }
 
+// A compression level which the tablet servers would only reject at flush
+// time must be rejected when the table is created.
+TEST_F(MasterTest, TestCreateTableInvalidCompressionLevel) {
+  ColumnStorageAttributes attributes(AUTO_ENCODING, ZSTD);
+  attributes.compression_level = 99;
+  const Schema kTableSchema({ ColumnSchema("key", INT32),
+                              ColumnSchema("val", STRING, true, nullptr, nullptr, attributes) },
+                            1);
+  Status s = CreateTable("testtb", kTableSchema);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  ASSERT_STR_CONTAINS(s.ToString(), "column `val`: invalid compression level");
+
+  // The default codec may resolve to ZSTD on the tablet servers.
+  attributes.compression = DEFAULT_COMPRESSION;
+  const Schema kDefaultCodecSchema(
+      { ColumnSchema("key", INT32),
+        ColumnSchema("val", STRING, true, nullptr, nullptr, attributes) },
+      1);
+  s = CreateTable("testtb", kDefaultCodecSchema);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+
+  // Codecs without levels ignore them.
+  attributes.compression = SNAPPY;
+  const Schema kSnappySchema({ ColumnSchema("key", INT32),
+                               ColumnSchema("val", STRING, true, nullptr, nullptr, attributes) },
+                             1);
+  ASSERT_OK(CreateTable("testtb", kSnappySchema));
+}
+
 // Regression test for KUDU-253/KUDU-592: crash if the schema passed to CreateTable
 // is invalid.
 TEST_F(MasterTest, TestCreateTableInvalidSchema) {
@@ -692,6 +738,45 @@ TEST_F(MasterTest, TestGetTableLocationsDuringRepeatedTableVisit) {
   t.join();
 }
 
+// Tests that the metadata preloaded by followers is only used by
+// VisitTablesAndTablets() if the sys catalog wasn't written to since.
+TEST_F(MasterTest, TestPreloadCatalog) {
+  Schema schema({ ColumnSchema("key", INT32) }, 1);
+  ASSERT_OK(CreateTable("first", schema));
+  CatalogManager* catalog = master_->catalog_manager();
+
+  // Nothing was written since the preload, so its metadata is swapped in.
+  catalog->PreloadCatalog();
+  scoped_refptr<TableInfo> preloaded;
+  {
+    std::lock_guard<simple_spinlock> l(catalog->preloaded_catalog_lock_);
+    ASSERT_TRUE(catalog->preloaded_catalog_ != nullptr);
+    preloaded = FindPtrOrNull(catalog->preloaded_catalog_->table_names_map, "first");
+    ASSERT_TRUE(preloaded != nullptr);
+  }
+  ASSERT_OK(catalog->VisitTablesAndTablets());
+  {
+    std::lock_guard<simple_spinlock> l(catalog->preloaded_catalog_lock_);
+    ASSERT_TRUE(catalog->preloaded_catalog_ == nullptr);
+  }
+  {
+    shared_lock<rw_spinlock> l(catalog->lock_);
+    ASSERT_EQ(preloaded.get(), FindPtrOrNull(catalog->table_names_map_, "first").get());
+  }
+
+  // A table created after the preload makes it stale, so the catalog is
+  // loaded anew.
+  catalog->PreloadCatalog();
+  ASSERT_OK(CreateTable("second", schema));
+  ASSERT_OK(catalog->VisitTablesAndTablets());
+  {
+    shared_lock<rw_spinlock> l(catalog->lock_);
+    ASSERT_EQ(2, catalog->table_names_map_.size());
+    ASSERT_TRUE(ContainsKey(catalog->table_names_map_, "second"));
+    ASSERT_NE(preloaded.get(), FindPtrOrNull(catalog->table_names_map_, "first").get());
+  }
+}
+
 // The catalog manager had a bug wherein GetTableSchema() interleaved with
 // CreateTable() could expose intermediate uncommitted state to clients. This
 // test ensures that bug does not regress.
@@ -50,6 +50,17 @@ DEFINE_int32(master_registration_rpc_timeout_ms, 1500,
              "Timeout for retrieving master registration over RPC.");
 TAG_FLAG(master_registration_rpc_timeout_ms, experimental);
 
+DEFINE_int32(master_tablet_report_threads, 4,
+             "Number of threads processing the tablet reports of tablet server "
+             "heartbeats.");
+TAG_FLAG(master_tablet_report_threads, advanced);
+
+DEFINE_int32(master_tablet_report_queue_size, 1000,
+             "Maximum number of heartbeats whose tablet reports are waiting to be "
+             "processed. Further heartbeats with tablet reports are rejected, and "
+             "resent by their tablet servers.");
+TAG_FLAG(master_tablet_report_queue_size, advanced);
+
 using std::min;
 using std::shared_ptr;
 using std::vector;
@@ -91,6 +102,10 @@ Status Master::Init() {
   cfile::BlockCache::GetSingleton()->StartInstrumentation(metric_entity());
 
   RETURN_NOT_OK(ThreadPoolBuilder("init").set_max_threads(1).Build(&init_pool_));
+  RETURN_NOT_OK(ThreadPoolBuilder("tablet-report")
+                .set_max_threads(FLAGS_master_tablet_report_threads)
+                .set_max_queue_size(FLAGS_master_tablet_report_queue_size)
+                .Build(&tablet_report_pool_));
 
   RETURN_NOT_OK(ServerBase::Init());
 
@@ -183,6 +198,9 @@ void Master::Shutdown() {
     LOG(INFO) << name << " shutting down...";
     maintenance_manager_->Shutdown();
     ServerBase::Shutdown();
+    // Process the queued tablet reports, so that their RPCs are responded to.
+    tablet_report_pool_->Wait();
+    tablet_report_pool_->Shutdown();
     catalog_manager_->Shutdown();
     LOG(INFO) << name << " shutdown complete.";
   }
@@ -100,6 +100,9 @@ class Master : public server::ServerBase {
     return maintenance_manager_.get();
   }
 
+  // The pool processing the tablet reports of tablet server heartbeats.
+  ThreadPool* tablet_report_pool() { return tablet_report_pool_.get(); }
+
  private:
   friend class MasterTest;
 
@@ -125,6 +128,9 @@ class Master : public server::ServerBase {
   // For initializing the catalog manager.
   gscoped_ptr<ThreadPool> init_pool_;
 
+  // For processing tablet reports off the RPC service threads.
+  gscoped_ptr<ThreadPool> tablet_report_pool_;
+
   // The status of the master initialization. This is set
   // by the async initialization task.
   Promise<Status> init_status_;
@@ -30,6 +30,7 @@
 #include "kudu/rpc/rpc_context.h"
 #include "kudu/server/webserver.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/threadpool.h"
 
 
 DEFINE_int32(master_inject_latency_on_tablet_lookups_ms, 0,
@@ -128,20 +129,55 @@ void MasterServiceImpl::TSHeartbeat(const TSHeartbeatRequestPB* req,
   // 4. Update tserver soft state based on the heartbeat contents.
   ts_desc->UpdateHeartbeatTime();
   ts_desc->set_num_live_replicas(req->num_live_tablets());
+  if (req->has_load()) {
+    ts_desc->UpdateLoad(req->load());
+  }
 
-  // 5. Only leaders handle tablet reports.
+  // 5. Only leaders handle tablet reports. They're processed on a dedicated
+  // pool, so that many large reports (e.g. after tablet servers restart)
+  // don't hold up the service threads; when its queue is full, the report is
+  // rejected and resent with the next heartbeat.
   if (is_leader_master && req->has_tablet_report()) {
-    Status s = server_->catalog_manager()->ProcessTabletReport(
-        ts_desc.get(), req->tablet_report(), resp->mutable_tablet_report(), rpc);
+    Status s = server_->tablet_report_pool()->SubmitFunc(
+        [this, ts_desc, req, resp, rpc]() { ProcessTabletReport(ts_desc, req, resp, rpc); });
     if (!s.ok()) {
-      rpc->RespondFailure(s.CloneAndPrepend("Failed to process tablet report"));
-      return;
+      rpc->RespondFailure(s.CloneAndPrepend("Unable to queue tablet report"));
     }
+    return;
   }
 
   rpc->RespondSuccess();
 }
 
+void MasterServiceImpl::ProcessTabletReport(const shared_ptr<TSDescriptor>& ts_desc,
+                                            const TSHeartbeatRequestPB* req,
+                                            TSHeartbeatResponsePB* resp,
+                                            rpc::RpcContext* rpc) {
+  CatalogManager::ScopedLeaderSharedLock l(server_->catalog_manager());
+  if (!l.CheckIsInitializedOrRespond(resp, rpc)) {
+    return;
+  }
+  if (!l.leader_status().ok()) {
+    // Leadership was lost while the report was queued. As with reports sent
+    // to followers, the report is dropped; the tablet server sends a full
+    // report once this master is leader again.
+    resp->set_leader_master(false);
+    rpc->RespondSuccess();
+    return;
+  }
+
+  Status s = server_->catalog_manager()->ProcessTabletReport(
+      ts_desc.get(), req->tablet_report(), resp->mutable_tablet_report(), rpc);
+  if (!s.ok()) {
+    rpc->RespondFailure(s.CloneAndPrepend("Failed to process tablet report"));
+    return;
+  }
+  if (req->tablet_stats_size() > 0) {
+    server_->catalog_manager()->ProcessTabletStats(ts_desc.get(), *req);
+  }
+  rpc->RespondSuccess();
+}
+
 void MasterServiceImpl::GetTabletLocations(const GetTabletLocationsRequestPB* req,
                                            GetTabletLocationsResponsePB* resp,
                                            rpc::RpcContext* rpc) {
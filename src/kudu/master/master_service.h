@@ -17,6 +17,8 @@
 #ifndef KUDU_MASTER_MASTER_SERVICE_H
 #define KUDU_MASTER_MASTER_SERVICE_H
 
+#include <memory>
+
 #include "kudu/gutil/macros.h"
 #include "kudu/master/master.service.h"
 #include "kudu/util/metrics.h"
@@ -87,6 +89,13 @@ class MasterServiceImpl : public MasterServiceIf {
   bool SupportsFeature(uint32_t feature) const override;
 
  private:
+  // Processes the tablet report of a heartbeat from 'ts_desc' and responds
+  // to it. Runs on the master's tablet report pool.
+  void ProcessTabletReport(const std::shared_ptr<TSDescriptor>& ts_desc,
+                           const TSHeartbeatRequestPB* req,
+                           TSHeartbeatResponsePB* resp,
+                           rpc::RpcContext* rpc);
+
   Master* server_;
 
   DISALLOW_COPY_AND_ASSIGN(MasterServiceImpl);
@@ -0,0 +1,149 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/master/rebalancer.h"
+#include "kudu/util/test_util.h"
+
+using std::set;
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace master {
+
+namespace {
+
+// Returns 'num_tablets' tablets of 'table_id', each with voters on 'uuids'
+// and led by the first of them.
+vector<Rebalancer::TabletReplicas> MakeTablets(const string& table_id,
+                                               int num_tablets,
+                                               const vector<string>& uuids) {
+  vector<Rebalancer::TabletReplicas> tablets;
+  for (int i = 0; i < num_tablets; i++) {
+    Rebalancer::TabletReplicas tablet;
+    tablet.tablet_id = Substitute("$0-tablet-$1", table_id, i);
+    tablet.table_id = table_id;
+    tablet.voters = uuids;
+    tablet.leader_uuid = uuids[0];
+    tablet.num_replicas = uuids.size();
+    tablets.push_back(tablet);
+  }
+  return tablets;
+}
+
+} // anonymous namespace
+
+// Test that replicas are moved to a newly added tablet server until the
+// servers are balanced.
+TEST(RebalancerTest, TestMoveReplicasToNewServer) {
+  vector<string> ts_uuids = { "a", "b", "c", "d" };
+  vector<Rebalancer::TabletReplicas> tablets = MakeTablets("t", 4, { "a", "b", "c" });
+
+  vector<Rebalancer::ReplicaMove> moves;
+  Rebalancer::PlanReplicaMoves(ts_uuids, tablets, {}, 10, &moves);
+  ASSERT_EQ(3, moves.size());
+  set<string> from_uuids;
+  set<string> tablet_ids;
+  for (const auto& move : moves) {
+    ASSERT_EQ("d", move.to_uuid);
+    from_uuids.insert(move.from_uuid);
+    tablet_ids.insert(move.tablet_id);
+  }
+  ASSERT_EQ(3, from_uuids.size());
+  ASSERT_EQ(3, tablet_ids.size());
+
+  // The limit on the number of moves is respected.
+  moves.clear();
+  Rebalancer::PlanReplicaMoves(ts_uuids, tablets, {}, 1, &moves);
+  ASSERT_EQ(1, moves.size());
+
+  // Excluded tablets and tablets which aren't fully replicated aren't moved.
+  moves.clear();
+  tablets[0].voters.pop_back();
+  Rebalancer::PlanReplicaMoves(ts_uuids, tablets, { tablets[1].tablet_id }, 10, &moves);
+  ASSERT_EQ(2, moves.size());
+  for (const auto& move : moves) {
+    ASSERT_NE(tablets[0].tablet_id, move.tablet_id);
+    ASSERT_NE(tablets[1].tablet_id, move.tablet_id);
+  }
+}
+
+// Test that the replicas of each table are evened out even when the
+// servers are balanced overall.
+TEST(RebalancerTest, TestBalanceTables) {
+  vector<string> ts_uuids = { "a", "b", "c", "d" };
+  // Overall, 'a' and 'b' have 4 replicas while 'c' and 'd' have 2, but 't1'
+  // is only on 'a' and 'b'.
+  vector<Rebalancer::TabletReplicas> tablets = MakeTablets("t1", 2, { "a", "b" });
+  for (const auto& tablet : MakeTablets("t2", 2, { "a", "b", "c", "d" })) {
+    tablets.push_back(tablet);
+  }
+  for (auto& tablet : tablets) {
+    tablet.num_replicas = tablet.voters.size();
+  }
+
+  vector<Rebalancer::ReplicaMove> moves;
+  Rebalancer::PlanReplicaMoves(ts_uuids, tablets, {}, 10, &moves);
+  ASSERT_EQ(2, moves.size());
+  for (const auto& move : moves) {
+    ASSERT_EQ(0, move.tablet_id.find("t1"));
+    ASSERT_TRUE(move.to_uuid == "c" || move.to_uuid == "d");
+  }
+
+  // A balanced cluster needs no moves.
+  vector<Rebalancer::TabletReplicas> balanced = MakeTablets("t", 3, { "a", "b", "c" });
+  moves.clear();
+  Rebalancer::PlanReplicaMoves({ "a", "b", "c" }, balanced, {}, 10, &moves);
+  ASSERT_TRUE(moves.empty());
+}
+
+// Test that leaders are asked to step down when they bunch up on a server.
+TEST(RebalancerTest, TestLeaderStepDowns) {
+  vector<string> ts_uuids = { "a", "b", "c" };
+  vector<Rebalancer::TabletReplicas> tablets = MakeTablets("t", 4, { "a", "b", "c" });
+
+  // 'a' leads all 4 tablets; moving 2 of them leaves 2, 1 and 1.
+  vector<int> step_downs;
+  Rebalancer::PlanLeaderStepDowns(ts_uuids, tablets, {}, 10, &step_downs);
+  ASSERT_EQ(2, step_downs.size());
+  ASSERT_NE(step_downs[0], step_downs[1]);
+
+  // Excluded tablets are left alone.
+  step_downs.clear();
+  vector<string> excluded = { tablets[0].tablet_id, tablets[1].tablet_id, tablets[2].tablet_id };
+  Rebalancer::PlanLeaderStepDowns(ts_uuids, tablets, excluded, 10, &step_downs);
+  ASSERT_EQ(1, step_downs.size());
+  ASSERT_EQ(3, step_downs[0]);
+
+  // The busiest leaders step down first.
+  step_downs.clear();
+  tablets[2].load = 100;
+  Rebalancer::PlanLeaderStepDowns(ts_uuids, tablets, {}, 1, &step_downs);
+  ASSERT_EQ(1, step_downs.size());
+  ASSERT_EQ(2, step_downs[0]);
+}
+
+} // namespace master
+} // namespace kudu
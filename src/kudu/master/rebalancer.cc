@@ -0,0 +1,348 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/master/rebalancer.h"
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
+#include <set>
+#include <unordered_set>
+
+#include "kudu/gutil/map-util.h"
+#include "kudu/util/metrics.h"
+
+METRIC_DEFINE_counter(server, rebalancer_replica_moves_started,
+                      "Rebalancer Replica Moves Started",
+                      kudu::MetricUnit::kOperations,
+                      "Number of tablet replica moves started by the rebalancer");
+METRIC_DEFINE_counter(server, rebalancer_replica_moves_completed,
+                      "Rebalancer Replica Moves Completed",
+                      kudu::MetricUnit::kOperations,
+                      "Number of tablet replica moves completed by the rebalancer");
+METRIC_DEFINE_counter(server, rebalancer_replica_moves_abandoned,
+                      "Rebalancer Replica Moves Abandoned",
+                      kudu::MetricUnit::kOperations,
+                      "Number of tablet replica moves abandoned by the rebalancer, "
+                      "because they timed out or the tablet's config changed otherwise");
+METRIC_DEFINE_counter(server, rebalancer_leader_step_downs,
+                      "Rebalancer Leader Step Downs",
+                      kudu::MetricUnit::kOperations,
+                      "Number of tablet leaders asked to step down by the rebalancer");
+
+using std::map;
+using std::set;
+using std::string;
+using std::unordered_set;
+using std::vector;
+
+namespace kudu {
+namespace master {
+
+namespace {
+
+typedef map<string, int> CountMap;
+
+bool ContainsUuid(const vector<string>& uuids, const string& uuid) {
+  return std::find(uuids.begin(), uuids.end(), uuid) != uuids.end();
+}
+
+// Sets 'max_uuid' and 'min_uuid' to the keys of 'counts' with the largest
+// and smallest counts. 'counts' must not be empty.
+void MinMax(const CountMap& counts, string* max_uuid, string* min_uuid) {
+  DCHECK(!counts.empty());
+  auto it = counts.begin();
+  *max_uuid = it->first;
+  *min_uuid = it->first;
+  int max_count = it->second;
+  int min_count = it->second;
+  for (++it; it != counts.end(); ++it) {
+    if (it->second > max_count) {
+      *max_uuid = it->first;
+      max_count = it->second;
+    }
+    if (it->second < min_count) {
+      *min_uuid = it->first;
+      min_count = it->second;
+    }
+  }
+}
+
+} // anonymous namespace
+
+Rebalancer::Rebalancer(const scoped_refptr<MetricEntity>& metric_entity)
+    : moves_started_(METRIC_rebalancer_replica_moves_started.Instantiate(metric_entity)),
+      moves_completed_(METRIC_rebalancer_replica_moves_completed.Instantiate(metric_entity)),
+      moves_abandoned_(METRIC_rebalancer_replica_moves_abandoned.Instantiate(metric_entity)),
+      leader_step_downs_(METRIC_rebalancer_leader_step_downs.Instantiate(metric_entity)) {
+}
+
+void Rebalancer::PlanReplicaMoves(const vector<string>& ts_uuids,
+                                  const vector<TabletReplicas>& tablets,
+                                  const vector<string>& excluded_tablets,
+                                  int max_moves,
+                                  vector<ReplicaMove>* moves) {
+  if (ts_uuids.size() < 2) {
+    return;
+  }
+  const unordered_set<string> live(ts_uuids.begin(), ts_uuids.end());
+  const unordered_set<string> excluded(excluded_tablets.begin(), excluded_tablets.end());
+
+  CountMap total;
+  for (const string& uuid : ts_uuids) {
+    total[uuid] = 0;
+  }
+  map<string, CountMap> per_table;
+  map<string, vector<const TabletReplicas*>> candidates_by_table;
+  for (const TabletReplicas& tablet : tablets) {
+    CountMap* table_counts = &per_table[tablet.table_id];
+    if (table_counts->empty()) {
+      *table_counts = total;
+      for (auto& e : *table_counts) {
+        e.second = 0;
+      }
+    }
+    bool all_live = true;
+    for (const string& uuid : tablet.voters) {
+      if (ContainsKey(live, uuid)) {
+        total[uuid]++;
+        (*table_counts)[uuid]++;
+      } else {
+        all_live = false;
+      }
+    }
+    if (all_live && static_cast<int>(tablet.voters.size()) == tablet.num_replicas &&
+        !ContainsKey(excluded, tablet.tablet_id)) {
+      candidates_by_table[tablet.table_id].push_back(&tablet);
+    }
+  }
+
+  set<string> moved;
+  // Returns the tablet with a replica on 'from' and none on 'to' whose
+  // table is the most skewed between the two, or nullptr.
+  auto find_candidate = [&](const string& from, const string& to,
+                            const string* table_id) -> const TabletReplicas* {
+    const TabletReplicas* best = nullptr;
+    int best_skew = std::numeric_limits<int>::min();
+    for (const auto& e : candidates_by_table) {
+      if (table_id && e.first != *table_id) {
+        continue;
+      }
+      const CountMap& table_counts = per_table[e.first];
+      int skew = FindOrDie(table_counts, from) - FindOrDie(table_counts, to);
+      if (skew <= best_skew) {
+        continue;
+      }
+      for (const TabletReplicas* tablet : e.second) {
+        if (!ContainsKey(moved, tablet->tablet_id) &&
+            ContainsUuid(tablet->voters, from) &&
+            !ContainsUuid(tablet->voters, to)) {
+          best = tablet;
+          best_skew = skew;
+          break;
+        }
+      }
+    }
+    return best;
+  };
+  auto add_move = [&](const TabletReplicas* tablet, const string& from, const string& to) {
+    moves->push_back({ tablet->tablet_id, from, to });
+    moved.insert(tablet->tablet_id);
+    total[from]--;
+    total[to]++;
+    per_table[tablet->table_id][from]--;
+    per_table[tablet->table_id][to]++;
+  };
+
+  while (static_cast<int>(moves->size()) < max_moves) {
+    // First even out the replicas over all tables.
+    string from;
+    string to;
+    MinMax(total, &from, &to);
+    if (total[from] - total[to] > 1) {
+      const TabletReplicas* tablet = find_candidate(from, to, nullptr);
+      if (tablet) {
+        add_move(tablet, from, to);
+        continue;
+      }
+    }
+
+    // Then even out each table, moving only to servers with fewer replicas
+    // overall so that the overall difference doesn't grow.
+    const TabletReplicas* best = nullptr;
+    int best_skew = 1;
+    for (const auto& e : per_table) {
+      const CountMap& table_counts = e.second;
+      string table_from;
+      int max_count = std::numeric_limits<int>::min();
+      for (const auto& c : table_counts) {
+        if (c.second > max_count) {
+          table_from = c.first;
+          max_count = c.second;
+        }
+      }
+      string table_to;
+      int min_count = std::numeric_limits<int>::max();
+      for (const auto& c : table_counts) {
+        if (c.second < min_count && total[c.first] < total[table_from]) {
+          table_to = c.first;
+          min_count = c.second;
+        }
+      }
+      if (table_to.empty() || max_count - min_count <= best_skew) {
+        continue;
+      }
+      const TabletReplicas* tablet = find_candidate(table_from, table_to, &e.first);
+      if (tablet) {
+        best = tablet;
+        best_skew = max_count - min_count;
+        from = table_from;
+        to = table_to;
+      }
+    }
+    if (!best) {
+      break;
+    }
+    add_move(best, from, to);
+  }
+}
+
+void Rebalancer::PlanLeaderStepDowns(const vector<string>& ts_uuids,
+                                     const vector<TabletReplicas>& tablets,
+                                     const vector<string>& excluded_tablets,
+                                     int max_step_downs,
+                                     vector<int>* step_downs) {
+  if (ts_uuids.size() < 2) {
+    return;
+  }
+  const unordered_set<string> excluded(excluded_tablets.begin(), excluded_tablets.end());
+  CountMap leaders;
+  for (const string& uuid : ts_uuids) {
+    leaders[uuid] = 0;
+  }
+  for (const TabletReplicas& tablet : tablets) {
+    int* count = FindOrNull(leaders, tablet.leader_uuid);
+    if (count) {
+      (*count)++;
+    }
+  }
+
+  set<int> picked;
+  while (static_cast<int>(step_downs->size()) < max_step_downs) {
+    string from;
+    string to;
+    MinMax(leaders, &from, &to);
+    int from_count = leaders[from];
+    if (from_count - leaders[to] <= 1) {
+      break;
+    }
+    // Pick the busiest tablet led by 'from' with a follower on a server with
+    // fewer leaders, preferring the followers on the servers with the fewest
+    // leaders. The follower is only a guess of the next leader.
+    int best = -1;
+    string best_follower;
+    int best_follower_count = std::numeric_limits<int>::max();
+    for (int i = 0; i < tablets.size(); i++) {
+      const TabletReplicas& tablet = tablets[i];
+      if (tablet.leader_uuid != from ||
+          ContainsKey(picked, i) ||
+          ContainsKey(excluded, tablet.tablet_id)) {
+        continue;
+      }
+      string follower;
+      int follower_count = std::numeric_limits<int>::max();
+      for (const string& uuid : tablet.voters) {
+        const int* count = FindOrNull(leaders, uuid);
+        if (uuid != from && count && *count < follower_count) {
+          follower = uuid;
+          follower_count = *count;
+        }
+      }
+      if (from_count - follower_count <= 1) {
+        continue;
+      }
+      if (best == -1 || tablet.load > tablets[best].load ||
+          (tablet.load == tablets[best].load && follower_count < best_follower_count)) {
+        best = i;
+        best_follower = follower;
+        best_follower_count = follower_count;
+      }
+    }
+    if (best == -1) {
+      break;
+    }
+    step_downs->push_back(best);
+    picked.insert(best);
+    leaders[from]--;
+    leaders[best_follower]++;
+  }
+}
+
+void Rebalancer::AddPendingMove(const ReplicaMove& move, int64_t config_opid_index) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  InsertOrDie(&pending_moves_, move.tablet_id,
+              { move, MonoTime::Now(), config_opid_index, false });
+  moves_started_->Increment();
+}
+
+void Rebalancer::MarkReplicaRunning(const string& tablet_id, const string& ts_uuid) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  PendingMove* pending = FindOrNull(pending_moves_, tablet_id);
+  if (pending && pending->move.to_uuid == ts_uuid) {
+    pending->target_running = true;
+  }
+}
+
+void Rebalancer::RemovePendingMove(const string& tablet_id, bool completed) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (pending_moves_.erase(tablet_id) == 0) {
+    return;
+  }
+  if (completed) {
+    moves_completed_->Increment();
+  } else {
+    moves_abandoned_->Increment();
+  }
+}
+
+void Rebalancer::GetPendingMoves(vector<PendingMove>* moves) const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  AppendValuesFromMap(pending_moves_, moves);
+}
+
+void Rebalancer::RecordLeaderStepDown() {
+  leader_step_downs_->Increment();
+}
+
+int64_t Rebalancer::num_moves_started() const {
+  return moves_started_->value();
+}
+
+int64_t Rebalancer::num_moves_completed() const {
+  return moves_completed_->value();
+}
+
+int64_t Rebalancer::num_moves_abandoned() const {
+  return moves_abandoned_->value();
+}
+
+int64_t Rebalancer::num_leader_step_downs() const {
+  return leader_step_downs_->value();
+}
+
+} // namespace master
+} // namespace kudu
@@ -0,0 +1,150 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_MASTER_REBALANCER_H
+#define KUDU_MASTER_REBALANCER_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+
+namespace kudu {
+
+class Counter;
+class MetricEntity;
+
+namespace master {
+
+// Plans and tracks moves of tablet replicas and leaders between tablet
+// servers, to even out the number of replicas and of leaders per server,
+// both overall and for each table.
+//
+// A replica is moved by adding a replica on the destination server and,
+// once it is running, removing the replica on the source server. Leaders are
+// moved by asking them to step down. The CatalogManager sends the requests;
+// this class decides what to move and keeps track of the moves in progress.
+//
+// Thread-safe.
+class Rebalancer {
+ public:
+  // The replicas of a tablet, as of its committed Raft config.
+  struct TabletReplicas {
+    std::string tablet_id;
+    std::string table_id;
+
+    // The permanent UUIDs of the voters.
+    std::vector<std::string> voters;
+
+    // The UUID of the leader, or empty if there's none.
+    std::string leader_uuid;
+
+    // The replication factor of the table.
+    int num_replicas;
+
+    // The rate of rows written to and scanned from the tablet, as reported
+    // by its leader.
+    double load = 0;
+  };
+
+  struct ReplicaMove {
+    std::string tablet_id;
+    std::string from_uuid;
+    std::string to_uuid;
+  };
+
+  // A replica move which was started and not yet completed or abandoned.
+  struct PendingMove {
+    ReplicaMove move;
+    MonoTime start_time;
+
+    // The opid_index of the config the destination replica was added to.
+    int64_t config_opid_index;
+
+    // Whether the replica on the destination server was reported running.
+    bool target_running;
+  };
+
+  explicit Rebalancer(const scoped_refptr<MetricEntity>& metric_entity);
+
+  // Plans up to 'max_moves' replica moves which reduce the difference in the
+  // number of replicas between the tablet servers in 'ts_uuids'. The
+  // difference over all tables is reduced first, then that of each table
+  // while keeping the overall difference.
+  //
+  // Tablets which aren't fully replicated on 'ts_uuids', and tablets whose
+  // IDs are in 'excluded_tablets', are not moved.
+  static void PlanReplicaMoves(const std::vector<std::string>& ts_uuids,
+                               const std::vector<TabletReplicas>& tablets,
+                               const std::vector<std::string>& excluded_tablets,
+                               int max_moves,
+                               std::vector<ReplicaMove>* moves);
+
+  // Plans up to 'max_step_downs' leaders to step down, to reduce the
+  // difference in the number of leaders between the servers in 'ts_uuids'.
+  // Since the next leader is elected among the followers, only leaders with
+  // a follower on a server with fewer leaders are picked, the busiest first
+  // so that the load moves along with the leaders. Appends the indexes of
+  // the tablets in 'tablets' to 'step_downs'.
+  static void PlanLeaderStepDowns(const std::vector<std::string>& ts_uuids,
+                                  const std::vector<TabletReplicas>& tablets,
+                                  const std::vector<std::string>& excluded_tablets,
+                                  int max_step_downs,
+                                  std::vector<int>* step_downs);
+
+  // Records that 'move' was started, by adding a replica to the tablet's
+  // config with the given opid_index.
+  void AddPendingMove(const ReplicaMove& move, int64_t config_opid_index);
+
+  // Marks the pending move of 'tablet_id', if any, as ready to remove its
+  // source replica if its destination is 'ts_uuid'.
+  void MarkReplicaRunning(const std::string& tablet_id, const std::string& ts_uuid);
+
+  // Forgets the pending move of 'tablet_id', which either completed or was
+  // abandoned.
+  void RemovePendingMove(const std::string& tablet_id, bool completed);
+
+  void GetPendingMoves(std::vector<PendingMove>* moves) const;
+
+  // Records that the leader of a tablet was asked to step down.
+  void RecordLeaderStepDown();
+
+  int64_t num_moves_started() const;
+  int64_t num_moves_completed() const;
+  int64_t num_moves_abandoned() const;
+  int64_t num_leader_step_downs() const;
+
+ private:
+  mutable simple_spinlock lock_;
+
+  // Keyed by tablet ID.
+  std::map<std::string, PendingMove> pending_moves_;
+
+  scoped_refptr<Counter> moves_started_;
+  scoped_refptr<Counter> moves_completed_;
+  scoped_refptr<Counter> moves_abandoned_;
+  scoped_refptr<Counter> leader_step_downs_;
+
+  DISALLOW_COPY_AND_ASSIGN(Rebalancer);
+};
+
+} // namespace master
+} // namespace kudu
+#endif /* KUDU_MASTER_REBALANCER_H */
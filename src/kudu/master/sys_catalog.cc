@@ -44,6 +44,7 @@
 #include "kudu/rpc/rpc_context.h"
 #include "kudu/tablet/tablet.h"
 #include "kudu/tablet/tablet_bootstrap.h"
+#include "kudu/tablet/tablet_metrics.h"
 #include "kudu/tablet/transactions/write_transaction.h"
 #include "kudu/tserver/tserver.pb.h"
 #include "kudu/util/debug/trace_event.h"
@@ -66,6 +67,7 @@ using kudu::log::Log;
 using kudu::log::LogAnchorRegistry;
 using kudu::tablet::LatchTransactionCompletionCallback;
 using kudu::tablet::Tablet;
+using kudu::tablet::TabletMetrics;
 using kudu::tablet::TabletPeer;
 using kudu::tablet::TabletStatusListener;
 using kudu::tserver::WriteRequestPB;
@@ -91,6 +93,7 @@ SysCatalogTable::SysCatalogTable(Master* master, MetricRegistry* metrics,
     : metric_registry_(metrics),
       master_(master),
       leader_cb_(std::move(leader_cb)) {
+  CHECK_OK(ThreadPoolBuilder("prepare").Build(&prepare_pool_));
   CHECK_OK(ThreadPoolBuilder("apply").Build(&apply_pool_));
 }
 
@@ -101,6 +104,7 @@ void SysCatalogTable::Shutdown() {
   if (tablet_peer_) {
     tablet_peer_->Shutdown();
   }
+  prepare_pool_->Shutdown();
   apply_pool_->Shutdown();
 }
 
@@ -174,6 +178,7 @@ Status SysCatalogTable::CreateNew(FsManager *fs_manager) {
                                                   table_id(),
                                                   schema, partition_schema,
                                                   partitions[0],
+                                                  CompactionPolicyPB(),
                                                   tablet::TABLET_DATA_READY,
                                                   &metadata));
 
@@ -280,6 +285,7 @@ Status SysCatalogTable::SetupTablet(const scoped_refptr<tablet::TabletMetadata>&
   tablet_peer_.reset(new TabletPeer(
       metadata,
       local_peer_pb_,
+      prepare_pool_.get(),
       apply_pool_.get(),
       Bind(&SysCatalogTable::SysCatalogStateChanged, Unretained(this), metadata->tablet_id())));
 
@@ -627,6 +633,17 @@ Status SysCatalogTable::VisitTablets(TabletVisitor* visitor) {
   return Status::OK();
 }
 
+int64_t SysCatalogTable::NumRowsWritten() const {
+  const TabletMetrics* metrics = tablet_peer_->tablet()->metrics();
+  if (!metrics) {
+    return -1;
+  }
+  return metrics->rows_inserted->value() +
+      metrics->rows_upserted->value() +
+      metrics->rows_updated->value() +
+      metrics->rows_deleted->value();
+}
+
 void SysCatalogTable::InitLocalRaftPeerPB() {
   local_peer_pb_.set_permanent_uuid(master_->fs_manager()->uuid());
   Sockaddr addr = master_->first_rpc_address();
@@ -115,6 +115,13 @@ class SysCatalogTable {
   // Scan of the tablet-related entries.
   Status VisitTablets(TabletVisitor* visitor);
 
+  // Returns the number of rows inserted, updated or deleted in the sys
+  // catalog since it was loaded, or -1 if it isn't tracked. The count is
+  // updated once a write is visible to scans, so a scan started after reading
+  // the count sees at least the writes it includes; if the count hasn't
+  // changed since, neither has the catalog.
+  int64_t NumRowsWritten() const;
+
  private:
   FRIEND_TEST(MasterTest, TestMasterMetadataConsistentDespiteFailures);
   DISALLOW_COPY_AND_ASSIGN(SysCatalogTable);
@@ -197,6 +204,7 @@ class SysCatalogTable {
 
   MetricRegistry* metric_registry_;
 
+  gscoped_ptr<ThreadPool> prepare_pool_;
   gscoped_ptr<ThreadPool> apply_pool_;
 
   scoped_refptr<tablet::TabletPeer> tablet_peer_;
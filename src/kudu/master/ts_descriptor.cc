@@ -187,6 +187,20 @@ void TSDescriptor::GetRegistration(ServerRegistrationPB* reg) const {
   CHECK_NOTNULL(reg)->CopyFrom(*registration_);
 }
 
+void TSDescriptor::UpdateLoad(const TServerLoadPB& load) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  load_.reset(new TServerLoadPB(load));
+}
+
+void TSDescriptor::GetLoad(TServerLoadPB* load) const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (load_) {
+    load->CopyFrom(*load_);
+  } else {
+    load->Clear();
+  }
+}
+
 void TSDescriptor::GetNodeInstancePB(NodeInstancePB* instance_pb) const {
   std::lock_guard<simple_spinlock> l(lock_);
   instance_pb->set_permanent_uuid(permanent_uuid_);
@@ -47,6 +47,8 @@ class TabletServerAdminServiceProxy;
 
 namespace master {
 
+class TServerLoadPB;
+
 // Master-side view of a single tablet server.
 //
 // Tracks the last heartbeat, status, instance identifier, etc.
@@ -114,6 +116,13 @@ class TSDescriptor {
     return num_live_replicas_;
   }
 
+  // Set the load statistics from the last heartbeat.
+  void UpdateLoad(const TServerLoadPB& load);
+
+  // Copy the load statistics from the last heartbeat into 'load'. Clears
+  // 'load' if the server hasn't reported any.
+  void GetLoad(TServerLoadPB* load) const;
+
   // Return a string form of this TS, suitable for printing.
   // Includes the UUID as well as last known host/port.
   std::string ToString() const;
@@ -146,6 +155,9 @@ class TSDescriptor {
 
   gscoped_ptr<ServerRegistrationPB> registration_;
 
+  // The load statistics from the last heartbeat, if any.
+  gscoped_ptr<TServerLoadPB> load_;
+
   std::shared_ptr<tserver::TabletServerAdminServiceProxy> ts_admin_proxy_;
   std::shared_ptr<consensus::ConsensusServiceProxy> consensus_proxy_;
 
@@ -39,6 +39,7 @@
 
 using google::protobuf::Message;
 using std::string;
+using std::unique_ptr;
 
 METRIC_DEFINE_counter(server, rpc_connections_accepted,
                       "RPC Connections Accepted",
@@ -54,29 +55,56 @@ DEFINE_int32(rpc_acceptor_listen_backlog, 128,
              "new inbound connection requests.");
 TAG_FLAG(rpc_acceptor_listen_backlog, advanced);
 
+DEFINE_bool(rpc_acceptor_reuseport, false,
+            "Whether to listen for RPC connections on one SO_REUSEPORT socket per "
+            "reactor, each with its own accept thread handing connections to its "
+            "reactor. This spreads the work of accepting the reconnecting clients "
+            "after a restart. Requires a kernel supporting SO_REUSEPORT.");
+TAG_FLAG(rpc_acceptor_reuseport, experimental);
+
 namespace kudu {
 namespace rpc {
 
 AcceptorPool::AcceptorPool(Messenger* messenger, Socket* socket,
                            Sockaddr bind_address)
     : messenger_(messenger),
-      socket_(socket->Release()),
       bind_address_(std::move(bind_address)),
       rpc_connections_accepted_(METRIC_rpc_connections_accepted.Instantiate(
           messenger->metric_entity())),
-      closing_(false) {}
+      closing_(false) {
+  sockets_.emplace_back(new Socket(socket->Release()));
+}
 
 AcceptorPool::~AcceptorPool() {
   Shutdown();
 }
 
 Status AcceptorPool::Start(int num_threads) {
-  RETURN_NOT_OK(socket_.Listen(FLAGS_rpc_acceptor_listen_backlog));
+  if (FLAGS_rpc_acceptor_reuseport) {
+    // The other sockets must bind to the port actually bound by the first.
+    Sockaddr addr;
+    RETURN_NOT_OK(sockets_[0]->GetSocketAddress(&addr));
+    for (int i = 1; i < messenger_->num_reactors(); i++) {
+      unique_ptr<Socket> sock(new Socket());
+      RETURN_NOT_OK(sock->Init(0));
+      RETURN_NOT_OK(sock->SetReuseAddr(true));
+      RETURN_NOT_OK(sock->SetReusePort(true));
+      RETURN_NOT_OK_PREPEND(sock->Bind(addr),
+                            "Unable to bind an additional SO_REUSEPORT socket");
+      sockets_.emplace_back(std::move(sock));
+    }
+  }
+  for (const auto& sock : sockets_) {
+    RETURN_NOT_OK(sock->Listen(FLAGS_rpc_acceptor_listen_backlog));
+  }
 
-  for (int i = 0; i < num_threads; i++) {
+  int n_threads = FLAGS_rpc_acceptor_reuseport ? sockets_.size() : num_threads;
+  for (int i = 0; i < n_threads; i++) {
     scoped_refptr<kudu::Thread> new_thread;
+    int socket_idx = FLAGS_rpc_acceptor_reuseport ? i : 0;
+    int reactor_idx = FLAGS_rpc_acceptor_reuseport ? i : -1;
     Status s = kudu::Thread::Create("acceptor pool", "acceptor",
-        &AcceptorPool::RunThread, this, &new_thread);
+        &AcceptorPool::RunThread, this, socket_idx, reactor_idx, &new_thread);
     if (!s.ok()) {
       Shutdown();
       return s;
@@ -94,11 +122,13 @@ void AcceptorPool::Shutdown() {
   }
 
 #if defined(__linux__)
-  // Closing the socket will break us out of accept() if we're in it, and
+  // Closing the sockets will break us out of accept() if we're in it, and
   // prevent future accepts.
-  WARN_NOT_OK(socket_.Shutdown(true, true),
-              strings::Substitute("Could not shut down acceptor socket on $0",
-                                  bind_address_.ToString()));
+  for (const auto& sock : sockets_) {
+    WARN_NOT_OK(sock->Shutdown(true, true),
+                strings::Substitute("Could not shut down acceptor socket on $0",
+                                    bind_address_.ToString()));
+  }
 #else
   // Calling shutdown on an accepting (non-connected) socket is illegal on most
   // platforms (but not Linux). Instead, the accepting threads are interrupted
@@ -119,16 +149,17 @@ Sockaddr AcceptorPool::bind_address() const {
 }
 
 Status AcceptorPool::GetBoundAddress(Sockaddr* addr) const {
-  return socket_.GetSocketAddress(addr);
+  return sockets_[0]->GetSocketAddress(addr);
 }
 
-void AcceptorPool::RunThread() {
+void AcceptorPool::RunThread(int socket_idx, int reactor_idx) {
+  Socket* socket = sockets_[socket_idx].get();
   while (true) {
     Socket new_sock;
     Sockaddr remote;
-    VLOG(2) << "calling accept() on socket " << socket_.GetFd()
+    VLOG(2) << "calling accept() on socket " << socket->GetFd()
             << " listening on " << bind_address_.ToString();
-    Status s = socket_.Accept(&new_sock, &remote, Socket::FLAG_NONBLOCKING);
+    Status s = socket->Accept(&new_sock, &remote, Socket::FLAG_NONBLOCKING);
     if (!s.ok()) {
       if (Release_Load(&closing_)) {
         break;
@@ -145,7 +176,11 @@ void AcceptorPool::RunThread() {
       continue;
     }
     rpc_connections_accepted_->Increment();
-    messenger_->RegisterInboundSocket(&new_sock, remote);
+    if (reactor_idx >= 0) {
+      messenger_->RegisterInboundSocket(&new_sock, remote, reactor_idx);
+    } else {
+      messenger_->RegisterInboundSocket(&new_sock, remote);
+    }
   }
   VLOG(1) << "AcceptorPool shutting down.";
 }
@@ -18,6 +18,7 @@
 #ifndef KUDU_RPC_ACCEPTOR_POOL_H
 #define KUDU_RPC_ACCEPTOR_POOL_H
 
+#include <memory>
 #include <vector>
 
 #include "kudu/gutil/atomicops.h"
@@ -38,6 +39,11 @@ class Messenger;
 // A pool of threads calling accept() to create new connections.
 // Acceptor pool threads terminate when they notice that the messenger has been
 // shut down, if Shutdown() is called, or if the pool object is destructed.
+//
+// If --rpc_acceptor_reuseport is set, the pool instead listens on one
+// SO_REUSEPORT socket per reactor of the messenger, so that the kernel
+// spreads new connections among them. Each socket has its own accept thread,
+// which hands the connections directly to its reactor.
 class AcceptorPool {
  public:
   // Create a new acceptor pool.  Calls socket::Release to take ownership of the
@@ -46,7 +52,8 @@ class AcceptorPool {
   AcceptorPool(Messenger *messenger, Socket *socket, Sockaddr bind_address);
   ~AcceptorPool();
 
-  // Start listening and accepting connections.
+  // Start listening and accepting connections. 'num_threads' is ignored when the
+  // pool listens on one socket per reactor.
   Status Start(int num_threads);
   void Shutdown();
 
@@ -60,10 +67,15 @@ class AcceptorPool {
   Status GetBoundAddress(Sockaddr* addr) const;
 
  private:
-  void RunThread();
+  // Accept connections on the socket with index 'socket_idx'. If
+  // 'reactor_idx' is non-negative, the connections are handed to that reactor.
+  void RunThread(int socket_idx, int reactor_idx);
 
   Messenger *messenger_;
-  Socket socket_;
+
+  // The listening sockets. The first is the one given to the constructor;
+  // the others are only opened with SO_REUSEPORT.
+  std::vector<std::unique_ptr<Socket>> sockets_;
   Sockaddr bind_address_;
   std::vector<scoped_refptr<kudu::Thread> > threads_;
 
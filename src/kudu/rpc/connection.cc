@@ -19,12 +19,14 @@
 
 #include <algorithm>
 #include <boost/intrusive/list.hpp>
+#include <climits>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <iostream>
 #include <set>
 #include <stdint.h>
 #include <string>
+#include <sys/uio.h>
 #include <vector>
 
 #include "kudu/gutil/map-util.h"
@@ -41,6 +43,7 @@
 #include "kudu/rpc/sasl_server.h"
 #include "kudu/rpc/transfer.h"
 #include "kudu/util/debug-util.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/status.h"
 #include "kudu/util/trace.h"
@@ -52,6 +55,24 @@ using std::shared_ptr;
 using std::vector;
 using strings::Substitute;
 
+DEFINE_int32(rpc_max_write_iovecs, 64,
+             "Maximum number of buffers written to a connection by a single writev(). "
+             "The pending transfers of a connection, such as many small responses, "
+             "are written together up to this many buffers.");
+TAG_FLAG(rpc_max_write_iovecs, advanced);
+
+static bool ValidateMaxWriteIovecs(const char* flagname, int32_t value) {
+  if (value < 1 || value > IOV_MAX) {
+    LOG(ERROR) << "Invalid value for " << flagname << ": " << value
+               << ", must be between 1 and " << IOV_MAX;
+    return false;
+  }
+  return true;
+}
+static bool dummy[] = {
+  google::RegisterFlagValidator(&FLAGS_rpc_max_write_iovecs, &ValidateMaxWriteIovecs)
+};
+
 namespace kudu {
 namespace rpc {
 
@@ -63,13 +84,17 @@ Connection::Connection(ReactorThread *reactor_thread, Sockaddr remote,
     : reactor_thread_(reactor_thread),
       socket_(socket),
       remote_(std::move(remote)),
+      outbound_idx_(0),
       direction_(direction),
       last_activity_time_(MonoTime::Now()),
       is_epoll_registered_(false),
       next_call_id_(1),
+      is_shutdown_(false),
       sasl_client_(kSaslAppName, socket),
       sasl_server_(kSaslAppName, socket),
-      negotiation_complete_(false) {}
+      negotiation_complete_(false),
+      uncompressed_payload_bytes_(0),
+      compressed_payload_bytes_(0) {}
 
 Status Connection::SetNonBlocking(bool enabled) {
   return socket_.SetNonBlocking(enabled);
@@ -133,6 +158,7 @@ bool Connection::Idle() const {
 void Connection::Shutdown(const Status &status) {
   DCHECK(reactor_thread_->IsCurrentThread());
   shutdown_status_ = status.CloneAndPrepend("RPC connection failed");
+  is_shutdown_.Store(true);
 
   if (inbound_ && inbound_->TransferStarted()) {
     double secs_since_active =
@@ -282,13 +308,19 @@ void Connection::QueueOutboundCall(const shared_ptr<OutboundCall> &call) {
   int32_t call_id = GetNextCallId();
   call->set_call_id(call_id);
 
-  // Serialize the actual bytes to be put on the wire.
+  // Serialize the actual bytes to be put on the wire. Calls queued before
+  // negotiation completes are sent uncompressed, since we don't know yet
+  // whether the server could decompress them.
   slices_tmp_.clear();
-  Status s = call->SerializeTo(&slices_tmp_);
+  serialization::CompressionStats stats;
+  Status s = call->SerializeTo(&slices_tmp_, RemoteSupportsFeature(LZ4_COMPRESSION), &stats);
   if (PREDICT_FALSE(!s.ok())) {
     call->SetFailed(s);
     return;
   }
+  if (stats.uncompressed_bytes > 0) {
+    RecordCompressedPayload(stats);
+  }
 
   call->SetQueued();
 
@@ -512,7 +544,11 @@ void Connection::HandleIncomingCall(gscoped_ptr<InboundTransfer> transfer) {
 void Connection::HandleCallResponse(gscoped_ptr<InboundTransfer> transfer) {
   DCHECK(reactor_thread_->IsCurrentThread());
   gscoped_ptr<CallResponse> resp(new CallResponse);
-  CHECK_OK(resp->ParseFrom(std::move(transfer)));
+  serialization::CompressionStats stats;
+  CHECK_OK(resp->ParseFrom(std::move(transfer), &stats));
+  if (stats.uncompressed_bytes > 0) {
+    RecordCompressedPayload(stats);
+  }
 
   CallAwaitingResponse *car_ptr =
     EraseKeyReturnValuePtr(&awaiting_response_, resp->call_id());
@@ -534,6 +570,35 @@ void Connection::HandleCallResponse(gscoped_ptr<InboundTransfer> transfer) {
   car->call->SetResponse(std::move(resp));
 }
 
+bool Connection::PrepareToSend(OutboundTransfer* transfer) {
+  if (!transfer->is_for_outbound_call()) {
+    return true;
+  }
+  CallAwaitingResponse* car = FindOrDie(awaiting_response_, transfer->call_id());
+  if (!car->call) {
+    // If the call has already timed out, then the 'call' field will have been nulled.
+    // In that case, we don't need to bother sending it.
+    transfer->Abort(Status::Aborted("already timed out"));
+    return false;
+  }
+
+  // If this is the start of the transfer, then check if the server has the
+  // required RPC flags. We have to wait until just before the transfer in
+  // order to ensure that the negotiation has taken place, so that the flags
+  // are available.
+  const set<RpcFeatureFlag>& required_features = car->call->required_rpc_features();
+  const set<RpcFeatureFlag>& server_features = sasl_client_.server_features();
+  if (!includes(server_features.begin(), server_features.end(),
+                required_features.begin(), required_features.end())) {
+    Status s = Status::NotSupported("server does not support the required RPC features");
+    transfer->Abort(s);
+    car->call->SetFailed(s);
+    car->call.reset();
+    return false;
+  }
+  return true;
+}
+
 void Connection::WriteHandler(ev::io &watcher, int revents) {
   DCHECK(reactor_thread_->IsCurrentThread());
 
@@ -544,7 +609,6 @@ void Connection::WriteHandler(ev::io &watcher, int revents) {
   }
   DVLOG(3) << ToString() << ": writeHandler: revents = " << revents;
 
-  OutboundTransfer *transfer;
   if (outbound_transfers_.empty()) {
     LOG(WARNING) << ToString() << " got a ready-to-write callback, but there is "
       "nothing to write.";
@@ -552,56 +616,68 @@ void Connection::WriteHandler(ev::io &watcher, int revents) {
     return;
   }
 
+  // Gather the data of as many pending transfers as fit in the iovecs, and
+  // send them with a single writev(), until the socket is full.
+  int max_iovecs = FLAGS_rpc_max_write_iovecs;
+  iovecs_.resize(max_iovecs);
   while (!outbound_transfers_.empty()) {
-    transfer = &(outbound_transfers_.front());
-
-    if (!transfer->TransferStarted()) {
-
-      if (transfer->is_for_outbound_call()) {
-        CallAwaitingResponse* car = FindOrDie(awaiting_response_, transfer->call_id());
-        if (!car->call) {
-          // If the call has already timed out, then the 'call' field will have been nulled.
-          // In that case, we don't need to bother sending it.
-          outbound_transfers_.pop_front();
-          transfer->Abort(Status::Aborted("already timed out"));
-          delete transfer;
-          continue;
-        }
-
-        // If this is the start of the transfer, then check if the server has the
-        // required RPC flags. We have to wait until just before the transfer in
-        // order to ensure that the negotiation has taken place, so that the flags
-        // are available.
-        const set<RpcFeatureFlag>& required_features = car->call->required_rpc_features();
-        const set<RpcFeatureFlag>& server_features = sasl_client_.server_features();
-        if (!includes(server_features.begin(), server_features.end(),
-                      required_features.begin(), required_features.end())) {
-          outbound_transfers_.pop_front();
-          Status s = Status::NotSupported("server does not support the required RPC features");
-          transfer->Abort(s);
-          car->call->SetFailed(s);
-          car->call.reset();
-          delete transfer;
-          continue;
-        }
+    int n_iovecs = 0;
+    int64_t gathered_bytes = 0;
+    auto it = outbound_transfers_.begin();
+    while (it != outbound_transfers_.end() && n_iovecs < max_iovecs) {
+      OutboundTransfer* transfer = &*it;
+      if (!transfer->TransferStarted() && !PrepareToSend(transfer)) {
+        it = outbound_transfers_.erase(it);
+        delete transfer;
+        continue;
+      }
+      bool complete;
+      int n = transfer->AppendIovecs(&iovecs_[n_iovecs], max_iovecs - n_iovecs, &complete);
+      for (int i = n_iovecs; i < n_iovecs + n; i++) {
+        gathered_bytes += iovecs_[i].iov_len;
       }
+      n_iovecs += n;
+      if (!complete) {
+        break;
+      }
+      ++it;
+    }
+    if (n_iovecs == 0) {
+      // All the remaining transfers were aborted.
+      break;
     }
 
     last_activity_time_ = reactor_thread_->cur_time();
-    Status status = transfer->SendBuffer(socket_);
+    int32_t written;
+    Status status = socket_.Writev(&iovecs_[0], n_iovecs, &written);
     if (PREDICT_FALSE(!status.ok())) {
+      if (Socket::IsTemporarySocketError(status.posix_code())) {
+        return;
+      }
       LOG(WARNING) << ToString() << " send error: " << status.ToString();
       reactor_thread_->DestroyConnection(this, status);
       return;
     }
 
-    if (!transfer->TransferFinished()) {
+    // Hand the written bytes out to the transfers they came from.
+    int n_finished = 0;
+    int32_t remaining = written;
+    while (!outbound_transfers_.empty()) {
+      OutboundTransfer* transfer = &outbound_transfers_.front();
+      remaining = transfer->ConsumeSent(remaining);
+      if (!transfer->TransferFinished()) {
+        break;
+      }
+      outbound_transfers_.pop_front();
+      delete transfer;
+      n_finished++;
+    }
+    reactor_thread_->RecordWrite(n_finished);
+
+    if (written < gathered_bytes) {
       DVLOG(3) << ToString() << ": writeHandler: xfer not finished.";
       return;
     }
-
-    outbound_transfers_.pop_front();
-    delete transfer;
   }
 
   // If we were able to write all of our outbound transfers,
@@ -673,6 +749,19 @@ void Connection::MarkNegotiationComplete() {
   negotiation_complete_ = true;
 }
 
+bool Connection::RemoteSupportsFeature(RpcFeatureFlag feature) {
+  if (direction_ == CLIENT) {
+    DCHECK(reactor_thread_->IsCurrentThread());
+    return negotiation_complete_ && ContainsKey(sasl_client_.server_features(), feature);
+  }
+  return ContainsKey(sasl_server_.client_features(), feature);
+}
+
+void Connection::RecordCompressedPayload(const serialization::CompressionStats& stats) {
+  uncompressed_payload_bytes_.IncrementBy(stats.uncompressed_bytes);
+  compressed_payload_bytes_.IncrementBy(stats.compressed_bytes);
+}
+
 Status Connection::DumpPB(const DumpRunningRpcsRequestPB& req,
                           RpcConnectionPB* resp) {
   DCHECK(reactor_thread_->IsCurrentThread());
@@ -685,6 +774,8 @@ Status Connection::DumpPB(const DumpRunningRpcsRequestPB& req,
     // object is owned by the negotiation thread at that point.
     resp->set_state(RpcConnectionPB::NEGOTIATING);
   }
+  resp->set_uncompressed_payload_bytes(uncompressed_payload_bytes_.Load());
+  resp->set_compressed_payload_bytes(compressed_payload_bytes_.Load());
 
   if (direction_ == CLIENT) {
     for (const car_map_t::value_type& entry : awaiting_response_) {
@@ -22,6 +22,7 @@
 #include <ev++.h>
 #include <memory>
 #include <stdint.h>
+#include <sys/uio.h>
 #include <unordered_map>
 
 #include <limits>
@@ -33,8 +34,10 @@
 #include "kudu/rpc/outbound_call.h"
 #include "kudu/rpc/sasl_client.h"
 #include "kudu/rpc/sasl_server.h"
+#include "kudu/rpc/serialization.h"
 #include "kudu/rpc/inbound_call.h"
 #include "kudu/rpc/transfer.h"
+#include "kudu/util/atomic.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/net/socket.h"
@@ -100,6 +103,11 @@ class Connection : public RefCountedThreadSafe<Connection> {
   // message, and we have no outstanding calls.
   bool Idle() const;
 
+  // Returns true once the connection has been shut down.
+  //
+  // This may be called from any thread.
+  bool IsShutdown() const { return is_shutdown_.Load(); }
+
   // Fail any calls which are currently queued or awaiting response.
   // Prohibits any future calls (they will be failed immediately with this
   // same Status).
@@ -128,6 +136,14 @@ class Connection : public RefCountedThreadSafe<Connection> {
   // Get the user credentials which will be used to log in.
   const UserCredentials &user_credentials() const { return user_credentials_; }
 
+  // Set the index of this connection among the client connections to the
+  // same remote with the same credentials.
+  void set_outbound_idx(int idx) { outbound_idx_ = idx; }
+
+  // Get the index of this connection among the client connections to the
+  // same remote with the same credentials.
+  int outbound_idx() const { return outbound_idx_; }
+
   RpczStore* rpcz_store();
 
   // libev callback when data is available to read.
@@ -136,6 +152,10 @@ class Connection : public RefCountedThreadSafe<Connection> {
   // libev callback when we may write to the socket.
   void WriteHandler(ev::io &watcher, int revents);
 
+  // Check that the transfer of an outbound call may still be sent, just
+  // before its first bytes are written. If not, abort it and return false.
+  bool PrepareToSend(OutboundTransfer* transfer);
+
   // Safe to be called from other threads.
   std::string ToString() const;
 
@@ -149,6 +169,18 @@ class Connection : public RefCountedThreadSafe<Connection> {
   // Return SASL server instance for this connection.
   SaslServer &sasl_server() { return sasl_server_; }
 
+  // Return true if the remote end advertised 'feature' during negotiation.
+  // On the client side, returns false until negotiation is complete and must
+  // be called from the reactor thread. On the server side, calls are only
+  // received once negotiation is complete, so this may be called by the
+  // handler of any call.
+  bool RemoteSupportsFeature(RpcFeatureFlag feature);
+
+  // Accounts for payload parts of calls or responses which were compressed
+  // before being sent on this connection, or decompressed after being
+  // received on it. Safe to be called from other threads.
+  void RecordCompressedPayload(const serialization::CompressionStats& stats);
+
   // Initialize SASL client before negotiation begins.
   Status InitSaslClient();
 
@@ -234,12 +266,20 @@ class Connection : public RefCountedThreadSafe<Connection> {
   // The credentials of the user operating on this connection (if a client user).
   UserCredentials user_credentials_;
 
+  // The index of this connection among the client connections to the same
+  // remote (always 0 unless the messenger opens several).
+  int outbound_idx_;
+
   // whether we are client or server
   Direction direction_;
 
   // The last time we read or wrote from the socket.
   MonoTime last_activity_time_;
 
+  // The buffers passed to writev() by WriteHandler(), kept to avoid
+  // allocating them on every write.
+  std::vector<struct iovec> iovecs_;
+
   // the inbound transfer, if any
   gscoped_ptr<InboundTransfer> inbound_;
 
@@ -270,6 +310,9 @@ class Connection : public RefCountedThreadSafe<Connection> {
   // Starts as Status::OK, gets set to a shutdown status upon Shutdown().
   Status shutdown_status_;
 
+  // Whether Shutdown() was called. See IsShutdown().
+  AtomicBool is_shutdown_;
+
   // Temporary vector used when serializing - avoids an allocation
   // when serializing calls.
   std::vector<Slice> slices_tmp_;
@@ -287,6 +330,11 @@ class Connection : public RefCountedThreadSafe<Connection> {
 
   // Whether we completed connection negotiation.
   bool negotiation_complete_;
+
+  // Total size of the compressed payload parts sent or received on this
+  // connection, before and after compression.
+  AtomicInt<int64_t> uncompressed_payload_bytes_;
+  AtomicInt<int64_t> compressed_payload_bytes_;
 };
 
 } // namespace rpc
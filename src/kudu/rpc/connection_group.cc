@@ -0,0 +1,105 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#include "kudu/rpc/connection_group.h"
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <mutex>
+
+#include "kudu/gutil/map-util.h"
+#include "kudu/rpc/outbound_call.h"
+#include "kudu/util/flag_tags.h"
+
+DEFINE_int64(rpc_bulk_call_min_bytes, 1024 * 1024,
+             "Minimum size of the request, or of the latest response to the same "
+             "method, for an outbound call to be considered a bulk transfer. When "
+             "there are several connections per server, other calls avoid the "
+             "connections which bulk transfers are pending on.");
+TAG_FLAG(rpc_bulk_call_min_bytes, advanced);
+
+using std::string;
+
+namespace kudu {
+namespace rpc {
+
+ConnectionGroup::ConnectionGroup(int num_connections)
+    : loads_(num_connections) {
+  CHECK_GT(num_connections, 0);
+}
+
+ConnectionGroup::~ConnectionGroup() {
+}
+
+void ConnectionGroup::AssignConnection(OutboundCall* call) {
+  const RemoteMethod& remote_method = call->remote_method();
+  string method = remote_method.service_name() + "." + remote_method.method_name();
+  int64_t request_bytes = call->request_payload_size();
+
+  int idx = 0;
+  bool bulk;
+  int64_t pending_bytes;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    int64_t expected_response_bytes = FindWithDefault(response_bytes_by_method_, method, 0);
+    bulk = request_bytes >= FLAGS_rpc_bulk_call_min_bytes ||
+        expected_response_bytes >= FLAGS_rpc_bulk_call_min_bytes;
+    pending_bytes = request_bytes + expected_response_bytes;
+
+    for (int i = 1; i < num_connections(); i++) {
+      const ConnectionLoad& cur = loads_[i];
+      const ConnectionLoad& best = loads_[idx];
+      bool better = bulk ?
+          (cur.bytes < best.bytes || (cur.bytes == best.bytes && cur.calls < best.calls)) :
+          (cur.bulk_calls < best.bulk_calls ||
+           (cur.bulk_calls == best.bulk_calls && cur.calls < best.calls));
+      if (better) {
+        idx = i;
+      }
+    }
+    ConnectionLoad* load = &loads_[idx];
+    load->calls++;
+    load->bytes += pending_bytes;
+    if (bulk) {
+      load->bulk_calls++;
+    }
+  }
+  call->SetConnectionGroup(shared_from_this(), idx, bulk, pending_bytes);
+}
+
+void ConnectionGroup::CallFinished(int idx, bool bulk, int64_t pending_bytes,
+                                   const string& method, int64_t response_bytes) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  ConnectionLoad* load = &loads_[idx];
+  load->calls--;
+  load->bytes -= pending_bytes;
+  if (bulk) {
+    load->bulk_calls--;
+  }
+  DCHECK_GE(load->calls, 0);
+  DCHECK_GE(load->bulk_calls, 0);
+  if (response_bytes > 0) {
+    response_bytes_by_method_[method] = response_bytes;
+  }
+}
+
+int64_t ConnectionGroup::pending_calls(int idx) const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return loads_[idx].calls;
+}
+
+} // namespace rpc
+} // namespace kudu
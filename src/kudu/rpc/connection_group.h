@@ -0,0 +1,93 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_RPC_CONNECTION_GROUP_H
+#define KUDU_RPC_CONNECTION_GROUP_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/locks.h"
+
+namespace kudu {
+namespace rpc {
+
+class OutboundCall;
+
+// Spreads the outbound calls to one remote, made as one user, over several
+// connections (see --rpc_num_connections_per_server), so that they don't all
+// queue up behind each other on a single TCP stream and reactor thread.
+//
+// A call is considered bulk if its request, or the latest response to its
+// method, holds at least --rpc_bulk_call_min_bytes. Other calls are sent on
+// the connection with the fewest pending bulk calls, and then the fewest
+// pending calls, so that latency-sensitive calls avoid waiting behind bulk
+// transfers. Bulk calls are sent on the connection with the fewest pending
+// bytes, counting the request and expected response of each pending call.
+//
+// This class is thread-safe.
+class ConnectionGroup : public std::enable_shared_from_this<ConnectionGroup> {
+ public:
+  explicit ConnectionGroup(int num_connections);
+
+  ~ConnectionGroup();
+
+  // Picks the connection to send 'call' on, and assigns it to the call with
+  // OutboundCall::SetConnectionGroup(). The call is pending on the connection
+  // until it calls CallFinished().
+  void AssignConnection(OutboundCall* call);
+
+  // Tells the group that a call which was assigned connection 'idx' has
+  // finished, having received a response of 'response_bytes' (0 if it
+  // failed). 'bulk' and 'pending_bytes' are as passed to the call.
+  void CallFinished(int idx, bool bulk, int64_t pending_bytes,
+                    const std::string& method, int64_t response_bytes);
+
+  int num_connections() const {
+    return loads_.size();
+  }
+
+  // Returns the number of calls pending on connection 'idx'.
+  int64_t pending_calls(int idx) const;
+
+ private:
+  struct ConnectionLoad {
+    ConnectionLoad() : calls(0), bulk_calls(0), bytes(0) {}
+
+    int64_t calls;
+    int64_t bulk_calls;
+    int64_t bytes;
+  };
+
+  mutable simple_spinlock lock_;
+
+  // Protected by lock_.
+  std::vector<ConnectionLoad> loads_;
+
+  // The size of the latest response to each method, by "service.method".
+  // Protected by lock_.
+  std::unordered_map<std::string, int64_t> response_bytes_by_method_;
+
+  DISALLOW_COPY_AND_ASSIGN(ConnectionGroup);
+};
+
+} // namespace rpc
+} // namespace kudu
+
+#endif
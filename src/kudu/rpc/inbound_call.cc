@@ -55,7 +55,20 @@ InboundCall::~InboundCall() {}
 Status InboundCall::ParseFrom(gscoped_ptr<InboundTransfer> transfer) {
   TRACE_EVENT_FLOW_BEGIN0("rpc", "InboundCall", this);
   TRACE_EVENT0("rpc", "InboundCall::ParseFrom");
-  RETURN_NOT_OK(serialization::ParseMessage(transfer->data(), &header_, &serialized_request_));
+  Slice entire_message;
+  RETURN_NOT_OK(serialization::ParseMessage(transfer->data(), &header_, &entire_message));
+  RETURN_NOT_OK(serialization::ParseSidecars(header_.sidecar_offsets(), entire_message,
+                                             &serialized_request_, inbound_sidecar_slices_));
+  if (header_.uncompressed_part_sizes_size() > 0) {
+    serialization::CompressionStats stats;
+    RETURN_NOT_OK(serialization::DecompressPayload(header_.uncompressed_part_sizes(),
+                                                   &serialized_request_,
+                                                   inbound_sidecar_slices_,
+                                                   header_.sidecar_offsets_size(),
+                                                   &decompressed_buf_,
+                                                   &stats));
+    conn_->RecordCompressedPayload(stats);
+  }
 
   // Adopt the service/method info from the header as soon as it's available.
   if (PREDICT_FALSE(!header_.has_remote_method())) {
@@ -67,6 +80,11 @@ Status InboundCall::ParseFrom(gscoped_ptr<InboundTransfer> transfer) {
   }
   remote_method_.FromPB(header_.remote_method());
 
+  if (PREDICT_FALSE(header_.has_trace_id() && header_.trace_id() != 0)) {
+    trace_->SetSampled(header_.trace_id());
+    TRACE_TO(trace_, "Part of sampled trace $0", header_.trace_id());
+  }
+
   // Retain the buffer that we have a view into.
   transfer_.swap(transfer);
   return Status::OK();
@@ -159,7 +177,26 @@ void InboundCall::SerializeResponseBuffer(const MessageLite& response,
   int additional_size = absolute_sidecar_offset - protobuf_msg_size;
   serialization::SerializeMessage(response, &response_msg_buf_,
                                   additional_size, true);
-  int main_msg_size = additional_size + response_msg_buf_.size();
+
+  response_sidecar_slices_.clear();
+  for (RpcSidecar* car : sidecars_) {
+    response_sidecar_slices_.push_back(car->AsSlice());
+  }
+  if (conn_->RemoteSupportsFeature(LZ4_COMPRESSION)) {
+    serialization::CompressionStats stats;
+    serialization::CompressPayload(&response_msg_buf_, &response_sidecar_slices_,
+                                   &compressed_sidecars_buf_,
+                                   resp_hdr.mutable_sidecar_offsets(),
+                                   resp_hdr.mutable_uncompressed_part_sizes(), &stats);
+    if (stats.uncompressed_bytes > 0) {
+      conn_->RecordCompressedPayload(stats);
+    }
+  }
+
+  int main_msg_size = response_msg_buf_.size();
+  for (const Slice& sidecar : response_sidecar_slices_) {
+    main_msg_size += sidecar.size();
+  }
   serialization::SerializeHeader(resp_hdr, main_msg_size,
                                  &response_hdr_buf_);
 }
@@ -168,12 +205,20 @@ void InboundCall::SerializeResponseTo(vector<Slice>* slices) const {
   TRACE_EVENT0("rpc", "InboundCall::SerializeResponseTo");
   CHECK_GT(response_hdr_buf_.size(), 0);
   CHECK_GT(response_msg_buf_.size(), 0);
-  slices->reserve(slices->size() + 2 + sidecars_.size());
+  slices->reserve(slices->size() + 2 + response_sidecar_slices_.size());
   slices->push_back(Slice(response_hdr_buf_));
   slices->push_back(Slice(response_msg_buf_));
-  for (RpcSidecar* car : sidecars_) {
-    slices->push_back(car->AsSlice());
+  slices->insert(slices->end(), response_sidecar_slices_.begin(),
+                 response_sidecar_slices_.end());
+}
+
+Status InboundCall::GetInboundSidecar(int idx, Slice* sidecar) const {
+  if (idx < 0 || idx >= header_.sidecar_offsets_size()) {
+    return Status::InvalidArgument(Substitute(
+        "Index $0 does not reference a valid sidecar", idx));
   }
+  *sidecar = inbound_sidecar_slices_[idx];
+  return Status::OK();
 }
 
 Status InboundCall::AddRpcSidecar(gscoped_ptr<RpcSidecar> car, int* idx) {
@@ -276,6 +321,14 @@ MonoTime InboundCall::GetClientDeadline() const {
   return timing_.time_received + MonoDelta::FromMilliseconds(header_.timeout_millis());
 }
 
+bool InboundCall::ClientAbandoned() const {
+  if (conn_->IsShutdown()) {
+    return true;
+  }
+  MonoTime deadline = GetClientDeadline();
+  return deadline != MonoTime::Max() && MonoTime::Now() > deadline;
+}
+
 MonoTime InboundCall::GetTimeReceived() const {
   return timing_.time_received;
 }
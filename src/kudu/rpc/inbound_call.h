@@ -73,9 +73,10 @@ class InboundCall {
   // Parse an inbound call message.
   //
   // This only deserializes the call header, populating the 'header_' and
-  // 'serialized_request_' member variables. The actual call parameter is
-  // not deserialized, as this may be CPU-expensive, and this is called
-  // from the reactor thread.
+  // 'serialized_request_' member variables, and decompresses the payload
+  // parts which were compressed. The actual call parameter is not
+  // deserialized, as this may be CPU-expensive, and this is called from the
+  // reactor thread.
   Status ParseFrom(gscoped_ptr<InboundTransfer> transfer);
 
   // Return the serialized request parameter protobuf.
@@ -126,6 +127,9 @@ class InboundCall {
   // See RpcContext::AddRpcSidecar()
   Status AddRpcSidecar(gscoped_ptr<RpcSidecar> car, int* idx);
 
+  // See RpcContext::GetInboundSidecar()
+  Status GetInboundSidecar(int idx, Slice* sidecar) const;
+
   std::string ToString() const;
 
   void DumpPB(const DumpRunningRpcsRequestPB& req, RpcCallInProgressPB* resp);
@@ -180,6 +184,10 @@ class InboundCall {
   // If the client did not specify a deadline, returns MonoTime::Max().
   MonoTime GetClientDeadline() const;
 
+  // Return true if the client can no longer receive the response, because
+  // its deadline passed or its connection was closed.
+  bool ClientAbandoned() const;
+
   // Return the time when this call was received.
   MonoTime GetTimeReceived() const;
 
@@ -216,15 +224,29 @@ class InboundCall {
   // This references memory held by 'transfer_'.
   Slice serialized_request_;
 
+  // Slices of data for the sidecars sent along with the request. Set by
+  // ParseFrom(). These reference memory held by 'transfer_'.
+  Slice inbound_sidecar_slices_[OutboundTransfer::kMaxPayloadSlices];
+
   // The transfer that produced the call.
   // This is kept around because it retains the memory referred to
-  // by 'serialized_request_' above.
+  // by 'serialized_request_' and 'inbound_sidecar_slices_' above.
   gscoped_ptr<InboundTransfer> transfer_;
 
+  // Holds the parts of the request which were received compressed, once
+  // decompressed. 'serialized_request_' and 'inbound_sidecar_slices_' refer
+  // into it instead of 'transfer_' for those parts.
+  faststring decompressed_buf_;
+
   // The buffers for serialized response. Set by SerializeResponseBuffer().
   faststring response_hdr_buf_;
   faststring response_msg_buf_;
 
+  // The response sidecars as sent, and the storage for those which were
+  // compressed. Set by SerializeResponseBuffer().
+  std::vector<Slice> response_sidecar_slices_;
+  faststring compressed_sidecars_buf_;
+
   // Vector of additional sidecars that are tacked on to the call's response
   // after serialization of the protobuf. See rpc/rpc_sidecar.h for more info.
   std::vector<RpcSidecar*> sidecars_;
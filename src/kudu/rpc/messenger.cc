@@ -35,6 +35,7 @@
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/acceptor_pool.h"
 #include "kudu/rpc/connection.h"
+#include "kudu/rpc/connection_group.h"
 #include "kudu/rpc/constants.h"
 #include "kudu/rpc/reactor.h"
 #include "kudu/rpc/rpc_header.pb.h"
@@ -47,6 +48,7 @@
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/socket.h"
+#include "kudu/util/numa.h"
 #include "kudu/util/status.h"
 #include "kudu/util/threadpool.h"
 #include "kudu/util/trace.h"
@@ -55,11 +57,20 @@ using std::string;
 using std::shared_ptr;
 using strings::Substitute;
 
+DECLARE_bool(rpc_acceptor_reuseport);
+
 DEFINE_int32(rpc_default_keepalive_time_ms, 65000,
              "If an RPC connection from a client is idle for this amount of time, the server "
              "will disconnect the client.");
 TAG_FLAG(rpc_default_keepalive_time_ms, advanced);
 
+DEFINE_int32(rpc_num_connections_per_server, 1,
+             "Number of connections a messenger opens to each remote server. With "
+             "more than one, outbound calls are spread among the connections by their "
+             "size and the number of calls pending on each, so that small calls are "
+             "not queued behind bulk transfers.");
+TAG_FLAG(rpc_num_connections_per_server, experimental);
+
 namespace kudu {
 namespace rpc {
 
@@ -72,7 +83,8 @@ MessengerBuilder::MessengerBuilder(std::string name)
           MonoDelta::FromMilliseconds(FLAGS_rpc_default_keepalive_time_ms)),
       num_reactors_(4),
       num_negotiation_threads_(4),
-      coarse_timer_granularity_(MonoDelta::FromMilliseconds(100)) {}
+      coarse_timer_granularity_(MonoDelta::FromMilliseconds(100)),
+      num_connections_per_server_(FLAGS_rpc_num_connections_per_server) {}
 
 MessengerBuilder& MessengerBuilder::set_connection_keepalive_time(const MonoDelta &keepalive) {
   connection_keepalive_time_ = keepalive;
@@ -100,6 +112,12 @@ MessengerBuilder &MessengerBuilder::set_metric_entity(
   return *this;
 }
 
+MessengerBuilder &MessengerBuilder::set_num_connections_per_server(int num_connections) {
+  CHECK_GT(num_connections, 0);
+  num_connections_per_server_ = num_connections;
+  return *this;
+}
+
 Status MessengerBuilder::Build(Messenger **msgr) {
   RETURN_NOT_OK(SaslInit(kSaslAppName)); // Initialize SASL library before we start making requests
   gscoped_ptr<Messenger> new_msgr(new Messenger(*this));
@@ -163,6 +181,9 @@ Status Messenger::AddAcceptorPool(const Sockaddr &accept_addr,
   Socket sock;
   RETURN_NOT_OK(sock.Init(0));
   RETURN_NOT_OK(sock.SetReuseAddr(true));
+  if (FLAGS_rpc_acceptor_reuseport) {
+    RETURN_NOT_OK(sock.SetReusePort(true));
+  }
   RETURN_NOT_OK(sock.Bind(accept_addr));
   Sockaddr remote;
   RETURN_NOT_OK(sock.GetSocketAddress(&remote));
@@ -204,10 +225,22 @@ Status Messenger::UnregisterService(const string& service_name) {
 }
 
 void Messenger::QueueOutboundCall(const shared_ptr<OutboundCall> &call) {
-  Reactor *reactor = RemoteToReactor(call->conn_id().remote());
+  if (num_connections_per_server_ > 1) {
+    GetConnectionGroup(call->conn_id())->AssignConnection(call.get());
+  }
+  Reactor *reactor = RemoteToReactor(call->conn_id().remote(), call->conn_id().idx());
   reactor->QueueOutboundCall(call);
 }
 
+shared_ptr<ConnectionGroup> Messenger::GetConnectionGroup(const ConnectionId& conn_id) {
+  std::lock_guard<simple_spinlock> l(conn_groups_lock_);
+  shared_ptr<ConnectionGroup>& group = conn_groups_[conn_id];
+  if (!group) {
+    group = std::make_shared<ConnectionGroup>(num_connections_per_server_);
+  }
+  return group;
+}
+
 void Messenger::QueueInboundCall(gscoped_ptr<InboundCall> call) {
   shared_lock<rw_spinlock> guard(lock_.get_lock());
   scoped_refptr<RpcService>* service = FindOrNull(rpc_services_,
@@ -227,15 +260,21 @@ void Messenger::QueueInboundCall(gscoped_ptr<InboundCall> call) {
 }
 
 void Messenger::RegisterInboundSocket(Socket *new_socket, const Sockaddr &remote) {
-  Reactor *reactor = RemoteToReactor(remote);
+  Reactor *reactor = InboundSocketToReactor(*new_socket, remote);
   reactor->RegisterInboundSocket(new_socket, remote);
 }
 
+void Messenger::RegisterInboundSocket(Socket *new_socket, const Sockaddr &remote,
+                                      int reactor_idx) {
+  reactors_[reactor_idx % reactors_.size()]->RegisterInboundSocket(new_socket, remote);
+}
+
 Messenger::Messenger(const MessengerBuilder &bld)
   : name_(bld.name_),
     closing_(false),
     rpcz_store_(new RpczStore()),
     metric_entity_(bld.metric_entity_),
+    num_connections_per_server_(bld.num_connections_per_server_),
     retain_self_(this) {
   for (int i = 0; i < bld.num_reactors_; i++) {
     reactors_.push_back(new Reactor(retain_self_, i, bld));
@@ -251,14 +290,30 @@ Messenger::~Messenger() {
   STLDeleteElements(&reactors_);
 }
 
-Reactor* Messenger::RemoteToReactor(const Sockaddr &remote) {
+Reactor* Messenger::RemoteToReactor(const Sockaddr &remote, int idx) {
   uint32_t hashCode = remote.HashCode();
-  int reactor_idx = hashCode % reactors_.size();
+  // Consecutive connections to the same remote go to different reactors.
+  int reactor_idx = (hashCode + idx) % reactors_.size();
   // This is just a static partitioning; we could get a lot
   // fancier with assigning Sockaddrs to Reactors.
   return reactors_[reactor_idx];
 }
 
+Reactor* Messenger::InboundSocketToReactor(const Socket& socket, const Sockaddr &remote) {
+  const int num_nodes = NumaNodeCount();
+  int cpu;
+  if (num_nodes == 1 || !socket.GetIncomingCpu(&cpu).ok() || cpu < 0) {
+    return RemoteToReactor(remote);
+  }
+  // Reactor 'i' runs on node 'i % num_nodes'; see ReactorThread::RunThread().
+  const int node = NumaNodeOfCpu(cpu);
+  const int num_node_reactors = (reactors_.size() + num_nodes - 1 - node) / num_nodes;
+  if (num_node_reactors == 0) {
+    return RemoteToReactor(remote);
+  }
+  return reactors_[node + num_nodes * (remote.HashCode() % num_node_reactors)];
+}
+
 
 Status Messenger::Init() {
   Status status;
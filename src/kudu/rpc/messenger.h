@@ -29,6 +29,7 @@
 
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/rpc/outbound_call.h"
 #include "kudu/rpc/response_callback.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
@@ -44,6 +45,7 @@ class ThreadPool;
 namespace rpc {
 
 class AcceptorPool;
+class ConnectionGroup;
 class DumpRunningRpcsRequestPB;
 class DumpRunningRpcsResponsePB;
 class InboundCall;
@@ -92,6 +94,11 @@ class MessengerBuilder {
   // Set metric entity for use by RPC systems.
   MessengerBuilder &set_metric_entity(const scoped_refptr<MetricEntity>& metric_entity);
 
+  // Set the number of connections opened to each remote server. Outbound
+  // calls are spread among them by their size and the number of calls
+  // pending on each connection.
+  MessengerBuilder &set_num_connections_per_server(int num_connections);
+
   Status Build(std::shared_ptr<Messenger> *msgr);
 
  private:
@@ -102,6 +109,7 @@ class MessengerBuilder {
   int num_negotiation_threads_;
   MonoDelta coarse_timer_granularity_;
   scoped_refptr<MetricEntity> metric_entity_;
+  int num_connections_per_server_;
 };
 
 // A Messenger is a container for the reactor threads which run event loops
@@ -162,6 +170,10 @@ class Messenger {
   // Take ownership of the socket via Socket::Release
   void RegisterInboundSocket(Socket *new_socket, const Sockaddr &remote);
 
+  // Take ownership of the socket via Socket::Release, handing it to the
+  // reactor with index 'reactor_idx'.
+  void RegisterInboundSocket(Socket *new_socket, const Sockaddr &remote, int reactor_idx);
+
   // Dump the current RPCs into the given protobuf.
   Status DumpRunningRpcs(const DumpRunningRpcsRequestPB& req,
                          DumpRunningRpcsResponsePB* resp);
@@ -194,10 +206,24 @@ class Messenger {
 
  private:
   FRIEND_TEST(TestRpc, TestConnectionKeepalive);
+  FRIEND_TEST(TestRpc, TestMultipleConnectionsPerServer);
+  FRIEND_TEST(TestRpc, TestReusePortAcceptors);
+  FRIEND_TEST(TestRpc, TestCoalescedWrites);
 
   explicit Messenger(const MessengerBuilder &bld);
 
-  Reactor* RemoteToReactor(const Sockaddr &remote);
+  // Return the reactor handling connection 'idx' to 'remote'.
+  Reactor* RemoteToReactor(const Sockaddr &remote, int idx = 0);
+
+  // Return the reactor to handle the inbound connection 'socket' from
+  // 'remote': one on the NUMA node whose CPUs process the socket's packets,
+  // if that can be told, and RemoteToReactor(remote) otherwise.
+  Reactor* InboundSocketToReactor(const Socket& socket, const Sockaddr &remote);
+
+  // Return the group of connections which calls to the remote of 'conn_id'
+  // are spread among, creating it if necessary.
+  std::shared_ptr<ConnectionGroup> GetConnectionGroup(const ConnectionId& conn_id);
+
   Status Init();
   void RunTimeoutThread();
   void UpdateCurTime();
@@ -230,6 +256,15 @@ class Messenger {
 
   scoped_refptr<MetricEntity> metric_entity_;
 
+  const int num_connections_per_server_;
+
+  // The connection groups by remote and credentials, used only when there
+  // are several connections per server. Protected by 'conn_groups_lock_'.
+  typedef std::unordered_map<ConnectionId, std::shared_ptr<ConnectionGroup>,
+                             ConnectionIdHash, ConnectionIdEqual> ConnectionGroupMap;
+  ConnectionGroupMap conn_groups_;
+  simple_spinlock conn_groups_lock_;
+
   // The ownership of the Messenger object is somewhat subtle. The pointer graph
   // looks like this:
   //
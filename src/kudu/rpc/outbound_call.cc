@@ -27,13 +27,18 @@
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/walltime.h"
 #include "kudu/rpc/outbound_call.h"
+#include "kudu/rpc/connection_group.h"
 #include "kudu/rpc/constants.h"
 #include "kudu/rpc/rpc_controller.h"
 #include "kudu/rpc/rpc_introspection.pb.h"
+#include "kudu/rpc/rpc_sidecar.h"
 #include "kudu/rpc/serialization.h"
 #include "kudu/rpc/transfer.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/kernel_stack_watchdog.h"
+#include "kudu/util/random.h"
+#include "kudu/util/random_util.h"
+#include "kudu/util/trace.h"
 
 namespace kudu {
 namespace rpc {
@@ -41,6 +46,7 @@ namespace rpc {
 using google::protobuf::io::CodedOutputStream;
 using google::protobuf::Message;
 using std::set;
+using std::shared_ptr;
 using strings::Substitute;
 
 static const double kMicrosPerSecond = 1000000.0;
@@ -55,6 +61,14 @@ DEFINE_int64(rpc_callback_max_cycles, 100 * 1000 * 1000,
 TAG_FLAG(rpc_callback_max_cycles, advanced);
 TAG_FLAG(rpc_callback_max_cycles, runtime);
 
+DEFINE_double(rpc_trace_sample_rate, 0,
+              "Fraction of the outbound calls made outside of a sampled trace which "
+              "start a new sampled distributed trace. The ID of a sampled trace is "
+              "passed on by the calls made while handling its calls, and the servers "
+              "keep the traces of these calls in their rpcz store.");
+TAG_FLAG(rpc_trace_sample_rate, advanced);
+TAG_FLAG(rpc_trace_sample_rate, runtime);
+
 ///
 /// OutboundCall
 ///
@@ -68,7 +82,11 @@ OutboundCall::OutboundCall(const ConnectionId& conn_id,
       conn_id_(conn_id),
       callback_(std::move(callback)),
       controller_(DCHECK_NOTNULL(controller)),
-      response_(DCHECK_NOTNULL(response_storage)) {
+      bulk_(false),
+      pending_bytes_(0),
+      response_bytes_(0),
+      response_(DCHECK_NOTNULL(response_storage)),
+      sidecars_deleter_(&sidecars_) {
   DVLOG(4) << "OutboundCall " << this << " constructed with state_: " << StateName(state_)
            << " and RPC timeout: "
            << (controller->timeout().Initialized() ? controller->timeout().ToString() : "none");
@@ -83,6 +101,32 @@ OutboundCall::OutboundCall(const ConnectionId& conn_id,
   if (controller_->request_id_) {
     header_.set_allocated_request_id(controller_->request_id_.release());
   }
+  sidecars_.swap(controller_->outbound_sidecars_);
+  SetTraceId();
+}
+
+void OutboundCall::SetTraceId() {
+  Trace* trace = Trace::CurrentTrace();
+  uint64_t trace_id = trace ? trace->sampled_trace_id() : 0;
+  if (PREDICT_TRUE(trace_id == 0)) {
+    double rate = FLAGS_rpc_trace_sample_rate;
+    if (PREDICT_TRUE(rate <= 0)) {
+      return;
+    }
+    static ThreadSafeRandom rng(GetRandomSeed32());
+    if (rate < 1 && rng.Next32() >= rate * 4294967296.0) {
+      return;
+    }
+    do {
+      trace_id = rng.Next64();
+    } while (trace_id == 0);
+    // The work already traced under the current trace, if any, is part of the
+    // new distributed trace.
+    if (trace) {
+      trace->SetSampled(trace_id);
+    }
+  }
+  header_.set_trace_id(trace_id);
 }
 
 OutboundCall::~OutboundCall() {
@@ -90,11 +134,25 @@ OutboundCall::~OutboundCall() {
   DVLOG(4) << "OutboundCall " << this << " destroyed with state_: " << StateName(state_);
 }
 
-Status OutboundCall::SerializeTo(vector<Slice>* slices) {
-  size_t param_len = request_buf_.size();
-  if (PREDICT_FALSE(param_len == 0)) {
+Status OutboundCall::SerializeTo(vector<Slice>* slices, bool compress,
+                                 serialization::CompressionStats* stats) {
+  if (PREDICT_FALSE(request_buf_.size() == 0)) {
     return Status::InvalidArgument("Must call SetRequestParam() before SerializeTo()");
   }
+  vector<Slice> sidecar_slices;
+  sidecar_slices.reserve(sidecars_.size());
+  for (const RpcSidecar* car : sidecars_) {
+    sidecar_slices.push_back(car->AsSlice());
+  }
+  if (compress) {
+    serialization::CompressPayload(&request_buf_, &sidecar_slices, &compressed_sidecars_buf_,
+                                   header_.mutable_sidecar_offsets(),
+                                   header_.mutable_uncompressed_part_sizes(), stats);
+  }
+  size_t param_len = request_buf_.size();
+  for (const Slice& sidecar : sidecar_slices) {
+    param_len += sidecar.size();
+  }
 
   const MonoDelta &timeout = controller_->timeout();
   if (timeout.Initialized()) {
@@ -108,13 +166,27 @@ Status OutboundCall::SerializeTo(vector<Slice>* slices) {
   serialization::SerializeHeader(header_, param_len, &header_buf_);
 
   // Return the concatenated packet.
+  slices->reserve(slices->size() + 2 + sidecar_slices.size());
   slices->push_back(Slice(header_buf_));
   slices->push_back(Slice(request_buf_));
+  slices->insert(slices->end(), sidecar_slices.begin(), sidecar_slices.end());
   return Status::OK();
 }
 
 void OutboundCall::SetRequestParam(const Message& message) {
-  serialization::SerializeMessage(message, &request_buf_);
+  if (sidecars_.empty()) {
+    serialization::SerializeMessage(message, &request_buf_);
+    return;
+  }
+
+  uint32_t protobuf_msg_size = message.ByteSize();
+  uint32_t absolute_sidecar_offset = protobuf_msg_size;
+  for (const RpcSidecar* car : sidecars_) {
+    header_.add_sidecar_offsets(absolute_sidecar_offset);
+    absolute_sidecar_offset += car->AsSlice().size();
+  }
+  int additional_size = absolute_sidecar_offset - protobuf_msg_size;
+  serialization::SerializeMessage(message, &request_buf_, additional_size, true);
 }
 
 Status OutboundCall::status() const {
@@ -182,7 +254,33 @@ void OutboundCall::set_state_unlocked(State new_state) {
   state_ = new_state;
 }
 
+size_t OutboundCall::request_payload_size() const {
+  size_t size = request_buf_.size();
+  for (const RpcSidecar* car : sidecars_) {
+    size += car->AsSlice().size();
+  }
+  return size;
+}
+
+void OutboundCall::SetConnectionGroup(shared_ptr<ConnectionGroup> group, int idx,
+                                      bool bulk, int64_t pending_bytes) {
+  DCHECK(!conn_group_);
+  conn_group_ = std::move(group);
+  conn_id_.set_idx(idx);
+  bulk_ = bulk;
+  pending_bytes_ = pending_bytes;
+}
+
 void OutboundCall::CallCallback() {
+  // The call no longer loads its connection, even if the callback takes a
+  // while.
+  if (conn_group_) {
+    conn_group_->CallFinished(conn_id_.idx(), bulk_, pending_bytes_,
+                              remote_method_.service_name() + "." +
+                              remote_method_.method_name(),
+                              response_bytes_);
+    conn_group_.reset();
+  }
   int64_t start_cycles = CycleClock::Now();
   {
     SCOPED_WATCH_STACK(100);
@@ -206,6 +304,7 @@ void OutboundCall::CallCallback() {
 
 void OutboundCall::SetResponse(gscoped_ptr<CallResponse> resp) {
   call_response_ = std::move(resp);
+  response_bytes_ = call_response_->transfer_size();
   Slice r(call_response_->serialized_response());
 
   if (call_response_->is_success()) {
@@ -382,13 +481,14 @@ bool UserCredentials::Equals(const UserCredentials& other) const {
 /// ConnectionId
 ///
 
-ConnectionId::ConnectionId() {}
+ConnectionId::ConnectionId() : idx_(0) {}
 
 ConnectionId::ConnectionId(const ConnectionId& other) {
   DoCopyFrom(other);
 }
 
-ConnectionId::ConnectionId(const Sockaddr& remote, const UserCredentials& user_credentials) {
+ConnectionId::ConnectionId(const Sockaddr& remote, const UserCredentials& user_credentials)
+    : idx_(0) {
   remote_ = remote;
   user_credentials_.CopyFrom(user_credentials);
 }
@@ -407,26 +507,30 @@ void ConnectionId::CopyFrom(const ConnectionId& other) {
 
 string ConnectionId::ToString() const {
   // Does not print the password.
-  return StringPrintf("{remote=%s, user_credentials=%s}",
+  return StringPrintf("{remote=%s, user_credentials=%s, idx=%d}",
       remote_.ToString().c_str(),
-      user_credentials_.ToString().c_str());
+      user_credentials_.ToString().c_str(),
+      idx_);
 }
 
 void ConnectionId::DoCopyFrom(const ConnectionId& other) {
   remote_ = other.remote_;
   user_credentials_.CopyFrom(other.user_credentials_);
+  idx_ = other.idx_;
 }
 
 size_t ConnectionId::HashCode() const {
   size_t seed = 0;
   boost::hash_combine(seed, remote_.HashCode());
   boost::hash_combine(seed, user_credentials_.HashCode());
+  boost::hash_combine(seed, idx_);
   return seed;
 }
 
 bool ConnectionId::Equals(const ConnectionId& other) const {
   return (remote() == other.remote()
-       && user_credentials().Equals(other.user_credentials()));
+       && user_credentials().Equals(other.user_credentials())
+       && idx() == other.idx());
 }
 
 size_t ConnectionIdHash::operator() (const ConnectionId& conn_id) const {
@@ -455,47 +559,24 @@ Status CallResponse::GetSidecar(int idx, Slice* sidecar) const {
   return Status::OK();
 }
 
-Status CallResponse::ParseFrom(gscoped_ptr<InboundTransfer> transfer) {
+Status CallResponse::ParseFrom(gscoped_ptr<InboundTransfer> transfer,
+                               serialization::CompressionStats* stats) {
   CHECK(!parsed_);
   Slice entire_message;
   RETURN_NOT_OK(serialization::ParseMessage(transfer->data(), &header_,
                                             &entire_message));
 
   // Use information from header to extract the payload slices.
-  int last = header_.sidecar_offsets_size() - 1;
-
-  if (last >= OutboundTransfer::kMaxPayloadSlices) {
-    return Status::Corruption(strings::Substitute(
-        "Received $0 additional payload slices, expected at most %d",
-        last, OutboundTransfer::kMaxPayloadSlices));
-  }
-
-  if (last >= 0) {
-    serialized_response_ = Slice(entire_message.data(),
-                                 header_.sidecar_offsets(0));
-    for (int i = 0; i < last; ++i) {
-      uint32_t next_offset = header_.sidecar_offsets(i);
-      int32_t len = header_.sidecar_offsets(i + 1) - next_offset;
-      if (next_offset + len > entire_message.size() || len < 0) {
-        return Status::Corruption(strings::Substitute(
-            "Invalid sidecar offsets; sidecar $0 apparently starts at $1,"
-            " has length $2, but the entire message has length $3",
-            i, next_offset, len, entire_message.size()));
-      }
-      sidecar_slices_[i] = Slice(entire_message.data() + next_offset, len);
-    }
-    uint32_t next_offset = header_.sidecar_offsets(last);
-    if (next_offset > entire_message.size()) {
-        return Status::Corruption(strings::Substitute(
-            "Invalid sidecar offsets; the last sidecar ($0) apparently starts "
-            "at $1, but the entire message has length $3",
-            last, next_offset, entire_message.size()));
-    }
-    sidecar_slices_[last] = Slice(entire_message.data() + next_offset,
-                                  entire_message.size() - next_offset);
-  } else {
-    serialized_response_ = entire_message;
-  }
+  RETURN_NOT_OK(serialization::ParseSidecars(header_.sidecar_offsets(),
+                                             entire_message,
+                                             &serialized_response_,
+                                             sidecar_slices_));
+  RETURN_NOT_OK(serialization::DecompressPayload(header_.uncompressed_part_sizes(),
+                                                 &serialized_response_,
+                                                 sidecar_slices_,
+                                                 header_.sidecar_offsets_size(),
+                                                 &decompressed_buf_,
+                                                 stats));
 
   transfer_.swap(transfer);
   parsed_ = true;
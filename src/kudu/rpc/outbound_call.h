@@ -17,6 +17,7 @@
 #ifndef KUDU_RPC_CLIENT_CALL_H
 #define KUDU_RPC_CLIENT_CALL_H
 
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
@@ -25,6 +26,7 @@
 
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/stl_util.h"
 #include "kudu/rpc/constants.h"
 #include "kudu/rpc/rpc_header.pb.h"
 #include "kudu/rpc/remote_method.h"
@@ -47,10 +49,16 @@ namespace rpc {
 
 class CallResponse;
 class Connection;
+class ConnectionGroup;
 class DumpRunningRpcsRequestPB;
 class InboundTransfer;
 class RpcCallInProgressPB;
 class RpcController;
+class RpcSidecar;
+
+namespace serialization {
+struct CompressionStats;
+} // namespace serialization
 
 // Client-side user credentials, such as a user's username & password.
 // In the future, we will add Kerberos credentials.
@@ -112,6 +120,11 @@ class ConnectionId {
   void set_remote(const Sockaddr& remote);
   const Sockaddr& remote() const { return remote_; }
 
+  // The index of this connection among the connections to the remote, when
+  // calls are spread over several (see ConnectionGroup). 0 otherwise.
+  void set_idx(int idx) { idx_ = idx; }
+  int idx() const { return idx_; }
+
   // The credentials of the user associated with this connection, if any.
   void set_user_credentials(const UserCredentials& user_credentials);
   const UserCredentials& user_credentials() const { return user_credentials_; }
@@ -130,6 +143,7 @@ class ConnectionId {
   // Remember to update HashCode() and Equals() when new fields are added.
   Sockaddr remote_;
   UserCredentials user_credentials_;
+  int idx_;
 
   // Implementation of CopyFrom that can be shared with copy constructor.
   void DoCopyFrom(const ConnectionId& other);
@@ -171,6 +185,15 @@ class OutboundCall {
   // subsequently mutated with no ill effects.
   void SetRequestParam(const google::protobuf::Message& req);
 
+  // Returns the size of the serialized request and its sidecars. Requires
+  // that SetRequestParam() is called first.
+  size_t request_payload_size() const;
+
+  // Sends this call on connection 'idx' of 'group', which must be told once
+  // the call finishes. See ConnectionGroup::AssignConnection().
+  void SetConnectionGroup(std::shared_ptr<ConnectionGroup> group, int idx,
+                          bool bulk, int64_t pending_bytes);
+
   // Assign the call ID for this call. This is called from the reactor
   // thread once a connection has been assigned. Must only be called once.
   void set_call_id(int32_t call_id) {
@@ -180,7 +203,12 @@ class OutboundCall {
 
   // Serialize the call for the wire. Requires that SetRequestParam()
   // is called first. This is called from the Reactor thread.
-  Status SerializeTo(std::vector<Slice>* slices);
+  //
+  // If 'compress' is true, which requires that the server supports the
+  // LZ4_COMPRESSION feature, large payload parts may be compressed, see
+  // serialization::CompressPayload(). 'stats' accumulates their sizes.
+  Status SerializeTo(std::vector<Slice>* slices, bool compress,
+                     serialization::CompressionStats* stats);
 
   // Callback after the call has been put on the outbound connection queue.
   void SetQueued();
@@ -237,6 +265,11 @@ class OutboundCall {
  private:
   friend class RpcController;
 
+  // Put the ID of the sampled trace the call is part of in the header: either
+  // that of the trace adopted by the calling thread, or a new one if the call
+  // is chosen to start a sampled trace.
+  void SetTraceId();
+
   // Various states the call propagates through.
   // NB: if adding another state, be sure to update OutboundCall::IsFinished()
   // and OutboundCall::StateName(State state) as well.
@@ -294,6 +327,16 @@ class OutboundCall {
   ResponseCallback callback_;
   RpcController* controller_;
 
+  // The group of connections this call was spread over, if any, and what it
+  // told the group about the call. The group is reset once it's told that
+  // the call finished.
+  std::shared_ptr<ConnectionGroup> conn_group_;
+  bool bulk_;
+  int64_t pending_bytes_;
+
+  // The size of the response transfer, once received.
+  int64_t response_bytes_;
+
   // Pointer for the protobuf where the response should be written.
   google::protobuf::Message* response_;
 
@@ -301,6 +344,15 @@ class OutboundCall {
   faststring header_buf_;
   faststring request_buf_;
 
+  // Sidecars sent after the request, taken over from the controller so that
+  // they outlive a transfer that is still in progress when the call times
+  // out. Owned.
+  std::vector<RpcSidecar*> sidecars_;
+  ElementDeleter sidecars_deleter_;
+
+  // The sidecars compressed by SerializeTo(), if any.
+  faststring compressed_sidecars_buf_;
+
   // Once a response has been received for this call, contains that response.
   // Otherwise NULL.
   gscoped_ptr<CallResponse> call_response_;
@@ -321,8 +373,10 @@ class CallResponse {
   CallResponse();
 
   // Parse the response received from a call. This must be called before any
-  // other methods on this object.
-  Status ParseFrom(gscoped_ptr<InboundTransfer> transfer);
+  // other methods on this object. Compressed payload parts are decompressed,
+  // and their sizes accumulated in 'stats'.
+  Status ParseFrom(gscoped_ptr<InboundTransfer> transfer,
+                   serialization::CompressionStats* stats);
 
   // Return true if the call succeeded.
   bool is_success() const {
@@ -346,6 +400,11 @@ class CallResponse {
   // See RpcController::GetSidecar()
   Status GetSidecar(int idx, Slice* sidecar) const;
 
+  // Return the size of the transfer the response was received in.
+  size_t transfer_size() const {
+    return transfer_->data().size();
+  }
+
  private:
   // True once ParseFrom() is called.
   bool parsed_;
@@ -357,9 +416,14 @@ class CallResponse {
   // This slice refers to memory allocated by transfer_
   Slice serialized_response_;
 
-  // Slices of data for rpc sidecars. They point into memory owned by transfer_.
+  // Slices of data for rpc sidecars. They point into memory owned by transfer_,
+  // or by decompressed_buf_ for the sidecars which were compressed.
   Slice sidecar_slices_[OutboundTransfer::kMaxPayloadSlices];
 
+  // Holds the payload parts which were received compressed, once
+  // decompressed.
+  faststring decompressed_buf_;
+
   // The incoming transfer data - retained because serialized_response_
   // and sidecar_slices_ refer into its data.
   gscoped_ptr<InboundTransfer> transfer_;
@@ -185,6 +185,9 @@ class MethodSubstitutions : public Substituter {
     (*map)["metric_enum_key"] = strings::Substitute("kMetricIndex$0", method_->name());
     bool track_result = static_cast<bool>(method_->options().GetExtension(track_rpc_result));
     (*map)["track_result"] = track_result ? " true" : "false";
+    bool reuse_messages = static_cast<bool>(
+        method_->options().GetExtension(reuse_rpc_messages));
+    (*map)["reuse_messages"] = reuse_messages ? "true" : "false";
   }
 
   // Strips the package from method arguments if they are in the same package as
@@ -427,7 +430,7 @@ class CodeGenerator : public ::google::protobuf::compiler::CodeGenerator {
           "  \"$rpc_full_name$ RPC Time\",\n"
           "  kudu::MetricUnit::kMicroseconds,\n"
           "  \"Microseconds spent handling $rpc_full_name$() RPC requests\",\n"
-          "  60000000LU, 2);\n"
+          "  60000000LU, 2, kudu::SHARDED_HISTOGRAM);\n"
           "\n");
         subs->Pop();
       }
@@ -466,6 +469,7 @@ class CodeGenerator : public ::google::protobuf::compiler::CodeGenerator {
               "    mi->req_prototype.reset(new $request$());\n"
               "    mi->resp_prototype.reset(new $response$());\n"
               "    mi->track_result = $track_result$;\n"
+              "    mi->reuse_messages = $reuse_messages$;\n"
               "    mi->handler_latency_histogram =\n"
               "        METRIC_handler_latency_$rpc_full_name_plainchars$.Instantiate(entity);\n"
               "    mi->func = [this](const Message* req, Message* resp, RpcContext* ctx) {\n"
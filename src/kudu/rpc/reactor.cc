@@ -43,6 +43,7 @@
 #include "kudu/util/errno.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/monotime.h"
+#include "kudu/util/numa.h"
 #include "kudu/util/thread.h"
 #include "kudu/util/threadpool.h"
 #include "kudu/util/thread_restrictions.h"
@@ -83,6 +84,8 @@ ReactorThread::ReactorThread(Reactor *reactor, const MessengerBuilder &bld)
   : loop_(kDefaultLibEvFlags),
     cur_time_(MonoTime::Now()),
     last_unused_tcp_scan_(cur_time_),
+    num_write_syscalls_(0),
+    num_transfers_sent_(0),
     reactor_(reactor),
     connection_keepalive_time_(bld.connection_keepalive_time_),
     coarse_timer_granularity_(bld.coarse_timer_granularity_) {
@@ -157,6 +160,8 @@ Status ReactorThread::GetMetrics(ReactorMetrics *metrics) {
   DCHECK(IsCurrentThread());
   metrics->num_client_connections_ = client_conns_.size();
   metrics->num_server_connections_ = server_conns_.size();
+  metrics->num_write_syscalls_ = num_write_syscalls_;
+  metrics->num_transfers_sent_ = num_transfers_sent_;
   return Status::OK();
 }
 
@@ -303,6 +308,9 @@ void ReactorThread::RunThread() {
   ThreadRestrictions::SetWaitAllowed(false);
   ThreadRestrictions::SetIOAllowed(false);
   DVLOG(6) << "Calling ReactorThread::RunThread()...";
+  // Reactors are spread over the NUMA nodes, in the order of their indexes.
+  WARN_NOT_OK(BindCurrentThreadToNumaNode(reactor_->index()),
+              "Unable to bind reactor thread to its NUMA node");
   loop_.run(0);
   VLOG(1) << name() << " thread exiting.";
 
@@ -333,6 +341,7 @@ Status ReactorThread::FindOrStartConnection(const ConnectionId &conn_id,
   // Register the new connection in our map.
   *conn = new Connection(this, conn_id.remote(), sock.Release(), Connection::CLIENT);
   (*conn)->set_user_credentials(conn_id.user_credentials());
+  (*conn)->set_outbound_idx(conn_id.idx());
 
   // Kick off blocking client connection negotiation.
   Status s = StartConnectionNegotiation(*conn);
@@ -424,6 +433,7 @@ void ReactorThread::DestroyConnection(Connection *conn,
   // Unlink connection from lists.
   if (conn->direction() == Connection::CLIENT) {
     ConnectionId conn_id(conn->remote(), conn->user_credentials());
+    conn_id.set_idx(conn->outbound_idx());
     auto it = client_conns_.find(conn_id);
     CHECK(it != client_conns_.end()) << "Couldn't find connection " << conn->ToString();
     client_conns_.erase(it);
@@ -479,6 +489,7 @@ Reactor::Reactor(const shared_ptr<Messenger>& messenger,
                  int index, const MessengerBuilder &bld)
   : messenger_(messenger),
     name_(StringPrintf("%s_R%03d", messenger->name().c_str(), index)),
+    index_(index),
     closing_(false),
     thread_(this, bld) {
 }
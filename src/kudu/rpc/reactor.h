@@ -53,6 +53,11 @@ struct ReactorMetrics {
   int32_t num_client_connections_;
   // Number of server RPC connections currently connected.
   int32_t num_server_connections_;
+  // Number of writev() calls made to send outbound transfers.
+  int64_t num_write_syscalls_;
+  // Number of outbound transfers (call requests or responses) sent. Several
+  // pending transfers of a connection may be sent by a single writev().
+  int64_t num_transfers_sent_;
 };
 
 // A task which can be enqueued to run on the reactor thread.
@@ -158,6 +163,12 @@ class ReactorThread {
 
   MonoTime cur_time() const;
 
+  // Record a writev() call which finished sending 'n_transfers' transfers.
+  void RecordWrite(int n_transfers) {
+    num_write_syscalls_++;
+    num_transfers_sent_ += n_transfers;
+  }
+
   // This may be called from another thread.
   Reactor *reactor();
 
@@ -246,6 +257,10 @@ class ReactorThread {
   // last time we did TCP timeouts.
   MonoTime last_unused_tcp_scan_;
 
+  // See ReactorMetrics.
+  int64_t num_write_syscalls_;
+  int64_t num_transfers_sent_;
+
   // Map of sockaddrs to Connection objects for outbound (client) connections.
   conn_map_t client_conns_;
 
@@ -276,6 +291,9 @@ class Reactor {
 
   const std::string &name() const;
 
+  // The index of the reactor within its messenger.
+  int index() const { return index_; }
+
   // Collect metrics about the reactor.
   Status GetMetrics(ReactorMetrics *metrics);
 
@@ -330,6 +348,8 @@ class Reactor {
 
   const std::string name_;
 
+  const int index_;
+
   // Whether the reactor is shutting down.
   // Guarded by lock_.
   bool closing_;
@@ -92,9 +92,11 @@ struct ScopedMemTrackerUpdater {
 
 ResultTracker::ResultTracker(shared_ptr<MemTracker> mem_tracker)
     : mem_tracker_(std::move(mem_tracker)),
-      clients_(ClientStateMap::key_compare(),
-               ClientStateMapAllocator(mem_tracker_)),
-      gc_thread_stop_latch_(1) {}
+      gc_thread_stop_latch_(1) {
+  for (auto& shard : shards_) {
+    shard.reset(new Shard(mem_tracker_));
+  }
+}
 
 ResultTracker::~ResultTracker() {
   if (gc_thread_) {
@@ -102,27 +104,32 @@ ResultTracker::~ResultTracker() {
     gc_thread_->Join();
   }
 
-  lock_guard<simple_spinlock> l(lock_);
   // Release all the memory for the stuff we'll delete on destruction.
-  for (auto& client_state : clients_) {
-    client_state.second->GCCompletionRecords(
-        mem_tracker_, [] (SequenceNumber, CompletionRecord*){ return true; });
-    mem_tracker_->Release(client_state.second->memory_footprint());
+  for (auto& shard : shards_) {
+    lock_guard<simple_spinlock> l(shard->lock);
+    for (auto& client_state : shard->clients) {
+      client_state.second->GCCompletionRecords(
+          mem_tracker_, [] (SequenceNumber, CompletionRecord*){ return true; });
+      mem_tracker_->Release(client_state.second->memory_footprint());
+    }
+    shard->clients.clear();
   }
 }
 
 ResultTracker::RpcState ResultTracker::TrackRpc(const RequestIdPB& request_id,
                                                 Message* response,
                                                 RpcContext* context) {
-  lock_guard<simple_spinlock> l(lock_);
-  return TrackRpcUnlocked(request_id, response, context);
+  Shard* shard = ShardFor(request_id.client_id());
+  lock_guard<simple_spinlock> l(shard->lock);
+  return TrackRpcUnlocked(shard, request_id, response, context);
 }
 
-ResultTracker::RpcState ResultTracker::TrackRpcUnlocked(const RequestIdPB& request_id,
+ResultTracker::RpcState ResultTracker::TrackRpcUnlocked(Shard* shard,
+                                                        const RequestIdPB& request_id,
                                                         Message* response,
                                                         RpcContext* context) {
   ClientState* client_state = ComputeIfAbsent(
-      &clients_,
+      &shard->clients,
       request_id.client_id(),
       [&]{
         unique_ptr<ClientState> client_state(new ClientState(mem_tracker_));
@@ -185,7 +192,7 @@ ResultTracker::RpcState ResultTracker::TrackRpcUnlocked(const RequestIdPB& reque
       // non-null) copy the response and reply immediately. If there is no context/response
       // do nothing.
       if (context != nullptr) {
-        DCHECK_NOTNULL(response)->CopyFrom(*completion_record->response);
+        CHECK(DCHECK_NOTNULL(response)->ParsePartialFromString(completion_record->response));
         context->call_->RespondSuccess(*response);
         delete context;
       }
@@ -209,12 +216,13 @@ ResultTracker::RpcState ResultTracker::TrackRpcUnlocked(const RequestIdPB& reque
 }
 
 ResultTracker::RpcState ResultTracker::TrackRpcOrChangeDriver(const RequestIdPB& request_id) {
-  lock_guard<simple_spinlock> l(lock_);
-  RpcState state = TrackRpcUnlocked(request_id, nullptr, nullptr);
+  Shard* shard = ShardFor(request_id.client_id());
+  lock_guard<simple_spinlock> l(shard->lock);
+  RpcState state = TrackRpcUnlocked(shard, request_id, nullptr, nullptr);
 
   if (state != RpcState::IN_PROGRESS) return state;
 
-  CompletionRecord* completion_record = FindCompletionRecordOrDieUnlocked(request_id);
+  CompletionRecord* completion_record = FindCompletionRecordOrDieUnlocked(shard, request_id);
   ScopedMemTrackerUpdater<CompletionRecord> updater(mem_tracker_.get(), completion_record);
 
   // ... if we did find a CompletionRecord change the driver and return true.
@@ -229,8 +237,9 @@ ResultTracker::RpcState ResultTracker::TrackRpcOrChangeDriver(const RequestIdPB&
 }
 
 bool ResultTracker::IsCurrentDriver(const RequestIdPB& request_id) {
-  lock_guard<simple_spinlock> l(lock_);
-  CompletionRecord* completion_record = FindCompletionRecordOrNullUnlocked(request_id);
+  Shard* shard = ShardFor(request_id.client_id());
+  lock_guard<simple_spinlock> l(shard->lock);
+  CompletionRecord* completion_record = FindCompletionRecordOrNullUnlocked(shard, request_id);
 
   // If we couldn't find the CompletionRecord, someone might have called FailAndRespond() so
   // just return false.
@@ -275,14 +284,16 @@ void ResultTracker::LogAndTraceFailure(RpcContext* context,
 }
 
 ResultTracker::CompletionRecord* ResultTracker::FindCompletionRecordOrDieUnlocked(
-    const RequestIdPB& request_id) {
-  ClientState* client_state = DCHECK_NOTNULL(FindPointeeOrNull(clients_, request_id.client_id()));
+    Shard* shard, const RequestIdPB& request_id) {
+  ClientState* client_state = DCHECK_NOTNULL(FindPointeeOrNull(shard->clients,
+                                                               request_id.client_id()));
   return DCHECK_NOTNULL(FindPointeeOrNull(client_state->completion_records, request_id.seq_no()));
 }
 
 pair<ResultTracker::ClientState*, ResultTracker::CompletionRecord*>
-ResultTracker::FindClientStateAndCompletionRecordOrNullUnlocked(const RequestIdPB& request_id) {
-  ClientState* client_state = FindPointeeOrNull(clients_, request_id.client_id());
+ResultTracker::FindClientStateAndCompletionRecordOrNullUnlocked(Shard* shard,
+                                                                const RequestIdPB& request_id) {
+  ClientState* client_state = FindPointeeOrNull(shard->clients, request_id.client_id());
   CompletionRecord* completion_record = nullptr;
   if (client_state != nullptr) {
     completion_record = FindPointeeOrNull(client_state->completion_records, request_id.seq_no());
@@ -291,24 +302,26 @@ ResultTracker::FindClientStateAndCompletionRecordOrNullUnlocked(const RequestIdP
 }
 
 ResultTracker::CompletionRecord*
-ResultTracker::FindCompletionRecordOrNullUnlocked(const RequestIdPB& request_id) {
-  return FindClientStateAndCompletionRecordOrNullUnlocked(request_id).second;
+ResultTracker::FindCompletionRecordOrNullUnlocked(Shard* shard, const RequestIdPB& request_id) {
+  return FindClientStateAndCompletionRecordOrNullUnlocked(shard, request_id).second;
 }
 
 void ResultTracker::RecordCompletionAndRespond(const RequestIdPB& request_id,
                                                const Message* response) {
-  lock_guard<simple_spinlock> l(lock_);
+  Shard* shard = ShardFor(request_id.client_id());
+  lock_guard<simple_spinlock> l(shard->lock);
 
-  CompletionRecord* completion_record = FindCompletionRecordOrDieUnlocked(request_id);
+  CompletionRecord* completion_record = FindCompletionRecordOrDieUnlocked(shard, request_id);
   ScopedMemTrackerUpdater<CompletionRecord> updater(mem_tracker_.get(), completion_record);
 
   CHECK_EQ(completion_record->driver_attempt_no, request_id.attempt_no())
     << "Called RecordCompletionAndRespond() from an executor identified with an attempt number that"
     << " was not marked as the driver for the RPC. RequestId: " << request_id.ShortDebugString()
-    << "\nTracker state:\n " << ToStringUnlocked();
+    << "\nTracker state:\n " << ToStringUnlocked(*shard);
   DCHECK_EQ(completion_record->state, RpcState::IN_PROGRESS);
-  completion_record->response.reset(DCHECK_NOTNULL(response)->New());
-  completion_record->response->CopyFrom(*response);
+  completion_record->response.clear();
+  CHECK(DCHECK_NOTNULL(response)->AppendPartialToString(&completion_record->response));
+  completion_record->response.shrink_to_fit();
   completion_record->state = RpcState::COMPLETED;
   completion_record->last_updated = MonoTime::Now();
 
@@ -324,7 +337,7 @@ void ResultTracker::RecordCompletionAndRespond(const RequestIdPB& request_id,
     if (MustHandleRpc(handler_attempt_no, completion_record, ongoing_rpc)) {
       if (ongoing_rpc.context != nullptr) {
         if (PREDICT_FALSE(ongoing_rpc.response != response)) {
-          ongoing_rpc.response->CopyFrom(*completion_record->response);
+          ongoing_rpc.response->CopyFrom(*response);
         }
         LogAndTraceAndRespondSuccess(ongoing_rpc.context, *ongoing_rpc.response);
       }
@@ -339,11 +352,12 @@ void ResultTracker::RecordCompletionAndRespond(const RequestIdPB& request_id,
 
 void ResultTracker::FailAndRespondInternal(const RequestIdPB& request_id,
                                            HandleOngoingRpcFunc func) {
-  lock_guard<simple_spinlock> l(lock_);
-  auto state_and_record = FindClientStateAndCompletionRecordOrNullUnlocked(request_id);
+  Shard* shard = ShardFor(request_id.client_id());
+  lock_guard<simple_spinlock> l(shard->lock);
+  auto state_and_record = FindClientStateAndCompletionRecordOrNullUnlocked(shard, request_id);
   if (PREDICT_FALSE(state_and_record.first == nullptr)) {
     LOG(FATAL) << "Couldn't find ClientState for request: " << request_id.ShortDebugString()
-        << ". \nTracker state:\n" << ToStringUnlocked();
+        << ". \nTracker state:\n" << ToStringUnlocked(*shard);
   }
 
   CompletionRecord* completion_record = state_and_record.second;
@@ -435,7 +449,6 @@ void ResultTracker::RunGCThread() {
 }
 
 void ResultTracker::GCResults() {
-  lock_guard<simple_spinlock> l(lock_);
   MonoTime now = MonoTime::Now();
   // Calculate the instants before which we'll start GCing ClientStates and CompletionRecords.
   MonoTime time_to_gc_clients_from = now;
@@ -444,11 +457,18 @@ void ResultTracker::GCResults() {
   MonoTime time_to_gc_responses_from = now;
   time_to_gc_responses_from.AddDelta(
       MonoDelta::FromMilliseconds(-FLAGS_remember_responses_ttl_ms));
+  for (auto& shard : shards_) {
+    GCShard(shard.get(), time_to_gc_clients_from, time_to_gc_responses_from);
+  }
+}
 
+void ResultTracker::GCShard(Shard* shard, MonoTime time_to_gc_clients_from,
+                            MonoTime time_to_gc_responses_from) {
+  lock_guard<simple_spinlock> l(shard->lock);
   // Now go through the ClientStates. If we haven't heard from a client in a while
   // GC it and all its completion records (making sure there isn't actually one in progress first).
   // If we've heard from a client recently, but some of its responses are old, GC those responses.
-  for (auto iter = clients_.begin(); iter != clients_.end();) {
+  for (auto iter = shard->clients.begin(); iter != shard->clients.end();) {
     auto& client_state = iter->second;
     if (client_state->last_heard_from.ComesBefore(time_to_gc_clients_from)) {
       // Client should be GCed.
@@ -468,7 +488,7 @@ void ResultTracker::GCResults() {
         continue;
       }
       mem_tracker_->Release(client_state->memory_footprint());
-      iter = clients_.erase(iter);
+      iter = shard->clients.erase(iter);
     } else {
       // Client can't be GCed, but its calls might be GCable.
       iter->second->GCCompletionRecords(
@@ -483,14 +503,20 @@ void ResultTracker::GCResults() {
 }
 
 string ResultTracker::ToString() {
-  lock_guard<simple_spinlock> l(lock_);
-  return ToStringUnlocked();
+  string result = Substitute("ResultTracker[this: $0, Shards:", this);
+  for (auto& shard : shards_) {
+    lock_guard<simple_spinlock> l(shard->lock);
+    result.append("\n");
+    result.append(ToStringUnlocked(*shard));
+  }
+  result.append("]");
+  return result;
 }
 
-string ResultTracker::ToStringUnlocked() const {
-  string result = Substitute("ResultTracker[this: $0, Num. Client States: $1, Client States:\n",
-                             this, clients_.size());
-  for (auto& cs : clients_) {
+string ResultTracker::ToStringUnlocked(const Shard& shard) const {
+  string result = Substitute("Shard[Num. Client States: $0, Client States:\n",
+                             shard.clients.size());
+  for (auto& cs : shard.clients) {
     SubstituteAndAppend(&result, Substitute("\n\tClient: $0, $1", cs.first, cs.second->ToString()));
   }
   result.append("]");
@@ -540,7 +566,8 @@ string ResultTracker::CompletionRecord::ToString() const {
                              "Cached response: $2, $3 OngoingRpcs:",
                              state,
                              driver_attempt_no,
-                             response ? response->ShortDebugString() : "None",
+                             state == RpcState::COMPLETED ?
+                                 Substitute("$0 bytes", response.size()) : "None",
                              ongoing_rpcs.size());
   for (auto& orpc : ongoing_rpcs) {
     SubstituteAndAppend(&result, Substitute("\n\t$0", orpc.ToString()));
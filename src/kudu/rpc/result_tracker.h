@@ -18,6 +18,7 @@
 
 #include <functional>
 #include <map>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -142,7 +143,8 @@ class RpcContext;
 //   }
 // }
 //
-// This class is thread safe.
+// This class is thread safe. The clients are spread over shards, each with its
+// own lock, so that concurrent RPCs from different clients rarely contend.
 class ResultTracker : public RefCountedThreadSafe<ResultTracker> {
  public:
   typedef rpc::RequestTracker::SequenceNumber SequenceNumber;
@@ -229,6 +231,8 @@ class ResultTracker : public RefCountedThreadSafe<ResultTracker> {
   void StartGCThread();
 
   // Runs time-based garbage collection on the results this result tracker is caching.
+  // The shards are collected one at a time, so RPCs are only ever blocked
+  // behind the collection of their own shard.
   // When garbage collection runs, it goes through all ClientStates and:
   // - If a ClientState is older than the 'remember_clients_ttl_ms' flag and no
   //   requests are in progress, GCs the ClientState and all its CompletionRecords.
@@ -269,8 +273,10 @@ class ResultTracker : public RefCountedThreadSafe<ResultTracker> {
     // The timestamp of the last CompletionRecord update.
     MonoTime last_updated;
 
-    // The cached response, if this RPC is in COMPLETED state.
-    std::unique_ptr<google::protobuf::Message> response;
+    // The cached response, serialized, if this RPC is in COMPLETED state.
+    // This is far more compact than a copy of the message, and is only
+    // parsed back for retries.
+    std::string response;
 
     // The set of ongoing RPCs that correspond to this record.
     std::vector<OnGoingRpcInfo> ongoing_rpcs;
@@ -281,7 +287,7 @@ class ResultTracker : public RefCountedThreadSafe<ResultTracker> {
     int64_t memory_footprint() const {
       return kudu_malloc_usable_size(this)
           + (ongoing_rpcs.capacity() > 0 ? kudu_malloc_usable_size(ongoing_rpcs.data()) : 0)
-          + (response.get() != nullptr ? response->SpaceUsed() : 0);
+          + response.capacity();
     }
   };
 
@@ -331,7 +337,34 @@ class ResultTracker : public RefCountedThreadSafe<ResultTracker> {
     }
   };
 
-  RpcState TrackRpcUnlocked(const RequestIdPB& request_id,
+  typedef MemTrackerAllocator<std::pair<const std::string,
+                                        std::unique_ptr<ClientState>>> ClientStateMapAllocator;
+  typedef std::map<std::string,
+                   std::unique_ptr<ClientState>,
+                   std::less<std::string>,
+                   ClientStateMapAllocator> ClientStateMap;
+
+  // A subset of the clients, by hash of their ID.
+  struct Shard {
+    explicit Shard(const std::shared_ptr<MemTracker>& mem_tracker)
+        : clients(ClientStateMap::key_compare(), ClientStateMapAllocator(mem_tracker)) {}
+
+    // Protects 'clients' and the state contained in each ClientState.
+    simple_spinlock lock;
+
+    ClientStateMap clients;
+
+    char padding[CACHELINE_SIZE];
+  };
+
+  static const int kNumShards = 16;
+
+  Shard* ShardFor(const std::string& client_id) {
+    return shards_[std::hash<std::string>()(client_id) % kNumShards].get();
+  }
+
+  RpcState TrackRpcUnlocked(Shard* shard,
+                            const RequestIdPB& request_id,
                             google::protobuf::Message* response,
                             RpcContext* context);
 
@@ -342,10 +375,12 @@ class ResultTracker : public RefCountedThreadSafe<ResultTracker> {
   void FailAndRespondInternal(const rpc::RequestIdPB& request_id,
                               HandleOngoingRpcFunc func);
 
-  CompletionRecord* FindCompletionRecordOrNullUnlocked(const RequestIdPB& request_id);
-  CompletionRecord* FindCompletionRecordOrDieUnlocked(const RequestIdPB& request_id);
+  CompletionRecord* FindCompletionRecordOrNullUnlocked(Shard* shard,
+                                                       const RequestIdPB& request_id);
+  CompletionRecord* FindCompletionRecordOrDieUnlocked(Shard* shard,
+                                                      const RequestIdPB& request_id);
   std::pair<ClientState*, CompletionRecord*> FindClientStateAndCompletionRecordOrNullUnlocked(
-      const RequestIdPB& request_id);
+      Shard* shard, const RequestIdPB& request_id);
 
   // A handler must handle an RPC attempt if:
   // 1 - It's its own attempt. I.e. it has the same attempt number of the handler.
@@ -367,26 +402,19 @@ class ResultTracker : public RefCountedThreadSafe<ResultTracker> {
   void LogAndTraceFailure(RpcContext* context, ErrorStatusPB_RpcErrorCodePB err,
                           const Status& status);
 
-  std::string ToStringUnlocked() const;
+  // Returns the state of the clients of 'shard'. Requires its lock.
+  std::string ToStringUnlocked(const Shard& shard) const;
+
+  // Runs GCResults() on 'shard'.
+  void GCShard(Shard* shard, MonoTime time_to_gc_clients_from,
+               MonoTime time_to_gc_responses_from);
 
   void RunGCThread();
 
   // The memory tracker that tracks this ResultTracker's memory consumption.
   std::shared_ptr<kudu::MemTracker> mem_tracker_;
 
-  // Lock that protects access to 'clients_' and to the state contained in each
-  // ClientState.
-  // TODO consider a per-ClientState lock if we find this too coarse grained.
-  simple_spinlock lock_;
-
-  typedef MemTrackerAllocator<std::pair<const std::string,
-                                        std::unique_ptr<ClientState>>> ClientStateMapAllocator;
-  typedef std::map<std::string,
-                   std::unique_ptr<ClientState>,
-                   std::less<std::string>,
-                   ClientStateMapAllocator> ClientStateMap;
-
-  ClientStateMap clients_;
+  std::unique_ptr<Shard> shards_[kNumShards];
 
   // The thread which runs GC, and a latch to stop it.
   scoped_refptr<Thread> gc_thread_;
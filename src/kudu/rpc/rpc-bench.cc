@@ -14,21 +14,32 @@
 // KIND, either express or implied.  See the License for the
 // specific language governing permissions and limitations
 // under the License.
-
+#include <algorithm>
 #include <functional>
 #include <gflags/gflags.h>
 #include <gtest/gtest.h>
 #include <memory>
+#include <sstream>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "kudu/gutil/atomicops.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/rpc-test-base.h"
+#include "kudu/rpc/rpc_sidecar.h"
 #include "kudu/rpc/rtest.proxy.h"
 #include "kudu/util/countdown_latch.h"
+#include "kudu/util/env.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/hdr_histogram.h"
+#include "kudu/util/jsonwriter.h"
 #include "kudu/util/test_util.h"
 
 using std::bind;
+using std::ostringstream;
 using std::shared_ptr;
 using std::string;
 using std::thread;
@@ -53,14 +64,33 @@ DEFINE_int32(server_reactors, 4,
 
 DEFINE_int32(run_seconds, 1, "Seconds to run the test");
 
+DEFINE_string(payload_sizes, "0",
+              "Comma-separated list of the sizes, in bytes, of the data echoed by "
+              "each call. The benchmarks run once for each combination of payload "
+              "and sidecar size.");
+
+DEFINE_string(sidecar_sizes, "0",
+              "Comma-separated list of the sizes, in bytes, of a sidecar attached to "
+              "each request. A size of 0 sends no sidecar.");
+
+DEFINE_string(output_file, "",
+              "If set, the results of each benchmark are written as a JSON array to "
+              "this path, suffixed with the name of the benchmark, for tracking "
+              "performance regressions.");
+
 namespace kudu {
 namespace rpc {
 
+// Calls taking longer than this are recorded as taking this long.
+static const int64_t kMaxLatencyMicros = 60 * 1000 * 1000;
+
 class RpcBench : public RpcTestBase {
  public:
   RpcBench()
       : should_run_(true),
-        stop_(0)
+        stop_(0),
+        sidecar_size_(0),
+        results_writer_(&results_, JsonWriter::PRETTY)
   {}
 
   void SetUp() override {
@@ -71,9 +101,62 @@ class RpcBench : public RpcTestBase {
 
     // Set up server.
     StartTestServerWithGeneratedCode(&server_addr_);
+    results_writer_.StartArray();
+  }
+
+  void TearDown() override {
+    results_writer_.EndArray();
+    if (!FLAGS_output_file.empty()) {
+      string path = FLAGS_output_file + "." +
+          ::testing::UnitTest::GetInstance()->current_test_info()->name();
+      CHECK_OK(WriteStringToFile(env_.get(), results_.str(), path));
+      LOG(INFO) << "Wrote results to " << path;
+    }
+    RpcTestBase::TearDown();
+  }
+
+  // Return the list of sizes in 'sizes_str'.
+  static vector<int64_t> ParseSizes(const string& sizes_str) {
+    vector<int64_t> sizes;
+    vector<string> fields = strings::Split(sizes_str, ",", strings::SkipEmpty());
+    for (const string& field : fields) {
+      int64_t size;
+      CHECK(safe_strto64(field, &size) && size >= 0) << "Invalid size: " << field;
+      sizes.push_back(size);
+    }
+    return sizes;
   }
 
-  void SummarizePerf(CpuTimes elapsed, int total_reqs, bool sync) {
+  // Prepare for a run with the given payload and sidecar sizes.
+  void StartRun(int64_t payload_size, int64_t sidecar_size) {
+    payload_.assign(payload_size, 'x');
+    sidecar_size_ = sidecar_size;
+    latency_hist_.reset(new HdrHistogram(kMaxLatencyMicros, 3));
+    Release_Store(&should_run_, true);
+  }
+
+  // Attach a sidecar of the size of the current run to 'controller'.
+  void AddSidecar(RpcController* controller) {
+    if (sidecar_size_ == 0) {
+      return;
+    }
+    gscoped_ptr<faststring> data(new faststring(sidecar_size_));
+    data->resize(sidecar_size_);
+    int idx;
+    CHECK_OK(controller->AddOutboundSidecar(
+        make_gscoped_ptr(new RpcSidecar(std::move(data))), &idx));
+  }
+
+  void RecordLatency(const MonoTime& start) {
+    latency_hist_->Increment(
+        std::min(kMaxLatencyMicros, (MonoTime::Now() - start).ToMicroseconds()));
+  }
+
+  // Log the results of a run, and add them to the results written to
+  // --output_file. 'client_cpu' is the CPU time used by the client threads
+  // issuing the calls, if measured.
+  void SummarizePerf(CpuTimes elapsed, int total_reqs, bool sync,
+                     const CpuTimes* client_cpu) {
     float reqs_per_second = static_cast<float>(total_reqs / elapsed.wall_seconds());
     float user_cpu_micros_per_req = static_cast<float>(elapsed.user / 1000.0 / total_reqs);
     float sys_cpu_micros_per_req = static_cast<float>(elapsed.system / 1000.0 / total_reqs);
@@ -89,12 +172,62 @@ class RpcBench : public RpcTestBase {
 
     LOG(INFO) << "Worker threads:   " << FLAGS_worker_threads;
     LOG(INFO) << "Server reactors:  " << FLAGS_server_reactors;
+    LOG(INFO) << "Payload size:     " << payload_.size();
+    LOG(INFO) << "Sidecar size:     " << sidecar_size_;
     LOG(INFO) << "----------------------------------";
     LOG(INFO) << "Reqs/sec:         " << reqs_per_second;
     LOG(INFO) << "User CPU per req: " << user_cpu_micros_per_req << "us";
     LOG(INFO) << "Sys CPU per req:  " << sys_cpu_micros_per_req << "us";
     LOG(INFO) << "Ctx Sw. per req:  " << csw_per_req;
-
+    float client_cpu_micros_per_req = 0;
+    if (client_cpu) {
+      client_cpu_micros_per_req = static_cast<float>(
+          (client_cpu->user + client_cpu->system) / 1000.0 / total_reqs);
+      LOG(INFO) << "Client thread CPU per req: " << client_cpu_micros_per_req << "us";
+    }
+    LOG(INFO) << "Latency p50:      " << latency_hist_->ValueAtPercentile(50) << "us";
+    LOG(INFO) << "Latency p99:      " << latency_hist_->ValueAtPercentile(99) << "us";
+    LOG(INFO) << "Latency p99.9:    " << latency_hist_->ValueAtPercentile(99.9) << "us";
+    LOG(INFO) << "Latency max:      " << latency_hist_->MaxValue() << "us";
+
+    results_writer_.StartObject();
+    results_writer_.String("mode");
+    results_writer_.String(sync ? "sync" : "async");
+    results_writer_.String("client_threads");
+    results_writer_.Int(FLAGS_client_threads);
+    if (!sync) {
+      results_writer_.String("async_call_concurrency");
+      results_writer_.Int(FLAGS_async_call_concurrency);
+    }
+    results_writer_.String("worker_threads");
+    results_writer_.Int(FLAGS_worker_threads);
+    results_writer_.String("server_reactors");
+    results_writer_.Int(FLAGS_server_reactors);
+    results_writer_.String("payload_bytes");
+    results_writer_.Int64(payload_.size());
+    results_writer_.String("sidecar_bytes");
+    results_writer_.Int64(sidecar_size_);
+    results_writer_.String("reqs_per_sec");
+    results_writer_.Double(reqs_per_second);
+    results_writer_.String("user_cpu_us_per_req");
+    results_writer_.Double(user_cpu_micros_per_req);
+    results_writer_.String("sys_cpu_us_per_req");
+    results_writer_.Double(sys_cpu_micros_per_req);
+    results_writer_.String("ctx_switches_per_req");
+    results_writer_.Double(csw_per_req);
+    if (client_cpu) {
+      results_writer_.String("client_thread_cpu_us_per_req");
+      results_writer_.Double(client_cpu_micros_per_req);
+    }
+    results_writer_.String("latency_us_p50");
+    results_writer_.Uint64(latency_hist_->ValueAtPercentile(50));
+    results_writer_.String("latency_us_p99");
+    results_writer_.Uint64(latency_hist_->ValueAtPercentile(99));
+    results_writer_.String("latency_us_p999");
+    results_writer_.Uint64(latency_hist_->ValueAtPercentile(99.9));
+    results_writer_.String("latency_us_max");
+    results_writer_.Uint64(latency_hist_->MaxValue());
+    results_writer_.EndObject();
   }
 
  protected:
@@ -104,6 +237,18 @@ class RpcBench : public RpcTestBase {
   Sockaddr server_addr_;
   Atomic32 should_run_;
   CountDownLatch stop_;
+
+  // The data echoed by the calls of the current run.
+  string payload_;
+
+  // The size of the sidecar sent with the calls of the current run.
+  int64_t sidecar_size_;
+
+  // The latencies, in microseconds, of the calls of the current run.
+  unique_ptr<HdrHistogram> latency_hist_;
+
+  ostringstream results_;
+  JsonWriter results_writer_;
 };
 
 class ClientThread {
@@ -126,48 +271,66 @@ class ClientThread {
 
     CalculatorServiceProxy p(client_messenger, bench_->server_addr_);
 
-    AddRequestPB req;
-    AddResponsePB resp;
+    EchoRequestPB req;
+    req.set_data(bench_->payload_);
+    EchoResponsePB resp;
+    Stopwatch sw(Stopwatch::THIS_THREAD);
+    sw.start();
     while (Acquire_Load(&bench_->should_run_)) {
-      req.set_x(request_count_);
-      req.set_y(request_count_);
       RpcController controller;
       controller.set_timeout(MonoDelta::FromSeconds(10));
-      CHECK_OK(p.Add(req, &resp, &controller));
-      CHECK_EQ(req.x() + req.y(), resp.result());
+      bench_->AddSidecar(&controller);
+      MonoTime start = MonoTime::Now();
+      CHECK_OK(p.Echo(req, &resp, &controller));
+      bench_->RecordLatency(start);
+      CHECK_EQ(req.data().size(), resp.data().size());
       request_count_++;
     }
+    sw.stop();
+    cpu_ = sw.elapsed();
   }
 
   unique_ptr<thread> thread_;
   RpcBench *bench_;
   int request_count_;
+
+  // The CPU time used by this thread.
+  CpuTimes cpu_;
 };
 
 
 // Test making successful RPC calls.
 TEST_F(RpcBench, BenchmarkCalls) {
-  Stopwatch sw(Stopwatch::ALL_THREADS);
-  sw.start();
-
-  vector<unique_ptr<ClientThread>> threads;
-  for (int i = 0; i < FLAGS_client_threads; i++) {
-    threads.emplace_back(new ClientThread(this));
-    threads.back()->Start();
-  }
-
-  SleepFor(MonoDelta::FromSeconds(FLAGS_run_seconds));
-  Release_Store(&should_run_, false);
-
-  int total_reqs = 0;
-
-  for (auto& thr : threads) {
-    thr->Join();
-    total_reqs += thr->request_count_;
+  for (int64_t payload_size : ParseSizes(FLAGS_payload_sizes)) {
+    for (int64_t sidecar_size : ParseSizes(FLAGS_sidecar_sizes)) {
+      StartRun(payload_size, sidecar_size);
+      Stopwatch sw(Stopwatch::ALL_THREADS);
+      sw.start();
+
+      vector<unique_ptr<ClientThread>> threads;
+      for (int i = 0; i < FLAGS_client_threads; i++) {
+        threads.emplace_back(new ClientThread(this));
+        threads.back()->Start();
+      }
+
+      SleepFor(MonoDelta::FromSeconds(FLAGS_run_seconds));
+      Release_Store(&should_run_, false);
+
+      int total_reqs = 0;
+      CpuTimes client_cpu;
+      client_cpu.clear();
+
+      for (auto& thr : threads) {
+        thr->Join();
+        total_reqs += thr->request_count_;
+        client_cpu.user += thr->cpu_.user;
+        client_cpu.system += thr->cpu_.system;
+      }
+      sw.stop();
+
+      SummarizePerf(sw.elapsed(), total_reqs, true, &client_cpu);
+    }
   }
-  sw.stop();
-
-  SummarizePerf(sw.elapsed(), total_reqs, true);
 }
 
 class ClientAsyncWorkload {
@@ -178,25 +341,27 @@ class ClientAsyncWorkload {
       request_count_(0) {
     controller_.set_timeout(MonoDelta::FromSeconds(10));
     proxy_.reset(new CalculatorServiceProxy(messenger_, bench_->server_addr_));
+    req_.set_data(bench_->payload_);
   }
 
   void CallOneRpc() {
     if (request_count_ > 0) {
+      bench_->RecordLatency(start_);
       CHECK_OK(controller_.status());
-      CHECK_EQ(req_.x() + req_.y(), resp_.result());
+      CHECK_EQ(req_.data().size(), resp_.data().size());
     }
     if (!Acquire_Load(&bench_->should_run_)) {
       bench_->stop_.CountDown();
       return;
     }
     controller_.Reset();
-    req_.set_x(request_count_);
-    req_.set_y(request_count_);
+    bench_->AddSidecar(&controller_);
     request_count_++;
-    proxy_->AddAsync(req_,
-                     &resp_,
-                     &controller_,
-                     bind(&ClientAsyncWorkload::CallOneRpc, this));
+    start_ = MonoTime::Now();
+    proxy_->EchoAsync(req_,
+                      &resp_,
+                      &controller_,
+                      bind(&ClientAsyncWorkload::CallOneRpc, this));
   }
 
   void Start() {
@@ -208,8 +373,9 @@ class ClientAsyncWorkload {
   unique_ptr<CalculatorServiceProxy> proxy_;
   uint32_t request_count_;
   RpcController controller_;
-  AddRequestPB req_;
-  AddResponsePB resp_;
+  EchoRequestPB req_;
+  EchoResponsePB resp_;
+  MonoTime start_;
 };
 
 TEST_F(RpcBench, BenchmarkCallsAsync) {
@@ -221,35 +387,39 @@ TEST_F(RpcBench, BenchmarkCallsAsync) {
     messengers.push_back(CreateMessenger("Client"));
   }
 
-  vector<unique_ptr<ClientAsyncWorkload>> workloads;
-  for (int i = 0; i < concurrency; i++) {
-    workloads.emplace_back(
-        new ClientAsyncWorkload(this, messengers[i % threads]));
-  }
+  for (int64_t payload_size : ParseSizes(FLAGS_payload_sizes)) {
+    for (int64_t sidecar_size : ParseSizes(FLAGS_sidecar_sizes)) {
+      StartRun(payload_size, sidecar_size);
+      vector<unique_ptr<ClientAsyncWorkload>> workloads;
+      for (int i = 0; i < concurrency; i++) {
+        workloads.emplace_back(
+            new ClientAsyncWorkload(this, messengers[i % threads]));
+      }
 
-  stop_.Reset(concurrency);
+      stop_.Reset(concurrency);
 
-  Stopwatch sw(Stopwatch::ALL_THREADS);
-  sw.start();
+      Stopwatch sw(Stopwatch::ALL_THREADS);
+      sw.start();
 
-  for (int i = 0; i < concurrency; i++) {
-    workloads[i]->Start();
-  }
+      for (int i = 0; i < concurrency; i++) {
+        workloads[i]->Start();
+      }
 
-  SleepFor(MonoDelta::FromSeconds(FLAGS_run_seconds));
-  Release_Store(&should_run_, false);
+      SleepFor(MonoDelta::FromSeconds(FLAGS_run_seconds));
+      Release_Store(&should_run_, false);
 
-  sw.stop();
+      sw.stop();
 
-  stop_.Wait();
-  int total_reqs = 0;
-  for (int i = 0; i < concurrency; i++) {
-    total_reqs += workloads[i]->request_count_;
-  }
+      stop_.Wait();
+      int total_reqs = 0;
+      for (int i = 0; i < concurrency; i++) {
+        total_reqs += workloads[i]->request_count_;
+      }
 
-  SummarizePerf(sw.elapsed(), total_reqs, false);
+      SummarizePerf(sw.elapsed(), total_reqs, false, nullptr);
+    }
+  }
 }
 
 } // namespace rpc
 } // namespace kudu
-
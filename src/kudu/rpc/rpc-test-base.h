@@ -61,6 +61,8 @@ using kudu::rpc_test::ExactlyOnceResponsePB;
 using kudu::rpc_test::FeatureFlags;
 using kudu::rpc_test::PanicRequestPB;
 using kudu::rpc_test::PanicResponsePB;
+using kudu::rpc_test::PushTwoStringsRequestPB;
+using kudu::rpc_test::PushTwoStringsResponsePB;
 using kudu::rpc_test::SendTwoStringsRequestPB;
 using kudu::rpc_test::SendTwoStringsResponsePB;
 using kudu::rpc_test::SleepRequestPB;
@@ -80,6 +82,7 @@ class GenericCalculatorService : public ServiceIf {
   static const char *kAddMethodName;
   static const char *kSleepMethodName;
   static const char *kSendTwoStringsMethodName;
+  static const char *kPushTwoStringsMethodName;
   static const char *kAddExactlyOnce;
 
   static const char* kFirstString;
@@ -101,6 +104,8 @@ class GenericCalculatorService : public ServiceIf {
       DoSleep(incoming);
     } else if (incoming->remote_method().method_name() == kSendTwoStringsMethodName) {
       DoSendTwoStrings(incoming);
+    } else if (incoming->remote_method().method_name() == kPushTwoStringsMethodName) {
+      DoPushTwoStrings(incoming);
     } else {
       incoming->RespondFailure(ErrorStatusPB::ERROR_NO_SUCH_METHOD,
                                Status::InvalidArgument("bad method"));
@@ -152,6 +157,23 @@ class GenericCalculatorService : public ServiceIf {
     incoming->RespondSuccess(resp);
   }
 
+  void DoPushTwoStrings(InboundCall* incoming) {
+    Slice param(incoming->serialized_request());
+    PushTwoStringsRequestPB req;
+    if (!req.ParseFromArray(param.data(), param.size())) {
+      LOG(FATAL) << "couldn't parse: " << param.ToDebugString();
+    }
+
+    Slice first, second;
+    CHECK_OK(incoming->GetInboundSidecar(req.sidecar1(), &first));
+    CHECK_OK(incoming->GetInboundSidecar(req.sidecar2(), &second));
+
+    PushTwoStringsResponsePB resp;
+    resp.set_data1(first.data(), first.size());
+    resp.set_data2(second.data(), second.size());
+    incoming->RespondSuccess(resp);
+  }
+
   void DoSleep(InboundCall *incoming) {
     Slice param(incoming->serialized_request());
     SleepRequestPB req;
@@ -163,7 +185,14 @@ class GenericCalculatorService : public ServiceIf {
     }
 
     LOG(INFO) << "got call: " << req.ShortDebugString();
-    SleepFor(MonoDelta::FromMicroseconds(req.sleep_micros()));
+    if (req.stop_when_abandoned()) {
+      MonoTime deadline = MonoTime::Now() + MonoDelta::FromMicroseconds(req.sleep_micros());
+      while (MonoTime::Now() < deadline && !incoming->ClientAbandoned()) {
+        SleepFor(MonoDelta::FromMilliseconds(10));
+      }
+    } else {
+      SleepFor(MonoDelta::FromMicroseconds(req.sleep_micros()));
+    }
     SleepResponsePB resp;
     incoming->RespondSuccess(resp);
   }
@@ -304,6 +333,7 @@ const char *GenericCalculatorService::kFullServiceName = "kudu.rpc.GenericCalcul
 const char *GenericCalculatorService::kAddMethodName = "Add";
 const char *GenericCalculatorService::kSleepMethodName = "Sleep";
 const char *GenericCalculatorService::kSendTwoStringsMethodName = "SendTwoStrings";
+const char *GenericCalculatorService::kPushTwoStringsMethodName = "PushTwoStrings";
 const char *GenericCalculatorService::kAddExactlyOnce = "AddExactlyOnce";
 
 const char *GenericCalculatorService::kFirstString =
@@ -393,6 +423,35 @@ class RpcTestBase : public KuduTest {
     CHECK_EQ(0, second.compare(Slice(expected)));
   }
 
+  void DoTestOutgoingSidecar(const Proxy &p, int size1, int size2) {
+    Random rng(12345);
+    gscoped_ptr<faststring> first(new faststring);
+    first->resize(size1);
+    RandomString(first->data(), size1, &rng);
+    gscoped_ptr<faststring> second(new faststring);
+    second->resize(size2);
+    RandomString(second->data(), size2, &rng);
+    std::string expected1 = first->ToString();
+    std::string expected2 = second->ToString();
+
+    PushTwoStringsRequestPB req;
+    RpcController controller;
+    controller.set_timeout(MonoDelta::FromMilliseconds(10000));
+    int idx1, idx2;
+    CHECK_OK(controller.AddOutboundSidecar(
+        make_gscoped_ptr(new RpcSidecar(std::move(first))), &idx1));
+    CHECK_OK(controller.AddOutboundSidecar(
+        make_gscoped_ptr(new RpcSidecar(std::move(second))), &idx2));
+    req.set_sidecar1(idx1);
+    req.set_sidecar2(idx2);
+
+    PushTwoStringsResponsePB resp;
+    CHECK_OK(p.SyncRequest(GenericCalculatorService::kPushTwoStringsMethodName,
+                           req, &resp, &controller));
+    CHECK_EQ(expected1, resp.data1());
+    CHECK_EQ(expected2, resp.data2());
+  }
+
   void DoTestExpectTimeout(const Proxy &p, const MonoDelta &timeout) {
     SleepRequestPB req;
     SleepResponsePB resp;
@@ -29,6 +29,7 @@
 #include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/constants.h"
+#include "kudu/rpc/rpc_introspection.pb.h"
 #include "kudu/rpc/serialization.h"
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/env.h"
@@ -38,7 +39,12 @@
 METRIC_DECLARE_histogram(handler_latency_kudu_rpc_test_CalculatorService_Sleep);
 METRIC_DECLARE_histogram(rpc_incoming_queue_time);
 
+DECLARE_bool(rpc_acceptor_reuseport);
+DECLARE_bool(rpc_compress_payloads);
+DECLARE_int32(rpc_compression_min_bytes);
 DECLARE_int32(rpc_negotiation_inject_delay_ms);
+DECLARE_int32(rpc_max_write_iovecs);
+DECLARE_int32(rpc_num_connections_per_server);
 
 using std::shared_ptr;
 using std::string;
@@ -291,6 +297,128 @@ TEST_F(TestRpc, TestRpcSidecar) {
   DoTestSidecar(p, 3000 * 1024, 2000 * 1024);
 }
 
+// Test that many pending transfers are written correctly when they are
+// coalesced into fewer writev() calls than transfers, including when a
+// transfer needs more buffers than a single writev() is allowed.
+TEST_F(TestRpc, TestCoalescedWrites) {
+  FLAGS_rpc_max_write_iovecs = 3;
+  n_server_reactor_threads_ = 1;
+
+  // Set up server.
+  Sockaddr server_addr;
+  StartTestServer(&server_addr);
+
+  // Set up client.
+  shared_ptr<Messenger> client_messenger(CreateMessenger("Client"));
+  Proxy p(client_messenger, server_addr, GenericCalculatorService::static_service_name());
+
+  // Responses with two sidecars are made of more buffers than fit in a
+  // single writev().
+  DoTestSidecar(p, 123, 456);
+
+  // Queue many small calls at once so that they are pending together.
+  const int n_calls = 100;
+  AddRequestPB req;
+  req.set_x(1);
+  req.set_y(2);
+  vector<unique_ptr<RpcController>> controllers;
+  vector<unique_ptr<AddResponsePB>> responses;
+  CountDownLatch latch(n_calls);
+  for (int i = 0; i < n_calls; i++) {
+    controllers.emplace_back(new RpcController());
+    responses.emplace_back(new AddResponsePB());
+    p.AsyncRequest(GenericCalculatorService::kAddMethodName, req, responses.back().get(),
+                   controllers.back().get(),
+                   boost::bind(&CountDownLatch::CountDown, boost::ref(latch)));
+  }
+  latch.Wait();
+  for (int i = 0; i < n_calls; i++) {
+    ASSERT_OK(controllers[i]->status());
+    ASSERT_EQ(3, responses[i]->result());
+  }
+
+  ReactorMetrics metrics;
+  ASSERT_OK(client_messenger->reactors_[0]->GetMetrics(&metrics));
+  LOG(INFO) << "Client sent " << metrics.num_transfers_sent_ << " transfers in "
+            << metrics.num_write_syscalls_ << " writes";
+  ASSERT_GE(metrics.num_transfers_sent_, n_calls + 1);
+  ASSERT_OK(server_messenger_->reactors_[0]->GetMetrics(&metrics));
+  LOG(INFO) << "Server sent " << metrics.num_transfers_sent_ << " transfers in "
+            << metrics.num_write_syscalls_ << " writes";
+  ASSERT_GE(metrics.num_transfers_sent_, n_calls + 1);
+}
+
+// Test that the client can send sidecars along with a request.
+TEST_F(TestRpc, TestRpcOutgoingSidecar) {
+  Sockaddr server_addr;
+  StartTestServer(&server_addr);
+
+  shared_ptr<Messenger> client_messenger(CreateMessenger("Client"));
+  Proxy p(client_messenger, server_addr, GenericCalculatorService::static_service_name());
+
+  DoTestOutgoingSidecar(p, 0, 0);
+  DoTestOutgoingSidecar(p, 123, 456);
+  DoTestOutgoingSidecar(p, 3000 * 1024, 2000 * 1024);
+
+  // The header and the request take two of the payload slices.
+  RpcController controller;
+  int idx;
+  for (int i = 0; i < OutboundTransfer::kMaxPayloadSlices - 2; i++) {
+    ASSERT_OK(controller.AddOutboundSidecar(
+        make_gscoped_ptr(new RpcSidecar(make_gscoped_ptr(new faststring))), &idx));
+  }
+  Status s = controller.AddOutboundSidecar(
+      make_gscoped_ptr(new RpcSidecar(make_gscoped_ptr(new faststring))), &idx);
+  ASSERT_TRUE(s.IsServiceUnavailable()) << s.ToString();
+}
+
+// Test that large, compressible requests, sidecars and responses are
+// compressed on the wire once the connection is negotiated, and arrive intact.
+TEST_F(TestRpc, TestCompressedPayloads) {
+  FLAGS_rpc_compress_payloads = true;
+  FLAGS_rpc_compression_min_bytes = 1024;
+
+  Sockaddr server_addr;
+  StartTestServer(&server_addr);
+  shared_ptr<Messenger> client_messenger(CreateMessenger("Client"));
+  Proxy p(client_messenger, server_addr, GenericCalculatorService::static_service_name());
+
+  // Calls sent before negotiation completes aren't compressed.
+  ASSERT_OK(DoTestSyncCall(p, GenericCalculatorService::kAddMethodName));
+
+  // The second sidecar is too small to be compressed. The response, which
+  // echoes both sidecars, is compressed as a whole.
+  const string kData1(256 * 1024, 'a');
+  const string kData2(100, 'b');
+  RpcController controller;
+  int idx1, idx2;
+  gscoped_ptr<faststring> first(new faststring);
+  first->append(kData1);
+  gscoped_ptr<faststring> second(new faststring);
+  second->append(kData2);
+  ASSERT_OK(controller.AddOutboundSidecar(
+      make_gscoped_ptr(new RpcSidecar(std::move(first))), &idx1));
+  ASSERT_OK(controller.AddOutboundSidecar(
+      make_gscoped_ptr(new RpcSidecar(std::move(second))), &idx2));
+  PushTwoStringsRequestPB req;
+  req.set_sidecar1(idx1);
+  req.set_sidecar2(idx2);
+  PushTwoStringsResponsePB resp;
+  ASSERT_OK(p.SyncRequest(GenericCalculatorService::kPushTwoStringsMethodName,
+                          req, &resp, &controller));
+  ASSERT_EQ(kData1, resp.data1());
+  ASSERT_EQ(kData2, resp.data2());
+
+  DumpRunningRpcsRequestPB dump_req;
+  DumpRunningRpcsResponsePB dump_resp;
+  ASSERT_OK(client_messenger->DumpRunningRpcs(dump_req, &dump_resp));
+  ASSERT_EQ(1, dump_resp.outbound_connections_size());
+  const RpcConnectionPB& conn = dump_resp.outbound_connections(0);
+  // At least the first sidecar and the response were compressed.
+  ASSERT_GE(conn.uncompressed_payload_bytes(), 2 * kData1.size());
+  ASSERT_LT(conn.compressed_payload_bytes(), conn.uncompressed_payload_bytes() / 10);
+}
+
 // Test that timeouts are properly handled.
 TEST_F(TestRpc, TestCallTimeout) {
   Sockaddr server_addr;
@@ -336,6 +464,31 @@ TEST_F(TestRpc, TestCallTimeoutDoesntAffectNegotiation) {
   ASSERT_EQ(1, down_cast<Histogram*>(metric)->TotalCount());
 }
 
+// Test that a handler which checks for abandoned calls stops working once the
+// client times out, rather than holding a service thread for its full duration.
+TEST_F(TestRpc, TestServerStopsAbandonedCalls) {
+  n_worker_threads_ = 1;
+  Sockaddr server_addr;
+  StartTestServer(&server_addr);
+  shared_ptr<Messenger> client_messenger(CreateMessenger("Client"));
+  Proxy p(client_messenger, server_addr, GenericCalculatorService::static_service_name());
+
+  SleepRequestPB req;
+  req.set_sleep_micros(10 * 1000 * 1000);
+  req.set_stop_when_abandoned(true);
+  SleepResponsePB resp;
+  RpcController c;
+  c.set_timeout(MonoDelta::FromMilliseconds(100));
+  Status s = p.SyncRequest(GenericCalculatorService::kSleepMethodName, req, &resp, &c);
+  ASSERT_TRUE(s.IsTimedOut()) << s.ToString();
+
+  // The only service thread must become free well before the sleep would have
+  // finished.
+  MonoTime start = MonoTime::Now();
+  ASSERT_OK(DoTestSyncCall(p, GenericCalculatorService::kAddMethodName));
+  ASSERT_LT((MonoTime::Now() - start).ToSeconds(), 5);
+}
+
 static void AcceptAndReadForever(Socket* listen_sock) {
   // Accept the TCP connection.
   Socket server_sock;
@@ -456,6 +609,79 @@ TEST_F(TestRpc, TestServerShutsDown) {
   }
 }
 
+// Test that a server listening on one SO_REUSEPORT socket per reactor
+// accepts connections from many clients.
+TEST_F(TestRpc, TestReusePortAcceptors) {
+  FLAGS_rpc_acceptor_reuseport = true;
+
+  // Set up server.
+  Sockaddr server_addr;
+  StartTestServer(&server_addr);
+
+  // Each client messenger opens its own connection, which the kernel assigns
+  // to one of the listening sockets. The messengers are kept alive so that
+  // their connections stay open.
+  vector<shared_ptr<Messenger>> client_messengers;
+  for (int i = 0; i < 10; i++) {
+    client_messengers.push_back(CreateMessenger(strings::Substitute("Client$0", i)));
+    Proxy p(client_messengers.back(), server_addr,
+            GenericCalculatorService::static_service_name());
+    ASSERT_OK(DoTestSyncCall(p, GenericCalculatorService::kAddMethodName));
+  }
+
+  int num_server_connections = 0;
+  for (Reactor* reactor : server_messenger_->reactors_) {
+    ReactorMetrics metrics;
+    ASSERT_OK(reactor->GetMetrics(&metrics));
+    num_server_connections += metrics.num_server_connections_;
+  }
+  ASSERT_EQ(10, num_server_connections);
+}
+
+// Test that concurrent calls to one server are spread among several
+// connections when the messenger is configured to open more than one.
+TEST_F(TestRpc, TestMultipleConnectionsPerServer) {
+  FLAGS_rpc_num_connections_per_server = 4;
+
+  // Set up server.
+  Sockaddr server_addr;
+  StartTestServer(&server_addr);
+
+  // Set up client.
+  shared_ptr<Messenger> client_messenger(CreateMessenger("Client", 2));
+  Proxy p(client_messenger, server_addr, GenericCalculatorService::static_service_name());
+
+  // Send calls which are all pending at the same time, so that each should be
+  // assigned to a different connection.
+  SleepRequestPB req;
+  req.set_sleep_micros(100 * 1000);
+  req.set_deferred(true);
+  const int n_calls = 4;
+  vector<unique_ptr<RpcController>> controllers;
+  vector<unique_ptr<SleepResponsePB>> responses;
+  CountDownLatch latch(n_calls);
+  for (int i = 0; i < n_calls; i++) {
+    controllers.emplace_back(new RpcController());
+    responses.emplace_back(new SleepResponsePB());
+    p.AsyncRequest(GenericCalculatorService::kSleepMethodName, req, responses.back().get(),
+                   controllers.back().get(),
+                   boost::bind(&CountDownLatch::CountDown, boost::ref(latch)));
+  }
+  latch.Wait();
+  for (const auto& controller : controllers) {
+    ASSERT_OK(controller->status());
+  }
+
+  // The connections outlive the calls until the keepalive expires.
+  int num_client_connections = 0;
+  for (Reactor* reactor : client_messenger->reactors_) {
+    ReactorMetrics metrics;
+    ASSERT_OK(reactor->GetMetrics(&metrics));
+    num_client_connections += metrics.num_client_connections_;
+  }
+  ASSERT_EQ(n_calls, num_client_connections);
+}
+
 // Test handler latency metric.
 TEST_F(TestRpc, TestRpcHandlerLatencyMetric) {
 
@@ -42,7 +42,8 @@ RpcContext::RpcContext(InboundCall *call,
   : call_(CHECK_NOTNULL(call)),
     request_pb_(request_pb),
     response_pb_(response_pb),
-    result_tracker_(result_tracker) {
+    result_tracker_(result_tracker),
+    request_bytes_(0) {
   VLOG(4) << call_->remote_method().service_name() << ": Received RPC request for "
           << call_->ToString() << ":" << std::endl << request_pb_->DebugString();
   TRACE_EVENT_ASYNC_BEGIN2("rpc_call", "RPC", this,
@@ -51,6 +52,15 @@ RpcContext::RpcContext(InboundCall *call,
 }
 
 RpcContext::~RpcContext() {
+  if (message_owner_) {
+    message_owner_->RecycleMessages(request_pb_.release(), response_pb_.release(),
+                                    request_bytes_);
+  }
+}
+
+void RpcContext::set_message_owner(RpcMethodInfo* owner) {
+  message_owner_ = owner;
+  request_bytes_ = call_->serialized_request().size();
 }
 
 void RpcContext::RespondSuccess() {
@@ -144,6 +154,10 @@ Status RpcContext::AddRpcSidecar(gscoped_ptr<RpcSidecar> car, int* idx) {
   return call_->AddRpcSidecar(std::move(car), idx);
 }
 
+Status RpcContext::GetInboundSidecar(int idx, Slice* sidecar) const {
+  return call_->GetInboundSidecar(idx, sidecar);
+}
+
 const UserCredentials& RpcContext::user_credentials() const {
   return call_->user_credentials();
 }
@@ -161,6 +175,22 @@ MonoTime RpcContext::GetClientDeadline() const {
   return call_->GetClientDeadline();
 }
 
+MonoTime RpcContext::GetTimeReceived() const {
+  return call_->GetTimeReceived();
+}
+
+MonoDelta RpcContext::GetTimeRemaining() const {
+  MonoTime deadline = call_->GetClientDeadline();
+  if (deadline == MonoTime::Max()) {
+    return MonoDelta();
+  }
+  return deadline - MonoTime::Now();
+}
+
+bool RpcContext::ClientAbandoned() const {
+  return call_->ClientAbandoned();
+}
+
 Trace* RpcContext::trace() {
   return call_->trace();
 }
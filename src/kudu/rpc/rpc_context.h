@@ -32,6 +32,7 @@ class Message;
 
 namespace kudu {
 
+class Slice;
 class Sockaddr;
 class Trace;
 
@@ -69,6 +70,10 @@ class RpcContext {
 
   ~RpcContext();
 
+  // Give the request and response back to 'owner' when the context is
+  // destroyed, rather than deleting them. Called only from generated code.
+  void set_message_owner(RpcMethodInfo* owner);
+
   // Return the trace buffer for this call.
   Trace* trace();
 
@@ -156,6 +161,13 @@ class RpcContext {
   // by the RPC response.
   Status AddRpcSidecar(gscoped_ptr<RpcSidecar> car, int* idx);
 
+  // Fetches the sidecar with index 'idx' that the client attached to the
+  // request (see RpcController::AddOutboundSidecar()), pointing 'sidecar'
+  // at its data. The data is only valid for the lifetime of this RpcContext.
+  //
+  // May fail if 'idx' does not reference a valid sidecar.
+  Status GetInboundSidecar(int idx, Slice* sidecar) const;
+
   // Return the credentials of the remote user who made this call.
   const UserCredentials& user_credentials() const;
 
@@ -174,6 +186,19 @@ class RpcContext {
   // If the client did not specify a deadline, returns MonoTime::Max().
   MonoTime GetClientDeadline() const;
 
+  // Return the time left until the client deadline, which is negative if the
+  // deadline passed. If the client did not specify a deadline, returns an
+  // uninitialized MonoDelta.
+  MonoDelta GetTimeRemaining() const;
+
+  // Return the time at which the call was received.
+  MonoTime GetTimeReceived() const;
+
+  // Return true if the client can no longer receive the response, because
+  // its deadline passed or its connection was closed. Long-running handlers
+  // should check this periodically and stop working on abandoned calls.
+  bool ClientAbandoned() const;
+
   // Whether the results of this RPC are tracked with a ResultTracker.
   // If this returns true, both result_tracker() and request_id() should return non-null results.
   bool AreResultsTracked() const { return result_tracker_.get() != nullptr; }
@@ -197,9 +222,14 @@ class RpcContext {
  private:
   friend class ResultTracker;
   InboundCall* const call_;
-  const gscoped_ptr<const google::protobuf::Message> request_pb_;
-  const gscoped_ptr<google::protobuf::Message> response_pb_;
+  gscoped_ptr<const google::protobuf::Message> request_pb_;
+  gscoped_ptr<google::protobuf::Message> response_pb_;
   scoped_refptr<ResultTracker> result_tracker_;
+  scoped_refptr<RpcMethodInfo> message_owner_;
+
+  // The size of the serialized request, recorded for 'message_owner_' since
+  // the call may be gone by the time the context is destroyed.
+  size_t request_bytes_;
 };
 
 } // namespace rpc
@@ -23,10 +23,13 @@
 
 #include "kudu/rpc/rpc_header.pb.h"
 #include "kudu/rpc/outbound_call.h"
+#include "kudu/rpc/rpc_sidecar.h"
+#include "kudu/rpc/transfer.h"
 
 namespace kudu { namespace rpc {
 
-RpcController::RpcController() {
+RpcController::RpcController()
+    : outbound_sidecars_deleter_(&outbound_sidecars_) {
   DVLOG(4) << "RpcController " << this << " constructed";
 }
 
@@ -45,6 +48,7 @@ void RpcController::Swap(RpcController* other) {
 
   std::swap(timeout_, other->timeout_);
   std::swap(call_, other->call_);
+  std::swap(outbound_sidecars_, other->outbound_sidecars_);
 }
 
 void RpcController::Reset() {
@@ -53,6 +57,8 @@ void RpcController::Reset() {
     CHECK(finished());
   }
   call_.reset();
+  required_server_features_.clear();
+  STLDeleteElements(&outbound_sidecars_);
 }
 
 bool RpcController::finished() const {
@@ -108,6 +114,18 @@ void RpcController::RequireServerFeature(uint32_t feature) {
   required_server_features_.insert(feature);
 }
 
+Status RpcController::AddOutboundSidecar(gscoped_ptr<RpcSidecar> car, int* idx) {
+  DCHECK(!call_) << "Sidecars must be added before the call is sent";
+  // Two of the payload slices are used up by the header and the request
+  // protobuf.
+  if (outbound_sidecars_.size() + 2 >= OutboundTransfer::kMaxPayloadSlices) {
+    return Status::ServiceUnavailable("All available sidecars already used");
+  }
+  outbound_sidecars_.push_back(car.release());
+  *idx = outbound_sidecars_.size() - 1;
+  return Status::OK();
+}
+
 MonoDelta RpcController::timeout() const {
   std::lock_guard<simple_spinlock> l(lock_);
   return timeout_;
@@ -21,8 +21,11 @@
 #include <glog/logging.h>
 #include <memory>
 #include <unordered_set>
+#include <vector>
 
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/stl_util.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/status.h"
@@ -33,6 +36,7 @@ namespace rpc {
 class ErrorStatusPB;
 class OutboundCall;
 class RequestIdPB;
+class RpcSidecar;
 
 // Controller for managing properties of a single RPC call, on the client side.
 //
@@ -178,6 +182,18 @@ class RpcController {
   // May fail if index is invalid.
   Status GetSidecar(int idx, Slice* sidecar) const;
 
+  // Adds a sidecar to the outbound request, to be sent after the request
+  // protobuf. Ownership of the sidecar passes to the call once it is sent.
+  //
+  // Upon success, writes the index of the sidecar (necessary for the server
+  // to retrieve it with RpcContext::GetInboundSidecar()) to 'idx'. May fail
+  // if all sidecars have already been used.
+  //
+  // Must be called before the call is sent. Since servers that predate
+  // request sidecars would misinterpret the request, callers should also
+  // require a server feature that implies support for them.
+  Status AddOutboundSidecar(gscoped_ptr<RpcSidecar> car, int* idx);
+
  private:
   friend class OutboundCall;
   friend class Proxy;
@@ -185,6 +201,11 @@ class RpcController {
   MonoDelta timeout_;
   std::unordered_set<uint32_t> required_server_features_;
 
+  // Sidecars to send along with the request. Owned until the call is sent,
+  // after which the OutboundCall owns them.
+  std::vector<RpcSidecar*> outbound_sidecars_;
+  ElementDeleter outbound_sidecars_deleter_;
+
   mutable simple_spinlock lock_;
 
   // The id of this request.
@@ -17,6 +17,9 @@
 #ifndef KUDU_RPC_RPC_SIDECAR_H
 #define KUDU_RPC_RPC_SIDECAR_H
 
+#include <memory>
+#include <string>
+
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/slice.h"
@@ -52,13 +55,25 @@ namespace rpc {
 class RpcSidecar {
  public:
   // Generates a sidecar with the parameter faststring as its data.
-  explicit RpcSidecar(gscoped_ptr<faststring> data) : data_(std::move(data)) {}
+  explicit RpcSidecar(gscoped_ptr<faststring> data)
+      : data_(std::move(data)),
+        slice_(*data_) {
+  }
+
+  // Generates a sidecar which shares 'data' with its other owners, so that
+  // the same data may be sent with several calls without being copied.
+  explicit RpcSidecar(std::shared_ptr<const std::string> data)
+      : shared_data_(std::move(data)),
+        slice_(*shared_data_) {
+  }
 
   // Returns a Slice representation of the sidecar's data.
-  Slice AsSlice() const { return *data_; }
+  Slice AsSlice() const { return slice_; }
 
  private:
   const gscoped_ptr<faststring> data_;
+  const std::shared_ptr<const std::string> shared_data_;
+  const Slice slice_;
 
   DISALLOW_COPY_AND_ASSIGN(RpcSidecar);
 };
@@ -39,6 +39,7 @@
 
 DEFINE_bool(is_panic_test_child, false, "Used by TestRpcPanic");
 DECLARE_bool(socket_inject_short_recvs);
+DECLARE_double(rpc_trace_sample_rate);
 
 using std::shared_ptr;
 using std::unique_ptr;
@@ -90,6 +91,20 @@ TEST_F(RpcStubTest, TestShortRecvs) {
   }
 }
 
+// Test that a method reusing its protobufs returns correct responses when
+// the messages it reuses held larger values.
+TEST_F(RpcStubTest, TestReusedMessages) {
+  CalculatorServiceProxy p(client_messenger_, server_addr_);
+  for (int size = 1000; size >= 0; size -= 100) {
+    EchoRequestPB req;
+    req.set_data(string(size, 'x'));
+    EchoResponsePB resp;
+    RpcController controller;
+    ASSERT_OK(p.Echo(req, &resp, &controller));
+    ASSERT_EQ(req.data(), resp.data());
+  }
+}
+
 // Test calls which are rather large.
 // This test sends many of them at once using the async API and then
 // waits for them all to return. This is meant to ensure that the
@@ -555,6 +570,28 @@ TEST_F(RpcStubTest, TestDumpSampledCalls) {
   ASSERT_STR_CONTAINS(sampled_rpcs.DebugString(), "duration_ms");
 }
 
+// Test that calls which start sampled traces are all kept by the server,
+// even when they fall into the same latency bucket.
+TEST_F(RpcStubTest, TestSampledTraceCalls) {
+  FLAGS_rpc_trace_sample_rate = 1;
+  for (int i = 0; i < 3; i++) {
+    NO_FATALS(SendSimpleCall());
+  }
+
+  DumpRpczStoreResponsePB sampled_rpcs;
+  server_messenger_->rpcz_store()->DumpPB(DumpRpczStoreRequestPB(), &sampled_rpcs);
+  ASSERT_EQ(1, sampled_rpcs.methods_size());
+  int num_traced = 0;
+  for (const auto& sample : sampled_rpcs.methods(0).samples()) {
+    if (sample.header().has_trace_id()) {
+      num_traced++;
+      ASSERT_STR_CONTAINS(sample.trace(), "Part of sampled trace");
+    }
+  }
+  // Besides the three calls, the latency bucket may hold one of them.
+  ASSERT_GE(num_traced, 3);
+}
+
 namespace {
 struct RefCountedTest : public RefCountedThreadSafe<RefCountedTest> {
 };
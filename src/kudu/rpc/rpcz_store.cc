@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <array>
+#include <deque>
 #include <glog/stl_logging.h>
 #include <mutex> // for unique_lock
 #include <string>
@@ -30,6 +31,7 @@
 #include "kudu/rpc/rpc_introspection.pb.h"
 #include "kudu/rpc/service_if.h"
 #include "kudu/util/atomic.h"
+#include "kudu/util/debug/trace_event.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/trace.h"
@@ -55,6 +57,10 @@ static const int kSampleIntervalMs = 1000;
 static const int kBucketThresholdsMs[] = {10, 100, 1000};
 static constexpr int kNumBuckets = arraysize(kBucketThresholdsMs) + 1;
 
+// The number of the most recent calls that are part of sampled distributed
+// traces kept for each RPC method, in addition to the per-bucket samples.
+static const size_t kMaxSampledTraceCalls = 10;
+
 // An instance of this class is created For each RPC method implemented
 // on the server. It keeps several recent samples for each RPC, currently
 // based on fixed time buckets.
@@ -66,6 +72,9 @@ class MethodSampler {
   // Potentially sample a single call.
   void SampleCall(InboundCall* call);
 
+  // Keep a call which is part of a sampled distributed trace.
+  void AddSampledTraceCall(InboundCall* call);
+
   // Dump the current samples.
   void GetSamplePBs(RpczMethodPB* pb);
 
@@ -95,6 +104,11 @@ class MethodSampler {
   };
   std::array<SampleBucket, kNumBuckets> buckets_;
 
+  // The most recent calls which are part of sampled distributed traces,
+  // protected by 'sampled_trace_calls_lock_'.
+  simple_spinlock sampled_trace_calls_lock_;
+  std::deque<Sample> sampled_trace_calls_;
+
   DISALLOW_COPY_AND_ASSIGN(MethodSampler);
 };
 
@@ -153,6 +167,15 @@ void MethodSampler::SampleCall(InboundCall* call) {
   }
 }
 
+void MethodSampler::AddSampledTraceCall(InboundCall* call) {
+  int duration_ms = call->timing().TotalDuration().ToMilliseconds();
+  std::lock_guard<simple_spinlock> l(sampled_trace_calls_lock_);
+  sampled_trace_calls_.push_back({call->header(), call->trace(), duration_ms});
+  if (sampled_trace_calls_.size() > kMaxSampledTraceCalls) {
+    sampled_trace_calls_.pop_front();
+  }
+}
+
 void MethodSampler::GetTraceMetrics(const Trace& t,
                                     const string& child_path,
                                     RpczSamplePB* sample_pb) {
@@ -188,6 +211,15 @@ void MethodSampler::GetSamplePBs(RpczMethodPB* method_pb) {
     GetTraceMetrics(*bucket.sample.trace.get(), "", sample_pb);
     sample_pb->set_duration_ms(bucket.sample.duration_ms);
   }
+
+  std::lock_guard<simple_spinlock> l(sampled_trace_calls_lock_);
+  for (const Sample& sample : sampled_trace_calls_) {
+    auto* sample_pb = method_pb->add_samples();
+    sample_pb->mutable_header()->CopyFrom(sample.header);
+    sample_pb->set_trace(sample.trace->DumpToString(Trace::INCLUDE_TIME_DELTAS));
+    GetTraceMetrics(*sample.trace.get(), "", sample_pb);
+    sample_pb->set_duration_ms(sample.duration_ms);
+  }
 }
 
 RpczStore::RpczStore() {}
@@ -199,6 +231,13 @@ void RpczStore::AddCall(InboundCall* call) {
   if (PREDICT_FALSE(!sampler)) return;
 
   sampler->SampleCall(call);
+  uint64_t trace_id = call->trace()->sampled_trace_id();
+  if (PREDICT_FALSE(trace_id != 0)) {
+    sampler->AddSampledTraceCall(call);
+    TRACE_EVENT_INSTANT2("rpc", "SampledTraceCall", TRACE_EVENT_SCOPE_THREAD,
+                         "trace_id", trace_id,
+                         "trace", call->trace()->DumpToString());
+  }
 }
 
 void RpczStore::DumpPB(const DumpRpczStoreRequestPB& req,
@@ -17,23 +17,41 @@
 
 #include "kudu/rpc/serialization.h"
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <google/protobuf/message_lite.h>
 #include <google/protobuf/io/coded_stream.h>
+#include <lz4.h>
 
 #include "kudu/gutil/endian.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/rpc/constants.h"
+#include "kudu/rpc/transfer.h"
 #include "kudu/util/faststring.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
 DECLARE_int32(rpc_max_message_size);
 
+DEFINE_bool(rpc_compress_payloads, false,
+            "Whether to compress large RPC messages and sidecars with LZ4 when "
+            "sending them to peers which support it. Useful when RPC traffic "
+            "is costly, e.g. between datacenters.");
+TAG_FLAG(rpc_compress_payloads, advanced);
+TAG_FLAG(rpc_compress_payloads, experimental);
+
+DEFINE_int32(rpc_compression_min_bytes, 4096,
+             "Minimum size of an RPC message or sidecar for it to be compressed "
+             "when --rpc_compress_payloads is set.");
+TAG_FLAG(rpc_compression_min_bytes, advanced);
+
 using google::protobuf::MessageLite;
+using google::protobuf::RepeatedField;
 using google::protobuf::io::CodedInputStream;
 using google::protobuf::io::CodedOutputStream;
+using std::vector;
 using strings::Substitute;
 
 namespace kudu {
@@ -152,6 +170,195 @@ Status ParseMessage(const Slice& buf,
   return Status::OK();
 }
 
+Status ParseSidecars(const google::protobuf::RepeatedField<uint32_t>& offsets,
+                     const Slice& entire_message,
+                     Slice* serialized_message,
+                     Slice* sidecars) {
+  int last = offsets.size() - 1;
+  if (last < 0) {
+    *serialized_message = entire_message;
+    return Status::OK();
+  }
+
+  if (last >= OutboundTransfer::kMaxPayloadSlices) {
+    return Status::Corruption(Substitute(
+        "Received $0 additional payload slices, expected at most $1",
+        last, OutboundTransfer::kMaxPayloadSlices));
+  }
+
+  *serialized_message = Slice(entire_message.data(), offsets.Get(0));
+  for (int i = 0; i < last; ++i) {
+    uint32_t next_offset = offsets.Get(i);
+    int32_t len = offsets.Get(i + 1) - next_offset;
+    if (next_offset + len > entire_message.size() || len < 0) {
+      return Status::Corruption(Substitute(
+          "Invalid sidecar offsets; sidecar $0 apparently starts at $1,"
+          " has length $2, but the entire message has length $3",
+          i, next_offset, len, entire_message.size()));
+    }
+    sidecars[i] = Slice(entire_message.data() + next_offset, len);
+  }
+  uint32_t next_offset = offsets.Get(last);
+  if (next_offset > entire_message.size()) {
+    return Status::Corruption(Substitute(
+        "Invalid sidecar offsets; the last sidecar ($0) apparently starts "
+        "at $1, but the entire message has length $2",
+        last, next_offset, entire_message.size()));
+  }
+  sidecars[last] = Slice(entire_message.data() + next_offset,
+                         entire_message.size() - next_offset);
+  return Status::OK();
+}
+
+namespace {
+
+// Appends the LZ4-compressed form of 'data' to 'buf' if 'data' is worth
+// compressing and shrinks when compressed. Returns whether it did.
+bool MaybeCompressTo(const Slice& data, faststring* buf) {
+  if (data.size() < FLAGS_rpc_compression_min_bytes) {
+    return false;
+  }
+  size_t old_size = buf->size();
+  buf->resize(old_size + LZ4_compressBound(data.size()));
+  int n = LZ4_compress(reinterpret_cast<const char*>(data.data()),
+                       reinterpret_cast<char*>(buf->data() + old_size),
+                       data.size());
+  if (n <= 0 || n >= data.size()) {
+    buf->resize(old_size);
+    return false;
+  }
+  buf->resize(old_size + n);
+  return true;
+}
+
+} // anonymous namespace
+
+void CompressPayload(faststring* main_buf,
+                     vector<Slice>* sidecars,
+                     faststring* compressed_sidecars_buf,
+                     RepeatedField<uint32_t>* sidecar_offsets,
+                     RepeatedField<uint32_t>* uncompressed_part_sizes,
+                     CompressionStats* stats) {
+  DCHECK_EQ(0, uncompressed_part_sizes->size());
+  if (!FLAGS_rpc_compress_payloads) {
+    return;
+  }
+
+  // Skip the length prefix written by SerializeMessage().
+  CodedInputStream in(main_buf->data(), main_buf->size());
+  uint32_t recorded_size;
+  CHECK(in.ReadVarint32(&recorded_size));
+  int prefix_len = in.CurrentPosition();
+  Slice pb(main_buf->data() + prefix_len, main_buf->size() - prefix_len);
+
+  vector<uint32_t> sizes(1 + sidecars->size(), 0);
+  bool compressed_any = false;
+  faststring compressed_pb;
+  if (MaybeCompressTo(pb, &compressed_pb)) {
+    sizes[0] = pb.size();
+    compressed_any = true;
+  }
+
+  // Compressed sidecars are appended to 'compressed_sidecars_buf', which may
+  // be reallocated as it grows, so only note where each one starts for now.
+  compressed_sidecars_buf->clear();
+  vector<size_t> compressed_offsets(sidecars->size());
+  for (int i = 0; i < sidecars->size(); i++) {
+    compressed_offsets[i] = compressed_sidecars_buf->size();
+    if (MaybeCompressTo((*sidecars)[i], compressed_sidecars_buf)) {
+      sizes[i + 1] = (*sidecars)[i].size();
+      compressed_any = true;
+    }
+  }
+  if (!compressed_any) {
+    return;
+  }
+
+  if (sizes[0] != 0) {
+    pb = Slice(compressed_pb);
+  }
+  for (int i = 0; i < sidecars->size(); i++) {
+    if (sizes[i + 1] != 0) {
+      size_t end = i + 1 < sidecars->size() ? compressed_offsets[i + 1]
+                                            : compressed_sidecars_buf->size();
+      (*sidecars)[i] = Slice(compressed_sidecars_buf->data() + compressed_offsets[i],
+                             end - compressed_offsets[i]);
+    }
+  }
+
+  // Rewrite the sidecar offsets and the length prefix of the main message
+  // to match the parts as sent.
+  uint32_t total_size = pb.size();
+  sidecar_offsets->Clear();
+  for (const Slice& sidecar : *sidecars) {
+    sidecar_offsets->Add(total_size);
+    total_size += sidecar.size();
+  }
+  faststring new_main_buf;
+  new_main_buf.resize(CodedOutputStream::VarintSize32(total_size) + pb.size());
+  uint8_t* dst = CodedOutputStream::WriteVarint32ToArray(total_size, new_main_buf.data());
+  memcpy(dst, pb.data(), pb.size());
+  main_buf->assign_copy(new_main_buf.data(), new_main_buf.size());
+
+  for (int i = 0; i < sizes.size(); i++) {
+    uncompressed_part_sizes->Add(sizes[i]);
+    if (stats && sizes[i] != 0) {
+      stats->uncompressed_bytes += sizes[i];
+      stats->compressed_bytes += i == 0 ? pb.size() : (*sidecars)[i - 1].size();
+    }
+  }
+}
+
+Status DecompressPayload(const RepeatedField<uint32_t>& uncompressed_part_sizes,
+                         Slice* serialized_message,
+                         Slice* sidecars,
+                         int num_sidecars,
+                         faststring* buf,
+                         CompressionStats* stats) {
+  if (uncompressed_part_sizes.size() == 0) {
+    return Status::OK();
+  }
+  if (PREDICT_FALSE(uncompressed_part_sizes.size() != num_sidecars + 1)) {
+    return Status::Corruption(Substitute(
+        "Invalid packet: $0 uncompressed part sizes for $1 payload parts",
+        uncompressed_part_sizes.size(), num_sidecars + 1));
+  }
+  int64_t total_size = 0;
+  for (uint32_t size : uncompressed_part_sizes) {
+    total_size += size;
+  }
+  if (PREDICT_FALSE(total_size > FLAGS_rpc_max_message_size)) {
+    return Status::Corruption(Substitute(
+        "Invalid packet: uncompressed payload of $0 bytes is larger than the "
+        "maximum configured RPC message size ($1 bytes)",
+        total_size, FLAGS_rpc_max_message_size));
+  }
+
+  buf->resize(total_size);
+  uint8_t* dst = buf->data();
+  for (int i = 0; i < uncompressed_part_sizes.size(); i++) {
+    uint32_t size = uncompressed_part_sizes.Get(i);
+    if (size == 0) {
+      continue;
+    }
+    Slice* part = i == 0 ? serialized_message : &sidecars[i - 1];
+    int n = LZ4_decompress_safe(reinterpret_cast<const char*>(part->data()),
+                                reinterpret_cast<char*>(dst),
+                                part->size(), size);
+    if (PREDICT_FALSE(n != size)) {
+      return Status::Corruption(Substitute(
+          "Invalid packet: could not decompress payload part $0", i));
+    }
+    if (stats) {
+      stats->uncompressed_bytes += size;
+      stats->compressed_bytes += part->size();
+    }
+    *part = Slice(dst, size);
+    dst += size;
+  }
+  return Status::OK();
+}
+
 void SerializeConnHeader(uint8_t* buf) {
   memcpy(reinterpret_cast<char *>(buf), kMagicNumber, kMagicNumberLength);
   buf += kMagicNumberLength;
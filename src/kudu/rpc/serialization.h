@@ -18,9 +18,12 @@
 #ifndef KUDU_RPC_SERIALIZATION_H
 #define KUDU_RPC_SERIALIZATION_H
 
+#include <google/protobuf/repeated_field.h>
 #include <inttypes.h>
 #include <string.h>
 
+#include <vector>
+
 namespace google {
 namespace protobuf {
 class MessageLite;
@@ -74,6 +77,57 @@ Status ParseMessage(const Slice& buf,
                     google::protobuf::MessageLite* parsed_header,
                     Slice* parsed_main_message);
 
+// Split the main message of a call or response into the protobuf and the
+// sidecars appended to it, using the sidecar offsets from the header.
+// In:  'offsets' the sidecar offsets listed in the message header,
+//      'entire_message' the payload following the header.
+// Out: 'serialized_message' pointing to the protobuf part of the payload,
+//      'sidecars' populated with one slice per offset. Must have room for
+//        OutboundTransfer::kMaxPayloadSlices entries.
+Status ParseSidecars(const google::protobuf::RepeatedField<uint32_t>& offsets,
+                     const Slice& entire_message,
+                     Slice* serialized_message,
+                     Slice* sidecars);
+
+// Sizes of the payload parts of calls or responses which were compressed.
+struct CompressionStats {
+  int64_t uncompressed_bytes = 0;
+  int64_t compressed_bytes = 0;
+};
+
+// Compress with LZ4, independently, each part of the main message of a call
+// or response -- its protobuf and each of its sidecars -- which is at least
+// --rpc_compression_min_bytes long and which shrinks when compressed. Does
+// nothing unless --rpc_compress_payloads is set.
+// In:  'main_buf' the protobuf as serialized by SerializeMessage(),
+//      'sidecars' the sidecars appended to it.
+// Out: If any part was compressed, 'main_buf' and 'sidecars' are rewritten
+//        to refer to the parts to send, the compressed sidecars being stored
+//        in 'compressed_sidecars_buf', 'sidecar_offsets' is rewritten to
+//        match and 'uncompressed_part_sizes' is filled in as described in
+//        rpc_header.proto. Otherwise, nothing is changed.
+//      'stats', if not NULL, accumulates the sizes of the compressed parts.
+void CompressPayload(faststring* main_buf,
+                     std::vector<Slice>* sidecars,
+                     faststring* compressed_sidecars_buf,
+                     google::protobuf::RepeatedField<uint32_t>* sidecar_offsets,
+                     google::protobuf::RepeatedField<uint32_t>* uncompressed_part_sizes,
+                     CompressionStats* stats);
+
+// Reverse CompressPayload() on the receiving side.
+// In:  'uncompressed_part_sizes' as listed in the message header.
+// In/Out: 'serialized_message' and the 'num_sidecars' entries of 'sidecars'
+//        the parts as received, as split by ParseSidecars(). The compressed
+//        ones are changed to point to their uncompressed data in 'buf'.
+// Out: 'stats', if not NULL, accumulates the sizes of the compressed parts.
+Status DecompressPayload(
+    const google::protobuf::RepeatedField<uint32_t>& uncompressed_part_sizes,
+    Slice* serialized_message,
+    Slice* sidecars,
+    int num_sidecars,
+    faststring* buf,
+    CompressionStats* stats);
+
 // Serialize the RPC connection header (magic number + flags).
 // buf must have 7 bytes available (kMagicNumberLength + kHeaderFlagsLength).
 void SerializeConnHeader(uint8_t* buf);
@@ -18,9 +18,11 @@
 #include "kudu/rpc/service_if.h"
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <google/protobuf/descriptor.pb.h>
 
+#include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
 
 #include "kudu/rpc/connection.h"
@@ -35,6 +37,17 @@
 DEFINE_bool(enable_exactly_once, true, "Whether to enable exactly once semantics.");
 TAG_FLAG(enable_exactly_once, hidden);
 
+DEFINE_int32(rpc_max_reused_messages_per_method, 32,
+             "Maximum number of cleared request and response protobufs kept for "
+             "reuse by each RPC method which reuses its messages.");
+TAG_FLAG(rpc_max_reused_messages_per_method, advanced);
+
+DEFINE_int32(rpc_max_reused_request_bytes, 1024 * 1024,
+             "Calls with serialized requests larger than this do not give their "
+             "protobufs for reuse, since a cleared protobuf keeps the memory of "
+             "its fields.");
+TAG_FLAG(rpc_max_reused_request_bytes, advanced);
+
 using google::protobuf::Message;
 using std::string;
 using std::unique_ptr;
@@ -43,6 +56,62 @@ using strings::Substitute;
 namespace kudu {
 namespace rpc {
 
+RpcMethodInfo::RpcMethodInfo()
+    : handler_latency_p50_us(-1),
+      handler_latency_refresh_us(0),
+      track_result(false),
+      reuse_messages(false) {
+}
+
+RpcMethodInfo::~RpcMethodInfo() {
+  STLDeleteElements(&cached_requests);
+  STLDeleteElements(&cached_responses);
+}
+
+Message* RpcMethodInfo::NewRequest() {
+  if (reuse_messages) {
+    std::lock_guard<simple_spinlock> l(cache_lock);
+    if (!cached_requests.empty()) {
+      Message* req = cached_requests.back();
+      cached_requests.pop_back();
+      return req;
+    }
+  }
+  return req_prototype->New();
+}
+
+Message* RpcMethodInfo::NewResponse() {
+  if (reuse_messages) {
+    std::lock_guard<simple_spinlock> l(cache_lock);
+    if (!cached_responses.empty()) {
+      Message* resp = cached_responses.back();
+      cached_responses.pop_back();
+      return resp;
+    }
+  }
+  return resp_prototype->New();
+}
+
+void RpcMethodInfo::RecycleMessages(const Message* req, Message* resp, size_t request_bytes) {
+  unique_ptr<Message> req_ptr(const_cast<Message*>(req));
+  unique_ptr<Message> resp_ptr(resp);
+  if (!reuse_messages || request_bytes > FLAGS_rpc_max_reused_request_bytes) {
+    // The messages are deleted.
+    return;
+  }
+  // Clear outside of the lock.
+  req_ptr->Clear();
+  resp_ptr->Clear();
+  std::lock_guard<simple_spinlock> l(cache_lock);
+  int max_cached = FLAGS_rpc_max_reused_messages_per_method;
+  if (cached_requests.size() < max_cached) {
+    cached_requests.push_back(req_ptr.release());
+  }
+  if (cached_responses.size() < max_cached) {
+    cached_responses.push_back(resp_ptr.release());
+  }
+}
+
 ServiceIf::~ServiceIf() {
 }
 
@@ -88,16 +157,16 @@ GeneratedServiceIf::~GeneratedServiceIf() {
 
 
 void GeneratedServiceIf::Handle(InboundCall *call) {
-  const RpcMethodInfo* method_info = call->method_info();
+  RpcMethodInfo* method_info = call->method_info();
   if (!method_info) {
     RespondBadMethod(call);
     return;
   }
-  unique_ptr<Message> req(method_info->req_prototype->New());
+  unique_ptr<Message> req(method_info->NewRequest());
   if (PREDICT_FALSE(!ParseParam(call, req.get()))) {
     return;
   }
-  Message* resp = method_info->resp_prototype->New();
+  Message* resp = method_info->NewResponse();
 
   bool track_result = call->header().has_request_id()
                       && method_info->track_result
@@ -106,6 +175,9 @@ void GeneratedServiceIf::Handle(InboundCall *call) {
                                    req.release(),
                                    resp,
                                    track_result ? result_tracker_ : nullptr);
+  if (method_info->reuse_messages) {
+    ctx->set_message_owner(method_info);
+  }
   if (track_result) {
     RequestIdPB request_id(call->header().request_id());
     ResultTracker::RpcState state = ctx->result_tracker()->TrackRpc(
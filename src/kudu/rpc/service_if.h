@@ -19,9 +19,12 @@
 
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/rpc/result_tracker.h"
@@ -47,6 +50,21 @@ class RpcContext;
 // by GeneratedServiceIf look up the RpcMethodInfo in order to handle
 // each RPC.
 struct RpcMethodInfo : public RefCountedThreadSafe<RpcMethodInfo> {
+  RpcMethodInfo();
+  ~RpcMethodInfo();
+
+  // Return an empty request or response protobuf, either cloned from the
+  // prototype or taken from the cache of reused messages.
+  google::protobuf::Message* NewRequest();
+  google::protobuf::Message* NewResponse();
+
+  // Take back the request and response of a finished call. If this method
+  // reuses its messages, they are cleared and cached for later calls.
+  // Otherwise, they are deleted.
+  void RecycleMessages(const google::protobuf::Message* req,
+                       google::protobuf::Message* resp,
+                       size_t request_bytes);
+
   // Prototype protobufs for requests and responses.
   // These are empty protobufs which are cloned in order to provide an
   // instance for each request.
@@ -55,9 +73,26 @@ struct RpcMethodInfo : public RefCountedThreadSafe<RpcMethodInfo> {
 
   scoped_refptr<Histogram> handler_latency_histogram;
 
+  // The median of 'handler_latency_histogram' in microseconds, or -1 while
+  // too few calls were handled for it to be trusted, as last computed by the
+  // service pool. Reading the sharded histogram merges all its shards, which
+  // is too costly to do for every call, so the median is recomputed once
+  // 'handler_latency_refresh_us' has passed, in microseconds since
+  // MonoTime::Min().
+  AtomicInt<int64_t> handler_latency_p50_us;
+  AtomicInt<int64_t> handler_latency_refresh_us;
+
   // Whether we should track this method's result, using ResultTracker.
   bool track_result;
 
+  // Whether the requests and responses of finished calls are reused.
+  bool reuse_messages;
+
+  // Cleared messages, protected by 'cache_lock'.
+  simple_spinlock cache_lock;
+  std::vector<google::protobuf::Message*> cached_requests;
+  std::vector<google::protobuf::Message*> cached_responses;
+
   // The actual function to be called.
   std::function<void(const google::protobuf::Message* req,
                      google::protobuf::Message* resp,
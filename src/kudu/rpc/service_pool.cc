@@ -17,32 +17,91 @@
 
 #include "kudu/rpc/service_pool.h"
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/rpc/inbound_call.h"
 #include "kudu/rpc/messenger.h"
+#include "kudu/rpc/outbound_call.h"
 #include "kudu/rpc/service_if.h"
 #include "kudu/rpc/service_queue.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/numa.h"
 #include "kudu/util/status.h"
 #include "kudu/util/thread.h"
 #include "kudu/util/trace.h"
 
 using std::shared_ptr;
+using std::string;
+using std::unordered_map;
 using strings::Substitute;
 
+DEFINE_bool(rpc_service_queue_fair, false,
+            "Whether to share the workers of each RPC service among its clients by "
+            "weighted fair queuing, rather than serving the calls of all clients in "
+            "deadline order. Calls are then also dropped once they are unlikely to "
+            "complete before their deadline. See --rpc_service_queue_tenant and "
+            "--rpc_service_queue_tenant_weights.");
+TAG_FLAG(rpc_service_queue_fair, experimental);
+
+DEFINE_string(rpc_service_queue_tenant, "user",
+              "What a client of an RPC service is when the service's calls are fairly "
+              "queued: 'user' for the user which made the call, or 'host' for the "
+              "host it came from.");
+TAG_FLAG(rpc_service_queue_tenant, experimental);
+
+DEFINE_string(rpc_service_queue_tenant_weights, "",
+              "Comma-separated list of tenant:weight pairs giving the share of an RPC "
+              "service's workers a client gets when the service's calls are fairly "
+              "queued, relative to the other clients. Clients which aren't listed "
+              "have a weight of 1.");
+TAG_FLAG(rpc_service_queue_tenant_weights, experimental);
+
+DEFINE_int32(rpc_service_queue_max_tenant_metrics, 100,
+             "Maximum number of clients of fairly queued RPC services whose queue "
+             "times are tracked by metrics of their own.");
+TAG_FLAG(rpc_service_queue_max_tenant_metrics, advanced);
+
+static bool ValidateTenant(const char* flagname, const string& value) {
+  if (value == "user" || value == "host") {
+    return true;
+  }
+  LOG(ERROR) << Substitute("$0 must be 'user' or 'host', value $1 is invalid",
+                           flagname, value);
+  return false;
+}
+
+static bool ValidateTenantWeights(const char* flagname, const string& value) {
+  unordered_map<string, int> weights;
+  kudu::Status s = kudu::rpc::FairServiceQueue::ParseTenantWeights(value, &weights);
+  if (!s.ok()) {
+    LOG(ERROR) << Substitute("Invalid value for $0: $1", flagname, s.ToString());
+    return false;
+  }
+  return true;
+}
+
+static bool dummy[] = {
+  google::RegisterFlagValidator(&FLAGS_rpc_service_queue_tenant, &ValidateTenant),
+  google::RegisterFlagValidator(&FLAGS_rpc_service_queue_tenant_weights, &ValidateTenantWeights)
+};
+
 METRIC_DEFINE_histogram(server, rpc_incoming_queue_time,
                         "RPC Queue Time",
                         kudu::MetricUnit::kMicroseconds,
                         "Number of microseconds incoming RPC requests spend in the worker queue",
-                        60000000LU, 3);
+                        60000000LU, 3, kudu::SHARDED_HISTOGRAM);
 
 METRIC_DEFINE_counter(server, rpcs_timed_out_in_queue,
                       "RPC Queue Timeouts",
@@ -56,18 +115,86 @@ METRIC_DEFINE_counter(server, rpcs_queue_overflow,
                       "Number of RPCs dropped because the service queue "
                       "was full.");
 
+METRIC_DEFINE_counter(server, rpcs_dropped_near_deadline,
+                      "RPCs Dropped Near Deadline",
+                      kudu::MetricUnit::kRequests,
+                      "Number of RPCs dropped from a fair service queue because "
+                      "too little of their timeout was left for them to complete.");
+
 namespace kudu {
 namespace rpc {
 
+namespace {
+
+// The median handling time of a method is only trusted to judge whether a call
+// would miss its deadline once this many calls were handled.
+const int kMinHandledCallsForEstimate = 100;
+
+// How often the median handling time of a method is recomputed.
+const int64_t kHandlerLatencyRefreshUs = 1000000;
+
+string TenantOfCall(const InboundCall* call) {
+  if (FLAGS_rpc_service_queue_tenant == "host") {
+    return call->remote_address().host();
+  }
+  const UserCredentials& creds = call->user_credentials();
+  return creds.has_effective_user() ? creds.effective_user() : creds.real_user();
+}
+
+// Returns the prototype of the queue time histogram of 'tenant', or nullptr if
+// --rpc_service_queue_max_tenant_metrics tenants already have one. Unlike other
+// prototypes these are created as tenants show up, and like them, they're
+// never destroyed.
+HistogramPrototype* TenantQueueTimePrototype(const string& tenant) {
+  static Mutex lock;
+  static auto* prototypes = new unordered_map<string, HistogramPrototype*>();
+
+  MutexLock l(lock);
+  HistogramPrototype* proto = FindPtrOrNull(*prototypes, tenant);
+  if (proto ||
+      prototypes->size() >= static_cast<size_t>(FLAGS_rpc_service_queue_max_tenant_metrics)) {
+    return proto;
+  }
+  // Metric names may only hold alphanumerics and underscores.
+  string suffix = tenant;
+  for (char& c : suffix) {
+    if (!isalnum(c)) c = '_';
+  }
+  auto* name = new string(Substitute("rpc_tenant_queue_time_$0", suffix));
+  auto* label = new string(Substitute("RPC Queue Time of $0", tenant));
+  auto* desc = new string(Substitute(
+      "Number of microseconds incoming RPC requests of tenant '$0' spend in a "
+      "fair service queue", tenant));
+  proto = new HistogramPrototype(
+      MetricPrototype::CtorArgs("server", name->c_str(), label->c_str(),
+                                MetricUnit::kMicroseconds, desc->c_str()),
+      60000000LU, 2);
+  InsertOrDie(prototypes, tenant, proto);
+  return proto;
+}
+
+} // anonymous namespace
+
 ServicePool::ServicePool(gscoped_ptr<ServiceIf> service,
                          const scoped_refptr<MetricEntity>& entity,
                          size_t service_queue_length)
   : service_(std::move(service)),
-    service_queue_(service_queue_length),
+    fair_queue_(nullptr),
+    metric_entity_(entity),
     incoming_queue_time_(METRIC_rpc_incoming_queue_time.Instantiate(entity)),
     rpcs_timed_out_in_queue_(METRIC_rpcs_timed_out_in_queue.Instantiate(entity)),
     rpcs_queue_overflow_(METRIC_rpcs_queue_overflow.Instantiate(entity)),
+    rpcs_dropped_near_deadline_(METRIC_rpcs_dropped_near_deadline.Instantiate(entity)),
     closing_(false) {
+  if (FLAGS_rpc_service_queue_fair) {
+    unordered_map<string, int> weights;
+    CHECK_OK(FairServiceQueue::ParseTenantWeights(FLAGS_rpc_service_queue_tenant_weights,
+                                                  &weights));
+    fair_queue_ = new FairServiceQueue(service_queue_length, &TenantOfCall, std::move(weights));
+    service_queue_.reset(fair_queue_);
+  } else {
+    service_queue_.reset(new LifoServiceQueue(service_queue_length));
+  }
 }
 
 ServicePool::~ServicePool() {
@@ -78,14 +205,14 @@ Status ServicePool::Init(int num_threads) {
   for (int i = 0; i < num_threads; i++) {
     scoped_refptr<kudu::Thread> new_thread;
     CHECK_OK(kudu::Thread::Create("service pool", "rpc worker",
-        &ServicePool::RunThread, this, &new_thread));
+        &ServicePool::RunThread, this, i, &new_thread));
     threads_.push_back(new_thread);
   }
   return Status::OK();
 }
 
 void ServicePool::Shutdown() {
-  service_queue_.Shutdown();
+  service_queue_->Shutdown();
 
   MutexLock lock(shutdown_lock_);
   if (closing_) return;
@@ -98,7 +225,7 @@ void ServicePool::Shutdown() {
   // Now we must drain the service queue.
   Status status = Status::ServiceUnavailable("Service is shutting down");
   std::unique_ptr<InboundCall> incoming;
-  while (service_queue_.BlockingGet(&incoming)) {
+  while (service_queue_->BlockingGet(&incoming)) {
     incoming.release()->RespondFailure(ErrorStatusPB::FATAL_SERVER_SHUTTING_DOWN, status);
   }
 
@@ -112,13 +239,13 @@ void ServicePool::RejectTooBusy(InboundCall* c) {
                  c->remote_method().method_name(),
                  service_->service_name(),
                  c->remote_address().ToString(),
-                 service_queue_.max_size());
+                 service_queue_->max_size());
   rpcs_queue_overflow_->Increment();
   KLOG_EVERY_N_SECS(WARNING, 1) << err_msg;
   c->RespondFailure(ErrorStatusPB::ERROR_SERVER_TOO_BUSY,
                     Status::ServiceUnavailable(err_msg));
   DLOG(INFO) << err_msg << " Contents of service queue:\n"
-             << service_queue_.ToString();
+             << service_queue_->ToString();
 }
 
 RpcMethodInfo* ServicePool::LookupMethod(const RemoteMethod& method) {
@@ -144,7 +271,7 @@ Status ServicePool::QueueInboundCall(gscoped_ptr<InboundCall> call) {
 
   // Queue message on service queue
   boost::optional<InboundCall*> evicted;
-  auto queue_status = service_queue_.Put(c, &evicted);
+  auto queue_status = service_queue_->Put(c, &evicted);
   if (queue_status == QUEUE_FULL) {
     RejectTooBusy(c);
     return Status::OK();
@@ -172,15 +299,21 @@ Status ServicePool::QueueInboundCall(gscoped_ptr<InboundCall> call) {
   return status;
 }
 
-void ServicePool::RunThread() {
+void ServicePool::RunThread(int index) {
+  // Workers are spread over the NUMA nodes, so that each node has its share.
+  WARN_NOT_OK(BindCurrentThreadToNumaNode(index),
+              "Unable to bind service pool thread to its NUMA node");
   while (true) {
     std::unique_ptr<InboundCall> incoming;
-    if (!service_queue_.BlockingGet(&incoming)) {
+    if (!service_queue_->BlockingGet(&incoming)) {
       VLOG(1) << "ServicePool: messenger shutting down.";
       return;
     }
 
     incoming->RecordHandlingStarted(incoming_queue_time_);
+    if (fair_queue_) {
+      RecordTenantQueueTime(incoming.get());
+    }
     ADOPT_TRACE(incoming->trace());
 
     if (PREDICT_FALSE(incoming->ClientTimedOut())) {
@@ -199,6 +332,16 @@ void ServicePool::RunThread() {
       continue;
     }
 
+    if (fair_queue_ && PREDICT_FALSE(LikelyToMissDeadline(incoming.get()))) {
+      TRACE_TO(incoming->trace(), "Skipping call since it would likely miss its deadline");
+      rpcs_dropped_near_deadline_->Increment();
+      incoming->RespondFailure(
+        ErrorStatusPB::ERROR_SERVER_TOO_BUSY,
+        Status::TimedOut("Call waited in the queue until too close to its deadline"));
+      ignore_result(incoming.release());
+      continue;
+    }
+
     TRACE_TO(incoming->trace(), "Handling call");
 
     // Release the InboundCall pointer -- when the call is responded to,
@@ -207,6 +350,57 @@ void ServicePool::RunThread() {
   }
 }
 
+bool ServicePool::LikelyToMissDeadline(InboundCall* call) const {
+  MonoTime deadline = call->GetClientDeadline();
+  if (deadline == MonoTime::Max() || !call->method_info()) {
+    return false;
+  }
+  MonoTime now = MonoTime::Now();
+  int64_t p50_us = HandlerLatencyMedian(call->method_info(), now);
+  if (p50_us < 0) {
+    return false;
+  }
+  return (deadline - now).ToMicroseconds() < p50_us;
+}
+
+int64_t ServicePool::HandlerLatencyMedian(RpcMethodInfo* method_info, const MonoTime& now) {
+  int64_t now_us = (now - MonoTime::Min()).ToMicroseconds();
+  int64_t refresh_us = method_info->handler_latency_refresh_us.Load();
+  // Only the thread which moves the refresh time forward recomputes the
+  // median; the others keep using the previous one meanwhile.
+  if (now_us >= refresh_us &&
+      method_info->handler_latency_refresh_us.CompareAndSet(
+          refresh_us, now_us + kHandlerLatencyRefreshUs)) {
+    const Histogram* handler_latency = method_info->handler_latency_histogram.get();
+    int64_t p50_us = -1;
+    if (handler_latency->TotalCount() >= kMinHandledCallsForEstimate) {
+      p50_us = static_cast<int64_t>(handler_latency->ValueAtPercentile(50));
+    }
+    method_info->handler_latency_p50_us.Store(p50_us);
+    return p50_us;
+  }
+  return method_info->handler_latency_p50_us.Load();
+}
+
+void ServicePool::RecordTenantQueueTime(const InboundCall* call) {
+  string tenant = fair_queue_->TenantOf(call);
+  scoped_refptr<Histogram> hist;
+  {
+    std::lock_guard<simple_spinlock> l(tenant_metrics_lock_);
+    hist = FindPtrOrNull(tenant_queue_times_, tenant);
+  }
+  if (!hist) {
+    HistogramPrototype* proto = TenantQueueTimePrototype(tenant);
+    if (!proto) {
+      return;
+    }
+    hist = proto->Instantiate(metric_entity_);
+    std::lock_guard<simple_spinlock> l(tenant_metrics_lock_);
+    tenant_queue_times_[tenant] = hist;
+  }
+  hist->Increment((MonoTime::Now() - call->GetTimeReceived()).ToMicroseconds());
+}
+
 const string ServicePool::service_name() const {
   return service_->service_name();
 }
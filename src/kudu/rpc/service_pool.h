@@ -19,6 +19,7 @@
 #define KUDU_SERVICE_POOL_H
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "kudu/gutil/macros.h"
@@ -26,6 +27,7 @@
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/rpc/rpc_service.h"
 #include "kudu/rpc/service_queue.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/mutex.h"
 #include "kudu/util/thread.h"
 #include "kudu/util/status.h"
@@ -35,12 +37,14 @@ namespace kudu {
 class Counter;
 class Histogram;
 class MetricEntity;
+class MonoTime;
 class Socket;
 
 namespace rpc {
 
 class Messenger;
 class ServiceIf;
+struct RpcMethodInfo;
 
 // A pool of threads that handle new incoming RPC calls.
 // Also includes a queue that calls get pushed onto for handling by the pool.
@@ -73,18 +77,46 @@ class ServicePool : public RpcService {
     return rpcs_queue_overflow_.get();
   }
 
+  const Counter* RpcsDroppedNearDeadlineMetricForTests() const {
+    return rpcs_dropped_near_deadline_.get();
+  }
+
   const std::string service_name() const;
 
  private:
-  void RunThread();
+  // Runs the 'index'th worker thread.
+  void RunThread(int index);
   void RejectTooBusy(InboundCall* c);
 
+  // Whether 'call' would likely miss its deadline if it were handled now,
+  // judging by how long its method usually takes.
+  bool LikelyToMissDeadline(InboundCall* call) const;
+
+  // Returns the median handling time of the method, in microseconds, or -1
+  // if too few of its calls were handled to tell. Recomputes it from the
+  // method's histogram at most every second.
+  static int64_t HandlerLatencyMedian(RpcMethodInfo* method_info, const MonoTime& now);
+
+  // Records how long 'call' waited in the fair queue in its tenant's metric.
+  void RecordTenantQueueTime(const InboundCall* call);
+
   gscoped_ptr<ServiceIf> service_;
   std::vector<scoped_refptr<kudu::Thread> > threads_;
-  LifoServiceQueue service_queue_;
+  gscoped_ptr<ServiceQueue> service_queue_;
+
+  // Set to 'service_queue_' if it's a FairServiceQueue, nullptr otherwise.
+  FairServiceQueue* fair_queue_;
+
+  const scoped_refptr<MetricEntity> metric_entity_;
   scoped_refptr<Histogram> incoming_queue_time_;
   scoped_refptr<Counter> rpcs_timed_out_in_queue_;
   scoped_refptr<Counter> rpcs_queue_overflow_;
+  scoped_refptr<Counter> rpcs_dropped_near_deadline_;
+
+  // The queue time histograms of the fair queue's tenants, by tenant.
+  // Protected by tenant_metrics_lock_.
+  std::unordered_map<std::string, scoped_refptr<Histogram>> tenant_queue_times_;
+  simple_spinlock tenant_metrics_lock_;
 
   mutable Mutex shutdown_lock_;
   bool closing_;
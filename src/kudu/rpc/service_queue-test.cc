@@ -16,6 +16,7 @@
 // under the License.
 
 
+#include <algorithm>
 #include <atomic>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
@@ -23,8 +24,10 @@
 #include <memory>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
+#include "kudu/gutil/map-util.h"
 #include "kudu/rpc/service_queue.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_util.h"
@@ -32,6 +35,7 @@
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
+using std::unordered_map;
 using std::vector;
 
 DEFINE_int32(num_producers, 4,
@@ -140,5 +144,129 @@ TEST(TestServiceQueue, LifoServiceQueuePerf) {
   LOG(INFO) << "Avg idle workers:     " << total_idle_workers / static_cast<double>(total_sample);
 }
 
+class FairServiceQueueTest : public KuduTest {
+ protected:
+  void MakeQueue(int max_size, unordered_map<string, int> weights) {
+    queue_.reset(new FairServiceQueue(
+        max_size,
+        [this](const InboundCall* call) { return FindOrDie(tenants_, call); },
+        std::move(weights)));
+  }
+
+  // Queues a new call of 'tenant', returning the call the queue evicted, if any.
+  QueueStatus PutCall(const string& tenant, boost::optional<InboundCall*>* evicted) {
+    InboundCall* call = new InboundCall(nullptr);
+    calls_.emplace_back(call);
+    tenants_[call] = tenant;
+    return queue_->Put(call, evicted);
+  }
+
+  // Returns the tenants of the next 'n' dequeued calls.
+  vector<string> GetTenants(int n) {
+    vector<string> ret;
+    for (int i = 0; i < n; i++) {
+      unique_ptr<InboundCall> call;
+      CHECK(queue_->BlockingGet(&call));
+      ret.push_back(FindOrDie(tenants_, call.get()));
+      // The call is owned by 'calls_'.
+      ignore_result(call.release());
+    }
+    return ret;
+  }
+
+  vector<unique_ptr<InboundCall>> calls_;
+  unordered_map<const InboundCall*, string> tenants_;
+  unique_ptr<FairServiceQueue> queue_;
+};
+
+// Test that backlogged tenants take turns, in proportion to their weights.
+TEST_F(FairServiceQueueTest, TestTenantsShareByWeight) {
+  MakeQueue(100, { { "heavy", 2 } });
+  boost::optional<InboundCall*> evicted;
+  for (int i = 0; i < 20; i++) {
+    ASSERT_EQ(QUEUE_SUCCESS, PutCall("flood", &evicted));
+  }
+  for (int i = 0; i < 3; i++) {
+    ASSERT_EQ(QUEUE_SUCCESS, PutCall("light", &evicted));
+  }
+  for (int i = 0; i < 8; i++) {
+    ASSERT_EQ(QUEUE_SUCCESS, PutCall("heavy", &evicted));
+  }
+  ASSERT_TRUE(evicted == boost::none);
+
+  // Each round of four calls serves 'heavy' twice and the others once, in
+  // some order.
+  for (int round = 0; round < 3; round++) {
+    vector<string> tenants = GetTenants(4);
+    std::sort(tenants.begin(), tenants.end());
+    ASSERT_EQ(vector<string>({ "flood", "heavy", "heavy", "light" }), tenants);
+  }
+  // Once 'light' has run out of calls, the rest is split between the others.
+  vector<string> tenants = GetTenants(3);
+  std::sort(tenants.begin(), tenants.end());
+  ASSERT_EQ(vector<string>({ "flood", "heavy", "heavy" }), tenants);
+
+  // A tenant which was idle gets no credit for it: it's served no sooner
+  // than once every round.
+  ASSERT_EQ(QUEUE_SUCCESS, PutCall("light", &evicted));
+  ASSERT_EQ(QUEUE_SUCCESS, PutCall("light", &evicted));
+  tenants = GetTenants(2);
+  ASSERT_EQ(1, std::count(tenants.begin(), tenants.end(), "light"));
+
+  queue_->Shutdown();
+  while (!queue_->empty()) {
+    GetTenants(1);
+  }
+}
+
+// Test that a full queue makes room by evicting calls of the tenant with the
+// most calls queued, unless that's the new call's tenant.
+TEST_F(FairServiceQueueTest, TestEvictsFromLargestTenant) {
+  MakeQueue(4, {});
+  boost::optional<InboundCall*> evicted;
+  for (int i = 0; i < 4; i++) {
+    ASSERT_EQ(QUEUE_SUCCESS, PutCall("flood", &evicted));
+  }
+  ASSERT_TRUE(evicted == boost::none);
+
+  // 'flood' can't have more of the queue, and since its new call has a
+  // later deadline than its queued ones, the call is rejected.
+  ASSERT_EQ(QUEUE_SUCCESS, PutCall("other", &evicted));
+  ASSERT_TRUE(evicted != boost::none);
+  ASSERT_EQ("flood", FindOrDie(tenants_, *evicted));
+  evicted = boost::none;
+  ASSERT_EQ(QUEUE_FULL, PutCall("flood", &evicted));
+  ASSERT_EQ(QUEUE_SUCCESS, PutCall("other", &evicted));
+  ASSERT_TRUE(evicted != boost::none);
+  ASSERT_EQ("flood", FindOrDie(tenants_, *evicted));
+
+  // Now 'flood' and 'other' have two calls each, so another call of
+  // 'other' is one too many.
+  evicted = boost::none;
+  ASSERT_EQ(QUEUE_FULL, PutCall("other", &evicted));
+  ASSERT_TRUE(evicted == boost::none);
+
+  queue_->Shutdown();
+  vector<string> tenants = GetTenants(4);
+  std::sort(tenants.begin(), tenants.end());
+  ASSERT_EQ(vector<string>({ "flood", "flood", "other", "other" }), tenants);
+  unique_ptr<InboundCall> call;
+  ASSERT_FALSE(queue_->BlockingGet(&call));
+  ASSERT_EQ(QUEUE_SHUTDOWN, PutCall("other", &evicted));
+}
+
+TEST(TestServiceQueue, TestParseTenantWeights) {
+  unordered_map<string, int> weights;
+  ASSERT_OK(FairServiceQueue::ParseTenantWeights("", &weights));
+  ASSERT_TRUE(weights.empty());
+  ASSERT_OK(FairServiceQueue::ParseTenantWeights("alice:3,bob:1", &weights));
+  ASSERT_EQ(2, weights.size());
+  ASSERT_EQ(3, weights["alice"]);
+  ASSERT_EQ(1, weights["bob"]);
+  for (const char* bad : { "alice", "alice:0", ":2", "alice:x", "alice:1:2" }) {
+    ASSERT_TRUE(FairServiceQueue::ParseTenantWeights(bad, &weights).IsInvalidArgument()) << bad;
+  }
+}
+
 } // namespace rpc
 } // namespace kudu
@@ -17,8 +17,14 @@
 
 #include "kudu/rpc/service_queue.h"
 
+#include <algorithm>
 #include <mutex>
+#include <vector>
 
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/logging.h"
 
 namespace kudu {
@@ -138,5 +144,170 @@ std::string LifoServiceQueue::ToString() const {
   return ret;
 }
 
+FairServiceQueue::FairServiceQueue(int max_size,
+                                   TenantFunction tenant_function,
+                                   std::unordered_map<std::string, int> tenant_weights)
+    : tenant_function_(std::move(tenant_function)),
+      tenant_weights_(std::move(tenant_weights)),
+      not_empty_(&lock_),
+      shutdown_(false),
+      max_queue_size_(max_size),
+      queue_size_(0),
+      virtual_time_(0) {
+  CHECK_GT(max_queue_size_, 0);
+}
+
+FairServiceQueue::~FairServiceQueue() {
+  DCHECK_EQ(queue_size_, 0)
+      << "ServiceQueue holds bare pointers at destruction time";
+}
+
+bool FairServiceQueue::BlockingGet(std::unique_ptr<InboundCall>* out) {
+  MutexLock l(lock_);
+  while (backlogged_tenants_.empty()) {
+    if (PREDICT_FALSE(shutdown_)) {
+      return false;
+    }
+    not_empty_.Wait();
+  }
+  auto first = backlogged_tenants_.begin();
+  Tenant* tenant = first->second;
+  virtual_time_ = first->first;
+  backlogged_tenants_.erase(first);
+
+  auto it = tenant->calls.begin();
+  out->reset(*it);
+  tenant->calls.erase(it);
+  queue_size_--;
+
+  tenant->tag = virtual_time_ + 1.0 / tenant->weight;
+  if (!tenant->calls.empty()) {
+    backlogged_tenants_.emplace(tenant->tag, tenant);
+  } else {
+    MaybeRemoveIdleTenantsUnlocked();
+  }
+  return true;
+}
+
+QueueStatus FairServiceQueue::Put(InboundCall* call,
+                                  boost::optional<InboundCall*>* evicted) {
+  std::string tenant_name = tenant_function_(call);
+  MutexLock l(lock_);
+  if (PREDICT_FALSE(shutdown_)) {
+    return QUEUE_SHUTDOWN;
+  }
+
+  auto& tenant_slot = tenants_[tenant_name];
+  if (!tenant_slot) {
+    const int* weight = FindOrNull(tenant_weights_, tenant_name);
+    tenant_slot.reset(new Tenant(weight ? *weight : 1));
+  }
+  Tenant* tenant = tenant_slot.get();
+
+  if (PREDICT_FALSE(queue_size_ >= max_queue_size_)) {
+    // Evict from the tenant which has the most calls queued for its weight,
+    // counting 'call' as one of its tenant's. Ties go against that tenant.
+    Tenant* victim = tenant;
+    double victim_share = static_cast<double>(tenant->calls.size() + 1) / tenant->weight;
+    for (const auto& entry : backlogged_tenants_) {
+      Tenant* t = entry.second;
+      double share = static_cast<double>(t->calls.size()) / t->weight;
+      if (share > victim_share) {
+        victim = t;
+        victim_share = share;
+      }
+    }
+    if (victim == tenant &&
+        (tenant->calls.empty() || DeadlineLess(*tenant->calls.rbegin(), call))) {
+      return QUEUE_FULL;
+    }
+    *evicted = RemoveLatestCallUnlocked(victim);
+  }
+
+  if (tenant->calls.empty()) {
+    tenant->tag = std::max(tenant->tag, virtual_time_);
+    backlogged_tenants_.emplace(tenant->tag, tenant);
+  }
+  tenant->calls.insert(call);
+  queue_size_++;
+  not_empty_.Signal();
+  return QUEUE_SUCCESS;
+}
+
+InboundCall* FairServiceQueue::RemoveLatestCallUnlocked(Tenant* tenant) {
+  DCHECK(!tenant->calls.empty());
+  auto it = --tenant->calls.end();
+  InboundCall* call = *it;
+  tenant->calls.erase(it);
+  queue_size_--;
+  if (tenant->calls.empty()) {
+    backlogged_tenants_.erase(std::make_pair(tenant->tag, tenant));
+  }
+  return call;
+}
+
+void FairServiceQueue::MaybeRemoveIdleTenantsUnlocked() {
+  // Amortizes the scan over the dequeues which made the tenants idle.
+  if (tenants_.size() < 2 * backlogged_tenants_.size() + 64) {
+    return;
+  }
+  for (auto it = tenants_.begin(); it != tenants_.end();) {
+    const Tenant* t = it->second.get();
+    if (t->calls.empty() && t->tag <= virtual_time_) {
+      it = tenants_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void FairServiceQueue::Shutdown() {
+  MutexLock l(lock_);
+  shutdown_ = true;
+  not_empty_.Broadcast();
+}
+
+bool FairServiceQueue::empty() const {
+  MutexLock l(lock_);
+  return queue_size_ == 0;
+}
+
+int FairServiceQueue::max_size() const {
+  return max_queue_size_;
+}
+
+std::string FairServiceQueue::ToString() const {
+  std::string ret;
+
+  MutexLock l(lock_);
+  for (const auto& entry : tenants_) {
+    const Tenant* t = entry.second.get();
+    if (t->calls.empty()) continue;
+    ret.append(strings::Substitute("tenant $0 (weight $1, $2 calls):\n",
+                                   entry.first, t->weight, t->calls.size()));
+    for (const auto* call : t->calls) {
+      ret.append(call->ToString());
+      ret.append("\n");
+    }
+  }
+  return ret;
+}
+
+Status FairServiceQueue::ParseTenantWeights(const std::string& str,
+                                            std::unordered_map<std::string, int>* weights) {
+  weights->clear();
+  std::vector<std::string> entries = strings::Split(str, ",", strings::SkipEmpty());
+  for (const std::string& entry : entries) {
+    std::vector<std::string> parts = strings::Split(entry, ":");
+    int32_t weight;
+    if (parts.size() != 2 || parts[0].empty() ||
+        !safe_strto32(parts[1], &weight) || weight <= 0) {
+      return Status::InvalidArgument("Invalid tenant weight", entry);
+    }
+    (*weights)[parts[0]] = weight;
+  }
+  return Status::OK();
+}
+
 } // namespace rpc
 } // namespace kudu
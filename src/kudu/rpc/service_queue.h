@@ -18,14 +18,18 @@
 #define KUDU_UTIL_SERVICE_QUEUE_H
 
 #include <boost/optional.hpp>
+#include <functional>
 #include <memory>
 #include <string>
 #include <set>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "kudu/rpc/inbound_call.h"
 #include "kudu/util/condition_variable.h"
 #include "kudu/util/mutex.h"
+#include "kudu/util/status.h"
 
 namespace kudu {
 namespace rpc {
@@ -37,6 +41,62 @@ enum QueueStatus {
   QUEUE_FULL = 2
 };
 
+// Interface of the queues which pass inbound RPC calls to the service handler pool.
+class ServiceQueue {
+ public:
+  virtual ~ServiceQueue() {}
+
+  // Get an element from the queue.  Returns false if we were shut down prior to
+  // getting the element.
+  virtual bool BlockingGet(std::unique_ptr<InboundCall>* out) = 0;
+
+  // Add a new call to the queue.
+  // Returns:
+  // - QUEUE_SHUTDOWN if Shutdown() has already been called.
+  // - QUEUE_FULL if the queue is full and 'call' was not enqueued.
+  // - QUEUE_SUCCESS if 'call' was enqueued.
+  //
+  // In the case of a 'QUEUE_SUCCESS' response, the new element may have bumped
+  // another call out of the queue. In that case, *evicted will be set to the
+  // call that was bumped.
+  virtual QueueStatus Put(InboundCall* call, boost::optional<InboundCall*>* evicted) = 0;
+
+  // Shut down the queue.
+  // When a blocking queue is shut down, no more elements can be added to it,
+  // and Put() will return QUEUE_SHUTDOWN.
+  // Existing elements will drain out of it, and then BlockingGet will start
+  // returning false.
+  virtual void Shutdown() = 0;
+
+  virtual bool empty() const = 0;
+
+  virtual int max_size() const = 0;
+
+  virtual std::string ToString() const = 0;
+
+ protected:
+  // Comparison function which orders calls by their deadlines.
+  static bool DeadlineLess(const InboundCall* a,
+                           const InboundCall* b) {
+    auto time_a = a->GetClientDeadline();
+    auto time_b = b->GetClientDeadline();
+    if (time_a == time_b) {
+      // If two calls have the same deadline (most likely because neither one specified
+      // one) then we should order them by arrival order.
+      time_a = a->GetTimeReceived();
+      time_b = b->GetTimeReceived();
+    }
+    return time_a < time_b;
+  }
+
+  // Struct functor wrapper for DeadlineLess.
+  struct DeadlineLessStruct {
+    bool operator()(const InboundCall* a, const InboundCall* b) const {
+      return DeadlineLess(a, b);
+    }
+  };
+};
+
 // Blocking queue used for passing inbound RPC calls to the service handler pool.
 // Calls are dequeued in 'earliest-deadline first' order. The queue also maintains a
 // bounded number of calls. If the queue overflows, then calls with deadlines farthest
@@ -65,40 +125,25 @@ enum QueueStatus {
 // NOTE: because of the use of thread-local consumer records, once a consumer
 // thread accesses one LifoServiceQueue, it becomes "bound" to that queue and
 // must never access any other instance.
-class LifoServiceQueue {
+class LifoServiceQueue : public ServiceQueue {
  public:
   explicit LifoServiceQueue(int max_size);
 
   ~LifoServiceQueue();
 
-  // Get an element from the queue.  Returns false if we were shut down prior to
-  // getting the element.
-  bool BlockingGet(std::unique_ptr<InboundCall>* out);
+  bool BlockingGet(std::unique_ptr<InboundCall>* out) override;
 
-  // Add a new call to the queue.
-  // Returns:
-  // - QUEUE_SHUTDOWN if Shutdown() has already been called.
-  // - QUEUE_FULL if the queue is full and 'call' has a later deadline than any
-  //   RPC already in the queue.
-  // - QUEUE_SUCCESS if 'call' was enqueued.
-  //
-  // In the case of a 'QUEUE_SUCCESS' response, the new element may have bumped
-  // another call out of the queue. In that case, *evicted will be set to the
-  // call that was bumped.
-  QueueStatus Put(InboundCall* call, boost::optional<InboundCall*>* evicted);
+  // Returns QUEUE_FULL if the queue is full and 'call' has a later deadline
+  // than any RPC already in the queue.
+  QueueStatus Put(InboundCall* call, boost::optional<InboundCall*>* evicted) override;
 
-  // Shut down the queue.
-  // When a blocking queue is shut down, no more elements can be added to it,
-  // and Put() will return QUEUE_SHUTDOWN.
-  // Existing elements will drain out of it, and then BlockingGet will start
-  // returning false.
-  void Shutdown();
+  void Shutdown() override;
 
-  bool empty() const;
+  bool empty() const override;
 
-  int max_size() const;
+  int max_size() const override;
 
-  std::string ToString() const;
+  std::string ToString() const override;
 
   // Return an estimate of the current queue length.
   int estimated_queue_length() const {
@@ -122,27 +167,6 @@ class LifoServiceQueue {
   }
 
  private:
-  // Comparison function which orders calls by their deadlines.
-  static bool DeadlineLess(const InboundCall* a,
-                           const InboundCall* b) {
-    auto time_a = a->GetClientDeadline();
-    auto time_b = b->GetClientDeadline();
-    if (time_a == time_b) {
-      // If two calls have the same deadline (most likely because neither one specified
-      // one) then we should order them by arrival order.
-      time_a = a->GetTimeReceived();
-      time_b = b->GetTimeReceived();
-    }
-    return time_a < time_b;
-  }
-
-  // Struct functor wrapper for DeadlineLess.
-  struct DeadlineLessStruct {
-    bool operator()(const InboundCall* a, const InboundCall* b) const {
-      return DeadlineLess(a, b);
-    }
-  };
-
   // The thread-local record corresponding to a single consumer thread.
   // Threads push this record onto the waiting_consumers_ stack when
   // they are awaiting work. Producers pop the top waiting consumer and
@@ -209,6 +233,101 @@ class LifoServiceQueue {
   DISALLOW_COPY_AND_ASSIGN(LifoServiceQueue);
 };
 
+// Blocking queue which shares the service's workers among tenants (users or
+// client hosts, say) by weighted fair queuing, so that a tenant flooding the
+// service with calls doesn't starve the others.
+//
+// Each tenant's calls are dequeued in 'earliest-deadline first' order. The
+// tenants themselves are served by start-time fair queuing: each tenant with
+// queued calls is tagged with the virtual time at which its next call starts,
+// and dequeuing a call of a tenant with weight W moves the virtual time to
+// that tag and advances the tenant's tag by 1/W. The next call is always taken
+// from the tenant with the lowest tag, so while several tenants have calls
+// queued, each gets a share of the workers proportional to its weight, and a
+// tenant which was idle gets no credit for the time it was.
+//
+// If the queue is full, a new call evicts the latest-deadline call of the
+// tenant with the most queued calls relative to its weight. If that's the new
+// call's own tenant, the call is rejected instead, unless its deadline is
+// earlier.
+//
+// Unlike LifoServiceQueue there's no direct hand-off to waiting consumers,
+// since the order calls are served in depends on all of the queued ones.
+class FairServiceQueue : public ServiceQueue {
+ public:
+  // Returns the tenant a call belongs to.
+  typedef std::function<std::string(const InboundCall*)> TenantFunction;
+
+  // Tenants which aren't in 'tenant_weights' have a weight of 1.
+  FairServiceQueue(int max_size,
+                   TenantFunction tenant_function,
+                   std::unordered_map<std::string, int> tenant_weights);
+
+  ~FairServiceQueue();
+
+  bool BlockingGet(std::unique_ptr<InboundCall>* out) override;
+
+  QueueStatus Put(InboundCall* call, boost::optional<InboundCall*>* evicted) override;
+
+  void Shutdown() override;
+
+  bool empty() const override;
+
+  int max_size() const override;
+
+  std::string ToString() const override;
+
+  // Returns the tenant of 'call', as used to queue it.
+  std::string TenantOf(const InboundCall* call) const {
+    return tenant_function_(call);
+  }
+
+  // Parses tenant weights of the form "tenant1:weight1,tenant2:weight2" into
+  // 'weights'. Weights must be positive integers.
+  static Status ParseTenantWeights(const std::string& str,
+                                   std::unordered_map<std::string, int>* weights);
+
+ private:
+  struct Tenant {
+    explicit Tenant(int weight) : weight(weight), tag(0) {}
+
+    const int weight;
+
+    // The virtual start time of the tenant's next call if it has calls
+    // queued, or of the call after its last dequeued call otherwise.
+    double tag;
+
+    std::multiset<InboundCall*, DeadlineLessStruct> calls;
+  };
+
+  // Removes and returns the latest-deadline call of 'tenant', which must
+  // have calls queued.
+  InboundCall* RemoveLatestCallUnlocked(Tenant* tenant);
+
+  // Forgets tenants with no queued calls and no virtual time left to their
+  // credit, once there are many of them.
+  void MaybeRemoveIdleTenantsUnlocked();
+
+  const TenantFunction tenant_function_;
+  const std::unordered_map<std::string, int> tenant_weights_;
+
+  mutable Mutex lock_;
+  ConditionVariable not_empty_;
+  bool shutdown_;
+  const int max_queue_size_;
+  int queue_size_;
+
+  // The start tag of the latest dequeued call.
+  double virtual_time_;
+
+  std::unordered_map<std::string, std::unique_ptr<Tenant>> tenants_;
+
+  // The tenants with queued calls, ordered by their tags.
+  std::set<std::pair<double, Tenant*>> backlogged_tenants_;
+
+  DISALLOW_COPY_AND_ASSIGN(FairServiceQueue);
+};
+
 } // namespace rpc
 } // namespace kudu
 
@@ -18,7 +18,9 @@
 #include "kudu/rpc/transfer.h"
 
 #include <stdint.h>
+#include <sys/uio.h>
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -181,23 +183,37 @@ void OutboundTransfer::Abort(const Status &status) {
 Status OutboundTransfer::SendBuffer(Socket &socket) {
   CHECK_LT(cur_slice_idx_, n_payload_slices_);
 
-  int n_iovecs = n_payload_slices_ - cur_slice_idx_;
-  struct iovec iovec[n_iovecs];
-  {
-    int offset_in_slice = cur_offset_in_slice_;
-    for (int i = 0; i < n_iovecs; i++) {
-      Slice &slice = payload_slices_[cur_slice_idx_ + i];
-      iovec[i].iov_base = slice.mutable_data() + offset_in_slice;
-      iovec[i].iov_len = slice.size() - offset_in_slice;
-
-      offset_in_slice = 0;
-    }
-  }
+  struct iovec iovec[kMaxPayloadSlices];
+  bool complete;
+  int n_iovecs = AppendIovecs(iovec, kMaxPayloadSlices, &complete);
+  DCHECK(complete);
 
   int32_t written;
   Status status = socket.Writev(iovec, n_iovecs, &written);
   RETURN_ON_ERROR_OR_SOCKET_NOT_READY(status);
 
+  int32_t excess = ConsumeSent(written);
+  DCHECK_EQ(0, excess);
+  return Status::OK();
+}
+
+int OutboundTransfer::AppendIovecs(struct iovec* iov, int max_iovecs, bool* complete) const {
+  int n_iovecs = std::min<int>(n_payload_slices_ - cur_slice_idx_, max_iovecs);
+  int offset_in_slice = cur_offset_in_slice_;
+  for (int i = 0; i < n_iovecs; i++) {
+    const Slice &slice = payload_slices_[cur_slice_idx_ + i];
+    iov[i].iov_base = const_cast<uint8_t*>(slice.data()) + offset_in_slice;
+    iov[i].iov_len = slice.size() - offset_in_slice;
+
+    offset_in_slice = 0;
+  }
+  *complete = cur_slice_idx_ + n_iovecs == n_payload_slices_;
+  return n_iovecs;
+}
+
+int32_t OutboundTransfer::ConsumeSent(int32_t written) {
+  DCHECK_LT(cur_slice_idx_, n_payload_slices_);
+
   // Adjust our accounting of current writer position.
   for (int i = cur_slice_idx_; i < n_payload_slices_; i++) {
     Slice &slice = payload_slices_[i];
@@ -212,6 +228,7 @@ Status OutboundTransfer::SendBuffer(Socket &socket) {
     } else {
       // Partially used up this slice, just advance the offset within it.
       cur_offset_in_slice_ += written;
+      written = 0;
       break;
     }
   }
@@ -220,11 +237,12 @@ Status OutboundTransfer::SendBuffer(Socket &socket) {
     callbacks_->NotifyTransferFinished();
     DCHECK_EQ(0, cur_offset_in_slice_);
   } else {
+    DCHECK_EQ(0, written);
     DCHECK_LT(cur_slice_idx_, n_payload_slices_);
     DCHECK_LT(cur_offset_in_slice_, payload_slices_[cur_slice_idx_].size());
   }
 
-  return Status::OK();
+  return written;
 }
 
 bool OutboundTransfer::TransferStarted() const {
@@ -29,6 +29,8 @@
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/status.h"
 
+struct iovec;
+
 DECLARE_int32(rpc_max_message_size);
 
 namespace google {
@@ -130,6 +132,17 @@ class OutboundTransfer : public boost::intrusive::list_base_hook<> {
   // send from our buffers into the sock
   Status SendBuffer(Socket &socket);
 
+  // Fill 'iov' with up to 'max_iovecs' entries pointing to the data which
+  // remains to be sent, and return the number of entries filled. The data of
+  // several transfers can then be sent in a single writev(). Set 'complete'
+  // to whether all the remaining data fit.
+  int AppendIovecs(struct iovec* iov, int max_iovecs, bool* complete) const;
+
+  // Record that 'written' bytes of the data remaining to be sent were sent,
+  // finishing the transfer if they cover all of it. Return the number of bytes
+  // beyond the end of this transfer.
+  int32_t ConsumeSent(int32_t written);
+
   // Return true if any bytes have yet been sent.
   bool TransferStarted() const;
 
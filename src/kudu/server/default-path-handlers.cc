@@ -23,6 +23,7 @@
 #include <memory>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <boost/algorithm/string.hpp>
@@ -31,6 +32,7 @@
 
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/human_readable.h"
+#include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/server/pprof-path-handlers.h"
@@ -160,11 +162,84 @@ static void MemTrackersHandler(const Webserver::WebRequest& req, std::ostringstr
   *output << "</table>\n";
 }
 
+typedef std::unordered_map<const MemTracker*, vector<shared_ptr<MemTracker>>> MemTrackerChildren;
+
+// Writes 'tracker' and its descendants. 'untracked_bytes' is the part of
+// the consumption of a tracker which isn't charged to any of its children;
+// since the consumption of the root is the heap allocated by tcmalloc, for
+// the root it's the memory no subsystem accounts for.
+static void WriteMemTrackerJson(const shared_ptr<MemTracker>& tracker,
+                                const MemTrackerChildren& children,
+                                JsonWriter* writer) {
+  writer->StartObject();
+  writer->String("id");
+  writer->String(tracker->id());
+  writer->String("limit");
+  writer->Int64(tracker->limit());
+  writer->String("consumption");
+  writer->Int64(tracker->consumption());
+  writer->String("peak_consumption");
+  writer->Int64(tracker->peak_consumption());
+  int64_t untracked = tracker->consumption();
+  const vector<shared_ptr<MemTracker>>* tracker_children = FindOrNull(children, tracker.get());
+  if (tracker_children) {
+    writer->String("children");
+    writer->StartArray();
+    for (const shared_ptr<MemTracker>& child : *tracker_children) {
+      untracked -= child->consumption();
+      WriteMemTrackerJson(child, children, writer);
+    }
+    writer->EndArray();
+  }
+  writer->String("untracked_bytes");
+  writer->Int64(untracked);
+  writer->EndObject();
+}
+
+// Registered to handle "/mem-trackers-json", and dumps the tree of memory
+// trackers, which breaks the memory of each tablet down by structure, along
+// with the tcmalloc statistics to correlate it with.
+static void MemTrackersJsonHandler(const Webserver::WebRequest& req,
+                                   std::ostringstream* output) {
+  vector<shared_ptr<MemTracker>> trackers;
+  MemTracker::ListTrackers(&trackers);
+  MemTrackerChildren children;
+  for (const shared_ptr<MemTracker>& tracker : trackers) {
+    if (tracker->parent()) {
+      children[tracker->parent().get()].push_back(tracker);
+    }
+  }
+
+  JsonWriter writer(output, JsonWriter::PRETTY);
+  writer.StartObject();
+#ifdef TCMALLOC_ENABLED
+  writer.String("tcmalloc");
+  writer.StartObject();
+  for (const char* prop : { "generic.current_allocated_bytes",
+                            "generic.heap_size",
+                            "tcmalloc.pageheap_free_bytes",
+                            "tcmalloc.pageheap_unmapped_bytes",
+                            "tcmalloc.current_total_thread_cache_bytes" }) {
+    size_t value = 0;
+    if (MallocExtension::instance()->GetNumericProperty(prop, &value)) {
+      writer.String(prop);
+      writer.Int64(value);
+    }
+  }
+  writer.EndObject();
+#endif
+  writer.String("root");
+  WriteMemTrackerJson(MemTracker::GetRootTracker(), children, &writer);
+  writer.EndObject();
+}
+
 void AddDefaultPathHandlers(Webserver* webserver) {
   webserver->RegisterPathHandler("/logs", "Logs", LogsHandler);
   webserver->RegisterPathHandler("/varz", "Flags", FlagsHandler);
   webserver->RegisterPathHandler("/memz", "Memory (total)", MemUsageHandler);
   webserver->RegisterPathHandler("/mem-trackers", "Memory (detail)", MemTrackersHandler);
+  webserver->RegisterPathHandler("/mem-trackers-json", "", MemTrackersJsonHandler,
+                                 false /* is_styled */, false /* is_on_nav_bar */);
 
   AddPprofPathHandlers(webserver);
 }
@@ -216,4 +291,45 @@ void RegisterMetricsJsonHandler(Webserver* webserver, const MetricRegistry* cons
   webserver->RegisterPathHandler("/jsonmetricz", "Metrics", callback, not_styled, not_on_nav_bar);
 }
 
+// Takes the same 'metrics' argument as the JSON handler, along with:
+//   types: a comma-separated list of entity types.
+//   since_epoch: the epoch reported by a previous scrape, to only get the
+//     metrics modified since then.
+static void WriteMetricsAsPrometheus(const MetricRegistry* const metrics,
+                                     const Webserver::WebRequest& req,
+                                     std::ostringstream* output) {
+  vector<string> requested_metrics;
+  MetricPrometheusOptions opts;
+
+  const string* requested_metrics_param = FindOrNull(req.parsed_args, "metrics");
+  if (requested_metrics_param != nullptr) {
+    SplitStringUsing(*requested_metrics_param, ",", &requested_metrics);
+  } else {
+    requested_metrics.push_back("*");
+  }
+  const string* types_param = FindOrNull(req.parsed_args, "types");
+  if (types_param != nullptr) {
+    SplitStringUsing(*types_param, ",", &opts.entity_types);
+  }
+  const string* since_param = FindOrNull(req.parsed_args, "since_epoch");
+  if (since_param != nullptr &&
+      !safe_strto64(*since_param, &opts.only_modified_in_or_after_epoch)) {
+    (*output) << "# Invalid since_epoch: " << *since_param << "\n";
+    return;
+  }
+
+  WARN_NOT_OK(metrics->WriteAsPrometheus(output, requested_metrics, opts),
+              "Couldn't write Prometheus metrics over HTTP");
+}
+
+void RegisterMetricsPrometheusHandler(Webserver* webserver,
+                                      const MetricRegistry* const metrics) {
+  Webserver::PathHandlerCallback callback =
+      boost::bind(WriteMetricsAsPrometheus, metrics, _1, _2);
+  bool not_styled = false;
+  bool not_on_nav_bar = false;
+  webserver->RegisterPathHandler("/metrics_prometheus", "Prometheus Metrics", callback,
+                                 not_styled, not_on_nav_bar);
+}
+
 } // namespace kudu
@@ -32,6 +32,10 @@ void AddDefaultPathHandlers(Webserver* webserver);
 // Adds an endpoint to get metrics in JSON format.
 void RegisterMetricsJsonHandler(Webserver* webserver, const MetricRegistry* const metrics);
 
+// Adds an endpoint to get metrics in the Prometheus text format.
+void RegisterMetricsPrometheusHandler(Webserver* webserver,
+                                      const MetricRegistry* const metrics);
+
 } // namespace kudu
 
 #endif // KUDU_SERVER_DEFAULT_PATH_HANDLERS_H
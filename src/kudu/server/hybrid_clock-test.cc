@@ -26,6 +26,7 @@
 #include "kudu/util/test_util.h"
 
 DECLARE_bool(use_mock_wall_clock);
+DECLARE_int32(hybrid_clock_max_error_refresh_ms);
 
 namespace kudu {
 namespace server {
@@ -129,6 +130,28 @@ TEST_F(HybridClockTest, TestNow_ValuesIncreaseMonotonically) {
   ASSERT_LT(now1.value(), now2.value());
 }
 
+// Test that, between readings from the kernel, the maximum error grows with
+// time at no more than the maximum drift rate of the clock.
+TEST_F(HybridClockTest, TestMaxErrorExtrapolation) {
+  google::FlagSaver saver;
+  FLAGS_hybrid_clock_max_error_refresh_ms = 60 * 60 * 1000;
+  Timestamp ts1, ts2;
+  uint64_t error1, error2;
+  clock_->NowWithError(&ts1, &error1);
+  SleepFor(MonoDelta::FromMilliseconds(100));
+  clock_->NowWithError(&ts2, &error2);
+  ASSERT_GE(error2, error1);
+  uint64_t elapsed_usec = HybridClock::GetPhysicalValueMicros(ts2) -
+      HybridClock::GetPhysicalValueMicros(ts1);
+  // NTP allows drifting by up to 500 parts per million.
+  ASSERT_LE(error2 - error1, elapsed_usec / 1000 + 1);
+
+  // Without a refresh interval, the error is read for every timestamp.
+  FLAGS_hybrid_clock_max_error_refresh_ms = 0;
+  clock_->NowWithError(&ts1, &error1);
+  ASSERT_GT(ts1.value(), ts2.value());
+}
+
 // Tests the clock updates with the incoming value if it is higher.
 TEST_F(HybridClockTest, TestUpdate_LogicalValueIncreasesByAmount) {
   Timestamp now = clock_->Now();
@@ -18,7 +18,9 @@
 #include "kudu/server/hybrid_clock.h"
 
 #include <algorithm>
+#include <cmath>
 #include <glog/logging.h>
+#include <time.h>
 #include <mutex>
 
 #include "kudu/gutil/bind.h"
@@ -52,6 +54,14 @@ DEFINE_bool(use_mock_wall_clock, false,
             "instead of reading time from the system clock, for tests.");
 TAG_FLAG(use_mock_wall_clock, hidden);
 
+DEFINE_int32(hybrid_clock_max_error_refresh_ms, 1000,
+             "How often HybridClock reads the maximum clock error from the kernel, "
+             "in milliseconds. In between, the error is extrapolated at the maximum "
+             "drift rate of the clock, so that timestamps don't each cost a system "
+             "call. If 0, the error is read for every timestamp.");
+TAG_FLAG(hybrid_clock_max_error_refresh_ms, advanced);
+TAG_FLAG(hybrid_clock_max_error_refresh_ms, runtime);
+
 METRIC_DEFINE_gauge_uint64(server, hybrid_clock_timestamp,
                            "Hybrid Clock Timestamp",
                            kudu::MetricUnit::kMicroseconds,
@@ -132,11 +142,17 @@ const uint64_t HybridClock::kNanosPerSec = 1000000;
 
 const double HybridClock::kAdjtimexScalingFactor = 65536;
 
+// The tolerance NTP assumes for clocks, until the kernel's is read.
+static const double kDefaultMaxDriftPpm = 500;
+
 HybridClock::HybridClock()
     : mock_clock_time_usec_(0),
       mock_clock_max_error_usec_(0),
 #if !defined(__APPLE__)
       divisor_(1),
+      max_drift_ppm_(kDefaultMaxDriftPpm),
+      max_error_read_usec_(0),
+      max_error_usec_(0),
 #endif
       tolerance_adjustment_(1),
       next_timestamp_(0),
@@ -172,7 +188,11 @@ Status HybridClock::Init() {
 
   // Calculate the sleep skew adjustment according to the max tolerance of the clock.
   // Tolerance comes in parts per million but needs to be applied a scaling factor.
-  tolerance_adjustment_ = (1 + ((timex.tolerance / kAdjtimexScalingFactor) / 1000000.0));
+  max_drift_ppm_ = timex.tolerance / kAdjtimexScalingFactor;
+  tolerance_adjustment_ = (1 + (max_drift_ppm_ / 1000000.0));
+
+  // Read the error again now that the drift rate is known.
+  RETURN_NOT_OK(RefreshMaxError(&now_usec, &error_usec));
 
   LOG(INFO) << "HybridClock initialized. Resolution in nanos?: " << (divisor_ == 1000)
             << " Wait times tolerance adjustment: " << tolerance_adjustment_
@@ -371,11 +391,10 @@ bool HybridClock::IsAfter(Timestamp t) {
   // a time update.
   uint64_t now_usec;
   uint64_t error_usec;
-  CHECK_OK(WalltimeWithError(&now_usec, &error_usec));
-
   Timestamp now;
   {
     std::lock_guard<simple_spinlock> lock(lock_);
+    CHECK_OK(WalltimeWithError(&now_usec, &error_usec));
     now = Timestamp(std::max(next_timestamp_, now_usec << kBitsToShift));
   }
   return t.value() < now.value();
@@ -394,11 +413,22 @@ kudu::Status HybridClock::WalltimeWithError(uint64_t* now_usec, uint64_t* error_
     *error_usec = 0;
   }
 #else
-    // Read the time. This will return an error if the clock is not synchronized.
-    ntptimeval timeval;
-    RETURN_NOT_OK(GetClockTime(&timeval));
-    *now_usec = timeval.time.tv_sec * kNanosPerSec + timeval.time.tv_usec / divisor_;
-    *error_usec = timeval.maxerror;
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    *now_usec = now.tv_sec * kNanosPerSec + now.tv_nsec / 1000;
+
+    // Extrapolate the error from its last reading, unless that's too old or
+    // the clock was stepped back since.
+    int64_t since_read_usec = *now_usec - max_error_read_usec_;
+    if (max_error_read_usec_ == 0 ||
+        since_read_usec < 0 ||
+        since_read_usec >= FLAGS_hybrid_clock_max_error_refresh_ms * 1000LL) {
+      // This will return an error if the clock is not synchronized.
+      RETURN_NOT_OK(RefreshMaxError(now_usec, error_usec));
+    } else {
+      *error_usec = max_error_usec_ +
+          static_cast<uint64_t>(ceil(since_read_usec * max_drift_ppm_ / 1000000.0));
+    }
   }
 
   // If the clock is synchronized but has max_error beyond max_clock_sync_error_usec
@@ -411,6 +441,18 @@ kudu::Status HybridClock::WalltimeWithError(uint64_t* now_usec, uint64_t* error_
   return kudu::Status::OK();
 }
 
+#if !defined(__APPLE__)
+kudu::Status HybridClock::RefreshMaxError(uint64_t* now_usec, uint64_t* error_usec) {
+  ntptimeval timeval;
+  RETURN_NOT_OK(GetClockTime(&timeval));
+  *now_usec = timeval.time.tv_sec * kNanosPerSec + timeval.time.tv_usec / divisor_;
+  *error_usec = timeval.maxerror;
+  max_error_read_usec_ = *now_usec;
+  max_error_usec_ = *error_usec;
+  return kudu::Status::OK();
+}
+#endif // !defined(__APPLE__)
+
 void HybridClock::SetMockClockWallTimeForTests(uint64_t now_usec) {
   CHECK(FLAGS_use_mock_wall_clock);
   std::lock_guard<simple_spinlock> lock(lock_);
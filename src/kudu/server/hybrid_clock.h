@@ -165,9 +165,23 @@ class HybridClock : public Clock {
   // Obtains the current wallclock time and maximum error in microseconds,
   // and checks if the clock is synchronized.
   //
+  // The time is read with clock_gettime(), which doesn't enter the kernel.
+  // The maximum error is only read from the kernel once it's older than
+  // --hybrid_clock_max_error_refresh_ms; in between, it's extrapolated from
+  // the last reading at the maximum drift rate of the clock. As a result, a
+  // clock becoming unsynchronized is noticed up to that much later.
+  //
+  // Requires 'lock_' to be held, except during Init().
+  //
   // On OS X, the error will always be 0.
   kudu::Status WalltimeWithError(uint64_t* now_usec, uint64_t* error_usec);
 
+#if !defined(__APPLE__)
+  // Reads the current time and maximum error from the kernel, and caches the
+  // latter for WalltimeWithError().
+  kudu::Status RefreshMaxError(uint64_t* now_usec, uint64_t* error_usec);
+#endif
+
   // Used to get the timestamp for metrics.
   uint64_t NowForMetrics();
 
@@ -184,6 +198,14 @@ class HybridClock : public Clock {
 
 #if !defined(__APPLE__)
   uint64_t divisor_;
+
+  // The maximum drift rate of the clock, in parts per million.
+  double max_drift_ppm_;
+
+  // The wall time at which 'max_error_usec_' was read from the kernel, or 0
+  // if it hasn't been yet.
+  uint64_t max_error_read_usec_;
+  uint64_t max_error_usec_;
 #endif
 
   double tolerance_adjustment_;
@@ -35,6 +35,7 @@
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/sysinfo.h"
 #include "kudu/server/webserver.h"
+#include "kudu/util/continuous_profiler.h"
 #include "kudu/util/env.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/monotime.h"
@@ -172,6 +173,19 @@ static void PprofContentionHandler(const Webserver::WebRequest& req, ostringstre
 #endif // defined(__linux__)
 }
 
+// The samples of the continuous profiler, as folded stacks for flamegraph.pl.
+// '?type=contention' returns the lock contention samples rather than the CPU
+// samples.
+static void ContinuousProfileHandler(const Webserver::WebRequest& req, ostringstream* output) {
+  string type = FindWithDefault(req.parsed_args, "type", "cpu");
+  if (type == "cpu") {
+    DumpContinuousCpuProfile(output);
+  } else if (type == "contention") {
+    DumpContinuousContentionProfile(output);
+  } else {
+    *output << "Unknown profile type: " << type;
+  }
+}
 
 // pprof asks for the url /pprof/symbol to map from hex addresses to variable names.
 // When the server receives a GET request for /pprof/symbol, it should return a line
@@ -235,6 +249,7 @@ void AddPprofPathHandlers(Webserver* webserver) {
   webserver->RegisterPathHandler("/pprof/profile", "", PprofCpuProfileHandler, false, false);
   webserver->RegisterPathHandler("/pprof/symbol", "", PprofSymbolHandler, false, false);
   webserver->RegisterPathHandler("/pprof/contention", "", PprofContentionHandler, false, false);
+  webserver->RegisterPathHandler("/pprof/continuous", "", ContinuousProfileHandler, false, false);
 }
 
 } // namespace kudu
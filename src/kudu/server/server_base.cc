@@ -43,6 +43,7 @@
 #include "kudu/server/server_base.pb.h"
 #include "kudu/server/tracing-path-handlers.h"
 #include "kudu/util/atomic.h"
+#include "kudu/util/continuous_profiler.h"
 #include "kudu/util/env.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/jsonwriter.h"
@@ -105,6 +106,7 @@ ServerBase::ServerBase(string name, const ServerBaseOptions& options,
   fs_opts.parent_mem_tracker = mem_tracker_;
   fs_opts.wal_path = options.fs_opts.wal_path;
   fs_opts.data_paths = options.fs_opts.data_paths;
+  fs_opts.direct_reads = options.fs_opts.direct_reads;
   fs_manager_.reset(new FsManager(options.env, fs_opts));
 
   if (FLAGS_use_hybrid_clock) {
@@ -157,6 +159,7 @@ Status ServerBase::Init() {
   RegisterSpinLockContentionMetrics(metric_entity_);
 
   InitSpinLockContentionProfiling();
+  WARN_NOT_OK(StartContinuousProfiling(), "Unable to start continuous profiling");
 
   // Initialize the clock immediately. This checks that the clock is synchronized
   // so we're less likely to get into a partially initialized state on disk during startup
@@ -314,6 +317,7 @@ Status ServerBase::Start() {
   AddDefaultPathHandlers(web_server_.get());
   AddRpczPathHandlers(messenger_, web_server_.get());
   RegisterMetricsJsonHandler(web_server_.get(), metric_registry_.get());
+  RegisterMetricsPrometheusHandler(web_server_.get(), metric_registry_.get());
   TracingPathHandlers::RegisterHandlers(web_server_.get());
   web_server_->set_footer_html(FooterHtml());
   RETURN_NOT_OK(web_server_->Start());
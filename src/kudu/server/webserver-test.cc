@@ -94,6 +94,16 @@ TEST_F(WebserverTest, TestDefaultPaths) {
   ASSERT_STR_CONTAINS(buf_.ToString(), "--v=");
 }
 
+TEST_F(WebserverTest, TestMemTrackersJson) {
+  ASSERT_OK(curl_.FetchURL(strings::Substitute("http://$0/mem-trackers-json", addr_.ToString()),
+                           &buf_));
+  ASSERT_STR_CONTAINS(buf_.ToString(), "\"id\": \"root\"");
+  ASSERT_STR_CONTAINS(buf_.ToString(), "untracked_bytes");
+#ifdef TCMALLOC_ENABLED
+  ASSERT_STR_CONTAINS(buf_.ToString(), "generic.current_allocated_bytes");
+#endif
+}
+
 // Used in symbolization test below.
 void SomeMethodForSymbolTest1() {}
 // Used in symbolization test below.
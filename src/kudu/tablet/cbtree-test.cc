@@ -15,11 +15,13 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <atomic>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <thread>
 #include <unordered_set>
 
+#include "kudu/gutil/endian.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/tablet/concurrent_btree.h"
 #include "kudu/util/barrier.h"
@@ -295,6 +297,37 @@ TEST_F(TestCBTree, TestInsertAndVerify) {
   }
 }
 
+// Test inserting values that were allocated up front in the tree's arena,
+// including across leaf splits.
+TEST_F(TestCBTree, TestInsertPreallocated) {
+  CBTree<SmallFanoutTraits> t;
+  char kbuf[64];
+  char vbuf[64];
+
+  int n_keys = 10000;
+
+  for (int i = 0; i < n_keys; i++) {
+    snprintf(kbuf, sizeof(kbuf), "key_%d", i);
+    int len = snprintf(vbuf, sizeof(vbuf), "val_%d", i);
+
+    Slice key(kbuf);
+    PreparedMutation<SmallFanoutTraits> pm(key);
+    pm.Prepare(&t);
+    ASSERT_FALSE(pm.exists());
+    uint8_t* val = ValueSlice::Allocate(len, 0, pm.arena());
+    ASSERT_TRUE(val != nullptr);
+    memcpy(val, vbuf, len);
+    ASSERT_TRUE(pm.InsertPreallocated(Slice(val, len)))
+      << "Failed insert at iteration " << i;
+  }
+
+  for (int i = 0; i < n_keys; i++) {
+    snprintf(kbuf, sizeof(kbuf), "key_%d", i);
+    snprintf(vbuf, sizeof(vbuf), "val_%d", i);
+    VerifyGet(t, Slice(kbuf), Slice(vbuf));
+  }
+}
+
 template<class TREE, class COLLECTION>
 static void InsertRandomKeys(TREE *t, int n_keys,
                              COLLECTION *inserted) {
@@ -471,6 +504,61 @@ void TestCBTree::DoTestConcurrentInsert() {
   }
 }
 
+// Inserts keys taken in increasing order from a shared counter until
+// 'n_keys' have been inserted.
+template<class T>
+static void InsertSequentialKeys(CBTree<T> *tree,
+                                 std::atomic<uint32_t> *next_key,
+                                 uint32_t n_keys) {
+  char kbuf[sizeof(uint32_t)];
+  uint32_t key;
+  while ((key = (*next_key)++) < n_keys) {
+    BigEndian::Store32(kbuf, key);
+    CHECK(tree->Insert(Slice(kbuf, sizeof(kbuf)), Slice("val")));
+  }
+}
+
+// Test concurrent inserts of monotonically increasing keys, which go
+// through the append path at the right edge of the tree.
+template<class TraitsClass>
+void DoTestConcurrentSequentialInsert() {
+  const int kNumThreads = 8;
+  const uint32_t kNumKeys = AllowSlowTests() ? 1000000 : 50000;
+
+  CBTree<TraitsClass> tree;
+  std::atomic<uint32_t> next_key(0);
+  vector<thread> threads;
+  for (int i = 0; i < kNumThreads; i++) {
+    threads.emplace_back(InsertSequentialKeys<TraitsClass>, &tree, &next_key, kNumKeys);
+  }
+  for (thread &thr : threads) {
+    thr.join();
+  }
+
+  // Every key should be present, in order.
+  gscoped_ptr<CBTreeIterator<TraitsClass> > iter(tree.NewIterator());
+  bool exact;
+  ASSERT_TRUE(iter->SeekAtOrAfter(Slice(""), &exact));
+  uint32_t count = 0;
+  while (iter->IsValid()) {
+    Slice k, v;
+    iter->GetCurrentEntry(&k, &v);
+    ASSERT_EQ(sizeof(uint32_t), k.size());
+    ASSERT_EQ(count, BigEndian::Load32(k.data()));
+    count++;
+    iter->Next();
+  }
+  ASSERT_EQ(kNumKeys, count);
+}
+
+TEST_F(TestCBTree, TestConcurrentSequentialInsert) {
+  DoTestConcurrentSequentialInsert<SmallFanoutTraits>();
+}
+
+TEST_F(TestCBTree, TestRacyConcurrentSequentialInsert) {
+  DoTestConcurrentSequentialInsert<RacyTraits>();
+}
+
 TEST_F(TestCBTree, TestIterator) {
   CBTree<SmallFanoutTraits> t;
 
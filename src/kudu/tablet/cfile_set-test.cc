@@ -26,6 +26,7 @@
 #include "kudu/util/test_util.h"
 
 DECLARE_int32(cfile_default_block_size);
+DECLARE_int32(sampled_scan_unit_rows);
 
 using std::shared_ptr;
 
@@ -108,6 +109,7 @@ class TestCFileSet : public KuduRowSetTest {
                            size_t col_idx,
                            ColumnBlock *cb) {
     SelectionVector sel(cb->nrows());
+    sel.SetAllTrue();
     ColumnMaterializationContext ctx(col_idx, nullptr, cb, &sel);
     return iter->MaterializeColumn(&ctx);
   }
@@ -317,6 +319,54 @@ TEST_F(TestCFileSet, TestRangePredicates2) {
   DoTestRangeScan(fileset, kNumRows * 10, kNoBound);
 }
 
+// Sampled scans read whole units of rows, the same ones for the same seed,
+// with every column of a row read from the same ordinal.
+TEST_F(TestCFileSet, TestSampledScan) {
+  const int kNumRows = 10000;
+  const int kUnitRows = 100;
+  FLAGS_sampled_scan_unit_rows = kUnitRows;
+  WriteTestRowSet(kNumRows);
+
+  shared_ptr<CFileSet> fileset(new CFileSet(rowset_meta_));
+  ASSERT_OK(fileset->Open());
+
+  vector<string> first_results;
+  for (int attempt = 0; attempt < 2; attempt++) {
+    shared_ptr<CFileSet::Iterator> cfile_iter(fileset->NewIterator(&schema_));
+    gscoped_ptr<RowwiseIterator> iter(new MaterializingIterator(cfile_iter));
+    ScanSpec spec;
+    ScanSample sample;
+    sample.rate = 0.3;
+    sample.seed = 7;
+    spec.set_sample(sample);
+    auto stats = std::make_shared<ScanSamplingStats>();
+    spec.set_sampling_stats(stats);
+    ASSERT_OK(iter->Init(&spec));
+
+    vector<string> results;
+    ASSERT_OK(IterateToStringList(iter.get(), &results));
+    ASSERT_GT(results.size(), 0);
+    ASSERT_LT(results.size(), kNumRows);
+    ASSERT_EQ(0, results.size() % kUnitRows);
+    for (int i = 0; i < results.size(); i += kUnitRows) {
+      uint32_t c0, c1, c2;
+      ASSERT_EQ(3, sscanf(results[i].c_str(), "(uint32 c0=%u, uint32 c1=%u, uint32 c2=%u)",
+                          &c0, &c1, &c2));
+      ASSERT_EQ(0, (c0 / 2) % kUnitRows) << results[i];
+      ASSERT_EQ(c0 * 5, c1);
+      ASSERT_EQ(c0 * 50, c2);
+    }
+    ASSERT_EQ(kNumRows, stats->rows_considered);
+    ASSERT_EQ(results.size(), stats->rows_sampled);
+    ASSERT_DOUBLE_EQ(static_cast<double>(results.size()) / kNumRows, stats->effective_rate());
+
+    if (attempt == 0) {
+      first_results = results;
+    } else {
+      ASSERT_EQ(first_results, results);
+    }
+  }
+}
 
 } // namespace tablet
 } // namespace kudu
@@ -24,18 +24,27 @@
 #include "kudu/cfile/cfile_writer.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/common/column_materialization_context.h"
+#include "kudu/common/key_encoder.h"
+#include "kudu/common/rowblock.h"
 #include "kudu/gutil/dynamic_annotations.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/tablet/diskrowset.h"
 #include "kudu/tablet/cfile_set.h"
+#include "kudu/tablet/tablet.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/mem_tracker.h"
 
 DEFINE_bool(consult_bloom_filters, true, "Whether to consult bloom filters on row presence checks");
 TAG_FLAG(consult_bloom_filters, hidden);
 
+DEFINE_int32(sampled_scan_unit_rows, 8192,
+             "Number of consecutive rows of a flushed rowset which sampled scans "
+             "either read or skip as a whole.");
+TAG_FLAG(sampled_scan_unit_rows, advanced);
+
 namespace kudu {
 namespace tablet {
 
@@ -49,8 +58,15 @@ using strings::Substitute;
 // Utilities
 ////////////////////////////////////////////////////////////
 
+static shared_ptr<MemTracker> FindOrCreateChildTracker(
+    const char* id, const shared_ptr<MemTracker>& parent) {
+  return parent ? MemTracker::FindOrCreateTracker(-1, id, parent) :
+      MemTracker::GetRootTracker();
+}
+
 static Status OpenReader(const shared_ptr<RowSetMetadata>& rowset_metadata,
                          ColumnId col_id,
+                         const shared_ptr<MemTracker>& mem_tracker,
                          gscoped_ptr<CFileReader> *new_reader) {
   FsManager* fs = rowset_metadata->fs_manager();
   gscoped_ptr<ReadableBlock> block;
@@ -59,6 +75,7 @@ static Status OpenReader(const shared_ptr<RowSetMetadata>& rowset_metadata,
 
   // TODO: somehow pass reader options in schema
   ReaderOptions opts;
+  opts.parent_mem_tracker = mem_tracker;
   return CFileReader::OpenNoInit(std::move(block), opts, new_reader);
 }
 
@@ -66,8 +83,13 @@ static Status OpenReader(const shared_ptr<RowSetMetadata>& rowset_metadata,
 // CFile Base
 ////////////////////////////////////////////////////////////
 
-CFileSet::CFileSet(shared_ptr<RowSetMetadata> rowset_metadata)
-    : rowset_metadata_(std::move(rowset_metadata)) {}
+CFileSet::CFileSet(shared_ptr<RowSetMetadata> rowset_metadata,
+                   const shared_ptr<MemTracker>& parent_mem_tracker)
+    : rowset_metadata_(std::move(rowset_metadata)),
+      reader_mem_tracker_(FindOrCreateChildTracker(Tablet::kCFileReaderMemTrackerId,
+                                                   parent_mem_tracker)),
+      bloom_mem_tracker_(FindOrCreateChildTracker(Tablet::kBloomFilterMemTrackerId,
+                                                  parent_mem_tracker)) {}
 
 CFileSet::~CFileSet() {
 }
@@ -84,7 +106,7 @@ Status CFileSet::Open() {
     DCHECK(!ContainsKey(readers_by_col_id_, col_id)) << "already open";
 
     gscoped_ptr<CFileReader> reader;
-    RETURN_NOT_OK(OpenReader(rowset_metadata_, col_id, &reader));
+    RETURN_NOT_OK(OpenReader(rowset_metadata_, col_id, reader_mem_tracker_, &reader));
     readers_by_col_id_[col_id] = shared_ptr<CFileReader>(reader.release());
     VLOG(1) << "Successfully opened cfile for column id " << col_id
             << " in " << rowset_metadata_->ToString();
@@ -114,6 +136,7 @@ Status CFileSet::OpenAdHocIndexReader() {
   RETURN_NOT_OK(fs->OpenBlock(rowset_metadata_->adhoc_index_block(), &block));
 
   ReaderOptions opts;
+  opts.parent_mem_tracker = reader_mem_tracker_;
   return CFileReader::Open(std::move(block), opts, &ad_hoc_idx_reader_);
 }
 
@@ -128,6 +151,7 @@ Status CFileSet::OpenBloomReader() {
   RETURN_NOT_OK(fs->OpenBlock(rowset_metadata_->bloom_block(), &block));
 
   ReaderOptions opts;
+  opts.parent_mem_tracker = bloom_mem_tracker_;
   Status s = BloomFileReader::OpenNoInit(std::move(block), opts, &bloom_reader_);
   if (!s.ok()) {
     LOG(WARNING) << "Unable to open bloom file in " << rowset_metadata_->ToString() << ": "
@@ -196,6 +220,112 @@ uint64_t CFileSet::EstimateOnDiskSize() const {
   return ret;
 }
 
+uint64_t CFileSet::EstimateOnDiskSizeForColumn(ColumnId col_id) const {
+  const shared_ptr<CFileReader>* reader = FindOrNull(readers_by_col_id_, col_id);
+  return reader == nullptr ? 0 : (*reader)->file_size();
+}
+
+Status CFileSet::GetNdvSketch(ColumnId col_id, string* sketch) const {
+  const shared_ptr<CFileReader>* reader = FindOrNull(readers_by_col_id_, col_id);
+  if (reader == nullptr || !(*reader)->footer().has_ndv_sketch()) {
+    return Status::NotFound("no distinct value sketch for column", ToString());
+  }
+  *sketch = (*reader)->footer().ndv_sketch();
+  return Status::OK();
+}
+
+void CFileSet::GetHotBlocks(HotBlocksPB* hot_blocks) const {
+  auto add_blocks = [&](const CFileReader& reader, const ColumnId* col_id) {
+    vector<cfile::BlockPointer> blocks;
+    reader.GetHotBlocks(&blocks);
+    for (const auto& ptr : blocks) {
+      HotBlocksPB::HotBlockPB* hot = hot_blocks->add_blocks();
+      reader.block_id().CopyToPB(hot->mutable_block());
+      hot->set_offset(ptr.offset());
+      hot->set_size(ptr.size());
+      if (col_id) {
+        hot->set_column_id(*col_id);
+      }
+    }
+  };
+  for (const auto& e : readers_by_col_id_) {
+    ColumnId col_id(e.first);
+    add_blocks(*e.second, &col_id);
+  }
+  if (ad_hoc_idx_reader_) {
+    add_blocks(*ad_hoc_idx_reader_, nullptr);
+  }
+}
+
+Status CFileSet::WarmUpBlockCache(const HotBlocksPB& hot_blocks, int* num_loaded) {
+  std::unordered_map<BlockId, vector<cfile::BlockPointer>, BlockIdHash, BlockIdEqual> blocks;
+  for (const auto& hot : hot_blocks.blocks()) {
+    blocks[BlockId::FromPB(hot.block())].emplace_back(hot.offset(), hot.size());
+  }
+  auto warm_up = [&](CFileReader* reader) -> Status {
+    const vector<cfile::BlockPointer>* file_blocks = FindOrNull(blocks, reader->block_id());
+    if (file_blocks) {
+      RETURN_NOT_OK(reader->WarmUp(*file_blocks, num_loaded));
+    }
+    return Status::OK();
+  };
+
+  for (int col_id : hot_blocks.column_ids()) {
+    shared_ptr<CFileReader>* reader = FindOrNull(readers_by_col_id_, col_id);
+    if (reader) {
+      RETURN_NOT_OK((*reader)->WarmUpIndex(num_loaded));
+    }
+  }
+  for (const auto& e : readers_by_col_id_) {
+    RETURN_NOT_OK(warm_up(e.second.get()));
+  }
+  if (ad_hoc_idx_reader_) {
+    RETURN_NOT_OK(warm_up(ad_hoc_idx_reader_.get()));
+  }
+  return Status::OK();
+}
+
+Status CFileSet::GetKeySamples(int num_samples, vector<string>* keys) const {
+  rowid_t num_rows;
+  RETURN_NOT_OK(CountRows(&num_rows));
+  if (num_rows == 0 || num_samples <= 0) {
+    return Status::OK();
+  }
+
+  CFileIterator *key_iter = nullptr;
+  RETURN_NOT_OK(NewKeyIterator(&key_iter));
+  gscoped_ptr<CFileIterator> key_iter_scoped(key_iter); // free on return
+
+  // The ad-hoc index holds the encoded keys themselves. Otherwise, the key
+  // is the value of the single key column, which must be encoded.
+  const TypeInfo* type = key_index_reader()->type_info();
+  const KeyEncoder<faststring>* encoder =
+      ad_hoc_idx_reader_ ? nullptr : &GetKeyEncoder<faststring>(type);
+
+  Arena arena(1024, 1024 * 1024);
+  vector<uint8_t> cell(type->size());
+  ColumnBlock block(type, nullptr, cell.data(), 1, &arena);
+  SelectionVector sel(1);
+  sel.SetAllTrue();
+  ColumnMaterializationContext ctx(0, nullptr, &block, &sel);
+  faststring encoded;
+  for (int i = 0; i < num_samples; i++) {
+    rowid_t ord = static_cast<uint64_t>(num_rows) * i / num_samples;
+    RETURN_NOT_OK(key_iter->SeekToOrdinal(ord));
+    size_t n = 1;
+    RETURN_NOT_OK(key_iter->CopyNextValues(&n, &ctx));
+    if (encoder) {
+      encoded.clear();
+      encoder->Encode(cell.data(), true, &encoded);
+      keys->push_back(encoded.ToString());
+    } else {
+      keys->push_back(reinterpret_cast<const Slice*>(cell.data())->ToString());
+    }
+    arena.Reset();
+  }
+  return Status::OK();
+}
+
 Status CFileSet::FindRow(const RowSetKeyProbe &probe, rowid_t *idx,
                          ProbeStats* stats) const {
   if (bloom_reader_ != nullptr && FLAGS_consult_bloom_filters) {
@@ -224,12 +354,34 @@ Status CFileSet::FindRow(const RowSetKeyProbe &probe, rowid_t *idx,
   gscoped_ptr<CFileIterator> key_iter_scoped(key_iter); // free on return
 
   bool exact;
-  RETURN_NOT_OK(key_iter->SeekAtOrAfter(probe.encoded_key(), &exact));
+  RETURN_NOT_OK(key_iter->LookupKey(probe.encoded_key(), &exact, idx));
   if (!exact) {
     return Status::NotFound("not present in storefile (failed seek)");
   }
+  return Status::OK();
+}
 
-  *idx = key_iter->GetCurrentOrdinal();
+Status CFileSet::CheckRowsMaybePresent(const RowSetKeyProbe* const* probes, size_t n,
+                                       bool* maybe_present,
+                                       ProbeStats* const* stats) const {
+  std::fill(maybe_present, maybe_present + n, true);
+  if (bloom_reader_ == nullptr || !FLAGS_consult_bloom_filters || n == 0) {
+    return Status::OK();
+  }
+  RETURN_NOT_OK(bloom_reader_->Init());
+
+  std::vector<const BloomKeyProbe*> bloom_probes(n);
+  for (size_t i = 0; i < n; i++) {
+    bloom_probes[i] = &probes[i]->bloom_probe();
+    stats[i]->blooms_consulted++;
+  }
+  Status s = bloom_reader_->CheckKeysPresent(bloom_probes.data(), n, maybe_present);
+  if (!s.ok()) {
+    LOG(WARNING) << "Unable to query bloom: " << s.ToString()
+                 << " (disabling bloom for this rowset from this point forward)";
+    const_cast<CFileSet *>(this)->bloom_reader_.reset(nullptr);
+    std::fill(maybe_present, maybe_present + n, true);
+  }
   return Status::OK();
 }
 
@@ -292,6 +444,9 @@ Status CFileSet::Iterator::CreateColumnIterators(const ScanSpec* spec) {
     RETURN_NOT_OK_PREPEND(base_data_->NewColumnIterator(col_id, cache_blocks, &iter),
                           Substitute("could not create iterator for column $0",
                                      projection_->column(proj_col_idx).ToString()));
+    if (spec && spec->readahead_mem_tracker()) {
+      iter->EnableReadahead(spec->readahead_mem_tracker());
+    }
     ret_iters.push_back(iter);
   }
 
@@ -314,15 +469,48 @@ Status CFileSet::Iterator::Init(ScanSpec *spec) {
   // ordinal range.
   RETURN_NOT_OK(PushdownRangeScanPredicate(spec));
 
+  if (spec != nullptr && spec->sample().is_sampled()) {
+    sample_ = spec->sample();
+    sampling_stats_ = spec->sampling_stats();
+    unit_rows_ = std::max(1, FLAGS_sampled_scan_unit_rows);
+  }
+
   initted_ = true;
 
   // Don't actually seek -- we'll seek when we first actually read the
   // data.
   cur_idx_ = lower_bound_idx_;
+  SkipUnsampledRows();
   Unprepare(); // Reset state.
   return Status::OK();
 }
 
+void CFileSet::Iterator::SkipUnsampledRows() {
+  if (!sample_.is_sampled() || cur_idx_ < sampled_end_idx_) {
+    return;
+  }
+  int64_t considered = 0;
+  int64_t sampled = 0;
+  while (cur_idx_ < upper_bound_idx_) {
+    // Units are aligned on multiples of unit_rows_, so that every scan of
+    // the rowset picks the same ones whatever its bounds.
+    uint64_t unit[2] = { static_cast<uint64_t>(base_data_->rowset_metadata_->id()),
+                         cur_idx_ / unit_rows_ };
+    size_t unit_end = std::min<size_t>((unit[1] + 1) * unit_rows_, upper_bound_idx_);
+    considered += unit_end - cur_idx_;
+    if (sample_.Samples(Slice(reinterpret_cast<const uint8_t*>(unit), sizeof(unit)))) {
+      sampled += unit_end - cur_idx_;
+      sampled_end_idx_ = unit_end;
+      break;
+    }
+    cur_idx_ = unit_end;
+  }
+  if (sampling_stats_) {
+    sampling_stats_->rows_considered += considered;
+    sampling_stats_->rows_sampled += sampled;
+  }
+}
+
 Status CFileSet::Iterator::PushdownRangeScanPredicate(ScanSpec *spec) {
   CHECK_GT(row_count_, 0);
 
@@ -391,7 +579,9 @@ void CFileSet::Iterator::Unprepare() {
 Status CFileSet::Iterator::PrepareBatch(size_t *n) {
   DCHECK_EQ(prepared_count_, 0) << "Already prepared";
 
-  size_t remaining = upper_bound_idx_ - cur_idx_;
+  // Only the rest of the sampled unit is read by a sampled scan: the next
+  // batch starts wherever the next sampled unit does.
+  size_t remaining = (sample_.is_sampled() ? sampled_end_idx_ : upper_bound_idx_) - cur_idx_;
   if (*n > remaining) {
     *n = remaining;
   }
@@ -470,6 +660,7 @@ Status CFileSet::Iterator::FinishBatch() {
   }
 
   cur_idx_ += prepared_count_;
+  SkipUnsampledRows();
   Unprepare();
 
   return Status::OK();
@@ -27,6 +27,7 @@
 #include "kudu/cfile/cfile_reader.h"
 
 #include "kudu/common/iterator.h"
+#include "kudu/common/scan_spec.h"
 #include "kudu/common/schema.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/map-util.h"
@@ -57,7 +58,11 @@ class CFileSet : public std::enable_shared_from_this<CFileSet> {
  public:
   class Iterator;
 
-  explicit CFileSet(std::shared_ptr<RowSetMetadata> rowset_metadata);
+  // The memory of the readers is charged to children of 'parent_mem_tracker',
+  // or to the root tracker if it's null.
+  explicit CFileSet(std::shared_ptr<RowSetMetadata> rowset_metadata,
+                    const std::shared_ptr<MemTracker>& parent_mem_tracker =
+                    std::shared_ptr<MemTracker>());
 
   Status Open();
 
@@ -73,6 +78,13 @@ class CFileSet : public std::enable_shared_from_this<CFileSet> {
 
   uint64_t EstimateOnDiskSize() const;
 
+  // Estimate the number of bytes on disk taken by the base data of column
+  // 'col_id', or 0 if this CFileSet has no data for it.
+  uint64_t EstimateOnDiskSizeForColumn(ColumnId col_id) const;
+
+  // See RowSet::GetKeySamples. The keys are read from the key index.
+  Status GetKeySamples(int num_samples, std::vector<std::string>* keys) const;
+
   // Determine the index of the given row key.
   Status FindRow(const RowSetKeyProbe &probe, rowid_t *idx, ProbeStats* stats) const;
 
@@ -85,11 +97,32 @@ class CFileSet : public std::enable_shared_from_this<CFileSet> {
   Status CheckRowPresent(const RowSetKeyProbe &probe, bool *present,
                          rowid_t *rowid, ProbeStats* stats) const;
 
+  // Check a batch of keys, sorted by key, against the bloom filter. Sets
+  // maybe_present[i] to false if probes[i] is definitely not present. If
+  // bloom filters are unavailable or disabled, every key may be present.
+  Status CheckRowsMaybePresent(const RowSetKeyProbe* const* probes, size_t n,
+                               bool* maybe_present,
+                               ProbeStats* const* stats) const;
+
   // Return true if there exists a CFile for the given column ID.
   bool has_data_for_column_id(ColumnId col_id) const {
     return ContainsKey(readers_by_col_id_, col_id);
   }
 
+  // Set 'sketch' to the distinct value sketch in the footer of the given
+  // column's CFile. Returns NotFound if there is no CFile for the column, or
+  // if it was written without a sketch.
+  Status GetNdvSketch(ColumnId col_id, std::string* sketch) const;
+
+  // Appends to 'hot_blocks' the sampled hot blocks of the cfiles.
+  // See CFileReader::GetHotBlocks().
+  void GetHotBlocks(HotBlocksPB* hot_blocks) const;
+
+  // Reads the blocks of 'hot_blocks' which belong to the cfiles into the
+  // block cache, as well as the index root blocks of its columns. Adds the
+  // number of blocks read from disk to 'num_loaded'.
+  Status WarmUpBlockCache(const HotBlocksPB& hot_blocks, int* num_loaded);
+
   virtual ~CFileSet();
 
  private:
@@ -114,6 +147,9 @@ class CFileSet : public std::enable_shared_from_this<CFileSet> {
 
   std::shared_ptr<RowSetMetadata> rowset_metadata_;
 
+  std::shared_ptr<MemTracker> reader_mem_tracker_;
+  std::shared_ptr<MemTracker> bloom_mem_tracker_;
+
   std::string min_encoded_key_;
   std::string max_encoded_key_;
 
@@ -182,7 +218,9 @@ class CFileSet::Iterator : public ColumnwiseIterator {
         projection_(projection),
         initted_(false),
         cur_idx_(0),
-        prepared_count_(0) {
+        prepared_count_(0),
+        unit_rows_(0),
+        sampled_end_idx_(0) {
     CHECK_OK(base_data_->CountRows(&row_count_));
   }
 
@@ -196,6 +234,10 @@ class CFileSet::Iterator : public ColumnwiseIterator {
 
   void Unprepare();
 
+  // For sampled scans, advances cur_idx_ past the units of rows which aren't
+  // sampled, unless it's within a sampled unit already.
+  void SkipUnsampledRows();
+
   // Prepare the given column if not already prepared.
   Status PrepareColumn(ColumnMaterializationContext *ctx);
 
@@ -226,6 +268,12 @@ class CFileSet::Iterator : public ColumnwiseIterator {
   // materialized, it doesn't need to be read off disk.
   vector<bool> cols_prepared_;
 
+  // The sampling of the scan, by units of unit_rows_ rows. sampled_end_idx_
+  // is the end of the sampled unit holding cur_idx_.
+  ScanSample sample_;
+  std::shared_ptr<ScanSamplingStats> sampling_stats_;
+  size_t unit_rows_;
+  size_t sampled_end_idx_;
 };
 
 } // namespace tablet
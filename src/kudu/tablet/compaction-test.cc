@@ -34,6 +34,7 @@
 #include "kudu/tablet/tablet-test-util.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_util.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_string(merge_benchmark_input_dir, "",
               "Directory to benchmark merge. The benchmark will merge "
@@ -70,7 +71,8 @@ class TestCompaction : public KuduRowSetTest {
       row_builder_(schema_),
       mvcc_(scoped_refptr<server::Clock>(
               server::LogicalClock::CreateStartingAt(Timestamp::kInitialTimestamp))),
-      log_anchor_registry_(new log::LogAnchorRegistry()) {
+      log_anchor_registry_(new log::LogAnchorRegistry()),
+      encode_pool_(nullptr) {
   }
 
   static Schema CreateSchema() {
@@ -199,16 +201,23 @@ class TestCompaction : public KuduRowSetTest {
   // Flush the given CompactionInput 'input' to disk with the given snapshot.
   // If 'result_rowsets' is not NULL, reopens the resulting rowset(s) and appends
   // them to the vector.
+  // If 'direct_mrs' is set, it's flushed with FlushMemRowSet() instead of
+  // flushing 'input'.
   void DoFlushAndReopen(
       CompactionInput *input, const Schema& projection, const MvccSnapshot &snap,
-      int64_t roll_threshold, vector<shared_ptr<DiskRowSet> >* result_rowsets) {
+      int64_t roll_threshold, vector<shared_ptr<DiskRowSet> >* result_rowsets,
+      const MemRowSet* direct_mrs = nullptr) {
     // Flush with a large roll threshold so we only write a single file.
     // This simplifies the test so we always need to reopen only a single rowset.
     RollingDiskRowSetWriter rsw(tablet()->metadata(), projection,
                                 BloomFilterSizing::BySizeAndFPRate(32*1024, 0.01f),
-                                roll_threshold);
+                                roll_threshold, encode_pool_);
     ASSERT_OK(rsw.Open());
-    ASSERT_OK(FlushCompactionInput(input, snap, HistoryGcOpts::Disabled(), &rsw));
+    if (direct_mrs) {
+      ASSERT_OK(FlushMemRowSet(*direct_mrs, snap, HistoryGcOpts::Disabled(), &rsw));
+    } else {
+      ASSERT_OK(FlushCompactionInput(input, snap, HistoryGcOpts::Disabled(), &rsw));
+    }
     ASSERT_OK(rsw.Finish());
 
     vector<shared_ptr<RowSetMetadata> > metas;
@@ -392,6 +401,9 @@ class TestCompaction : public KuduRowSetTest {
   MvccManager mvcc_;
 
   scoped_refptr<LogAnchorRegistry> log_anchor_registry_;
+
+  // If set, flushes encode their output's columns on this pool.
+  ThreadPool* encode_pool_;
 };
 
 TEST_F(TestCompaction, TestMemRowSetInput) {
@@ -445,6 +457,84 @@ TEST_F(TestCompaction, TestFlushMRSWithRolling) {
             rows[1]);
 }
 
+// Flushing and compacting with the columns encoded in the background should
+// write exactly the same rows as doing it all on one thread.
+TEST_F(TestCompaction, TestFlushAndCompactWithEncodePool) {
+  const int kNumRows = 30000;
+  shared_ptr<MemRowSet> mrs(new MemRowSet(0, schema_, log_anchor_registry_.get()));
+  InsertRows(mrs.get(), kNumRows, 0);
+  UpdateRows(mrs.get(), kNumRows, 0, 1);
+
+  vector<shared_ptr<DiskRowSet> > expected_rowsets;
+  FlushMRSAndReopen(*mrs, schema_, kSmallRollThreshold, &expected_rowsets);
+
+  gscoped_ptr<ThreadPool> pool;
+  ASSERT_OK(ThreadPoolBuilder("encode").set_max_threads(4).Build(&pool));
+  encode_pool_ = pool.get();
+
+  vector<shared_ptr<DiskRowSet> > flushed_rowsets;
+  FlushMRSAndReopen(*mrs, schema_, kSmallRollThreshold, &flushed_rowsets);
+  ASSERT_GT(flushed_rowsets.size(), 1);
+
+  vector<shared_ptr<DiskRowSet> > compacted_rowsets;
+  ASSERT_OK(CompactAndReopen(flushed_rowsets, schema_, kLargeRollThreshold,
+                             &compacted_rowsets));
+  ASSERT_EQ(1, compacted_rowsets.size());
+
+  vector<string> expected;
+  for (const shared_ptr<DiskRowSet>& rs : expected_rowsets) {
+    ASSERT_OK(rs->DebugDump(&expected));
+  }
+  vector<string> flushed;
+  for (const shared_ptr<DiskRowSet>& rs : flushed_rowsets) {
+    ASSERT_OK(rs->DebugDump(&flushed));
+  }
+  vector<string> compacted;
+  ASSERT_OK(compacted_rowsets[0]->DebugDump(&compacted));
+
+  ASSERT_EQ(kNumRows, expected.size());
+  ASSERT_EQ(expected, flushed);
+  ASSERT_EQ(expected, compacted);
+}
+
+// Flushing an MRS straight from its tree should write the same rows and
+// deltas as flushing its compaction input, with or without an encode pool.
+TEST_F(TestCompaction, TestFlushMemRowSetDirectly) {
+  const int kNumRows = 30000;
+  shared_ptr<MemRowSet> mrs(new MemRowSet(0, schema_, log_anchor_registry_.get()));
+  InsertRows(mrs.get(), kNumRows, 0);
+  UpdateRows(mrs.get(), kNumRows / 2, 0, 1);
+  DeleteRows(mrs.get(), kNumRows / 4, 0);
+
+  gscoped_ptr<ThreadPool> pool;
+  ASSERT_OK(ThreadPoolBuilder("encode").set_max_threads(4).Build(&pool));
+
+  MvccSnapshot snap(mvcc_);
+  vector<string> expected;
+  {
+    gscoped_ptr<CompactionInput> input(CompactionInput::Create(*mrs, &schema_, snap));
+    vector<shared_ptr<DiskRowSet> > rowsets;
+    NO_FATALS(DoFlushAndReopen(input.get(), schema_, snap, kSmallRollThreshold, &rowsets));
+    for (const shared_ptr<DiskRowSet>& rs : rowsets) {
+      ASSERT_OK(rs->DebugDump(&expected));
+    }
+  }
+  ASSERT_EQ(kNumRows, expected.size());
+
+  for (ThreadPool* encode_pool : { static_cast<ThreadPool*>(nullptr), pool.get() }) {
+    encode_pool_ = encode_pool;
+    vector<shared_ptr<DiskRowSet> > rowsets;
+    NO_FATALS(DoFlushAndReopen(nullptr, schema_, snap, kSmallRollThreshold, &rowsets,
+                               mrs.get()));
+    ASSERT_GT(rowsets.size(), 1);
+    vector<string> flushed;
+    for (const shared_ptr<DiskRowSet>& rs : rowsets) {
+      ASSERT_OK(rs->DebugDump(&flushed));
+    }
+    ASSERT_EQ(expected, flushed);
+  }
+}
+
 TEST_F(TestCompaction, TestRowSetInput) {
   // Create a memrowset with a bunch of rows, flush and reopen.
   shared_ptr<DiskRowSet> rs;
@@ -768,6 +858,122 @@ TEST_F(TestCompaction, TestCompactionFreesDiskSpace) {
   }
 }
 
+// Records the memory charged to compactions once their inputs are selected.
+class RecordCompactionMemoryHooks : public Tablet::CompactionFaultHooks {
+ public:
+  explicit RecordCompactionMemoryHooks(shared_ptr<MemTracker> tracker)
+      : tracker_(std::move(tracker)),
+        consumption_(0) {
+  }
+
+  Status PostSelectIterators() OVERRIDE {
+    consumption_ = tracker_->consumption();
+    return Status::OK();
+  }
+
+  int64_t consumption() const { return consumption_; }
+
+ private:
+  const shared_ptr<MemTracker> tracker_;
+  int64_t consumption_;
+};
+
+// Compactions should charge their estimated memory to the tablet's
+// compaction tracker while they run, and release it when done.
+TEST_F(TestCompaction, TestCompactionMemoryIsTracked) {
+  {
+    LocalTabletWriter writer(tablet().get(), &client_schema());
+    KuduPartialRow row(&client_schema());
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 10; j++) {
+        int val = (i * 10) + j;
+        ASSERT_OK(row.SetStringCopy("key", Substitute("hello $0", val)));
+        ASSERT_OK(row.SetInt32("val", val));
+        ASSERT_OK(writer.Insert(row));
+      }
+      ASSERT_OK(tablet()->Flush());
+    }
+  }
+
+  shared_ptr<MemTracker> compactions_tracker;
+  ASSERT_TRUE(MemTracker::FindTracker("Compactions", &compactions_tracker,
+                                      tablet()->mem_tracker()));
+  shared_ptr<RecordCompactionMemoryHooks> hooks(
+      new RecordCompactionMemoryHooks(compactions_tracker));
+  tablet()->SetCompactionHooksForTests(hooks);
+
+  ASSERT_OK(tablet()->Compact(Tablet::FORCE_COMPACT_ALL));
+  ASSERT_GT(hooks->consumption(), 0);
+  ASSERT_EQ(0, compactions_tracker->consumption());
+  ASSERT_EQ(1, tablet()->num_rowsets());
+}
+
+// Runs the test tablet under a memory tracker whose spare memory the tests
+// control.
+class TestCompactionMemoryLimit : public TestCompaction {
+ public:
+  TestCompactionMemoryLimit() {
+    parent_mem_tracker_ = MemTracker::CreateTracker(kLimitBytes, "compaction-limit");
+  }
+
+  void SetUp() OVERRIDE {
+    TestCompaction::SetUp();
+
+    // Flush four small rowsets with interleaved keys, so that each overlaps
+    // the others and the compaction policy picks them all.
+    LocalTabletWriter writer(tablet().get(), &client_schema());
+    KuduPartialRow row(&client_schema());
+    for (int i = 0; i < 4; i++) {
+      for (int j = 0; j < 10; j++) {
+        int val = (j * 4) + i;
+        ASSERT_OK(row.SetStringCopy("key", Substitute("hello $0", val)));
+        ASSERT_OK(row.SetInt32("val", val));
+        ASSERT_OK(writer.Insert(row));
+      }
+      ASSERT_OK(tablet()->Flush());
+    }
+    ASSERT_EQ(4, tablet()->num_rowsets());
+  }
+
+  void TearDown() OVERRIDE {
+    if (ballast_) {
+      ballast_->Release(ballast_->consumption());
+    }
+    TestCompaction::TearDown();
+  }
+
+ protected:
+  // Leaves only 'spare_bytes' for the tablet to consume.
+  void LeaveSpareMemory(int64_t spare_bytes) {
+    ballast_ = MemTracker::CreateTracker(-1, "ballast", parent_mem_tracker_);
+    ballast_->Consume(kLimitBytes - parent_mem_tracker_->consumption() - spare_bytes);
+  }
+
+  static const int64_t kLimitBytes = 64 * 1024 * 1024;
+
+  shared_ptr<MemTracker> ballast_;
+};
+
+// A compaction which doesn't fit in the memory available is shrunk until it
+// does. Each of the small rowsets is estimated to need a little over the
+// 128KB of its input arena, so only two of them fit in 384KB.
+TEST_F(TestCompactionMemoryLimit, TestCompactionShrinksToFit) {
+  LeaveSpareMemory(384 * 1024);
+  ASSERT_OK(tablet()->Compact(Tablet::COMPACT_NO_FLAGS));
+  ASSERT_EQ(3, tablet()->num_rowsets());
+}
+
+// A compaction is deferred if not even two rowsets fit.
+TEST_F(TestCompactionMemoryLimit, TestCompactionIsDeferred) {
+  LeaveSpareMemory(64 * 1024);
+  ASSERT_OK(tablet()->Compact(Tablet::COMPACT_NO_FLAGS));
+  ASSERT_EQ(4, tablet()->num_rowsets());
+
+  // Forced compactions proceed regardless.
+  ASSERT_OK(tablet()->Compact(Tablet::FORCE_COMPACT_ALL));
+  ASSERT_EQ(1, tablet()->num_rowsets());
+}
+
 // Regression test for KUDU-1237, a bug in which empty flushes or compactions
 // would result in orphaning near-empty cfile blocks on the disk.
 TEST_F(TestCompaction, TestEmptyFlushDoesntLeakBlocks) {
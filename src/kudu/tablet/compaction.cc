@@ -17,7 +17,9 @@
 
 #include "kudu/tablet/compaction.h"
 
+#include <algorithm>
 #include <deque>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <memory>
 #include <string>
@@ -35,9 +37,12 @@
 #include "kudu/tablet/delta_store.h"
 #include "kudu/tablet/delta_tracker.h"
 #include "kudu/tablet/diskrowset.h"
+#include "kudu/tablet/rowset_info.h"
 #include "kudu/tablet/tablet.pb.h"
 #include "kudu/tablet/transactions/write_transaction.h"
 #include "kudu/util/debug/trace_event.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/scoped_cleanup.h"
 
 using kudu::server::HybridClock;
 using std::shared_ptr;
@@ -45,11 +50,21 @@ using std::unique_ptr;
 using std::unordered_set;
 using strings::Substitute;
 
+DECLARE_int32(cfile_default_block_size);
+
 namespace kudu {
 namespace tablet {
 
 namespace {
 
+// The number of rows read at a time from each on-disk compaction input.
+const int kRowsPerBlock = 100;
+
+// The initial and maximum sizes of the arena holding an on-disk input's
+// mutations for its current block.
+const int kInputArenaInitialBytes = 32 * 1024;
+const int kInputArenaMaxBytes = 128 * 1024;
+
 // CompactionInput yielding rows and mutations from a MemRowSet.
 class MemRowSetCompactionInput : public CompactionInput {
  public:
@@ -142,7 +157,7 @@ class DiskRowSetCompactionInput : public CompactionInput {
       : base_iter_(std::move(base_iter)),
         redo_delta_iter_(std::move(redo_delta_iter)),
         undo_delta_iter_(std::move(undo_delta_iter)),
-        arena_(32 * 1024, 128 * 1024),
+        arena_(kInputArenaInitialBytes, kInputArenaMaxBytes),
         block_(base_iter_->schema(), kRowsPerBlock, &arena_),
         redo_mutation_block_(kRowsPerBlock, static_cast<Mutation *>(nullptr)),
         undo_mutation_block_(kRowsPerBlock, static_cast<Mutation *>(nullptr)),
@@ -214,10 +229,6 @@ class DiskRowSetCompactionInput : public CompactionInput {
   vector<Mutation *> undo_mutation_block_;
 
   rowid_t first_rowid_in_block_;
-
-  enum {
-    kRowsPerBlock = 100
-  };
 };
 
 class MergeCompactionInput : public CompactionInput {
@@ -595,6 +606,23 @@ void RowSetsInCompaction::DumpToLog() const {
   }
 }
 
+int64_t EstimateCompactionInputMemory(const Schema& schema, const RowSetInfo& rsi) {
+  // A column's decoded block is at most a block, but small rowsets don't
+  // fill a block per column.
+  const int64_t bytes_per_column = rsi.size_bytes() / std::max<size_t>(schema.num_columns(), 1);
+  int64_t bytes = 0;
+  for (const ColumnSchema& col : schema.columns()) {
+    int64_t block_size = col.attributes().cfile_block_size > 0 ?
+        col.attributes().cfile_block_size : FLAGS_cfile_default_block_size;
+    bytes += std::min(block_size, bytes_per_column);
+  }
+  // The REDO and UNDO delta iterators each hold a decoded block.
+  bytes += 2 * std::min<int64_t>(FLAGS_cfile_default_block_size, rsi.size_bytes());
+  // The rows handed to the merge, and their mutations.
+  bytes += kRowsPerBlock * schema.byte_size() + kInputArenaMaxBytes;
+  return bytes;
+}
+
 void RemoveAncientUndos(const HistoryGcOpts& history_gc_opts, CompactionInputRow* row) {
   if (!history_gc_opts.gc_enabled()) {
     return;
@@ -793,9 +821,30 @@ Status FlushCompactionInput(CompactionInput* input,
 
   DCHECK(out->schema().has_column_ids());
 
-  RowBlock block(out->schema(), 100, nullptr);
+  // If the output encodes its columns in the background, fill one block while
+  // the other is being written. Each block then owns a copy of its rows'
+  // indirect data, since the input's arena is reset with every input block.
+  const bool pipelined = out->has_encode_pool();
+  unique_ptr<Arena> arenas[2];
+  unique_ptr<RowBlock> blocks[2];
+  for (int i = 0; i < 2; i++) {
+    arenas[i].reset(new Arena(32 * 1024, 4 * 1024 * 1024));
+    blocks[i].reset(new RowBlock(out->schema(), 100, nullptr));
+  }
+  int cur_block = 0;
+
+  // A block in flight references the blocks above; if the flush fails
+  // partway, wait for it to be written before they're destroyed. The output's
+  // blocks are then aborted along with the writer.
+  uint64_t num_rows_merged = 0;
+  auto sync_output = MakeScopedCleanup([&]() {
+    WARN_NOT_OK(out->Sync(), "Failed to write the last block of the failed flush");
+    LOG(WARNING) << "Flush failed after merging " << num_rows_merged << " rows, of which "
+                 << out->written_count() << " were appended to the output";
+  });
 
   uint64_t num_rows_history_truncated = 0;
+  uint64_t num_rows_expired = 0;
 
   while (input->HasMoreBlocks()) {
     RETURN_NOT_OK(input->PrepareBlock(&rows));
@@ -803,8 +852,15 @@ Status FlushCompactionInput(CompactionInput* input,
     int n = 0;
     for (int i = 0; i < rows.size(); i++) {
       CompactionInputRow* input_row = &rows[i];
+      if (history_gc_opts.IsExpired(input_row->row)) {
+        // Drop the row along with its history, like a garbage collected one.
+        num_rows_expired++;
+        continue;
+      }
       RETURN_NOT_OK(out->RollIfNecessary());
 
+      RowBlock& block = *blocks[cur_block];
+
       const Schema* schema = input_row->row.schema();
       DCHECK_SCHEMA_EQ(*schema, out->schema());
       DCHECK(schema->has_column_ids());
@@ -849,6 +905,10 @@ Status FlushCompactionInput(CompactionInput* input,
         continue;
       }
 
+      if (pipelined) {
+        RETURN_NOT_OK(RelocateIndirectDataToArena(&dst_row, arenas[cur_block].get()));
+      }
+
       rowid_t index_in_current_drs;
 
       if (new_undos_head != nullptr) {
@@ -866,16 +926,143 @@ Status FlushCompactionInput(CompactionInput* input,
       if (n == block.nrows()) {
         RETURN_NOT_OK(out->AppendBlock(block));
         n = 0;
+        // Appending this block waited for the other one to be written.
+        cur_block ^= 1;
+        arenas[cur_block]->Reset();
       }
     }
 
     if (n > 0) {
+      RowBlock& block = *blocks[cur_block];
       block.Resize(n);
       RETURN_NOT_OK(out->AppendBlock(block));
+      block.Resize(block.row_capacity());
+      cur_block ^= 1;
+      arenas[cur_block]->Reset();
     }
 
+    num_rows_merged += rows.size();
     RETURN_NOT_OK(input->FinishBlock());
   }
+  RETURN_NOT_OK(out->Sync());
+  sync_output.cancel();
+
+  if (num_rows_history_truncated > 0) {
+    LOG(WARNING) << "Total " << num_rows_history_truncated
+                 << " rows lost some history due to REINSERT after DELETE";
+  }
+  if (num_rows_expired > 0) {
+    LOG(INFO) << "Dropped " << num_rows_expired << " expired rows";
+  }
+  return Status::OK();
+}
+
+Status FlushMemRowSet(const MemRowSet& memrowset,
+                      const MvccSnapshot& snap,
+                      const HistoryGcOpts& history_gc_opts,
+                      RollingDiskRowSetWriter* out) {
+  const Schema* schema = &out->schema();
+  DCHECK(schema->has_column_ids());
+
+  gscoped_ptr<MemRowSet::Iterator> iter(memrowset.NewIterator(schema, snap));
+  RETURN_NOT_OK(iter->Init(nullptr));
+
+  // Rows are projected straight into the output block. Their indirect data
+  // stays in the MemRowSet, which outlives the flush and is never modified in
+  // place, so only the mutations and whatever applying them allocates go into
+  // the block's arena. As in FlushCompactionInput(), one block is filled
+  // while the other may be written in the background.
+  unique_ptr<Arena> arenas[2];
+  unique_ptr<RowBlock> blocks[2];
+  for (int i = 0; i < 2; i++) {
+    arenas[i].reset(new Arena(kInputArenaInitialBytes, kInputArenaMaxBytes));
+    blocks[i].reset(new RowBlock(*schema, kRowsPerBlock, nullptr));
+  }
+  int cur_block = 0;
+
+  uint64_t num_rows_flushed = 0;
+  auto sync_output = MakeScopedCleanup([&]() {
+    WARN_NOT_OK(out->Sync(), "Failed to write the last block of the failed flush");
+    LOG(WARNING) << "Flush failed after reading " << num_rows_flushed << " rows, of which "
+                 << out->written_count() << " were appended to the output";
+  });
+
+  // Every MemRowSet row's history begins with its insertion.
+  faststring delete_buf;
+  RowChangeListEncoder undo_encoder(&delete_buf);
+  undo_encoder.SetToDelete();
+  const RowChangeList delete_changelist = undo_encoder.as_changelist();
+
+  uint64_t num_rows_history_truncated = 0;
+  int n = 0;
+  for (; iter->HasNext(); iter->Next()) {
+    RETURN_NOT_OK(out->RollIfNecessary());
+    RowBlock& block = *blocks[cur_block];
+    Arena* arena = arenas[cur_block].get();
+
+    CompactionInputRow input_row;
+    input_row.row = block.row(n);
+    Timestamp insertion_timestamp;
+    RETURN_NOT_OK(iter->GetCurrentRow(&input_row.row,
+                                      static_cast<Arena*>(nullptr),
+                                      &input_row.redo_head,
+                                      arena,
+                                      &insertion_timestamp));
+    input_row.undo_head = Mutation::CreateInArena(arena, insertion_timestamp,
+                                                  delete_changelist);
+    num_rows_flushed++;
+    if (history_gc_opts.IsExpired(input_row.row)) {
+      continue;
+    }
+    RemoveAncientUndos(history_gc_opts, &input_row);
+
+    Mutation* new_undos_head = input_row.undo_head;
+    Mutation* new_redos_head = nullptr;
+    if (input_row.redo_head != nullptr) {
+      // The row was updated or deleted since it was inserted: turn its
+      // committed redos into undos, applying them to the base row in place.
+      bool is_garbage_collected;
+      RowBlockRow dst_row = input_row.row;
+      RETURN_NOT_OK(ApplyMutationsAndGenerateUndos(snap,
+                                                   input_row,
+                                                   history_gc_opts,
+                                                   schema,
+                                                   &new_undos_head,
+                                                   &new_redos_head,
+                                                   arena,
+                                                   &dst_row,
+                                                   &is_garbage_collected,
+                                                   &num_rows_history_truncated));
+      if (is_garbage_collected) {
+        continue;
+      }
+    }
+
+    rowid_t index_in_current_drs;
+    if (new_undos_head != nullptr) {
+      RETURN_NOT_OK(out->AppendUndoDeltas(n, new_undos_head, &index_in_current_drs));
+    }
+    if (new_redos_head != nullptr) {
+      RETURN_NOT_OK(out->AppendRedoDeltas(n, new_redos_head, &index_in_current_drs));
+    }
+
+    n++;
+    if (n == block.nrows()) {
+      RETURN_NOT_OK(out->AppendBlock(block));
+      n = 0;
+      // Appending this block waited for the other one to be written.
+      cur_block ^= 1;
+      arenas[cur_block]->Reset();
+    }
+  }
+
+  if (n > 0) {
+    RowBlock& block = *blocks[cur_block];
+    block.Resize(n);
+    RETURN_NOT_OK(out->AppendBlock(block));
+  }
+  RETURN_NOT_OK(out->Sync());
+  sync_output.cancel();
 
   if (num_rows_history_truncated > 0) {
     LOG(WARNING) << "Total " << num_rows_history_truncated
@@ -929,6 +1116,12 @@ Status ReupdateMissedDeltas(const string &tablet_name,
     RETURN_NOT_OK(input->PrepareBlock(&rows));
 
     for (const CompactionInputRow &row : rows) {
+      if (history_gc_opts.IsExpired(row.row)) {
+        // Expired rows were dropped by the first pass, along with any
+        // mutations, so they mustn't increment the output row offset either.
+        DVLOG(4) << "Skipping expired input row: " << schema->DebugRow(row.row);
+        continue;
+      }
       DVLOG(4) << "Revisiting row: " << schema->DebugRow(row.row) <<
           " Redo Mutations: " << Mutation::StringifyMutationList(*schema, row.redo_head) <<
           " Undo Mutations: " << Mutation::StringifyMutationList(*schema, row.undo_head);
@@ -17,6 +17,7 @@
 #ifndef KUDU_TABLET_COMPACTION_H
 #define KUDU_TABLET_COMPACTION_H
 
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -26,10 +27,12 @@
 #include "kudu/common/iterator.h"
 #include "kudu/tablet/diskrowset.h"
 #include "kudu/tablet/memrowset.h"
+#include "kudu/util/mem_tracker.h"
 
 namespace kudu {
 namespace tablet {
 struct CompactionInputRow;
+class RowSetInfo;
 class WriteTransactionState;
 
 // Options related to tablet history garbage collection.
@@ -60,10 +63,26 @@ class HistoryGcOpts {
     return ancient_history_mark_;
   }
 
+  // Returns a copy of these options which also drops the rows whose leading
+  // key column, which must be a UNIXTIME_MICROS column, is below 'cutoff'.
+  HistoryGcOpts WithRowTtlCutoff(int64_t cutoff) const {
+    return HistoryGcOpts(gc_enabled_, ancient_history_mark_, cutoff);
+  }
+
+  // Returns true if 'row' expired before the row TTL cutoff, if any. Expired
+  // rows are dropped along with all of their history.
+  template<class RowType>
+  bool IsExpired(const RowType& row) const {
+    return row_ttl_cutoff_ != std::numeric_limits<int64_t>::min() &&
+        *reinterpret_cast<const int64_t*>(row.cell_ptr(0)) < row_ttl_cutoff_;
+  }
+
  private:
-  HistoryGcOpts(bool gc_enabled, Timestamp ahm)
+  HistoryGcOpts(bool gc_enabled, Timestamp ahm,
+                int64_t row_ttl_cutoff = std::numeric_limits<int64_t>::min())
       : gc_enabled_(gc_enabled),
-        ancient_history_mark_(ahm) {
+        ancient_history_mark_(ahm),
+        row_ttl_cutoff_(row_ttl_cutoff) {
   }
 
   // Whether historical records prior to the ancient history mark should be
@@ -73,6 +92,10 @@ class HistoryGcOpts {
   // A timestamp prior to which no history will be preserved.
   // Ignored if 'enabled' != GC_ENABLED.
   const Timestamp ancient_history_mark_;
+
+  // The smallest leading key of the rows which haven't expired. The minimum
+  // int64 if the table has no row TTL.
+  const int64_t row_ttl_cutoff_;
 };
 
 // Interface for an input feeding into a compaction or flush.
@@ -121,6 +144,12 @@ class CompactionInput {
 // The set of rowsets which are taking part in a given compaction.
 class RowSetsInCompaction {
  public:
+  ~RowSetsInCompaction() {
+    if (mem_tracker_) {
+      mem_tracker_->Release(reserved_memory_bytes_);
+    }
+  }
+
   void AddRowSet(const std::shared_ptr<RowSet> &rowset,
                  std::unique_lock<std::mutex> lock) {
     CHECK(lock.owns_lock());
@@ -147,11 +176,31 @@ class RowSetsInCompaction {
     return rowsets_.size();
   }
 
+  // Track this compaction's memory with 'tracker', which has already been
+  // charged 'bytes' for it. The charge is released when this object is
+  // destroyed.
+  void SetMemoryReservation(std::shared_ptr<MemTracker> tracker, int64_t bytes) {
+    CHECK(!mem_tracker_);
+    mem_tracker_ = std::move(tracker);
+    reserved_memory_bytes_ = bytes;
+  }
+
+  const std::shared_ptr<MemTracker>& mem_tracker() const { return mem_tracker_; }
+
  private:
   RowSetVector rowsets_;
   vector<std::unique_lock<std::mutex>> locks_;
+
+  std::shared_ptr<MemTracker> mem_tracker_;
+  int64_t reserved_memory_bytes_ = 0;
 };
 
+// Estimates the memory needed to read the rowset described by 'rsi' as one
+// input of a compaction producing rows of 'schema': a decoded block for each
+// column of its base data and for its REDO and UNDO deltas, and the block of
+// rows and mutations it contributes to the merge.
+int64_t EstimateCompactionInputMemory(const Schema& schema, const RowSetInfo& rsi);
+
 // One row yielded by CompactionInput::PrepareBlock.
 // Looks like this (assuming n UNDO records and m REDO records):
 // UNDO_n <- ... <- UNDO_1 <- UNDO_head <- row -> REDO_head -> REDO_1 -> ... -> REDO_m
@@ -210,6 +259,16 @@ Status FlushCompactionInput(CompactionInput *input,
                             const HistoryGcOpts& history_gc_opts,
                             RollingDiskRowSetWriter *out);
 
+// Flush the rows of 'memrowset' as of 'snap' to the given RollingDiskRowSetWriter,
+// along with their undo deltas. This writes the same output as flushing the
+// memrowset's CompactionInput with FlushCompactionInput(), but reads the rows
+// straight out of the memrowset's tree into the output blocks rather than
+// staging each of its leaves in a block of its own.
+Status FlushMemRowSet(const MemRowSet& memrowset,
+                      const MvccSnapshot& snap,
+                      const HistoryGcOpts& history_gc_opts,
+                      RollingDiskRowSetWriter* out);
+
 // Iterate through this compaction input, finding any mutations which came between
 // snap_to_exclude and snap_to_include (ie those transactions that were not yet
 // committed in 'snap_to_exclude' but _are_ committed in 'snap_to_include'). For
@@ -15,15 +15,21 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <gflags/gflags.h>
 #include <glog/stl_logging.h>
 #include <gtest/gtest.h>
 #include <memory>
 #include <unordered_set>
 #include <string>
 
+#include "kudu/common/key_encoder.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/random.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_util.h"
 #include "kudu/tablet/mock-rowsets.h"
@@ -36,6 +42,8 @@ using std::unordered_set;
 using std::string;
 using std::vector;
 
+DECLARE_int32(compaction_max_exact_rowsets);
+
 namespace kudu {
 namespace tablet {
 
@@ -55,11 +63,164 @@ TEST(TestCompactionPolicy, TestBudgetedSelection) {
 
   unordered_set<RowSet*> picked;
   double quality = 0;
-  ASSERT_OK(policy.PickRowSets(tree, &picked, &quality, nullptr));
+  ASSERT_OK(policy.PickRowSets(tree, Timestamp::kMin, &picked, &quality, nullptr));
   ASSERT_EQ(3, picked.size());
   ASSERT_GE(quality, 1.0);
 }
 
+// A MockDiskRowSet in which some of the rows were deleted before the
+// ancient history mark.
+class MockDeletedRowsDiskRowSet : public MockDiskRowSet {
+ public:
+  MockDeletedRowsDiskRowSet(std::string first_key, std::string last_key,
+                            rowid_t num_rows, int64_t num_deleted)
+      : MockDiskRowSet(std::move(first_key), std::move(last_key)),
+        num_rows_(num_rows),
+        num_deleted_(num_deleted) {}
+
+  Status CountRows(rowid_t *count) const OVERRIDE {
+    *count = num_rows_;
+    return Status::OK();
+  }
+
+  int64_t CountAncientDeletedRows(Timestamp ancient_history_mark) const OVERRIDE {
+    return num_deleted_;
+  }
+
+ private:
+  const rowid_t num_rows_;
+  const int64_t num_deleted_;
+};
+
+// A lone rowset is only worth rewriting if compaction would drop some of
+// its deleted rows.
+TEST(TestCompactionPolicy, TestSingleRowSetWithDeletedRows) {
+  const int kBudgetMb = 1000;
+  BudgetedCompactionPolicy policy(kBudgetMb);
+
+  {
+    RowSetVector vec;
+    vec.push_back(shared_ptr<RowSet>(new MockDeletedRowsDiskRowSet("a", "z", 100, 0)));
+    RowSetTree tree;
+    ASSERT_OK(tree.Reset(vec));
+    unordered_set<RowSet*> picked;
+    double quality = 0;
+    ASSERT_OK(policy.PickRowSets(tree, Timestamp::kMin, &picked, &quality, nullptr));
+    ASSERT_TRUE(picked.empty());
+  }
+
+  {
+    RowSetVector vec;
+    vec.push_back(shared_ptr<RowSet>(new MockDeletedRowsDiskRowSet("a", "z", 100, 50)));
+    RowSetTree tree;
+    ASSERT_OK(tree.Reset(vec));
+    unordered_set<RowSet*> picked;
+    double quality = 0;
+    ASSERT_OK(policy.PickRowSets(tree, Timestamp::kMin, &picked, &quality, nullptr));
+    ASSERT_EQ(1, picked.size());
+    ASSERT_GT(quality, 0);
+  }
+}
+
+static string EncodeInt64Key(int64_t val) {
+  faststring buf;
+  GetKeyEncoder<faststring>(GetTypeInfo(INT64)).ResetAndEncode(&val, &buf);
+  return buf.ToString();
+}
+
+static shared_ptr<RowSet> MakeInt64KeyRowSet(int64_t first, int64_t last) {
+  return shared_ptr<RowSet>(new MockDiskRowSet(EncodeInt64Key(first), EncodeInt64Key(last)));
+}
+
+// The time-windowed policy only compacts rowsets within a single window,
+// and leaves windows far enough behind the newest key alone.
+TEST(TestCompactionPolicy, TestTimeWindowedSelection) {
+  Schema schema({ ColumnSchema("ts", INT64) }, 1);
+  const int kBudgetMb = 1000;
+
+  // Window [0, 100): three overlapping rowsets.
+  // Window [200, 300): two overlapping rowsets.
+  // Window [300, 400): a single rowset holding the newest key.
+  RowSetVector old_window = { MakeInt64KeyRowSet(0, 50),
+                              MakeInt64KeyRowSet(20, 90),
+                              MakeInt64KeyRowSet(30, 80) };
+  RowSetVector recent_window = { MakeInt64KeyRowSet(200, 250),
+                                 MakeInt64KeyRowSet(210, 260) };
+  RowSetVector vec = old_window;
+  vec.insert(vec.end(), recent_window.begin(), recent_window.end());
+  vec.push_back(MakeInt64KeyRowSet(300, 350));
+  RowSetTree tree;
+  ASSERT_OK(tree.Reset(vec));
+
+  auto contains_all = [](const RowSetVector& rowsets, const unordered_set<RowSet*>& picked) {
+    for (RowSet* rs : picked) {
+      bool found = false;
+      for (const auto& candidate : rowsets) {
+        found |= candidate.get() == rs;
+      }
+      if (!found) return false;
+    }
+    return true;
+  };
+
+  // Without freezing, whichever window is picked, the pick doesn't cross windows.
+  {
+    CompactionPolicyPB config;
+    config.set_type(CompactionPolicyPB::TIME_WINDOWED);
+    config.set_window_width(100);
+    ASSERT_OK(TimeWindowedCompactionPolicy::ValidateConfig(schema, config));
+    TimeWindowedCompactionPolicy policy(schema, config, kBudgetMb);
+    unordered_set<RowSet*> picked;
+    double quality = 0;
+    ASSERT_OK(policy.PickRowSets(tree, Timestamp::kMin, &picked, &quality, nullptr));
+    ASSERT_FALSE(picked.empty());
+    ASSERT_GT(quality, 0);
+    ASSERT_TRUE(contains_all(old_window, picked) || contains_all(recent_window, picked));
+  }
+
+  // Once the oldest window trails the newest key by more than the frozen age,
+  // only the recent window is compacted.
+  {
+    CompactionPolicyPB config;
+    config.set_type(CompactionPolicyPB::TIME_WINDOWED);
+    config.set_window_width(100);
+    config.set_frozen_window_age(150);
+    TimeWindowedCompactionPolicy policy(schema, config, kBudgetMb);
+    unordered_set<RowSet*> picked;
+    double quality = 0;
+    ASSERT_OK(policy.PickRowSets(tree, Timestamp::kMin, &picked, &quality, nullptr));
+    ASSERT_EQ(2, picked.size());
+    ASSERT_TRUE(contains_all(recent_window, picked));
+  }
+
+  // The leading key column must be an integer.
+  {
+    Schema string_schema({ ColumnSchema("key", STRING) }, 1);
+    CompactionPolicyPB config;
+    config.set_type(CompactionPolicyPB::TIME_WINDOWED);
+    config.set_window_width(100);
+    Status s = TimeWindowedCompactionPolicy::ValidateConfig(string_schema, config);
+    ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  }
+}
+
+// Test that a row TTL requires a timestamp leading key column.
+TEST(TestCompactionPolicy, TestValidateRowTtl) {
+  Schema schema({ ColumnSchema("time", UNIXTIME_MICROS), ColumnSchema("key", STRING) }, 2);
+  Schema int_schema({ ColumnSchema("key", INT64) }, 1);
+  CompactionPolicyPB config;
+  ASSERT_OK(ValidateRowTtl(int_schema, config));
+
+  config.set_row_ttl_usec(1000);
+  ASSERT_OK(ValidateRowTtl(schema, config));
+  Status s = ValidateRowTtl(int_schema, config);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+
+  config.set_row_ttl_usec(-1);
+  s = ValidateRowTtl(schema, config);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+}
+
 // Return the directory of the currently-running executable.
 static string GetExecutableDir() {
   string exec;
@@ -102,7 +263,7 @@ TEST(TestCompactionPolicy, TestYcsbCompaction) {
     unordered_set<RowSet*> picked;
     double quality = 0;
     LOG_TIMING(INFO, strings::Substitute("Computing compaction with $0MB budget", budget_mb)) {
-      ASSERT_OK(policy.PickRowSets(tree, &picked, &quality, nullptr));
+      ASSERT_OK(policy.PickRowSets(tree, Timestamp::kMin, &picked, &quality, nullptr));
     }
     LOG(INFO) << "quality=" << quality;
     int total_size = 0;
@@ -118,5 +279,104 @@ TEST(TestCompactionPolicy, TestYcsbCompaction) {
       << qualities;
 }
 
+// Generates a synthetic layout of 'num_rowsets' rowsets resembling a tablet
+// under a mostly-sequential insert workload: most rowsets cover a short range
+// following the previous one, but one in ten covers a wide random range.
+static RowSetVector GenerateRowSets(int num_rowsets, Random* rng) {
+  const uint32_t kKeySpace = num_rowsets * 100;
+  RowSetVector ret;
+  for (int i = 0; i < num_rowsets; i++) {
+    uint32_t start = i * 100;
+    uint32_t width = 1 + rng->Uniform(200);
+    if (rng->OneIn(10)) {
+      start = rng->Uniform(kKeySpace);
+      width = 1 + rng->Uniform(kKeySpace - start);
+    }
+    ret.emplace_back(new MockDiskRowSet(StringPrintf("%010u", start),
+                                        StringPrintf("%010u", start + width),
+                                        (1 + rng->Uniform(32)) * 1024 * 1024));
+  }
+  return ret;
+}
+
+static int TotalSizeMb(const unordered_set<RowSet*>& picked) {
+  int total_size = 0;
+  for (const auto* rs : picked) {
+    total_size += rs->EstimateOnDiskSize() / 1024 / 1024;
+  }
+  return total_size;
+}
+
+// Benchmark of the selection on tablets with very many rowsets, which only
+// use the approximate pass. Repeated selections against an unchanged tablet,
+// as done by every maintenance manager poll, should reuse the previous result.
+TEST(TestCompactionPolicy, TestManyRowSetsBenchmark) {
+  const int kNumRowSets = AllowSlowTests() ? 10000 : 2000;
+  const int kBudgetMb = 128;
+  Random rng(SeedRandom());
+  RowSetVector vec = GenerateRowSets(kNumRowSets, &rng);
+  RowSetTree tree;
+  ASSERT_OK(tree.Reset(vec));
+  BudgetedCompactionPolicy policy(kBudgetMb);
+
+  unordered_set<RowSet*> picked;
+  double quality = 0;
+  LOG_TIMING(INFO, strings::Substitute("Computing compaction over $0 rowsets", kNumRowSets)) {
+    ASSERT_OK(policy.PickRowSets(tree, Timestamp::kMin, &picked, &quality, nullptr));
+  }
+  LOG(INFO) << "quality=" << quality;
+  ASSERT_GT(quality, 0);
+  ASSERT_LE(TotalSizeMb(picked), kBudgetMb);
+
+  unordered_set<RowSet*> repicked;
+  double requality = 0;
+  LOG_TIMING(INFO, "Recomputing compaction over unchanged rowsets") {
+    ASSERT_OK(policy.PickRowSets(tree, Timestamp::kMin, &repicked, &requality, nullptr));
+  }
+  ASSERT_EQ(picked, repicked);
+  ASSERT_EQ(quality, requality);
+
+  // A flush adds a new rowset at the end of the key space.
+  vec.emplace_back(new MockDiskRowSet(StringPrintf("%010u", kNumRowSets * 100),
+                                      StringPrintf("%010u", kNumRowSets * 100 + 50)));
+  ASSERT_OK(tree.Reset(vec));
+  picked.clear();
+  LOG_TIMING(INFO, "Computing compaction after a flush") {
+    ASSERT_OK(policy.PickRowSets(tree, Timestamp::kMin, &picked, &quality, nullptr));
+  }
+  ASSERT_LE(TotalSizeMb(picked), kBudgetMb);
+}
+
+// Selections in which the exact solver reuses the per-window results from a
+// previous selection should be as good as those computed from scratch.
+TEST(TestCompactionPolicy, TestReusedWindowResults) {
+  const int kNumRowSets = 500;
+  const int kBudgetMb = 64;
+  ASSERT_LE(kNumRowSets + 10, FLAGS_compaction_max_exact_rowsets);
+  Random rng(SeedRandom());
+  RowSetVector vec = GenerateRowSets(kNumRowSets, &rng);
+  BudgetedCompactionPolicy policy(kBudgetMb);
+  for (int i = 0; i < 10; i++) {
+    RowSetTree tree;
+    ASSERT_OK(tree.Reset(vec));
+    unordered_set<RowSet*> picked;
+    double quality = 0;
+    ASSERT_OK(policy.PickRowSets(tree, Timestamp::kMin, &picked, &quality, nullptr));
+
+    BudgetedCompactionPolicy fresh_policy(kBudgetMb);
+    unordered_set<RowSet*> fresh_picked;
+    double fresh_quality = 0;
+    ASSERT_OK(fresh_policy.PickRowSets(tree, Timestamp::kMin, &fresh_picked, &fresh_quality,
+                                       nullptr));
+    ASSERT_NEAR(fresh_quality, quality, 1e-9);
+    ASSERT_LE(TotalSizeMb(picked), kBudgetMb);
+
+    // Emulate a flush of recent data.
+    uint32_t start = (kNumRowSets + i) * 100;
+    vec.emplace_back(new MockDiskRowSet(StringPrintf("%010u", start),
+                                        StringPrintf("%010u", start + 1 + rng.Uniform(200))));
+  }
+}
+
 } // namespace tablet
 } // namespace kudu
@@ -20,22 +20,38 @@
 #include <glog/logging.h>
 
 #include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
 #include <utility>
 #include <string>
 #include <vector>
 
+#include "kudu/common/key_encoder.h"
+#include "kudu/common/schema.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/casts.h"
+#include "kudu/gutil/hash/builtin_type_hash.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/mathlimits.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/rowset_info.h"
 #include "kudu/tablet/rowset_tree.h"
 #include "kudu/tablet/svg_dump.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/knapsack_solver.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
+using std::map;
+using std::shared_ptr;
+using std::string;
+using std::unique_ptr;
+using std::unordered_map;
 using std::vector;
+using strings::Substitute;
 
 DEFINE_int32(budgeted_compaction_target_rowset_size, 32*1024*1024,
              "The target size for DiskRowSets during flush/compact when the "
@@ -49,6 +65,15 @@ DEFINE_double(compaction_approximation_ratio, 1.05f,
               "if it is known to be within 5% of the optimal solution.");
 TAG_FLAG(compaction_approximation_ratio, experimental);
 
+DEFINE_int32(compaction_max_exact_rowsets, 1000,
+             "Maximum number of rowsets available for compaction in a tablet for which "
+             "the exact knapsack solver is used when selecting a compaction. Beyond "
+             "this, only the approximation is used, and at most this many rowsets are "
+             "considered together, bounding the selection time on tablets with very "
+             "many rowsets.");
+TAG_FLAG(compaction_max_exact_rowsets, experimental);
+TAG_FLAG(compaction_max_exact_rowsets, advanced);
+
 namespace kudu {
 namespace tablet {
 
@@ -76,7 +101,9 @@ static const double kSupportAdjust = 1.01;
 ////////////////////////////////////////////////////////////
 
 BudgetedCompactionPolicy::BudgetedCompactionPolicy(int budget)
-  : size_budget_mb_(budget) {
+  : size_budget_mb_(budget),
+    has_last_solution_(false),
+    last_input_fingerprint_(0) {
   CHECK_GT(budget, 0);
 }
 
@@ -87,12 +114,17 @@ uint64_t BudgetedCompactionPolicy::target_rowset_size() const {
 
 // Returns in min-key and max-key sorted order
 void BudgetedCompactionPolicy::SetupKnapsackInput(const RowSetTree &tree,
+                                                  Timestamp ancient_history_mark,
                                                   vector<RowSetInfo>* min_key,
                                                   vector<RowSetInfo>* max_key) {
-  RowSetInfo::CollectOrdered(tree, min_key, max_key);
+  RowSetInfo::CollectOrdered(tree, ancient_history_mark, min_key, max_key);
 
-  if (min_key->size() < 2) {
-    // require at least 2 rowsets to compact
+  if (min_key->empty()) {
+    return;
+  }
+  // Require at least 2 rowsets to compact, unless rewriting a single rowset
+  // would drop some of its deleted rows.
+  if (min_key->size() < 2 && min_key->front().deleted_fraction() == 0) {
     min_key->clear();
     max_key->clear();
     return;
@@ -114,7 +146,7 @@ struct KnapsackTraits {
     return item->size_mb();
   }
   static value_type get_value(const RowSetInfo* item) {
-    return item->width();
+    return item->value();
   }
 };
 
@@ -165,11 +197,11 @@ class BoundCalculator {
                    DerefCompare<CompareByDescendingDensity>());
 
     total_weight_ += candidate.size_mb();
-    total_value_ += candidate.width();
+    total_value_ += candidate.value();
     const RowSetInfo* top = fractional_solution_.front();
     while (total_weight_ - top->size_mb() > max_weight_) {
       total_weight_ -= top->size_mb();
-      total_value_ -= top->width();
+      total_value_ -= top->value();
       std::pop_heap(fractional_solution_.begin(), fractional_solution_.end(),
                     DerefCompare<CompareByDescendingDensity>());
       fractional_solution_.pop_back();
@@ -195,10 +227,10 @@ class BoundCalculator {
     // - the N+1th item, if it fits
     // This is a 2-approximation (i.e. no worse than 1/2 of the best solution).
     // See https://courses.engr.illinois.edu/cs598csc/sp2009/lectures/lecture_4.pdf
-    double lower_bound = std::max(total_value_ - top.width(), top.width());
+    double lower_bound = std::max(total_value_ - top.value(), top.value());
     double fraction_of_top_to_remove = static_cast<double>(excess_weight) / top.size_mb();
     DCHECK_GT(fraction_of_top_to_remove, 0);
-    double upper_bound = total_value_ - fraction_of_top_to_remove * top.width();
+    double upper_bound = total_value_ - fraction_of_top_to_remove * top.value();
     return {lower_bound, upper_bound};
   }
 
@@ -213,7 +245,7 @@ class BoundCalculator {
 
       // See above: there are two choices for the lower-bound estimate,
       // and we need to return the one matching the bound we computed.
-      if (total_value_ - top->width() > top->width()) {
+      if (total_value_ - top->value() > top->value()) {
         // The current solution less the top (minimum density) element.
         solution->assign(fractional_solution_.begin() + 1,
                          fractional_solution_.end());
@@ -240,25 +272,95 @@ class BoundCalculator {
   double topdensity_;
 };
 
+// Returns the index of the first rowset in 'asc_max_key' which may share a
+// compaction with a rowset whose min key is at 'cdf_min_key' without widening
+// it to the left. Every earlier rowset ends, and so starts, before that key.
+int FirstCandidate(const vector<RowSetInfo>& asc_max_key, double cdf_min_key) {
+  auto it = std::lower_bound(asc_max_key.begin(), asc_max_key.end(), cdf_min_key,
+                             [](const RowSetInfo& rsi, double val) {
+                               return rsi.cdf_max_key() < val;
+                             });
+  return it - asc_max_key.begin();
+}
+
+// Returns the width beyond which no compaction can have a positive value.
+// A compaction's value is at most the highest density of any rowset times
+// the budget, whereas spanning 'width' costs 'width * kSupportAdjust'.
+double MaxSolutionWidth(const vector<RowSetInfo>& candidates, int size_budget_mb) {
+  double max_density = 0;
+  for (const RowSetInfo& rsi : candidates) {
+    max_density = std::max(max_density, rsi.density());
+  }
+  return max_density * size_budget_mb / kSupportAdjust;
+}
+
+// Maps a value relative to a window's width to an integer, so that the
+// floating point noise from the tablet-wide normalization doesn't affect
+// window signatures.
+uint64_t QuantizeRelative(double val) {
+  return static_cast<uint64_t>(std::llround(val * (1 << 24)));
+}
+
+// Fingerprints the candidates of a window starting at 'ab_min' and spanning
+// 'span', in terms which are unaffected by changes elsewhere in the tablet.
+uint64_t WindowSignature(const vector<const RowSetInfo*>& candidates,
+                         double ab_min, double ab_max, double span) {
+  uint64_t sig = Hash64NumWithSeed(candidates.size(),
+                                   QuantizeRelative((ab_max - ab_min) / span));
+  for (const RowSetInfo* rsi : candidates) {
+    sig = Hash64NumWithSeed(reinterpret_cast<uintptr_t>(rsi->rowset()), sig);
+    sig = Hash64NumWithSeed(rsi->size_mb(), sig);
+    sig = Hash64NumWithSeed(QuantizeRelative(rsi->value() / span), sig);
+    sig = Hash64NumWithSeed(QuantizeRelative((rsi->cdf_max_key() - ab_min) / span), sig);
+  }
+  return sig;
+}
+
+// Fingerprints the whole input to a selection.
+uint64_t InputFingerprint(const vector<RowSetInfo>& asc_min_key, int size_budget_mb) {
+  uint64_t fp = Hash64NumWithSeed(size_budget_mb, asc_min_key.size());
+  fp = Hash64NumWithSeed(bit_cast<uint64_t>(FLAGS_compaction_approximation_ratio), fp);
+  fp = Hash64NumWithSeed(FLAGS_compaction_max_exact_rowsets, fp);
+  for (const RowSetInfo& rsi : asc_min_key) {
+    fp = Hash64NumWithSeed(reinterpret_cast<uintptr_t>(rsi.rowset()), fp);
+    fp = Hash64NumWithSeed(rsi.size_mb(), fp);
+    fp = Hash64NumWithSeed(bit_cast<uint64_t>(rsi.value()), fp);
+    fp = Hash64NumWithSeed(bit_cast<uint64_t>(rsi.cdf_min_key()), fp);
+    fp = Hash64NumWithSeed(bit_cast<uint64_t>(rsi.cdf_max_key()), fp);
+  }
+  return fp;
+}
+
 } // anonymous namespace
 
 void BudgetedCompactionPolicy::RunApproximation(
     const vector<RowSetInfo>& asc_min_key,
     const vector<RowSetInfo>& asc_max_key,
+    int max_window_rowsets,
     vector<double>* best_upper_bounds,
     SolutionAndValue* best_solution) {
   best_upper_bounds->clear();
   best_upper_bounds->reserve(asc_min_key.size());
+  const double max_width = MaxSolutionWidth(asc_min_key, size_budget_mb_);
   BoundCalculator bound_calc(size_budget_mb_);
   for (const RowSetInfo& cc_a : asc_min_key) {
     bound_calc.clear();
     double ab_min = cc_a.cdf_min_key();
     double ab_max = cc_a.cdf_max_key();
     double best_upper = 0;
-    for (const RowSetInfo& cc_b : asc_max_key) {
+    int num_considered = 0;
+    for (int j = FirstCandidate(asc_max_key, ab_min);
+         j < asc_max_key.size() && num_considered < max_window_rowsets;
+         j++) {
+      const RowSetInfo& cc_b = asc_max_key[j];
       if (cc_b.cdf_min_key() < ab_min) {
         continue;
       }
+      if (cc_b.cdf_max_key() - ab_min >= max_width) {
+        // This and every following candidate is too wide to be worth it.
+        break;
+      }
+      num_considered++;
       ab_max = std::max(cc_b.cdf_max_key(), ab_max);
       double union_width = ab_max - ab_min;
       bound_calc.Add(cc_b);
@@ -286,12 +388,15 @@ void BudgetedCompactionPolicy::RunExact(
     const vector<double>& best_upper_bounds,
     SolutionAndValue* best_solution) {
 
+  const double max_width = MaxSolutionWidth(asc_min_key, size_budget_mb_);
+  unordered_map<RowSet*, WindowResult> window_results;
   KnapsackSolver<KnapsackTraits> solver;
   vector<const RowSetInfo*> inrange_candidates;
   inrange_candidates.reserve(asc_min_key.size());
   for (int i = 0; i < asc_min_key.size(); i++) {
     const RowSetInfo& cc_a = asc_min_key[i];
     const double upper_bound = best_upper_bounds[i];
+    const WindowResult* prev_result = FindOrNull(window_results_, cc_a.rowset());
 
     // 'upper_bound' is an upper bound on the solution value of any compaction that includes
     // 'cc_a' as its left-most RowSet. If that bound is worse than the current best solution,
@@ -301,27 +406,64 @@ void BudgetedCompactionPolicy::RunExact(
     // to just be better than the current solution, but needs to be better by at least
     // the approximation ratio before we bother looking for it.
     if (upper_bound < best_solution->value * FLAGS_compaction_approximation_ratio) {
+      if (prev_result) {
+        window_results.emplace(cc_a.rowset(), *prev_result);
+      }
       continue;
     }
 
     inrange_candidates.clear();
     double ab_min = cc_a.cdf_min_key();
     double ab_max = cc_a.cdf_max_key();
-    for (const RowSetInfo& cc_b : asc_max_key) {
+    for (int j = FirstCandidate(asc_max_key, ab_min); j < asc_max_key.size(); j++) {
+      const RowSetInfo& cc_b = asc_max_key[j];
       if (cc_b.cdf_min_key() < ab_min) {
         // Would expand support to the left.
-        // TODO: possible optimization here: binary search to skip to the first
-        // cc_b with cdf_max_key() > cc_a.cdf_min_key()
         continue;
       }
+      if (cc_b.cdf_max_key() - ab_min >= max_width) {
+        break;
+      }
       inrange_candidates.push_back(&cc_b);
     }
     if (inrange_candidates.empty()) continue;
 
+    // If the candidates are the same as in the previous selection, the best
+    // solution among them is too, and only needs solving again if it would
+    // improve on the best solution found so far.
+    const double span = std::max(ab_max, inrange_candidates.back()->cdf_max_key()) - ab_min;
+    const uint64_t signature = span > 0 ?
+        WindowSignature(inrange_candidates, ab_min, ab_max, span) : 0;
+    if (span > 0 && prev_result && prev_result->signature == signature) {
+      window_results.emplace(cc_a.rowset(), *prev_result);
+      if (prev_result->best_idx < 0 ||
+          prev_result->relative_value * span <= best_solution->value) {
+        continue;
+      }
+      solver.Reset(size_budget_mb_, &inrange_candidates);
+      for (int j = 0; j <= prev_result->best_idx; j++) {
+        CHECK(solver.ProcessNext());
+        ab_max = std::max(inrange_candidates[j]->cdf_max_key(), ab_max);
+      }
+      std::pair<int, double> best_with_this_item = solver.GetSolution();
+      double solution = best_with_this_item.second - (ab_max - ab_min) * kSupportAdjust;
+      if (solution > best_solution->value) {
+        vector<int> chosen_indexes;
+        solver.TracePath(best_with_this_item, &chosen_indexes);
+        best_solution->rowsets.clear();
+        for (int idx : chosen_indexes) {
+          best_solution->rowsets.insert(inrange_candidates[idx]->rowset());
+        }
+        best_solution->value = solution;
+      }
+      continue;
+    }
+
     solver.Reset(size_budget_mb_, &inrange_candidates);
-    ab_max = cc_a.cdf_max_key();
 
     vector<int> chosen_indexes;
+    double window_best = 0;
+    int window_best_idx = -1;
     int j = 0;
     while (solver.ProcessNext()) {
       const RowSetInfo* item = inrange_candidates[j++];
@@ -331,11 +473,19 @@ void BudgetedCompactionPolicy::RunExact(
       ab_max = std::max(item->cdf_max_key(), ab_max);
       DCHECK_GE(ab_max, ab_min);
       double solution = best_value - (ab_max - ab_min) * kSupportAdjust;
+      if (solution > window_best) {
+        window_best = solution;
+        window_best_idx = j - 1;
+      }
       if (solution > best_solution->value) {
         solver.TracePath(best_with_this_item, &chosen_indexes);
         best_solution->value = solution;
       }
     }
+    if (span > 0) {
+      window_results.emplace(cc_a.rowset(),
+                             WindowResult{ signature, window_best_idx, window_best / span });
+    }
 
     // If we came up with a new solution, replace.
     if (!chosen_indexes.empty()) {
@@ -345,16 +495,18 @@ void BudgetedCompactionPolicy::RunExact(
       }
     }
   }
+  window_results_.swap(window_results);
 }
 
 // See docs/design-docs/compaction-policy.md for an overview of the compaction
 // policy implemented in this function.
 Status BudgetedCompactionPolicy::PickRowSets(const RowSetTree &tree,
+                                             Timestamp ancient_history_mark,
                                              unordered_set<RowSet*>* picked,
                                              double* quality,
                                              std::vector<std::string>* log) {
   vector<RowSetInfo> asc_min_key, asc_max_key;
-  SetupKnapsackInput(tree, &asc_min_key, &asc_max_key);
+  SetupKnapsackInput(tree, ancient_history_mark, &asc_min_key, &asc_max_key);
   if (asc_max_key.empty()) {
     if (log) {
       LOG_STRING(INFO, log) << "No rowsets to compact";
@@ -366,6 +518,23 @@ Status BudgetedCompactionPolicy::PickRowSets(const RowSetTree &tree,
   // The best set of rowsets chosen so far, and the value attained by that choice.
   SolutionAndValue best_solution;
 
+  // Tablets are polled for compactions far more often than their rowsets
+  // change, so first check whether the previous selection still applies.
+  const uint64_t fingerprint = InputFingerprint(asc_min_key, size_budget_mb_);
+  if (log == nullptr && has_last_solution_ && fingerprint == last_input_fingerprint_) {
+    size_t num_found = 0;
+    for (const RowSetInfo& cand : asc_min_key) {
+      num_found += ContainsKey(last_solution_.rowsets, cand.rowset());
+    }
+    if (num_found == last_solution_.rowsets.size()) {
+      *quality = last_solution_.value;
+      if (last_solution_.value > 0) {
+        *picked = last_solution_.rowsets;
+      }
+      return Status::OK();
+    }
+  }
+
   // The algorithm proceeds in two passes. The first is based on an approximation
   // of the knapsack problem, and computes some upper and lower bounds. The second
   // pass looks again over the input for any cases where the upper bound tells us
@@ -410,8 +579,16 @@ Status BudgetedCompactionPolicy::PickRowSets(const RowSetTree &tree,
   //     cases where the upper bound is lower than our current best solution.
   // 2) 'best_solution' and 'best_solution->value': the best approximate solution
   //     found.
+  //
+  // Beyond --compaction_max_exact_rowsets rowsets, only this pass runs, and it
+  // considers at most that many rowsets for each left-most rowset, so that the
+  // selection time grows only linearly with the number of rowsets.
+  const bool run_exact = asc_min_key.size() <= FLAGS_compaction_max_exact_rowsets;
   vector<double> best_upper_bounds;
-  RunApproximation(asc_min_key, asc_max_key, &best_upper_bounds, &best_solution);
+  RunApproximation(asc_min_key, asc_max_key,
+                   run_exact ? static_cast<int>(asc_max_key.size())
+                             : FLAGS_compaction_max_exact_rowsets,
+                   &best_upper_bounds, &best_solution);
 
   // Pass 2 (precise)
   // ------------------------------------------------------------
@@ -419,7 +596,15 @@ Status BudgetedCompactionPolicy::PickRowSets(const RowSetTree &tree,
   // In cases where the upper bound indicates we could do substantially better than
   // our current best solution, we use the exact knapsack solver to find the improved
   // solution.
-  RunExact(asc_min_key, asc_max_key, best_upper_bounds, &best_solution);
+  if (run_exact) {
+    RunExact(asc_min_key, asc_max_key, best_upper_bounds, &best_solution);
+  } else {
+    window_results_.clear();
+  }
+
+  has_last_solution_ = true;
+  last_input_fingerprint_ = fingerprint;
+  last_solution_ = best_solution;
 
   // Log the input and output of the selection.
   if (VLOG_IS_ON(1) || log != nullptr) {
@@ -447,5 +632,188 @@ Status BudgetedCompactionPolicy::PickRowSets(const RowSetTree &tree,
   return Status::OK();
 }
 
+////////////////////////////////////////////////////////////
+// TimeWindowedCompactionPolicy
+////////////////////////////////////////////////////////////
+
+TimeWindowedCompactionPolicy::TimeWindowedCompactionPolicy(const Schema& schema,
+                                                           const CompactionPolicyPB& config,
+                                                           int size_budget_mb)
+  : leading_key_type_(schema.column(0).type_info()),
+    single_key_column_(schema.num_key_columns() == 1),
+    window_width_(config.window_width()),
+    frozen_window_age_(config.frozen_window_age()),
+    size_budget_mb_(size_budget_mb) {
+  CHECK_OK(ValidateConfig(schema, config));
+}
+
+Status TimeWindowedCompactionPolicy::ValidateConfig(const Schema& schema,
+                                                    const CompactionPolicyPB& config) {
+  if (config.type() != CompactionPolicyPB::TIME_WINDOWED) {
+    return Status::InvalidArgument("not a time-windowed compaction policy",
+                                   config.ShortDebugString());
+  }
+  if (config.window_width() <= 0) {
+    return Status::InvalidArgument(
+        Substitute("time-windowed compaction window width must be positive: $0",
+                   config.window_width()));
+  }
+  if (config.frozen_window_age() < 0) {
+    return Status::InvalidArgument(
+        Substitute("time-windowed compaction frozen window age must not be negative: $0",
+                   config.frozen_window_age()));
+  }
+  const ColumnSchema& col = schema.column(0);
+  switch (col.type_info()->physical_type()) {
+    case INT8:
+    case INT16:
+    case INT32:
+    case INT64:
+      return Status::OK();
+    default:
+      return Status::InvalidArgument(
+          Substitute("time-windowed compaction requires an integer or timestamp "
+                     "leading key column, but column $0 has type $1",
+                     col.name(), col.type_info()->name()));
+  }
+}
+
+Status TimeWindowedCompactionPolicy::DecodeLeadingKey(const string& encoded_key,
+                                                      int64_t* val) const {
+  const KeyEncoder<faststring>& encoder = GetKeyEncoder<faststring>(leading_key_type_);
+  Slice key(encoded_key);
+  uint8_t cell[sizeof(int64_t)];
+  RETURN_NOT_OK(encoder.Decode(&key, single_key_column_, nullptr, cell));
+  switch (leading_key_type_->physical_type()) {
+    case INT8: *val = *reinterpret_cast<const int8_t*>(cell); break;
+    case INT16: *val = *reinterpret_cast<const int16_t*>(cell); break;
+    case INT32: *val = *reinterpret_cast<const int32_t*>(cell); break;
+    case INT64: *val = *reinterpret_cast<const int64_t*>(cell); break;
+    default: LOG(FATAL) << "unexpected leading key type " << leading_key_type_->name();
+  }
+  return Status::OK();
+}
+
+int64_t TimeWindowedCompactionPolicy::WindowIndex(int64_t val) const {
+  // Round towards negative infinity so that windows stay the same width on
+  // either side of zero.
+  int64_t idx = val / window_width_;
+  if (val % window_width_ != 0 && val < 0) {
+    idx--;
+  }
+  return idx;
+}
+
+uint64_t TimeWindowedCompactionPolicy::target_rowset_size() const {
+  CHECK_GT(FLAGS_budgeted_compaction_target_rowset_size, 0);
+  return FLAGS_budgeted_compaction_target_rowset_size;
+}
+
+Status TimeWindowedCompactionPolicy::PickRowSets(const RowSetTree &tree,
+                                                 Timestamp ancient_history_mark,
+                                                 unordered_set<RowSet*>* picked,
+                                                 double* quality,
+                                                 std::vector<std::string>* log) {
+  // Bucket the rowsets with known bounds by the window of their largest key.
+  map<int64_t, RowSetVector> windows;
+  int64_t newest_key = MathLimits<int64_t>::kMin;
+  for (const shared_ptr<RowSet>& rs : tree.all_rowsets()) {
+    string min_key, max_key;
+    if (!rs->GetBounds(&min_key, &max_key).ok()) {
+      continue;
+    }
+    int64_t max_val;
+    Status s = DecodeLeadingKey(max_key, &max_val);
+    if (PREDICT_FALSE(!s.ok())) {
+      LOG(WARNING) << "Unable to decode the leading key column of " << rs->ToString()
+                   << ", not considering it for compaction: " << s.ToString();
+      continue;
+    }
+    windows[WindowIndex(max_val)].push_back(rs);
+    newest_key = std::max(newest_key, max_val);
+  }
+
+  // Forget the policies of windows which no longer hold any rowsets.
+  for (auto it = window_policies_.begin(); it != window_policies_.end();) {
+    if (ContainsKey(windows, it->first)) {
+      ++it;
+    } else {
+      it = window_policies_.erase(it);
+    }
+  }
+
+  // Run the budgeted policy within each window which isn't frozen, and keep
+  // the best of the per-window picks.
+  double best_quality = 0;
+  for (const auto& e : windows) {
+    int64_t window_start = e.first * window_width_;
+    int64_t window_last_key = window_start + (window_width_ - 1);
+    if (frozen_window_age_ > 0 && newest_key > window_last_key &&
+        static_cast<uint64_t>(newest_key) - static_cast<uint64_t>(window_last_key) >
+        static_cast<uint64_t>(frozen_window_age_)) {
+      if (log) {
+        LOG_STRING(INFO, log) << Substitute("Window starting at $0 is frozen ($1 rowsets)",
+                                            window_start, e.second.size());
+      }
+      continue;
+    }
+
+    RowSetTree window_tree;
+    RETURN_NOT_OK(window_tree.Reset(e.second));
+    if (log) {
+      LOG_STRING(INFO, log) << Substitute("Window starting at $0 ($1 rowsets):",
+                                          window_start, e.second.size());
+    }
+    unordered_set<RowSet*> window_picked;
+    double window_quality = 0;
+    unique_ptr<BudgetedCompactionPolicy>& window_policy = window_policies_[e.first];
+    if (!window_policy) {
+      window_policy.reset(new BudgetedCompactionPolicy(size_budget_mb_));
+    }
+    RETURN_NOT_OK(window_policy->PickRowSets(window_tree, ancient_history_mark,
+                                             &window_picked, &window_quality, log));
+    if (!window_picked.empty() && window_quality > best_quality) {
+      best_quality = window_quality;
+      picked->swap(window_picked);
+    }
+  }
+  *quality = best_quality;
+  return Status::OK();
+}
+
+CompactionPolicy* CreateCompactionPolicy(const Schema& schema,
+                                         const CompactionPolicyPB& config,
+                                         int size_budget_mb) {
+  if (config.type() == CompactionPolicyPB::TIME_WINDOWED) {
+    Status s = TimeWindowedCompactionPolicy::ValidateConfig(schema, config);
+    if (s.ok()) {
+      return new TimeWindowedCompactionPolicy(schema, config, size_budget_mb);
+    }
+    LOG(WARNING) << "Invalid compaction policy, falling back to the budgeted policy: "
+                 << s.ToString();
+  }
+  return new BudgetedCompactionPolicy(size_budget_mb);
+}
+
+Status ValidateRowTtl(const Schema& schema, const CompactionPolicyPB& config) {
+  if (config.row_ttl_usec() == 0) {
+    return Status::OK();
+  }
+  if (config.row_ttl_usec() < 0) {
+    return Status::InvalidArgument(
+        Substitute("row TTL must not be negative: $0", config.row_ttl_usec()));
+  }
+  // Expiration is decided by the leading key column, which can't be updated,
+  // so that the key bounds of each rowset also bound its expiration.
+  const ColumnSchema& col = schema.column(0);
+  if (col.type_info()->type() != UNIXTIME_MICROS) {
+    return Status::InvalidArgument(
+        Substitute("row TTL requires a UNIXTIME_MICROS leading key column, "
+                   "but column $0 has type $1",
+                   col.name(), col.type_info()->name()));
+  }
+  return Status::OK();
+}
+
 } // namespace tablet
 } // namespace kudu
@@ -17,15 +17,24 @@
 #ifndef KUDU_TABLET_COMPACTION_POLICY_H
 #define KUDU_TABLET_COMPACTION_POLICY_H
 
+#include <map>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#include "kudu/common/common.pb.h"
+#include "kudu/common/timestamp.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
+
+class Schema;
+class TypeInfo;
+
 namespace tablet {
 
 class RowSet;
@@ -51,9 +60,14 @@ class CompactionPolicy {
   // *quality is set to represent how effective the compaction will be on
   // reducing IO in the tablet. TODO: determine the units/ranges of this thing.
   //
+  // Rows deleted before 'ancient_history_mark' are dropped when their rowset
+  // is rewritten, so rowsets containing such rows are favored. Pass
+  // Timestamp::kMin if no history may be discarded.
+  //
   // If 'log' is not NULL, then a verbose log of the compaction selection
   // process will be appended to it.
   virtual Status PickRowSets(const RowSetTree &tree,
+                             Timestamp ancient_history_mark,
                              std::unordered_set<RowSet*>* picked,
                              double* quality,
                              std::vector<std::string>* log) = 0;
@@ -74,11 +88,17 @@ class CompactionPolicy {
 // future cost of operations on the tablet.
 //
 // See src/kudu/tablet/compaction-policy.txt for details.
+//
+// The policy remembers the results of its previous selection so that repeated
+// calls against an unchanged tablet are cheap, and so that the exact solver is
+// only rerun for the candidate compactions whose rowsets changed since. Hence,
+// like PickRowSets() itself, an instance must not be used concurrently.
 class BudgetedCompactionPolicy : public CompactionPolicy {
  public:
   explicit BudgetedCompactionPolicy(int size_budget_mb);
 
   virtual Status PickRowSets(const RowSetTree &tree,
+                             Timestamp ancient_history_mark,
                              std::unordered_set<RowSet*>* picked,
                              double* quality,
                              std::vector<std::string>* log) OVERRIDE;
@@ -91,9 +111,26 @@ class BudgetedCompactionPolicy : public CompactionPolicy {
     double value = 0;
   };
 
+  // The outcome of the exact pass for the candidate compactions starting at a
+  // given rowset, remembered from the previous selection.
+  struct WindowResult {
+    // Fingerprint of the candidate rowsets considered; see WindowSignature().
+    uint64_t signature;
+
+    // Index of the last candidate included in the best solution's support, or
+    // -1 if no solution had a positive value.
+    int best_idx;
+
+    // The best solution's value, relative to the width spanned by all of the
+    // candidates. Relative values stay comparable as the rest of the tablet
+    // changes, whereas absolute ones are normalized over the whole tablet.
+    double relative_value;
+  };
+
   // Sets up the 'asc_min_key' and 'asc_max_key' vectors necessary
   // for both the approximate and exact solutions below.
   void SetupKnapsackInput(const RowSetTree &tree,
+                          Timestamp ancient_history_mark,
                           std::vector<RowSetInfo>* asc_min_key,
                           std::vector<RowSetInfo>* asc_max_key);
 
@@ -103,9 +140,13 @@ class BudgetedCompactionPolicy : public CompactionPolicy {
   //
   // Sets best_upper_bounds[i] to the upper bound for any solution containing
   // asc_min_key[i] as its left-most rowset.
+  //
+  // At most 'max_window_rowsets' rowsets are considered for each left-most
+  // rowset.
   void RunApproximation(
       const std::vector<RowSetInfo>& asc_min_key,
       const std::vector<RowSetInfo>& asc_max_key,
+      int max_window_rowsets,
       std::vector<double>* best_upper_bounds,
       SolutionAndValue* best_solution);
 
@@ -117,6 +158,9 @@ class BudgetedCompactionPolicy : public CompactionPolicy {
   // 'best_solution' by at least the configured approximation ratio. If so, runs the full
   // knapsack algorithm to determine the value of that solution and, if it is indeed
   // better, replaces '*best_solution' with the new best solution.
+  //
+  // The knapsack is only solved for windows whose candidates changed since the
+  // previous selection; the others reuse 'window_results_'.
   void RunExact(
       const std::vector<RowSetInfo>& asc_min_key,
       const std::vector<RowSetInfo>& asc_max_key,
@@ -124,8 +168,73 @@ class BudgetedCompactionPolicy : public CompactionPolicy {
       SolutionAndValue* best_solution);
 
   size_t size_budget_mb_;
+
+  // Keyed by the left-most rowset of each window solved by the last RunExact().
+  std::unordered_map<RowSet*, WindowResult> window_results_;
+
+  // Fingerprint of the input to the last selection and the solution it
+  // produced, reused as long as the tablet's rowsets remain unchanged.
+  bool has_last_solution_;
+  uint64_t last_input_fingerprint_;
+  SolutionAndValue last_solution_;
 };
 
+// Compaction policy for append-mostly tables whose leading primary key
+// column is a time (or other monotonically increasing integer).
+//
+// Rowsets are grouped into fixed-width windows of the leading key column,
+// each rowset belonging to the window holding its largest key. Compactions
+// are only ever picked among the rowsets of a single window, using the
+// budgeted policy within that window, so that old and new data are never
+// rewritten together. Windows which trail the largest key in the tablet by
+// more than the configured age are frozen and left alone entirely.
+class TimeWindowedCompactionPolicy : public CompactionPolicy {
+ public:
+  // 'config' must have passed ValidateConfig() against 'schema'.
+  TimeWindowedCompactionPolicy(const Schema& schema,
+                               const CompactionPolicyPB& config,
+                               int size_budget_mb);
+
+  // Returns an error if 'config' can't be used with a table of 'schema'.
+  static Status ValidateConfig(const Schema& schema, const CompactionPolicyPB& config);
+
+  virtual Status PickRowSets(const RowSetTree &tree,
+                             Timestamp ancient_history_mark,
+                             std::unordered_set<RowSet*>* picked,
+                             double* quality,
+                             std::vector<std::string>* log) OVERRIDE;
+
+  virtual uint64_t target_rowset_size() const OVERRIDE;
+
+ private:
+  // Decodes the leading key column out of 'encoded_key'.
+  Status DecodeLeadingKey(const std::string& encoded_key, int64_t* val) const;
+
+  // Returns the index of the window holding the key 'val'.
+  int64_t WindowIndex(int64_t val) const;
+
+  const TypeInfo* const leading_key_type_;
+  const bool single_key_column_;
+  const int64_t window_width_;
+  const int64_t frozen_window_age_;
+  const int size_budget_mb_;
+
+  // The policy used within each window, keyed by window index. Each window
+  // has its own so that it keeps its own record of previous selections.
+  std::map<int64_t, std::unique_ptr<BudgetedCompactionPolicy>> window_policies_;
+};
+
+// Creates the compaction policy configured by 'config' for a tablet of
+// 'schema'. Falls back to the budgeted policy (logging a warning) if the
+// configuration is invalid for the schema.
+CompactionPolicy* CreateCompactionPolicy(const Schema& schema,
+                                         const CompactionPolicyPB& config,
+                                         int size_budget_mb);
+
+// Returns an error if the row TTL of 'config' can't be used with a table of
+// 'schema'. A config without a row TTL is always valid.
+Status ValidateRowTtl(const Schema& schema, const CompactionPolicyPB& config);
+
 } // namespace tablet
 } // namespace kudu
 #endif
@@ -0,0 +1,114 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "kudu/tablet/compaction_policy.h"
+#include "kudu/tablet/compaction_simulator.h"
+#include "kudu/util/random.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+DECLARE_int32(budgeted_compaction_target_rowset_size);
+
+using std::vector;
+
+namespace kudu {
+namespace tablet {
+
+const int64_t kMb = 1024 * 1024;
+
+TEST(TestCompactionSimulator, TestParseTrace) {
+  vector<SimulatedFlush> flushes;
+  ASSERT_OK(ParseCompactionTrace("# size\tmin\tmax\n"
+                                 "32\t0\t999\n"
+                                 "\n"
+                                 "8\t500\t1500\n", &flushes));
+  ASSERT_EQ(2, flushes.size());
+  ASSERT_EQ(8 * kMb, flushes[1].size_bytes);
+  ASSERT_EQ(500, flushes[1].min_key);
+  ASSERT_EQ(1500, flushes[1].max_key);
+
+  ASSERT_TRUE(ParseCompactionTrace("32\t10\t0\n", &flushes).IsCorruption());
+  ASSERT_TRUE(ParseCompactionTrace("32\t10\n", &flushes).IsCorruption());
+}
+
+// Flushes are rolled into rowsets of the target size, like compactions.
+TEST(TestCompactionSimulator, TestFlushRolls) {
+  FLAGS_budgeted_compaction_target_rowset_size = 32 * kMb;
+  BudgetedCompactionPolicy policy(128);
+  CompactionSimulator sim(&policy, CompactionSimulator::Options());
+  ASSERT_OK(sim.Flush({ 0, 999999, 100 * kMb }));
+  CompactionSimulatorSample sample = sim.Sample();
+  ASSERT_EQ(4, sample.num_rowsets);
+  ASSERT_EQ(1, sample.max_height);
+  ASSERT_EQ(0, sample.num_compactions);
+  ASSERT_DOUBLE_EQ(1, sample.write_amplification());
+
+  ASSERT_TRUE(sim.Flush({ 10, 0, kMb }).IsInvalidArgument());
+}
+
+// Sequential inserts never overlap, so they're never compacted.
+TEST(TestCompactionSimulator, TestSequentialInserts) {
+  BudgetedCompactionPolicy policy(128);
+  CompactionSimulator sim(&policy, CompactionSimulator::Options());
+  SyntheticTraceOptions opts;
+  opts.num_flushes = 50;
+  Random rng(SeedRandom());
+  vector<SimulatedFlush> flushes;
+  GenerateCompactionTrace(opts, &rng, &flushes);
+  vector<CompactionSimulatorSample> samples;
+  ASSERT_OK(sim.Replay(flushes, &samples));
+  ASSERT_EQ(50, samples.size());
+  ASSERT_EQ(0, samples.back().num_compactions);
+  ASSERT_DOUBLE_EQ(1, samples.back().average_height);
+  ASSERT_DOUBLE_EQ(1, samples.back().write_amplification());
+}
+
+// Random inserts pile up rowsets spanning the whole key space, which
+// compactions keep in check at the cost of rewriting data.
+TEST(TestCompactionSimulator, TestRandomInserts) {
+  SyntheticTraceOptions opts;
+  opts.num_flushes = 100;
+  opts.flush_size_bytes = 16 * kMb;
+  opts.random_fraction = 1;
+  Random rng(SeedRandom());
+  vector<SimulatedFlush> flushes;
+  GenerateCompactionTrace(opts, &rng, &flushes);
+
+  BudgetedCompactionPolicy policy(128);
+  CompactionSimulator::Options sim_opts;
+  sim_opts.max_compactions_per_flush = 0;
+  CompactionSimulator no_compactions(&policy, sim_opts);
+  ASSERT_OK(no_compactions.Replay(flushes, nullptr));
+  CompactionSimulatorSample uncompacted = no_compactions.Sample();
+  ASSERT_EQ(0, uncompacted.num_compactions);
+
+  sim_opts.max_compactions_per_flush = 2;
+  CompactionSimulator sim(&policy, sim_opts);
+  ASSERT_OK(sim.Replay(flushes, nullptr));
+  CompactionSimulatorSample compacted = sim.Sample();
+  ASSERT_GT(compacted.num_compactions, 0);
+  ASSERT_GT(compacted.write_amplification(), 1);
+  ASSERT_LT(compacted.average_height, uncompacted.average_height);
+  ASSERT_LE(compacted.max_height, uncompacted.max_height);
+}
+
+} // namespace tablet
+} // namespace kudu
@@ -0,0 +1,287 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tablet/compaction_simulator.h"
+
+#include <algorithm>
+#include <limits>
+#include <unordered_set>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/common/key_encoder.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/casts.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/strip.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/tablet/compaction_policy.h"
+#include "kudu/tablet/mock-rowsets.h"
+#include "kudu/tablet/rowset_tree.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/random.h"
+
+using std::pair;
+using std::shared_ptr;
+using std::string;
+using std::unordered_set;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace tablet {
+
+namespace {
+
+// Densities below this are rounding errors of the sums of densities.
+const double kMinDensity = 1e-9;
+
+string EncodeInt64Key(int64_t val) {
+  faststring buf;
+  GetKeyEncoder<faststring>(GetTypeInfo(INT64)).ResetAndEncode(&val, &buf);
+  return buf.ToString();
+}
+
+// A rowset which only has its bounds and size.
+class SimulatedRowSet : public MockRowSet {
+ public:
+  explicit SimulatedRowSet(const SimulatedFlush& range)
+      : range_(range),
+        min_encoded_key_(EncodeInt64Key(range.min_key)),
+        max_encoded_key_(EncodeInt64Key(range.max_key)) {
+  }
+
+  Status GetBounds(string* min_encoded_key, string* max_encoded_key) const OVERRIDE {
+    *min_encoded_key = min_encoded_key_;
+    *max_encoded_key = max_encoded_key_;
+    return Status::OK();
+  }
+
+  uint64_t EstimateOnDiskSize() const OVERRIDE {
+    return range_.size_bytes;
+  }
+
+  string ToString() const OVERRIDE {
+    return Substitute("sim[$0, $1]", range_.min_key, range_.max_key);
+  }
+
+  const SimulatedFlush& range() const { return range_; }
+
+ private:
+  const SimulatedFlush range_;
+  const string min_encoded_key_;
+  const string max_encoded_key_;
+};
+
+const SimulatedFlush& RangeOf(const shared_ptr<RowSet>& rs) {
+  return down_cast<SimulatedRowSet*>(rs.get())->range();
+}
+
+// Writes the data of 'inputs' into rowsets of about 'target_size' bytes,
+// assuming that the data of each input is spread evenly over its key range,
+// and appends them to 'out'.
+void Roll(const vector<SimulatedFlush>& inputs, uint64_t target_size, RowSetVector* out) {
+  int64_t total_size = 0;
+  int64_t min_key = std::numeric_limits<int64_t>::max();
+  int64_t max_key = std::numeric_limits<int64_t>::min();
+  // The changes in density along the key space.
+  vector<pair<double, double>> edges;
+  for (const SimulatedFlush& in : inputs) {
+    total_size += in.size_bytes;
+    min_key = std::min(min_key, in.min_key);
+    max_key = std::max(max_key, in.max_key);
+    double density = in.size_bytes / (static_cast<double>(in.max_key) - in.min_key + 1);
+    edges.emplace_back(in.min_key, density);
+    edges.emplace_back(static_cast<double>(in.max_key) + 1, -density);
+  }
+  int64_t num_outputs = std::max<int64_t>(1, (total_size + target_size - 1) / target_size);
+  const int64_t output_size = total_size / num_outputs;
+  std::sort(edges.begin(), edges.end());
+
+  // Walk the key space, cutting an output each time it has accumulated
+  // 'output_size' bytes. Each output starts where the previous one ended.
+  double density = 0;
+  double filled = 0;
+  int64_t start_key = min_key;
+  for (int i = 0; i + 1 < edges.size() && num_outputs > 1; i++) {
+    density += edges[i].second;
+    if (density < kMinDensity) {
+      continue;
+    }
+    double pos = edges[i].first;
+    const double end = edges[i + 1].first;
+    while (num_outputs > 1 && filled + density * (end - pos) >= output_size) {
+      double cut = pos + (output_size - filled) / density;
+      int64_t last_key = std::max(start_key, static_cast<int64_t>(cut) - 1);
+      out->emplace_back(new SimulatedRowSet({ start_key, last_key, output_size }));
+      total_size -= output_size;
+      num_outputs--;
+      start_key = last_key + 1;
+      pos = cut;
+      filled = 0;
+    }
+    filled += density * (end - pos);
+  }
+  out->emplace_back(new SimulatedRowSet({ std::min(start_key, max_key), max_key, total_size }));
+}
+
+} // anonymous namespace
+
+Status ParseCompactionTrace(const string& data, vector<SimulatedFlush>* flushes) {
+  vector<string> lines = strings::Split(data, "\n");
+  for (int i = 0; i < lines.size(); i++) {
+    string line = lines[i];
+    StripWhiteSpace(&line);
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    vector<string> fields = strings::Split(line, "\t");
+    SimulatedFlush flush;
+    int64_t size_mb;
+    if (fields.size() != 3 ||
+        !safe_strto64(fields[0], &size_mb) || size_mb < 1 ||
+        !safe_strto64(fields[1], &flush.min_key) ||
+        !safe_strto64(fields[2], &flush.max_key) ||
+        flush.min_key > flush.max_key) {
+      return Status::Corruption(Substitute("bad flush on line $0", i + 1), line);
+    }
+    flush.size_bytes = size_mb * 1024 * 1024;
+    flushes->push_back(flush);
+  }
+  return Status::OK();
+}
+
+void GenerateCompactionTrace(const SyntheticTraceOptions& opts, Random* rng,
+                             vector<SimulatedFlush>* flushes) {
+  int64_t next_key = 0;
+  for (int i = 0; i < opts.num_flushes; i++) {
+    SimulatedFlush flush;
+    flush.size_bytes = opts.flush_size_bytes;
+    if (next_key > 0 && rng->NextDoubleFraction() < opts.random_fraction) {
+      flush.min_key = 0;
+      flush.max_key = next_key - 1;
+    } else {
+      flush.min_key = next_key;
+      flush.max_key = next_key + opts.keys_per_flush - 1;
+      next_key += opts.keys_per_flush;
+    }
+    flushes->push_back(flush);
+  }
+}
+
+CompactionSimulator::CompactionSimulator(CompactionPolicy* policy, Options opts)
+    : policy_(policy),
+      opts_(opts) {
+}
+
+CompactionSimulator::~CompactionSimulator() {}
+
+Status CompactionSimulator::Flush(const SimulatedFlush& flush) {
+  if (flush.min_key > flush.max_key || flush.size_bytes <= 0) {
+    return Status::InvalidArgument("bad flush", Substitute("[$0, $1], $2 bytes", flush.min_key,
+                                                           flush.max_key, flush.size_bytes));
+  }
+  Roll({ flush }, policy_->target_rowset_size(), &rowsets_);
+  num_flushes_++;
+  bytes_flushed_ += flush.size_bytes;
+
+  for (int i = 0; i < opts_.max_compactions_per_flush; i++) {
+    bool compacted;
+    RETURN_NOT_OK(MaybeCompact(&compacted));
+    if (!compacted) {
+      break;
+    }
+  }
+  return Status::OK();
+}
+
+Status CompactionSimulator::Replay(const vector<SimulatedFlush>& flushes,
+                                   vector<CompactionSimulatorSample>* samples) {
+  for (const SimulatedFlush& flush : flushes) {
+    RETURN_NOT_OK(Flush(flush));
+    if (samples) {
+      samples->push_back(Sample());
+    }
+  }
+  return Status::OK();
+}
+
+Status CompactionSimulator::MaybeCompact(bool* compacted) {
+  *compacted = false;
+  RowSetTree tree;
+  RETURN_NOT_OK(tree.Reset(rowsets_));
+  unordered_set<RowSet*> picked;
+  double quality = 0;
+  RETURN_NOT_OK(policy_->PickRowSets(tree, Timestamp::kMin, &picked, &quality, nullptr));
+  // With no deleted rows to drop, rewriting a single rowset gains nothing.
+  if (picked.size() < 2 || quality <= opts_.min_quality) {
+    return Status::OK();
+  }
+
+  vector<SimulatedFlush> inputs;
+  RowSetVector remaining;
+  for (const auto& rs : rowsets_) {
+    if (ContainsKey(picked, rs.get())) {
+      inputs.push_back(RangeOf(rs));
+      bytes_compacted_ += RangeOf(rs).size_bytes;
+    } else {
+      remaining.push_back(rs);
+    }
+  }
+  Roll(inputs, policy_->target_rowset_size(), &remaining);
+  rowsets_.swap(remaining);
+  num_compactions_++;
+  *compacted = true;
+  return Status::OK();
+}
+
+CompactionSimulatorSample CompactionSimulator::Sample() const {
+  CompactionSimulatorSample sample;
+  sample.num_flushes = num_flushes_;
+  sample.num_compactions = num_compactions_;
+  sample.bytes_flushed = bytes_flushed_;
+  sample.bytes_compacted = bytes_compacted_;
+  sample.num_rowsets = rowsets_.size();
+
+  // Sweep the key space, tracking the number of rowsets spanning each key.
+  vector<pair<double, int>> edges;
+  for (const auto& rs : rowsets_) {
+    edges.emplace_back(RangeOf(rs).min_key, 1);
+    edges.emplace_back(static_cast<double>(RangeOf(rs).max_key) + 1, -1);
+  }
+  std::sort(edges.begin(), edges.end());
+  int height = 0;
+  double covered = 0;
+  double weighted_height = 0;
+  for (int i = 0; i + 1 < edges.size(); i++) {
+    height += edges[i].second;
+    sample.max_height = std::max(sample.max_height, height);
+    if (height > 0) {
+      double width = edges[i + 1].first - edges[i].first;
+      covered += width;
+      weighted_height += width * height;
+    }
+  }
+  sample.average_height = covered > 0 ? weighted_height / covered : 0;
+  return sample;
+}
+
+} // namespace tablet
+} // namespace kudu
@@ -0,0 +1,148 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TABLET_COMPACTION_SIMULATOR_H
+#define KUDU_TABLET_COMPACTION_SIMULATOR_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/tablet/rowset.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class Random;
+
+namespace tablet {
+
+class CompactionPolicy;
+
+// A flush of the MemRowSet of a simulated tablet. The keys are those of a
+// single INT64 key column, and the flushed data is assumed to be spread
+// evenly over [min_key, max_key].
+struct SimulatedFlush {
+  int64_t min_key;
+  int64_t max_key;
+  int64_t size_bytes;
+};
+
+// Parses a recorded trace of flushes, one per line of the form
+// "<size in MB>\t<min key>\t<max key>", as in the rowset dumps used by
+// compaction_policy-test. Empty lines and lines starting with '#' are
+// skipped.
+Status ParseCompactionTrace(const std::string& data, std::vector<SimulatedFlush>* flushes);
+
+struct SyntheticTraceOptions {
+  int num_flushes = 1000;
+
+  int64_t flush_size_bytes = 64 * 1024 * 1024;
+
+  // Number of keys inserted between flushes.
+  int64_t keys_per_flush = 1000000;
+
+  // Probability that a flush holds keys spread over all the keys inserted so
+  // far, as with random inserts, rather than the keys following those of the
+  // previous flush, as with sequential inserts.
+  double random_fraction = 0;
+};
+
+// Generates a synthetic trace of flushes of a workload described by 'opts'.
+void GenerateCompactionTrace(const SyntheticTraceOptions& opts, Random* rng,
+                             std::vector<SimulatedFlush>* flushes);
+
+// The state of the simulated tablet after a flush and the compactions which
+// followed it.
+struct CompactionSimulatorSample {
+  int64_t num_flushes = 0;
+  int64_t num_compactions = 0;
+  int64_t bytes_flushed = 0;
+  int64_t bytes_compacted = 0;
+
+  int num_rowsets = 0;
+
+  // The average number of rowsets spanning a key, over the keys spanned by
+  // any rowset. This is the expected number of bloom filter probes of an
+  // insert of a random key.
+  double average_height = 0;
+  int max_height = 0;
+
+  // The bytes written to disk by flushes and compactions, per byte flushed.
+  double write_amplification() const {
+    return bytes_flushed == 0 ? 0 :
+        static_cast<double>(bytes_flushed + bytes_compacted) / bytes_flushed;
+  }
+};
+
+// Replays flushes through a compaction policy, modeling the rowsets which
+// result from the flushes and compactions of a tablet without doing any I/O.
+//
+// As in a tablet, both flushes and compactions roll their output into
+// rowsets of the policy's target_rowset_size(), and the output of a
+// compaction is assumed to be spread over its key range like the data of
+// its inputs was.
+class CompactionSimulator {
+ public:
+  struct Options {
+    // Maximum number of compactions run after each flush, modeling how far
+    // the maintenance threads keep up with the ingest.
+    int max_compactions_per_flush = 1;
+
+    // Compactions of a lower quality than this aren't run.
+    double min_quality = 0;
+  };
+
+  // 'policy' must outlive the simulator.
+  CompactionSimulator(CompactionPolicy* policy, Options opts);
+  ~CompactionSimulator();
+
+  // Adds the rowsets of 'flush', then runs compactions.
+  Status Flush(const SimulatedFlush& flush);
+
+  // Replays 'flushes', appending the state of the tablet after each to
+  // 'samples' if it isn't null.
+  Status Replay(const std::vector<SimulatedFlush>& flushes,
+                std::vector<CompactionSimulatorSample>* samples);
+
+  // Returns the current state of the tablet.
+  CompactionSimulatorSample Sample() const;
+
+  const RowSetVector& rowsets() const { return rowsets_; }
+
+ private:
+  // Runs a compaction, if the policy picks one worth running. Sets
+  // '*compacted' to whether it did.
+  Status MaybeCompact(bool* compacted);
+
+  CompactionPolicy* const policy_;
+  const Options opts_;
+
+  RowSetVector rowsets_;
+
+  int64_t num_flushes_ = 0;
+  int64_t num_compactions_ = 0;
+  int64_t bytes_flushed_ = 0;
+  int64_t bytes_compacted_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(CompactionSimulator);
+};
+
+} // namespace tablet
+} // namespace kudu
+#endif
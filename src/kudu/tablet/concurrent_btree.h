@@ -293,6 +293,32 @@ class ValueSlice {
     ptr_ = const_cast<const uint8_t*>(in_arena);
   }
 
+  // Allocate a value of 'size' bytes from 'alloc_arena' with the same layout
+  // as set() would produce, followed by 'trailer_size' bytes for the caller's
+  // own use, and return a pointer to the value's data (or NULL if the arena
+  // is out of memory). Once filled in, the value can be inserted with
+  // PreparedMutation::InsertPreallocated(), which adopts it without a copy.
+  template<class ArenaType>
+  static uint8_t* Allocate(size_t size, size_t trailer_size, ArenaType* alloc_arena) {
+    DCHECK_LE(size, MathLimits<size_type>::kMax)
+      << "Slice too large for btree";
+    uint8_t* in_arena = reinterpret_cast<uint8_t*>(
+      alloc_arena->AllocateBytesAligned(sizeof(size_type) + size + trailer_size,
+                                        sizeof(uint8_t*)));
+    if (PREDICT_FALSE(in_arena == nullptr)) {
+      return nullptr;
+    }
+    size_type stored_size = size;
+    memcpy(in_arena, &stored_size, sizeof(stored_size));
+    return in_arena + sizeof(size_type);
+  }
+
+  // Set this slice to refer to a value previously returned by Allocate().
+  void set_preallocated(const Slice& src) {
+    ptr_ = src.data() - sizeof(size_type);
+    DCHECK_EQ(src.size(), *reinterpret_cast<const size_type*>(ptr_));
+  }
+
  private:
   const uint8_t* ptr_;
 } PACKED;
@@ -347,6 +373,17 @@ static void InsertInSliceArray(ISlice *array, size_t num_entries,
   array[idx].set(src, arena);
 }
 
+// Like InsertInSliceArray(), but adopts a value allocated by
+// ValueSlice::Allocate() instead of copying it.
+static inline void InsertPreallocatedInValueArray(ValueSlice *array, size_t num_entries,
+                                                  const Slice &src, size_t idx) {
+  DCHECK_LT(idx, num_entries);
+  for (size_t i = num_entries - 1; i > idx; i--) {
+    array[i] = array[i - 1];
+  }
+  array[idx].set_preallocated(src);
+}
+
 
 template<class Traits>
 class NodeBase {
@@ -697,13 +734,15 @@ class LeafNode : public NodeBase<Traits> {
       return INSERT_DUPLICATE;
     }
 
-    return InsertNew(mut->idx(), mut->key(), val, mut->arena());
+    return InsertNew(mut->idx(), mut->key(), val, mut->arena(), mut->val_preallocated());
   }
 
   // Insert an entry at the given index, which is guaranteed to be
-  // new.
+  // new. If 'val_preallocated' is true, 'val' was allocated by
+  // ValueSlice::Allocate() and is adopted rather than copied.
   InsertStatus InsertNew(size_t idx, const Slice &key, const Slice &val,
-                         typename Traits::ArenaType* arena) {
+                         typename Traits::ArenaType* arena,
+                         bool val_preallocated = false) {
     if (PREDICT_FALSE(num_entries_ == kMaxEntries)) {
       // Full due to metadata
       return INSERT_FULL;
@@ -718,7 +757,11 @@ class LeafNode : public NodeBase<Traits> {
     num_entries_++;
     InsertInSliceArray(keys_, num_entries_, key, idx, arena);
     DebugRacyPoint<Traits>();
-    InsertInSliceArray(vals_, num_entries_, val, idx, arena);
+    if (val_preallocated) {
+      InsertPreallocatedInValueArray(vals_, num_entries_, val, idx);
+    } else {
+      InsertInSliceArray(vals_, num_entries_, val, idx, arena);
+    }
 
     return INSERT_SUCCESS;
   }
@@ -829,7 +872,8 @@ class PreparedMutation {
   // The data referred to by the 'key' Slice passed in themust remain
   // valid for the lifetime of the PreparedMutation object.
   explicit PreparedMutation(Slice key)
-      : key_(std::move(key)), tree_(NULL), leaf_(NULL), needs_unlock_(false) {}
+      : key_(std::move(key)), tree_(NULL), leaf_(NULL), needs_unlock_(false),
+        val_preallocated_(false) {}
 
   ~PreparedMutation() {
     UnPrepare();
@@ -838,6 +882,7 @@ class PreparedMutation {
   void Reset(const Slice& key) {
     UnPrepare();
     key_ = key;
+    val_preallocated_ = false;
   }
 
   // Prepare a mutation against the given tree.
@@ -861,6 +906,15 @@ class PreparedMutation {
     return tree_->Insert(this, val);
   }
 
+  // Like Insert(), but 'val' must have been allocated with
+  // ValueSlice::Allocate() from an arena which outlives the tree. The
+  // tree adopts the value instead of copying it.
+  bool InsertPreallocated(const Slice &val) {
+    CHECK(prepared());
+    val_preallocated_ = true;
+    return tree_->Insert(this, val);
+  }
+
   // Return a slice referencing the existing data in the row.
   //
   // This is mutable data, but the size may not be changed.
@@ -905,6 +959,10 @@ class PreparedMutation {
     return arena_;
   }
 
+  bool val_preallocated() const {
+    return val_preallocated_;
+  }
+
  private:
   friend class CBTree<Traits>;
   friend class LeafNode<Traits>;
@@ -938,6 +996,9 @@ class PreparedMutation {
   size_t idx_;
   bool exists_;
   bool needs_unlock_;
+
+  // Whether the value being inserted was allocated by ValueSlice::Allocate().
+  bool val_preallocated_;
 };
 
 
@@ -947,11 +1008,15 @@ class CBTree {
   CBTree()
     : arena_(new typename Traits::ArenaType(512*1024, 4*1024*1024)),
       root_(NewLeaf(false)),
+      rightmost_leaf_(reinterpret_cast<AtomicWord>(root_.leaf_node_ptr())),
       frozen_(false) {
   }
 
   explicit CBTree(std::shared_ptr<typename Traits::ArenaType> arena)
-      : arena_(std::move(arena)), root_(NewLeaf(false)), frozen_(false) {}
+      : arena_(std::move(arena)),
+        root_(NewLeaf(false)),
+        rightmost_leaf_(reinterpret_cast<AtomicWord>(root_.leaf_node_ptr())),
+        frozen_(false) {}
 
   ~CBTree() {
     RecursiveDelete(root_);
@@ -1262,8 +1327,49 @@ class CBTree {
     }
   }
 
+  // Try to prepare 'mutation' against the rightmost leaf, without
+  // traversing from the root. This succeeds when the key sorts after every
+  // key already in the tree, which is the common case for monotonically
+  // increasing keys (eg timestamps).
+  //
+  // Returns true, with the rightmost leaf locked, if the mutation was
+  // prepared. Otherwise returns false and no node is locked.
+  bool TryPrepareAppend(PreparedMutation<Traits> *mutation) {
+    LeafNode<Traits> *leaf = reinterpret_cast<LeafNode<Traits> *>(
+      base::subtle::Acquire_Load(&rightmost_leaf_));
+
+    // Peek without the lock first, so that non-sequential workloads don't
+    // all contend on the rightmost leaf. The unlocked reads may see
+    // bogus data (though the key pointer is always valid), so everything is
+    // checked again below once the lock is held.
+    int num_entries = leaf->num_entries();
+    if (leaf->next_ != NULL ||
+        num_entries == 0 ||
+        mutation->key().compare(leaf->GetKey(num_entries - 1)) <= 0) {
+      return false;
+    }
+
+    leaf->Lock();
+    // Leaves are never removed from the tree, and only stop being the
+    // rightmost leaf by splitting, which requires the lock. So, if it has
+    // no right sibling now, any key greater than its last key belongs in it.
+    num_entries = leaf->num_entries();
+    if (PREDICT_FALSE(leaf->next_ != NULL ||
+                      mutation->key().compare(leaf->GetKey(num_entries - 1)) <= 0)) {
+      leaf->Unlock();
+      return false;
+    }
+    mutation->leaf_ = leaf;
+    mutation->idx_ = num_entries;
+    mutation->exists_ = false;
+    return true;
+  }
+
   void PrepareMutation(PreparedMutation<Traits> *mutation) {
     DCHECK_EQ(mutation->tree(), this);
+    if (TryPrepareAppend(mutation)) {
+      return;
+    }
     while (true) {
       AtomicVersion stable_version;
       LeafNode<Traits> *lnode = TraverseToLeaf(mutation->key(), &stable_version);
@@ -1401,12 +1507,15 @@ class CBTree {
   }
 
   // Split the given leaf node 'node', creating a new node
-  // with the higher half of the elements.
+  // with the higher half of the elements. If 'append' is true,
+  // 'node' must be the rightmost leaf, and the new node is
+  // created empty instead.
   //
   // N.B: the new node is initially locked, but doesn't have the
   // SPLITTING flag. This function sets the SPLITTING flag before
   // modifying it.
   void SplitLeafNode(LeafNode<Traits> *node,
+                     bool append,
                      LeafNode<Traits> **new_node) {
     DCHECK(node->IsLocked());
 
@@ -1428,10 +1537,19 @@ class CBTree {
     LeafNode<Traits> *new_leaf = NewLeaf(true);
     new_leaf->next_ = node->next_;
 
-    // Copy half the keys from node into the new leaf
-    int copy_start = node->num_entries() / 2;
-    CHECK_GT(copy_start, 0) <<
-      "Trying to split a node with 0 or 1 entries";
+    int copy_start;
+    if (append) {
+      // Splitting the rightmost leaf to append a key past its end, as
+      // with sequential inserts. Leave the node full and start the new
+      // leaf empty: splitting in half would leave every leaf behind the
+      // insertion point half-empty, and split twice as often.
+      copy_start = node->num_entries();
+    } else {
+      // Copy half the keys from node into the new leaf
+      copy_start = node->num_entries() / 2;
+      CHECK_GT(copy_start, 0) <<
+        "Trying to split a node with 0 or 1 entries";
+    }
 
     std::copy(node->keys_ + copy_start, node->keys_ + node->num_entries(),
               new_leaf->keys_);
@@ -1440,10 +1558,18 @@ class CBTree {
     new_leaf->num_entries_ = node->num_entries() - copy_start;
 
     // Truncate the left node to remove the keys which have been
-    // moved to the right node.
+    // moved to the right node. Even if no keys were moved, the split
+    // flag must be set so that concurrent traversers retry and find the
+    // new node.
     node->SetSplitting();
     node->next_ = new_leaf;
-    node->Truncate(copy_start);
+    if (copy_start < node->num_entries()) {
+      node->Truncate(copy_start);
+    }
+    if (new_leaf->next_ == NULL) {
+      base::subtle::Release_Store(&rightmost_leaf_,
+                                  reinterpret_cast<AtomicWord>(new_leaf));
+    }
     *new_node = new_leaf;
   }
 
@@ -1463,23 +1589,32 @@ class CBTree {
 
     //DebugPrint();
 
+    // If the key goes past the end of the rightmost leaf, the new key
+    // becomes the first (and only) entry of the new leaf.
+    bool append = node->next_ == NULL &&
+                  mutation->idx() == static_cast<size_t>(node->num_entries());
+
     LeafNode<Traits> *new_leaf;
-    SplitLeafNode(node, &new_leaf);
+    SplitLeafNode(node, append, &new_leaf);
 
     // The new leaf node is returned still locked.
     DCHECK(new_leaf->IsLocked());
 
     // Insert the key that we were originally trying to insert in the
     // correct side post-split.
-    Slice split_key = new_leaf->GetKey(0);
-    LeafNode<Traits> *dst_leaf = (key.compare(split_key) < 0) ? node : new_leaf;
+    LeafNode<Traits> *dst_leaf;
+    if (append) {
+      dst_leaf = new_leaf;
+    } else {
+      dst_leaf = (key.compare(new_leaf->GetKey(0)) < 0) ? node : new_leaf;
+    }
     // Re-prepare the mutation after the split.
     dst_leaf->PrepareMutation(mutation);
 
     CHECK_EQ(INSERT_SUCCESS, dst_leaf->Insert(mutation, val))
-      << "node split at " << split_key.ToDebugString()
-      << " did not result in enough space for key " << key.ToDebugString()
-      << " in left node";
+      << "node split did not result in enough space for key "
+      << key.ToDebugString();
+    Slice split_key = new_leaf->GetKey(0);
 
     // Insert the new node into the parents.
     PropagateSplitUpward(node, new_leaf, split_key);
@@ -1591,6 +1726,11 @@ class CBTree {
   // when they encounter a stale root pointer.
   mutable NodePtr<Traits> root_;
 
+  // The leaf with no right sibling, ie the one holding the largest keys.
+  // Used by inserts to skip the traversal when appending past the end of
+  // the tree. Updated, with the leaf locked, whenever that leaf splits.
+  AtomicWord rightmost_leaf_;
+
   // If true, the tree is no longer mutable. Once a tree becomes
   // frozen, it may not be un-frozen. If an iterator is created on
   // a frozen tree, it will be more efficient.
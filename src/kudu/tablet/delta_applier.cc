@@ -37,7 +37,8 @@ DeltaApplier::DeltaApplier(shared_ptr<CFileSet::Iterator> base_iter,
                            unique_ptr<DeltaIterator> delta_iter)
     : base_iter_(std::move(base_iter)),
       delta_iter_(std::move(delta_iter)),
-      first_prepare_(true) {}
+      first_prepare_(true),
+      next_ordinal_(0) {}
 
 DeltaApplier::~DeltaApplier() {
 }
@@ -64,7 +65,10 @@ const Schema &DeltaApplier::schema() const {
 }
 
 void DeltaApplier::GetIteratorStats(std::vector<IteratorStats>* stats) const {
-  return base_iter_->GetIteratorStats(stats);
+  base_iter_->GetIteratorStats(stats);
+  for (IteratorStats& col_stats : *stats) {
+    col_stats.delta_stores_read += delta_iter_->num_stores();
+  }
 }
 
 bool DeltaApplier::HasNext() const {
@@ -75,12 +79,17 @@ Status DeltaApplier::PrepareBatch(size_t *nrows) {
   // The initial seek is deferred from Init() into the first PrepareBatch()
   // because it requires a loaded delta file, and we don't want to require
   // that at Init() time.
-  if (first_prepare_) {
-    RETURN_NOT_OK(delta_iter_->SeekToOrdinal(base_iter_->cur_ordinal_idx()));
+  //
+  // The base iterator of a sampled scan skips the rows which aren't sampled,
+  // in which case the deltas are seeked past them too.
+  rowid_t ordinal = base_iter_->cur_ordinal_idx();
+  if (first_prepare_ || ordinal != next_ordinal_) {
+    RETURN_NOT_OK(delta_iter_->SeekToOrdinal(ordinal));
     first_prepare_ = false;
   }
   RETURN_NOT_OK(base_iter_->PrepareBatch(nrows));
   RETURN_NOT_OK(delta_iter_->PrepareBatch(*nrows, DeltaIterator::PREPARE_FOR_APPLY));
+  next_ordinal_ = ordinal + *nrows;
   return Status::OK();
 }
 
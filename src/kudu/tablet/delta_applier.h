@@ -78,6 +78,10 @@ class DeltaApplier : public ColumnwiseIterator {
   std::unique_ptr<DeltaIterator> delta_iter_;
 
   bool first_prepare_;
+
+  // The ordinal of the row following the last prepared batch, at which the
+  // delta iterator is positioned.
+  rowid_t next_ordinal_;
 };
 
 } // namespace tablet
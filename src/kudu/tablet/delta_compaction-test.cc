@@ -166,7 +166,7 @@ TEST_F(TestDeltaCompaction, TestMergeMultipleSchemas) {
       DeltaKey key((i < kNumMultipleUpdates) ? i : row_id, Timestamp(curr_timestamp));
       RowChangeList row_changes = update.as_changelist();
       ASSERT_OK(dfw->AppendDelta<REDO>(key, row_changes));
-      ASSERT_OK(stats.UpdateStats(key.timestamp(), row_changes));
+      ASSERT_OK(stats.UpdateStats(key, row_changes));
       curr_timestamp++;
       row_id++;
     }
@@ -208,5 +208,60 @@ TEST_F(TestDeltaCompaction, TestMergeMultipleSchemas) {
   ASSERT_TRUE(is_sorted(results.begin(), results.end()));
 }
 
+// Delta files mutating disjoint ranges of rows are merged without losing or
+// reordering any delta, though each batch only reads the files overlapping it.
+TEST_F(TestDeltaCompaction, TestMergeDisjointRowRanges) {
+  const int kNumFiles = 4;
+  const int kRowsPerFile = 250;
+  vector<shared_ptr<DeltaStore> > inputs;
+  faststring buf;
+  for (int f = 0; f < kNumFiles; f++) {
+    BlockId block_id;
+    gscoped_ptr<DeltaFileWriter> dfw;
+    ASSERT_OK(GetDeltaFileWriter(&dfw, &block_id));
+    DeltaStats stats;
+    for (int i = 0; i < kRowsPerFile; i++) {
+      buf.clear();
+      RowChangeListEncoder update(&buf);
+      uint32_t val = f;
+      update.AddColumnUpdate(schema_.column(0), schema_.column_id(0), &val);
+      DeltaKey key(f * kRowsPerFile + i, Timestamp(f * kRowsPerFile + i));
+      ASSERT_OK(dfw->AppendDelta<REDO>(key, update.as_changelist()));
+      ASSERT_OK(stats.UpdateStats(key, update.as_changelist()));
+    }
+    ASSERT_OK(dfw->WriteDeltaStats(stats));
+    ASSERT_OK(dfw->Finish());
+    shared_ptr<DeltaFileReader> dfr;
+    ASSERT_OK(GetDeltaFileReader(block_id, &dfr));
+    ASSERT_OK(dfr->Init());
+    ASSERT_EQ(f * kRowsPerFile, dfr->delta_stats().min_row_id());
+    ASSERT_EQ((f + 1) * kRowsPerFile - 1, dfr->delta_stats().max_row_id());
+    inputs.push_back(dfr);
+  }
+
+  MvccSnapshot snap(MvccSnapshot::CreateSnapshotIncludingAllTransactions());
+  unique_ptr<DeltaIterator> merge_iter;
+  ASSERT_OK(DeltaIteratorMerger::Create(inputs, &schema_, snap, &merge_iter));
+  gscoped_ptr<DeltaFileWriter> dfw;
+  BlockId block_id;
+  ASSERT_OK(GetDeltaFileWriter(&dfw, &block_id));
+  ASSERT_OK(WriteDeltaIteratorToFile<REDO>(merge_iter.get(), ITERATE_OVER_ALL_ROWS, dfw.get()));
+  ASSERT_OK(dfw->Finish());
+
+  shared_ptr<DeltaFileReader> dfr;
+  ASSERT_OK(GetDeltaFileReader(block_id, &dfr));
+  ASSERT_OK(dfr->Init());
+  ASSERT_EQ(0, dfr->delta_stats().min_row_id());
+  ASSERT_EQ(kNumFiles * kRowsPerFile - 1, dfr->delta_stats().max_row_id());
+
+  DeltaIterator* raw_iter;
+  ASSERT_OK(dfr->NewDeltaIterator(&schema_, snap, &raw_iter));
+  gscoped_ptr<DeltaIterator> scoped_iter(raw_iter);
+  vector<string> results;
+  ASSERT_OK(DebugDumpDeltaIterator(REDO, scoped_iter.get(), schema_,
+                                   ITERATE_OVER_ALL_ROWS, &results));
+  ASSERT_EQ(kNumFiles * kRowsPerFile, results.size());
+}
+
 } // namespace tablet
 } // namespace kudu
@@ -42,6 +42,7 @@ namespace kudu {
 using cfile::CFileIterator;
 using cfile::CFileReader;
 using cfile::IndexTreeIterator;
+using fs::CreateBlockOptions;
 using fs::WritableBlock;
 using std::unique_ptr;
 using std::vector;
@@ -58,12 +59,14 @@ const size_t kRowsPerBlock = 100; // Number of rows per block of columns
 // TODO: can you major-delta-compact a new column after an alter table in order
 // to materialize it? should write a test for this.
 MajorDeltaCompaction::MajorDeltaCompaction(
-    FsManager* fs_manager, const Schema& base_schema, CFileSet* base_data,
+    FsManager* fs_manager, string tablet_id,
+    const Schema& base_schema, CFileSet* base_data,
     unique_ptr<DeltaIterator> delta_iter,
     vector<shared_ptr<DeltaStore> > included_stores,
     vector<ColumnId> col_ids,
     HistoryGcOpts history_gc_opts)
     : fs_manager_(fs_manager),
+      tablet_id_(std::move(tablet_id)),
       base_schema_(base_schema),
       column_ids_(std::move(col_ids)),
       history_gc_opts_(std::move(history_gc_opts)),
@@ -182,7 +185,7 @@ Status MajorDeltaCompaction::FlushRowSetAndDeltas() {
       for (const Mutation *mut = new_undos_head; mut != nullptr; mut = mut->next()) {
         DeltaKey undo_key(nrows + dst_row.row_index(), mut->timestamp());
         RETURN_NOT_OK(new_undo_delta_writer_->AppendDelta<UNDO>(undo_key, mut->changelist()));
-        undo_stats.UpdateStats(mut->timestamp(), mut->changelist());
+        undo_stats.UpdateStats(undo_key, mut->changelist());
         undo_delta_mutations_written_++;
       }
     }
@@ -208,7 +211,7 @@ Status MajorDeltaCompaction::FlushRowSetAndDeltas() {
       RowChangeList update(key_and_update.cell);
       RETURN_NOT_OK_PREPEND(new_redo_delta_writer_->AppendDelta<REDO>(key_and_update.key, update),
                             "Failed to append a delta");
-      WARN_NOT_OK(redo_stats.UpdateStats(key_and_update.key.timestamp(), update),
+      WARN_NOT_OK(redo_stats.UpdateStats(key_and_update.key, update),
                   "Failed to update stats");
     }
     redo_delta_mutations_written_ += out.size();
@@ -242,7 +245,8 @@ Status MajorDeltaCompaction::FlushRowSetAndDeltas() {
 Status MajorDeltaCompaction::OpenBaseDataWriter() {
   CHECK(!base_data_writer_);
 
-  gscoped_ptr<MultiColumnWriter> w(new MultiColumnWriter(fs_manager_, &partial_schema_));
+  gscoped_ptr<MultiColumnWriter> w(new MultiColumnWriter(fs_manager_, &partial_schema_,
+                                                         nullptr, tablet_id_));
   RETURN_NOT_OK(w->Open());
   base_data_writer_.swap(w);
   return Status::OK();
@@ -250,7 +254,7 @@ Status MajorDeltaCompaction::OpenBaseDataWriter() {
 
 Status MajorDeltaCompaction::OpenRedoDeltaFileWriter() {
   gscoped_ptr<WritableBlock> block;
-  RETURN_NOT_OK_PREPEND(fs_manager_->CreateNewBlock(&block),
+  RETURN_NOT_OK_PREPEND(fs_manager_->CreateNewBlock(CreateBlockOptions::Background(tablet_id_), &block),
                         "Unable to create REDO delta output block");
   new_redo_delta_block_ = block->id();
   new_redo_delta_writer_.reset(new DeltaFileWriter(std::move(block)));
@@ -259,7 +263,7 @@ Status MajorDeltaCompaction::OpenRedoDeltaFileWriter() {
 
 Status MajorDeltaCompaction::OpenUndoDeltaFileWriter() {
   gscoped_ptr<WritableBlock> block;
-  RETURN_NOT_OK_PREPEND(fs_manager_->CreateNewBlock(&block),
+  RETURN_NOT_OK_PREPEND(fs_manager_->CreateNewBlock(CreateBlockOptions::Background(tablet_id_), &block),
                         "Unable to create UNDO delta output block");
   new_undo_delta_block_ = block->id();
   new_undo_delta_writer_.reset(new DeltaFileWriter(std::move(block)));
@@ -310,6 +314,8 @@ Status MajorDeltaCompaction::CreateMetadataUpdate(
   // Replace old column blocks with new ones
   RowSetMetadata::ColumnIdToBlockIdMap new_column_blocks;
   base_data_writer_->GetFlushedBlocksByColumnId(&new_column_blocks);
+  RowSetMetadata::ColumnIdToStatsMap new_column_stats;
+  base_data_writer_->GetColumnStatisticsByColumnId(&new_column_stats);
 
   // NOTE: in the case that one of the columns being compacted is deleted,
   // we may have fewer elements in new_column_blocks compared to 'column_ids'.
@@ -319,7 +325,7 @@ Status MajorDeltaCompaction::CreateMetadataUpdate(
   for (ColumnId col_id : column_ids_) {
     BlockId new_block;
     if (FindCopy(new_column_blocks, col_id, &new_block)) {
-      update->ReplaceColumnId(col_id, new_block);
+      update->ReplaceColumnId(col_id, new_block, FindOrDie(new_column_stats, col_id));
     } else {
       // The column has been deleted.
       // If the base data has a block for this column, we need to remove it.
@@ -337,9 +343,9 @@ Status MajorDeltaCompaction::CreateMetadataUpdate(
   return Status::OK();
 }
 
-// We're called under diskrowset's component_lock_ and delta_tracker's compact_flush_lock_
-// so both AtomicUpdateStores calls can be done separately and still be seen as one atomic
-// operation.
+// We're called under diskrowset's component_lock_ and delta_tracker's compact_flush_lock_,
+// after checking that included_stores_ are still tracked, so both AtomicUpdateStores calls
+// can be done separately and still be seen as one atomic operation.
 Status MajorDeltaCompaction::UpdateDeltaTracker(DeltaTracker* tracker) {
   CHECK_EQ(state_, kFinished);
   vector<BlockId> new_delta_blocks;
@@ -54,7 +54,8 @@ class MajorDeltaCompaction {
   // TODO: is base_schema supposed to be the same as base_data->schema()? how about
   // in an ALTER scenario?
   MajorDeltaCompaction(
-      FsManager* fs_manager, const Schema& base_schema, CFileSet* base_data,
+      FsManager* fs_manager, std::string tablet_id,
+      const Schema& base_schema, CFileSet* base_data,
       std::unique_ptr<DeltaIterator> delta_iter,
       std::vector<std::shared_ptr<DeltaStore> > included_stores,
       std::vector<ColumnId> col_ids,
@@ -74,6 +75,11 @@ class MajorDeltaCompaction {
   // Apply the changes to the given delta tracker.
   Status UpdateDeltaTracker(DeltaTracker* tracker);
 
+  // The REDO delta stores read by this compaction, which it replaces.
+  const SharedDeltaStoreVector& included_stores() const {
+    return included_stores_;
+  }
+
  private:
   std::string ColumnNamesToString() const;
 
@@ -94,6 +100,7 @@ class MajorDeltaCompaction {
   Status FlushRowSetAndDeltas();
 
   FsManager* const fs_manager_;
+  const std::string tablet_id_;
 
   // TODO: doc me
   const Schema base_schema_;
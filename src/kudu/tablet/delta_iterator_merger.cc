@@ -18,6 +18,8 @@
 #include "kudu/tablet/delta_iterator_merger.h"
 
 #include <algorithm>
+#include <limits>
+#include <queue>
 
 #include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/strcat.h"
@@ -35,7 +37,10 @@ using strings::Substitute;
 
 DeltaIteratorMerger::DeltaIteratorMerger(
     vector<unique_ptr<DeltaIterator> > iters)
-    : iters_(std::move(iters)) {}
+    : iters_(std::move(iters)),
+      iter_idxs_(iters_.size(), 0),
+      prepared_idx_(0),
+      prepared_count_(0) {}
 
 Status DeltaIteratorMerger::Init(ScanSpec *spec) {
   for (const unique_ptr<DeltaIterator> &iter : iters_) {
@@ -45,35 +50,54 @@ Status DeltaIteratorMerger::Init(ScanSpec *spec) {
 }
 
 Status DeltaIteratorMerger::SeekToOrdinal(rowid_t idx) {
-  for (const unique_ptr<DeltaIterator> &iter : iters_) {
-    RETURN_NOT_OK(iter->SeekToOrdinal(idx));
+  // Every iterator is seeked, which also loads what MayHaveDeltasForRows()
+  // needs to know about its store.
+  for (int i = 0; i < iters_.size(); i++) {
+    RETURN_NOT_OK(iters_[i]->SeekToOrdinal(idx));
+    iter_idxs_[i] = idx;
   }
+  prepared_idx_ = idx;
+  prepared_count_ = 0;
+  active_iters_.clear();
   return Status::OK();
 }
 
 Status DeltaIteratorMerger::PrepareBatch(size_t nrows, PrepareFlag flag) {
-  for (const unique_ptr<DeltaIterator> &iter : iters_) {
+  prepared_idx_ += prepared_count_;
+  prepared_count_ = nrows;
+  active_iters_.clear();
+  for (int i = 0; i < iters_.size(); i++) {
+    DeltaIterator* iter = iters_[i].get();
+    if (!iter->MayHaveDeltasForRows(prepared_idx_, nrows)) {
+      continue;
+    }
+    // An iterator skipped by the previous batches is behind.
+    if (iter_idxs_[i] != prepared_idx_) {
+      RETURN_NOT_OK(iter->SeekToOrdinal(prepared_idx_));
+    }
     RETURN_NOT_OK(iter->PrepareBatch(nrows, flag));
+    iter_idxs_[i] = prepared_idx_ + nrows;
+    active_iters_.push_back(iter);
   }
   return Status::OK();
 }
 
 Status DeltaIteratorMerger::ApplyUpdates(size_t col_to_apply, ColumnBlock *dst) {
-  for (const unique_ptr<DeltaIterator> &iter : iters_) {
+  for (DeltaIterator* iter : active_iters_) {
     RETURN_NOT_OK(iter->ApplyUpdates(col_to_apply, dst));
   }
   return Status::OK();
 }
 
 Status DeltaIteratorMerger::ApplyDeletes(SelectionVector *sel_vec) {
-  for (const unique_ptr<DeltaIterator> &iter : iters_) {
+  for (DeltaIterator* iter : active_iters_) {
     RETURN_NOT_OK(iter->ApplyDeletes(sel_vec));
   }
   return Status::OK();
 }
 
 Status DeltaIteratorMerger::CollectMutations(vector<Mutation *> *dst, Arena *arena) {
-  for (const unique_ptr<DeltaIterator> &iter : iters_) {
+  for (DeltaIterator* iter : active_iters_) {
     RETURN_NOT_OK(iter->CollectMutations(dst, arena));
   }
   // TODO: do we need to do some kind of sorting here to deal with out-of-order
@@ -87,23 +111,80 @@ struct DeltaKeyUpdateComparator {
   }
 };
 
+namespace {
+
+// The next delta of one of the runs merged by MergeDeltaRuns().
+struct DeltaRunCursor {
+  size_t pos;
+  size_t end;
+  int run;
+};
+
+// Merges the sorted runs of 'deltas' starting at 'run_starts' (and ending
+// at the next one, or at the end of 'deltas') into 'out'. Deltas with equal
+// keys are taken in the order of their runs, as a stable sort would.
+void MergeDeltaRuns(const vector<DeltaKeyAndUpdate>& deltas,
+                    const vector<size_t>& run_starts,
+                    vector<DeltaKeyAndUpdate>* out) {
+  // Greatest first, as std::priority_queue pops the greatest element.
+  auto after = [&](const DeltaRunCursor& a, const DeltaRunCursor& b) {
+    int c = deltas[a.pos].key.CompareTo<REDO>(deltas[b.pos].key);
+    return c != 0 ? c > 0 : a.run > b.run;
+  };
+  std::priority_queue<DeltaRunCursor, vector<DeltaRunCursor>, decltype(after)> heap(after);
+  for (int run = 0; run < run_starts.size(); run++) {
+    size_t end = run + 1 < run_starts.size() ? run_starts[run + 1] : deltas.size();
+    if (run_starts[run] < end) {
+      heap.push({ run_starts[run], end, run });
+    }
+  }
+  out->reserve(out->size() + deltas.size());
+  while (!heap.empty()) {
+    DeltaRunCursor cursor = heap.top();
+    heap.pop();
+    out->push_back(deltas[cursor.pos]);
+    if (++cursor.pos < cursor.end) {
+      heap.push(cursor);
+    }
+  }
+}
+
+} // anonymous namespace
+
 Status DeltaIteratorMerger::FilterColumnIdsAndCollectDeltas(
     const vector<ColumnId>& col_ids,
     vector<DeltaKeyAndUpdate>* out,
     Arena* arena) {
-  for (const unique_ptr<DeltaIterator>& iter : iters_) {
-    RETURN_NOT_OK(iter->FilterColumnIdsAndCollectDeltas(col_ids, out, arena));
+  vector<DeltaKeyAndUpdate> deltas;
+  vector<size_t> run_starts;
+  bool runs_sorted = true;
+  for (DeltaIterator* iter : active_iters_) {
+    run_starts.push_back(deltas.size());
+    RETURN_NOT_OK(iter->FilterColumnIdsAndCollectDeltas(col_ids, &deltas, arena));
+    runs_sorted = runs_sorted && std::is_sorted(deltas.begin() + run_starts.back(), deltas.end(),
+                                                DeltaKeyUpdateComparator());
+  }
+  // Each REDO store returns its deltas in order, so their runs only need to
+  // be merged. Otherwise, we use a stable sort here since an input may
+  // include multiple deltas for the same row at the same timestamp, in the
+  // case of a user batch which had several mutations for the same row.
+  // Either way, the user-provided ordering is preserved.
+  if (runs_sorted) {
+    MergeDeltaRuns(deltas, run_starts, out);
+  } else {
+    std::stable_sort(deltas.begin(), deltas.end(), DeltaKeyUpdateComparator());
+    out->insert(out->end(), deltas.begin(), deltas.end());
   }
-  // We use a stable sort here since an input may include multiple deltas for the
-  // same row at the same timestamp, in the case of a user batch which had several
-  // mutations for the same row. Stable sort preserves the user-provided ordering.
-  std::stable_sort(out->begin(), out->end(), DeltaKeyUpdateComparator());
   return Status::OK();
 }
 
 bool DeltaIteratorMerger::HasNext() {
+  // The iterators skipped by the previous batches are behind, but their
+  // stores have no deltas left if they have none from here on.
+  rowid_t next_idx = prepared_idx_ + prepared_count_;
+  size_t rows_left = static_cast<size_t>(std::numeric_limits<rowid_t>::max()) - next_idx + 1;
   for (const unique_ptr<DeltaIterator>& iter : iters_) {
-    if (iter->HasNext()) {
+    if (iter->MayHaveDeltasForRows(next_idx, rows_left) && iter->HasNext()) {
       return true;
     }
   }
@@ -112,7 +193,7 @@ bool DeltaIteratorMerger::HasNext() {
 }
 
 bool DeltaIteratorMerger::MayHaveDeltas() {
-  for (const unique_ptr<DeltaIterator>& iter : iters_) {
+  for (DeltaIterator* iter : active_iters_) {
     if (iter->MayHaveDeltas()) {
       return true;
     }
@@ -120,6 +201,15 @@ bool DeltaIteratorMerger::MayHaveDeltas() {
   return false;
 }
 
+bool DeltaIteratorMerger::MayHaveDeltasForRows(rowid_t start_row, size_t nrows) {
+  for (const unique_ptr<DeltaIterator>& iter : iters_) {
+    if (iter->MayHaveDeltasForRows(start_row, nrows)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 string DeltaIteratorMerger::ToString() const {
   string ret;
   ret.append("DeltaIteratorMerger(");
@@ -138,6 +228,14 @@ string DeltaIteratorMerger::ToString() const {
 }
 
 
+int DeltaIteratorMerger::num_stores() const {
+  int num_stores = 0;
+  for (const unique_ptr<DeltaIterator>& iter : iters_) {
+    num_stores += iter->num_stores();
+  }
+  return num_stores;
+}
+
 Status DeltaIteratorMerger::Create(
     const vector<shared_ptr<DeltaStore> > &stores,
     const Schema* projection,
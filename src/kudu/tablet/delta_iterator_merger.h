@@ -29,8 +29,13 @@ class ScanSpec;
 
 namespace tablet {
 
-// DeltaIterator that simply combines together other DeltaIterators,
-// applying deltas from each in order.
+// DeltaIterator that combines together other DeltaIterators, applying
+// deltas from each in order.
+//
+// Each batch only involves the iterators whose stores may have deltas for
+// its rows (see DeltaIterator::MayHaveDeltasForRows()), so that rowsets with
+// many small delta files, each mutating a narrow range of rows, don't pay
+// for every file on every batch.
 class DeltaIteratorMerger : public DeltaIterator {
  public:
   // Create a new DeltaIterator which combines the deltas from
@@ -58,12 +63,25 @@ class DeltaIteratorMerger : public DeltaIterator {
                                                  Arena* arena) OVERRIDE;
   virtual bool HasNext() OVERRIDE;
   bool MayHaveDeltas() override;
+  bool MayHaveDeltasForRows(rowid_t start_row, size_t nrows) override;
+  int num_stores() const override;
   virtual std::string ToString() const OVERRIDE;
 
  private:
   explicit DeltaIteratorMerger(vector<std::unique_ptr<DeltaIterator> > iters);
 
   std::vector<std::unique_ptr<DeltaIterator> > iters_;
+
+  // The ordinal up to which each of iters_ has been prepared, past which
+  // it must be seeked again before its next batch.
+  std::vector<rowid_t> iter_idxs_;
+
+  // The iterators prepared for the current batch, in the order of iters_.
+  std::vector<DeltaIterator*> active_iters_;
+
+  // The first row and number of rows of the current batch.
+  rowid_t prepared_idx_;
+  size_t prepared_count_;
 };
 
 } // namespace tablet
@@ -16,6 +16,8 @@
 // under the License.
 #include "kudu/tablet/delta_stats.h"
 
+#include <algorithm>
+#include <limits>
 #include <utility>
 #include <vector>
 
@@ -33,7 +35,9 @@ namespace tablet {
 DeltaStats::DeltaStats()
     : delete_count_(0),
       max_timestamp_(Timestamp::kMin),
-      min_timestamp_(Timestamp::kMax) {
+      min_timestamp_(Timestamp::kMax),
+      min_row_id_(std::numeric_limits<rowid_t>::max()),
+      max_row_id_(0) {
 }
 
 void DeltaStats::IncrUpdateCount(ColumnId col_id, int64_t update_count) {
@@ -45,7 +49,7 @@ void DeltaStats::IncrDeleteCount(int64_t delete_count) {
   delete_count_ += delete_count;
 }
 
-Status DeltaStats::UpdateStats(const Timestamp& timestamp,
+Status DeltaStats::UpdateStats(const DeltaKey& key,
                                const RowChangeList& update) {
   // Decode the update, incrementing the update count for each of the
   // columns we find present.
@@ -61,21 +65,25 @@ Status DeltaStats::UpdateStats(const Timestamp& timestamp,
     }
   } // Don't handle re-inserts
 
+  const Timestamp& timestamp = key.timestamp();
   if (min_timestamp_.CompareTo(timestamp) > 0) {
     min_timestamp_ = timestamp;
   }
   if (max_timestamp_.CompareTo(timestamp) < 0) {
     max_timestamp_ = timestamp;
   }
+  min_row_id_ = std::min(min_row_id_, key.row_idx());
+  max_row_id_ = std::max(max_row_id_, key.row_idx());
 
   return Status::OK();
 }
 
 string DeltaStats::ToString() const {
   string ret = strings::Substitute(
-      "ts range=[$0, $1]",
+      "ts range=[$0, $1], row id range=[$2, $3]",
       min_timestamp_.ToString(),
-      max_timestamp_.ToString());
+      max_timestamp_.ToString(),
+      min_row_id_, max_row_id_);
   ret.append(", update_counts_by_col_id=[");
   ret.append(JoinKeysAndValuesIterator(update_counts_by_col_id_.begin(),
                                        update_counts_by_col_id_.end(),
@@ -97,6 +105,8 @@ void DeltaStats::ToPB(DeltaStatsPB* pb) const {
 
   pb->set_max_timestamp(max_timestamp_.ToUint64());
   pb->set_min_timestamp(min_timestamp_.ToUint64());
+  pb->set_min_row_id(min_row_id_);
+  pb->set_max_row_id(max_row_id_);
 }
 
 Status DeltaStats::InitFromPB(const DeltaStatsPB& pb) {
@@ -107,6 +117,14 @@ Status DeltaStats::InitFromPB(const DeltaStatsPB& pb) {
   }
   max_timestamp_.FromUint64(pb.max_timestamp());
   min_timestamp_.FromUint64(pb.min_timestamp());
+  // Files written before the row id range was recorded may mutate any row.
+  if (pb.has_min_row_id() && pb.has_max_row_id()) {
+    min_row_id_ = pb.min_row_id();
+    max_row_id_ = pb.max_row_id();
+  } else {
+    min_row_id_ = 0;
+    max_row_id_ = std::numeric_limits<rowid_t>::max();
+  }
   return Status::OK();
 }
 
@@ -28,6 +28,7 @@
 #include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/common/row_changelist.h"
+#include "kudu/tablet/delta_key.h"
 #include "kudu/tablet/mvcc.h"
 
 namespace kudu {
@@ -48,8 +49,8 @@ class DeltaStats {
   void IncrDeleteCount(int64_t delete_count);
 
   // Increment delete and update counts based on changes contained in
-  // 'update'.
-  Status UpdateStats(const Timestamp& timestamp,
+  // 'update', and widen the timestamp and row id ranges to include 'key'.
+  Status UpdateStats(const DeltaKey& key,
                      const RowChangeList& update);
 
   // Return the number of deletes in the current delta store.
@@ -80,6 +81,23 @@ class DeltaStats {
     min_timestamp_ = timestamp;
   }
 
+  // Returns the range of the ids of the rows mutated in a delta file, which
+  // is empty (min > max) if there are no mutations. For delta files written
+  // before the range was recorded, it covers every row.
+  rowid_t min_row_id() const {
+    return min_row_id_;
+  }
+  rowid_t max_row_id() const {
+    return max_row_id_;
+  }
+
+  // Returns whether any of the 'nrows' rows starting at 'start_row' may have
+  // been mutated.
+  bool MayHaveRowsInRange(rowid_t start_row, size_t nrows) const {
+    return nrows > 0 && start_row <= max_row_id_ &&
+        start_row + nrows - 1 >= min_row_id_;
+  }
+
   std::string ToString() const;
 
   // Convert this object to the protobuf which is stored in the DeltaFile footer.
@@ -97,6 +115,8 @@ class DeltaStats {
   uint64_t delete_count_;
   Timestamp max_timestamp_;
   Timestamp min_timestamp_;
+  rowid_t min_row_id_;
+  rowid_t max_row_id_;
 };
 
 
@@ -113,7 +113,7 @@ Status WriteDeltaIteratorToFile(DeltaIterator* iter,
     for (const DeltaKeyAndUpdate& cell : cells) {
       RowChangeList rcl(cell.cell);
       RETURN_NOT_OK(out->AppendDelta<Type>(cell.key, rcl));
-      RETURN_NOT_OK(stats.UpdateStats(cell.key.timestamp(), rcl));
+      RETURN_NOT_OK(stats.UpdateStats(cell.key, rcl));
     }
 
     i += n;
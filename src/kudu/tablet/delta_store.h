@@ -179,6 +179,15 @@ class DeltaIterator {
   // Must have called PrepareBatch() with flag = PREPARE_FOR_APPLY.
   virtual bool MayHaveDeltas() = 0;
 
+  // Returns whether the store may have deltas for any of the 'nrows' rows
+  // starting at 'start_row', whatever the snapshot. It is safe to
+  // conservatively return true.
+  // Must have called SeekToOrdinal().
+  virtual bool MayHaveDeltasForRows(rowid_t start_row, size_t nrows) { return true; }
+
+  // Returns the number of delta stores this iterator reads from.
+  virtual int num_stores() const { return 1; }
+
   // Return a string representation suitable for debug printouts.
   virtual std::string ToString() const = 0;
 
@@ -29,12 +29,15 @@
 #include "kudu/tablet/delta_store.h"
 #include "kudu/tablet/deltafile.h"
 #include "kudu/tablet/diskrowset.h"
+#include "kudu/tablet/tablet.h"
 #include "kudu/tablet/tablet.pb.h"
+#include "kudu/util/mem_tracker.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
 namespace tablet {
 
+using fs::CreateBlockOptions;
 using fs::ReadableBlock;
 using fs::WritableBlock;
 using std::shared_ptr;
@@ -51,6 +54,9 @@ DeltaTracker::DeltaTracker(shared_ptr<RowSetMetadata> rowset_metadata,
       open_(false),
       log_anchor_registry_(log_anchor_registry),
       parent_tracker_(std::move(parent_tracker)),
+      reader_mem_tracker_(parent_tracker_ ?
+          MemTracker::FindOrCreateTracker(-1, Tablet::kCFileReaderMemTrackerId, parent_tracker_) :
+          MemTracker::GetRootTracker()),
       dms_empty_(true) {
 }
 
@@ -69,7 +75,9 @@ Status DeltaTracker::OpenDeltaReaders(const vector<BlockId>& blocks,
     }
 
     shared_ptr<DeltaFileReader> dfr;
-    s = DeltaFileReader::OpenNoInit(std::move(block), block_id, &dfr, type);
+    cfile::ReaderOptions opts;
+    opts.parent_mem_tracker = reader_mem_tracker_;
+    s = DeltaFileReader::OpenNoInit(std::move(block), block_id, &dfr, type, opts);
     if (!s.ok()) {
       LOG(ERROR) << "Failed to open " << DeltaType_Name(type)
                  << " delta file reader " << block_id.ToString() << ": "
@@ -138,6 +146,25 @@ Status DeltaTracker::MakeDeltaIteratorMergerUnlocked(size_t start_idx, size_t en
 
 namespace {
 
+// A partly ancient UNDO delta file is only rewritten if at least this share
+// of it is estimated to be ancient; otherwise rewriting costs too much IO for
+// the space it frees.
+const double kMinAncientFractionToRewrite = 0.5;
+
+// Return the estimated share of the mutations in a delta file with 'stats'
+// which happened before 'ancient_history_mark', assuming that they're spread
+// evenly over the file's timestamp range.
+double EstimateAncientFraction(const DeltaStats& stats, Timestamp ancient_history_mark) {
+  if (!stats.min_timestamp().ComesBefore(ancient_history_mark)) {
+    return 0;
+  }
+  if (stats.max_timestamp().ComesBefore(ancient_history_mark)) {
+    return 1;
+  }
+  uint64_t range = stats.max_timestamp().value() - stats.min_timestamp().value() + 1;
+  return static_cast<double>(ancient_history_mark.value() - stats.min_timestamp().value()) / range;
+}
+
 string JoinDeltaStoreStrings(const SharedDeltaStoreVector& stores) {
   vector<string> strings;
   for (const shared_ptr<DeltaStore>& store : stores) {
@@ -148,6 +175,43 @@ string JoinDeltaStoreStrings(const SharedDeltaStoreVector& stores) {
 
 } // anonymous namespace
 
+namespace {
+
+// Finds 'seq' as a contiguous subsequence of 'stores', returning the index of
+// its first element in '*start_idx'.
+Status FindStoreSequence(const SharedDeltaStoreVector& seq,
+                         const SharedDeltaStoreVector& stores,
+                         size_t* start_idx) {
+  DCHECK(!seq.empty());
+  auto start_it = std::find(stores.begin(), stores.end(), seq[0]);
+  auto end_it = start_it;
+  for (const shared_ptr<DeltaStore>& ds : seq) {
+    if (end_it == stores.end() || *end_it != ds) {
+      return Status::InvalidArgument(
+          strings::Substitute("Cannot find deltastore sequence <$0> in <$1>",
+                              JoinDeltaStoreStrings(seq),
+                              JoinDeltaStoreStrings(stores)));
+    }
+    ++end_it;
+  }
+  *start_idx = start_it - stores.begin();
+  return Status::OK();
+}
+
+} // anonymous namespace
+
+Status DeltaTracker::CheckStoresAreTracked(const SharedDeltaStoreVector& stores,
+                                           DeltaType type) const {
+  if (stores.empty()) {
+    return Status::OK();
+  }
+  shared_lock<rw_spinlock> lock(component_lock_);
+  size_t start_idx;
+  return FindStoreSequence(stores,
+                           type == REDO ? redo_delta_stores_ : undo_delta_stores_,
+                           &start_idx);
+}
+
 Status DeltaTracker::AtomicUpdateStores(const SharedDeltaStoreVector& to_remove,
                                         const vector<BlockId>& new_delta_blocks,
                                         DeltaType type) {
@@ -163,21 +227,12 @@ Status DeltaTracker::AtomicUpdateStores(const SharedDeltaStoreVector& to_remove,
   // front-load them. When we start GCing UNDO files (KUDU-236) we'll need to be able to atomically
   // replace them too, and in their right order.
   if (!to_remove.empty()) {
-    start_it =
-        std::find(stores_to_update->begin(), stores_to_update->end(), to_remove[0]);
-
-    auto end_it = start_it;
-    for (const shared_ptr<DeltaStore>& ds : to_remove) {
-      if (end_it == stores_to_update->end() || *end_it != ds) {
-        return Status::InvalidArgument(
-            strings::Substitute("Cannot find deltastore sequence <$0> in <$1>",
-                                JoinDeltaStoreStrings(to_remove),
-                                JoinDeltaStoreStrings(*stores_to_update)));
-      }
-      ++end_it;
-    }
+    size_t start_idx;
+    RETURN_NOT_OK(FindStoreSequence(to_remove, *stores_to_update, &start_idx));
+    start_it = stores_to_update->begin() + start_idx;
+
     // Remove the old stores
-    stores_to_update->erase(start_it, end_it);
+    start_it = stores_to_update->erase(start_it, start_it + to_remove.size());
   } else {
     start_it = stores_to_update->begin();
   }
@@ -217,7 +272,8 @@ Status DeltaTracker::CompactStores(int start_idx, int end_idx) {
   // Open a writer for the new destination delta block
   FsManager* fs = rowset_metadata_->fs_manager();
   gscoped_ptr<WritableBlock> block;
-  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(&block),
+  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(
+      CreateBlockOptions::Background(rowset_metadata_->tablet_metadata()->tablet_id()), &block),
                         "Could not allocate delta block");
   BlockId new_block_id(block->id());
 
@@ -387,7 +443,9 @@ Status DeltaTracker::FlushDMS(DeltaMemStore* dms,
   // Open file for write.
   FsManager* fs = rowset_metadata_->fs_manager();
   gscoped_ptr<WritableBlock> writable_block;
-  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(&writable_block),
+  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(
+      CreateBlockOptions::Background(rowset_metadata_->tablet_metadata()->tablet_id()),
+      &writable_block),
                         "Unable to allocate new delta data writable_block");
   BlockId block_id(writable_block->id());
 
@@ -405,7 +463,10 @@ Status DeltaTracker::FlushDMS(DeltaMemStore* dms,
   // Now re-open for read
   gscoped_ptr<ReadableBlock> readable_block;
   RETURN_NOT_OK(fs->OpenBlock(block_id, &readable_block));
-  RETURN_NOT_OK(DeltaFileReader::OpenNoInit(std::move(readable_block), block_id, dfr, REDO));
+  cfile::ReaderOptions opts;
+  opts.parent_mem_tracker = reader_mem_tracker_;
+  RETURN_NOT_OK(DeltaFileReader::OpenNoInit(std::move(readable_block), block_id, dfr, REDO,
+                                            opts));
   LOG(INFO) << "Reopened delta block for read: " << block_id.ToString();
 
   RETURN_NOT_OK(rowset_metadata_->CommitRedoDeltaDataBlock(dms->id(), block_id));
@@ -517,5 +578,224 @@ void DeltaTracker::GetColumnIdsWithUpdates(std::vector<ColumnId>* col_ids) const
   col_ids->assign(column_ids_with_updates.begin(), column_ids_with_updates.end());
 }
 
+void DeltaTracker::EstimateRedoBytesByColumnId(
+    std::map<ColumnId, int64_t>* bytes_by_col_id) const {
+  shared_lock<rw_spinlock> lock(component_lock_);
+
+  for (const shared_ptr<DeltaStore>& ds : redo_delta_stores_) {
+    // We won't force open files just to read their stats.
+    if (!ds->Initted()) {
+      continue;
+    }
+
+    const DeltaStats& stats = ds->delta_stats();
+    set<ColumnId> col_ids;
+    stats.AddColumnIdsWithUpdates(&col_ids);
+    int64_t total_updates = 0;
+    for (ColumnId col_id : col_ids) {
+      total_updates += stats.update_count_for_col_id(col_id);
+    }
+    if (total_updates == 0) {
+      continue;
+    }
+    for (ColumnId col_id : col_ids) {
+      (*bytes_by_col_id)[col_id] +=
+          static_cast<int64_t>(ds->EstimateSize()) * stats.update_count_for_col_id(col_id) /
+          total_updates;
+    }
+  }
+}
+
+int64_t DeltaTracker::CountAncientDeletes(Timestamp ancient_history_mark) const {
+  shared_lock<rw_spinlock> lock(component_lock_);
+
+  int64_t delete_count = 0;
+  for (const shared_ptr<DeltaStore>& ds : redo_delta_stores_) {
+    // We won't force open files just to read their stats.
+    if (!ds->Initted()) {
+      continue;
+    }
+
+    const DeltaStats& stats = ds->delta_stats();
+    if (stats.max_timestamp().ComesBefore(ancient_history_mark)) {
+      delete_count += stats.delete_count();
+    }
+  }
+  return delete_count;
+}
+
+Status DeltaTracker::CountDeletesFromStats(const MvccSnapshot& snap, int64_t* delete_count,
+                                           bool* counted) const {
+  *counted = false;
+  if (!dms_empty_.Load()) {
+    return Status::OK();
+  }
+  SharedDeltaStoreVector redos;
+  SharedDeltaStoreVector undos;
+  {
+    shared_lock<rw_spinlock> lock(component_lock_);
+    redos = redo_delta_stores_;
+    undos = undo_delta_stores_;
+  }
+
+  // Files are opened outside of the lock, since that may do IO.
+  auto all_committed = [&](const shared_ptr<DeltaStore>& ds, bool* committed) -> Status {
+    if (!ds->Initted()) {
+      RETURN_NOT_OK(ds->Init());
+    }
+    *committed = !snap.MayHaveUncommittedTransactionsAtOrBefore(
+        ds->delta_stats().max_timestamp());
+    return Status::OK();
+  };
+  bool committed;
+  for (const shared_ptr<DeltaStore>& ds : undos) {
+    RETURN_NOT_OK(all_committed(ds, &committed));
+    if (!committed) {
+      return Status::OK();
+    }
+  }
+  int64_t deletes = 0;
+  for (const shared_ptr<DeltaStore>& ds : redos) {
+    RETURN_NOT_OK(all_committed(ds, &committed));
+    // A DeltaMemStore being flushed is among the REDOs until its file
+    // replaces it, without statistics, so stores without any are skipped.
+    const DeltaStats& stats = ds->delta_stats();
+    if (!committed || stats.max_timestamp().ComesBefore(stats.min_timestamp())) {
+      return Status::OK();
+    }
+    // A row is deleted at most once, so the counts of the stores add up.
+    deletes += ds->delta_stats().delete_count();
+  }
+  *delete_count = deletes;
+  *counted = true;
+  return Status::OK();
+}
+
+int64_t DeltaTracker::EstimateBytesInAncientUndoDeltas(Timestamp ancient_history_mark) const {
+  shared_lock<rw_spinlock> lock(component_lock_);
+
+  int64_t bytes = 0;
+  for (const shared_ptr<DeltaStore>& ds : undo_delta_stores_) {
+    // We won't force open files just to read their stats.
+    if (!ds->Initted()) {
+      continue;
+    }
+    double ancient = EstimateAncientFraction(ds->delta_stats(), ancient_history_mark);
+    if (ancient >= kMinAncientFractionToRewrite) {
+      bytes += ds->EstimateSize() * ancient;
+    }
+  }
+  return bytes;
+}
+
+Status DeltaTracker::GCAncientUndoDeltas(Timestamp ancient_history_mark,
+                                         int64_t* rewrite_budget_bytes,
+                                         int64_t* bytes_reclaimed) {
+  std::lock_guard<Mutex> l(compact_flush_lock_);
+  CHECK(open_);
+
+  SharedDeltaStoreVector undos;
+  {
+    shared_lock<rw_spinlock> lock(component_lock_);
+    undos = undo_delta_stores_;
+  }
+
+  // Each removed or rewritten store is replaced on its own, since the stores
+  // to replace needn't be contiguous.
+  vector<SharedDeltaStoreVector> stores_to_replace;
+  vector<BlockId> new_blocks;
+  RowSetMetadataUpdate update;
+  int64_t bytes_freed = 0;
+  for (const shared_ptr<DeltaStore>& ds : undos) {
+    RETURN_NOT_OK(ds->Init());
+    double ancient = EstimateAncientFraction(ds->delta_stats(), ancient_history_mark);
+    if (ancient == 0) {
+      continue;
+    }
+    shared_ptr<DeltaFileReader> dfr = std::static_pointer_cast<DeltaFileReader>(ds);
+    int64_t size = dfr->EstimateSize();
+
+    if (ancient == 1) {
+      VLOG(1) << "Deleting ancient UNDO delta file " << dfr->ToString();
+      update.ReplaceUndoDeltaBlocks({ dfr->block_id() }, {});
+      stores_to_replace.push_back({ ds });
+      new_blocks.emplace_back();
+      bytes_freed += size;
+      continue;
+    }
+
+    if (ancient < kMinAncientFractionToRewrite || size > *rewrite_budget_bytes) {
+      continue;
+    }
+    *rewrite_budget_bytes -= size;
+
+    BlockId new_block_id;
+    RETURN_NOT_OK_PREPEND(RewriteWithoutAncientUndos(dfr, ancient_history_mark, &new_block_id),
+                          Substitute("Could not rewrite UNDO delta file $0", dfr->ToString()));
+    gscoped_ptr<ReadableBlock> new_block;
+    uint64_t new_size;
+    RETURN_NOT_OK(rowset_metadata_->fs_manager()->OpenBlock(new_block_id, &new_block));
+    RETURN_NOT_OK(new_block->Size(&new_size));
+    VLOG(1) << "Rewrote UNDO delta file " << dfr->ToString() << " without its ancient "
+            << "mutations as " << new_block_id.ToString() << ": " << size << " bytes to "
+            << new_size;
+
+    update.ReplaceUndoDeltaBlocks({ dfr->block_id() }, { new_block_id });
+    stores_to_replace.push_back({ ds });
+    new_blocks.push_back(new_block_id);
+    bytes_freed += size - static_cast<int64_t>(new_size);
+  }
+
+  if (stores_to_replace.empty()) {
+    return Status::OK();
+  }
+
+  // Persist the new set of blocks before dropping the old stores: if the
+  // metadata can't be written, the old blocks are all still in place.
+  RETURN_NOT_OK(rowset_metadata_->CommitUpdate(update));
+  RETURN_NOT_OK_PREPEND(rowset_metadata_->Flush(),
+                        "Unable to commit UNDO delta block metadata");
+
+  for (int i = 0; i < stores_to_replace.size(); i++) {
+    vector<BlockId> to_add;
+    if (!new_blocks[i].IsNull()) {
+      to_add.push_back(new_blocks[i]);
+    }
+    CHECK_OK(AtomicUpdateStores(stores_to_replace[i], to_add, UNDO));
+  }
+  *bytes_reclaimed += bytes_freed;
+  LOG(INFO) << "Garbage collected " << stores_to_replace.size() << " ancient UNDO delta "
+            << "files of rowset " << rowset_metadata_->id() << ", freeing "
+            << bytes_freed << " bytes";
+  return Status::OK();
+}
+
+Status DeltaTracker::RewriteWithoutAncientUndos(const shared_ptr<DeltaFileReader>& dfr,
+                                                Timestamp ancient_history_mark,
+                                                BlockId* new_block_id) {
+  // An UNDO is read by the snapshots taken before it happened, so a snapshot
+  // at the ancient history mark reads exactly the UNDOs which aren't ancient.
+  // As in DoCompactStores(), the projection is ignored when collecting.
+  Schema empty_schema;
+  DeltaIterator* raw_iter;
+  RETURN_NOT_OK(dfr->NewDeltaIterator(&empty_schema, MvccSnapshot(ancient_history_mark),
+                                      &raw_iter));
+  unique_ptr<DeltaIterator> iter(raw_iter);
+
+  FsManager* fs = rowset_metadata_->fs_manager();
+  gscoped_ptr<WritableBlock> block;
+  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(
+      CreateBlockOptions::Background(rowset_metadata_->tablet_metadata()->tablet_id()), &block),
+                        "Could not allocate delta block");
+  *new_block_id = block->id();
+
+  // The iterator visits the file in batches of rows, so this needs no more
+  // memory than a batch's worth of mutations however large the file is.
+  DeltaFileWriter dfw(std::move(block));
+  RETURN_NOT_OK(dfw.Start());
+  RETURN_NOT_OK(WriteDeltaIteratorToFile<UNDO>(iter.get(), ITERATE_OVER_ALL_ROWS, &dfw));
+  return dfw.Finish();
+}
+
 } // namespace tablet
 } // namespace kudu
@@ -18,6 +18,7 @@
 #define KUDU_TABLET_DELTATRACKER_H
 
 #include <gtest/gtest_prod.h>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -184,6 +185,58 @@ class DeltaTracker {
   // Retrieves the list of column indexes that currently have updates.
   void GetColumnIdsWithUpdates(std::vector<ColumnId>* col_ids) const;
 
+  // Estimate how many bytes of the REDO delta files are taken by the updates
+  // to each column, splitting each file's size between the columns it updates
+  // in proportion to their update counts. Only columns with updates are added
+  // to '*bytes_by_col_id'.
+  //
+  // Files which haven't been opened yet are not counted.
+  void EstimateRedoBytesByColumnId(std::map<ColumnId, int64_t>* bytes_by_col_id) const;
+
+  // Returns Status::OK() if 'stores' are tracked, in this order and next to
+  // each other, among the stores of type 'type', and Status::InvalidArgument()
+  // otherwise. Major delta compactions read their input stores without
+  // holding compact_flush_lock(), so they use this once they hold it to check
+  // that no other compaction replaced the stores meanwhile.
+  Status CheckStoresAreTracked(const SharedDeltaStoreVector& stores, DeltaType type) const;
+
+  // Return the number of deletes recorded in the statistics of the REDO delta
+  // files whose mutations all happened before 'ancient_history_mark'. Since
+  // a row in a DiskRowSet can only be deleted once, this is a lower bound on
+  // the number of rows deleted before the ancient history mark.
+  //
+  // Files which haven't been opened yet are not counted.
+  int64_t CountAncientDeletes(Timestamp ancient_history_mark) const;
+
+  // Sets 'counted' to whether the rows visible in 'snap' can be counted from
+  // the delta stores' statistics, without reading the deltas: that's the case
+  // when the DeltaMemStore is empty and every mutation of the delta files is
+  // committed in 'snap', so that no UNDO applies and every REDO does. If so,
+  // sets 'delete_count' to the number of rows deleted by the REDOs.
+  //
+  // Opens the delta files whose statistics haven't been read yet.
+  Status CountDeletesFromStats(const MvccSnapshot& snap, int64_t* delete_count,
+                               bool* counted) const;
+
+  // Return the estimated number of bytes in UNDO delta files which would be
+  // freed by discarding the mutations which happened before
+  // 'ancient_history_mark'. The ancient share of a file which straddles the
+  // mark is estimated from its timestamp range.
+  //
+  // Files which haven't been opened yet are not counted.
+  int64_t EstimateBytesInAncientUndoDeltas(Timestamp ancient_history_mark) const;
+
+  // Discard the UNDO mutations which happened before 'ancient_history_mark'.
+  //
+  // UNDO delta files whose mutations are all ancient are removed with a
+  // metadata update alone. Files which are mostly ancient are rewritten
+  // without their ancient mutations, as long as they fit in what's left of
+  // '*rewrite_budget_bytes', which is decremented by the size of each file
+  // read. '*bytes_reclaimed' is incremented by the number of bytes freed.
+  Status GCAncientUndoDeltas(Timestamp ancient_history_mark,
+                             int64_t* rewrite_budget_bytes,
+                             int64_t* bytes_reclaimed);
+
   Mutex* compact_flush_lock() {
     return &compact_flush_lock_;
   }
@@ -211,6 +264,12 @@ class DeltaTracker {
   void CollectStores(vector<std::shared_ptr<DeltaStore>>* stores,
                      WhichStores which) const;
 
+  // Write the UNDO mutations of 'dfr' which happened at or after
+  // 'ancient_history_mark' to a new delta block, returned in 'new_block_id'.
+  Status RewriteWithoutAncientUndos(const std::shared_ptr<DeltaFileReader>& dfr,
+                                    Timestamp ancient_history_mark,
+                                    BlockId* new_block_id);
+
   // Performs the actual compaction. Results of compaction are written to "block",
   // while delta stores that underwent compaction are appended to "compacted_stores", while
   // their corresponding block ids are appended to "compacted_blocks".
@@ -251,6 +310,9 @@ class DeltaTracker {
 
   std::shared_ptr<MemTracker> parent_tracker_;
 
+  // Charged with the memory of the delta file readers.
+  std::shared_ptr<MemTracker> reader_mem_tracker_;
+
   // The current DeltaMemStore into which updates should be written.
   std::shared_ptr<DeltaMemStore> dms_;
   // The set of tracked REDO delta stores, in increasing timestamp order.
@@ -272,12 +334,15 @@ class DeltaTracker {
   // contention between threads.
   mutable rw_spinlock component_lock_;
 
-  // Exclusive lock that ensures that only one flush or compaction can run
-  // at a time. Protects delta_stores_. NOTE: this lock cannot be acquired
-  // while component_lock is held: otherwise, Flush and Compaction threads
-  // (that both first acquire this lock and then component_lock) will deadlock.
+  // Exclusive lock that ensures that only one flush or compaction modifies
+  // the delta stores at a time. Protects delta_stores_. NOTE: this lock cannot
+  // be acquired while component_lock is held: otherwise, Flush and Compaction
+  // threads (that both first acquire this lock and then component_lock) will
+  // deadlock.
   //
-  // TODO(perf): this needs to be more fine grained
+  // Major delta compactions, which can take a long time, only hold this lock
+  // while selecting their input stores and while swapping in their results,
+  // so that DMS flushes can proceed while they run.
   mutable Mutex compact_flush_lock_;
 };
 
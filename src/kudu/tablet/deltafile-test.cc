@@ -86,7 +86,7 @@ class TestDeltaFile : public KuduTest {
         DeltaKey key(i, Timestamp(timestamp));
         RowChangeList rcl(buf);
         ASSERT_OK_FAST(dfw.AppendDelta<REDO>(key, rcl));
-        ASSERT_OK_FAST(stats.UpdateStats(key.timestamp(), rcl));
+        ASSERT_OK_FAST(stats.UpdateStats(key, rcl));
       }
     }
     ASSERT_OK(dfw.WriteDeltaStats(stats));
@@ -361,6 +361,65 @@ TEST_F(TestDeltaFile, TestLazyInit) {
   ASSERT_EQ(bytes_read_after_init, bytes_read);
 }
 
+// Data blocks whose deltas are all too recent for a snapshot aren't read.
+TEST_F(TestDeltaFile, TestSkipsDeltaBlocksOutOfRange) {
+  FLAGS_deltafile_default_block_size = 256;
+  const int kNumRows = 2000;
+  const int kSnapshotTimestamp = 200;
+
+  // Row 'i' is updated at timestamp 'i', so later blocks hold later deltas.
+  gscoped_ptr<WritableBlock> wb;
+  ASSERT_OK(fs_manager_->CreateNewBlock(&wb));
+  test_block_ = wb->id();
+  DeltaFileWriter dfw(std::move(wb));
+  ASSERT_OK(dfw.Start());
+  faststring buf;
+  DeltaStats stats;
+  for (int i = 0; i < kNumRows; i++) {
+    buf.clear();
+    RowChangeListEncoder update(&buf);
+    uint32_t new_val = i;
+    update.AddColumnUpdate(schema_.column(0), schema_.column_id(0), &new_val);
+    DeltaKey key(i, Timestamp(i));
+    RowChangeList rcl(buf);
+    ASSERT_OK(dfw.AppendDelta<REDO>(key, rcl));
+    ASSERT_OK(stats.UpdateStats(key, rcl));
+  }
+  ASSERT_OK(dfw.WriteDeltaStats(stats));
+  ASSERT_OK(dfw.Finish());
+
+  gscoped_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(test_block_, &block));
+  uint64_t file_size;
+  ASSERT_OK(block->Size(&file_size));
+  size_t bytes_read = 0;
+  gscoped_ptr<ReadableBlock> count_block(
+      new CountingReadableBlock(std::move(block), &bytes_read));
+  shared_ptr<DeltaFileReader> reader;
+  ASSERT_OK(DeltaFileReader::Open(std::move(count_block), test_block_, &reader, REDO));
+  size_t bytes_read_after_init = bytes_read;
+
+  DeltaIterator* raw_iter;
+  ASSERT_OK(reader->NewDeltaIterator(&schema_, MvccSnapshot(Timestamp(kSnapshotTimestamp)),
+                                     &raw_iter));
+  gscoped_ptr<DeltaIterator> it(raw_iter);
+  ASSERT_OK(it->Init(nullptr));
+  ASSERT_OK(it->SeekToOrdinal(0));
+  RowBlock rb(schema_, kNumRows, &arena_);
+  rb.ZeroMemory();
+  ASSERT_OK(it->PrepareBatch(rb.nrows(), DeltaIterator::PREPARE_FOR_APPLY));
+  ColumnBlock dst_col = rb.column_block(0);
+  ASSERT_OK(it->ApplyUpdates(0, &dst_col));
+
+  // Only the updates committed in the snapshot are applied...
+  for (int i = 0; i < kNumRows; i++) {
+    uint32_t val = *schema_.ExtractColumnFromRow<UINT32>(rb.row(i), 0);
+    ASSERT_EQ(i < kSnapshotTimestamp ? i : 0, val) << "row " << i;
+  }
+  // ...and most of the data blocks weren't read at all.
+  ASSERT_LT(bytes_read - bytes_read_after_init, file_size / 2);
+}
+
 // Check that, if a delta file is opened but no deltas are written,
 // Finish() will return Status::Aborted().
 TEST_F(TestDeltaFile, TestEmptyFileIsAborted) {
@@ -18,6 +18,7 @@
 #include "kudu/tablet/deltafile.h"
 
 #include <arpa/inet.h>
+#include <algorithm>
 #include <memory>
 #include <string>
 
@@ -60,6 +61,7 @@ using fs::WritableBlock;
 namespace tablet {
 
 const char * const DeltaFileReader::kDeltaStatsEntryName = "deltafilestats";
+const char * const DeltaFileReader::kDeltaBlockTimestampsEntryName = "deltablocktimestamps";
 
 namespace {
 
@@ -77,6 +79,27 @@ DeltaFileWriter::DeltaFileWriter(gscoped_ptr<WritableBlock> block)
   // No optimization for deltafiles because a deltafile index key must decode into a DeltaKey
   opts.optimize_index_keys = false;
   writer_.reset(new cfile::CFileWriter(opts, GetTypeInfo(BINARY), false, std::move(block)));
+  writer_->set_data_block_callback(
+      [this](const BlockPointer& ptr, rowid_t /* first_ordinal */, uint32_t num_values) {
+        DataBlockWritten(ptr, num_values);
+      });
+}
+
+void DeltaFileWriter::DataBlockWritten(const BlockPointer& ptr, uint32_t num_values) {
+  // Blocks are written in order, so the block is made of the oldest pending
+  // deltas.
+  DCHECK_LE(num_values, pending_timestamps_.size());
+  DCHECK_GT(num_values, 0);
+  uint64_t min_ts = pending_timestamps_.front().ToUint64();
+  uint64_t max_ts = min_ts;
+  for (uint32_t i = 0; i < num_values; i++) {
+    min_ts = std::min(min_ts, pending_timestamps_.front().ToUint64());
+    max_ts = std::max(max_ts, pending_timestamps_.front().ToUint64());
+    pending_timestamps_.pop_front();
+  }
+  block_timestamps_.add_block_offsets(ptr.offset());
+  block_timestamps_.add_min_timestamps(min_ts);
+  block_timestamps_.add_max_timestamps(max_ts);
 }
 
 
@@ -94,6 +117,15 @@ Status DeltaFileWriter::FinishAndReleaseBlock(ScopedWritableBlockCloser* closer)
   if (writer_->written_value_count() == 0) {
     return Status::Aborted("no deltas written");
   }
+  // Write out the last data block, so that the timestamps of all the blocks
+  // are known.
+  RETURN_NOT_OK(writer_->FinishCurDataBlock());
+  DCHECK(pending_timestamps_.empty());
+  faststring buf;
+  if (!pb_util::SerializeToString(block_timestamps_, &buf)) {
+    return Status::IOError("Unable to serialize DeltaBlockTimestampsPB");
+  }
+  writer_->AddMetadataPair(DeltaFileReader::kDeltaBlockTimestampsEntryName, buf.ToString());
   return writer_->FinishAndReleaseBlock(closer);
 }
 
@@ -114,6 +146,8 @@ Status DeltaFileWriter::DoAppendDelta(const DeltaKey &key,
   tmp_buf_.append(delta_slice.data(), delta_slice.size());
   Slice tmp_buf_slice(tmp_buf_);
 
+  pending_timestamps_.push_back(key.timestamp());
+
   return writer_->AppendEntries(&tmp_buf_slice, 1);
 }
 
@@ -189,10 +223,10 @@ Status DeltaFileReader::Open(gscoped_ptr<ReadableBlock> block,
 Status DeltaFileReader::OpenNoInit(gscoped_ptr<ReadableBlock> block,
                                    const BlockId& block_id,
                                    shared_ptr<DeltaFileReader>* reader_out,
-                                   DeltaType delta_type) {
+                                   DeltaType delta_type,
+                                   const cfile::ReaderOptions& options) {
   gscoped_ptr<CFileReader> cf_reader;
-  RETURN_NOT_OK(CFileReader::OpenNoInit(std::move(block),
-                                        cfile::ReaderOptions(), &cf_reader));
+  RETURN_NOT_OK(CFileReader::OpenNoInit(std::move(block), options, &cf_reader));
   gscoped_ptr<DeltaFileReader> df_reader(new DeltaFileReader(block_id,
                                                              cf_reader.release(),
                                                              delta_type));
@@ -227,6 +261,25 @@ Status DeltaFileReader::InitOnce() {
 
   // Initialize delta file stats
   RETURN_NOT_OK(ReadDeltaStats());
+  RETURN_NOT_OK(ReadBlockTimestamps());
+  return Status::OK();
+}
+
+Status DeltaFileReader::ReadBlockTimestamps() {
+  string buf;
+  if (!reader_->GetMetadataEntry(kDeltaBlockTimestampsEntryName, &buf)) {
+    // The file predates the block timestamps.
+    return Status::OK();
+  }
+  DeltaBlockTimestampsPB pb;
+  if (!pb.ParseFromString(buf)) {
+    return Status::Corruption("unable to parse the delta block timestamps protobuf");
+  }
+  if (pb.min_timestamps_size() != pb.block_offsets_size() ||
+      pb.max_timestamps_size() != pb.block_offsets_size()) {
+    return Status::Corruption("inconsistent delta block timestamps", pb.ShortDebugString());
+  }
+  block_timestamps_.Swap(&pb);
   return Status::OK();
 }
 
@@ -252,11 +305,33 @@ bool DeltaFileReader::IsRelevantForSnapshot(const MvccSnapshot& snap) const {
     // assume that this file is relevant for every snapshot.
     return true;
   }
+  return IsTimestampRangeRelevant(delta_stats_->min_timestamp(), delta_stats_->max_timestamp(),
+                                  snap);
+}
+
+bool DeltaFileReader::IsBlockRelevantForSnapshot(const BlockPointer& ptr,
+                                                 const MvccSnapshot& snap) const {
+  DCHECK(init_once_.initted());
+  const auto& offsets = block_timestamps_.block_offsets();
+  auto it = std::lower_bound(offsets.begin(), offsets.end(), ptr.offset());
+  if (it == offsets.end() || *it != ptr.offset()) {
+    return true;
+  }
+  int idx = it - offsets.begin();
+  return IsTimestampRangeRelevant(Timestamp(block_timestamps_.min_timestamps(idx)),
+                                  Timestamp(block_timestamps_.max_timestamps(idx)),
+                                  snap);
+}
+
+bool DeltaFileReader::IsTimestampRangeRelevant(Timestamp min, Timestamp max,
+                                               const MvccSnapshot& snap) const {
+  // A REDO is relevant if it's committed in the snapshot, and an UNDO if it
+  // isn't, since it must then be undone.
   if (delta_type_ == REDO) {
-    return snap.MayHaveCommittedTransactionsAtOrAfter(delta_stats_->min_timestamp());
+    return snap.MayHaveCommittedTransactionsAtOrAfter(min);
   }
   if (delta_type_ == UNDO) {
-    return snap.MayHaveUncommittedTransactionsAtOrBefore(delta_stats_->max_timestamp());
+    return snap.MayHaveUncommittedTransactionsAtOrBefore(max);
   }
   LOG(DFATAL) << "Cannot reach here";
   return false;
@@ -499,7 +574,11 @@ Status DeltaFileIterator::PrepareBatch(size_t nrows, PrepareFlag flag) {
       break;
     }
 
-    RETURN_NOT_OK(ReadCurrentBlockOntoQueue());
+    if (dfr_->IsBlockRelevantForSnapshot(index_iter_->GetCurrentBlockPointer(), mvcc_snap_)) {
+      RETURN_NOT_OK(ReadCurrentBlockOntoQueue());
+    } else {
+      TRACE_COUNTER_INCREMENT("delta_blocks_culled", 1);
+    }
 
     Status s = index_iter_->Next();
     if (s.IsNotFound()) {
@@ -817,6 +896,11 @@ bool DeltaFileIterator::HasNext() {
   return !exhausted_ || !delta_blocks_.empty();
 }
 
+bool DeltaFileIterator::MayHaveDeltasForRows(rowid_t start_row, size_t nrows) {
+  // SeekToOrdinal() initialized the reader, and so loaded its stats.
+  return dfr_->delta_stats().MayHaveRowsInRange(start_row, nrows);
+}
+
 bool DeltaFileIterator::MayHaveDeltas() {
   // TODO: change the API to take in the col_to_apply and check for deltas on
   // that column only.
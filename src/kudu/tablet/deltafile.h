@@ -85,8 +85,18 @@ class DeltaFileWriter {
  private:
   Status DoAppendDelta(const DeltaKey &key, const RowChangeList &delta);
 
+  // Records the timestamp range of the data block just written.
+  void DataBlockWritten(const cfile::BlockPointer& ptr, uint32_t num_values);
+
   gscoped_ptr<cfile::CFileWriter> writer_;
 
+  // The timestamps of the deltas appended since the last data block was
+  // written, in order.
+  std::deque<Timestamp> pending_timestamps_;
+
+  // The timestamp ranges of the data blocks written so far.
+  DeltaBlockTimestampsPB block_timestamps_;
+
   // Buffer used as a temporary for storing the serialized form
   // of the deltas
   faststring tmp_buf_;
@@ -106,6 +116,7 @@ class DeltaFileReader : public DeltaStore,
                         public std::enable_shared_from_this<DeltaFileReader> {
  public:
   static const char * const kDeltaStatsEntryName;
+  static const char * const kDeltaBlockTimestampsEntryName;
 
   // Fully open a delta file using a previously opened block.
   //
@@ -123,7 +134,8 @@ class DeltaFileReader : public DeltaStore,
   static Status OpenNoInit(gscoped_ptr<fs::ReadableBlock> file,
                            const BlockId& block_id,
                            std::shared_ptr<DeltaFileReader>* reader_out,
-                           DeltaType delta_type);
+                           DeltaType delta_type,
+                           const cfile::ReaderOptions& options = cfile::ReaderOptions());
 
   virtual Status Init() OVERRIDE;
 
@@ -157,6 +169,14 @@ class DeltaFileReader : public DeltaStore,
   // been fully initialized.
   bool IsRelevantForSnapshot(const MvccSnapshot& snap) const;
 
+  // Returns true if the data block at 'ptr' may include any deltas which need
+  // to be applied when scanning the given snapshot. Files written before the
+  // timestamps of their blocks were recorded always return true.
+  //
+  // REQUIRES: the file is initialized.
+  bool IsBlockRelevantForSnapshot(const cfile::BlockPointer& ptr,
+                                  const MvccSnapshot& snap) const;
+
  private:
   friend class DeltaFileIterator;
 
@@ -173,10 +193,18 @@ class DeltaFileReader : public DeltaStore,
   Status InitOnce();
 
   Status ReadDeltaStats();
+  Status ReadBlockTimestamps();
+
+  // Returns true if a delta file or data block whose deltas have timestamps
+  // within [min, max] may include any deltas relevant to 'snap'.
+  bool IsTimestampRangeRelevant(Timestamp min, Timestamp max, const MvccSnapshot& snap) const;
 
   std::shared_ptr<cfile::CFileReader> reader_;
   gscoped_ptr<DeltaStats> delta_stats_;
 
+  // The timestamp ranges of the data blocks, if the file has them.
+  DeltaBlockTimestampsPB block_timestamps_;
+
   const BlockId block_id_;
 
   // The type of this delta, i.e. UNDO or REDO.
@@ -203,6 +231,7 @@ class DeltaFileIterator : public DeltaIterator {
   string ToString() const OVERRIDE;
   virtual bool HasNext() OVERRIDE;
   bool MayHaveDeltas() override;
+  bool MayHaveDeltasForRows(rowid_t start_row, size_t nrows) override;
 
  private:
   friend class DeltaFileReader;
@@ -25,6 +25,7 @@
 #include "kudu/consensus/opid_util.h"
 #include "kudu/gutil/casts.h"
 #include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/server/logical_clock.h"
 #include "kudu/tablet/deltamemstore.h"
 #include "kudu/tablet/deltafile.h"
@@ -398,6 +399,74 @@ TEST_F(TestDeltaMemStore, TestDMSBasic) {
   ASSERT_EQ(2000, dms_->Count());
 }
 
+// Test applying deletes and updates to only some of the projected columns,
+// interleaved with collecting mutations from the same iterator.
+TEST_F(TestDeltaMemStore, TestApplyDeletesAndSparseColumns) {
+  faststring update_buf;
+  RowChangeListEncoder update(&update_buf);
+  for (uint32_t i = 0; i < 20; i++) {
+    ScopedTransaction tx(&mvcc_);
+    tx.StartApplying();
+    update.Reset();
+    if (i % 5 == 3) {
+      update.SetToDelete();
+    } else {
+      uint32_t val = i * 10;
+      update.AddColumnUpdate(schema_.column(kIntColumn),
+                             schema_.column_id(kIntColumn), &val);
+    }
+    ASSERT_OK(dms_->Update(tx.timestamp(), i, RowChangeList(update_buf), op_id_));
+    tx.Commit();
+  }
+
+  for (uint32_t i = 0; i < 20; i++) {
+    bool deleted;
+    ASSERT_OK(dms_->CheckRowDeleted(i, &deleted));
+    ASSERT_EQ(i % 5 == 3, deleted) << "row " << i;
+  }
+
+  DeltaIterator* raw_iter;
+  ASSERT_OK(dms_->NewDeltaIterator(&schema_, MvccSnapshot(mvcc_), &raw_iter));
+  gscoped_ptr<DeltaIterator> iter(raw_iter);
+  ASSERT_OK(iter->Init(nullptr));
+  ASSERT_OK(iter->SeekToOrdinal(0));
+
+  // Apply the first batch. The string column was never updated.
+  const int kBatchSize = 10;
+  ScopedColumnBlock<UINT32> ints(kBatchSize);
+  ScopedColumnBlock<STRING> strings(kBatchSize);
+  for (int i = 0; i < kBatchSize; i++) {
+    ints[i] = 0xDEADBEEF;
+    strings[i] = Slice("orig");
+  }
+  SelectionVector sel(kBatchSize);
+  sel.SetAllTrue();
+  ASSERT_OK(iter->PrepareBatch(kBatchSize, DeltaIterator::PREPARE_FOR_APPLY));
+  ASSERT_OK(iter->ApplyDeletes(&sel));
+  ASSERT_OK(iter->ApplyUpdates(kIntColumn, &ints));
+  ASSERT_OK(iter->ApplyUpdates(kStringColumn, &strings));
+  for (int i = 0; i < kBatchSize; i++) {
+    bool deleted = i % 5 == 3;
+    ASSERT_EQ(!deleted, sel.IsRowSelected(i)) << "row " << i;
+    ASSERT_EQ(deleted ? 0xDEADBEEF : i * 10, ints[i]) << "row " << i;
+    ASSERT_EQ("orig", strings[i].ToString());
+  }
+
+  // Collect the second batch from the same iterator.
+  Arena arena(1024, 1024);
+  vector<Mutation *> mutations(kBatchSize);
+  ASSERT_OK(iter->PrepareBatch(kBatchSize, DeltaIterator::PREPARE_FOR_COLLECT));
+  ASSERT_OK(iter->CollectMutations(&mutations, &arena));
+  for (int i = 0; i < kBatchSize; i++) {
+    string str = Mutation::StringifyMutationList(schema_, mutations[i]);
+    if (i % 5 == 3) {
+      ASSERT_STR_CONTAINS(str, "DELETE");
+    } else {
+      ASSERT_STR_CONTAINS(str, strings::Substitute("SET col3=$0", (kBatchSize + i) * 10));
+    }
+  }
+}
+
 TEST_F(TestDeltaMemStore, TestIteratorDoesUpdates) {
   unordered_set<uint32_t> to_update;
   for (uint32_t i = 0; i < 1000; i++) {
@@ -15,6 +15,8 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
+#include <mutex>
 #include <utility>
 
 #include "kudu/consensus/consensus.pb.h"
@@ -33,6 +35,7 @@ namespace tablet {
 
 using log::LogAnchorRegistry;
 using std::shared_ptr;
+using std::unique_ptr;
 using strings::Substitute;
 
 ////////////////////////////////////////////////////////////
@@ -62,6 +65,7 @@ DeltaMemStore::DeltaMemStore(int64_t id,
   arena_.reset(new ThreadSafeMemoryTrackingArena(
       kInitialArenaSize, kMaxArenaBufferSize, allocator_));
   tree_.reset(new DMSTree(arena_));
+  delete_index_.reset(new DMSTree(arena_));
 }
 
 Status DeltaMemStore::Init() {
@@ -96,12 +100,68 @@ Status DeltaMemStore::Update(Timestamp timestamp,
   if (PREDICT_FALSE(!mutation.Insert(update.slice()))) {
     return Status::IOError("Unable to insert into tree");
   }
+  RETURN_NOT_OK(IndexDelta(key_slice, update));
 
   anchorer_.AnchorIfMinimum(op_id.index());
 
   return Status::OK();
 }
 
+Status DeltaMemStore::IndexDelta(const Slice& key, const RowChangeList& update) {
+  RowChangeListDecoder decoder(update);
+  RETURN_NOT_OK(decoder.Init());
+  if (decoder.is_delete() || decoder.is_reinsert()) {
+    uint8_t reinserted = decoder.is_reinsert();
+    if (PREDICT_FALSE(!delete_index_->Insert(key, Slice(&reinserted, 1)))) {
+      return Status::IOError("Unable to insert into delete index");
+    }
+    return Status::OK();
+  }
+
+  // Decoded values may only be valid until the next update is decoded, so
+  // the updated columns are found first.
+  vector<ColumnId> col_ids;
+  RowChangeListDecoder ids_decoder = decoder;
+  RETURN_NOT_OK(ids_decoder.GetIncludedColumnIds(&col_ids));
+
+  faststring val;
+  for (auto id_it = col_ids.begin(); id_it != col_ids.end(); ++id_it) {
+    RowChangeListDecoder::DecodedUpdate dec;
+    RETURN_NOT_OK(decoder.DecodeNext(&dec));
+    // If the same column is updated more than once, the last update wins.
+    ColumnId col_id = dec.col_id;
+    if (std::find(id_it + 1, col_ids.end(), col_id) != col_ids.end()) {
+      continue;
+    }
+
+    DMSTree* index = FindColumnIndex(col_id);
+    if (index == nullptr) {
+      std::lock_guard<rw_spinlock> l(col_indexes_lock_);
+      unique_ptr<DMSTree>& slot = col_indexes_[col_id];
+      if (!slot) {
+        slot.reset(new DMSTree(arena_));
+      }
+      index = slot.get();
+    }
+
+    val.clear();
+    val.push_back(dec.null ? 1 : 0);
+    if (!dec.null) {
+      val.append(dec.raw_value.data(), dec.raw_value.size());
+    }
+    if (PREDICT_FALSE(!index->Insert(key, Slice(val)))) {
+      return Status::IOError("Unable to insert into column index");
+    }
+  }
+  return Status::OK();
+}
+
+DeltaMemStore::DMSTree* DeltaMemStore::FindColumnIndex(ColumnId col_id) const {
+  shared_lock<rw_spinlock> l(col_indexes_lock_);
+  auto it = col_indexes_.find(col_id);
+  return it == col_indexes_.end() ? nullptr : it->second.get();
+}
+
 Status DeltaMemStore::FlushToFile(DeltaFileWriter *dfw,
                                   gscoped_ptr<DeltaStats>* stats_ret) {
   gscoped_ptr<DeltaStats> stats(new DeltaStats());
@@ -115,7 +175,7 @@ Status DeltaMemStore::FlushToFile(DeltaFileWriter *dfw,
     RETURN_NOT_OK(key.DecodeFrom(&key_slice));
     RowChangeList rcl(val);
     RETURN_NOT_OK_PREPEND(dfw->AppendDelta<REDO>(key, rcl), "Failed to append delta");
-    stats->UpdateStats(key.timestamp(), rcl);
+    stats->UpdateStats(key, rcl);
     iter->Next();
   }
   RETURN_NOT_OK(dfw->WriteDeltaStats(*stats));
@@ -141,8 +201,9 @@ Status DeltaMemStore::CheckRowDeleted(rowid_t row_idx, bool *deleted) const {
 
   bool exact;
 
+  // Only the deletes and reinserts matter, so look in the delete index.
   // TODO: can we avoid the allocation here?
-  gscoped_ptr<DMSTreeIter> iter(tree_->NewIterator());
+  gscoped_ptr<DMSTreeIter> iter(delete_index_->NewIterator());
   if (!iter->SeekAtOrAfter(key_slice, &exact)) {
     return Status::OK();
   }
@@ -155,11 +216,9 @@ Status DeltaMemStore::CheckRowDeleted(rowid_t row_idx, bool *deleted) const {
     DCHECK_GE(key.row_idx(), row_idx);
     if (key.row_idx() != row_idx) break;
 
-    RowChangeList val(v);
-    // Mutation is for the target row, check deletion status.
-    RowChangeListDecoder decoder((RowChangeList(v)));
-    decoder.InitNoSafetyChecks();
-    decoder.TwiddleDeleteStatus(deleted);
+    // The last delete or reinsert of the row determines whether it's deleted.
+    DCHECK_EQ(1, v.size());
+    *deleted = v[0] == 0;
 
     iter->Next();
   }
@@ -180,12 +239,25 @@ DMSIterator::DMSIterator(const shared_ptr<const DeltaMemStore>& dms,
     : dms_(dms),
       mvcc_snapshot_(std::move(snapshot)),
       iter_(dms->tree_->NewIterator()),
+      delete_index_iter_(dms->delete_index_->NewIterator()),
+      iter_positioned_(false),
+      index_iters_positioned_(false),
       initted_(false),
       prepared_idx_(0),
       prepared_count_(0),
       prepared_for_(NOT_PREPARED),
       seeked_(false),
-      projection_(projection) {}
+      projection_(projection) {
+  // Any update visible in the snapshot was indexed before the snapshot was
+  // taken, so columns without an index yet have nothing to apply.
+  for (int i = 0; i < projection_->num_columns(); i++) {
+    DeltaMemStore::DMSTree* index = dms->FindColumnIndex(projection_->column_id(i));
+    if (index != nullptr) {
+      col_index_iters_.push_back({ i, unique_ptr<DeltaMemStore::DMSTreeIter>(
+          index->NewIterator()) });
+    }
+  }
+}
 
 Status DMSIterator::Init(ScanSpec *spec) {
   initted_ = true;
@@ -193,12 +265,9 @@ Status DMSIterator::Init(ScanSpec *spec) {
 }
 
 Status DMSIterator::SeekToOrdinal(rowid_t row_idx) {
-  faststring buf;
-  DeltaKey key(row_idx, Timestamp(0));
-  key.EncodeTo(&buf);
-
-  bool exact; /* unused */
-  iter_->SeekAtOrAfter(Slice(buf), &exact);
+  // The iterators are seeked lazily, by the first batch which uses them.
+  iter_positioned_ = false;
+  index_iters_positioned_ = false;
   prepared_idx_ = row_idx;
   prepared_count_ = 0;
   prepared_for_ = NOT_PREPARED;
@@ -206,6 +275,15 @@ Status DMSIterator::SeekToOrdinal(rowid_t row_idx) {
   return Status::OK();
 }
 
+void DMSIterator::SeekTreeIter(DeltaMemStore::DMSTreeIter* iter, rowid_t row_idx) {
+  faststring buf;
+  DeltaKey key(row_idx, Timestamp(0));
+  key.EncodeTo(&buf);
+
+  bool exact; /* unused */
+  iter->SeekAtOrAfter(Slice(buf), &exact);
+}
+
 Status DMSIterator::PrepareBatch(size_t nrows, PrepareFlag flag) {
   // This current implementation copies the whole batch worth of deltas
   // into a buffer local to this iterator, after filtering out deltas which
@@ -218,6 +296,10 @@ Status DMSIterator::PrepareBatch(size_t nrows, PrepareFlag flag) {
   // local copies as they progress in order to shield from concurrent mutation,
   // so with N columns, we'd end up making N copies of the data. Making a local
   // copy here is instead a single copy of the data, so is likely faster.
+  //
+  // When preparing to apply, the deltas are read from the per-column and
+  // delete indexes rather than from the tree of whole deltas, so that only
+  // the projected columns' updates are read, and none need to be decoded.
   CHECK(seeked_);
   DCHECK(initted_) << "must init";
   rowid_t start_row = prepared_idx_ + prepared_count_;
@@ -232,71 +314,65 @@ Status DMSIterator::PrepareBatch(size_t nrows, PrepareFlag flag) {
   deletes_and_reinserts_.clear();
   prepared_deltas_.clear();
 
-  while (iter_->IsValid()) {
-    Slice key_slice, val;
-    iter_->GetCurrentEntry(&key_slice, &val);
-    DeltaKey key;
-    RETURN_NOT_OK(key.DecodeFrom(&key_slice));
-    DCHECK_GE(key.row_idx(), start_row);
-    if (key.row_idx() > stop_row) break;
-
-    if (!mvcc_snapshot_.IsCommitted(key.timestamp())) {
-      // The transaction which applied this update is not yet committed
-      // in this iterator's MVCC snapshot. Hence, skip it.
-      iter_->Next();
-      continue;
+  if (flag == PREPARE_FOR_APPLY) {
+    if (!index_iters_positioned_) {
+      for (ColumnIndexIter& cii : col_index_iters_) {
+        SeekTreeIter(cii.iter.get(), start_row);
+      }
+      SeekTreeIter(delete_index_iter_.get(), start_row);
+    }
+    for (ColumnIndexIter& cii : col_index_iters_) {
+      RETURN_NOT_OK(PrepareColumnUpdates(cii.col_idx, stop_row, cii.iter.get(),
+                                         &updates_by_col_[cii.col_idx]));
     }
 
-    if (flag == PREPARE_FOR_APPLY) {
-      RowChangeListDecoder decoder((RowChangeList(val)));
-      decoder.InitNoSafetyChecks();
-      if (decoder.is_delete() || decoder.is_reinsert()) {
+    while (delete_index_iter_->IsValid()) {
+      Slice key_slice, val;
+      delete_index_iter_->GetCurrentEntry(&key_slice, &val);
+      DeltaKey key;
+      RETURN_NOT_OK(key.DecodeFrom(&key_slice));
+      DCHECK_GE(key.row_idx(), start_row);
+      if (key.row_idx() > stop_row) break;
+
+      if (mvcc_snapshot_.IsCommitted(key.timestamp())) {
+        DCHECK_EQ(1, val.size());
         DeleteOrReinsert dor;
         dor.row_id = key.row_idx();
-        dor.exists = decoder.is_reinsert();
+        dor.exists = val[0] != 0;
         deletes_and_reinserts_.push_back(dor);
-      } else {
-        DCHECK(decoder.is_update());
-        while (decoder.HasNext()) {
-          RowChangeListDecoder::DecodedUpdate dec;
-          RETURN_NOT_OK(decoder.DecodeNext(&dec));
-          int col_idx;
-          const void* col_val;
-          RETURN_NOT_OK(dec.Validate(*projection_, &col_idx, &col_val));
-          if (col_idx == -1) {
-            // This column isn't being projected.
-            continue;
-          }
-          int col_size = projection_->column(col_idx).type_info()->size();
-
-          // If we already have an earlier update for the same column, we can
-          // just overwrite that one.
-          if (updates_by_col_[col_idx].empty() ||
-              updates_by_col_[col_idx].back().row_id != key.row_idx()) {
-            updates_by_col_[col_idx].push_back(ColumnUpdate());
-          }
-
-          ColumnUpdate& cu = updates_by_col_[col_idx].back();
-          cu.row_id = key.row_idx();
-          if (col_val == nullptr) {
-            cu.new_val_ptr = nullptr;
-          } else {
-            memcpy(cu.new_val_buf, col_val, col_size);
-            // NOTE: we're constructing a pointer here to an element inside the deque.
-            // This is safe because deques never invalidate pointers to their elements.
-            cu.new_val_ptr = cu.new_val_buf;
-          }
-        }
       }
-    } else {
-      DCHECK_EQ(flag, PREPARE_FOR_COLLECT);
+      delete_index_iter_->Next();
+    }
+    index_iters_positioned_ = true;
+    iter_positioned_ = false;
+  } else {
+    DCHECK_EQ(flag, PREPARE_FOR_COLLECT);
+    if (!iter_positioned_) {
+      SeekTreeIter(iter_.get(), start_row);
+    }
+    while (iter_->IsValid()) {
+      Slice key_slice, val;
+      iter_->GetCurrentEntry(&key_slice, &val);
+      DeltaKey key;
+      RETURN_NOT_OK(key.DecodeFrom(&key_slice));
+      DCHECK_GE(key.row_idx(), start_row);
+      if (key.row_idx() > stop_row) break;
+
+      if (!mvcc_snapshot_.IsCommitted(key.timestamp())) {
+        // The transaction which applied this update is not yet committed
+        // in this iterator's MVCC snapshot. Hence, skip it.
+        iter_->Next();
+        continue;
+      }
+
       PreparedDelta d;
       d.key = key;
       d.val = val;
       prepared_deltas_.push_back(d);
+      iter_->Next();
     }
-
-    iter_->Next();
+    iter_positioned_ = true;
+    index_iters_positioned_ = false;
   }
   prepared_idx_ = start_row;
   prepared_count_ = nrows;
@@ -304,6 +380,64 @@ Status DMSIterator::PrepareBatch(size_t nrows, PrepareFlag flag) {
   return Status::OK();
 }
 
+Status DMSIterator::PrepareColumnUpdates(int col_idx, rowid_t stop_row,
+                                         DeltaMemStore::DMSTreeIter* iter,
+                                         UpdatesForColumn* updates) {
+  const ColumnSchema& col = projection_->column(col_idx);
+  bool is_binary = col.type_info()->physical_type() == BINARY;
+  size_t col_size = col.type_info()->size();
+
+  while (iter->IsValid()) {
+    Slice key_slice, val;
+    iter->GetCurrentEntry(&key_slice, &val);
+    DeltaKey key;
+    RETURN_NOT_OK(key.DecodeFrom(&key_slice));
+    if (key.row_idx() > stop_row) break;
+
+    if (!mvcc_snapshot_.IsCommitted(key.timestamp())) {
+      // The transaction which applied this update is not yet committed
+      // in this iterator's MVCC snapshot. Hence, skip it.
+      iter->Next();
+      continue;
+    }
+
+    DCHECK_GE(val.size(), 1);
+    bool is_null = val[0] != 0;
+    Slice raw_value(val.data() + 1, val.size() - 1);
+    if (is_null) {
+      if (PREDICT_FALSE(!col.is_nullable())) {
+        return Status::Corruption("decoded set-to-NULL for non-nullable column",
+                                  col.ToString());
+      }
+    } else if (PREDICT_FALSE(!is_binary && raw_value.size() != col_size)) {
+      return Status::Corruption(Substitute("invalid value $0 for column $1",
+                                           raw_value.ToDebugString(), col.ToString()));
+    }
+
+    // If we already have an earlier update for the same row, we can
+    // just overwrite that one.
+    if (updates->empty() || updates->back().row_id != key.row_idx()) {
+      updates->push_back(ColumnUpdate());
+    }
+
+    ColumnUpdate& cu = updates->back();
+    cu.row_id = key.row_idx();
+    if (is_null) {
+      cu.new_val_ptr = nullptr;
+    } else {
+      // For strings, the Slice stored in the buffer points to the value in the
+      // DMS's arena.
+      const void* src = is_binary ? static_cast<const void*>(&raw_value) : raw_value.data();
+      memcpy(cu.new_val_buf, src, col_size);
+      // NOTE: we're constructing a pointer here to an element inside the deque.
+      // This is safe because deques never invalidate pointers to their elements.
+      cu.new_val_ptr = cu.new_val_buf;
+    }
+    iter->Next();
+  }
+  return Status::OK();
+}
+
 Status DMSIterator::ApplyUpdates(size_t col_to_apply, ColumnBlock *dst) {
   DCHECK_EQ(prepared_for_, PREPARED_FOR_APPLY);
   DCHECK_EQ(prepared_count_, dst->nrows());
@@ -21,6 +21,7 @@
 #include <gtest/gtest_prod.h>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "kudu/common/columnblock.h"
@@ -36,6 +37,7 @@
 #include "kudu/tablet/delta_stats.h"
 #include "kudu/tablet/mvcc.h"
 #include "kudu/util/atomic.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/memory/arena.h"
 
 namespace kudu {
@@ -57,6 +59,13 @@ struct DMSTreeTraits : public btree::BTreeTraits {
 // In-memory storage for data which has been recently updated.
 // This essentially tracks a 'diff' per row, which contains the
 // modified columns.
+//
+// Alongside the tree of whole deltas, the DMS maintains secondary indexes
+// with the same keys: one per updated column, holding just that column's new
+// values, and one holding the deletes and reinserts. Scans apply deltas from
+// these, so they only decode the columns they project, and skip the deltas
+// for columns they don't project entirely. Compactions and flushes read the
+// whole deltas.
 
 class DeltaMemStore : public DeltaStore,
                       public std::enable_shared_from_this<DeltaMemStore> {
@@ -146,6 +155,14 @@ class DeltaMemStore : public DeltaStore,
     return *tree_;
   }
 
+  // Add the delta 'update', which was inserted into tree_ at 'key', to the
+  // per-column index of each column it updates, or to the delete index.
+  Status IndexDelta(const Slice& key, const RowChangeList& update);
+
+  // Return the index of the updates to the column 'col_id', or NULL if
+  // the column has never been updated.
+  DMSTree* FindColumnIndex(ColumnId col_id) const;
+
   const int64_t id_;    // DeltaMemStore ID.
   const int64_t rs_id_; // Rowset ID.
 
@@ -157,6 +174,17 @@ class DeltaMemStore : public DeltaStore,
   // Concurrent B-Tree storing <key index> -> RowChangeList
   gscoped_ptr<DMSTree> tree_;
 
+  // Per-column indexes storing <key index> -> new value of the column,
+  // encoded as a byte which is non-zero if the value is NULL, followed by
+  // the raw value (as decoded from the RowChangeList). Created the first
+  // time each column is updated, and never removed.
+  std::unordered_map<ColumnId, std::unique_ptr<DMSTree>> col_indexes_;
+  mutable rw_spinlock col_indexes_lock_;
+
+  // Index storing <key index> -> a byte which is non-zero if the delta is a
+  // REINSERT, and zero if the delta is a DELETE.
+  gscoped_ptr<DMSTree> delete_index_;
+
   log::MinLogIndexAnchorer anchorer_;
 
   const DeltaStats delta_stats_;
@@ -218,13 +246,33 @@ class DMSIterator : public DeltaIterator {
   DMSIterator(const std::shared_ptr<const DeltaMemStore> &dms,
               const Schema *projection, MvccSnapshot snapshot);
 
+  // Seek 'iter' to the first delta for row 'row_idx' or later.
+  static void SeekTreeIter(DeltaMemStore::DMSTreeIter* iter, rowid_t row_idx);
+
   const std::shared_ptr<const DeltaMemStore> dms_;
 
   // MVCC state which allows us to ignore uncommitted transactions.
   const MvccSnapshot mvcc_snapshot_;
 
+  // Iterator over the whole deltas, used when preparing to collect
+  // mutations.
   gscoped_ptr<DeltaMemStore::DMSTreeIter> iter_;
 
+  // Iterators over the indexes of the projected columns which have been
+  // updated, and over the delete index, used when preparing to apply.
+  struct ColumnIndexIter {
+    int col_idx;
+    std::unique_ptr<DeltaMemStore::DMSTreeIter> iter;
+  };
+  std::vector<ColumnIndexIter> col_index_iters_;
+  gscoped_ptr<DeltaMemStore::DMSTreeIter> delete_index_iter_;
+
+  // Whether iter_, or the index iterators, are positioned at the start of
+  // the next batch. Each set of iterators is only advanced by the kind of
+  // batch it is used for, and is lazily re-seeked otherwise.
+  bool iter_positioned_;
+  bool index_iters_positioned_;
+
   bool initted_;
 
   // The index at which the last PrepareBatch() call was made
@@ -256,6 +304,14 @@ class DMSIterator : public DeltaIterator {
   };
   typedef std::deque<ColumnUpdate> UpdatesForColumn;
   std::vector<UpdatesForColumn> updates_by_col_;
+
+  // Prepare 'updates' with the committed updates to the column at
+  // 'col_idx' in the projection, for rows up to and including 'stop_row',
+  // read with 'iter' from the column's index.
+  Status PrepareColumnUpdates(int col_idx, rowid_t stop_row,
+                              DeltaMemStore::DMSTreeIter* iter,
+                              UpdatesForColumn* updates);
+
   struct DeleteOrReinsert {
     rowid_t row_id;
     bool exists;
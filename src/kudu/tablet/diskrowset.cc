@@ -16,12 +16,17 @@
 // under the License.
 
 #include <algorithm>
+#include <functional>
 #include <glog/logging.h>
+#include <limits>
+#include <map>
 #include <mutex>
+#include <utility>
 #include <vector>
 
 #include "kudu/common/generic_iterators.h"
 #include "kudu/common/iterator.h"
+#include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/consensus/log_anchor_registry.h"
 #include "kudu/cfile/bloomfile.h"
@@ -54,10 +59,17 @@ DEFINE_int32(default_composite_key_index_block_size_bytes, 4096,
              "Block size used for composite key indexes.");
 TAG_FLAG(default_composite_key_index_block_size_bytes, experimental);
 
+DEFINE_bool(tablet_cache_rowset_checksums, true,
+            "Whether flushes and compactions checksum the rows they write to each "
+            "rowset, so that checksum scans can skip the rowsets which haven't been "
+            "mutated since.");
+TAG_FLAG(tablet_cache_rowset_checksums, advanced);
+
 namespace kudu {
 namespace tablet {
 
 using cfile::BloomFileWriter;
+using fs::CreateBlockOptions;
 using fs::ScopedWritableBlockCloser;
 using fs::WritableBlock;
 using log::LogAnchorRegistry;
@@ -70,20 +82,26 @@ const char *DiskRowSet::kMaxKeyMetaEntryName = "max_key";
 
 DiskRowSetWriter::DiskRowSetWriter(RowSetMetadata* rowset_metadata,
                                    const Schema* schema,
-                                   BloomFilterSizing bloom_sizing)
+                                   BloomFilterSizing bloom_sizing,
+                                   ThreadPool* encode_pool)
     : rowset_metadata_(rowset_metadata),
       schema_(schema),
       bloom_sizing_(std::move(bloom_sizing)),
+      encode_pool_(encode_pool),
       finished_(false),
       written_count_(0) {
   CHECK(schema->has_column_ids());
+  if (FLAGS_tablet_cache_rowset_checksums) {
+    checksummer_.reset(new RowChecksummer());
+  }
 }
 
 Status DiskRowSetWriter::Open() {
   TRACE_EVENT0("tablet", "DiskRowSetWriter::Open");
 
   FsManager* fs = rowset_metadata_->fs_manager();
-  col_writer_.reset(new MultiColumnWriter(fs, schema_));
+  col_writer_.reset(new MultiColumnWriter(fs, schema_, encode_pool_,
+                                          rowset_metadata_->tablet_metadata()->tablet_id()));
   RETURN_NOT_OK(col_writer_->Open());
 
   // Open bloom filter.
@@ -101,7 +119,8 @@ Status DiskRowSetWriter::InitBloomFileWriter() {
   TRACE_EVENT0("tablet", "DiskRowSetWriter::InitBloomFileWriter");
   gscoped_ptr<WritableBlock> block;
   FsManager* fs = rowset_metadata_->fs_manager();
-  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(&block),
+  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(
+      CreateBlockOptions::Background(rowset_metadata_->tablet_metadata()->tablet_id()), &block),
                         "Couldn't allocate a block for bloom filter");
   rowset_metadata_->set_bloom_block(block->id());
 
@@ -114,7 +133,8 @@ Status DiskRowSetWriter::InitAdHocIndexWriter() {
   TRACE_EVENT0("tablet", "DiskRowSetWriter::InitAdHocIndexWriter");
   gscoped_ptr<WritableBlock> block;
   FsManager* fs = rowset_metadata_->fs_manager();
-  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(&block),
+  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(
+      CreateBlockOptions::Background(rowset_metadata_->tablet_metadata()->tablet_id()), &block),
                         "Couldn't allocate a block for compoound index");
 
   rowset_metadata_->set_adhoc_index_block(block->id());
@@ -174,6 +194,9 @@ Status DiskRowSetWriter::AppendBlock(const RowBlock &block) {
     // TODO: performance might be better if we actually batch this -
     // encode a bunch of key slices, then pass them all in one go.
     RowBlockRow row = block.row(i);
+    if (checksummer_) {
+      checksummer_->AddRow(*schema_, row);
+    }
     // Insert the encoded key into the bloom.
     Slice enc_key = schema_->EncodeComparableKey(row, &last_encoded_key_);
     RETURN_NOT_OK(bloom_writer_->AppendKeys(&enc_key, 1));
@@ -195,6 +218,10 @@ Status DiskRowSetWriter::AppendBlock(const RowBlock &block) {
   return Status::OK();
 }
 
+Status DiskRowSetWriter::Sync() {
+  return col_writer_->Sync();
+}
+
 Status DiskRowSetWriter::Finish() {
   TRACE_EVENT0("tablet", "DiskRowSetWriter::Finish");
   ScopedWritableBlockCloser closer;
@@ -211,6 +238,9 @@ Status DiskRowSetWriter::FinishAndReleaseBlocks(ScopedWritableBlockCloser* close
     return Status::Aborted("no data written");
   }
 
+  // The key index may be the key column's writer, which must not be in use.
+  RETURN_NOT_OK(col_writer_->Sync());
+
   // Save the last encoded (max) key
   CHECK_GT(last_encoded_key_.size(), 0);
   Slice last_enc_slice(last_encoded_key_);
@@ -230,6 +260,9 @@ Status DiskRowSetWriter::FinishAndReleaseBlocks(ScopedWritableBlockCloser* close
   RowSetMetadata::ColumnIdToBlockIdMap flushed_blocks;
   col_writer_->GetFlushedBlocksByColumnId(&flushed_blocks);
   rowset_metadata_->SetColumnDataBlocks(flushed_blocks);
+  RowSetMetadata::ColumnIdToStatsMap column_stats;
+  col_writer_->GetColumnStatisticsByColumnId(&column_stats);
+  rowset_metadata_->SetColumnStatistics(column_stats);
 
   if (ad_hoc_index_writer_ != nullptr) {
     Status s = ad_hoc_index_writer_->FinishAndReleaseBlock(closer);
@@ -277,12 +310,14 @@ DiskRowSetWriter::~DiskRowSetWriter() {
 
 RollingDiskRowSetWriter::RollingDiskRowSetWriter(
     TabletMetadata* tablet_metadata, const Schema& schema,
-    BloomFilterSizing bloom_sizing, size_t target_rowset_size)
+    BloomFilterSizing bloom_sizing, size_t target_rowset_size,
+    ThreadPool* encode_pool)
     : state_(kInitialized),
       tablet_metadata_(DCHECK_NOTNULL(tablet_metadata)),
       schema_(schema),
       bloom_sizing_(std::move(bloom_sizing)),
       target_rowset_size_(target_rowset_size),
+      encode_pool_(encode_pool),
       row_idx_in_cur_drs_(0),
       can_roll_(false),
       written_count_(0),
@@ -306,14 +341,17 @@ Status RollingDiskRowSetWriter::RollWriter() {
 
   RETURN_NOT_OK(tablet_metadata_->CreateRowSet(&cur_drs_metadata_, schema_));
 
-  cur_writer_.reset(new DiskRowSetWriter(cur_drs_metadata_.get(), &schema_, bloom_sizing_));
+  cur_writer_.reset(new DiskRowSetWriter(cur_drs_metadata_.get(), &schema_, bloom_sizing_,
+                                         encode_pool_));
   RETURN_NOT_OK(cur_writer_->Open());
 
   FsManager* fs = tablet_metadata_->fs_manager();
   gscoped_ptr<WritableBlock> undo_data_block;
   gscoped_ptr<WritableBlock> redo_data_block;
-  RETURN_NOT_OK(fs->CreateNewBlock(&undo_data_block));
-  RETURN_NOT_OK(fs->CreateNewBlock(&redo_data_block));
+  RETURN_NOT_OK(fs->CreateNewBlock(
+      CreateBlockOptions::Background(tablet_metadata_->tablet_id()), &undo_data_block));
+  RETURN_NOT_OK(fs->CreateNewBlock(
+      CreateBlockOptions::Background(tablet_metadata_->tablet_id()), &redo_data_block));
   cur_undo_ds_block_id_ = undo_data_block->id();
   cur_redo_ds_block_id_ = redo_data_block->id();
   cur_undo_writer_.reset(new DeltaFileWriter(std::move(undo_data_block)));
@@ -347,6 +385,14 @@ Status RollingDiskRowSetWriter::AppendBlock(const RowBlock &block) {
   return Status::OK();
 }
 
+Status RollingDiskRowSetWriter::Sync() {
+  // There may be no current writer if rolling failed.
+  if (!cur_writer_) {
+    return Status::OK();
+  }
+  return cur_writer_->Sync();
+}
+
 Status RollingDiskRowSetWriter::AppendUndoDeltas(rowid_t row_idx_in_block,
                                                  Mutation* undo_delta_head,
                                                  rowid_t* row_idx) {
@@ -377,7 +423,7 @@ Status RollingDiskRowSetWriter::AppendDeltas(rowid_t row_idx_in_block,
   for (const Mutation *mut = delta_head; mut != nullptr; mut = mut->next()) {
     DeltaKey undo_key(*row_idx, mut->timestamp());
     RETURN_NOT_OK(writer->AppendDelta<Type>(undo_key, mut->changelist()));
-    delta_stats->UpdateStats(mut->timestamp(), mut->changelist());
+    delta_stats->UpdateStats(undo_key, mut->changelist());
   }
   return Status::OK();
 }
@@ -422,6 +468,20 @@ Status RollingDiskRowSetWriter::FinishCurrentWriter() {
       DCHECK_EQ(cur_redo_delta_stats->min_timestamp(), Timestamp::kMax);
     }
 
+    const RowChecksummer* checksummer = cur_writer_->checksummer();
+    if (checksummer) {
+      RowSetChecksumPB checksum;
+      for (int i = 0; i < schema_.num_columns(); i++) {
+        checksum.add_column_ids(schema_.column_id(i));
+      }
+      checksum.set_checksum(checksummer->checksum());
+      checksum.set_num_rows(checksummer->num_rows());
+      if (cur_undo_delta_stats->min_timestamp() != Timestamp::kMax) {
+        checksum.set_max_write_timestamp(cur_undo_delta_stats->max_timestamp().ToUint64());
+      }
+      cur_drs_metadata_->SetBaseChecksum(checksum);
+    }
+
     written_size_ += cur_writer_->written_size();
 
     written_drs_metas_.push_back(cur_drs_metadata_);
@@ -481,7 +541,7 @@ DiskRowSet::DiskRowSet(shared_ptr<RowSetMetadata> rowset_metadata,
 
 Status DiskRowSet::Open() {
   TRACE_EVENT0("tablet", "DiskRowSet::Open");
-  gscoped_ptr<CFileSet> new_base(new CFileSet(rowset_metadata_));
+  gscoped_ptr<CFileSet> new_base(new CFileSet(rowset_metadata_, parent_tracker_));
   RETURN_NOT_OK(new_base->Open());
   base_data_.reset(new_base.release());
 
@@ -509,7 +569,7 @@ Status DiskRowSet::MinorCompactDeltaStores() {
 
 Status DiskRowSet::MajorCompactDeltaStores(HistoryGcOpts history_gc_opts) {
   vector<ColumnId> col_ids;
-  delta_tracker_->GetColumnIdsWithUpdates(&col_ids);
+  GetColumnIdsToMajorCompact(&col_ids);
 
   if (col_ids.empty()) {
     return Status::OK();
@@ -521,13 +581,27 @@ Status DiskRowSet::MajorCompactDeltaStores(HistoryGcOpts history_gc_opts) {
 Status DiskRowSet::MajorCompactDeltaStoresWithColumnIds(const vector<ColumnId>& col_ids,
                                                         HistoryGcOpts history_gc_opts) {
   TRACE_EVENT0("tablet", "DiskRowSet::MajorCompactDeltaStores");
-  std::lock_guard<Mutex> l(*delta_tracker()->compact_flush_lock());
 
+  // The delta tracker's lock is only held while selecting the REDO stores to
+  // compact, and later while committing, so that DMS flushes, which append
+  // newer REDO stores, aren't held up by the compaction.
   // TODO: do we need to lock schema or anything here?
   gscoped_ptr<MajorDeltaCompaction> compaction;
-  RETURN_NOT_OK(NewMajorDeltaCompaction(col_ids, std::move(history_gc_opts), &compaction));
+  {
+    std::lock_guard<Mutex> l(*delta_tracker()->compact_flush_lock());
+    RETURN_NOT_OK(NewMajorDeltaCompaction(col_ids, std::move(history_gc_opts), &compaction));
+  }
 
   RETURN_NOT_OK(compaction->Compact());
+  return CommitMajorDeltaCompaction(compaction.get());
+}
+
+Status DiskRowSet::CommitMajorDeltaCompaction(MajorDeltaCompaction* compaction) {
+  std::lock_guard<Mutex> l(*delta_tracker()->compact_flush_lock());
+  Status s = delta_tracker_->CheckStoresAreTracked(compaction->included_stores(), REDO);
+  if (!s.ok()) {
+    return Status::Aborted("REDO delta stores were compacted concurrently", s.ToString());
+  }
 
   // Update and flush the metadata. This needs to happen before we make the new files visible to
   // prevent inconsistencies after a server crash.
@@ -537,7 +611,7 @@ Status DiskRowSet::MajorCompactDeltaStoresWithColumnIds(const vector<ColumnId>&
   RETURN_NOT_OK(rowset_metadata_->Flush());
 
   // Make the new base data and delta files visible.
-  gscoped_ptr<CFileSet> new_base(new CFileSet(rowset_metadata_));
+  gscoped_ptr<CFileSet> new_base(new CFileSet(rowset_metadata_, parent_tracker_));
   RETURN_NOT_OK(new_base->Open());
   {
     std::lock_guard<percpu_rwlock> lock(component_lock_);
@@ -565,6 +639,7 @@ Status DiskRowSet::NewMajorDeltaCompaction(const vector<ColumnId>& col_ids,
     &delta_iter));
 
   out->reset(new MajorDeltaCompaction(rowset_metadata_->fs_manager(),
+                                      rowset_metadata_->tablet_metadata()->tablet_id(),
                                       *schema,
                                       base_data_.get(),
                                       std::move(delta_iter),
@@ -620,6 +695,14 @@ Status DiskRowSet::MutateRow(Timestamp timestamp,
   return Status::OK();
 }
 
+Status DiskRowSet::CheckRowsMaybePresent(const RowSetKeyProbe* const* probes, size_t n,
+                                         bool* maybe_present,
+                                         ProbeStats* const* stats) const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+  return base_data_->CheckRowsMaybePresent(probes, n, maybe_present, stats);
+}
+
 Status DiskRowSet::CheckRowPresent(const RowSetKeyProbe &probe,
                                    bool* present,
                                    ProbeStats* stats) const {
@@ -647,6 +730,19 @@ Status DiskRowSet::CountRows(rowid_t *count) const {
   return base_data_->CountRows(count);
 }
 
+Status DiskRowSet::CountVisibleRows(const MvccSnapshot& snap, int64_t* count,
+                                    bool* counted) const {
+  DCHECK(open_);
+  rowid_t num_rows;
+  RETURN_NOT_OK(CountRows(&num_rows));
+  int64_t delete_count;
+  RETURN_NOT_OK(delta_tracker_->CountDeletesFromStats(snap, &delete_count, counted));
+  if (*counted) {
+    *count = num_rows - delete_count;
+  }
+  return Status::OK();
+}
+
 Status DiskRowSet::GetBounds(std::string* min_encoded_key,
                              std::string* max_encoded_key) const {
   DCHECK(open_);
@@ -660,6 +756,43 @@ uint64_t DiskRowSet::EstimateBaseDataDiskSize() const {
   return base_data_->EstimateOnDiskSize();
 }
 
+void DiskRowSet::GetColumnIdsToMajorCompact(vector<ColumnId>* col_ids) const {
+  DCHECK(open_);
+  col_ids->clear();
+  std::map<ColumnId, int64_t> delta_bytes_by_col_id;
+  vector<std::pair<double, ColumnId>> ranked;
+  {
+    shared_lock<rw_spinlock> l(component_lock_.get_lock());
+    delta_tracker_->EstimateRedoBytesByColumnId(&delta_bytes_by_col_id);
+    for (const auto& entry : delta_bytes_by_col_id) {
+      uint64_t base_bytes = base_data_->EstimateOnDiskSizeForColumn(entry.first);
+      // A column without base data (e.g. one which was added after the data was
+      // flushed) always benefits from having its updates compacted.
+      double ratio = base_bytes == 0 ?
+          std::numeric_limits<double>::infinity() :
+          static_cast<double>(entry.second) / base_bytes;
+      if (ratio >= FLAGS_tablet_delta_store_major_compact_min_ratio) {
+        ranked.emplace_back(ratio, entry.first);
+      }
+    }
+  }
+
+  if (ranked.empty()) {
+    // The updates are spread across many columns, none of which is worth
+    // compacting on its own, so compact them all.
+    delta_tracker_->GetColumnIdsWithUpdates(col_ids);
+    return;
+  }
+  std::sort(ranked.begin(), ranked.end(), std::greater<std::pair<double, ColumnId>>());
+  for (const auto& r : ranked) {
+    col_ids->push_back(r.second);
+  }
+  if (VLOG_IS_ON(1)) {
+    VLOG(1) << ToString() << ": major compacting " << ranked.size() << " of "
+            << delta_bytes_by_col_id.size() << " updated columns";
+  }
+}
+
 uint64_t DiskRowSet::EstimateDeltaDiskSize() const {
   DCHECK(open_);
   shared_lock<rw_spinlock> l(component_lock_.get_lock());
@@ -672,6 +805,80 @@ uint64_t DiskRowSet::EstimateOnDiskSize() const {
   return base_data_->EstimateOnDiskSize() + delta_tracker_->EstimateOnDiskSize();
 }
 
+Status DiskRowSet::GetColumnStatistics(const Schema& schema, int col_idx,
+                                       ColumnStatisticsPB* stats) const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+  ColumnId col_id = schema.column_id(col_idx);
+  if (!rowset_metadata_->GetColumnStatistics(col_id, stats)) {
+    return Status::NotFound("no statistics for column", schema.column(col_idx).name());
+  }
+  // The sketch isn't kept in the metadata; see RowSetMetadata::SetColumnStatistics().
+  string sketch;
+  if (base_data_->GetNdvSketch(col_id, &sketch).ok()) {
+    stats->set_ndv_sketch(sketch);
+  }
+  return Status::OK();
+}
+
+Status DiskRowSet::GetKeySamples(int num_samples, vector<string>* keys) const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+  return base_data_->GetKeySamples(num_samples, keys);
+}
+
+void DiskRowSet::GetHotBlocks(HotBlocksPB* hot_blocks) const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+  base_data_->GetHotBlocks(hot_blocks);
+}
+
+Status DiskRowSet::WarmUpBlockCache(const HotBlocksPB& hot_blocks, int* num_loaded) {
+  DCHECK(open_);
+  shared_ptr<CFileSet> base_data;
+  {
+    shared_lock<rw_spinlock> l(component_lock_.get_lock());
+    base_data = base_data_;
+  }
+  // The reads happen outside of the lock, which is a spinlock.
+  return base_data->WarmUpBlockCache(hot_blocks, num_loaded);
+}
+
+bool DiskRowSet::GetCachedChecksum(const Schema& projection, const MvccSnapshot& snap,
+                                   uint64_t* checksum, int64_t* num_rows) const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+  RowSetChecksumPB cached;
+  if (!rowset_metadata_->GetBaseChecksum(&cached)) {
+    return false;
+  }
+  if (cached.column_ids_size() != projection.num_columns()) {
+    return false;
+  }
+  for (int i = 0; i < projection.num_columns(); i++) {
+    if (cached.column_ids(i) != projection.column_id(i)) {
+      return false;
+    }
+  }
+
+  // The cached checksum doesn't reflect any REDO, including the DELETEs of
+  // the rows written after being deleted. A flushing DMS is added to the
+  // REDO stores before being replaced, so checking the DMS first can't miss
+  // one in between.
+  if (!delta_tracker_->DeltaMemStoreEmpty() || delta_tracker_->CountRedoDeltaStores() > 0) {
+    return false;
+  }
+
+  // Nor can the UNDOs of the writes the snapshot doesn't see be applied.
+  if (cached.has_max_write_timestamp() &&
+      snap.MayHaveUncommittedTransactionsAtOrBefore(Timestamp(cached.max_write_timestamp()))) {
+    return false;
+  }
+  *checksum = cached.checksum();
+  *num_rows = cached.num_rows();
+  return true;
+}
+
 size_t DiskRowSet::DeltaMemStoreSize() const {
   DCHECK(open_);
   return delta_tracker_->DeltaMemStoreSize();
@@ -734,6 +941,68 @@ double DiskRowSet::DeltaStoresCompactionPerfImprovementScore(DeltaCompactionType
   return std::min(1.0, perf_improv);
 }
 
+int64_t DiskRowSet::CountAncientDeletedRows(Timestamp ancient_history_mark) const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+  return delta_tracker_->CountAncientDeletes(ancient_history_mark);
+}
+
+int64_t DiskRowSet::EstimateBytesInAncientUndoDeltas(Timestamp ancient_history_mark) const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+  return delta_tracker_->EstimateBytesInAncientUndoDeltas(ancient_history_mark);
+}
+
+Status DiskRowSet::GCAncientUndoDeltas(Timestamp ancient_history_mark,
+                                       int64_t* rewrite_budget_bytes,
+                                       int64_t* bytes_reclaimed) {
+  TRACE_EVENT0("tablet", "DiskRowSet::GCAncientUndoDeltas");
+  DCHECK(open_);
+  return delta_tracker_->GCAncientUndoDeltas(ancient_history_mark, rewrite_budget_bytes,
+                                             bytes_reclaimed);
+}
+
+Status DiskRowSet::CheckAllRowsDeleted(Timestamp ancient_history_mark,
+                                       bool* all_deleted) const {
+  DCHECK(open_);
+  *all_deleted = false;
+
+  // The delta statistics can rule most rowsets out without any IO.
+  rowid_t num_rows;
+  RETURN_NOT_OK(CountRows(&num_rows));
+  if (num_rows == 0 || CountAncientDeletedRows(ancient_history_mark) < num_rows) {
+    return Status::OK();
+  }
+
+  // The statistics only bound the count: a store's deletes may have been
+  // reinserted since. Verify by applying the REDO deletes which happened
+  // before the ancient history mark to every row.
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+  Schema empty_schema;
+  unique_ptr<DeltaIterator> iter;
+  RETURN_NOT_OK(delta_tracker_->NewDeltaIterator(&empty_schema,
+                                                 MvccSnapshot(ancient_history_mark),
+                                                 DeltaTracker::REDOS_ONLY,
+                                                 &iter));
+  RETURN_NOT_OK(iter->Init(nullptr));
+  RETURN_NOT_OK(iter->SeekToOrdinal(0));
+
+  const size_t kBatchSize = 1000;
+  SelectionVector sel(kBatchSize);
+  for (rowid_t start = 0; start < num_rows; start += kBatchSize) {
+    size_t n = std::min<size_t>(kBatchSize, num_rows - start);
+    RETURN_NOT_OK(iter->PrepareBatch(n, DeltaIterator::PREPARE_FOR_APPLY));
+    sel.Resize(n);
+    sel.SetAllTrue();
+    RETURN_NOT_OK(iter->ApplyDeletes(&sel));
+    if (sel.AnySelected()) {
+      return Status::OK();
+    }
+  }
+  *all_deleted = true;
+  return Status::OK();
+}
+
 Status DiskRowSet::DebugDump(vector<string> *lines) {
   // Using CompactionInput to dump our data is an easy way of seeing all the
   // rows and deltas.
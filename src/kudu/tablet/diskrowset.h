@@ -33,6 +33,7 @@
 #include "kudu/fs/block_manager.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/tablet/delta_key.h"
+#include "kudu/tablet/row_checksum.h"
 #include "kudu/tablet/rowset_metadata.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/util/atomic.h"
@@ -45,6 +46,7 @@ class FsManager;
 class MemTracker;
 class RowBlock;
 class RowChangeList;
+class ThreadPool;
 
 namespace cfile {
 class BloomFileWriter;
@@ -69,8 +71,12 @@ class OperationResultPB;
 class DiskRowSetWriter {
  public:
   // TODO: document ownership of rowset_metadata
+  //
+  // If 'encode_pool' is non-NULL, the columns are encoded and written on it;
+  // see MultiColumnWriter.
   DiskRowSetWriter(RowSetMetadata* rowset_metadata, const Schema* schema,
-                   BloomFilterSizing bloom_sizing);
+                   BloomFilterSizing bloom_sizing,
+                   ThreadPool* encode_pool = nullptr);
 
   ~DiskRowSetWriter();
 
@@ -79,8 +85,15 @@ class DiskRowSetWriter {
   // The block is written to all column writers as well as the bloom filter,
   // if configured.
   // Rows must be appended in ascending order.
+  //
+  // With an encode pool, the columns of 'block' may still be being written
+  // when this returns, so 'block' must stay valid and unmodified until the
+  // next call to AppendBlock(), Sync() or Finish().
   Status AppendBlock(const RowBlock &block);
 
+  // Wait for all appended blocks to be written to the columns.
+  Status Sync();
+
   // Closes the CFiles and their underlying writable blocks.
   // If no rows were written, returns Status::Aborted().
   Status Finish();
@@ -105,6 +118,10 @@ class DiskRowSetWriter {
 
   const Schema& schema() const { return *schema_; }
 
+  // The checksum of the rows appended so far, or NULL if rows aren't being
+  // checksummed (see --tablet_cache_rowset_checksums).
+  const RowChecksummer* checksummer() const { return checksummer_.get(); }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(DiskRowSetWriter);
 
@@ -122,12 +139,14 @@ class DiskRowSetWriter {
   const Schema* const schema_;
 
   BloomFilterSizing bloom_sizing_;
+  ThreadPool* const encode_pool_;
 
   bool finished_;
   rowid_t written_count_;
   gscoped_ptr<MultiColumnWriter> col_writer_;
   gscoped_ptr<cfile::BloomFileWriter> bloom_writer_;
   gscoped_ptr<cfile::CFileWriter> ad_hoc_index_writer_;
+  gscoped_ptr<RowChecksummer> checksummer_;
 
   // The last encoded key written.
   faststring last_encoded_key_;
@@ -144,9 +163,13 @@ class RollingDiskRowSetWriter {
   // Create a new rolling writer. The given 'tablet_metadata' must stay valid
   // for the lifetime of this writer, and is used to construct the new rowsets
   // that this RollingDiskRowSetWriter creates.
+  //
+  // If 'encode_pool' is non-NULL, the columns of each rowset are encoded and
+  // written on it; see DiskRowSetWriter::AppendBlock() for the implications.
   RollingDiskRowSetWriter(TabletMetadata* tablet_metadata, const Schema& schema,
                           BloomFilterSizing bloom_sizing,
-                          size_t target_rowset_size);
+                          size_t target_rowset_size,
+                          ThreadPool* encode_pool = nullptr);
   ~RollingDiskRowSetWriter();
 
   Status Open();
@@ -159,8 +182,14 @@ class RollingDiskRowSetWriter {
   // you must append deltas using the APIs below *before* appending the block
   // of rows that they correspond to. This ensures that the output delta files
   // and data files are aligned.
+  //
+  // With an encode pool, 'block' must stay valid and unmodified until the
+  // next call to AppendBlock(), Sync() or Finish().
   Status AppendBlock(const RowBlock &block);
 
+  // Wait for all appended blocks to be written to the current rowset.
+  Status Sync();
+
   // Appends a sequence of REDO deltas for the same row to the current
   // redo delta file. 'row_idx_in_next_block' is the positional index after
   // the last written block. The 'row_idx_in_drs' out parameter will be set
@@ -190,6 +219,9 @@ class RollingDiskRowSetWriter {
 
   const Schema &schema() const { return schema_; }
 
+  // Return true if the columns are encoded and written in the background.
+  bool has_encode_pool() const { return encode_pool_ != nullptr; }
+
   // Return the set of rowset paths that were written by this writer.
   // This must only be called after Finish() returns an OK result.
   void GetWrittenRowSetMetadata(RowSetMetadataVector* metas) const;
@@ -222,6 +254,7 @@ class RollingDiskRowSetWriter {
   std::shared_ptr<RowSetMetadata> cur_drs_metadata_;
   const BloomFilterSizing bloom_sizing_;
   const size_t target_rowset_size_;
+  ThreadPool* const encode_pool_;
 
   gscoped_ptr<DiskRowSetWriter> cur_writer_;
 
@@ -308,6 +341,12 @@ class DiskRowSet : public RowSet {
                          bool *present,
                          ProbeStats* stats) const OVERRIDE;
 
+  // Filters out keys which are definitely absent from the base data, using
+  // its bloom filter. Deleted rows are not considered.
+  Status CheckRowsMaybePresent(const RowSetKeyProbe* const* probes, size_t n,
+                               bool* maybe_present,
+                               ProbeStats* const* stats) const OVERRIDE;
+
   ////////////////////
   // Read functions.
   ////////////////////
@@ -322,6 +361,11 @@ class DiskRowSet : public RowSet {
   // Count the number of rows in this rowset.
   Status CountRows(rowid_t *count) const OVERRIDE;
 
+  // Counts the base rows minus those deleted, when the delta stores'
+  // statistics suffice; see DeltaTracker::CountDeletesFromStats().
+  Status CountVisibleRows(const MvccSnapshot& snap, int64_t* count,
+                          bool* counted) const OVERRIDE;
+
   // See RowSet::GetBounds(...)
   virtual Status GetBounds(std::string* min_encoded_key,
                            std::string* max_encoded_key) const OVERRIDE;
@@ -336,6 +380,18 @@ class DiskRowSet : public RowSet {
   // TODO Offer a version that has the real total disk space usage.
   uint64_t EstimateOnDiskSize() const OVERRIDE;
 
+  Status GetColumnStatistics(const Schema& schema, int col_idx,
+                             ColumnStatisticsPB* stats) const OVERRIDE;
+
+  Status GetKeySamples(int num_samples, std::vector<std::string>* keys) const OVERRIDE;
+
+  bool GetCachedChecksum(const Schema& projection, const MvccSnapshot& snap,
+                         uint64_t* checksum, int64_t* num_rows) const OVERRIDE;
+
+  void GetHotBlocks(HotBlocksPB* hot_blocks) const OVERRIDE;
+
+  Status WarmUpBlockCache(const HotBlocksPB& hot_blocks, int* num_loaded) OVERRIDE;
+
   size_t DeltaMemStoreSize() const OVERRIDE;
 
   bool DeltaMemStoreEmpty() const OVERRIDE;
@@ -346,6 +402,16 @@ class DiskRowSet : public RowSet {
 
   double DeltaStoresCompactionPerfImprovementScore(DeltaCompactionType type) const OVERRIDE;
 
+  int64_t CountAncientDeletedRows(Timestamp ancient_history_mark) const OVERRIDE;
+
+  Status CheckAllRowsDeleted(Timestamp ancient_history_mark, bool* all_deleted) const OVERRIDE;
+
+  int64_t EstimateBytesInAncientUndoDeltas(Timestamp ancient_history_mark) const OVERRIDE;
+
+  Status GCAncientUndoDeltas(Timestamp ancient_history_mark,
+                             int64_t* rewrite_budget_bytes,
+                             int64_t* bytes_reclaimed) OVERRIDE;
+
   // Major compacts all the delta files for all the columns.
   Status MajorCompactDeltaStores(HistoryGcOpts history_gc_opts);
 
@@ -372,6 +438,8 @@ class DiskRowSet : public RowSet {
   FRIEND_TEST(TestRowSet, TestDMSFlush);
   FRIEND_TEST(TestCompaction, TestOneToOne);
   FRIEND_TEST(TabletHistoryGcTest, TestMajorDeltaCompactionOnSubsetOfColumns);
+  FRIEND_TEST(TestMajorDeltaCompaction, TestDeltaFlushDuringMajorCompaction);
+  FRIEND_TEST(TestMajorDeltaCompaction, TestColumnsToMajorCompact);
 
   friend class CompactionInput;
   friend class Tablet;
@@ -391,6 +459,17 @@ class DiskRowSet : public RowSet {
   Status MajorCompactDeltaStoresWithColumnIds(const std::vector<ColumnId>& col_ids,
                                               HistoryGcOpts history_gc_opts);
 
+  // Makes the results of 'compaction', which must have finished, durable and
+  // visible. Returns Status::Aborted() without changing anything if another
+  // compaction replaced some of its input REDO stores while it ran.
+  Status CommitMajorDeltaCompaction(MajorDeltaCompaction* compaction);
+
+  // Selects the columns worth major compacting, ranked worst first by their
+  // estimated ratio of REDO delta bytes to base data bytes: those whose ratio
+  // is at least --tablet_delta_store_major_compact_min_ratio. If no single
+  // column qualifies, all the columns with updates are selected.
+  void GetColumnIdsToMajorCompact(std::vector<ColumnId>* col_ids) const;
+
   std::shared_ptr<RowSetMetadata> rowset_metadata_;
 
   bool open_;
@@ -75,6 +75,10 @@ class LocalTabletWriter {
     return Write(RowOperationsPB::UPDATE, row);
   }
 
+  Status Increment(const KuduPartialRow& row) {
+    return Write(RowOperationsPB::INCREMENT, row);
+  }
+
   // Perform a write against the local tablet.
   // Returns a bad Status if the applied operation had a per-row error.
   Status Write(RowOperationsPB::Type type,
@@ -17,10 +17,12 @@
 
 #include "kudu/tablet/lock_manager.h"
 
+#include <algorithm>
 #include <glog/logging.h>
 #include <mutex>
 #include <semaphore.h>
 #include <string>
+#include <vector>
 
 #include "kudu/gutil/dynamic_annotations.h"
 #include "kudu/gutil/gscoped_ptr.h"
@@ -30,6 +32,8 @@
 #include "kudu/util/semaphore.h"
 #include "kudu/util/trace.h"
 
+using std::vector;
+
 namespace kudu {
 namespace tablet {
 
@@ -116,6 +120,12 @@ class LockTable {
   }
 
   LockEntry *GetLockEntry(const Slice &key);
+
+  // Look up (or insert) the entries for all of 'keys' at once, storing
+  // the entry for keys[i] in (*entries)[i]. Keys falling into the same
+  // bucket are handled under a single acquisition of that bucket's lock.
+  void GetLockEntries(const vector<Slice>& keys, vector<LockEntry*>* entries);
+
   void ReleaseLockEntry(LockEntry *entry);
 
  private:
@@ -146,6 +156,10 @@ class LockTable {
     return nullptr;
   }
 
+  // Bump the item count by 'delta' newly inserted entries, growing the
+  // table if it's now overloaded.
+  void AddItemsAndMaybeResize(int64_t delta);
+
   void Resize();
 
  private:
@@ -187,7 +201,70 @@ LockEntry *LockTable::GetLockEntry(const Slice& key) {
     return old_entry;
   }
 
-  if (base::subtle::NoBarrier_AtomicIncrement(&item_count_, 1) > size_) {
+  AddItemsAndMaybeResize(1);
+  return new_entry;
+}
+
+void LockTable::GetLockEntries(const vector<Slice>& keys, vector<LockEntry*>* entries) {
+  const size_t n = keys.size();
+  entries->resize(n);
+
+  // Hash every key (and allocate its candidate entry) before touching the table.
+  vector<LockEntry*> new_entries(n);
+  for (size_t i = 0; i < n; i++) {
+    new_entries[i] = new LockEntry(keys[i]);
+  }
+
+  int64_t num_inserted = 0;
+  {
+    shared_lock<rw_spinlock> l(lock_.get_lock());
+
+    // Order the keys by bucket so that each bucket lock is taken once per
+    // batch. Only one bucket lock is ever held at a time, so the order
+    // matters only for locality, not for correctness.
+    vector<size_t> order(n);
+    for (size_t i = 0; i < n; i++) {
+      order[i] = i;
+    }
+    const uint64_t mask = mask_;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return (new_entries[a]->key_hash_ & mask) < (new_entries[b]->key_hash_ & mask);
+      });
+
+    size_t i = 0;
+    while (i < n) {
+      Bucket *bucket = FindBucket(new_entries[order[i]]->key_hash_);
+      std::lock_guard<simple_spinlock> bucket_lock(bucket->lock);
+      for (; i < n && FindBucket(new_entries[order[i]]->key_hash_) == bucket; i++) {
+        LockEntry* new_entry = new_entries[order[i]];
+        LockEntry **node = FindSlot(bucket, new_entry->key_, new_entry->key_hash_);
+        if (*node != nullptr) {
+          (*node)->refs_++;
+          (*entries)[order[i]] = *node;
+        } else {
+          new_entry->ht_next_ = nullptr;
+          new_entry->CopyKey();
+          *node = new_entry;
+          (*entries)[order[i]] = new_entry;
+          num_inserted++;
+        }
+      }
+    }
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    if ((*entries)[i] != new_entries[i]) {
+      delete new_entries[i];
+    }
+  }
+
+  if (num_inserted > 0) {
+    AddItemsAndMaybeResize(num_inserted);
+  }
+}
+
+void LockTable::AddItemsAndMaybeResize(int64_t delta) {
+  if (base::subtle::NoBarrier_AtomicIncrement(&item_count_, delta) > size_) {
     std::unique_lock<percpu_rwlock> table_wrlock(lock_, std::try_to_lock);
     // if we can't take the lock, means that someone else is resizing.
     // (The percpu_rwlock try_lock waits for readers to complete)
@@ -195,8 +272,6 @@ LockEntry *LockTable::GetLockEntry(const Slice& key) {
       Resize();
     }
   }
-
-  return new_entry;
 }
 
 void LockTable::ReleaseLockEntry(LockEntry *entry) {
@@ -280,6 +355,16 @@ ScopedRowLock::ScopedRowLock(LockManager *manager,
   }
 }
 
+ScopedRowLock::ScopedRowLock(LockManager* manager,
+                             LockEntry* entry,
+                             LockManager::LockStatus ls)
+  : manager_(DCHECK_NOTNULL(manager)),
+    acquired_(ls == LockManager::LOCK_ACQUIRED),
+    entry_(DCHECK_NOTNULL(entry)),
+    ls_(ls) {
+  CHECK_NE(ls_, LockManager::LOCK_BUSY);
+}
+
 ScopedRowLock::ScopedRowLock(ScopedRowLock&& other) {
   TakeState(&other);
 }
@@ -328,11 +413,46 @@ LockManager::LockStatus LockManager::Lock(const Slice& key,
                                           LockManager::LockMode mode,
                                           LockEntry** entry) {
   *entry = locks_->GetLockEntry(key);
+  return AcquireEntry(key, tx, *entry);
+}
+
+void LockManager::LockBatch(const vector<Slice>& keys,
+                            const TransactionState* tx,
+                            LockManager::LockMode mode,
+                            vector<ScopedRowLock>* locks) {
+  vector<LockEntry*> entries;
+  locks_->GetLockEntries(keys, &entries);
+
+  // Acquire the row locks in a canonical order. Every entry we hold a
+  // reference to stays at a fixed address until released, so ordering by
+  // entry address is consistent across all concurrent batches that share
+  // an entry, which rules out lock-order inversions between them.
+  vector<size_t> order(entries.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return entries[a] < entries[b];
+    });
+
+  vector<LockStatus> statuses(entries.size());
+  for (size_t idx : order) {
+    statuses[idx] = AcquireEntry(keys[idx], tx, entries[idx]);
+  }
 
+  locks->reserve(locks->size() + entries.size());
+  for (size_t i = 0; i < entries.size(); i++) {
+    locks->push_back(ScopedRowLock(this, entries[i], statuses[i]));
+  }
+}
+
+LockManager::LockStatus LockManager::AcquireEntry(const Slice& key,
+                                                  const TransactionState* tx,
+                                                  LockEntry* entry) {
   // We expect low contention, so just try to try_lock first. This is faster
   // than a timed_lock, since we don't have to do a syscall to get the current
   // time.
-  if (!(*entry)->sem.TryAcquire()) {
+  if (!entry->sem.TryAcquire()) {
     // If the current holder of this lock is the same transaction just return
     // a LOCK_ALREADY_ACQUIRED status without actually acquiring the mutex.
     //
@@ -342,8 +462,8 @@ LockManager::LockStatus LockManager::Lock(const Slice& key,
     // obtained and released at the same time). If at any time in the future
     // we opt to perform more fine grained locking, possibly letting transactions
     // release a portion of the locks they no longer need, this no longer is OK.
-    if (ANNOTATE_UNPROTECTED_READ((*entry)->holder_) == tx) {
-      (*entry)->recursion_++;
+    if (ANNOTATE_UNPROTECTED_READ(entry->holder_) == tx) {
+      entry->recursion_++;
       return LOCK_ACQUIRED;
     }
 
@@ -354,8 +474,8 @@ LockManager::LockStatus LockManager::Lock(const Slice& key,
     TRACE_COUNTER_INCREMENT("row_lock_wait_count", 1);
     MicrosecondsInt64 start_wait_us = GetMonoTimeMicros();
     int waited_seconds = 0;
-    while (!(*entry)->sem.TimedAcquire(MonoDelta::FromSeconds(1))) {
-      const TransactionState* cur_holder = ANNOTATE_UNPROTECTED_READ((*entry)->holder_);
+    while (!entry->sem.TimedAcquire(MonoDelta::FromSeconds(1))) {
+      const TransactionState* cur_holder = ANNOTATE_UNPROTECTED_READ(entry->holder_);
       LOG(WARNING) << "Waited " << (++waited_seconds) << " seconds to obtain row lock on key "
                    << key.ToDebugString() << " cur holder: " << cur_holder;
       // TODO: would be nice to also include some info about the blocking transaction,
@@ -369,7 +489,7 @@ LockManager::LockStatus LockManager::Lock(const Slice& key,
     }
   }
 
-  (*entry)->holder_ = tx;
+  entry->holder_ = tx;
   return LOCK_ACQUIRED;
 }
 
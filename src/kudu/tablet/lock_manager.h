@@ -17,6 +17,8 @@
 #ifndef KUDU_TABLET_LOCK_MANAGER_H
 #define KUDU_TABLET_LOCK_MANAGER_H
 
+#include <vector>
+
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/move.h"
 #include "kudu/util/slice.h"
@@ -26,6 +28,7 @@ namespace kudu { namespace tablet {
 class LockManager;
 class LockTable;
 class LockEntry;
+class ScopedRowLock;
 class TransactionState;
 
 // Super-simple lock manager implementation. This only supports exclusive
@@ -49,6 +52,20 @@ class LockManager {
     LOCK_EXCLUSIVE
   };
 
+  // Lock all of the rows in 'keys' on behalf of 'tx', appending one
+  // lock holder per key (in the same order as 'keys') to 'locks'.
+  //
+  // The keys are hashed up front and grouped by hash table bucket, so each
+  // bucket is visited once regardless of how many keys map to it. The row
+  // locks themselves are then acquired in a canonical order, so two batches
+  // with overlapping keys can never deadlock against each other. Duplicate
+  // keys within a batch are allowed and are treated as a recursive acquisition.
+  //
+  // As with the ScopedRowLock constructor, the key slices must remain valid
+  // and un-changed for the lifetime of the returned lock holders.
+  void LockBatch(const std::vector<Slice>& keys, const TransactionState* tx,
+                 LockMode mode, std::vector<ScopedRowLock>* locks);
+
  private:
   friend class ScopedRowLock;
   friend class LockManagerTest;
@@ -57,6 +74,10 @@ class LockManager {
                   LockMode mode, LockEntry **entry);
   LockStatus TryLock(const Slice& key, const TransactionState* tx,
                      LockMode mode, LockEntry **entry);
+
+  // Acquire the semaphore of an entry already obtained from the lock table,
+  // waiting if necessary. 'key' is used only for logging.
+  LockStatus AcquireEntry(const Slice& key, const TransactionState* tx, LockEntry* entry);
   void Release(LockEntry *lock, LockStatus ls);
 
   LockTable *locks_;
@@ -116,6 +137,11 @@ class ScopedRowLock {
   ~ScopedRowLock();
 
  private:
+  friend class LockManager;
+
+  // Adopt an entry which was already locked by LockManager::LockBatch().
+  ScopedRowLock(LockManager* manager, LockEntry* entry, LockManager::LockStatus ls);
+
   void TakeState(ScopedRowLock* other);
 
   LockManager *manager_;
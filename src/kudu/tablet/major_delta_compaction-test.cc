@@ -33,6 +33,8 @@
 #include "kudu/tablet/diskrowset-test-base.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_double(tablet_delta_store_major_compact_min_ratio);
+
 using std::shared_ptr;
 using std::unordered_set;
 
@@ -345,6 +347,91 @@ TEST_F(TestMajorDeltaCompaction, TestReinserts) {
   ASSERT_NO_FATAL_FAILURE(VerifyDataWithMvccAndExpectedState(second_batch_inserts, old_state));
 }
 
+// Verify that deltas can be flushed while a major delta compaction runs, and
+// that a major delta compaction whose input stores were compacted away in the
+// meantime is aborted without losing any data.
+TEST_F(TestMajorDeltaCompaction, TestDeltaFlushDuringMajorCompaction) {
+  const int kNumRows = 100;
+  NO_FATALS(WriteTestTablet(kNumRows));
+  ASSERT_OK(tablet()->Flush());
+
+  vector<shared_ptr<RowSet> > all_rowsets;
+  tablet()->GetRowSetsForTests(&all_rowsets);
+  DiskRowSet* drs = down_cast<DiskRowSet*>(all_rowsets.front().get());
+  vector<ColumnId> col_ids_to_compact = { schema_.column_id(1),
+                                          schema_.column_id(3) };
+
+  NO_FATALS(UpdateRows(kNumRows, false));
+  ASSERT_OK(tablet()->FlushBiggestDMS());
+
+  // Start a compaction, then flush more updates into a newer REDO store before
+  // it's committed.
+  gscoped_ptr<MajorDeltaCompaction> compaction;
+  ASSERT_OK(drs->NewMajorDeltaCompaction(col_ids_to_compact, tablet()->GetHistoryGcOpts(),
+                                         &compaction));
+  NO_FATALS(UpdateRows(kNumRows, true));
+  ASSERT_OK(tablet()->FlushBiggestDMS());
+  ASSERT_OK(compaction->Compact());
+  ASSERT_OK(drs->CommitMajorDeltaCompaction(compaction.get()));
+  NO_FATALS(VerifyData());
+
+  // This time, minor compact the REDO stores that the compaction reads
+  // before it's committed.
+  NO_FATALS(UpdateRows(kNumRows, false));
+  ASSERT_OK(tablet()->FlushBiggestDMS());
+  ASSERT_GT(drs->CountDeltaStores(), 1);
+  ASSERT_OK(drs->NewMajorDeltaCompaction(col_ids_to_compact, tablet()->GetHistoryGcOpts(),
+                                         &compaction));
+  ASSERT_OK(drs->MinorCompactDeltaStores());
+  ASSERT_OK(compaction->Compact());
+  Status s = drs->CommitMajorDeltaCompaction(compaction.get());
+  ASSERT_TRUE(s.IsAborted()) << s.ToString();
+  NO_FATALS(VerifyData());
+}
+
+// Verify that only the columns with a large enough share of the deltas are
+// picked for major compaction, worst first.
+TEST_F(TestMajorDeltaCompaction, TestColumnsToMajorCompact) {
+  const int kNumRows = 1000;
+  NO_FATALS(WriteTestTablet(kNumRows));
+  ASSERT_OK(tablet()->Flush());
+
+  vector<shared_ptr<RowSet> > all_rowsets;
+  tablet()->GetRowSetsForTests(&all_rowsets);
+  DiskRowSet* drs = down_cast<DiskRowSet*>(all_rowsets.front().get());
+
+  // Update 'val1' in every row, and 'val2' in one row only.
+  {
+    LocalTabletWriter writer(tablet().get(), &client_schema_);
+    KuduPartialRow prow(&client_schema_);
+    for (int idx = 0; idx < kNumRows; idx++) {
+      ExpectedRow* row = &expected_state_[idx];
+      CHECK_OK(prow.SetStringNoCopy(0, row->key));
+      row->val1++;
+      CHECK_OK(prow.SetInt32(1, row->val1));
+      CHECK_OK(prow.Unset(2));
+      if (idx == 0) {
+        row->val2.append("[U]");
+        CHECK_OK(prow.SetStringNoCopy(2, row->val2));
+      }
+      ASSERT_OK(writer.Update(prow));
+    }
+  }
+  ASSERT_OK(tablet()->FlushBiggestDMS());
+
+  vector<ColumnId> col_ids;
+  drs->GetColumnIdsToMajorCompact(&col_ids);
+  ASSERT_EQ(vector<ColumnId>({ schema_.column_id(1) }), col_ids);
+
+  // With no minimum ratio, both updated columns qualify, worst first.
+  FLAGS_tablet_delta_store_major_compact_min_ratio = 0;
+  drs->GetColumnIdsToMajorCompact(&col_ids);
+  ASSERT_EQ(vector<ColumnId>({ schema_.column_id(1), schema_.column_id(2) }), col_ids);
+
+  ASSERT_OK(drs->MajorCompactDeltaStores(tablet()->GetHistoryGcOpts()));
+  NO_FATALS(VerifyData());
+}
+
 // Verify that we won't schedule a major compaction when files are just composed of deletes.
 TEST_F(TestMajorDeltaCompaction, TestJustDeletes) {
   const int kNumRows = 100;
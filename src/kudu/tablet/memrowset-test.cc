@@ -19,6 +19,8 @@
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
+#include "kudu/codegen/compilation_manager.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/row.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/consensus/log_anchor_registry.h"
@@ -30,6 +32,7 @@
 #include "kudu/util/test_macros.h"
 
 DECLARE_bool(enable_data_block_fsync);
+DECLARE_int32(memrowset_key_filter_kb);
 DEFINE_int32(roundtrip_num_rows, 10000,
              "Number of rows to use for the round-trip test");
 DEFINE_int32(num_scan_passes, 1,
@@ -300,6 +303,37 @@ TEST_F(TestMemRowSet, TestInsertDuplicate) {
   ASSERT_TRUE(s.IsAlreadyPresent()) << "bad status: " << s.ToString();
 }
 
+// Test that the key filter holds every inserted key, and few others.
+TEST_F(TestMemRowSet, TestKeyFilter) {
+  const int kNumRows = 1000;
+  shared_ptr<MemRowSet> mrs(new MemRowSet(0, schema_, log_anchor_registry_.get()));
+  ASSERT_OK(InsertRows(mrs.get(), kNumRows));
+  ASSERT_TRUE(mrs->key_filter_selective());
+
+  int num_positives = 0;
+  char keybuf[256];
+  for (int i = 0; i < kNumRows * 2; i++) {
+    snprintf(keybuf, sizeof(keybuf), "hello %d", i);
+    RowBuilder rb(key_schema_);
+    rb.AddString(Slice(keybuf));
+    RowSetKeyProbe probe(rb.row());
+    if (i < kNumRows) {
+      ASSERT_TRUE(mrs->MayContainKey(probe)) << keybuf;
+    } else if (mrs->MayContainKey(probe)) {
+      num_positives++;
+    }
+  }
+  ASSERT_LT(num_positives, kNumRows / 20);
+
+  // Without the filter, every key may be present.
+  FLAGS_memrowset_key_filter_kb = 0;
+  shared_ptr<MemRowSet> unfiltered(new MemRowSet(1, schema_, log_anchor_registry_.get()));
+  ASSERT_FALSE(unfiltered->key_filter_selective());
+  RowBuilder rb(key_schema_);
+  rb.AddString(Slice("missing"));
+  ASSERT_TRUE(unfiltered->MayContainKey(RowSetKeyProbe(rb.row())));
+}
+
 // Test for updating rows in memrowset
 TEST_F(TestMemRowSet, TestUpdate) {
   shared_ptr<MemRowSet> mrs(new MemRowSet(0, schema_, log_anchor_registry_.get()));
@@ -439,6 +473,45 @@ TEST_F(TestMemRowSet, TestMemRowSetInsertCountAndScan) {
     }
   }
 }
+// Test that the iterator evaluates pushed-down predicates itself, both before
+// and after its predicate evaluator has been code-generated.
+TEST_F(TestMemRowSet, TestScanWithPredicates) {
+  shared_ptr<MemRowSet> mrs(new MemRowSet(0, schema_, log_anchor_registry_.get()));
+  const int kNumRows = 1000;
+  ASSERT_OK(InsertRows(mrs.get(), kNumRows));
+  MvccSnapshot snap(Timestamp(kNumRows + 1));
+
+  const uint32_t lower = 100;
+  const uint32_t upper = 300;
+  for (int pass = 0; pass < 2; pass++) {
+    ScanSpec spec;
+    spec.AddPredicate(ColumnPredicate::Range(schema_.column(1), &lower, &upper));
+    gscoped_ptr<MemRowSet::Iterator> iter(mrs->NewIterator(&schema_, snap));
+    ASSERT_OK(iter->Init(&spec));
+    ASSERT_TRUE(spec.predicates().empty());
+
+    Arena arena(1024, 256*1024);
+    RowBlock block(schema_, 100, &arena);
+    int selected = 0;
+    while (iter->HasNext()) {
+      ASSERT_OK(iter->NextBlock(&block));
+      for (size_t i = 0; i < block.nrows(); i++) {
+        if (block.selection_vector()->IsRowSelected(i)) {
+          uint32_t val = *schema_.ExtractColumnFromRow<UINT32>(block.row(i), 1);
+          ASSERT_GE(val, lower);
+          ASSERT_LT(val, upper);
+          selected++;
+        }
+      }
+    }
+    ASSERT_EQ(static_cast<int>(upper - lower), selected);
+
+    // Let the compilation kicked off by the first scan finish, so the
+    // second scan uses the generated code from the start.
+    codegen::CompilationManager::GetSingleton()->Wait();
+  }
+}
+
 // Test that scanning at past MVCC snapshots will hide rows which are
 // not committed in that snapshot.
 TEST_F(TestMemRowSet, TestInsertionMVCC) {
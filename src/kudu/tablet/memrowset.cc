@@ -17,20 +17,27 @@
 
 #include "kudu/tablet/memrowset.h"
 
+#include <algorithm>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
+#include <sched.h>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "kudu/codegen/compilation_manager.h"
+#include "kudu/codegen/predicate_evaluator.h"
 #include "kudu/codegen/row_projector.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/common.pb.h"
 #include "kudu/common/generic_iterators.h"
 #include "kudu/common/row.h"
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/consensus/log_anchor_registry.h"
 #include "kudu/gutil/dynamic_annotations.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/tablet/compaction.h"
+#include "kudu/util/bloom_filter.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/memory/overwrite.h"
@@ -39,8 +46,19 @@ DEFINE_bool(mrs_use_codegen, true, "whether the memrowset should use code "
             "generation for iteration");
 TAG_FLAG(mrs_use_codegen, hidden);
 
+DEFINE_int32(memrowset_key_filter_kb, 64,
+             "Size of the filter of the keys inserted into each MemRowSet. Upserts "
+             "and duplicate inserts of keys found in the filter are looked up in the "
+             "MemRowSet first, skipping the bloom filters of the flushed rowsets, "
+             "while updates of keys missing from it skip the MemRowSet. Keys beyond "
+             "about one per byte of the filter make it less selective. 0 disables "
+             "the filter.");
+TAG_FLAG(memrowset_key_filter_kb, advanced);
+TAG_FLAG(memrowset_key_filter_kb, experimental);
+
 using std::pair;
 using std::shared_ptr;
+using std::vector;
 
 namespace kudu { namespace tablet {
 
@@ -51,6 +69,10 @@ using strings::Substitute;
 static const int kInitialArenaSize = 16;
 static const int kMaxArenaBufferSize = 8*1024*1024;
 
+// While a predicate evaluator is being compiled, how many blocks an iterator
+// evaluates with the interpreted path between checks of the code cache.
+static const int kCodegenCheckIntervalBlocks = 16;
+
 bool MRSRow::IsGhost() const {
   bool is_ghost = false;
   for (const Mutation *mut = header_->redo_head;
@@ -100,14 +122,49 @@ MemRowSet::MemRowSet(int64_t id,
     has_logged_throttling_(false),
     anchorer_(log_anchor_registry, Substitute("MemRowSet-$0", id_)) {
   CHECK(schema.has_column_ids());
+  int num_row_arenas = base::MaxCPUIndex() + 1;
+  CHECK_GT(num_row_arenas, 0);
+  row_arenas_.reserve(num_row_arenas);
+  for (int i = 0; i < num_row_arenas; i++) {
+    row_arenas_.emplace_back(new ThreadSafeMemoryTrackingArena(
+        kInitialArenaSize, kMaxArenaBufferSize, allocator_));
+  }
+  if (FLAGS_memrowset_key_filter_kb > 0) {
+    key_filter_.reset(new ConcurrentBloomFilter(FLAGS_memrowset_key_filter_kb * 1024));
+    mem_tracker_->Consume(key_filter_->n_bytes());
+  }
   ANNOTATE_BENIGN_RACE(&debug_insert_count_, "insert count isnt accurate");
   ANNOTATE_BENIGN_RACE(&debug_update_count_, "update count isnt accurate");
 }
 
 MemRowSet::~MemRowSet() {
+  if (key_filter_) {
+    mem_tracker_->Release(key_filter_->n_bytes());
+  }
   mem_tracker_->UnregisterFromParent();
 }
 
+size_t MemRowSet::memory_footprint() const {
+  size_t footprint = arena_->memory_footprint();
+  for (const auto& row_arena : row_arenas_) {
+    footprint += row_arena->memory_footprint();
+  }
+  return footprint;
+}
+
+ThreadSafeMemoryTrackingArena* MemRowSet::RowArena() {
+#if defined(__APPLE__)
+  // OSX doesn't have a way to get the CPU, so all threads share one arena.
+  int cpu = 0;
+#else
+  int cpu = sched_getcpu();
+  if (PREDICT_FALSE(cpu < 0)) {
+    cpu = 0;
+  }
+#endif  // defined(__APPLE__)
+  return row_arenas_[cpu % row_arenas_.size()].get();
+}
+
 Status MemRowSet::DebugDump(vector<string> *lines) {
   gscoped_ptr<Iterator> iter(NewIterator());
   RETURN_NOT_OK(iter->Init(NULL));
@@ -136,6 +193,12 @@ Status MemRowSet::Insert(Timestamp timestamp,
     schema_.EncodeComparableKey(row, &enc_key_buf);
     Slice enc_key(enc_key_buf);
 
+    // Add the key before inserting it, so that anyone who finds the row in
+    // the tree also finds its key in the filter.
+    if (key_filter_) {
+      key_filter_->AddKey(BloomKeyProbe(enc_key));
+    }
+
     btree::PreparedMutation<MSBTreeTraits> mutation(enc_key);
     mutation.Prepare(&tree_);
 
@@ -156,14 +219,46 @@ Status MemRowSet::Insert(Timestamp timestamp,
       return Reinsert(timestamp, row, &ms_row);
     }
 
-    // Copy the non-encoded key onto the stack since we need
-    // to mutate it when we relocate its Slices into our arena.
-    DEFINE_MRSROW_ON_STACK(this, mrsrow, mrsrow_slice);
+    // Lay out the row header, the row and all of its indirect data in a
+    // single allocation from this CPU's row arena, which the tree then adopts
+    // as the value. This copies the row and each of its strings exactly
+    // once, instead of staging the row on the stack, relocating each string
+    // separately, and having the tree copy the staged row again.
+    const size_t row_size = ContiguousRowHelper::row_size(schema_);
+    const size_t val_size = sizeof(MRSRow::Header) + row_size;
+    size_t indirect_size = 0;
+    for (int i = 0; i < schema_.num_columns(); i++) {
+      const ColumnSchema& col = schema_.column(i);
+      if (col.type_info()->physical_type() == BINARY &&
+          !(col.is_nullable() && row.is_null(i))) {
+        indirect_size += reinterpret_cast<const Slice*>(row.cell_ptr(i))->size();
+      }
+    }
+    uint8_t* val = btree::ValueSlice::Allocate(val_size, indirect_size, RowArena());
+    if (PREDICT_FALSE(val == nullptr)) {
+      return Status::IOError("Unable to allocate row in MemRowSet arena");
+    }
+
+    Slice mrsrow_slice(val, val_size);
+    MRSRow mrsrow(this, mrsrow_slice);
     mrsrow.header_->insertion_timestamp = timestamp;
     mrsrow.header_->redo_head = nullptr;
-    RETURN_NOT_OK(mrsrow.CopyRow(row, arena_.get()));
+    memcpy(mrsrow.row_slice_.mutable_data(), row.row_data(), row_size);
+
+    uint8_t* indirect = val + val_size;
+    for (int i = 0; i < schema_.num_columns(); i++) {
+      const ColumnSchema& col = schema_.column(i);
+      if (col.type_info()->physical_type() == BINARY &&
+          !(col.is_nullable() && mrsrow.is_null(i))) {
+        Slice* cell = reinterpret_cast<Slice*>(mrsrow.mutable_cell_ptr(i));
+        memcpy(indirect, cell->data(), cell->size());
+        *cell = Slice(indirect, cell->size());
+        indirect += cell->size();
+      }
+    }
+    DCHECK_EQ(val + val_size + indirect_size, indirect);
 
-    CHECK(mutation.Insert(mrsrow_slice))
+    CHECK(mutation.InsertPreallocated(mrsrow_slice))
     << "Expected to be able to insert, since the prepared mutation "
     << "succeeded!";
   }
@@ -184,7 +279,7 @@ Status MemRowSet::Reinsert(Timestamp timestamp, const ConstContiguousRow& row, M
   // Make a copy of the row, and relocate any of its indirected data into
   // our Arena.
   DEFINE_MRSROW_ON_STACK(this, row_copy, row_copy_slice);
-  RETURN_NOT_OK(row_copy.CopyRow(row, arena_.get()));
+  RETURN_NOT_OK(row_copy.CopyRow(row, RowArena()));
 
   // Encode the REINSERT mutation from the relocated row copy.
   faststring buf;
@@ -192,7 +287,7 @@ Status MemRowSet::Reinsert(Timestamp timestamp, const ConstContiguousRow& row, M
   encoder.SetToReinsert(row_copy.row_slice());
 
   // Move the REINSERT mutation itself into our Arena.
-  Mutation *mut = Mutation::CreateInArena(arena_.get(), timestamp, encoder.as_changelist());
+  Mutation *mut = Mutation::CreateInArena(RowArena(), timestamp, encoder.as_changelist());
 
   // Append the mutation into the row's mutation list.
   // This function has "release" semantics which ensures that the memory writes
@@ -226,7 +321,7 @@ Status MemRowSet::MutateRow(Timestamp timestamp,
     }
 
     // Append to the linked list of mutations for this row.
-    Mutation *mut = Mutation::CreateInArena(arena_.get(), timestamp, delta);
+    Mutation *mut = Mutation::CreateInArena(RowArena(), timestamp, delta);
 
     // This function has "release" semantics which ensures that the memory writes
     // for the mutation are fully published before any concurrent reader sees
@@ -244,6 +339,16 @@ Status MemRowSet::MutateRow(Timestamp timestamp,
   return Status::OK();
 }
 
+bool MemRowSet::MayContainKey(const RowSetKeyProbe &probe) const {
+  return !key_filter_ || key_filter_->MayContainKey(probe.bloom_probe());
+}
+
+bool MemRowSet::key_filter_selective() const {
+  // With about eight bits per key, the filter's false positive rate is a few
+  // percent. It rises quickly past that.
+  return key_filter_ && debug_insert_count_ <= key_filter_->n_bytes();
+}
+
 Status MemRowSet::CheckRowPresent(const RowSetKeyProbe &probe, bool *present,
                                   ProbeStats* stats) const {
   // Use a PreparedMutation here even though we don't plan to mutate. Even though
@@ -303,6 +408,40 @@ Status MemRowSet::GetBounds(string *min_encoded_key,
   return Status::NotSupported("");
 }
 
+Status MemRowSet::CountVisibleRows(const MvccSnapshot& snap, int64_t* count,
+                                   bool* counted) const {
+  gscoped_ptr<MSBTIter> iter(tree_.NewIterator());
+  int64_t visible = 0;
+  for (bool valid = iter->SeekToStart(); valid; valid = iter->Next()) {
+    Slice k, v;
+    iter->GetCurrentEntry(&k, &v);
+    MRSRow row(this, v);
+    if (!snap.IsCommitted(row.insertion_timestamp())) {
+      continue;
+    }
+    // Like the iterator, roll the row's deletions forward to the snapshot.
+    bool is_deleted = false;
+    for (const Mutation* mut = row.acquire_redo_head();
+         mut != nullptr;
+         mut = mut->acquire_next()) {
+      if (!snap.IsCommitted(mut->timestamp())) {
+        continue;
+      }
+      RowChangeListDecoder decoder(mut->changelist());
+      RETURN_NOT_OK(decoder.Init());
+      if (decoder.is_delete() || decoder.is_reinsert()) {
+        decoder.TwiddleDeleteStatus(&is_deleted);
+      }
+    }
+    if (!is_deleted) {
+      visible++;
+    }
+  }
+  *count = visible;
+  *counted = true;
+  return Status::OK();
+}
+
 // Virtual interface allows two possible row projector implementations
 class MemRowSet::Iterator::MRSRowProjector {
  public:
@@ -380,7 +519,9 @@ MemRowSet::Iterator::Iterator(const std::shared_ptr<const MemRowSet>& mrs,
       projector_(
           GenerateAppropriateProjector(&mrs->schema_nonvirtual(), projection)),
       delta_projector_(&mrs->schema_nonvirtual(), projection),
-      state_(kUninitialized) {
+      rows_read_(0),
+      state_(kUninitialized),
+      blocks_until_codegen_check_(0) {
   // TODO: various code assumes that a newly constructed iterator
   // is pointed at the beginning of the dataset. This causes a redundant
   // seek. Could make this lazy instead, or change the semantics so that
@@ -412,10 +553,74 @@ Status MemRowSet::Iterator::Init(ScanSpec *spec) {
     exclusive_upper_bound_.reset(upper_bound);
   }
 
+  if (spec && FLAGS_mrs_use_codegen) {
+    MaybeTakePredicates(spec);
+  }
+
+  if (spec) {
+    sample_ = spec->sample();
+    sampling_stats_ = spec->sampling_stats();
+  }
+
   state_ = kScanning;
   return Status::OK();
 }
 
+void MemRowSet::Iterator::MaybeTakePredicates(ScanSpec* spec) {
+  if (spec->predicates().empty()) {
+    return;
+  }
+
+  vector<ColumnPredicate> predicates;
+  predicates.reserve(spec->predicates().size());
+  for (const auto& predicate : spec->predicates()) {
+    predicates.push_back(predicate.second);
+  }
+  // Evaluate the most selective predicates first, as the
+  // PredicateEvaluatingIterator would.
+  std::sort(predicates.begin(), predicates.end(), SelectivityComparator);
+
+  // Leave the spec alone if the predicates can't be code-generated; the
+  // iterator wrapping this one will evaluate them.
+  vector<codegen::PredicateShape> shapes;
+  if (!codegen::PredicateEvaluatorFunctions::BuildShapes(*projection_, predicates, &shapes).ok()) {
+    return;
+  }
+
+  predicate_col_idxs_.clear();
+  for (const codegen::PredicateShape& shape : shapes) {
+    predicate_col_idxs_.push_back(shape.col_idx);
+  }
+  predicates_ = std::move(predicates);
+  spec->RemovePredicates();
+
+  // Kick off the compilation now; until it's done the predicates are
+  // evaluated one at a time.
+  codegen::CompilationManager::GetSingleton()->RequestPredicateEvaluator(
+      projection_, predicates_, &codegen_evaluator_);
+  blocks_until_codegen_check_ = kCodegenCheckIntervalBlocks;
+}
+
+void MemRowSet::Iterator::EvaluatePredicates(RowBlock* dst) {
+  if (!codegen_evaluator_ && --blocks_until_codegen_check_ <= 0) {
+    codegen::CompilationManager::GetSingleton()->RequestPredicateEvaluator(
+        projection_, predicates_, &codegen_evaluator_);
+    blocks_until_codegen_check_ = kCodegenCheckIntervalBlocks;
+  }
+
+  if (codegen_evaluator_) {
+    codegen_evaluator_->Evaluate(dst);
+    return;
+  }
+
+  for (size_t i = 0; i < predicates_.size(); i++) {
+    predicates_[i].Evaluate(dst->column_block(predicate_col_idxs_[i]), dst->selection_vector());
+    if (!dst->selection_vector()->AnySelected()) {
+      break;
+    }
+  }
+}
+
 Status MemRowSet::Iterator::SeekAtOrAfter(const Slice &key, bool *exact) {
   DCHECK_NE(state_, kUninitialized) << "not initted";
 
@@ -465,15 +670,22 @@ Status MemRowSet::Iterator::NextBlock(RowBlock *dst) {
   RETURN_NOT_OK(FetchRows(dst, &fetched));
   DCHECK_LE(0, fetched);
   DCHECK_LE(fetched, dst->nrows());
+  rows_read_ += fetched;
 
   // Clear unreached bits by resizing
   dst->Resize(fetched);
 
+  if (!predicates_.empty()) {
+    EvaluatePredicates(dst);
+  }
+
   return Status::OK();
 }
 
 Status MemRowSet::Iterator::FetchRows(RowBlock* dst, size_t* fetched) {
   *fetched = 0;
+  int64_t considered = 0;
+  int64_t sampled = 0;
   do {
     Slice k, v;
     RowBlockRow dst_row = dst->row(*fetched);
@@ -490,6 +702,16 @@ Status MemRowSet::Iterator::FetchRows(RowBlock* dst, size_t* fetched) {
         state_ = kFinished;
         break;
       } else {
+        if (sample_.is_sampled()) {
+          considered++;
+          if (!sample_.Samples(k)) {
+            // Unsampled rows are left unselected, like uncommitted ones.
+            dst->selection_vector()->SetRowUnselected(*fetched);
+            ++*fetched;
+            continue;
+          }
+          sampled++;
+        }
         RETURN_NOT_OK(projector_->ProjectRowForRead(row, &dst_row, dst->arena()));
 
         Mutation* redo_head = reinterpret_cast<Mutation*>(
@@ -515,6 +737,10 @@ Status MemRowSet::Iterator::FetchRows(RowBlock* dst, size_t* fetched) {
     ++*fetched;
   } while (iter_->Next() && *fetched < dst->nrows());
 
+  if (sample_.is_sampled() && sampling_stats_) {
+    sampling_stats_->rows_considered += considered;
+    sampling_stats_->rows_sampled += sampled;
+  }
   return Status::OK();
 }
 
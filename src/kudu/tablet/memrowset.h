@@ -37,8 +37,13 @@
 
 namespace kudu {
 
+class ConcurrentBloomFilter;
 class MemTracker;
 
+namespace codegen {
+class PredicateEvaluator;
+} // namespace codegen
+
 namespace tablet {
 
 //
@@ -54,7 +59,10 @@ namespace tablet {
 // lexicographic comparator. The value for each row is an instance of MRSRow.
 //
 // NOTE: all allocations done by the MemRowSet are done inside its associated
-// thread-safe arena, and then freed in bulk when the MemRowSet is destructed.
+// thread-safe arenas, and then freed in bulk when the MemRowSet is destructed.
+// The tree's nodes are allocated from one arena, while the rows and their
+// mutations are allocated from per-CPU arenas, so that concurrent writers
+// don't contend on a single arena.
 
 class MemRowSet;
 
@@ -227,6 +235,11 @@ class MemRowSet : public RowSet,
     return Status::OK();
   }
 
+  // Counts the rows by walking the tree, checking whether each is visible
+  // and not deleted in 'snap' without projecting it. Always sets 'counted'.
+  Status CountVisibleRows(const MvccSnapshot& snap, int64_t* count,
+                          bool* counted) const OVERRIDE;
+
   virtual Status GetBounds(std::string *min_encoded_key,
                            std::string *max_encoded_key) const OVERRIDE;
 
@@ -234,6 +247,26 @@ class MemRowSet : public RowSet,
     return 0;
   }
 
+  Status GetColumnStatistics(const Schema& schema, int col_idx,
+                             ColumnStatisticsPB* stats) const OVERRIDE {
+    return Status::NotFound("MemRowSet does not keep column statistics");
+  }
+
+  Status GetKeySamples(int num_samples, std::vector<std::string>* keys) const OVERRIDE {
+    return Status::OK();
+  }
+
+  bool GetCachedChecksum(const Schema& projection, const MvccSnapshot& snap,
+                         uint64_t* checksum, int64_t* num_rows) const OVERRIDE {
+    return false;
+  }
+
+  void GetHotBlocks(HotBlocksPB* hot_blocks) const OVERRIDE {}
+
+  Status WarmUpBlockCache(const HotBlocksPB& hot_blocks, int* num_loaded) OVERRIDE {
+    return Status::OK();
+  }
+
   std::mutex *compact_flush_lock() OVERRIDE {
     return &compact_flush_lock_;
   }
@@ -252,13 +285,21 @@ class MemRowSet : public RowSet,
   Status CheckRowPresent(const RowSetKeyProbe &probe, bool *present,
                          ProbeStats* stats) const OVERRIDE;
 
+  // Return false if no row with the key of 'probe' was ever inserted into
+  // this memrowset, from a filter of the inserted keys. Such a key needn't be
+  // looked up in the memrowset at all. The result is only reliable if the
+  // caller holds the row lock of the key.
+  bool MayContainKey(const RowSetKeyProbe &probe) const;
+
+  // Return true if the key filter holds few enough keys that a key which
+  // passes MayContainKey() is likely to be in the memrowset.
+  bool key_filter_selective() const;
+
   // Return the memory footprint of this memrowset.
   // Note that this may be larger than the sum of the data
   // inserted into the memrowset, due to arena and data structure
   // overhead.
-  size_t memory_footprint() const {
-    return arena_->memory_footprint();
-  }
+  size_t memory_footprint() const;
 
   // Return an iterator over the items in this memrowset.
   //
@@ -334,6 +375,28 @@ class MemRowSet : public RowSet,
     return 0;
   }
 
+  // Deleted rows are flushed away along with the MemRowSet, so they aren't
+  // tracked here.
+  int64_t CountAncientDeletedRows(Timestamp ancient_history_mark) const OVERRIDE {
+    return 0;
+  }
+
+  Status CheckAllRowsDeleted(Timestamp ancient_history_mark, bool* all_deleted) const OVERRIDE {
+    *all_deleted = false;
+    return Status::OK();
+  }
+
+  // A MemRowSet's history is garbage collected when it's flushed.
+  int64_t EstimateBytesInAncientUndoDeltas(Timestamp ancient_history_mark) const OVERRIDE {
+    return 0;
+  }
+
+  Status GCAncientUndoDeltas(Timestamp ancient_history_mark,
+                             int64_t* rewrite_budget_bytes,
+                             int64_t* bytes_reclaimed) OVERRIDE {
+    return Status::OK();
+  }
+
   Status FlushDeltas() OVERRIDE { return Status::OK(); }
 
   Status MinorCompactDeltaStores() OVERRIDE { return Status::OK(); }
@@ -349,18 +412,31 @@ class MemRowSet : public RowSet,
 
   typedef btree::CBTree<MSBTreeTraits> MSBTree;
 
+  // Return the arena for the CPU the calling thread is running on. The
+  // thread may migrate at any time, so this is only a hint for spreading
+  // allocations; the returned arena is still thread-safe.
+  ThreadSafeMemoryTrackingArena* RowArena();
+
   int64_t id_;
 
   const Schema schema_;
   std::shared_ptr<MemTracker> parent_tracker_;
   std::shared_ptr<MemTracker> mem_tracker_;
   std::shared_ptr<MemoryTrackingBufferAllocator> allocator_;
+  // Holds the tree's nodes.
   std::shared_ptr<ThreadSafeMemoryTrackingArena> arena_;
 
+  // Hold the rows and their mutations, one arena per CPU. See RowArena().
+  std::vector<std::unique_ptr<ThreadSafeMemoryTrackingArena>> row_arenas_;
+
   typedef btree::CBTreeIterator<MSBTreeTraits> MSBTIter;
 
   MSBTree tree_;
 
+  // Filter of the keys inserted into the tree, or null if disabled by
+  // --memrowset_key_filter_kb.
+  std::unique_ptr<ConcurrentBloomFilter> key_filter_;
+
   // Approximate counts of mutations. This variable is updated non-atomically,
   // so it cannot be relied upon to be in any way accurate. It's only used
   // as a sanity check during flush.
@@ -448,12 +524,14 @@ class MemRowSet::Iterator : public RowwiseIterator {
   }
 
   virtual void GetIteratorStats(std::vector<IteratorStats>* stats) const OVERRIDE {
-    // Currently we do not expose any non-disk related statistics in
-    // IteratorStats.  However, callers of GetIteratorStats expected
-    // an IteratorStats object for every column; vector::resize() is
-    // used as it will also fill the 'stats' with new instances of
-    // IteratorStats.
+    // Callers of GetIteratorStats expect an IteratorStats object for every
+    // column; vector::resize() is used as it will also fill the 'stats' with
+    // new instances of IteratorStats.
+    stats->clear();
     stats->resize(schema().num_columns());
+    for (IteratorStats& col_stats : *stats) {
+      col_stats.cells_read_from_memrowset = rows_read_;
+    }
   }
 
  private:
@@ -473,6 +551,14 @@ class MemRowSet::Iterator : public RowwiseIterator {
            MemRowSet::MSBTIter *iter, const Schema *projection,
            MvccSnapshot mvcc_snap);
 
+  // If every predicate in 'spec' can be code-generated, take them over from
+  // the spec so that this iterator evaluates them itself (see predicates_).
+  void MaybeTakePredicates(ScanSpec* spec);
+
+  // Evaluate predicates_ over 'dst', using the code-generated evaluator if
+  // it has been compiled by now.
+  void EvaluatePredicates(RowBlock* dst);
+
   // Various helper functions called while getting the next RowBlock
   Status FetchRows(RowBlock* dst, size_t* fetched);
   Status ApplyMutationsToProjectedRow(const Mutation *mutation_head,
@@ -499,6 +585,9 @@ class MemRowSet::Iterator : public RowwiseIterator {
 
   size_t prepared_count_;
 
+  // The number of rows fetched from the MemRowSet so far.
+  int64_t rows_read_;
+
   // Temporary local buffer used for seeking to hold the encoded
   // seek target.
   faststring tmp_buf;
@@ -510,6 +599,22 @@ class MemRowSet::Iterator : public RowwiseIterator {
 
   // Pushed down encoded upper bound key, if any
   boost::optional<const Slice &> exclusive_upper_bound_;
+
+  // Predicates taken over from the scan spec, in order of most to least
+  // selective, and the projection index of each predicate's column.
+  std::vector<ColumnPredicate> predicates_;
+  std::vector<size_t> predicate_col_idxs_;
+
+  // Code-generated evaluator for predicates_. Until compilation finishes
+  // this is NULL and the predicates are evaluated one by one.
+  gscoped_ptr<codegen::PredicateEvaluator> codegen_evaluator_;
+
+  // Number of blocks to evaluate before checking the code cache again.
+  int blocks_until_codegen_check_;
+
+  // The sampling of the scan. Rows are sampled one by one, by their keys.
+  ScanSample sample_;
+  std::shared_ptr<ScanSamplingStats> sampling_stats_;
 };
 
 inline const Schema* MRSRow::schema() const {
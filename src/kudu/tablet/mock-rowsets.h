@@ -62,6 +62,11 @@ class MockRowSet : public RowSet {
     LOG(FATAL) << "Unimplemented";
     return Status::OK();
   }
+  virtual Status CountVisibleRows(const MvccSnapshot& snap, int64_t* count,
+                                  bool* counted) const OVERRIDE {
+    LOG(FATAL) << "Unimplemented";
+    return Status::OK();
+  }
   virtual std::string ToString() const OVERRIDE {
     LOG(FATAL) << "Unimplemented";
     return "";
@@ -78,6 +83,27 @@ class MockRowSet : public RowSet {
     LOG(FATAL) << "Unimplemented";
     return 0;
   }
+  virtual Status GetColumnStatistics(const Schema& schema, int col_idx,
+                                     ColumnStatisticsPB* stats) const OVERRIDE {
+    LOG(FATAL) << "Unimplemented";
+    return Status::OK();
+  }
+  virtual Status GetKeySamples(int num_samples, std::vector<std::string>* keys) const OVERRIDE {
+    LOG(FATAL) << "Unimplemented";
+    return Status::OK();
+  }
+  virtual bool GetCachedChecksum(const Schema& projection, const MvccSnapshot& snap,
+                                 uint64_t* checksum, int64_t* num_rows) const OVERRIDE {
+    LOG(FATAL) << "Unimplemented";
+    return false;
+  }
+  virtual void GetHotBlocks(HotBlocksPB* hot_blocks) const OVERRIDE {
+    LOG(FATAL) << "Unimplemented";
+  }
+  virtual Status WarmUpBlockCache(const HotBlocksPB& hot_blocks, int* num_loaded) OVERRIDE {
+    LOG(FATAL) << "Unimplemented";
+    return Status::OK();
+  }
   virtual std::mutex *compact_flush_lock() OVERRIDE {
     LOG(FATAL) << "Unimplemented";
     return NULL;
@@ -107,6 +133,28 @@ class MockRowSet : public RowSet {
     return 0;
   }
 
+  virtual int64_t CountAncientDeletedRows(Timestamp ancient_history_mark) const OVERRIDE {
+    return 0;
+  }
+
+  virtual Status CheckAllRowsDeleted(Timestamp ancient_history_mark,
+                                     bool* all_deleted) const OVERRIDE {
+    LOG(FATAL) << "Unimplemented";
+    return Status::OK();
+  }
+
+  virtual int64_t EstimateBytesInAncientUndoDeltas(Timestamp ancient_history_mark)
+      const OVERRIDE {
+    return 0;
+  }
+
+  virtual Status GCAncientUndoDeltas(Timestamp ancient_history_mark,
+                                     int64_t* rewrite_budget_bytes,
+                                     int64_t* bytes_reclaimed) OVERRIDE {
+    LOG(FATAL) << "Unimplemented";
+    return Status::OK();
+  }
+
   virtual Status FlushDeltas() OVERRIDE {
     LOG(FATAL) << "Unimplemented";
     return Status::OK();
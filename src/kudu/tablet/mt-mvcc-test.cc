@@ -0,0 +1,152 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/server/logical_clock.h"
+#include "kudu/tablet/mvcc.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/stopwatch.h"
+#include "kudu/util/test_util.h"
+
+DEFINE_int32(mt_mvcc_num_writer_threads, 8,
+             "Number of threads starting and committing transactions");
+DEFINE_int32(mt_mvcc_num_snapshot_threads, 2,
+             "Number of threads taking snapshots concurrently with the writers");
+DEFINE_int32(mt_mvcc_txns_per_thread, 20000,
+             "Number of transactions each writer thread runs");
+
+using std::thread;
+using std::unique_ptr;
+using std::vector;
+
+namespace kudu {
+namespace tablet {
+
+class MultiThreadedMvccTest : public KuduTest {
+ public:
+  MultiThreadedMvccTest()
+      : clock_(server::LogicalClock::CreateStartingAt(Timestamp::kInitialTimestamp)),
+        mgr_(clock_),
+        done_(false) {
+  }
+
+ public:
+  // Runs transactions back to back, publishing the timestamp of the last
+  // one committed in 'last_committed'.
+  void WriterThread(AtomicInt<Timestamp::val_type>* last_committed, int num_txns) {
+    for (int i = 0; i < num_txns; i++) {
+      ScopedTransaction txn(&mgr_);
+      txn.StartApplying();
+      txn.Commit();
+      last_committed->Store(txn.timestamp().value(), kMemOrderRelease);
+    }
+  }
+
+  // Takes snapshots until told to stop, checking that every transaction
+  // known to have committed before a snapshot was taken is in it and that
+  // the clean time never goes backwards.
+  void SnapshotThread(const vector<unique_ptr<AtomicInt<Timestamp::val_type>>>* last_committed,
+                      int64_t* num_snapshots) {
+    Timestamp prev_clean = Timestamp::kMin;
+    vector<Timestamp::val_type> before(last_committed->size());
+    while (!done_.Load(kMemOrderAcquire)) {
+      for (int i = 0; i < last_committed->size(); i++) {
+        before[i] = (*last_committed)[i]->Load(kMemOrderAcquire);
+      }
+      MvccSnapshot snap(mgr_);
+      for (Timestamp::val_type ts : before) {
+        if (ts != 0) {
+          CHECK(snap.IsCommitted(Timestamp(ts)))
+              << ts << " committed before " << snap.ToString();
+        }
+      }
+      Timestamp clean = mgr_.GetCleanTimestamp();
+      CHECK_GE(clean.value(), prev_clean.value());
+      prev_clean = clean;
+      (*num_snapshots)++;
+    }
+  }
+
+ protected:
+  scoped_refptr<server::Clock> clock_;
+  MvccManager mgr_;
+  AtomicBool done_;
+};
+
+// Starts and commits transactions from many threads while others take
+// snapshots, and reports the throughput of both.
+TEST_F(MultiThreadedMvccTest, TestConcurrentTransactionsAndSnapshots) {
+  int num_writers = FLAGS_mt_mvcc_num_writer_threads;
+  int txns_per_thread = FLAGS_mt_mvcc_txns_per_thread;
+  if (!AllowSlowTests()) {
+    txns_per_thread = std::min(txns_per_thread, 2000);
+  }
+
+  vector<unique_ptr<AtomicInt<Timestamp::val_type>>> last_committed;
+  for (int i = 0; i < num_writers; i++) {
+    last_committed.emplace_back(new AtomicInt<Timestamp::val_type>(0));
+  }
+  vector<int64_t> num_snapshots(FLAGS_mt_mvcc_num_snapshot_threads);
+  vector<thread> snapshot_threads;
+  for (int i = 0; i < FLAGS_mt_mvcc_num_snapshot_threads; i++) {
+    snapshot_threads.emplace_back(&MultiThreadedMvccTest::SnapshotThread, this,
+                                  &last_committed, &num_snapshots[i]);
+  }
+
+  Stopwatch sw;
+  sw.start();
+  vector<thread> writer_threads;
+  for (int i = 0; i < num_writers; i++) {
+    writer_threads.emplace_back(&MultiThreadedMvccTest::WriterThread, this,
+                                last_committed[i].get(), txns_per_thread);
+  }
+  for (thread& t : writer_threads) {
+    t.join();
+  }
+  sw.stop();
+  done_.Store(true, kMemOrderRelease);
+  for (thread& t : snapshot_threads) {
+    t.join();
+  }
+
+  int64_t total_txns = static_cast<int64_t>(num_writers) * txns_per_thread;
+  int64_t total_snapshots = 0;
+  for (int64_t n : num_snapshots) {
+    total_snapshots += n;
+  }
+  double secs = sw.elapsed().wall_seconds();
+  LOG(INFO) << strings::Substitute(
+      "$0 writer threads: $1 txns in $2s ($3 txns/sec); $4 snapshots ($5 snapshots/sec)",
+      num_writers, total_txns, secs, total_txns / secs,
+      total_snapshots, total_snapshots / secs);
+
+  ASSERT_EQ(0, mgr_.CountTransactionsInFlight());
+  MvccSnapshot snap(mgr_);
+  for (const auto& ts : last_committed) {
+    ASSERT_TRUE(snap.IsCommitted(Timestamp(ts->Load())));
+  }
+}
+
+} // namespace tablet
+} // namespace kudu
@@ -105,6 +105,13 @@ class MultiThreadedTabletTest : public TabletTestBase<SETUP> {
                          inserts.get());
   }
 
+  // Inserts 'scaling_rows_per_thread_' rows which don't overlap with those of
+  // any other thread in the same round of the WriteScaling benchmark.
+  void ScalingInsertThread(int tid) {
+    this->InsertTestRows(scaling_first_row_ + tid * scaling_rows_per_thread_,
+                         scaling_rows_per_thread_, 0);
+  }
+
   void UpdateThread(int tid) {
     const Schema &schema = schema_;
 
@@ -382,6 +389,7 @@ class MultiThreadedTabletTest : public TabletTestBase<SETUP> {
     for (scoped_refptr<kudu::Thread> thr : threads_) {
      CHECK_OK(ThreadJoiner(thr.get()).Join());
     }
+    threads_.clear();
   }
 
   std::vector<scoped_refptr<kudu::Thread> > threads_;
@@ -392,6 +400,10 @@ class MultiThreadedTabletTest : public TabletTestBase<SETUP> {
   Schema valcol_projection_;
 
   TimeSeriesCollector ts_collector_;
+
+  // Row range written by the current round of ScalingInsertThread.
+  uint64_t scaling_first_row_ = 0;
+  uint64_t scaling_rows_per_thread_ = 0;
 };
 
 
@@ -431,6 +443,41 @@ TYPED_TEST(MultiThreadedTabletTest, DoTestAllAtOnce) {
   this->VerifyTestRows(0, max_rows * FLAGS_num_insert_threads);
 }
 
+// Measures how single-tablet write throughput scales with the number of
+// concurrent writers inserting disjoint keys. Each round doubles the number
+// of writers, up to --num_insert_threads.
+TYPED_TEST(MultiThreadedTabletTest, WriteScaling) {
+  int64_t rows_per_round = FLAGS_inserts_per_thread * FLAGS_num_insert_threads;
+  if (AllowSlowTests()) {
+    rows_per_round *= 10;
+  }
+  int num_rounds = 0;
+  for (int n = 1; n <= FLAGS_num_insert_threads; n *= 2) {
+    num_rounds++;
+  }
+  uint64_t max_rows = this->ClampRowCount(rows_per_round * num_rounds) / num_rounds;
+
+  uint64_t total_rows = 0;
+  for (int n_threads = 1; n_threads <= FLAGS_num_insert_threads; n_threads *= 2) {
+    this->scaling_first_row_ = total_rows;
+    this->scaling_rows_per_thread_ = max_rows / n_threads;
+
+    Stopwatch sw;
+    sw.start();
+    this->StartThreads(n_threads, &TestFixture::ScalingInsertThread);
+    this->JoinThreads();
+    sw.stop();
+
+    uint64_t rows = this->scaling_rows_per_thread_ * n_threads;
+    total_rows += rows;
+    LOG(INFO) << strings::Substitute("$0 writer thread(s): $1 rows in $2s ($3 rows/sec)",
+                                     n_threads, rows, sw.elapsed().wall_seconds(),
+                                     rows / sw.elapsed().wall_seconds());
+  }
+
+  this->VerifyTestRows(0, total_rows);
+}
+
 // Start up a bunch of threads which repeatedly insert and delete the same
 // row, while flushing and compacting. This checks various concurrent handling
 // of DELETE/REINSERT during flushes.
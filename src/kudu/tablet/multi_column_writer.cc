@@ -17,27 +17,39 @@
 
 #include "kudu/tablet/multi_column_writer.h"
 
+#include <boost/bind.hpp>
+
 #include "kudu/cfile/cfile_writer.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/fs/block_id.h"
 #include "kudu/gutil/stl_util.h"
+#include "kudu/util/threadpool.h"
 
 namespace kudu {
 namespace tablet {
 
 using cfile::CFileWriter;
+using fs::CreateBlockOptions;
 using fs::ScopedWritableBlockCloser;
 using fs::WritableBlock;
 
 MultiColumnWriter::MultiColumnWriter(FsManager* fs,
-                                     const Schema* schema)
+                                     const Schema* schema,
+                                     ThreadPool* encode_pool,
+                                     std::string tablet_id)
   : fs_(fs),
     schema_(schema),
-    finished_(false) {
+    encode_pool_(encode_pool),
+    tablet_id_(std::move(tablet_id)),
+    finished_(false),
+    in_flight_(false),
+    synced_written_size_(0) {
 }
 
 MultiColumnWriter::~MultiColumnWriter() {
+  // The tasks in flight reference the writers, so they must finish first.
+  WARN_NOT_OK(Sync(), "Failed to write the last block before destroying the writer");
   STLDeleteElements(&cfile_writers_);
 }
 
@@ -59,6 +71,10 @@ Status MultiColumnWriter::Open() {
     // the corresponding rows.
     opts.write_posidx = true;
 
+    // Summarize each data block so scans can skip the ones which cannot
+    // match their predicates.
+    opts.write_zone_map = true;
+
     /// Set the column storage attributes.
     opts.storage_attributes = col.attributes();
 
@@ -69,7 +85,7 @@ Status MultiColumnWriter::Open() {
 
     // Open file for write.
     gscoped_ptr<WritableBlock> block;
-    RETURN_NOT_OK_PREPEND(fs_->CreateNewBlock(&block),
+    RETURN_NOT_OK_PREPEND(fs_->CreateNewBlock(CreateBlockOptions::Background(tablet_id_), &block),
                           "Unable to open output file for column " + col.ToString());
     BlockId block_id(block->id());
 
@@ -91,18 +107,56 @@ Status MultiColumnWriter::Open() {
 }
 
 Status MultiColumnWriter::AppendBlock(const RowBlock& block) {
-  for (int i = 0; i < schema_->num_columns(); i++) {
-    ColumnBlock column = block.column_block(i);
-    if (column.is_nullable()) {
-      RETURN_NOT_OK(cfile_writers_[i]->AppendNullableEntries(column.null_bitmap(),
-          column.data(), column.nrows()));
-    } else {
-      RETURN_NOT_OK(cfile_writers_[i]->AppendEntries(column.data(), column.nrows()));
+  const int num_columns = schema_->num_columns();
+  if (encode_pool_ == nullptr || num_columns < 2) {
+    for (int i = 0; i < num_columns; i++) {
+      RETURN_NOT_OK(AppendColumn(block, i));
+    }
+    return Status::OK();
+  }
+
+  RETURN_NOT_OK(Sync());
+  in_flight_latch_.reset(new CountDownLatch(num_columns));
+  col_statuses_.assign(num_columns, Status::OK());
+  in_flight_ = true;
+  for (int i = 0; i < num_columns; i++) {
+    Status s = encode_pool_->SubmitFunc(
+        boost::bind(&MultiColumnWriter::AppendColumnTask, this, &block, i));
+    if (!s.ok()) {
+      // The pool is shutting down; write the column ourselves.
+      AppendColumnTask(&block, i);
     }
   }
   return Status::OK();
 }
 
+Status MultiColumnWriter::Sync() {
+  if (!in_flight_) {
+    return Status::OK();
+  }
+  in_flight_latch_->Wait();
+  in_flight_ = false;
+  synced_written_size_ = ComputeWrittenSize();
+  for (const Status& s : col_statuses_) {
+    RETURN_NOT_OK(s);
+  }
+  return Status::OK();
+}
+
+void MultiColumnWriter::AppendColumnTask(const RowBlock* block, int col_idx) {
+  col_statuses_[col_idx] = AppendColumn(*block, col_idx);
+  in_flight_latch_->CountDown();
+}
+
+Status MultiColumnWriter::AppendColumn(const RowBlock& block, int col_idx) {
+  ColumnBlock column = block.column_block(col_idx);
+  if (column.is_nullable()) {
+    return cfile_writers_[col_idx]->AppendNullableEntries(column.null_bitmap(),
+        column.data(), column.nrows());
+  }
+  return cfile_writers_[col_idx]->AppendEntries(column.data(), column.nrows());
+}
+
 Status MultiColumnWriter::Finish() {
   ScopedWritableBlockCloser closer;
   RETURN_NOT_OK(FinishAndReleaseBlocks(&closer));
@@ -111,6 +165,7 @@ Status MultiColumnWriter::Finish() {
 
 Status MultiColumnWriter::FinishAndReleaseBlocks(ScopedWritableBlockCloser* closer) {
   CHECK(!finished_);
+  RETURN_NOT_OK(Sync());
   for (int i = 0; i < schema_->num_columns(); i++) {
     CFileWriter *writer = cfile_writers_[i];
     Status s = writer->FinishAndReleaseBlock(closer);
@@ -132,7 +187,23 @@ void MultiColumnWriter::GetFlushedBlocksByColumnId(std::map<ColumnId, BlockId>*
   }
 }
 
+void MultiColumnWriter::GetColumnStatisticsByColumnId(
+    std::map<ColumnId, ColumnStatisticsPB>* ret) const {
+  CHECK(finished_);
+  ret->clear();
+  for (int i = 0; i < schema_->num_columns(); i++) {
+    cfile_writers_[i]->GetColumnStatistics(&(*ret)[schema_->column_id(i)]);
+  }
+}
+
 size_t MultiColumnWriter::written_size() const {
+  if (in_flight_) {
+    return synced_written_size_;
+  }
+  return ComputeWrittenSize();
+}
+
+size_t MultiColumnWriter::ComputeWrittenSize() const {
   size_t size = 0;
   for (const CFileWriter *writer : cfile_writers_) {
     size += writer->written_size();
@@ -21,14 +21,18 @@
 #include <map>
 #include <vector>
 
+#include "kudu/common/common.pb.h"
 #include "kudu/common/schema.h"
 #include "kudu/fs/fs_manager.h"
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/util/countdown_latch.h"
 
 namespace kudu {
 
 class RowBlock;
 class Schema;
+class ThreadPool;
 
 namespace cfile {
 class CFileWriter;
@@ -42,10 +46,17 @@ namespace tablet {
 
 // Wrapper which writes several columns in parallel corresponding to some
 // Schema.
+//
+// If 'encode_pool' is non-NULL, each column of an appended block is encoded,
+// compressed and written by a task on that pool, and AppendBlock() returns
+// without waiting for them. At most one block is in flight at a time.
 class MultiColumnWriter {
  public:
+  // The blocks are created for tablet 'tablet_id', if not empty.
   MultiColumnWriter(FsManager* fs,
-                    const Schema* schema);
+                    const Schema* schema,
+                    ThreadPool* encode_pool = nullptr,
+                    std::string tablet_id = "");
 
   virtual ~MultiColumnWriter();
 
@@ -54,9 +65,18 @@ class MultiColumnWriter {
 
   // Append the given block to the output columns.
   //
+  // With an encode pool, this first waits for the previously appended block
+  // to be written, returning any error from doing so. 'block' must then stay
+  // valid and unmodified until the next call to AppendBlock(), Sync() or
+  // Finish().
+  //
   // Note that the selection vector here is ignored.
   Status AppendBlock(const RowBlock& block);
 
+  // Wait for the block in flight, if any, to be written to all columns.
+  // Returns the first error encountered by any column.
+  Status Sync();
+
   // Close the in-progress files.
   //
   // The file's blocks may be retrieved using FlushedBlocks().
@@ -66,11 +86,14 @@ class MultiColumnWriter {
   // to 'closer'.
   Status FinishAndReleaseBlocks(fs::ScopedWritableBlockCloser* closer);
 
-  // Return the number of bytes written so far.
+  // Return the number of bytes written so far. The block in flight, if any,
+  // is not included.
   size_t written_size() const;
 
+  // REQUIRES: no block is in flight.
   cfile::CFileWriter* writer_for_col_idx(int i) {
     DCHECK_LT(i, cfile_writers_.size());
+    DCHECK(!in_flight_);
     return cfile_writers_[i];
   }
 
@@ -79,15 +102,39 @@ class MultiColumnWriter {
   // REQUIRES: Finish() already called.
   void GetFlushedBlocksByColumnId(std::map<ColumnId, BlockId>* ret) const;
 
+  // Return the statistics of the written columns, keyed by column ID.
+  //
+  // REQUIRES: Finish() already called.
+  void GetColumnStatisticsByColumnId(std::map<ColumnId, ColumnStatisticsPB>* ret) const;
+
  private:
+  // Append column 'col_idx' of 'block', storing the result in col_statuses_.
+  void AppendColumnTask(const RowBlock* block, int col_idx);
+
+  Status AppendColumn(const RowBlock& block, int col_idx);
+
+  // Sum the sizes written by each of the column writers.
+  size_t ComputeWrittenSize() const;
+
   FsManager* const fs_;
   const Schema* const schema_;
+  ThreadPool* const encode_pool_;
+  const std::string tablet_id_;
 
   bool finished_;
 
   std::vector<cfile::CFileWriter *> cfile_writers_;
   std::vector<BlockId> block_ids_;
 
+  // State of the block in flight on 'encode_pool_'. Each task sets the
+  // status for its column before counting down the latch.
+  bool in_flight_;
+  gscoped_ptr<CountDownLatch> in_flight_latch_;
+  std::vector<Status> col_statuses_;
+
+  // written_size() as of the last time no block was in flight.
+  size_t synced_written_size_;
+
   DISALLOW_COPY_AND_ASSIGN(MultiColumnWriter);
 };
 
@@ -500,20 +500,20 @@ TEST_F(MvccTest, TestTxnAbort) {
   // shouldn't be reported as committed.
   mgr.AbortTransaction(tx1);
   ASSERT_EQ(mgr.GetCleanTimestamp().CompareTo(Timestamp::kInitialTimestamp), 0);
-  ASSERT_FALSE(mgr.cur_snap_.IsCommitted(tx1));
+  ASSERT_FALSE(MvccSnapshot(mgr).IsCommitted(tx1));
 
   // Committing tx3 shouldn't advance the clean time since it is not the earliest
   // in-flight, but it should advance 'no_new_transactions_at_or_before_', the "safe"
   // time, to 3.
   mgr.StartApplyingTransaction(tx3);
   mgr.CommitTransaction(tx3);
-  ASSERT_TRUE(mgr.cur_snap_.IsCommitted(tx3));
-  ASSERT_EQ(mgr.no_new_transactions_at_or_before_.CompareTo(tx3), 0);
+  ASSERT_TRUE(MvccSnapshot(mgr).IsCommitted(tx3));
+  ASSERT_EQ(Timestamp(mgr.no_new_transactions_at_or_before_.Load()).CompareTo(tx3), 0);
 
   // Committing tx2 should advance the clean time to 3.
   mgr.StartApplyingTransaction(tx2);
   mgr.CommitTransaction(tx2);
-  ASSERT_TRUE(mgr.cur_snap_.IsCommitted(tx2));
+  ASSERT_TRUE(MvccSnapshot(mgr).IsCommitted(tx2));
   ASSERT_EQ(mgr.GetCleanTimestamp().CompareTo(tx3), 0);
 }
 
@@ -533,7 +533,7 @@ TEST_F(MvccTest, TestCleanTimeCoalescingOnOfflineTransactions) {
 
   mgr.StartApplyingTransaction(Timestamp(10));
   mgr.OfflineCommitTransaction(Timestamp(10));
-  ASSERT_EQ(mgr.cur_snap_.ToString(), "MvccSnapshot[committed={T|T < 15 or (T in {15})}]");
+  ASSERT_EQ(MvccSnapshot(mgr).ToString(), "MvccSnapshot[committed={T|T < 15 or (T in {15})}]");
 }
 
 // Various death tests which ensure that we can only transition in one of the following
@@ -21,12 +21,14 @@
 #include <glog/logging.h>
 #include <mutex>
 
+#include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/mathlimits.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/strcat.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/server/logical_clock.h"
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/debug/trace_event.h"
@@ -34,19 +36,35 @@
 
 namespace kudu { namespace tablet {
 
+namespace {
+
+// The maximum number of shards of the in-flight set.
+const int kMaxMvccShards = 64;
+
+} // anonymous namespace
+
 MvccManager::MvccManager(const scoped_refptr<server::Clock>& clock)
-  : no_new_transactions_at_or_before_(Timestamp::kMin),
-    earliest_in_flight_(Timestamp::kMax),
+  : num_shards_(1),
+    all_committed_before_(Timestamp::kInitialTimestamp.value()),
+    no_new_transactions_at_or_before_(Timestamp::kMin.value()),
+    earliest_in_flight_(Timestamp::kMax.value()),
     clock_(clock) {
-  cur_snap_.all_committed_before_ = Timestamp::kInitialTimestamp;
-  cur_snap_.none_committed_at_or_after_ = Timestamp::kInitialTimestamp;
+  while (num_shards_ < base::NumCPUs() && num_shards_ < kMaxMvccShards) {
+    num_shards_ *= 2;
+  }
+  shards_.reset(new Shard[num_shards_]);
+}
+
+MvccManager::Shard* MvccManager::ShardFor(Timestamp ts) const {
+  // Spread consecutive timestamps over the shards.
+  uint64_t h = ts.value() * 0x9E3779B97F4A7C15ULL;
+  return &shards_[(h >> 32) & (num_shards_ - 1)];
 }
 
 Timestamp MvccManager::StartTransaction() {
   while (true) {
     Timestamp now = clock_->Now();
-    std::lock_guard<LockType> l(lock_);
-    if (PREDICT_TRUE(InitTransactionUnlocked(now))) {
+    if (PREDICT_TRUE(InitTransaction(now))) {
       return now;
     }
   }
@@ -56,33 +74,38 @@ Timestamp MvccManager::StartTransaction() {
 }
 
 Timestamp MvccManager::StartTransactionAtLatest() {
-  std::lock_guard<LockType> l(lock_);
+  std::lock_guard<simple_spinlock> l(latest_lock_);
   Timestamp now_latest = clock_->NowLatest();
-  while (PREDICT_FALSE(!InitTransactionUnlocked(now_latest))) {
+  while (PREDICT_FALSE(!InitTransaction(now_latest))) {
     now_latest = clock_->NowLatest();
   }
 
   // If in debug mode enforce that transactions have monotonically increasing
   // timestamps at all times
 #ifndef NDEBUG
-  if (!timestamps_in_flight_.empty()) {
-    Timestamp max(std::max_element(timestamps_in_flight_.begin(),
-                                   timestamps_in_flight_.end())->first);
-    CHECK_EQ(max.value(), now_latest.value());
+  Timestamp::val_type max = 0;
+  for (int i = 0; i < num_shards_; i++) {
+    std::lock_guard<simple_spinlock> shard_lock(shards_[i].lock);
+    for (const auto& entry : shards_[i].in_flight) {
+      max = std::max(max, entry.first);
+    }
   }
+  CHECK_EQ(max, now_latest.value());
 #endif
 
   return now_latest;
 }
 
 Status MvccManager::StartTransactionAtTimestamp(Timestamp timestamp) {
-  std::lock_guard<LockType> l(lock_);
-  if (PREDICT_FALSE(cur_snap_.IsCommitted(timestamp))) {
+  if (PREDICT_FALSE(timestamp.value() < all_committed_before_.Load(kMemOrderAcquire) ||
+                    IsInCommittedList(timestamp))) {
+    MvccSnapshot snap;
+    TakeSnapshot(&snap);
     return Status::IllegalState(
         strings::Substitute("Timestamp: $0 is already committed. Current Snapshot: $1",
-                            timestamp.value(), cur_snap_.ToString()));
+                            timestamp.value(), snap.ToString()));
   }
-  if (!InitTransactionUnlocked(timestamp)) {
+  if (!InitTransaction(timestamp)) {
     return Status::IllegalState(
         strings::Substitute("There is already a transaction with timestamp: $0 in flight.",
                             timestamp.value()));
@@ -91,9 +114,10 @@ Status MvccManager::StartTransactionAtTimestamp(Timestamp timestamp) {
 }
 
 void MvccManager::StartApplyingTransaction(Timestamp timestamp) {
-  std::lock_guard<LockType> l(lock_);
-  auto it = timestamps_in_flight_.find(timestamp.value());
-  if (PREDICT_FALSE(it == timestamps_in_flight_.end())) {
+  Shard* shard = ShardFor(timestamp);
+  std::lock_guard<simple_spinlock> l(shard->lock);
+  auto it = shard->in_flight.find(timestamp.value());
+  if (PREDICT_FALSE(it == shard->in_flight.end())) {
     LOG(FATAL) << "Cannot mark timestamp " << timestamp.ToString() << " as APPLYING: "
                << "not in the in-flight map.";
   }
@@ -107,39 +131,50 @@ void MvccManager::StartApplyingTransaction(Timestamp timestamp) {
   it->second = APPLYING;
 }
 
-bool MvccManager::InitTransactionUnlocked(const Timestamp& timestamp) {
-  // Ensure that we didn't mark the given timestamp as "safe" in between
-  // acquiring the time and taking the lock. This allows us to acquire timestamps
-  // outside of the MVCC lock.
-  if (PREDICT_FALSE(no_new_transactions_at_or_before_.CompareTo(timestamp) >= 0)) {
+bool MvccManager::InitTransaction(Timestamp timestamp) {
+  // Ensure that we didn't mark the given timestamp as "safe" since acquiring
+  // the time. This allows us to acquire timestamps outside of any lock.
+  if (PREDICT_FALSE(no_new_transactions_at_or_before_.Load(kMemOrderAcquire) >=
+                    timestamp.value())) {
     return false;
   }
-  // Since transactions only commit once they are in the past, and new
-  // transactions always start either in the current time or the future,
-  // we should never be trying to start a new transaction at the same time
-  // as an already-committed one.
-  DCHECK(!cur_snap_.IsCommitted(timestamp))
-    << "Trying to start a new txn at already-committed timestamp "
-    << timestamp.ToString()
-    << " cur_snap_: " << cur_snap_.ToString();
 
-  if (timestamp.CompareTo(earliest_in_flight_) < 0) {
-    earliest_in_flight_ = timestamp;
+  Shard* shard = ShardFor(timestamp);
+  {
+    std::lock_guard<simple_spinlock> l(shard->lock);
+    // Since transactions only commit once they are in the past, and new
+    // transactions always start either in the current time or the future,
+    // we should never be trying to start a new transaction at the same time
+    // as an already-committed one.
+    DCHECK(std::find(shard->committed.begin(), shard->committed.end(), timestamp.value()) ==
+           shard->committed.end())
+      << "Trying to start a new txn at already-committed timestamp "
+      << timestamp.ToString();
+    if (!InsertIfNotPresent(&shard->in_flight, timestamp.value(), RESERVED)) {
+      return false;
+    }
   }
 
-  return InsertIfNotPresent(&timestamps_in_flight_, timestamp.value(), RESERVED);
+  // A commit may have advanced the safe time past 'timestamp' while it was
+  // being inserted. Committers advance the safe time before scanning the
+  // shards, and we check it after inserting, so either the commit's scan
+  // sees this transaction or we see the new safe time and back off.
+  base::subtle::MemoryBarrier();
+  if (PREDICT_FALSE(no_new_transactions_at_or_before_.Load(kMemOrderAcquire) >=
+                    timestamp.value())) {
+    RemoveAbortedTransaction(timestamp, RESERVED);
+    return false;
+  }
+
+  if (timestamp.value() < earliest_in_flight_.Load(kMemOrderAcquire)) {
+    earliest_in_flight_.StoreMin(timestamp.value());
+  }
+  return true;
 }
 
 void MvccManager::CommitTransaction(Timestamp timestamp) {
-  std::lock_guard<LockType> l(lock_);
   bool was_earliest = false;
-  CommitTransactionUnlocked(timestamp, &was_earliest);
-
-  // No more transactions will start with a ts that is lower than or equal
-  // to 'timestamp', so we adjust the snapshot accordingly.
-  if (no_new_transactions_at_or_before_.CompareTo(timestamp) < 0) {
-    no_new_transactions_at_or_before_ = timestamp;
-  }
+  CommitTransactionInShard(timestamp, &was_earliest);
 
   if (was_earliest) {
     // If this transaction was the earliest in-flight, we might have to adjust
@@ -149,90 +184,134 @@ void MvccManager::CommitTransaction(Timestamp timestamp) {
 }
 
 void MvccManager::AbortTransaction(Timestamp timestamp) {
-  std::lock_guard<LockType> l(lock_);
+  RemoveAbortedTransaction(timestamp, RESERVED);
+}
 
-  // Remove from our in-flight list.
-  TxnState old_state = RemoveInFlightAndGetStateUnlocked(timestamp);
-  CHECK_EQ(old_state, RESERVED) << "transaction with timestamp " << timestamp.ToString()
-                                << " cannot be aborted in state " << old_state;
+void MvccManager::RemoveAbortedTransaction(Timestamp timestamp, TxnState expected_state) {
+  Shard* shard = ShardFor(timestamp);
+  {
+    std::lock_guard<simple_spinlock> l(shard->lock);
+    // Remove from our in-flight list.
+    TxnState old_state = RemoveInFlightAndGetStateUnlocked(shard, timestamp);
+    CHECK_EQ(old_state, expected_state) << "transaction with timestamp " << timestamp.ToString()
+                                        << " cannot be aborted in state " << old_state;
+  }
 
   // If we're aborting the earliest transaction that was in flight,
-  // update our cached value.
-  if (earliest_in_flight_.CompareTo(timestamp) == 0) {
-    AdvanceEarliestInFlightTimestamp();
+  // update our cached value. This doesn't advance the clean time, since a
+  // new transaction with a lower timestamp might be executed later.
+  base::subtle::MemoryBarrier();
+  if (earliest_in_flight_.Load(kMemOrderAcquire) == timestamp.value()) {
+    std::lock_guard<LockType> l(lock_);
+    RecomputeEarliestInFlightUnlocked();
   }
 }
 
 void MvccManager::OfflineCommitTransaction(Timestamp timestamp) {
-  std::lock_guard<LockType> l(lock_);
-
   // Commit the transaction, but do not adjust 'all_committed_before_', that will
   // be done with a separate OfflineAdjustCurSnap() call.
-  bool was_earliest = false;
-  CommitTransactionUnlocked(timestamp, &was_earliest);
-
-  if (was_earliest
-      && no_new_transactions_at_or_before_.CompareTo(timestamp) >= 0) {
+  Shard* shard = ShardFor(timestamp);
+  {
+    std::lock_guard<simple_spinlock> l(shard->lock);
+    TxnState old_state = RemoveInFlightAndGetStateUnlocked(shard, timestamp);
+    CHECK_EQ(old_state, APPLYING)
+      << "Trying to commit a transaction which never entered APPLYING state: "
+      << timestamp.ToString() << " state=" << old_state;
+    shard->committed.push_back(timestamp.value());
+  }
+  base::subtle::MemoryBarrier();
+  bool was_earliest = earliest_in_flight_.Load(kMemOrderAcquire) == timestamp.value();
+
+  if (was_earliest &&
+      no_new_transactions_at_or_before_.Load(kMemOrderAcquire) >= timestamp.value()) {
     // If this transaction was the earliest in-flight, we might have to adjust
     // the "clean" timestamp.
     AdjustCleanTime();
+  } else if (was_earliest) {
+    std::lock_guard<LockType> l(lock_);
+    RecomputeEarliestInFlightUnlocked();
   }
 }
 
-MvccManager::TxnState MvccManager::RemoveInFlightAndGetStateUnlocked(Timestamp ts) {
-  DCHECK(lock_.is_locked());
+MvccManager::TxnState MvccManager::RemoveInFlightAndGetStateUnlocked(Shard* shard,
+                                                                     Timestamp ts) {
+  DCHECK(shard->lock.is_locked());
 
-  auto it = timestamps_in_flight_.find(ts.value());
-  if (it == timestamps_in_flight_.end()) {
+  auto it = shard->in_flight.find(ts.value());
+  if (it == shard->in_flight.end()) {
     LOG(FATAL) << "Trying to remove timestamp which isn't in the in-flight set: "
                << ts.ToString();
   }
   TxnState state = it->second;
-  timestamps_in_flight_.erase(it);
+  shard->in_flight.erase(it);
   return state;
 }
 
-void MvccManager::CommitTransactionUnlocked(Timestamp timestamp,
-                                            bool* was_earliest_in_flight) {
+void MvccManager::CommitTransactionInShard(Timestamp timestamp,
+                                           bool* was_earliest_in_flight) {
   DCHECK(clock_->IsAfter(timestamp))
     << "Trying to commit a transaction with a future timestamp: "
     << timestamp.ToString() << ". Current time: " << clock_->Stringify(clock_->Now());
 
-  *was_earliest_in_flight = earliest_in_flight_ == timestamp;
+  Shard* shard = ShardFor(timestamp);
+  {
+    std::lock_guard<simple_spinlock> l(shard->lock);
 
-  // Remove from our in-flight list.
-  TxnState old_state = RemoveInFlightAndGetStateUnlocked(timestamp);
-  CHECK_EQ(old_state, APPLYING)
-    << "Trying to commit a transaction which never entered APPLYING state: "
-    << timestamp.ToString() << " state=" << old_state;
+    // Remove from our in-flight list.
+    TxnState old_state = RemoveInFlightAndGetStateUnlocked(shard, timestamp);
+    CHECK_EQ(old_state, APPLYING)
+      << "Trying to commit a transaction which never entered APPLYING state: "
+      << timestamp.ToString() << " state=" << old_state;
 
-  // Add to snapshot's committed list
-  cur_snap_.AddCommittedTimestamp(timestamp);
+    // Add to the committed list which snapshots are built from.
+    shard->committed.push_back(timestamp.value());
+  }
 
-  // If we're committing the earliest transaction that was in flight,
-  // update our cached value.
-  if (*was_earliest_in_flight) {
-    AdvanceEarliestInFlightTimestamp();
+  // No more transactions will start with a ts that is lower than or equal
+  // to 'timestamp'.
+  no_new_transactions_at_or_before_.StoreMax(timestamp.value());
+
+  // If we're committing the earliest transaction that was in flight, the
+  // cached value has to be recomputed along with the clean time.
+  base::subtle::MemoryBarrier();
+  *was_earliest_in_flight = earliest_in_flight_.Load(kMemOrderAcquire) == timestamp.value();
+}
+
+Timestamp::val_type MvccManager::ScanEarliestInFlight() const {
+  Timestamp::val_type earliest = Timestamp::kMax.value();
+  for (int i = 0; i < num_shards_; i++) {
+    std::lock_guard<simple_spinlock> l(shards_[i].lock);
+    for (const auto& entry : shards_[i].in_flight) {
+      earliest = std::min(earliest, entry.first);
+    }
   }
+  return earliest;
 }
 
-void MvccManager::AdvanceEarliestInFlightTimestamp() {
-  if (timestamps_in_flight_.empty()) {
-    earliest_in_flight_ = Timestamp::kMax;
-  } else {
-    earliest_in_flight_ = Timestamp(std::min_element(timestamps_in_flight_.begin(),
-                                                     timestamps_in_flight_.end())->first);
+Timestamp MvccManager::RecomputeEarliestInFlightUnlocked() {
+  DCHECK(lock_.is_locked());
+  Timestamp safe_time(no_new_transactions_at_or_before_.Load(kMemOrderAcquire));
+  base::subtle::MemoryBarrier();
+
+  // A transaction may start with a lower timestamp, or the scanned earliest
+  // one finish, while the shards are being scanned. Either one happening
+  // after the cached value is published shows up in a rescan, so repeat
+  // until two scans agree.
+  Timestamp::val_type earliest = ScanEarliestInFlight();
+  while (true) {
+    earliest_in_flight_.Store(earliest, kMemOrderRelease);
+    base::subtle::MemoryBarrier();
+    Timestamp::val_type rescanned = ScanEarliestInFlight();
+    if (rescanned == earliest) break;
+    earliest = rescanned;
   }
+  return safe_time;
 }
 
 void MvccManager::OfflineAdjustSafeTime(Timestamp safe_time) {
-  std::lock_guard<LockType> l(lock_);
-
   // No more transactions will start with a ts that is lower than or equal
   // to 'safe_time', so we adjust the snapshot accordingly.
-  if (no_new_transactions_at_or_before_.CompareTo(safe_time) < 0) {
-    no_new_transactions_at_or_before_ = safe_time;
-  }
+  no_new_transactions_at_or_before_.StoreMax(safe_time.value());
 
   AdjustCleanTime();
 }
@@ -250,6 +329,8 @@ static void FilterTimestamps(std::vector<Timestamp::val_type>* v,
 }
 
 void MvccManager::AdjustCleanTime() {
+  std::lock_guard<LockType> l(lock_);
+
   // There are two possibilities:
   //
   // 1) We still have an in-flight transaction earlier than 'no_new_transactions_at_or_before_'.
@@ -263,15 +344,20 @@ void MvccManager::AdjustCleanTime() {
   //
   // In either case, we have to add the newly committed ts only if it remains higher
   // than the new watermark.
+  Timestamp safe_time = RecomputeEarliestInFlightUnlocked();
+  Timestamp::val_type clean = std::min(earliest_in_flight_.Load(kMemOrderAcquire),
+                                       safe_time.value());
 
-  if (earliest_in_flight_.CompareTo(no_new_transactions_at_or_before_) < 0) {
-    cur_snap_.all_committed_before_ = earliest_in_flight_;
-  } else {
-    cur_snap_.all_committed_before_ = no_new_transactions_at_or_before_;
-  }
+  // A transaction which backs off from starting below the safe time may
+  // briefly have been seen in flight; never move the clean time backwards.
+  all_committed_before_.StoreMax(clean, kMemOrderRelease);
+  clean = all_committed_before_.Load(kMemOrderAcquire);
 
   // Filter out any committed timestamps that now fall below the watermark
-  FilterTimestamps(&cur_snap_.committed_timestamps_, cur_snap_.all_committed_before_.value());
+  for (int i = 0; i < num_shards_; i++) {
+    std::lock_guard<simple_spinlock> shard_lock(shards_[i].lock);
+    FilterTimestamps(&shards_[i].committed, clean);
+  }
 
   // it may also have unblocked some waiters.
   // Check if someone is waiting for transactions to be committed.
@@ -336,27 +422,70 @@ bool MvccManager::IsDoneWaitingUnlocked(const WaitingState& waiter) const {
 }
 
 bool MvccManager::AreAllTransactionsCommittedUnlocked(Timestamp ts) const {
-  if (timestamps_in_flight_.empty()) {
+  if (NoneInFlight()) {
     // If nothing is in-flight, then check the clock. If the timestamp is in the past,
     // we know that no new uncommitted transactions may start before this ts.
     return ts.CompareTo(clock_->Now()) <= 0;
   }
-  // If some transactions are in flight, then check the in-flight list.
-  return !cur_snap_.MayHaveUncommittedTransactionsAtOrBefore(ts);
+  // If some transactions are in flight, then check the clean time and the
+  // committed list. See MvccSnapshot::MayHaveUncommittedTransactionsAtOrBefore().
+  Timestamp::val_type clean = all_committed_before_.Load(kMemOrderAcquire);
+  return ts.value() < clean || (ts.value() == clean && IsInCommittedList(ts));
 }
 
 bool MvccManager::AnyApplyingAtOrBeforeUnlocked(Timestamp ts) const {
-  for (const InFlightMap::value_type entry : timestamps_in_flight_) {
-    if (entry.first <= ts.value()) {
-      return true;
+  for (int i = 0; i < num_shards_; i++) {
+    std::lock_guard<simple_spinlock> l(shards_[i].lock);
+    for (const InFlightMap::value_type& entry : shards_[i].in_flight) {
+      if (entry.first <= ts.value()) {
+        return true;
+      }
     }
   }
   return false;
 }
 
+bool MvccManager::IsInCommittedList(Timestamp ts) const {
+  const Shard* shard = ShardFor(ts);
+  std::lock_guard<simple_spinlock> l(shard->lock);
+  return std::find(shard->committed.begin(), shard->committed.end(), ts.value()) !=
+      shard->committed.end();
+}
+
+bool MvccManager::NoneInFlight() const {
+  for (int i = 0; i < num_shards_; i++) {
+    std::lock_guard<simple_spinlock> l(shards_[i].lock);
+    if (!shards_[i].in_flight.empty()) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void MvccManager::TakeSnapshot(MvccSnapshot *snap) const {
-  std::lock_guard<LockType> l(lock_);
-  *snap = cur_snap_;
+  // Hold every shard's lock at once so that the snapshot reflects a single
+  // point in time: a transaction which committed before another one did is
+  // never missing from a snapshot which includes the other.
+  for (int i = 0; i < num_shards_; i++) {
+    shards_[i].lock.lock();
+  }
+  Timestamp::val_type clean = all_committed_before_.Load(kMemOrderAcquire);
+  snap->committed_timestamps_.clear();
+  for (int i = 0; i < num_shards_; i++) {
+    for (Timestamp::val_type ts : shards_[i].committed) {
+      if (ts >= clean) {
+        snap->committed_timestamps_.push_back(ts);
+      }
+    }
+  }
+  for (int i = num_shards_ - 1; i >= 0; i--) {
+    shards_[i].lock.unlock();
+  }
+
+  std::sort(snap->committed_timestamps_.begin(), snap->committed_timestamps_.end());
+  snap->all_committed_before_ = Timestamp(clean);
+  snap->none_committed_at_or_after_ = snap->committed_timestamps_.empty() ?
+      Timestamp(clean) : Timestamp(snap->committed_timestamps_.back() + 1);
 }
 
 Status MvccManager::WaitForCleanSnapshotAtTimestamp(Timestamp timestamp,
@@ -378,9 +507,9 @@ void MvccManager::WaitForApplyingTransactionsToCommit() const {
 
   // Find the highest timestamp of an APPLYING transaction.
   Timestamp wait_for = Timestamp::kMin;
-  {
-    std::lock_guard<LockType> l(lock_);
-    for (const InFlightMap::value_type entry : timestamps_in_flight_) {
+  for (int i = 0; i < num_shards_; i++) {
+    std::lock_guard<simple_spinlock> l(shards_[i].lock);
+    for (const InFlightMap::value_type& entry : shards_[i].in_flight) {
       if (entry.second == APPLYING) {
         wait_for = Timestamp(std::max(entry.first, wait_for.value()));
       }
@@ -399,26 +528,29 @@ void MvccManager::WaitForApplyingTransactionsToCommit() const {
 }
 
 bool MvccManager::AreAllTransactionsCommitted(Timestamp ts) const {
-  std::lock_guard<LockType> l(lock_);
   return AreAllTransactionsCommittedUnlocked(ts);
 }
 
 int MvccManager::CountTransactionsInFlight() const {
-  std::lock_guard<LockType> l(lock_);
-  return timestamps_in_flight_.size();
+  int count = 0;
+  for (int i = 0; i < num_shards_; i++) {
+    std::lock_guard<simple_spinlock> l(shards_[i].lock);
+    count += shards_[i].in_flight.size();
+  }
+  return count;
 }
 
 Timestamp MvccManager::GetCleanTimestamp() const {
-  std::lock_guard<LockType> l(lock_);
-  return cur_snap_.all_committed_before_;
+  return Timestamp(all_committed_before_.Load(kMemOrderAcquire));
 }
 
 void MvccManager::GetApplyingTransactionsTimestamps(std::vector<Timestamp>* timestamps) const {
-  std::lock_guard<LockType> l(lock_);
-  timestamps->reserve(timestamps_in_flight_.size());
-  for (const InFlightMap::value_type entry : timestamps_in_flight_) {
-    if (entry.second == APPLYING) {
-      timestamps->push_back(Timestamp(entry.first));
+  for (int i = 0; i < num_shards_; i++) {
+    std::lock_guard<simple_spinlock> l(shards_[i].lock);
+    for (const InFlightMap::value_type& entry : shards_[i].in_flight) {
+      if (entry.second == APPLYING) {
+        timestamps->push_back(Timestamp(entry.first));
+      }
     }
   }
 }
@@ -18,6 +18,7 @@
 #define KUDU_TABLET_MVCC_H
 
 #include <gtest/gtest_prod.h>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
@@ -25,6 +26,7 @@
 
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/server/clock.h"
+#include "kudu/util/atomic.h"
 #include "kudu/util/locks.h"
 
 namespace kudu {
@@ -178,6 +180,11 @@ class MvccSnapshot {
 // NOTE: we do not support "rollback" of in-memory edits. Thus, once we call
 // StartApplyingTransaction(), the transaction _must_ commit.
 //
+// The set of in-flight transactions is split into shards by timestamp, each
+// with its own lock, so that transactions which start and commit
+// concurrently don't serialize on a single lock. Taking a snapshot briefly
+// locks every shard to get a consistent view of the committed transactions.
+//
 class MvccManager {
  public:
   explicit MvccManager(const scoped_refptr<server::Clock>& clock);
@@ -316,7 +323,9 @@ class MvccManager {
     APPLYING
   };
 
-  bool InitTransactionUnlocked(const Timestamp& timestamp);
+  // Adds 'timestamp' to the in-flight set, unless it is already in flight or
+  // may already be considered committed. Returns true if it was added.
+  bool InitTransaction(Timestamp timestamp);
 
   enum WaitFor {
     ALL_COMMITTED,
@@ -329,6 +338,26 @@ class MvccManager {
     WaitFor wait_for;
   };
 
+  // The set of timestamps corresponding to currently in-flight transactions.
+  typedef std::unordered_map<Timestamp::val_type, TxnState> InFlightMap;
+
+  // A slice of the in-flight set. Each timestamp belongs to the one shard it
+  // hashes to, so that transactions starting and committing on different
+  // cores mostly take different locks.
+  struct Shard {
+    mutable simple_spinlock lock;
+
+    // The in-flight transactions of this shard.
+    InFlightMap in_flight;
+
+    // The transactions of this shard committed at or after the clean time.
+    std::vector<Timestamp::val_type> committed;
+
+    char padding[CACHELINE_SIZE];
+  };
+
+  Shard* ShardFor(Timestamp ts) const;
+
   // Returns true if all transactions before the given timestamp are committed.
   //
   // If 'ts' is not in the past, it's still possible that new transactions could
@@ -347,49 +376,74 @@ class MvccManager {
   // been achieved.
   bool IsDoneWaitingUnlocked(const WaitingState& waiter) const;
 
-  // Commits the given transaction.
+  // Commits the given transaction in its shard.
   // Sets *was_earliest to true if this was the earliest in-flight transaction.
-  void CommitTransactionUnlocked(Timestamp timestamp,
-                                 bool* was_earliest);
+  void CommitTransactionInShard(Timestamp timestamp, bool* was_earliest);
 
-  // Remove the timestamp 'ts' from the in-flight map.
-  // FATALs if the ts is not in the in-flight map.
+  // Remove the timestamp 'ts' from the in-flight map of 'shard', whose lock
+  // must be held. FATALs if the ts is not in the in-flight map.
   // Returns its state.
-  TxnState RemoveInFlightAndGetStateUnlocked(Timestamp ts);
+  static TxnState RemoveInFlightAndGetStateUnlocked(Shard* shard, Timestamp ts);
+
+  // Removes an aborted transaction, or one which backed off while starting,
+  // from the in-flight set.
+  void RemoveAbortedTransaction(Timestamp ts, TxnState expected_state);
 
   // Adjusts the clean time, i.e. the timestamp such that all transactions with
   // lower timestamps are committed or aborted, based on which transactions are
   // currently in flight and on what is the latest value of 'no_new_transactions_at_or_before_'.
   void AdjustCleanTime();
 
-  // Advances the earliest in-flight timestamp, based on which transactions are
-  // currently in-flight. Usually called when the previous earliest transaction
-  // commits or aborts.
-  void AdvanceEarliestInFlightTimestamp();
+  // Recomputes 'earliest_in_flight_' from the shards. Returns the value read
+  // from 'no_new_transactions_at_or_before_' before scanning them.
+  //
+  // Requires 'lock_' to be held.
+  Timestamp RecomputeEarliestInFlightUnlocked();
+
+  // Returns the minimum timestamp in flight across the shards, or
+  // Timestamp::kMax if there is none.
+  Timestamp::val_type ScanEarliestInFlight() const;
+
+  // Returns true if the committed timestamps of the shard which 'ts' belongs
+  // to include it.
+  bool IsInCommittedList(Timestamp ts) const;
+
+  // Returns true if no transaction is in flight in any shard.
+  bool NoneInFlight() const;
 
   int GetNumWaitersForTests() const {
     std::lock_guard<simple_spinlock> l(lock_);
     return waiters_.size();
   }
 
+  // Serializes changes to the clean time and to 'earliest_in_flight_' made
+  // from scans of the shards, and protects 'waiters_'. Starting and
+  // committing a transaction only takes the lock of its shard, and this one
+  // only when the transaction may be the earliest in flight.
   typedef simple_spinlock LockType;
   mutable LockType lock_;
 
-  MvccSnapshot cur_snap_;
+  // Serializes StartTransactionAtLatest() calls so that they are assigned
+  // monotonically increasing timestamps.
+  simple_spinlock latest_lock_;
 
-  // The set of timestamps corresponding to currently in-flight transactions.
-  typedef std::unordered_map<Timestamp::val_type, TxnState> InFlightMap;
-  InFlightMap timestamps_in_flight_;
+  int num_shards_;
+  std::unique_ptr<Shard[]> shards_;
+
+  // The timestamp below which all transactions are committed, i.e. the
+  // 'all_committed_before_' of snapshots taken now. Only ever increases.
+  AtomicInt<Timestamp::val_type> all_committed_before_;
 
   // A transaction ID below which all transactions are either committed or in-flight,
   // meaning no new transactions will be started with a timestamp that is equal
   // to or lower than this one.
-  Timestamp no_new_transactions_at_or_before_;
+  AtomicInt<Timestamp::val_type> no_new_transactions_at_or_before_;
 
-  // The minimum timestamp in timestamps_in_flight_, or Timestamp::kMax
-  // if that set is empty. This is cached in order to avoid having to iterate
-  // over timestamps_in_flight_ on every commit.
-  Timestamp earliest_in_flight_;
+  // The minimum timestamp in flight, or Timestamp::kMax if there is none.
+  // This is cached in order to avoid having to scan the shards on every
+  // commit. Lowered by starting transactions and raised, under 'lock_', by
+  // scans of the shards when the earliest transaction finishes.
+  AtomicInt<Timestamp::val_type> earliest_in_flight_;
 
   scoped_refptr<server::Clock> clock_;
   mutable std::vector<WaitingState*> waiters_;
@@ -0,0 +1,64 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tablet/row_checksum.h"
+
+#include "kudu/common/row.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/schema.h"
+
+namespace kudu {
+namespace tablet {
+
+RowChecksummer::RowChecksummer()
+    : crc_(crc::GetCrc32cInstance()),
+      checksum_(0),
+      num_rows_(0) {
+}
+
+void RowChecksummer::AddRow(const Schema& projection, const RowBlockRow& row) {
+  checksum_ += CalcRowCrc32(projection, row);
+  num_rows_++;
+}
+
+uint32_t RowChecksummer::CalcRowCrc32(const Schema& projection, const RowBlockRow& row) {
+  tmp_buf_.clear();
+
+  for (size_t j = 0; j < projection.num_columns(); j++) {
+    uint32_t col_index = static_cast<uint32_t>(j);  // For the CRC.
+    tmp_buf_.append(&col_index, sizeof(col_index));
+    ColumnBlockCell cell = row.cell(j);
+    if (cell.is_nullable()) {
+      uint8_t is_defined = cell.is_null() ? 0 : 1;
+      tmp_buf_.append(&is_defined, sizeof(is_defined));
+      if (!is_defined) continue;
+    }
+    if (cell.typeinfo()->physical_type() == BINARY) {
+      const Slice* data = reinterpret_cast<const Slice *>(cell.ptr());
+      tmp_buf_.append(data->data(), data->size());
+    } else {
+      tmp_buf_.append(cell.ptr(), cell.size());
+    }
+  }
+
+  uint64_t row_crc = 0;
+  crc_->Compute(tmp_buf_.data(), tmp_buf_.size(), &row_crc, nullptr);
+  return static_cast<uint32_t>(row_crc); // CRC32 only uses the lower 32 bits.
+}
+
+} // namespace tablet
+} // namespace kudu
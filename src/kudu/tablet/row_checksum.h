@@ -0,0 +1,71 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TABLET_ROW_CHECKSUM_H
+#define KUDU_TABLET_ROW_CHECKSUM_H
+
+#include <cstdint>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/crc.h"
+#include "kudu/util/faststring.h"
+
+namespace kudu {
+
+class RowBlockRow;
+class Schema;
+
+namespace tablet {
+
+// Accumulates the checksum of a set of rows, as the sum of the CRC32C of
+// each row. The sum doesn't depend on the order in which rows are added, so
+// the checksums of disjoint sets of rows, e.g. of different rowsets or of
+// consecutive batches of a scan, can simply be added together.
+//
+// Checksum scans and the per-rowset checksums cached at flush and
+// compaction time must agree, so both compute them here.
+class RowChecksummer {
+ public:
+  RowChecksummer();
+
+  // Adds 'row' to the checksum. Only the columns of 'projection' are
+  // checksummed, positionally.
+  void AddRow(const Schema& projection, const RowBlockRow& row);
+
+  // Adds the checksum of other rows to this one.
+  void Add(uint64_t checksum, int64_t num_rows) {
+    checksum_ += checksum;
+    num_rows_ += num_rows;
+  }
+
+  uint64_t checksum() const { return checksum_; }
+  int64_t num_rows() const { return num_rows_; }
+
+ private:
+  // Calculates a CRC32C for the given row.
+  uint32_t CalcRowCrc32(const Schema& projection, const RowBlockRow& row);
+
+  crc::Crc* const crc_;
+  faststring tmp_buf_;
+  uint64_t checksum_;
+  int64_t num_rows_;
+
+  DISALLOW_COPY_AND_ASSIGN(RowChecksummer);
+};
+
+} // namespace tablet
+} // namespace kudu
+#endif /* KUDU_TABLET_ROW_CHECKSUM_H */
@@ -24,7 +24,8 @@ namespace tablet {
 
 RowOp::RowOp(DecodedRowOperation decoded_op)
     : decoded_op(std::move(decoded_op)),
-      orig_result_from_log_(nullptr) {
+      orig_result_from_log_(nullptr),
+      has_rowsets_to_check(false) {
 }
 
 RowOp::~RowOp() {
@@ -18,6 +18,7 @@
 #define KUDU_TABLET_ROW_OP_H
 
 #include <string>
+#include <vector>
 
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/common/row_operations.h"
@@ -81,6 +82,12 @@ struct RowOp {
   // If this operation is being replayed from the log, set to the original
   // result. Otherwise nullptr.
   const OperationResultPB* orig_result_from_log_;
+
+  // The rowsets which may contain this row's key, as found for the whole
+  // batch before it is applied (see Tablet::BatchFindRowSetsToCheck()).
+  // Only meaningful if 'has_rowsets_to_check' is true.
+  std::vector<RowSet*> rowsets_to_check;
+  bool has_rowsets_to_check;
 };
 
 
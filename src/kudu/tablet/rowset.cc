@@ -17,11 +17,13 @@
 
 #include "kudu/tablet/rowset.h"
 
+#include <algorithm>
 #include <limits>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "kudu/common/column_statistics.h"
 #include "kudu/common/generic_iterators.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/stringprintf.h"
@@ -33,6 +35,13 @@ using strings::Substitute;
 
 namespace kudu { namespace tablet {
 
+Status RowSet::CheckRowsMaybePresent(const RowSetKeyProbe* const* /* probes */, size_t n,
+                                     bool* maybe_present,
+                                     ProbeStats* const* /* stats */) const {
+  std::fill(maybe_present, maybe_present + n, true);
+  return Status::OK();
+}
+
 DuplicatingRowSet::DuplicatingRowSet(RowSetVector old_rowsets,
                                      RowSetVector new_rowsets)
     : old_rowsets_(std::move(old_rowsets)),
@@ -208,6 +217,29 @@ uint64_t DuplicatingRowSet::EstimateOnDiskSize() const {
   return size;
 }
 
+Status DuplicatingRowSet::GetColumnStatistics(const Schema& schema, int col_idx,
+                                              ColumnStatisticsPB* stats) const {
+  ColumnStatisticsPB merged;
+  for (const shared_ptr<RowSet> &rs : new_rowsets_) {
+    ColumnStatisticsPB rs_stats;
+    RETURN_NOT_OK(rs->GetColumnStatistics(schema, col_idx, &rs_stats));
+    RETURN_NOT_OK(MergeColumnStatistics(schema.column(col_idx).type_info(), rs_stats, &merged));
+  }
+  stats->Swap(&merged);
+  return Status::OK();
+}
+
+Status DuplicatingRowSet::GetKeySamples(int num_samples, vector<string>* keys) const {
+  if (new_rowsets_.empty()) {
+    return Status::OK();
+  }
+  int per_rowset = std::max<int>(1, num_samples / new_rowsets_.size());
+  for (const shared_ptr<RowSet> &rs : new_rowsets_) {
+    RETURN_NOT_OK(rs->GetKeySamples(per_rowset, keys));
+  }
+  return Status::OK();
+}
+
 shared_ptr<RowSetMetadata> DuplicatingRowSet::metadata() {
   return shared_ptr<RowSetMetadata>(reinterpret_cast<RowSetMetadata *>(NULL));
 }
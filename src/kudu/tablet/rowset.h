@@ -23,6 +23,7 @@
 #include <vector>
 
 #include "kudu/cfile/cfile_util.h"
+#include "kudu/common/common.pb.h"
 #include "kudu/common/iterator.h"
 #include "kudu/common/rowid.h"
 #include "kudu/common/schema.h"
@@ -44,6 +45,7 @@ class OpId;
 namespace tablet {
 
 class CompactionInput;
+class HotBlocksPB;
 class OperationResultPB;
 class MvccSnapshot;
 class RowSetKeyProbe;
@@ -67,6 +69,20 @@ class RowSet {
   virtual Status CheckRowPresent(const RowSetKeyProbe &probe, bool *present,
                                  ProbeStats* stats) const = 0;
 
+  // Pre-filter a batch of 'n' keys, sorted by key, before they are applied.
+  //
+  // Sets maybe_present[i] to false if the key of probes[i] is definitely not
+  // in this rowset no matter what else happens to the rowset in the meantime,
+  // and to true otherwise. Keys which may be present must still be checked
+  // with CheckRowPresent() or MutateRow() when they are applied.
+  //
+  // 'stats' holds the per-probe statistics and has 'n' entries.
+  //
+  // The default implementation reports every key as maybe present.
+  virtual Status CheckRowsMaybePresent(const RowSetKeyProbe* const* probes, size_t n,
+                                       bool* maybe_present,
+                                       ProbeStats* const* stats) const;
+
   // Update/delete a row in this rowset.
   // The 'update_schema' is the client schema used to encode the 'update' RowChangeList.
   //
@@ -98,6 +114,12 @@ class RowSet {
   // Count the number of rows in this rowset.
   virtual Status CountRows(rowid_t *count) const = 0;
 
+  // Counts the rows visible in 'snap' without reading them, if the rowset
+  // can. Sets 'counted' to false, leaving 'count' unset, if the rows must be
+  // scanned to be counted.
+  virtual Status CountVisibleRows(const MvccSnapshot& snap, int64_t* count,
+                                  bool* counted) const = 0;
+
   // Return the bounds for this RowSet. 'min_encoded_key' and 'max_encoded_key'
   // are set to the first and last encoded keys for this RowSet.
   //
@@ -116,6 +138,35 @@ class RowSet {
   // Estimate the number of bytes on-disk
   virtual uint64_t EstimateOnDiskSize() const = 0;
 
+  // Fill 'stats' with the statistics of the base data of the column at index
+  // 'col_idx' of 'schema'. Updates and deletes which are still in delta stores
+  // are not reflected. Returns NotFound if the statistics are not available.
+  virtual Status GetColumnStatistics(const Schema& schema, int col_idx,
+                                     ColumnStatisticsPB* stats) const = 0;
+
+  // Append to 'keys' the encoded keys of up to 'num_samples' rows of the base
+  // data, evenly spaced through the rowset, in key order. Rows deleted since
+  // the base data was written may be sampled. A rowset which is still
+  // mutable (eg MemRowSet) appends no keys.
+  virtual Status GetKeySamples(int num_samples, std::vector<std::string>* keys) const = 0;
+
+  // Returns true and sets 'checksum' and 'num_rows' to the checksum of the
+  // rows visible in 'snap', projected onto 'projection', if the checksum
+  // cached when the rowset was written still stands for them. Otherwise,
+  // the rowset has to be scanned to checksum it. See RowChecksummer.
+  virtual bool GetCachedChecksum(const Schema& projection, const MvccSnapshot& snap,
+                                 uint64_t* checksum, int64_t* num_rows) const = 0;
+
+  // Append to 'hot_blocks' the blocks of the base data which were recently
+  // found in the block cache. A rowset without base data (eg MemRowSet)
+  // appends none.
+  virtual void GetHotBlocks(HotBlocksPB* hot_blocks) const = 0;
+
+  // Read the blocks of 'hot_blocks' which belong to the base data into the
+  // block cache, adding the number of blocks read from disk to 'num_loaded'.
+  // See CFileSet::WarmUpBlockCache().
+  virtual Status WarmUpBlockCache(const HotBlocksPB& hot_blocks, int* num_loaded) = 0;
+
   // Return the lock used for including this DiskRowSet in a compaction.
   // This prevents multiple compactions and flushes from trying to include
   // the same rowset.
@@ -136,6 +187,31 @@ class RowSet {
   // The returned score ranges between 0 and 1 inclusively.
   virtual double DeltaStoresCompactionPerfImprovementScore(DeltaCompactionType type) const = 0;
 
+  // Return a lower bound on the number of rows in this rowset which were
+  // deleted before 'ancient_history_mark', and so would be dropped by
+  // rewriting the rowset. This is computed from delta store statistics
+  // without doing any IO.
+  virtual int64_t CountAncientDeletedRows(Timestamp ancient_history_mark) const = 0;
+
+  // Sets '*all_deleted' to true if every row in this rowset was deleted
+  // before 'ancient_history_mark', in which case the rowset can be removed
+  // from the tablet without being rewritten. This is usually ruled out
+  // cheaply, but confirming it reads the delta stores.
+  virtual Status CheckAllRowsDeleted(Timestamp ancient_history_mark,
+                                     bool* all_deleted) const = 0;
+
+  // Return the estimated number of bytes of UNDO deltas in this rowset which
+  // hold only history from before 'ancient_history_mark', and so could be
+  // discarded by GCAncientUndoDeltas(). This doesn't do any IO.
+  virtual int64_t EstimateBytesInAncientUndoDeltas(Timestamp ancient_history_mark) const = 0;
+
+  // Discard the UNDO deltas of this rowset from before 'ancient_history_mark'
+  // without rewriting the rest of the rowset. See
+  // DeltaTracker::GCAncientUndoDeltas() for the meaning of the arguments.
+  virtual Status GCAncientUndoDeltas(Timestamp ancient_history_mark,
+                                     int64_t* rewrite_budget_bytes,
+                                     int64_t* bytes_reclaimed) = 0;
+
   // Flush the DMS if there's one
   virtual Status FlushDeltas() = 0;
 
@@ -175,9 +251,9 @@ class RowSetKeyProbe {
   // NOTE: row_key is not copied and must be valid for the lifetime
   // of this object.
   explicit RowSetKeyProbe(ConstContiguousRow row_key)
-      : row_key_(std::move(row_key)) {
-    encoded_key_ = EncodedKey::FromContiguousRow(row_key_);
-    bloom_probe_ = BloomKeyProbe(encoded_key_slice());
+      : row_key_(std::move(row_key)),
+        encoded_key_(row_key_),
+        bloom_probe_(encoded_key_slice()) {
   }
 
   // RowSetKeyProbes are usually allocated on the stack, which means that we
@@ -186,16 +262,16 @@ class RowSetKeyProbe {
   // Still, the ConstContiguousRow row_key_ remains a reference to the data
   // underlying the original RowsetKeyProbe and is not copied.
   explicit RowSetKeyProbe(const RowSetKeyProbe& probe)
-  : row_key_(probe.row_key_) {
-    encoded_key_ = EncodedKey::FromContiguousRow(row_key_);
-    bloom_probe_ = BloomKeyProbe(encoded_key_slice());
+      : row_key_(probe.row_key_),
+        encoded_key_(row_key_),
+        bloom_probe_(encoded_key_slice()) {
   }
 
   const ConstContiguousRow& row_key() const { return row_key_; }
 
   // Pointer to the key which has been encoded to be contiguous
   // and lexicographically comparable
-  const Slice &encoded_key_slice() const { return encoded_key_->encoded_key(); }
+  const Slice &encoded_key_slice() const { return encoded_key_.encoded_key(); }
 
   // Return the cached structure used to query bloom filters.
   const BloomKeyProbe &bloom_probe() const { return bloom_probe_; }
@@ -204,12 +280,12 @@ class RowSetKeyProbe {
   const Schema* schema() const { return row_key_.schema(); }
 
   const EncodedKey &encoded_key() const {
-    return *encoded_key_;
+    return encoded_key_;
   }
 
  private:
   const ConstContiguousRow row_key_;
-  gscoped_ptr<EncodedKey> encoded_key_;
+  const EncodedKey encoded_key_;
   BloomKeyProbe bloom_probe_;
 };
 
@@ -224,7 +300,10 @@ struct ProbeStats {
     : blooms_consulted(0),
       keys_consulted(0),
       deltas_consulted(0),
-      mrs_consulted(0) {
+      mrs_consulted(0),
+      mrs_filter_skips(0),
+      mrs_filter_hits(0),
+      mrs_filter_misses(0) {
   }
 
   // Incremented for each bloom filter consulted.
@@ -238,6 +317,18 @@ struct ProbeStats {
 
   // Incremented for each MemRowSet consulted.
   int mrs_consulted;
+
+  // Incremented when the MemRowSet's key filter showed that a key was never
+  // inserted there, so that the MemRowSet wasn't consulted.
+  int mrs_filter_skips;
+
+  // Incremented when an upsert which passed the MemRowSet's key filter found
+  // its key in the MemRowSet, so that no other rowset was consulted.
+  int mrs_filter_hits;
+
+  // Incremented when an upsert which passed the MemRowSet's key filter
+  // didn't find its key in the MemRowSet.
+  int mrs_filter_misses;
 };
 
 // RowSet which is used during the middle of a flush or compaction.
@@ -271,11 +362,40 @@ class DuplicatingRowSet : public RowSet {
 
   Status CountRows(rowid_t *count) const OVERRIDE;
 
+  // The rows are scanned, since they're duplicated in the input and output
+  // rowsets.
+  Status CountVisibleRows(const MvccSnapshot& snap, int64_t* count,
+                          bool* counted) const OVERRIDE {
+    *counted = false;
+    return Status::OK();
+  }
+
   virtual Status GetBounds(std::string* min_encoded_key,
                            std::string* max_encoded_key) const OVERRIDE;
 
   uint64_t EstimateOnDiskSize() const OVERRIDE;
 
+  // Returns the statistics of the output rowsets, like CountRows().
+  Status GetColumnStatistics(const Schema& schema, int col_idx,
+                             ColumnStatisticsPB* stats) const OVERRIDE;
+
+  // Samples the output rowsets. The keys are in key order within each of them.
+  Status GetKeySamples(int num_samples, std::vector<std::string>* keys) const OVERRIDE;
+
+  // The output rowsets may not hold all of the input rows yet.
+  bool GetCachedChecksum(const Schema& projection, const MvccSnapshot& snap,
+                         uint64_t* checksum, int64_t* num_rows) const OVERRIDE {
+    return false;
+  }
+
+  // The input rowsets are about to be replaced, so their blocks aren't
+  // worth keeping in the cache.
+  void GetHotBlocks(HotBlocksPB* hot_blocks) const OVERRIDE {}
+
+  Status WarmUpBlockCache(const HotBlocksPB& hot_blocks, int* num_loaded) OVERRIDE {
+    return Status::OK();
+  }
+
   string ToString() const OVERRIDE;
 
   virtual Status DebugDump(vector<string> *lines = NULL) OVERRIDE;
@@ -302,6 +422,25 @@ class DuplicatingRowSet : public RowSet {
     return 0;
   }
 
+  int64_t CountAncientDeletedRows(Timestamp ancient_history_mark) const OVERRIDE {
+    return 0;
+  }
+
+  Status CheckAllRowsDeleted(Timestamp ancient_history_mark, bool* all_deleted) const OVERRIDE {
+    *all_deleted = false;
+    return Status::OK();
+  }
+
+  int64_t EstimateBytesInAncientUndoDeltas(Timestamp ancient_history_mark) const OVERRIDE {
+    return 0;
+  }
+
+  Status GCAncientUndoDeltas(Timestamp ancient_history_mark,
+                             int64_t* rewrite_budget_bytes,
+                             int64_t* bytes_reclaimed) OVERRIDE {
+    return Status::OK();
+  }
+
   int64_t MinUnflushedLogIndex() const OVERRIDE { return -1; }
 
   Status FlushDeltas() OVERRIDE {
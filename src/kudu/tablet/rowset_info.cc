@@ -23,6 +23,7 @@
 #include <string>
 #include <utility>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <inttypes.h>
 
@@ -32,8 +33,17 @@
 #include "kudu/gutil/strings/util.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/rowset_tree.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/slice.h"
 
+DEFINE_double(compaction_deleted_rows_weight, 1.0,
+              "How strongly the compaction policy favors rowsets containing rows "
+              "deleted before the ancient history mark. A rowset whose rows are all "
+              "deleted is valued as if it were (1 + weight) times wider. "
+              "0 disables the preference.");
+TAG_FLAG(compaction_deleted_rows_weight, experimental);
+TAG_FLAG(compaction_deleted_rows_weight, advanced);
+
 using std::shared_ptr;
 using std::unordered_map;
 using std::vector;
@@ -161,14 +171,17 @@ void CheckCollectOrderedCorrectness(const vector<RowSetInfo>& min_key,
 
 // RowSetInfo class ---------------------------------------------------
 
-void RowSetInfo::Collect(const RowSetTree& tree, vector<RowSetInfo>* rsvec) {
+void RowSetInfo::Collect(const RowSetTree& tree,
+                         Timestamp ancient_history_mark,
+                         vector<RowSetInfo>* rsvec) {
   rsvec->reserve(tree.all_rowsets().size());
   for (const shared_ptr<RowSet>& ptr : tree.all_rowsets()) {
-    rsvec->push_back(RowSetInfo(ptr.get(), 0));
+    rsvec->push_back(RowSetInfo(ptr.get(), 0, ancient_history_mark));
   }
 }
 
 void RowSetInfo::CollectOrdered(const RowSetTree& tree,
+                                Timestamp ancient_history_mark,
                                 vector<RowSetInfo>* min_key,
                                 vector<RowSetInfo>* max_key) {
   // Resize
@@ -225,7 +238,7 @@ void RowSetInfo::CollectOrdered(const RowSetTree& tree,
 
     // Add/remove current RowSetInfo
     if (rse.endpoint_ == RowSetTree::START) {
-      min_key->push_back(RowSetInfo(rs, total_width));
+      min_key->push_back(RowSetInfo(rs, total_width, ancient_history_mark));
       // Store reference from vector. This is safe b/c of reserve() above.
       active.insert(std::make_pair(rs, &min_key->back()));
     } else if (rse.endpoint_ == RowSetTree::STOP) {
@@ -251,13 +264,23 @@ void RowSetInfo::CollectOrdered(const RowSetTree& tree,
   FinalizeCDFVector(max_key, total_width);
 }
 
-RowSetInfo::RowSetInfo(RowSet* rs, double init_cdf)
+RowSetInfo::RowSetInfo(RowSet* rs, double init_cdf, Timestamp ancient_history_mark)
   : rowset_(rs),
     size_bytes_(rs->EstimateOnDiskSize()),
     size_mb_(std::max(implicit_cast<int>(size_bytes_ / 1024 / 1024), kMinSizeMb)),
     cdf_min_key_(init_cdf),
-    cdf_max_key_(init_cdf) {
+    cdf_max_key_(init_cdf),
+    deleted_fraction_(0),
+    value_(0),
+    density_(0) {
   has_bounds_ = rs->GetBounds(&min_key_, &max_key_).ok();
+
+  // Only count the rows if there's something to weigh them against.
+  int64_t deleted = rs->CountAncientDeletedRows(ancient_history_mark);
+  rowid_t num_rows;
+  if (deleted > 0 && rs->CountRows(&num_rows).ok() && num_rows > 0) {
+    deleted_fraction_ = std::min(1.0, static_cast<double>(deleted) / num_rows);
+  }
 }
 
 void RowSetInfo::FinalizeCDFVector(vector<RowSetInfo>* vec,
@@ -270,8 +293,9 @@ void RowSetInfo::FinalizeCDFVector(vector<RowSetInfo>* vec,
                                  << " bytes.";
     cdf_rs.cdf_min_key_ /= quot;
     cdf_rs.cdf_max_key_ /= quot;
-    cdf_rs.density_ = (cdf_rs.cdf_max_key() - cdf_rs.cdf_min_key())
-      / cdf_rs.size_mb_;
+    cdf_rs.value_ = cdf_rs.width() *
+        (1 + FLAGS_compaction_deleted_rows_weight * cdf_rs.deleted_fraction_);
+    cdf_rs.density_ = cdf_rs.value_ / cdf_rs.size_mb_;
   }
 }
 
@@ -280,6 +304,9 @@ string RowSetInfo::ToString() const {
   ret.append(rowset_->ToString());
   StringAppendF(&ret, "(% 3dM) [%.04f, %.04f]", size_mb_,
                 cdf_min_key_, cdf_max_key_);
+  if (deleted_fraction_ > 0) {
+    StringAppendF(&ret, " deleted=%.04f", deleted_fraction_);
+  }
   if (has_bounds_) {
     ret.append(" [").append(Slice(min_key_).ToDebugString());
     ret.append(",").append(Slice(max_key_).ToDebugString());
@@ -20,6 +20,8 @@
 #include <string>
 #include <vector>
 
+#include "kudu/common/timestamp.h"
+
 namespace kudu {
 namespace tablet {
 
@@ -34,10 +36,16 @@ class RowSetInfo {
  public:
 
   // Appends the rowsets in no order without the cdf values set.
-  static void Collect(const RowSetTree& tree, std::vector<RowSetInfo>* rsvec);
+  //
+  // Rows deleted before 'ancient_history_mark' are counted as reclaimable
+  // by compaction (see deleted_fraction()).
+  static void Collect(const RowSetTree& tree,
+                      Timestamp ancient_history_mark,
+                      std::vector<RowSetInfo>* rsvec);
   // Appends the rowsets in min-key and max-key sorted order, with
   // cdf values set.
   static void CollectOrdered(const RowSetTree& tree,
+                             Timestamp ancient_history_mark,
                              std::vector<RowSetInfo>* min_key,
                              std::vector<RowSetInfo>* max_key);
 
@@ -62,6 +70,15 @@ class RowSetInfo {
     return cdf_max_key_ - cdf_min_key_;
   }
 
+  // Return the estimated fraction of this rowset's rows which were deleted
+  // before the ancient history mark and would be dropped by a compaction.
+  double deleted_fraction() const { return deleted_fraction_; }
+
+  // Return the value of compacting this candidate: its width, increased in
+  // proportion to deleted_fraction() so that rowsets holding many deleted
+  // rows are preferred.
+  double value() const { return value_; }
+
   double density() const { return density_; }
 
   RowSet* rowset() const { return rowset_; }
@@ -76,7 +93,7 @@ class RowSetInfo {
   bool Intersects(const RowSetInfo& other) const;
 
  private:
-  explicit RowSetInfo(RowSet* rs, double init_cdf);
+  RowSetInfo(RowSet* rs, double init_cdf, Timestamp ancient_history_mark);
 
   static void FinalizeCDFVector(std::vector<RowSetInfo>* vec,
                                 double quot);
@@ -98,6 +115,12 @@ class RowSetInfo {
   std::string min_key_, max_key_;
 
   double cdf_min_key_, cdf_max_key_;
+
+  // Cached estimate of the fraction of rows deleted before the ancient
+  // history mark.
+  double deleted_fraction_;
+
+  double value_;
   double density_;
 };
 
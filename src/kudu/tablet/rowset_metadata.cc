@@ -31,6 +31,43 @@ using strings::Substitute;
 namespace kudu {
 namespace tablet {
 
+namespace {
+
+ColumnStatisticsPB WithoutSketch(const ColumnStatisticsPB& stats) {
+  ColumnStatisticsPB ret(stats);
+  ret.clear_ndv_sketch();
+  return ret;
+}
+
+// Replace the subsequence 'to_remove' of 'blocks' with 'to_add', appending the
+// removed blocks to 'removed'.
+Status ReplaceBlockSubsequence(const vector<BlockId>& to_remove,
+                               const vector<BlockId>& to_add,
+                               vector<BlockId>* blocks,
+                               vector<BlockId>* removed) {
+  CHECK(!to_remove.empty());
+
+  auto start_it = std::find(blocks->begin(), blocks->end(), to_remove[0]);
+
+  auto end_it = start_it;
+  for (const BlockId& b : to_remove) {
+    if (end_it == blocks->end() || *end_it != b) {
+      return Status::InvalidArgument(
+          Substitute("Cannot find subsequence <$0> in <$1>",
+                     BlockId::JoinStrings(to_remove),
+                     BlockId::JoinStrings(*blocks)));
+    }
+    ++end_it;
+  }
+
+  removed->insert(removed->end(), start_it, end_it);
+  start_it = blocks->erase(start_it, end_it);
+  blocks->insert(start_it, to_add.begin(), to_add.end());
+  return Status::OK();
+}
+
+} // anonymous namespace
+
 // ============================================================================
 //  RowSet Metadata
 // ============================================================================
@@ -73,6 +110,9 @@ Status RowSetMetadata::InitFromPB(const RowSetDataPB& pb) {
   for (const ColumnDataPB& col_pb : pb.columns()) {
     ColumnId col_id = ColumnId(col_pb.column_id());
     blocks_by_col_id_[col_id] = BlockId::FromPB(col_pb.block());
+    if (col_pb.has_stats()) {
+      stats_by_col_id_[col_id] = col_pb.stats();
+    }
   }
 
   // Load redo delta files
@@ -87,6 +127,10 @@ Status RowSetMetadata::InitFromPB(const RowSetDataPB& pb) {
     undo_delta_blocks_.push_back(BlockId::FromPB(undo_delta_pb.block()));
   }
 
+  if (pb.has_base_checksum()) {
+    base_checksum_ = pb.base_checksum();
+  }
+
   initted_ = true;
   return Status::OK();
 }
@@ -104,6 +148,10 @@ void RowSetMetadata::ToProtobuf(RowSetDataPB *pb) {
     ColumnDataPB *col_data = pb->add_columns();
     block_id.CopyToPB(col_data->mutable_block());
     col_data->set_column_id(col_id);
+    const ColumnStatisticsPB* stats = FindOrNull(stats_by_col_id_, col_id);
+    if (stats) {
+      col_data->mutable_stats()->CopyFrom(*stats);
+    }
   }
 
   // Write Delta Files
@@ -128,6 +176,10 @@ void RowSetMetadata::ToProtobuf(RowSetDataPB *pb) {
   if (!adhoc_index_block_.IsNull()) {
     adhoc_index_block_.CopyToPB(pb->mutable_adhoc_index_block());
   }
+
+  if (base_checksum_.has_checksum()) {
+    pb->mutable_base_checksum()->CopyFrom(base_checksum_);
+  }
 }
 
 const string RowSetMetadata::ToString() const {
@@ -139,6 +191,14 @@ void RowSetMetadata::SetColumnDataBlocks(const ColumnIdToBlockIdMap& blocks) {
   blocks_by_col_id_ = blocks;
 }
 
+void RowSetMetadata::SetColumnStatistics(const ColumnIdToStatsMap& stats) {
+  std::lock_guard<LockType> l(lock_);
+  stats_by_col_id_.clear();
+  for (const ColumnIdToStatsMap::value_type& e : stats) {
+    stats_by_col_id_[e.first] = WithoutSketch(e.second);
+  }
+}
+
 Status RowSetMetadata::CommitRedoDeltaDataBlock(int64_t dms_id,
                                                 const BlockId& block_id) {
   std::lock_guard<LockType> l(lock_);
@@ -158,27 +218,15 @@ Status RowSetMetadata::CommitUpdate(const RowSetMetadataUpdate& update) {
   {
     std::lock_guard<LockType> l(lock_);
 
-    for (const RowSetMetadataUpdate::ReplaceDeltaBlocks rep :
+    for (const RowSetMetadataUpdate::ReplaceDeltaBlocks& rep :
                   update.replace_redo_blocks_) {
-      CHECK(!rep.to_remove.empty());
-
-      auto start_it = std::find(redo_delta_blocks_.begin(),
-                                redo_delta_blocks_.end(), rep.to_remove[0]);
-
-      auto end_it = start_it;
-      for (const BlockId& b : rep.to_remove) {
-        if (end_it == redo_delta_blocks_.end() || *end_it != b) {
-          return Status::InvalidArgument(
-              Substitute("Cannot find subsequence <$0> in <$1>",
-                         BlockId::JoinStrings(rep.to_remove),
-                         BlockId::JoinStrings(redo_delta_blocks_)));
-        }
-        ++end_it;
-      }
-
-      removed.insert(removed.end(), start_it, end_it);
-      redo_delta_blocks_.erase(start_it, end_it);
-      redo_delta_blocks_.insert(start_it, rep.to_add.begin(), rep.to_add.end());
+      RETURN_NOT_OK(ReplaceBlockSubsequence(rep.to_remove, rep.to_add,
+                                            &redo_delta_blocks_, &removed));
+    }
+    for (const RowSetMetadataUpdate::ReplaceDeltaBlocks& rep :
+                  update.replace_undo_blocks_) {
+      RETURN_NOT_OK(ReplaceBlockSubsequence(rep.to_remove, rep.to_add,
+                                            &undo_delta_blocks_, &removed));
     }
 
     // Add new redo blocks
@@ -199,13 +247,25 @@ Status RowSetMetadata::CommitUpdate(const RowSetMetadataUpdate& update) {
       if (UpdateReturnCopy(&blocks_by_col_id_, e.first, e.second, &old_block_id)) {
         removed.push_back(old_block_id);
       }
+      const ColumnStatisticsPB* stats = FindOrNull(update.stats_to_replace_, e.first);
+      if (stats) {
+        stats_by_col_id_[e.first] = *stats;
+      } else {
+        stats_by_col_id_.erase(e.first);
+      }
     }
 
     for (ColumnId col_id : update.col_ids_to_remove_) {
       BlockId old = FindOrDie(blocks_by_col_id_, col_id);
       CHECK_EQ(1, blocks_by_col_id_.erase(col_id));
+      stats_by_col_id_.erase(col_id);
       removed.push_back(old);
     }
+
+    // The base data no longer has the rows that were checksummed.
+    if (!update.cols_to_replace_.empty() || !update.col_ids_to_remove_.empty()) {
+      base_checksum_.Clear();
+    }
   }
 
   // Should only be NULL in tests.
@@ -245,6 +305,13 @@ RowSetMetadataUpdate& RowSetMetadataUpdate::ReplaceColumnId(ColumnId col_id,
   return *this;
 }
 
+RowSetMetadataUpdate& RowSetMetadataUpdate::ReplaceColumnId(ColumnId col_id,
+                                                            const BlockId& block_id,
+                                                            const ColumnStatisticsPB& stats) {
+  InsertOrDie(&stats_to_replace_, col_id, WithoutSketch(stats));
+  return ReplaceColumnId(col_id, block_id);
+}
+
 RowSetMetadataUpdate& RowSetMetadataUpdate::RemoveColumnId(ColumnId col_id) {
   col_ids_to_remove_.push_back(col_id);
   return *this;
@@ -259,6 +326,14 @@ RowSetMetadataUpdate& RowSetMetadataUpdate::ReplaceRedoDeltaBlocks(
   return *this;
 }
 
+RowSetMetadataUpdate& RowSetMetadataUpdate::ReplaceUndoDeltaBlocks(
+    const std::vector<BlockId>& to_remove,
+    const std::vector<BlockId>& to_add) {
+  ReplaceDeltaBlocks rdb = { to_remove, to_add };
+  replace_undo_blocks_.push_back(rdb);
+  return *this;
+}
+
 RowSetMetadataUpdate& RowSetMetadataUpdate::SetNewUndoBlock(const BlockId& undo_block) {
   new_undo_block_ = undo_block;
   return *this;
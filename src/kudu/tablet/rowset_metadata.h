@@ -22,6 +22,7 @@
 #include <string>
 #include <vector>
 
+#include "kudu/common/common.pb.h"
 #include "kudu/common/schema.h"
 #include "kudu/fs/block_id.h"
 #include "kudu/fs/fs_manager.h"
@@ -64,6 +65,7 @@ class TabletMetadata;
 class RowSetMetadata {
  public:
   typedef std::map<ColumnId, BlockId> ColumnIdToBlockIdMap;
+  typedef std::map<ColumnId, ColumnStatisticsPB> ColumnIdToStatsMap;
 
   // Create a new RowSetMetadata
   static Status CreateNew(TabletMetadata* tablet_metadata,
@@ -99,6 +101,19 @@ class RowSetMetadata {
 
   void SetColumnDataBlocks(const ColumnIdToBlockIdMap& blocks_by_col_id);
 
+  // Set the statistics of the columns' data blocks.
+  //
+  // The distinct value sketches are not kept: the tablet metadata is
+  // rewritten on every flush and compaction, and the sketches are already in
+  // the CFile footers, which the open rowset holds in memory.
+  void SetColumnStatistics(const ColumnIdToStatsMap& stats_by_col_id);
+
+  // Set the checksum of the rows in the base data.
+  void SetBaseChecksum(const RowSetChecksumPB& checksum) {
+    std::lock_guard<LockType> l(lock_);
+    base_checksum_ = checksum;
+  }
+
   Status CommitRedoDeltaDataBlock(int64_t dms_id, const BlockId& block_id);
 
   Status CommitUndoDeltaDataBlock(const BlockId& block_id);
@@ -128,6 +143,24 @@ class RowSetMetadata {
     return blocks_by_col_id_;
   }
 
+  // Return false if the column has no data block, or if its block was written
+  // before statistics were recorded.
+  bool GetColumnStatistics(ColumnId col_id, ColumnStatisticsPB* stats) const {
+    std::lock_guard<LockType> l(lock_);
+    return FindCopy(stats_by_col_id_, col_id, stats);
+  }
+
+  // Return false if the rowset has no checksum of its base data, e.g.
+  // because it was rewritten by a major delta compaction.
+  bool GetBaseChecksum(RowSetChecksumPB* checksum) const {
+    std::lock_guard<LockType> l(lock_);
+    if (!base_checksum_.has_checksum()) {
+      return false;
+    }
+    *checksum = base_checksum_;
+    return true;
+  }
+
   vector<BlockId> redo_delta_blocks() const {
     std::lock_guard<LockType> l(lock_);
     return redo_delta_blocks_;
@@ -206,11 +239,16 @@ class RowSetMetadata {
 
   // Map of column ID to block ID.
   ColumnIdToBlockIdMap blocks_by_col_id_;
+  // Map of column ID to the statistics of its block.
+  ColumnIdToStatsMap stats_by_col_id_;
   std::vector<BlockId> redo_delta_blocks_;
   std::vector<BlockId> undo_delta_blocks_;
 
   int64_t last_durable_redo_dms_id_;
 
+  // Cleared whenever the base data is rewritten.
+  RowSetChecksumPB base_checksum_;
+
   DISALLOW_COPY_AND_ASSIGN(RowSetMetadata);
 };
 
@@ -230,19 +268,30 @@ class RowSetMetadataUpdate {
   RowSetMetadataUpdate& ReplaceRedoDeltaBlocks(const std::vector<BlockId>& to_remove,
                                                const std::vector<BlockId>& to_add);
 
-  // Replace the CFile for the given column ID.
+  // Replace the CFile for the given column ID. The statistics of the old
+  // CFile are dropped.
   RowSetMetadataUpdate& ReplaceColumnId(ColumnId col_id, const BlockId& block_id);
 
+  // Replace the CFile for the given column ID, along with its statistics
+  // (see RowSetMetadata::SetColumnStatistics()).
+  RowSetMetadataUpdate& ReplaceColumnId(ColumnId col_id, const BlockId& block_id,
+                                        const ColumnStatisticsPB& stats);
+
   // Remove the CFile for the given column ID.
   RowSetMetadataUpdate& RemoveColumnId(ColumnId col_id);
 
+  // Like ReplaceRedoDeltaBlocks(), but for UNDO delta blocks, e.g. to drop
+  // the ones which only hold ancient history.
+  RowSetMetadataUpdate& ReplaceUndoDeltaBlocks(const std::vector<BlockId>& to_remove,
+                                               const std::vector<BlockId>& to_add);
+
   // Add a new UNDO delta block to the list of UNDO files.
-  // We'll need to replace them instead when we start GCing.
   RowSetMetadataUpdate& SetNewUndoBlock(const BlockId& undo_block);
 
  private:
   friend class RowSetMetadata;
   RowSetMetadata::ColumnIdToBlockIdMap cols_to_replace_;
+  RowSetMetadata::ColumnIdToStatsMap stats_to_replace_;
   std::vector<ColumnId> col_ids_to_remove_;
   std::vector<BlockId> new_redo_blocks_;
 
@@ -251,6 +300,7 @@ class RowSetMetadataUpdate {
     std::vector<BlockId> to_add;
   };
   std::vector<ReplaceDeltaBlocks> replace_redo_blocks_;
+  std::vector<ReplaceDeltaBlocks> replace_undo_blocks_;
   BlockId new_undo_block_;
 
   DISALLOW_COPY_AND_ASSIGN(RowSetMetadataUpdate);
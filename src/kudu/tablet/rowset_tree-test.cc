@@ -15,11 +15,14 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <memory>
 #include <stdio.h>
 #include <unordered_set>
+#include <vector>
 
 #include "kudu/gutil/map-util.h"
 #include "kudu/tablet/mock-rowsets.h"
@@ -28,9 +31,12 @@
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_int32(rowset_tree_flat_index_max_entries);
+
 using std::shared_ptr;
 using std::string;
 using std::unordered_set;
+using std::vector;
 
 namespace kudu { namespace tablet {
 
@@ -104,6 +110,38 @@ TEST_F(TestRowSetTree, TestTree) {
   ASSERT_EQ(vec[2].get(), out[3]);
 }
 
+// Test that keys past either end of the bounded rowsets only find the
+// unbounded ones, as for rows appended with increasing keys.
+TEST_F(TestRowSetTree, TestKeysOutsideBoundedRowSets) {
+  RowSetVector vec;
+  vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet("1", "3")));
+  vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet("3", "5")));
+  vec.push_back(shared_ptr<RowSet>(new MockMemRowSet()));
+
+  RowSetTree tree;
+  ASSERT_OK(tree.Reset(vec));
+
+  for (const char* key : { "0", "6", "50" }) {
+    vector<RowSet *> out;
+    tree.FindRowSetsWithKeyInRange(key, &out);
+    ASSERT_EQ(1, out.size()) << key;
+    ASSERT_EQ(vec[2].get(), out[0]);
+  }
+
+  // The last bound itself is still in range.
+  vector<RowSet *> out;
+  tree.FindRowSetsWithKeyInRange("5", &out);
+  ASSERT_EQ(2, out.size());
+  ASSERT_EQ(vec[1].get(), out[1]);
+
+  // With only unbounded rowsets, every key finds them.
+  RowSetTree mrs_only;
+  ASSERT_OK(mrs_only.Reset({ vec[2] }));
+  out.clear();
+  mrs_only.FindRowSetsWithKeyInRange("2", &out);
+  ASSERT_EQ(1, out.size());
+}
+
 TEST_F(TestRowSetTree, TestPerformance) {
   const int kNumRowSets = 200;
   const int kNumQueries = AllowSlowTests() ? 1000000 : 10000;
@@ -128,6 +166,100 @@ TEST_F(TestRowSetTree, TestPerformance) {
   }
 }
 
+// The batched sweep must find exactly the rowsets the interval tree finds
+// for each key, including keys which fall on rowset bounds and duplicates.
+TEST_F(TestRowSetTree, TestBatchedLookupMatchesTree) {
+  const int kNumRowSets = 100;
+  const int kNumKeys = 2000;
+  SeedRandom();
+  RowSetVector vec = GenerateRandomRowSets(kNumRowSets);
+  vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet("5000", "5000")));
+  vec.push_back(shared_ptr<RowSet>(new MockMemRowSet()));
+
+  RowSetTree tree;
+  ASSERT_OK(tree.Reset(vec));
+
+  vector<string> key_strs;
+  for (int i = 0; i < kNumKeys; i++) {
+    key_strs.push_back(StringPrintf("%04d", rand() % 11000));
+  }
+  for (const auto& ep : tree.key_endpoints()) {
+    key_strs.push_back(ep.slice_.ToString());
+  }
+  std::sort(key_strs.begin(), key_strs.end());
+  vector<Slice> keys(key_strs.begin(), key_strs.end());
+
+  vector<vector<RowSet *>> batched;
+  tree.FindRowSetsWithKeysInRange(keys, &batched);
+  ASSERT_EQ(keys.size(), batched.size());
+  for (int i = 0; i < keys.size(); i++) {
+    vector<RowSet *> expected;
+    tree.FindRowSetsWithKeyInRange(keys[i], &expected);
+    std::sort(expected.begin(), expected.end());
+    std::sort(batched[i].begin(), batched[i].end());
+    ASSERT_EQ(expected, batched[i]) << "key " << keys[i].ToString();
+  }
+}
+
+// The flat index must find exactly the rowsets the interval tree finds, for
+// keys which share long prefixes too.
+TEST_F(TestRowSetTree, TestFlatIndexMatchesTree) {
+  const int kNumRowSets = 100;
+  const int kNumQueries = 2000;
+  SeedRandom();
+  auto random_key = []() {
+    return StringPrintf("prefix%d%04d", rand() % 2, rand() % 10000);
+  };
+  RowSetVector vec;
+  for (int i = 0; i < kNumRowSets; i++) {
+    string min = random_key();
+    string max = random_key();
+    if (max < min) {
+      min.swap(max);
+    }
+    vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet(min, max)));
+  }
+  vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet("prefix05000", "prefix05000")));
+  vec.push_back(shared_ptr<RowSet>(new MockMemRowSet()));
+
+  RowSetTree flat;
+  ASSERT_OK(flat.Reset(vec));
+  FLAGS_rowset_tree_flat_index_max_entries = 0;
+  RowSetTree tree;
+  ASSERT_OK(tree.Reset(vec));
+
+  vector<string> keys;
+  for (int i = 0; i < kNumQueries; i++) {
+    keys.push_back(random_key());
+  }
+  for (const auto& ep : tree.key_endpoints()) {
+    keys.push_back(ep.slice_.ToString());
+  }
+  keys.emplace_back("a");
+  keys.emplace_back("z");
+  for (int i = 0; i < keys.size(); i++) {
+    vector<RowSet *> expected;
+    vector<RowSet *> out;
+    tree.FindRowSetsWithKeyInRange(keys[i], &expected);
+    flat.FindRowSetsWithKeyInRange(keys[i], &out);
+    std::sort(expected.begin(), expected.end());
+    std::sort(out.begin(), out.end());
+    ASSERT_EQ(expected, out) << "key " << keys[i];
+
+    string upper = keys[rand() % keys.size()];
+    if (upper < keys[i]) {
+      continue;
+    }
+    expected.clear();
+    out.clear();
+    tree.FindRowSetsIntersectingInterval(keys[i], upper, &expected);
+    flat.FindRowSetsIntersectingInterval(keys[i], upper, &out);
+    std::sort(expected.begin(), expected.end());
+    std::sort(out.begin(), out.end());
+    ASSERT_EQ(expected, out) << "range " << keys[i] << " to " << upper;
+  }
+}
+
 TEST_F(TestRowSetTree, TestEndpointsConsistency) {
   const int kNumRowSets = 1000;
   RowSetVector vec = GenerateRandomRowSets(kNumRowSets);
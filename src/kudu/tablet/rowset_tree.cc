@@ -19,17 +19,31 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include <gflags/gflags.h>
+
+#include "kudu/gutil/endian.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/rowset_metadata.h"
 #include "kudu/util/interval_tree.h"
 #include "kudu/util/interval_tree-inl.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/mem_tracker.h"
 #include "kudu/util/slice.h"
 
+DEFINE_int32(rowset_tree_flat_index_max_entries, 1024 * 1024,
+             "Maximum number of rowset pointers held by the flat index of a tablet's "
+             "rowsets. The flat index stores the rowsets spanning each interval between "
+             "rowset bounds, so heavily overlapping rowsets may require many entries; past "
+             "this, lookups fall back to an interval tree.");
+TAG_FLAG(rowset_tree_flat_index_max_entries, advanced);
+
 using std::vector;
 using std::shared_ptr;
 
@@ -49,8 +63,182 @@ bool RSEndpointBySliceCompare(const RowSetTree::RSEndpoint& a,
   return false;
 }
 
+// Returns the first 8 bytes of 'key' as a big-endian integer, padded with
+// zeros. If prefix(a) < prefix(b) then a < b; keys with equal prefixes must be
+// compared in full.
+uint64_t KeyPrefix(const Slice& key) {
+  uint64_t prefix = 0;
+  memcpy(&prefix, key.data(), std::min<size_t>(key.size(), sizeof(prefix)));
+  return BigEndian::ToHost64(prefix);
+}
+
 } // anonymous namespace
 
+// A flattened index of the bounded rowsets of a RowSetTree.
+//
+// The distinct rowset bounds split the key space into elementary segments:
+// each bound itself, and the open interval between it and the next bound.
+// The rowsets spanning each segment are precomputed, so a point lookup comes
+// down to finding the last bound <= the key. For that, the 8-byte prefixes of
+// the bounds are laid out in an Eytzinger (BFS-ordered) array, which is
+// searched branch-free and with good cache locality; full keys are only
+// compared among bounds whose prefixes tie with the key's.
+class FlatRowSetIndex {
+ public:
+  // Builds the index from the sorted 'endpoints', or returns null if it would
+  // hold more than 'max_entries' rowset pointers.
+  static gscoped_ptr<FlatRowSetIndex> Build(const vector<RowSetTree::RSEndpoint>& endpoints,
+                                            int64_t max_entries) {
+    gscoped_ptr<FlatRowSetIndex> idx(new FlatRowSetIndex());
+    vector<RowSet*> active;
+    size_t i = 0;
+    idx->segment_offsets_.push_back(0);
+    while (i < endpoints.size()) {
+      const Slice& bound = endpoints[i].slice_;
+      idx->bounds_.push_back(bound);
+      idx->first_endpoint_.push_back(i);
+
+      // The rowsets spanning the bound itself.
+      idx->rowsets_.insert(idx->rowsets_.end(), active.begin(), active.end());
+      size_t group_end = i;
+      for (; group_end < endpoints.size() && endpoints[group_end].slice_ == bound; group_end++) {
+        if (endpoints[group_end].endpoint_ == RowSetTree::START) {
+          idx->rowsets_.push_back(endpoints[group_end].rowset_);
+          active.push_back(endpoints[group_end].rowset_);
+        }
+      }
+      idx->segment_offsets_.push_back(idx->rowsets_.size());
+
+      // The rowsets spanning the keys between the bound and the next one.
+      for (; i < group_end; i++) {
+        if (endpoints[i].endpoint_ == RowSetTree::STOP) {
+          auto it = std::find(active.begin(), active.end(), endpoints[i].rowset_);
+          DCHECK(it != active.end());
+          *it = active.back();
+          active.pop_back();
+        }
+      }
+      idx->rowsets_.insert(idx->rowsets_.end(), active.begin(), active.end());
+      idx->segment_offsets_.push_back(idx->rowsets_.size());
+
+      if (static_cast<int64_t>(idx->rowsets_.size()) > max_entries) {
+        return gscoped_ptr<FlatRowSetIndex>();
+      }
+    }
+    DCHECK(active.empty());
+    idx->first_endpoint_.push_back(endpoints.size());
+
+    idx->eytzinger_prefixes_.resize(idx->bounds_.size() + 1);
+    idx->eytzinger_ranks_.resize(idx->bounds_.size() + 1);
+    size_t rank = 0;
+    idx->FillEytzinger(1, &rank);
+    return idx.Pass();
+  }
+
+  // Appends the rowsets which may contain 'key'.
+  void FindContainingPoint(const Slice& key, vector<RowSet*>* rowsets) const {
+    ssize_t b = FindLastBoundAtOrBefore(key);
+    if (b < 0) {
+      return;
+    }
+    // Segment 2*b holds the rowsets spanning bounds_[b], and 2*b+1 those
+    // spanning the keys after it.
+    size_t segment = 2 * b + (bounds_[b] == key ? 0 : 1);
+    rowsets->insert(rowsets->end(),
+                    rowsets_.begin() + segment_offsets_[segment],
+                    rowsets_.begin() + segment_offsets_[segment + 1]);
+  }
+
+  // Appends the rowsets which may intersect [lower_bound, upper_bound].
+  void FindIntersectingInterval(const Slice& lower_bound, const Slice& upper_bound,
+                                const vector<RowSetTree::RSEndpoint>& endpoints,
+                                vector<RowSet*>* rowsets) const {
+    // The rowsets containing the lower bound, plus those starting after it
+    // and no later than the upper bound.
+    FindContainingPoint(lower_bound, rowsets);
+    size_t begin = first_endpoint_[FindLastBoundAtOrBefore(lower_bound) + 1];
+    size_t end = first_endpoint_[FindLastBoundAtOrBefore(upper_bound) + 1];
+    for (size_t i = begin; i < end; i++) {
+      if (endpoints[i].endpoint_ == RowSetTree::START) {
+        rowsets->push_back(endpoints[i].rowset_);
+      }
+    }
+  }
+
+  size_t memory_footprint() const {
+    return sizeof(*this) +
+        bounds_.capacity() * sizeof(Slice) +
+        eytzinger_prefixes_.capacity() * sizeof(uint64_t) +
+        (eytzinger_ranks_.capacity() + segment_offsets_.capacity()) * sizeof(uint32_t) +
+        first_endpoint_.capacity() * sizeof(uint32_t) +
+        rowsets_.capacity() * sizeof(RowSet*);
+  }
+
+ private:
+  FlatRowSetIndex() {}
+
+  // Fills the Eytzinger array rooted at 'k' with the bounds in order,
+  // starting from bounds_[*rank].
+  void FillEytzinger(size_t k, size_t* rank) {
+    if (k > bounds_.size()) {
+      return;
+    }
+    FillEytzinger(2 * k, rank);
+    eytzinger_prefixes_[k] = KeyPrefix(bounds_[*rank]);
+    eytzinger_ranks_[k] = *rank;
+    (*rank)++;
+    FillEytzinger(2 * k + 1, rank);
+  }
+
+  // Returns the index of the first bound whose prefix is greater than
+  // 'prefix' if 'inclusive' is true, or at least 'prefix' otherwise.
+  size_t SearchPrefix(uint64_t prefix, bool inclusive) const {
+    const size_t n = bounds_.size();
+    size_t k = 1;
+    while (k <= n) {
+      uint64_t p = eytzinger_prefixes_[k];
+      k = 2 * k + (inclusive ? p <= prefix : p < prefix);
+    }
+    // Undo the descents to the right made after the last descent to the left,
+    // which landed on the answer.
+    k >>= __builtin_ffsl(~k);
+    return k == 0 ? n : eytzinger_ranks_[k];
+  }
+
+  // Returns the index of the last bound <= 'key', or -1 if there isn't one.
+  ssize_t FindLastBoundAtOrBefore(const Slice& key) const {
+    uint64_t prefix = KeyPrefix(key);
+    // Bounds before 'lo' are smaller than the key, and those from 'hi' on
+    // are larger; only those in between need full comparisons.
+    size_t lo = SearchPrefix(prefix, false);
+    size_t hi = SearchPrefix(prefix, true);
+    auto it = std::upper_bound(bounds_.begin() + lo, bounds_.begin() + hi, key,
+                               [](const Slice& a, const Slice& b) {
+                                 return a.compare(b) < 0;
+                               });
+    return static_cast<ssize_t>(it - bounds_.begin()) - 1;
+  }
+
+  // The distinct rowset bounds, in order.
+  vector<Slice> bounds_;
+
+  // The prefixes of the bounds in Eytzinger order, starting at index 1, and
+  // the index in 'bounds_' of each.
+  vector<uint64_t> eytzinger_prefixes_;
+  vector<uint32_t> eytzinger_ranks_;
+
+  // The rowsets spanning segment 's' are rowsets_[segment_offsets_[s]] up to
+  // rowsets_[segment_offsets_[s + 1]], with two segments per bound.
+  vector<uint32_t> segment_offsets_;
+  vector<RowSet*> rowsets_;
+
+  // The index of the first endpoint at each bound, followed by the number of
+  // endpoints.
+  vector<uint32_t> first_endpoint_;
+
+  DISALLOW_COPY_AND_ASSIGN(FlatRowSetIndex);
+};
+
 // Entry for use in the interval tree.
 struct RowSetWithBounds {
   RowSet *rowset;
@@ -129,8 +317,11 @@ Status RowSetTree::Reset(const RowSetVector &rowsets) {
   // Install the vectors into the object.
   entries_.swap(entries);
   unbounded_rowsets_.swap(unbounded);
-  tree_.reset(new IntervalTree<RowSetIntervalTraits>(entries_));
   key_endpoints_.swap(endpoints);
+  flat_ = FlatRowSetIndex::Build(key_endpoints_, FLAGS_rowset_tree_flat_index_max_entries);
+  if (!flat_) {
+    tree_.reset(new IntervalTree<RowSetIntervalTraits>(entries_));
+  }
   all_rowsets_.assign(rowsets.begin(), rowsets.end());
 
   // Build the mapping from DRS ID to DRS.
@@ -146,6 +337,30 @@ Status RowSetTree::Reset(const RowSetVector &rowsets) {
   return Status::OK();
 }
 
+size_t RowSetTree::memory_footprint() const {
+  size_t size = sizeof(*this);
+  for (const RowSetWithBounds* e : entries_) {
+    size += sizeof(*e) + e->min_key.capacity() + e->max_key.capacity();
+  }
+  if (flat_) {
+    size += flat_->memory_footprint();
+  } else {
+    // Each interval is held by a single node of the interval tree, in both of
+    // the node's sorted lists.
+    size += entries_.size() * 2 * sizeof(RowSetWithBounds*);
+  }
+  size += entries_.capacity() * sizeof(RowSetWithBounds*);
+  size += key_endpoints_.capacity() * sizeof(RSEndpoint);
+  size += (all_rowsets_.capacity() + unbounded_rowsets_.capacity()) * sizeof(shared_ptr<RowSet>);
+  size += drs_by_id_.size() * (sizeof(std::pair<int64_t, RowSet*>) + 2 * sizeof(void*));
+  return size;
+}
+
+void RowSetTree::TrackMemory(shared_ptr<MemTracker> tracker) {
+  DCHECK(initted_);
+  mem_consumption_.reset(new ScopedTrackedConsumption(std::move(tracker), memory_footprint()));
+}
+
 void RowSetTree::FindRowSetsIntersectingInterval(const Slice &lower_bound,
                                                  const Slice &upper_bound,
                                                  vector<RowSet *> *rowsets) const {
@@ -156,6 +371,11 @@ void RowSetTree::FindRowSetsIntersectingInterval(const Slice &lower_bound,
     rowsets->push_back(rs.get());
   }
 
+  if (flat_) {
+    flat_->FindIntersectingInterval(lower_bound, upper_bound, key_endpoints_, rowsets);
+    return;
+  }
+
   // perf TODO: make it possible to query using raw Slices
   // instead of copying to strings here
   RowSetWithBounds query;
@@ -180,6 +400,19 @@ void RowSetTree::FindRowSetsWithKeyInRange(const Slice &encoded_key,
     rowsets->push_back(rs.get());
   }
 
+  // Keys outside of every bounded rowset, such as those appended past the
+  // end of the tablet, need not query the interval tree.
+  if (key_endpoints_.empty() ||
+      encoded_key.compare(key_endpoints_.back().slice_) > 0 ||
+      encoded_key.compare(key_endpoints_.front().slice_) < 0) {
+    return;
+  }
+
+  if (flat_) {
+    flat_->FindContainingPoint(encoded_key, rowsets);
+    return;
+  }
+
   // Query the interval tree to efficiently find rowsets with known bounds
   // whose ranges overlap the probe key.
   vector<RowSetWithBounds *> from_tree;
@@ -191,6 +424,52 @@ void RowSetTree::FindRowSetsWithKeyInRange(const Slice &encoded_key,
   }
 }
 
+void RowSetTree::FindRowSetsWithKeysInRange(const vector<Slice>& encoded_keys,
+                                            vector<vector<RowSet *>>* rowsets) const {
+  DCHECK(initted_);
+  rowsets->clear();
+  rowsets->resize(encoded_keys.size());
+
+  // The rowsets whose range started before the current key and has not yet
+  // stopped before it.
+  vector<RowSet *> active;
+  size_t ep_idx = 0;
+  for (size_t i = 0; i < encoded_keys.size(); i++) {
+    const Slice& key = encoded_keys[i];
+    DCHECK(i == 0 || encoded_keys[i - 1].compare(key) <= 0) << "keys must be sorted";
+
+    // Consume every endpoint strictly before the key. Since bounds are
+    // inclusive, endpoints equal to the key are handled below.
+    for (; ep_idx < key_endpoints_.size() &&
+           key_endpoints_[ep_idx].slice_.compare(key) < 0; ep_idx++) {
+      const RSEndpoint& ep = key_endpoints_[ep_idx];
+      if (ep.endpoint_ == START) {
+        active.push_back(ep.rowset_);
+      } else {
+        auto it = std::find(active.begin(), active.end(), ep.rowset_);
+        DCHECK(it != active.end());
+        *it = active.back();
+        active.pop_back();
+      }
+    }
+
+    vector<RowSet *>* out = &(*rowsets)[i];
+    out->reserve(unbounded_rowsets_.size() + active.size());
+    for (const shared_ptr<RowSet> &rs : unbounded_rowsets_) {
+      out->push_back(rs.get());
+    }
+    out->insert(out->end(), active.begin(), active.end());
+
+    // Rowsets which start exactly at the key contain it too.
+    for (size_t j = ep_idx; j < key_endpoints_.size() &&
+           key_endpoints_[j].slice_.compare(key) == 0; j++) {
+      if (key_endpoints_[j].endpoint_ == START) {
+        out->push_back(key_endpoints_[j].rowset_);
+      }
+    }
+  }
+}
+
 RowSetTree::~RowSetTree() {
   STLDeleteElements(&entries_);
 }
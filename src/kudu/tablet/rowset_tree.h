@@ -17,6 +17,7 @@
 #ifndef KUDU_TABLET_ROWSET_MANAGER_H
 #define KUDU_TABLET_ROWSET_MANAGER_H
 
+#include <memory>
 #include <unordered_map>
 #include <vector>
 #include <utility>
@@ -28,11 +29,15 @@
 
 namespace kudu {
 
+class MemTracker;
+class ScopedTrackedConsumption;
+
 template<class Traits>
 class IntervalTree;
 
 namespace tablet {
 
+class FlatRowSetIndex;
 struct RowSetIntervalTraits;
 struct RowSetWithBounds;
 
@@ -73,6 +78,15 @@ class RowSetTree {
   void FindRowSetsWithKeyInRange(const Slice &encoded_key,
                                  std::vector<RowSet *> *rowsets) const;
 
+  // Batched equivalent of FindRowSetsWithKeyInRange(): for each of the
+  // 'encoded_keys', which must be sorted, sets (*rowsets)[i] to the RowSets
+  // whose range may contain encoded_keys[i].
+  //
+  // Rather than querying the interval tree once per key, this sweeps the
+  // sorted key endpoints once alongside the keys.
+  void FindRowSetsWithKeysInRange(const std::vector<Slice>& encoded_keys,
+                                  std::vector<std::vector<RowSet *>>* rowsets) const;
+
   void FindRowSetsIntersectingInterval(const Slice &lower_bound,
                                        const Slice &upper_bound,
                                        std::vector<RowSet *> *rowsets) const;
@@ -88,9 +102,21 @@ class RowSetTree {
   // its stop slice, equivalent to its GetBounds() values.
   const std::vector<RSEndpoint>& key_endpoints() const { return key_endpoints_; }
 
+  // Returns an estimate of the memory used by the tree, excluding the rowsets.
+  size_t memory_footprint() const;
+
+  // Charges memory_footprint() to 'tracker' until the tree is destroyed.
+  // Must be called after Reset().
+  void TrackMemory(std::shared_ptr<MemTracker> tracker);
+
  private:
-  // Interval tree of the rowsets. Used to efficiently find rowsets which might contain
-  // a probe row.
+  // Flattened index of the rowsets, used to find the rowsets which might
+  // contain a probe row or intersect a range with a few searches of
+  // contiguous arrays. Null if it would have exceeded
+  // --rowset_tree_flat_index_max_entries, in which case tree_ is used.
+  gscoped_ptr<FlatRowSetIndex> flat_;
+
+  // Interval tree of the rowsets, used when there's no flat index.
   gscoped_ptr<IntervalTree<RowSetIntervalTraits> > tree_;
 
   // Ordered map of all the interval endpoints, holding the implicit contiguous
@@ -116,6 +142,8 @@ class RowSetTree {
   // stored in the interval tree.
   RowSetVector unbounded_rowsets_;
 
+  gscoped_ptr<ScopedTrackedConsumption> mem_consumption_;
+
   bool initted_;
 };
 
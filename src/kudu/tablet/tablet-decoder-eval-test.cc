@@ -52,14 +52,32 @@ public:
                                                                         DEFAULT_COMPRESSION)),
                                    ColumnSchema("string_val_b", STRING, true, NULL, NULL,
                                                 ColumnStorageAttributes(DICT_ENCODING,
+                                                                        DEFAULT_COMPRESSION)),
+                                   ColumnSchema("int_val_rle", INT32, true, NULL, NULL,
+                                                ColumnStorageAttributes(RLE,
+                                                                        DEFAULT_COMPRESSION)),
+                                   ColumnSchema("int_val_bshuf", INT32, true, NULL, NULL,
+                                                ColumnStorageAttributes(BIT_SHUFFLE,
+                                                                        DEFAULT_COMPRESSION)),
+                                   ColumnSchema("int_val_plain", INT32, true, NULL, NULL,
+                                                ColumnStorageAttributes(PLAIN_ENCODING,
                                                                         DEFAULT_COMPRESSION))}, 1))
   {}
 
+  // Indexes of the columns holding the same values with different encodings.
+  enum {
+    kDictStringCol = 2,
+    kRleIntCol = 3,
+    kBitShuffleIntCol = 4,
+    kPlainIntCol = 5
+  };
+
   void SetUp() override {
     KuduTabletTest::SetUp();
   }
 
-  void ScanAndFilter(size_t cardinality, size_t lower, size_t upper, int null_upper) {
+  void ScanAndFilter(size_t cardinality, size_t lower, size_t upper, int null_upper,
+                     int col_idx) {
     if (GetParam() == LARGE && !AllowSlowTests()) {
       LOG(INFO) << "Skipped large test case";
       return;
@@ -88,7 +106,7 @@ public:
     }
 
     for (int i = 0; i < FLAGS_decoder_eval_test_nrepeats; i++) {
-      TestTimedScanWithBounds(nrows, cardinality, strlen, lower, upper, &fetched);
+      TestTimedScanWithBounds(nrows, cardinality, strlen, lower, upper, col_idx, &fetched);
 
       // Calculate the expected count, potentially factoring in nulls.
       size_t expected_sel_count = ExpectedCount(nrows, cardinality, lower_not_null, upper);
@@ -100,12 +118,14 @@ public:
     }
   }
 
-  void TestScanAndFilter(size_t cardinality, size_t lower, size_t upper) {
-    ScanAndFilter(cardinality, lower, upper, -1);
+  void TestScanAndFilter(size_t cardinality, size_t lower, size_t upper,
+                         int col_idx = kDictStringCol) {
+    ScanAndFilter(cardinality, lower, upper, -1, col_idx);
   }
 
-  void TestNullableScanAndFilter(size_t cardinality, size_t lower, size_t upper, int null_upper) {
-    ScanAndFilter(cardinality, lower, upper, null_upper);
+  void TestNullableScanAndFilter(size_t cardinality, size_t lower, size_t upper, int null_upper,
+                                 int col_idx = kDictStringCol) {
+    ScanAndFilter(cardinality, lower, upper, null_upper, col_idx);
   }
 
   void FillTestTablet(size_t nrows, size_t cardinality, size_t strlen, int null_upper) {
@@ -120,9 +140,15 @@ public:
       if (static_cast<int>(i % cardinality) < null_upper) {
         CHECK_OK(row.SetNull(1));
         CHECK_OK(row.SetNull(2));
+        CHECK_OK(row.SetNull(kRleIntCol));
+        CHECK_OK(row.SetNull(kBitShuffleIntCol));
+        CHECK_OK(row.SetNull(kPlainIntCol));
       } else {
         CHECK_OK(row.SetStringCopy(1, LeftZeroPadded(i % cardinality, strlen)));
         CHECK_OK(row.SetStringCopy(2, LeftZeroPadded(i % cardinality, strlen)));
+        CHECK_OK(row.SetInt32(kRleIntCol, i % cardinality));
+        CHECK_OK(row.SetInt32(kBitShuffleIntCol, i % cardinality));
+        CHECK_OK(row.SetInt32(kPlainIntCol, i % cardinality));
       }
       ASSERT_OK_FAST(writer.Insert(row));
     }
@@ -130,20 +156,26 @@ public:
   }
 
   void TestTimedScanWithBounds(size_t nrows, size_t cardinality, size_t strlen, size_t lower_val,
-                               size_t upper_val, int* fetched) {
+                               size_t upper_val, int col_idx, int* fetched) {
     Arena arena(128, 1028);
     AutoReleasePool pool;
     ScanSpec spec;
 
     // Generate the predicate.
+    const ColumnSchema& col = schema_.column(col_idx);
     const std::string lower_string = LeftZeroPadded(lower_val, strlen);
     const std::string upper_string = LeftZeroPadded(upper_val, strlen);
-    Slice lower(lower_string);
-    Slice upper(upper_string);
-    auto string_pred = ColumnPredicate::Range(schema_.column(2), &lower, &upper);
+    Slice lower_slice(lower_string);
+    Slice upper_slice(upper_string);
+    int32_t lower_int = lower_val;
+    int32_t upper_int = upper_val;
+    if (col.type_info()->type() == STRING) {
+      spec.AddPredicate(ColumnPredicate::Range(col, &lower_slice, &upper_slice));
+    } else {
+      spec.AddPredicate(ColumnPredicate::Range(col, &lower_int, &upper_int));
+    }
 
     // Prepare the scan.
-    spec.AddPredicate(string_pred);
     spec.OptimizeScan(schema_, &arena, &pool, true);
     ScanSpec orig_spec = spec;
     gscoped_ptr<RowwiseIterator> iter;
@@ -154,7 +186,7 @@ public:
 
     // Execute and time the scan. Argument fetched is an output and will be set
     // to the number of rows returned in the result set.
-    LOG_TIMING(INFO, "Filtering by string value") {
+    LOG_TIMING(INFO, Substitute("Filtering by $0", col.name())) {
       ASSERT_OK(SilentIterateToStringList(iter.get(), fetched));
     }
   }
@@ -287,6 +319,39 @@ TEST_P(TabletDecoderEvalTest, NullableHighCardinality) {
   TestNullableScanAndFilter(50000, 30, 200, 75);
 }
 
+// The integer columns hold the same values as the dictionary-encoded string
+// columns, so the timings of these tests can be compared to the ones above.
+TEST_P(TabletDecoderEvalTest, LowCardinalityRleInts) {
+  TestScanAndFilter(50, FLAGS_decoder_eval_test_lower, FLAGS_decoder_eval_test_upper, kRleIntCol);
+}
+
+TEST_P(TabletDecoderEvalTest, LowCardinalityBitShuffleInts) {
+  TestScanAndFilter(50, FLAGS_decoder_eval_test_lower, FLAGS_decoder_eval_test_upper,
+                    kBitShuffleIntCol);
+}
+
+TEST_P(TabletDecoderEvalTest, LowCardinalityPlainInts) {
+  TestScanAndFilter(50, FLAGS_decoder_eval_test_lower, FLAGS_decoder_eval_test_upper,
+                    kPlainIntCol);
+}
+
+TEST_P(TabletDecoderEvalTest, HighCardinalityRleInts) {
+  TestScanAndFilter(50000, FLAGS_decoder_eval_test_lower, FLAGS_decoder_eval_test_upper,
+                    kRleIntCol);
+}
+
+TEST_P(TabletDecoderEvalTest, NullableRleInts) {
+  TestNullableScanAndFilter(1000, 30, 100, 50, kRleIntCol);
+}
+
+TEST_P(TabletDecoderEvalTest, NullableBitShuffleInts) {
+  TestNullableScanAndFilter(1000, 30, 100, 50, kBitShuffleIntCol);
+}
+
+TEST_P(TabletDecoderEvalTest, NullablePlainInts) {
+  TestNullableScanAndFilter(1000, 30, 100, 50, kPlainIntCol);
+}
+
 TEST_P(TabletDecoderEvalTest, MultipleColumns) {
   // Fill a tablet with pattern [0, 10) and query a:[0, 5) AND b:[3, 10).
   // To be considered correct, returned columns must align as they do in the
@@ -77,6 +77,12 @@ class TabletHarness {
     string root_dir;
     bool enable_metrics;
     ClockType clock_type;
+
+    // The compaction policy of a newly created tablet.
+    CompactionPolicyPB compaction_policy;
+
+    // The parent of the tablet's memory tracker. The root tracker if null.
+    std::shared_ptr<MemTracker> parent_mem_tracker;
   };
 
   TabletHarness(const Schema& schema, Options options)
@@ -93,15 +99,28 @@ class TabletHarness {
     RETURN_NOT_OK(fs_manager_->Open());
 
     scoped_refptr<TabletMetadata> metadata;
-    RETURN_NOT_OK(TabletMetadata::LoadOrCreate(fs_manager_.get(),
-                                               options_.tablet_id,
-                                               "KuduTableTest",
-                                               "KuduTableTestId",
-                                               schema_,
-                                               partition.first,
-                                               partition.second,
-                                               TABLET_DATA_READY,
-                                               &metadata));
+    if (first_time && options_.compaction_policy.ByteSize() > 0) {
+      RETURN_NOT_OK(TabletMetadata::CreateNew(fs_manager_.get(),
+                                              options_.tablet_id,
+                                              "KuduTableTest",
+                                              "KuduTableTestId",
+                                              schema_,
+                                              partition.first,
+                                              partition.second,
+                                              options_.compaction_policy,
+                                              TABLET_DATA_READY,
+                                              &metadata));
+    } else {
+      RETURN_NOT_OK(TabletMetadata::LoadOrCreate(fs_manager_.get(),
+                                                 options_.tablet_id,
+                                                 "KuduTableTest",
+                                                 "KuduTableTestId",
+                                                 schema_,
+                                                 partition.first,
+                                                 partition.second,
+                                                 TABLET_DATA_READY,
+                                                 &metadata));
+    }
     if (options_.enable_metrics) {
       metrics_registry_.reset(new MetricRegistry());
     }
@@ -114,7 +133,7 @@ class TabletHarness {
     }
     tablet_.reset(new Tablet(metadata,
                              clock_,
-                             std::shared_ptr<MemTracker>(),
+                             options_.parent_mem_tracker,
                              metrics_registry_.get(),
                              new log::LogAnchorRegistry()));
     return Status::OK();
@@ -261,6 +261,28 @@ TEST_F(TestTabletSchema, TestDeleteAndReAddColumn) {
   VerifyTabletRows(s2, keys);
 }
 
+// Test that scans don't reuse the projections of the columns of a previous
+// schema, even if a column was replaced by a column of the same type.
+TEST_F(TestTabletSchema, TestReplaceColumnWithSameType) {
+  std::vector<std::pair<string, string> > keys;
+  InsertRow(client_schema_, 1);
+  MutateRow(client_schema_, /* key= */ 1, /* col_idx= */ 1, /* new_val= */ 2);
+  keys.push_back(std::pair<string, string>("key=1", "c1=2"));
+  VerifyTabletRows(client_schema_, keys);
+
+  // Replace 'c1' with a new non-nullable INT32 column.
+  SchemaBuilder builder(tablet()->metadata()->schema());
+  ASSERT_OK(builder.RemoveColumn("c1"));
+  int32_t c1_default = 5;
+  ASSERT_OK(builder.AddColumn("c1", INT32, false, &c1_default, &c1_default));
+  AlterSchema(builder.Build());
+
+  // The same client projection now reads the new column.
+  keys.clear();
+  keys.push_back(std::pair<string, string>("key=1", "c1=5"));
+  VerifyTabletRows(client_schema_, keys);
+}
+
 // Verify modifying an empty MemRowSet
 TEST_F(TestTabletSchema, TestModifyEmptyMemRowSet) {
   std::vector<std::pair<string, string> > keys;
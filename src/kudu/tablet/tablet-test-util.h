@@ -68,6 +68,8 @@ class KuduTabletTest : public KuduTest {
     TabletHarness::Options opts(dir);
     opts.enable_metrics = true;
     opts.clock_type = clock_type_;
+    opts.compaction_policy = compaction_policy_;
+    opts.parent_mem_tracker = parent_mem_tracker_;
     bool first_time = harness_ == NULL;
     harness_.reset(new TabletHarness(schema_, opts));
     CHECK_OK(harness_->Create(first_time));
@@ -121,6 +123,14 @@ class KuduTabletTest : public KuduTest {
   const Schema client_schema_;
   const TabletHarness::Options::ClockType clock_type_;
 
+  // The compaction policy of the test tablet, which subclasses may set before
+  // it's created.
+  CompactionPolicyPB compaction_policy_;
+
+  // The parent of the test tablet's memory tracker, which subclasses may set
+  // before it's created.
+  std::shared_ptr<MemTracker> parent_mem_tracker_;
+
   gscoped_ptr<TabletHarness> harness_;
 };
 
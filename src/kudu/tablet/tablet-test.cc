@@ -15,22 +15,33 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
 #include <ctime>
+#include <limits>
+#include <map>
+#include <set>
 
 #include <glog/logging.h>
 
+#include "kudu/common/column_statistics.h"
 #include "kudu/common/iterator.h"
 #include "kudu/common/row.h"
 #include "kudu/common/scan_spec.h"
+#include "kudu/gutil/casts.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/join.h"
 #include "kudu/tablet/deltafile.h"
 #include "kudu/tablet/local_tablet_writer.h"
+#include "kudu/tablet/row_checksum.h"
 #include "kudu/tablet/tablet.h"
 #include "kudu/tablet/tablet-test-base.h"
+#include "kudu/tablet/tablet_metrics.h"
+#include "kudu/util/mem_tracker.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/test_macros.h"
 
+DECLARE_int32(tablet_reverse_scan_chunk_size_bytes);
+
 using std::shared_ptr;
 using std::unordered_set;
 
@@ -91,6 +102,22 @@ TYPED_TEST(TestTablet, TestFlush) {
   ASSERT_EQ(dfr->delta_stats().delete_count(), max_rows);
 }
 
+// The memory of the readers and structures of the flushed rowsets is charged
+// to children of the tablet's tracker.
+TYPED_TEST(TestTablet, TestMemoryBreakdown) {
+  this->InsertTestRows(0, 100, 0);
+  ASSERT_OK(this->tablet()->Flush());
+
+  for (const char* id : { Tablet::kCFileReaderMemTrackerId,
+                          Tablet::kBloomFilterMemTrackerId,
+                          Tablet::kRowSetTreeMemTrackerId }) {
+    SCOPED_TRACE(id);
+    shared_ptr<MemTracker> tracker;
+    ASSERT_TRUE(MemTracker::FindTracker(id, &tracker, this->tablet()->mem_tracker()));
+    ASSERT_GT(tracker->consumption(), 0);
+  }
+}
+
 // Test that historical data for a row is maintained even after the row
 // is flushed from the memrowset.
 TYPED_TEST(TestTablet, TestInsertsAndMutationsAreUndoneWithMVCCAfterFlush) {
@@ -448,6 +475,117 @@ TYPED_TEST(TestTablet, TestRowIteratorOrdered) {
   }
 }
 
+// Test that a REVERSE_ORDERED iterator returns the rows of every rowset and
+// the memrowset in descending key order, whether it reads the tablet in one
+// chunk or many.
+TYPED_TEST(TestTablet, TestRowIteratorReverseOrdered) {
+  const int kNumRows = 128;
+  const int kNumBatches = 4;
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+  for (int i = 0; i < kNumBatches; i++) {
+    ASSERT_OK(this->tablet()->Flush());
+    for (int j = 0; j < kNumRows; j++) {
+      if (j % kNumBatches == i) {
+        CHECK_OK(this->InsertTestRow(&writer, 654321+j, j));
+      }
+    }
+  }
+
+  MvccSnapshot snap(*this->tablet()->mvcc_manager());
+  for (int chunk_size : { 8 * 1024 * 1024, 1 }) {
+    SCOPED_TRACE(chunk_size);
+    FLAGS_tablet_reverse_scan_chunk_size_bytes = chunk_size;
+    gscoped_ptr<RowwiseIterator> iter;
+    ASSERT_OK(this->tablet()->NewRowIterator(this->client_schema_, snap,
+                                             Tablet::REVERSE_ORDERED, &iter));
+    ASSERT_OK(iter->Init(nullptr));
+
+    vector<string> rows;
+    RowBlock block(this->schema_, 10, &this->arena_);
+    while (iter->HasNext()) {
+      ASSERT_OK(iter->NextBlock(&block));
+      for (int j = 0; j < block.nrows(); j++) {
+        ASSERT_TRUE(block.selection_vector()->IsRowSelected(j));
+        faststring encoded;
+        this->client_schema_.EncodeComparableKey(block.row(j), &encoded);
+        rows.push_back(encoded.ToString());
+      }
+    }
+    ASSERT_EQ(kNumRows, rows.size());
+    for (int j = 1; j < rows.size(); j++) {
+      ASSERT_GT(rows[j-1], rows[j]);
+    }
+  }
+}
+
+// Test that a resumable scan can be continued by new iterators, even after
+// the memrowset it was reading is flushed, but not once the rowsets it
+// started with are compacted away.
+TYPED_TEST(TestTablet, TestResumableRowIterator) {
+  const int kNumRows = 128;
+  const int kNumBatches = 4;
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+  // Three disk rowsets and the memrowset, with interleaved keys.
+  for (int i = 0; i < kNumBatches; i++) {
+    if (i > 0) {
+      ASSERT_OK(this->tablet()->Flush());
+    }
+    for (int j = 0; j < kNumRows; j++) {
+      if (j % kNumBatches == i) {
+        CHECK_OK(this->InsertTestRow(&writer, j, j));
+      }
+    }
+  }
+
+  // Read ten rows at a time, each time with a new iterator, flushing the
+  // memrowset while the scan reads it.
+  MvccSnapshot snap(*this->tablet()->mvcc_manager());
+  unordered_set<string> keys;
+  ScanResumePosition position;
+  bool resuming = false;
+  bool flushed = false;
+  while (true) {
+    gscoped_ptr<RowwiseIterator> iter;
+    ASSERT_OK(this->tablet()->NewResumableRowIterator(this->client_schema_, snap,
+                                                      resuming ? &position : nullptr,
+                                                      &iter));
+    ASSERT_OK(iter->Init(nullptr));
+    if (!iter->HasNext()) {
+      break;
+    }
+    RowBlock block(this->schema_, 10, &this->arena_);
+    ASSERT_OK(iter->NextBlock(&block));
+    for (int j = 0; j < block.nrows(); j++) {
+      if (block.selection_vector()->IsRowSelected(j)) {
+        faststring encoded;
+        this->client_schema_.EncodeComparableKey(block.row(j), &encoded);
+        ASSERT_TRUE(keys.insert(encoded.ToString()).second) << "row returned twice";
+      }
+    }
+    ASSERT_TRUE(down_cast<Tablet::Iterator*>(iter.get())->GetResumePosition(&position));
+    ASSERT_EQ(3, position.rowset_block_ids.size());
+    resuming = true;
+    if (!flushed && position.rowset_idx == 3) {
+      ASSERT_OK(this->tablet()->Flush());
+      flushed = true;
+    }
+  }
+  ASSERT_TRUE(flushed);
+  ASSERT_EQ(kNumRows, keys.size());
+
+  // Compacting the rowsets of a scan prevents it from being resumed.
+  gscoped_ptr<RowwiseIterator> iter;
+  ASSERT_OK(this->tablet()->NewResumableRowIterator(this->client_schema_, snap, nullptr, &iter));
+  ASSERT_OK(iter->Init(nullptr));
+  RowBlock block(this->schema_, 10, &this->arena_);
+  ASSERT_OK(iter->NextBlock(&block));
+  ASSERT_TRUE(down_cast<Tablet::Iterator*>(iter.get())->GetResumePosition(&position));
+  ASSERT_OK(this->tablet()->Compact(Tablet::FORCE_COMPACT_ALL));
+  ASSERT_OK(this->tablet()->NewResumableRowIterator(this->client_schema_, snap, &position, &iter));
+  Status s = iter->Init(nullptr);
+  ASSERT_TRUE(s.IsIllegalState()) << s.ToString();
+}
+
 
 template<class SETUP>
 bool TestSetupExpectsNulls(int32_t key_idx) {
@@ -577,8 +715,9 @@ TYPED_TEST(TestTablet, TestUpsert) {
   vector<string> rows;
   this->UpsertTestRows(0, 1, 1000);
 
-  // UPSERT a row that is in MRS.
+  // UPSERT a row that is in MRS. The MRS's key filter sends it straight there.
   this->UpsertTestRows(0, 1, 1001);
+  ASSERT_EQ(1, this->tablet()->metrics()->mrs_filter_hits->value());
 
   ASSERT_OK(this->IterateToStringList(&rows));
   EXPECT_EQ(vector<string>{ this->setup_.FormatDebugRow(0, 1001, false) }, rows);
@@ -650,6 +789,49 @@ TYPED_TEST(TestTablet, TestMultipleUpdates) {
   ASSERT_EQ(this->setup_.FormatDebugRow(1, 0, false), out_rows[1]);
 }
 
+// Test that increments add to the latest value of a row, wherever it is.
+TYPED_TEST(TestTablet, TestIncrement) {
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+  int col_idx = this->schema_.num_key_columns() == 1 ? 2 : 3;
+  auto Increment = [&](int64_t key_idx, int32_t amount) {
+    KuduPartialRow row(&this->client_schema_);
+    this->setup_.BuildRowKey(&row, key_idx);
+    CHECK_OK(row.SetInt32(col_idx, amount));
+    return writer.Increment(row);
+  };
+
+  // Increments of missing rows fail.
+  Status s = Increment(0, 1);
+  ASSERT_TRUE(s.IsNotFound()) << s.ToString();
+
+  // Increment a row in the MemRowSet.
+  ASSERT_OK(this->InsertTestRow(&writer, 0, 10));
+  ASSERT_OK(Increment(0, 5));
+  ASSERT_EQ(0L, writer.last_op_result().mutated_stores(0).mrs_id());
+  vector<string> rows;
+  ASSERT_OK(this->IterateToStringList(&rows));
+  ASSERT_EQ(vector<string>{ this->setup_.FormatDebugRow(0, 15, false) }, rows);
+
+  // Increment it in a DiskRowSet, on top of an update.
+  ASSERT_OK(this->tablet()->Flush());
+  ASSERT_OK(this->UpdateTestRow(&writer, 0, 100));
+  ASSERT_OK(Increment(0, -120));
+  ASSERT_EQ(0L, writer.last_op_result().mutated_stores(0).rs_id());
+  ASSERT_OK(this->IterateToStringList(&rows));
+  ASSERT_EQ(vector<string>{ this->setup_.FormatDebugRow(0, -20, false) }, rows);
+
+  // Overflowing increments fail and leave the row as it was.
+  s = Increment(0, std::numeric_limits<int32_t>::min());
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  ASSERT_OK(this->IterateToStringList(&rows));
+  ASSERT_EQ(vector<string>{ this->setup_.FormatDebugRow(0, -20, false) }, rows);
+
+  // Deleted rows can't be incremented.
+  ASSERT_OK(this->DeleteTestRow(&writer, 0));
+  s = Increment(0, 1);
+  ASSERT_TRUE(s.IsNotFound()) << s.ToString();
+}
+
 TYPED_TEST(TestTablet, TestCompaction) {
   uint64_t max_rows = this->ClampRowCount(FLAGS_testcompaction_num_rows);
 
@@ -937,6 +1119,268 @@ TYPED_TEST(TestTablet, TestCompactionWithConcurrentMutation) {
   }
 }
 
+// Test that the tablet merges the column statistics of its rowsets, and that
+// rows which haven't been flushed aren't reflected.
+TYPED_TEST(TestTablet, TestColumnStatistics) {
+  // Two flushed rowsets, plus a rowset's worth of rows left in the MemRowSet.
+  const int64_t kRowsPerRowSet = this->ClampRowCount(1000) / 3;
+  std::map<string, ColumnStatisticsPB> stats;
+  ASSERT_OK(this->tablet()->GetColumnStatistics(&stats));
+  ASSERT_EQ(this->schema_.num_columns(), stats.size());
+  ASSERT_EQ(0, stats["key_idx"].num_rows());
+
+  for (int i = 0; i < 2; i++) {
+    this->InsertTestRows(i * kRowsPerRowSet, kRowsPerRowSet, 0);
+    ASSERT_OK(this->tablet()->Flush());
+  }
+  this->InsertTestRows(2 * kRowsPerRowSet, kRowsPerRowSet, 0);
+
+  ASSERT_OK(this->tablet()->GetColumnStatistics(&stats));
+  ASSERT_EQ(this->schema_.num_columns(), stats.size());
+  for (const auto& e : stats) {
+    SCOPED_TRACE(e.first);
+    ASSERT_EQ(2 * kRowsPerRowSet, e.second.num_rows());
+    ASSERT_GT(e.second.total_bytes(), 0);
+  }
+
+  // The key_idx column holds the index of each row.
+  const ColumnStatisticsPB& key_idx = stats["key_idx"];
+  ASSERT_EQ(0, key_idx.null_count());
+  ASSERT_EQ(0, *reinterpret_cast<const int32_t*>(key_idx.min_value().data()));
+  ASSERT_EQ(2 * kRowsPerRowSet - 1,
+            *reinterpret_cast<const int32_t*>(key_idx.max_value().data()));
+  int64_t ndv;
+  ASSERT_OK(EstimateDistinctValues(key_idx, &ndv));
+  ASSERT_NEAR(2 * kRowsPerRowSet, ndv, std::max<int64_t>(2, kRowsPerRowSet * 0.2));
+
+  // The statistics outlive a restart of the tablet.
+  this->TabletReOpen();
+  std::map<string, ColumnStatisticsPB> reopened_stats;
+  ASSERT_OK(this->tablet()->GetColumnStatistics(&reopened_stats));
+  ASSERT_EQ(this->schema_.num_columns(), reopened_stats.size());
+  ASSERT_EQ(key_idx.SerializeAsString(), reopened_stats["key_idx"].SerializeAsString());
+}
+
+TYPED_TEST(TestTablet, TestChecksumRows) {
+  // Checksums the rows in 'snap' by scanning the tablet, as checksum scans do.
+  auto scan_checksum = [&](const MvccSnapshot& snap, uint64_t* checksum, int64_t* num_rows) {
+    gscoped_ptr<RowwiseIterator> iter;
+    ASSERT_OK(this->tablet()->NewRowIterator(this->client_schema_, snap, Tablet::UNORDERED,
+                                             &iter));
+    ASSERT_OK(iter->Init(nullptr));
+    Arena arena(1024, 1024 * 1024);
+    RowBlock block(iter->schema(), 100, &arena);
+    RowChecksummer checksummer;
+    while (iter->HasNext()) {
+      arena.Reset();
+      ASSERT_OK(iter->NextBlock(&block));
+      for (size_t i = 0; i < block.nrows(); i++) {
+        if (block.selection_vector()->IsRowSelected(i)) {
+          checksummer.AddRow(iter->schema(), block.row(i));
+        }
+      }
+    }
+    *checksum = checksummer.checksum();
+    *num_rows = checksummer.num_rows();
+  };
+
+  // Two flushed rowsets, plus a rowset's worth of rows left in the MemRowSet.
+  const int64_t kRowsPerRowSet = this->ClampRowCount(1000) / 3;
+  this->InsertTestRows(0, kRowsPerRowSet, 0);
+  ASSERT_OK(this->tablet()->Flush());
+  MvccSnapshot first_snap(*this->tablet()->mvcc_manager());
+  this->InsertTestRows(kRowsPerRowSet, kRowsPerRowSet, 0);
+  ASSERT_OK(this->tablet()->Flush());
+  this->InsertTestRows(2 * kRowsPerRowSet, kRowsPerRowSet, 0);
+
+  uint64_t expected_checksum;
+  int64_t expected_rows;
+  uint64_t checksum;
+  int64_t num_rows;
+  int num_cached;
+  MvccSnapshot snap(*this->tablet()->mvcc_manager());
+  NO_FATALS(scan_checksum(snap, &expected_checksum, &expected_rows));
+  ASSERT_EQ(3 * kRowsPerRowSet, expected_rows);
+  ASSERT_OK(this->tablet()->ChecksumRows(snap, 4, &checksum, &num_rows, &num_cached));
+  ASSERT_EQ(expected_checksum, checksum);
+  ASSERT_EQ(expected_rows, num_rows);
+  ASSERT_EQ(2, num_cached);
+
+  // A mutated rowset is scanned again.
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+  ASSERT_OK(this->UpdateTestRow(&writer, 0, 12345));
+  snap = MvccSnapshot(*this->tablet()->mvcc_manager());
+  NO_FATALS(scan_checksum(snap, &expected_checksum, &expected_rows));
+  ASSERT_OK(this->tablet()->ChecksumRows(snap, 1, &checksum, &num_rows, &num_cached));
+  ASSERT_EQ(expected_checksum, checksum);
+  ASSERT_EQ(expected_rows, num_rows);
+  ASSERT_EQ(1, num_cached);
+
+  // So is a rowset with writes that the snapshot doesn't see.
+  NO_FATALS(scan_checksum(first_snap, &expected_checksum, &expected_rows));
+  ASSERT_EQ(kRowsPerRowSet, expected_rows);
+  ASSERT_OK(this->tablet()->ChecksumRows(first_snap, 4, &checksum, &num_rows, &num_cached));
+  ASSERT_EQ(expected_checksum, checksum);
+  ASSERT_EQ(expected_rows, num_rows);
+  ASSERT_EQ(0, num_cached);
+
+  // The cached checksums outlive a restart of the tablet.
+  this->TabletReOpen();
+  snap = MvccSnapshot(*this->tablet()->mvcc_manager());
+  NO_FATALS(scan_checksum(snap, &expected_checksum, &expected_rows));
+  ASSERT_OK(this->tablet()->ChecksumRows(snap, 4, &checksum, &num_rows, &num_cached));
+  ASSERT_EQ(expected_checksum, checksum);
+  ASSERT_EQ(1, num_cached);
+}
+
+TYPED_TEST(TestTablet, TestSplitKeyRange) {
+  const int64_t kRowsPerRowSet = this->ClampRowCount(1000) / 2;
+  vector<string> split_keys;
+  ASSERT_OK(this->tablet()->SplitKeyRange("", "", 1, &split_keys));
+  ASSERT_TRUE(split_keys.empty());
+
+  for (int i = 0; i < 2; i++) {
+    this->InsertTestRows(i * kRowsPerRowSet, kRowsPerRowSet, 0);
+    ASSERT_OK(this->tablet()->Flush());
+  }
+  uint64_t size = this->tablet()->EstimateOnDiskSize();
+  ASSERT_GT(size, 0);
+
+  // A chunk bigger than the tablet needs no split.
+  ASSERT_OK(this->tablet()->SplitKeyRange("", "", size * 2, &split_keys));
+  ASSERT_TRUE(split_keys.empty());
+
+  // Splitting into about four chunks yields ascending split keys.
+  ASSERT_OK(this->tablet()->SplitKeyRange("", "", size / 4, &split_keys));
+  ASSERT_GE(split_keys.size(), 2);
+  ASSERT_LE(split_keys.size(), 4);
+  for (int i = 1; i < split_keys.size(); i++) {
+    ASSERT_LT(split_keys[i - 1], split_keys[i]);
+  }
+
+  // The split keys of a sub-range fall within it.
+  const string& start = split_keys.front();
+  const string& stop = split_keys.back();
+  vector<string> sub_split_keys;
+  ASSERT_OK(this->tablet()->SplitKeyRange(start, stop, size / 16, &sub_split_keys));
+  ASSERT_FALSE(sub_split_keys.empty());
+  for (const string& key : sub_split_keys) {
+    ASSERT_GT(key, start);
+    ASSERT_LT(key, stop);
+  }
+}
+
+TYPED_TEST(TestTablet, TestEstimateSplitKey) {
+  const int64_t kRowsPerRowSet = this->ClampRowCount(1000) / 2;
+  string split_key;
+  ASSERT_OK(this->tablet()->EstimateSplitKey(&split_key));
+  ASSERT_TRUE(split_key.empty());
+
+  // A single rowset can't be split by its bounds.
+  this->InsertTestRows(0, kRowsPerRowSet, 0);
+  ASSERT_OK(this->tablet()->Flush());
+  ASSERT_OK(this->tablet()->EstimateSplitKey(&split_key));
+  ASSERT_TRUE(split_key.empty());
+
+  // Two rowsets of increasing keys are split between them, like SplitKeyRange()
+  // would split them in halves.
+  this->InsertTestRows(kRowsPerRowSet, kRowsPerRowSet, 0);
+  ASSERT_OK(this->tablet()->Flush());
+  ASSERT_OK(this->tablet()->EstimateSplitKey(&split_key));
+  ASSERT_FALSE(split_key.empty());
+  vector<string> split_keys;
+  ASSERT_OK(this->tablet()->SplitKeyRange("", split_key, 1, &split_keys));
+  ASSERT_FALSE(split_keys.empty());
+  ASSERT_OK(this->tablet()->SplitKeyRange(split_key, "", 1, &split_keys));
+  ASSERT_FALSE(split_keys.empty());
+}
+
+// Test point lookups of keys spread over the memrowset and a disk rowset,
+// including missing and deleted rows.
+TYPED_TEST(TestTablet, TestLookupRows) {
+  this->InsertTestRows(0, 10, 0);
+  ASSERT_OK(this->tablet()->Flush());
+  this->InsertTestRows(10, 10, 0);
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+  ASSERT_OK(this->DeleteTestRow(&writer, 3));
+  MvccSnapshot snap(*this->tablet()->mvcc_manager());
+  // Written after the snapshot, so not seen by it.
+  this->InsertTestRows(30, 1, 0);
+
+  // The keys must be passed in order; remember which row each one is.
+  std::map<string, int64_t> key_idx_by_key;
+  for (int64_t key_idx : { 1, 3, 5, 15, 25, 30 }) {
+    KuduPartialRow row(&this->client_schema_);
+    this->setup_.BuildRowKey(&row, key_idx);
+    string encoded;
+    ASSERT_OK(row.EncodeRowKey(&encoded));
+    key_idx_by_key[encoded] = key_idx;
+  }
+  vector<Slice> keys;
+  vector<int64_t> key_idxs;
+  for (const auto& e : key_idx_by_key) {
+    keys.emplace_back(e.first);
+    key_idxs.push_back(e.second);
+  }
+
+  Arena arena(1024, 1024 * 1024);
+  RowBlock block(this->client_schema_, keys.size(), &arena);
+  vector<int> found_keys;
+  ASSERT_OK(this->tablet()->LookupRows(this->client_schema_, snap, keys, &block, &found_keys));
+  ASSERT_EQ(3, block.nrows());
+  ASSERT_EQ(3, found_keys.size());
+  std::set<int64_t> found_key_idxs;
+  for (int i = 0; i < block.nrows(); i++) {
+    int64_t key_idx = key_idxs[found_keys[i]];
+    this->VerifyRow(block.row(i), key_idx, 0);
+    found_key_idxs.insert(key_idx);
+  }
+  ASSERT_EQ((std::set<int64_t>{ 1, 5, 15 }), found_key_idxs);
+
+  // Keys out of order are rejected.
+  std::swap(keys[0], keys[1]);
+  Status s = this->tablet()->LookupRows(this->client_schema_, snap, keys, &block, &found_keys);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+}
+
+// Test that rows are counted from the rowsets' metadata when their deltas
+// allow, and scanned otherwise.
+TYPED_TEST(TestTablet, TestCountRows) {
+  const int64_t kRowsPerRowSet = this->ClampRowCount(1000) / 2;
+  this->InsertTestRows(0, kRowsPerRowSet, 0);
+  ASSERT_OK(this->tablet()->Flush());
+  this->InsertTestRows(kRowsPerRowSet, kRowsPerRowSet, 0);
+  MvccSnapshot before_deletes(*this->tablet()->mvcc_manager());
+
+  int64_t count;
+  int num_scanned;
+  ASSERT_OK(this->tablet()->CountRows(before_deletes, &count, &num_scanned));
+  ASSERT_EQ(2 * kRowsPerRowSet, count);
+  ASSERT_EQ(0, num_scanned);
+
+  // Deletes in the DeltaMemStore require scanning the disk rowset, but not
+  // those in the MemRowSet.
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+  ASSERT_OK(this->DeleteTestRow(&writer, 0));
+  ASSERT_OK(this->DeleteTestRow(&writer, 1));
+  ASSERT_OK(this->DeleteTestRow(&writer, kRowsPerRowSet));
+  MvccSnapshot after_deletes(*this->tablet()->mvcc_manager());
+  ASSERT_OK(this->tablet()->CountRows(after_deletes, &count, &num_scanned));
+  ASSERT_EQ(2 * kRowsPerRowSet - 3, count);
+  ASSERT_EQ(1, num_scanned);
+
+  // Once flushed, the deletes are counted from the delta file's statistics.
+  ASSERT_OK(this->tablet()->FlushBiggestDMS());
+  ASSERT_OK(this->tablet()->CountRows(after_deletes, &count, &num_scanned));
+  ASSERT_EQ(2 * kRowsPerRowSet - 3, count);
+  ASSERT_EQ(0, num_scanned);
+
+  // They don't apply to an earlier snapshot, which is scanned.
+  ASSERT_OK(this->tablet()->CountRows(before_deletes, &count, &num_scanned));
+  ASSERT_EQ(2 * kRowsPerRowSet, count);
+  ASSERT_EQ(1, num_scanned);
+}
+
 // Test that metrics behave properly during tablet initialization
 TYPED_TEST(TestTablet, TestMetricsInit) {
   // Create a tablet, but do not open it
@@ -23,11 +23,16 @@
 #include <memory>
 #include <mutex>
 #include <ostream>
+#include <set>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "kudu/cfile/cfile_writer.h"
+#include "kudu/common/column_statistics.h"
+#include "kudu/common/encoded_key.h"
+#include "kudu/common/generic_iterators.h"
 #include "kudu/common/iterator.h"
 #include "kudu/common/row_changelist.h"
 #include "kudu/common/row_operations.h"
@@ -39,13 +44,16 @@
 #include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/walltime.h"
 #include "kudu/server/hybrid_clock.h"
 #include "kudu/tablet/compaction.h"
 #include "kudu/tablet/compaction_policy.h"
 #include "kudu/tablet/delta_compaction.h"
 #include "kudu/tablet/diskrowset.h"
+#include "kudu/tablet/row_checksum.h"
 #include "kudu/tablet/row_op.h"
 #include "kudu/tablet/rowset_info.h"
 #include "kudu/tablet/rowset_tree.h"
@@ -55,6 +63,7 @@
 #include "kudu/tablet/transactions/alter_schema_transaction.h"
 #include "kudu/tablet/transactions/write_transaction.h"
 #include "kudu/util/bloom_filter.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/env.h"
 #include "kudu/util/fault_injection.h"
@@ -65,6 +74,7 @@
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/stopwatch.h"
+#include "kudu/util/threadpool.h"
 #include "kudu/util/trace.h"
 #include "kudu/util/url-coding.h"
 
@@ -83,6 +93,53 @@ DEFINE_double(tablet_bloom_target_fp_rate, 0.0001f,
               "required for bloom filters.");
 TAG_FLAG(tablet_bloom_target_fp_rate, advanced);
 
+DEFINE_bool(tablet_bloom_blocked_layout, true,
+            "Whether to write tablet key bloom filters with all of a key's bits in a "
+            "single cache line. This makes each bloom probe a single cache miss at the "
+            "cost of slightly larger filters for the same false-positive rate. Filters "
+            "written with either layout can always be read.");
+TAG_FLAG(tablet_bloom_blocked_layout, advanced);
+
+DEFINE_bool(tablet_flush_mrs_directly, true,
+            "Whether to flush a MemRowSet by reading its rows straight into the "
+            "output blocks, rather than through the compaction input used to merge "
+            "rowsets. Both write the same rowsets.");
+TAG_FLAG(tablet_flush_mrs_directly, advanced);
+TAG_FLAG(tablet_flush_mrs_directly, runtime);
+
+DEFINE_bool(enable_undo_delta_block_gc, true,
+            "Whether to run a maintenance operation which discards UNDO deltas older "
+            "than --tablet_history_max_age_sec without rewriting the rest of their "
+            "rowsets. Otherwise they're only discarded by compactions.");
+TAG_FLAG(enable_undo_delta_block_gc, advanced);
+TAG_FLAG(enable_undo_delta_block_gc, runtime);
+
+DEFINE_int32(undo_delta_block_gc_rewrite_budget_mb, 128,
+             "Maximum amount of partly ancient UNDO delta files to rewrite without "
+             "their ancient mutations in each run of the UNDO delta block GC "
+             "operation. Files which are entirely ancient are deleted regardless.");
+TAG_FLAG(undo_delta_block_gc_rewrite_budget_mb, advanced);
+TAG_FLAG(undo_delta_block_gc_rewrite_budget_mb, runtime);
+
+DEFINE_int32(tablet_scan_readahead_budget_mb, 16,
+             "Maximum amount of memory each scan may hold in data blocks read "
+             "ahead of it in the background. 0 disables readahead.");
+TAG_FLAG(tablet_scan_readahead_budget_mb, advanced);
+
+DEFINE_int32(tablet_projection_cache_entries, 64,
+             "Maximum number of mapped scan projections cached by each tablet, "
+             "so that scans with a projection seen before skip resolving it "
+             "against the tablet schema. 0 disables the cache.");
+TAG_FLAG(tablet_projection_cache_entries, advanced);
+
+DEFINE_bool(tablet_batch_row_presence_checks, true,
+            "Whether to find the rowsets which may hold the rows of a write batch "
+            "for the whole batch at once, in key order, consulting each rowset's "
+            "bloom filter for all of the batch's keys together. Otherwise each row "
+            "is looked up individually as it is applied.");
+TAG_FLAG(tablet_batch_row_presence_checks, advanced);
+TAG_FLAG(tablet_batch_row_presence_checks, runtime);
+
 
 DEFINE_double(fault_crash_before_flush_tablet_meta_after_compaction, 0.0,
               "Fraction of the time, during compaction, to crash before flushing metadata");
@@ -114,6 +171,18 @@ DEFINE_int32(tablet_history_max_age_sec, 15 * 60,
              "To disable history removal, set to -1.");
 TAG_FLAG(tablet_history_max_age_sec, advanced);
 
+DEFINE_int32(tablet_max_hot_blocks, 1024,
+             "Maximum number of hot blocks of a tablet kept to warm up the "
+             "block cache with when the tablet is reopened or its replica "
+             "becomes leader.");
+TAG_FLAG(tablet_max_hot_blocks, advanced);
+
+DEFINE_int32(tablet_reverse_scan_chunk_size_bytes, 8 * 1024 * 1024,
+             "Approximate amount of on-disk data read at a time by scans in descending "
+             "key order, which are read in chunks from the end of their key range. "
+             "Larger chunks take more memory, since each is buffered to be reversed.");
+TAG_FLAG(tablet_reverse_scan_chunk_size_bytes, advanced);
+
 METRIC_DEFINE_entity(tablet);
 METRIC_DEFINE_gauge_size(tablet, memrowset_size, "MemRowSet Memory Usage",
                          kudu::MetricUnit::kBytes,
@@ -138,10 +207,6 @@ using strings::Substitute;
 namespace kudu {
 namespace tablet {
 
-static CompactionPolicy *CreateCompactionPolicy() {
-  return new BudgetedCompactionPolicy(FLAGS_tablet_compaction_budget_mb);
-}
-
 ////////////////////////////////////////////////////////////
 // TabletComponents
 ////////////////////////////////////////////////////////////
@@ -155,6 +220,19 @@ TabletComponents::TabletComponents(shared_ptr<MemRowSet> mrs,
 ////////////////////////////////////////////////////////////
 
 const char* Tablet::kDMSMemTrackerId = "DeltaMemStores";
+const char* Tablet::kCFileReaderMemTrackerId = "CFileReaders";
+const char* Tablet::kBloomFilterMemTrackerId = "BloomFilters";
+const char* Tablet::kRowSetTreeMemTrackerId = "RowSetTree";
+
+namespace {
+
+// Returns a row history ID which no tablet of this process has had before.
+uint64_t NewRowHistoryId() {
+  static AtomicInt<uint64_t> last_id(0);
+  return last_id.Increment();
+}
+
+} // anonymous namespace
 
 Tablet::Tablet(const scoped_refptr<TabletMetadata>& metadata,
                const scoped_refptr<server::Clock>& clock,
@@ -169,13 +247,37 @@ Tablet::Tablet(const scoped_refptr<TabletMetadata>& metadata,
                        parent_mem_tracker)),
     dms_mem_tracker_(MemTracker::CreateTracker(
         -1, kDMSMemTrackerId, mem_tracker_)),
+    cfile_reader_mem_tracker_(MemTracker::CreateTracker(
+        -1, kCFileReaderMemTrackerId, mem_tracker_)),
+    bloom_filter_mem_tracker_(MemTracker::CreateTracker(
+        -1, kBloomFilterMemTrackerId, mem_tracker_)),
+    rowset_tree_mem_tracker_(MemTracker::CreateTracker(
+        -1, kRowSetTreeMemTrackerId, mem_tracker_)),
+    compaction_mem_tracker_(MemTracker::CreateTracker(
+        -1, "Compactions", mem_tracker_)),
     next_mrs_id_(0),
     clock_(clock),
     mvcc_(clock),
+    last_write_timestamp_(Timestamp::kMin.ToUint64()),
+    row_history_id_(NewRowHistoryId()),
+    row_ttl_usec_(0),
+    row_ttl_cutoff_(std::numeric_limits<int64_t>::min()),
+    next_compaction_tracker_id_(0),
     rowsets_flush_sem_(1),
-    state_(kInitialized) {
+    state_(kInitialized),
+    next_readahead_tracker_id_(0),
+    compaction_encode_pool_(nullptr),
+    projection_cache_schema_(nullptr) {
       CHECK(schema()->has_column_ids());
-  compaction_policy_.reset(CreateCompactionPolicy());
+  compaction_policy_.reset(CreateCompactionPolicy(*schema(), metadata_->compaction_policy(),
+                                                   FLAGS_tablet_compaction_budget_mb));
+  Status ttl_status = ValidateRowTtl(*schema(), metadata_->compaction_policy());
+  if (ttl_status.ok()) {
+    row_ttl_usec_ = metadata_->compaction_policy().row_ttl_usec();
+  } else {
+    LOG_WITH_PREFIX(WARNING) << "Invalid row TTL, rows will not expire: "
+                             << ttl_status.ToString();
+  }
 
   if (metric_registry) {
     MetricEntity::AttributeMap attrs;
@@ -204,6 +306,10 @@ Tablet::Tablet(const scoped_refptr<TabletMetadata>& metadata,
 
 Tablet::~Tablet() {
   Shutdown();
+  compaction_mem_tracker_->UnregisterFromParent();
+  rowset_tree_mem_tracker_->UnregisterFromParent();
+  bloom_filter_mem_tracker_->UnregisterFromParent();
+  cfile_reader_mem_tracker_->UnregisterFromParent();
   dms_mem_tracker_->UnregisterFromParent();
   mem_tracker_->UnregisterFromParent();
 }
@@ -233,6 +339,7 @@ Status Tablet::Open() {
 
   shared_ptr<RowSetTree> new_rowset_tree(new RowSetTree());
   CHECK_OK(new_rowset_tree->Reset(rowsets_opened));
+  new_rowset_tree->TrackMemory(rowset_tree_mem_tracker_);
   // now that the current state is loaded, create the new MemRowSet with the next id
   shared_ptr<MemRowSet> new_mrs(new MemRowSet(next_mrs_id_++, *schema(),
                                               log_anchor_registry_.get(),
@@ -265,12 +372,50 @@ void Tablet::Shutdown() {
 Status Tablet::GetMappedReadProjection(const Schema& projection,
                                        Schema *mapped_projection) const {
   const Schema* cur_schema = schema();
-  return cur_schema->GetMappedReadProjection(projection, mapped_projection);
+  // Projections with IDs are invalid, and left for the schema to report.
+  if (FLAGS_tablet_projection_cache_entries <= 0 || projection.has_column_ids()) {
+    return cur_schema->GetMappedReadProjection(projection, mapped_projection);
+  }
+
+  // The mapping depends on the columns' names, types and nullability only.
+  // 'projection' and 'mapped_projection' may be the same object.
+  string key;
+  for (const ColumnSchema& col : projection.columns()) {
+    key.append(col.name());
+    key.push_back('\0');
+    key.push_back(static_cast<char>(col.type_info()->type()));
+    key.push_back(col.is_nullable() ? 1 : 0);
+  }
+  size_t num_key_columns = projection.num_key_columns();
+  key.append(reinterpret_cast<const char*>(&num_key_columns), sizeof(num_key_columns));
+  {
+    std::lock_guard<simple_spinlock> l(projection_cache_lock_);
+    if (projection_cache_schema_ == cur_schema) {
+      const shared_ptr<const Schema>* cached = FindOrNull(projection_cache_, key);
+      if (cached) {
+        *mapped_projection = **cached;
+        return Status::OK();
+      }
+    }
+  }
+
+  RETURN_NOT_OK(cur_schema->GetMappedReadProjection(projection, mapped_projection));
+  shared_ptr<const Schema> mapped(new Schema(*mapped_projection));
+  std::lock_guard<simple_spinlock> l(projection_cache_lock_);
+  if (projection_cache_schema_ != cur_schema ||
+      projection_cache_.size() >= FLAGS_tablet_projection_cache_entries) {
+    projection_cache_.clear();
+    projection_cache_schema_ = cur_schema;
+  }
+  projection_cache_[key] = std::move(mapped);
+  return Status::OK();
 }
 
 BloomFilterSizing Tablet::bloom_sizing() const {
   return BloomFilterSizing::BySizeAndFPRate(FLAGS_tablet_bloom_block_size,
-                                            FLAGS_tablet_bloom_target_fp_rate);
+                                            FLAGS_tablet_bloom_target_fp_rate,
+                                            FLAGS_tablet_bloom_blocked_layout ?
+                                            BLOCKED_BLOOM_LAYOUT : CLASSIC_BLOOM_LAYOUT);
 }
 
 Status Tablet::NewRowIterator(const Schema &projection,
@@ -285,15 +430,474 @@ Status Tablet::NewRowIterator(const Schema &projection,
                               const MvccSnapshot &snap,
                               const OrderMode order,
                               gscoped_ptr<RowwiseIterator> *iter) const {
+  return NewRowIterator(projection, snap, order, 1, iter);
+}
+
+Status Tablet::NewRowIterator(const Schema &projection,
+                              const MvccSnapshot &snap,
+                              const OrderMode order,
+                              int max_parallelism,
+                              gscoped_ptr<RowwiseIterator> *iter) const {
   CHECK_EQ(state_, kOpen);
+  DCHECK_GT(max_parallelism, 0);
   if (metrics_) {
     metrics_->scans_started->Increment();
   }
   VLOG_WITH_PREFIX(2) << "Created new Iterator under snap: " << snap.ToString();
-  iter->reset(new Iterator(this, projection, snap, order));
+  iter->reset(new Iterator(this, projection, snap, order, max_parallelism));
+  return Status::OK();
+}
+
+Status Tablet::NewResumableRowIterator(const Schema& projection,
+                                       const MvccSnapshot& snap,
+                                       const ScanResumePosition* resume_from,
+                                       gscoped_ptr<RowwiseIterator>* iter) const {
+  CHECK_EQ(state_, kOpen);
+  if (metrics_) {
+    metrics_->scans_started->Increment();
+  }
+  VLOG_WITH_PREFIX(2) << "Created new resumable Iterator under snap: " << snap.ToString();
+  gscoped_ptr<Iterator> tablet_iter(new Iterator(this, projection, snap, UNORDERED, 1));
+  tablet_iter->resume_position_.reset(resume_from != nullptr ?
+                                      new ScanResumePosition(*resume_from) :
+                                      new ScanResumePosition());
+  iter->reset(tablet_iter.release());
+  return Status::OK();
+}
+
+namespace {
+
+// Adds the rows of 'iter' to 'checksummer'.
+Status ChecksumIterator(const Schema& projection, RowwiseIterator* iter,
+                        RowChecksummer* checksummer) {
+  RETURN_NOT_OK(iter->Init(nullptr));
+  Arena arena(32 * 1024, 4 * 1024 * 1024);
+  RowBlock block(iter->schema(), 512, &arena);
+  while (iter->HasNext()) {
+    arena.Reset();
+    RETURN_NOT_OK(iter->NextBlock(&block));
+    for (size_t i = 0; i < block.nrows(); i++) {
+      if (block.selection_vector()->IsRowSelected(i)) {
+        checksummer->AddRow(projection, block.row(i));
+      }
+    }
+  }
+  return Status::OK();
+}
+
+} // anonymous namespace
+
+Status Tablet::ChecksumRows(const MvccSnapshot& snap,
+                            int max_parallelism,
+                            uint64_t* checksum,
+                            int64_t* num_rows,
+                            int* num_cached_rowsets) const {
+  CHECK_EQ(state_, kOpen);
+  DCHECK_GT(max_parallelism, 0);
+  if (metrics_) {
+    metrics_->scans_started->Increment();
+  }
+
+  // The iterators refer to the projection, so it must outlive them.
+  const Schema projection = *schema();
+  RowChecksummer total;
+  int num_cached = 0;
+  vector<shared_ptr<RowwiseIterator>> iters;
+  {
+    shared_lock<rw_spinlock> l(component_lock_);
+    gscoped_ptr<RowwiseIterator> ms_iter;
+    RETURN_NOT_OK(components_->memrowset->NewRowIterator(&projection, snap, &ms_iter));
+    iters.emplace_back(ms_iter.release());
+    for (const shared_ptr<RowSet>& rs : components_->rowsets->all_rowsets()) {
+      uint64_t rs_checksum;
+      int64_t rs_rows;
+      if (rs->GetCachedChecksum(projection, snap, &rs_checksum, &rs_rows)) {
+        total.Add(rs_checksum, rs_rows);
+        num_cached++;
+        continue;
+      }
+      gscoped_ptr<RowwiseIterator> row_it;
+      RETURN_NOT_OK_PREPEND(rs->NewRowIterator(&projection, snap, &row_it),
+                            Substitute("Could not create iterator for rowset $0",
+                                       rs->ToString()));
+      iters.emplace_back(row_it.release());
+    }
+  }
+
+  // Task 'i' checksums every 'num_tasks'th iterator from the 'i'th. The
+  // first task runs on this thread.
+  const int num_tasks = std::min<int>(max_parallelism, iters.size());
+  vector<uint64_t> task_checksums(num_tasks, 0);
+  vector<int64_t> task_rows(num_tasks, 0);
+  vector<Status> task_statuses(num_tasks);
+  auto run_task = [&](int task) {
+    RowChecksummer checksummer;
+    for (int i = task; i < iters.size(); i += num_tasks) {
+      Status s = ChecksumIterator(projection, iters[i].get(), &checksummer);
+      if (!s.ok()) {
+        task_statuses[task] = s;
+        return;
+      }
+    }
+    task_checksums[task] = checksummer.checksum();
+    task_rows[task] = checksummer.num_rows();
+  };
+
+  CountDownLatch latch(num_tasks - 1);
+  if (num_tasks > 1) {
+    ThreadPool* pool;
+    shared_ptr<MemTracker> mem_tracker;
+    RETURN_NOT_OK(GetScanPool(&pool, &mem_tracker));
+    for (int task = 1; task < num_tasks; task++) {
+      Status s = pool->SubmitFunc([&, task]() {
+          run_task(task);
+          latch.CountDown();
+        });
+      if (!s.ok()) {
+        task_statuses[task] = s;
+        latch.CountDown();
+      }
+    }
+  }
+  run_task(0);
+  latch.Wait();
+
+  for (int task = 0; task < num_tasks; task++) {
+    RETURN_NOT_OK(task_statuses[task]);
+    total.Add(task_checksums[task], task_rows[task]);
+  }
+  *checksum = total.checksum();
+  *num_rows = total.num_rows();
+  *num_cached_rowsets = num_cached;
+  return Status::OK();
+}
+
+namespace {
+
+// Reads the row of 'rs' visible in 'snap' whose key is in ['lower', 'upper'),
+// if any, projected onto 'projection', into 'dst'. 'upper' may be NULL if
+// 'lower' is the greatest possible key.
+Status LookupRowInRowSet(const RowSet& rs,
+                         const Schema& projection,
+                         const MvccSnapshot& snap,
+                         const EncodedKey& lower,
+                         const EncodedKey* upper,
+                         RowBlockRow* dst,
+                         bool* found) {
+  gscoped_ptr<RowwiseIterator> iter;
+  RETURN_NOT_OK(rs.NewRowIterator(&projection, snap, &iter));
+  ScanSpec spec;
+  spec.SetLowerBoundKey(&lower);
+  if (upper) {
+    spec.SetExclusiveUpperBoundKey(upper);
+  }
+  RETURN_NOT_OK(iter->Init(&spec));
+
+  Arena arena(256, 1024 * 1024);
+  RowBlock block(projection, 1, &arena);
+  *found = false;
+  while (!*found && iter->HasNext()) {
+    RETURN_NOT_OK(iter->NextBlock(&block));
+    if (block.nrows() > 0 && block.selection_vector()->IsRowSelected(0)) {
+      RETURN_NOT_OK(CopyRow(block.row(0), dst, dst->row_block()->arena()));
+      *found = true;
+    }
+  }
+  return Status::OK();
+}
+
+// Adds the value 'amount' to the value 'value' of a numeric column, in place.
+template<DataType Type>
+Status AddToCell(const void* amount, void* value) {
+  typedef typename DataTypeTraits<Type>::cpp_type T;
+  T a;
+  T v;
+  memcpy(&a, amount, sizeof(T));
+  memcpy(&v, value, sizeof(T));
+  if (std::numeric_limits<T>::is_integer &&
+      ((a > 0 && v > std::numeric_limits<T>::max() - a) ||
+       (a < 0 && v < std::numeric_limits<T>::min() - a))) {
+    return Status::InvalidArgument("INCREMENT overflows column value");
+  }
+  v += a;
+  memcpy(value, &v, sizeof(T));
+  return Status::OK();
+}
+
+// Encodes into 'buf' the update of the columns incremented by 'increments'
+// from their values in 'row' to their sums.
+Status ResolveIncrement(const Schema& schema,
+                        const RowChangeList& increments,
+                        const RowBlockRow& row,
+                        faststring* buf) {
+  RowChangeListDecoder decoder(increments);
+  RETURN_NOT_OK(decoder.Init());
+  RowChangeListEncoder encoder(buf);
+  while (decoder.HasNext()) {
+    RowChangeListDecoder::DecodedUpdate dec;
+    RETURN_NOT_OK(decoder.DecodeNext(&dec));
+    int col_idx;
+    const void* amount;
+    RETURN_NOT_OK(dec.Validate(schema, &col_idx, &amount));
+    if (PREDICT_FALSE(col_idx == Schema::kColumnNotFound || amount == nullptr)) {
+      return Status::InvalidArgument("invalid INCREMENT", increments.ToString(schema));
+    }
+    const ColumnSchema& col = schema.column(col_idx);
+    if (col.is_nullable() && row.is_null(col_idx)) {
+      return Status::InvalidArgument("INCREMENT of NULL value", col.ToString());
+    }
+
+    uint8_t sum[kLargestTypeSize];
+    memcpy(sum, row.cell_ptr(col_idx), col.type_info()->size());
+    switch (col.type_info()->physical_type()) {
+      case INT8: RETURN_NOT_OK(AddToCell<INT8>(amount, sum)); break;
+      case INT16: RETURN_NOT_OK(AddToCell<INT16>(amount, sum)); break;
+      case INT32: RETURN_NOT_OK(AddToCell<INT32>(amount, sum)); break;
+      case INT64: RETURN_NOT_OK(AddToCell<INT64>(amount, sum)); break;
+      case FLOAT: RETURN_NOT_OK(AddToCell<FLOAT>(amount, sum)); break;
+      case DOUBLE: RETURN_NOT_OK(AddToCell<DOUBLE>(amount, sum)); break;
+      default:
+        return Status::InvalidArgument("INCREMENT of non-numeric column", col.ToString());
+    }
+    encoder.AddColumnUpdate(col, schema.column_id(col_idx), sum);
+  }
+  return Status::OK();
+}
+
+} // anonymous namespace
+
+Status Tablet::LookupRows(const Schema& projection,
+                          const MvccSnapshot& snap,
+                          const vector<Slice>& encoded_keys,
+                          RowBlock* block,
+                          vector<int>* found_keys) const {
+  CHECK_EQ(state_, kOpen);
+  DCHECK_GE(block->row_capacity(), encoded_keys.size());
+  TRACE_EVENT1("tablet", "Tablet::LookupRows", "num_keys", encoded_keys.size());
+  if (metrics_) {
+    metrics_->scans_started->Increment();
+  }
+
+  // The iterators refer to the projection, so it must outlive them.
+  Schema mapped_projection;
+  RETURN_NOT_OK(GetMappedReadProjection(projection, &mapped_projection));
+
+  // Decode the keys into rows of the key schema, to probe the rowsets with,
+  // and into the bounds of the rows to read.
+  Arena arena(1024, 4 * 1024 * 1024);
+  const Schema* schema = this->schema();
+  vector<gscoped_ptr<RowSetKeyProbe>> probe_storage;
+  vector<const RowSetKeyProbe*> probes;
+  vector<gscoped_ptr<EncodedKey>> lower_bounds;
+  vector<gscoped_ptr<EncodedKey>> upper_bounds;
+  for (int i = 0; i < encoded_keys.size(); i++) {
+    if (i > 0 && encoded_keys[i - 1].compare(encoded_keys[i]) >= 0) {
+      return Status::InvalidArgument("keys must be sorted and unique");
+    }
+    gscoped_ptr<EncodedKey> decoded;
+    RETURN_NOT_OK_PREPEND(EncodedKey::DecodeEncodedString(*schema, &arena, encoded_keys[i],
+                                                          &decoded),
+                          "invalid key");
+    uint8_t* key_data = static_cast<uint8_t*>(arena.AllocateBytes(key_schema_.byte_size()));
+    if (PREDICT_FALSE(!key_data)) {
+      return Status::RuntimeError("Out of memory allocating row key");
+    }
+    for (int col = 0; col < key_schema_.num_columns(); col++) {
+      memcpy(key_data + key_schema_.column_offset(col), decoded->raw_keys()[col],
+             key_schema_.column(col).type_info()->size());
+    }
+    ConstContiguousRow key_row(&key_schema_, key_data);
+    probe_storage.emplace_back(new RowSetKeyProbe(key_row));
+    probes.push_back(probe_storage.back().get());
+    lower_bounds.emplace_back(EncodedKey::FromContiguousRow(key_row));
+    gscoped_ptr<EncodedKey> upper = EncodedKey::FromContiguousRow(key_row);
+    if (!EncodedKey::IncrementEncodedKey(key_schema_, &upper, &arena).ok()) {
+      // This is the greatest possible key.
+      upper.reset();
+    }
+    upper_bounds.push_back(std::move(upper));
+  }
+
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+  vector<ProbeStats> stats_storage(encoded_keys.size());
+  vector<ProbeStats*> stats;
+  for (ProbeStats& s : stats_storage) {
+    stats.push_back(&s);
+  }
+  vector<vector<RowSet*>> candidates;
+  FindRowSetsMaybeWithKeys(*comps.get(), probes, stats, &candidates);
+
+  // A key has at most one row visible in any snapshot, in the memrowset or
+  // in one of its candidate rowsets. Expired rows aren't visible at all.
+  int64_t row_ttl_cutoff;
+  const bool has_row_ttl = GetRowTtlCutoff(&row_ttl_cutoff);
+  found_keys->clear();
+  block->Resize(block->row_capacity());
+  for (int i = 0; i < encoded_keys.size(); i++) {
+    if (has_row_ttl &&
+        *reinterpret_cast<const int64_t*>(lower_bounds[i]->raw_keys()[0]) < row_ttl_cutoff) {
+      continue;
+    }
+    candidates[i].push_back(comps->memrowset.get());
+    RowBlockRow dst = block->row(found_keys->size());
+    for (const RowSet* rs : candidates[i]) {
+      bool found;
+      RETURN_NOT_OK_PREPEND(LookupRowInRowSet(*rs, mapped_projection, snap, *lower_bounds[i],
+                                              upper_bounds[i].get(), &dst, &found),
+                            Substitute("Could not look up key in rowset $0", rs->ToString()));
+      if (found) {
+        found_keys->push_back(i);
+        break;
+      }
+    }
+  }
+  block->Resize(found_keys->size());
+  block->selection_vector()->SetAllTrue();
+  return Status::OK();
+}
+
+Status Tablet::CountRows(const MvccSnapshot& snap, int64_t* count,
+                         int* num_scanned_rowsets) const {
+  CHECK_EQ(state_, kOpen);
+  TRACE_EVENT0("tablet", "Tablet::CountRows");
+  if (metrics_) {
+    metrics_->scans_started->Increment();
+  }
+
+  Schema projection;
+  RETURN_NOT_OK(GetMappedReadProjection(Schema(), &projection));
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+  vector<shared_ptr<RowSet>> rowsets = comps->rowsets->all_rowsets();
+  rowsets.push_back(comps->memrowset);
+
+  // With a row TTL, only the rowsets without expired rows are counted from
+  // their metadata; the others are scanned from the cutoff.
+  int64_t row_ttl_cutoff;
+  faststring cutoff_key_buf;
+  gscoped_ptr<EncodedKey> cutoff_key;
+  if (GetRowTtlCutoff(&row_ttl_cutoff)) {
+    EncodeRowTtlCutoff(row_ttl_cutoff, &cutoff_key_buf, &cutoff_key);
+  }
+
+  int64_t total = 0;
+  *num_scanned_rowsets = 0;
+  Arena arena(1024, 1024 * 1024);
+  for (const shared_ptr<RowSet>& rs : rowsets) {
+    bool may_have_expired_rows = false;
+    if (cutoff_key) {
+      if (RowSetExpired(*rs, cutoff_key->encoded_key())) {
+        continue;
+      }
+      string min_key;
+      string max_key;
+      may_have_expired_rows = !rs->GetBounds(&min_key, &max_key).ok() ||
+          Slice(min_key).compare(cutoff_key->encoded_key()) < 0;
+    }
+    if (!may_have_expired_rows) {
+      int64_t rs_count;
+      bool counted;
+      RETURN_NOT_OK(rs->CountVisibleRows(snap, &rs_count, &counted));
+      if (counted) {
+        total += rs_count;
+        continue;
+      }
+    }
+
+    (*num_scanned_rowsets)++;
+    gscoped_ptr<RowwiseIterator> iter;
+    RETURN_NOT_OK(rs->NewRowIterator(&projection, snap, &iter));
+    ScanSpec spec;
+    if (cutoff_key) {
+      spec.SetLowerBoundKey(cutoff_key.get());
+    }
+    RETURN_NOT_OK(iter->Init(&spec));
+    RowBlock block(projection, 1024, &arena);
+    while (iter->HasNext()) {
+      RETURN_NOT_OK_PREPEND(iter->NextBlock(&block),
+                            Substitute("Could not count rows of rowset $0", rs->ToString()));
+      total += block.selection_vector()->CountSelected();
+    }
+  }
+  *count = total;
+  return Status::OK();
+}
+
+void Tablet::GetHotBlocks(HotBlocksPB* hot_blocks) const {
+  hot_blocks->Clear();
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+  for (const shared_ptr<RowSet>& rs : comps->rowsets->all_rowsets()) {
+    rs->GetHotBlocks(hot_blocks);
+    if (hot_blocks->blocks_size() >= FLAGS_tablet_max_hot_blocks) {
+      break;
+    }
+  }
+  if (hot_blocks->blocks_size() > FLAGS_tablet_max_hot_blocks) {
+    hot_blocks->mutable_blocks()->DeleteSubrange(
+        FLAGS_tablet_max_hot_blocks,
+        hot_blocks->blocks_size() - FLAGS_tablet_max_hot_blocks);
+  }
+
+  std::set<int32_t> col_ids;
+  for (const auto& hot : hot_blocks->blocks()) {
+    if (hot.has_column_id()) {
+      col_ids.insert(hot.column_id());
+    }
+  }
+  for (int32_t col_id : col_ids) {
+    hot_blocks->add_column_ids(col_id);
+  }
+}
+
+Status Tablet::WarmUpBlockCache(const HotBlocksPB& hot_blocks, int* num_loaded) {
+  // The warmup runs in the background, and may race with shutting down.
+  if (state_ != kOpen) {
+    return Status::IllegalState("Tablet is not open", tablet_id());
+  }
+  TRACE_EVENT0("tablet", "Tablet::WarmUpBlockCache");
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+  *num_loaded = 0;
+  for (const shared_ptr<RowSet>& rs : comps->rowsets->all_rowsets()) {
+    RETURN_NOT_OK_PREPEND(rs->WarmUpBlockCache(hot_blocks, num_loaded),
+                          Substitute("Could not warm up the block cache for rowset $0",
+                                     rs->ToString()));
+  }
+  return Status::OK();
+}
+
+Status Tablet::GetScanPool(ThreadPool** pool, shared_ptr<MemTracker>* mem_tracker) const {
+  std::lock_guard<std::mutex> l(scan_pool_lock_);
+  if (!scan_pool_) {
+    RETURN_NOT_OK(ThreadPoolBuilder(Substitute("$0-scan", tablet_id().substr(0, 6)))
+                  .Build(&scan_pool_));
+    scan_mem_tracker_ = MemTracker::CreateTracker(-1, "ParallelScans", mem_tracker_);
+  }
+  *pool = scan_pool_.get();
+  *mem_tracker = scan_mem_tracker_;
   return Status::OK();
 }
 
+string Tablet::DataIOTarget() const {
+  if (!metadata_->data_dirs().empty()) {
+    return JoinStrings(metadata_->data_dirs(), ",");
+  }
+  return JoinStrings(metadata_->fs_manager()->GetDataRootDirs(), ",");
+}
+
+shared_ptr<MemTracker> Tablet::CreateScanReadaheadTracker() const {
+  int64_t id;
+  {
+    std::lock_guard<std::mutex> l(scan_pool_lock_);
+    id = next_readahead_tracker_id_++;
+  }
+  return MemTracker::CreateTracker(
+      static_cast<int64_t>(FLAGS_tablet_scan_readahead_budget_mb) * 1024 * 1024,
+      Substitute("ScanReadahead-$0", id), mem_tracker_);
+}
+
 Status Tablet::DecodeWriteOperations(const Schema* client_schema,
                                      WriteTransactionState* tx_state) {
   TRACE_EVENT0("tablet", "Tablet::DecodeWriteOperations");
@@ -310,7 +914,8 @@ Status Tablet::DecodeWriteOperations(const Schema* client_schema,
   vector<DecodedRowOperation> ops;
 
   // Decode the ops
-  RowOperationsPBDecoder dec(&tx_state->request()->row_operations(),
+  RowOperationsPBDecoder dec(tx_state->encoded_rows(),
+                             tx_state->encoded_indirect_data(),
                              client_schema,
                              schema(),
                              tx_state->arena());
@@ -336,8 +941,28 @@ Status Tablet::AcquireRowLocks(WriteTransactionState* tx_state) {
   TRACE_EVENT1("tablet", "Tablet::AcquireRowLocks",
                "num_locks", tx_state->row_ops().size());
   TRACE("PREPARE: Acquiring locks for $0 operations", tx_state->row_ops().size());
-  for (RowOp* op : tx_state->row_ops()) {
-    RETURN_NOT_OK(AcquireLockForOp(tx_state, op));
+  const vector<RowOp*>& ops = tx_state->row_ops();
+  if (ops.size() == 1) {
+    RETURN_NOT_OK(AcquireLockForOp(tx_state, ops[0]));
+    TRACE("PREPARE: locks acquired");
+    return Status::OK();
+  }
+
+  // Encode and validate all of the keys first, so that the whole batch
+  // can be handed to the lock manager in a single call.
+  vector<Slice> keys;
+  keys.reserve(ops.size());
+  for (RowOp* op : ops) {
+    ConstContiguousRow row_key(&key_schema_, op->decoded_op.row_data);
+    op->key_probe.reset(new tablet::RowSetKeyProbe(row_key));
+    RETURN_NOT_OK(CheckRowInTablet(row_key));
+    keys.push_back(op->key_probe->encoded_key_slice());
+  }
+
+  vector<ScopedRowLock> locks;
+  lock_manager_.LockBatch(keys, tx_state, LockManager::LOCK_EXCLUSIVE, &locks);
+  for (size_t i = 0; i < ops.size(); i++) {
+    ops[i]->row_lock = std::move(locks[i]);
   }
   TRACE("PREPARE: locks acquired");
   return Status::OK();
@@ -395,10 +1020,31 @@ Status Tablet::InsertOrUpsertUnlocked(WriteTransactionState *tx_state,
                                       ProbeStats* stats) {
   const bool is_upsert = op->decoded_op.type == RowOperationsPB::UPSERT;
   const TabletComponents* comps = DCHECK_NOTNULL(tx_state->tablet_components());
+  MemRowSet* mrs = comps->memrowset.get();
+
+  // A key which is live in the MemRowSet can't be live in any other rowset.
+  // Upserts of keys which were recently inserted, as with counters or
+  // session state, are then applied to the MemRowSet without consulting
+  // the flushed rowsets.
+  if (is_upsert && mrs->key_filter_selective() && mrs->MayContainKey(*op->key_probe)) {
+    bool present = false;
+    RETURN_NOT_OK(mrs->CheckRowPresent(*op->key_probe, &present, stats));
+    if (present) {
+      stats->mrs_filter_hits++;
+      return ApplyUpsertAsUpdate(tx_state, op, mrs, stats);
+    }
+    stats->mrs_filter_misses++;
+  }
 
   // First, ensure that it is a unique key by checking all the open RowSets.
+  // The current MemRowSet is skipped, since the Insert() below detects
+  // duplicates there anyway: for keys past the end of every flushed rowset,
+  // as with monotonically increasing keys, this leaves nothing to check.
   vector<RowSet *> to_check = FindRowSetsToCheck(op, comps);
   for (RowSet *rowset : to_check) {
+    if (rowset == comps->memrowset.get()) {
+      continue;
+    }
     bool present = false;
     RETURN_NOT_OK(rowset->CheckRowPresent(*op->key_probe, &present, stats));
     if (present) {
@@ -481,11 +1127,16 @@ vector<RowSet*> Tablet::FindRowSetsToCheck(RowOp* op,
                                            const TabletComponents* comps) {
   vector<RowSet*> to_check;
   if (PREDICT_TRUE(!op->orig_result_from_log_)) {
-    // TODO: could iterate the rowsets in a smart order
-    // based on recent statistics - eg if a rowset is getting
-    // updated frequently, pick that one first.
-    comps->rowsets->FindRowSetsWithKeyInRange(op->key_probe->encoded_key_slice(),
-                                              &to_check);
+    if (op->has_rowsets_to_check) {
+      to_check.swap(op->rowsets_to_check);
+      op->has_rowsets_to_check = false;
+    } else {
+      // TODO: could iterate the rowsets in a smart order
+      // based on recent statistics - eg if a rowset is getting
+      // updated frequently, pick that one first.
+      comps->rowsets->FindRowSetsWithKeyInRange(op->key_probe->encoded_key_slice(),
+                                                &to_check);
+    }
 #ifndef NDEBUG
     // The order in which the rowset tree returns its results doesn't have semantic
     // relevance. We've had bugs in the past (eg KUDU-1341) which were obscured by
@@ -539,20 +1190,25 @@ Status Tablet::MutateRowUnlocked(WriteTransactionState *tx_state,
 
   Timestamp ts = tx_state->timestamp();
 
-  // First try to update in memrowset.
-  s = comps->memrowset->MutateRow(ts,
-                            *mutate->key_probe,
-                            mutate->decoded_op.changelist,
-                            tx_state->op_id(),
-                            stats,
-                            result.get());
-  if (s.ok()) {
-    mutate->SetMutateSucceeded(std::move(result));
-    return s;
-  }
-  if (!s.IsNotFound()) {
-    mutate->SetFailed(s);
-    return s;
+  // First try to update in memrowset, unless its key filter shows that the
+  // key was never inserted there.
+  if (comps->memrowset->MayContainKey(*mutate->key_probe)) {
+    s = comps->memrowset->MutateRow(ts,
+                              *mutate->key_probe,
+                              mutate->decoded_op.changelist,
+                              tx_state->op_id(),
+                              stats,
+                              result.get());
+    if (s.ok()) {
+      mutate->SetMutateSucceeded(std::move(result));
+      return s;
+    }
+    if (!s.IsNotFound()) {
+      mutate->SetFailed(s);
+      return s;
+    }
+  } else {
+    stats->mrs_filter_skips++;
   }
 
   // Next, check the disk rowsets.
@@ -580,12 +1236,169 @@ Status Tablet::MutateRowUnlocked(WriteTransactionState *tx_state,
   return s;
 }
 
+Status Tablet::IncrementRowUnlocked(WriteTransactionState *tx_state,
+                                    RowOp* increment,
+                                    ProbeStats* stats) {
+  const TabletComponents* comps = DCHECK_NOTNULL(tx_state->tablet_components());
+  const Schema* schema = this->schema();
+
+  // The row lock keeps other transactions from mutating the row, so its
+  // latest version, including any earlier operations of this transaction,
+  // is the one the increments apply to.
+  MvccSnapshot snap = MvccSnapshot::CreateSnapshotIncludingAllTransactions();
+  Arena arena(1024, 1024 * 1024);
+  gscoped_ptr<EncodedKey> lower = EncodedKey::FromContiguousRow(increment->key_probe->row_key());
+  gscoped_ptr<EncodedKey> upper = EncodedKey::FromContiguousRow(increment->key_probe->row_key());
+  if (!EncodedKey::IncrementEncodedKey(key_schema_, &upper, &arena).ok()) {
+    // This is the greatest possible key.
+    upper.reset();
+  }
+
+  // As for other mutations, the memrowset is checked first.
+  vector<RowSet*> to_check = FindRowSetsToCheck(increment, comps);
+  to_check.insert(to_check.begin(), comps->memrowset.get());
+
+  RowBlock block(*schema, 1, &arena);
+  RowBlockRow row = block.row(0);
+  for (RowSet* rs : to_check) {
+    bool found;
+    Status s = LookupRowInRowSet(*rs, *schema, snap, *lower, upper.get(), &row, &found);
+    if (s.ok() && !found) {
+      continue;
+    }
+    faststring buf;
+    if (s.ok()) {
+      s = ResolveIncrement(*schema, increment->decoded_op.changelist, row, &buf);
+    }
+    gscoped_ptr<OperationResultPB> result(new OperationResultPB());
+    if (s.ok()) {
+      s = rs->MutateRow(tx_state->timestamp(),
+                        *increment->key_probe,
+                        RowChangeList(buf),
+                        tx_state->op_id(),
+                        stats,
+                        result.get());
+    }
+    if (s.ok()) {
+      increment->SetMutateSucceeded(std::move(result));
+    } else {
+      increment->SetFailed(s);
+    }
+    return s;
+  }
+
+  Status s = Status::NotFound("key not found");
+  increment->SetFailed(s);
+  return s;
+}
+
 void Tablet::StartApplying(WriteTransactionState* tx_state) {
   shared_lock<rw_spinlock> l(component_lock_);
   tx_state->StartApplying();
   tx_state->set_tablet_components(components_);
 }
 
+void Tablet::BatchFindRowSetsToCheck(WriteTransactionState* tx_state,
+                                     ProbeStats* stats_array) {
+  const TabletComponents* comps = DCHECK_NOTNULL(tx_state->tablet_components());
+  const vector<RowOp*>& row_ops = tx_state->row_ops();
+
+  // Ops replayed from the log already know which rowsets they apply to.
+  vector<int> order;
+  order.reserve(row_ops.size());
+  for (int i = 0; i < row_ops.size(); i++) {
+    if (PREDICT_TRUE(!row_ops[i]->orig_result_from_log_)) {
+      order.push_back(i);
+    }
+  }
+  if (order.size() < 2) {
+    return;
+  }
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+    return row_ops[a]->key_probe->encoded_key_slice().compare(
+        row_ops[b]->key_probe->encoded_key_slice()) < 0;
+  });
+
+  vector<const RowSetKeyProbe*> probes;
+  vector<ProbeStats*> stats;
+  probes.reserve(order.size());
+  stats.reserve(order.size());
+  for (int idx : order) {
+    probes.push_back(row_ops[idx]->key_probe.get());
+    stats.push_back(&stats_array[idx]);
+  }
+  vector<vector<RowSet*>> candidates;
+  FindRowSetsMaybeWithKeys(*comps, probes, stats, &candidates);
+
+  for (int pos = 0; pos < candidates.size(); pos++) {
+    RowOp* op = row_ops[order[pos]];
+    op->rowsets_to_check.swap(candidates[pos]);
+    op->has_rowsets_to_check = true;
+  }
+}
+
+void Tablet::FindRowSetsMaybeWithKeys(const TabletComponents& comps,
+                                      const vector<const RowSetKeyProbe*>& probes,
+                                      const vector<ProbeStats*>& stats,
+                                      vector<vector<RowSet*>>* candidates) const {
+  vector<Slice> keys;
+  keys.reserve(probes.size());
+  for (const RowSetKeyProbe* probe : probes) {
+    keys.push_back(probe->encoded_key_slice());
+  }
+  comps.rowsets->FindRowSetsWithKeysInRange(keys, candidates);
+
+  // Group the candidates by rowset. Since the keys are visited in sorted
+  // order, each rowset's probes are sorted too.
+  struct Candidate {
+    int key_pos;
+    int slot;
+  };
+  std::unordered_map<RowSet*, vector<Candidate>> by_rowset;
+  for (int pos = 0; pos < candidates->size(); pos++) {
+    for (int slot = 0; slot < (*candidates)[pos].size(); slot++) {
+      by_rowset[(*candidates)[pos][slot]].push_back({ pos, slot });
+    }
+  }
+
+  vector<const RowSetKeyProbe*> rs_probes;
+  vector<ProbeStats*> rs_stats;
+  std::unique_ptr<bool[]> maybe_present;
+  size_t maybe_present_size = 0;
+  for (const auto& e : by_rowset) {
+    RowSet* rs = e.first;
+    const vector<Candidate>& cands = e.second;
+    rs_probes.clear();
+    rs_stats.clear();
+    for (const Candidate& c : cands) {
+      rs_probes.push_back(probes[c.key_pos]);
+      rs_stats.push_back(stats[c.key_pos]);
+    }
+    if (maybe_present_size < cands.size()) {
+      maybe_present_size = cands.size();
+      maybe_present.reset(new bool[maybe_present_size]);
+    }
+    Status s = rs->CheckRowsMaybePresent(rs_probes.data(), cands.size(),
+                                         maybe_present.get(), rs_stats.data());
+    if (PREDICT_FALSE(!s.ok())) {
+      // Leave the rowset in every candidate list; the per-row checks will
+      // run into and report the same error.
+      KLOG_EVERY_N(WARNING, 100) << LogPrefix() << "Unable to batch check keys in "
+                                 << rs->ToString() << ": " << s.ToString();
+      continue;
+    }
+    for (int i = 0; i < cands.size(); i++) {
+      if (!maybe_present[i]) {
+        (*candidates)[cands[i].key_pos][cands[i].slot] = nullptr;
+      }
+    }
+  }
+
+  for (vector<RowSet*>& to_check : *candidates) {
+    to_check.erase(std::remove(to_check.begin(), to_check.end(), nullptr), to_check.end());
+  }
+}
+
 void Tablet::ApplyRowOperations(WriteTransactionState* tx_state) {
   // Allocate the ProbeStats objects from the transaction's arena, so
   // they're all contiguous and we don't need to do any central allocation.
@@ -594,14 +1407,20 @@ void Tablet::ApplyRowOperations(WriteTransactionState* tx_state) {
       tx_state->arena()->AllocateBytesAligned(sizeof(ProbeStats) * num_ops,
                                               alignof(ProbeStats)));
 
+  // Manually run the constructor to clear the stats to 0 before collecting
+  // them.
+  for (int i = 0; i < num_ops; i++) {
+    new (&stats_array[i]) ProbeStats();
+  }
+
   StartApplying(tx_state);
+  last_write_timestamp_.StoreMax(tx_state->timestamp().ToUint64());
+  if (FLAGS_tablet_batch_row_presence_checks) {
+    BatchFindRowSetsToCheck(tx_state, stats_array);
+  }
   int i = 0;
   for (RowOp* row_op : tx_state->row_ops()) {
-    ProbeStats* stats = &stats_array[i++];
-    // Manually run the constructor to clear the stats to 0 before collecting
-    // them.
-    new (stats) ProbeStats();
-    ApplyRowOperation(tx_state, row_op, stats);
+    ApplyRowOperation(tx_state, row_op, &stats_array[i++]);
   }
 
   if (metrics_) {
@@ -618,6 +1437,27 @@ void Tablet::ApplyRowOperation(WriteTransactionState* tx_state,
   DCHECK(tx_state->op_id().IsInitialized()) << "TransactionState OpId needed for anchoring";
   DCHECK_EQ(tx_state->schema_at_decode_time(), schema());
 
+  // Writes to expired rows are rejected. The cutoff comes from the write's
+  // timestamp rather than the local clock, so that the leader and the
+  // followers agree on the outcome, and it's never below the cutoff of a
+  // flush or compaction; see GetRowTtlDropCutoff(). Replayed operations are
+  // applied as they originally were.
+  int64_t row_ttl_cutoff;
+  if (!row_op->orig_result_from_log_ &&
+      GetRowTtlCutoffAt(tx_state->timestamp(), &row_ttl_cutoff)) {
+    int64_t leading_key;
+    memcpy(&leading_key, row_op->decoded_op.row_data + key_schema_.column_offset(0),
+           sizeof(leading_key));
+    if (leading_key < row_ttl_cutoff) {
+      bool is_insert = row_op->decoded_op.type == RowOperationsPB::INSERT ||
+          row_op->decoded_op.type == RowOperationsPB::UPSERT;
+      row_op->SetFailed(is_insert ?
+                        Status::InvalidArgument("row is older than the row TTL of the table") :
+                        Status::NotFound("key not found"));
+      return;
+    }
+  }
+
   switch (row_op->decoded_op.type) {
     case RowOperationsPB::INSERT:
     case RowOperationsPB::UPSERT:
@@ -629,6 +1469,10 @@ void Tablet::ApplyRowOperation(WriteTransactionState* tx_state,
       ignore_result(MutateRowUnlocked(tx_state, row_op, stats));
       return;
 
+    case RowOperationsPB::INCREMENT:
+      ignore_result(IncrementRowUnlocked(tx_state, row_op, stats));
+      return;
+
     default:
       LOG_WITH_PREFIX(FATAL) << RowOperationsPB::Type_Name(row_op->decoded_op.type);
   }
@@ -682,6 +1526,7 @@ void Tablet::AtomicSwapRowSetsUnlocked(const RowSetVector &to_remove,
   shared_ptr<RowSetTree> new_tree(new RowSetTree());
   ModifyRowSetTree(*components_->rowsets,
                    to_remove, to_add, new_tree.get());
+  new_tree->TrackMemory(rowset_tree_mem_tracker_);
 
   components_ = new TabletComponents(components_->memrowset, new_tree);
 }
@@ -724,6 +1569,66 @@ HistoryGcOpts Tablet::GetHistoryGcOpts() const {
   return HistoryGcOpts::Disabled();
 }
 
+bool Tablet::GetRowTtlCutoff(int64_t* cutoff) const {
+  if (row_ttl_usec_ == 0) {
+    return false;
+  }
+  row_ttl_cutoff_.StoreMax(GetCurrentTimeMicros() - row_ttl_usec_);
+  *cutoff = row_ttl_cutoff_.Load();
+  return true;
+}
+
+bool Tablet::GetRowTtlCutoffAt(Timestamp timestamp, int64_t* cutoff) const {
+  if (row_ttl_usec_ == 0) {
+    return false;
+  }
+  if (!clock_->HasPhysicalComponent()) {
+    return GetRowTtlCutoff(cutoff);
+  }
+  *cutoff = HybridClock::GetPhysicalValueMicros(timestamp) - row_ttl_usec_;
+  return true;
+}
+
+bool Tablet::GetRowTtlDropCutoff(int64_t* cutoff) const {
+  if (!GetRowTtlCutoff(cutoff)) {
+    return false;
+  }
+  // Without a physical clock, writes use the same cutoff, which never
+  // decreases. Writes which see the output of a compaction see at least its
+  // cutoff, which is ensured by component_lock_.
+  if (!clock_->HasPhysicalComponent()) {
+    return true;
+  }
+  // Every write which hasn't committed yet, or is yet to start, is at or
+  // after the clean timestamp, so its cutoff is at least this one. Keeping
+  // below the scans' cutoff means replicas never drop a row they still show.
+  Timestamp clean = mvcc_.GetCleanTimestamp();
+  *cutoff = std::min<int64_t>(*cutoff,
+                              HybridClock::GetPhysicalValueMicros(clean) - row_ttl_usec_);
+  return true;
+}
+
+void Tablet::EncodeRowTtlCutoff(int64_t cutoff, faststring* buf,
+                                gscoped_ptr<EncodedKey>* key) const {
+  buf->resize(key_schema_.byte_size());
+  ContiguousRow row(&key_schema_, buf->data());
+  memcpy(row.mutable_cell_ptr(0), &cutoff, sizeof(cutoff));
+  for (int i = 1; i < key_schema_.num_columns(); i++) {
+    key_schema_.column(i).type_info()->CopyMinValue(row.mutable_cell_ptr(i));
+  }
+  *key = EncodedKey::FromContiguousRow(ConstContiguousRow(&key_schema_, buf->data()));
+}
+
+bool Tablet::RowSetExpired(const RowSet& rs, const Slice& cutoff_key) {
+  string min_key;
+  string max_key;
+  if (!rs.GetBounds(&min_key, &max_key).ok()) {
+    // The MemRowSet has no bounds.
+    return false;
+  }
+  return Slice(max_key).compare(cutoff_key) < 0;
+}
+
 Status Tablet::Flush() {
   TRACE_EVENT1("tablet", "Tablet::Flush", "id", tablet_id());
   std::lock_guard<Semaphore> lock(rowsets_flush_sem_);
@@ -766,6 +1671,7 @@ Status Tablet::ReplaceMemRowSetUnlocked(RowSetsInCompaction *compaction,
                    RowSetVector(), // remove nothing
                    { *old_ms }, // add the old MRS
                    new_rst.get());
+  new_rst->TrackMemory(rowset_tree_mem_tracker_);
 
   // Swap it in
   components_ = new TabletComponents(new_mrs, new_rst);
@@ -936,16 +1842,33 @@ bool Tablet::ShouldThrottleAllow(int64_t bytes) {
   return throttler_->Take(MonoTime::Now(), 1, bytes);
 }
 
-////////////////////////////////////////////////////////////
-// CompactRowSetsOp
-////////////////////////////////////////////////////////////
+namespace {
 
-CompactRowSetsOp::CompactRowSetsOp(Tablet* tablet)
-  : MaintenanceOp(Substitute("CompactRowSetsOp($0)", tablet->tablet_id()),
+// The factor by which the perf improvement of compactions is scaled down
+// while the tablet may have data on a degraded data directory. They still
+// run, but after the compactions of tablets on healthy disks.
+const double kDegradedDataDirPerfFactor = 0.1;
+
+void BackOffIfDataDirDegraded(const Tablet* tablet, MaintenanceOpStats* stats) {
+  if (stats->perf_improvement() > 0 &&
+      tablet->metadata()->fs_manager()->TabletHasDegradedDataRoot(tablet->tablet_id())) {
+    stats->set_perf_improvement(stats->perf_improvement() * kDegradedDataDirPerfFactor);
+  }
+}
+
+} // anonymous namespace
+
+////////////////////////////////////////////////////////////
+// CompactRowSetsOp
+////////////////////////////////////////////////////////////
+
+CompactRowSetsOp::CompactRowSetsOp(Tablet* tablet)
+  : MaintenanceOp(Substitute("CompactRowSetsOp($0)", tablet->tablet_id()),
                   MaintenanceOp::HIGH_IO_USAGE),
     last_num_mrs_flushed_(0),
     last_num_rs_compacted_(0),
-    tablet_(tablet) {
+    tablet_(tablet),
+    io_target_(tablet->DataIOTarget()) {
 }
 
 void CompactRowSetsOp::UpdateStats(MaintenanceOpStats* stats) {
@@ -961,6 +1884,7 @@ void CompactRowSetsOp::UpdateStats(MaintenanceOpStats* stats) {
         new_num_mrs_flushed == last_num_mrs_flushed_ &&
         new_num_rs_compacted == last_num_rs_compacted_) {
       *stats = prev_stats_;
+      BackOffIfDataDirDegraded(tablet_, stats);
       return;
     } else {
       last_num_mrs_flushed_ = new_num_mrs_flushed;
@@ -970,6 +1894,7 @@ void CompactRowSetsOp::UpdateStats(MaintenanceOpStats* stats) {
 
   tablet_->UpdateCompactionStats(&prev_stats_);
   *stats = prev_stats_;
+  BackOffIfDataDirDegraded(tablet_, stats);
 }
 
 bool CompactRowSetsOp::Prepare() {
@@ -998,6 +1923,10 @@ scoped_refptr<AtomicGauge<uint32_t> > CompactRowSetsOp::RunningGauge() const {
   return tablet_->metrics()->compact_rs_running;
 }
 
+scoped_refptr<Counter> CompactRowSetsOp::CpuTimeCounter() const {
+  return tablet_->metrics()->maintenance_cpu_time_us;
+}
+
 ////////////////////////////////////////////////////////////
 // MinorDeltaCompactionOp
 ////////////////////////////////////////////////////////////
@@ -1009,7 +1938,8 @@ MinorDeltaCompactionOp::MinorDeltaCompactionOp(Tablet* tablet)
     last_num_dms_flushed_(0),
     last_num_rs_compacted_(0),
     last_num_rs_minor_delta_compacted_(0),
-    tablet_(tablet) {
+    tablet_(tablet),
+    io_target_(tablet->DataIOTarget()) {
 }
 
 void MinorDeltaCompactionOp::UpdateStats(MaintenanceOpStats* stats) {
@@ -1030,6 +1960,7 @@ void MinorDeltaCompactionOp::UpdateStats(MaintenanceOpStats* stats) {
         new_num_rs_compacted == last_num_rs_compacted_ &&
         new_num_rs_minor_delta_compacted == last_num_rs_minor_delta_compacted_) {
       *stats = prev_stats_;
+      BackOffIfDataDirDegraded(tablet_, stats);
       return;
     } else {
       last_num_mrs_flushed_ = new_num_mrs_flushed;
@@ -1044,6 +1975,7 @@ void MinorDeltaCompactionOp::UpdateStats(MaintenanceOpStats* stats) {
   prev_stats_.set_perf_improvement(perf_improv);
   prev_stats_.set_runnable(perf_improv > 0);
   *stats = prev_stats_;
+  BackOffIfDataDirDegraded(tablet_, stats);
 }
 
 bool MinorDeltaCompactionOp::Prepare() {
@@ -1069,6 +2001,10 @@ scoped_refptr<AtomicGauge<uint32_t> > MinorDeltaCompactionOp::RunningGauge() con
   return tablet_->metrics()->delta_minor_compact_rs_running;
 }
 
+scoped_refptr<Counter> MinorDeltaCompactionOp::CpuTimeCounter() const {
+  return tablet_->metrics()->maintenance_cpu_time_us;
+}
+
 ////////////////////////////////////////////////////////////
 // MajorDeltaCompactionOp
 ////////////////////////////////////////////////////////////
@@ -1081,7 +2017,8 @@ MajorDeltaCompactionOp::MajorDeltaCompactionOp(Tablet* tablet)
     last_num_rs_compacted_(0),
     last_num_rs_minor_delta_compacted_(0),
     last_num_rs_major_delta_compacted_(0),
-    tablet_(tablet) {
+    tablet_(tablet),
+    io_target_(tablet->DataIOTarget()) {
 }
 
 void MajorDeltaCompactionOp::UpdateStats(MaintenanceOpStats* stats) {
@@ -1105,6 +2042,7 @@ void MajorDeltaCompactionOp::UpdateStats(MaintenanceOpStats* stats) {
         new_num_rs_minor_delta_compacted == last_num_rs_minor_delta_compacted_ &&
         new_num_rs_major_delta_compacted == last_num_rs_major_delta_compacted_) {
       *stats = prev_stats_;
+      BackOffIfDataDirDegraded(tablet_, stats);
       return;
     } else {
       last_num_mrs_flushed_ = new_num_mrs_flushed;
@@ -1120,6 +2058,7 @@ void MajorDeltaCompactionOp::UpdateStats(MaintenanceOpStats* stats) {
   prev_stats_.set_perf_improvement(perf_improv);
   prev_stats_.set_runnable(perf_improv > 0);
   *stats = prev_stats_;
+  BackOffIfDataDirDegraded(tablet_, stats);
 }
 
 bool MajorDeltaCompactionOp::Prepare() {
@@ -1145,10 +2084,81 @@ scoped_refptr<AtomicGauge<uint32_t> > MajorDeltaCompactionOp::RunningGauge() con
   return tablet_->metrics()->delta_major_compact_rs_running;
 }
 
+scoped_refptr<Counter> MajorDeltaCompactionOp::CpuTimeCounter() const {
+  return tablet_->metrics()->maintenance_cpu_time_us;
+}
+
+////////////////////////////////////////////////////////////
+// UndoDeltaBlockGCOp
+////////////////////////////////////////////////////////////
+
+UndoDeltaBlockGCOp::UndoDeltaBlockGCOp(Tablet* tablet)
+  : MaintenanceOp(Substitute("UndoDeltaBlockGCOp($0)", tablet->tablet_id()),
+                  MaintenanceOp::HIGH_IO_USAGE),
+    tablet_(tablet),
+    sem_(1),
+    io_target_(tablet->DataIOTarget()) {
+}
+
+void UndoDeltaBlockGCOp::UpdateStats(MaintenanceOpStats* stats) {
+  if (!FLAGS_enable_undo_delta_block_gc) {
+    stats->set_runnable(false);
+    stats->set_perf_improvement(0);
+    return;
+  }
+
+  // Running the op is fully worthwhile once it has a whole rewrite budget's
+  // worth of ancient history to discard.
+  int64_t bytes = tablet_->EstimateBytesInAncientUndoDeltas();
+  int64_t budget_bytes =
+      std::max<int64_t>(FLAGS_undo_delta_block_gc_rewrite_budget_mb, 1) * 1024 * 1024;
+  stats->set_perf_improvement(std::min(1.0, static_cast<double>(bytes) / budget_bytes));
+  stats->set_runnable(bytes > 0 && sem_.GetValue() == 1);
+}
+
+bool UndoDeltaBlockGCOp::Prepare() {
+  return sem_.try_lock();
+}
+
+void UndoDeltaBlockGCOp::Perform() {
+  CHECK(!sem_.try_lock());
+
+  int64_t bytes_reclaimed;
+  WARN_NOT_OK(tablet_->GCAncientUndoDeltas(&bytes_reclaimed),
+              Substitute("UNDO delta block GC failed on $0", tablet_->tablet_id()));
+
+  sem_.unlock();
+}
+
+scoped_refptr<Histogram> UndoDeltaBlockGCOp::DurationHistogram() const {
+  return tablet_->metrics()->undo_delta_block_gc_duration;
+}
+
+scoped_refptr<AtomicGauge<uint32_t> > UndoDeltaBlockGCOp::RunningGauge() const {
+  return tablet_->metrics()->undo_delta_block_gc_running;
+}
+
+scoped_refptr<Counter> UndoDeltaBlockGCOp::CpuTimeCounter() const {
+  return tablet_->metrics()->maintenance_cpu_time_us;
+}
+
 ////////////////////////////////////////////////////////////
 // Tablet
 ////////////////////////////////////////////////////////////
 
+int64_t Tablet::EstimateCompactionMemory(const RowSetTree& tree,
+                                         const unordered_set<RowSet*>& picked) const {
+  vector<RowSetInfo> infos;
+  RowSetInfo::Collect(tree, Timestamp::kMin, &infos);
+  int64_t bytes = 0;
+  for (const RowSetInfo& rsi : infos) {
+    if (ContainsKey(picked, rsi.rowset())) {
+      bytes += EstimateCompactionInputMemory(*schema(), rsi);
+    }
+  }
+  return bytes;
+}
+
 Status Tablet::PickRowSetsToCompact(RowSetsInCompaction *picked,
                                     CompactFlags flags) const {
   CHECK_EQ(state_, kOpen);
@@ -1176,10 +2186,54 @@ Status Tablet::PickRowSetsToCompact(RowSetsInCompaction *picked,
   } else {
     // Let the policy decide which rowsets to compact.
     double quality = 0;
-    RETURN_NOT_OK(compaction_policy_->PickRowSets(*rowsets_copy, &picked_set, &quality, NULL));
+    RETURN_NOT_OK(compaction_policy_->PickRowSets(*rowsets_copy,
+                                                  CompactionAncientHistoryMark(),
+                                                  &picked_set, &quality, NULL));
     VLOG_WITH_PREFIX(2) << "Compaction quality: " << quality;
   }
 
+  // Charge the compaction's estimated memory before starting it. A forced
+  // compaction always proceeds; any other is shrunk until the process can
+  // spare its memory, picking again with halved budgets, or else deferred.
+  if (!picked_set.empty()) {
+    shared_ptr<MemTracker> tracker = MemTracker::CreateTracker(
+        -1, Substitute("Compaction-$0", next_compaction_tracker_id_++),
+        compaction_mem_tracker_);
+    int64_t mem_estimate = EstimateCompactionMemory(*rowsets_copy, picked_set);
+    if (flags & FORCE_COMPACT_ALL) {
+      tracker->Consume(mem_estimate);
+    } else {
+      int budget_mb = FLAGS_tablet_compaction_budget_mb;
+      while (!tracker->TryConsume(mem_estimate)) {
+        budget_mb /= 2;
+        if (picked_set.size() < 2 || budget_mb == 0) {
+          LOG_WITH_PREFIX(INFO) << Substitute(
+              "Deferring compaction of $0 rowsets: estimated to need $1 bytes, "
+              "more than the memory available", picked_set.size(), mem_estimate);
+          picked_set.clear();
+          break;
+        }
+        VLOG_WITH_PREFIX(1) << Substitute(
+            "Compaction of $0 rowsets estimated to need $1 bytes, more than the memory "
+            "available. Retrying with a $2MB budget", picked_set.size(), mem_estimate, budget_mb);
+        gscoped_ptr<CompactionPolicy> smaller_policy(CreateCompactionPolicy(
+            *schema(), metadata_->compaction_policy(), budget_mb));
+        double quality = 0;
+        picked_set.clear();
+        RETURN_NOT_OK(smaller_policy->PickRowSets(*rowsets_copy,
+                                                  CompactionAncientHistoryMark(),
+                                                  &picked_set, &quality, NULL));
+        if (picked_set.empty()) {
+          break;
+        }
+        mem_estimate = EstimateCompactionMemory(*rowsets_copy, picked_set);
+      }
+    }
+    if (!picked_set.empty()) {
+      picked->SetMemoryReservation(std::move(tracker), mem_estimate);
+    }
+  }
+
   shared_lock<rw_spinlock> l(component_lock_);
   for (const shared_ptr<RowSet>& rs : components_->rowsets->all_rowsets()) {
     if (picked_set.erase(rs.get()) == 0) {
@@ -1214,6 +2268,106 @@ Status Tablet::PickRowSetsToCompact(RowSetsInCompaction *picked,
   return Status::OK();
 }
 
+Status Tablet::DropFullyDeletedRowSets() {
+  Timestamp ancient_history_mark;
+  if (!GetTabletAncientHistoryMark(&ancient_history_mark)) {
+    return Status::OK();
+  }
+
+  shared_ptr<RowSetTree> rowsets_copy;
+  {
+    shared_lock<rw_spinlock> l(component_lock_);
+    rowsets_copy = components_->rowsets;
+  }
+
+  // Lock the rowsets whose delta stats make them candidates, so that no
+  // other compaction or flush can select them while we check them.
+  vector<std::pair<shared_ptr<RowSet>, std::unique_lock<std::mutex>>> candidates;
+  {
+    std::lock_guard<std::mutex> compact_lock(compact_select_lock_);
+    for (const shared_ptr<RowSet>& rs : rowsets_copy->all_rowsets()) {
+      if (rs->CountAncientDeletedRows(ancient_history_mark) == 0) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(*rs->compact_flush_lock(), std::try_to_lock);
+      if (lock.owns_lock()) {
+        candidates.emplace_back(rs, std::move(lock));
+      }
+    }
+  }
+  if (candidates.empty()) {
+    return Status::OK();
+  }
+
+  RowSetVector to_drop;
+  for (const auto& candidate : candidates) {
+    bool all_deleted;
+    RETURN_NOT_OK_PREPEND(candidate.first->CheckAllRowsDeleted(ancient_history_mark,
+                                                               &all_deleted),
+                          Substitute("Failed to check for deleted rows in $0",
+                                     candidate.first->ToString()));
+    if (all_deleted) {
+      to_drop.push_back(candidate.first);
+    }
+  }
+  if (to_drop.empty()) {
+    return Status::OK();
+  }
+
+  LOG_WITH_PREFIX(INFO) << "Dropping " << to_drop.size() << " rowsets whose rows "
+                        << "were all deleted before the ancient history mark";
+  return HandleEmptyCompactionOrFlush(to_drop, TabletMetadata::kNoMrsFlushed);
+}
+
+Status Tablet::DropExpiredRowSets() {
+  int64_t cutoff;
+  if (!GetRowTtlDropCutoff(&cutoff)) {
+    return Status::OK();
+  }
+  faststring key_buf;
+  gscoped_ptr<EncodedKey> cutoff_key;
+  EncodeRowTtlCutoff(cutoff, &key_buf, &cutoff_key);
+
+  shared_ptr<RowSetTree> rowsets_copy;
+  {
+    shared_lock<rw_spinlock> l(component_lock_);
+    rowsets_copy = components_->rowsets;
+  }
+
+  // As in DropFullyDeletedRowSets(), lock the rowsets so that no compaction
+  // or flush selects them while they're dropped.
+  RowSetVector to_drop;
+  vector<std::unique_lock<std::mutex>> locks;
+  {
+    std::lock_guard<std::mutex> compact_lock(compact_select_lock_);
+    for (const shared_ptr<RowSet>& rs : rowsets_copy->all_rowsets()) {
+      if (!RowSetExpired(*rs, cutoff_key->encoded_key())) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(*rs->compact_flush_lock(), std::try_to_lock);
+      if (lock.owns_lock()) {
+        to_drop.push_back(rs);
+        locks.push_back(std::move(lock));
+      }
+    }
+  }
+  if (to_drop.empty()) {
+    return Status::OK();
+  }
+
+  LOG_WITH_PREFIX(INFO) << "Dropping " << to_drop.size() << " rowsets whose rows "
+                        << "all expired";
+  return HandleEmptyCompactionOrFlush(to_drop, TabletMetadata::kNoMrsFlushed);
+}
+
+Timestamp Tablet::CompactionAncientHistoryMark() const {
+  Timestamp ancient_history_mark;
+  if (!GetTabletAncientHistoryMark(&ancient_history_mark)) {
+    return Timestamp::kMin;
+  }
+  return ancient_history_mark;
+}
+
 void Tablet::GetRowSetsForTests(RowSetVector* out) {
   shared_ptr<RowSetTree> rowsets_copy;
   {
@@ -1240,6 +2394,10 @@ void Tablet::RegisterMaintenanceOps(MaintenanceManager* maint_mgr) {
   gscoped_ptr<MaintenanceOp> major_delta_compact_op(new MajorDeltaCompactionOp(this));
   maint_mgr->RegisterOp(major_delta_compact_op.get());
   maintenance_ops_.push_back(major_delta_compact_op.release());
+
+  gscoped_ptr<MaintenanceOp> undo_delta_block_gc_op(new UndoDeltaBlockGCOp(this));
+  maint_mgr->RegisterOp(undo_delta_block_gc_op.get());
+  maintenance_ops_.push_back(undo_delta_block_gc_op.release());
 }
 
 void Tablet::UnregisterMaintenanceOps() {
@@ -1291,12 +2449,25 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
   RETURN_NOT_OK(input.CreateCompactionInput(flush_snap, schema(), &merge));
 
   RollingDiskRowSetWriter drsw(metadata_.get(), merge->schema(), bloom_sizing(),
-                               compaction_policy_->target_rowset_size());
+                               compaction_policy_->target_rowset_size(),
+                               compaction_encode_pool_);
   RETURN_NOT_OK_PREPEND(drsw.Open(), "Failed to open DiskRowSet for flush");
 
-  HistoryGcOpts history_gc_opts = GetHistoryGcOpts();
-  RETURN_NOT_OK_PREPEND(FlushCompactionInput(merge.get(), flush_snap, history_gc_opts, &drsw),
-                        "Flush to disk failed");
+  // The row TTL cutoff is taken before the DuplicatingRowSet is swapped in,
+  // so that no write to the rows this drops can be duplicated.
+  int64_t row_ttl_cutoff;
+  const HistoryGcOpts history_gc_opts = GetRowTtlDropCutoff(&row_ttl_cutoff) ?
+      GetHistoryGcOpts().WithRowTtlCutoff(row_ttl_cutoff) : GetHistoryGcOpts();
+  if (mrs_being_flushed != TabletMetadata::kNoMrsFlushed && input.num_rowsets() == 1 &&
+      FLAGS_tablet_flush_mrs_directly) {
+    // Nothing overlaps a flushing MemRowSet, so there's nothing to merge it with.
+    const MemRowSet* mrs = down_cast<MemRowSet*>(input.rowsets()[0].get());
+    RETURN_NOT_OK_PREPEND(FlushMemRowSet(*mrs, flush_snap, history_gc_opts, &drsw),
+                          "Flush to disk failed");
+  } else {
+    RETURN_NOT_OK_PREPEND(FlushCompactionInput(merge.get(), flush_snap, history_gc_opts, &drsw),
+                          "Flush to disk failed");
+  }
   RETURN_NOT_OK_PREPEND(drsw.Finish(), "Failed to finish DRS writer");
 
   if (common_hooks_) {
@@ -1486,12 +2657,22 @@ Status Tablet::HandleEmptyCompactionOrFlush(const RowSetVector& rowsets,
 Status Tablet::Compact(CompactFlags flags) {
   CHECK_EQ(state_, kOpen);
 
+  // Rowsets which would compact to nothing don't need to be rewritten.
+  RETURN_NOT_OK_PREPEND(DropFullyDeletedRowSets(),
+                        "Failed to drop fully deleted rowsets");
+  RETURN_NOT_OK_PREPEND(DropExpiredRowSets(),
+                        "Failed to drop expired rowsets");
+
   RowSetsInCompaction input;
   // Step 1. Capture the rowsets to be merged
   RETURN_NOT_OK_PREPEND(PickRowSetsToCompact(&input, flags),
                         "Failed to pick rowsets to compact");
   LOG_WITH_PREFIX(INFO) << "Compaction: stage 1 complete, picked "
                         << input.num_rowsets() << " rowsets to compact";
+  if (input.num_rowsets() == 0) {
+    // The compaction was deferred for lack of memory.
+    return Status::OK();
+  }
   if (compaction_hooks_) {
     RETURN_NOT_OK_PREPEND(compaction_hooks_->PostSelectIterators(),
                           "PostSelectIterators hook failed");
@@ -1519,10 +2700,25 @@ void Tablet::UpdateCompactionStats(MaintenanceOpStats* stats) {
 
   {
     std::lock_guard<std::mutex> compact_lock(compact_select_lock_);
-    WARN_NOT_OK(compaction_policy_->PickRowSets(*rowsets_copy, &picked_set_ignored, &quality, NULL),
+    WARN_NOT_OK(compaction_policy_->PickRowSets(*rowsets_copy, CompactionAncientHistoryMark(),
+                                                &picked_set_ignored, &quality, NULL),
                 Substitute("Couldn't determine compaction quality for $0", tablet_id()));
   }
 
+  // Rowsets whose rows all expired are dropped by any compaction.
+  int64_t row_ttl_cutoff;
+  if (quality < 1 && GetRowTtlDropCutoff(&row_ttl_cutoff)) {
+    faststring key_buf;
+    gscoped_ptr<EncodedKey> cutoff_key;
+    EncodeRowTtlCutoff(row_ttl_cutoff, &key_buf, &cutoff_key);
+    for (const shared_ptr<RowSet>& rs : rowsets_copy->all_rowsets()) {
+      if (RowSetExpired(*rs, cutoff_key->encoded_key())) {
+        quality = 1;
+        break;
+      }
+    }
+  }
+
   VLOG_WITH_PREFIX(1) << "Best compaction for " << tablet_id() << ": " << quality;
 
   stats->set_runnable(quality >= 0);
@@ -1551,17 +2747,33 @@ Status Tablet::CaptureConsistentIterators(
   const Schema *projection,
   const MvccSnapshot &snap,
   const ScanSpec *spec,
-  vector<shared_ptr<RowwiseIterator> > *iters) const {
+  vector<IterWithBounds> *iters) const {
   shared_lock<rw_spinlock> l(component_lock_);
 
   // Construct all the iterators locally first, so that if we fail
   // in the middle, we don't modify the output arguments.
-  vector<shared_ptr<RowwiseIterator> > ret;
+  vector<IterWithBounds> ret;
 
-  // Grab the memrowset iterator.
+  // Grab the memrowset iterator. Its bounds are unknown.
   gscoped_ptr<RowwiseIterator> ms_iter;
   RETURN_NOT_OK(components_->memrowset->NewRowIterator(projection, snap, &ms_iter));
-  ret.push_back(shared_ptr<RowwiseIterator>(ms_iter.release()));
+  ret.push_back({ shared_ptr<RowwiseIterator>(ms_iter.release()), "" });
+
+  // The smallest and largest keys of each bounded rowset, as tracked by the
+  // rowset tree.
+  std::unordered_map<const RowSet*, Slice> lower_bounds;
+  std::unordered_map<const RowSet*, Slice> upper_bounds;
+  for (const RowSetTree::RSEndpoint& endpoint : components_->rowsets->key_endpoints()) {
+    if (endpoint.endpoint_ == RowSetTree::START) {
+      lower_bounds.emplace(endpoint.rowset_, endpoint.slice_);
+    } else {
+      upper_bounds.emplace(endpoint.rowset_, endpoint.slice_);
+    }
+  }
+  auto lower_bound = [&] (const RowSet* rs) {
+    const Slice* bound = FindOrNull(lower_bounds, rs);
+    return bound != nullptr ? bound->ToString() : string();
+  };
 
   // Cull row-sets in the case of key-range queries.
   if (spec != nullptr && spec->lower_bound_key() && spec->exclusive_upper_bound_key()) {
@@ -1579,20 +2791,105 @@ Status Tablet::CaptureConsistentIterators(
       RETURN_NOT_OK_PREPEND(rs->NewRowIterator(projection, snap, &row_it),
                             Substitute("Could not create iterator for rowset $0",
                                        rs->ToString()));
-      ret.push_back(shared_ptr<RowwiseIterator>(row_it.release()));
+      ret.push_back({ shared_ptr<RowwiseIterator>(row_it.release()), lower_bound(rs) });
     }
     ret.swap(*iters);
     return Status::OK();
   }
 
   // If there are no encoded predicates or they represent an open-ended range, then
-  // fall back to grabbing all rowset iterators
+  // fall back to grabbing all rowset iterators, except for those entirely below
+  // the lower bound, such as the rowsets whose rows all expired.
+  const EncodedKey* lower_bound_key = spec != nullptr ? spec->lower_bound_key() : nullptr;
   for (const shared_ptr<RowSet> &rs : components_->rowsets->all_rowsets()) {
+    if (lower_bound_key != nullptr) {
+      const Slice* upper_bound = FindOrNull(upper_bounds, rs.get());
+      if (upper_bound != nullptr && upper_bound->compare(lower_bound_key->encoded_key()) < 0) {
+        continue;
+      }
+    }
     gscoped_ptr<RowwiseIterator> row_it;
     RETURN_NOT_OK_PREPEND(rs->NewRowIterator(projection, snap, &row_it),
                           Substitute("Could not create iterator for rowset $0",
                                      rs->ToString()));
-    ret.push_back(shared_ptr<RowwiseIterator>(row_it.release()));
+    ret.push_back({ shared_ptr<RowwiseIterator>(row_it.release()), lower_bound(rs.get()) });
+  }
+
+  // Swap results into the parameters.
+  ret.swap(*iters);
+  return Status::OK();
+}
+
+Status Tablet::CaptureResumableIterators(const Schema* projection,
+                                         const MvccSnapshot& snap,
+                                         bool new_scan,
+                                         ScanResumePosition* position,
+                                         vector<shared_ptr<RowwiseIterator>>* iters,
+                                         bool* rest_in_key_order) const {
+  shared_lock<rw_spinlock> l(component_lock_);
+
+  // Identify the disk rowsets. The memrowset being flushed and the rowsets
+  // being compacted have no metadata, and are read along with the memrowset.
+  const ColumnId key_col_id = schema()->column_id(0);
+  vector<uint64_t> block_ids;
+  std::unordered_map<uint64_t, shared_ptr<RowSet>> disk_rowsets;
+  vector<shared_ptr<RowSet>> rest;
+  for (const shared_ptr<RowSet>& rs : components_->rowsets->all_rowsets()) {
+    shared_ptr<RowSetMetadata> rs_metadata = rs->metadata();
+    if (!rs_metadata) {
+      rest.push_back(rs);
+      continue;
+    }
+    uint64_t block_id = rs_metadata->column_data_block_for_col_id(key_col_id).id();
+    block_ids.push_back(block_id);
+    disk_rowsets.emplace(block_id, rs);
+  }
+  // A DuplicatingRowSet unions its input rowsets, so its rows may be out of
+  // order.
+  *rest_in_key_order = rest.empty();
+  if (new_scan) {
+    position->rowset_block_ids = std::move(block_ids);
+  }
+
+  vector<shared_ptr<RowwiseIterator>> ret;
+  for (int i = 0; i < position->rowset_block_ids.size(); i++) {
+    uint64_t block_id = position->rowset_block_ids[i];
+    shared_ptr<RowSet> rs;
+    if (!FindCopy(disk_rowsets, block_id, &rs)) {
+      return Status::IllegalState(Substitute(
+          "rowset with key block $0 is no longer part of the tablet", block_id));
+    }
+    disk_rowsets.erase(block_id);
+    if (i < position->rowset_idx) {
+      continue;
+    }
+    gscoped_ptr<RowwiseIterator> row_it;
+    RETURN_NOT_OK_PREPEND(rs->NewRowIterator(projection, snap, &row_it),
+                          Substitute("Could not create iterator for rowset $0",
+                                     rs->ToString()));
+    ret.emplace_back(row_it.release());
+  }
+
+  // The rest of the tablet: the memrowset, and the rowsets written since the
+  // scan started, which hold the rows it had then.
+  vector<IterWithBounds> rest_iters;
+  gscoped_ptr<RowwiseIterator> ms_iter;
+  RETURN_NOT_OK(components_->memrowset->NewRowIterator(projection, snap, &ms_iter));
+  rest_iters.push_back({ shared_ptr<RowwiseIterator>(ms_iter.release()), "" });
+  for (const auto& entry : disk_rowsets) {
+    rest.push_back(entry.second);
+  }
+  for (const shared_ptr<RowSet>& rs : rest) {
+    gscoped_ptr<RowwiseIterator> row_it;
+    RETURN_NOT_OK_PREPEND(rs->NewRowIterator(projection, snap, &row_it),
+                          Substitute("Could not create iterator for rowset $0",
+                                     rs->ToString()));
+    rest_iters.push_back({ shared_ptr<RowwiseIterator>(row_it.release()), "" });
+  }
+  if (rest_iters.size() == 1) {
+    ret.emplace_back(std::move(rest_iters[0].iter));
+  } else {
+    ret.emplace_back(new MergeIterator(*projection, std::move(rest_iters)));
   }
 
   // Swap results into the parameters.
@@ -1616,6 +2913,123 @@ Status Tablet::CountRows(uint64_t *count) const {
   return Status::OK();
 }
 
+Status Tablet::GetColumnStatistics(std::map<string, ColumnStatisticsPB>* stats) const {
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+  // Copy the schema, since it may be swapped out by a concurrent alter.
+  const Schema schema = *this->schema();
+
+  stats->clear();
+  for (int i = 0; i < schema.num_columns(); i++) {
+    ColumnStatisticsPB merged;
+    bool complete = true;
+    for (const shared_ptr<RowSet> &rowset : comps->rowsets->all_rowsets()) {
+      ColumnStatisticsPB rs_stats;
+      Status s = rowset->GetColumnStatistics(schema, i, &rs_stats);
+      if (s.IsNotFound()) {
+        complete = false;
+        break;
+      }
+      RETURN_NOT_OK(s);
+      RETURN_NOT_OK_PREPEND(MergeColumnStatistics(schema.column(i).type_info(), rs_stats, &merged),
+                            Substitute("unable to merge statistics of $0 for column $1",
+                                       rowset->ToString(), schema.column(i).name()));
+    }
+    if (complete) {
+      (*stats)[schema.column(i).name()].Swap(&merged);
+    }
+  }
+  return Status::OK();
+}
+
+Status Tablet::SplitKeyRange(const string& start_key,
+                             const string& stop_key,
+                             uint64_t target_chunk_size_bytes,
+                             vector<string>* split_keys) const {
+  DCHECK_GT(target_chunk_size_bytes, 0);
+  // Taking a few samples per chunk keeps the split points close to where
+  // the chunks should end, and bounds the number of samples of huge rowsets.
+  const uint64_t kSamplesPerChunk = 4;
+  const uint64_t kMaxSamplesPerRowSet = 1024;
+
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+
+  // The sampled keys within the range, with the number of bytes each stands for.
+  vector<std::pair<string, uint64_t>> samples;
+  for (const shared_ptr<RowSet> &rowset : comps->rowsets->all_rowsets()) {
+    uint64_t size = rowset->EstimateOnDiskSize();
+    if (size == 0) {
+      continue;
+    }
+    int num_samples = std::min(kMaxSamplesPerRowSet,
+                               size * kSamplesPerChunk / target_chunk_size_bytes + 1);
+    vector<string> keys;
+    RETURN_NOT_OK_PREPEND(rowset->GetKeySamples(num_samples, &keys),
+                          Substitute("unable to sample keys of $0", rowset->ToString()));
+    if (keys.empty()) {
+      continue;
+    }
+    uint64_t bytes_per_key = size / keys.size();
+    for (string& key : keys) {
+      if (key < start_key || (!stop_key.empty() && key >= stop_key)) {
+        continue;
+      }
+      samples.emplace_back(std::move(key), bytes_per_key);
+    }
+  }
+  std::sort(samples.begin(), samples.end());
+
+  split_keys->clear();
+  uint64_t chunk_bytes = 0;
+  for (const auto& sample : samples) {
+    // Start a new chunk at this key once the current one is full, unless
+    // the chunk would be empty.
+    const string& chunk_start = split_keys->empty() ? start_key : split_keys->back();
+    if (chunk_bytes >= target_chunk_size_bytes && sample.first > chunk_start) {
+      split_keys->push_back(sample.first);
+      chunk_bytes = 0;
+    }
+    chunk_bytes += sample.second;
+  }
+  return Status::OK();
+}
+
+Status Tablet::EstimateSplitKey(string* split_key) const {
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+
+  // The on-disk rowsets by min key, with their sizes.
+  vector<std::pair<string, uint64_t>> rowsets;
+  uint64_t total_size = 0;
+  for (const shared_ptr<RowSet> &rowset : comps->rowsets->all_rowsets()) {
+    uint64_t size = rowset->EstimateOnDiskSize();
+    string min_key;
+    string max_key;
+    if (size == 0 || !rowset->GetBounds(&min_key, &max_key).ok()) {
+      continue;
+    }
+    rowsets.emplace_back(std::move(min_key), size);
+    total_size += size;
+  }
+  std::sort(rowsets.begin(), rowsets.end());
+
+  // Split at the min key of the first rowset past the half of the data, so
+  // that both halves get whole rowsets when they don't overlap.
+  split_key->clear();
+  uint64_t below_size = 0;
+  for (const auto& rowset : rowsets) {
+    if (below_size * 2 >= total_size) {
+      if (rowset.first > rowsets.front().first) {
+        *split_key = rowset.first;
+      }
+      break;
+    }
+    below_size += rowset.second;
+  }
+  return Status::OK();
+}
+
 size_t Tablet::MemRowSetSize() const {
   scoped_refptr<TabletComponents> comps;
   GetComponents(&comps);
@@ -1759,6 +3173,18 @@ Status Tablet::FlushBiggestDMS() {
   return max_size > 0 ? biggest_drs->FlushDeltas() : Status::OK();
 }
 
+Status Tablet::FlushAllDMS() {
+  CHECK_EQ(state_, kOpen);
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+  for (const shared_ptr<RowSet> &rowset : comps->rowsets->all_rowsets()) {
+    if (!rowset->DeltaMemStoreEmpty()) {
+      RETURN_NOT_OK(rowset->FlushDeltas());
+    }
+  }
+  return Status::OK();
+}
+
 Status Tablet::CompactWorstDeltas(RowSet::DeltaCompactionType type) {
   CHECK_EQ(state_, kOpen);
   shared_ptr<RowSet> rs;
@@ -1792,6 +3218,61 @@ Status Tablet::CompactWorstDeltas(RowSet::DeltaCompactionType type) {
   return Status::OK();
 }
 
+int64_t Tablet::EstimateBytesInAncientUndoDeltas() const {
+  Timestamp ancient_history_mark;
+  if (!GetTabletAncientHistoryMark(&ancient_history_mark)) {
+    return 0;
+  }
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+  int64_t bytes = 0;
+  for (const shared_ptr<RowSet>& rs : comps->rowsets->all_rowsets()) {
+    bytes += rs->EstimateBytesInAncientUndoDeltas(ancient_history_mark);
+  }
+  return bytes;
+}
+
+Status Tablet::GCAncientUndoDeltas(int64_t* bytes_reclaimed) {
+  CHECK_EQ(state_, kOpen);
+  *bytes_reclaimed = 0;
+  Timestamp ancient_history_mark;
+  if (!GetTabletAncientHistoryMark(&ancient_history_mark)) {
+    return Status::OK();
+  }
+
+  // Lock the rowsets which aren't being compacted, so that no compaction
+  // reads their UNDO deltas as we remove them. Rowsets which are being
+  // compacted are skipped: the compaction discards their ancient history.
+  vector<shared_ptr<RowSet>> rowsets;
+  vector<std::unique_lock<std::mutex>> locks;
+  {
+    std::lock_guard<std::mutex> compact_lock(compact_select_lock_);
+    scoped_refptr<TabletComponents> comps;
+    GetComponents(&comps);
+    for (const shared_ptr<RowSet>& rs : comps->rowsets->all_rowsets()) {
+      if (!rs->IsAvailableForCompaction()) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(*rs->compact_flush_lock(), std::try_to_lock);
+      CHECK(lock.owns_lock());
+      rowsets.push_back(rs);
+      locks.push_back(std::move(lock));
+    }
+  }
+
+  int64_t rewrite_budget_bytes =
+      static_cast<int64_t>(FLAGS_undo_delta_block_gc_rewrite_budget_mb) * 1024 * 1024;
+  for (const shared_ptr<RowSet>& rs : rowsets) {
+    RETURN_NOT_OK_PREPEND(rs->GCAncientUndoDeltas(ancient_history_mark, &rewrite_budget_bytes,
+                                                  bytes_reclaimed),
+                          "Failed to garbage collect the UNDO deltas of " + rs->ToString());
+  }
+  if (metrics_) {
+    metrics_->undo_delta_block_gc_bytes_deleted->IncrementBy(*bytes_reclaimed);
+  }
+  return Status::OK();
+}
+
 double Tablet::GetPerfImprovementForBestDeltaCompact(RowSet::DeltaCompactionType type,
                                                      shared_ptr<RowSet>* rs) const {
   std::lock_guard<std::mutex> compact_lock(compact_select_lock_);
@@ -1839,7 +3320,9 @@ void Tablet::PrintRSLayout(ostream* o) {
   vector<string> log;
   unordered_set<RowSet*> picked;
   double quality;
-  Status s = compaction_policy_->PickRowSets(*rowsets_copy, &picked, &quality, &log);
+  Timestamp ancient_history_mark = CompactionAncientHistoryMark();
+  Status s = compaction_policy_->PickRowSets(*rowsets_copy, ancient_history_mark,
+                                             &picked, &quality, &log);
   if (!s.ok()) {
     *o << "<b>Error:</b> " << EscapeForHtmlToString(s.ToString());
     return;
@@ -1853,7 +3336,7 @@ void Tablet::PrintRSLayout(ostream* o) {
   }
 
   vector<RowSetInfo> min, max;
-  RowSetInfo::CollectOrdered(*rowsets_copy, &min, &max);
+  RowSetInfo::CollectOrdered(*rowsets_copy, ancient_history_mark, &min, &max);
   DumpCompactionSVG(min, picked, o, false);
 
   *o << "<h2>Compaction policy log</h2>" << std::endl;
@@ -1873,31 +3356,308 @@ string Tablet::LogPrefix() const {
 // Tablet::Iterator
 ////////////////////////////////////////////////////////////
 
+namespace {
+
+// Wraps the iterator of a rowset of a resumable scan, or of the rest of the
+// tablet, so that it starts after the row the scan resumes from, and records
+// the position of the last row it returns in 'position'.
+class ResumePositionIterator : public RowwiseIterator {
+ public:
+  ResumePositionIterator(shared_ptr<RowwiseIterator> iter, const Schema* key_schema,
+                         int rowset_idx, ScanResumePosition* position)
+      : iter_(std::move(iter)),
+        key_schema_(key_schema),
+        rowset_idx_(rowset_idx),
+        position_(position),
+        arena_(256, 4096) {
+  }
+
+  virtual Status Init(ScanSpec* spec) OVERRIDE {
+    if (position_->rowset_idx == rowset_idx_ && !position_->last_key.empty()) {
+      gscoped_ptr<EncodedKey> start;
+      RETURN_NOT_OK_PREPEND(EncodedKey::DecodeEncodedString(*key_schema_, &arena_,
+                                                            position_->last_key, &start),
+                            "Failed to decode resume position key");
+      RETURN_NOT_OK_PREPEND(EncodedKey::IncrementEncodedKey(*key_schema_, &start, &arena_),
+                            "Failed to increment resume position key");
+      if (spec == nullptr) {
+        spec = &own_spec_;
+      }
+      spec->SetLowerBoundKey(start.get());
+      start_key_.reset(start.release());
+    }
+    return iter_->Init(spec);
+  }
+
+  virtual bool HasNext() const OVERRIDE {
+    return iter_->HasNext();
+  }
+
+  virtual Status NextBlock(RowBlock* dst) OVERRIDE {
+    RETURN_NOT_OK(iter_->NextBlock(dst));
+    const SelectionVector* sel = dst->selection_vector();
+    for (int i = dst->nrows() - 1; i >= 0; i--) {
+      if (sel->IsRowSelected(i)) {
+        dst->schema().EncodeComparableKey(dst->row(i), &key_buf_);
+        position_->rowset_idx = rowset_idx_;
+        position_->last_key.assign(reinterpret_cast<const char*>(key_buf_.data()),
+                                   key_buf_.size());
+        break;
+      }
+    }
+    return Status::OK();
+  }
+
+  virtual string ToString() const OVERRIDE {
+    return iter_->ToString();
+  }
+
+  virtual const Schema& schema() const OVERRIDE {
+    return iter_->schema();
+  }
+
+  virtual void GetIteratorStats(vector<IteratorStats>* stats) const OVERRIDE {
+    iter_->GetIteratorStats(stats);
+  }
+
+ private:
+  const shared_ptr<RowwiseIterator> iter_;
+  const Schema* const key_schema_;
+  const int rowset_idx_;
+  ScanResumePosition* const position_;
+
+  // Used to start after the resumed row when Init() isn't given a spec.
+  ScanSpec own_spec_;
+
+  Arena arena_;
+  gscoped_ptr<EncodedKey> start_key_;
+  faststring key_buf_;
+
+  DISALLOW_COPY_AND_ASSIGN(ResumePositionIterator);
+};
+
+// Returns the rows of a tablet in descending key order.
+//
+// The key range of the scan is split into chunks of about
+// --tablet_reverse_scan_chunk_size_bytes of on-disk data each. The chunks are
+// read one at a time, last first, by ORDERED tablet iterators, and the rows
+// of each are buffered and returned in reverse. Scans which stop early, such
+// as those with a limit, thus only read the last few chunks of their range.
+class ReverseOrderedIterator : public RowwiseIterator {
+ public:
+  // 'projection' is the projection requested of the tablet, and
+  // 'mapped_projection' the one it maps to, which the rows are returned in.
+  ReverseOrderedIterator(const Tablet* tablet, Schema projection, Schema mapped_projection,
+                         MvccSnapshot snap)
+      : tablet_(tablet),
+        projection_(std::move(projection)),
+        schema_(std::move(mapped_projection)),
+        snap_(std::move(snap)),
+        next_chunk_(-1),
+        next_row_(0),
+        arena_(32 * 1024, 4 * 1024 * 1024) {
+  }
+
+  virtual Status Init(ScanSpec* spec) OVERRIDE {
+    if (spec != nullptr) {
+      spec_ = *spec;
+    }
+    string start_key;
+    string stop_key;
+    if (spec_.lower_bound_key()) {
+      start_key = spec_.lower_bound_key()->encoded_key().ToString();
+    }
+    if (spec_.exclusive_upper_bound_key()) {
+      stop_key = spec_.exclusive_upper_bound_key()->encoded_key().ToString();
+    }
+    vector<string> split_keys;
+    RETURN_NOT_OK(tablet_->SplitKeyRange(
+        start_key, stop_key,
+        std::max(1, FLAGS_tablet_reverse_scan_chunk_size_bytes), &split_keys));
+    chunk_bounds_.push_back(std::move(start_key));
+    for (string& key : split_keys) {
+      chunk_bounds_.push_back(std::move(key));
+    }
+    chunk_bounds_.push_back(std::move(stop_key));
+    next_chunk_ = chunk_bounds_.size() - 2;
+    return Status::OK();
+  }
+
+  virtual bool HasNext() const OVERRIDE {
+    return next_row_ > 0 || next_chunk_ >= 0;
+  }
+
+  virtual Status NextBlock(RowBlock* dst) OVERRIDE {
+    if (dst->arena()) {
+      dst->arena()->Reset();
+    }
+    while (next_row_ == 0 && next_chunk_ >= 0) {
+      RETURN_NOT_OK(ReadChunk(next_chunk_--));
+    }
+    size_t n = std::min<size_t>(dst->row_capacity(), next_row_);
+    dst->Resize(n);
+    dst->selection_vector()->SetAllTrue();
+    for (size_t i = 0; i < n; i++) {
+      RowBlockRow dst_row = dst->row(i);
+      RETURN_NOT_OK(CopyRow(ConstContiguousRow(&schema_, rows_[--next_row_]), &dst_row,
+                            dst->arena()));
+    }
+    return Status::OK();
+  }
+
+  virtual string ToString() const OVERRIDE {
+    return Substitute("ReverseOrderedIterator($0 chunks left)", next_chunk_ + 1);
+  }
+
+  virtual const Schema& schema() const OVERRIDE {
+    return schema_;
+  }
+
+  virtual void GetIteratorStats(vector<IteratorStats>* stats) const OVERRIDE {
+    *stats = stats_;
+  }
+
+ private:
+  // Reads the rows of chunk 'idx' into 'rows_', in ascending key order.
+  Status ReadChunk(int idx) {
+    rows_.clear();
+    arena_.Reset();
+
+    // Each chunk is read with a copy of the spec, since iterators modify the
+    // spec they're initialized with.
+    ScanSpec chunk_spec = spec_;
+    Arena key_arena(256, 4096);
+    gscoped_ptr<EncodedKey> lower;
+    gscoped_ptr<EncodedKey> upper;
+    if (!chunk_bounds_[idx].empty()) {
+      RETURN_NOT_OK(EncodedKey::DecodeEncodedString(tablet_->key_schema(), &key_arena,
+                                                    chunk_bounds_[idx], &lower));
+      chunk_spec.SetLowerBoundKey(lower.get());
+    }
+    if (!chunk_bounds_[idx + 1].empty()) {
+      RETURN_NOT_OK(EncodedKey::DecodeEncodedString(tablet_->key_schema(), &key_arena,
+                                                    chunk_bounds_[idx + 1], &upper));
+      chunk_spec.SetExclusiveUpperBoundKey(upper.get());
+    }
+
+    gscoped_ptr<RowwiseIterator> iter;
+    RETURN_NOT_OK(tablet_->NewRowIterator(projection_, snap_, Tablet::ORDERED, &iter));
+    RETURN_NOT_OK(iter->Init(&chunk_spec));
+    Arena block_arena(32 * 1024, 1024 * 1024);
+    RowBlock block(iter->schema(), 1024, &block_arena);
+    while (iter->HasNext()) {
+      RETURN_NOT_OK(iter->NextBlock(&block));
+      for (size_t i = 0; i < block.nrows(); i++) {
+        if (!block.selection_vector()->IsRowSelected(i)) {
+          continue;
+        }
+        uint8_t* row_data = static_cast<uint8_t*>(arena_.AllocateBytes(schema_.byte_size()));
+        if (PREDICT_FALSE(row_data == nullptr)) {
+          return Status::RuntimeError("out of memory buffering a reverse scan chunk");
+        }
+        ContiguousRow row(&schema_, row_data);
+        RETURN_NOT_OK(CopyRow(block.row(i), &row, &arena_));
+        rows_.push_back(row_data);
+      }
+    }
+    next_row_ = rows_.size();
+
+    vector<IteratorStats> chunk_stats;
+    iter->GetIteratorStats(&chunk_stats);
+    if (stats_.empty()) {
+      stats_ = std::move(chunk_stats);
+    } else {
+      for (int i = 0; i < std::min(stats_.size(), chunk_stats.size()); i++) {
+        stats_[i].AddStats(chunk_stats[i]);
+      }
+    }
+    return Status::OK();
+  }
+
+  const Tablet* const tablet_;
+  const Schema projection_;
+  const Schema schema_;
+  const MvccSnapshot snap_;
+  ScanSpec spec_;
+
+  // The encoded keys bounding the chunks, in ascending order. Chunk 'i'
+  // spans [chunk_bounds_[i], chunk_bounds_[i + 1]). An empty first or last
+  // bound leaves that end of the range unbounded.
+  vector<string> chunk_bounds_;
+
+  // The index of the next chunk to read, counting down.
+  int next_chunk_;
+
+  // The rows of the chunk being returned, in ascending key order, and the
+  // number of them which are left to return.
+  vector<const uint8_t*> rows_;
+  size_t next_row_;
+  Arena arena_;
+
+  vector<IteratorStats> stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReverseOrderedIterator);
+};
+
+} // anonymous namespace
+
 Tablet::Iterator::Iterator(const Tablet* tablet, const Schema& projection,
-                           MvccSnapshot snap, const OrderMode order)
+                           MvccSnapshot snap, const OrderMode order,
+                           int max_parallelism)
     : tablet_(tablet),
       projection_(projection),
       snap_(std::move(snap)),
-      order_(order) {}
+      order_(order),
+      max_parallelism_(max_parallelism),
+      rest_in_key_order_(false) {}
 
 Tablet::Iterator::~Iterator() {}
 
 Status Tablet::Iterator::Init(ScanSpec *spec) {
   DCHECK(iter_.get() == nullptr);
 
+  Schema requested_projection = projection_;
   RETURN_NOT_OK(tablet_->GetMappedReadProjection(projection_, &projection_));
+  if (resume_position_) {
+    return InitResumable(spec);
+  }
+  if (order_ == REVERSE_ORDERED) {
+    // Each chunk is read by a tablet iterator of its own, which maps the
+    // requested projection and bounds the scan by the row TTL itself.
+    iter_.reset(new ReverseOrderedIterator(tablet_, std::move(requested_projection),
+                                           projection_, snap_));
+    return iter_->Init(spec);
+  }
 
-  vector<shared_ptr<RowwiseIterator>> iters;
+  AddRowTtlBound(&spec);
+  vector<IterWithBounds> bounded_iters;
+
+  RETURN_NOT_OK(tablet_->CaptureConsistentIterators(&projection_, snap_, spec, &bounded_iters));
 
-  RETURN_NOT_OK(tablet_->CaptureConsistentIterators(&projection_, snap_, spec, &iters));
+  // Give each scan its own readahead budget, shared by all of its rowsets.
+  if (spec != nullptr && FLAGS_tablet_scan_readahead_budget_mb > 0 &&
+      !spec->readahead_mem_tracker()) {
+    spec->set_readahead_mem_tracker(tablet_->CreateScanReadaheadTracker());
+  }
 
+  vector<shared_ptr<RowwiseIterator>> iters;
   switch (order_) {
     case ORDERED:
-      iter_.reset(new MergeIterator(projection_, iters));
+      iter_.reset(new MergeIterator(projection_, std::move(bounded_iters)));
       break;
     case UNORDERED:
     default:
-      iter_.reset(new UnionIterator(iters));
+      for (IterWithBounds& sub : bounded_iters) {
+        iters.emplace_back(std::move(sub.iter));
+      }
+      if (max_parallelism_ > 1 && iters.size() > 1) {
+        ThreadPool* pool;
+        shared_ptr<MemTracker> mem_tracker;
+        RETURN_NOT_OK(tablet_->GetScanPool(&pool, &mem_tracker));
+        iter_.reset(new ParallelUnionIterator(iters, pool, max_parallelism_, mem_tracker));
+      } else {
+        iter_.reset(new UnionIterator(iters));
+      }
       break;
   }
 
@@ -1905,6 +3665,64 @@ Status Tablet::Iterator::Init(ScanSpec *spec) {
   return Status::OK();
 }
 
+Status Tablet::Iterator::InitResumable(ScanSpec* spec) {
+  if (projection_.num_key_columns() != tablet_->schema()->num_key_columns()) {
+    return Status::InvalidArgument("Resumable scans must project the key columns");
+  }
+  AddRowTtlBound(&spec);
+  bool new_scan = resume_position_->rowset_block_ids.empty() &&
+      resume_position_->last_key.empty();
+  vector<shared_ptr<RowwiseIterator>> iters;
+  RETURN_NOT_OK(tablet_->CaptureResumableIterators(&projection_, snap_, new_scan,
+                                                   resume_position_.get(), &iters,
+                                                   &rest_in_key_order_));
+
+  if (spec != nullptr && FLAGS_tablet_scan_readahead_budget_mb > 0 &&
+      !spec->readahead_mem_tracker()) {
+    spec->set_readahead_mem_tracker(tablet_->CreateScanReadaheadTracker());
+  }
+
+  // The iterators are read one after the other, starting with the rowset
+  // the scan resumes from.
+  vector<shared_ptr<RowwiseIterator>> tracked_iters;
+  int rowset_idx = resume_position_->rowset_idx;
+  for (shared_ptr<RowwiseIterator>& iter : iters) {
+    tracked_iters.emplace_back(new ResumePositionIterator(
+        std::move(iter), &tablet_->key_schema(), rowset_idx++, resume_position_.get()));
+  }
+  iter_.reset(new UnionIterator(tracked_iters));
+  return iter_->Init(spec);
+}
+
+void Tablet::Iterator::AddRowTtlBound(ScanSpec** spec) {
+  int64_t cutoff;
+  if (!tablet_->GetRowTtlCutoff(&cutoff)) {
+    return;
+  }
+  // The bound is added to a copy of the spec, so that the spec doesn't
+  // refer to it once this iterator is destroyed.
+  tablet_->EncodeRowTtlCutoff(cutoff, &ttl_key_buf_, &ttl_lower_bound_);
+  if (*spec != nullptr) {
+    ttl_spec_ = **spec;
+  }
+  ttl_spec_.SetLowerBoundKey(ttl_lower_bound_.get());
+  *spec = &ttl_spec_;
+}
+
+bool Tablet::Iterator::GetResumePosition(ScanResumePosition* position) const {
+  if (!resume_position_) {
+    return false;
+  }
+  // Rows of the rest of the tablet can only be found again by their keys if
+  // they're returned in key order.
+  if (resume_position_->rowset_idx == resume_position_->rowset_block_ids.size() &&
+      !resume_position_->last_key.empty() && !rest_in_key_order_) {
+    return false;
+  }
+  *position = *resume_position_;
+  return true;
+}
+
 bool Tablet::Iterator::HasNext() const {
   DCHECK(iter_.get() != nullptr) << "Not initialized!";
   return iter_->HasNext();
@@ -22,9 +22,12 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "kudu/common/iterator.h"
+#include "kudu/common/scan_spec.h"
 #include "kudu/common/schema.h"
 #include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/gscoped_ptr.h"
@@ -34,6 +37,8 @@
 #include "kudu/tablet/lock_manager.h"
 #include "kudu/tablet/mvcc.h"
 #include "kudu/tablet/rowset.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/semaphore.h"
@@ -43,9 +48,13 @@
 
 namespace kudu {
 
+class EncodedKey;
+struct IterWithBounds;
 class MemTracker;
 class MetricEntity;
+class RowBlock;
 class RowChangeList;
+class ThreadPool;
 class UnionIterator;
 
 namespace log {
@@ -74,6 +83,25 @@ struct TabletComponents;
 struct TabletMetrics;
 class WriteTransactionState;
 
+// The position of a resumable scan of a tablet, as of the last row it
+// returned. See Tablet::NewResumableRowIterator().
+struct ScanResumePosition {
+  // Identifies each of the disk rowsets which were in the tablet when the
+  // scan started, in the order the scan reads them, by the block ID of its
+  // first key column. Unlike rowset IDs, block IDs aren't shared with copies
+  // of the tablet on other servers.
+  std::vector<uint64_t> rowset_block_ids;
+
+  // The index in 'rowset_block_ids' of the rowset which returned 'last_key',
+  // or the size of 'rowset_block_ids' if the row came from the rest of the
+  // tablet, which is read last.
+  int rowset_idx = 0;
+
+  // The encoded primary key of the last row returned by the rowset at
+  // 'rowset_idx', or empty if it hasn't returned any yet.
+  std::string last_key;
+};
+
 class Tablet {
  public:
   typedef std::map<int64_t, int64_t> MaxIdxToSegmentMap;
@@ -194,7 +222,9 @@ class Tablet {
   // Whether the iterator should return results in order.
   enum OrderMode {
     UNORDERED = 0,
-    ORDERED = 1
+    ORDERED = 1,
+    // In descending key order. The projection must include the key columns.
+    REVERSE_ORDERED = 2
   };
 
   // Create a new row iterator for some historical snapshot.
@@ -203,6 +233,75 @@ class Tablet {
                         const OrderMode order,
                         gscoped_ptr<RowwiseIterator> *iter) const;
 
+  // As above, but if 'order' is UNORDERED and 'max_parallelism' is greater
+  // than 1, up to 'max_parallelism' rowsets are read concurrently on the
+  // tablet's scan thread pool.
+  Status NewRowIterator(const Schema &projection,
+                        const MvccSnapshot &snap,
+                        const OrderMode order,
+                        int max_parallelism,
+                        gscoped_ptr<RowwiseIterator> *iter) const;
+
+  // Create a new UNORDERED row iterator for 'snap' whose position can be
+  // saved with Iterator::GetResumePosition(), so that another iterator at the
+  // same snapshot may continue from it, even after the tablet is reopened.
+  //
+  // The disk rowsets which are in the tablet when the scan starts are read
+  // one at a time, in key order; the rest of the tablet (the memrowset and
+  // the rowsets written since) is read last, also in key order. 'projection'
+  // must include the key columns.
+  //
+  // If 'resume_from' is non-NULL, the scan continues from that position.
+  // Init() then fails with IllegalState if any of the rowsets it started
+  // with is gone, e.g. compacted away.
+  Status NewResumableRowIterator(const Schema& projection,
+                                 const MvccSnapshot& snap,
+                                 const ScanResumePosition* resume_from,
+                                 gscoped_ptr<RowwiseIterator>* iter) const;
+
+  // Look up the rows visible in 'snap' whose encoded primary keys are
+  // 'encoded_keys', which must be sorted and unique, without a tablet-wide
+  // iterator: each key is only looked for in the memrowset and in the disk
+  // rowsets whose key ranges and bloom filters may hold it.
+  //
+  // The rows found are projected onto 'projection', which must not have
+  // column IDs, and stored in order at the start of 'block', which must
+  // have room for a row per key and is resized to the rows found. Their
+  // indexes in 'encoded_keys' are stored in 'found_keys'.
+  Status LookupRows(const Schema& projection,
+                    const MvccSnapshot& snap,
+                    const std::vector<Slice>& encoded_keys,
+                    RowBlock* block,
+                    std::vector<int>* found_keys) const;
+
+  // Count the rows visible in 'snap', as a scan without predicates would,
+  // counting from each rowset's metadata where it allows (see
+  // RowSet::CountVisibleRows()) and scanning the rest with an empty
+  // projection. Sets 'num_scanned_rowsets' to the number of rowsets scanned.
+  Status CountRows(const MvccSnapshot& snap, int64_t* count,
+                   int* num_scanned_rowsets) const;
+
+  // Compute the checksum of the rows visible in 'snap', projected onto the
+  // tablet's schema, as a checksum scan would (see RowChecksummer). The
+  // rowsets whose cached checksums still stand are not read; the rest of
+  // the tablet is scanned on up to 'max_parallelism' threads of the scan
+  // pool. Sets 'num_cached_rowsets' to the number of rowsets not read.
+  Status ChecksumRows(const MvccSnapshot& snap,
+                      int max_parallelism,
+                      uint64_t* checksum,
+                      int64_t* num_rows,
+                      int* num_cached_rowsets) const;
+
+  // Set 'hot_blocks' to the blocks of the tablet's rowsets which were
+  // sampled as hot in the block cache, up to --tablet_max_hot_blocks of
+  // them, and to the IDs of their columns. See RowSet::GetHotBlocks().
+  void GetHotBlocks(HotBlocksPB* hot_blocks) const;
+
+  // Read the blocks of 'hot_blocks' which belong to the tablet's rowsets
+  // into the block cache, as well as the index root blocks of its columns.
+  // Sets 'num_loaded' to the number of blocks read from disk.
+  Status WarmUpBlockCache(const HotBlocksPB& hot_blocks, int* num_loaded);
+
   // Flush the current MemRowSet for this tablet to disk. This swaps
   // in a new (initially empty) MemRowSet in its place.
   //
@@ -283,10 +382,23 @@ class Tablet {
   // Flush only the biggest DMS
   Status FlushBiggestDMS();
 
+  // Flush every non-empty DMS.
+  Status FlushAllDMS();
+
   // Finds the RowSet which has the most separate delta files and
   // issues a delta compaction.
   Status CompactWorstDeltas(RowSet::DeltaCompactionType type);
 
+  // Return the estimated number of bytes of UNDO deltas in this tablet's
+  // rowsets which only hold history older than the ancient history mark.
+  int64_t EstimateBytesInAncientUndoDeltas() const;
+
+  // Discard the UNDO deltas older than the ancient history mark from the
+  // rowsets which aren't being compacted, without rewriting their base data.
+  // At most --undo_delta_block_gc_rewrite_budget_mb of partly ancient delta
+  // files are rewritten. Sets '*bytes_reclaimed' to the number of bytes freed.
+  Status GCAncientUndoDeltas(int64_t* bytes_reclaimed);
+
   // Get the highest performance improvement that would come from compacting the delta stores
   // of one of the rowsets. If the returned performance improvement is 0, or if 'rs' is NULL,
   // then 'rs' isn't set. Callers who already own compact_select_lock_
@@ -307,6 +419,35 @@ class Tablet {
   // memrowset in the current implementation.
   Status CountRows(uint64_t *count) const;
 
+  // Merge the statistics of every column of the tablet's schema over all of
+  // its rowsets into 'stats', keyed by column name.
+  //
+  // Like the rowsets' statistics, they only describe flushed base data: rows
+  // in the MemRowSet and mutations in delta stores are not reflected. A
+  // column is absent if some rowset has no statistics for it, e.g. because
+  // the rowset was written before statistics were recorded.
+  Status GetColumnStatistics(std::map<std::string, ColumnStatisticsPB>* stats) const;
+
+  // Set 'split_keys' to encoded primary keys which split the key range from
+  // 'start_key' (inclusive) to 'stop_key' (exclusive) into chunks of about
+  // 'target_chunk_size_bytes' of on-disk data each, in ascending order. An
+  // empty key leaves that end of the range unbounded.
+  //
+  // The chunk sizes are estimated from samples of the rowsets' keys, each
+  // standing for an equal share of its rowset's size. Rows in the MemRowSet
+  // aren't accounted for.
+  Status SplitKeyRange(const std::string& start_key,
+                       const std::string& stop_key,
+                       uint64_t target_chunk_size_bytes,
+                       std::vector<std::string>* split_keys) const;
+
+  // Set 'split_key' to an encoded primary key which splits the tablet's
+  // on-disk data in about equal halves, or to an empty string if no key does.
+  //
+  // Unlike SplitKeyRange(), only the key bounds of the rowsets are used, so
+  // this is cheap but only accurate when the rowsets don't overlap much, e.g.
+  // for tablets of monotonically increasing keys.
+  Status EstimateSplitKey(std::string* split_key) const;
 
   // Verbosely dump this entire tablet to the logs. This is only
   // really useful when debugging unit tests failures where the tablet
@@ -324,12 +465,31 @@ class Tablet {
   // Return the MVCC manager for this tablet.
   MvccManager* mvcc_manager() { return &mvcc_; }
 
+  // Returns the largest timestamp of the writes applied to this tablet since
+  // it was opened, or Timestamp::kMin if there were none. While it's at or
+  // below a clean snapshot, no write changed the rows visible at the
+  // snapshots between it and the snapshot.
+  Timestamp last_write_timestamp() const {
+    return Timestamp(last_write_timestamp_.Load());
+  }
+
+  // Identifies the history of the rows of this tablet within this process.
+  // It changes when the tablet is reopened, since the writes applied before
+  // aren't reflected in last_write_timestamp().
+  uint64_t row_history_id() const { return row_history_id_.Load(); }
+
   // Return the Lock Manager for this tablet
   LockManager* lock_manager() { return &lock_manager_; }
 
   const TabletMetadata *metadata() const { return metadata_.get(); }
   TabletMetadata *metadata() { return metadata_.get(); }
 
+  // Sets the pool, shared by the tablets of the server, which encodes the
+  // columns of flush and compaction output while the merge continues. Without
+  // one, the flushing thread does all of the work. Must be called before the
+  // tablet's maintenance ops are registered.
+  void SetCompactionEncodePool(ThreadPool* pool) { compaction_encode_pool_ = pool; }
+
   void SetCompactionHooksForTests(const std::shared_ptr<CompactionFaultHooks> &hooks);
   void SetFlushHooksForTests(const std::shared_ptr<FlushFaultHooks> &hooks);
   void SetFlushCompactCommonHooksForTests(
@@ -355,6 +515,28 @@ class Tablet {
   // Calculates history GC options based on properties of the Clock implementation.
   HistoryGcOpts GetHistoryGcOpts() const;
 
+  // If the table has a row TTL, sets 'cutoff' to the smallest leading key
+  // value of the rows which haven't expired and returns true. Otherwise,
+  // returns false.
+  //
+  // The cutoff never decreases, even if the wall clock goes backwards.
+  bool GetRowTtlCutoff(int64_t* cutoff) const WARN_UNUSED_RESULT;
+
+  // Like GetRowTtlCutoff(), but for a write at 'timestamp'. The cutoff only
+  // depends on the timestamp, so that every replica of the tablet makes the
+  // same decision for the same replicated write. Without a physical clock,
+  // falls back to GetRowTtlCutoff().
+  bool GetRowTtlCutoffAt(Timestamp timestamp, int64_t* cutoff) const WARN_UNUSED_RESULT;
+
+  // Like GetRowTtlCutoff(), but for flushes and compactions, which drop the
+  // rows below the cutoff. The cutoff is at most that of any write which
+  // hasn't been applied yet, so that every replica keeps the rows a later
+  // write can still reach, and no write reaches a row a compaction dropped.
+  bool GetRowTtlDropCutoff(int64_t* cutoff) const WARN_UNUSED_RESULT;
+
+  // Returns whether the rows of the tablet expire.
+  bool has_row_ttl() const { return row_ttl_usec_ != 0; }
+
   // Method used by tests to retrieve all rowsets of this table. This
   // will be removed once code for selecting the appropriate RowSet is
   // finished and delta files is finished is part of Tablet class.
@@ -369,6 +551,11 @@ class Tablet {
 
   const std::string& tablet_id() const { return metadata_->tablet_id(); }
 
+  // Return the MaintenanceOp::io_target() of ops which read and write this
+  // tablet's data blocks: the set of data directories the tablet's blocks are
+  // placed in, which is all of them unless it has a data dir group.
+  std::string DataIOTarget() const;
+
   // Return the metrics for this tablet.
   // May be NULL in unit tests, etc.
   TabletMetrics* metrics() { return metrics_.get(); }
@@ -386,6 +573,13 @@ class Tablet {
   scoped_refptr<server::Clock> clock() const { return clock_; }
 
   static const char* kDMSMemTrackerId;
+
+  // Ids of the children of the tablet's tracker charged with the memory of
+  // the cfile readers (including their index roots), of the loaded bloom
+  // filters, and of the RowSetTree.
+  static const char* kCFileReaderMemTrackerId;
+  static const char* kBloomFilterMemTrackerId;
+  static const char* kRowSetTreeMemTrackerId;
  private:
   friend class Iterator;
   friend class TabletPeerTest;
@@ -408,6 +602,12 @@ class Tablet {
                            RowOp* mutate,
                            ProbeStats* stats);
 
+  // Same as above, but for INCREMENT: reads the current row and performs an
+  // UPDATE of the incremented columns to their sums.
+  Status IncrementRowUnlocked(WriteTransactionState *tx_state,
+                              RowOp* increment,
+                              ProbeStats* stats);
+
   // In the case of an UPSERT against a duplicate row, converts the UPSERT
   // into an internal UPDATE operation and performs it.
   Status ApplyUpsertAsUpdate(WriteTransactionState *tx_state,
@@ -417,9 +617,29 @@ class Tablet {
 
   // Return the list of RowSets that need to be consulted when processing the
   // given insertion or mutation.
+  //
+  // If the rowsets were already found by BatchFindRowSetsToCheck(), they
+  // are handed over from the op.
   static std::vector<RowSet*> FindRowSetsToCheck(RowOp* op,
                                                  const TabletComponents* comps);
 
+  // Find the rowsets to check for every op of the transaction at once, in
+  // key order, and store them in the ops. Rowsets whose base data bloom
+  // filter rules out an op's key are dropped from its list.
+  //
+  // 'stats_array' holds one ProbeStats per op of the transaction.
+  void BatchFindRowSetsToCheck(WriteTransactionState* tx_state,
+                               ProbeStats* stats_array);
+
+  // Sets 'candidates' to the rowsets of 'comps' which may hold the key of
+  // each of 'probes', which must be sorted by key, ruling out the rowsets
+  // whose bloom filters don't have it. 'stats' holds one ProbeStats per
+  // probe.
+  void FindRowSetsMaybeWithKeys(const TabletComponents& comps,
+                                const std::vector<const RowSetKeyProbe*>& probes,
+                                const std::vector<ProbeStats*>& stats,
+                                std::vector<std::vector<RowSet*>>* candidates) const;
+
 
   // Capture a set of iterators which, together, reflect all of the data in the tablet.
   //
@@ -427,16 +647,65 @@ class Tablet {
   // concurrent modification. They will include all data that was present at the time
   // of creation, and potentially newer data.
   //
-  // The returned iterators are not Init()ed.
+  // The returned iterators are not Init()ed. Each is returned along with the
+  // smallest key of its rowset, if known.
   // 'projection' must remain valid and unchanged for the lifetime of the returned iterators.
   Status CaptureConsistentIterators(const Schema *projection,
                                     const MvccSnapshot &snap,
                                     const ScanSpec *spec,
-                                    vector<std::shared_ptr<RowwiseIterator> > *iters) const;
-
+                                    vector<IterWithBounds> *iters) const;
+
+  // Captures the iterators of a resumable scan as of 'position', filling in
+  // its rowsets if 'new_scan' is true: one for each rowset at or after its
+  // 'rowset_idx', followed by one for the rest of the tablet. Sets
+  // 'rest_in_key_order' to whether the latter yields its rows in key order,
+  // which it doesn't while a compaction is swapping out its input rowsets.
+  // See NewResumableRowIterator().
+  Status CaptureResumableIterators(const Schema* projection,
+                                   const MvccSnapshot& snap,
+                                   bool new_scan,
+                                   ScanResumePosition* position,
+                                   vector<std::shared_ptr<RowwiseIterator>>* iters,
+                                   bool* rest_in_key_order) const;
+
+  // Returns the estimated memory needed to compact the rowsets of 'tree'
+  // which are in 'picked'.
+  int64_t EstimateCompactionMemory(const RowSetTree& tree,
+                                   const std::unordered_set<RowSet*>& picked) const;
+
+  // Selects the rowsets of the next compaction and charges its estimated
+  // memory to a new tracker held by 'picked'. If that memory can't be spared,
+  // the compaction is shrunk by selecting again with smaller budgets, or
+  // deferred by selecting nothing.
   Status PickRowSetsToCompact(RowSetsInCompaction *picked,
                               CompactFlags flags) const;
 
+  // Removes the rowsets in which every row was deleted before the ancient
+  // history mark. Such rowsets would compact to nothing, so they are dropped
+  // by updating the tablet metadata without rewriting any data.
+  //
+  // Does nothing if history GC is disabled.
+  Status DropFullyDeletedRowSets();
+
+  // Returns the ancient history mark to pass to the compaction policy, or
+  // Timestamp::kMin if history GC is disabled.
+  Timestamp CompactionAncientHistoryMark() const;
+
+  // Removes the rowsets in which every row expired, by updating the tablet
+  // metadata like DropFullyDeletedRowSets().
+  //
+  // Does nothing if the table has no row TTL.
+  Status DropExpiredRowSets();
+
+  // Returns true if 'rs' has bounds and every one of its rows expired before
+  // the row TTL cutoff encoded by 'cutoff_key'.
+  static bool RowSetExpired(const RowSet& rs, const Slice& cutoff_key);
+
+  // Sets 'key' to the smallest key whose leading column is 'cutoff', with
+  // its cells in 'buf', which must outlive it.
+  void EncodeRowTtlCutoff(int64_t cutoff, faststring* buf,
+                          gscoped_ptr<EncodedKey>* key) const;
+
   // Performs a merge compaction or a flush.
   Status DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
                                   int64_t mrs_being_flushed);
@@ -485,8 +754,17 @@ class Tablet {
 
   BloomFilterSizing bloom_sizing() const;
 
+  // Return the pool and memory tracker used by parallel scans, creating them
+  // if needed.
+  Status GetScanPool(ThreadPool** pool, std::shared_ptr<MemTracker>* mem_tracker) const;
+
+  // Create the tracker for the data blocks read ahead of a single scan,
+  // limited to --tablet_scan_readahead_budget_mb.
+  std::shared_ptr<MemTracker> CreateScanReadaheadTracker() const;
+
   // Convert the specified read client schema (without IDs) to a server schema (with IDs)
-  // This method is used by NewRowIterator().
+  // This method is used by NewRowIterator(). The results are cached for the
+  // current schema.
   Status GetMappedReadProjection(const Schema& projection,
                                  Schema *mapped_projection) const;
 
@@ -545,6 +823,12 @@ class Tablet {
   scoped_refptr<log::LogAnchorRegistry> log_anchor_registry_;
   std::shared_ptr<MemTracker> mem_tracker_;
   std::shared_ptr<MemTracker> dms_mem_tracker_;
+  std::shared_ptr<MemTracker> cfile_reader_mem_tracker_;
+  std::shared_ptr<MemTracker> bloom_filter_mem_tracker_;
+  std::shared_ptr<MemTracker> rowset_tree_mem_tracker_;
+
+  // Parent of the trackers of each running compaction.
+  std::shared_ptr<MemTracker> compaction_mem_tracker_;
 
   scoped_refptr<MetricEntity> metric_entity_;
   gscoped_ptr<TabletMetrics> metrics_;
@@ -560,14 +844,26 @@ class Tablet {
   MvccManager mvcc_;
   LockManager lock_manager_;
 
+  // See last_write_timestamp() and row_history_id().
+  AtomicInt<uint64_t> last_write_timestamp_;
+  AtomicInt<uint64_t> row_history_id_;
+
   gscoped_ptr<CompactionPolicy> compaction_policy_;
 
+  // The row TTL of the table in microseconds, or 0 if rows never expire, and
+  // the largest cutoff returned by GetRowTtlCutoff().
+  int64_t row_ttl_usec_;
+  mutable AtomicInt<int64_t> row_ttl_cutoff_;
+
 
   // Lock protecting the selection of rowsets for compaction.
   // Only one thread may run the compaction selection algorithm at a time
   // so that they don't both try to select the same rowset.
   mutable std::mutex compact_select_lock_;
 
+  // The id of the next compaction's tracker. Protected by 'compact_select_lock_'.
+  mutable int64_t next_compaction_tracker_id_;
+
   // We take this lock when flushing the tablet's rowsets in Tablet::Flush.  We
   // don't want to have two flushes in progress at once, in case the one which
   // started earlier completes after the one started later.
@@ -588,6 +884,26 @@ class Tablet {
 
   std::vector<MaintenanceOp*> maintenance_ops_;
 
+  // Threads reading rowsets for parallel scans, and the tracker for the
+  // batches they read ahead. Created on first use. The pool is only shut down
+  // with the tablet since scanners may outlive Shutdown().
+  mutable std::mutex scan_pool_lock_;
+  mutable gscoped_ptr<ThreadPool> scan_pool_;
+  mutable std::shared_ptr<MemTracker> scan_mem_tracker_;
+
+  // The id of the next scan readahead tracker. Protected by 'scan_pool_lock_'.
+  mutable int64_t next_readahead_tracker_id_;
+
+  // Threads encoding flush and compaction output, or null. Not owned.
+  ThreadPool* compaction_encode_pool_;
+
+  // The mapped read projections of 'projection_cache_schema_', keyed by the
+  // names, types and nullability of the projected columns. Cleared when the
+  // schema changes, since every schema version is its own Schema object.
+  mutable simple_spinlock projection_cache_lock_;
+  mutable const Schema* projection_cache_schema_;
+  mutable std::unordered_map<std::string, std::shared_ptr<const Schema>> projection_cache_;
+
   DISALLOW_COPY_AND_ASSIGN(Tablet);
 };
 
@@ -636,19 +952,44 @@ class Tablet::Iterator : public RowwiseIterator {
 
   virtual void GetIteratorStats(std::vector<IteratorStats>* stats) const OVERRIDE;
 
+  // Sets 'position' to the position of a resumable scan as of the last row
+  // returned by NextBlock(), and returns true, unless the iterator wasn't
+  // made resumable or that row can't be found again.
+  bool GetResumePosition(ScanResumePosition* position) const;
+
  private:
   friend class Tablet;
 
   DISALLOW_COPY_AND_ASSIGN(Iterator);
 
   Iterator(const Tablet* tablet, const Schema& projection, MvccSnapshot snap,
-           const OrderMode order);
+           const OrderMode order, int max_parallelism);
+
+  // Sets 'iter_' up to read from 'resume_position_'.
+  Status InitResumable(ScanSpec* spec);
+
+  // If the table has a row TTL, bounds 'spec' to the rows which haven't
+  // expired. If 'spec' is NULL, it's set to 'ttl_spec_'.
+  void AddRowTtlBound(ScanSpec** spec);
 
   const Tablet *tablet_;
   Schema projection_;
   const MvccSnapshot snap_;
   const OrderMode order_;
+  const int max_parallelism_;
   gscoped_ptr<RowwiseIterator> iter_;
+
+  // For resumable scans, the position of the scan, kept up to date as rows
+  // are returned, and whether the rest of the tablet is read in key order.
+  // NULL otherwise.
+  gscoped_ptr<ScanResumePosition> resume_position_;
+  bool rest_in_key_order_;
+
+  // The lower bound of the scan set by AddRowTtlBound(), and the spec it's
+  // set on if the scan has none.
+  faststring ttl_key_buf_;
+  gscoped_ptr<EncodedKey> ttl_lower_bound_;
+  ScanSpec ttl_spec_;
 };
 
 // Structure which represents the components of the tablet's storage.
@@ -32,6 +32,8 @@
 #include "kudu/tablet/tablet-test-util.h"
 #include "kudu/tablet/tablet_metadata.h"
 
+DECLARE_int32(tablet_bootstrap_read_ahead_mb);
+
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
@@ -579,5 +581,51 @@ TEST_F(BootstrapTest, TestConsensusOnlyOperationOutOfOrderTimestamp) {
   ASSERT_EQ(1, results.size());
 }
 
+// Tests replaying a log spread over several segments while the read-ahead of
+// the log is limited to a single batch of entries at a time.
+TEST_F(BootstrapTest, TestReplayWithMinimalReadAhead) {
+  FLAGS_tablet_bootstrap_read_ahead_mb = 0;
+  ASSERT_OK(BuildLog());
+
+  const int kNumSegments = 4;
+  const int kNumOpsPerSegment = 10;
+  consensus::ReplicateRefPtr replicate = consensus::make_scoped_refptr_replicate(
+      new consensus::ReplicateMsg());
+  replicate->get()->set_op_type(consensus::WRITE_OP);
+  tserver::WriteRequestPB* batch_request = replicate->get()->mutable_write_request();
+  ASSERT_OK(SchemaToPB(schema_, batch_request->mutable_schema()));
+  batch_request->set_tablet_id(log::kTestTablet);
+
+  for (int i = 1; i <= kNumSegments * kNumOpsPerSegment; i++) {
+    OpId opid = MakeOpId(1, i);
+    batch_request->mutable_row_operations()->Clear();
+    replicate->get()->mutable_id()->CopyFrom(opid);
+    replicate->get()->set_timestamp(clock_->Now().ToUint64());
+    AddTestRowToPB(RowOperationsPB::INSERT, schema_, i, i,
+                   "this is a test insert", batch_request->mutable_row_operations());
+    AppendReplicateBatch(replicate, true);
+
+    gscoped_ptr<consensus::CommitMsg> commit(new consensus::CommitMsg);
+    commit->set_op_type(consensus::WRITE_OP);
+    commit->mutable_commited_op_id()->CopyFrom(opid);
+    commit->mutable_result()->add_ops()->add_mutated_stores()->set_mrs_id(1);
+    AppendCommit(std::move(commit));
+
+    if (i % kNumOpsPerSegment == 0) {
+      ASSERT_OK(RollLog());
+    }
+  }
+
+  ConsensusBootstrapInfo boot_info;
+  shared_ptr<Tablet> tablet;
+  ASSERT_OK(BootstrapTestTablet(-1, -1, &tablet, &boot_info));
+  ASSERT_EQ(0, boot_info.orphaned_replicates.size());
+  ASSERT_OPID_EQ(MakeOpId(1, kNumSegments * kNumOpsPerSegment), boot_info.last_committed_id);
+
+  vector<string> results;
+  IterateTabletRows(tablet.get(), &results);
+  ASSERT_EQ(kNumSegments * kNumOpsPerSegment, results.size());
+}
+
 } // namespace tablet
 } // namespace kudu
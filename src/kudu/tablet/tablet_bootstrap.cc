@@ -17,6 +17,7 @@
 
 #include "kudu/tablet/tablet_bootstrap.h"
 
+#include <algorithm>
 #include <gflags/gflags.h>
 #include <map>
 #include <memory>
@@ -30,6 +31,7 @@
 #include "kudu/consensus/consensus_meta.h"
 #include "kudu/consensus/log.h"
 #include "kudu/consensus/log_anchor_registry.h"
+#include "kudu/consensus/log_index.h"
 #include "kudu/consensus/log_reader.h"
 #include "kudu/consensus/log_util.h"
 #include "kudu/consensus/metadata.pb.h"
@@ -50,13 +52,16 @@
 #include "kudu/tablet/tablet_peer.h"
 #include "kudu/tablet/transactions/alter_schema_transaction.h"
 #include "kudu/tablet/transactions/write_transaction.h"
+#include "kudu/util/blocking_queue.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/fault_injection.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/path_util.h"
+#include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/stopwatch.h"
+#include "kudu/util/thread.h"
 
 DEFINE_bool(skip_remove_old_recovery_dir, false,
             "Skip removing WAL recovery dir after startup. (useful for debugging)");
@@ -68,7 +73,16 @@ DEFINE_double(fault_crash_during_log_replay, 0.0,
               "(For testing only!)");
 TAG_FLAG(fault_crash_during_log_replay, unsafe);
 
+DEFINE_int32(tablet_bootstrap_read_ahead_mb, 64,
+             "Maximum amount of WAL data, in MB, which may be read and decoded ahead "
+             "of its replay while bootstrapping a tablet. At least one batch of "
+             "entries is always read ahead, even if this is 0.");
+TAG_FLAG(tablet_bootstrap_read_ahead_mb, advanced);
+TAG_FLAG(tablet_bootstrap_read_ahead_mb, experimental);
+
 DECLARE_int32(max_clock_sync_error_usec);
+DECLARE_int64(remember_clients_ttl_ms);
+DECLARE_int64(remember_responses_ttl_ms);
 
 namespace kudu {
 namespace tablet {
@@ -98,6 +112,7 @@ using log::LogEntryPB;
 using log::LogOptions;
 using log::LogReader;
 using log::ReadableLogSegment;
+using log::SegmentSequence;
 using rpc::ResultTracker;
 using server::Clock;
 using std::map;
@@ -105,6 +120,7 @@ using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
 using std::unordered_map;
+using std::vector;
 using strings::Substitute;
 using tserver::AlterSchemaRequestPB;
 using tserver::WriteRequestPB;
@@ -146,6 +162,97 @@ class FlushedStoresSnapshot {
   DISALLOW_COPY_AND_ASSIGN(FlushedStoresSnapshot);
 };
 
+namespace {
+
+// The maximum number of entries handed over to the replaying thread at once.
+const int kMaxEntriesPerReadAheadBatch = 1024;
+
+// A run of consecutive entries of a log segment, read and decoded ahead of
+// their replay.
+struct ReadAheadBatch {
+  ReadAheadBatch()
+      : first_entry_idx(0),
+        bytes(0),
+        end_of_segment(false) {
+  }
+
+  scoped_refptr<ReadableLogSegment> segment;
+
+  // The position within 'segment' of the first of 'entries'.
+  int first_entry_idx;
+
+  vector<unique_ptr<LogEntryPB>> entries;
+
+  // The number of bytes of 'segment' spanned by 'entries'.
+  int64_t bytes;
+
+  // Whether 'entries' are the last entries of 'segment'.
+  bool end_of_segment;
+
+  // Set if reading 'segment' failed after 'entries'.
+  Status read_status;
+
+  // The time spent reading 'entries' from the segment and decoding them.
+  MonoDelta read_time;
+};
+
+struct ReadAheadBatchSize {
+  static size_t logical_size(const ReadAheadBatch* batch) {
+    return batch->bytes;
+  }
+};
+
+typedef BlockingQueue<ReadAheadBatch*, ReadAheadBatchSize> ReadAheadQueue;
+
+// Reads the entries of 'segments' in order and passes them to the replaying
+// thread through 'queue'. Shuts 'queue' down once all entries were read or
+// reading failed. Returns early if 'queue' is shut down by the replaying
+// thread.
+void ReadAheadSegments(const SegmentSequence& segments, ReadAheadQueue* queue) {
+  for (const scoped_refptr<ReadableLogSegment>& segment : segments) {
+    log::LogEntryReader reader(segment.get());
+    int entry_idx = 0;
+    bool end_of_segment = false;
+    while (!end_of_segment) {
+      unique_ptr<ReadAheadBatch> batch(new ReadAheadBatch);
+      batch->segment = segment;
+      batch->first_entry_idx = entry_idx;
+      int64_t start_offset = reader.offset();
+      MonoTime start = MonoTime::Now();
+      while (batch->entries.size() < kMaxEntriesPerReadAheadBatch) {
+        unique_ptr<LogEntryPB> entry(new LogEntryPB);
+        Status s = reader.ReadNextEntry(entry.get());
+        if (PREDICT_FALSE(!s.ok())) {
+          if (!s.IsEndOfFile()) {
+            batch->read_status = s;
+          }
+          end_of_segment = true;
+          break;
+        }
+        batch->entries.emplace_back(std::move(entry));
+      }
+      batch->read_time = MonoTime::Now() - start;
+      batch->bytes = reader.offset() - start_offset;
+      batch->end_of_segment = end_of_segment;
+      entry_idx += batch->entries.size();
+
+      bool read_failed = !batch->read_status.ok();
+      if (!queue->BlockingPut(batch.get())) {
+        // Replay stopped early.
+        return;
+      }
+      ignore_result(batch.release());
+      if (read_failed) {
+        queue->Shutdown();
+        return;
+      }
+    }
+  }
+  queue->Shutdown();
+}
+
+} // anonymous namespace
+
 // Bootstraps an existing tablet by opening the metadata from disk, and rebuilding soft
 // state by playing log segments. A bootstrapped tablet can then be added to an existing
 // consensus configuration as a LEARNER, which will bring its state up to date with the
@@ -210,6 +317,17 @@ class TabletBootstrap {
   // The directory is expected to be clean.
   Status OpenNewLog();
 
+  // Opens the log where it was left off by the clean shutdown recorded in
+  // 'clean_shutdown', if the WAL is as the shutdown left it. Sets '*opened'
+  // to whether it did, in which case the WAL doesn't need to be replayed.
+  Status OpenLogAfterCleanShutdown(const CleanShutdownPB& clean_shutdown, bool* opened);
+
+  // Registers the results of the committed writes in 'segments' with the
+  // result tracker, as replaying them would have, so that the retries of the
+  // writes which completed before 'clean_shutdown' aren't applied again.
+  Status RegisterWriteResults(const CleanShutdownPB& clean_shutdown,
+                              const SegmentSequence& segments);
+
   // Finishes bootstrap, setting 'rebuilt_log' and 'rebuilt_tablet'.
   Status FinishBootstrap(const string& message,
                          scoped_refptr<log::Log>* rebuilt_log,
@@ -336,18 +454,23 @@ class TabletBootstrap {
         inserts_ignored(0),
         mutations_seen(0),
         mutations_ignored(0),
-        orphaned_commits(0) {
+        orphaned_commits(0),
+        read_us(0),
+        read_wait_us(0),
+        replay_us(0) {
     }
 
     string ToString() const {
-      return Substitute("ops{read=$0 overwritten=$1 applied=$2 ignored=$3} "
-                        "inserts{seen=$4 ignored=$5} "
-                        "mutations{seen=$6 ignored=$7} "
-                        "orphaned_commits=$8",
-                        ops_read, ops_overwritten, ops_committed, ops_ignored,
-                        inserts_seen, inserts_ignored,
-                        mutations_seen, mutations_ignored,
-                        orphaned_commits);
+      return StrCat(Substitute("ops{read=$0 overwritten=$1 applied=$2 ignored=$3} "
+                               "inserts{seen=$4 ignored=$5} "
+                               "mutations{seen=$6 ignored=$7} "
+                               "orphaned_commits=$8",
+                               ops_read, ops_overwritten, ops_committed, ops_ignored,
+                               inserts_seen, inserts_ignored,
+                               mutations_seen, mutations_ignored,
+                               orphaned_commits),
+                    Substitute(" time{read=$0ms read_wait=$1ms replay=$2ms}",
+                               read_us / 1000, read_wait_us / 1000, replay_us / 1000));
     }
 
     // Number of REPLICATE messages read from the log
@@ -367,6 +490,13 @@ class TabletBootstrap {
 
     // Number of COMMIT messages for which a corresponding REPLICATE was not found.
     int orphaned_commits;
+
+    // Time spent reading and decoding log entries on the read-ahead thread.
+    int64_t read_us;
+    // Time the replaying thread spent waiting for entries to be read.
+    int64_t read_wait_us;
+    // Time spent replaying log entries.
+    int64_t replay_us;
   };
   Stats stats_;
 
@@ -471,6 +601,22 @@ Status TabletBootstrap::Bootstrap(shared_ptr<Tablet>* rebuilt_tablet,
   bool has_blocks;
   RETURN_NOT_OK(OpenTablet(&has_blocks));
 
+  // The record of a clean shutdown only holds until the log is appended to,
+  // so it's cleared whether or not it allows skipping the replay. The
+  // metadata is pinned, so this only persists once bootstrap is finished.
+  CleanShutdownPB clean_shutdown;
+  if (meta_->TakeCleanShutdown(&clean_shutdown)) {
+    RETURN_NOT_OK(meta_->Flush());
+    bool opened;
+    RETURN_NOT_OK(OpenLogAfterCleanShutdown(clean_shutdown, &opened));
+    if (opened) {
+      consensus_info->last_id = clean_shutdown.last_op_id();
+      consensus_info->last_committed_id = clean_shutdown.last_op_id();
+      return FinishBootstrap("Bootstrap complete, no replay needed after a clean shutdown.",
+                             rebuilt_log, rebuilt_tablet);
+    }
+  }
+
   bool needs_recovery;
   RETURN_NOT_OK(PrepareRecoveryDir(&needs_recovery));
   if (needs_recovery) {
@@ -670,6 +816,132 @@ Status TabletBootstrap::OpenNewLog() {
   return Status::OK();
 }
 
+Status TabletBootstrap::OpenLogAfterCleanShutdown(const CleanShutdownPB& clean_shutdown,
+                                                  bool* opened) {
+  *opened = false;
+  FsManager* fs_manager = meta_->fs_manager();
+  const string& tablet_id = meta_->tablet_id();
+  // A recovery directory is left by a bootstrap which didn't finish, so the
+  // WAL has changed since the shutdown.
+  if (fs_manager->Exists(fs_manager->GetTabletWalRecoveryDir(tablet_id)) ||
+      !fs_manager->Exists(fs_manager->GetTabletWalDir(tablet_id))) {
+    LOG_WITH_PREFIX(INFO) << "Ignoring the clean shutdown: the WAL has changed since";
+    return Status::OK();
+  }
+
+  // The last segment holding operations must be closed, and end with the
+  // last operation of the shutdown.
+  shared_ptr<LogReader> reader;
+  RETURN_NOT_OK_PREPEND(LogReader::Open(fs_manager, nullptr, tablet_id,
+                                        tablet_->GetMetricEntity(), &reader),
+                        "Could not open LogReader");
+  SegmentSequence segments;
+  RETURN_NOT_OK(reader->GetSegmentsSnapshot(&segments));
+  const int64_t last_index = clean_shutdown.last_op_id().index();
+  bool found = false;
+  for (auto it = segments.rbegin(); it != segments.rend(); ++it) {
+    if (!(*it)->HasFooter()) {
+      break;
+    }
+    int64_t max_index = (*it)->footer().max_replicate_index();
+    if (max_index != -1) {
+      found = max_index == last_index;
+      break;
+    }
+  }
+  if (!found) {
+    LOG_WITH_PREFIX(INFO) << "Ignoring the clean shutdown at "
+                          << OpIdToString(clean_shutdown.last_op_id())
+                          << ": the WAL doesn't end there";
+    return Status::OK();
+  }
+
+  RETURN_NOT_OK_PREPEND(RegisterWriteResults(clean_shutdown, segments),
+                        "Failed to register the results of the writes in the WAL");
+
+  // Everything up to the shutdown is committed and flushed: keep the clock
+  // and MVCC ahead of it, as replaying the WAL would have.
+  RETURN_NOT_OK(UpdateClock(clean_shutdown.timestamp()));
+  tablet_->mvcc_manager()->OfflineAdjustSafeTime(Timestamp(clean_shutdown.timestamp()));
+
+  // The log continues from the existing segments, which are kept for peers
+  // to catch up from until they're GCed.
+  RETURN_NOT_OK_PREPEND(OpenNewLog(), "Failed to open log");
+  LOG_WITH_PREFIX(INFO) << "Skipping log replay after a clean shutdown at "
+                        << OpIdToString(clean_shutdown.last_op_id());
+  *opened = true;
+  return Status::OK();
+}
+
+Status TabletBootstrap::RegisterWriteResults(const CleanShutdownPB& clean_shutdown,
+                                             const SegmentSequence& segments) {
+  if (!result_tracker_) {
+    return Status::OK();
+  }
+  // Past this long, the tracker would have forgotten the clients of the writes
+  // and their results anyway.
+  int64_t retention_us = std::max(FLAGS_remember_clients_ttl_ms,
+                                  FLAGS_remember_responses_ttl_ms) * 1000;
+  if (clean_shutdown.has_wall_time_us() &&
+      GetCurrentTimeMicros() - static_cast<int64_t>(clean_shutdown.wall_time_us()) >
+      retention_us) {
+    return Status::OK();
+  }
+
+  // Only the entries are read: the writes were all applied and flushed before
+  // the shutdown. The writes with request ids are kept by index until their
+  // commit is read.
+  map<int64_t, unique_ptr<LogEntryPB>> pending_writes;
+  int num_registered = 0;
+  for (const scoped_refptr<ReadableLogSegment>& segment : segments) {
+    log::LogEntryReader reader(segment.get());
+    while (true) {
+      unique_ptr<LogEntryPB> entry(new LogEntryPB);
+      Status s = reader.ReadNextEntry(entry.get());
+      if (s.IsEndOfFile()) {
+        break;
+      }
+      RETURN_NOT_OK_PREPEND(s, Substitute("Could not read log segment $0", segment->path()));
+
+      if (entry->type() == log::REPLICATE) {
+        // As in replay, a replicate overwrites the uncommitted ones from its
+        // index on.
+        const ReplicateMsg& replicate = entry->replicate();
+        int64_t index = replicate.id().index();
+        pending_writes.erase(pending_writes.lower_bound(index), pending_writes.end());
+        if (replicate.op_type() == WRITE_OP && replicate.has_request_id()) {
+          pending_writes.emplace(index, std::move(entry));
+        }
+        continue;
+      }
+      if (entry->type() != log::COMMIT) {
+        continue;
+      }
+      const CommitMsg& commit = entry->commit();
+      auto it = pending_writes.find(commit.commited_op_id().index());
+      if (it == pending_writes.end() ||
+          !OpIdEquals(it->second->replicate().id(), commit.commited_op_id())) {
+        continue;
+      }
+      const ReplicateMsg& replicate = it->second->replicate();
+      if (result_tracker_->TrackRpcOrChangeDriver(replicate.request_id()) ==
+          ResultTracker::RpcState::NEW) {
+        WriteResponsePB response;
+        response.set_timestamp(replicate.timestamp());
+        vector<bool> already_flushed;
+        RETURN_NOT_OK(DetermineFlushedOpsAndBuildResponse(commit.result(), &already_flushed,
+                                                          &response));
+        result_tracker_->RecordCompletionAndRespond(replicate.request_id(), &response);
+        num_registered++;
+      }
+      pending_writes.erase(it);
+    }
+  }
+  LOG_WITH_PREFIX(INFO) << "Registered the results of " << num_registered
+                        << " writes from the WAL";
+  return Status::OK();
+}
+
 typedef map<int64_t, LogEntryPB*> OpIndexToEntryMap;
 
 // State kept during replay.
@@ -1044,30 +1316,39 @@ Status TabletBootstrap::PlaySegments(ConsensusBootstrapInfo* consensus_info) {
   // writing.
   RETURN_NOT_OK_PREPEND(OpenNewLog(), "Failed to open new log");
 
-  int segment_count = 0;
-  for (const scoped_refptr<ReadableLogSegment>& segment : segments) {
-    log::LogEntryReader reader(segment.get());
+  // The segments are read and decoded on a separate thread, so that reading
+  // the next entries overlaps with replaying the current ones.
+  ReadAheadQueue queue(std::max<int64_t>(
+      1, static_cast<int64_t>(FLAGS_tablet_bootstrap_read_ahead_mb) * 1024 * 1024));
+  scoped_refptr<Thread> read_ahead_thread;
+  RETURN_NOT_OK(Thread::Create("tablet-bootstrap", "log-read-ahead",
+                               &ReadAheadSegments, segments, &queue, &read_ahead_thread));
+  auto stop_read_ahead = MakeScopedCleanup([&]() {
+    queue.Shutdown();
+    CHECK_OK(ThreadJoiner(read_ahead_thread.get()).Join());
+    ReadAheadBatch* batch;
+    while (queue.BlockingGet(&batch)) {
+      delete batch;
+    }
+  });
 
-    int entry_count = 0;
-    while (true) {
-      unique_ptr<LogEntryPB> entry(new LogEntryPB);
+  int segment_count = 0;
+  while (true) {
+    MonoTime wait_start = MonoTime::Now();
+    gscoped_ptr<ReadAheadBatch> batch;
+    if (!queue.BlockingGet(&batch)) {
+      break;
+    }
+    MonoTime replay_start = MonoTime::Now();
+    stats_.read_wait_us += (replay_start - wait_start).ToMicroseconds();
+    stats_.read_us += batch->read_time.ToMicroseconds();
 
-      Status s = reader.ReadNextEntry(entry.get());
-      if (PREDICT_FALSE(!s.ok())) {
-        if (s.IsEndOfFile()) {
-          break;
-        }
-        return Status::Corruption(Substitute("Error reading Log Segment of tablet $0: $1 "
-                                             "(Read up to entry $2 of segment $3, in path $4)",
-                                             tablet_->tablet_id(),
-                                             s.ToString(),
-                                             entry_count,
-                                             segment->header().sequence_number(),
-                                             segment->path()));
-      }
+    const scoped_refptr<ReadableLogSegment>& segment = batch->segment;
+    int entry_count = batch->first_entry_idx;
+    for (unique_ptr<LogEntryPB>& entry : batch->entries) {
       entry_count++;
 
-      s = HandleEntry(&state, entry.get());
+      Status s = HandleEntry(&state, entry.get());
       if (!s.ok()) {
         DumpReplayStateToLog(state);
         RETURN_NOT_OK_PREPEND(s, DebugInfo(tablet_->tablet_id(),
@@ -1077,18 +1358,31 @@ Status TabletBootstrap::PlaySegments(ConsensusBootstrapInfo* consensus_info) {
       }
 
       // If HandleEntry returns OK, then it has taken ownership of the entry.
-      entry.release();
+      ignore_result(entry.release());
+    }
+    stats_.replay_us += (MonoTime::Now() - replay_start).ToMicroseconds();
+
+    if (PREDICT_FALSE(!batch->read_status.ok())) {
+      return Status::Corruption(Substitute("Error reading Log Segment of tablet $0: $1 "
+                                           "(Read up to entry $2 of segment $3, in path $4)",
+                                           tablet_->tablet_id(),
+                                           batch->read_status.ToString(),
+                                           entry_count,
+                                           segment->header().sequence_number(),
+                                           segment->path()));
     }
 
-    // TODO: could be more granular here and log during the segments as well,
-    // plus give info about number of MB processed, but this is better than
-    // nothing.
-    StatusMessage(Substitute("Bootstrap replayed $0/$1 log segments. "
-                             "Stats: $2. Pending: $3 replicates",
-                             segment_count + 1, log_reader_->num_segments(),
-                             stats_.ToString(),
-                             state.pending_replicates.size()));
-    segment_count++;
+    if (batch->end_of_segment) {
+      // TODO: could be more granular here and log during the segments as well,
+      // plus give info about number of MB processed, but this is better than
+      // nothing.
+      StatusMessage(Substitute("Bootstrap replayed $0/$1 log segments. "
+                               "Stats: $2. Pending: $3 replicates",
+                               segment_count + 1, log_reader_->num_segments(),
+                               stats_.ToString(),
+                               state.pending_replicates.size()));
+      segment_count++;
+    }
   }
 
   // If we have non-applied commits they all must belong to pending operations and
@@ -1386,7 +1680,8 @@ Status TabletBootstrap::ApplyOperations(WriteTransactionState* tx_state,
         break;
       }
       case RowOperationsPB::UPDATE:
-      case RowOperationsPB::DELETE: {
+      case RowOperationsPB::DELETE:
+      case RowOperationsPB::INCREMENT: {
         stats_.mutations_seen++;
         if (op->has_result()) {
           stats_.mutations_ignored++;
@@ -18,6 +18,7 @@
 #include <atomic>
 #include <gflags/gflags.h>
 
+#include "kudu/gutil/strings/util.h"
 #include "kudu/server/hybrid_clock.h"
 #include "kudu/tablet/compaction.h"
 #include "kudu/tablet/mvcc.h"
@@ -334,6 +335,82 @@ TEST_F(TabletHistoryGcTest, TestNoUndoGCUntilAncientHistoryMark) {
                                R"(@[[:digit:]]+\(DELETE\)\] Redos: \[\]$)");
 }
 
+// Test that UNDO delta files which only hold ancient history are dropped
+// without compacting their rowsets.
+TEST_F(TabletHistoryGcTest, TestUndoDeltaBlockGC) {
+  FLAGS_tablet_history_max_age_sec = 100;
+
+  NO_FATALS(InsertOriginalRows(num_rowsets_, rows_per_rowset_));
+  ASSERT_DEBUG_DUMP_ROWS_MATCH(R"(int32 val=0\) Undos: \[@[[:digit:]]+\(DELETE\)\] Redos: \[\]$)");
+
+  // Nothing is ancient yet.
+  int64_t bytes_reclaimed;
+  ASSERT_OK(tablet()->GCAncientUndoDeltas(&bytes_reclaimed));
+  ASSERT_EQ(0, bytes_reclaimed);
+  ASSERT_EQ(0, tablet()->EstimateBytesInAncientUndoDeltas());
+
+  // Move the AHM past the inserts: every UNDO file is now ancient.
+  NO_FATALS(AddTimeToHybridClock(MonoDelta::FromSeconds(200)));
+  ASSERT_GT(tablet()->EstimateBytesInAncientUndoDeltas(), 0);
+  ASSERT_OK(tablet()->GCAncientUndoDeltas(&bytes_reclaimed));
+  ASSERT_GT(bytes_reclaimed, 0);
+  ASSERT_EQ(0, tablet()->EstimateBytesInAncientUndoDeltas());
+
+  ASSERT_EQ(num_rowsets_, tablet()->num_rowsets());
+  for (const std::shared_ptr<RowSetMetadata>& rowset_meta : tablet()->metadata()->rowsets()) {
+    ASSERT_TRUE(rowset_meta->undo_delta_blocks().empty());
+  }
+  ASSERT_DEBUG_DUMP_ROWS_MATCH(R"(int32 val=0\) Undos: \[\] Redos: \[\]$)");
+  NO_FATALS(VerifyTestRowsWithVerifier(kStartRow, TotalNumRows(), kRowsEqual0));
+}
+
+// Test that an UNDO delta file which is mostly, but not entirely, ancient is
+// rewritten with only its recent history.
+TEST_F(TabletHistoryGcTest, TestUndoDeltaBlockGCRewritesPartlyAncientFiles) {
+  FLAGS_tablet_history_max_age_sec = 100;
+
+  // Insert half of the rows 100 seconds before the other half, into a single
+  // rowset.
+  ClampRowCount(rows_per_rowset_);
+  const int kHalf = rows_per_rowset_ / 2;
+  InsertTestRows(0, kHalf, 0);
+  NO_FATALS(AddTimeToHybridClock(MonoDelta::FromSeconds(100)));
+  Timestamp time_after_first_half = clock()->Now();
+  InsertTestRows(kHalf, rows_per_rowset_ - kHalf, 0);
+  ASSERT_OK(tablet()->Flush());
+  ASSERT_EQ(1, tablet()->num_rowsets());
+  BlockId old_undo_block = tablet()->metadata()->rowsets()[0]->undo_delta_blocks()[0];
+
+  // Move the AHM between the two halves.
+  NO_FATALS(AddTimeToHybridClock(MonoDelta::FromSeconds(95)));
+  int64_t bytes_reclaimed;
+  ASSERT_OK(tablet()->GCAncientUndoDeltas(&bytes_reclaimed));
+  ASSERT_GT(bytes_reclaimed, 0);
+
+  vector<BlockId> undo_blocks = tablet()->metadata()->rowsets()[0]->undo_delta_blocks();
+  ASSERT_EQ(1, undo_blocks.size());
+  ASSERT_NE(old_undo_block, undo_blocks[0]);
+
+  vector<string> rows;
+  ASSERT_OK(tablet()->DebugDump(&rows));
+  int num_with_undos = 0;
+  int num_without_undos = 0;
+  for (const string& row : rows) {
+    if (MatchPattern(row, "*Undos: [@*(DELETE)]*")) {
+      num_with_undos++;
+    } else if (MatchPattern(row, "*Undos: []*")) {
+      num_without_undos++;
+    }
+  }
+  ASSERT_EQ(kHalf, num_without_undos);
+  ASSERT_EQ(rows_per_rowset_ - kHalf, num_with_undos);
+
+  // The recent history is still readable.
+  NO_FATALS(VerifyTestRowsWithTimestampAndVerifier(kStartRow, kHalf, time_after_first_half,
+                                                   kRowsEqual0));
+  NO_FATALS(VerifyTestRowsWithVerifier(kStartRow, rows_per_rowset_, kRowsEqual0));
+}
+
 // Test that "ghost" rows (deleted on one rowset, reinserted on another) don't
 // get revived after history GC.
 TEST_F(TabletHistoryGcTest, TestGhostRowsNotRevived) {
@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include "kudu/common/schema.h"
@@ -24,6 +25,8 @@
 #include "kudu/tablet/local_tablet_writer.h"
 #include "kudu/tablet/tablet-test-util.h"
 
+DECLARE_double(tablet_metadata_log_checkpoint_ratio);
+
 namespace kudu {
 namespace tablet {
 
@@ -93,6 +96,72 @@ TEST_F(TestTabletMetadata, TestLoadFromSuperBlock) {
             << superblock_pb_1.DebugString();
 }
 
+// Test that the WAL root assigned to a tablet is persisted in its superblock
+// and registered with the FsManager when the metadata is loaded again.
+TEST_F(TestTabletMetadata, TestWalRootIsPersisted) {
+  TabletMetadata* meta = harness_->tablet()->metadata();
+  FsManager* fs_manager = meta->fs_manager();
+  ASSERT_FALSE(meta->wal_root().empty());
+  ASSERT_EQ(meta->wal_root(), fs_manager->GetTabletWalRoot(meta->tablet_id()));
+
+  TabletSuperBlockPB superblock;
+  ASSERT_OK(meta->ReadSuperBlockFromDisk(&superblock));
+  ASSERT_EQ(meta->wal_root(), superblock.wal_root());
+
+  fs_manager->UnregisterTabletWalRoot(meta->tablet_id());
+  scoped_refptr<TabletMetadata> loaded;
+  ASSERT_OK(TabletMetadata::Load(fs_manager, meta->tablet_id(), &loaded));
+  ASSERT_EQ(meta->wal_root(), loaded->wal_root());
+  ASSERT_EQ(meta->wal_root(), fs_manager->GetTabletWalRoot(meta->tablet_id()));
+}
+
+// Test that flushes append their changes to the metadata log, and that the
+// superblock is rebuilt from the checkpoint and the log when it's loaded.
+TEST_F(TestTabletMetadata, TestMetadataLog) {
+  FLAGS_tablet_metadata_log_checkpoint_ratio = 1.0;
+  TabletMetadata* meta = harness_->tablet()->metadata();
+  FsManager* fs_manager = meta->fs_manager();
+  string log_path = fs_manager->GetTabletMetadataLogPath(meta->tablet_id());
+  ASSERT_FALSE(env_->FileExists(log_path));
+
+  // Each flush of the tablet adds a rowset, as a delta.
+  for (int i = 0; i < 3; i++) {
+    gscoped_ptr<KuduPartialRow> row;
+    BuildPartialRow(i, i, "foo", &row);
+    ASSERT_OK(writer_->Insert(*row));
+    ASSERT_OK(harness_->tablet()->Flush());
+  }
+  ASSERT_TRUE(env_->FileExists(log_path));
+
+  // Loads the metadata from disk, checking that it matches 'meta'.
+  auto check_loaded = [&]() {
+    TabletSuperBlockPB expected;
+    ASSERT_OK(meta->ToSuperBlock(&expected));
+    fs_manager->UnregisterTabletWalRoot(meta->tablet_id());
+    scoped_refptr<TabletMetadata> loaded;
+    ASSERT_OK(TabletMetadata::Load(fs_manager, meta->tablet_id(), &loaded));
+    TabletSuperBlockPB actual;
+    ASSERT_OK(loaded->ToSuperBlock(&actual));
+    ASSERT_EQ(expected.SerializeAsString(), actual.SerializeAsString())
+        << expected.DebugString() << actual.DebugString();
+  };
+  ASSERT_NO_FATAL_FAILURE(check_loaded());
+
+  // A flush without changes writes nothing; unless every flush writes a
+  // checkpoint, which replaces the log.
+  uint64_t log_size;
+  ASSERT_OK(env_->GetFileSize(log_path, &log_size));
+  ASSERT_OK(meta->Flush());
+  uint64_t new_log_size;
+  ASSERT_OK(env_->GetFileSize(log_path, &new_log_size));
+  ASSERT_EQ(log_size, new_log_size);
+
+  FLAGS_tablet_metadata_log_checkpoint_ratio = 0;
+  ASSERT_OK(meta->Flush());
+  ASSERT_FALSE(env_->FileExists(log_path));
+  ASSERT_NO_FATAL_FAILURE(check_loaded());
+}
+
 
 } // namespace tablet
 } // namespace kudu
@@ -23,6 +23,7 @@
 #include <mutex>
 #include <string>
 
+#include "kudu/cfile/block_cache.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/metadata.pb.h"
 #include "kudu/consensus/opid.pb.h"
@@ -48,7 +49,21 @@ TAG_FLAG(enable_tablet_orphaned_block_deletion, advanced);
 TAG_FLAG(enable_tablet_orphaned_block_deletion, hidden);
 TAG_FLAG(enable_tablet_orphaned_block_deletion, runtime);
 
+DEFINE_double(tablet_metadata_log_checkpoint_ratio, 0,
+              "Once the updates appended to a tablet's metadata log since its "
+              "last checkpoint add up to this many times the size of the "
+              "checkpoint, the next flush of the tablet's metadata writes a "
+              "new checkpoint. If 0, every flush writes a checkpoint, and no "
+              "log is kept. Versions which predate the log take it for a tablet "
+              "and ignore its updates, so setting this above 0 rules out "
+              "downgrades.");
+TAG_FLAG(tablet_metadata_log_checkpoint_ratio, advanced);
+TAG_FLAG(tablet_metadata_log_checkpoint_ratio, experimental);
+TAG_FLAG(tablet_metadata_log_checkpoint_ratio, runtime);
+
 using std::shared_ptr;
+using std::unordered_map;
+using std::unordered_set;
 
 using base::subtle::Barrier_AtomicIncrement;
 using strings::Substitute;
@@ -56,6 +71,8 @@ using strings::Substitute;
 using kudu::consensus::MinimumOpId;
 using kudu::consensus::OpId;
 using kudu::consensus::RaftConfigPB;
+using kudu::pb_util::ReadablePBContainerFile;
+using kudu::pb_util::WritablePBContainerFile;
 
 namespace kudu {
 namespace tablet {
@@ -73,6 +90,7 @@ Status TabletMetadata::CreateNew(FsManager* fs_manager,
                                  const Schema& schema,
                                  const PartitionSchema& partition_schema,
                                  const Partition& partition,
+                                 const CompactionPolicyPB& compaction_policy,
                                  const TabletDataState& initial_tablet_data_state,
                                  scoped_refptr<TabletMetadata>* metadata) {
 
@@ -88,8 +106,16 @@ Status TabletMetadata::CreateNew(FsManager* fs_manager,
                                                        schema,
                                                        partition_schema,
                                                        partition,
+                                                       compaction_policy,
                                                        initial_tablet_data_state));
-  RETURN_NOT_OK(ret->Flush());
+  fs_manager->AssignTabletWalRoot(tablet_id, &ret->wal_root_);
+  fs_manager->AssignTabletDataDirs(tablet_id, &ret->data_dirs_);
+  Status s = ret->Flush();
+  if (!s.ok()) {
+    fs_manager->UnregisterTabletWalRoot(tablet_id);
+    fs_manager->UnregisterTabletDataDirs(tablet_id);
+    return s;
+  }
   metadata->swap(ret);
   return Status::OK();
 }
@@ -122,8 +148,8 @@ Status TabletMetadata::LoadOrCreate(FsManager* fs_manager,
     return Status::OK();
   } else if (s.IsNotFound()) {
     return CreateNew(fs_manager, tablet_id, table_name, table_id, schema,
-                     partition_schema, partition, initial_tablet_data_state,
-                     metadata);
+                     partition_schema, partition, CompactionPolicyPB(),
+                     initial_tablet_data_state, metadata);
   } else {
     return s;
   }
@@ -159,6 +185,13 @@ Status TabletMetadata::DeleteTabletData(TabletDataState delete_type,
       << tablet_id_ << ": " << TabletDataState_Name(delete_type)
       << " (" << delete_type << ")";
 
+  // The hot blocks are about to be deleted.
+  string hot_blocks_path = fs_manager_->GetTabletHotBlocksPath(tablet_id_);
+  if (fs_manager_->env()->FileExists(hot_blocks_path)) {
+    RETURN_NOT_OK_PREPEND(fs_manager_->env()->DeleteFile(hot_blocks_path),
+                          "Unable to delete hot blocks of tablet " + tablet_id_);
+  }
+
   // First add all of our blocks to the orphan list
   // and clear our rowsets. This serves to erase all the data.
   //
@@ -207,13 +240,21 @@ Status TabletMetadata::DeleteSuperBlock() {
   string path = fs_manager_->GetTabletMetadataPath(tablet_id_);
   RETURN_NOT_OK_PREPEND(fs_manager_->env()->DeleteFile(path),
                         "Unable to delete superblock for tablet " + tablet_id_);
+  log_writer_.reset();
+  string log_path = fs_manager_->GetTabletMetadataLogPath(tablet_id_);
+  if (fs_manager_->env()->FileExists(log_path)) {
+    RETURN_NOT_OK_PREPEND(fs_manager_->env()->DeleteFile(log_path),
+                          "Unable to delete metadata log for tablet " + tablet_id_);
+  }
+  fs_manager_->UnregisterTabletWalRoot(tablet_id_);
+  fs_manager_->UnregisterTabletDataDirs(tablet_id_);
   return Status::OK();
 }
 
 TabletMetadata::TabletMetadata(FsManager* fs_manager, string tablet_id,
                                string table_name, string table_id,
                                const Schema& schema, PartitionSchema partition_schema,
-                               Partition partition,
+                               Partition partition, CompactionPolicyPB compaction_policy,
                                const TabletDataState& tablet_data_state)
     : state_(kNotWrittenYet),
       tablet_id_(std::move(tablet_id)),
@@ -226,8 +267,16 @@ TabletMetadata::TabletMetadata(FsManager* fs_manager, string tablet_id,
       schema_version_(0),
       table_name_(std::move(table_name)),
       partition_schema_(std::move(partition_schema)),
+      compaction_policy_(std::move(compaction_policy)),
       tablet_data_state_(tablet_data_state),
       tombstone_last_logged_opid_(MinimumOpId()),
+      has_clean_shutdown_(false),
+      flush_requests_(0),
+      flushed_requests_(0),
+      has_flushed_state_(false),
+      last_delta_seqno_(0),
+      checkpoint_bytes_(0),
+      log_bytes_(0),
       num_flush_pins_(0),
       needs_flush_(false),
       pre_flush_callback_(Bind(DoNothingStatusClosure)) {
@@ -247,6 +296,13 @@ TabletMetadata::TabletMetadata(FsManager* fs_manager, string tablet_id)
       next_rowset_idx_(0),
       schema_(nullptr),
       tombstone_last_logged_opid_(MinimumOpId()),
+      has_clean_shutdown_(false),
+      flush_requests_(0),
+      flushed_requests_(0),
+      has_flushed_state_(false),
+      last_delta_seqno_(0),
+      checkpoint_bytes_(0),
+      log_bytes_(0),
       num_flush_pins_(0),
       needs_flush_(false),
       pre_flush_callback_(Bind(DoNothingStatusClosure)) {}
@@ -258,7 +314,19 @@ Status TabletMetadata::LoadFromDisk() {
   CHECK_EQ(state_, kNotLoadedYet);
 
   TabletSuperBlockPB superblock;
-  RETURN_NOT_OK(ReadSuperBlockFromDisk(&superblock));
+  {
+    MutexLock l(flush_lock_);
+    int num_deltas;
+    RETURN_NOT_OK(ReadSuperBlockFromDiskUnlocked(&superblock, &num_deltas));
+    last_delta_seqno_ = superblock.last_delta_seqno();
+    // Updates are only appended to a log opened by this instance, so the
+    // next flush starts a new one with a checkpoint.
+    if (num_deltas == 0) {
+      GetFlushedState(&superblock, &flushed_);
+      has_flushed_state_ = true;
+      checkpoint_bytes_ = superblock.ByteSize();
+    }
+  }
   RETURN_NOT_OK_PREPEND(LoadFromSuperBlock(superblock),
                         "Failed to load data from superblock protobuf");
   state_ = kInitialized;
@@ -310,6 +378,12 @@ Status TabletMetadata::LoadFromSuperBlock(const TabletSuperBlockPB& superblock)
       RETURN_NOT_OK(PartitionSchema::FromPB(superblock.partition_schema(),
                                             *schema_, &partition_schema_));
       Partition::FromPB(superblock.partition(), &partition_);
+      compaction_policy_ = superblock.compaction_policy();
+      wal_root_ = superblock.has_wal_root() ? superblock.wal_root()
+                                            : fs_manager_->GetTabletWalRoot(tablet_id_);
+      RETURN_NOT_OK(fs_manager_->RegisterTabletWalRoot(tablet_id_, wal_root_));
+      data_dirs_.assign(superblock.data_dirs().begin(), superblock.data_dirs().end());
+      fs_manager_->RegisterTabletDataDirs(tablet_id_, data_dirs_);
     } else {
       CHECK_EQ(table_id_, superblock.table_id());
       PartitionSchema partition_schema;
@@ -342,6 +416,13 @@ Status TabletMetadata::LoadFromSuperBlock(const TabletSuperBlockPB& superblock)
     } else {
       tombstone_last_logged_opid_ = MinimumOpId();
     }
+
+    has_clean_shutdown_ = superblock.has_clean_shutdown();
+    if (has_clean_shutdown_) {
+      clean_shutdown_ = superblock.clean_shutdown();
+    } else {
+      clean_shutdown_.Clear();
+    }
   }
 
   // Now is a good time to clean up any orphaned blocks that may have been
@@ -394,6 +475,7 @@ void TabletMetadata::DeleteOrphanedBlocks(const vector<BlockId>& blocks) {
 
     deleted.push_back(b);
   }
+  cfile::BlockCache::GetSingleton()->InvalidateFiles(deleted);
 
   // Remove the successfully-deleted blocks from the set.
   {
@@ -426,11 +508,25 @@ Status TabletMetadata::Flush() {
   TRACE_EVENT1("tablet", "TabletMetadata::Flush",
                "tablet_id", tablet_id_);
 
+  int64_t request;
+  {
+    std::lock_guard<LockType> l(data_lock_);
+    request = ++flush_requests_;
+  }
+
   MutexLock l_flush(flush_lock_);
+  // A flush which began while this one waited for the lock has already
+  // persisted everything this one would.
+  if (flushed_requests_ >= request) {
+    TRACE("Metadata flushed by a concurrent flush");
+    return Status::OK();
+  }
   vector<BlockId> orphaned;
   TabletSuperBlockPB pb;
+  int64_t covered_requests;
   {
     std::lock_guard<LockType> l(data_lock_);
+    covered_requests = flush_requests_;
     CHECK_GE(num_flush_pins_, 0);
     if (num_flush_pins_ > 0) {
       needs_flush_ = true;
@@ -450,8 +546,30 @@ Status TabletMetadata::Flush() {
     orphaned.assign(orphaned_blocks_.begin(), orphaned_blocks_.end());
   }
   pre_flush_callback_.Run();
-  RETURN_NOT_OK(ReplaceSuperBlockUnlocked(pb));
-  TRACE("Metadata flushed");
+
+  // Append just the changes to the metadata log, unless it's time for a new
+  // checkpoint.
+  FlushedState state;
+  TabletMetadataDeltaPB delta;
+  bool checkpoint = !has_flushed_state_ || FLAGS_tablet_metadata_log_checkpoint_ratio <= 0;
+  if (!checkpoint) {
+    GetFlushedState(&pb, &state);
+    if (!ComputeDelta(pb, flushed_, state, &delta)) {
+      TRACE("Metadata unchanged");
+    } else if (log_bytes_ + delta.ByteSize() >
+               checkpoint_bytes_ * FLAGS_tablet_metadata_log_checkpoint_ratio) {
+      checkpoint = true;
+    } else {
+      RETURN_NOT_OK(AppendDeltaUnlocked(&delta));
+      flushed_ = std::move(state);
+      TRACE("Metadata update appended");
+    }
+  }
+  if (checkpoint) {
+    RETURN_NOT_OK(ReplaceSuperBlockUnlocked(pb));
+    TRACE("Metadata flushed");
+  }
+  flushed_requests_ = covered_requests;
   l_flush.Unlock();
 
   // Now that the superblock is written, try to delete the orphaned blocks.
@@ -506,23 +624,262 @@ Status TabletMetadata::ReplaceSuperBlock(const TabletSuperBlockPB &pb) {
   return Status::OK();
 }
 
+Status TabletMetadata::SaveHotBlocks(const HotBlocksPB& hot_blocks) {
+  string path = fs_manager_->GetTabletHotBlocksPath(tablet_id_);
+  RETURN_NOT_OK_PREPEND(pb_util::WritePBContainerToPath(
+                            fs_manager_->env(), path, hot_blocks,
+                            pb_util::OVERWRITE, pb_util::NO_SYNC),
+                        Substitute("Failed to write hot blocks of tablet $0", tablet_id_));
+  return Status::OK();
+}
+
+Status TabletMetadata::LoadHotBlocks(HotBlocksPB* hot_blocks) const {
+  string path = fs_manager_->GetTabletHotBlocksPath(tablet_id_);
+  if (!fs_manager_->env()->FileExists(path)) {
+    return Status::NotFound("No hot blocks persisted for tablet", tablet_id_);
+  }
+  RETURN_NOT_OK_PREPEND(
+      pb_util::ReadPBContainerFromPath(fs_manager_->env(), path, hot_blocks),
+      Substitute("Could not load hot blocks from $0", path));
+  return Status::OK();
+}
+
 Status TabletMetadata::ReplaceSuperBlockUnlocked(const TabletSuperBlockPB &pb) {
   flush_lock_.AssertAcquired();
 
+  // The checkpoint includes every delta appended so far, even a failed one,
+  // so that none of them is applied to it should the log outlive it.
+  TabletSuperBlockPB checkpoint(pb);
+  checkpoint.set_last_delta_seqno(last_delta_seqno_);
+  has_flushed_state_ = false;
   string path = fs_manager_->GetTabletMetadataPath(tablet_id_);
   RETURN_NOT_OK_PREPEND(pb_util::WritePBContainerToPath(
-                            fs_manager_->env(), path, pb,
+                            fs_manager_->env(), path, checkpoint,
                             pb_util::OVERWRITE, pb_util::SYNC),
                         Substitute("Failed to write tablet metadata $0", tablet_id_));
+  TRACE_COUNTER_INCREMENT("tablet_metadata_bytes_written", checkpoint.ByteSize());
+
+  // The log's deltas are now part of the checkpoint. If deleting it fails,
+  // they're skipped when loading.
+  log_writer_.reset();
+  string log_path = fs_manager_->GetTabletMetadataLogPath(tablet_id_);
+  if (fs_manager_->env()->FileExists(log_path)) {
+    WARN_NOT_OK(fs_manager_->env()->DeleteFile(log_path),
+                Substitute("Failed to delete metadata log of tablet $0", tablet_id_));
+  }
+  GetFlushedState(&checkpoint, &flushed_);
+  has_flushed_state_ = true;
+  checkpoint_bytes_ = checkpoint.ByteSize();
+  log_bytes_ = 0;
+  return Status::OK();
+}
 
+Status TabletMetadata::AppendDeltaUnlocked(TabletMetadataDeltaPB* delta) {
+  flush_lock_.AssertAcquired();
+
+  // Consumed even if the append fails, as the delta may reach the disk
+  // anyway.
+  delta->set_seqno(++last_delta_seqno_);
+  Status s;
+  if (!log_writer_) {
+    Env* env = fs_manager_->env();
+    string log_path = fs_manager_->GetTabletMetadataLogPath(tablet_id_);
+    RWFileOptions opts;
+    opts.mode = Env::CREATE_IF_NON_EXISTING_TRUNCATE;
+    gscoped_ptr<RWFile> file;
+    s = env->NewRWFile(opts, log_path, &file);
+    gscoped_ptr<WritablePBContainerFile> writer;
+    if (s.ok()) {
+      writer.reset(new WritablePBContainerFile(std::move(file)));
+      s = writer->Init(TabletMetadataDeltaPB());
+    }
+    if (s.ok()) {
+      s = env->SyncDir(fs_manager_->GetTabletMetadataDir());
+    }
+    if (s.ok()) {
+      log_writer_ = std::move(writer);
+    }
+  }
+  if (s.ok()) {
+    s = log_writer_->Append(*delta);
+  }
+  if (s.ok()) {
+    s = log_writer_->Sync();
+  }
+  if (!s.ok()) {
+    // The log may end with a partial delta; start over with a checkpoint.
+    log_writer_.reset();
+    has_flushed_state_ = false;
+    return s.CloneAndPrepend(Substitute("Failed to append to metadata log of tablet $0",
+                                        tablet_id_));
+  }
+  log_bytes_ += delta->ByteSize();
+  TRACE_COUNTER_INCREMENT("tablet_metadata_bytes_written", delta->ByteSize());
   return Status::OK();
 }
 
+void TabletMetadata::GetFlushedState(TabletSuperBlockPB* pb, FlushedState* state) {
+  state->rowsets.clear();
+  for (const RowSetDataPB& rowset : pb->rowsets()) {
+    state->rowsets[rowset.id()] = rowset.SerializeAsString();
+  }
+  state->orphaned_blocks.clear();
+  for (const BlockIdPB& block : pb->orphaned_blocks()) {
+    state->orphaned_blocks.insert(BlockId::FromPB(block));
+  }
+
+  // Set aside the rowsets and orphaned blocks, rather than copying the
+  // superblock without them.
+  google::protobuf::RepeatedPtrField<RowSetDataPB> rowsets;
+  google::protobuf::RepeatedPtrField<BlockIdPB> orphaned_blocks;
+  rowsets.Swap(pb->mutable_rowsets());
+  orphaned_blocks.Swap(pb->mutable_orphaned_blocks());
+  bool has_seqno = pb->has_last_delta_seqno();
+  int64_t seqno = pb->last_delta_seqno();
+  pb->clear_last_delta_seqno();
+  state->header = pb->SerializeAsString();
+  if (has_seqno) {
+    pb->set_last_delta_seqno(seqno);
+  }
+  rowsets.Swap(pb->mutable_rowsets());
+  orphaned_blocks.Swap(pb->mutable_orphaned_blocks());
+}
+
+bool TabletMetadata::ComputeDelta(const TabletSuperBlockPB& pb,
+                                  const FlushedState& old_state,
+                                  const FlushedState& new_state,
+                                  TabletMetadataDeltaPB* delta) {
+  bool changed = false;
+  if (new_state.header != old_state.header) {
+    CHECK(delta->mutable_header()->ParseFromString(new_state.header));
+    changed = true;
+  }
+  for (const RowSetDataPB& rowset : pb.rowsets()) {
+    const string* old_rowset = FindOrNull(old_state.rowsets, rowset.id());
+    if (!old_rowset || *old_rowset != FindOrDie(new_state.rowsets, rowset.id())) {
+      delta->add_updated_rowsets()->CopyFrom(rowset);
+      changed = true;
+    }
+  }
+  for (const auto& e : old_state.rowsets) {
+    if (!ContainsKey(new_state.rowsets, e.first)) {
+      delta->add_removed_rowset_ids(e.first);
+      changed = true;
+    }
+  }
+  for (const BlockId& block : new_state.orphaned_blocks) {
+    if (!ContainsKey(old_state.orphaned_blocks, block)) {
+      block.CopyToPB(delta->add_added_orphaned_blocks());
+      changed = true;
+    }
+  }
+  for (const BlockId& block : old_state.orphaned_blocks) {
+    if (!ContainsKey(new_state.orphaned_blocks, block)) {
+      block.CopyToPB(delta->add_removed_orphaned_blocks());
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+void TabletMetadata::ApplyDelta(const TabletMetadataDeltaPB& delta,
+                                TabletSuperBlockPB* superblock) {
+  if (delta.has_header()) {
+    TabletSuperBlockPB header(delta.header());
+    header.mutable_rowsets()->Swap(superblock->mutable_rowsets());
+    header.mutable_orphaned_blocks()->Swap(superblock->mutable_orphaned_blocks());
+    superblock->Swap(&header);
+  }
+
+  unordered_set<int64_t> removed(delta.removed_rowset_ids().begin(),
+                                 delta.removed_rowset_ids().end());
+  google::protobuf::RepeatedPtrField<RowSetDataPB> rowsets;
+  unordered_map<int64_t, RowSetDataPB*> rowsets_by_id;
+  for (RowSetDataPB& rowset : *superblock->mutable_rowsets()) {
+    if (!ContainsKey(removed, rowset.id())) {
+      RowSetDataPB* kept = rowsets.Add();
+      kept->Swap(&rowset);
+      rowsets_by_id[kept->id()] = kept;
+    }
+  }
+  for (const RowSetDataPB& rowset : delta.updated_rowsets()) {
+    RowSetDataPB* existing = FindPtrOrNull(rowsets_by_id, rowset.id());
+    if (existing) {
+      existing->CopyFrom(rowset);
+    } else {
+      rowsets.Add()->CopyFrom(rowset);
+    }
+  }
+  superblock->mutable_rowsets()->Swap(&rowsets);
+
+  if (delta.added_orphaned_blocks_size() > 0 || delta.removed_orphaned_blocks_size() > 0) {
+    unordered_set<BlockId, BlockIdHash, BlockIdEqual> orphaned_blocks;
+    for (const BlockIdPB& block : superblock->orphaned_blocks()) {
+      orphaned_blocks.insert(BlockId::FromPB(block));
+    }
+    for (const BlockIdPB& block : delta.removed_orphaned_blocks()) {
+      orphaned_blocks.erase(BlockId::FromPB(block));
+    }
+    for (const BlockIdPB& block : delta.added_orphaned_blocks()) {
+      orphaned_blocks.insert(BlockId::FromPB(block));
+    }
+    superblock->clear_orphaned_blocks();
+    for (const BlockId& block : orphaned_blocks) {
+      block.CopyToPB(superblock->add_orphaned_blocks());
+    }
+  }
+  superblock->set_last_delta_seqno(delta.seqno());
+}
+
 Status TabletMetadata::ReadSuperBlockFromDisk(TabletSuperBlockPB* superblock) const {
+  MutexLock l(flush_lock_);
+  int num_deltas;
+  return ReadSuperBlockFromDiskUnlocked(superblock, &num_deltas);
+}
+
+Status TabletMetadata::ReadSuperBlockFromDiskUnlocked(TabletSuperBlockPB* superblock,
+                                                      int* num_deltas) const {
+  flush_lock_.AssertAcquired();
+  *num_deltas = 0;
   string path = fs_manager_->GetTabletMetadataPath(tablet_id_);
   RETURN_NOT_OK_PREPEND(
       pb_util::ReadPBContainerFromPath(fs_manager_->env(), path, superblock),
       Substitute("Could not load tablet metadata from $0", path));
+
+  string log_path = fs_manager_->GetTabletMetadataLogPath(tablet_id_);
+  if (!fs_manager_->env()->FileExists(log_path)) {
+    return Status::OK();
+  }
+  gscoped_ptr<RandomAccessFile> file;
+  RETURN_NOT_OK_PREPEND(fs_manager_->env()->NewRandomAccessFile(log_path, &file),
+                        Substitute("Could not open tablet metadata log $0", log_path));
+  ReadablePBContainerFile reader(std::move(file));
+  Status s = reader.Open();
+  if (s.IsIncomplete()) {
+    // The log was being created; none of its deltas were synced.
+    return Status::OK();
+  }
+  RETURN_NOT_OK_PREPEND(s, Substitute("Could not read tablet metadata log $0", log_path));
+  while (true) {
+    TabletMetadataDeltaPB delta;
+    s = reader.ReadNextPB(&delta);
+    if (s.IsEndOfFile() || s.IsIncomplete()) {
+      // A partial trailing delta was never synced, so its flush failed.
+      break;
+    }
+    RETURN_NOT_OK_PREPEND(s, Substitute("Could not read tablet metadata log $0", log_path));
+    if (delta.seqno() <= superblock->last_delta_seqno()) {
+      // Already in the checkpoint.
+      continue;
+    }
+    if (delta.seqno() != superblock->last_delta_seqno() + 1) {
+      return Status::Corruption(
+          Substitute("Tablet metadata log $0 is missing deltas $1 to $2", log_path,
+                     superblock->last_delta_seqno() + 1, delta.seqno() - 1));
+    }
+    ApplyDelta(delta, superblock);
+    (*num_deltas)++;
+  }
   return Status::OK();
 }
 
@@ -543,7 +900,14 @@ Status TabletMetadata::ToSuperBlockUnlocked(TabletSuperBlockPB* super_block,
   pb.set_last_durable_mrs_id(last_durable_mrs_id_);
   pb.set_schema_version(schema_version_);
   partition_schema_.ToPB(pb.mutable_partition_schema());
+  if (compaction_policy_.ByteSize() > 0) {
+    *pb.mutable_compaction_policy() = compaction_policy_;
+  }
   pb.set_table_name(table_name_);
+  pb.set_wal_root(wal_root_);
+  for (const string& dir : data_dirs_) {
+    pb.add_data_dirs(dir);
+  }
 
   for (const shared_ptr<RowSetMetadata>& meta : rowsets) {
     meta->ToProtobuf(pb.add_rowsets());
@@ -557,6 +921,9 @@ Status TabletMetadata::ToSuperBlockUnlocked(TabletSuperBlockPB* super_block,
   if (!OpIdEquals(tombstone_last_logged_opid_, MinimumOpId())) {
     *pb.mutable_tombstone_last_logged_opid() = tombstone_last_logged_opid_;
   }
+  if (has_clean_shutdown_) {
+    *pb.mutable_clean_shutdown() = clean_shutdown_;
+  }
 
   for (const BlockId& block_id : orphaned_blocks_) {
     block_id.CopyToPB(pb.mutable_orphaned_blocks()->Add());
@@ -566,6 +933,23 @@ Status TabletMetadata::ToSuperBlockUnlocked(TabletSuperBlockPB* super_block,
   return Status::OK();
 }
 
+void TabletMetadata::SetCleanShutdown(const CleanShutdownPB& clean_shutdown) {
+  std::lock_guard<LockType> l(data_lock_);
+  clean_shutdown_ = clean_shutdown;
+  has_clean_shutdown_ = true;
+}
+
+bool TabletMetadata::TakeCleanShutdown(CleanShutdownPB* clean_shutdown) {
+  std::lock_guard<LockType> l(data_lock_);
+  if (!has_clean_shutdown_) {
+    return false;
+  }
+  clean_shutdown->Swap(&clean_shutdown_);
+  clean_shutdown_.Clear();
+  has_clean_shutdown_ = false;
+  return true;
+}
+
 Status TabletMetadata::CreateRowSet(shared_ptr<RowSetMetadata> *rowset,
                                     const Schema& schema) {
   AtomicWord rowset_idx = Barrier_AtomicIncrement(&next_rowset_idx_, 1) - 1;
@@ -20,6 +20,7 @@
 #include <boost/optional/optional_fwd.hpp>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -30,6 +31,7 @@
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/callback.h"
 #include "kudu/gutil/dynamic_annotations.h"
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/tablet/metadata.pb.h"
@@ -38,6 +40,11 @@
 #include "kudu/util/status_callback.h"
 
 namespace kudu {
+
+namespace pb_util {
+class WritablePBContainerFile;
+} // namespace pb_util
+
 namespace tablet {
 
 class RowSetMetadata;
@@ -57,6 +64,14 @@ extern const int64 kNoDurableMemStore;
 // At startup, the TSTabletManager will load a TabletMetadata for each
 // super block found in the tablets/ directory, and then instantiate
 // tablets from this data.
+//
+// Rather than rewriting the whole superblock, most flushes append just what
+// changed since the previous flush, as a TabletMetadataDeltaPB, to the
+// tablet's metadata log. Once the log grows large enough relative to the
+// superblock, the next flush writes out the whole superblock again as a new
+// checkpoint and starts a new log. Concurrent flushes are coalesced: a flush
+// which waited for another one to finish returns right away if that one
+// already persisted its changes.
 class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
  public:
   // Create metadata for a new tablet. This assumes that the given superblock
@@ -69,6 +84,7 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
                           const Schema& schema,
                           const PartitionSchema& partition_schema,
                           const Partition& partition,
+                          const CompactionPolicyPB& compaction_policy,
                           const TabletDataState& initial_tablet_data_state,
                           scoped_refptr<TabletMetadata>* metadata);
 
@@ -132,6 +148,11 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
     return partition_schema_;
   }
 
+  // Returns the compaction policy of the tablet's table.
+  const CompactionPolicyPB& compaction_policy() const {
+    return compaction_policy_;
+  }
+
   // Set / get the tablet copy / tablet data state.
   void set_tablet_data_state(TabletDataState state);
   TabletDataState tablet_data_state() const;
@@ -147,6 +168,8 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
   // this method.
   Status UnPinFlush();
 
+  // Persists the metadata, unless it's pinned. Returns once the metadata as
+  // of the call is durable.
   Status Flush();
 
   // Updates the metadata in the following ways:
@@ -209,7 +232,23 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
 
   consensus::OpId tombstone_last_logged_opid() const { return tombstone_last_logged_opid_; }
 
-  // Loads the currently-flushed superblock from disk into the given protobuf.
+  // Records that the tablet was shut down cleanly, persisted by the next
+  // Flush(). See CleanShutdownPB.
+  void SetCleanShutdown(const CleanShutdownPB& clean_shutdown);
+
+  // Clears the record set by SetCleanShutdown(), returning it through
+  // 'clean_shutdown'. Returns false if the tablet wasn't shut down cleanly.
+  bool TakeCleanShutdown(CleanShutdownPB* clean_shutdown);
+
+  // The filesystem root hosting the tablet's WAL.
+  const std::string& wal_root() const { return wal_root_; }
+
+  // The data roots the tablet's blocks are placed in, or empty if they may
+  // be placed in any of them.
+  const std::vector<std::string>& data_dirs() const { return data_dirs_; }
+
+  // Loads the currently-flushed superblock from disk into the given protobuf,
+  // applying the updates in the metadata log to the last checkpoint.
   Status ReadSuperBlockFromDisk(TabletSuperBlockPB* superblock) const;
 
   // Sets *super_block to the serialized form of the current metadata.
@@ -218,6 +257,14 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
   // Fully replace a superblock (used for bootstrap).
   Status ReplaceSuperBlock(const TabletSuperBlockPB &pb);
 
+  // Persists the hot blocks of the tablet, replacing those persisted before.
+  // The hot blocks are only a hint, so they aren't synced to disk.
+  Status SaveHotBlocks(const HotBlocksPB& hot_blocks);
+
+  // Loads the hot blocks last persisted by SaveHotBlocks(). Returns NotFound
+  // if there are none.
+  Status LoadHotBlocks(HotBlocksPB* hot_blocks) const;
+
   // ==========================================================================
   // Stuff used by the tests
   // ==========================================================================
@@ -239,7 +286,7 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
   TabletMetadata(FsManager* fs_manager, std::string tablet_id,
                  std::string table_name, std::string table_id,
                  const Schema& schema, PartitionSchema partition_schema,
-                 Partition partition,
+                 Partition partition, CompactionPolicyPB compaction_policy,
                  const TabletDataState& tablet_data_state);
 
   // Constructor for loading an existing tablet.
@@ -254,10 +301,44 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
 
   Status ReadSuperBlock(TabletSuperBlockPB *pb);
 
-  // Fully replace superblock.
+  // Fully replace superblock, as a new checkpoint, and discard the metadata
+  // log.
   // Requires 'flush_lock_'.
   Status ReplaceSuperBlockUnlocked(const TabletSuperBlockPB &pb);
 
+  // The superblock as of the last flush, which the next delta is computed
+  // against. Each rowset and the remaining fields are kept serialized.
+  struct FlushedState {
+    std::string header;
+    std::unordered_map<int64_t, std::string> rowsets;
+    std::unordered_set<BlockId, BlockIdHash, BlockIdEqual> orphaned_blocks;
+  };
+
+  // Sets 'state' to that of 'pb'. 'pb' is left as it was.
+  static void GetFlushedState(TabletSuperBlockPB* pb, FlushedState* state);
+
+  // Sets 'delta' to the changes from 'old_state' to 'new_state', which is
+  // that of 'pb'. Returns false if nothing changed. The sequence number of
+  // 'delta' is left unset.
+  static bool ComputeDelta(const TabletSuperBlockPB& pb,
+                           const FlushedState& old_state,
+                           const FlushedState& new_state,
+                           TabletMetadataDeltaPB* delta);
+
+  // Applies 'delta' to 'superblock'.
+  static void ApplyDelta(const TabletMetadataDeltaPB& delta, TabletSuperBlockPB* superblock);
+
+  // Appends 'delta' to the metadata log and syncs it, creating the log if
+  // needed. Sets the sequence number of 'delta'.
+  // Requires 'flush_lock_'.
+  Status AppendDeltaUnlocked(TabletMetadataDeltaPB* delta);
+
+  // Like ReadSuperBlockFromDisk(). Sets 'num_deltas' to the number of
+  // updates applied from the metadata log.
+  // Requires 'flush_lock_'.
+  Status ReadSuperBlockFromDiskUnlocked(TabletSuperBlockPB* superblock,
+                                        int* num_deltas) const;
+
   // Requires 'data_lock_'.
   Status UpdateUnlocked(const RowSetMetadataIds& to_remove,
                         const RowSetMetadataVector& to_add,
@@ -296,6 +377,31 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
   // If taken together with 'data_lock_', must be acquired first.
   mutable Mutex flush_lock_;
 
+  // The number of calls to Flush(). Protected by 'data_lock_'.
+  int64_t flush_requests_;
+
+  // The number of calls to Flush() whose changes are known to be durable:
+  // those which were made before the last successful flush began.
+  // Protected by 'flush_lock_'.
+  int64_t flushed_requests_;
+
+  // The superblock as of the last flush, if it's known. If it isn't, the
+  // next flush writes a checkpoint. Protected by 'flush_lock_'.
+  FlushedState flushed_;
+  bool has_flushed_state_;
+
+  // The sequence number of the last delta appended to the metadata log, or
+  // included in the last checkpoint. Protected by 'flush_lock_'.
+  int64_t last_delta_seqno_;
+
+  // The sizes of the last checkpoint, and of the deltas appended to the
+  // metadata log since. Protected by 'flush_lock_'.
+  int64_t checkpoint_bytes_;
+  int64_t log_bytes_;
+
+  // Appends to the metadata log, if it's open. Protected by 'flush_lock_'.
+  gscoped_ptr<pb_util::WritablePBContainerFile> log_writer_;
+
   const std::string tablet_id_;
   std::string table_id_;
 
@@ -314,6 +420,7 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
   uint32_t schema_version_;
   std::string table_name_;
   PartitionSchema partition_schema_;
+  CompactionPolicyPB compaction_policy_;
 
   // Previous values of 'schema_'.
   // These are currently kept alive forever, under the assumption that
@@ -332,6 +439,19 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
   // tombstoned. Has no meaning for non-tombstoned tablets.
   consensus::OpId tombstone_last_logged_opid_;
 
+  // Set if the tablet was shut down cleanly and hasn't been bootstrapped
+  // since.
+  CleanShutdownPB clean_shutdown_;
+  bool has_clean_shutdown_;
+
+  // The filesystem root hosting the tablet's WAL. Immutable once the tablet
+  // is created or loaded.
+  std::string wal_root_;
+
+  // The data roots the tablet's blocks are placed in, as assigned when the
+  // tablet was created. Immutable once the tablet is created or loaded.
+  std::vector<std::string> data_dirs_;
+
   // If this counter is > 0 then Flush() will not write any data to
   // disk.
   int32_t num_flush_pins_;
@@ -107,6 +107,18 @@ METRIC_DEFINE_counter(tablet, delta_file_lookups, "Delta File Lookups",
 METRIC_DEFINE_counter(tablet, mrs_lookups, "MemRowSet Lookups",
                       kudu::MetricUnit::kProbes,
                       "Number of times a MemRowSet was consulted.");
+METRIC_DEFINE_counter(tablet, mrs_filter_skips, "MemRowSet Lookups Skipped",
+                      kudu::MetricUnit::kProbes,
+                      "Number of times the key filter of a MemRowSet showed that a key "
+                      "wasn't there, skipping a MemRowSet lookup.");
+METRIC_DEFINE_counter(tablet, mrs_filter_hits, "MemRowSet Key Filter Hits",
+                      kudu::MetricUnit::kProbes,
+                      "Number of upserts which passed the key filter of a MemRowSet and "
+                      "found their key there, skipping the lookups of the flushed rowsets.");
+METRIC_DEFINE_counter(tablet, mrs_filter_misses, "MemRowSet Key Filter Misses",
+                      kudu::MetricUnit::kProbes,
+                      "Number of upserts which passed the key filter of a MemRowSet but "
+                      "didn't find their key there.");
 METRIC_DEFINE_counter(tablet, bytes_flushed, "Bytes Flushed",
                       kudu::MetricUnit::kBytes,
                       "Amount of data that has been flushed to disk by this tablet.");
@@ -117,33 +129,35 @@ METRIC_DEFINE_histogram(tablet, bloom_lookups_per_op, "Bloom Lookups per Operati
                         "operation. A single operation may perform several bloom filter "
                         "lookups if the tablet is not fully compacted. High frequency of "
                         "high values may indicate that compaction is falling behind.",
-                        20, 2);
+                        20, 2, kudu::SHARDED_HISTOGRAM);
 
 METRIC_DEFINE_histogram(tablet, key_file_lookups_per_op, "Key Lookups per Operation",
                         kudu::MetricUnit::kProbes,
                         "Tracks the number of key file lookups performed by each "
                         "operation. A single operation may perform several key file "
                         "lookups if the tablet is not fully compacted and if bloom filters "
-                        "are not effectively culling lookups.", 20, 2);
+                        "are not effectively culling lookups.", 20, 2,
+                        kudu::SHARDED_HISTOGRAM);
 
 METRIC_DEFINE_histogram(tablet, delta_file_lookups_per_op, "Delta File Lookups per Operation",
                         kudu::MetricUnit::kProbes,
                         "Tracks the number of delta file lookups performed by each "
                         "operation. A single operation may perform several delta file "
                         "lookups if the tablet is not fully compacted. High frequency of "
-                        "high values may indicate that compaction is falling behind.", 20, 2);
+                        "high values may indicate that compaction is falling behind.", 20, 2,
+                        kudu::SHARDED_HISTOGRAM);
 
 METRIC_DEFINE_histogram(tablet, write_op_duration_client_propagated_consistency,
   "Write Op Duration with Propagated Consistency",
   kudu::MetricUnit::kMicroseconds,
   "Duration of writes to this tablet with external consistency set to CLIENT_PROPAGATED.",
-  60000000LU, 2);
+  60000000LU, 2, kudu::SHARDED_HISTOGRAM);
 
 METRIC_DEFINE_histogram(tablet, write_op_duration_commit_wait_consistency,
   "Write Op Duration with Commit-Wait Consistency",
   kudu::MetricUnit::kMicroseconds,
   "Duration of writes to this tablet with external consistency set to COMMIT_WAIT.",
-  60000000LU, 2);
+  60000000LU, 2, kudu::SHARDED_HISTOGRAM);
 
 METRIC_DEFINE_histogram(tablet, commit_wait_duration,
   "Commit-Wait Duration",
@@ -182,6 +196,11 @@ METRIC_DEFINE_gauge_uint32(tablet, delta_major_compact_rs_running,
   kudu::MetricUnit::kMaintenanceOperations,
   "Number of delta major compactions currently running.");
 
+METRIC_DEFINE_gauge_uint32(tablet, undo_delta_block_gc_running,
+  "Undo Delta Block GC Running",
+  kudu::MetricUnit::kMaintenanceOperations,
+  "Number of UNDO delta block GC operations currently running.");
+
 METRIC_DEFINE_histogram(tablet, flush_dms_duration,
   "DeltaMemStore Flush Duration",
   kudu::MetricUnit::kMilliseconds,
@@ -207,11 +226,45 @@ METRIC_DEFINE_histogram(tablet, delta_major_compact_rs_duration,
   kudu::MetricUnit::kSeconds,
   "Seconds spent major delta compacting.", 60000000LU, 2);
 
+METRIC_DEFINE_histogram(tablet, undo_delta_block_gc_duration,
+  "Undo Delta Block GC Duration",
+  kudu::MetricUnit::kMilliseconds,
+  "Time spent garbage collecting ancient UNDO delta blocks.", 60000LU, 1);
+
+METRIC_DEFINE_counter(tablet, undo_delta_block_gc_bytes_deleted,
+  "Undo Delta Block GC Bytes Deleted",
+  kudu::MetricUnit::kBytes,
+  "Bytes of UNDO delta blocks deleted, or removed by rewriting them, because "
+  "they only held history older than the ancient history mark.");
+
 METRIC_DEFINE_counter(tablet, leader_memory_pressure_rejections,
   "Leader Memory Pressure Rejections",
   kudu::MetricUnit::kRequests,
   "Number of RPC requests rejected due to memory pressure while LEADER.");
 
+METRIC_DEFINE_counter(tablet, rpc_cpu_time_us,
+  "RPC CPU Time",
+  kudu::MetricUnit::kMicroseconds,
+  "CPU time spent by the RPC handler threads serving requests for this tablet. "
+  "The time spent by the prepare and apply threads of writes isn't included.");
+
+METRIC_DEFINE_counter(tablet, rpc_cfile_cache_hit_bytes,
+  "RPC Block Cache Hit Bytes",
+  kudu::MetricUnit::kBytes,
+  "Bytes of blocks read from the block cache while serving requests for this tablet.");
+
+METRIC_DEFINE_counter(tablet, rpc_cfile_cache_miss_bytes,
+  "RPC Block Cache Miss Bytes",
+  kudu::MetricUnit::kBytes,
+  "Bytes of blocks read from disk because they were missing from the block cache, "
+  "while serving requests for this tablet.");
+
+METRIC_DEFINE_counter(tablet, maintenance_cpu_time_us,
+  "Maintenance CPU Time",
+  kudu::MetricUnit::kMicroseconds,
+  "CPU time spent running maintenance operations, such as flushes and compactions, "
+  "of this tablet.");
+
 using strings::Substitute;
 using std::unordered_map;
 
@@ -238,6 +291,9 @@ TabletMetrics::TabletMetrics(const scoped_refptr<MetricEntity>& entity)
     MINIT(key_file_lookups),
     MINIT(delta_file_lookups),
     MINIT(mrs_lookups),
+    MINIT(mrs_filter_skips),
+    MINIT(mrs_filter_hits),
+    MINIT(mrs_filter_misses),
     MINIT(bytes_flushed),
     MINIT(bloom_lookups_per_op),
     MINIT(key_file_lookups_per_op),
@@ -251,12 +307,19 @@ TabletMetrics::TabletMetrics(const scoped_refptr<MetricEntity>& entity)
     GINIT(compact_rs_running),
     GINIT(delta_minor_compact_rs_running),
     GINIT(delta_major_compact_rs_running),
+    GINIT(undo_delta_block_gc_running),
     MINIT(flush_dms_duration),
     MINIT(flush_mrs_duration),
     MINIT(compact_rs_duration),
     MINIT(delta_minor_compact_rs_duration),
     MINIT(delta_major_compact_rs_duration),
-    MINIT(leader_memory_pressure_rejections) {
+    MINIT(undo_delta_block_gc_duration),
+    MINIT(undo_delta_block_gc_bytes_deleted),
+    MINIT(leader_memory_pressure_rejections),
+    MINIT(rpc_cpu_time_us),
+    MINIT(rpc_cfile_cache_hit_bytes),
+    MINIT(rpc_cfile_cache_miss_bytes),
+    MINIT(maintenance_cpu_time_us) {
 }
 #undef MINIT
 #undef GINIT
@@ -287,6 +350,9 @@ void TabletMetrics::AddProbeStats(const ProbeStats* stats_array, int len,
     sum.keys_consulted += stats.keys_consulted;
     sum.deltas_consulted += stats.deltas_consulted;
     sum.mrs_consulted += stats.mrs_consulted;
+    sum.mrs_filter_skips += stats.mrs_filter_skips;
+    sum.mrs_filter_hits += stats.mrs_filter_hits;
+    sum.mrs_filter_misses += stats.mrs_filter_misses;
 
     bloom_lookups_hist[stats.blooms_consulted]++;
     key_file_lookups_hist[stats.keys_consulted]++;
@@ -297,6 +363,9 @@ void TabletMetrics::AddProbeStats(const ProbeStats* stats_array, int len,
   key_file_lookups->IncrementBy(sum.keys_consulted);
   delta_file_lookups->IncrementBy(sum.deltas_consulted);
   mrs_lookups->IncrementBy(sum.mrs_consulted);
+  mrs_filter_skips->IncrementBy(sum.mrs_filter_skips);
+  mrs_filter_hits->IncrementBy(sum.mrs_filter_hits);
+  mrs_filter_misses->IncrementBy(sum.mrs_filter_misses);
 
   for (const auto& entry : bloom_lookups_hist) {
     bloom_lookups_per_op->IncrementBy(entry.first, entry.second);
@@ -309,9 +378,11 @@ void TabletMetrics::AddProbeStats(const ProbeStats* stats_array, int len,
   }
 
   TRACE("ProbeStats: bloom_lookups=$0,key_file_lookups=$1,"
-        "delta_file_lookups=$2,mrs_lookups=$3",
+        "delta_file_lookups=$2,mrs_lookups=$3,mrs_filter_skips=$4,"
+        "mrs_filter_hits=$5,mrs_filter_misses=$6",
         sum.blooms_consulted, sum.keys_consulted,
-        sum.deltas_consulted, sum.mrs_consulted);
+        sum.deltas_consulted, sum.mrs_consulted, sum.mrs_filter_skips,
+        sum.mrs_filter_hits, sum.mrs_filter_misses);
 }
 
 } // namespace tablet
@@ -64,6 +64,9 @@ struct TabletMetrics {
   scoped_refptr<Counter> key_file_lookups;
   scoped_refptr<Counter> delta_file_lookups;
   scoped_refptr<Counter> mrs_lookups;
+  scoped_refptr<Counter> mrs_filter_skips;
+  scoped_refptr<Counter> mrs_filter_hits;
+  scoped_refptr<Counter> mrs_filter_misses;
   scoped_refptr<Counter> bytes_flushed;
 
   scoped_refptr<Histogram> bloom_lookups_per_op;
@@ -80,14 +83,23 @@ struct TabletMetrics {
   scoped_refptr<AtomicGauge<uint32_t> > compact_rs_running;
   scoped_refptr<AtomicGauge<uint32_t> > delta_minor_compact_rs_running;
   scoped_refptr<AtomicGauge<uint32_t> > delta_major_compact_rs_running;
+  scoped_refptr<AtomicGauge<uint32_t> > undo_delta_block_gc_running;
 
   scoped_refptr<Histogram> flush_dms_duration;
   scoped_refptr<Histogram> flush_mrs_duration;
   scoped_refptr<Histogram> compact_rs_duration;
   scoped_refptr<Histogram> delta_minor_compact_rs_duration;
   scoped_refptr<Histogram> delta_major_compact_rs_duration;
+  scoped_refptr<Histogram> undo_delta_block_gc_duration;
+  scoped_refptr<Counter> undo_delta_block_gc_bytes_deleted;
 
   scoped_refptr<Counter> leader_memory_pressure_rejections;
+
+  // Resources used on behalf of the tablet, see tserver::ResourceAccountant.
+  scoped_refptr<Counter> rpc_cpu_time_us;
+  scoped_refptr<Counter> rpc_cfile_cache_hit_bytes;
+  scoped_refptr<Counter> rpc_cfile_cache_miss_bytes;
+  scoped_refptr<Counter> maintenance_cpu_time_us;
 };
 
 } // namespace tablet
@@ -18,10 +18,14 @@
 #ifndef KUDU_TABLET_TABLET_MM_OPS_H_
 #define KUDU_TABLET_TABLET_MM_OPS_H_
 
+#include <string>
+
 #include "kudu/util/maintenance_manager.h"
+#include "kudu/util/semaphore.h"
 
 namespace kudu {
 
+class Counter;
 class Histogram;
 template<class T>
 class AtomicGauge;
@@ -49,12 +53,17 @@ class CompactRowSetsOp : public MaintenanceOp {
 
   virtual scoped_refptr<AtomicGauge<uint32_t> > RunningGauge() const OVERRIDE;
 
+  virtual scoped_refptr<Counter> CpuTimeCounter() const OVERRIDE;
+
+  virtual std::string io_target() const OVERRIDE { return io_target_; }
+
  private:
   mutable simple_spinlock lock_;
   MaintenanceOpStats prev_stats_;
   uint64_t last_num_mrs_flushed_;
   uint64_t last_num_rs_compacted_;
   Tablet* const tablet_;
+  const std::string io_target_;
 };
 
 // MaintenanceOp to run minor compaction on delta stores.
@@ -76,6 +85,10 @@ class MinorDeltaCompactionOp : public MaintenanceOp {
 
   virtual scoped_refptr<AtomicGauge<uint32_t> > RunningGauge() const OVERRIDE;
 
+  virtual scoped_refptr<Counter> CpuTimeCounter() const OVERRIDE;
+
+  virtual std::string io_target() const OVERRIDE { return io_target_; }
+
  private:
   mutable simple_spinlock lock_;
   MaintenanceOpStats prev_stats_;
@@ -84,6 +97,7 @@ class MinorDeltaCompactionOp : public MaintenanceOp {
   uint64_t last_num_rs_compacted_;
   uint64_t last_num_rs_minor_delta_compacted_;
   Tablet* const tablet_;
+  const std::string io_target_;
 };
 
 // MaintenanceOp to run major compaction on delta stores.
@@ -103,6 +117,10 @@ class MajorDeltaCompactionOp : public MaintenanceOp {
 
   virtual scoped_refptr<AtomicGauge<uint32_t> > RunningGauge() const OVERRIDE;
 
+  virtual scoped_refptr<Counter> CpuTimeCounter() const OVERRIDE;
+
+  virtual std::string io_target() const OVERRIDE { return io_target_; }
+
  private:
   mutable simple_spinlock lock_;
   MaintenanceOpStats prev_stats_;
@@ -112,6 +130,39 @@ class MajorDeltaCompactionOp : public MaintenanceOp {
   uint64_t last_num_rs_minor_delta_compacted_;
   uint64_t last_num_rs_major_delta_compacted_;
   Tablet* const tablet_;
+  const std::string io_target_;
+};
+
+// MaintenanceOp to discard the UNDO deltas older than the ancient history
+// mark without compacting the rowsets they belong to.
+//
+// UNDO delta files which only hold ancient history are removed from their
+// rowsets' metadata, and files which mostly do are rewritten without it, so
+// that space is reclaimed and old snapshot scans read less even in rowsets
+// which are never compacted. The op is runnable when the delta statistics
+// show some ancient history; only one can run at a time per tablet.
+class UndoDeltaBlockGCOp : public MaintenanceOp {
+ public:
+  explicit UndoDeltaBlockGCOp(Tablet* tablet);
+
+  virtual void UpdateStats(MaintenanceOpStats* stats) OVERRIDE;
+
+  virtual bool Prepare() OVERRIDE;
+
+  virtual void Perform() OVERRIDE;
+
+  virtual scoped_refptr<Histogram> DurationHistogram() const OVERRIDE;
+
+  virtual scoped_refptr<AtomicGauge<uint32_t> > RunningGauge() const OVERRIDE;
+
+  virtual scoped_refptr<Counter> CpuTimeCounter() const OVERRIDE;
+
+  virtual std::string io_target() const OVERRIDE { return io_target_; }
+
+ private:
+  Tablet* const tablet_;
+  mutable Semaphore sem_;
+  const std::string io_target_;
 };
 
 } // namespace tablet
@@ -48,6 +48,7 @@
 METRIC_DECLARE_entity(tablet);
 
 DECLARE_int32(flush_threshold_mb);
+DECLARE_bool(tablet_concurrent_leader_prepare);
 
 namespace kudu {
 namespace tablet {
@@ -90,6 +91,7 @@ class TabletPeerTest : public KuduTabletTest {
   virtual void SetUp() OVERRIDE {
     KuduTabletTest::SetUp();
 
+    ASSERT_OK(ThreadPoolBuilder("prepare").Build(&prepare_pool_));
     ASSERT_OK(ThreadPoolBuilder("apply").Build(&apply_pool_));
 
     rpc::MessengerBuilder builder(CURRENT_TEST_NAME());
@@ -107,6 +109,7 @@ class TabletPeerTest : public KuduTabletTest {
     tablet_peer_.reset(
       new TabletPeer(make_scoped_refptr(tablet()->metadata()),
                      config_peer,
+                     prepare_pool_.get(),
                      apply_pool_.get(),
                      Bind(&TabletPeerTest::TabletPeerStateChangedCallback,
                           Unretained(this),
@@ -154,6 +157,7 @@ class TabletPeerTest : public KuduTabletTest {
 
   virtual void TearDown() OVERRIDE {
     tablet_peer_->Shutdown();
+    prepare_pool_->Shutdown();
     apply_pool_->Shutdown();
     KuduTabletTest::TearDown();
   }
@@ -261,6 +265,8 @@ class TabletPeerTest : public KuduTabletTest {
   MetricRegistry metric_registry_;
   scoped_refptr<MetricEntity> metric_entity_;
   shared_ptr<Messenger> messenger_;
+  // Declared before 'tablet_peer_' so that it outlives the peer's token.
+  gscoped_ptr<ThreadPool> prepare_pool_;
   scoped_refptr<TabletPeer> tablet_peer_;
   gscoped_ptr<ThreadPool> apply_pool_;
 };
@@ -521,6 +527,39 @@ TEST_F(TabletPeerTest, TestActiveTransactionPreventsLogGC) {
   ASSERT_EQ(2, segments.size());
 }
 
+// Tests that leader writes prepared concurrently are all applied, in OpId
+// order (the order verifier crashes the server otherwise).
+TEST_F(TabletPeerTest, TestConcurrentLeaderPrepare) {
+  FLAGS_tablet_concurrent_leader_prepare = true;
+  ConsensusBootstrapInfo info;
+  ASSERT_OK(StartPeer(info));
+
+  const int kNumWrites = 50;
+  std::vector<unique_ptr<WriteRequestPB>> reqs;
+  std::vector<unique_ptr<WriteResponsePB>> resps;
+  CountDownLatch rpc_latch(kNumWrites);
+  for (int i = 0; i < kNumWrites; i++) {
+    reqs.emplace_back(new WriteRequestPB());
+    resps.emplace_back(new WriteResponsePB());
+    ASSERT_OK(GenerateSequentialInsertRequest(reqs.back().get()));
+  }
+  for (int i = 0; i < kNumWrites; i++) {
+    unique_ptr<WriteTransactionState> tx_state(
+        new WriteTransactionState(tablet_peer_.get(), reqs[i].get(), nullptr, resps[i].get()));
+    tx_state->set_completion_callback(gscoped_ptr<TransactionCompletionCallback>(
+        new LatchTransactionCompletionCallback<WriteResponsePB>(&rpc_latch, resps[i].get())));
+    ASSERT_OK(tablet_peer_->SubmitWrite(std::move(tx_state)));
+  }
+  rpc_latch.Wait();
+  for (const auto& resp : resps) {
+    ASSERT_FALSE(resp->has_error()) << resp->DebugString();
+  }
+
+  uint64_t num_rows;
+  ASSERT_OK(tablet()->CountRows(&num_rows));
+  ASSERT_EQ(kNumWrites, num_rows);
+}
+
 TEST_F(TabletPeerTest, TestGCEmptyLog) {
   ConsensusBootstrapInfo info;
   tablet_peer_->Start(info);
@@ -557,6 +596,13 @@ TEST_F(TabletPeerTest, TestFlushOpsPerfImprovements) {
   ASSERT_LT(0.7, stats.perf_improvement());
   ASSERT_GT(1.0, stats.perf_improvement());
   stats.Clear();
+
+  // With the thresholds scaled up, the same MRS isn't over the size threshold
+  // nor due for a time-based flush anymore.
+  stats.set_ram_anchored(128 * 1024 * 1024);
+  FlushOpPerfImprovementPolicy::SetPerfImprovementForFlush(&stats, 3 * 60 * 1000, 4);
+  ASSERT_EQ(0.0, stats.perf_improvement());
+  stats.Clear();
 }
 
 } // namespace tablet
@@ -37,6 +37,7 @@
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/sysinfo.h"
+#include "kudu/gutil/walltime.h"
 #include "kudu/rpc/messenger.h"
 #include "kudu/rpc/remote_method.h"
 #include "kudu/rpc/rpc_service.h"
@@ -48,6 +49,7 @@
 #include "kudu/tablet/tablet_metrics.h"
 #include "kudu/tablet/tablet_peer_mm_ops.h"
 #include "kudu/tablet/tablet.pb.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/stopwatch.h"
@@ -60,6 +62,15 @@ using std::unique_ptr;
 namespace kudu {
 namespace tablet {
 
+DEFINE_bool(tablet_concurrent_leader_prepare, false,
+            "Whether write transactions submitted to the same tablet leader may "
+            "be prepared concurrently on the prepare pool. Transactions on "
+            "disjoint rows then decode their operations and take their row "
+            "locks in parallel; timestamp assignment and replication remain "
+            "serialized.");
+TAG_FLAG(tablet_concurrent_leader_prepare, advanced);
+TAG_FLAG(tablet_concurrent_leader_prepare, experimental);
+
 METRIC_DEFINE_histogram(tablet, op_prepare_queue_length, "Operation Prepare Queue Length",
                         MetricUnit::kTasks,
                         "Number of operations waiting to be prepared within this tablet. "
@@ -105,6 +116,7 @@ using tserver::TabletServerErrorPB;
 // ============================================================================
 TabletPeer::TabletPeer(const scoped_refptr<TabletMetadata>& meta,
                        const consensus::RaftPeerPB& local_peer_pb,
+                       ThreadPool* prepare_pool,
                        ThreadPool* apply_pool,
                        Callback<void(const std::string& reason)> mark_dirty_clbk)
     : meta_(meta),
@@ -112,6 +124,7 @@ TabletPeer::TabletPeer(const scoped_refptr<TabletMetadata>& meta,
       local_peer_pb_(local_peer_pb),
       state_(NOT_STARTED),
       last_status_("Tablet initializing..."),
+      prepare_pool_(prepare_pool),
       apply_pool_(apply_pool),
       log_anchor_registry_(new LogAnchorRegistry()),
       mark_dirty_clbk_(std::move(mark_dirty_clbk)) {}
@@ -135,13 +148,17 @@ Status TabletPeer::Init(const shared_ptr<Tablet>& tablet,
   DCHECK(tablet) << "A TabletPeer must be provided with a Tablet";
   DCHECK(log) << "A TabletPeer must be provided with a Log";
 
-  RETURN_NOT_OK(ThreadPoolBuilder("prepare").set_max_threads(1).Build(&prepare_pool_));
-  prepare_pool_->SetQueueLengthHistogram(
-      METRIC_op_prepare_queue_length.Instantiate(metric_entity));
-  prepare_pool_->SetQueueTimeMicrosHistogram(
-      METRIC_op_prepare_queue_time.Instantiate(metric_entity));
-  prepare_pool_->SetRunTimeMicrosHistogram(
-      METRIC_op_prepare_run_time.Instantiate(metric_entity));
+  ThreadPoolMetrics prepare_metrics;
+  prepare_metrics.queue_length_histogram =
+      METRIC_op_prepare_queue_length.Instantiate(metric_entity);
+  prepare_metrics.queue_time_us_histogram =
+      METRIC_op_prepare_queue_time.Instantiate(metric_entity);
+  prepare_metrics.run_time_us_histogram =
+      METRIC_op_prepare_run_time.Instantiate(metric_entity);
+  prepare_pool_token_ = prepare_pool_->NewTokenWithMetrics(
+      ThreadPool::ExecutionMode::SERIAL, prepare_metrics);
+  concurrent_prepare_pool_token_ = prepare_pool_->NewTokenWithMetrics(
+      ThreadPool::ExecutionMode::CONCURRENT, std::move(prepare_metrics));
 
   {
     std::lock_guard<simple_spinlock> lock(lock_);
@@ -211,6 +228,14 @@ const consensus::RaftConfigPB TabletPeer::RaftConfig() const {
 }
 
 void TabletPeer::Shutdown() {
+  ShutdownInternal(false);
+}
+
+bool TabletPeer::ShutdownAndFlush() {
+  return ShutdownInternal(true);
+}
+
+bool TabletPeer::ShutdownInternal(bool flush) {
 
   LOG(INFO) << "Initiating TabletPeer shutdown for tablet: " << tablet_id_;
 
@@ -219,8 +244,11 @@ void TabletPeer::Shutdown() {
     if (state_ == QUIESCING || state_ == SHUTDOWN) {
       lock.unlock();
       WaitUntilShutdown();
-      return;
+      return false;
     }
+    // Only a running tablet has anything to flush. Leaving the RUNNING state
+    // makes new writes fail, so that clients retry them on the new leader.
+    flush &= state_ == RUNNING;
     state_ = QUIESCING;
   }
 
@@ -232,6 +260,10 @@ void TabletPeer::Shutdown() {
   if (tablet_) tablet_->UnregisterMaintenanceOps();
   UnregisterMaintenanceOps();
 
+  if (flush) {
+    StepDownForShutdown();
+  }
+
   if (consensus_) consensus_->Shutdown();
 
   // TODO: KUDU-183: Keep track of the pending tasks and send an "abort" message.
@@ -240,10 +272,15 @@ void TabletPeer::Shutdown() {
     txn_tracker_.WaitForAllToFinish();
   }
 
-  if (prepare_pool_) {
-    prepare_pool_->Shutdown();
+  if (concurrent_prepare_pool_token_) {
+    concurrent_prepare_pool_token_->Shutdown();
+  }
+  if (prepare_pool_token_) {
+    prepare_pool_token_->Shutdown();
   }
 
+  bool clean = flush && FlushForCleanShutdown();
+
   if (log_) {
     WARN_NOT_OK(log_->Close(), "Error closing the Log.");
   }
@@ -264,6 +301,65 @@ void TabletPeer::Shutdown() {
     tablet_.reset();
     state_ = SHUTDOWN;
   }
+  return clean;
+}
+
+void TabletPeer::StepDownForShutdown() {
+  scoped_refptr<Consensus> consensus = shared_consensus();
+  // Hand leadership over before shutting down consensus, rather than leaving
+  // the followers to notice the leader is gone. A single replica would only
+  // elect itself again.
+  if (!consensus || consensus->role() != RaftPeerPB::LEADER ||
+      consensus::CountVoters(consensus->CommittedConfig()) <= 1) {
+    return;
+  }
+  consensus::LeaderStepDownResponsePB resp;
+  WARN_NOT_OK(consensus->StepDown(&resp),
+              Substitute("T $0: Unable to step down before shutting down", tablet_id_));
+}
+
+bool TabletPeer::FlushForCleanShutdown() {
+  // With consensus shut down, nothing is appended to the WAL anymore. The
+  // operations received but not committed must be replayed, to be committed
+  // or aborted by the next leader.
+  OpId last_received;
+  OpId last_committed;
+  Status s = consensus_->GetLastOpId(consensus::RECEIVED_OPID, &last_received);
+  if (s.ok()) {
+    s = consensus_->GetLastOpId(consensus::COMMITTED_OPID, &last_committed);
+  }
+  bool all_committed = s.ok() && OpIdEquals(last_received, last_committed);
+
+  LOG_TIMING(INFO, Substitute("flushing tablet $0 for shutdown", tablet_id_)) {
+    if (!tablet_->MemRowSetEmpty()) {
+      s = tablet_->Flush();
+    }
+    if (s.ok()) {
+      s = tablet_->FlushAllDMS();
+    }
+  }
+  if (!s.ok()) {
+    LOG(WARNING) << "T " << tablet_id_ << ": Unable to flush for shutdown: " << s.ToString();
+    return false;
+  }
+  if (!all_committed || !tablet_->MemRowSetEmpty() || !tablet_->DeltaMemRowSetEmpty()) {
+    LOG(INFO) << "T " << tablet_id_ << ": Not all operations are committed and flushed, "
+              << "the WAL will be replayed on restart";
+    return false;
+  }
+
+  CleanShutdownPB clean_shutdown;
+  *clean_shutdown.mutable_last_op_id() = last_received;
+  clean_shutdown.set_timestamp(clock_->Now().ToUint64());
+  clean_shutdown.set_wall_time_us(GetCurrentTimeMicros());
+  meta_->SetCleanShutdown(clean_shutdown);
+  s = meta_->Flush();
+  if (!s.ok()) {
+    LOG(WARNING) << "T " << tablet_id_ << ": Unable to record clean shutdown: " << s.ToString();
+    meta_->TakeCleanShutdown(&clean_shutdown);
+    return false;
+  }
+  return true;
 }
 
 void TabletPeer::WaitUntilShutdown() {
@@ -546,15 +642,71 @@ Status TabletPeer::StartReplicaTransaction(const scoped_refptr<ConsensusRound>&
   return Status::OK();
 }
 
+Timestamp TabletPeer::GetSafeTimestampForFollowers() {
+  shared_ptr<Tablet> tablet = shared_tablet();
+  if (!tablet) {
+    return Timestamp::kInvalidTimestamp;
+  }
+  // Transactions which start from now on are assigned a later timestamp, so
+  // everything below the resulting clean time has already been applied.
+  MvccManager* mvcc = tablet->mvcc_manager();
+  mvcc->OfflineAdjustSafeTime(clock_->Now());
+  Timestamp clean = mvcc->GetCleanTimestamp();
+  if (clean.value() <= Timestamp::kInitialTimestamp.value()) {
+    return Timestamp::kInvalidTimestamp;
+  }
+  return Timestamp(clean.value() - 1);
+}
+
+void TabletPeer::AdvanceSafeTimestamp(int64_t committed_index, Timestamp safe_timestamp) {
+  shared_ptr<Tablet> tablet;
+  {
+    std::lock_guard<simple_spinlock> lock(lock_);
+    if (state_ != RUNNING) {
+      return;
+    }
+    tablet = tablet_;
+  }
+
+  // Transactions up to 'committed_index' may have timestamps at or below the
+  // safe time, so they must all have been applied before it can be adopted.
+  vector<scoped_refptr<TransactionDriver> > pending_transactions;
+  txn_tracker_.GetPendingTransactions(&pending_transactions);
+  for (const scoped_refptr<TransactionDriver>& driver : pending_transactions) {
+    OpId tx_op_id = driver->GetOpId();
+    if (tx_op_id.IsInitialized() && tx_op_id.index() <= committed_index) {
+      return;
+    }
+  }
+
+  Status s = clock_->Update(safe_timestamp);
+  if (PREDICT_FALSE(!s.ok())) {
+    KLOG_EVERY_N_SECS(WARNING, 10) << "T " << tablet_id_ << ": unable to update the clock "
+                                   << "to the leader's safe time: " << s.ToString();
+    return;
+  }
+  tablet->mvcc_manager()->OfflineAdjustSafeTime(safe_timestamp);
+}
+
 Status TabletPeer::NewLeaderTransactionDriver(gscoped_ptr<Transaction> transaction,
                                               scoped_refptr<TransactionDriver>* driver) {
+  // Replica transactions left over from a previous term are prepared serially
+  // and must be applied before any of ours, so only bypass the serial token
+  // once they have all completed. Replica transactions can't start while we
+  // remain the leader.
+  ThreadPoolToken* prepare_token = prepare_pool_token_.get();
+  if (FLAGS_tablet_concurrent_leader_prepare &&
+      txn_tracker_.GetNumPendingReplicaTransactions() == 0) {
+    prepare_token = concurrent_prepare_pool_token_.get();
+  }
   scoped_refptr<TransactionDriver> tx_driver = new TransactionDriver(
     &txn_tracker_,
     consensus_.get(),
     log_.get(),
-    prepare_pool_.get(),
+    prepare_token,
     apply_pool_,
-    &txn_order_verifier_);
+    &txn_order_verifier_,
+    &start_replicate_lock_);
   RETURN_NOT_OK(tx_driver->Init(std::move(transaction), consensus::LEADER));
   driver->swap(tx_driver);
 
@@ -567,9 +719,10 @@ Status TabletPeer::NewReplicaTransactionDriver(gscoped_ptr<Transaction> transact
     &txn_tracker_,
     consensus_.get(),
     log_.get(),
-    prepare_pool_.get(),
+    prepare_pool_token_.get(),
     apply_pool_,
-    &txn_order_verifier_);
+    &txn_order_verifier_,
+    &start_replicate_lock_);
   RETURN_NOT_OK(tx_driver->Init(std::move(transaction), consensus::REPLICA));
   driver->swap(tx_driver);
 
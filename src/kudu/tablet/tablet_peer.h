@@ -51,6 +51,8 @@ class CatchUpServiceTest;
 
 class MaintenanceManager;
 class MaintenanceOp;
+class ThreadPool;
+class ThreadPoolToken;
 
 namespace tablet {
 class LeaderTransactionDriver;
@@ -82,7 +84,8 @@ class TabletPeer : public RefCountedThreadSafe<TabletPeer>,
   typedef std::map<int64_t, int64_t> MaxIdxToSegmentSizeMap;
 
   TabletPeer(const scoped_refptr<TabletMetadata>& meta,
-             const consensus::RaftPeerPB& local_peer_pb, ThreadPool* apply_pool,
+             const consensus::RaftPeerPB& local_peer_pb,
+             ThreadPool* prepare_pool, ThreadPool* apply_pool,
              Callback<void(const std::string& reason)> mark_dirty_clbk);
 
   // Initializes the TabletPeer, namely creating the Log and initializing
@@ -103,6 +106,19 @@ class TabletPeer : public RefCountedThreadSafe<TabletPeer>,
   // If a shutdown is already in progress, blocks until that shutdown is complete.
   void Shutdown();
 
+  // Shuts down this tablet peer like Shutdown(), but gracefully: it first
+  // steps down if it's the leader, and once consensus no longer replicates
+  // operations, flushes the MemRowSet and DeltaMemStores. If every operation
+  // in the WAL was committed, a clean shutdown is then recorded in the tablet
+  // metadata, which lets the next bootstrap skip replaying the WAL.
+  //
+  // Returns whether a clean shutdown was recorded.
+  bool ShutdownAndFlush();
+
+  // Steps down if this peer leads a replicated tablet, so that another
+  // replica takes over its writes ahead of a graceful shutdown.
+  void StepDownForShutdown();
+
   // Check that the tablet is in a RUNNING state.
   Status CheckRunning() const;
 
@@ -135,6 +151,17 @@ class TabletPeer : public RefCountedThreadSafe<TabletPeer>,
   virtual Status StartReplicaTransaction(
       const scoped_refptr<consensus::ConsensusRound>& round) OVERRIDE;
 
+  // Used by consensus on the leader to obtain the safe time to propagate to
+  // followers: just below the tablet's clean time, after marking the current
+  // time as safe.
+  virtual Timestamp GetSafeTimestampForFollowers() OVERRIDE;
+
+  // Used by consensus on followers to adopt the leader's safe time once every
+  // transaction up to 'committed_index' has been applied. If some are still
+  // in flight the update is dropped; a later request will carry a newer one.
+  virtual void AdvanceSafeTimestamp(int64_t committed_index,
+                                    Timestamp safe_timestamp) OVERRIDE;
+
   consensus::Consensus* consensus() {
     std::lock_guard<simple_spinlock> lock(lock_);
     return consensus_.get();
@@ -278,6 +305,13 @@ class TabletPeer : public RefCountedThreadSafe<TabletPeer>,
   // Wait until the TabletPeer is fully in SHUTDOWN state.
   void WaitUntilShutdown();
 
+  // Implements Shutdown() and ShutdownAndFlush().
+  bool ShutdownInternal(bool flush);
+
+  // Flushes the tablet once consensus is shut down, and records a clean
+  // shutdown if nothing is left to replay. Returns whether it did.
+  bool FlushForCleanShutdown();
+
   // After bootstrap is complete and consensus is setup this initiates the transactions
   // that were not complete on bootstrap.
   // Not implemented yet. See .cc file.
@@ -298,7 +332,10 @@ class TabletPeer : public RefCountedThreadSafe<TabletPeer>,
   std::shared_ptr<Tablet> tablet_;
   std::shared_ptr<rpc::Messenger> messenger_;
   scoped_refptr<consensus::Consensus> consensus_;
-  simple_spinlock prepare_replicate_lock_;
+
+  // Serializes timestamp assignment and replication of leader transactions
+  // which were prepared concurrently. See TransactionDriver.
+  std::mutex start_replicate_lock_;
 
   // Lock protecting state_, last_status_, as well as smart pointers to collaborating
   // classes such as tablet_ and consensus_.
@@ -316,12 +353,23 @@ class TabletPeer : public RefCountedThreadSafe<TabletPeer>,
   // during them in order to reject RPCs, etc.
   mutable simple_spinlock state_change_lock_;
 
-  // IMPORTANT: correct execution of PrepareTask assumes that 'prepare_pool_'
-  // is single-threaded, moving to a multi-tablet setup where multiple TabletPeers
-  // use the same 'prepare_pool_' needs to enforce that, for a single
-  // TabletPeer, PrepareTasks are executed *serially*.
-  // TODO move the prepare pool to TabletServer.
-  gscoped_ptr<ThreadPool> prepare_pool_;
+  // Pool that executes prepare tasks for transactions. Like 'apply_pool_',
+  // this is shared between tablets and constructor-injected by either the
+  // Master (for system tables) or the Tablet server.
+  ThreadPool* prepare_pool_;
+
+  // Token through which this peer's prepare tasks are submitted to
+  // 'prepare_pool_'. Created in Init().
+  //
+  // IMPORTANT: correct execution of PrepareTask assumes that, for a single
+  // TabletPeer, replica PrepareTasks are executed *serially*, so this must be
+  // a SERIAL token.
+  std::unique_ptr<ThreadPoolToken> prepare_pool_token_;
+
+  // CONCURRENT token through which leader transactions are prepared when
+  // --tablet_concurrent_leader_prepare is set and no replica transactions are
+  // pending. Created in Init().
+  std::unique_ptr<ThreadPoolToken> concurrent_prepare_pool_token_;
 
   // Pool that executes apply tasks for transactions. This is a multi-threaded
   // pool, constructor-injected by either the Master (for system tables) or
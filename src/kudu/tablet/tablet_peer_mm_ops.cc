@@ -23,11 +23,13 @@
 #include <mutex>
 #include <string>
 
+#include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/tablet/tablet_metrics.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/maintenance_manager.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/path_util.h"
 
 DEFINE_int32(flush_threshold_mb, 1024,
              "Size at which MemRowSet flushes are triggered. "
@@ -60,8 +62,10 @@ const double kFlushUpperBoundMs = 60 * 60 * 1000;
 //
 
 void FlushOpPerfImprovementPolicy::SetPerfImprovementForFlush(MaintenanceOpStats* stats,
-                                                              double elapsed_ms) {
-  if (stats->ram_anchored() > FLAGS_flush_threshold_mb * 1024 * 1024) {
+                                                              double elapsed_ms,
+                                                              double threshold_scale) {
+  const double threshold_mb = FLAGS_flush_threshold_mb * threshold_scale;
+  if (stats->ram_anchored() > threshold_mb * 1024 * 1024) {
     // If we're over the user-specified flush threshold, then consider the perf
     // improvement to be 1 for every extra MB.  This produces perf_improvement results
     // which are much higher than any compaction would produce, and means that, when
@@ -69,15 +73,15 @@ void FlushOpPerfImprovementPolicy::SetPerfImprovementForFlush(MaintenanceOpStats
     // a compaction.  That's not necessarily a good thing, but in the absence of better
     // heuristics, it will do for now.
     double extra_mb =
-        static_cast<double>(FLAGS_flush_threshold_mb - (stats->ram_anchored()) / (1024 * 1024));
+        static_cast<double>(stats->ram_anchored()) / (1024 * 1024) - threshold_mb;
     stats->set_perf_improvement(extra_mb);
-  } else if (elapsed_ms > kFlushDueToTimeMs) {
+  } else if (elapsed_ms > kFlushDueToTimeMs * threshold_scale) {
     // Even if we aren't over the threshold, consider flushing if we haven't flushed
     // in a long time. But, don't give it a large perf_improvement score. We should
     // only do this if we really don't have much else to do, and if we've already waited a bit.
     // The following will give an improvement that's between 0.0 and 1.0, gradually growing
     // as 'elapsed_ms' approaches 'kFlushUpperBoundMs'.
-    double perf = elapsed_ms / kFlushUpperBoundMs;
+    double perf = elapsed_ms / (kFlushUpperBoundMs * threshold_scale);
     if (perf > 1.0) {
       perf = 1.0;
     }
@@ -111,7 +115,8 @@ void FlushMRSOp::UpdateStats(MaintenanceOpStats* stats) {
   // been in the last 5 minutes.
   FlushOpPerfImprovementPolicy::SetPerfImprovementForFlush(
       stats,
-      time_since_flush_.elapsed().wall_millis());
+      time_since_flush_.elapsed().wall_millis(),
+      flush_threshold_scale());
 }
 
 bool FlushMRSOp::Prepare() {
@@ -142,6 +147,10 @@ scoped_refptr<AtomicGauge<uint32_t> > FlushMRSOp::RunningGauge() const {
   return tablet_peer_->tablet()->metrics()->flush_mrs_running;
 }
 
+scoped_refptr<Counter> FlushMRSOp::CpuTimeCounter() const {
+  return tablet_peer_->tablet()->metrics()->maintenance_cpu_time_us;
+}
+
 //
 // FlushDeltaMemStoresOp.
 //
@@ -164,7 +173,8 @@ void FlushDeltaMemStoresOp::UpdateStats(MaintenanceOpStats* stats) {
 
   FlushOpPerfImprovementPolicy::SetPerfImprovementForFlush(
       stats,
-      time_since_flush_.elapsed().wall_millis());
+      time_since_flush_.elapsed().wall_millis(),
+      flush_threshold_scale());
 }
 
 void FlushDeltaMemStoresOp::Perform() {
@@ -191,6 +201,10 @@ scoped_refptr<AtomicGauge<uint32_t> > FlushDeltaMemStoresOp::RunningGauge() cons
   return tablet_peer_->tablet()->metrics()->flush_dms_running;
 }
 
+scoped_refptr<Counter> FlushDeltaMemStoresOp::CpuTimeCounter() const {
+  return tablet_peer_->tablet()->metrics()->maintenance_cpu_time_us;
+}
+
 //
 // LogGCOp.
 //
@@ -203,7 +217,9 @@ LogGCOp::LogGCOp(TabletPeer* tablet_peer)
                            tablet_peer->tablet()->GetMetricEntity())),
       log_gc_running_(METRIC_log_gc_running.Instantiate(
                           tablet_peer->tablet()->GetMetricEntity(), 0)),
-      sem_(1) {}
+      sem_(1),
+      io_target_(DirName(tablet_peer->tablet()->metadata()->fs_manager()->GetTabletWalDir(
+                     tablet_peer->tablet_id()))) {}
 
 void LogGCOp::UpdateStats(MaintenanceOpStats* stats) {
   int64_t retention_size;
@@ -236,5 +252,9 @@ scoped_refptr<AtomicGauge<uint32_t> > LogGCOp::RunningGauge() const {
   return log_gc_running_;
 }
 
+scoped_refptr<Counter> LogGCOp::CpuTimeCounter() const {
+  return tablet_peer_->tablet()->metrics()->maintenance_cpu_time_us;
+}
+
 }  // namespace tablet
 }  // namespace kudu
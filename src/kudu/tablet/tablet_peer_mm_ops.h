@@ -24,6 +24,7 @@
 
 namespace kudu {
 
+class Counter;
 class Histogram;
 template<class T>
 class AtomicGauge;
@@ -36,7 +37,11 @@ class FlushOpPerfImprovementPolicy {
 
   // Sets the performance improvement based on the anchored ram if it's over the threshold,
   // else it will set it based on how long it has been since the last flush.
-  static void SetPerfImprovementForFlush(MaintenanceOpStats* stats, double elapsed_ms);
+  //
+  // Both the size and time thresholds are multiplied by 'threshold_scale'; see
+  // MaintenanceOp::flush_threshold_scale().
+  static void SetPerfImprovementForFlush(MaintenanceOpStats* stats, double elapsed_ms,
+                                         double threshold_scale = 1);
 
  private:
   FlushOpPerfImprovementPolicy() {}
@@ -48,7 +53,8 @@ class FlushMRSOp : public MaintenanceOp {
   explicit FlushMRSOp(TabletPeer* tablet_peer)
     : MaintenanceOp(StringPrintf("FlushMRSOp(%s)", tablet_peer->tablet()->tablet_id().c_str()),
                     MaintenanceOp::HIGH_IO_USAGE),
-      tablet_peer_(tablet_peer) {
+      tablet_peer_(tablet_peer),
+      io_target_(tablet_peer->tablet()->DataIOTarget()) {
     time_since_flush_.start();
   }
 
@@ -62,12 +68,17 @@ class FlushMRSOp : public MaintenanceOp {
 
   virtual scoped_refptr<AtomicGauge<uint32_t> > RunningGauge() const OVERRIDE;
 
+  virtual scoped_refptr<Counter> CpuTimeCounter() const OVERRIDE;
+
+  virtual std::string io_target() const OVERRIDE { return io_target_; }
+
  private:
   // Lock protecting time_since_flush_.
   mutable simple_spinlock lock_;
   Stopwatch time_since_flush_;
 
   TabletPeer *const tablet_peer_;
+  const std::string io_target_;
 };
 
 // Maintenance op for DMS flush.
@@ -78,7 +89,8 @@ class FlushDeltaMemStoresOp : public MaintenanceOp {
     : MaintenanceOp(StringPrintf("FlushDeltaMemStoresOp(%s)",
                                  tablet_peer->tablet()->tablet_id().c_str()),
                     MaintenanceOp::HIGH_IO_USAGE),
-      tablet_peer_(tablet_peer) {
+      tablet_peer_(tablet_peer),
+      io_target_(tablet_peer->tablet()->DataIOTarget()) {
     time_since_flush_.start();
   }
 
@@ -94,12 +106,17 @@ class FlushDeltaMemStoresOp : public MaintenanceOp {
 
   virtual scoped_refptr<AtomicGauge<uint32_t> > RunningGauge() const OVERRIDE;
 
+  virtual scoped_refptr<Counter> CpuTimeCounter() const OVERRIDE;
+
+  virtual std::string io_target() const OVERRIDE { return io_target_; }
+
  private:
   // Lock protecting time_since_flush_
   mutable simple_spinlock lock_;
   Stopwatch time_since_flush_;
 
   TabletPeer *const tablet_peer_;
+  const std::string io_target_;
 };
 
 // Maintenance task that runs log GC. Reports log retention that represents the amount of data
@@ -120,11 +137,16 @@ class LogGCOp : public MaintenanceOp {
 
   virtual scoped_refptr<AtomicGauge<uint32_t> > RunningGauge() const OVERRIDE;
 
+  virtual scoped_refptr<Counter> CpuTimeCounter() const OVERRIDE;
+
+  virtual std::string io_target() const OVERRIDE { return io_target_; }
+
  private:
   TabletPeer *const tablet_peer_;
   scoped_refptr<Histogram> log_gc_duration_;
   scoped_refptr<AtomicGauge<uint32_t> > log_gc_running_;
   mutable Semaphore sem_;
+  const std::string io_target_;
 };
 
 } // namespace tablet
@@ -0,0 +1,168 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "kudu/common/partial_row.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/walltime.h"
+#include "kudu/server/hybrid_clock.h"
+#include "kudu/tablet/local_tablet_writer.h"
+#include "kudu/tablet/tablet.h"
+#include "kudu/tablet/tablet-test-util.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/test_macros.h"
+
+using std::shared_ptr;
+using std::vector;
+
+namespace kudu {
+namespace tablet {
+
+class TestTabletRowTtl : public KuduTabletTest {
+ public:
+  static const int64_t kRowTtlUsec = 4 * 1000 * 1000;
+
+  explicit TestTabletRowTtl(TabletHarness::Options::ClockType clock_type =
+                                TabletHarness::Options::ClockType::LOGICAL_CLOCK)
+      : KuduTabletTest(Schema({ ColumnSchema("time", UNIXTIME_MICROS),
+                                ColumnSchema("val", INT32) }, 1),
+                       clock_type) {
+    compaction_policy_.set_row_ttl_usec(kRowTtlUsec);
+  }
+
+ protected:
+  Status WriteRow(LocalTabletWriter* writer, RowOperationsPB::Type type, int64_t time) {
+    KuduPartialRow row(&client_schema_);
+    RETURN_NOT_OK(row.SetUnixTimeMicros(0, time));
+    if (type != RowOperationsPB::DELETE) {
+      RETURN_NOT_OK(row.SetInt32(1, 0));
+    }
+    return writer->Write(type, row);
+  }
+
+  Status InsertRows(int64_t first_time, int num_rows) {
+    LocalTabletWriter writer(tablet().get(), &client_schema_);
+    for (int i = 0; i < num_rows; i++) {
+      RETURN_NOT_OK(WriteRow(&writer, RowOperationsPB::INSERT, first_time + i));
+    }
+    return Status::OK();
+  }
+
+  // Returns the number of rows returned by a scan of the tablet.
+  int ScanRows() {
+    gscoped_ptr<RowwiseIterator> iter;
+    CHECK_OK(tablet()->NewRowIterator(client_schema_, &iter));
+    CHECK_OK(iter->Init(nullptr));
+    int fetched;
+    CHECK_OK(SilentIterateToStringList(iter.get(), &fetched));
+    return fetched;
+  }
+};
+
+// Test that expired rows are neither scanned nor written, and that they're
+// dropped by flushes and compactions, whole rowsets at a time if possible.
+TEST_F(TestTabletRowTtl, TestExpiration) {
+  // The "old" rows expire a couple of seconds into the test.
+  const int64_t now = GetCurrentTimeMicros();
+  const int64_t old = now - kRowTtlUsec + 2 * 1000 * 1000;
+
+  // A rowset which will expire as a whole, one which will partly expire, and
+  // the same in the MemRowSet.
+  ASSERT_OK(InsertRows(old, 10));
+  ASSERT_OK(tablet()->Flush());
+  ASSERT_OK(InsertRows(old + 100, 5));
+  ASSERT_OK(InsertRows(now, 10));
+  ASSERT_OK(tablet()->Flush());
+  ASSERT_OK(InsertRows(old + 200, 5));
+  ASSERT_OK(InsertRows(now + 100, 5));
+  ASSERT_EQ(35, ScanRows());
+
+  while (GetCurrentTimeMicros() - kRowTtlUsec <= old + 200 + 5) {
+    SleepFor(MonoDelta::FromMilliseconds(100));
+  }
+  ASSERT_EQ(15, ScanRows());
+  int64_t count;
+  int num_scanned;
+  ASSERT_OK(tablet()->CountRows(MvccSnapshot(*tablet()->mvcc_manager()), &count, &num_scanned));
+  ASSERT_EQ(15, count);
+
+  // Expired rows can't be written, but the others can.
+  LocalTabletWriter writer(tablet().get(), &client_schema_);
+  Status s = WriteRow(&writer, RowOperationsPB::UPDATE, old + 100);
+  ASSERT_TRUE(s.IsNotFound()) << s.ToString();
+  s = WriteRow(&writer, RowOperationsPB::DELETE, old + 200);
+  ASSERT_TRUE(s.IsNotFound()) << s.ToString();
+  s = WriteRow(&writer, RowOperationsPB::INSERT, old + 300);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  s = WriteRow(&writer, RowOperationsPB::UPSERT, old + 300);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  ASSERT_OK(WriteRow(&writer, RowOperationsPB::UPDATE, now));
+
+  // The flush drops the expired rows of the MemRowSet, and the compaction
+  // drops the expired rowset without rewriting it, then the expired rows of
+  // the others.
+  ASSERT_OK(tablet()->Flush());
+  ASSERT_EQ(3, tablet()->num_rowsets());
+  ASSERT_OK(tablet()->Compact(Tablet::FORCE_COMPACT_ALL));
+  vector<shared_ptr<RowSet>> rowsets;
+  tablet()->GetRowSetsForTests(&rowsets);
+  ASSERT_EQ(1, rowsets.size());
+  rowid_t num_rows;
+  ASSERT_OK(rowsets[0]->CountRows(&num_rows));
+  ASSERT_EQ(15, num_rows);
+  ASSERT_EQ(15, ScanRows());
+}
+
+class TestTabletRowTtlHybridClock : public TestTabletRowTtl {
+ public:
+  TestTabletRowTtlHybridClock()
+      : TestTabletRowTtl(TabletHarness::Options::ClockType::HYBRID_CLOCK) {}
+};
+
+// Test that writes decide whether a row expired from their own timestamp,
+// as every replica does for the same replicated write, and that flushes and
+// compactions only drop rows no pending write can reach.
+TEST_F(TestTabletRowTtlHybridClock, TestCutoffsFollowTimestamps) {
+  const int64_t kWriteMicros = 1000 * 1000 * 1000;
+  int64_t write_cutoff;
+  ASSERT_TRUE(tablet()->GetRowTtlCutoffAt(
+      server::HybridClock::TimestampFromMicroseconds(kWriteMicros), &write_cutoff));
+  ASSERT_EQ(kWriteMicros - kRowTtlUsec, write_cutoff);
+
+  const int64_t now = GetCurrentTimeMicros();
+  ASSERT_OK(InsertRows(now, 10));
+  LocalTabletWriter writer(tablet().get(), &client_schema_);
+  Status s = WriteRow(&writer, RowOperationsPB::INSERT, now - 2 * kRowTtlUsec);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+
+  int64_t drop_cutoff;
+  int64_t scan_cutoff;
+  ASSERT_TRUE(tablet()->GetRowTtlDropCutoff(&drop_cutoff));
+  ASSERT_TRUE(tablet()->GetRowTtlCutoff(&scan_cutoff));
+  ASSERT_LE(drop_cutoff, scan_cutoff);
+  ASSERT_TRUE(tablet()->GetRowTtlCutoffAt(
+      tablet()->mvcc_manager()->GetCleanTimestamp(), &write_cutoff));
+  ASSERT_LE(drop_cutoff, write_cutoff);
+  ASSERT_EQ(10, ScanRows());
+}
+
+} // namespace tablet
+} // namespace kudu
@@ -65,6 +65,14 @@ const tserver::TabletServerErrorPB::Code TransactionCompletionCallback::error_co
   return code_;
 }
 
+void TransactionCompletionCallback::set_leader_uuid(const std::string& leader_uuid) {
+  leader_uuid_ = leader_uuid;
+}
+
+const std::string& TransactionCompletionCallback::leader_uuid() const {
+  return leader_uuid_;
+}
+
 void TransactionCompletionCallback::TransactionCompleted() {}
 
 TransactionCompletionCallback::~TransactionCompletionCallback() {}
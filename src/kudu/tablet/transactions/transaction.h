@@ -142,6 +142,10 @@ class TransactionState {
   // This will only return a non-null object for leader-side transactions.
   virtual google::protobuf::Message* response() const { return NULL; }
 
+  // Returns the memory used by the request, including any of its data which
+  // is held outside of the request PB.
+  virtual int64_t RequestSpaceUsed() const { return request()->SpaceUsed(); }
+
   // Returns whether the results of the transaction are being tracked.
   bool are_results_tracked() const {
     return result_tracker_.get() != nullptr && has_request_id();
@@ -319,6 +323,12 @@ class TransactionCompletionCallback {
 
   const tserver::TabletServerErrorPB::Code error_code() const;
 
+  // Sets the UUID of the replica believed to lead the tablet, when this
+  // transaction failed because the local replica isn't the leader.
+  void set_leader_uuid(const std::string& leader_uuid);
+
+  const std::string& leader_uuid() const;
+
   // Subclasses should override this.
   virtual void TransactionCompleted();
 
@@ -327,6 +337,7 @@ class TransactionCompletionCallback {
  protected:
   Status status_;
   tserver::TabletServerErrorPB::Code code_;
+  std::string leader_uuid_;
 };
 
 // TransactionCompletionCallback implementation that can be waited on.
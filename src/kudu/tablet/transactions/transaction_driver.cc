@@ -84,15 +84,17 @@ class FollowerTransactionCompletionCallback : public TransactionCompletionCallba
 TransactionDriver::TransactionDriver(TransactionTracker *txn_tracker,
                                      Consensus* consensus,
                                      Log* log,
-                                     ThreadPool* prepare_pool,
+                                     ThreadPoolToken* prepare_pool_token,
                                      ThreadPool* apply_pool,
-                                     TransactionOrderVerifier* order_verifier)
+                                     TransactionOrderVerifier* order_verifier,
+                                     std::mutex* start_replicate_lock)
     : txn_tracker_(txn_tracker),
       consensus_(consensus),
       log_(log),
-      prepare_pool_(prepare_pool),
+      prepare_pool_token_(prepare_pool_token),
       apply_pool_(apply_pool),
       order_verifier_(order_verifier),
+      start_replicate_lock_(start_replicate_lock),
       trace_(new Trace()),
       start_time_(MonoTime::Now()),
       replication_state_(NOT_REPLICATING),
@@ -157,6 +159,10 @@ Transaction::TransactionType TransactionDriver::tx_type() const {
   return transaction_->tx_type();
 }
 
+consensus::DriverType TransactionDriver::driver_type() const {
+  return transaction_->type();
+}
+
 string TransactionDriver::ToString() const {
   std::lock_guard<simple_spinlock> lock(lock_);
   return ToStringUnlocked();
@@ -186,7 +192,7 @@ Status TransactionDriver::ExecuteAsync() {
   }
 
   if (s.ok()) {
-    s = prepare_pool_->SubmitClosure(
+    s = prepare_pool_token_->SubmitClosure(
       Bind(&TransactionDriver::PrepareAndStartTask, Unretained(this)));
   }
 
@@ -241,6 +247,16 @@ Status TransactionDriver::PrepareAndStart() {
   prepare_physical_timestamp_ = GetMonoTimeMicros();
 
   RETURN_NOT_OK(transaction_->Prepare());
+
+  // Leader transactions may have been prepared concurrently. Serialize the
+  // rest, up to and including the call to Replicate(), so that timestamps
+  // increase with OpIds and so that the order verifier sees prepares complete
+  // in OpId order.
+  std::unique_lock<std::mutex> start_replicate_lock;
+  if (start_replicate_lock_ && transaction_->type() == consensus::LEADER) {
+    start_replicate_lock = std::unique_lock<std::mutex>(*start_replicate_lock_);
+    prepare_physical_timestamp_ = GetMonoTimeMicros();
+  }
   RETURN_NOT_OK(transaction_->Start());
 
   // Only take the lock long enough to take a local copy of the
@@ -341,6 +357,16 @@ void TransactionDriver::HandleFailure(const Status& s) {
           "replication success: " << s.ToString();
       transaction_->Finish(Transaction::ABORTED);
       mutable_state()->completion_callback()->set_error(transaction_status_);
+      // A leader transaction rejected because the local replica isn't the
+      // leader: tell the client which replica is, if we know.
+      if (repl_state_copy == NOT_REPLICATING && driver_type() == consensus::LEADER &&
+          transaction_status_.IsIllegalState()) {
+        string leader_uuid = consensus_->ConsensusState(
+            consensus::CONSENSUS_CONFIG_COMMITTED).leader_uuid();
+        if (!leader_uuid.empty() && leader_uuid != consensus_->peer_uuid()) {
+          mutable_state()->completion_callback()->set_leader_uuid(leader_uuid);
+        }
+      }
       mutable_state()->completion_callback()->TransactionCompleted();
       txn_tracker_->Release(this);
       return;
@@ -18,6 +18,7 @@
 #ifndef KUDU_TABLET_TRANSACTION_DRIVER_H_
 #define KUDU_TABLET_TRANSACTION_DRIVER_H_
 
+#include <mutex>
 #include <string>
 #include <kudu/rpc/result_tracker.h>
 
@@ -30,6 +31,7 @@
 
 namespace kudu {
 class ThreadPool;
+class ThreadPoolToken;
 
 namespace log {
 class Log;
@@ -54,8 +56,8 @@ class TransactionTracker;
 //      the operation is already "REPLICATING" (and thus we don't need to
 //      trigger replication ourself later on).
 //
-//  2 - ExecuteAsync() is called. This submits PrepareAndStartTask() to prepare_pool_
-//      and returns immediately.
+//  2 - ExecuteAsync() is called. This submits PrepareAndStartTask() to
+//      prepare_pool_token_ and returns immediately.
 //
 //  3 - PrepareAndStartTask() calls Prepare() and Start() on the transaction.
 //
@@ -63,6 +65,11 @@ class TransactionTracker;
 //      also triggers consensus->Replicate() and changes the replication state to
 //      REPLICATING.
 //
+//      Leader transactions may be prepared concurrently with each other if
+//      prepare_pool_token_ is a CONCURRENT token. Their Start() and Replicate()
+//      then run under 'start_replicate_lock', so that timestamps are still
+//      assigned in the same order as consensus assigns OpIds.
+//
 //      On the other hand, if we have already successfully replicated (eg we are the
 //      follower and ConsensusCommitted() has already been called, then we can move
 //      on to ApplyAsync().
@@ -186,9 +193,10 @@ class TransactionDriver : public RefCountedThreadSafe<TransactionDriver> {
   TransactionDriver(TransactionTracker* txn_tracker,
                     consensus::Consensus* consensus,
                     log::Log* log,
-                    ThreadPool* prepare_pool,
+                    ThreadPoolToken* prepare_pool_token,
                     ThreadPool* apply_pool,
-                    TransactionOrderVerifier* order_verifier);
+                    TransactionOrderVerifier* order_verifier,
+                    std::mutex* start_replicate_lock);
 
   // Perform any non-constructor initialization. Sets the transaction
   // that will be executed.
@@ -228,6 +236,9 @@ class TransactionDriver : public RefCountedThreadSafe<TransactionDriver> {
   // Returns the type of the transaction being executed by this driver.
   Transaction::TransactionType tx_type() const;
 
+  // Returns whether this driver executes a leader or a replica transaction.
+  consensus::DriverType driver_type() const;
+
   // Returns the state of the transaction being executed by this driver.
   const TransactionState* state() const;
 
@@ -308,9 +319,10 @@ class TransactionDriver : public RefCountedThreadSafe<TransactionDriver> {
   TransactionTracker* const txn_tracker_;
   consensus::Consensus* const consensus_;
   log::Log* const log_;
-  ThreadPool* const prepare_pool_;
+  ThreadPoolToken* const prepare_pool_token_;
   ThreadPool* const apply_pool_;
   TransactionOrderVerifier* const order_verifier_;
+  std::mutex* const start_replicate_lock_;
 
   Status transaction_status_;
 
@@ -82,7 +82,8 @@ TransactionTracker::State::State()
   : memory_footprint(0) {
 }
 
-TransactionTracker::TransactionTracker() {
+TransactionTracker::TransactionTracker()
+    : num_pending_replica_txns_(0) {
 }
 
 TransactionTracker::~TransactionTracker() {
@@ -94,7 +95,7 @@ TransactionTracker::~TransactionTracker() {
 }
 
 Status TransactionTracker::Add(TransactionDriver* driver) {
-  int64_t driver_mem_footprint = driver->state()->request()->SpaceUsed();
+  int64_t driver_mem_footprint = driver->state()->RequestSpaceUsed();
   if (mem_tracker_ && !mem_tracker_->TryConsume(driver_mem_footprint)) {
     if (metrics_) {
       metrics_->transaction_memory_pressure_rejections->Increment();
@@ -122,6 +123,9 @@ Status TransactionTracker::Add(TransactionDriver* driver) {
   st.memory_footprint = driver_mem_footprint;
   std::lock_guard<simple_spinlock> l(lock_);
   InsertOrDie(&pending_txns_, driver, st);
+  if (driver->driver_type() == consensus::REPLICA) {
+    num_pending_replica_txns_++;
+  }
   return Status::OK();
 }
 
@@ -173,6 +177,10 @@ void TransactionTracker::Release(TransactionDriver* driver) {
       LOG(FATAL) << "Could not remove pending transaction from map: "
           << driver->ToStringUnlocked();
     }
+    if (driver->driver_type() == consensus::REPLICA) {
+      DCHECK_GT(num_pending_replica_txns_, 0);
+      num_pending_replica_txns_--;
+    }
   }
 
   if (mem_tracker_) {
@@ -195,6 +203,11 @@ int TransactionTracker::GetNumPendingForTests() const {
   return pending_txns_.size();
 }
 
+int TransactionTracker::GetNumPendingReplicaTransactions() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return num_pending_replica_txns_;
+}
+
 void TransactionTracker::WaitForAllToFinish() const {
   // Wait indefinitely.
   CHECK_OK(WaitForAllToFinish(MonoDelta::FromNanoseconds(std::numeric_limits<int64_t>::max())));
@@ -63,6 +63,9 @@ class TransactionTracker {
   // Returns number of pending transactions.
   int GetNumPendingForTests() const;
 
+  // Returns the number of pending REPLICA transactions.
+  int GetNumPendingReplicaTransactions() const;
+
   void WaitForAllToFinish() const;
   Status WaitForAllToFinish(const MonoDelta& timeout) const;
 
@@ -103,6 +106,9 @@ class TransactionTracker {
       ScopedRefPtrEqualToFunctor<TransactionDriver> > TxnMap;
   TxnMap pending_txns_;
 
+  // The number of REPLICA transactions in 'pending_txns_'. Protected by 'lock_'.
+  int num_pending_replica_txns_;
+
   gscoped_ptr<Metrics> metrics_;
 
   std::shared_ptr<MemTracker> mem_tracker_;
@@ -64,7 +64,19 @@ WriteTransaction::WriteTransaction(unique_ptr<WriteTransactionState> state, Driv
 void WriteTransaction::NewReplicateMsg(gscoped_ptr<ReplicateMsg>* replicate_msg) {
   replicate_msg->reset(new ReplicateMsg);
   (*replicate_msg)->set_op_type(WRITE_OP);
-  (*replicate_msg)->mutable_write_request()->CopyFrom(*state()->request());
+  WriteRequestPB* write = (*replicate_msg)->mutable_write_request();
+  write->CopyFrom(*state()->request());
+  if (state()->rows_from_sidecars()) {
+    // Replicas and the WAL get the rows in the request itself. This is the
+    // only copy made of them on the leader.
+    write->clear_rows_sidecar();
+    write->clear_indirect_data_sidecar();
+    Slice rows = state()->encoded_rows();
+    Slice indirect_data = state()->encoded_indirect_data();
+    RowOperationsPB* ops = write->mutable_row_operations();
+    ops->set_rows(rows.data(), rows.size());
+    ops->set_indirect_data(indirect_data.data(), indirect_data.size());
+  }
   if (state()->are_results_tracked()) {
     (*replicate_msg)->mutable_request_id()->CopyFrom(state()->request_id());
   }
@@ -73,6 +85,13 @@ void WriteTransaction::NewReplicateMsg(gscoped_ptr<ReplicateMsg>* replicate_msg)
 Status WriteTransaction::Prepare() {
   TRACE_EVENT0("txn", "WriteTransaction::Prepare");
   TRACE("PREPARE: Starting");
+  // Don't bother preparing and replicating a write the client gave up on.
+  if (type() == consensus::LEADER && MonoTime::Now() > state_->client_deadline()) {
+    Status s = Status::TimedOut("Client deadline expired before the write was prepared");
+    state_->completion_callback()->set_error(s);
+    return s;
+  }
+
   // Decode everything first so that we give up if something major is wrong.
   Schema client_schema;
   RETURN_NOT_OK_PREPEND(SchemaFromPB(state_->request()->schema(), &client_schema),
@@ -209,6 +228,8 @@ WriteTransactionState::WriteTransactionState(TabletPeer* tablet_peer,
   : TransactionState(tablet_peer),
     request_(DCHECK_NOTNULL(request)),
     response_(response),
+    rows_from_sidecars_(false),
+    client_deadline_(MonoTime::Max()),
     mvcc_tx_(nullptr),
     schema_at_decode_time_(nullptr) {
   external_consistency_mode_ = request_->external_consistency_mode();
@@ -220,6 +241,30 @@ WriteTransactionState::WriteTransactionState(TabletPeer* tablet_peer,
   }
 }
 
+int64_t WriteTransactionState::RequestSpaceUsed() const {
+  return request_->SpaceUsed() + sidecar_rows_.size() + sidecar_indirect_data_.size();
+}
+
+void WriteTransactionState::SetRowsFromSidecars(const Slice& rows, const Slice& indirect_data) {
+  rows_from_sidecars_ = true;
+  sidecar_rows_ = rows;
+  sidecar_indirect_data_ = indirect_data;
+}
+
+Slice WriteTransactionState::encoded_rows() const {
+  if (rows_from_sidecars_) {
+    return sidecar_rows_;
+  }
+  return request_->row_operations().rows();
+}
+
+Slice WriteTransactionState::encoded_indirect_data() const {
+  if (rows_from_sidecars_) {
+    return sidecar_indirect_data_;
+  }
+  return request_->row_operations().indirect_data();
+}
+
 void WriteTransactionState::SetMvccTxAndTimestamp(gscoped_ptr<ScopedTransaction> mvcc_tx) {
   DCHECK(!mvcc_tx_) << "Mvcc transaction already started/set.";
   if (has_timestamp()) {
@@ -298,6 +343,7 @@ void WriteTransactionState::UpdateMetricsForOp(const RowOp& op) {
       tx_metrics_.successful_upserts++;
       break;
     case RowOperationsPB::UPDATE:
+    case RowOperationsPB::INCREMENT:
       tx_metrics_.successful_updates++;
       break;
     case RowOperationsPB::DELETE:
@@ -337,6 +383,9 @@ void WriteTransactionState::ResetRpcFields() {
   std::lock_guard<simple_spinlock> l(txn_state_lock_);
   request_ = nullptr;
   response_ = nullptr;
+  rows_from_sidecars_ = false;
+  sidecar_rows_.clear();
+  sidecar_indirect_data_.clear();
   STLDeleteElements(&row_ops_);
 }
 
@@ -29,6 +29,8 @@
 #include "kudu/tablet/tablet.pb.h"
 #include "kudu/tablet/transactions/transaction.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/slice.h"
 
 namespace kudu {
 struct DecodedRowOperation;
@@ -99,6 +101,37 @@ class WriteTransactionState : public TransactionState {
     return response_;
   }
 
+  int64_t RequestSpaceUsed() const OVERRIDE;
+
+  // Sets the encoded rows and indirect data of a request which carried them
+  // in RPC sidecars rather than in its 'row_operations'. The data must remain
+  // valid until the transaction completes, which it does since it's held by
+  // the same RPC as the request.
+  void SetRowsFromSidecars(const Slice& rows, const Slice& indirect_data);
+
+  // Whether the request's rows were set with SetRowsFromSidecars().
+  bool rows_from_sidecars() const {
+    return rows_from_sidecars_;
+  }
+
+  // Returns the encoded rows of the request's operations, and their indirect
+  // data, wherever they were received.
+  Slice encoded_rows() const;
+  Slice encoded_indirect_data() const;
+
+  // Set the deadline of the client which submitted this write. If the
+  // deadline has already passed when the leader prepares the transaction,
+  // the write is failed without being replicated, since nobody is waiting
+  // for its result.
+  void set_client_deadline(const MonoTime& deadline) {
+    client_deadline_ = deadline;
+  }
+
+  // Returns the client deadline, or MonoTime::Max() if none was set.
+  const MonoTime& client_deadline() const {
+    return client_deadline_;
+  }
+
   // Set the MVCC transaction associated with this Write operation.
   // This must be called exactly once, during the PREPARE phase just
   // after the MvccManager has assigned a timestamp.
@@ -196,6 +229,15 @@ class WriteTransactionState : public TransactionState {
   const tserver::WriteRequestPB* request_;
   tserver::WriteResponsePB* response_;
 
+  // The request's encoded rows and indirect data, if they were received in
+  // RPC sidecars. Point into the RPC's buffers.
+  bool rows_from_sidecars_;
+  Slice sidecar_rows_;
+  Slice sidecar_indirect_data_;
+
+  // The deadline of the client, see set_client_deadline().
+  MonoTime client_deadline_;
+
   // The row operations which are decoded from the request during PREPARE
   // Protected by superclass's txn_state_lock_.
   std::vector<RowOp*> row_ops_;
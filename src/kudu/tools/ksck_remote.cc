@@ -28,6 +28,10 @@
 #include "kudu/util/net/sockaddr.h"
 
 DEFINE_bool(checksum_cache_blocks, false, "Should the checksum scanners cache the read blocks");
+DEFINE_bool(checksum_whole_tablets, true,
+            "Whether snapshot checksums ask the tablet servers to checksum each tablet in "
+            "a single round trip, which reuses the checksums cached for the rowsets that "
+            "haven't been mutated. Progress is then only reported once per tablet.");
 DEFINE_int64(timeout_ms, 1000 * 60, "RPC timeout in milliseconds");
 
 namespace kudu {
@@ -203,6 +207,11 @@ class ChecksumStepper {
           req_.mutable_new_request()->set_snap_timestamp(options_.snapshot_timestamp);
         }
         rpc_.set_timeout(GetDefaultTimeout());
+        if (options_.use_snapshot && FLAGS_checksum_whole_tablets) {
+          // The server may take as long as the whole checksum to respond.
+          req_.set_checksum_whole_tablet(true);
+          rpc_.set_timeout(options_.timeout);
+        }
         break;
       }
       case kContinueRequest: {
@@ -43,6 +43,8 @@
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/integration-tests/mini_cluster.h"
+#include "kudu/master/mini_master.h"
 #include "kudu/tablet/local_tablet_writer.h"
 #include "kudu/tablet/tablet-harness.h"
 #include "kudu/tablet/tablet_metadata.h"
@@ -183,6 +185,7 @@ TEST_F(ToolTest, TestTopLevelHelp) {
       "local_replica.*Kudu replicas",
       "master.*Kudu Master",
       "pbc.*protobuf container",
+      "perf.*performance of a Kudu cluster",
       "remote_replica.*replicas on a Kudu Tablet Server",
       "table.*Kudu tables",
       "tablet.*Kudu tablets",
@@ -260,6 +263,13 @@ TEST_F(ToolTest, TestModeHelp) {
     };
     NO_FATALS(RunTestHelp("pbc", kPbcModeRegexes));
   }
+  {
+    const vector<string> kPerfModeRegexes = {
+        "loadgen.*insert or upsert workload",
+        "scan.*Scan a table in parallel"
+    };
+    NO_FATALS(RunTestHelp("perf", kPerfModeRegexes));
+  }
   {
     const vector<string> kRemoteReplicaModeRegexes = {
         "check.*Check if all replicas",
@@ -317,6 +327,48 @@ TEST_F(ToolTest, TestActionHelp) {
       Status::InvalidArgument("too many arguments: 'extra_arg'")));
 }
 
+// Test that loadgen writes the requested rows, and that scans find them.
+TEST_F(ToolTest, TestPerfLoadgenAndScan) {
+  MiniCluster cluster(env_.get(), MiniClusterOptions());
+  ASSERT_OK(cluster.Start());
+  string master_addr = cluster.mini_master()->bound_rpc_addr_str();
+
+  vector<string> lines;
+  NO_FATALS(RunActionStdoutLines(Substitute(
+      "perf loadgen $0 --num_threads=2 --num_rows_per_thread=100 --batch_size=10 "
+      "--flush_mode=MANUAL_FLUSH --keep_auto_table", master_addr), &lines));
+  ASSERT_EQ(3, lines.size());
+  const string kTablePrefix = "Using auto-created table ";
+  ASSERT_EQ(0, lines[0].find(kTablePrefix));
+  string table_name = lines[0].substr(kTablePrefix.size());
+  ASSERT_STR_CONTAINS(lines[1], "Inserted 200 rows");
+  ASSERT_STR_CONTAINS(lines[1], "0 errors");
+  ASSERT_STR_CONTAINS(lines[2], "Batch latency (us): count=20");
+
+  // Sequential keys are written again by upserts, but not by inserts.
+  NO_FATALS(RunActionStdoutLines(Substitute(
+      "perf loadgen $0 --num_threads=2 --num_rows_per_thread=100 --table_name=$1 --upsert",
+      master_addr, table_name), &lines));
+  ASSERT_STR_CONTAINS(lines[0], "Upserted 200 rows");
+  Status s = RunTool(Substitute("perf loadgen $0 --num_threads=1 --num_rows_per_thread=10 "
+                                "--table_name=$1", master_addr, table_name),
+                     nullptr, nullptr, nullptr, nullptr);
+  ASSERT_TRUE(s.IsRuntimeError()) << s.ToString();
+
+  NO_FATALS(RunActionStdoutLines(Substitute("perf scan $0 $1 --num_threads=3",
+                                            master_addr, table_name), &lines));
+  ASSERT_STR_CONTAINS(lines[0], "Scanned 200 rows");
+  NO_FATALS(RunActionStdoutLines(Substitute(
+      "perf scan $0 $1 --columns=key --predicates=key>=50,key<60 --replica_selection=LEADER_ONLY",
+      master_addr, table_name), &lines));
+  ASSERT_STR_CONTAINS(lines[0], "Scanned 10 rows");
+
+  s = RunTool(Substitute("perf scan $0 $1 --predicates=no_such_column=1",
+                         master_addr, table_name),
+              nullptr, nullptr, nullptr, nullptr);
+  ASSERT_FALSE(s.ok());
+}
+
 TEST_F(ToolTest, TestFsFormat) {
   const string kTestDir = GetTestPath("test");
   NO_FATALS(RunActionStdoutNone(Substitute("fs format --fs_wal_dir=$0", kTestDir)));
@@ -579,7 +631,7 @@ TEST_F(ToolTest, TestLocalReplicaDumpMeta) {
   scoped_refptr<TabletMetadata> meta;
   TabletMetadata::CreateNew(&fs, kTestTablet, kTestTableName, kTestTableId,
                   kSchemaWithIds, partition.first, partition.second,
-                  tablet::TABLET_DATA_READY, &meta);
+                  CompactionPolicyPB(), tablet::TABLET_DATA_READY, &meta);
   string stdout;
   NO_FATALS(RunActionStdoutString(Substitute("local_replica dump meta $0 "
                                              "--fs_wal_dir=$1 "
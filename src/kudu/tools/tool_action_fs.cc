@@ -125,6 +125,7 @@ static unique_ptr<Mode> BuildFsDumpMode() {
       .Description("Dump the contents of a CFile (column file)")
       .AddRequiredParameter({ "block_id", "block identifier" })
       .AddOptionalParameter("fs_wal_dir")
+      .AddOptionalParameter("fs_extra_wal_dirs")
       .AddOptionalParameter("fs_data_dirs")
       .AddOptionalParameter("print_meta")
       .AddOptionalParameter("print_rows")
@@ -134,6 +135,7 @@ static unique_ptr<Mode> BuildFsDumpMode() {
       ActionBuilder("tree", &DumpFsTree)
       .Description("Dump the tree of a Kudu filesystem")
       .AddOptionalParameter("fs_wal_dir")
+      .AddOptionalParameter("fs_extra_wal_dirs")
       .AddOptionalParameter("fs_data_dirs")
       .Build();
 
@@ -141,6 +143,7 @@ static unique_ptr<Mode> BuildFsDumpMode() {
       ActionBuilder("uuid", &DumpUuid)
       .Description("Dump the UUID of a Kudu filesystem")
       .AddOptionalParameter("fs_wal_dir")
+      .AddOptionalParameter("fs_extra_wal_dirs")
       .AddOptionalParameter("fs_data_dirs")
       .Build();
 
@@ -157,6 +160,7 @@ unique_ptr<Mode> BuildFsMode() {
       ActionBuilder("format", &Format)
       .Description("Format a new Kudu filesystem")
       .AddOptionalParameter("fs_wal_dir")
+      .AddOptionalParameter("fs_extra_wal_dirs")
       .AddOptionalParameter("fs_data_dirs")
       .AddOptionalParameter("uuid")
       .Build();
@@ -259,6 +259,14 @@ Status DumpWals(const RunnerContext& context) {
   RETURN_NOT_OK(FsInit(&fs_manager));
   string tablet_id = FindOrDie(context.required_args, "tablet_id");
 
+  // Loading the tablet's metadata locates its WAL, which may be on any of the
+  // WAL roots.
+  scoped_refptr<TabletMetadata> meta;
+  Status s = TabletMetadata::Load(fs_manager.get(), tablet_id, &meta);
+  if (!s.ok() && !s.IsNotFound()) {
+    return s;
+  }
+
   shared_ptr<LogReader> reader;
   RETURN_NOT_OK(LogReader::Open(fs_manager.get(),
                                 scoped_refptr<LogIndex>(),
@@ -616,6 +624,7 @@ unique_ptr<Mode> BuildDumpMode() {
       .Description("Dump the IDs of all blocks belonging to a local replica")
       .AddRequiredParameter({ "tablet_id", "tablet identifier" })
       .AddOptionalParameter("fs_wal_dir")
+      .AddOptionalParameter("fs_extra_wal_dirs")
       .AddOptionalParameter("fs_data_dirs")
       .Build();
 
@@ -624,6 +633,7 @@ unique_ptr<Mode> BuildDumpMode() {
       .Description("Dump the metadata of a local replica")
       .AddRequiredParameter({ "tablet_id", "tablet identifier" })
       .AddOptionalParameter("fs_wal_dir")
+      .AddOptionalParameter("fs_extra_wal_dirs")
       .AddOptionalParameter("fs_data_dirs")
       .Build();
 
@@ -632,6 +642,7 @@ unique_ptr<Mode> BuildDumpMode() {
       .Description("Dump the rowset contents of a local replica")
       .AddRequiredParameter({ "tablet_id", "tablet identifier" })
       .AddOptionalParameter("fs_wal_dir")
+      .AddOptionalParameter("fs_extra_wal_dirs")
       .AddOptionalParameter("fs_data_dirs")
       .AddOptionalParameter("metadata_only")
       .AddOptionalParameter("nrows")
@@ -645,6 +656,7 @@ unique_ptr<Mode> BuildDumpMode() {
         "a local replica")
       .AddRequiredParameter({ "tablet_id", "Tablet identifier" })
       .AddOptionalParameter("fs_wal_dir")
+      .AddOptionalParameter("fs_extra_wal_dirs")
       .AddOptionalParameter("fs_data_dirs")
       .AddOptionalParameter("print_entries")
       .AddOptionalParameter("print_meta")
@@ -669,6 +681,7 @@ unique_ptr<Mode> BuildLocalReplicaMode() {
         "tablet's Raft configuration")
       .AddRequiredParameter({ "tablet_id", "Tablet identifier" })
       .AddOptionalParameter("fs_wal_dir")
+      .AddOptionalParameter("fs_extra_wal_dirs")
       .AddOptionalParameter("fs_data_dirs")
       .Build();
 
@@ -680,6 +693,7 @@ unique_ptr<Mode> BuildLocalReplicaMode() {
         "peers", "List of peers where each peer is of "
         "form 'uuid:hostname:port'" })
       .AddOptionalParameter("fs_wal_dir")
+      .AddOptionalParameter("fs_extra_wal_dirs")
       .AddOptionalParameter("fs_data_dirs")
       .Build();
 
@@ -698,6 +712,7 @@ unique_ptr<Mode> BuildLocalReplicaMode() {
       .AddRequiredParameter({ "source", "Source RPC address of "
         "form hostname:port" })
       .AddOptionalParameter("fs_wal_dir")
+      .AddOptionalParameter("fs_extra_wal_dirs")
       .AddOptionalParameter("fs_data_dirs")
       .Build();
 
@@ -705,6 +720,7 @@ unique_ptr<Mode> BuildLocalReplicaMode() {
       ActionBuilder("list", &ListLocalReplicas)
       .Description("Show list of Kudu replicas in the local filesystem")
       .AddOptionalParameter("fs_wal_dir")
+      .AddOptionalParameter("fs_extra_wal_dirs")
       .AddOptionalParameter("fs_data_dirs")
       .AddOptionalParameter("verbose")
       .Build();
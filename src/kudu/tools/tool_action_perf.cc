@@ -0,0 +1,893 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tools/tool_action.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gflags/gflags.h>
+
+#include "kudu/client/client.h"
+#include "kudu/client/client.pb.h"
+#include "kudu/common/partial_row.h"
+#include "kudu/common/wire_protocol.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/rpc_controller.h"
+#include "kudu/tools/data_gen_util.h"
+#include "kudu/tools/tool_action_common.h"
+#include "kudu/tserver/request_capture.h"
+#include "kudu/tserver/tablet_server.h"
+#include "kudu/tserver/tserver.pb.h"
+#include "kudu/tserver/tserver_service.proxy.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/env.h"
+#include "kudu/util/hdr_histogram.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/oid_generator.h"
+#include "kudu/util/pb_util.h"
+#include "kudu/util/random.h"
+#include "kudu/util/random_util.h"
+#include "kudu/util/status.h"
+#include "kudu/util/thread.h"
+
+DEFINE_int32(num_threads, 2,
+             "Number of threads writing or scanning in parallel.");
+DEFINE_int64(num_rows_per_thread, 100000,
+             "Number of rows each loadgen thread writes.");
+DEFINE_string(key_distribution, "sequential",
+              "How loadgen picks the keys of the rows: 'sequential', for "
+              "disjoint ascending keys per thread, or 'random', for uniformly "
+              "distributed keys.");
+DEFINE_int32(string_len, 32,
+             "Length of the values loadgen writes to non-key string and binary "
+             "columns, which sets the width of the rows.");
+DEFINE_string(flush_mode, "AUTO_FLUSH_BACKGROUND",
+              "Flush mode of the loadgen sessions: 'AUTO_FLUSH_BACKGROUND' or "
+              "'MANUAL_FLUSH'.");
+DEFINE_int32(batch_size, 1000,
+             "Number of rows loadgen applies between flushes, and over which "
+             "its write latency is measured.");
+DEFINE_bool(upsert, false,
+            "Whether loadgen upserts rows rather than inserting them.");
+DEFINE_string(table_name, "",
+              "Name of an existing table for loadgen to write to. If empty, "
+              "loadgen creates a table and deletes it when it's done, unless "
+              "--keep_auto_table is set.");
+DEFINE_bool(keep_auto_table, false,
+            "Whether loadgen keeps the table it created.");
+DEFINE_int32(table_num_replicas, 1,
+             "Replication factor of the table created by loadgen.");
+DEFINE_int32(table_num_hash_buckets, 8,
+             "Number of hash partitions of the table created by loadgen.");
+DEFINE_string(columns, "",
+              "Comma-separated list of the columns to scan. If empty, all "
+              "columns are scanned.");
+DEFINE_string(predicates, "",
+              "Comma-separated list of predicates of the scan, each of the form "
+              "<column><op><value> where <op> is one of <, <=, =, >= and >, "
+              "e.g. 'key>=100,key<200'.");
+DEFINE_string(replica_selection, "CLOSEST_REPLICA",
+              "Replicas to scan: 'LEADER_ONLY', 'CLOSEST_REPLICA' or "
+              "'FIRST_REPLICA'.");
+DEFINE_double(replay_speed, 1,
+              "Pace at which the captured requests are re-issued, relative to the "
+              "pace at which they were received: 2 replays them twice as fast. "
+              "0 replays them as fast as possible.");
+
+DECLARE_int64(timeout_ms);
+
+namespace kudu {
+namespace tools {
+
+using client::KuduClient;
+using client::KuduClientBuilder;
+using client::KuduColumnSchema;
+using client::KuduError;
+using client::KuduPredicate;
+using client::KuduReplica;
+using client::KuduScanBatch;
+using client::KuduScanToken;
+using client::KuduScanTokenBuilder;
+using client::KuduScanner;
+using client::KuduSchema;
+using client::KuduSchemaBuilder;
+using client::KuduSession;
+using client::KuduTable;
+using client::KuduTableCreator;
+using client::KuduValue;
+using client::KuduWriteOperation;
+using client::ScanTokenPB;
+using client::sp::shared_ptr;
+using rpc::RpcController;
+using tserver::CapturedRequestPB;
+using tserver::RequestCapture;
+using tserver::ScanRequestPB;
+using tserver::ScanResponsePB;
+using tserver::TabletServerServiceProxy;
+using tserver::WriteRequestPB;
+using tserver::WriteResponsePB;
+using std::cout;
+using std::endl;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace {
+
+const char* const kMasterAddressesArg = "master_addresses";
+const char* const kCaptureDirArg = "capture_dir";
+const char* const kTableNameArg = "table_name";
+const char* const kMasterAddressesArgDesc =
+    "Comma-separated list of Kudu Master addresses where each address is "
+    "of form 'hostname:port'";
+
+// Latencies are tracked in microseconds, up to a minute.
+const uint64_t kMaxLatencyUs = 60 * 1000 * 1000;
+const int kLatencySignificantDigits = 2;
+
+// The results of the threads of a perf action.
+struct PerfResults {
+  PerfResults() : latency_us(kMaxLatencyUs, kLatencySignificantDigits) {}
+
+  // Merges the results of a thread.
+  void Merge(int64_t thread_rows, int64_t thread_errors,
+             const HdrHistogram& thread_latency_us, const Status& s) {
+    std::lock_guard<simple_spinlock> l(lock);
+    rows += thread_rows;
+    errors += thread_errors;
+    latency_us.MergeFrom(thread_latency_us);
+    if (status.ok()) {
+      status = s;
+    }
+  }
+
+  simple_spinlock lock;
+  int64_t rows = 0;
+  int64_t errors = 0;
+  HdrHistogram latency_us;
+  Status status;
+};
+
+void PrintResults(const string& verb, const PerfResults& results, const MonoDelta& elapsed,
+                  const string& latency_desc) {
+  double secs = elapsed.ToSeconds();
+  cout << Substitute("$0 $1 rows in $2 seconds ($3 rows/sec), $4 errors",
+                     verb, results.rows, secs,
+                     secs > 0 ? static_cast<int64_t>(results.rows / secs) : 0,
+                     results.errors) << endl;
+  const HdrHistogram& h = results.latency_us;
+  if (h.TotalCount() == 0) {
+    return;
+  }
+  cout << Substitute("$0 latency (us): count=$1 mean=$2 min=$3 p50=$4 p95=$5 "
+                     "p99=$6 p99.9=$7 max=$8",
+                     latency_desc, h.TotalCount(), static_cast<int64_t>(h.MeanValue()),
+                     h.MinValue(), h.ValueAtPercentile(50), h.ValueAtPercentile(95),
+                     h.ValueAtPercentile(99), h.ValueAtPercentile(99.9), h.MaxValue())
+       << endl;
+}
+
+Status BuildClient(const RunnerContext& context, shared_ptr<KuduClient>* client) {
+  vector<string> master_addresses = strings::Split(
+      FindOrDie(context.required_args, kMasterAddressesArg), ",");
+  return KuduClientBuilder()
+      .master_server_addrs(master_addresses)
+      .Build(client);
+}
+
+// Sets the value of each column of 'row': key columns get 'key', non-key
+// string and binary columns get a string of --string_len bytes, and the
+// other columns get random values.
+Status GenerateRow(const KuduSchema& schema, uint64_t key, Random* rng,
+                   string* buf, KuduPartialRow* row) {
+  vector<int> key_indexes;
+  schema.GetPrimaryKeyColumnIndexes(&key_indexes);
+  for (int i = 0; i < schema.num_columns(); i++) {
+    if (i < key_indexes.size()) {
+      WriteValueToColumn(schema, i, key, row);
+      continue;
+    }
+    KuduColumnSchema::DataType type = schema.Column(i).type();
+    if (type == KuduColumnSchema::STRING || type == KuduColumnSchema::BINARY) {
+      buf->assign(FLAGS_string_len, 'x');
+      for (int j = 0; j < buf->size() && j < 8; j++) {
+        (*buf)[j] = 'a' + rng->Uniform(26);
+      }
+      RETURN_NOT_OK(type == KuduColumnSchema::STRING ? row->SetStringCopy(i, *buf)
+                                                     : row->SetBinaryCopy(i, *buf));
+    } else {
+      WriteValueToColumn(schema, i, rng->Next64(), row);
+    }
+  }
+  return Status::OK();
+}
+
+// Counts and drops the pending errors of 'session'.
+int64_t CountErrors(KuduSession* session) {
+  vector<KuduError*> errors;
+  ElementDeleter d(&errors);
+  bool overflow;
+  session->GetPendingErrors(&errors, &overflow);
+  if (!errors.empty()) {
+    VLOG(1) << "Write error: " << errors[0]->status().ToString();
+  }
+  return errors.size();
+}
+
+void LoadgenThread(const shared_ptr<KuduClient>& client, const shared_ptr<KuduTable>& table,
+                   int thread_idx, PerfResults* results) {
+  HdrHistogram latency_us(kMaxLatencyUs, kLatencySignificantDigits);
+  int64_t rows = 0;
+  int64_t errors = 0;
+  Status s = [&] () -> Status {
+    shared_ptr<KuduSession> session = client->NewSession();
+    session->SetTimeoutMillis(60 * 1000);
+    RETURN_NOT_OK(session->SetFlushMode(FLAGS_flush_mode == "MANUAL_FLUSH" ?
+                                        KuduSession::MANUAL_FLUSH :
+                                        KuduSession::AUTO_FLUSH_BACKGROUND));
+    Random rng(GetRandomSeed32() + thread_idx);
+    const KuduSchema& schema = table->schema();
+    string buf;
+    uint64_t first_key = static_cast<uint64_t>(thread_idx) * FLAGS_num_rows_per_thread;
+    for (int64_t i = 0; i < FLAGS_num_rows_per_thread;) {
+      MonoTime start = MonoTime::Now();
+      int64_t batch_end = std::min<int64_t>(i + FLAGS_batch_size, FLAGS_num_rows_per_thread);
+      for (; i < batch_end; i++) {
+        unique_ptr<KuduWriteOperation> op(FLAGS_upsert ?
+                                          static_cast<KuduWriteOperation*>(table->NewUpsert()) :
+                                          table->NewInsert());
+        uint64_t key = FLAGS_key_distribution == "random" ? rng.Next64() : first_key + i;
+        RETURN_NOT_OK(GenerateRow(schema, key, &rng, &buf, op->mutable_row()));
+        // Errors of individual rows are counted below.
+        WARN_NOT_OK(session->Apply(op.release()), "Unable to apply write");
+      }
+      if (FLAGS_flush_mode == "MANUAL_FLUSH") {
+        WARN_NOT_OK(session->Flush(), "Unable to flush writes");
+      }
+      latency_us.Increment((MonoTime::Now() - start).ToMicroseconds());
+      errors += CountErrors(session.get());
+      rows = i;
+    }
+    WARN_NOT_OK(session->Flush(), "Unable to flush writes");
+    errors += CountErrors(session.get());
+    return session->Close();
+  }();
+  results->Merge(rows - errors, errors, latency_us, s);
+}
+
+Status CreateLoadgenTable(const shared_ptr<KuduClient>& client, string* table_name) {
+  *table_name = "loadgen_auto_" + ObjectIdGenerator().Next();
+  KuduSchema schema;
+  KuduSchemaBuilder b;
+  b.AddColumn("key")->Type(KuduColumnSchema::INT64)->NotNull()->PrimaryKey();
+  b.AddColumn("int_val")->Type(KuduColumnSchema::INT64);
+  b.AddColumn("string_val")->Type(KuduColumnSchema::STRING);
+  RETURN_NOT_OK(b.Build(&schema));
+  unique_ptr<KuduTableCreator> creator(client->NewTableCreator());
+  creator->table_name(*table_name)
+      .schema(&schema)
+      .num_replicas(FLAGS_table_num_replicas);
+  if (FLAGS_table_num_hash_buckets > 1) {
+    creator->add_hash_partitions({ "key" }, FLAGS_table_num_hash_buckets);
+  } else {
+    creator->set_range_partition_columns({ "key" });
+  }
+  return creator->Create();
+}
+
+Status Loadgen(const RunnerContext& context) {
+  if (FLAGS_key_distribution != "sequential" && FLAGS_key_distribution != "random") {
+    return Status::InvalidArgument("unknown key distribution", FLAGS_key_distribution);
+  }
+  if (FLAGS_flush_mode != "AUTO_FLUSH_BACKGROUND" && FLAGS_flush_mode != "MANUAL_FLUSH") {
+    return Status::InvalidArgument("unknown flush mode", FLAGS_flush_mode);
+  }
+  if (FLAGS_num_threads <= 0 || FLAGS_batch_size <= 0) {
+    return Status::InvalidArgument("the number of threads and the batch size must be positive");
+  }
+
+  shared_ptr<KuduClient> client;
+  RETURN_NOT_OK(BuildClient(context, &client));
+  string table_name = FLAGS_table_name;
+  bool auto_table = table_name.empty();
+  if (auto_table) {
+    RETURN_NOT_OK_PREPEND(CreateLoadgenTable(client, &table_name),
+                          "unable to create the loadgen table");
+    cout << "Using auto-created table " << table_name << endl;
+  }
+  shared_ptr<KuduTable> table;
+  RETURN_NOT_OK(client->OpenTable(table_name, &table));
+
+  PerfResults results;
+  MonoTime start = MonoTime::Now();
+  vector<scoped_refptr<Thread>> threads;
+  for (int i = 0; i < FLAGS_num_threads; i++) {
+    scoped_refptr<Thread> thread;
+    RETURN_NOT_OK(Thread::Create("tool", Substitute("loadgen-$0", i),
+                                 &LoadgenThread, client, table, i, &results, &thread));
+    threads.emplace_back(std::move(thread));
+  }
+  for (const auto& thread : threads) {
+    thread->Join();
+  }
+  PrintResults(FLAGS_upsert ? "Upserted" : "Inserted", results, MonoTime::Now() - start,
+               "Batch");
+
+  if (auto_table && !FLAGS_keep_auto_table) {
+    RETURN_NOT_OK_PREPEND(client->DeleteTable(table_name),
+                          "unable to delete the loadgen table");
+  }
+  RETURN_NOT_OK(results.status);
+  if (results.errors > 0) {
+    return Status::RuntimeError(Substitute("$0 rows failed to be written", results.errors));
+  }
+  return Status::OK();
+}
+
+// Parses --predicates into predicates on the columns of 'table', appending
+// them to 'predicates'.
+Status ParsePredicates(const shared_ptr<KuduTable>& table, vector<KuduPredicate*>* predicates) {
+  // Two-character operators are matched first.
+  const vector<std::pair<string, KuduPredicate::ComparisonOp>> kOps = {
+    { "<=", KuduPredicate::LESS_EQUAL },
+    { ">=", KuduPredicate::GREATER_EQUAL },
+    { "=", KuduPredicate::EQUAL },
+    { "<", KuduPredicate::LESS },
+    { ">", KuduPredicate::GREATER },
+  };
+  const KuduSchema& schema = table->schema();
+  vector<string> predicate_strs = strings::Split(FLAGS_predicates, ",", strings::SkipEmpty());
+  for (const string& predicate : predicate_strs) {
+    size_t pos = string::npos;
+    const std::pair<string, KuduPredicate::ComparisonOp>* op = nullptr;
+    for (const auto& candidate : kOps) {
+      size_t p = predicate.find(candidate.first);
+      if (p != string::npos && (pos == string::npos || p < pos)) {
+        pos = p;
+        op = &candidate;
+      }
+    }
+    if (op == nullptr || pos == 0) {
+      return Status::InvalidArgument("unable to parse predicate", predicate);
+    }
+    string col_name = predicate.substr(0, pos);
+    string value_str = predicate.substr(pos + op->first.size());
+
+    int col_idx = -1;
+    for (int i = 0; i < schema.num_columns(); i++) {
+      if (schema.Column(i).name() == col_name) {
+        col_idx = i;
+        break;
+      }
+    }
+    if (col_idx < 0) {
+      return Status::NotFound("no such column", col_name);
+    }
+
+    KuduValue* value;
+    switch (schema.Column(col_idx).type()) {
+      case KuduColumnSchema::INT8:
+      case KuduColumnSchema::INT16:
+      case KuduColumnSchema::INT32:
+      case KuduColumnSchema::INT64:
+      case KuduColumnSchema::UNIXTIME_MICROS: {
+        int64_t v;
+        if (!safe_strto64(value_str, &v)) {
+          return Status::InvalidArgument("invalid integer value", predicate);
+        }
+        value = KuduValue::FromInt(v);
+        break;
+      }
+      case KuduColumnSchema::FLOAT:
+      case KuduColumnSchema::DOUBLE: {
+        double v;
+        if (!safe_strtod(value_str, &v)) {
+          return Status::InvalidArgument("invalid floating point value", predicate);
+        }
+        value = KuduValue::FromDouble(v);
+        break;
+      }
+      case KuduColumnSchema::BOOL: {
+        if (value_str != "true" && value_str != "false") {
+          return Status::InvalidArgument("invalid boolean value", predicate);
+        }
+        value = KuduValue::FromBool(value_str == "true");
+        break;
+      }
+      default:
+        value = KuduValue::CopyString(value_str);
+        break;
+    }
+    predicates->push_back(table->NewComparisonPredicate(col_name, op->second, value));
+  }
+  return Status::OK();
+}
+
+void ScanThread(const vector<KuduScanToken*>* tokens, AtomicInt<int32_t>* next_token,
+                PerfResults* results) {
+  HdrHistogram latency_us(kMaxLatencyUs, kLatencySignificantDigits);
+  int64_t rows = 0;
+  Status s = [&] () -> Status {
+    for (int i = next_token->Increment() - 1; i < tokens->size();
+         i = next_token->Increment() - 1) {
+      KuduScanner* scanner_ptr;
+      RETURN_NOT_OK((*tokens)[i]->IntoKuduScanner(&scanner_ptr));
+      unique_ptr<KuduScanner> scanner(scanner_ptr);
+      RETURN_NOT_OK(scanner->Open());
+      KuduScanBatch batch;
+      while (scanner->HasMoreRows()) {
+        MonoTime start = MonoTime::Now();
+        RETURN_NOT_OK(scanner->NextBatch(&batch));
+        latency_us.Increment((MonoTime::Now() - start).ToMicroseconds());
+        rows += batch.NumRows();
+      }
+    }
+    return Status::OK();
+  }();
+  results->Merge(rows, s.ok() ? 0 : 1, latency_us, s);
+}
+
+Status Scan(const RunnerContext& context) {
+  KuduClient::ReplicaSelection selection;
+  if (FLAGS_replica_selection == "LEADER_ONLY") {
+    selection = KuduClient::LEADER_ONLY;
+  } else if (FLAGS_replica_selection == "CLOSEST_REPLICA") {
+    selection = KuduClient::CLOSEST_REPLICA;
+  } else if (FLAGS_replica_selection == "FIRST_REPLICA") {
+    selection = KuduClient::FIRST_REPLICA;
+  } else {
+    return Status::InvalidArgument("unknown replica selection", FLAGS_replica_selection);
+  }
+  if (FLAGS_num_threads <= 0) {
+    return Status::InvalidArgument("the number of threads must be positive");
+  }
+
+  shared_ptr<KuduClient> client;
+  RETURN_NOT_OK(BuildClient(context, &client));
+  shared_ptr<KuduTable> table;
+  RETURN_NOT_OK(client->OpenTable(FindOrDie(context.required_args, kTableNameArg), &table));
+
+  KuduScanTokenBuilder builder(table.get());
+  RETURN_NOT_OK(builder.SetSelection(selection));
+  if (!FLAGS_columns.empty()) {
+    RETURN_NOT_OK(builder.SetProjectedColumnNames(
+        strings::Split(FLAGS_columns, ",", strings::SkipEmpty())));
+  }
+  vector<KuduPredicate*> predicates;
+  RETURN_NOT_OK(ParsePredicates(table, &predicates));
+  for (KuduPredicate* predicate : predicates) {
+    RETURN_NOT_OK(builder.AddConjunctPredicate(predicate));
+  }
+  vector<KuduScanToken*> tokens;
+  ElementDeleter d(&tokens);
+  RETURN_NOT_OK(builder.Build(&tokens));
+
+  // The threads scan the tablets in turn.
+  PerfResults results;
+  AtomicInt<int32_t> next_token(0);
+  MonoTime start = MonoTime::Now();
+  vector<scoped_refptr<Thread>> threads;
+  for (int i = 0; i < FLAGS_num_threads; i++) {
+    scoped_refptr<Thread> thread;
+    RETURN_NOT_OK(Thread::Create("tool", Substitute("scan-$0", i),
+                                 &ScanThread, &tokens, &next_token, &results, &thread));
+    threads.emplace_back(std::move(thread));
+  }
+  for (const auto& thread : threads) {
+    thread->Join();
+  }
+  PrintResults("Scanned", results, MonoTime::Now() - start, "Batch");
+  return results.status;
+}
+
+// Reads the records of the capture files in 'dir', ordered by the time
+// their requests were received.
+Status ReadCapture(const string& dir, vector<CapturedRequestPB>* records) {
+  Env* env = Env::Default();
+  vector<string> paths;
+  RETURN_NOT_OK(RequestCapture::ListFiles(env, dir, &paths));
+  if (paths.empty()) {
+    return Status::NotFound("no request capture files", dir);
+  }
+  for (const string& path : paths) {
+    gscoped_ptr<RandomAccessFile> file;
+    RETURN_NOT_OK(env->NewRandomAccessFile(path, &file));
+    pb_util::ReadablePBContainerFile reader(std::move(file));
+    RETURN_NOT_OK_PREPEND(reader.Open(), path);
+    while (true) {
+      CapturedRequestPB record;
+      Status s = reader.ReadNextPB(&record);
+      // The file being written by the server may end with a partial record.
+      if (s.IsEndOfFile() || s.IsIncomplete()) {
+        break;
+      }
+      RETURN_NOT_OK_PREPEND(s, path);
+      records->emplace_back(std::move(record));
+    }
+    RETURN_NOT_OK(reader.Close());
+  }
+  std::stable_sort(records->begin(), records->end(),
+                   [](const CapturedRequestPB& a, const CapturedRequestPB& b) {
+                     return a.received_unix_us() < b.received_unix_us();
+                   });
+  return Status::OK();
+}
+
+// A captured request, and the tablet of the target cluster to send it to.
+struct ReplayRequest {
+  const CapturedRequestPB* record;
+  string tablet_id;
+  TabletServerServiceProxy* proxy;
+};
+
+// The tablets of the target cluster's tables, which the captured requests
+// are sent to.
+class ReplayTargets {
+ public:
+  explicit ReplayTargets(shared_ptr<KuduClient> client) : client_(std::move(client)) {}
+
+  // Finds the tablet of the target cluster whose table and start partition
+  // key are those of the tablet 'record' was sent to, and the proxy to its
+  // leader. Returns NotFound if there's none.
+  Status Resolve(const CapturedRequestPB& record, ReplayRequest* request) {
+    if (!ContainsKey(loaded_tables_, record.table_name())) {
+      RETURN_NOT_OK(LoadTable(record.table_name()));
+    }
+    const Target* target = FindOrNull(targets_, std::make_pair(record.table_name(),
+                                                               record.partition_key_start()));
+    if (target == nullptr) {
+      return Status::NotFound("no matching tablet", record.table_name());
+    }
+    request->record = &record;
+    request->tablet_id = target->tablet_id;
+    request->proxy = target->proxy;
+    return Status::OK();
+  }
+
+ private:
+  struct Target {
+    string tablet_id;
+    TabletServerServiceProxy* proxy;
+  };
+
+  Status LoadTable(const string& table_name) {
+    loaded_tables_.insert(table_name);
+    shared_ptr<KuduTable> table;
+    Status s = client_->OpenTable(table_name, &table);
+    if (s.IsNotFound()) {
+      return Status::OK();
+    }
+    RETURN_NOT_OK(s);
+
+    // Without split keys, there's a token per tablet, which holds the
+    // partition of the tablet.
+    vector<KuduScanToken*> tokens;
+    ElementDeleter d(&tokens);
+    RETURN_NOT_OK(KuduScanTokenBuilder(table.get()).Build(&tokens));
+    for (const KuduScanToken* token : tokens) {
+      string buf;
+      RETURN_NOT_OK(token->Serialize(&buf));
+      ScanTokenPB pb;
+      if (!pb.ParseFromString(buf)) {
+        return Status::Corruption("unable to parse scan token");
+      }
+      const vector<const KuduReplica*>& replicas = token->tablet().replicas();
+      if (replicas.empty()) {
+        continue;
+      }
+      const KuduReplica* leader = replicas[0];
+      for (const KuduReplica* replica : replicas) {
+        if (replica->is_leader()) {
+          leader = replica;
+          break;
+        }
+      }
+      Target target;
+      target.tablet_id = token->tablet().id();
+      RETURN_NOT_OK(GetProxy(Substitute("$0:$1", leader->ts().hostname(), leader->ts().port()),
+                             &target.proxy));
+      targets_[std::make_pair(table_name, pb.lower_bound_partition_key())] = target;
+    }
+    return Status::OK();
+  }
+
+  Status GetProxy(const string& address, TabletServerServiceProxy** proxy) {
+    unique_ptr<TabletServerServiceProxy>& p = proxies_[address];
+    if (!p) {
+      RETURN_NOT_OK(BuildProxy(address, tserver::TabletServer::kDefaultPort, &p));
+    }
+    *proxy = p.get();
+    return Status::OK();
+  }
+
+  const shared_ptr<KuduClient> client_;
+  std::set<string> loaded_tables_;
+  std::map<std::pair<string, string>, Target> targets_;
+  std::map<string, unique_ptr<TabletServerServiceProxy>> proxies_;
+};
+
+// The latencies of the captured requests of a method, when they were
+// received and when they were replayed.
+struct ReplayMethodResults {
+  ReplayMethodResults()
+      : original_us(kMaxLatencyUs, kLatencySignificantDigits),
+        replayed_us(kMaxLatencyUs, kLatencySignificantDigits) {}
+
+  HdrHistogram original_us;
+  HdrHistogram replayed_us;
+  int64_t errors = 0;
+};
+
+struct ReplayResults {
+  simple_spinlock lock;
+  ReplayMethodResults writes;
+  ReplayMethodResults scans;
+  // How far behind the schedule set by --replay_speed the replay got.
+  int64_t max_lag_us = 0;
+};
+
+Status ReplayWrite(const ReplayRequest& request, const MonoDelta& timeout) {
+  WriteRequestPB req = request.record->write_request();
+  req.set_tablet_id(request.tablet_id);
+  // The timestamps of the captured cluster mean nothing to the target.
+  req.clear_propagated_timestamp();
+  WriteResponsePB resp;
+  RpcController rpc;
+  rpc.set_timeout(timeout);
+  RETURN_NOT_OK(request.proxy->Write(req, &resp, &rpc));
+  if (resp.has_error()) {
+    return StatusFromPB(resp.error().status());
+  }
+  // Rows failing, e.g. because replayed inserts find their rows already
+  // there, are part of the replayed workload.
+  return Status::OK();
+}
+
+// Opens the captured scan, returning the latency of that request in
+// 'latency', then drains it as its client would have.
+Status ReplayScan(const ReplayRequest& request, const MonoDelta& timeout, MonoDelta* latency) {
+  ScanRequestPB req = request.record->scan_request();
+  req.mutable_new_scan_request()->set_tablet_id(request.tablet_id);
+  req.mutable_new_scan_request()->clear_snap_timestamp();
+  req.mutable_new_scan_request()->clear_propagated_timestamp();
+  MonoTime start = MonoTime::Now();
+  for (uint32_t seq = 1; ; seq++) {
+    ScanResponsePB resp;
+    RpcController rpc;
+    rpc.set_timeout(timeout);
+    RETURN_NOT_OK(request.proxy->Scan(req, &resp, &rpc));
+    if (seq == 1) {
+      *latency = MonoTime::Now() - start;
+    }
+    if (resp.has_error()) {
+      return StatusFromPB(resp.error().status());
+    }
+    if (!resp.has_more_results()) {
+      return Status::OK();
+    }
+    uint32_t batch_size_bytes = req.batch_size_bytes();
+    req.Clear();
+    req.set_scanner_id(resp.scanner_id());
+    req.set_call_seq_id(seq);
+    if (batch_size_bytes > 0) {
+      req.set_batch_size_bytes(batch_size_bytes);
+    }
+  }
+}
+
+void ReplayThread(const vector<ReplayRequest>* requests, AtomicInt<int32_t>* next_request,
+                  MonoTime start, ReplayResults* results) {
+  const int64_t first_received_us = (*requests)[0].record->received_unix_us();
+  for (int i = next_request->Increment() - 1; i < requests->size();
+       i = next_request->Increment() - 1) {
+    const ReplayRequest& request = (*requests)[i];
+    const CapturedRequestPB& record = *request.record;
+    int64_t lag_us = 0;
+    if (FLAGS_replay_speed > 0) {
+      MonoTime due = start + MonoDelta::FromMicroseconds(
+          (record.received_unix_us() - first_received_us) / FLAGS_replay_speed);
+      MonoTime now = MonoTime::Now();
+      if (due > now) {
+        SleepFor(due - now);
+      } else {
+        lag_us = (now - due).ToMicroseconds();
+      }
+    }
+    MonoDelta timeout = MonoDelta::FromMilliseconds(
+        record.has_timeout_ms() ? record.timeout_ms() : FLAGS_timeout_ms);
+    MonoTime sent = MonoTime::Now();
+    MonoDelta latency;
+    Status s;
+    if (record.method() == CapturedRequestPB::WRITE) {
+      s = ReplayWrite(request, timeout);
+      latency = MonoTime::Now() - sent;
+    } else {
+      s = ReplayScan(request, timeout, &latency);
+    }
+    if (!latency.Initialized()) {
+      latency = MonoTime::Now() - sent;
+    }
+
+    std::lock_guard<simple_spinlock> l(results->lock);
+    ReplayMethodResults* method = record.method() == CapturedRequestPB::WRITE ?
+        &results->writes : &results->scans;
+    method->original_us.Increment(std::min<int64_t>(record.handler_time_us(), kMaxLatencyUs));
+    method->replayed_us.Increment(std::min<int64_t>(latency.ToMicroseconds(), kMaxLatencyUs));
+    if (!s.ok()) {
+      VLOG(1) << "Replayed request failed: " << s.ToString();
+      method->errors++;
+    }
+    results->max_lag_us = std::max(results->max_lag_us, lag_us);
+  }
+}
+
+void PrintReplayResults(const string& method, const ReplayMethodResults& results) {
+  if (results.original_us.TotalCount() == 0) {
+    return;
+  }
+  cout << Substitute("$0: $1 requests, $2 errors", method,
+                     results.original_us.TotalCount(), results.errors) << endl;
+  for (const auto& h : { std::make_pair("original", &results.original_us),
+                         std::make_pair("replayed", &results.replayed_us) }) {
+    cout << Substitute("  $0 latency (us): mean=$1 p50=$2 p95=$3 p99=$4 max=$5",
+                       h.first, static_cast<int64_t>(h.second->MeanValue()),
+                       h.second->ValueAtPercentile(50), h.second->ValueAtPercentile(95),
+                       h.second->ValueAtPercentile(99), h.second->MaxValue()) << endl;
+  }
+  for (double pct : { 50.0, 95.0, 99.0 }) {
+    int64_t original = results.original_us.ValueAtPercentile(pct);
+    int64_t replayed = results.replayed_us.ValueAtPercentile(pct);
+    cout << Substitute("  p$0 difference: $1 us ($2%)", pct, replayed - original,
+                       original > 0 ? (replayed - original) * 100 / original : 0) << endl;
+  }
+}
+
+Status Replay(const RunnerContext& context) {
+  if (FLAGS_num_threads <= 0) {
+    return Status::InvalidArgument("the number of threads must be positive");
+  }
+  if (FLAGS_replay_speed < 0) {
+    return Status::InvalidArgument("the replay speed must not be negative");
+  }
+  vector<CapturedRequestPB> records;
+  RETURN_NOT_OK(ReadCapture(FindOrDie(context.required_args, kCaptureDirArg), &records));
+
+  shared_ptr<KuduClient> client;
+  RETURN_NOT_OK(BuildClient(context, &client));
+  ReplayTargets targets(client);
+  vector<ReplayRequest> requests;
+  int64_t unmatched = 0;
+  for (const CapturedRequestPB& record : records) {
+    ReplayRequest request;
+    Status s = targets.Resolve(record, &request);
+    if (s.IsNotFound()) {
+      unmatched++;
+      continue;
+    }
+    RETURN_NOT_OK(s);
+    requests.push_back(request);
+  }
+  cout << Substitute("Replaying $0 of $1 captured requests; $2 were sent to tablets the "
+                     "target cluster doesn't have", requests.size(), records.size(), unmatched)
+       << endl;
+  if (requests.empty()) {
+    return Status::OK();
+  }
+
+  // Each thread issues the next request once it's due, so the requests are
+  // issued in order, but a slow request only delays the others once all the
+  // threads are busy.
+  ReplayResults results;
+  AtomicInt<int32_t> next_request(0);
+  MonoTime start = MonoTime::Now();
+  vector<scoped_refptr<Thread>> threads;
+  for (int i = 0; i < FLAGS_num_threads; i++) {
+    scoped_refptr<Thread> thread;
+    RETURN_NOT_OK(Thread::Create("tool", Substitute("replay-$0", i),
+                                 &ReplayThread, &requests, &next_request, start, &results,
+                                 &thread));
+    threads.emplace_back(std::move(thread));
+  }
+  for (const auto& thread : threads) {
+    thread->Join();
+  }
+  cout << Substitute("Replayed in $0 seconds, at most $1 ms behind schedule",
+                     (MonoTime::Now() - start).ToSeconds(), results.max_lag_us / 1000)
+       << endl;
+  PrintReplayResults("Writes", results.writes);
+  PrintReplayResults("Scans", results.scans);
+  return Status::OK();
+}
+
+} // anonymous namespace
+
+unique_ptr<Mode> BuildPerfMode() {
+  unique_ptr<Action> loadgen =
+      ActionBuilder("loadgen", &Loadgen)
+      .Description("Run a multi-threaded insert or upsert workload")
+      .ExtraDescription("Writes generated rows to a table, with each thread using "
+                        "its own session, then reports the write throughput and "
+                        "the latency of the batches of rows. By default, the rows "
+                        "are written to a table created for the purpose.")
+      .AddRequiredParameter({ kMasterAddressesArg, kMasterAddressesArgDesc })
+      .AddOptionalParameter("batch_size")
+      .AddOptionalParameter("flush_mode")
+      .AddOptionalParameter("keep_auto_table")
+      .AddOptionalParameter("key_distribution")
+      .AddOptionalParameter("num_rows_per_thread")
+      .AddOptionalParameter("num_threads")
+      .AddOptionalParameter("string_len")
+      .AddOptionalParameter("table_name")
+      .AddOptionalParameter("table_num_hash_buckets")
+      .AddOptionalParameter("table_num_replicas")
+      .AddOptionalParameter("upsert")
+      .Build();
+
+  unique_ptr<Action> scan =
+      ActionBuilder("scan", &Scan)
+      .Description("Scan a table in parallel")
+      .ExtraDescription("Scans the tablets of a table with several threads, then "
+                        "reports the scan throughput and the latency of the "
+                        "batches of rows.")
+      .AddRequiredParameter({ kMasterAddressesArg, kMasterAddressesArgDesc })
+      .AddRequiredParameter({ kTableNameArg, "Name of the table to scan" })
+      .AddOptionalParameter("columns")
+      .AddOptionalParameter("num_threads")
+      .AddOptionalParameter("predicates")
+      .AddOptionalParameter("replica_selection")
+      .Build();
+
+  unique_ptr<Action> replay =
+      ActionBuilder("replay", &Replay)
+      .Description("Replay the requests captured by tablet servers")
+      .ExtraDescription("Sends the Write and Scan requests captured with "
+                        "--request_capture_dir to the leaders of the matching "
+                        "tablets of another cluster, at their original pace scaled "
+                        "by --replay_speed, then compares their latencies with "
+                        "the original ones. The tables of the other cluster must "
+                        "have the same names and partitioning as the captured ones.")
+      .AddRequiredParameter({ kMasterAddressesArg, kMasterAddressesArgDesc })
+      .AddRequiredParameter({ kCaptureDirArg, "Directory of the request capture files" })
+      .AddOptionalParameter("num_threads")
+      .AddOptionalParameter("replay_speed")
+      .AddOptionalParameter("timeout_ms")
+      .Build();
+
+  return ModeBuilder("perf")
+      .Description("Measure the performance of a Kudu cluster")
+      .AddAction(std::move(loadgen))
+      .AddAction(std::move(replay))
+      .AddAction(std::move(scan))
+      .Build();
+}
+
+} // namespace tools
+} // namespace kudu
@@ -126,7 +126,7 @@ class ReplicaDumper {
       RETURN_NOT_OK(results.Reset(&rpc,
                                   &schema,
                                   &client_schema,
-                                  make_gscoped_ptr(resp.release_data())));
+                                  &resp));
       vector<KuduRowResult> rows;
       results.ExtractRows(&rows);
       for (const auto& r : rows) {
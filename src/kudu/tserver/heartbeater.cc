@@ -17,23 +17,33 @@
 
 #include "kudu/tserver/heartbeater.h"
 
+#include <algorithm>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <memory>
+#include <sys/resource.h>
 #include <string>
 #include <vector>
 
 #include "kudu/common/wire_protocol.h"
+#include "kudu/consensus/consensus.h"
+#include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/master/master.h"
 #include "kudu/master/master_rpc.h"
 #include "kudu/master/master.proxy.h"
 #include "kudu/server/webserver.h"
+#include "kudu/tablet/tablet.h"
+#include "kudu/tablet/tablet_metrics.h"
+#include "kudu/tablet/tablet_peer.h"
 #include "kudu/tserver/tablet_server.h"
 #include "kudu/tserver/tablet_server_options.h"
 #include "kudu/tserver/ts_tablet_manager.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/mem_tracker.h"
 #include "kudu/util/thread.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/net_util.h"
@@ -54,6 +64,26 @@ DEFINE_int32(heartbeat_max_failures_before_backoff, 3,
              "rather than retrying.");
 TAG_FLAG(heartbeat_max_failures_before_backoff, advanced);
 
+DEFINE_int32(heartbeat_max_tablets_per_report, 1000,
+             "Maximum number of tablets included in the tablet report of a "
+             "heartbeat. The remaining tablets are reported in the following "
+             "heartbeats, which are sent right away.");
+TAG_FLAG(heartbeat_max_tablets_per_report, advanced);
+
+DEFINE_bool(heartbeat_compact_tablet_reports, true,
+            "Whether incremental tablet reports identify the committed Raft "
+            "config of a tablet by its opid_index, rather than sending it in "
+            "full, when it hasn't changed since last acknowledged by the master.");
+TAG_FLAG(heartbeat_compact_tablet_reports, advanced);
+TAG_FLAG(heartbeat_compact_tablet_reports, runtime);
+
+DEFINE_int32(heartbeat_tablet_stats_interval_ms, 10000,
+             "Interval at which the statistics of the tablet replicas which are "
+             "leaders are sent to the master, which detects the tablets to "
+             "split with them. If 0, they are not sent.");
+TAG_FLAG(heartbeat_tablet_stats_interval_ms, advanced);
+TAG_FLAG(heartbeat_tablet_stats_interval_ms, runtime);
+
 using google::protobuf::RepeatedPtrField;
 using kudu::HostPortPB;
 using kudu::consensus::RaftPeerPB;
@@ -63,6 +93,7 @@ using kudu::master::Master;
 using kudu::master::MasterServiceProxy;
 using kudu::master::TabletReportPB;
 using kudu::rpc::RpcController;
+using kudu::tablet::TabletPeer;
 using std::shared_ptr;
 using strings::Substitute;
 
@@ -103,11 +134,23 @@ class Heartbeater::Thread {
   void GenerateIncrementalTabletReport(TabletReportPB* report);
   void GenerateFullTabletReport(TabletReportPB* report);
 
+  // Fill in 'load' with the server's current load, and its rates of CPU use,
+  // writes and scans since the previous call.
+  void GenerateLoadReport(master::TServerLoadPB* load);
+
+  // Add the statistics of the replicas which are leaders to 'req', if
+  // --heartbeat_tablet_stats_interval_ms passed since they were last added.
+  void GenerateTabletStats(master::TSHeartbeatRequestPB* req);
+
   // Mark that the master successfully received and processed the given
   // tablet report. This uses the report sequence number to "un-dirty" any
-  // tablets which have not changed since the acknowledged report.
+  // tablets of the report which have not changed since.
   void MarkTabletReportAcknowledged(const TabletReportPB& report);
 
+  // Marks the tablets whose consensus state the master couldn't rebuild from
+  // a compact report, so that the next report sends it in full.
+  void HandleTabletReportUpdates(const master::TabletReportUpdatesPB& updates);
+
  private:
   void RunThread();
   Status ConnectToMaster();
@@ -155,7 +198,12 @@ class Heartbeater::Thread {
   // reported to the master, an entry is added to this map.
   DirtyMap dirty_tablets_;
 
-  // Lock protecting 'dirty_tablets_'.
+  // The opid_index of the committed config of each tablet, as of the last
+  // report acknowledged by the master which included its consensus state.
+  // Used to send compact consensus states.
+  std::unordered_map<std::string, int64_t> acked_config_opid_indexes_;
+
+  // Lock protecting 'dirty_tablets_' and 'acked_config_opid_indexes_'.
   //
   // Should not be held at the same time as mutex_.
   mutable simple_spinlock dirty_tablets_lock_;
@@ -176,6 +224,15 @@ class Heartbeater::Thread {
   // the thread detects that the master has been elected leader.
   bool send_full_tablet_report_;
 
+  // The totals at the previous load report, to compute rates from.
+  MonoTime last_load_report_time_;
+  int64_t last_cpu_micros_;
+  int64_t last_rows_written_;
+  int64_t last_rows_scanned_;
+
+  // The last time the tablet statistics were added to a heartbeat.
+  MonoTime last_tablet_stats_time_;
+
   DISALLOW_COPY_AND_ASSIGN(Thread);
 };
 
@@ -275,7 +332,10 @@ Heartbeater::Thread::Thread(const HostPort& master_address, TabletServer* server
     cond_(&mutex_),
     should_run_(false),
     heartbeat_asap_(true),
-    send_full_tablet_report_(false) {
+    send_full_tablet_report_(false),
+    last_cpu_micros_(0),
+    last_rows_written_(0),
+    last_rows_scanned_(0) {
 }
 
 Status Heartbeater::Thread::ConnectToMaster() {
@@ -382,6 +442,8 @@ Status Heartbeater::Thread::DoHeartbeat() {
     GenerateIncrementalTabletReport(req.mutable_tablet_report());
   }
   req.set_num_live_tablets(server_->tablet_manager()->GetNumLiveTablets());
+  GenerateLoadReport(req.mutable_load());
+  GenerateTabletStats(&req);
 
   RpcController rpc;
   rpc.set_timeout(MonoDelta::FromMilliseconds(FLAGS_heartbeat_rpc_timeout_ms));
@@ -408,6 +470,14 @@ Status Heartbeater::Thread::DoHeartbeat() {
   last_hb_response_.Swap(&resp);
 
   MarkTabletReportAcknowledged(req.tablet_report());
+  HandleTabletReportUpdates(last_hb_response_.tablet_report());
+
+  // If the report was paged, send the next page right away.
+  const TabletReportPB& report = req.tablet_report();
+  if (report.updated_tablets_size() + report.removed_tablet_ids_size() >=
+      FLAGS_heartbeat_max_tablets_per_report) {
+    TriggerASAP();
+  }
   return Status::OK();
 }
 
@@ -477,18 +547,43 @@ void Heartbeater::Thread::MarkTabletReportAcknowledged(const master::TabletRepor
   int32_t acked_seq = report.sequence_number();
   CHECK_LT(acked_seq, next_report_seq_.load());
 
-  // Clear the "dirty" state for any tablets which have not changed since
-  // this report.
-  auto it = dirty_tablets_.begin();
-  while (it != dirty_tablets_.end()) {
-    const TabletReportState& state = it->second;
-    if (state.change_seq <= acked_seq) {
+  // Clear the "dirty" state for the tablets of this report which have not
+  // changed since. Tablets left out of a paged report stay dirty.
+  auto clear_dirty = [&](const string& tablet_id) {
+    auto it = dirty_tablets_.find(tablet_id);
+    if (it != dirty_tablets_.end() && it->second.change_seq <= acked_seq) {
       // This entry has not changed since this tablet report, we no longer need
       // to track it as dirty. If it becomes dirty again, it will be re-added
       // with a higher sequence number.
-      it = dirty_tablets_.erase(it);
-    } else {
-      ++it;
+      dirty_tablets_.erase(it);
+    }
+  };
+
+  if (!report.is_incremental()) {
+    acked_config_opid_indexes_.clear();
+  }
+  for (const master::ReportedTabletPB& reported : report.updated_tablets()) {
+    clear_dirty(reported.tablet_id());
+    if (reported.has_committed_consensus_state()) {
+      acked_config_opid_indexes_[reported.tablet_id()] =
+          reported.committed_consensus_state().config().opid_index();
+    }
+  }
+  for (const string& tablet_id : report.removed_tablet_ids()) {
+    clear_dirty(tablet_id);
+    acked_config_opid_indexes_.erase(tablet_id);
+  }
+}
+
+void Heartbeater::Thread::HandleTabletReportUpdates(
+    const master::TabletReportUpdatesPB& updates) {
+  for (const master::ReportedTabletUpdatesPB& update : updates.tablets()) {
+    if (update.needs_consensus_state()) {
+      {
+        std::lock_guard<simple_spinlock> l(dirty_tablets_lock_);
+        acked_config_opid_indexes_.erase(update.tablet_id());
+      }
+      MarkTabletDirty(update.tablet_id(), "Master needs the consensus state");
     }
   }
 }
@@ -551,13 +646,41 @@ void Heartbeater::Thread::GenerateIncrementalTabletReport(TabletReportPB* report
   report->Clear();
   report->set_sequence_number(next_report_seq_.fetch_add(1));
   report->set_is_incremental(true);
+  const size_t max_tablets = std::max(FLAGS_heartbeat_max_tablets_per_report, 1);
   vector<string> dirty_tablet_ids;
   {
     std::lock_guard<simple_spinlock> l(dirty_tablets_lock_);
-    AppendKeysFromMap(dirty_tablets_, &dirty_tablet_ids);
+    for (const auto& e : dirty_tablets_) {
+      if (dirty_tablet_ids.size() >= max_tablets) {
+        break;
+      }
+      dirty_tablet_ids.push_back(e.first);
+    }
   }
   server_->tablet_manager()->PopulateIncrementalTabletReport(
       report, dirty_tablet_ids);
+
+  if (!FLAGS_heartbeat_compact_tablet_reports) {
+    return;
+  }
+  std::lock_guard<simple_spinlock> l(dirty_tablets_lock_);
+  for (master::ReportedTabletPB& reported : *report->mutable_updated_tablets()) {
+    if (!reported.has_committed_consensus_state()) {
+      continue;
+    }
+    const consensus::ConsensusStatePB& cstate = reported.committed_consensus_state();
+    const int64_t* acked_index = FindOrNull(acked_config_opid_indexes_, reported.tablet_id());
+    if (!acked_index || *acked_index != cstate.config().opid_index()) {
+      continue;
+    }
+    master::CompactConsensusStatePB* compact = reported.mutable_compact_consensus_state();
+    compact->set_current_term(cstate.current_term());
+    compact->set_config_opid_index(cstate.config().opid_index());
+    if (cstate.has_leader_uuid()) {
+      compact->set_leader_uuid(cstate.leader_uuid());
+    }
+    reported.clear_committed_consensus_state();
+  }
 }
 
 void Heartbeater::Thread::GenerateFullTabletReport(TabletReportPB* report) {
@@ -565,6 +688,132 @@ void Heartbeater::Thread::GenerateFullTabletReport(TabletReportPB* report) {
   report->set_sequence_number(next_report_seq_.fetch_add(1));
   report->set_is_incremental(false);
   server_->tablet_manager()->PopulateFullTabletReport(report);
+
+  // Page large reports: the tablets left out are marked dirty, to be sent in
+  // the following incremental reports.
+  const int num_tablets = report->updated_tablets_size();
+  const int max_tablets = std::max(FLAGS_heartbeat_max_tablets_per_report, 1);
+  if (num_tablets > max_tablets) {
+    for (int i = max_tablets; i < num_tablets; i++) {
+      MarkTabletDirty(report->updated_tablets(i).tablet_id(), "Paged full tablet report");
+    }
+    report->mutable_updated_tablets()->DeleteSubrange(max_tablets, num_tablets - max_tablets);
+    LOG(INFO) << Substitute("Paging full tablet report to master $0: sending $1 of $2 tablets",
+                            master_address_.ToString(), max_tablets, num_tablets);
+  }
+}
+
+void Heartbeater::Thread::GenerateLoadReport(master::TServerLoadPB* load) {
+  load->Clear();
+  FsManager* fs_manager = server_->fs_manager();
+  for (const string& dir : fs_manager->GetDataRootDirs()) {
+    int64_t bytes_free;
+    Status s = fs_manager->env()->GetBytesFree(dir, &bytes_free);
+    if (PREDICT_FALSE(!s.ok())) {
+      KLOG_EVERY_N_SECS(WARNING, 60) << "Unable to get free space of " << dir
+                                     << ": " << s.ToString();
+      continue;
+    }
+    load->add_data_dir_bytes_free(bytes_free);
+  }
+  vector<string> degraded_dirs;
+  fs_manager->GetDegradedDataRoots(&degraded_dirs);
+  load->set_num_degraded_data_dirs(degraded_dirs.size());
+
+  shared_ptr<MemTracker> root_tracker = MemTracker::GetRootTracker();
+  if (root_tracker->limit() > 0) {
+    load->set_memory_pressure(
+        static_cast<double>(root_tracker->consumption()) / root_tracker->limit());
+  }
+
+  int num_leaders = 0;
+  int64_t rows_written = 0;
+  int64_t rows_scanned = 0;
+  vector<scoped_refptr<TabletPeer>> peers;
+  server_->tablet_manager()->GetTabletPeers(&peers);
+  for (const auto& peer : peers) {
+    scoped_refptr<consensus::Consensus> consensus = peer->shared_consensus();
+    if (consensus && consensus->role() == RaftPeerPB::LEADER) {
+      num_leaders++;
+    }
+    shared_ptr<tablet::Tablet> tablet = peer->shared_tablet();
+    if (!tablet || !tablet->metrics()) {
+      continue;
+    }
+    const tablet::TabletMetrics* metrics = tablet->metrics();
+    rows_written += metrics->rows_inserted->value() +
+                    metrics->rows_upserted->value() +
+                    metrics->rows_updated->value() +
+                    metrics->rows_deleted->value();
+    rows_scanned += metrics->scanner_rows_returned->value();
+  }
+  load->set_num_leaders(num_leaders);
+
+  rusage ru;
+  CHECK_ERR(getrusage(RUSAGE_SELF, &ru));
+  int64_t cpu_micros = (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000L +
+                       ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+
+  MonoTime now = MonoTime::Now();
+  if (last_load_report_time_.Initialized()) {
+    double elapsed_secs = (now - last_load_report_time_).ToSeconds();
+    if (elapsed_secs > 0) {
+      double cpu_secs = (cpu_micros - last_cpu_micros_) / 1e6;
+      load->set_cpu_utilization(std::min(1.0, cpu_secs / (elapsed_secs * base::NumCPUs())));
+      // The totals drop when tablets are removed from the server.
+      load->set_rows_written_per_sec(
+          std::max<int64_t>(0, rows_written - last_rows_written_) / elapsed_secs);
+      load->set_rows_scanned_per_sec(
+          std::max<int64_t>(0, rows_scanned - last_rows_scanned_) / elapsed_secs);
+    }
+  }
+  last_load_report_time_ = now;
+  last_cpu_micros_ = cpu_micros;
+  last_rows_written_ = rows_written;
+  last_rows_scanned_ = rows_scanned;
+}
+
+void Heartbeater::Thread::GenerateTabletStats(master::TSHeartbeatRequestPB* req) {
+  MonoTime now = MonoTime::Now();
+  if (FLAGS_heartbeat_tablet_stats_interval_ms <= 0 ||
+      (last_tablet_stats_time_.Initialized() &&
+       now < last_tablet_stats_time_ +
+             MonoDelta::FromMilliseconds(FLAGS_heartbeat_tablet_stats_interval_ms))) {
+    return;
+  }
+  last_tablet_stats_time_ = now;
+
+  vector<scoped_refptr<TabletPeer>> peers;
+  server_->tablet_manager()->GetTabletPeers(&peers);
+  for (const auto& peer : peers) {
+    scoped_refptr<consensus::Consensus> consensus = peer->shared_consensus();
+    shared_ptr<tablet::Tablet> tablet = peer->shared_tablet();
+    if (!consensus || consensus->role() != RaftPeerPB::LEADER ||
+        !tablet || !tablet->metrics()) {
+      continue;
+    }
+    master::TabletStatsPB* stats = req->add_tablet_stats();
+    stats->set_tablet_id(peer->tablet_id());
+    stats->set_on_disk_size(tablet->EstimateOnDiskSize());
+    const tablet::TabletMetrics* metrics = tablet->metrics();
+    stats->set_rows_written(metrics->rows_inserted->value() +
+                            metrics->rows_upserted->value() +
+                            metrics->rows_updated->value() +
+                            metrics->rows_deleted->value());
+    stats->set_rows_scanned(metrics->scanner_rows_returned->value());
+    stats->set_bytes_scanned(metrics->scanner_bytes_returned->value());
+    stats->set_write_latency_p99_us(std::max(
+        metrics->write_op_duration_client_propagated_consistency->ValueAtPercentile(99),
+        metrics->write_op_duration_commit_wait_consistency->ValueAtPercentile(99)));
+    string split_key;
+    Status s = tablet->EstimateSplitKey(&split_key);
+    if (!s.ok()) {
+      KLOG_EVERY_N_SECS(WARNING, 60) << "Unable to estimate the split key of tablet "
+                                     << peer->tablet_id() << ": " << s.ToString();
+    } else if (!split_key.empty()) {
+      stats->set_split_key(split_key);
+    }
+  }
 }
 
 } // namespace tserver
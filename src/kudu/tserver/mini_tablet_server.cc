@@ -134,7 +134,7 @@ Status MiniTabletServer::AddTestTablet(const std::string& table_id,
 
   return server_->tablet_manager()->CreateNewTablet(
     table_id, tablet_id, partition.second, table_id,
-    schema_with_ids, partition.first, config, nullptr);
+    schema_with_ids, partition.first, CompactionPolicyPB(), config, nullptr);
 }
 
 void MiniTabletServer::FailHeartbeats() {
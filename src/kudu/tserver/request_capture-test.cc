@@ -0,0 +1,153 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tserver/request_capture.h"
+
+#include <string>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include "kudu/tserver/tserver.pb.h"
+#include "kudu/util/env.h"
+#include "kudu/util/path_util.h"
+#include "kudu/util/pb_util.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+DECLARE_double(request_capture_sample_rate);
+DECLARE_int32(request_capture_file_size_mb);
+DECLARE_int32(request_capture_max_files);
+DECLARE_int32(request_capture_queue_mb);
+
+using std::string;
+using std::vector;
+
+namespace kudu {
+namespace tserver {
+
+class RequestCaptureTest : public KuduTest {
+ protected:
+  static gscoped_ptr<CapturedRequestPB> MakeRecord(int64_t received_unix_us, int size_bytes) {
+    gscoped_ptr<CapturedRequestPB> record(new CapturedRequestPB());
+    record->set_method(CapturedRequestPB::WRITE);
+    record->set_received_unix_us(received_unix_us);
+    record->set_table_name("table");
+    record->mutable_write_request()->set_tablet_id(string(size_bytes, 'x'));
+    return std::move(record);
+  }
+
+  // Reads the records of the capture file at 'path'.
+  Status ReadRecords(const string& path, vector<CapturedRequestPB>* records) {
+    gscoped_ptr<RandomAccessFile> file;
+    RETURN_NOT_OK(env_->NewRandomAccessFile(path, &file));
+    pb_util::ReadablePBContainerFile reader(std::move(file));
+    RETURN_NOT_OK(reader.Open());
+    while (true) {
+      CapturedRequestPB record;
+      Status s = reader.ReadNextPB(&record);
+      if (s.IsEndOfFile()) {
+        break;
+      }
+      RETURN_NOT_OK(s);
+      records->push_back(record);
+    }
+    return reader.Close();
+  }
+};
+
+TEST_F(RequestCaptureTest, TestSampling) {
+  RequestCapture disabled(env_.get(), "");
+  ASSERT_FALSE(disabled.enabled());
+  FLAGS_request_capture_sample_rate = 1;
+  ASSERT_FALSE(disabled.ShouldCapture());
+
+  RequestCapture capture(env_.get(), GetTestPath("capture"));
+  ASSERT_TRUE(capture.enabled());
+  for (int i = 0; i < 100; i++) {
+    ASSERT_TRUE(capture.ShouldCapture());
+  }
+  FLAGS_request_capture_sample_rate = 0;
+  for (int i = 0; i < 100; i++) {
+    ASSERT_FALSE(capture.ShouldCapture());
+  }
+}
+
+// The capture rolls over to new files, keeping only the newest ones.
+TEST_F(RequestCaptureTest, TestRolling) {
+  FLAGS_request_capture_file_size_mb = 1;
+  FLAGS_request_capture_max_files = 2;
+  const string dir = GetTestPath("capture");
+  const int kRecordSize = 100 * 1024;
+  {
+    RequestCapture capture(env_.get(), dir);
+    ASSERT_OK(capture.StartWriterThread());
+    for (int i = 0; i < 50; i++) {
+      ASSERT_OK(capture.Append(MakeRecord(i, kRecordSize)));
+    }
+  }
+  vector<string> paths;
+  ASSERT_OK(RequestCapture::ListFiles(env_.get(), dir, &paths));
+  ASSERT_EQ(2, paths.size());
+  vector<CapturedRequestPB> records;
+  for (const string& path : paths) {
+    ASSERT_OK(ReadRecords(path, &records));
+  }
+  ASSERT_FALSE(records.empty());
+  ASSERT_LT(records.size(), 50);
+  // The records read are the newest ones, in order.
+  for (int i = 0; i < records.size(); i++) {
+    ASSERT_EQ(50 - records.size() + i, records[i].received_unix_us());
+  }
+
+  // A restarted server continues the sequence of files, and rolls away those
+  // of the previous run.
+  string last = BaseName(paths.back());
+  {
+    RequestCapture capture(env_.get(), dir);
+    ASSERT_OK(capture.StartWriterThread());
+    for (int i = 0; i < 30; i++) {
+      ASSERT_OK(capture.Append(MakeRecord(100 + i, kRecordSize)));
+    }
+  }
+  ASSERT_OK(RequestCapture::ListFiles(env_.get(), dir, &paths));
+  ASSERT_EQ(2, paths.size());
+  ASSERT_GT(BaseName(paths.front()), last);
+}
+
+// Records are dropped rather than queued past --request_capture_queue_mb.
+TEST_F(RequestCaptureTest, TestQueueIsBounded) {
+  FLAGS_request_capture_queue_mb = 1;
+  const int kRecordSize = 100 * 1024;
+  // Without a writer thread, the queue is never drained.
+  RequestCapture capture(env_.get(), GetTestPath("capture"));
+  int queued = 0;
+  while (true) {
+    Status s = capture.Append(MakeRecord(queued, kRecordSize));
+    if (!s.ok()) {
+      ASSERT_TRUE(s.IsServiceUnavailable()) << s.ToString();
+      break;
+    }
+    queued++;
+  }
+  // Records are queued while less than the limit is.
+  ASSERT_EQ(1024 * 1024 / kRecordSize + 1, queued);
+}
+
+} // namespace tserver
+} // namespace kudu
@@ -0,0 +1,236 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tserver/request_capture.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/util.h"
+#include "kudu/tserver/tserver.pb.h"
+#include "kudu/util/env.h"
+#include "kudu/util/env_util.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/path_util.h"
+#include "kudu/util/pb_util.h"
+#include "kudu/util/random_util.h"
+
+DEFINE_string(request_capture_dir, "",
+              "Directory to which a sample of the Write and Scan requests received "
+              "by the tablet server is written, for 'kudu perf replay' to re-issue "
+              "them. If empty, requests aren't captured.");
+TAG_FLAG(request_capture_dir, advanced);
+TAG_FLAG(request_capture_dir, experimental);
+
+DEFINE_double(request_capture_sample_rate, 0.01,
+              "Fraction of the Write and Scan requests which are captured, when "
+              "--request_capture_dir is set.");
+TAG_FLAG(request_capture_sample_rate, advanced);
+TAG_FLAG(request_capture_sample_rate, experimental);
+TAG_FLAG(request_capture_sample_rate, runtime);
+
+DEFINE_int32(request_capture_file_size_mb, 64,
+             "Size past which a new request capture file is started.");
+TAG_FLAG(request_capture_file_size_mb, advanced);
+TAG_FLAG(request_capture_file_size_mb, experimental);
+TAG_FLAG(request_capture_file_size_mb, runtime);
+
+DEFINE_int32(request_capture_max_files, 10,
+             "Number of request capture files kept. The oldest files are deleted "
+             "as new ones are started.");
+TAG_FLAG(request_capture_max_files, advanced);
+TAG_FLAG(request_capture_max_files, experimental);
+TAG_FLAG(request_capture_max_files, runtime);
+
+DEFINE_int32(request_capture_queue_mb, 16,
+             "Maximum amount of captured requests, in MB, which may wait to be "
+             "written. Requests captured while the queue is full are dropped.");
+TAG_FLAG(request_capture_queue_mb, advanced);
+TAG_FLAG(request_capture_queue_mb, experimental);
+
+using kudu::pb_util::WritablePBContainerFile;
+using std::string;
+using std::vector;
+
+namespace kudu {
+namespace tserver {
+
+namespace {
+
+const char* const kFilePrefix = "requests-";
+
+// Returns the name of the capture file with sequence number 'seqno'. The
+// names sort in the order of the sequence numbers.
+string FileName(int64_t seqno) {
+  return StringPrintf("%s%020" PRId64, kFilePrefix, seqno);
+}
+
+// Returns whether 'name' is the name of a capture file, setting 'seqno' to
+// its sequence number if it is.
+bool ParseFileName(const string& name, int64_t* seqno) {
+  return HasPrefixString(name, kFilePrefix) &&
+      safe_strto64(name.substr(strlen(kFilePrefix)), seqno);
+}
+
+} // anonymous namespace
+
+size_t RequestCapture::RecordSize::logical_size(const CapturedRequestPB* record) {
+  return record->ByteSize();
+}
+
+RequestCapture::RequestCapture(Env* env, string dir)
+    : env_(env),
+      dir_(std::move(dir)),
+      rng_(GetRandomSeed32()),
+      queue_(std::max<int64_t>(
+          1, static_cast<int64_t>(FLAGS_request_capture_queue_mb) * 1024 * 1024)) {
+}
+
+RequestCapture::~RequestCapture() {
+  // The writer thread drains the queue before exiting.
+  queue_.Shutdown();
+  if (writer_thread_) {
+    CHECK_OK(ThreadJoiner(writer_thread_.get()).Join());
+  }
+  CapturedRequestPB* record;
+  while (queue_.BlockingGet(&record)) {
+    delete record;
+  }
+  if (writer_) {
+    WARN_NOT_OK(writer_->Close(), "Unable to close request capture file");
+  }
+}
+
+Status RequestCapture::StartWriterThread() {
+  if (!enabled()) {
+    return Status::OK();
+  }
+  return Thread::Create("request-capture", "writer",
+                        &RequestCapture::RunWriterThread, this, &writer_thread_);
+}
+
+bool RequestCapture::ShouldCapture() {
+  if (!enabled()) {
+    return false;
+  }
+  double rate = FLAGS_request_capture_sample_rate;
+  return rate >= 1 || (rate > 0 && rng_.Uniform(1000000) < rate * 1000000);
+}
+
+Status RequestCapture::ListFiles(Env* env, const string& dir, vector<string>* paths) {
+  vector<string> children;
+  RETURN_NOT_OK(env->GetChildren(dir, &children));
+  std::sort(children.begin(), children.end());
+  paths->clear();
+  for (const string& child : children) {
+    int64_t seqno;
+    if (ParseFileName(child, &seqno)) {
+      paths->push_back(JoinPathSegments(dir, child));
+    }
+  }
+  return Status::OK();
+}
+
+Status RequestCapture::Append(gscoped_ptr<CapturedRequestPB> record) {
+  DCHECK(enabled());
+  switch (queue_.Put(&record)) {
+    case QUEUE_SUCCESS:
+      return Status::OK();
+    case QUEUE_FULL:
+      return Status::ServiceUnavailable("request capture queue is full");
+    case QUEUE_SHUTDOWN:
+      return Status::ServiceUnavailable("request capture is shutting down");
+  }
+  LOG(FATAL) << "unreachable";
+  return Status::OK();
+}
+
+void RequestCapture::RunWriterThread() {
+  gscoped_ptr<CapturedRequestPB> record;
+  while (queue_.BlockingGet(&record)) {
+    Status s = Write(*record);
+    if (PREDICT_FALSE(!s.ok())) {
+      KLOG_EVERY_N_SECS(WARNING, 10) << "Unable to capture request: " << s.ToString()
+                                     << THROTTLE_MSG;
+    }
+  }
+}
+
+Status RequestCapture::Write(const CapturedRequestPB& record) {
+  if (!writer_ || file_size_ >= FLAGS_request_capture_file_size_mb * 1024LL * 1024) {
+    RETURN_NOT_OK(Roll());
+  }
+  Status s = writer_->Append(record);
+  if (!s.ok()) {
+    // The file may end with a partial record; start over in a new one.
+    writer_.reset();
+    return s.CloneAndPrepend("Unable to append to request capture file");
+  }
+  file_size_ += record.ByteSize();
+  return Status::OK();
+}
+
+Status RequestCapture::Roll() {
+  if (writer_) {
+    Status s = writer_->Close();
+    writer_.reset();
+    RETURN_NOT_OK_PREPEND(s, "Unable to close request capture file");
+  } else if (files_.empty()) {
+    // Pick up where a previous run of the server left off, so that its
+    // files are rolled away too.
+    RETURN_NOT_OK(env_util::CreateDirIfMissing(env_, dir_));
+    vector<string> paths;
+    RETURN_NOT_OK(ListFiles(env_, dir_, &paths));
+    for (const string& path : paths) {
+      int64_t seqno;
+      CHECK(ParseFileName(BaseName(path), &seqno));
+      files_.push_back(path);
+      next_seqno_ = std::max(next_seqno_, seqno + 1);
+    }
+  }
+
+  string path = JoinPathSegments(dir_, FileName(next_seqno_++));
+  RWFileOptions opts;
+  opts.mode = Env::CREATE_IF_NON_EXISTING_TRUNCATE;
+  gscoped_ptr<RWFile> file;
+  RETURN_NOT_OK_PREPEND(env_->NewRWFile(opts, path, &file),
+                        "Unable to create request capture file");
+  gscoped_ptr<WritablePBContainerFile> writer(new WritablePBContainerFile(std::move(file)));
+  RETURN_NOT_OK_PREPEND(writer->Init(CapturedRequestPB()),
+                        "Unable to initialize request capture file");
+  writer_ = std::move(writer);
+  file_size_ = 0;
+  files_.push_back(path);
+
+  while (files_.size() > std::max<size_t>(1, FLAGS_request_capture_max_files)) {
+    WARN_NOT_OK(env_->DeleteFile(files_.front()), "Unable to delete request capture file");
+    files_.pop_front();
+  }
+  return Status::OK();
+}
+
+} // namespace tserver
+} // namespace kudu
@@ -0,0 +1,124 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TSERVER_REQUEST_CAPTURE_H
+#define KUDU_TSERVER_REQUEST_CAPTURE_H
+
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/blocking_queue.h"
+#include "kudu/util/random.h"
+#include "kudu/util/status.h"
+#include "kudu/util/thread.h"
+
+namespace kudu {
+
+class Env;
+
+namespace pb_util {
+class WritablePBContainerFile;
+} // namespace pb_util
+
+namespace tserver {
+
+class CapturedRequestPB;
+
+// Captures a sample of the requests received by a tablet server, so that
+// they can be re-issued against another cluster by 'kudu perf replay'.
+//
+// The requests are appended to PB container files of CapturedRequestPB in
+// 'dir', named so that they sort in the order they were written. A new file
+// is started once the current one reaches --request_capture_file_size_mb,
+// and only the last --request_capture_max_files files are kept. The files
+// aren't synced: the capture is a diagnostic, and a crash loses at most the
+// requests which weren't written back yet.
+//
+// The requests are written by a thread of their own, so that handling a
+// request never waits for the capture files. Up to --request_capture_queue_mb
+// of requests wait for it; those captured while the queue is full are
+// dropped.
+//
+// An empty 'dir' disables the capture.
+//
+// This class is thread-safe.
+class RequestCapture {
+ public:
+  RequestCapture(Env* env, std::string dir);
+  ~RequestCapture();
+
+  bool enabled() const { return !dir_.empty(); }
+
+  // Returns whether the request being handled should be captured, sampling
+  // --request_capture_sample_rate of the requests.
+  bool ShouldCapture();
+
+  // Starts the thread writing the captured requests, if the capture is
+  // enabled.
+  Status StartWriterThread();
+
+  // Queues 'record' to be appended to the current capture file. Returns
+  // ServiceUnavailable, dropping the record, if the queue is full.
+  Status Append(gscoped_ptr<CapturedRequestPB> record);
+
+  // Sets 'paths' to the capture files in 'dir', oldest first.
+  static Status ListFiles(Env* env, const std::string& dir, std::vector<std::string>* paths);
+
+ private:
+  struct RecordSize {
+    static size_t logical_size(const CapturedRequestPB* record);
+  };
+
+  // Writes the queued records until the queue is shut down and drained.
+  void RunWriterThread();
+
+  // Appends 'record' to the current capture file.
+  Status Write(const CapturedRequestPB& record);
+
+  // Starts a new capture file, deleting the oldest ones if there are too
+  // many.
+  Status Roll();
+
+  Env* const env_;
+  const std::string dir_;
+
+  ThreadSafeRandom rng_;
+
+  BlockingQueue<CapturedRequestPB*, RecordSize> queue_;
+  scoped_refptr<Thread> writer_thread_;
+
+  // The state below is only used by the writer thread.
+
+  // The capture files, oldest first, including the one being written.
+  std::deque<std::string> files_;
+
+  gscoped_ptr<pb_util::WritablePBContainerFile> writer_;
+  int64_t file_size_ = 0;
+  int64_t next_seqno_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(RequestCapture);
+};
+
+} // namespace tserver
+} // namespace kudu
+
+#endif // KUDU_TSERVER_REQUEST_CAPTURE_H
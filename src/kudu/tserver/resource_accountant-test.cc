@@ -0,0 +1,92 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tserver/resource_accountant.h"
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "kudu/tablet/tablet_metrics.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/test_util.h"
+#include "kudu/util/trace.h"
+
+METRIC_DECLARE_entity(tablet);
+
+using std::string;
+
+namespace kudu {
+
+namespace cfile {
+extern const char* CFILE_CACHE_MISS_BYTES_METRIC_NAME;
+extern const char* CFILE_CACHE_HIT_BYTES_METRIC_NAME;
+} // namespace cfile
+
+namespace tserver {
+
+class ResourceAccountantTest : public KuduTest {};
+
+TEST_F(ResourceAccountantTest, TestMeter) {
+  scoped_refptr<Trace> trace(new Trace);
+  ADOPT_TRACE(trace.get());
+  TRACE_COUNTER_INCREMENT(cfile::CFILE_CACHE_MISS_BYTES_METRIC_NAME, 100);
+
+  // Only what's used after the meter is created counts.
+  ResourceUsageMeter meter;
+  TRACE_COUNTER_INCREMENT(cfile::CFILE_CACHE_MISS_BYTES_METRIC_NAME, 10);
+  TRACE_COUNTER_INCREMENT(cfile::CFILE_CACHE_HIT_BYTES_METRIC_NAME, 20);
+  while (meter.Elapsed().cpu_time_us < 1000) {
+  }
+  ResourceUsage usage = meter.Elapsed();
+  ASSERT_GE(usage.cpu_time_us, 1000);
+  ASSERT_EQ(10, usage.cfile_cache_miss_bytes);
+  ASSERT_EQ(20, usage.cfile_cache_hit_bytes);
+}
+
+TEST_F(ResourceAccountantTest, TestCharge) {
+  MetricRegistry registry;
+  tablet::TabletMetrics metrics(METRIC_ENTITY_tablet.Instantiate(&registry, "test"));
+  ResourceAccountant accountant;
+
+  ResourceUsage usage;
+  usage.cpu_time_us = 5;
+  usage.cfile_cache_hit_bytes = 100;
+  usage.cfile_cache_miss_bytes = 1000;
+  accountant.ChargeRpc("alice", &metrics, usage);
+  accountant.ChargeRpc("alice", &metrics, usage);
+  usage.cpu_time_us = 20;
+  accountant.ChargeRpc("bob", nullptr, usage);
+  ASSERT_EQ(10, metrics.rpc_cpu_time_us->value());
+  ASSERT_EQ(200, metrics.rpc_cfile_cache_hit_bytes->value());
+  ASSERT_EQ(2000, metrics.rpc_cfile_cache_miss_bytes->value());
+
+  ResourceUsageVector users = accountant.GetUsageByUser();
+  KeepTopResourceUsages(1, &ResourceUsage::cpu_time_us, &users);
+  ASSERT_EQ(1, users.size());
+  ASSERT_EQ("bob", users[0].first);
+
+  users = accountant.GetUsageByUser();
+  KeepTopResourceUsages(10, &ResourceUsage::cfile_cache_miss_bytes, &users);
+  ASSERT_EQ(2, users.size());
+  ASSERT_EQ("alice", users[0].first);
+  ASSERT_EQ(2000, users[0].second.cfile_cache_miss_bytes);
+  ASSERT_EQ("bob", users[1].first);
+}
+
+} // namespace tserver
+} // namespace kudu
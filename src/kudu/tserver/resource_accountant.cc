@@ -0,0 +1,103 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tserver/resource_accountant.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include "kudu/tablet/tablet_metrics.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/trace.h"
+
+using std::string;
+
+namespace kudu {
+
+namespace cfile {
+extern const char* CFILE_CACHE_MISS_BYTES_METRIC_NAME;
+extern const char* CFILE_CACHE_HIT_BYTES_METRIC_NAME;
+} // namespace cfile
+
+namespace tserver {
+
+void KeepTopResourceUsages(int n, int64_t ResourceUsage::*resource,
+                           ResourceUsageVector* usages) {
+  auto by_resource = [&](const ResourceUsageVector::value_type& a,
+                         const ResourceUsageVector::value_type& b) {
+    if (a.second.*resource != b.second.*resource) {
+      return a.second.*resource > b.second.*resource;
+    }
+    return a.first < b.first;
+  };
+  if (n < usages->size()) {
+    std::partial_sort(usages->begin(), usages->begin() + n, usages->end(), by_resource);
+    usages->resize(n);
+  } else {
+    std::sort(usages->begin(), usages->end(), by_resource);
+  }
+}
+
+ResourceUsageMeter::ResourceUsageMeter()
+    : sw_(Stopwatch::THIS_THREAD),
+      trace_(Trace::CurrentTrace()) {
+  if (trace_) {
+    start_cache_hit_bytes_ = trace_->metrics()->GetMetric(
+        cfile::CFILE_CACHE_HIT_BYTES_METRIC_NAME);
+    start_cache_miss_bytes_ = trace_->metrics()->GetMetric(
+        cfile::CFILE_CACHE_MISS_BYTES_METRIC_NAME);
+  }
+  sw_.start();
+}
+
+ResourceUsageMeter::~ResourceUsageMeter() {}
+
+ResourceUsage ResourceUsageMeter::Elapsed() const {
+  ResourceUsage usage;
+  CpuTimes times = sw_.elapsed();
+  usage.cpu_time_us = (times.user + times.system) / 1000;
+  if (trace_) {
+    usage.cfile_cache_hit_bytes = trace_->metrics()->GetMetric(
+        cfile::CFILE_CACHE_HIT_BYTES_METRIC_NAME) - start_cache_hit_bytes_;
+    usage.cfile_cache_miss_bytes = trace_->metrics()->GetMetric(
+        cfile::CFILE_CACHE_MISS_BYTES_METRIC_NAME) - start_cache_miss_bytes_;
+  }
+  return usage;
+}
+
+ResourceAccountant::ResourceAccountant() {}
+
+ResourceAccountant::~ResourceAccountant() {}
+
+void ResourceAccountant::ChargeRpc(const string& user, tablet::TabletMetrics* tablet_metrics,
+                                   const ResourceUsage& usage) {
+  if (tablet_metrics) {
+    tablet_metrics->rpc_cpu_time_us->IncrementBy(usage.cpu_time_us);
+    tablet_metrics->rpc_cfile_cache_hit_bytes->IncrementBy(usage.cfile_cache_hit_bytes);
+    tablet_metrics->rpc_cfile_cache_miss_bytes->IncrementBy(usage.cfile_cache_miss_bytes);
+  }
+  std::lock_guard<simple_spinlock> l(lock_);
+  usage_by_user_[user] += usage;
+}
+
+ResourceUsageVector ResourceAccountant::GetUsageByUser() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return ResourceUsageVector(usage_by_user_.begin(), usage_by_user_.end());
+}
+
+} // namespace tserver
+} // namespace kudu
@@ -0,0 +1,115 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TSERVER_RESOURCE_ACCOUNTANT_H
+#define KUDU_TSERVER_RESOURCE_ACCOUNTANT_H
+
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/stopwatch.h"
+
+namespace kudu {
+
+class Trace;
+
+namespace tablet {
+struct TabletMetrics;
+} // namespace tablet
+
+namespace tserver {
+
+// The resources used to serve a request, or a set of them.
+struct ResourceUsage {
+  // CPU time of the threads which served the request.
+  int64_t cpu_time_us = 0;
+
+  // Bytes of blocks read from the block cache.
+  int64_t cfile_cache_hit_bytes = 0;
+
+  // Bytes of blocks missing from the block cache, and so read from disk.
+  int64_t cfile_cache_miss_bytes = 0;
+
+  ResourceUsage& operator+=(const ResourceUsage& other) {
+    cpu_time_us += other.cpu_time_us;
+    cfile_cache_hit_bytes += other.cfile_cache_hit_bytes;
+    cfile_cache_miss_bytes += other.cfile_cache_miss_bytes;
+    return *this;
+  }
+};
+
+// The usage of each of a set of consumers, e.g. tables or users.
+typedef std::vector<std::pair<std::string, ResourceUsage>> ResourceUsageVector;
+
+// Sorts 'usages' by decreasing 'resource', e.g. &ResourceUsage::cpu_time_us,
+// and drops all but the first 'n'.
+void KeepTopResourceUsages(int n, int64_t ResourceUsage::*resource,
+                           ResourceUsageVector* usages);
+
+// Measures the resources used by the current thread, from construction to
+// each call of Elapsed(). The block cache reads are those recorded in the
+// metrics of the thread's current trace, if any.
+class ResourceUsageMeter {
+ public:
+  ResourceUsageMeter();
+  ~ResourceUsageMeter();
+
+  ResourceUsage Elapsed() const;
+
+ private:
+  Stopwatch sw_;
+  scoped_refptr<Trace> trace_;
+  int64_t start_cache_hit_bytes_ = 0;
+  int64_t start_cache_miss_bytes_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(ResourceUsageMeter);
+};
+
+// Attributes the resources used by the RPCs handled by a tablet server to
+// the tablets they were for, through the tablets' metrics, and to the users
+// who sent them.
+//
+// This class is thread-safe.
+class ResourceAccountant {
+ public:
+  ResourceAccountant();
+  ~ResourceAccountant();
+
+  // Charges 'usage' by an RPC from 'user' to the user and, unless they're
+  // NULL, to the metrics of the tablet the RPC was for.
+  void ChargeRpc(const std::string& user, tablet::TabletMetrics* tablet_metrics,
+                 const ResourceUsage& usage);
+
+  // Returns the usage charged to each user so far.
+  ResourceUsageVector GetUsageByUser() const;
+
+ private:
+  mutable simple_spinlock lock_;
+  std::unordered_map<std::string, ResourceUsage> usage_by_user_;
+
+  DISALLOW_COPY_AND_ASSIGN(ResourceAccountant);
+};
+
+} // namespace tserver
+} // namespace kudu
+#endif
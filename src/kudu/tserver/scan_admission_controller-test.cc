@@ -0,0 +1,172 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tserver/scan_admission_controller.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include "kudu/util/locks.h"
+#include "kudu/util/mem_tracker.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/test_util.h"
+
+DECLARE_int32(scanner_admission_max_concurrent);
+DECLARE_int64(scanner_admission_memory_budget_bytes);
+DECLARE_int32(scanner_admission_max_queued);
+DECLARE_int32(scanner_admission_max_wait_ms);
+
+METRIC_DECLARE_gauge_int32(scan_requests_queued);
+METRIC_DECLARE_gauge_int32(scan_requests_running);
+
+using std::shared_ptr;
+using std::string;
+using std::thread;
+using std::vector;
+
+namespace kudu {
+namespace tserver {
+
+class ScanAdmissionControllerTest : public KuduTest {
+ public:
+  ScanAdmissionControllerTest()
+      : entity_(METRIC_ENTITY_server.Instantiate(&registry_, "test")),
+        parent_tracker_(MemTracker::CreateTracker(-1, CURRENT_TEST_NAME())) {
+  }
+
+ protected:
+  static MonoTime Deadline() {
+    return MonoTime::Now() + MonoDelta::FromSeconds(30);
+  }
+
+  int32_t GaugeValue(GaugePrototype<int32_t>* prototype) {
+    return prototype->Instantiate(entity_, 0)->value();
+  }
+
+  MetricRegistry registry_;
+  scoped_refptr<MetricEntity> entity_;
+  shared_ptr<MemTracker> parent_tracker_;
+};
+
+// Test that requests are held back by the concurrency and memory limits,
+// and rejected when they wait for too long or the queue is full.
+TEST_F(ScanAdmissionControllerTest, TestLimits) {
+  FLAGS_scanner_admission_max_concurrent = 2;
+  FLAGS_scanner_admission_memory_budget_bytes = 1000;
+  FLAGS_scanner_admission_max_wait_ms = 50;
+  ScanAdmissionController controller(parent_tracker_, entity_);
+
+  // A request too large for the budget still runs on its own.
+  gscoped_ptr<ScanAdmissionController::Admission> big;
+  ASSERT_OK(controller.Admit("a", "", 2000, Deadline(), &big));
+  gscoped_ptr<ScanAdmissionController::Admission> small;
+  Status s = controller.Admit("a", "", 100, Deadline(), &small);
+  ASSERT_TRUE(s.IsServiceUnavailable()) << s.ToString();
+  big.reset();
+
+  // Only two requests run at once.
+  gscoped_ptr<ScanAdmissionController::Admission> first;
+  gscoped_ptr<ScanAdmissionController::Admission> second;
+  gscoped_ptr<ScanAdmissionController::Admission> third;
+  ASSERT_OK(controller.Admit("a", "", 100, Deadline(), &first));
+  ASSERT_OK(controller.Admit("b", "scanner", 100, Deadline(), &second));
+  ASSERT_EQ(2, controller.num_running());
+  ASSERT_EQ(2, GaugeValue(&METRIC_scan_requests_running));
+  s = controller.Admit("c", "", 100, Deadline(), &third);
+  ASSERT_TRUE(s.IsServiceUnavailable()) << s.ToString();
+  ASSERT_EQ(0, GaugeValue(&METRIC_scan_requests_queued));
+  first.reset();
+  ASSERT_OK(controller.Admit("c", "", 100, Deadline(), &third));
+
+  // Memory is only handed out within the budget.
+  FLAGS_scanner_admission_max_concurrent = 0;
+  s = controller.Admit("a", "", 900, Deadline(), &first);
+  ASSERT_TRUE(s.IsServiceUnavailable()) << s.ToString();
+  ASSERT_OK(controller.Admit("a", "", 800, Deadline(), &first));
+
+  // With no room to queue, requests are rejected right away.
+  FLAGS_scanner_admission_max_queued = 0;
+  FLAGS_scanner_admission_max_wait_ms = 60000;
+  gscoped_ptr<ScanAdmissionController::Admission> rejected;
+  s = controller.Admit("a", "", 100, Deadline(), &rejected);
+  ASSERT_TRUE(s.IsServiceUnavailable()) << s.ToString();
+
+  first.reset();
+  second.reset();
+  third.reset();
+  ASSERT_EQ(0, controller.num_running());
+  ASSERT_EQ(0, GaugeValue(&METRIC_scan_requests_running));
+}
+
+// Test that waiting requests are admitted as others finish, with users
+// running fewer requests going first.
+TEST_F(ScanAdmissionControllerTest, TestQueueOrder) {
+  FLAGS_scanner_admission_max_concurrent = 2;
+  FLAGS_scanner_admission_max_wait_ms = 60000;
+  ScanAdmissionController controller(parent_tracker_, entity_);
+
+  gscoped_ptr<ScanAdmissionController::Admission> a1;
+  gscoped_ptr<ScanAdmissionController::Admission> a2;
+  ASSERT_OK(controller.Admit("a", "", 100, Deadline(), &a1));
+  ASSERT_OK(controller.Admit("a", "", 100, Deadline(), &a2));
+
+  simple_spinlock lock;
+  vector<string> admitted;
+  auto admit = [&](const string& user, const string& scanner_id) {
+    gscoped_ptr<ScanAdmissionController::Admission> admission;
+    CHECK_OK(controller.Admit(user, scanner_id, 100, Deadline(), &admission));
+    std::lock_guard<simple_spinlock> l(lock);
+    admitted.push_back(user);
+  };
+  auto wait_for_queue = [&](int size) {
+    AssertEventually([&]() {
+      vector<ScanAdmissionController::QueuedRequest> queue;
+      controller.GetQueue(&queue);
+      ASSERT_EQ(size, queue.size());
+    });
+  };
+  thread a3(admit, "a", "a-scanner");
+  wait_for_queue(1);
+  thread b1(admit, "b", "");
+  wait_for_queue(2);
+  ASSERT_EQ(2, GaugeValue(&METRIC_scan_requests_queued));
+
+  // 'b' runs nothing, so it's ahead of 'a' despite arriving later.
+  vector<ScanAdmissionController::QueuedRequest> queue;
+  controller.GetQueue(&queue);
+  ASSERT_EQ("b", queue[0].user);
+  ASSERT_EQ("", queue[0].scanner_id);
+  ASSERT_EQ("a", queue[1].user);
+  ASSERT_EQ("a-scanner", queue[1].scanner_id);
+
+  a1.reset();
+  a3.join();
+  b1.join();
+  ASSERT_EQ((vector<string>{ "b", "a" }), admitted);
+  ASSERT_EQ(0, GaugeValue(&METRIC_scan_requests_queued));
+  a2.reset();
+  ASSERT_EQ(0, controller.num_running());
+}
+
+} // namespace tserver
+} // namespace kudu
@@ -0,0 +1,246 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tserver/scan_admission_controller.h"
+
+#include <utility>
+
+#include <gflags/gflags.h>
+
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/mem_tracker.h"
+#include "kudu/util/metrics.h"
+
+DEFINE_int32(scanner_admission_max_concurrent, 64,
+             "Maximum number of scan requests that a tablet server runs at once. "
+             "Other requests wait to be admitted. 0 means unlimited.");
+TAG_FLAG(scanner_admission_max_concurrent, advanced);
+TAG_FLAG(scanner_admission_max_concurrent, runtime);
+
+DEFINE_int64(scanner_admission_memory_budget_bytes, 1024 * 1024 * 1024,
+             "Maximum memory that the responses of the scan requests running at "
+             "once may use. -1 means unlimited.");
+TAG_FLAG(scanner_admission_memory_budget_bytes, advanced);
+
+DEFINE_int32(scanner_admission_max_queued, 10,
+             "Maximum number of scan requests waiting to be admitted, each of which "
+             "holds an RPC service thread. Other requests are rejected, and retried "
+             "by clients.");
+TAG_FLAG(scanner_admission_max_queued, advanced);
+TAG_FLAG(scanner_admission_max_queued, runtime);
+
+DEFINE_int32(scanner_admission_max_wait_ms, 5000,
+             "Maximum time a scan request waits to be admitted before being "
+             "rejected, and retried by its client.");
+TAG_FLAG(scanner_admission_max_wait_ms, advanced);
+TAG_FLAG(scanner_admission_max_wait_ms, runtime);
+
+METRIC_DEFINE_gauge_int32(server, scan_requests_queued,
+                          "Scan Requests Queued", kudu::MetricUnit::kRequests,
+                          "Number of scan requests waiting to be admitted");
+METRIC_DEFINE_gauge_int32(server, scan_requests_running,
+                          "Scan Requests Running", kudu::MetricUnit::kRequests,
+                          "Number of scan requests admitted and running");
+METRIC_DEFINE_histogram(server, scan_admission_wait_time,
+                        "Scan Admission Wait Time", kudu::MetricUnit::kMicroseconds,
+                        "Time that scan requests which had to wait were queued for "
+                        "admission, whether or not they were admitted",
+                        60000000LU, 2);
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace tserver {
+
+ScanAdmissionController::Admission::Admission(ScanAdmissionController* controller,
+                                              string user, int64_t bytes)
+    : controller_(controller),
+      user_(std::move(user)),
+      bytes_(bytes) {
+}
+
+ScanAdmissionController::Admission::~Admission() {
+  controller_->Release(user_, bytes_);
+}
+
+ScanAdmissionController::ScanAdmissionController(
+    const shared_ptr<MemTracker>& parent_mem_tracker,
+    const scoped_refptr<MetricEntity>& metric_entity)
+    : mem_tracker_(MemTracker::CreateTracker(FLAGS_scanner_admission_memory_budget_bytes,
+                                             "scans", parent_mem_tracker)),
+      admitted_cond_(&lock_),
+      num_running_(0) {
+  if (metric_entity) {
+    queued_gauge_ = METRIC_scan_requests_queued.Instantiate(metric_entity, 0);
+    running_gauge_ = METRIC_scan_requests_running.Instantiate(metric_entity, 0);
+    wait_time_us_ = METRIC_scan_admission_wait_time.Instantiate(metric_entity);
+  }
+}
+
+ScanAdmissionController::~ScanAdmissionController() {
+  DCHECK_EQ(0, num_running_);
+  DCHECK(waiters_.empty());
+}
+
+Status ScanAdmissionController::Admit(const string& user, const string& scanner_id,
+                                      int64_t bytes, const MonoTime& deadline,
+                                      gscoped_ptr<Admission>* admission) {
+  MonoTime now = MonoTime::Now();
+  MutexLock l(lock_);
+  if (waiters_.empty() && TryStartUnlocked(user, bytes)) {
+    admission->reset(new Admission(this, user, bytes));
+    return Status::OK();
+  }
+  if (static_cast<int>(waiters_.size()) >= FLAGS_scanner_admission_max_queued) {
+    return Status::ServiceUnavailable(Substitute(
+        "Scan request rejected: $0 scan requests are already waiting to run",
+        waiters_.size()));
+  }
+
+  Waiter waiter = { { user, scanner_id, bytes, now }, false };
+  waiters_.push_back(&waiter);
+  if (queued_gauge_) {
+    queued_gauge_->Increment();
+  }
+  MonoTime wait_deadline = MonoTime::Earliest(
+      deadline, now + MonoDelta::FromMilliseconds(FLAGS_scanner_admission_max_wait_ms));
+  while (!waiter.admitted) {
+    MonoTime wait_now = MonoTime::Now();
+    if (wait_now >= wait_deadline) {
+      break;
+    }
+    admitted_cond_.TimedWait(wait_deadline - wait_now);
+  }
+  if (wait_time_us_) {
+    wait_time_us_->Increment((MonoTime::Now() - now).ToMicroseconds());
+  }
+  if (!waiter.admitted) {
+    waiters_.remove(&waiter);
+    if (queued_gauge_) {
+      queued_gauge_->Decrement();
+    }
+    // The waiter may have blocked others behind it.
+    AdmitWaitersUnlocked();
+    return Status::ServiceUnavailable("Scan request rejected: timed out waiting to run");
+  }
+  admission->reset(new Admission(this, user, bytes));
+  return Status::OK();
+}
+
+void ScanAdmissionController::Release(const string& user, int64_t bytes) {
+  MutexLock l(lock_);
+  mem_tracker_->Release(bytes);
+  num_running_--;
+  if (--FindOrDie(num_running_by_user_, user) == 0) {
+    num_running_by_user_.erase(user);
+  }
+  if (running_gauge_) {
+    running_gauge_->Decrement();
+  }
+  AdmitWaitersUnlocked();
+}
+
+bool ScanAdmissionController::TryStartUnlocked(const string& user, int64_t bytes) {
+  lock_.AssertAcquired();
+  int max_concurrent = FLAGS_scanner_admission_max_concurrent;
+  if (num_running_ > 0) {
+    if (max_concurrent > 0 && num_running_ >= max_concurrent) {
+      return false;
+    }
+    if (!mem_tracker_->TryConsume(bytes)) {
+      return false;
+    }
+  } else {
+    // A request always runs on its own, even if it doesn't fit.
+    mem_tracker_->Consume(bytes);
+  }
+  num_running_++;
+  num_running_by_user_[user]++;
+  if (running_gauge_) {
+    running_gauge_->Increment();
+  }
+  return true;
+}
+
+ScanAdmissionController::Waiter* ScanAdmissionController::NextWaiterUnlocked() const {
+  lock_.AssertAcquired();
+  Waiter* next = nullptr;
+  int next_user_running = 0;
+  for (Waiter* waiter : waiters_) {
+    int user_running = FindWithDefault(num_running_by_user_, waiter->request.user, 0);
+    // 'waiters_' is in arrival order, so the earliest of the users with the
+    // fewest running requests comes first.
+    if (next == nullptr || user_running < next_user_running) {
+      next = waiter;
+      next_user_running = user_running;
+    }
+  }
+  return next;
+}
+
+void ScanAdmissionController::AdmitWaitersUnlocked() {
+  lock_.AssertAcquired();
+  bool admitted = false;
+  while (true) {
+    Waiter* next = NextWaiterUnlocked();
+    if (next == nullptr || !TryStartUnlocked(next->request.user, next->request.bytes)) {
+      break;
+    }
+    next->admitted = true;
+    waiters_.remove(next);
+    if (queued_gauge_) {
+      queued_gauge_->Decrement();
+    }
+    admitted = true;
+  }
+  if (admitted) {
+    admitted_cond_.Broadcast();
+  }
+}
+
+void ScanAdmissionController::GetQueue(vector<QueuedRequest>* queue) const {
+  MutexLock l(lock_);
+  // Order the waiters as NextWaiterUnlocked() would pick them, assuming each
+  // of them runs.
+  std::unordered_map<string, int> num_running_by_user = num_running_by_user_;
+  std::list<Waiter*> waiters = waiters_;
+  while (!waiters.empty()) {
+    auto next = waiters.begin();
+    for (auto it = waiters.begin(); it != waiters.end(); ++it) {
+      if (num_running_by_user[(*it)->request.user] <
+          num_running_by_user[(*next)->request.user]) {
+        next = it;
+      }
+    }
+    num_running_by_user[(*next)->request.user]++;
+    queue->push_back((*next)->request);
+    waiters.erase(next);
+  }
+}
+
+int ScanAdmissionController::num_running() const {
+  MutexLock l(lock_);
+  return num_running_;
+}
+
+} // namespace tserver
+} // namespace kudu
@@ -0,0 +1,151 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TSERVER_SCAN_ADMISSION_CONTROLLER_H
+#define KUDU_TSERVER_SCAN_ADMISSION_CONTROLLER_H
+
+#include <stdint.h>
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/mutex.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+template<class T>
+class AtomicGauge;
+class Histogram;
+class MemTracker;
+class MetricEntity;
+
+namespace tserver {
+
+// Limits the scan requests that a tablet server runs at once, so that a
+// burst of scans queues up rather than making every scan slow and the
+// server balloon in memory.
+//
+// A request is admitted once fewer than --scanner_admission_max_concurrent
+// requests run, and the memory it may use for its response fits in the
+// "scans" MemTracker, limited to --scanner_admission_memory_budget_bytes
+// (and by the limits of its ancestors). Requests which don't fit wait in
+// line, ordered by how many requests of their user already run, then by
+// arrival, so that a user with many scans can't starve the others. Since a
+// waiting request holds an RPC service thread, at most
+// --scanner_admission_max_queued requests wait; the others, and those
+// which aren't admitted within --scanner_admission_max_wait_ms, are
+// rejected with ServiceUnavailable, which clients retry after backing off.
+//
+// This class is thread-safe.
+class ScanAdmissionController {
+ public:
+  // An admitted request, which leaves the budgets on destruction.
+  class Admission {
+   public:
+    ~Admission();
+
+   private:
+    friend class ScanAdmissionController;
+
+    Admission(ScanAdmissionController* controller, std::string user, int64_t bytes);
+
+    ScanAdmissionController* const controller_;
+    const std::string user_;
+    const int64_t bytes_;
+
+    DISALLOW_COPY_AND_ASSIGN(Admission);
+  };
+
+  // A request waiting in line, as listed by GetQueue().
+  struct QueuedRequest {
+    std::string user;
+
+    // The scanner continued by the request, or empty for a new scan.
+    std::string scanner_id;
+
+    int64_t bytes;
+    MonoTime arrival_time;
+  };
+
+  // 'metric_entity' may be NULL, in which case no metrics are produced.
+  ScanAdmissionController(const std::shared_ptr<MemTracker>& parent_mem_tracker,
+                          const scoped_refptr<MetricEntity>& metric_entity);
+  ~ScanAdmissionController();
+
+  // Admits a request of 'user' for 'scanner_id' (empty for a new scan), which
+  // may use 'bytes' of memory, waiting in line until then or 'deadline'.
+  Status Admit(const std::string& user, const std::string& scanner_id, int64_t bytes,
+               const MonoTime& deadline, gscoped_ptr<Admission>* admission);
+
+  // Returns the waiting requests, in the order they'll be admitted in.
+  void GetQueue(std::vector<QueuedRequest>* queue) const;
+
+  // Returns the number of admitted requests.
+  int num_running() const;
+
+ private:
+  struct Waiter {
+    QueuedRequest request;
+    bool admitted;
+  };
+
+  // Leaves the budgets, on destruction of an Admission.
+  void Release(const std::string& user, int64_t bytes);
+
+  // Enters the budgets if 'bytes' fit, in which case returns true.
+  bool TryStartUnlocked(const std::string& user, int64_t bytes);
+
+  // Returns the waiter to admit next, or NULL if there are none.
+  Waiter* NextWaiterUnlocked() const;
+
+  // Admits the waiters which fit, in order.
+  void AdmitWaitersUnlocked();
+
+  std::shared_ptr<MemTracker> mem_tracker_;
+
+  mutable Mutex lock_;
+
+  // Signalled when waiters are admitted.
+  ConditionVariable admitted_cond_;
+
+  // The waiting requests, in arrival order. Protected by 'lock_'.
+  std::list<Waiter*> waiters_;
+
+  // The number of running requests, in total and per user. Protected by
+  // 'lock_'.
+  int num_running_;
+  std::unordered_map<std::string, int> num_running_by_user_;
+
+  scoped_refptr<AtomicGauge<int32_t>> queued_gauge_;
+  scoped_refptr<AtomicGauge<int32_t>> running_gauge_;
+  scoped_refptr<Histogram> wait_time_us_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanAdmissionController);
+};
+
+} // namespace tserver
+} // namespace kudu
+
+#endif // KUDU_TSERVER_SCAN_ADMISSION_CONTROLLER_H
@@ -0,0 +1,133 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tserver/scan_result_cache.h"
+
+#include <string>
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include "kudu/util/metrics.h"
+#include "kudu/util/test_util.h"
+
+DECLARE_int32(scan_result_cache_capacity_mb);
+DECLARE_int32(scan_result_cache_max_result_kb);
+
+METRIC_DECLARE_counter(scan_result_cache_hits);
+METRIC_DECLARE_counter(scan_result_cache_misses);
+
+using std::string;
+
+namespace kudu {
+namespace tserver {
+
+class ScanResultCacheTest : public KuduTest {
+ public:
+  ScanResultCacheTest()
+      : entity_(METRIC_ENTITY_server.Instantiate(&registry_, "test")) {
+  }
+
+ protected:
+  static ScanResultCache::Result MakeResult(uint64_t snap_timestamp, const string& rows) {
+    ScanResultCache::Result result;
+    result.snap_timestamp = Timestamp(snap_timestamp);
+    result.resp.mutable_data()->set_num_rows(1);
+    result.resp.mutable_data()->set_rows_sidecar(0);
+    result.sidecars.push_back(rows);
+    return result;
+  }
+
+  int64_t CounterValue(CounterPrototype* prototype) {
+    return prototype->Instantiate(entity_)->value();
+  }
+
+  MetricRegistry registry_;
+  scoped_refptr<MetricEntity> entity_;
+};
+
+// Test that the scan timestamps and the other details of cached results
+// don't tell keys apart, unlike anything else in the scan.
+TEST_F(ScanResultCacheTest, TestKeys) {
+  NewScanRequestPB scan_pb;
+  scan_pb.set_tablet_id("tablet");
+  scan_pb.set_read_mode(READ_AT_SNAPSHOT);
+  string key = ScanResultCache::MakeKey(scan_pb, 1024, 1, 0);
+
+  NewScanRequestPB other_pb(scan_pb);
+  other_pb.set_snap_timestamp(10);
+  other_pb.set_propagated_timestamp(5);
+  other_pb.set_cache_blocks(false);
+  ASSERT_EQ(key, ScanResultCache::MakeKey(other_pb, 1024, 1, 0));
+
+  ASSERT_NE(key, ScanResultCache::MakeKey(scan_pb, 2048, 1, 0));
+  ASSERT_NE(key, ScanResultCache::MakeKey(scan_pb, 1024, 2, 0));
+  ASSERT_NE(key, ScanResultCache::MakeKey(scan_pb, 1024, 1, 1));
+  other_pb = scan_pb;
+  other_pb.set_limit(1);
+  ASSERT_NE(key, ScanResultCache::MakeKey(other_pb, 1024, 1, 0));
+}
+
+// Test that cached results are only returned at snapshots which no writes
+// tell apart from theirs.
+TEST_F(ScanResultCacheTest, TestValidity) {
+  FLAGS_scan_result_cache_capacity_mb = 1;
+  ScanResultCache cache(entity_);
+  ASSERT_TRUE(cache.enabled());
+
+  ScanResultCache::Result result;
+  ASSERT_FALSE(cache.Lookup("key", Timestamp(100), Timestamp(10), &result));
+  ASSERT_EQ(1, CounterValue(&METRIC_scan_result_cache_misses));
+
+  cache.Insert("key", MakeResult(100, "rows"));
+
+  // The tablet was last written before both snapshots, which may be before or
+  // after that of the cached result.
+  for (uint64_t snap_timestamp : { 50, 100, 200 }) {
+    ASSERT_TRUE(cache.Lookup("key", Timestamp(snap_timestamp), Timestamp(50), &result));
+    ASSERT_EQ(Timestamp(100), result.snap_timestamp);
+    ASSERT_EQ(1, result.resp.data().num_rows());
+    ASSERT_EQ(1, result.sidecars.size());
+    ASSERT_EQ("rows", result.sidecars[0]);
+  }
+  ASSERT_EQ(3, CounterValue(&METRIC_scan_result_cache_hits));
+
+  // A write between the snapshots drops the result.
+  ASSERT_FALSE(cache.Lookup("key", Timestamp(200), Timestamp(150), &result));
+  ASSERT_FALSE(cache.Lookup("key", Timestamp(200), Timestamp(10), &result));
+  ASSERT_EQ(3, CounterValue(&METRIC_scan_result_cache_misses));
+
+  // Results are replaced.
+  cache.Insert("key", MakeResult(200, "old rows"));
+  cache.Insert("key", MakeResult(300, "new rows"));
+  ASSERT_TRUE(cache.Lookup("key", Timestamp(300), Timestamp(10), &result));
+  ASSERT_EQ("new rows", result.sidecars[0]);
+}
+
+// Test that the cache can be disabled, and that only small results are cached.
+TEST_F(ScanResultCacheTest, TestLimits) {
+  FLAGS_scan_result_cache_capacity_mb = 0;
+  ScanResultCache cache(entity_);
+  ASSERT_FALSE(cache.enabled());
+
+  FLAGS_scan_result_cache_max_result_kb = 1;
+  ASSERT_TRUE(ScanResultCache::IsCacheableSize(1024));
+  ASSERT_FALSE(ScanResultCache::IsCacheableSize(1025));
+}
+
+} // namespace tserver
+} // namespace kudu
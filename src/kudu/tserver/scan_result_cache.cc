@@ -0,0 +1,154 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tserver/scan_result_cache.h"
+
+#include <string.h>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/util/cache.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/pb_util.h"
+
+DEFINE_int32(scan_result_cache_capacity_mb, 0,
+             "Capacity of the cache of the results of small snapshot scans, with "
+             "which repeated scans of tablets that aren't written to meanwhile are "
+             "answered without reading the tablets again. 0 disables the cache.");
+TAG_FLAG(scan_result_cache_capacity_mb, advanced);
+TAG_FLAG(scan_result_cache_capacity_mb, experimental);
+
+DEFINE_int32(scan_result_cache_max_result_kb, 64,
+             "Maximum size of the results cached in the scan result cache. Scans "
+             "with larger results aren't cached.");
+TAG_FLAG(scan_result_cache_max_result_kb, advanced);
+TAG_FLAG(scan_result_cache_max_result_kb, runtime);
+
+METRIC_DEFINE_counter(server, scan_result_cache_hits,
+                      "Scan Result Cache Hits", kudu::MetricUnit::kCacheHits,
+                      "Number of snapshot scans answered from the scan result cache");
+METRIC_DEFINE_counter(server, scan_result_cache_misses,
+                      "Scan Result Cache Misses", kudu::MetricUnit::kCacheQueries,
+                      "Number of snapshot scans looked up in the scan result cache "
+                      "which had no valid result there");
+
+using std::string;
+
+namespace kudu {
+namespace tserver {
+
+ScanResultCache::ScanResultCache(const scoped_refptr<MetricEntity>& metric_entity) {
+  if (FLAGS_scan_result_cache_capacity_mb > 0) {
+    cache_.reset(NewLRUCache(DRAM_CACHE,
+                             static_cast<size_t>(FLAGS_scan_result_cache_capacity_mb) * 1024 * 1024,
+                             "scan_result_cache"));
+  }
+  if (metric_entity) {
+    hits_ = METRIC_scan_result_cache_hits.Instantiate(metric_entity);
+    misses_ = METRIC_scan_result_cache_misses.Instantiate(metric_entity);
+  }
+}
+
+ScanResultCache::~ScanResultCache() {
+}
+
+string ScanResultCache::MakeKey(const NewScanRequestPB& scan_pb,
+                                size_t batch_size_bytes,
+                                uint64_t row_history_id,
+                                uint32_t schema_version) {
+  NewScanRequestPB key_pb(scan_pb);
+  key_pb.clear_snap_timestamp();
+  key_pb.clear_propagated_timestamp();
+  key_pb.clear_cache_blocks();
+
+  faststring key;
+  PutFixed64(&key, row_history_id);
+  PutFixed32(&key, schema_version);
+  PutFixed64(&key, batch_size_bytes);
+  pb_util::AppendToString(key_pb, &key);
+  return key.ToString();
+}
+
+bool ScanResultCache::IsCacheableSize(int64_t result_bytes) {
+  return result_bytes <= static_cast<int64_t>(FLAGS_scan_result_cache_max_result_kb) * 1024;
+}
+
+bool ScanResultCache::Lookup(const string& key,
+                             const Timestamp& snap_timestamp,
+                             const Timestamp& last_write_timestamp,
+                             Result* result) {
+  DCHECK(enabled());
+  Cache::Handle* handle = cache_->Lookup(key, Cache::EXPECT_IN_CACHE);
+  bool found = false;
+  if (handle) {
+    Slice value = cache_->Value(handle);
+    Timestamp cached_timestamp(DecodeFixed64(value.data()));
+    value.remove_prefix(sizeof(uint64_t));
+
+    // Results don't change between snapshots with no writes between them.
+    const Timestamp& earliest = cached_timestamp.ComesBefore(snap_timestamp) ?
+        cached_timestamp : snap_timestamp;
+    if (!earliest.ComesBefore(last_write_timestamp)) {
+      Slice resp_data;
+      CHECK(GetLengthPrefixedSlice(&value, &resp_data));
+      result->snap_timestamp = cached_timestamp;
+      CHECK(result->resp.ParseFromArray(resp_data.data(), resp_data.size()));
+      result->sidecars.clear();
+      Slice sidecar;
+      while (GetLengthPrefixedSlice(&value, &sidecar)) {
+        result->sidecars.push_back(sidecar.ToString());
+      }
+      found = true;
+    }
+    cache_->Release(handle);
+    if (!found) {
+      cache_->Erase(key);
+    }
+  }
+  if (found && hits_) {
+    hits_->Increment();
+  } else if (!found && misses_) {
+    misses_->Increment();
+  }
+  return found;
+}
+
+void ScanResultCache::Insert(const string& key, const Result& result) {
+  DCHECK(enabled());
+  faststring value;
+  PutFixed64(&value, result.snap_timestamp.ToUint64());
+  faststring resp_data;
+  pb_util::AppendToString(result.resp, &resp_data);
+  PutLengthPrefixedSlice(&value, resp_data);
+  for (const string& sidecar : result.sidecars) {
+    PutLengthPrefixedSlice(&value, sidecar);
+  }
+
+  int charge = key.size() + value.size();
+  Cache::PendingHandle* pending = cache_->Allocate(key, value.size(), charge);
+  if (pending) {
+    memcpy(cache_->MutableValue(pending), value.data(), value.size());
+    cache_->Release(cache_->Insert(pending, nullptr));
+  }
+}
+
+} // namespace tserver
+} // namespace kudu
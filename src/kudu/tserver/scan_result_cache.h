@@ -0,0 +1,107 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TSERVER_SCAN_RESULT_CACHE_H
+#define KUDU_TSERVER_SCAN_RESULT_CACHE_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "kudu/common/timestamp.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/tserver/tserver.pb.h"
+
+namespace kudu {
+
+class Cache;
+class Counter;
+class MetricEntity;
+
+namespace tserver {
+
+// A cache of the results of small snapshot scans, so that scans which are
+// repeated over and over, as dashboards do, are answered without reading the
+// tablet again.
+//
+// A result is cached along with the snapshot timestamp it was read at. It is
+// valid at another snapshot as long as no write was applied to the tablet
+// between the two, which the caller tells by passing the timestamp of the
+// last write applied to the tablet. Entries are keyed by whatever else
+// determines the result, see MakeKey().
+//
+// The cache is bounded by --scan_result_cache_capacity_mb, and accounted for
+// in its own MemTracker. A capacity of 0 disables it.
+//
+// This class is thread-safe.
+class ScanResultCache {
+ public:
+  // A cached result: the response to a scan which returned all of its rows at
+  // once, along with the contents of its sidecars in the order they were
+  // attached, so that the sidecar indexes in 'resp' still hold.
+  struct Result {
+    Timestamp snap_timestamp;
+    ScanResponsePB resp;
+    std::vector<std::string> sidecars;
+  };
+
+  // 'metric_entity' may be NULL, in which case no metrics are produced.
+  explicit ScanResultCache(const scoped_refptr<MetricEntity>& metric_entity);
+  ~ScanResultCache();
+
+  // Returns whether results are cached at all.
+  bool enabled() const { return cache_ != nullptr; }
+
+  // Returns the key of the result of 'scan_pb', returning at most
+  // 'batch_size_bytes' of rows at once, on the tablet whose rows have
+  // history 'row_history_id' and whose schema has version 'schema_version'.
+  // The snapshot timestamp of the scan isn't part of the key.
+  static std::string MakeKey(const NewScanRequestPB& scan_pb,
+                             size_t batch_size_bytes,
+                             uint64_t row_history_id,
+                             uint32_t schema_version);
+
+  // Returns whether a result of the given size may be cached.
+  static bool IsCacheableSize(int64_t result_bytes);
+
+  // Sets 'result' to the result cached under 'key', if it's valid at
+  // 'snap_timestamp' of a tablet whose last write was applied at
+  // 'last_write_timestamp', in which case returns true. 'snap_timestamp'
+  // must be a clean snapshot. Results which aren't valid are dropped.
+  bool Lookup(const std::string& key,
+              const Timestamp& snap_timestamp,
+              const Timestamp& last_write_timestamp,
+              Result* result);
+
+  // Caches 'result' under 'key', replacing any result already there.
+  void Insert(const std::string& key, const Result& result);
+
+ private:
+  gscoped_ptr<Cache> cache_;
+
+  scoped_refptr<Counter> hits_;
+  scoped_refptr<Counter> misses_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanResultCache);
+};
+
+} // namespace tserver
+} // namespace kudu
+
+#endif // KUDU_TSERVER_SCAN_RESULT_CACHE_H
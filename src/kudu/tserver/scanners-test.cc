@@ -24,6 +24,7 @@
 #include "kudu/util/metrics.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_int32(scanner_memory_budget_bytes);
 DECLARE_int32(scanner_ttl_ms);
 
 namespace kudu {
@@ -81,5 +82,50 @@ TEST(ScannerTest, TestExpire) {
   ASSERT_EQ(s2->id(), active_scanners[0]->id());
 }
 
+TEST(ScanBatchSizerTest, TestBlockRows) {
+  google::FlagSaver saver;
+  ScanBatchSizer sizer;
+  // Until a block is scanned, every row is expected to be returned.
+  ASSERT_EQ(100, sizer.BlockRows(10, 1000));
+
+  // With one row in ten returned, blocks grow tenfold, up to a limit.
+  sizer.BlockScanned(100, 10, 100);
+  ASSERT_EQ(1000, sizer.BlockRows(10, 1000));
+  ASSERT_EQ(16 * 1024, sizer.BlockRows(10, 1 << 30));
+  ASSERT_EQ(1, sizer.BlockRows(10, 0));
+
+  // Wide rows are bounded by the memory budget.
+  FLAGS_scanner_memory_budget_bytes = 2 * 100 * 1000;
+  ASSERT_EQ(100, sizer.BlockRows(1000, 1 << 30));
+
+  // Scans which filter out all their rows so far read the largest blocks.
+  ScanBatchSizer filtered;
+  filtered.BlockScanned(100, 0, 0);
+  ASSERT_EQ(100, filtered.BlockRows(1000, 1000));
+}
+
+TEST(ScanBatchSizerTest, TestResponseBytes) {
+  ScanBatchSizer sizer;
+  MonoTime now = MonoTime::Now();
+  ASSERT_EQ(1000, sizer.ResponseBytes(1000, now));
+
+  // Responses shrink while the client is slow to come back for them...
+  const MonoDelta fill_time = MonoDelta::FromMilliseconds(1);
+  const MonoDelta slow_gap = MonoDelta::FromMilliseconds(100);
+  for (int expected : { 500, 250, 250 }) {
+    sizer.ResponseFilled(now, now + fill_time);
+    now += fill_time;
+    now += slow_gap;
+    ASSERT_EQ(expected, sizer.ResponseBytes(1000, now));
+  }
+
+  // ...and grow back, up to the requested size, once it keeps up.
+  for (int expected : { 500, 1000, 1000 }) {
+    sizer.ResponseFilled(now, now + fill_time);
+    now += fill_time;
+    ASSERT_EQ(expected, sizer.ResponseBytes(1000, now));
+  }
+}
+
 } // namespace tserver
 } // namespace kudu
@@ -17,6 +17,7 @@
 #include "kudu/tserver/scanners.h"
 
 #include <gflags/gflags.h>
+#include <algorithm>
 #include <mutex>
 
 #include "kudu/common/iterator.h"
@@ -35,6 +36,11 @@ TAG_FLAG(scanner_ttl_ms, advanced);
 DEFINE_int32(scanner_gc_check_interval_us, 5 * 1000L *1000L, // 5 seconds
              "Number of microseconds in the interval at which we remove expired scanners");
 TAG_FLAG(scanner_gc_check_interval_us, hidden);
+DEFINE_int32(scanner_memory_budget_bytes, 32 * 1024 * 1024,
+             "Memory budget of a scan request, half of which bounds the rows read "
+             "from the tablet at a time, and half the response.");
+TAG_FLAG(scanner_memory_budget_bytes, advanced);
+TAG_FLAG(scanner_memory_budget_bytes, runtime);
 
 // TODO: would be better to scope this at a tablet level instead of
 // server level.
@@ -185,6 +191,10 @@ Scanner::Scanner(string id, const scoped_refptr<TabletPeer>& tablet_peer,
       call_seq_id_(0),
       start_time_(MonoTime::Now()),
       metrics_(metrics),
+      row_format_flags_(0),
+      resumable_(false),
+      resume_snap_timestamp_(0),
+      remaining_rows_(-1),
       arena_(1024, 1024 * 1024) {
   UpdateAccessTime();
 }
@@ -216,6 +226,65 @@ void Scanner::GetIteratorStats(vector<IteratorStats>* stats) const {
   iter_->GetIteratorStats(stats);
 }
 
+// Bounds on ScanBatchSizer::response_scale_.
+static const double kMinResponseScale = 0.25;
+static const double kMaxResponseScale = 1;
+
+// Past this many rows, larger blocks don't amortize the per-block overhead
+// any further.
+static const size_t kMaxBlockRows = 16 * 1024;
+
+ScanBatchSizer::ScanBatchSizer()
+    : rows_scanned_(0),
+      rows_returned_(0),
+      bytes_returned_(0),
+      response_scale_(kMaxResponseScale) {
+}
+
+size_t ScanBatchSizer::ResponseBytes(size_t hint_bytes, const MonoTime& now) {
+  if (last_response_time_.Initialized()) {
+    int64_t gap_nanos = (now - last_response_time_).ToNanoseconds();
+    int64_t fill_nanos = last_fill_time_.ToNanoseconds();
+    if (gap_nanos <= fill_nanos) {
+      response_scale_ = std::min(response_scale_ * 2, kMaxResponseScale);
+    } else if (gap_nanos > 8 * fill_nanos) {
+      response_scale_ = std::max(response_scale_ / 2, kMinResponseScale);
+    }
+  }
+  size_t max_bytes = std::max(FLAGS_scanner_memory_budget_bytes / 2, 1);
+  return std::max<size_t>(1, std::min<size_t>(hint_bytes * response_scale_, max_bytes));
+}
+
+size_t ScanBatchSizer::BlockRows(size_t row_bytes, size_t remaining_bytes) const {
+  // Indirect data, such as strings, is returned along with the rows, so the
+  // returned rows hint at how much of it the block's rows hold.
+  double block_row_bytes = std::max<double>(row_bytes, 1);
+  double bytes_per_scanned_row = block_row_bytes;
+  if (rows_scanned_ > 0) {
+    if (rows_returned_ > 0) {
+      block_row_bytes = std::max(block_row_bytes,
+                                 static_cast<double>(bytes_returned_) / rows_returned_);
+    }
+    bytes_per_scanned_row = static_cast<double>(bytes_returned_) / rows_scanned_;
+  }
+  double max_rows = std::min<double>(
+      kMaxBlockRows, FLAGS_scanner_memory_budget_bytes / 2 / block_row_bytes);
+  double rows = bytes_per_scanned_row > 0 ? remaining_bytes / bytes_per_scanned_row : max_rows;
+  return std::max<size_t>(1, std::min(rows, max_rows));
+}
+
+void ScanBatchSizer::BlockScanned(size_t rows_scanned, size_t rows_returned,
+                                  size_t bytes_returned) {
+  rows_scanned_ += rows_scanned;
+  rows_returned_ += rows_returned;
+  bytes_returned_ += bytes_returned;
+}
+
+void ScanBatchSizer::ResponseFilled(const MonoTime& start, const MonoTime& now) {
+  last_fill_time_ = now - start;
+  last_response_time_ = now;
+}
+
 
 } // namespace tserver
 } // namespace kudu
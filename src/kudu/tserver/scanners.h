@@ -25,6 +25,7 @@
 #include <vector>
 
 #include "kudu/common/iterator_stats.h"
+#include "kudu/common/scan_aggregate.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
@@ -165,6 +166,56 @@ class ScopedUnregisterScanner {
 };
 
 // An open scanner on the server side.
+// Sizes the blocks of rows that a scanner reads from its iterator, and the
+// responses that it fills, from what it observed of its previous blocks and
+// responses. Half of --scanner_memory_budget_bytes bounds the rows of a block,
+// and the other half bounds a response.
+//
+// Blocks are sized for their returned rows to just fill what's left of the
+// response, given the observed selectivity of the scan and size of the
+// returned rows: narrow scans read a few large blocks rather than many small
+// ones, and wide ones don't overshoot. Responses shrink, down to a quarter of
+// the size requested, while the client takes a lot longer to come back for the
+// next response than it took to fill the previous one, and grow back when it
+// keeps up.
+//
+// Not thread-safe: a scanner serves one request at a time.
+class ScanBatchSizer {
+ public:
+  ScanBatchSizer();
+
+  // Returns the size of the response to fill, given the size 'hint_bytes'
+  // requested, for a request which arrived at 'now'.
+  size_t ResponseBytes(size_t hint_bytes, const MonoTime& now);
+
+  // Returns the number of rows of the next block, with 'remaining_bytes' of
+  // the response left to fill and rows taking 'row_bytes' each in a block.
+  size_t BlockRows(size_t row_bytes, size_t remaining_bytes) const;
+
+  // Records that a block of 'rows_scanned' rows added 'rows_returned' rows,
+  // and 'bytes_returned' bytes, to the response.
+  void BlockScanned(size_t rows_scanned, size_t rows_returned, size_t bytes_returned);
+
+  // Records that the response to the request which arrived at 'start' was
+  // filled at 'now'.
+  void ResponseFilled(const MonoTime& start, const MonoTime& now);
+
+ private:
+  // The totals of the blocks scanned so far.
+  int64_t rows_scanned_;
+  int64_t rows_returned_;
+  int64_t bytes_returned_;
+
+  // The fraction of the requested size that responses are filled to.
+  double response_scale_;
+
+  // How long the previous response took to fill, and when it was filled.
+  MonoDelta last_fill_time_;
+  MonoTime last_response_time_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanBatchSizer);
+};
+
 class Scanner {
  public:
   explicit Scanner(std::string id,
@@ -262,6 +313,60 @@ class Scanner {
   // See the note about 'set_client_projection_schema' above.
   const Schema* client_projection_schema() const { return client_projection_schema_.get(); }
 
+  // Set the bitmask of RowFormatFlags with which the scanned rows should be
+  // returned to the client.
+  void set_row_format_flags(uint64_t row_format_flags) {
+    row_format_flags_ = row_format_flags;
+  }
+
+  uint64_t row_format_flags() const { return row_format_flags_; }
+
+  // Set the aggregates which are computed over the scanned rows in place of
+  // returning the rows, and the schema of their results.
+  void set_aggregates(std::vector<ScanAggregate> aggregates,
+                      gscoped_ptr<Schema> aggregate_result_schema) {
+    aggregates_ = std::move(aggregates);
+    aggregate_result_schema_.swap(aggregate_result_schema);
+  }
+
+  // Returns the aggregates requested when the scan was started, which are
+  // empty unless this is an aggregating scan.
+  const std::vector<ScanAggregate>& aggregates() const { return aggregates_; }
+
+  // Returns the schema of the aggregate results, or NULL if this is not an
+  // aggregating scan.
+  const Schema* aggregate_result_schema() const { return aggregate_result_schema_.get(); }
+
+  // Set the grouping of the aggregates, for scans with a GROUP BY. The
+  // aggregate result schema must be that of the grouping.
+  void set_group_by(std::unique_ptr<ScanGroupBy> group_by) {
+    group_by_ = std::move(group_by);
+  }
+
+  // Returns the grouping of the aggregates, which has no groups of its own,
+  // or NULL if the aggregates aren't grouped.
+  const ScanGroupBy* group_by() const { return group_by_.get(); }
+
+  // Marks the scan as resumable, reading at the snapshot 'snap_timestamp'.
+  // iter() must then be a tablet iterator made by
+  // Tablet::NewResumableRowIterator().
+  void set_resumable(uint64_t snap_timestamp) {
+    resumable_ = true;
+    resume_snap_timestamp_ = snap_timestamp;
+  }
+
+  bool resumable() const { return resumable_; }
+
+  // Set the number of rows the scan may still return. Negative if the scan
+  // has no limit.
+  void set_remaining_rows(int64_t remaining_rows) {
+    remaining_rows_ = remaining_rows;
+  }
+
+  int64_t remaining_rows() const { return remaining_rows_; }
+
+  uint64_t resume_snap_timestamp() const { return resume_snap_timestamp_; }
+
   // Get per-column stats for each iterator.
   void GetIteratorStats(std::vector<IteratorStats>* stats) const;
 
@@ -272,6 +377,17 @@ class Scanner {
     already_reported_stats_ = stats;
   }
 
+  const std::vector<IteratorStats>& already_profiled_stats_by_col() const {
+    return already_profiled_stats_by_col_;
+  }
+  void set_already_profiled_stats_by_col(const std::vector<IteratorStats>& stats) {
+    already_profiled_stats_by_col_ = stats;
+  }
+
+  ScanBatchSizer* batch_sizer() {
+    return &batch_sizer_;
+  }
+
  private:
   friend class ScannerManager;
 
@@ -305,6 +421,12 @@ class Scanner {
   // as the scanner proceeds.
   IteratorStats already_reported_stats_;
 
+  // The per-column statistics already returned in the scan profiles of
+  // previous responses, if the client asked for profiles.
+  std::vector<IteratorStats> already_profiled_stats_by_col_;
+
+  ScanBatchSizer batch_sizer_;
+
   // The spec used by 'iter_'
   gscoped_ptr<ScanSpec> spec_;
 
@@ -312,6 +434,22 @@ class Scanner {
   // schema used by the iterator.
   gscoped_ptr<Schema> client_projection_schema_;
 
+  // The RowFormatFlags requested when the scan was started.
+  uint64_t row_format_flags_;
+
+  // The aggregates requested when the scan was started, and their result
+  // schema.
+  std::vector<ScanAggregate> aggregates_;
+  gscoped_ptr<Schema> aggregate_result_schema_;
+  std::unique_ptr<ScanGroupBy> group_by_;
+
+  // Whether the scan is resumable, and at which snapshot.
+  bool resumable_;
+  uint64_t resume_snap_timestamp_;
+
+  // The number of rows the scan may still return, or -1 if it has no limit.
+  int64_t remaining_rows_;
+
   gscoped_ptr<RowwiseIterator> iter_;
 
   AutoReleasePool autorelease_pool_;
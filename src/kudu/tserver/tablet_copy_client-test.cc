@@ -24,6 +24,9 @@
 
 using std::shared_ptr;
 
+DECLARE_int32(tablet_copy_download_parallelism);
+DECLARE_int32(tablet_copy_transfer_chunk_size_bytes);
+
 namespace kudu {
 namespace tserver {
 
@@ -234,5 +237,25 @@ TEST_F(TabletCopyClientTest, TestDownloadAllBlocks) {
   }
 }
 
+// Test that blocks downloaded concurrently, in many pipelined chunks, match
+// the remote ones.
+TEST_F(TabletCopyClientTest, TestDownloadBlocksInSmallChunks) {
+  FLAGS_tablet_copy_download_parallelism = 8;
+  FLAGS_tablet_copy_transfer_chunk_size_bytes = 64;
+  ASSERT_OK(client_->DownloadBlocks());
+
+  BlockId old_block_id = FirstColumnBlockId(*client_->superblock_);
+  BlockId new_block_id = FirstColumnBlockId(*client_->new_superblock_);
+  faststring old_scratch;
+  faststring new_scratch;
+  Slice old_slice;
+  Slice new_slice;
+  ASSERT_OK(ReadLocalBlockFile(mini_server_->server()->fs_manager(), old_block_id,
+                               &old_scratch, &old_slice));
+  ASSERT_OK(ReadLocalBlockFile(fs_manager_.get(), new_block_id, &new_scratch, &new_slice));
+  ASSERT_GT(old_slice.size(), 2 * FLAGS_tablet_copy_transfer_chunk_size_bytes);
+  ASSERT_EQ(old_slice, new_slice);
+}
+
 } // namespace tserver
 } // namespace kudu
@@ -19,8 +19,11 @@
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
+#include <algorithm>
 #include <memory>
+#include <mutex>
 
+#include "kudu/cfile/compression_codec.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/consensus_meta.h"
 #include "kudu/consensus/metadata.pb.h"
@@ -37,13 +40,16 @@
 #include "kudu/tablet/tablet_peer.h"
 #include "kudu/tserver/tablet_copy.pb.h"
 #include "kudu/tserver/tablet_copy.proxy.h"
+#include "kudu/tserver/tablet_copy_throttler.h"
 #include "kudu/tserver/tablet_server.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/crc.h"
 #include "kudu/util/env.h"
 #include "kudu/util/env_util.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/net/net_util.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_int32(tablet_copy_begin_session_timeout_ms, 3000,
              "Tablet server RPC client timeout for BeginTabletCopySession calls. "
@@ -62,6 +68,19 @@ DEFINE_int32(tablet_copy_dowload_file_inject_latency_ms, 0,
              "to take much longer. For use in tests only.");
 TAG_FLAG(tablet_copy_dowload_file_inject_latency_ms, hidden);
 
+DEFINE_int32(tablet_copy_download_parallelism, 4,
+             "Number of data blocks and WAL segments a tablet copy client "
+             "downloads concurrently.");
+TAG_FLAG(tablet_copy_download_parallelism, advanced);
+
+DEFINE_string(tablet_copy_compression_codec, "lz4",
+              "Codec with which the tablet copy source is asked to compress the "
+              "chunks it sends: one of 'none', 'snappy', 'lz4', 'zlib' or 'zstd'. "
+              "Chunks which barely compress, such as those of compressed blocks, "
+              "are sent uncompressed regardless.");
+TAG_FLAG(tablet_copy_compression_codec, advanced);
+TAG_FLAG(tablet_copy_compression_codec, runtime);
+
 DECLARE_int32(tablet_copy_transfer_chunk_size_bytes);
 
 // RETURN_NOT_OK_PREPEND() with a remote-error unwinding step.
@@ -77,6 +96,7 @@ using consensus::OpId;
 using consensus::RaftConfigPB;
 using consensus::RaftPeerPB;
 using env_util::CopyFile;
+using fs::CreateBlockOptions;
 using fs::WritableBlock;
 using rpc::Messenger;
 using std::shared_ptr;
@@ -95,13 +115,16 @@ using tablet::TabletSuperBlockPB;
 
 TabletCopyClient::TabletCopyClient(std::string tablet_id,
                                              FsManager* fs_manager,
-                                             shared_ptr<Messenger> messenger)
+                                             shared_ptr<Messenger> messenger,
+                                             TabletCopyThrottler* throttler)
     : tablet_id_(std::move(tablet_id)),
       fs_manager_(fs_manager),
       messenger_(std::move(messenger)),
+      throttler_(throttler),
       started_(false),
       downloaded_wal_(false),
       downloaded_blocks_(false),
+      changed_local_state_(false),
       replace_tombstoned_tablet_(false),
       status_listener_(nullptr),
       session_idle_timeout_millis_(0),
@@ -153,6 +176,11 @@ Status TabletCopyClient::Start(const HostPort& copy_source_addr,
   CHECK(!started_);
   start_time_micros_ = GetCurrentTimeMicros();
 
+  RETURN_NOT_OK(ThreadPoolBuilder("tablet-copy-dl")
+                .set_min_threads(0)
+                .set_max_threads(std::max(1, FLAGS_tablet_copy_download_parallelism))
+                .Build(&download_pool_));
+
   Sockaddr addr;
   RETURN_NOT_OK(SockaddrFromHostPort(copy_source_addr, &addr));
   if (addr.IsWildcard()) {
@@ -220,6 +248,7 @@ Status TabletCopyClient::Start(const HostPort& copy_source_addr,
 
     // Remove any existing orphaned blocks from the tablet, and
     // set the data state to 'COPYING'.
+    changed_local_state_ = true;
     RETURN_NOT_OK_PREPEND(meta_->DeleteTabletData(tablet::TABLET_DATA_COPYING, boost::none),
                           "Couldn't replace superblock with COPYING data state");
   } else {
@@ -231,12 +260,14 @@ Status TabletCopyClient::Start(const HostPort& copy_source_addr,
                                           schema, &partition_schema));
 
     // Create the superblock on disk.
+    changed_local_state_ = true;
     RETURN_NOT_OK(TabletMetadata::CreateNew(fs_manager_, tablet_id_,
                                             superblock_->table_name(),
                                             superblock_->table_id(),
                                             schema,
                                             partition_schema,
                                             partition,
+                                            superblock_->compaction_policy(),
                                             tablet::TABLET_DATA_COPYING,
                                             &meta_));
   }
@@ -252,7 +283,7 @@ Status TabletCopyClient::FetchAll(TabletStatusListener* status_listener) {
   CHECK(started_);
   status_listener_ = status_listener;
 
-  // Download all the files (serially, for now, but in parallel in the future).
+  // Download all the files, several at a time.
   RETURN_NOT_OK(DownloadBlocks());
   RETURN_NOT_OK(DownloadWALs());
 
@@ -273,6 +304,13 @@ Status TabletCopyClient::Finish() {
   LOG_WITH_PREFIX(INFO) << "Tablet Copy complete. Replacing tablet superblock.";
   UpdateStatusMessage("Replacing tablet superblock");
   new_superblock_->set_tablet_data_state(tablet::TABLET_DATA_READY);
+  // The WAL and data roots are local to each server: keep the ones the data
+  // was downloaded to rather than the remote's.
+  new_superblock_->set_wal_root(meta_->wal_root());
+  new_superblock_->clear_data_dirs();
+  for (const string& dir : meta_->data_dirs()) {
+    new_superblock_->add_data_dirs(dir);
+  }
   RETURN_NOT_OK(meta_->ReplaceSuperBlock(*new_superblock_));
 
   if (FLAGS_tablet_copy_save_downloaded_metadata) {
@@ -310,6 +348,7 @@ Status TabletCopyClient::UnwindRemoteError(const Status& status,
 }
 
 void TabletCopyClient::UpdateStatusMessage(const string& message) {
+  std::lock_guard<simple_spinlock> l(status_lock_);
   if (status_listener_ != nullptr) {
     status_listener_->StatusMessage("TabletCopy: " + message);
   }
@@ -350,13 +389,18 @@ Status TabletCopyClient::DownloadWALs() {
   // Download the WAL segments.
   int num_segments = wal_seqnos_.size();
   LOG_WITH_PREFIX(INFO) << "Starting download of " << num_segments << " WAL segments...";
-  uint64_t counter = 0;
+  AtomicInt<int32_t> counter(0);
+  vector<std::function<Status()>> downloads;
   for (uint64_t seg_seqno : wal_seqnos_) {
-    UpdateStatusMessage(Substitute("Downloading WAL segment with seq. number $0 ($1/$2)",
-                                   seg_seqno, counter + 1, num_segments));
-    RETURN_NOT_OK(DownloadWAL(seg_seqno));
-    ++counter;
+    downloads.emplace_back([this, seg_seqno, &counter, num_segments]() {
+      UpdateStatusMessage(Substitute("Downloading WAL segment with seq. number $0 ($1/$2)",
+                                     seg_seqno, counter.Load() + 1, num_segments));
+      RETURN_NOT_OK(DownloadWAL(seg_seqno));
+      counter.Increment();
+      return Status::OK();
+    });
   }
+  RETURN_NOT_OK(RunDownloads(downloads));
 
   downloaded_wal_ = true;
   return Status::OK();
@@ -365,48 +409,40 @@ Status TabletCopyClient::DownloadWALs() {
 Status TabletCopyClient::DownloadBlocks() {
   CHECK(started_);
 
-  // Count up the total number of blocks to download.
-  int num_blocks = 0;
-  for (const RowSetDataPB& rowset : superblock_->rowsets()) {
-    num_blocks += rowset.columns_size();
-    num_blocks += rowset.redo_deltas_size();
-    num_blocks += rowset.undo_deltas_size();
-    if (rowset.has_bloom_block()) {
-      num_blocks++;
-    }
-    if (rowset.has_adhoc_index_block()) {
-      num_blocks++;
-    }
-  }
-
   // Download each block, writing the new block IDs into the new superblock
-  // as each block downloads.
+  // as each block downloads. Each download rewrites a different BlockIdPB,
+  // so they may run concurrently.
   gscoped_ptr<TabletSuperBlockPB> new_sb(new TabletSuperBlockPB());
   new_sb->CopyFrom(*superblock_);
-  int block_count = 0;
-  LOG_WITH_PREFIX(INFO) << "Starting download of " << num_blocks << " data blocks...";
+  vector<BlockIdPB*> block_ids;
   for (RowSetDataPB& rowset : *new_sb->mutable_rowsets()) {
     for (ColumnDataPB& col : *rowset.mutable_columns()) {
-      RETURN_NOT_OK(DownloadAndRewriteBlock(col.mutable_block(),
-                                            &block_count, num_blocks));
+      block_ids.push_back(col.mutable_block());
     }
     for (DeltaDataPB& redo : *rowset.mutable_redo_deltas()) {
-      RETURN_NOT_OK(DownloadAndRewriteBlock(redo.mutable_block(),
-                                            &block_count, num_blocks));
+      block_ids.push_back(redo.mutable_block());
     }
     for (DeltaDataPB& undo : *rowset.mutable_undo_deltas()) {
-      RETURN_NOT_OK(DownloadAndRewriteBlock(undo.mutable_block(),
-                                            &block_count, num_blocks));
+      block_ids.push_back(undo.mutable_block());
     }
     if (rowset.has_bloom_block()) {
-      RETURN_NOT_OK(DownloadAndRewriteBlock(rowset.mutable_bloom_block(),
-                                            &block_count, num_blocks));
+      block_ids.push_back(rowset.mutable_bloom_block());
     }
     if (rowset.has_adhoc_index_block()) {
-      RETURN_NOT_OK(DownloadAndRewriteBlock(rowset.mutable_adhoc_index_block(),
-                                            &block_count, num_blocks));
+      block_ids.push_back(rowset.mutable_adhoc_index_block());
     }
   }
+  int num_blocks = block_ids.size();
+
+  AtomicInt<int32_t> block_count(0);
+  vector<std::function<Status()>> downloads;
+  for (BlockIdPB* block_id : block_ids) {
+    downloads.emplace_back([this, block_id, &block_count, num_blocks]() {
+      return DownloadAndRewriteBlock(block_id, &block_count, num_blocks);
+    });
+  }
+  LOG_WITH_PREFIX(INFO) << "Starting download of " << num_blocks << " data blocks...";
+  RETURN_NOT_OK(RunDownloads(downloads));
 
   // The orphaned physical block ids at the remote have no meaning to us.
   new_sb->clear_orphaned_blocks();
@@ -462,26 +498,59 @@ Status TabletCopyClient::WriteConsensusMetadata() {
 }
 
 Status TabletCopyClient::DownloadAndRewriteBlock(BlockIdPB* block_id,
-                                                      int* block_count, int num_blocks) {
+                                                 AtomicInt<int32_t>* block_count,
+                                                 int num_blocks) {
   BlockId old_block_id(BlockId::FromPB(*block_id));
   UpdateStatusMessage(Substitute("Downloading block $0 ($1/$2)",
-                                 old_block_id.ToString(), *block_count,
+                                 old_block_id.ToString(), block_count->Load(),
                                  num_blocks));
   BlockId new_block_id;
   RETURN_NOT_OK_PREPEND(DownloadBlock(old_block_id, &new_block_id),
       "Unable to download block with id " + old_block_id.ToString());
 
   new_block_id.CopyToPB(block_id);
-  (*block_count)++;
+  block_count->Increment();
   return Status::OK();
 }
 
+Status TabletCopyClient::RunDownloads(const vector<std::function<Status()>>& downloads) {
+  simple_spinlock lock;
+  Status first_error;
+  Status submit_status;
+  for (const auto& download : downloads) {
+    submit_status = download_pool_->SubmitFunc([&lock, &first_error, &download]() {
+      {
+        std::lock_guard<simple_spinlock> l(lock);
+        if (!first_error.ok()) {
+          return;
+        }
+      }
+      Status s = download();
+      if (PREDICT_FALSE(!s.ok())) {
+        std::lock_guard<simple_spinlock> l(lock);
+        if (first_error.ok()) {
+          first_error = s;
+        }
+      }
+    });
+    if (PREDICT_FALSE(!submit_status.ok())) {
+      break;
+    }
+  }
+  // The downloads refer to this frame, so wait for them even on failure.
+  download_pool_->Wait();
+  RETURN_NOT_OK_PREPEND(submit_status, "Unable to start download");
+  return first_error;
+}
+
 Status TabletCopyClient::DownloadBlock(const BlockId& old_block_id,
                                             BlockId* new_block_id) {
   VLOG_WITH_PREFIX(1) << "Downloading block with block_id " << old_block_id.ToString();
 
   gscoped_ptr<WritableBlock> block;
-  RETURN_NOT_OK_PREPEND(fs_manager_->CreateNewBlock(&block),
+  CreateBlockOptions opts;
+  opts.tablet_id = tablet_id_;
+  RETURN_NOT_OK_PREPEND(fs_manager_->CreateNewBlock(opts, &block),
                         "Unable to create new block");
 
   DataIdPB data_id;
@@ -499,30 +568,69 @@ Status TabletCopyClient::DownloadBlock(const BlockId& old_block_id,
 template<class Appendable>
 Status TabletCopyClient::DownloadFile(const DataIdPB& data_id,
                                            Appendable* appendable) {
-  uint64_t offset = 0;
-  rpc::RpcController controller;
-  controller.set_timeout(MonoDelta::FromMilliseconds(session_idle_timeout_millis_));
+  // Chunks are fetched into two alternating slots, so that the next chunk
+  // is in flight while the current one is written.
+  struct Fetch {
+    Fetch() : done(0) {}
+    rpc::RpcController controller;
+    FetchDataResponsePB resp;
+    CountDownLatch done;
+  };
+  Fetch fetches[2];
   FetchDataRequestPB req;
+  req.set_session_id(session_id_);
+  req.mutable_data_id()->CopyFrom(data_id);
+  req.set_max_length(FLAGS_tablet_copy_transfer_chunk_size_bytes);
+  req.set_compression(cfile::GetCompressionCodecType(FLAGS_tablet_copy_compression_codec));
+  auto start_fetch = [&](Fetch* fetch, uint64_t fetch_offset) {
+    fetch->controller.Reset();
+    fetch->controller.set_timeout(MonoDelta::FromMilliseconds(session_idle_timeout_millis_));
+    fetch->resp.Clear();
+    fetch->done.Reset(1);
+    req.set_offset(fetch_offset);
+    CountDownLatch* done = &fetch->done;
+    proxy_->FetchDataAsync(req, &fetch->resp, &fetch->controller,
+                           [done]() { done->CountDown(); });
+  };
 
-  bool done = false;
-  while (!done) {
-    controller.Reset();
-    req.set_session_id(session_id_);
-    req.mutable_data_id()->CopyFrom(data_id);
-    req.set_offset(offset);
-    req.set_max_length(FLAGS_tablet_copy_transfer_chunk_size_bytes);
-
-    FetchDataResponsePB resp;
-    RETURN_NOT_OK_UNWIND_PREPEND(proxy_->FetchData(req, &resp, &controller),
-                                controller,
-                                "Unable to fetch data from remote");
+  uint64_t offset = 0;
+  int cur = 0;
+  start_fetch(&fetches[cur], offset);
+  while (true) {
+    Fetch* fetch = &fetches[cur];
+    fetch->done.Wait();
+    RETURN_NOT_OK_UNWIND_PREPEND(fetch->controller.status(),
+                                 fetch->controller,
+                                 "Unable to fetch data from remote");
+    DataChunkPB* mutable_chunk = fetch->resp.mutable_chunk();
+    if (throttler_) {
+      throttler_->Throttle(mutable_chunk->data().size());
+    }
+    RETURN_NOT_OK_PREPEND(UncompressChunk(mutable_chunk),
+                          Substitute("Error uncompressing data item $0",
+                                     data_id.ShortDebugString()));
+    const DataChunkPB& chunk = *mutable_chunk;
 
     // Sanity-check for corruption.
-    RETURN_NOT_OK_PREPEND(VerifyData(offset, resp.chunk()),
+    RETURN_NOT_OK_PREPEND(VerifyData(offset, chunk),
                           Substitute("Error validating data item $0", data_id.ShortDebugString()));
 
-    // Write the data.
-    RETURN_NOT_OK(appendable->Append(resp.chunk().data()));
+    uint64_t next_offset = offset + chunk.data().size();
+    bool done = next_offset == chunk.total_data_length();
+    Fetch* next = &fetches[1 - cur];
+    if (!done) {
+      start_fetch(next, next_offset);
+    }
+
+    // Write the data. The next fetch refers to this frame, so it's waited
+    // for if the write fails.
+    Status s = appendable->Append(chunk.data());
+    if (PREDICT_FALSE(!s.ok())) {
+      if (!done) {
+        next->done.Wait();
+      }
+      return s;
+    }
 
     if (PREDICT_FALSE(FLAGS_tablet_copy_dowload_file_inject_latency_ms > 0)) {
       LOG_WITH_PREFIX(INFO) << "Injecting latency into file download: " <<
@@ -530,15 +638,40 @@ Status TabletCopyClient::DownloadFile(const DataIdPB& data_id,
       SleepFor(MonoDelta::FromMilliseconds(FLAGS_tablet_copy_dowload_file_inject_latency_ms));
     }
 
-    if (offset + resp.chunk().data().size() == resp.chunk().total_data_length()) {
-      done = true;
+    if (done) {
+      break;
     }
-    offset += resp.chunk().data().size();
+    offset = next_offset;
+    cur = 1 - cur;
   }
 
   return Status::OK();
 }
 
+Status TabletCopyClient::UncompressChunk(DataChunkPB* chunk) {
+  if (chunk->compression() == NO_COMPRESSION) {
+    return Status::OK();
+  }
+  const cfile::CompressionCodec* codec;
+  RETURN_NOT_OK(cfile::GetCompressionCodec(chunk->compression(), &codec));
+  if (PREDICT_FALSE(!codec || !chunk->has_uncompressed_length() ||
+                    chunk->uncompressed_length() < 0)) {
+    return Status::Corruption("Invalid compressed chunk",
+                              Substitute("codec $0, uncompressed length $1",
+                                         CompressionType_Name(chunk->compression()),
+                                         chunk->uncompressed_length()));
+  }
+  string uncompressed;
+  uncompressed.resize(chunk->uncompressed_length());
+  RETURN_NOT_OK(codec->Uncompress(Slice(chunk->data()),
+                                  reinterpret_cast<uint8_t*>(&uncompressed[0]),
+                                  uncompressed.size()));
+  chunk->mutable_data()->swap(uncompressed);
+  chunk->clear_compression();
+  chunk->clear_uncompressed_length();
+  return Status::OK();
+}
+
 Status TabletCopyClient::VerifyData(uint64_t offset, const DataChunkPB& chunk) {
   // Verify the offset is what we expected.
   if (offset != chunk.offset()) {
@@ -17,6 +17,7 @@
 #ifndef KUDU_TSERVER_TABLET_COPY_CLIENT_H
 #define KUDU_TSERVER_TABLET_COPY_CLIENT_H
 
+#include <functional>
 #include <string>
 #include <memory>
 #include <vector>
@@ -26,6 +27,8 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
@@ -34,6 +37,7 @@ class BlockId;
 class BlockIdPB;
 class FsManager;
 class HostPort;
+class ThreadPool;
 
 namespace consensus {
 class ConsensusMetadata;
@@ -59,20 +63,24 @@ namespace tserver {
 class DataIdPB;
 class DataChunkPB;
 class TabletCopyServiceProxy;
+class TabletCopyThrottler;
 
 // Client class for using tablet copy to copy a tablet from another host.
 // This class is not thread-safe.
 //
-// TODO:
-// * Parallelize download of blocks and WAL segments.
-//
+// Up to --tablet_copy_download_parallelism blocks and WAL segments are
+// downloaded concurrently, each into its own file. Within a file, the next
+// chunk is fetched while the current one is written.
 class TabletCopyClient {
  public:
 
   // Construct the tablet copy client.
   // 'fs_manager' and 'messenger' must remain valid until this object is destroyed.
+  // So must 'throttler', which rate limits the received chunks, unless it's
+  // NULL, in which case they aren't limited.
   TabletCopyClient(std::string tablet_id, FsManager* fs_manager,
-                        std::shared_ptr<rpc::Messenger> messenger);
+                        std::shared_ptr<rpc::Messenger> messenger,
+                        TabletCopyThrottler* throttler = nullptr);
 
   // Attempt to clean up resources on the remote end by sending an
   // EndTabletCopySession() RPC
@@ -94,9 +102,16 @@ class TabletCopyClient {
   // in progress. If the 'metadata' pointer is passed as NULL, it is ignored,
   // otherwise the TabletMetadata object resulting from the initial remote
   // bootstrap response is returned.
+  //
+  // If Start() fails without having changed any local state, e.g. because
+  // the source couldn't begin a session, it may be called again with
+  // another source.
   Status Start(const HostPort& copy_source_addr,
                scoped_refptr<tablet::TabletMetadata>* metadata);
 
+  // Whether a call to Start() went as far as changing the local superblock.
+  bool changed_local_state() const { return changed_local_state_; }
+
   // Runs a "full" tablet copy, copying the physical layout of a tablet
   // from the leader of the specified consensus configuration.
   Status FetchAll(tablet::TabletStatusListener* status_listener);
@@ -111,6 +126,7 @@ class TabletCopyClient {
   FRIEND_TEST(TabletCopyClientTest, TestVerifyData);
   FRIEND_TEST(TabletCopyClientTest, TestDownloadWalSegment);
   FRIEND_TEST(TabletCopyClientTest, TestDownloadAllBlocks);
+  FRIEND_TEST(TabletCopyClientTest, TestDownloadBlocksInSmallChunks);
 
   // Extract the embedded Status message from the given ErrorStatusPB.
   // The given ErrorStatusPB must extend TabletCopyErrorPB.
@@ -120,12 +136,13 @@ class TabletCopyClient {
 
   // Update the bootstrap StatusListener with a message.
   // The string "TabletCopy: " will be prepended to each message.
+  // Thread-safe.
   void UpdateStatusMessage(const std::string& message);
 
   // End the tablet copy session.
   Status EndRemoteSession();
 
-  // Download all WAL files sequentially.
+  // Download all WAL files.
   Status DownloadWALs();
 
   // Download a single WAL file.
@@ -137,7 +154,7 @@ class TabletCopyClient {
   // downloaded as part of initiating the tablet copy session.
   Status WriteConsensusMetadata();
 
-  // Download all blocks belonging to a tablet sequentially.
+  // Download all blocks belonging to a tablet.
   //
   // Blocks are given new IDs upon creation. On success, 'new_superblock_'
   // is populated to reflect the new block IDs and should be used in lieu
@@ -149,7 +166,13 @@ class TabletCopyClient {
   // On success:
   // - 'block_id' is set to the new ID of the downloaded block.
   // - 'block_count' is incremented.
-  Status DownloadAndRewriteBlock(BlockIdPB* block_id, int* block_count, int num_blocks);
+  Status DownloadAndRewriteBlock(BlockIdPB* block_id, AtomicInt<int32_t>* block_count,
+                                 int num_blocks);
+
+  // Runs 'downloads' on 'download_pool_', returning once they're all done.
+  // The downloads which haven't started are skipped after one fails, and
+  // the first failure is returned.
+  Status RunDownloads(const std::vector<std::function<Status()>>& downloads);
 
   // Download a single block.
   // Data block is opened with options so that it will fsync() on close.
@@ -167,6 +190,10 @@ class TabletCopyClient {
   template<class Appendable>
   Status DownloadFile(const DataIdPB& data_id, Appendable* appendable);
 
+  // Replaces the data of 'chunk' with its uncompressed data, if the server
+  // compressed it.
+  static Status UncompressChunk(DataChunkPB* chunk);
+
   Status VerifyData(uint64_t offset, const DataChunkPB& resp);
 
   // Return standard log prefix.
@@ -176,11 +203,13 @@ class TabletCopyClient {
   const std::string tablet_id_;
   FsManager* const fs_manager_;
   const std::shared_ptr<rpc::Messenger> messenger_;
+  TabletCopyThrottler* const throttler_;
 
   // State flags that enforce the progress of tablet copy.
   bool started_;            // Session started.
   bool downloaded_wal_;     // WAL segments downloaded.
   bool downloaded_blocks_;  // Data blocks downloaded.
+  bool changed_local_state_;  // Local superblock replaced or created.
 
   // Session-specific data items.
   bool replace_tombstoned_tablet_;
@@ -202,6 +231,12 @@ class TabletCopyClient {
   std::vector<uint64_t> wal_seqnos_;
   int64_t start_time_micros_;
 
+  // Runs the concurrent downloads of blocks and WAL segments.
+  gscoped_ptr<ThreadPool> download_pool_;
+
+  // Serializes the status messages of concurrent downloads.
+  simple_spinlock status_lock_;
+
   DISALLOW_COPY_AND_ASSIGN(TabletCopyClient);
 };
 
@@ -21,6 +21,7 @@
 #include <thread>
 #include <vector>
 
+#include "kudu/cfile/compression_codec.h"
 #include "kudu/consensus/log.h"
 #include "kudu/consensus/log_anchor_registry.h"
 #include "kudu/consensus/log_util.h"
@@ -392,6 +393,43 @@ TEST_F(TabletCopyServiceTest, TestFetchBlockAtOnce) {
   AssertDataEqual(local_data.data(), local_data.size(), resp.chunk());
 }
 
+// Test that a chunk which was asked to be compressed either comes back
+// compressed, or as it is if it doesn't compress well.
+TEST_F(TabletCopyServiceTest, TestFetchBlockCompressed) {
+  string session_id;
+  tablet::TabletSuperBlockPB superblock;
+  ASSERT_OK(DoBeginValidTabletCopySession(&session_id, &superblock));
+
+  BlockId block_id = FirstColumnBlockId(superblock);
+  Slice local_data;
+  faststring scratch;
+  ASSERT_OK(ReadLocalBlockFile(mini_server_->server()->fs_manager(), block_id,
+                               &scratch, &local_data));
+
+  FetchDataRequestPB req;
+  req.set_session_id(session_id);
+  req.mutable_data_id()->CopyFrom(AsDataTypeId(block_id));
+  req.set_compression(LZ4);
+  FetchDataResponsePB resp;
+  RpcController controller;
+  ASSERT_OK(tablet_copy_proxy_->FetchData(req, &resp, &controller));
+
+  DataChunkPB chunk = resp.chunk();
+  if (chunk.compression() != NO_COMPRESSION) {
+    ASSERT_EQ(LZ4, chunk.compression());
+    ASSERT_EQ(static_cast<int64_t>(local_data.size()), chunk.uncompressed_length());
+    ASSERT_LT(chunk.data().size(), local_data.size());
+    const cfile::CompressionCodec* codec;
+    ASSERT_OK(cfile::GetCompressionCodec(LZ4, &codec));
+    string uncompressed(chunk.uncompressed_length(), '\0');
+    ASSERT_OK(codec->Uncompress(Slice(chunk.data()),
+                                reinterpret_cast<uint8_t*>(&uncompressed[0]),
+                                uncompressed.size()));
+    chunk.set_data(uncompressed);
+  }
+  AssertDataEqual(local_data.data(), local_data.size(), chunk);
+}
+
 // Test that we are able to incrementally fetch blocks.
 TEST_F(TabletCopyServiceTest, TestFetchBlockIncrementally) {
   string session_id;
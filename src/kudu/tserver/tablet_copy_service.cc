@@ -22,6 +22,7 @@
 #include <string>
 #include <vector>
 
+#include "kudu/cfile/compression_codec.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/log.h"
 #include "kudu/fs/fs_manager.h"
@@ -34,6 +35,7 @@
 #include "kudu/util/crc.h"
 #include "kudu/util/fault_injection.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/logging.h"
 
 // Note, this macro assumes the existence of a local var named 'context'.
 #define RPC_RETURN_APP_ERROR(app_err, message, s) \
@@ -73,6 +75,36 @@ using crc::Crc32c;
 using strings::Substitute;
 using tablet::TabletPeer;
 
+// Compresses the data of 'chunk' with 'compression', unless it doesn't shrink
+// enough to be worth it, as with chunks of blocks which are already
+// compressed.
+static void MaybeCompressChunk(CompressionType compression, DataChunkPB* chunk) {
+  // The most a compressed chunk may keep of the uncompressed size.
+  const double kMaxCompressedFraction = 0.9;
+
+  const cfile::CompressionCodec* codec;
+  if (!cfile::GetCompressionCodec(compression, &codec).ok() || !codec) {
+    return;
+  }
+  const string& data = chunk->data();
+  string compressed;
+  compressed.resize(codec->MaxCompressedLength(data.size()));
+  size_t compressed_length;
+  Status s = codec->Compress(Slice(data), reinterpret_cast<uint8_t*>(&compressed[0]),
+                             &compressed_length);
+  if (PREDICT_FALSE(!s.ok())) {
+    KLOG_EVERY_N_SECS(WARNING, 60) << "Unable to compress tablet copy chunk: " << s.ToString();
+    return;
+  }
+  if (compressed_length > data.size() * kMaxCompressedFraction) {
+    return;
+  }
+  compressed.resize(compressed_length);
+  chunk->set_uncompressed_length(data.size());
+  chunk->set_compression(compression);
+  chunk->mutable_data()->swap(compressed);
+}
+
 static void SetupErrorAndRespond(rpc::RpcContext* context,
                                  TabletCopyErrorPB::Code code,
                                  const string& message,
@@ -95,7 +127,8 @@ TabletCopyServiceImpl::TabletCopyServiceImpl(
     : TabletCopyServiceIf(metric_entity, result_tracker),
       fs_manager_(CHECK_NOTNULL(fs_manager)),
       tablet_peer_lookup_(CHECK_NOTNULL(tablet_peer_lookup)),
-      shutdown_latch_(1) {
+      shutdown_latch_(1),
+      send_throttler_(TabletCopyThrottler::SEND, metric_entity) {
   CHECK_OK(Thread::Create("tablet-copy", "tc-session-exp",
                           &TabletCopyServiceImpl::EndExpiredSessions, this,
                           &session_expiration_thread_));
@@ -199,6 +232,12 @@ void TabletCopyServiceImpl::FetchData(const FetchDataRequestPB* req,
 
   MAYBE_FAULT(FLAGS_fault_crash_on_handle_tc_fetch_data);
 
+  // Don't read a chunk from disk if the client already gave up on it.
+  if (PREDICT_FALSE(context->ClientAbandoned())) {
+    context->RespondFailure(Status::TimedOut("Client abandoned the FetchData call"));
+    return;
+  }
+
   uint64_t offset = req->offset();
   int64_t client_maxlen = req->max_length();
 
@@ -231,6 +270,14 @@ void TabletCopyServiceImpl::FetchData(const FetchDataRequestPB* req,
   uint32_t crc32 = Crc32c(data->data(), data->length());
   data_chunk->set_crc32(crc32);
 
+  if (req->compression() != NO_COMPRESSION) {
+    MaybeCompressChunk(req->compression(), data_chunk);
+  }
+
+  // Sessions share the send bandwidth, so a throttled chunk holds its
+  // service thread until its turn.
+  send_throttler_.Throttle(data_chunk->data().size());
+
   context->RespondSuccess();
 }
 
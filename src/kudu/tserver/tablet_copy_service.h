@@ -23,6 +23,7 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/tserver/tablet_copy.service.h"
+#include "kudu/tserver/tablet_copy_throttler.h"
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
@@ -104,6 +105,9 @@ class TabletCopyServiceImpl : public TabletCopyServiceIf {
   // TODO: this is a hack, replace with some kind of timer impl. See KUDU-286.
   CountDownLatch shutdown_latch_;
   scoped_refptr<Thread> session_expiration_thread_;
+
+  // Rate limits the chunks sent by all sessions.
+  TabletCopyThrottler send_throttler_;
 };
 
 } // namespace tserver
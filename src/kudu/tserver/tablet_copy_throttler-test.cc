@@ -0,0 +1,74 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tserver/tablet_copy_throttler.h"
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/test_util.h"
+
+DECLARE_int64(tablet_copy_receive_bytes_per_sec);
+
+METRIC_DECLARE_counter(tablet_copy_bytes_received);
+METRIC_DECLARE_counter(tablet_copy_receive_throttled_time_us);
+
+namespace kudu {
+namespace tserver {
+
+class TabletCopyThrottlerTest : public KuduTest {
+ public:
+  TabletCopyThrottlerTest()
+      : entity_(METRIC_ENTITY_server.Instantiate(&registry_, "test")) {
+  }
+
+ protected:
+  int64_t CounterValue(CounterPrototype* prototype) {
+    return prototype->Instantiate(entity_)->value();
+  }
+
+  MetricRegistry registry_;
+  scoped_refptr<MetricEntity> entity_;
+};
+
+// Test that transfers are only accounted for when they aren't rate limited,
+// and are held back to the rate otherwise.
+TEST_F(TabletCopyThrottlerTest, TestThrottle) {
+  TabletCopyThrottler throttler(TabletCopyThrottler::RECEIVE, entity_);
+  const int kBytes = 300 * 1024;
+  MonoTime start = MonoTime::Now();
+  throttler.Throttle(kBytes);
+  ASSERT_LT(MonoTime::Now() - start, MonoDelta::FromMilliseconds(100));
+  ASSERT_EQ(kBytes, CounterValue(&METRIC_tablet_copy_bytes_received));
+  ASSERT_EQ(0, CounterValue(&METRIC_tablet_copy_receive_throttled_time_us));
+
+  // At 1 MB/s, with an empty bucket to start with, 300 KB take at least a
+  // few refill periods.
+  FLAGS_tablet_copy_receive_bytes_per_sec = 1024 * 1024;
+  start = MonoTime::Now();
+  for (int i = 0; i < 3; i++) {
+    throttler.Throttle(kBytes / 3);
+  }
+  ASSERT_GE(MonoTime::Now() - start, MonoDelta::FromMilliseconds(150));
+  ASSERT_EQ(2 * kBytes, CounterValue(&METRIC_tablet_copy_bytes_received));
+  ASSERT_GT(CounterValue(&METRIC_tablet_copy_receive_throttled_time_us), 0);
+}
+
+} // namespace tserver
+} // namespace kudu
@@ -0,0 +1,171 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tserver/tablet_copy_throttler.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include <gflags/gflags.h>
+
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/throttler.h"
+
+DEFINE_int64(tablet_copy_send_bytes_per_sec, 0,
+             "Maximum rate, in bytes per second, at which a server sends tablet "
+             "copy data to all of its tablet copy clients. 0 means unlimited.");
+TAG_FLAG(tablet_copy_send_bytes_per_sec, advanced);
+TAG_FLAG(tablet_copy_send_bytes_per_sec, runtime);
+
+DEFINE_int64(tablet_copy_receive_bytes_per_sec, 0,
+             "Maximum rate, in bytes per second, at which a server receives tablet "
+             "copy data for all of the tablets it copies. 0 means unlimited.");
+TAG_FLAG(tablet_copy_receive_bytes_per_sec, advanced);
+TAG_FLAG(tablet_copy_receive_bytes_per_sec, runtime);
+
+METRIC_DEFINE_counter(server, tablet_copy_bytes_sent,
+                      "Tablet Copy Bytes Sent", kudu::MetricUnit::kBytes,
+                      "Number of bytes of tablet copy data sent to other servers");
+METRIC_DEFINE_counter(server, tablet_copy_bytes_received,
+                      "Tablet Copy Bytes Received", kudu::MetricUnit::kBytes,
+                      "Number of bytes of tablet copy data received from other servers");
+METRIC_DEFINE_counter(server, tablet_copy_send_throttled_time_us,
+                      "Tablet Copy Send Throttled Time", kudu::MetricUnit::kMicroseconds,
+                      "Total time tablet copy chunks waited to be sent because of "
+                      "--tablet_copy_send_bytes_per_sec");
+METRIC_DEFINE_counter(server, tablet_copy_receive_throttled_time_us,
+                      "Tablet Copy Receive Throttled Time", kudu::MetricUnit::kMicroseconds,
+                      "Total time tablet copy chunks waited to be fetched because of "
+                      "--tablet_copy_receive_bytes_per_sec");
+METRIC_DEFINE_gauge_int64(server, tablet_copy_send_rate,
+                          "Tablet Copy Send Rate", kudu::MetricUnit::kBytes,
+                          "Bytes per second of tablet copy data sent over the last second");
+METRIC_DEFINE_gauge_int64(server, tablet_copy_receive_rate,
+                          "Tablet Copy Receive Rate", kudu::MetricUnit::kBytes,
+                          "Bytes per second of tablet copy data received over the last second");
+METRIC_DEFINE_gauge_int32(server, tablet_copy_send_transfers_waiting,
+                          "Tablet Copy Send Transfers Waiting", kudu::MetricUnit::kRequests,
+                          "Number of tablet copy chunks currently waiting for send bandwidth");
+METRIC_DEFINE_gauge_int32(server, tablet_copy_receive_transfers_waiting,
+                          "Tablet Copy Receive Transfers Waiting", kudu::MetricUnit::kRequests,
+                          "Number of tablet copy chunks currently waiting for receive bandwidth");
+
+namespace kudu {
+namespace tserver {
+
+TabletCopyThrottler::TabletCopyThrottler(Direction direction,
+                                         const scoped_refptr<MetricEntity>& metric_entity)
+    : direction_(direction),
+      throttler_rate_(0),
+      window_start_(MonoTime::Now()),
+      window_bytes_(0),
+      bytes_per_sec_(0) {
+  if (metric_entity) {
+    if (direction_ == SEND) {
+      bytes_transferred_ = METRIC_tablet_copy_bytes_sent.Instantiate(metric_entity);
+      time_throttled_us_ = METRIC_tablet_copy_send_throttled_time_us.Instantiate(metric_entity);
+      bandwidth_gauge_ = METRIC_tablet_copy_send_rate.Instantiate(metric_entity, 0);
+      waiting_gauge_ = METRIC_tablet_copy_send_transfers_waiting.Instantiate(metric_entity, 0);
+    } else {
+      bytes_transferred_ = METRIC_tablet_copy_bytes_received.Instantiate(metric_entity);
+      time_throttled_us_ =
+          METRIC_tablet_copy_receive_throttled_time_us.Instantiate(metric_entity);
+      bandwidth_gauge_ = METRIC_tablet_copy_receive_rate.Instantiate(metric_entity, 0);
+      waiting_gauge_ =
+          METRIC_tablet_copy_receive_transfers_waiting.Instantiate(metric_entity, 0);
+    }
+  }
+}
+
+TabletCopyThrottler::~TabletCopyThrottler() {
+}
+
+int64_t TabletCopyThrottler::RateLimit() const {
+  return std::max<int64_t>(0, direction_ == SEND ? FLAGS_tablet_copy_send_bytes_per_sec :
+                                                   FLAGS_tablet_copy_receive_bytes_per_sec);
+}
+
+void TabletCopyThrottler::Throttle(uint64_t bytes) {
+  MonoTime start = MonoTime::Now();
+  int64_t rate = RateLimit();
+  if (rate > 0) {
+    Throttler* throttler;
+    {
+      std::lock_guard<simple_spinlock> l(lock_);
+      if (!throttler_) {
+        throttler_.reset(new Throttler(start, 0, rate, 1.0));
+      } else if (throttler_rate_ != rate) {
+        throttler_->SetByteRate(rate);
+      }
+      throttler_rate_ = rate;
+      throttler = throttler_.get();
+    }
+
+    // A take can't exceed what the bucket holds after one refill period, so
+    // large chunks are admitted in pieces.
+    const int64_t kPeriodsPerSecond =
+        MonoTime::kMicrosecondsPerSecond / Throttler::kRefillPeriodMicros;
+    const uint64_t max_take = std::max<int64_t>(rate / kPeriodsPerSecond, 1);
+    bool waiting = false;
+    uint64_t remaining = bytes;
+    while (remaining > 0) {
+      uint64_t piece = std::min(remaining, max_take);
+      if (throttler->Take(MonoTime::Now(), 0, piece)) {
+        remaining -= piece;
+        continue;
+      }
+      if (!waiting && waiting_gauge_) {
+        waiting_gauge_->Increment();
+      }
+      waiting = true;
+      SleepFor(MonoDelta::FromMicroseconds(Throttler::kRefillPeriodMicros / 10));
+    }
+    if (waiting && waiting_gauge_) {
+      waiting_gauge_->Decrement();
+      time_throttled_us_->IncrementBy((MonoTime::Now() - start).ToMicroseconds());
+    }
+  }
+  RecordBytes(bytes, MonoTime::Now());
+}
+
+void TabletCopyThrottler::RecordBytes(uint64_t bytes, MonoTime now) {
+  if (bytes_transferred_) {
+    bytes_transferred_->IncrementBy(bytes);
+  }
+  std::lock_guard<simple_spinlock> l(lock_);
+  MonoDelta elapsed = now - window_start_;
+  if (elapsed >= MonoDelta::FromSeconds(1)) {
+    // A window with no transfers at all leaves a rate of 0 behind.
+    bytes_per_sec_ = elapsed >= MonoDelta::FromSeconds(2) ? 0 :
+        static_cast<int64_t>(window_bytes_ / elapsed.ToSeconds());
+    window_start_ = now;
+    window_bytes_ = 0;
+    if (bandwidth_gauge_) {
+      bandwidth_gauge_->set_value(bytes_per_sec_);
+    }
+  }
+  window_bytes_ += bytes;
+}
+
+int64_t TabletCopyThrottler::bytes_per_sec() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return bytes_per_sec_;
+}
+
+} // namespace tserver
+} // namespace kudu
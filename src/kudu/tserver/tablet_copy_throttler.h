@@ -0,0 +1,101 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TSERVER_TABLET_COPY_THROTTLER_H
+#define KUDU_TSERVER_TABLET_COPY_THROTTLER_H
+
+#include <stdint.h>
+
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+
+namespace kudu {
+
+template<class T>
+class AtomicGauge;
+class Counter;
+class MetricEntity;
+class Throttler;
+
+namespace tserver {
+
+// Rate limits the tablet copy traffic of a server in one direction: the
+// chunks sent by its TabletCopyService, or the chunks received by its tablet
+// copy clients. One token bucket is shared by all the sessions of the
+// server, with the byte rate of --tablet_copy_send_bytes_per_sec or
+// --tablet_copy_receive_bytes_per_sec, which may be changed at runtime.
+//
+// The bandwidth used and the transfers waiting for it are exported as
+// metrics, whether or not the traffic is rate limited.
+//
+// This class is thread-safe.
+class TabletCopyThrottler {
+ public:
+  enum Direction {
+    SEND,
+    RECEIVE,
+  };
+
+  // 'metric_entity' may be NULL, in which case no metrics are produced.
+  TabletCopyThrottler(Direction direction,
+                      const scoped_refptr<MetricEntity>& metric_entity);
+  ~TabletCopyThrottler();
+
+  // Blocks the calling thread until 'bytes' more may be transferred, and
+  // accounts for them.
+  void Throttle(uint64_t bytes);
+
+  // Returns the bandwidth used over the last full second, in bytes per
+  // second.
+  int64_t bytes_per_sec() const;
+
+ private:
+  // Returns the byte rate limit of 'direction_', or 0 if unlimited.
+  int64_t RateLimit() const;
+
+  // Accounts for 'bytes' transferred at 'now' in the bandwidth.
+  void RecordBytes(uint64_t bytes, MonoTime now);
+
+  const Direction direction_;
+
+  mutable simple_spinlock lock_;
+
+  // The token bucket, and the byte rate it was set up with. Protected by
+  // 'lock_'; the bucket itself is thread-safe.
+  gscoped_ptr<Throttler> throttler_;
+  int64_t throttler_rate_;
+
+  // The bytes transferred since 'window_start_', and the bandwidth of the
+  // previous window. Protected by 'lock_'.
+  MonoTime window_start_;
+  int64_t window_bytes_;
+  int64_t bytes_per_sec_;
+
+  scoped_refptr<Counter> bytes_transferred_;
+  scoped_refptr<Counter> time_throttled_us_;
+  scoped_refptr<AtomicGauge<int64_t>> bandwidth_gauge_;
+  scoped_refptr<AtomicGauge<int32_t>> waiting_gauge_;
+
+  DISALLOW_COPY_AND_ASSIGN(TabletCopyThrottler);
+};
+
+} // namespace tserver
+} // namespace kudu
+
+#endif // KUDU_TSERVER_TABLET_COPY_THROTTLER_H
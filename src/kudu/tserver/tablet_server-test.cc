@@ -25,6 +25,7 @@
 #include "kudu/gutil/strings/escaping.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/master/master.pb.h"
+#include "kudu/rpc/rpc_sidecar.h"
 #include "kudu/server/hybrid_clock.h"
 #include "kudu/server/server_base.pb.h"
 #include "kudu/server/server_base.proxy.h"
@@ -56,15 +57,21 @@ DEFINE_int32(single_threaded_insert_latency_bench_insert_rows, 1000,
              "Number of rows to insert in the testing phase of the single threaded"
              " tablet server insert latency micro-benchmark");
 
+DECLARE_bool(scanner_adaptive_batch_sizing);
+DECLARE_int32(cfile_hot_block_sample_interval);
 DECLARE_int32(scanner_batch_size_rows);
 DECLARE_int32(metrics_retirement_age_ms);
+DECLARE_int32(scan_result_cache_capacity_mb);
 DECLARE_string(block_manager);
+DECLARE_int32(tablet_reverse_scan_chunk_size_bytes);
 
 // Declare these metrics prototypes for simpler unit testing of their behavior.
 METRIC_DECLARE_counter(rows_inserted);
 METRIC_DECLARE_counter(rows_updated);
 METRIC_DECLARE_counter(rows_deleted);
 METRIC_DECLARE_gauge_uint64(log_block_manager_blocks_under_management);
+METRIC_DECLARE_counter(scan_result_cache_hits);
+METRIC_DECLARE_counter(scan_result_cache_misses);
 
 namespace kudu {
 namespace tserver {
@@ -356,6 +363,54 @@ TEST_F(TabletServerTest, TestInsert) {
   ASSERT_GE(now_after.value(), now_before.value());
 }
 
+// Test that the rows of a write may be sent in sidecars, and that they're
+// replicated in the request itself.
+TEST_F(TabletServerTest, TestInsertRowsInSidecars) {
+  WriteRequestPB req;
+  req.set_tablet_id(kTabletId);
+  ASSERT_OK(SchemaToPB(schema_, req.mutable_schema()));
+
+  RowOperationsPB ops;
+  AddTestRowToPB(RowOperationsPB::INSERT, schema_, 1, 10, "row one via sidecar", &ops);
+  AddTestRowToPB(RowOperationsPB::INSERT, schema_, 2, 20, "row two via sidecar", &ops);
+
+  for (bool bad_index : { true, false }) {
+    WriteResponsePB resp;
+    RpcController controller;
+    int rows_idx;
+    int indirect_idx;
+    gscoped_ptr<faststring> rows(new faststring);
+    rows->append(ops.rows());
+    ASSERT_OK(controller.AddOutboundSidecar(
+        make_gscoped_ptr(new rpc::RpcSidecar(std::move(rows))), &rows_idx));
+    gscoped_ptr<faststring> indirect_data(new faststring);
+    indirect_data->append(ops.indirect_data());
+    ASSERT_OK(controller.AddOutboundSidecar(
+        make_gscoped_ptr(new rpc::RpcSidecar(std::move(indirect_data))), &indirect_idx));
+    controller.RequireServerFeature(TabletServerFeatures::WRITE_ROWS_IN_SIDECAR);
+    req.set_rows_sidecar(rows_idx);
+    req.set_indirect_data_sidecar(bad_index ? indirect_idx + 1 : indirect_idx);
+
+    SCOPED_TRACE(req.DebugString());
+    ASSERT_OK(proxy_->Write(req, &resp, &controller));
+    SCOPED_TRACE(resp.DebugString());
+    if (bad_index) {
+      ASSERT_TRUE(resp.has_error());
+      ASSERT_EQ(TabletServerErrorPB::INVALID_ROW_BLOCK, resp.error().code());
+      ASSERT_STR_CONTAINS(resp.error().status().message(),
+                          "Unable to get the indirect data sidecar");
+    } else {
+      ASSERT_FALSE(resp.has_error());
+      ASSERT_EQ(0, resp.per_row_errors_size());
+    }
+  }
+  VerifyRows(schema_, { KeyValue(1, 10), KeyValue(2, 20) });
+
+  // The rows must have been written to the WAL, so they're replayed.
+  ASSERT_NO_FATAL_FAILURE(ShutdownAndRebuildTablet());
+  VerifyRows(schema_, { KeyValue(1, 10), KeyValue(2, 20) });
+}
+
 TEST_F(TabletServerTest, TestExternalConsistencyModes_ClientPropagated) {
   WriteRequestPB req;
   req.set_tablet_id(kTabletId);
@@ -964,6 +1019,68 @@ TEST_F(TabletServerTest, TestKUDU_177_RecoveryOfDMSEditsAfterMajorDeltaCompactio
   ANFF(VerifyRows(schema_, { KeyValue(1, 3) }));
 }
 
+// A tablet flushed by a graceful shutdown is bootstrapped without replaying
+// its WAL, and the next bootstrap replays it again.
+TEST_F(TabletServerTest, TestGracefulShutdownSkipsReplay) {
+  ANFF(InsertTestRowsRemote(0, 1, 2));
+  ASSERT_OK(tablet_peer_->tablet()->Flush());
+  // Leave an update in the DMS and an insert in the MRS.
+  ANFF(UpdateTestRowRemote(0, 1, 3));
+  ANFF(InsertTestRowsRemote(0, 3, 1));
+
+  tablet_peer_.reset();
+  mini_server_->server()->tablet_manager()->ShutdownAndFlush(MonoDelta::FromSeconds(30));
+  ASSERT_OK(ShutdownAndRebuildTablet());
+  ASSERT_STR_CONTAINS(tablet_peer_->last_status(), "no replay needed");
+  ANFF(VerifyRows(schema_, { KeyValue(1, 3), KeyValue(2, 2), KeyValue(3, 3) }));
+
+  // The WAL can be appended to and replayed as usual after that.
+  ANFF(InsertTestRowsRemote(0, 4, 1));
+  ASSERT_OK(ShutdownAndRebuildTablet());
+  ASSERT_EQ(string::npos, tablet_peer_->last_status().find("no replay needed"));
+  ANFF(VerifyRows(schema_, { KeyValue(1, 3), KeyValue(2, 2), KeyValue(3, 3),
+                             KeyValue(4, 4) }));
+}
+
+// The results of the writes completed before a graceful shutdown are still
+// known after a restart which skips the replay, so retries of those writes
+// aren't applied again.
+TEST_F(TabletServerTest, TestGracefulShutdownKeepsWriteResults) {
+  WriteRequestPB req;
+  req.set_tablet_id(kTabletId);
+  ASSERT_OK(SchemaToPB(schema_, req.mutable_schema()));
+  AddTestRowToPB(RowOperationsPB::INSERT, schema_, 1, 1, "original",
+                 req.mutable_row_operations());
+
+  // Sends 'req' as attempt 'attempt_no' of the same request.
+  auto write = [&](int attempt_no, WriteResponsePB* resp) {
+    RpcController controller;
+    std::unique_ptr<rpc::RequestIdPB> request_id(new rpc::RequestIdPB());
+    request_id->set_client_id("test_client");
+    request_id->set_seq_no(0);
+    request_id->set_attempt_no(attempt_no);
+    request_id->set_first_incomplete_seq_no(0);
+    controller.SetRequestIdPB(std::move(request_id));
+    ASSERT_OK(proxy_->Write(req, resp, &controller));
+    SCOPED_TRACE(resp->DebugString());
+    ASSERT_FALSE(resp->has_error());
+  };
+  WriteResponsePB first_resp;
+  ANFF(write(0, &first_resp));
+  ASSERT_EQ(0, first_resp.per_row_errors_size());
+
+  tablet_peer_.reset();
+  mini_server_->server()->tablet_manager()->ShutdownAndFlush(MonoDelta::FromSeconds(30));
+  ASSERT_OK(ShutdownAndRebuildTablet());
+  ASSERT_STR_CONTAINS(tablet_peer_->last_status(), "no replay needed");
+
+  // Applied again, the retry would fail with a duplicate key.
+  WriteResponsePB retry_resp;
+  ANFF(write(1, &retry_resp));
+  ASSERT_EQ(0, retry_resp.per_row_errors_size()) << retry_resp.DebugString();
+  ANFF(VerifyRows(schema_, { KeyValue(1, 1) }));
+}
+
 TEST_F(TabletServerTest, TestClientGetsErrorBackWhenRecoveryFailed) {
   ANFF(InsertTestRowsRemote(0, 1, 7));
 
@@ -1149,6 +1266,183 @@ TEST_F(TabletServerTest, TestSnapshotScan_WithoutSnapshotTimestamp) {
   ASSERT_GE(resp.snap_timestamp(), now.ToUint64());
 }
 
+// Tests that MultiGet returns the rows of the keys it's given in key order,
+// along with the index of the key each row was found by.
+TEST_F(TabletServerTest, TestMultiGet) {
+  InsertTestRowsDirect(0, 10);
+
+  MultiGetRequestPB req;
+  MultiGetResponsePB resp;
+  RpcController rpc;
+  req.set_tablet_id(kTabletId);
+  ASSERT_OK(SchemaToColumnPBs(schema_, req.mutable_projected_columns()));
+  // Out of order, with a missing and a duplicate key.
+  for (int key : { 7, 2, 42, 2 }) {
+    KuduPartialRow row(&schema_);
+    ASSERT_OK(row.SetInt32(0, key));
+    ASSERT_OK(row.EncodeRowKey(req.add_encoded_keys()));
+  }
+  rpc.RequireServerFeature(TabletServerFeatures::MULTI_GET);
+  {
+    SCOPED_TRACE(req.DebugString());
+    ASSERT_OK(proxy_->MultiGet(req, &resp, &rpc));
+    SCOPED_TRACE(resp.DebugString());
+    ASSERT_FALSE(resp.has_error());
+    ASSERT_TRUE(resp.has_snap_timestamp());
+  }
+  ASSERT_EQ((vector<int32_t>{ 1, 0 }),
+            vector<int32_t>(resp.key_indexes().begin(), resp.key_indexes().end()));
+
+  // The rows are laid out as in a scan response.
+  ScanResponsePB scan_resp;
+  scan_resp.mutable_data()->Swap(resp.mutable_data());
+  vector<string> results;
+  NO_FATALS(StringifyRowsFromResponse(schema_, rpc, scan_resp, &results));
+  ASSERT_EQ(2, results.size());
+  KuduPartialRow row(&schema_);
+  NO_FATALS(BuildTestRow(2, &row));
+  ASSERT_EQ("(" + row.ToString() + ")", results[0]);
+  NO_FATALS(BuildTestRow(7, &row));
+  ASSERT_EQ("(" + row.ToString() + ")", results[1]);
+
+  // A projection of a column the tablet doesn't have is rejected.
+  Schema bad_projection({ ColumnSchema("not_a_column", INT32) }, 0);
+  req.clear_projected_columns();
+  ASSERT_OK(SchemaToColumnPBs(bad_projection, req.mutable_projected_columns()));
+  rpc.Reset();
+  ASSERT_OK(proxy_->MultiGet(req, &resp, &rpc));
+  ASSERT_TRUE(resp.has_error());
+  ASSERT_EQ(TabletServerErrorPB::MISMATCHED_SCHEMA, resp.error().code());
+}
+
+// Test that the hot blocks of tablets are persisted beside their metadata,
+// and that hints of the hot set are accepted.
+TEST_F(TabletServerTest, TestWarmUpBlockCache) {
+  FLAGS_cfile_hot_block_sample_interval = 1;
+  InsertTestRowsDirect(0, 100);
+  ASSERT_OK(tablet_peer_->tablet()->Flush());
+  vector<KeyValue> expected;
+  for (int i = 0; i < 100; i++) {
+    expected.emplace_back(i, i * 2);
+  }
+  // The second scan finds the blocks in the cache.
+  NO_FATALS(VerifyRows(schema_, expected));
+  NO_FATALS(VerifyRows(schema_, expected));
+
+  mini_server_->server()->tablet_manager()->SaveHotBlocks();
+  tablet::HotBlocksPB hot_blocks;
+  ASSERT_OK(tablet_peer_->tablet_metadata()->LoadHotBlocks(&hot_blocks));
+  ASSERT_GT(hot_blocks.blocks_size(), 0);
+  ASSERT_EQ(schema_.num_columns(), hot_blocks.column_ids_size());
+
+  // The hot blocks aren't mistaken for a tablet when the server restarts,
+  // and are kept.
+  ASSERT_OK(ShutdownAndRebuildTablet());
+  vector<string> tablet_ids;
+  ASSERT_OK(mini_server_->server()->fs_manager()->ListTabletIds(&tablet_ids));
+  ASSERT_EQ(vector<string>{ kTabletId }, tablet_ids);
+  tablet::HotBlocksPB reloaded;
+  ASSERT_OK(tablet_peer_->tablet_metadata()->LoadHotBlocks(&reloaded));
+  ASSERT_EQ(hot_blocks.ShortDebugString(), reloaded.ShortDebugString());
+
+  WarmUpBlockCacheRequestPB req;
+  WarmUpBlockCacheResponsePB resp;
+  RpcController rpc;
+  req.set_tablet_id(kTabletId);
+  *req.mutable_hot_blocks() = hot_blocks;
+  ASSERT_OK(proxy_->WarmUpBlockCache(req, &resp, &rpc));
+  ASSERT_FALSE(resp.has_error()) << resp.ShortDebugString();
+
+  req.set_tablet_id("not-a-tablet");
+  rpc.Reset();
+  ASSERT_OK(proxy_->WarmUpBlockCache(req, &resp, &rpc));
+  ASSERT_TRUE(resp.has_error());
+  ASSERT_EQ(TabletServerErrorPB::TABLET_NOT_FOUND, resp.error().code());
+}
+
+// Tests that repeated snapshot scans are answered from the scan result cache
+// until the tablet is written to.
+TEST_F(TabletServerTest, TestSnapshotScan_ResultCache) {
+  FLAGS_scan_result_cache_capacity_mb = 1;
+  ASSERT_OK(ShutdownAndRebuildTablet());
+  InsertTestRowsRemote(0, 0, 10);
+  scoped_refptr<MetricEntity> entity = mini_server_->server()->metric_entity();
+  scoped_refptr<Counter> hits = METRIC_scan_result_cache_hits.Instantiate(entity);
+  scoped_refptr<Counter> misses = METRIC_scan_result_cache_misses.Instantiate(entity);
+
+  // Scans at the current time, returning the rows read.
+  auto scan_rows = [&](vector<string>* results) {
+    ScanRequestPB req;
+    ScanResponsePB resp;
+    RpcController rpc;
+    NewScanRequestPB* scan = req.mutable_new_scan_request();
+    scan->set_tablet_id(kTabletId);
+    scan->set_read_mode(READ_AT_SNAPSHOT);
+    ASSERT_OK(SchemaToColumnPBs(schema_, scan->mutable_projected_columns()));
+    req.set_call_seq_id(0);
+    ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+    SCOPED_TRACE(resp.DebugString());
+    ASSERT_FALSE(resp.has_error());
+    ASSERT_FALSE(resp.has_more_results());
+    ASSERT_TRUE(resp.has_snap_timestamp());
+    results->clear();
+    NO_FATALS(StringifyRowsFromResponse(schema_, rpc, resp, results));
+  };
+
+  vector<string> results;
+  NO_FATALS(scan_rows(&results));
+  ASSERT_EQ(10, results.size());
+  ASSERT_EQ(0, hits->value());
+  ASSERT_EQ(1, misses->value());
+
+  vector<string> cached_results;
+  NO_FATALS(scan_rows(&cached_results));
+  ASSERT_EQ(results, cached_results);
+  ASSERT_EQ(1, hits->value());
+
+  // Writes invalidate the cached result.
+  InsertTestRowsRemote(0, 10, 1);
+  NO_FATALS(scan_rows(&results));
+  ASSERT_EQ(11, results.size());
+  ASSERT_EQ(1, hits->value());
+  ASSERT_EQ(2, misses->value());
+}
+
+// Tests that a bounded-staleness scan on the leader reads all committed rows
+// without waiting and returns the snapshot timestamp it read at.
+TEST_F(TabletServerTest, TestBoundedStalenessScanOnLeader) {
+  const int kNumRows = 10;
+  vector<uint64_t> write_timestamps_collector;
+  InsertTestRowsRemote(0, 0, kNumRows, 1, nullptr, kTabletId, &write_timestamps_collector);
+  ASSERT_EQ(1, write_timestamps_collector.size());
+
+  ScanRequestPB req;
+  ScanResponsePB resp;
+  RpcController rpc;
+
+  NewScanRequestPB* scan = req.mutable_new_scan_request();
+  scan->set_tablet_id(kTabletId);
+  scan->set_read_mode(READ_BOUNDED_STALENESS);
+  scan->set_max_staleness_usec(10 * 1000 * 1000);
+  ASSERT_OK(SchemaToColumnPBs(schema_, scan->mutable_projected_columns()));
+  req.set_call_seq_id(0);
+  req.set_batch_size_bytes(0); // so it won't return data right away
+  rpc.RequireServerFeature(TabletServerFeatures::BOUNDED_STALENESS_READS);
+  {
+    SCOPED_TRACE(req.DebugString());
+    ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+    SCOPED_TRACE(resp.DebugString());
+    ASSERT_FALSE(resp.has_error());
+  }
+
+  // The leader's safe time is past the write, so the scan sees every row.
+  ASSERT_GT(resp.snap_timestamp(), write_timestamps_collector[0]);
+  ASSERT_TRUE(resp.has_more_results());
+  vector<string> results;
+  ASSERT_NO_FATAL_FAILURE(DrainScannerToStrings(resp.scanner_id(), schema_, &results));
+  ASSERT_EQ(kNumRows, results.size());
+}
+
 // Tests that a snapshot in the future (beyond the current time plus maximum
 // synchronization error) fails as an invalid snapshot.
 TEST_F(TabletServerTest, TestSnapshotScan_SnapshotInTheFutureFails) {
@@ -1225,6 +1519,7 @@ TEST_F(TabletServerTest, TestSnapshotScan_LastRow) {
   // Set the internal batching within the tserver to be small. Otherwise,
   // even though we use a small batch size in our request, we'd end up reading
   // many rows at a time.
+  FLAGS_scanner_adaptive_batch_sizing = false;
   FLAGS_scanner_batch_size_rows = 5;
   const int num_rows = AllowSlowTests() ? 1000 : 100;
   const int num_batches = AllowSlowTests() ? 10 : 5;
@@ -1303,6 +1598,62 @@ TEST_F(TabletServerTest, TestSnapshotScan_LastRow) {
   }
 }
 
+// Test a REVERSE_ORDERED scan with a limit, retried from its last row after
+// every response like a fault-tolerant client would.
+TEST_F(TabletServerTest, TestSnapshotScan_ReverseOrderedWithLimit) {
+  FLAGS_scanner_adaptive_batch_sizing = false;
+  FLAGS_scanner_batch_size_rows = 3;
+  // Read the tablet in many small chunks.
+  FLAGS_tablet_reverse_scan_chunk_size_bytes = 1;
+  const int kNumRows = 100;
+  const int kNumRowSets = 4;
+  const int kLimit = 10;
+  for (int i = 0; i < kNumRowSets; i++) {
+    for (int j = 0; j < kNumRows; j++) {
+      if (j % kNumRowSets == i) {
+        InsertTestRowsDirect(j, 1);
+      }
+    }
+    ASSERT_OK(tablet_peer_->tablet()->Flush());
+  }
+
+  ScanResponsePB resp;
+  ScanRequestPB req;
+  NewScanRequestPB* scan = req.mutable_new_scan_request();
+  scan->set_tablet_id(kTabletId);
+  ASSERT_OK(SchemaToColumnPBs(schema_, scan->mutable_projected_columns()));
+  scan->set_read_mode(READ_AT_SNAPSHOT);
+  scan->set_order_mode(REVERSE_ORDERED);
+  req.set_call_seq_id(0);
+  req.set_batch_size_bytes(1);
+
+  vector<string> results;
+  do {
+    RpcController rpc;
+    scan->set_limit(kLimit - results.size());
+    {
+      SCOPED_TRACE(req.DebugString());
+      ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+      SCOPED_TRACE(resp.DebugString());
+      ASSERT_FALSE(resp.has_error());
+    }
+    StringifyRowsFromResponse(schema_, rpc, resp, &results);
+    // Restart the scan below the last row returned, at the same snapshot.
+    scan->set_last_primary_key(resp.last_primary_key());
+    scan->set_snap_timestamp(resp.snap_timestamp());
+  } while (resp.has_more_results());
+
+  // The rows come back from the highest key down, up to the limit.
+  ASSERT_EQ(kLimit, results.size());
+  KuduPartialRow row(&schema_);
+  for (int j = 0; j < kLimit; j++) {
+    int key = kNumRows - 1 - j;
+    ASSERT_OK(row.SetInt32(0, key));
+    ASSERT_OK(row.SetInt32(1, key * 2));
+    ASSERT_OK(row.SetStringCopy(2, StringPrintf("hello %d", key)));
+    ASSERT_EQ("(" + row.ToString() + ")", results[j]);
+  }
+}
 
 // Tests that a read in the future succeeds if a propagated_timestamp (that is even
 // further in the future) follows along. Also tests that the clock was updated so
@@ -1895,6 +2246,42 @@ TEST_F(TabletServerTest, TestCreateTablet_TabletExists) {
   }
 }
 
+// Test creating several tablets with one CreateTablets RPC, where one of them
+// already exists.
+TEST_F(TabletServerTest, TestCreateTablets) {
+  CreateTabletsRequestPB req;
+  CreateTabletsResponsePB resp;
+  RpcController rpc;
+
+  req.set_dest_uuid(mini_server_->server()->fs_manager()->uuid());
+  Schema schema = SchemaBuilder(schema_).Build();
+  for (const string& tablet_id : { string(kTabletId), string("new-tablet-1"),
+                                   string("new-tablet-2") }) {
+    CreateTabletRequestPB* tablet_req = req.add_tablets();
+    tablet_req->set_dest_uuid(req.dest_uuid());
+    tablet_req->set_table_id("testtb");
+    tablet_req->set_tablet_id(tablet_id);
+    tablet_req->mutable_partition()->set_partition_key_start(" ");
+    tablet_req->mutable_partition()->set_partition_key_end(" ");
+    tablet_req->set_table_name("testtb");
+    tablet_req->mutable_config()->CopyFrom(mini_server_->CreateLocalConfig());
+    ASSERT_OK(SchemaToPB(schema, tablet_req->mutable_schema()));
+  }
+
+  rpc.RequireServerFeature(TabletServerAdminFeatures::CREATE_TABLETS);
+  ASSERT_OK(admin_proxy_->CreateTablets(req, &resp, &rpc));
+  SCOPED_TRACE(resp.DebugString());
+  ASSERT_FALSE(resp.has_error());
+  ASSERT_EQ(3, resp.tablets_size());
+  ASSERT_EQ(TabletServerErrorPB::TABLET_ALREADY_EXISTS, resp.tablets(0).error().code());
+  for (int i = 1; i < 3; i++) {
+    ASSERT_FALSE(resp.tablets(i).has_error());
+    scoped_refptr<TabletPeer> tablet;
+    ASSERT_TRUE(mini_server_->server()->tablet_manager()->LookupTablet(
+        req.tablets(i).tablet_id(), &tablet));
+  }
+}
+
 TEST_F(TabletServerTest, TestDeleteTablet) {
   scoped_refptr<TabletPeer> tablet;
 
@@ -1987,6 +2374,90 @@ TEST_F(TabletServerTest, TestDeleteTablet_TabletNotCreated) {
   }
 }
 
+// Test that each update in a MultiUpdateConsensus batch gets its own response,
+// and that an update to a missing tablet doesn't fail the others.
+TEST_F(TabletServerTest, TestMultiUpdateConsensus) {
+  const string& uuid = mini_server_->server()->fs_manager()->uuid();
+  consensus::MultiConsensusRequestPB req;
+  consensus::MultiConsensusResponsePB resp;
+  RpcController rpc;
+  req.set_dest_uuid(uuid);
+  for (const char* tablet_id : { kTabletId, "NotPresentTabletId" }) {
+    consensus::ConsensusRequestPB* update = req.add_requests();
+    update->set_dest_uuid(uuid);
+    update->set_tablet_id(tablet_id);
+    update->set_caller_uuid("fake-leader");
+    update->set_caller_term(0);
+  }
+
+  {
+    SCOPED_TRACE(req.DebugString());
+    ASSERT_OK(consensus_proxy_->MultiUpdateConsensus(req, &resp, &rpc));
+    SCOPED_TRACE(resp.DebugString());
+    ASSERT_FALSE(resp.has_error());
+    ASSERT_EQ(2, resp.responses_size());
+    ASSERT_FALSE(resp.responses(0).has_error());
+    ASSERT_TRUE(resp.responses(0).has_status());
+    ASSERT_TRUE(resp.responses(1).has_error());
+    ASSERT_EQ(TabletServerErrorPB::TABLET_NOT_FOUND, resp.responses(1).error().code());
+  }
+
+  // A batch addressed to another server is rejected as a whole.
+  req.set_dest_uuid("wrong-uuid");
+  resp.Clear();
+  rpc.Reset();
+  ASSERT_OK(consensus_proxy_->MultiUpdateConsensus(req, &resp, &rpc));
+  ASSERT_TRUE(resp.has_error());
+  ASSERT_EQ(TabletServerErrorPB::WRONG_SERVER_UUID, resp.error().code());
+  ASSERT_EQ(0, resp.responses_size());
+}
+
+// Test that the ops of an UpdateConsensus request may be sent in a sidecar.
+TEST_F(TabletServerTest, TestUpdateConsensusOpsInSidecar) {
+  consensus::ConsensusRequestPB req;
+  req.set_dest_uuid(mini_server_->server()->fs_manager()->uuid());
+  req.set_tablet_id(kTabletId);
+  req.set_caller_uuid("fake-leader");
+  req.set_caller_term(0);
+
+  consensus::ReplicateRefPtr msg = consensus::make_scoped_refptr_replicate(
+      new consensus::ReplicateMsg);
+  msg->get()->mutable_id()->set_term(0);
+  msg->get()->mutable_id()->set_index(1);
+  msg->get()->set_timestamp(0);
+  msg->get()->set_op_type(consensus::NO_OP);
+  msg->get()->mutable_noop_request();
+
+  for (const string& sidecar : { msg->EncodedAsOp(), string("not an op") }) {
+    consensus::ConsensusResponsePB resp;
+    RpcController rpc;
+    int idx;
+    gscoped_ptr<faststring> buf(new faststring);
+    buf->append(sidecar);
+    ASSERT_OK(rpc.AddOutboundSidecar(make_gscoped_ptr(new rpc::RpcSidecar(std::move(buf))),
+                                     &idx));
+    rpc.RequireServerFeature(consensus::ConsensusServiceFeatures::OPS_IN_SIDECAR);
+    req.set_ops_sidecar_idx(idx);
+    ASSERT_OK(consensus_proxy_->UpdateConsensus(req, &resp, &rpc));
+    SCOPED_TRACE(resp.DebugString());
+    if (sidecar == msg->EncodedAsOp()) {
+      ASSERT_FALSE(resp.has_error());
+      ASSERT_TRUE(resp.has_status());
+    } else {
+      ASSERT_TRUE(resp.has_error());
+      ASSERT_STR_CONTAINS(resp.error().status().message(), "Unable to parse the ops sidecar");
+    }
+  }
+
+  // The sidecar index must reference a sidecar of the call.
+  consensus::ConsensusResponsePB resp;
+  RpcController rpc;
+  req.set_ops_sidecar_idx(1);
+  ASSERT_OK(consensus_proxy_->UpdateConsensus(req, &resp, &rpc));
+  ASSERT_TRUE(resp.has_error());
+  ASSERT_EQ(AppStatusPB::INVALID_ARGUMENT, resp.error().status().code());
+}
+
 // Test that with concurrent requests to delete the same tablet, one wins and
 // the other fails, with no assertion failures. Regression test for KUDU-345.
 TEST_F(TabletServerTest, TestConcurrentDeleteTablet) {
@@ -2106,7 +2577,7 @@ TEST_F(TabletServerTest, TestWriteOutOfBounds) {
   ASSERT_OK(mini_server_->server()->tablet_manager()->CreateNewTablet(
       "TestWriteOutOfBoundsTable", tabletId,
       partitions[1],
-      tabletId, schema, partition_schema,
+      tabletId, schema, partition_schema, CompactionPolicyPB(),
       mini_server_->CreateLocalConfig(), nullptr));
 
   ASSERT_OK(WaitForTabletRunning(tabletId));
@@ -2205,6 +2676,7 @@ TEST_F(TabletServerTest, TestChecksumScan) {
   ASSERT_FALSE(resp.has_more_results());
 
   // Now test the same thing, but with a scan requiring 2 passes (one per row).
+  FLAGS_scanner_adaptive_batch_sizing = false;
   FLAGS_scanner_batch_size_rows = 1;
   req.set_batch_size_bytes(1);
   controller.Reset();
@@ -17,27 +17,36 @@
 
 #include "kudu/tserver/tablet_server.h"
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <list>
 #include <vector>
 
 #include "kudu/cfile/block_cache.h"
+#include "kudu/fs/block_manager.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/service_if.h"
 #include "kudu/server/rpc_server.h"
 #include "kudu/server/webserver.h"
 #include "kudu/tserver/heartbeater.h"
+#include "kudu/tserver/request_capture.h"
+#include "kudu/tserver/resource_accountant.h"
+#include "kudu/tserver/scan_admission_controller.h"
+#include "kudu/tserver/scan_result_cache.h"
 #include "kudu/tserver/scanners.h"
 #include "kudu/tserver/tablet_service.h"
 #include "kudu/tserver/ts_tablet_manager.h"
 #include "kudu/tserver/tserver-path-handlers.h"
+#include "kudu/tserver/write_admission_controller.h"
 #include "kudu/tserver/tablet_copy_service.h"
 #include "kudu/util/maintenance_manager.h"
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/status.h"
 
+DECLARE_string(request_capture_dir);
+
 using kudu::rpc::ServiceIf;
 using kudu::tablet::TabletPeer;
 using std::shared_ptr;
@@ -53,6 +62,11 @@ TabletServer::TabletServer(const TabletServerOptions& opts)
     opts_(opts),
     tablet_manager_(new TSTabletManager(fs_manager_.get(), this, metric_registry())),
     scanner_manager_(new ScannerManager(metric_entity())),
+    scan_admission_controller_(new ScanAdmissionController(mem_tracker(), metric_entity())),
+    scan_result_cache_(new ScanResultCache(metric_entity())),
+    resource_accountant_(new ResourceAccountant()),
+    request_capture_(new RequestCapture(fs_manager_->env(), FLAGS_request_capture_dir)),
+    write_admission_controller_(new WriteAdmissionController(metric_entity())),
     path_handlers_(new TabletServerPathHandlers(this)),
     maintenance_manager_(new MaintenanceManager(MaintenanceManager::DEFAULT_OPTIONS)) {
 }
@@ -90,6 +104,12 @@ Status TabletServer::Init() {
   RETURN_NOT_OK(ServerBase::Init());
   RETURN_NOT_OK(path_handlers_->Register(web_server_.get()));
 
+  // A persistent block cache may hold blocks deleted while the server was
+  // down, whose IDs may since have been reused.
+  cfile::BlockCache::GetSingleton()->EraseMissingFiles([this](const BlockId& id) {
+      return fs_manager_->BlockExists(id);
+    });
+
   heartbeater_.reset(new Heartbeater(opts_, this));
 
   RETURN_NOT_OK_PREPEND(tablet_manager_->Init(),
@@ -98,6 +118,9 @@ Status TabletServer::Init() {
   RETURN_NOT_OK_PREPEND(scanner_manager_->StartRemovalThread(),
                         "Could not start expired Scanner removal thread");
 
+  RETURN_NOT_OK_PREPEND(request_capture_->StartWriterThread(),
+                        "Could not start request capture writer thread");
+
   initted_ = true;
   return Status::OK();
 }
@@ -125,6 +148,7 @@ Status TabletServer::Start() {
 
   RETURN_NOT_OK(heartbeater_->Start());
   RETURN_NOT_OK(maintenance_manager_->Init());
+  fs_manager_->block_manager()->RegisterMaintenanceOps(maintenance_manager_.get());
 
   google::FlushLogFiles(google::INFO); // Flush the startup messages.
 
@@ -135,6 +159,7 @@ void TabletServer::Shutdown() {
   LOG(INFO) << "TabletServer shutting down...";
 
   if (initted_) {
+    fs_manager_->block_manager()->UnregisterMaintenanceOps();
     maintenance_manager_->Shutdown();
     WARN_NOT_OK(heartbeater_->Stop(), "Failed to stop TS Heartbeat thread");
     ServerBase::Shutdown();
@@ -144,5 +169,19 @@ void TabletServer::Shutdown() {
   LOG(INFO) << "TabletServer shut down complete. Bye!";
 }
 
+void TabletServer::ShutdownAndFlush(const MonoDelta& flush_budget) {
+  LOG(INFO) << "TabletServer shutting down gracefully...";
+
+  if (initted_) {
+    // The tablets are shut down before the RPC server, so that their pending
+    // operations can still be committed by their peers.
+    fs_manager_->block_manager()->UnregisterMaintenanceOps();
+    maintenance_manager_->Shutdown();
+    WARN_NOT_OK(heartbeater_->Stop(), "Failed to stop TS Heartbeat thread");
+    tablet_manager_->ShutdownAndFlush(flush_budget);
+  }
+  Shutdown();
+}
+
 } // namespace tserver
 } // namespace kudu
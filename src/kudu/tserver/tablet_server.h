@@ -40,9 +40,14 @@ class MaintenanceManager;
 namespace tserver {
 
 class Heartbeater;
+class RequestCapture;
+class ResourceAccountant;
+class ScanAdmissionController;
+class ScanResultCache;
 class ScannerManager;
 class TabletServerPathHandlers;
 class TSTabletManager;
+class WriteAdmissionController;
 
 class TabletServer : public server::ServerBase {
  public:
@@ -67,12 +72,31 @@ class TabletServer : public server::ServerBase {
   Status Start();
   void Shutdown();
 
+  // Shuts down like Shutdown(), but first shuts the tablets down gracefully,
+  // flushing them for up to 'flush_budget' while the server still serves
+  // RPCs. See TSTabletManager::ShutdownAndFlush().
+  void ShutdownAndFlush(const MonoDelta& flush_budget);
+
   std::string ToString() const;
 
   TSTabletManager* tablet_manager() { return tablet_manager_.get(); }
 
   ScannerManager* scanner_manager() { return scanner_manager_.get(); }
 
+  ScanAdmissionController* scan_admission_controller() {
+    return scan_admission_controller_.get();
+  }
+
+  ScanResultCache* scan_result_cache() { return scan_result_cache_.get(); }
+
+  ResourceAccountant* resource_accountant() { return resource_accountant_.get(); }
+
+  RequestCapture* request_capture() { return request_capture_.get(); }
+
+  WriteAdmissionController* write_admission_controller() {
+    return write_admission_controller_.get();
+  }
+
   Heartbeater* heartbeater() { return heartbeater_.get(); }
 
   void set_fail_heartbeats_for_tests(bool fail_heartbeats_for_tests) {
@@ -108,6 +132,23 @@ class TabletServer : public server::ServerBase {
   // dependencies.
   gscoped_ptr<ScannerManager> scanner_manager_;
 
+  // Limits the scan requests running at once. Always non-NULL.
+  gscoped_ptr<ScanAdmissionController> scan_admission_controller_;
+
+  // Caches the results of small snapshot scans. Always non-NULL, but may
+  // be disabled.
+  gscoped_ptr<ScanResultCache> scan_result_cache_;
+
+  // Attributes the resources used by RPCs to tablets and users. Always non-NULL.
+  gscoped_ptr<ResourceAccountant> resource_accountant_;
+
+  // Samples the requests received into capture files. Always non-NULL, but
+  // may be disabled.
+  gscoped_ptr<RequestCapture> request_capture_;
+
+  // Holds back write requests under memory pressure. Always non-NULL.
+  gscoped_ptr<WriteAdmissionController> write_admission_controller_;
+
   // Thread responsible for heartbeating to the master.
   gscoped_ptr<Heartbeater> heartbeater_;
 
@@ -17,15 +17,25 @@
 
 #include <glog/logging.h>
 #include <iostream>
+#include <signal.h>
 
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/tserver/tablet_server.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/flags.h"
 #include "kudu/util/init.h"
 #include "kudu/util/logging.h"
 
 using kudu::tserver::TabletServer;
 
+DEFINE_int32(graceful_shutdown_flush_budget_ms, 0,
+             "If positive, SIGTERM shuts the tablet server down gracefully: its "
+             "tablets stop taking writes, step down as leaders and are flushed, "
+             "so that they don't need to replay their WAL on restart. Tablets "
+             "whose flush hasn't started after this many milliseconds are shut "
+             "down without flushing. If 0, SIGTERM terminates the server at once.");
+TAG_FLAG(graceful_shutdown_flush_budget_ms, advanced);
+
 DECLARE_string(rpc_bind_addresses);
 DECLARE_int32(rpc_num_service_threads);
 DECLARE_int32(webserver_port);
@@ -49,6 +59,16 @@ static int TabletServerMain(int argc, char** argv) {
   }
   InitGoogleLoggingSafe(argv[0]);
 
+  // SIGTERM is blocked before any thread is started so that only the main
+  // thread, which waits for it, receives it.
+  sigset_t shutdown_signals;
+  sigemptyset(&shutdown_signals);
+  sigaddset(&shutdown_signals, SIGTERM);
+  bool graceful_shutdown = FLAGS_graceful_shutdown_flush_budget_ms > 0;
+  if (graceful_shutdown) {
+    CHECK_EQ(0, pthread_sigmask(SIG_BLOCK, &shutdown_signals, nullptr));
+  }
+
   TabletServerOptions opts;
   TabletServer server(opts);
   LOG(INFO) << "Initializing tablet server...";
@@ -58,6 +78,13 @@ static int TabletServerMain(int argc, char** argv) {
   CHECK_OK(server.Start());
 
   LOG(INFO) << "Tablet server successfully started.";
+  if (graceful_shutdown) {
+    int sig;
+    CHECK_EQ(0, sigwait(&shutdown_signals, &sig));
+    LOG(INFO) << "Received SIGTERM, shutting down gracefully";
+    server.ShutdownAndFlush(MonoDelta::FromMilliseconds(FLAGS_graceful_shutdown_flush_budget_ms));
+    return 0;
+  }
   while (true) {
     SleepFor(MonoDelta::FromSeconds(60));
   }
@@ -20,6 +20,7 @@
 #include <glog/logging.h>
 #include <gflags/gflags.h>
 
+#include "kudu/cfile/block_cache.h"
 #include "kudu/master/master.h"
 #include "kudu/tserver/tablet_server.h"
 #include "kudu/util/flag_tags.h"
@@ -37,6 +38,7 @@ TAG_FLAG(tserver_master_addrs, stable);
 
 TabletServerOptions::TabletServerOptions() {
   rpc_opts.default_port = TabletServer::kDefaultPort;
+  fs_opts.direct_reads = cfile::BlockCache::ShouldUseDirectReads();
 
   Status s = HostPort::ParseStrings(FLAGS_tserver_master_addrs,
                                     master::Master::kDefaultPort,
@@ -19,36 +19,49 @@
 
 #include <algorithm>
 #include <boost/optional.hpp>
+#include <google/protobuf/io/coded_stream.h>
+#include <limits>
+#include <map>
 #include <memory>
+#include <numeric>
 #include <string>
 #include <vector>
 
 #include "kudu/common/iterator.h"
+#include "kudu/common/scan_aggregate.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/consensus.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/casts.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/escaping.h"
+#include "kudu/gutil/walltime.h"
+#include "kudu/rpc/outbound_call.h"
 #include "kudu/rpc/rpc_context.h"
 #include "kudu/rpc/rpc_sidecar.h"
 #include "kudu/server/hybrid_clock.h"
 #include "kudu/tablet/compaction.h"
 #include "kudu/tablet/metadata.pb.h"
+#include "kudu/tablet/row_checksum.h"
 #include "kudu/tablet/tablet_bootstrap.h"
 #include "kudu/tablet/tablet_metrics.h"
 #include "kudu/tablet/tablet_peer.h"
 #include "kudu/tablet/transactions/alter_schema_transaction.h"
 #include "kudu/tablet/transactions/write_transaction.h"
 #include "kudu/tserver/tablet_copy_service.h"
+#include "kudu/tserver/request_capture.h"
+#include "kudu/tserver/resource_accountant.h"
+#include "kudu/tserver/scan_admission_controller.h"
+#include "kudu/tserver/scan_result_cache.h"
 #include "kudu/tserver/scanners.h"
 #include "kudu/tserver/tablet_server.h"
 #include "kudu/tserver/ts_tablet_manager.h"
 #include "kudu/tserver/tserver.pb.h"
-#include "kudu/util/crc.h"
+#include "kudu/tserver/write_admission_controller.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/flag_tags.h"
@@ -71,11 +84,33 @@ TAG_FLAG(scanner_max_batch_size_bytes, advanced);
 TAG_FLAG(scanner_max_batch_size_bytes, runtime);
 
 DEFINE_int32(scanner_batch_size_rows, 100,
-             "The number of rows to batch for servicing scan requests.");
+             "The number of rows to batch for servicing scan requests, unless "
+             "--scanner_adaptive_batch_sizing is set.");
 TAG_FLAG(scanner_batch_size_rows, advanced);
 TAG_FLAG(scanner_batch_size_rows, runtime);
 
+DEFINE_bool(scanner_adaptive_batch_sizing, true,
+            "Whether to size the batches of rows read for scan requests, and their "
+            "responses, from the width and selectivity of the scan and how fast the "
+            "client consumes the responses, within --scanner_memory_budget_bytes.");
+TAG_FLAG(scanner_adaptive_batch_sizing, advanced);
+TAG_FLAG(scanner_adaptive_batch_sizing, runtime);
+
+DEFINE_int32(scanner_max_parallelism, 1,
+             "The maximum number of rowsets of a tablet read concurrently by an "
+             "unordered scan. Values greater than 1 read rowsets ahead of the "
+             "client on a per-tablet pool of scan threads.");
+TAG_FLAG(scanner_max_parallelism, experimental);
+TAG_FLAG(scanner_max_parallelism, runtime);
+
 // Fault injection flags.
+DEFINE_bool(scanner_count_rows_from_metadata, true,
+            "Whether scans which only count rows, e.g. COUNT(*) aggregates or scans "
+            "of no columns, count them from the metadata of the rowsets where "
+            "possible rather than reading them.");
+TAG_FLAG(scanner_count_rows_from_metadata, advanced);
+TAG_FLAG(scanner_count_rows_from_metadata, runtime);
+
 DEFINE_int32(scanner_inject_latency_on_each_batch_ms, 0,
              "If set, the scanner will pause the specified number of milliesconds "
              "before reading each batch of data on the tablet server. "
@@ -86,6 +121,7 @@ DECLARE_int32(memory_limit_warn_threshold_percentage);
 DECLARE_int32(tablet_history_max_age_sec);
 
 using google::protobuf::RepeatedPtrField;
+using google::protobuf::io::CodedInputStream;
 using kudu::consensus::ChangeConfigRequestPB;
 using kudu::consensus::ChangeConfigResponsePB;
 using kudu::consensus::CONSENSUS_CONFIG_ACTIVE;
@@ -94,11 +130,14 @@ using kudu::consensus::Consensus;
 using kudu::consensus::ConsensusConfigType;
 using kudu::consensus::ConsensusRequestPB;
 using kudu::consensus::ConsensusResponsePB;
+using kudu::consensus::ConsensusServiceFeatures;
 using kudu::consensus::GetLastOpIdRequestPB;
 using kudu::consensus::GetNodeInstanceRequestPB;
 using kudu::consensus::GetNodeInstanceResponsePB;
 using kudu::consensus::LeaderStepDownRequestPB;
 using kudu::consensus::LeaderStepDownResponsePB;
+using kudu::consensus::MultiConsensusRequestPB;
+using kudu::consensus::MultiConsensusResponsePB;
 using kudu::consensus::RunLeaderElectionRequestPB;
 using kudu::consensus::RunLeaderElectionResponsePB;
 using kudu::consensus::StartTabletCopyRequestPB;
@@ -132,21 +171,15 @@ namespace tserver {
 namespace {
 
 // Lookup the given tablet, ensuring that it both exists and is RUNNING.
-// If it is not, responds to the RPC associated with 'context' after setting
-// resp->mutable_error() to indicate the failure reason.
-//
-// Returns true if successful.
-template<class RespClass>
-bool LookupTabletPeerOrRespond(TabletPeerLookupIf* tablet_manager,
+// If it is not, returns a bad Status and sets 'error_code' to indicate the
+// failure reason.
+Status LookupRunningTabletPeer(TabletPeerLookupIf* tablet_manager,
                                const string& tablet_id,
-                               RespClass* resp,
-                               rpc::RpcContext* context,
-                               scoped_refptr<TabletPeer>* peer) {
+                               scoped_refptr<TabletPeer>* peer,
+                               TabletServerErrorPB::Code* error_code) {
   if (PREDICT_FALSE(!tablet_manager->GetTabletPeer(tablet_id, peer).ok())) {
-    SetupErrorAndRespond(resp->mutable_error(),
-                         Status::NotFound("Tablet not found"),
-                         TabletServerErrorPB::TABLET_NOT_FOUND, context);
-    return false;
+    *error_code = TabletServerErrorPB::TABLET_NOT_FOUND;
+    return Status::NotFound("Tablet not found");
   }
 
   // Check RUNNING state.
@@ -157,8 +190,26 @@ bool LookupTabletPeerOrRespond(TabletPeerLookupIf* tablet_manager,
     if (state == tablet::FAILED) {
       s = s.CloneAndAppend((*peer)->error().ToString());
     }
-    SetupErrorAndRespond(resp->mutable_error(), s,
-                         TabletServerErrorPB::TABLET_NOT_RUNNING, context);
+    *error_code = TabletServerErrorPB::TABLET_NOT_RUNNING;
+    return s;
+  }
+  return Status::OK();
+}
+
+// Like LookupRunningTabletPeer(), but on failure responds to the RPC
+// associated with 'context' after setting resp->mutable_error().
+//
+// Returns true if successful.
+template<class RespClass>
+bool LookupTabletPeerOrRespond(TabletPeerLookupIf* tablet_manager,
+                               const string& tablet_id,
+                               RespClass* resp,
+                               rpc::RpcContext* context,
+                               scoped_refptr<TabletPeer>* peer) {
+  TabletServerErrorPB::Code error_code;
+  Status s = LookupRunningTabletPeer(tablet_manager, tablet_id, peer, &error_code);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
     return false;
   }
   return true;
@@ -210,6 +261,71 @@ bool GetConsensusOrRespond(const scoped_refptr<TabletPeer>& tablet_peer,
   return true;
 }
 
+// Applies a consensus update to the tablet it's addressed to. Unlike the
+// helpers above, failures are reported in resp->mutable_error() without
+// responding to any RPC, so that one update in a batch doesn't fail the others.
+void UpdateConsensusOrSetError(TabletPeerLookupIf* tablet_manager,
+                               const ConsensusRequestPB& req,
+                               ConsensusResponsePB* resp) {
+  scoped_refptr<TabletPeer> tablet_peer;
+  scoped_refptr<Consensus> consensus;
+  TabletServerErrorPB::Code code = TabletServerErrorPB::UNKNOWN_ERROR;
+  Status s;
+  if (PREDICT_FALSE(!tablet_manager->GetTabletPeer(req.tablet_id(), &tablet_peer).ok())) {
+    s = Status::NotFound("Tablet not found");
+    code = TabletServerErrorPB::TABLET_NOT_FOUND;
+  } else if (PREDICT_FALSE(tablet_peer->state() != tablet::RUNNING)) {
+    s = Status::IllegalState("Tablet not RUNNING",
+                             tablet::TabletStatePB_Name(tablet_peer->state()));
+    code = TabletServerErrorPB::TABLET_NOT_RUNNING;
+  } else if (PREDICT_FALSE(!(consensus = tablet_peer->shared_consensus()))) {
+    s = Status::ServiceUnavailable("Consensus unavailable. Tablet not running");
+    code = TabletServerErrorPB::TABLET_NOT_RUNNING;
+  } else {
+    s = consensus->Update(&req, resp);
+  }
+  if (PREDICT_FALSE(!s.ok())) {
+    resp->Clear();
+    StatusToPB(s, resp->mutable_error()->mutable_status());
+    resp->mutable_error()->set_code(code);
+  }
+}
+
+// Copies 'req' into 'merged', along with the ops that were sent in the
+// request's sidecar.
+Status MergeOpsFromSidecar(const ConsensusRequestPB& req,
+                           const RpcContext* context,
+                           ConsensusRequestPB* merged) {
+  Slice sidecar;
+  RETURN_NOT_OK(context->GetInboundSidecar(req.ops_sidecar_idx(), &sidecar));
+  merged->CopyFrom(req);
+  merged->clear_ops_sidecar_idx();
+  // The sidecar holds encoded 'ops' entries, so it can be merged as-is.
+  CodedInputStream cis(sidecar.data(), sidecar.size());
+  if (PREDICT_FALSE(!merged->MergeFromCodedStream(&cis))) {
+    return Status::Corruption("Unable to parse the ops sidecar",
+                              merged->InitializationErrorString());
+  }
+  return Status::OK();
+}
+
+// Fetches the encoded rows and indirect data of a write request which were
+// sent in the request's sidecars.
+Status GetRowsFromSidecars(const WriteRequestPB& req,
+                           const RpcContext* context,
+                           Slice* rows,
+                           Slice* indirect_data) {
+  RETURN_NOT_OK_PREPEND(context->GetInboundSidecar(req.rows_sidecar(), rows),
+                        "Unable to get the rows sidecar");
+  if (req.has_indirect_data_sidecar()) {
+    RETURN_NOT_OK_PREPEND(context->GetInboundSidecar(req.indirect_data_sidecar(), indirect_data),
+                          "Unable to get the indirect data sidecar");
+  } else {
+    *indirect_data = Slice();
+  }
+  return Status::OK();
+}
+
 Status GetTabletRef(const scoped_refptr<TabletPeer>& tablet_peer,
                     shared_ptr<Tablet>* tablet,
                     TabletServerErrorPB::Code* error_code) {
@@ -244,6 +360,91 @@ static StatusCallback BindHandleResponse(const ReqType* req, RespType* resp, Rpc
   return Bind(&HandleResponse<ReqType, RespType>, req, resp, context);
 }
 
+// Charges the resources used by the current thread during the lifetime of
+// this object to the user who sent an RPC and to the tablet it's for. The
+// tablet is looked up when the charge is made, so that it's charged even if
+// the RPC was already responded to, and nothing is charged if it's gone.
+class ScopedRpcResourceCharge {
+ public:
+  ScopedRpcResourceCharge(TabletServer* server, RpcContext* context, string tablet_id)
+      : server_(server),
+        user_(context->user_credentials().real_user()),
+        tablet_id_(std::move(tablet_id)) {
+  }
+
+  ~ScopedRpcResourceCharge() {
+    tablet::TabletMetrics* metrics = nullptr;
+    scoped_refptr<TabletPeer> tablet_peer;
+    shared_ptr<Tablet> tablet;
+    if (!tablet_id_.empty() &&
+        server_->tablet_manager()->LookupTablet(tablet_id_, &tablet_peer) &&
+        (tablet = tablet_peer->shared_tablet())) {
+      metrics = tablet->metrics();
+    }
+    server_->resource_accountant()->ChargeRpc(user_, metrics, meter_.Elapsed());
+  }
+
+ private:
+  TabletServer* const server_;
+  const string user_;
+  const string tablet_id_;
+  ResourceUsageMeter meter_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedRpcResourceCharge);
+};
+
+// A request sampled for the server's request capture, which is appended to
+// it along with the time taken to handle the request once this is destroyed,
+// after the request was responded to.
+class PendingCapture {
+ public:
+  // Does nothing unless the request of 'context' to 'tablet_id' is sampled.
+  PendingCapture(TabletServer* server, const RpcContext* context, const string& tablet_id,
+                 CapturedRequestPB::Method method)
+      : server_(server),
+        received_(context->GetTimeReceived()) {
+    scoped_refptr<TabletPeer> tablet_peer;
+    if (!server->request_capture()->ShouldCapture() ||
+        !server->tablet_manager()->LookupTablet(tablet_id, &tablet_peer)) {
+      return;
+    }
+    record_.reset(new CapturedRequestPB());
+    record_->set_method(method);
+    record_->set_received_unix_us(
+        GetCurrentTimeMicros() - (MonoTime::Now() - received_).ToMicroseconds());
+    record_->set_user(context->user_credentials().real_user());
+    record_->set_remote_address(context->remote_address().ToString());
+    MonoTime deadline = context->GetClientDeadline();
+    if (deadline != MonoTime::Max()) {
+      record_->set_timeout_ms((deadline - received_).ToMilliseconds());
+    }
+    record_->set_table_name(tablet_peer->tablet_metadata()->table_name());
+    record_->set_partition_key_start(
+        tablet_peer->tablet_metadata()->partition().partition_key_start());
+  }
+
+  ~PendingCapture() {
+    if (record_) {
+      record_->set_handler_time_us((MonoTime::Now() - received_).ToMicroseconds());
+      Status s = server_->request_capture()->Append(std::move(record_));
+      if (PREDICT_FALSE(!s.ok())) {
+        KLOG_EVERY_N_SECS(WARNING, 10) << "Unable to capture request: " << s.ToString()
+                                       << THROTTLE_MSG;
+      }
+    }
+  }
+
+  // The record of the request, or null if it isn't captured.
+  CapturedRequestPB* record() { return record_.get(); }
+
+ private:
+  TabletServer* const server_;
+  const MonoTime received_;
+  gscoped_ptr<CapturedRequestPB> record_;
+
+  DISALLOW_COPY_AND_ASSIGN(PendingCapture);
+};
+
 } // namespace
 
 typedef ListTabletsResponsePB::StatusAndSchemaPB StatusAndSchemaPB;
@@ -288,12 +489,21 @@ class RpcTransactionCompletionCallback : public TransactionCompletionCallback {
 
   virtual void TransactionCompleted() OVERRIDE {
     if (!status_.ok()) {
+      if (!leader_uuid_.empty()) {
+        get_error()->set_leader_uuid(leader_uuid_);
+      }
       SetupErrorAndRespond(get_error(), status_, code_, context_);
     } else {
       context_->RespondSuccess();
     }
+    capture_.reset();
   };
 
+  // Captures the request once it's been responded to.
+  void set_capture(unique_ptr<PendingCapture> capture) {
+    capture_ = std::move(capture);
+  }
+
  private:
 
   TabletServerErrorPB* get_error() {
@@ -303,6 +513,55 @@ class RpcTransactionCompletionCallback : public TransactionCompletionCallback {
   rpc::RpcContext* context_;
   Response* response_;
   tablet::TransactionState* state_;
+  unique_ptr<PendingCapture> capture_;
+};
+
+// The writes of a MultiWrite RPC which are still in progress. The RPC is
+// responded to once they all complete.
+class MultiWriteState : public RefCountedThreadSafe<MultiWriteState> {
+ public:
+  MultiWriteState(rpc::RpcContext* context, int num_writes)
+      : context_(context),
+        num_pending_(num_writes) {
+  }
+
+  void WriteCompleted() {
+    if (num_pending_.IncrementBy(-1) == 0) {
+      context_->RespondSuccess();
+    }
+  }
+
+ private:
+  friend class RefCountedThreadSafe<MultiWriteState>;
+  ~MultiWriteState() {}
+
+  rpc::RpcContext* context_;
+  AtomicInt<int32_t> num_pending_;
+};
+
+// Reports the outcome of one of the writes of a MultiWrite RPC in its own
+// response, without failing the other writes.
+class MultiWriteCompletionCallback : public TransactionCompletionCallback {
+ public:
+  MultiWriteCompletionCallback(scoped_refptr<MultiWriteState> state,
+                               WriteResponsePB* response)
+      : state_(std::move(state)),
+        response_(response) {}
+
+  void TransactionCompleted() override {
+    if (!status_.ok()) {
+      StatusToPB(status_, response_->mutable_error()->mutable_status());
+      response_->mutable_error()->set_code(code_);
+      if (!leader_uuid_.empty()) {
+        response_->mutable_error()->set_leader_uuid(leader_uuid_);
+      }
+    }
+    state_->WriteCompleted();
+  }
+
+ private:
+  scoped_refptr<MultiWriteState> state_;
+  WriteResponsePB* response_;
 };
 
 // Generic interface to handle scan results.
@@ -322,10 +581,72 @@ class ScanResultCollector {
 
   // Return the number of rows actually returned to the client.
   virtual int64_t NumRowsReturned() const = 0;
+
+  // Sets the bitmask of RowFormatFlags with which rows should be returned.
+  // Must be called before any calls to HandleRowBlock(). Collectors which
+  // don't return rows to the client may ignore the flags.
+  virtual void set_row_format_flags(uint64_t row_format_flags) {}
+
+  // Sets the aggregates which should be computed over the scanned rows in
+  // place of returning them, and the schema of the aggregate results. Must be
+  // called before any calls to HandleRowBlock(). Collectors which don't return
+  // rows to the client may ignore the aggregates.
+  virtual void set_aggregates(const vector<ScanAggregate>& aggregates,
+                              const Schema* result_schema) {}
+
+  // Sets the grouping of the aggregates, if they are grouped. Must be called
+  // after set_aggregates(), with the aggregates and result schema of the
+  // grouping.
+  virtual void set_group_by(const ScanGroupBy* group_by) {}
+
+  // Sets the token from which the scan may be resumed after the rows
+  // collected so far. Collectors which don't return rows to the client may
+  // ignore the token.
+  virtual void set_resume_token(const string& resume_token) {}
+
+  // Sets the fraction of the rows considered so far by a sampled scan which
+  // were sampled. Collectors which don't return rows to the client may
+  // ignore the rate.
+  virtual void set_effective_sample_rate(double rate) {}
+
+  // Returns the profile to which the work done for the response is added, or
+  // NULL if the client didn't ask for one. Collectors which don't return rows
+  // to the client return NULL.
+  virtual ScanProfilePB* profile() { return nullptr; }
+
+  // Whether the collector may be given row counts with HandleRowCount(), for
+  // scans which only count rows, in place of the row blocks.
+  virtual bool AcceptsRowCounts() const { return false; }
+
+  // Accounts for 'count' rows of an empty projection matched by the scan.
+  // Only called if AcceptsRowCounts().
+  virtual void HandleRowCount(int64_t count) {
+    LOG(DFATAL) << "Row counts aren't accepted";
+  }
 };
 
 namespace {
 
+// Unselects the rows of 'block' past the limit of 'scanner', and counts the
+// others against it.
+void ApplyScanLimit(Scanner* scanner, RowBlock* block) {
+  int64_t remaining = scanner->remaining_rows();
+  SelectionVector* sel = block->selection_vector();
+  int64_t selected = sel->CountSelected();
+  if (selected <= remaining) {
+    scanner->set_remaining_rows(remaining - selected);
+    return;
+  }
+  sel->ForEachSelectedRow([&](size_t i) {
+    if (remaining == 0) {
+      sel->SetRowUnselected(i);
+    } else {
+      remaining--;
+    }
+  });
+  scanner->set_remaining_rows(remaining);
+}
+
 // Given a RowBlock, set last_primary_key to the primary key of the last selected row
 // in the RowBlock. If no row is selected, last_primary_key is not set.
 void SetLastRow(const RowBlock& row_block, faststring* last_primary_key) {
@@ -355,20 +676,29 @@ void SetLastRow(const RowBlock& row_block, faststring* last_primary_key) {
 // server-side scan and thus never need to return the actual data.)
 class ScanResultCopier : public ScanResultCollector {
  public:
-  ScanResultCopier(RowwiseRowBlockPB* rowblock_pb, faststring* rows_data, faststring* indirect_data)
-      : rowblock_pb_(DCHECK_NOTNULL(rowblock_pb)),
-        rows_data_(DCHECK_NOTNULL(rows_data)),
-        indirect_data_(DCHECK_NOTNULL(indirect_data)),
+  explicit ScanResultCopier(size_t batch_size_bytes)
+      : rows_data_(new faststring(batch_size_bytes * 11 / 10)),
+        indirect_data_(new faststring(batch_size_bytes * 11 / 10)),
         blocks_processed_(0),
-        num_rows_returned_(0) {
+        num_rows_returned_(0),
+        row_format_flags_(RowFormatFlags::NO_FLAGS),
+        effective_sample_rate_(-1),
+        profile_(nullptr) {
   }
 
   virtual void HandleRowBlock(const Schema* client_projection_schema,
                               const RowBlock& row_block) OVERRIDE {
     blocks_processed_++;
-    num_rows_returned_ += row_block.selection_vector()->CountSelected();
-    SerializeRowBlock(row_block, rowblock_pb_, client_projection_schema,
-                      rows_data_, indirect_data_);
+    if (group_by_) {
+      group_by_->Accumulate(row_block);
+    } else if (!aggregates_.empty()) {
+      for (ScanAggregate& aggregate : aggregates_) {
+        aggregate.Accumulate(row_block);
+      }
+    } else {
+      num_rows_returned_ += row_block.selection_vector()->CountSelected();
+      SerializeRows(client_projection_schema, row_block);
+    }
     SetLastRow(row_block, &last_primary_key_);
   }
 
@@ -376,6 +706,19 @@ class ScanResultCopier : public ScanResultCollector {
 
   // Returns number of bytes buffered to return.
   virtual int64_t ResponseSize() const OVERRIDE {
+    if (group_by_) {
+      // The groups are held until the response is sent, so they count
+      // against the batch size: once they fill it, the response is sent
+      // with the groups so far, and the scan continues with new groups.
+      return group_by_->memory_footprint();
+    }
+    if (!aggregates_.empty()) {
+      // Only the single row of aggregate results is returned.
+      return 0;
+    }
+    if (row_format_flags_ & RowFormatFlags::COLUMNAR_LAYOUT) {
+      return ColumnarSerializedBatchSize(columnar_batch_);
+    }
     return rows_data_->size() + indirect_data_->size();
   }
 
@@ -384,16 +727,198 @@ class ScanResultCopier : public ScanResultCollector {
   }
 
   virtual int64_t NumRowsReturned() const OVERRIDE {
+    if (group_by_) {
+      return group_by_->num_groups();
+    }
+    if (!aggregates_.empty()) {
+      return blocks_processed_ > 0 ? 1 : 0;
+    }
     return num_rows_returned_;
   }
 
+  virtual void set_row_format_flags(uint64_t row_format_flags) OVERRIDE {
+    DCHECK_EQ(0, blocks_processed_);
+    row_format_flags_ = row_format_flags;
+    columnar_batch_.dictionary_encode = row_format_flags & RowFormatFlags::COLUMNAR_DICTIONARY;
+  }
+
+  virtual void set_aggregates(const vector<ScanAggregate>& aggregates,
+                              const Schema* result_schema) OVERRIDE {
+    DCHECK_EQ(0, blocks_processed_);
+    aggregates_ = aggregates;
+    // Copied, since the scanner which owns the schema may go away before the
+    // response is set up.
+    if (result_schema) {
+      aggregate_result_schema_ = *result_schema;
+    }
+  }
+
+  virtual void set_group_by(const ScanGroupBy* group_by) OVERRIDE {
+    DCHECK_EQ(0, blocks_processed_);
+    if (group_by) {
+      group_by_ = group_by->CloneEmpty();
+    }
+  }
+
+  virtual bool AcceptsRowCounts() const OVERRIDE {
+    // The projection of grouped aggregates holds the grouping columns.
+    return !(row_format_flags_ & RowFormatFlags::COLUMNAR_LAYOUT) && !group_by_;
+  }
+
+  virtual void HandleRowCount(int64_t count) OVERRIDE {
+    blocks_processed_++;
+    if (!aggregates_.empty()) {
+      for (ScanAggregate& aggregate : aggregates_) {
+        // Only COUNT(*) aggregates have an empty projection.
+        DCHECK_EQ(ScanAggregatePB::COUNT, aggregate.function());
+        aggregate.Merge(&count);
+      }
+    } else {
+      // The rows of an empty projection take no space.
+      rowblock_pb_.set_num_rows(rowblock_pb_.num_rows() + count);
+      num_rows_returned_ += count;
+    }
+  }
+
+  virtual void set_resume_token(const string& resume_token) OVERRIDE {
+    resume_token_ = resume_token;
+  }
+
+  const string& resume_token() const { return resume_token_; }
+
+  virtual void set_effective_sample_rate(double rate) OVERRIDE {
+    effective_sample_rate_ = rate;
+  }
+
+  // The effective sample rate of a sampled scan, or -1 for other scans.
+  double effective_sample_rate() const { return effective_sample_rate_; }
+
+  virtual ScanProfilePB* profile() OVERRIDE { return profile_; }
+
+  void set_profile(ScanProfilePB* profile) { profile_ = profile; }
+
+  // Moves the collected rows into 'resp', attaching their data to 'context'
+  // as sidecars. If 'sidecar_copies' isn't NULL, copies of the sidecars are
+  // appended to it in the order they're attached.
+  void SetupResponse(rpc::RpcContext* context, ScanResponsePB* resp,
+                     vector<string>* sidecar_copies = nullptr) {
+    if (!aggregates_.empty()) {
+      SerializeAggregateResults();
+    }
+
+    if (row_format_flags_ & RowFormatFlags::COLUMNAR_LAYOUT) {
+      ColumnarRowBlockPB* columnar_pb = resp->mutable_columnar_data();
+      gscoped_ptr<faststring> sidecar(new faststring());
+      FinishColumnarSerializedBatch(columnar_batch_, columnar_pb, sidecar.get());
+      if (sidecar_copies) {
+        sidecar_copies->push_back(sidecar->ToString());
+      }
+      int sidecar_idx;
+      CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+          new rpc::RpcSidecar(std::move(sidecar))), &sidecar_idx));
+      columnar_pb->set_sidecar(sidecar_idx);
+      return;
+    }
+
+    resp->mutable_data()->CopyFrom(rowblock_pb_);
+
+    // Add sidecar data to context and record the returned indices.
+    if (sidecar_copies) {
+      sidecar_copies->push_back(rows_data_->ToString());
+    }
+    int rows_idx;
+    CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+        new rpc::RpcSidecar(std::move(rows_data_))), &rows_idx));
+    resp->mutable_data()->set_rows_sidecar(rows_idx);
+
+    // Add indirect data as a sidecar, if applicable.
+    if (indirect_data_->size() > 0) {
+      if (sidecar_copies) {
+        sidecar_copies->push_back(indirect_data_->ToString());
+      }
+      int indirect_idx;
+      CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+          new rpc::RpcSidecar(std::move(indirect_data_))), &indirect_idx));
+      resp->mutable_data()->set_indirect_data_sidecar(indirect_idx);
+    }
+  }
+
  private:
-  RowwiseRowBlockPB* const rowblock_pb_;
-  faststring* const rows_data_;
-  faststring* const indirect_data_;
+  void SerializeRows(const Schema* client_projection_schema, const RowBlock& row_block) {
+    if (row_format_flags_ & RowFormatFlags::COLUMNAR_LAYOUT) {
+      SerializeRowBlockColumnar(row_block, client_projection_schema, &columnar_batch_);
+    } else {
+      SerializeRowBlock(row_block, &rowblock_pb_, client_projection_schema,
+                        rows_data_.get(), indirect_data_.get());
+    }
+  }
+
+  // Serializes the partial results of the aggregates as the single row of
+  // the response, or as a row per group if they're grouped.
+  void SerializeAggregateResults() {
+    if (group_by_) {
+      SerializeGroupedAggregateResults();
+      return;
+    }
+    Arena arena(256, 4 * 1024);
+    RowBlock block(aggregate_result_schema_, 1, &arena);
+    block.selection_vector()->SetAllTrue();
+    RowBlockRow row = block.row(0);
+    for (int i = 0; i < aggregates_.size(); i++) {
+      ColumnBlockCell cell = row.cell(i);
+      bool has_result = aggregates_[i].GetResult(cell.mutable_ptr());
+      if (cell.is_nullable()) {
+        cell.set_null(!has_result);
+      }
+    }
+    SerializeRows(nullptr, block);
+  }
+
+  void SerializeGroupedAggregateResults() {
+    if (group_by_->num_groups() == 0) {
+      return;
+    }
+    // The cells of BINARY grouping values and results point into the
+    // grouping, so nothing is allocated from the arena.
+    Arena arena(256, 4 * 1024);
+    RowBlock block(aggregate_result_schema_, group_by_->num_groups(), &arena);
+    block.selection_vector()->SetAllTrue();
+    for (size_t g = 0; g < group_by_->num_groups(); g++) {
+      RowBlockRow row = block.row(g);
+      for (int i = 0; i < aggregate_result_schema_.num_columns(); i++) {
+        ColumnBlockCell cell = row.cell(i);
+        bool has_result = group_by_->GetResult(g, i, cell.mutable_ptr());
+        if (cell.is_nullable()) {
+          cell.set_null(!has_result);
+        }
+      }
+    }
+    SerializeRows(nullptr, block);
+  }
+
+  RowwiseRowBlockPB rowblock_pb_;
+  gscoped_ptr<faststring> rows_data_;
+  gscoped_ptr<faststring> indirect_data_;
+  ColumnarSerializedBatch columnar_batch_;
   int blocks_processed_;
   int64_t num_rows_returned_;
   faststring last_primary_key_;
+  uint64_t row_format_flags_;
+
+  // The aggregates accumulated over the rows of this response, if this is an
+  // aggregating scan, and the schema of their results.
+  vector<ScanAggregate> aggregates_;
+  Schema aggregate_result_schema_;
+
+  // The groups of the aggregates accumulated over the rows of this
+  // response, if the aggregates are grouped.
+  unique_ptr<ScanGroupBy> group_by_;
+
+  string resume_token_;
+
+  double effective_sample_rate_;
+
+  ScanProfilePB* profile_;
 
   DISALLOW_COPY_AND_ASSIGN(ScanResultCopier);
 };
@@ -402,10 +927,8 @@ class ScanResultCopier : public ScanResultCollector {
 class ScanResultChecksummer : public ScanResultCollector {
  public:
   ScanResultChecksummer()
-      : crc_(crc::GetCrc32cInstance()),
-        agg_checksum_(0),
-        blocks_processed_(0),
-        rows_checksummed_(0) {
+      : previous_checksum_(0),
+        blocks_processed_(0) {
   }
 
   virtual void HandleRowBlock(const Schema* client_projection_schema,
@@ -418,9 +941,7 @@ class ScanResultChecksummer : public ScanResultCollector {
     size_t nrows = row_block.nrows();
     for (size_t i = 0; i < nrows; i++) {
       if (!row_block.selection_vector()->IsRowSelected(i)) continue;
-      uint32_t row_crc = CalcRowCrc32(*client_projection_schema, row_block.row(i));
-      agg_checksum_ += row_crc;
-      rows_checksummed_++;
+      checksummer_.AddRow(*client_projection_schema, row_block.row(i));
     }
     // Find the last selected row and save its encoded key.
     SetLastRow(row_block, &encoded_last_row_);
@@ -429,7 +950,7 @@ class ScanResultChecksummer : public ScanResultCollector {
   virtual int BlocksProcessed() const OVERRIDE { return blocks_processed_; }
 
   // Returns a constant -- we only return checksum based on a time budget.
-  virtual int64_t ResponseSize() const OVERRIDE { return sizeof(agg_checksum_); }
+  virtual int64_t ResponseSize() const OVERRIDE { return sizeof(uint64_t); }
 
   virtual const faststring& last_primary_key() const OVERRIDE { return encoded_last_row_; }
 
@@ -438,46 +959,18 @@ class ScanResultChecksummer : public ScanResultCollector {
   }
 
   int64_t rows_checksummed() const {
-    return rows_checksummed_;
+    return checksummer_.num_rows();
   }
 
   // Accessors for initializing / setting the checksum.
-  void set_agg_checksum(uint64_t value) { agg_checksum_ = value; }
-  uint64_t agg_checksum() const { return agg_checksum_; }
+  void set_agg_checksum(uint64_t value) { previous_checksum_ = value; }
+  uint64_t agg_checksum() const { return previous_checksum_ + checksummer_.checksum(); }
 
  private:
-  // Calculates a CRC32C for the given row.
-  uint32_t CalcRowCrc32(const Schema& projection, const RowBlockRow& row) {
-    tmp_buf_.clear();
-
-    for (size_t j = 0; j < projection.num_columns(); j++) {
-      uint32_t col_index = static_cast<uint32_t>(j);  // For the CRC.
-      tmp_buf_.append(&col_index, sizeof(col_index));
-      ColumnBlockCell cell = row.cell(j);
-      if (cell.is_nullable()) {
-        uint8_t is_defined = cell.is_null() ? 0 : 1;
-        tmp_buf_.append(&is_defined, sizeof(is_defined));
-        if (!is_defined) continue;
-      }
-      if (cell.typeinfo()->physical_type() == BINARY) {
-        const Slice* data = reinterpret_cast<const Slice *>(cell.ptr());
-        tmp_buf_.append(data->data(), data->size());
-      } else {
-        tmp_buf_.append(cell.ptr(), cell.size());
-      }
-    }
-
-    uint64_t row_crc = 0;
-    crc_->Compute(tmp_buf_.data(), tmp_buf_.size(), &row_crc, nullptr);
-    return static_cast<uint32_t>(row_crc); // CRC32 only uses the lower 32 bits.
-  }
-
-
-  faststring tmp_buf_;
-  crc::Crc* const crc_;
-  uint64_t agg_checksum_;
+  // The checksum returned by the previous request of the scan.
+  uint64_t previous_checksum_;
+  tablet::RowChecksummer checksummer_;
   int blocks_processed_;
-  int64_t rows_checksummed_;
   faststring encoded_last_row_;
 
   DISALLOW_COPY_AND_ASSIGN(ScanResultChecksummer);
@@ -585,64 +1078,98 @@ void TabletServiceAdminImpl::AlterSchema(const AlterSchemaRequestPB* req,
   }
 }
 
-void TabletServiceAdminImpl::CreateTablet(const CreateTabletRequestPB* req,
-                                          CreateTabletResponsePB* resp,
-                                          rpc::RpcContext* context) {
-  if (!CheckUuidMatchOrRespond(server_->tablet_manager(), "CreateTablet", req, resp, context)) {
-    return;
-  }
+bool TabletServiceAdminImpl::SupportsFeature(uint32_t feature) const {
+  return feature == TabletServerAdminFeatures::CREATE_TABLETS;
+}
+
+namespace {
+
+// Creates the new tablet described by 'req' on 'server'. On failure, sets
+// 'error_code' to the error to return to the master.
+Status CreateTabletFromRequest(TabletServer* server,
+                               const CreateTabletRequestPB& req,
+                               TabletServerErrorPB::Code* error_code) {
   TRACE_EVENT1("tserver", "CreateTablet",
-               "tablet_id", req->tablet_id());
+               "tablet_id", req.tablet_id());
 
   Schema schema;
-  Status s = SchemaFromPB(req->schema(), &schema);
+  Status s = SchemaFromPB(req.schema(), &schema);
   DCHECK(schema.has_column_ids());
   if (!s.ok()) {
-    SetupErrorAndRespond(resp->mutable_error(),
-                         Status::InvalidArgument("Invalid Schema."),
-                         TabletServerErrorPB::INVALID_SCHEMA, context);
-    return;
+    *error_code = TabletServerErrorPB::INVALID_SCHEMA;
+    return Status::InvalidArgument("Invalid Schema.");
   }
 
   PartitionSchema partition_schema;
-  s = PartitionSchema::FromPB(req->partition_schema(), schema, &partition_schema);
+  s = PartitionSchema::FromPB(req.partition_schema(), schema, &partition_schema);
   if (!s.ok()) {
-    SetupErrorAndRespond(resp->mutable_error(),
-                         Status::InvalidArgument("Invalid PartitionSchema."),
-                         TabletServerErrorPB::INVALID_SCHEMA, context);
-    return;
+    *error_code = TabletServerErrorPB::INVALID_SCHEMA;
+    return Status::InvalidArgument("Invalid PartitionSchema.");
   }
 
   Partition partition;
-  Partition::FromPB(req->partition(), &partition);
+  Partition::FromPB(req.partition(), &partition);
 
-  LOG(INFO) << "Processing CreateTablet for tablet " << req->tablet_id()
-            << " (table=" << req->table_name()
-            << " [id=" << req->table_id() << "]), partition="
+  LOG(INFO) << "Processing CreateTablet for tablet " << req.tablet_id()
+            << " (table=" << req.table_name()
+            << " [id=" << req.table_id() << "]), partition="
             << partition_schema.PartitionDebugString(partition, schema);
-  VLOG(1) << "Full request: " << req->DebugString();
-
-  s = server_->tablet_manager()->CreateNewTablet(req->table_id(),
-                                                 req->tablet_id(),
-                                                 partition,
-                                                 req->table_name(),
-                                                 schema,
-                                                 partition_schema,
-                                                 req->config(),
-                                                 nullptr);
+  VLOG(1) << "Full request: " << req.DebugString();
+
+  s = server->tablet_manager()->CreateNewTablet(req.table_id(),
+                                                req.tablet_id(),
+                                                partition,
+                                                req.table_name(),
+                                                schema,
+                                                partition_schema,
+                                                req.compaction_policy(),
+                                                req.config(),
+                                                nullptr);
   if (PREDICT_FALSE(!s.ok())) {
-    TabletServerErrorPB::Code code;
     if (s.IsAlreadyPresent()) {
-      code = TabletServerErrorPB::TABLET_ALREADY_EXISTS;
+      *error_code = TabletServerErrorPB::TABLET_ALREADY_EXISTS;
     } else {
-      code = TabletServerErrorPB::UNKNOWN_ERROR;
+      *error_code = TabletServerErrorPB::UNKNOWN_ERROR;
     }
+  }
+  return s;
+}
+
+} // anonymous namespace
+
+void TabletServiceAdminImpl::CreateTablet(const CreateTabletRequestPB* req,
+                                          CreateTabletResponsePB* resp,
+                                          rpc::RpcContext* context) {
+  if (!CheckUuidMatchOrRespond(server_->tablet_manager(), "CreateTablet", req, resp, context)) {
+    return;
+  }
+  TabletServerErrorPB::Code code;
+  Status s = CreateTabletFromRequest(server_, *req, &code);
+  if (!s.ok()) {
     SetupErrorAndRespond(resp->mutable_error(), s, code, context);
     return;
   }
   context->RespondSuccess();
 }
 
+void TabletServiceAdminImpl::CreateTablets(const CreateTabletsRequestPB* req,
+                                           CreateTabletsResponsePB* resp,
+                                           rpc::RpcContext* context) {
+  if (!CheckUuidMatchOrRespond(server_->tablet_manager(), "CreateTablets", req, resp, context)) {
+    return;
+  }
+  for (const CreateTabletRequestPB& tablet_req : req->tablets()) {
+    CreateTabletResponsePB* tablet_resp = resp->add_tablets();
+    TabletServerErrorPB::Code code;
+    Status s = CreateTabletFromRequest(server_, tablet_req, &code);
+    if (!s.ok()) {
+      StatusToPB(s, tablet_resp->mutable_error()->mutable_status());
+      tablet_resp->mutable_error()->set_code(code);
+    }
+  }
+  context->RespondSuccess();
+}
+
 void TabletServiceAdminImpl::DeleteTablet(const DeleteTabletRequestPB* req,
                                           DeleteTabletResponsePB* resp,
                                           rpc::RpcContext* context) {
@@ -685,92 +1212,154 @@ void TabletServiceImpl::Write(const WriteRequestPB* req,
   TRACE_EVENT1("tserver", "TabletServiceImpl::Write",
                "tablet_id", req->tablet_id());
   DVLOG(3) << "Received Write RPC: " << req->DebugString();
-
-  scoped_refptr<TabletPeer> tablet_peer;
-  if (!LookupTabletPeerOrRespond(server_->tablet_manager(), req->tablet_id(), resp, context,
-                                 &tablet_peer)) {
-    return;
+  ScopedRpcResourceCharge charge(server_, context, req->tablet_id());
+
+  unique_ptr<PendingCapture> capture;
+  if (server_->request_capture()->enabled()) {
+    capture.reset(new PendingCapture(server_, context, req->tablet_id(),
+                                     CapturedRequestPB::WRITE));
+    if (capture->record()) {
+      // The rows are inlined, so that the capture holds the whole request.
+      WriteRequestPB* captured = capture->record()->mutable_write_request();
+      *captured = *req;
+      Slice rows;
+      Slice indirect_data;
+      if (req->has_rows_sidecar() &&
+          GetRowsFromSidecars(*req, context, &rows, &indirect_data).ok()) {
+        captured->mutable_row_operations()->set_rows(rows.data(), rows.size());
+        captured->mutable_row_operations()->set_indirect_data(indirect_data.data(),
+                                                              indirect_data.size());
+        captured->clear_rows_sidecar();
+        captured->clear_indirect_data_sidecar();
+      }
+    }
   }
 
-  shared_ptr<Tablet> tablet;
+  // The RPC will be responded to asynchronously once the write completes.
+  gscoped_ptr<RpcTransactionCompletionCallback<WriteResponsePB>> callback(
+      new RpcTransactionCompletionCallback<WriteResponsePB>(context, resp));
+  callback->set_capture(std::move(capture));
   TabletServerErrorPB::Code error_code;
-  Status s = GetTabletRef(tablet_peer, &tablet, &error_code);
+  Status s = StartWrite(req, resp, context,
+                        context->AreResultsTracked() ? context->request_id() : nullptr,
+                        gscoped_ptr<TransactionCompletionCallback>(callback.release()),
+                        &error_code);
   if (PREDICT_FALSE(!s.ok())) {
     SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
-    return;
+  }
+}
+
+void TabletServiceImpl::MultiWrite(const MultiWriteRequestPB* req,
+                                   MultiWriteResponsePB* resp,
+                                   rpc::RpcContext* context) {
+  TRACE_EVENT1("tserver", "TabletServiceImpl::MultiWrite",
+               "num_writes", req->writes_size());
+  DVLOG(3) << "Received MultiWrite RPC: " << req->DebugString();
+
+  for (int i = 0; i < req->writes_size(); i++) {
+    resp->add_writes();
+  }
+  // Holds an extra write until all have been started, so that the RPC isn't
+  // responded to while the response is still being filled in.
+  scoped_refptr<MultiWriteState> state(new MultiWriteState(context, req->writes_size() + 1));
+  for (int i = 0; i < req->writes_size(); i++) {
+    WriteResponsePB* write_resp = resp->mutable_writes(i);
+    TabletServerErrorPB::Code error_code;
+    Status s = StartWrite(&req->writes(i), write_resp, context, nullptr,
+                          gscoped_ptr<TransactionCompletionCallback>(
+                              new MultiWriteCompletionCallback(state, write_resp)),
+                          &error_code);
+    if (PREDICT_FALSE(!s.ok())) {
+      StatusToPB(s, write_resp->mutable_error()->mutable_status());
+      write_resp->mutable_error()->set_code(error_code);
+      state->WriteCompleted();
+    }
+  }
+  state->WriteCompleted();
+}
+
+Status TabletServiceImpl::StartWrite(const WriteRequestPB* req,
+                                     WriteResponsePB* resp,
+                                     rpc::RpcContext* context,
+                                     const rpc::RequestIdPB* request_id,
+                                     gscoped_ptr<TransactionCompletionCallback> callback,
+                                     TabletServerErrorPB::Code* error_code) {
+  scoped_refptr<TabletPeer> tablet_peer;
+  RETURN_NOT_OK(LookupRunningTabletPeer(server_->tablet_manager(), req->tablet_id(),
+                                        &tablet_peer, error_code));
+
+  shared_ptr<Tablet> tablet;
+  RETURN_NOT_OK(GetTabletRef(tablet_peer, &tablet, error_code));
+
+  // The rows may have been sent in sidecars, in which case they're decoded
+  // in place.
+  Slice rows(req->row_operations().rows());
+  Slice indirect_data(req->row_operations().indirect_data());
+  if (req->has_rows_sidecar()) {
+    Status s = GetRowsFromSidecars(*req, context, &rows, &indirect_data);
+    if (PREDICT_FALSE(!s.ok())) {
+      *error_code = TabletServerErrorPB::INVALID_ROW_BLOCK;
+      return s;
+    }
   }
 
-  uint64_t bytes = req->row_operations().rows().size() +
-      req->row_operations().indirect_data().size();
+  uint64_t bytes = rows.size() + indirect_data.size();
   if (!tablet->ShouldThrottleAllow(bytes)) {
-    SetupErrorAndRespond(resp->mutable_error(),
-                         Status::ServiceUnavailable("Rejecting Write request: throttled"),
-                         TabletServerErrorPB::THROTTLED,
-                         context);
-    return;
+    *error_code = TabletServerErrorPB::THROTTLED;
+    return Status::ServiceUnavailable("Rejecting Write request: throttled");
   }
 
-  // Check for memory pressure; don't bother doing any additional work if we've
-  // exceeded the limit.
-  double capacity_pct;
-  if (tablet->mem_tracker()->AnySoftLimitExceeded(&capacity_pct)) {
+  *error_code = TabletServerErrorPB::UNKNOWN_ERROR;
+
+  // Check for memory pressure, waiting a little for memory to be freed if
+  // need be; don't bother doing any additional work if it wasn't.
+  double capacity_pct = 0;
+  MonoDelta waited;
+  Status s = server_->write_admission_controller()->Admit(
+      req->tablet_id(), tablet->mem_tracker().get(), context->GetClientDeadline(),
+      &waited, &capacity_pct);
+  if (PREDICT_FALSE(!s.ok())) {
     tablet->metrics()->leader_memory_pressure_rejections->Increment();
-    string msg = StringPrintf(
-        "Soft memory limit exceeded (at %.2f%% of capacity)",
-        capacity_pct);
+    resp->set_admission_backoff_ms(std::max<int64_t>(1, waited.ToMilliseconds()));
     if (capacity_pct >= FLAGS_memory_limit_warn_threshold_percentage) {
-      KLOG_EVERY_N_SECS(WARNING, 1) << "Rejecting Write request: " << msg << THROTTLE_MSG;
+      KLOG_EVERY_N_SECS(WARNING, 1) << "Rejecting Write request: " << s.message().ToString()
+                                    << THROTTLE_MSG;
     } else {
-      KLOG_EVERY_N_SECS(INFO, 1) << "Rejecting Write request: " << msg << THROTTLE_MSG;
+      KLOG_EVERY_N_SECS(INFO, 1) << "Rejecting Write request: " << s.message().ToString()
+                                 << THROTTLE_MSG;
     }
-    SetupErrorAndRespond(resp->mutable_error(), Status::ServiceUnavailable(msg),
-                         TabletServerErrorPB::UNKNOWN_ERROR,
-                         context);
-    return;
+    return s;
+  }
+  if (waited.ToMilliseconds() > 0) {
+    resp->set_admission_backoff_ms(waited.ToMilliseconds());
   }
 
   if (!server_->clock()->SupportsExternalConsistencyMode(req->external_consistency_mode())) {
-    Status s = Status::NotSupported("The configured clock does not support the"
+    return Status::NotSupported("The configured clock does not support the"
         " required consistency mode.");
-    SetupErrorAndRespond(resp->mutable_error(), s,
-                         TabletServerErrorPB::UNKNOWN_ERROR,
-                         context);
-    return;
   }
 
   unique_ptr<WriteTransactionState> tx_state(new WriteTransactionState(
       tablet_peer.get(),
       req,
-      context->AreResultsTracked() ? context->request_id() : nullptr,
+      request_id,
       resp));
+  if (req->has_rows_sidecar()) {
+    tx_state->SetRowsFromSidecars(rows, indirect_data);
+  }
+  tx_state->set_client_deadline(context->GetClientDeadline());
 
   // If the client sent us a timestamp, decode it and update the clock so that all future
   // timestamps are greater than the passed timestamp.
   if (req->has_propagated_timestamp()) {
     Timestamp ts(req->propagated_timestamp());
-    s = server_->clock()->Update(ts);
-  }
-  if (PREDICT_FALSE(!s.ok())) {
-    SetupErrorAndRespond(resp->mutable_error(), s,
-                         TabletServerErrorPB::UNKNOWN_ERROR,
-                         context);
-    return;
+    RETURN_NOT_OK(server_->clock()->Update(ts));
   }
 
-  tx_state->set_completion_callback(gscoped_ptr<TransactionCompletionCallback>(
-      new RpcTransactionCompletionCallback<WriteResponsePB>(context,
-                                                            resp)));
-
-  // Submit the write. The RPC will be responded to asynchronously.
-  s = tablet_peer->SubmitWrite(std::move(tx_state));
+  tx_state->set_completion_callback(std::move(callback));
 
-  // Check that we could submit the write
-  if (PREDICT_FALSE(!s.ok())) {
-    SetupErrorAndRespond(resp->mutable_error(), s,
-                         TabletServerErrorPB::UNKNOWN_ERROR,
-                         context);
-  }
-  return;
+  // Submit the write. The callback runs once it completes.
+  return tablet_peer->SubmitWrite(std::move(tx_state));
 }
 
 ConsensusServiceImpl::ConsensusServiceImpl(const scoped_refptr<MetricEntity>& metric_entity,
@@ -783,6 +1372,10 @@ ConsensusServiceImpl::ConsensusServiceImpl(const scoped_refptr<MetricEntity>& me
 ConsensusServiceImpl::~ConsensusServiceImpl() {
 }
 
+bool ConsensusServiceImpl::SupportsFeature(uint32_t feature) const {
+  return feature == ConsensusServiceFeatures::OPS_IN_SIDECAR;
+}
+
 void ConsensusServiceImpl::UpdateConsensus(const ConsensusRequestPB* req,
                                            ConsensusResponsePB* resp,
                                            rpc::RpcContext* context) {
@@ -800,6 +1393,19 @@ void ConsensusServiceImpl::UpdateConsensus(const ConsensusRequestPB* req,
   // Submit the update directly to the TabletPeer's Consensus instance.
   scoped_refptr<Consensus> consensus;
   if (!GetConsensusOrRespond(tablet_peer, resp, context, &consensus)) return;
+
+  ConsensusRequestPB req_with_ops;
+  if (req->has_ops_sidecar_idx()) {
+    Status s = MergeOpsFromSidecar(*req, context, &req_with_ops);
+    if (PREDICT_FALSE(!s.ok())) {
+      SetupErrorAndRespond(resp->mutable_error(), s,
+                           TabletServerErrorPB::UNKNOWN_ERROR,
+                           context);
+      return;
+    }
+    req = &req_with_ops;
+  }
+
   Status s = consensus->Update(req, resp);
   if (PREDICT_FALSE(!s.ok())) {
     // Clear the response first, since a partially-filled response could
@@ -815,6 +1421,19 @@ void ConsensusServiceImpl::UpdateConsensus(const ConsensusRequestPB* req,
   context->RespondSuccess();
 }
 
+void ConsensusServiceImpl::MultiUpdateConsensus(const MultiConsensusRequestPB* req,
+                                                MultiConsensusResponsePB* resp,
+                                                rpc::RpcContext* context) {
+  DVLOG(3) << "Received Consensus Multi Update RPC: " << req->DebugString();
+  if (!CheckUuidMatchOrRespond(tablet_manager_, "MultiUpdateConsensus", req, resp, context)) {
+    return;
+  }
+  for (const ConsensusRequestPB& update : req->requests()) {
+    UpdateConsensusOrSetError(tablet_manager_, update, resp->add_responses());
+  }
+  context->RespondSuccess();
+}
+
 void ConsensusServiceImpl::RequestConsensusVote(const VoteRequestPB* req,
                                                 VoteResponsePB* resp,
                                                 rpc::RpcContext* context) {
@@ -1021,6 +1640,28 @@ void SetResourceMetrics(ResourceMetricsPB* metrics, rpc::RpcContext* context) {
   metrics->set_cfile_cache_hit_bytes(
     context->trace()->metrics()->GetMetric(cfile::CFILE_CACHE_HIT_BYTES_METRIC_NAME));
 }
+
+// Adds the per-column statistics 'stats_by_col' of 'scanner', less those
+// returned with its previous profiled responses, to 'profile'.
+void AddColumnProfiles(const vector<IteratorStats>& stats_by_col, Scanner* scanner,
+                       ScanProfilePB* profile) {
+  vector<IteratorStats> profiled = scanner->already_profiled_stats_by_col();
+  profiled.resize(stats_by_col.size());
+  const Schema& schema = scanner->iter()->schema();
+  for (int i = 0; i < stats_by_col.size(); i++) {
+    IteratorStats delta = stats_by_col[i];
+    delta.SubtractStats(profiled[i]);
+    ColumnScanProfilePB* col = profile->add_columns();
+    col->set_column_name(schema.column(i).name());
+    col->set_cells_read_from_disk(delta.cells_read_from_disk);
+    col->set_bytes_read_from_disk(delta.bytes_read_from_disk);
+    col->set_data_blocks_read_from_disk(delta.data_blocks_read_from_disk);
+    col->set_data_blocks_skipped(delta.data_blocks_skipped);
+    col->set_cells_read_from_memrowset(delta.cells_read_from_memrowset);
+    col->set_delta_stores_read(delta.delta_stores_read);
+  }
+  scanner->set_already_profiled_stats_by_col(stats_by_col);
+}
 } // anonymous namespace
 
 void TabletServiceImpl::Scan(const ScanRequestPB* req,
@@ -1035,15 +1676,52 @@ void TabletServiceImpl::Scan(const ScanRequestPB* req,
                             "Must not pass both a scanner_id and new_scan_request"));
     return;
   }
+  string charged_tablet_id;
+  if (req->has_new_scan_request()) {
+    charged_tablet_id = req->new_scan_request().tablet_id();
+  } else {
+    SharedScanner scanner;
+    if (server_->scanner_manager()->LookupScanner(req->scanner_id(), &scanner)) {
+      charged_tablet_id = scanner->tablet_id();
+    }
+  }
+  ScopedRpcResourceCharge charge(server_, context, std::move(charged_tablet_id));
 
+  // Only the requests which open a scanner are captured; the replay continues
+  // the scans by itself.
+  unique_ptr<PendingCapture> capture;
+  if (req->has_new_scan_request() && server_->request_capture()->enabled()) {
+    capture.reset(new PendingCapture(server_, context, req->new_scan_request().tablet_id(),
+                                     CapturedRequestPB::SCAN));
+    if (capture->record()) {
+      *capture->record()->mutable_scan_request() = *req;
+    }
+  }
+
+  // Requests which return rows wait for their turn to run; those which only
+  // close their scanner don't.
   size_t batch_size_bytes = GetMaxBatchSizeBytesHint(req);
-  gscoped_ptr<faststring> rows_data(new faststring(batch_size_bytes * 11 / 10));
-  gscoped_ptr<faststring> indirect_data(new faststring(batch_size_bytes * 11 / 10));
-  RowwiseRowBlockPB data;
-  ScanResultCopier collector(&data, rows_data.get(), indirect_data.get());
+  gscoped_ptr<ScanAdmissionController::Admission> admission;
+  if (batch_size_bytes > 0) {
+    Status s = server_->scan_admission_controller()->Admit(
+        context->user_credentials().real_user(), req->scanner_id(), batch_size_bytes,
+        context->GetClientDeadline(), &admission);
+    if (PREDICT_FALSE(!s.ok())) {
+      SetupErrorAndRespond(resp->mutable_error(), s, TabletServerErrorPB::THROTTLED, context);
+      return;
+    }
+  }
+
+  MonoTime admitted = MonoTime::Now();
+  ScanProfilePB* profile = req->profile() ? resp->mutable_profile() : nullptr;
+  ScanResultCopier collector(batch_size_bytes);
+  collector.set_profile(profile);
 
   bool has_more_results = false;
   TabletServerErrorPB::Code error_code = TabletServerErrorPB::UNKNOWN_ERROR;
+  Timestamp scan_timestamp;
+  shared_ptr<Tablet> tablet;
+  string cache_key;
   if (req->has_new_scan_request()) {
     const NewScanRequestPB& scan_pb = req->new_scan_request();
     scoped_refptr<TabletPeer> tablet_peer;
@@ -1051,8 +1729,19 @@ void TabletServiceImpl::Scan(const ScanRequestPB* req,
                                    &tablet_peer)) {
       return;
     }
+
+    // Small snapshot scans may be answered from the scan result cache, unless
+    // the client wants to know how the rows were read.
+    TabletServerErrorPB::Code tablet_error_code;
+    if (server_->scan_result_cache()->enabled() && !profile &&
+        GetTabletRef(tablet_peer, &tablet, &tablet_error_code).ok()) {
+      cache_key = ScanResultCacheKey(req, *tablet);
+      if (!cache_key.empty() && HandleCachedScan(req, cache_key, tablet, resp, context)) {
+        return;
+      }
+    }
+
     string scanner_id;
-    Timestamp scan_timestamp;
     Status s = HandleNewScanRequest(tablet_peer.get(), req, context,
                                     &collector, &scanner_id, &scan_timestamp, &has_more_results,
                                     &error_code);
@@ -1069,7 +1758,8 @@ void TabletServiceImpl::Scan(const ScanRequestPB* req,
       resp->set_snap_timestamp(scan_timestamp.ToUint64());
     }
   } else if (req->has_scanner_id()) {
-    Status s = HandleContinueScanRequest(req, &collector, &has_more_results, &error_code);
+    Status s = HandleContinueScanRequest(req, context, &collector, &has_more_results,
+                                         &error_code);
     if (PREDICT_FALSE(!s.ok())) {
       SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
       return;
@@ -1079,33 +1769,221 @@ void TabletServiceImpl::Scan(const ScanRequestPB* req,
                               "Must pass either a scanner_id or new_scan_request"));
     return;
   }
-  resp->set_has_more_results(has_more_results);
-
-  DVLOG(2) << "Blocks processed: " << collector.BlocksProcessed();
-  if (collector.BlocksProcessed() > 0) {
-    resp->mutable_data()->CopyFrom(data);
+  // Results are cached if the scan returned them all at once, and if no
+  // new rows were loaded meanwhile.
+  bool cache_result = !cache_key.empty() &&
+                      !has_more_results &&
+                      scan_timestamp != Timestamp::kInvalidTimestamp &&
+                      ScanResultCache::IsCacheableSize(collector.ResponseSize()) &&
+                      ScanResultCacheKey(req, *tablet) == cache_key;
+  vector<string> sidecars;
+
+  DVLOG(2) << "Blocks processed: " << collector.BlocksProcessed();
+  if (collector.BlocksProcessed() > 0) {
+    collector.SetupResponse(context, resp, cache_result ? &sidecars : nullptr);
+
+    // Set the last row found by the collector.
+    // We could have an empty batch if all the remaining rows are filtered by the predicate,
+    // in which case do not set the last row.
+    const faststring& last = collector.last_primary_key();
+    if (last.length() > 0) {
+      resp->set_last_primary_key(last.ToString());
+    }
+  }
+  if (!collector.resume_token().empty()) {
+    resp->set_resume_token(collector.resume_token());
+  }
+  if (collector.effective_sample_rate() >= 0) {
+    resp->set_effective_sample_rate(collector.effective_sample_rate());
+  }
+  if (cache_result) {
+    ScanResultCache::Result result;
+    result.snap_timestamp = scan_timestamp;
+    result.resp.CopyFrom(*resp);
+    result.resp.clear_snap_timestamp();
+    result.sidecars = std::move(sidecars);
+    server_->scan_result_cache()->Insert(cache_key, result);
+  }
+  resp->set_has_more_results(has_more_results);
+  if (profile) {
+    profile->set_queue_time_us((admitted - context->GetTimeReceived()).ToMicroseconds());
+    profile->set_scan_time_us((MonoTime::Now() - admitted).ToMicroseconds());
+  }
+  SetResourceMetrics(resp->mutable_resource_metrics(), context);
+  context->RespondSuccess();
+}
+
+string TabletServiceImpl::ScanResultCacheKey(const ScanRequestPB* req,
+                                             const Tablet& tablet) const {
+  const NewScanRequestPB& scan_pb = req->new_scan_request();
+  size_t batch_size_bytes = GetMaxBatchSizeBytesHint(req);
+  // Rows expire without any write, so a cached result of a table with a row
+  // TTL would keep returning them.
+  if (scan_pb.read_mode() != READ_AT_SNAPSHOT ||
+      scan_pb.has_resume_token() ||
+      batch_size_bytes == 0 ||
+      tablet.has_row_ttl()) {
+    return "";
+  }
+  return ScanResultCache::MakeKey(scan_pb, batch_size_bytes, tablet.row_history_id(),
+                                  tablet.metadata()->schema_version());
+}
+
+bool TabletServiceImpl::HandleCachedScan(const ScanRequestPB* req,
+                                         const string& cache_key,
+                                         const shared_ptr<Tablet>& tablet,
+                                         ScanResponsePB* resp,
+                                         rpc::RpcContext* context) {
+  // Failures are left for the regular path to report.
+  const NewScanRequestPB& scan_pb = req->new_scan_request();
+  tablet::MvccSnapshot snap;
+  Timestamp snap_timestamp;
+  if (!WaitForSnapshot(scan_pb, context, tablet, &snap, &snap_timestamp).ok() ||
+      tablet->GetHistoryGcOpts().IsAncientHistory(snap_timestamp)) {
+    return false;
+  }
+  ScanResultCache::Result result;
+  if (!server_->scan_result_cache()->Lookup(cache_key, snap_timestamp,
+                                            tablet->last_write_timestamp(), &result)) {
+    return false;
+  }
+  TRACE("Found the scan result in the cache");
+
+  resp->Swap(&result.resp);
+  for (int i = 0; i < result.sidecars.size(); i++) {
+    gscoped_ptr<faststring> sidecar(new faststring(result.sidecars[i].size()));
+    sidecar->append(result.sidecars[i]);
+    int sidecar_idx;
+    CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+        new rpc::RpcSidecar(std::move(sidecar))), &sidecar_idx));
+    DCHECK_EQ(i, sidecar_idx);
+  }
+  resp->set_has_more_results(false);
+  resp->set_snap_timestamp(snap_timestamp.ToUint64());
+  SetResourceMetrics(resp->mutable_resource_metrics(), context);
+  context->RespondSuccess();
+  return true;
+}
+
+void TabletServiceImpl::MultiGet(const MultiGetRequestPB* req,
+                                 MultiGetResponsePB* resp,
+                                 rpc::RpcContext* context) {
+  TRACE_EVENT1("tserver", "TabletServiceImpl::MultiGet",
+               "tablet_id", req->tablet_id());
+  ScopedRpcResourceCharge charge(server_, context, req->tablet_id());
+  scoped_refptr<TabletPeer> tablet_peer;
+  if (!LookupTabletPeerOrRespond(server_->tablet_manager(), req->tablet_id(), resp, context,
+                                 &tablet_peer)) {
+    return;
+  }
+  shared_ptr<Tablet> tablet;
+  TabletServerErrorPB::Code error_code;
+  Status s = GetTabletRef(tablet_peer, &tablet, &error_code);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
+    return;
+  }
+
+  Schema projection;
+  s = ColumnPBsToSchema(req->projected_columns(), &projection);
+  if (PREDICT_TRUE(s.ok()) && projection.has_column_ids()) {
+    s = Status::InvalidArgument("User requests should not have Column IDs");
+  }
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, TabletServerErrorPB::INVALID_SCHEMA, context);
+    return;
+  }
 
-    // Add sidecar data to context and record the returned indices.
-    int rows_idx;
-    CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
-        new rpc::RpcSidecar(std::move(rows_data))), &rows_idx));
-    resp->mutable_data()->set_rows_sidecar(rows_idx);
+  // The tablet looks the keys up in key order, each of them once.
+  vector<int> order(req->encoded_keys_size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+    return req->encoded_keys(a) < req->encoded_keys(b);
+  });
+  order.erase(std::unique(order.begin(), order.end(), [&](int a, int b) {
+    return req->encoded_keys(a) == req->encoded_keys(b);
+  }), order.end());
+  vector<Slice> keys;
+  keys.reserve(order.size());
+  for (int idx : order) {
+    keys.push_back(req->encoded_keys(idx));
+  }
 
-    // Add indirect data as a sidecar, if applicable.
-    if (indirect_data->size() > 0) {
-      int indirect_idx;
-      CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
-          new rpc::RpcSidecar(std::move(indirect_data))), &indirect_idx));
-      resp->mutable_data()->set_indirect_data_sidecar(indirect_idx);
+  tablet::MvccSnapshot snap;
+  Timestamp snap_timestamp = Timestamp::kInvalidTimestamp;
+  switch (req->read_mode()) {
+    case READ_LATEST:
+      snap = tablet::MvccSnapshot(*tablet->mvcc_manager());
+      break;
+    case READ_AT_SNAPSHOT: {
+      NewScanRequestPB scan_pb;
+      scan_pb.set_tablet_id(req->tablet_id());
+      if (req->has_snap_timestamp()) {
+        scan_pb.set_snap_timestamp(req->snap_timestamp());
+      }
+      if (req->has_propagated_timestamp()) {
+        scan_pb.set_propagated_timestamp(req->propagated_timestamp());
+      }
+      s = WaitForSnapshot(scan_pb, context, tablet, &snap, &snap_timestamp);
+      if (PREDICT_FALSE(!s.ok())) {
+        SetupErrorAndRespond(resp->mutable_error(), s, TabletServerErrorPB::INVALID_SNAPSHOT,
+                             context);
+        return;
+      }
+      break;
     }
+    default:
+      SetupErrorAndRespond(resp->mutable_error(),
+                           Status::NotSupported("Unsupported read mode for MultiGet"),
+                           TabletServerErrorPB::INVALID_SCAN_SPEC, context);
+      return;
+  }
 
-    // Set the last row found by the collector.
-    // We could have an empty batch if all the remaining rows are filtered by the predicate,
-    // in which case do not set the last row.
-    const faststring& last = collector.last_primary_key();
-    if (last.length() > 0) {
-      resp->set_last_primary_key(last.ToString());
-    }
+  Arena arena(32 * 1024, 64 * 1024 * 1024);
+  RowBlock block(projection, std::max<size_t>(keys.size(), 1), &arena);
+  vector<int> found_keys;
+  s = tablet->LookupRows(projection, snap, keys, &block, &found_keys);
+  if (PREDICT_FALSE(!s.ok())) {
+    // The projection or the keys don't match the tablet's schema.
+    SetupErrorAndRespond(resp->mutable_error(), s,
+                         s.IsInvalidArgument() ? TabletServerErrorPB::MISMATCHED_SCHEMA :
+                                                 TabletServerErrorPB::UNKNOWN_ERROR,
+                         context);
+    return;
+  }
+  // As for scans, the ancient history mark is checked once the rowsets are
+  // captured. See HandleNewScanRequest().
+  if (snap_timestamp != Timestamp::kInvalidTimestamp &&
+      tablet->GetHistoryGcOpts().IsAncientHistory(snap_timestamp)) {
+    SetupErrorAndRespond(resp->mutable_error(),
+                         Status::InvalidArgument(
+                             "Snapshot timestamp is earlier than the ancient history mark",
+                             "consider increasing the value of the configuration parameter "
+                             "--tablet_history_max_age_sec"),
+                         TabletServerErrorPB::INVALID_SNAPSHOT, context);
+    return;
+  }
+  TRACE("Found $0 of $1 keys", found_keys.size(), keys.size());
+
+  gscoped_ptr<faststring> rows_data(new faststring());
+  gscoped_ptr<faststring> indirect_data(new faststring());
+  SerializeRowBlock(block, resp->mutable_data(), &projection, rows_data.get(),
+                    indirect_data.get());
+  int rows_idx;
+  CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+      new rpc::RpcSidecar(std::move(rows_data))), &rows_idx));
+  resp->mutable_data()->set_rows_sidecar(rows_idx);
+  if (indirect_data->size() > 0) {
+    int indirect_idx;
+    CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+        new rpc::RpcSidecar(std::move(indirect_data))), &indirect_idx));
+    resp->mutable_data()->set_indirect_data_sidecar(indirect_idx);
+  }
+  for (int found : found_keys) {
+    resp->add_key_indexes(order[found]);
+  }
+  if (snap_timestamp != Timestamp::kInvalidTimestamp) {
+    resp->set_snap_timestamp(snap_timestamp.ToUint64());
   }
   SetResourceMetrics(resp->mutable_resource_metrics(), context);
   context->RespondSuccess();
@@ -1144,6 +2022,11 @@ void TabletServiceImpl::Checksum(const ChecksumRequestPB* req,
     return;
   }
 
+  if (req->has_new_request() && req->checksum_whole_tablet() &&
+      HandleWholeTabletChecksum(req->new_request(), resp, context)) {
+    return;
+  }
+
   // Convert ChecksumRequestPB to a ScanRequestPB.
   ScanRequestPB scan_req;
   if (req->has_call_seq_id()) scan_req.set_call_seq_id(req->call_seq_id());
@@ -1179,7 +2062,8 @@ void TabletServiceImpl::Checksum(const ChecksumRequestPB* req,
     const ContinueChecksumRequestPB& continue_req = req->continue_request();
     collector.set_agg_checksum(continue_req.previous_checksum());
     scan_req.set_scanner_id(continue_req.scanner_id());
-    Status s = HandleContinueScanRequest(&scan_req, &collector, &has_more, &error_code);
+    Status s = HandleContinueScanRequest(&scan_req, context, &collector, &has_more,
+                                         &error_code);
     if (PREDICT_FALSE(!s.ok())) {
       SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
       return;
@@ -1197,8 +2081,189 @@ void TabletServiceImpl::Checksum(const ChecksumRequestPB* req,
   context->RespondSuccess();
 }
 
+bool TabletServiceImpl::HandleWholeTabletChecksum(const NewScanRequestPB& scan_pb,
+                                                  ChecksumResponsePB* resp,
+                                                  rpc::RpcContext* context) {
+  if (scan_pb.read_mode() != READ_AT_SNAPSHOT ||
+      scan_pb.has_limit() ||
+      scan_pb.deprecated_range_predicates_size() > 0 ||
+      scan_pb.column_predicates_size() > 0 ||
+      scan_pb.has_start_primary_key() ||
+      scan_pb.has_stop_primary_key() ||
+      scan_pb.has_last_primary_key() ||
+      scan_pb.aggregates_size() > 0 ||
+      scan_pb.has_resume_token() ||
+      scan_pb.has_sample_rate()) {
+    return false;
+  }
+  scoped_refptr<TabletPeer> tablet_peer;
+  if (!LookupTabletPeerOrRespond(server_->tablet_manager(), scan_pb.tablet_id(), resp, context,
+                                 &tablet_peer)) {
+    return true;
+  }
+  shared_ptr<Tablet> tablet;
+  TabletServerErrorPB::Code error_code;
+  Status s = GetTabletRef(tablet_peer, &tablet, &error_code);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
+    return true;
+  }
+  // Bad projections are left for the regular path to report.
+  Schema projection;
+  if (!ColumnPBsToSchema(scan_pb.projected_columns(), &projection).ok() ||
+      projection.has_column_ids() ||
+      !projection.Equals(*tablet->schema())) {
+    return false;
+  }
+
+  tablet::MvccSnapshot snap;
+  Timestamp snap_timestamp;
+  s = WaitForSnapshot(scan_pb, context, tablet, &snap, &snap_timestamp);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, TabletServerErrorPB::INVALID_SNAPSHOT,
+                         context);
+    return true;
+  }
+
+  uint64_t checksum;
+  int64_t num_rows;
+  int num_cached_rowsets;
+  s = tablet->ChecksumRows(snap, std::max(1, FLAGS_scanner_max_parallelism),
+                           &checksum, &num_rows, &num_cached_rowsets);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, TabletServerErrorPB::UNKNOWN_ERROR, context);
+    return true;
+  }
+  // As for scans, the ancient history mark is checked once the rowsets are
+  // captured. See HandleNewScanRequest().
+  if (tablet->GetHistoryGcOpts().IsAncientHistory(snap_timestamp)) {
+    SetupErrorAndRespond(resp->mutable_error(),
+                         Status::InvalidArgument(
+                             "Snapshot timestamp is earlier than the ancient history mark",
+                             "consider increasing the value of the configuration parameter "
+                             "--tablet_history_max_age_sec"),
+                         TabletServerErrorPB::INVALID_SNAPSHOT, context);
+    return true;
+  }
+  VLOG(1) << "Checksummed " << num_rows << " rows of tablet " << scan_pb.tablet_id()
+          << ", reusing the checksums of " << num_cached_rowsets << " rowsets";
+
+  resp->set_checksum(checksum);
+  resp->set_has_more_results(false);
+  resp->set_snap_timestamp(snap_timestamp.ToUint64());
+  resp->set_rows_checksummed(num_rows);
+  SetResourceMetrics(resp->mutable_resource_metrics(), context);
+  context->RespondSuccess();
+  return true;
+}
+
+void TabletServiceImpl::GetColumnStatistics(const GetColumnStatisticsRequestPB* req,
+                                            GetColumnStatisticsResponsePB* resp,
+                                            rpc::RpcContext* context) {
+  scoped_refptr<TabletPeer> tablet_peer;
+  if (!LookupTabletPeerOrRespond(server_->tablet_manager(), req->tablet_id(), resp, context,
+                                 &tablet_peer)) {
+    return;
+  }
+  shared_ptr<Tablet> tablet;
+  TabletServerErrorPB::Code error_code;
+  Status s = GetTabletRef(tablet_peer, &tablet, &error_code);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
+    return;
+  }
+
+  std::map<string, ColumnStatisticsPB> stats;
+  s = tablet->GetColumnStatistics(&stats);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, TabletServerErrorPB::UNKNOWN_ERROR, context);
+    return;
+  }
+  const Schema schema = *tablet->schema();
+  for (int i = 0; i < schema.num_columns(); i++) {
+    ColumnStatisticsPB* col_stats = FindOrNull(stats, schema.column(i).name());
+    if (col_stats) {
+      GetColumnStatisticsResponsePB::ColumnPB* col = resp->add_columns();
+      col->set_name(schema.column(i).name());
+      col->mutable_stats()->Swap(col_stats);
+    }
+  }
+  context->RespondSuccess();
+}
+
+void TabletServiceImpl::SplitKeyRange(const SplitKeyRangeRequestPB* req,
+                                      SplitKeyRangeResponsePB* resp,
+                                      rpc::RpcContext* context) {
+  if (PREDICT_FALSE(req->target_chunk_size_bytes() == 0)) {
+    SetupErrorAndRespond(resp->mutable_error(),
+                         Status::InvalidArgument("target chunk size must be positive"),
+                         TabletServerErrorPB::UNKNOWN_ERROR, context);
+    return;
+  }
+  scoped_refptr<TabletPeer> tablet_peer;
+  if (!LookupTabletPeerOrRespond(server_->tablet_manager(), req->tablet_id(), resp, context,
+                                 &tablet_peer)) {
+    return;
+  }
+  shared_ptr<Tablet> tablet;
+  TabletServerErrorPB::Code error_code;
+  Status s = GetTabletRef(tablet_peer, &tablet, &error_code);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
+    return;
+  }
+
+  vector<string> split_keys;
+  s = tablet->SplitKeyRange(req->start_primary_key(), req->stop_primary_key(),
+                            req->target_chunk_size_bytes(), &split_keys);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, TabletServerErrorPB::UNKNOWN_ERROR, context);
+    return;
+  }
+  for (string& key : split_keys) {
+    resp->add_split_keys()->swap(key);
+  }
+  context->RespondSuccess();
+}
+
+void TabletServiceImpl::WarmUpBlockCache(const WarmUpBlockCacheRequestPB* req,
+                                         WarmUpBlockCacheResponsePB* resp,
+                                         rpc::RpcContext* context) {
+  scoped_refptr<TabletPeer> tablet_peer;
+  if (!LookupTabletPeerOrRespond(server_->tablet_manager(), req->tablet_id(), resp, context,
+                                 &tablet_peer)) {
+    return;
+  }
+  shared_ptr<Tablet> tablet;
+  TabletServerErrorPB::Code error_code;
+  Status s = GetTabletRef(tablet_peer, &tablet, &error_code);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
+    return;
+  }
+
+  // The blocks of the hint, if any, are the leader's: only its columns
+  // apply to this replica.
+  tablet::HotBlocksPB hot_blocks;
+  hot_blocks.mutable_column_ids()->CopyFrom(req->hot_blocks().column_ids());
+  server_->tablet_manager()->WarmUpBlockCache(tablet_peer, hot_blocks);
+  context->RespondSuccess();
+}
+
 bool TabletServiceImpl::SupportsFeature(uint32_t feature) const {
-  return feature == TabletServerFeatures::COLUMN_PREDICATES;
+  return feature == TabletServerFeatures::COLUMN_PREDICATES ||
+         feature == TabletServerFeatures::COLUMNAR_LAYOUT_FEATURE ||
+         feature == TabletServerFeatures::SCAN_AGGREGATES ||
+         feature == TabletServerFeatures::BOUNDED_STALENESS_READS ||
+         feature == TabletServerFeatures::WRITE_ROWS_IN_SIDECAR ||
+         feature == TabletServerFeatures::MULTI_TABLET_WRITES ||
+         feature == TabletServerFeatures::RESUMABLE_SCANS ||
+         feature == TabletServerFeatures::MULTI_GET ||
+         feature == TabletServerFeatures::COLUMNAR_DICTIONARY_FEATURE ||
+         feature == TabletServerFeatures::SCAN_LIMITS ||
+         feature == TabletServerFeatures::REVERSE_ORDERED_SCANS ||
+         feature == TabletServerFeatures::SAMPLED_SCANS ||
+         feature == TabletServerFeatures::GROUPED_SCAN_AGGREGATES;
 }
 
 void TabletServiceImpl::Shutdown() {
@@ -1255,6 +2320,17 @@ static Status DecodeEncodedKeyRange(const NewScanRequestPB& scan_pb,
                           "Invalid scan stop key");
   }
 
+  if (scan_pb.order_mode() == REVERSE_ORDERED && scan_pb.has_last_primary_key()) {
+    // Rows are returned in descending key order, so the scan continues below
+    // the last key from a previous scan result, which is within the stop key.
+    gscoped_ptr<EncodedKey> last;
+    RETURN_NOT_OK_PREPEND(EncodedKey::DecodeEncodedString(tablet_schema, scanner->arena(),
+                                                          scan_pb.last_primary_key(), &last),
+                          "Failed to decode last primary key");
+    spec->SetExclusiveUpperBoundKey(last.get());
+    scanner->autorelease_pool()->Add(last.release());
+  }
+
   if (scan_pb.order_mode() == ORDERED && scan_pb.has_last_primary_key()) {
     if (start) {
       return Status::InvalidArgument("Cannot specify both a start key and a last key");
@@ -1283,11 +2359,19 @@ static Status DecodeEncodedKeyRange(const NewScanRequestPB& scan_pb,
 static Status SetupScanSpec(const NewScanRequestPB& scan_pb,
                             const Schema& tablet_schema,
                             const Schema& projection,
+                            bool resumable,
                             vector<ColumnSchema>* missing_cols,
                             gscoped_ptr<ScanSpec>* spec,
                             const SharedScanner& scanner) {
   gscoped_ptr<ScanSpec> ret(new ScanSpec);
   ret->set_cache_blocks(scan_pb.cache_blocks());
+  if (scan_pb.has_sample_rate() && scan_pb.sample_rate() < 1) {
+    ScanSample sample;
+    sample.rate = scan_pb.sample_rate();
+    sample.seed = scan_pb.sample_seed();
+    ret->set_sample(sample);
+    ret->set_sampling_stats(std::make_shared<ScanSamplingStats>());
+  }
 
   unordered_set<string> missing_col_names;
 
@@ -1348,9 +2432,10 @@ static Status SetupScanSpec(const NewScanRequestPB& scan_pb,
     }
   }
 
-  // When doing an ordered scan, we need to include the key columns to be able to encode
-  // the last row key for the scan response.
-  if (scan_pb.order_mode() == kudu::ORDERED &&
+  // When doing an ordered or resumable scan, we need to include the key columns to be able
+  // to encode the last row key for the scan response or resume token.
+  if ((scan_pb.order_mode() == kudu::ORDERED ||
+       scan_pb.order_mode() == kudu::REVERSE_ORDERED || resumable) &&
       projection.num_key_columns() != tablet_schema.num_key_columns()) {
     for (int i = 0; i < tablet_schema.num_key_columns(); i++) {
       const ColumnSchema &col = tablet_schema.column(i);
@@ -1368,6 +2453,33 @@ static Status SetupScanSpec(const NewScanRequestPB& scan_pb,
   return Status::OK();
 }
 
+// Decodes the resume token of 'scan_pb', which must have been issued by this
+// server, here of uuid 'server_uuid', for a scan at the same snapshot.
+static Status DecodeResumeToken(const NewScanRequestPB& scan_pb,
+                                const string& server_uuid,
+                                tablet::ScanResumePosition* position,
+                                TabletServerErrorPB::Code* error_code) {
+  ScanResumeTokenPB token_pb;
+  if (!token_pb.ParseFromString(scan_pb.resume_token())) {
+    *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+    return Status::InvalidArgument("Invalid resume token");
+  }
+  if (token_pb.server_uuid() != server_uuid) {
+    *error_code = TabletServerErrorPB::SCAN_NOT_RESUMABLE;
+    return Status::IllegalState(Substitute("Resume token was issued by tablet server $0",
+                                           token_pb.server_uuid()));
+  }
+  if (!scan_pb.has_snap_timestamp() || scan_pb.snap_timestamp() != token_pb.snap_timestamp()) {
+    *error_code = TabletServerErrorPB::INVALID_SNAPSHOT;
+    return Status::InvalidArgument("Resumed scans must be at the snapshot of their token");
+  }
+  position->rowset_block_ids.assign(token_pb.rowset_block_ids().begin(),
+                                    token_pb.rowset_block_ids().end());
+  position->rowset_idx = token_pb.rowset_idx();
+  position->last_key = token_pb.last_primary_key();
+  return Status::OK();
+}
+
 // Start a new scan.
 Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
                                                const ScanRequestPB* req,
@@ -1409,7 +2521,61 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
     return Status::InvalidArgument("User requests should not have Column IDs");
   }
 
-  if (scan_pb.order_mode() == ORDERED) {
+  if (PREDICT_FALSE(scan_pb.row_format_flags() &
+                    ~(RowFormatFlags::COLUMNAR_LAYOUT | RowFormatFlags::COLUMNAR_DICTIONARY))) {
+    *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+    return Status::NotSupported(Substitute("Unknown row format flags: $0",
+                                           scan_pb.row_format_flags()));
+  }
+  if (PREDICT_FALSE((scan_pb.row_format_flags() & RowFormatFlags::COLUMNAR_DICTIONARY) &&
+                    !(scan_pb.row_format_flags() & RowFormatFlags::COLUMNAR_LAYOUT))) {
+    *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+    return Status::InvalidArgument("COLUMNAR_DICTIONARY requires COLUMNAR_LAYOUT");
+  }
+  scanner->set_row_format_flags(scan_pb.row_format_flags());
+
+  if (PREDICT_FALSE(scan_pb.has_sample_rate() &&
+                    !(scan_pb.sample_rate() > 0 && scan_pb.sample_rate() <= 1))) {
+    *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+    return Status::InvalidArgument(Substitute("Sample rate must be in (0, 1]: $0",
+                                              scan_pb.sample_rate()));
+  }
+
+  // The aggregated columns are part of the projection, so their indexes in
+  // the projection are also their indexes in the iterator's schema.
+  if (scan_pb.aggregates_size() > 0) {
+    vector<ScanAggregate> aggregates;
+    for (const ScanAggregatePB& aggregate_pb : scan_pb.aggregates()) {
+      s = ScanAggregate::FromPB(aggregate_pb, projection, &aggregates);
+      if (PREDICT_FALSE(!s.ok())) {
+        *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+        return s;
+      }
+    }
+    gscoped_ptr<Schema> result_schema(new Schema());
+    unique_ptr<ScanGroupBy> group_by;
+    if (scan_pb.group_by_columns_size() > 0) {
+      vector<string> group_columns(scan_pb.group_by_columns().begin(),
+                                   scan_pb.group_by_columns().end());
+      s = ScanGroupBy::Create(group_columns, projection, aggregates, &group_by);
+      if (s.ok()) {
+        s = group_by->ResultSchema(result_schema.get());
+      }
+    } else {
+      s = ScanAggregate::ResultSchema(aggregates, result_schema.get());
+    }
+    if (PREDICT_FALSE(!s.ok())) {
+      *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+      return s;
+    }
+    scanner->set_aggregates(std::move(aggregates), std::move(result_schema));
+    scanner->set_group_by(std::move(group_by));
+  } else if (PREDICT_FALSE(scan_pb.group_by_columns_size() > 0)) {
+    *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+    return Status::InvalidArgument("Grouping columns require aggregates");
+  }
+
+  if (scan_pb.order_mode() == ORDERED || scan_pb.order_mode() == REVERSE_ORDERED) {
     // Ordered scans must be at a snapshot so that we perform a serializable read (which can be
     // resumed). Otherwise, this would be read committed isolation, which is not resumable.
     if (scan_pb.read_mode() != READ_AT_SNAPSHOT) {
@@ -1418,13 +2584,34 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
     }
   }
 
+  // Unordered snapshot scans return resume tokens, with which they may be
+  // restarted from where they left off should their scanner be lost. Ordered
+  // scans are resumed from their last primary key instead.
+  bool resumable_mode = scan_pb.order_mode() == UNORDERED &&
+                        scan_pb.read_mode() == READ_AT_SNAPSHOT &&
+                        scan_pb.aggregates_size() == 0;
+  gscoped_ptr<tablet::ScanResumePosition> resume_from;
+  if (scan_pb.has_resume_token()) {
+    if (!resumable_mode) {
+      *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+      return Status::InvalidArgument(
+          "Only unordered snapshot scans without aggregates may be resumed");
+    }
+    resume_from.reset(new tablet::ScanResumePosition);
+    RETURN_NOT_OK(DecodeResumeToken(scan_pb, tablet_peer->permanent_uuid(),
+                                    resume_from.get(), error_code));
+  }
+  bool resumable = resumable_mode &&
+                   (resume_from || FLAGS_scanner_max_parallelism <= 1);
+
   gscoped_ptr<ScanSpec> spec(new ScanSpec);
 
   // Missing columns will contain the columns that are not mentioned in the client
   // projection but are actually needed for the scan, such as columns referred to by
   // predicates or key columns (if this is an ORDERED scan).
   vector<ColumnSchema> missing_cols;
-  s = SetupScanSpec(scan_pb, tablet_schema, projection, &missing_cols, &spec, scanner);
+  s = SetupScanSpec(scan_pb, tablet_schema, projection, resumable, &missing_cols, &spec,
+                    scanner);
   if (PREDICT_FALSE(!s.ok())) {
     *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
     return s;
@@ -1440,6 +2627,24 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
     return Status::OK();
   }
 
+  // Scans of no columns with nothing to filter the rows by only count them,
+  // which is done at once without a server-side scanner.
+  if (FLAGS_scanner_count_rows_from_metadata &&
+      projection.num_columns() == 0 &&
+      missing_cols.empty() &&
+      spec->predicates().empty() &&
+      !spec->lower_bound_key() &&
+      !spec->exclusive_upper_bound_key() &&
+      !scan_pb.has_limit() &&
+      !spec->sample().is_sampled() &&
+      !resume_from &&
+      (scan_pb.read_mode() == READ_LATEST || scan_pb.read_mode() == READ_AT_SNAPSHOT) &&
+      result_collector->AcceptsRowCounts()) {
+    *has_more_results = false;
+    return HandleCountScan(scan_pb, rpc_context, tablet_peer, *scanner, result_collector,
+                           snap_timestamp, error_code);
+  }
+
   // Store the original projection.
   gscoped_ptr<Schema> orig_projection(new Schema(projection));
   scanner->set_client_projection_schema(std::move(orig_projection));
@@ -1473,11 +2678,22 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
         return s;
       }
       case READ_LATEST: {
-        s = tablet->NewRowIterator(projection, &iter);
+        tablet::MvccSnapshot snap(*tablet->mvcc_manager());
+        s = tablet->NewRowIterator(projection, snap, tablet::Tablet::UNORDERED,
+                                   std::max(1, FLAGS_scanner_max_parallelism), &iter);
+        break;
+      }
+      case READ_BOUNDED_STALENESS: {
+        s = HandleScanAtSafeTime(scan_pb, projection, tablet_peer, tablet, &iter,
+                                 snap_timestamp, error_code);
+        if (PREDICT_FALSE(!s.ok())) {
+          return s;
+        }
         break;
       }
       case READ_AT_SNAPSHOT: {
-        s = HandleScanAtSnapshot(scan_pb, rpc_context, projection, tablet, &iter, snap_timestamp);
+        s = HandleScanAtSnapshot(scan_pb, rpc_context, projection, tablet, resumable,
+                                 resume_from.get(), &iter, snap_timestamp);
         if (!s.ok()) {
           tmp_error_code = TabletServerErrorPB::INVALID_SNAPSHOT;
         }
@@ -1505,6 +2721,10 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
     // error codes throughout Kudu.
     *error_code = tmp_error_code;
     return s;
+  } else if (PREDICT_FALSE(resume_from && s.IsIllegalState())) {
+    // The rowsets that the scan was reading are gone, e.g. compacted away.
+    *error_code = TabletServerErrorPB::SCAN_NOT_RESUMABLE;
+    return s;
   } else if (PREDICT_FALSE(!s.ok())) {
     LOG(WARNING) << "Error setting up scanner with request " << req->ShortDebugString();
     *error_code = TabletServerErrorPB::UNKNOWN_ERROR;
@@ -1530,7 +2750,8 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
   // represented by those open files in that case.
   Timestamp ancient_history_mark;
   tablet::HistoryGcOpts history_gc_opts = tablet->GetHistoryGcOpts();
-  if (scan_pb.read_mode() == READ_AT_SNAPSHOT &&
+  if ((scan_pb.read_mode() == READ_AT_SNAPSHOT ||
+       scan_pb.read_mode() == READ_BOUNDED_STALENESS) &&
       history_gc_opts.IsAncientHistory(*snap_timestamp)) {
     // Now that we have initialized our row iterator at a snapshot, return an
     // error if the snapshot timestamp was prior to the ancient history mark.
@@ -1542,7 +2763,7 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
                                    "--tablet_history_max_age_sec");
   }
 
-  *has_more_results = iter->HasNext();
+  *has_more_results = iter->HasNext() && !(scan_pb.has_limit() && scan_pb.limit() == 0);
   TRACE("has_more: $0", *has_more_results);
   if (!*has_more_results) {
     // If there are no more rows, we can short circuit some work and respond immediately.
@@ -1551,6 +2772,13 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
   }
 
   scanner->Init(std::move(iter), std::move(orig_spec));
+  if (resumable) {
+    scanner->set_resumable(snap_timestamp->ToUint64());
+  }
+  if (scan_pb.has_limit()) {
+    scanner->set_remaining_rows(std::min<uint64_t>(scan_pb.limit(),
+                                                   std::numeric_limits<int64_t>::max()));
+  }
   unreg_scanner.Cancel();
   *scanner_id = scanner->id();
 
@@ -1563,8 +2791,8 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
     // and call the second half directly
     ScanRequestPB continue_req(*req);
     continue_req.set_scanner_id(scanner->id());
-    RETURN_NOT_OK(HandleContinueScanRequest(&continue_req, result_collector, has_more_results,
-                                            error_code));
+    RETURN_NOT_OK(HandleContinueScanRequest(&continue_req, rpc_context, result_collector,
+                                            has_more_results, error_code));
   } else {
     // Increment the scanner call sequence ID. HandleContinueScanRequest handles
     // this in the non-empty scan case.
@@ -1575,6 +2803,7 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
 
 // Continue an existing scan request.
 Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
+                                                    const rpc::RpcContext* rpc_context,
                                                     ScanResultCollector* result_collector,
                                                     bool* has_more_results,
                                                     TabletServerErrorPB::Code* error_code) {
@@ -1616,55 +2845,89 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
   }
   scanner->IncrementCallSeqId();
   scanner->UpdateAccessTime();
+  result_collector->set_row_format_flags(scanner->row_format_flags());
+  result_collector->set_aggregates(scanner->aggregates(), scanner->aggregate_result_schema());
+  result_collector->set_group_by(scanner->group_by());
 
   RowwiseIterator* iter = scanner->iter();
+  ScanBatchSizer* sizer = scanner->batch_sizer();
+  const bool adaptive = FLAGS_scanner_adaptive_batch_sizing;
+  MonoTime start = MonoTime::Now();
+  if (adaptive) {
+    batch_size_bytes = sizer->ResponseBytes(batch_size_bytes, start);
+  }
 
-  // TODO: could size the RowBlock based on the user's requested batch size?
-  // If people had really large indirect objects, we would currently overshoot
-  // their requested batch size by a lot.
   Arena arena(32 * 1024, 1 * 1024 * 1024);
-  RowBlock block(scanner->iter()->schema(),
-                 FLAGS_scanner_batch_size_rows, &arena);
+  gscoped_ptr<RowBlock> block;
 
-  // TODO: in the future, use the client timeout to set a budget. For now,
-  // just use a half second, which should be plenty to amortize call overhead.
+  // Use a half second budget, which should be plenty to amortize call
+  // overhead, but respond before the client deadline if that comes sooner so
+  // that the client doesn't time out waiting for rows we already have.
   int budget_ms = 500;
-  MonoTime deadline = MonoTime::Now() + MonoDelta::FromMilliseconds(budget_ms);
+  MonoTime deadline = start + MonoDelta::FromMilliseconds(budget_ms);
+  MonoTime client_deadline = rpc_context->GetClientDeadline();
+  if (client_deadline != MonoTime::Max()) {
+    deadline = MonoTime::Earliest(deadline, client_deadline - MonoDelta::FromMilliseconds(10));
+  }
 
   int64_t rows_scanned = 0;
-  while (iter->HasNext()) {
+  while (iter->HasNext() && scanner->remaining_rows() != 0) {
     if (PREDICT_FALSE(FLAGS_scanner_inject_latency_on_each_batch_ms > 0)) {
       SleepFor(MonoDelta::FromMilliseconds(FLAGS_scanner_inject_latency_on_each_batch_ms));
     }
 
-    Status s = iter->NextBlock(&block);
+    int64_t prev_response_size = result_collector->ResponseSize();
+    int64_t prev_rows_returned = result_collector->NumRowsReturned();
+    size_t block_rows = FLAGS_scanner_batch_size_rows;
+    if (adaptive) {
+      size_t remaining_bytes = batch_size_bytes - std::min<size_t>(prev_response_size,
+                                                                   batch_size_bytes);
+      block_rows = sizer->BlockRows(iter->schema().byte_size(), remaining_bytes);
+    }
+    // Only reallocate the block when it's off by more than a factor of two.
+    if (!block || block_rows > block->row_capacity() * 2 ||
+        block_rows * 2 < block->row_capacity()) {
+      block.reset(new RowBlock(iter->schema(), block_rows, &arena));
+    }
+
+    Status s = iter->NextBlock(block.get());
     if (PREDICT_FALSE(!s.ok())) {
       LOG(WARNING) << "Copying rows from internal iterator for request " << req->ShortDebugString();
       *error_code = TabletServerErrorPB::UNKNOWN_ERROR;
       return s;
     }
 
-    if (PREDICT_TRUE(block.nrows() > 0)) {
+    if (PREDICT_TRUE(block->nrows() > 0)) {
       // Count the number of rows scanned, regardless of predicates or deletions.
       // The collector will separately count the number of rows actually returned to
       // the client.
-      rows_scanned += block.nrows();
-      result_collector->HandleRowBlock(scanner->client_projection_schema(), block);
+      rows_scanned += block->nrows();
+      if (scanner->remaining_rows() >= 0) {
+        ApplyScanLimit(scanner.get(), block.get());
+      }
+      result_collector->HandleRowBlock(scanner->client_projection_schema(), *block);
     }
 
     int64_t response_size = result_collector->ResponseSize();
+    sizer->BlockScanned(block->nrows(),
+                        result_collector->NumRowsReturned() - prev_rows_returned,
+                        response_size - prev_response_size);
 
     if (VLOG_IS_ON(2)) {
       // This may be fairly expensive if row block size is small
-      TRACE("Copied block (nrows=$0), new size=$1", block.nrows(), response_size);
+      TRACE("Copied block (nrows=$0), new size=$1", block->nrows(), response_size);
     }
 
-    // TODO: should check if RPC got cancelled, once we implement RPC cancellation.
     if (PREDICT_FALSE(MonoTime::Now() >= deadline)) {
       TRACE("Deadline expired - responding early");
       break;
     }
 
+    if (PREDICT_FALSE(rpc_context->ClientAbandoned())) {
+      TRACE("Client abandoned the call - responding early");
+      break;
+    }
+
     if (response_size >= batch_size_bytes) {
       break;
     }
@@ -1702,9 +2965,33 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
       delta_stats.cells_read_from_disk);
   tablet->metrics()->scanner_bytes_scanned_from_disk->IncrementBy(
       delta_stats.bytes_read_from_disk);
+  if (result_collector->profile()) {
+    AddColumnProfiles(stats_by_col, scanner.get(), result_collector->profile());
+  }
 
+  sizer->ResponseFilled(start, MonoTime::Now());
   scanner->UpdateAccessTime();
-  *has_more_results = !req->close_scanner() && iter->HasNext();
+  *has_more_results = !req->close_scanner() && iter->HasNext() &&
+                      scanner->remaining_rows() != 0;
+
+  // Let the client resume the scan from here should it lose the scanner.
+  tablet::ScanResumePosition position;
+  if (*has_more_results && scanner->resumable() &&
+      down_cast<tablet::Tablet::Iterator*>(iter)->GetResumePosition(&position)) {
+    ScanResumeTokenPB token_pb;
+    token_pb.set_server_uuid(tablet_peer->permanent_uuid());
+    token_pb.set_snap_timestamp(scanner->resume_snap_timestamp());
+    for (uint64_t block_id : position.rowset_block_ids) {
+      token_pb.add_rowset_block_ids(block_id);
+    }
+    token_pb.set_rowset_idx(position.rowset_idx);
+    token_pb.set_last_primary_key(position.last_key);
+    result_collector->set_resume_token(token_pb.SerializeAsString());
+  }
+  if (scanner->spec().sampling_stats()) {
+    result_collector->set_effective_sample_rate(
+        scanner->spec().sampling_stats()->effective_rate());
+  }
   if (*has_more_results) {
     unreg_scanner.Cancel();
   } else {
@@ -1714,13 +3001,11 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
   return Status::OK();
 }
 
-Status TabletServiceImpl::HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
-                                               const RpcContext* rpc_context,
-                                               const Schema& projection,
-                                               const shared_ptr<Tablet>& tablet,
-                                               gscoped_ptr<RowwiseIterator>* iter,
-                                               Timestamp* snap_timestamp) {
-
+Status TabletServiceImpl::WaitForSnapshot(const NewScanRequestPB& scan_pb,
+                                          const RpcContext* rpc_context,
+                                          const shared_ptr<Tablet>& tablet,
+                                          tablet::MvccSnapshot* snap,
+                                          Timestamp* snap_timestamp) {
   // TODO check against the earliest boundary (i.e. how early can we go) right
   // now we're keeping all undos/redos forever!
 
@@ -1759,8 +3044,6 @@ Status TabletServiceImpl::HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
     }
   }
 
-  tablet::MvccSnapshot snap;
-
   // Wait for the in-flights in the snapshot to be finished.
   // We'll use the client-provided deadline, but not if it's more than 5 seconds from
   // now -- it's better to make the client retry than hold RPC threads busy.
@@ -1783,23 +3066,130 @@ Status TabletServiceImpl::HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
   MonoTime before = MonoTime::Now();
   RETURN_NOT_OK_PREPEND(
       tablet->mvcc_manager()->WaitForCleanSnapshotAtTimestamp(
-          tmp_snap_timestamp, &snap, deadline),
+          tmp_snap_timestamp, snap, deadline),
       "could not wait for desired snapshot timestamp to be consistent");
 
   uint64_t duration_usec = (MonoTime::Now() - before).ToMicroseconds();
   tablet->metrics()->snapshot_read_inflight_wait_duration->Increment(duration_usec);
   TRACE("All operations in snapshot committed. Waited for $0 microseconds", duration_usec);
+  *snap_timestamp = tmp_snap_timestamp;
+  return Status::OK();
+}
+
+Status TabletServiceImpl::HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
+                                               const RpcContext* rpc_context,
+                                               const Schema& projection,
+                                               const shared_ptr<Tablet>& tablet,
+                                               bool resumable,
+                                               const tablet::ScanResumePosition* resume_from,
+                                               gscoped_ptr<RowwiseIterator>* iter,
+                                               Timestamp* snap_timestamp) {
+  tablet::MvccSnapshot snap;
+  Timestamp tmp_snap_timestamp;
+  RETURN_NOT_OK(WaitForSnapshot(scan_pb, rpc_context, tablet, &snap, &tmp_snap_timestamp));
 
   tablet::Tablet::OrderMode order;
   switch (scan_pb.order_mode()) {
     case UNORDERED: order = tablet::Tablet::UNORDERED; break;
     case ORDERED: order = tablet::Tablet::ORDERED; break;
+    case REVERSE_ORDERED: order = tablet::Tablet::REVERSE_ORDERED; break;
     default: LOG(FATAL) << "Unexpected order mode.";
   }
-  RETURN_NOT_OK(tablet->NewRowIterator(projection, snap, order, iter));
+  if (resumable) {
+    DCHECK_EQ(tablet::Tablet::UNORDERED, order);
+    RETURN_NOT_OK(tablet->NewResumableRowIterator(projection, snap, resume_from, iter));
+  } else {
+    RETURN_NOT_OK(tablet->NewRowIterator(projection, snap, order,
+                                         std::max(1, FLAGS_scanner_max_parallelism), iter));
+  }
   *snap_timestamp = tmp_snap_timestamp;
   return Status::OK();
 }
 
+Status TabletServiceImpl::HandleCountScan(const NewScanRequestPB& scan_pb,
+                                          const RpcContext* rpc_context,
+                                          TabletPeer* tablet_peer,
+                                          const Scanner& scanner,
+                                          ScanResultCollector* result_collector,
+                                          Timestamp* snap_timestamp,
+                                          TabletServerErrorPB::Code* error_code) {
+  shared_ptr<Tablet> tablet;
+  RETURN_NOT_OK(GetTabletRef(tablet_peer, &tablet, error_code));
+
+  tablet::MvccSnapshot snap;
+  if (scan_pb.read_mode() == READ_AT_SNAPSHOT) {
+    Status s = WaitForSnapshot(scan_pb, rpc_context, tablet, &snap, snap_timestamp);
+    if (PREDICT_FALSE(!s.ok())) {
+      *error_code = s.IsInvalidArgument() ? TabletServerErrorPB::INVALID_SNAPSHOT
+                                          : TabletServerErrorPB::UNKNOWN_ERROR;
+      return s;
+    }
+    // See HandleNewScanRequest(). No rows are read after choosing the
+    // snapshot here, so there's no need to wait for an iterator first.
+    if (tablet->GetHistoryGcOpts().IsAncientHistory(*snap_timestamp)) {
+      *error_code = TabletServerErrorPB::INVALID_SNAPSHOT;
+      return Status::InvalidArgument("Snapshot timestamp is earlier than the ancient history mark",
+                                     "consider increasing the value of the configuration "
+                                     "parameter --tablet_history_max_age_sec");
+    }
+  } else {
+    snap = tablet::MvccSnapshot(*tablet->mvcc_manager());
+  }
+
+  int64_t count;
+  int num_scanned_rowsets;
+  Status s = tablet->CountRows(snap, &count, &num_scanned_rowsets);
+  if (PREDICT_FALSE(!s.ok())) {
+    *error_code = TabletServerErrorPB::UNKNOWN_ERROR;
+    return s;
+  }
+  TRACE("Counted $0 rows, scanning $1 rowsets", count, num_scanned_rowsets);
+
+  result_collector->set_aggregates(scanner.aggregates(), scanner.aggregate_result_schema());
+  result_collector->set_group_by(scanner.group_by());
+  result_collector->HandleRowCount(count);
+  return Status::OK();
+}
+
+Status TabletServiceImpl::HandleScanAtSafeTime(const NewScanRequestPB& scan_pb,
+                                               const Schema& projection,
+                                               TabletPeer* tablet_peer,
+                                               const shared_ptr<Tablet>& tablet,
+                                               gscoped_ptr<RowwiseIterator>* iter,
+                                               Timestamp* snap_timestamp,
+                                               TabletServerErrorPB::Code* error_code) {
+  // A leader may mark the current time as safe itself. A follower reads at the
+  // safe time last propagated by its leader, which only advances once all the
+  // operations below it have been applied locally.
+  scoped_refptr<consensus::Consensus> consensus = tablet_peer->shared_consensus();
+  if (consensus && consensus->role() == consensus::RaftPeerPB::LEADER) {
+    tablet_peer->GetSafeTimestampForFollowers();
+  }
+  Timestamp safe_timestamp = tablet->mvcc_manager()->GetCleanTimestamp();
+
+  if (scan_pb.has_max_staleness_usec()) {
+    if (!server_->clock()->HasPhysicalComponent()) {
+      *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+      return Status::NotSupported("Bounded staleness requires a physical clock");
+    }
+    uint64_t now_usec = HybridClock::GetPhysicalValueMicros(server_->clock()->Now());
+    uint64_t safe_usec = HybridClock::GetPhysicalValueMicros(safe_timestamp);
+    if (now_usec > safe_usec && now_usec - safe_usec > scan_pb.max_staleness_usec()) {
+      *error_code = TabletServerErrorPB::REPLICA_TOO_STALE;
+      return Status::ServiceUnavailable(
+          Substitute("Replica safe time is $0 us behind, more than the allowed $1 us",
+                     now_usec - safe_usec, scan_pb.max_staleness_usec()));
+    }
+  }
+
+  // No transaction can start at or below the clean time, and all those below
+  // it have committed, so the snapshot is consistent without waiting.
+  tablet::MvccSnapshot snap(safe_timestamp);
+  RETURN_NOT_OK(tablet->NewRowIterator(projection, snap, tablet::Tablet::UNORDERED,
+                                       std::max(1, FLAGS_scanner_max_parallelism), iter));
+  *snap_timestamp = safe_timestamp;
+  return Status::OK();
+}
+
 } // namespace tserver
 } // namespace kudu
@@ -22,6 +22,7 @@
 #include <vector>
 
 #include "kudu/consensus/consensus.service.h"
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/tserver/tserver_admin.service.h"
 #include "kudu/tserver/tserver_service.service.h"
@@ -33,14 +34,18 @@ class Status;
 class Timestamp;
 
 namespace tablet {
+class MvccSnapshot;
+struct ScanResumePosition;
 class Tablet;
 class TabletPeer;
+class TransactionCompletionCallback;
 class TransactionState;
 } // namespace tablet
 
 namespace tserver {
 
 class ScanResultCollector;
+class Scanner;
 class TabletPeerLookupIf;
 class TabletServer;
 
@@ -55,6 +60,9 @@ class TabletServiceImpl : public TabletServerServiceIf {
   virtual void Write(const WriteRequestPB* req, WriteResponsePB* resp,
                    rpc::RpcContext* context) OVERRIDE;
 
+  virtual void MultiWrite(const MultiWriteRequestPB* req, MultiWriteResponsePB* resp,
+                          rpc::RpcContext* context) OVERRIDE;
+
   virtual void Scan(const ScanRequestPB* req,
                     ScanResponsePB* resp,
                     rpc::RpcContext* context) OVERRIDE;
@@ -63,6 +71,10 @@ class TabletServiceImpl : public TabletServerServiceIf {
                                 ScannerKeepAliveResponsePB *resp,
                                 rpc::RpcContext *context) OVERRIDE;
 
+  virtual void MultiGet(const MultiGetRequestPB* req,
+                        MultiGetResponsePB* resp,
+                        rpc::RpcContext* context) OVERRIDE;
+
   virtual void ListTablets(const ListTabletsRequestPB* req,
                            ListTabletsResponsePB* resp,
                            rpc::RpcContext* context) OVERRIDE;
@@ -71,11 +83,34 @@ class TabletServiceImpl : public TabletServerServiceIf {
                         ChecksumResponsePB* resp,
                         rpc::RpcContext* context) OVERRIDE;
 
+  virtual void SplitKeyRange(const SplitKeyRangeRequestPB* req,
+                             SplitKeyRangeResponsePB* resp,
+                             rpc::RpcContext* context) OVERRIDE;
+
+  virtual void WarmUpBlockCache(const WarmUpBlockCacheRequestPB* req,
+                                WarmUpBlockCacheResponsePB* resp,
+                                rpc::RpcContext* context) OVERRIDE;
+
+  virtual void GetColumnStatistics(const GetColumnStatisticsRequestPB* req,
+                                   GetColumnStatisticsResponsePB* resp,
+                                   rpc::RpcContext* context) OVERRIDE;
+
   bool SupportsFeature(uint32_t feature) const override;
 
   virtual void Shutdown() OVERRIDE;
 
  private:
+  // Starts the write of 'req', with the given request ID if its result is
+  // tracked. Once the write completes, 'callback' is run after 'resp' is
+  // filled in. If the write can't be started, returns a bad Status and sets
+  // 'error_code' without running 'callback'.
+  Status StartWrite(const WriteRequestPB* req,
+                    WriteResponsePB* resp,
+                    rpc::RpcContext* context,
+                    const rpc::RequestIdPB* request_id,
+                    gscoped_ptr<tablet::TransactionCompletionCallback> callback,
+                    TabletServerErrorPB::Code* error_code);
+
   Status HandleNewScanRequest(tablet::TabletPeer* tablet_peer,
                               const ScanRequestPB* req,
                               const rpc::RpcContext* rpc_context,
@@ -86,27 +121,90 @@ class TabletServiceImpl : public TabletServerServiceIf {
                               TabletServerErrorPB::Code* error_code);
 
   Status HandleContinueScanRequest(const ScanRequestPB* req,
+                                   const rpc::RpcContext* rpc_context,
                                    ScanResultCollector* result_collector,
                                    bool* has_more_results,
                                    TabletServerErrorPB::Code* error_code);
 
+  // Checksums the whole tablet in one go for a ChecksumRequestPB with
+  // 'checksum_whole_tablet' set, responding to 'context'. Returns false
+  // without responding if 'scan_pb' isn't a snapshot scan of every row and
+  // column of the tablet, in which case it must be checksummed by scanning.
+  bool HandleWholeTabletChecksum(const NewScanRequestPB& scan_pb,
+                                 ChecksumResponsePB* resp,
+                                 rpc::RpcContext* context);
+
+  // Returns the key of the result of the new scan of 'req' on 'tablet' in
+  // the scan result cache, or an empty string if its result isn't cached.
+  std::string ScanResultCacheKey(const ScanRequestPB* req,
+                                 const tablet::Tablet& tablet) const;
+
+  // Responds to the new scan of 'req' with its result cached under
+  // 'cache_key', if it's valid at the scan's snapshot, in which case returns
+  // true. Returns false without responding otherwise.
+  bool HandleCachedScan(const ScanRequestPB* req,
+                        const std::string& cache_key,
+                        const std::shared_ptr<tablet::Tablet>& tablet,
+                        ScanResponsePB* resp,
+                        rpc::RpcContext* context);
+
+  // Sets 'snap' to the snapshot of a READ_AT_SNAPSHOT scan once all of the
+  // operations in it are committed. Its timestamp, which is the requested
+  // one or else the current time, is returned in 'snap_timestamp'.
+  Status WaitForSnapshot(const NewScanRequestPB& scan_pb,
+                         const rpc::RpcContext* rpc_context,
+                         const std::shared_ptr<tablet::Tablet>& tablet,
+                         tablet::MvccSnapshot* snap,
+                         Timestamp* snap_timestamp);
+
   Status HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
                               const rpc::RpcContext* rpc_context,
                               const Schema& projection,
                               const std::shared_ptr<tablet::Tablet>& tablet,
+                              bool resumable,
+                              const tablet::ScanResumePosition* resume_from,
                               gscoped_ptr<RowwiseIterator>* iter,
                               Timestamp* snap_timestamp);
 
+  // Sets up 'iter' for a READ_BOUNDED_STALENESS scan at the replica's current
+  // safe time, which is returned in 'snap_timestamp'.
+  Status HandleScanAtSafeTime(const NewScanRequestPB& scan_pb,
+                              const Schema& projection,
+                              tablet::TabletPeer* tablet_peer,
+                              const std::shared_ptr<tablet::Tablet>& tablet,
+                              gscoped_ptr<RowwiseIterator>* iter,
+                              Timestamp* snap_timestamp,
+                              TabletServerErrorPB::Code* error_code);
+
+  // Answers a READ_LATEST or READ_AT_SNAPSHOT scan which only counts rows,
+  // without an iterator over the whole tablet: the rows are counted with
+  // Tablet::CountRows() and handed to 'result_collector' as a row count, or
+  // as the partial result of the COUNT(*) aggregates of 'scanner'.
+  Status HandleCountScan(const NewScanRequestPB& scan_pb,
+                         const rpc::RpcContext* rpc_context,
+                         tablet::TabletPeer* tablet_peer,
+                         const Scanner& scanner,
+                         ScanResultCollector* result_collector,
+                         Timestamp* snap_timestamp,
+                         TabletServerErrorPB::Code* error_code);
+
   TabletServer* server_;
 };
 
 class TabletServiceAdminImpl : public TabletServerAdminServiceIf {
  public:
   explicit TabletServiceAdminImpl(TabletServer* server);
+
+  bool SupportsFeature(uint32_t feature) const override;
+
   virtual void CreateTablet(const CreateTabletRequestPB* req,
                             CreateTabletResponsePB* resp,
                             rpc::RpcContext* context) OVERRIDE;
 
+  virtual void CreateTablets(const CreateTabletsRequestPB* req,
+                             CreateTabletsResponsePB* resp,
+                             rpc::RpcContext* context) OVERRIDE;
+
   virtual void DeleteTablet(const DeleteTabletRequestPB* req,
                             DeleteTabletResponsePB* resp,
                             rpc::RpcContext* context) OVERRIDE;
@@ -127,10 +225,16 @@ class ConsensusServiceImpl : public consensus::ConsensusServiceIf {
 
   virtual ~ConsensusServiceImpl();
 
+  bool SupportsFeature(uint32_t feature) const override;
+
   virtual void UpdateConsensus(const consensus::ConsensusRequestPB *req,
                                consensus::ConsensusResponsePB *resp,
                                rpc::RpcContext *context) OVERRIDE;
 
+  virtual void MultiUpdateConsensus(const consensus::MultiConsensusRequestPB* req,
+                                    consensus::MultiConsensusResponsePB* resp,
+                                    rpc::RpcContext* context) OVERRIDE;
+
   virtual void RequestConsensusVote(const consensus::VoteRequestPB* req,
                                     consensus::VoteResponsePB* resp,
                                     rpc::RpcContext* context) OVERRIDE;
@@ -17,19 +17,27 @@
 
 #include "kudu/tserver/ts_tablet_manager.h"
 
+#include <gflags/gflags.h>
 #include <gtest/gtest.h>
+#include <memory>
+#include <set>
 #include <string>
+#include <vector>
 
 #include "kudu/common/partition.h"
 #include "kudu/common/schema.h"
+#include "kudu/consensus/consensus_meta.h"
 #include "kudu/consensus/metadata.pb.h"
 #include "kudu/fs/fs_manager.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/master/master.pb.h"
 #include "kudu/tablet/tablet_peer.h"
 #include "kudu/tablet/tablet-test-util.h"
 #include "kudu/tserver/heartbeater.h"
 #include "kudu/tserver/mini_tablet_server.h"
 #include "kudu/tserver/tablet_server.h"
+#include "kudu/util/env.h"
+#include "kudu/util/path_util.h"
 #include "kudu/util/test_util.h"
 
 #define ASSERT_REPORT_HAS_UPDATED_TABLET(report, tablet_id) \
@@ -38,13 +46,19 @@
 #define ASSERT_MONOTONIC_REPORT_SEQNO(report_seqno, tablet_report) \
   ASSERT_NO_FATAL_FAILURE(AssertMonotonicReportSeqno(report_seqno, tablet_report))
 
+DECLARE_bool(heartbeat_compact_tablet_reports);
+DECLARE_int32(heartbeat_max_tablets_per_report);
+
 namespace kudu {
 namespace tserver {
 
+using consensus::ConsensusMetadata;
 using consensus::kInvalidOpIdIndex;
 using consensus::RaftConfigPB;
 using master::ReportedTabletPB;
 using master::TabletReportPB;
+using strings::Substitute;
+using tablet::TabletMetadata;
 using tablet::TabletPeer;
 
 static const char* const kTabletId = "my-tablet-id";
@@ -85,6 +99,7 @@ class TsTabletManagerTest : public KuduTest {
     RETURN_NOT_OK(tablet_manager_->CreateNewTablet(tablet_id, tablet_id, partition.second,
                                                    tablet_id,
                                                    full_schema, partition.first,
+                                                   CompactionPolicyPB(),
                                                    config_,
                                                    &tablet_peer));
     if (out_tablet_peer) {
@@ -264,5 +279,113 @@ TEST_F(TsTabletManagerTest, TestTabletReports) {
   ASSERT_MONOTONIC_REPORT_SEQNO(&seqno, report);
 }
 
+// Tests that full tablet reports are paged, and that incremental reports only
+// send the consensus state of a tablet in full if its config changed since it
+// was last acknowledged.
+TEST_F(TsTabletManagerTest, TestPagedAndCompactTabletReports) {
+  FLAGS_heartbeat_max_tablets_per_report = 1;
+  ASSERT_OK(CreateNewTablet("tablet-1", schema_, nullptr));
+  ASSERT_OK(CreateNewTablet("tablet-2", schema_, nullptr));
+
+  // The full report only has one of the tablets.
+  TabletReportPB report;
+  GenerateFullTabletReport(&report);
+  ASSERT_FALSE(report.is_incremental());
+  ASSERT_EQ(1, report.updated_tablets_size());
+  ASSERT_TRUE(report.updated_tablets(0).has_committed_consensus_state());
+  const string first_tablet = report.updated_tablets(0).tablet_id();
+  MarkTabletReportAcknowledged(report);
+
+  // The other one is sent in the following incremental reports, one at a time.
+  std::set<string> reported;
+  while (true) {
+    GenerateIncrementalTabletReport(&report);
+    ASSERT_TRUE(report.is_incremental());
+    ASSERT_LE(report.updated_tablets_size(), 1);
+    if (report.updated_tablets_size() == 0) {
+      break;
+    }
+    reported.insert(report.updated_tablets(0).tablet_id());
+    MarkTabletReportAcknowledged(report);
+  }
+  ASSERT_EQ(1, reported.count(first_tablet == "tablet-1" ? "tablet-2" : "tablet-1"));
+
+  // The config of the tablet hasn't changed since it was acknowledged, so
+  // only its opid_index is sent.
+  FLAGS_heartbeat_max_tablets_per_report = 1000;
+  tablet_manager_->MarkTabletDirty(first_tablet, "Test");
+  GenerateIncrementalTabletReport(&report);
+  ASSERT_EQ(1, report.updated_tablets_size());
+  const ReportedTabletPB& compact = report.updated_tablets(0);
+  ASSERT_EQ(first_tablet, compact.tablet_id());
+  ASSERT_FALSE(compact.has_committed_consensus_state());
+  ASSERT_TRUE(compact.has_compact_consensus_state());
+  ASSERT_EQ(kInvalidOpIdIndex, compact.compact_consensus_state().config_opid_index());
+  ASSERT_TRUE(compact.compact_consensus_state().has_leader_uuid());
+
+  // Unless compact reports are disabled.
+  FLAGS_heartbeat_compact_tablet_reports = false;
+  GenerateIncrementalTabletReport(&report);
+  ASSERT_REPORT_HAS_UPDATED_TABLET(report, first_tablet);
+}
+
+// The tablets whose replica here voted for this server in its last election
+// are bootstrapped first, then the others; each by ascending WAL size.
+TEST_F(TsTabletManagerTest, TestOrderTabletsForBootstrap) {
+  struct TabletSpec {
+    string tablet_id;
+    string voted_for;
+    int wal_bytes;
+  };
+  const string local_uuid = fs_manager_->uuid();
+  const vector<TabletSpec> specs = {
+    { "tablet-a", "", 3000 },
+    { "tablet-b", local_uuid, 2000 },
+    { "tablet-c", "", 1000 },
+    { "tablet-d", "other-server", 0 },
+    { "tablet-e", local_uuid, 500 },
+  };
+
+  Schema full_schema = SchemaBuilder(schema_).Build();
+  std::pair<PartitionSchema, Partition> partition = tablet::CreateDefaultPartition(full_schema);
+  Env* env = fs_manager_->env();
+  vector<scoped_refptr<TabletMetadata>> metas;
+  for (const TabletSpec& spec : specs) {
+    scoped_refptr<TabletMetadata> meta;
+    ASSERT_OK(TabletMetadata::CreateNew(fs_manager_, spec.tablet_id, spec.tablet_id,
+                                        spec.tablet_id, full_schema, partition.first,
+                                        partition.second, CompactionPolicyPB(),
+                                        tablet::TABLET_DATA_READY, &meta));
+    metas.push_back(meta);
+
+    std::unique_ptr<ConsensusMetadata> cmeta;
+    ASSERT_OK(ConsensusMetadata::Create(fs_manager_, spec.tablet_id, local_uuid,
+                                        config_, 1, &cmeta));
+    if (!spec.voted_for.empty()) {
+      cmeta->set_voted_for(spec.voted_for);
+      ASSERT_OK(cmeta->Flush());
+    }
+
+    // Only the WAL segments count, not the other files of the WAL directory.
+    string wal_dir = fs_manager_->GetTabletWalDir(spec.tablet_id);
+    ASSERT_OK(env->CreateDir(wal_dir));
+    ASSERT_OK(WriteStringToFile(env, string(100, 'x'),
+                                JoinPathSegments(wal_dir, "index.000000000")));
+    if (spec.wal_bytes > 0) {
+      ASSERT_OK(WriteStringToFile(env, string(spec.wal_bytes, 'x'),
+                                  JoinPathSegments(wal_dir, Substitute(
+                                      "$0-00000001", FsManager::kWalFileNamePrefix))));
+    }
+  }
+
+  tablet_manager_->OrderTabletsForBootstrap(&metas);
+  vector<string> order;
+  for (const scoped_refptr<TabletMetadata>& meta : metas) {
+    order.push_back(meta->tablet_id());
+  }
+  ASSERT_EQ((vector<string>{ "tablet-e", "tablet-b", "tablet-d", "tablet-c", "tablet-a" }),
+            order);
+}
+
 } // namespace tserver
 } // namespace kudu
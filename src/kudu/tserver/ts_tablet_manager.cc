@@ -47,16 +47,21 @@
 #include "kudu/tablet/tablet_peer.h"
 #include "kudu/tserver/heartbeater.h"
 #include "kudu/tserver/tablet_copy_client.h"
+#include "kudu/tserver/tablet_copy_throttler.h"
 #include "kudu/tserver/tablet_server.h"
 #include "kudu/tserver/tablet_service.h"
+#include "kudu/tserver/tserver_service.proxy.h"
+#include "kudu/util/atomic.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/env.h"
 #include "kudu/util/env_util.h"
 #include "kudu/util/fault_injection.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/path_util.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/stopwatch.h"
+#include "kudu/util/thread.h"
 #include "kudu/util/trace.h"
 
 DEFINE_int32(num_tablets_to_open_simultaneously, 0,
@@ -67,11 +72,46 @@ DEFINE_int32(num_tablets_to_open_simultaneously, 0,
              "may make sense to manually tune this.");
 TAG_FLAG(num_tablets_to_open_simultaneously, advanced);
 
+DEFINE_int32(num_tablets_to_flush_on_shutdown_simultaneously, 0,
+             "Number of threads available to flush tablets during a graceful "
+             "shutdown. If this is set to 0 (the default), then the number of "
+             "flush threads will be set based on the number of data directories.");
+TAG_FLAG(num_tablets_to_flush_on_shutdown_simultaneously, advanced);
+
+DEFINE_int32(tablet_compaction_encode_threads, 4,
+             "Maximum number of threads, shared by all of the tablets of the server, "
+             "encoding, compressing and writing the columns of flush and compaction "
+             "output while the merge continues on the maintenance thread. If 0, all "
+             "of the work is done on the maintenance thread.");
+TAG_FLAG(tablet_compaction_encode_threads, advanced);
+
+DEFINE_bool(prioritize_tablet_bootstrap, true,
+            "Whether to open the tablets which are likely to be available soonest "
+            "first during startup: those which voted for this server in their last "
+            "election, and therefore were likely led by it, and then those with the "
+            "least WAL to replay. If false, tablets are opened in the order they're "
+            "listed on disk.");
+TAG_FLAG(prioritize_tablet_bootstrap, advanced);
+
 DEFINE_int32(tablet_start_warn_threshold_ms, 500,
              "If a tablet takes more than this number of millis to start, issue "
              "a warning with a trace.");
 TAG_FLAG(tablet_start_warn_threshold_ms, hidden);
 
+DEFINE_bool(block_cache_warmup_enabled, true,
+            "Whether to warm up the block cache with the hot blocks of each tablet "
+            "when it's opened and when its replica becomes leader, and with the "
+            "hints of the leaders of the tablets followed by this server.");
+TAG_FLAG(block_cache_warmup_enabled, advanced);
+TAG_FLAG(block_cache_warmup_enabled, runtime);
+
+DEFINE_int32(tablet_hot_blocks_save_interval_ms, 60 * 1000,
+             "Interval at which the hot blocks of each tablet are sampled from the "
+             "block cache and persisted beside its superblock, and at which the "
+             "leaders of tablets hint their hot set to their followers. "
+             "0 disables saving the hot blocks.");
+TAG_FLAG(tablet_hot_blocks_save_interval_ms, advanced);
+
 DEFINE_double(fault_crash_after_blocks_deleted, 0.0,
               "Fraction of the time when the tablet will crash immediately "
               "after deleting the data blocks during tablet deletion. "
@@ -136,6 +176,7 @@ using std::string;
 using std::unique_ptr;
 using std::vector;
 using strings::Substitute;
+using tablet::HotBlocksPB;
 using tablet::Tablet;
 using tablet::TABLET_DATA_COPYING;
 using tablet::TABLET_DATA_DELETED;
@@ -154,8 +195,11 @@ TSTabletManager::TSTabletManager(FsManager* fs_manager,
   : fs_manager_(fs_manager),
     server_(server),
     metric_registry_(metric_registry),
-    state_(MANAGER_INITIALIZING) {
+    state_(MANAGER_INITIALIZING),
+    hot_blocks_shutdown_latch_(1) {
 
+  // Per-tablet prepare metrics are recorded through each tablet's token.
+  CHECK_OK(ThreadPoolBuilder("prepare").Build(&prepare_pool_));
   CHECK_OK(ThreadPoolBuilder("apply").Build(&apply_pool_));
   apply_pool_->SetQueueLengthHistogram(
       METRIC_op_apply_queue_length.Instantiate(server_->metric_entity()));
@@ -163,6 +207,16 @@ TSTabletManager::TSTabletManager(FsManager* fs_manager,
       METRIC_op_apply_queue_time.Instantiate(server_->metric_entity()));
   apply_pool_->SetRunTimeMicrosHistogram(
       METRIC_op_apply_run_time.Instantiate(server_->metric_entity()));
+  tablet_copy_throttler_.reset(new TabletCopyThrottler(TabletCopyThrottler::RECEIVE,
+                                                       server_->metric_entity()));
+  CHECK_OK(ThreadPoolBuilder("block-cache-warmup")
+           .set_max_threads(1)
+           .Build(&warmup_pool_));
+  if (FLAGS_tablet_compaction_encode_threads > 0) {
+    CHECK_OK(ThreadPoolBuilder("compaction-encode")
+             .set_max_threads(FLAGS_tablet_compaction_encode_threads)
+             .Build(&compaction_encode_pool_));
+  }
 }
 
 TSTabletManager::~TSTabletManager() {
@@ -205,7 +259,14 @@ Status TSTabletManager::Init() {
     metas.push_back(meta);
   }
 
-  // Now submit the "Open" task for each.
+  if (FLAGS_prioritize_tablet_bootstrap) {
+    LOG_TIMING(INFO, "ordering tablets for bootstrap") {
+      OrderTabletsForBootstrap(&metas);
+    }
+  }
+
+  // Now submit the "Open" task for each. The tablets are opened in the order
+  // they're submitted in.
   for (const scoped_refptr<TabletMetadata>& meta : metas) {
     scoped_refptr<TransitionInProgressDeleter> deleter;
     {
@@ -223,9 +284,66 @@ Status TSTabletManager::Init() {
     state_ = MANAGER_RUNNING;
   }
 
+  if (FLAGS_tablet_hot_blocks_save_interval_ms > 0) {
+    RETURN_NOT_OK(Thread::Create("tablet-manager", "hot-blocks",
+                                 &TSTabletManager::RunHotBlocksThread, this,
+                                 &hot_blocks_thread_));
+  }
   return Status::OK();
 }
 
+void TSTabletManager::OrderTabletsForBootstrap(vector<scoped_refptr<TabletMetadata>>* metas) {
+  struct TabletOrder {
+    scoped_refptr<TabletMetadata> meta;
+    bool voted_for_local;
+    uint64_t wal_bytes;
+  };
+  Env* env = fs_manager_->env();
+  const string& local_uuid = fs_manager_->uuid();
+  vector<TabletOrder> order;
+  order.reserve(metas->size());
+  for (scoped_refptr<TabletMetadata>& meta : *metas) {
+    const string& tablet_id = meta->tablet_id();
+    // A replica which voted for this server in its last election most likely
+    // had it as its leader. Failing to read the consensus metadata isn't an
+    // error here; the bootstrap will report it.
+    bool voted_for_local = false;
+    unique_ptr<ConsensusMetadata> cmeta;
+    if (ConsensusMetadata::Load(fs_manager_, tablet_id, local_uuid, &cmeta).ok()) {
+      voted_for_local = cmeta->has_voted_for() && cmeta->voted_for() == local_uuid;
+    }
+
+    // The WAL segments to be replayed, estimated by those on disk.
+    uint64_t wal_bytes = 0;
+    string wal_dir = fs_manager_->GetTabletWalDir(tablet_id);
+    vector<string> children;
+    if (env->GetChildren(wal_dir, &children).ok()) {
+      for (const string& child : children) {
+        uint64_t size;
+        if (HasPrefixString(child, FsManager::kWalFileNamePrefix) &&
+            env->GetFileSize(JoinPathSegments(wal_dir, child), &size).ok()) {
+          wal_bytes += size;
+        }
+      }
+    }
+    order.push_back({ std::move(meta), voted_for_local, wal_bytes });
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [](const TabletOrder& a, const TabletOrder& b) {
+                     if (a.voted_for_local != b.voted_for_local) {
+                       return a.voted_for_local;
+                     }
+                     return a.wal_bytes < b.wal_bytes;
+                   });
+  metas->clear();
+  for (TabletOrder& tablet : order) {
+    VLOG(1) << LogPrefix(tablet.meta->tablet_id()) << "Bootstrap order " << metas->size()
+            << ": voted for local server: " << tablet.voted_for_local
+            << ", WAL bytes: " << tablet.wal_bytes;
+    metas->push_back(std::move(tablet.meta));
+  }
+}
+
 Status TSTabletManager::WaitForAllBootstrapsToFinish() {
   CHECK_EQ(state(), MANAGER_RUNNING);
 
@@ -251,6 +369,7 @@ Status TSTabletManager::CreateNewTablet(const string& table_id,
                                         const string& table_name,
                                         const Schema& schema,
                                         const PartitionSchema& partition_schema,
+                                        const CompactionPolicyPB& compaction_policy,
                                         RaftConfigPB config,
                                         scoped_refptr<TabletPeer>* tablet_peer) {
   CHECK_EQ(state(), MANAGER_RUNNING);
@@ -287,6 +406,7 @@ Status TSTabletManager::CreateNewTablet(const string& table_id,
                               schema,
                               partition_schema,
                               partition,
+                              compaction_policy,
                               TABLET_DATA_READY,
                               &meta),
     "Couldn't create tablet metadata");
@@ -340,9 +460,13 @@ Status TSTabletManager::StartTabletCopy(
     const StartTabletCopyRequestPB& req,
     boost::optional<TabletServerErrorPB::Code>* error_code) {
   const string& tablet_id = req.tablet_id();
-  const string& copy_source_uuid = req.copy_peer_uuid();
+  string copy_source_uuid = req.copy_peer_uuid();
   HostPort copy_source_addr;
   RETURN_NOT_OK(HostPortFromPB(req.copy_peer_addr(), &copy_source_addr));
+  HostPort fallback_addr;
+  if (req.has_fallback_peer_addr()) {
+    RETURN_NOT_OK(HostPortFromPB(req.fallback_peer_addr(), &fallback_addr));
+  }
   int64_t leader_term = req.caller_term();
 
   const string kLogPrefix = LogPrefix(tablet_id);
@@ -417,13 +541,25 @@ Status TSTabletManager::StartTabletCopy(
   LOG(INFO) << init_msg;
   TRACE(init_msg);
 
-  TabletCopyClient tc_client(tablet_id, fs_manager_, server_->messenger());
+  TabletCopyClient tc_client(tablet_id, fs_manager_, server_->messenger(),
+                             tablet_copy_throttler_.get());
 
   // Download and persist the remote superblock in TABLET_DATA_COPYING state.
   if (replacing_tablet) {
     RETURN_NOT_OK(tc_client.SetTabletToReplace(meta, leader_term));
   }
-  RETURN_NOT_OK(tc_client.Start(copy_source_addr, &meta));
+  Status s = tc_client.Start(copy_source_addr, &meta);
+  if (!s.ok() && req.has_fallback_peer_addr() && !tc_client.changed_local_state()) {
+    // The source was a follower which can't serve the copy, e.g. because
+    // it's being copied itself: copy from the leader instead.
+    LOG(WARNING) << kLogPrefix << "Unable to start tablet copy from Peer " << copy_source_uuid
+                 << ": " << s.ToString() << ". Falling back to Peer "
+                 << req.fallback_peer_uuid() << " (" << fallback_addr.ToString() << ")";
+    copy_source_uuid = req.fallback_peer_uuid();
+    copy_source_addr = fallback_addr;
+    s = tc_client.Start(copy_source_addr, &meta);
+  }
+  RETURN_NOT_OK(s);
 
   // From this point onward, the superblock is persisted in TABLET_DATA_COPYING
   // state, and we need to tombtone the tablet if additional steps prior to
@@ -435,7 +571,7 @@ Status TSTabletManager::StartTabletCopy(
   string peer_str = copy_source_uuid + " (" + copy_source_addr.ToString() + ")";
 
   // Download all of the remote files.
-  Status s = tc_client.FetchAll(implicit_cast<TabletStatusListener*>(tablet_peer.get()));
+  s = tc_client.FetchAll(implicit_cast<TabletStatusListener*>(tablet_peer.get()));
   TOMBSTONE_NOT_OK(s, tablet_peer,
                    "Tablet Copy: Unable to fetch data from remote peer " +
                    copy_source_uuid + " (" + copy_source_addr.ToString() + ")");
@@ -460,6 +596,7 @@ scoped_refptr<TabletPeer> TSTabletManager::CreateAndRegisterTabletPeer(
   scoped_refptr<TabletPeer> tablet_peer(
       new TabletPeer(meta,
                      local_peer_pb_,
+                     prepare_pool_.get(),
                      apply_pool_.get(),
                      Bind(&TSTabletManager::MarkTabletDirty, Unretained(this), meta->tablet_id())));
   RegisterTablet(meta->tablet_id(), tablet_peer, mode);
@@ -658,6 +795,7 @@ void TSTabletManager::OpenTablet(const scoped_refptr<TabletMetadata>& meta,
       tablet_peer->SetFailed(s);
       return;
     }
+    tablet->SetCompactionEncodePool(compaction_encode_pool_.get());
   }
 
   MonoTime start(MonoTime::Now());
@@ -689,6 +827,10 @@ void TSTabletManager::OpenTablet(const scoped_refptr<TabletMetadata>& meta,
     tablet_peer->RegisterMaintenanceOps(server_->maintenance_manager());
   }
 
+  // The blocks the tablet had hot before it was last closed are likely to
+  // be read again soon.
+  WarmUpBlockCacheFromSavedHotBlocks(tablet_peer);
+
   int elapsed_ms = (MonoTime::Now() - start).ToMilliseconds();
   if (elapsed_ms > FLAGS_tablet_start_warn_threshold_ms) {
     LOG(WARNING) << LogPrefix(tablet_id) << "Tablet startup took " << elapsed_ms << "ms";
@@ -700,6 +842,14 @@ void TSTabletManager::OpenTablet(const scoped_refptr<TabletMetadata>& meta,
 }
 
 void TSTabletManager::Shutdown() {
+  ShutdownInternal(nullptr);
+}
+
+void TSTabletManager::ShutdownAndFlush(const MonoDelta& flush_budget) {
+  ShutdownInternal(&flush_budget);
+}
+
+void TSTabletManager::ShutdownInternal(const MonoDelta* flush_budget) {
   {
     std::lock_guard<rw_spinlock> lock(lock_);
     switch (state_) {
@@ -726,18 +876,33 @@ void TSTabletManager::Shutdown() {
   // Shut down the bootstrap pool, so new tablets are registered after this point.
   open_tablet_pool_->Shutdown();
 
+  // Stop saving the hot blocks and warming up the block cache.
+  hot_blocks_shutdown_latch_.CountDown();
+  if (hot_blocks_thread_) {
+    CHECK_OK(ThreadJoiner(hot_blocks_thread_.get()).Join());
+  }
+  warmup_pool_->Shutdown();
+
   // Take a snapshot of the peers list -- that way we don't have to hold
   // on to the lock while shutting them down, which might cause a lock
   // inversion. (see KUDU-308 for example).
   vector<scoped_refptr<TabletPeer> > peers_to_shutdown;
   GetTabletPeers(&peers_to_shutdown);
 
-  for (const scoped_refptr<TabletPeer>& peer : peers_to_shutdown) {
-    peer->Shutdown();
+  if (flush_budget) {
+    FlushAndShutdownPeers(peers_to_shutdown, MonoTime::Now() + *flush_budget);
+  } else {
+    for (const scoped_refptr<TabletPeer>& peer : peers_to_shutdown) {
+      peer->Shutdown();
+    }
   }
 
-  // Shut down the apply pool.
+  // Shut down the prepare, apply and compaction encode pools.
+  prepare_pool_->Shutdown();
   apply_pool_->Shutdown();
+  if (compaction_encode_pool_) {
+    compaction_encode_pool_->Shutdown();
+  }
 
   {
     std::lock_guard<rw_spinlock> l(lock_);
@@ -751,6 +916,51 @@ void TSTabletManager::Shutdown() {
   }
 }
 
+void TSTabletManager::FlushAndShutdownPeers(const vector<scoped_refptr<TabletPeer>>& peers,
+                                            const MonoTime& deadline) {
+  // Step down everywhere first, so that clients move on to the new leaders
+  // while the tablets wait for their turn to flush.
+  for (const scoped_refptr<TabletPeer>& peer : peers) {
+    if (peer->state() == tablet::RUNNING) {
+      peer->StepDownForShutdown();
+    }
+  }
+
+  int max_flush_threads = FLAGS_num_tablets_to_flush_on_shutdown_simultaneously;
+  if (max_flush_threads == 0) {
+    // Default to the number of disks.
+    max_flush_threads = fs_manager_->GetDataRootDirs().size();
+  }
+  gscoped_ptr<ThreadPool> flush_pool;
+  Status s = ThreadPoolBuilder("shutdown-flush")
+      .set_max_threads(max_flush_threads)
+      .Build(&flush_pool);
+  if (!s.ok()) {
+    LOG(WARNING) << "Unable to flush the tablets on shutdown: " << s.ToString();
+    for (const scoped_refptr<TabletPeer>& peer : peers) {
+      peer->Shutdown();
+    }
+    return;
+  }
+
+  AtomicInt<int32_t> num_clean(0);
+  for (const scoped_refptr<TabletPeer>& peer : peers) {
+    CHECK_OK(flush_pool->SubmitFunc([&num_clean, peer, deadline]() {
+      if (MonoTime::Now() < deadline) {
+        if (peer->ShutdownAndFlush()) {
+          num_clean.Increment();
+        }
+      } else {
+        peer->Shutdown();
+      }
+    }));
+  }
+  flush_pool->Wait();
+  flush_pool->Shutdown();
+  LOG(INFO) << Substitute("$0 of $1 tablets were shut down cleanly and won't replay their WAL",
+                          num_clean.Load(), peers.size());
+}
+
 void TSTabletManager::RegisterTablet(const std::string& tablet_id,
                                      const scoped_refptr<TabletPeer>& tablet_peer,
                                      RegisterTabletPeerMode mode) {
@@ -811,6 +1021,153 @@ void TSTabletManager::MarkTabletDirty(const std::string& tablet_id, const std::s
       LogPrefix(tablet_id), reason);
   server_->heartbeater()->MarkTabletDirty(tablet_id, reason);
   server_->heartbeater()->TriggerASAP();
+  MaybeWarmUpNewLeader(tablet_id);
+}
+
+void TSTabletManager::WarmUpBlockCache(const scoped_refptr<TabletPeer>& tablet_peer,
+                                       const HotBlocksPB& hot_blocks) {
+  if (!FLAGS_block_cache_warmup_enabled) {
+    return;
+  }
+  Status s = warmup_pool_->SubmitFunc([this, tablet_peer, hot_blocks]() {
+    const string& tablet_id = tablet_peer->tablet_id();
+    shared_ptr<Tablet> tablet = tablet_peer->shared_tablet();
+    if (!tablet) {
+      return;
+    }
+    int num_loaded;
+    Status s = tablet->WarmUpBlockCache(hot_blocks, &num_loaded);
+    if (!s.ok()) {
+      LOG(WARNING) << LogPrefix(tablet_id) << "Failed to warm up the block cache: "
+                   << s.ToString();
+      return;
+    }
+    if (num_loaded > 0) {
+      LOG(INFO) << LogPrefix(tablet_id)
+                << Substitute("Warmed up the block cache with $0 blocks", num_loaded);
+    }
+  });
+  WARN_NOT_OK(s, LogPrefix(tablet_peer->tablet_id()) + "Unable to warm up the block cache");
+}
+
+void TSTabletManager::WarmUpBlockCacheFromSavedHotBlocks(
+    const scoped_refptr<TabletPeer>& tablet_peer) {
+  HotBlocksPB hot_blocks;
+  Status s = tablet_peer->tablet_metadata()->LoadHotBlocks(&hot_blocks);
+  if (s.IsNotFound()) {
+    return;
+  }
+  if (!s.ok()) {
+    LOG(WARNING) << LogPrefix(tablet_peer->tablet_id()) << s.ToString();
+    return;
+  }
+  WarmUpBlockCache(tablet_peer, hot_blocks);
+}
+
+void TSTabletManager::MaybeWarmUpNewLeader(const string& tablet_id) {
+  scoped_refptr<TabletPeer> tablet_peer;
+  if (!LookupTablet(tablet_id, &tablet_peer) || tablet_peer->state() != tablet::RUNNING) {
+    return;
+  }
+  scoped_refptr<consensus::Consensus> consensus = tablet_peer->shared_consensus();
+  bool is_leader = consensus && consensus->role() == RaftPeerPB::LEADER;
+  bool became_leader = false;
+  {
+    std::lock_guard<rw_spinlock> l(lock_);
+    if (is_leader) {
+      became_leader = leader_tablet_ids_.insert(tablet_id).second;
+    } else {
+      leader_tablet_ids_.erase(tablet_id);
+    }
+  }
+  if (became_leader) {
+    WarmUpBlockCacheFromSavedHotBlocks(tablet_peer);
+  }
+}
+
+void TSTabletManager::SaveHotBlocks() {
+  vector<scoped_refptr<TabletPeer>> tablet_peers;
+  GetTabletPeers(&tablet_peers);
+  for (const scoped_refptr<TabletPeer>& tablet_peer : tablet_peers) {
+    shared_ptr<Tablet> tablet = tablet_peer->shared_tablet();
+    if (tablet_peer->state() != tablet::RUNNING || !tablet) {
+      continue;
+    }
+    HotBlocksPB hot_blocks;
+    tablet->GetHotBlocks(&hot_blocks);
+    // Nothing was read since the tablet was opened: the blocks saved
+    // before are still the best guess.
+    if (hot_blocks.blocks_size() == 0) {
+      continue;
+    }
+    WARN_NOT_OK(tablet_peer->tablet_metadata()->SaveHotBlocks(hot_blocks),
+                LogPrefix(tablet_peer->tablet_id()) + "Unable to save the hot blocks");
+    scoped_refptr<consensus::Consensus> consensus = tablet_peer->shared_consensus();
+    if (consensus && consensus->role() == RaftPeerPB::LEADER) {
+      HintFollowers(tablet_peer, hot_blocks);
+    }
+  }
+}
+
+namespace {
+
+// A hint sent to a follower, kept until its response arrives.
+struct WarmUpHint {
+  gscoped_ptr<TabletServerServiceProxy> proxy;
+  WarmUpBlockCacheRequestPB req;
+  WarmUpBlockCacheResponsePB resp;
+  rpc::RpcController controller;
+};
+
+} // anonymous namespace
+
+void TSTabletManager::HintFollowers(const scoped_refptr<TabletPeer>& tablet_peer,
+                                    const HotBlocksPB& hot_blocks) {
+  const string& tablet_id = tablet_peer->tablet_id();
+  RaftConfigPB config = tablet_peer->consensus()->CommittedConfig();
+  for (const RaftPeerPB& peer : config.peers()) {
+    if (peer.permanent_uuid() == fs_manager_->uuid() || !peer.has_last_known_addr()) {
+      continue;
+    }
+    HostPort hp;
+    vector<Sockaddr> addrs;
+    Status s = HostPortFromPB(peer.last_known_addr(), &hp);
+    if (s.ok()) {
+      s = hp.ResolveAddresses(&addrs);
+    }
+    if (!s.ok() || addrs.empty()) {
+      VLOG(1) << LogPrefix(tablet_id) << "Unable to resolve follower "
+              << peer.permanent_uuid() << ": " << s.ToString();
+      continue;
+    }
+
+    // The blocks are specific to this replica: the follower only needs the
+    // columns.
+    auto hint = std::make_shared<WarmUpHint>();
+    hint->proxy.reset(new TabletServerServiceProxy(server_->messenger(), addrs[0]));
+    hint->req.set_tablet_id(tablet_id);
+    hint->req.mutable_hot_blocks()->mutable_column_ids()->CopyFrom(hot_blocks.column_ids());
+    hint->controller.set_timeout(MonoDelta::FromSeconds(10));
+    string msg = Substitute("$0Unable to hint the hot set to follower $1",
+                            LogPrefix(tablet_id), peer.permanent_uuid());
+    hint->proxy->WarmUpBlockCacheAsync(hint->req, &hint->resp, &hint->controller,
+                                       [hint, msg] {
+      Status s = hint->controller.status();
+      if (s.ok() && hint->resp.has_error()) {
+        s = StatusFromPB(hint->resp.error().status());
+      }
+      if (!s.ok()) {
+        VLOG(1) << msg << ": " << s.ToString();
+      }
+    });
+  }
+}
+
+void TSTabletManager::RunHotBlocksThread() {
+  while (!hot_blocks_shutdown_latch_.WaitFor(
+      MonoDelta::FromMilliseconds(FLAGS_tablet_hot_blocks_save_interval_ms))) {
+    SaveHotBlocks();
+  }
 }
 
 int TSTabletManager::GetNumLiveTablets() const {
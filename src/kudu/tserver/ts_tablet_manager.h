@@ -30,8 +30,10 @@
 #include "kudu/tserver/tablet_peer_lookup.h"
 #include "kudu/tserver/tserver_admin.pb.h"
 #include "kudu/tserver/tserver.pb.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/status.h"
 #include "kudu/util/threadpool.h"
 
@@ -42,6 +44,7 @@ class FsManager;
 class HostPort;
 class Partition;
 class Schema;
+class Thread;
 
 namespace consensus {
 class RaftConfigPB;
@@ -57,6 +60,7 @@ class ResultTracker;
 } // namespace rpc
 
 namespace tablet {
+class HotBlocksPB;
 class TabletMetadata;
 class TabletPeer;
 class TabletStatusPB;
@@ -64,6 +68,7 @@ class TabletStatusListener;
 }
 
 namespace tserver {
+class TabletCopyThrottler;
 class TabletServer;
 
 // Map of tablet id -> transition reason string.
@@ -97,9 +102,16 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
   // the first tablet whose bootstrap failed.
   Status WaitForAllBootstrapsToFinish();
 
-  // Shut down all of the tablets, gracefully flushing before shutdown.
+  // Shut down all of the tablets.
   void Shutdown();
 
+  // Shut down all of the tablets like Shutdown(), but gracefully: the
+  // tablets stop taking writes and step down as leaders, then are flushed
+  // in parallel so that, if every operation in their WAL was committed,
+  // they skip replaying it on restart. The tablets whose flush hasn't
+  // started after 'flush_budget' are shut down without flushing.
+  void ShutdownAndFlush(const MonoDelta& flush_budget);
+
   // Create a new tablet and register it with the tablet manager. The new tablet
   // is persisted on disk and opened before this method returns.
   //
@@ -113,6 +125,7 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
                          const std::string& table_name,
                          const Schema& schema,
                          const PartitionSchema& partition_schema,
+                         const CompactionPolicyPB& compaction_policy,
                          consensus::RaftConfigPB config,
                          scoped_refptr<tablet::TabletPeer>* tablet_peer);
 
@@ -173,9 +186,21 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
   // Return the number of tablets in RUNNING or BOOTSTRAPPING state.
   int GetNumLiveTablets() const;
 
+  // Warms up the block cache with 'hot_blocks' for the tablet of
+  // 'tablet_peer', in the background. Does nothing if the warmup is disabled
+  // with --block_cache_warmup_enabled. See Tablet::WarmUpBlockCache().
+  void WarmUpBlockCache(const scoped_refptr<tablet::TabletPeer>& tablet_peer,
+                        const tablet::HotBlocksPB& hot_blocks);
+
+  // Persists the hot blocks of every running tablet, and hints the hot set
+  // of the tablets led by this server to their followers. This is done
+  // every --tablet_hot_blocks_save_interval_ms.
+  void SaveHotBlocks();
+
   Status RunAllLogGC();
 
  private:
+  FRIEND_TEST(TsTabletManagerTest, TestOrderTabletsForBootstrap);
   FRIEND_TEST(TsTabletManagerTest, TestPersistBlocks);
 
   // Flag specified when registering a TabletPeer.
@@ -187,6 +212,14 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
   // Standard log prefix, given a tablet id.
   std::string LogPrefix(const std::string& tablet_id) const;
 
+  // Implements Shutdown() and ShutdownAndFlush(). The tablets are flushed
+  // if 'flush_budget' isn't null.
+  void ShutdownInternal(const MonoDelta* flush_budget);
+
+  // Shuts down 'peers', flushing those whose flush starts before 'deadline'.
+  void FlushAndShutdownPeers(const std::vector<scoped_refptr<tablet::TabletPeer>>& peers,
+                             const MonoTime& deadline);
+
   // Returns Status::OK() iff state_ == MANAGER_RUNNING.
   Status CheckRunningUnlocked(boost::optional<TabletServerErrorPB::Code>* error_code) const;
 
@@ -202,6 +235,11 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
                                             const std::string& reason,
                                             scoped_refptr<TransitionInProgressDeleter>* deleter);
 
+  // Reorders 'metas' so that the tablets which are likely to be needed and
+  // quick to open come first: those this server likely led before it
+  // restarted, then those with the least WAL to replay.
+  void OrderTabletsForBootstrap(std::vector<scoped_refptr<tablet::TabletMetadata>>* metas);
+
   // Open a tablet meta from the local file system by loading its superblock.
   Status OpenTabletMeta(const std::string& tablet_id,
                         scoped_refptr<tablet::TabletMetadata>* metadata);
@@ -276,6 +314,22 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
     return state_;
   }
 
+  // Warms up the block cache with the hot blocks last persisted for the
+  // tablet of 'tablet_peer', if there are any.
+  void WarmUpBlockCacheFromSavedHotBlocks(const scoped_refptr<tablet::TabletPeer>& tablet_peer);
+
+  // Warms up the block cache for the tablet of 'tablet_peer' if its replica
+  // just became leader, as far as the tablet manager knows.
+  void MaybeWarmUpNewLeader(const std::string& tablet_id);
+
+  // Sends the columns of 'hot_blocks' to the followers of the tablet of
+  // 'tablet_peer', which this server leads. See WarmUpBlockCacheRequestPB.
+  void HintFollowers(const scoped_refptr<tablet::TabletPeer>& tablet_peer,
+                     const tablet::HotBlocksPB& hot_blocks);
+
+  // Runs SaveHotBlocks() periodically until the tablet manager is shut down.
+  void RunHotBlocksThread();
+
   // Initializes the RaftPeerPB for the local peer.
   // Guaranteed to include both uuid and last_seen_addr fields.
   // Crashes with an invariant check if the RPC server is not currently in a
@@ -291,7 +345,7 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
   typedef std::unordered_map<std::string, scoped_refptr<tablet::TabletPeer> > TabletMap;
 
   // Lock protecting tablet_map_, dirty_tablets_, state_,
-  // transition_in_progress_, and perm_deleted_tablet_ids_.
+  // transition_in_progress_, perm_deleted_tablet_ids_ and leader_tablet_ids_.
   mutable rw_spinlock lock_;
 
   // Map from tablet ID to tablet
@@ -306,6 +360,10 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
   // bootstrap, creation, or deletion is in-progress
   TransitionInProgressMap transition_in_progress_;
 
+  // The tablets last known to be led by this server. See
+  // MaybeWarmUpNewLeader().
+  std::unordered_set<std::string> leader_tablet_ids_;
+
   MetricRegistry* metric_registry_;
 
   TSTabletManagerStatePB state_;
@@ -313,9 +371,29 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
   // Thread pool used to open the tablets async, whether bootstrap is required or not.
   gscoped_ptr<ThreadPool> open_tablet_pool_;
 
+  // Thread pool for preparing transactions, shared between all tablets. Each
+  // tablet submits to it through its own SERIAL token.
+  gscoped_ptr<ThreadPool> prepare_pool_;
+
   // Thread pool for apply transactions, shared between all tablets.
   gscoped_ptr<ThreadPool> apply_pool_;
 
+  // Rate limits the chunks received by all tablet copies.
+  gscoped_ptr<TabletCopyThrottler> tablet_copy_throttler_;
+
+  // Thread pool for warming up the block cache. It has a single thread, so
+  // that the warmup doesn't compete much with the reads it speeds up.
+  gscoped_ptr<ThreadPool> warmup_pool_;
+
+  // Thread pool encoding the flush and compaction output of all tablets, or
+  // null if --tablet_compaction_encode_threads is 0.
+  gscoped_ptr<ThreadPool> compaction_encode_pool_;
+
+  // Thread running SaveHotBlocks() periodically, and the latch which stops
+  // it.
+  scoped_refptr<Thread> hot_blocks_thread_;
+  CountDownLatch hot_blocks_shutdown_latch_;
+
   DISALLOW_COPY_AND_ASSIGN(TSTabletManager);
 };
 
@@ -18,6 +18,7 @@
 #include "kudu/tserver/tserver-path-handlers.h"
 
 #include <algorithm>
+#include <map>
 #include <memory>
 #include <sstream>
 #include <string>
@@ -34,7 +35,10 @@
 #include "kudu/server/webui_util.h"
 #include "kudu/tablet/tablet.pb.h"
 #include "kudu/tablet/tablet_bootstrap.h"
+#include "kudu/tablet/tablet_metrics.h"
 #include "kudu/tablet/tablet_peer.h"
+#include "kudu/tserver/resource_accountant.h"
+#include "kudu/tserver/scan_admission_controller.h"
 #include "kudu/tserver/scanners.h"
 #include "kudu/tserver/tablet_server.h"
 #include "kudu/tserver/ts_tablet_manager.h"
@@ -101,6 +105,10 @@ Status TabletServerPathHandlers::Register(Webserver* server) {
     "/maintenance-manager", "",
     boost::bind(&TabletServerPathHandlers::HandleMaintenanceManagerPage, this, _1, _2),
     true /* styled */, false /* is_on_nav_bar */);
+  server->RegisterPathHandler(
+    "/resources", "",
+    boost::bind(&TabletServerPathHandlers::HandleResourcesPage, this, _1, _2),
+    true /* styled */, false /* is_on_nav_bar */);
 
   return Status::OK();
 }
@@ -414,6 +422,28 @@ void TabletServerPathHandlers::HandleScansPage(const Webserver::WebRequest& req,
     *output << ScannerToHtml(*scanner);
   }
   *output << "</table>";
+
+  ScanAdmissionController* admission = tserver_->scan_admission_controller();
+  vector<ScanAdmissionController::QueuedRequest> queue;
+  admission->GetQueue(&queue);
+  *output << Substitute("<h2>Queued Scan Requests</h2>\n"
+                        "<p>$0 scan requests running, $1 waiting to run.</p>\n",
+                        admission->num_running(), queue.size());
+  *output << "<table class='table table-striped'>\n";
+  *output << "<tr><th>Position</th><th>User</th><th>Scanner id</th>"
+      "<th>Memory reserved</th><th>Time waiting</th></tr>\n";
+  MonoTime now = MonoTime::Now();
+  for (int i = 0; i < queue.size(); i++) {
+    const ScanAdmissionController::QueuedRequest& request = queue[i];
+    *output << Substitute("<tr><td>$0</td><td>$1</td><td>$2</td><td>$3</td><td>$4 us.</td></tr>\n",
+                          i + 1,
+                          EscapeForHtmlToString(request.user),
+                          request.scanner_id.empty() ? "&lt;new scan&gt;"
+                              : EscapeForHtmlToString(request.scanner_id),
+                          HumanReadableNumBytes::ToString(request.bytes),
+                          (now - request.arrival_time).ToMicroseconds());
+  }
+  *output << "</table>";
 }
 
 string TabletServerPathHandlers::ScannerToHtml(const Scanner& scanner) const {
@@ -511,6 +541,8 @@ void TabletServerPathHandlers::HandleDashboardsPage(const Webserver::WebRequest&
   *output << GetDashboardLine("maintenance-manager", "Maintenance Manager",
                               "List of operations that are currently running and those "
                               "that are registered.");
+  *output << GetDashboardLine("resources", "Resources",
+                              "Tables and users which used the most CPU and I/O.");
 }
 
 string TabletServerPathHandlers::GetDashboardLine(const std::string& link,
@@ -548,6 +580,42 @@ void TabletServerPathHandlers::HandleMaintenanceManagerPage(const Webserver::Web
   }
   *output << "</table>\n";
 
+  *output << "<h3>Adaptive scheduling</h3>\n";
+  *output << Substitute("<p>Threads: $0, flush threshold scale: $1</p>\n",
+                        pb.num_threads(), pb.flush_threshold_scale());
+  if (pb.adjustments_size() > 0) {
+    *output << "<table class='table table-striped'>\n";
+    *output << "  <tr><th>Time since adjustment</th><th>Threads</th>\n"
+            << "       <th>Flush threshold scale</th><th>Reason</th></tr>\n";
+    for (const auto& adjustment_pb : pb.adjustments()) {
+      *output << Substitute("<tr><td>$0</td><td>$1</td><td>$2</td><td>$3</td></tr>\n",
+                            HumanReadableElapsedTime::ToShortString(
+                                adjustment_pb.secs_since_adjustment()),
+                            adjustment_pb.num_threads(),
+                            adjustment_pb.flush_threshold_scale(),
+                            EscapeForHtmlToString(adjustment_pb.reason()));
+    }
+    *output << "</table>\n";
+  }
+
+  *output << "<h3>Operation classes</h3>\n";
+  *output << "<table class='table table-striped'>\n";
+  *output << "  <tr><th>Class</th><th>Running</th><th>Launched</th>\n"
+          << "       <th>Mean queue time</th><th>Max queue time</th></tr>\n";
+  for (int i = 0; i < pb.op_classes_size(); i++) {
+    const MaintenanceManagerStatusPB_OpClassPB& class_pb = pb.op_classes(i);
+    double mean_queue_secs = class_pb.launched() == 0 ? 0 :
+        class_pb.total_queue_time_micros() / 1e6 / class_pb.launched();
+    *output << Substitute("<tr><td>$0</td><td>$1</td><td>$2</td><td>$3</td><td>$4</td></tr>\n",
+                          EscapeForHtmlToString(class_pb.name()),
+                          class_pb.running(),
+                          class_pb.launched(),
+                          HumanReadableElapsedTime::ToShortString(mean_queue_secs),
+                          HumanReadableElapsedTime::ToShortString(
+                              class_pb.max_queue_time_micros() / 1e6));
+  }
+  *output << "</table>\n";
+
   *output << "<h3>Recent completed operations</h3>\n";
   *output << "<table class='table table-striped'>\n";
   *output << "  <tr><th>Name</th><th>Duration</th><th>Time since op started</th></tr>\n";
@@ -580,5 +648,83 @@ void TabletServerPathHandlers::HandleMaintenanceManagerPage(const Webserver::Web
   *output << "</table>\n";
 }
 
+namespace {
+
+// Lists the 'n' consumers of 'usages' which used the most of 'resource'.
+void ResourceUsagesToHtml(const string& title, const string& consumer, int n,
+                          int64_t ResourceUsage::*resource, bool is_bytes,
+                          ResourceUsageVector usages, std::ostringstream* output) {
+  KeepTopResourceUsages(n, resource, &usages);
+  *output << "<h3>" << EscapeForHtmlToString(title) << "</h3>\n";
+  *output << "<table class='table table-striped'>\n";
+  *output << Substitute("  <tr><th>$0</th><th>Usage</th></tr>\n", consumer);
+  for (const auto& usage : usages) {
+    int64_t value = usage.second.*resource;
+    *output << Substitute("  <tr><td>$0</td><td>$1</td></tr>\n",
+                          EscapeForHtmlToString(usage.first),
+                          is_bytes ? HumanReadableNumBytes::ToString(value) :
+                                     Substitute("$0 ms", value / 1000));
+  }
+  *output << "</table>\n";
+}
+
+} // anonymous namespace
+
+void TabletServerPathHandlers::HandleResourcesPage(const Webserver::WebRequest& req,
+                                                   std::ostringstream* output) {
+  int n = 10;
+  string arg = FindWithDefault(req.parsed_args, "n", "");
+  if (!arg.empty() && (!safe_strto32(arg, &n) || n < 1)) {
+    *output << "Invalid number of consumers to list: " << EscapeForHtmlToString(arg);
+    return;
+  }
+
+  // The usages of tables are the sums of those of their tablets, which only
+  // count since the tablets were opened by this server.
+  std::map<string, ResourceUsage> rpc_usage_by_table;
+  std::map<string, ResourceUsage> maintenance_usage_by_table;
+  vector<scoped_refptr<TabletPeer> > peers;
+  tserver_->tablet_manager()->GetTabletPeers(&peers);
+  for (const scoped_refptr<TabletPeer>& peer : peers) {
+    shared_ptr<Tablet> tablet = peer->shared_tablet();
+    if (!tablet || !tablet->metrics()) {
+      continue;
+    }
+    const tablet::TabletMetrics* metrics = tablet->metrics();
+    string table_name = peer->tablet_metadata()->table_name();
+    ResourceUsage rpc_usage;
+    rpc_usage.cpu_time_us = metrics->rpc_cpu_time_us->value();
+    rpc_usage.cfile_cache_hit_bytes = metrics->rpc_cfile_cache_hit_bytes->value();
+    rpc_usage.cfile_cache_miss_bytes = metrics->rpc_cfile_cache_miss_bytes->value();
+    rpc_usage_by_table[table_name] += rpc_usage;
+    ResourceUsage maintenance_usage;
+    maintenance_usage.cpu_time_us = metrics->maintenance_cpu_time_us->value();
+    maintenance_usage_by_table[table_name] += maintenance_usage;
+  }
+  ResourceUsageVector tables(rpc_usage_by_table.begin(), rpc_usage_by_table.end());
+  ResourceUsageVector users = tserver_->resource_accountant()->GetUsageByUser();
+
+  *output << "<h1>Resource usage</h1>\n";
+  *output << "<p>CPU time only counts the RPC handler threads; block cache misses "
+             "are the bytes read from disk.</p>\n";
+  ResourceUsagesToHtml("Tables by RPC CPU time", "Table", n,
+                       &ResourceUsage::cpu_time_us, false, tables, output);
+  ResourceUsagesToHtml("Tables by block cache miss bytes", "Table", n,
+                       &ResourceUsage::cfile_cache_miss_bytes, true, tables, output);
+  ResourceUsagesToHtml("Tables by block cache hit bytes", "Table", n,
+                       &ResourceUsage::cfile_cache_hit_bytes, true, tables, output);
+  ResourceUsagesToHtml("Tables by maintenance CPU time", "Table", n,
+                       &ResourceUsage::cpu_time_us, false,
+                       ResourceUsageVector(maintenance_usage_by_table.begin(),
+                                           maintenance_usage_by_table.end()),
+                       output);
+  ResourceUsagesToHtml("Users by RPC CPU time", "User", n,
+                       &ResourceUsage::cpu_time_us, false, users, output);
+  ResourceUsagesToHtml("Users by block cache miss bytes", "User", n,
+                       &ResourceUsage::cfile_cache_miss_bytes, true, users, output);
+  ResourceUsagesToHtml("Users by block cache hit bytes", "User", n,
+                       &ResourceUsage::cfile_cache_hit_bytes, true, users, output);
+}
+
 } // namespace tserver
 } // namespace kudu
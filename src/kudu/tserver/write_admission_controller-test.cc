@@ -0,0 +1,152 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tserver/write_admission_controller.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include "kudu/util/mem_tracker.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/test_util.h"
+
+DECLARE_int32(tablet_write_admission_max_queued);
+DECLARE_int32(tablet_write_admission_max_wait_ms);
+
+METRIC_DECLARE_gauge_int32(write_requests_queued);
+
+using std::shared_ptr;
+using std::string;
+using std::thread;
+using std::vector;
+
+namespace kudu {
+namespace tserver {
+
+class WriteAdmissionControllerTest : public KuduTest {
+ public:
+  WriteAdmissionControllerTest()
+      : entity_(METRIC_ENTITY_server.Instantiate(&registry_, "test")),
+        tracker_(MemTracker::CreateTracker(1000, CURRENT_TEST_NAME())),
+        controller_(entity_) {
+  }
+
+ protected:
+  static MonoTime Deadline() {
+    return MonoTime::Now() + MonoDelta::FromSeconds(30);
+  }
+
+  Status Admit(const string& tablet_id, MonoDelta* waited) {
+    double capacity_pct;
+    return controller_.Admit(tablet_id, tracker_.get(), Deadline(), waited, &capacity_pct);
+  }
+
+  // Waits until 'n' writes are queued.
+  void WaitForQueued(int n) {
+    AssertEventually([&]() {
+      ASSERT_EQ(n, controller_.num_queued());
+    });
+  }
+
+  MetricRegistry registry_;
+  scoped_refptr<MetricEntity> entity_;
+  shared_ptr<MemTracker> tracker_;
+  WriteAdmissionController controller_;
+};
+
+// Test that writes pass right away without memory pressure, wait while it
+// lasts, and are rejected when they wait for too long or the queue is full.
+TEST_F(WriteAdmissionControllerTest, TestMemoryPressure) {
+  MonoDelta waited;
+  ASSERT_OK(Admit("a", &waited));
+  ASSERT_EQ(0, waited.ToNanoseconds());
+
+  // Over the hard limit, writes time out waiting.
+  FLAGS_tablet_write_admission_max_wait_ms = 50;
+  tracker_->Consume(1001);
+  Status s = Admit("a", &waited);
+  ASSERT_TRUE(s.IsServiceUnavailable()) << s.ToString();
+  ASSERT_GE(waited.ToMilliseconds(), 50);
+
+  // A write is admitted once memory is freed.
+  FLAGS_tablet_write_admission_max_wait_ms = 30000;
+  Status waiter_status;
+  thread waiter([&]() {
+    MonoDelta waiter_waited;
+    waiter_status = Admit("a", &waiter_waited);
+  });
+  NO_FATALS(WaitForQueued(1));
+  ASSERT_EQ(1, METRIC_write_requests_queued.Instantiate(entity_, 0)->value());
+
+  // A full queue rejects writes right away.
+  FLAGS_tablet_write_admission_max_queued = 1;
+  s = Admit("b", &waited);
+  ASSERT_TRUE(s.IsServiceUnavailable()) << s.ToString();
+  ASSERT_EQ(0, waited.ToNanoseconds());
+
+  tracker_->Release(1001);
+  waiter.join();
+  ASSERT_OK(waiter_status);
+  ASSERT_EQ(0, controller_.num_queued());
+  ASSERT_EQ(0, METRIC_write_requests_queued.Instantiate(entity_, 0)->value());
+}
+
+// Test that the tablets waiting for memory take turns.
+TEST_F(WriteAdmissionControllerTest, TestTabletsTakeTurns) {
+  FLAGS_tablet_write_admission_max_wait_ms = 30000;
+  // Tablet "a" is under pressure from 'tracker_', "b" from its own tracker.
+  shared_ptr<MemTracker> b_tracker = MemTracker::CreateTracker(1000, "b");
+  tracker_->Consume(1001);
+  b_tracker->Consume(1001);
+
+  vector<thread> threads;
+  for (int i = 0; i < 2; i++) {
+    threads.emplace_back([&]() {
+      MonoDelta waited;
+      CHECK_OK(Admit("a", &waited));
+    });
+    NO_FATALS(WaitForQueued(i + 1));
+  }
+  threads.emplace_back([&]() {
+    MonoDelta waited;
+    double capacity_pct;
+    CHECK_OK(controller_.Admit("b", b_tracker.get(), Deadline(), &waited, &capacity_pct));
+  });
+  NO_FATALS(WaitForQueued(3));
+
+  // Once "a" has had a write admitted, it waits for "b" to have its turn,
+  // even though only "a" has memory.
+  tracker_->Release(1001);
+  NO_FATALS(WaitForQueued(2));
+  SleepFor(MonoDelta::FromMilliseconds(100));
+  ASSERT_EQ(2, controller_.num_queued());
+
+  b_tracker->Release(1001);
+  for (thread& t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(0, controller_.num_queued());
+}
+
+} // namespace tserver
+} // namespace kudu
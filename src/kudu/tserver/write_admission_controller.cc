@@ -0,0 +1,168 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tserver/write_admission_controller.h"
+
+#include <algorithm>
+
+#include <gflags/gflags.h>
+
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/mem_tracker.h"
+#include "kudu/util/metrics.h"
+
+DEFINE_int32(tablet_write_admission_max_queued, 10,
+             "Maximum number of write requests waiting for memory to be freed "
+             "before being admitted, each of which holds an RPC service thread. "
+             "Other writes under memory pressure are rejected, and retried by "
+             "clients.");
+TAG_FLAG(tablet_write_admission_max_queued, advanced);
+TAG_FLAG(tablet_write_admission_max_queued, runtime);
+
+DEFINE_int32(tablet_write_admission_max_wait_ms, 500,
+             "Maximum time a write request waits for memory to be freed before "
+             "being rejected, and retried by its client. 0 means that writes under "
+             "memory pressure are rejected right away.");
+TAG_FLAG(tablet_write_admission_max_wait_ms, advanced);
+TAG_FLAG(tablet_write_admission_max_wait_ms, runtime);
+
+METRIC_DEFINE_gauge_int32(server, write_requests_queued,
+                          "Write Requests Queued", kudu::MetricUnit::kRequests,
+                          "Number of write requests waiting for memory to be freed "
+                          "before being admitted");
+METRIC_DEFINE_histogram(server, write_admission_wait_time,
+                        "Write Admission Wait Time", kudu::MetricUnit::kMicroseconds,
+                        "Time that write requests which had to wait were queued for "
+                        "admission, whether or not they were admitted",
+                        60000000LU, 2);
+
+using std::string;
+using strings::Substitute;
+
+namespace kudu {
+namespace tserver {
+
+// How often the next waiter checks whether memory was freed.
+static const int kMemoryPollIntervalMs = 10;
+
+WriteAdmissionController::WriteAdmissionController(
+    const scoped_refptr<MetricEntity>& metric_entity)
+    : cond_(&lock_),
+      num_admitted_from_queue_(0) {
+  if (metric_entity) {
+    queued_gauge_ = METRIC_write_requests_queued.Instantiate(metric_entity, 0);
+    wait_time_us_ = METRIC_write_admission_wait_time.Instantiate(metric_entity);
+  }
+}
+
+WriteAdmissionController::~WriteAdmissionController() {
+  DCHECK(waiters_.empty());
+}
+
+Status WriteAdmissionController::Admit(const string& tablet_id, MemTracker* mem_tracker,
+                                       const MonoTime& deadline, MonoDelta* waited,
+                                       double* capacity_pct) {
+  MonoTime now = MonoTime::Now();
+  *waited = MonoDelta::FromNanoseconds(0);
+  MutexLock l(lock_);
+  if (waiters_.empty() && !mem_tracker->AnySoftLimitExceeded(capacity_pct)) {
+    return Status::OK();
+  }
+  int max_wait_ms = FLAGS_tablet_write_admission_max_wait_ms;
+  if (max_wait_ms <= 0 ||
+      static_cast<int>(waiters_.size()) >= FLAGS_tablet_write_admission_max_queued) {
+    // Report the memory pressure if it's the reason for the rejection.
+    if (mem_tracker->AnySoftLimitExceeded(capacity_pct)) {
+      return Status::ServiceUnavailable(
+          Substitute("Soft memory limit exceeded (at $0% of capacity)", *capacity_pct));
+    }
+    return Status::ServiceUnavailable(Substitute(
+        "Write request rejected: $0 write requests are already waiting for memory",
+        waiters_.size()));
+  }
+
+  Waiter waiter = { tablet_id, mem_tracker };
+  waiters_.push_back(&waiter);
+  if (queued_gauge_) {
+    queued_gauge_->Increment();
+  }
+  MonoTime wait_deadline = MonoTime::Earliest(
+      deadline, now + MonoDelta::FromMilliseconds(max_wait_ms));
+  bool admitted = false;
+  while (true) {
+    if (NextWaiterUnlocked() == &waiter && !mem_tracker->AnySoftLimitExceeded(capacity_pct)) {
+      admitted = true;
+      break;
+    }
+    MonoTime wait_now = MonoTime::Now();
+    if (wait_now >= wait_deadline) {
+      break;
+    }
+    cond_.TimedWait(std::min(MonoDelta::FromMilliseconds(kMemoryPollIntervalMs),
+                             wait_deadline - wait_now));
+  }
+
+  waiters_.remove(&waiter);
+  if (admitted) {
+    last_admitted_by_tablet_[tablet_id] = ++num_admitted_from_queue_;
+  }
+  if (waiters_.empty()) {
+    // The turns start over with the next memory pressure.
+    last_admitted_by_tablet_.clear();
+  }
+  if (queued_gauge_) {
+    queued_gauge_->Decrement();
+  }
+  *waited = MonoTime::Now() - now;
+  if (wait_time_us_) {
+    wait_time_us_->Increment(waited->ToMicroseconds());
+  }
+  // Let the next waiter check in right away.
+  cond_.Broadcast();
+  if (!admitted) {
+    return Status::ServiceUnavailable(Substitute(
+        "Soft memory limit exceeded (at $0% of capacity): timed out waiting for "
+        "memory to be freed", *capacity_pct));
+  }
+  return Status::OK();
+}
+
+const WriteAdmissionController::Waiter* WriteAdmissionController::NextWaiterUnlocked() const {
+  lock_.AssertAcquired();
+  const Waiter* next = nullptr;
+  int64_t next_last_admitted = 0;
+  for (const Waiter* waiter : waiters_) {
+    int64_t last_admitted = FindWithDefault(last_admitted_by_tablet_, waiter->tablet_id, 0);
+    // 'waiters_' is in arrival order, so the earliest of the tablets admitted
+    // the longest ago comes first.
+    if (next == nullptr || last_admitted < next_last_admitted) {
+      next = waiter;
+      next_last_admitted = last_admitted;
+    }
+  }
+  return next;
+}
+
+int WriteAdmissionController::num_queued() const {
+  MutexLock l(lock_);
+  return waiters_.size();
+}
+
+} // namespace tserver
+} // namespace kudu
@@ -0,0 +1,108 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TSERVER_WRITE_ADMISSION_CONTROLLER_H
+#define KUDU_TSERVER_WRITE_ADMISSION_CONTROLLER_H
+
+#include <stdint.h>
+
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/mutex.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+template<class T>
+class AtomicGauge;
+class Histogram;
+class MemTracker;
+class MetricEntity;
+
+namespace tserver {
+
+// Holds back the write requests that a tablet server receives while it's
+// under memory pressure, rather than rejecting them right away and having
+// their clients retry them in bursts.
+//
+// A write is admitted right away unless a soft memory limit of its tablet's
+// MemTracker (or of one of its ancestors) is exceeded, or other writes are
+// already waiting. Otherwise the write waits in line while flushes free
+// memory, until the soft limit check passes. The tablets take turns: the
+// next write admitted is the earliest of those whose tablet was admitted
+// from the line the longest ago, so that a tablet receiving many writes
+// can't hold back the others. Since a waiting write holds an RPC service
+// thread, at most --tablet_write_admission_max_queued writes wait; the
+// others, and those which aren't admitted within
+// --tablet_write_admission_max_wait_ms, are rejected with
+// ServiceUnavailable, as all writes under memory pressure used to be.
+//
+// This class is thread-safe.
+class WriteAdmissionController {
+ public:
+  // 'metric_entity' may be NULL, in which case no metrics are produced.
+  explicit WriteAdmissionController(const scoped_refptr<MetricEntity>& metric_entity);
+  ~WriteAdmissionController();
+
+  // Admits a write to tablet 'tablet_id', whose memory is tracked by
+  // 'mem_tracker', waiting in line until then or 'deadline'. Sets 'waited'
+  // to the time the write waited. If the write is rejected, sets
+  // 'capacity_pct' to the percentage of the memory limit in use.
+  Status Admit(const std::string& tablet_id, MemTracker* mem_tracker,
+               const MonoTime& deadline, MonoDelta* waited, double* capacity_pct);
+
+  // Returns the number of waiting writes.
+  int num_queued() const;
+
+ private:
+  struct Waiter {
+    std::string tablet_id;
+    MemTracker* mem_tracker;
+  };
+
+  // Returns the waiter to admit next, or NULL if there are none.
+  const Waiter* NextWaiterUnlocked() const;
+
+  mutable Mutex lock_;
+
+  // Signalled when a waiter leaves the line.
+  ConditionVariable cond_;
+
+  // The waiting writes, in arrival order. Protected by 'lock_'.
+  std::list<const Waiter*> waiters_;
+
+  // The number of writes admitted from the line, and the number at which
+  // each tablet last had a write admitted from it, while there have been
+  // waiters. Protected by 'lock_'.
+  int64_t num_admitted_from_queue_;
+  std::unordered_map<std::string, int64_t> last_admitted_by_tablet_;
+
+  scoped_refptr<AtomicGauge<int32_t>> queued_gauge_;
+  scoped_refptr<Histogram> wait_time_us_;
+
+  DISALLOW_COPY_AND_ASSIGN(WriteAdmissionController);
+};
+
+} // namespace tserver
+} // namespace kudu
+
+#endif // KUDU_TSERVER_WRITE_ADMISSION_CONTROLLER_H
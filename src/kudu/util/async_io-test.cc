@@ -0,0 +1,104 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/async_io.h"
+
+#include <string>
+#include <vector>
+
+#include "kudu/gutil/bind.h"
+#include "kudu/util/env.h"
+#include "kudu/util/test_util.h"
+
+using std::string;
+using std::vector;
+
+namespace kudu {
+
+class AsyncIoTest : public KuduTest {
+};
+
+namespace {
+void RecordStatus(Status* out, const Status& s) {
+  *out = s;
+}
+
+Status FailRequest() {
+  return Status::IOError("injected failure");
+}
+} // anonymous namespace
+
+// Test that batches of writes and reads complete, with their callbacks.
+TEST_F(AsyncIoTest, TestWriteAndRead) {
+  AsyncIo io(4);
+  const int kNumRequests = 16;
+  const string path = GetTestPath("file");
+  gscoped_ptr<RWFile> rw_file;
+  ASSERT_OK(env_->NewRWFile(path, &rw_file));
+
+  vector<string> contents;
+  vector<Status> statuses(kNumRequests);
+  vector<AsyncIo::Request> writes;
+  for (int i = 0; i < kNumRequests; i++) {
+    contents.push_back(string(64, 'a' + i));
+  }
+  for (int i = 0; i < kNumRequests; i++) {
+    writes.push_back(AsyncIo::Request::Write(
+        rw_file.get(), i * 64, contents[i], Bind(&RecordStatus, &statuses[i])));
+  }
+  ASSERT_OK(io.SubmitAndWait(writes));
+  for (const Status& s : statuses) {
+    ASSERT_OK(s);
+  }
+  ASSERT_OK(rw_file->Close());
+
+  gscoped_ptr<RandomAccessFile> file;
+  ASSERT_OK(env_->NewRandomAccessFile(path, &file));
+  vector<uint8_t> scratch(kNumRequests * 64);
+  vector<Slice> results(kNumRequests);
+  vector<AsyncIo::Request> reads;
+  for (int i = 0; i < kNumRequests; i++) {
+    statuses[i] = Status::Incomplete("");
+    reads.push_back(AsyncIo::Request::Read(
+        file.get(), i * 64, 64, &scratch[i * 64], &results[i],
+        Bind(&RecordStatus, &statuses[i])));
+  }
+  ASSERT_OK(io.SubmitAndWait(reads));
+  for (int i = 0; i < kNumRequests; i++) {
+    ASSERT_OK(statuses[i]);
+    ASSERT_EQ(contents[i], results[i].ToString());
+  }
+  ASSERT_EQ(0, io.num_in_flight());
+}
+
+// Test that failed requests are reported to their callbacks and to
+// SubmitAndWait().
+TEST_F(AsyncIoTest, TestFailure) {
+  AsyncIo io(2);
+  Status ok_status;
+  Status failed_status;
+  vector<AsyncIo::Request> requests = {
+    AsyncIo::Request::Custom(Bind(&Status::OK), Bind(&RecordStatus, &ok_status)),
+    AsyncIo::Request::Custom(Bind(&FailRequest), Bind(&RecordStatus, &failed_status))
+  };
+  Status s = io.SubmitAndWait(requests);
+  ASSERT_TRUE(s.IsIOError()) << s.ToString();
+  ASSERT_OK(ok_status);
+  ASSERT_TRUE(failed_status.IsIOError()) << failed_status.ToString();
+}
+
+} // namespace kudu
@@ -0,0 +1,154 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/async_io.h"
+
+#include <mutex>
+
+#include <boost/bind.hpp>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/bind.h"
+#include "kudu/gutil/once.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/env.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/threadpool.h"
+
+DEFINE_int32(async_io_queue_depth, 32,
+             "Maximum number of asynchronous file I/O requests in flight at "
+             "once. Fast devices such as NVMe SSDs need 32 or more outstanding "
+             "requests to reach their full bandwidth. The requests are run by "
+             "as many threads, which spend most of their time waiting on I/O.");
+TAG_FLAG(async_io_queue_depth, advanced);
+
+using std::vector;
+
+namespace kudu {
+
+namespace {
+
+GoogleOnceType g_default_once;
+AsyncIo* g_default;
+
+void InitDefault() {
+  // The instance lives as long as the process.
+  g_default = new AsyncIo(FLAGS_async_io_queue_depth);
+}
+
+Status DoRead(const RandomAccessFile* file, uint64_t offset, size_t length,
+              uint8_t* scratch, Slice* result) {
+  return file->Read(offset, length, result, scratch);
+}
+
+Status DoWrite(RWFile* file, uint64_t offset, Slice data) {
+  return file->Write(offset, data);
+}
+
+// Tracks the requests of a SubmitAndWait() call.
+struct WaitState {
+  explicit WaitState(int num_requests)
+    : latch(num_requests) {
+  }
+
+  CountDownLatch latch;
+
+  simple_spinlock lock;
+  Status first_error;
+};
+
+void RequestDone(WaitState* state, StatusCallback done, const Status& s) {
+  done.Run(s);
+  if (!s.ok()) {
+    std::lock_guard<simple_spinlock> l(state->lock);
+    if (state->first_error.ok()) {
+      state->first_error = s;
+    }
+  }
+  state->latch.CountDown();
+}
+
+} // anonymous namespace
+
+AsyncIo::Request AsyncIo::Request::Read(const RandomAccessFile* file, uint64_t offset,
+                                        size_t length, uint8_t* scratch, Slice* result,
+                                        const StatusCallback& done) {
+  return { Bind(&DoRead, Unretained(file), offset, length,
+                Unretained(scratch), Unretained(result)), done };
+}
+
+AsyncIo::Request AsyncIo::Request::Write(RWFile* file, uint64_t offset, const Slice& data,
+                                         const StatusCallback& done) {
+  return { Bind(&DoWrite, Unretained(file), offset, data), done };
+}
+
+AsyncIo::Request AsyncIo::Request::Custom(const StatusClosure& op,
+                                          const StatusCallback& done) {
+  return { op, done };
+}
+
+AsyncIo* AsyncIo::Default() {
+  GoogleOnceInit(&g_default_once, &InitDefault);
+  return g_default;
+}
+
+AsyncIo::AsyncIo(int queue_depth)
+  : num_in_flight_(0) {
+  CHECK_GT(queue_depth, 0);
+  CHECK_OK(ThreadPoolBuilder("async-io")
+           .set_max_threads(queue_depth)
+           .Build(&pool_));
+}
+
+AsyncIo::~AsyncIo() {
+  pool_->Wait();
+  pool_->Shutdown();
+}
+
+void AsyncIo::Submit(const vector<Request>& requests) {
+  num_in_flight_.IncrementBy(requests.size());
+  for (const Request& request : requests) {
+    Status s = pool_->SubmitFunc(boost::bind(&AsyncIo::Run, this, request));
+    if (PREDICT_FALSE(!s.ok())) {
+      num_in_flight_.IncrementBy(-1);
+      request.done.Run(s.CloneAndPrepend("Unable to submit I/O request"));
+    }
+  }
+}
+
+Status AsyncIo::SubmitAndWait(const vector<Request>& requests) {
+  WaitState state(requests.size());
+  vector<Request> waited;
+  waited.reserve(requests.size());
+  for (const Request& request : requests) {
+    waited.push_back({ request.op, Bind(&RequestDone, Unretained(&state), request.done) });
+  }
+  Submit(waited);
+  state.latch.Wait();
+  std::lock_guard<simple_spinlock> l(state.lock);
+  return state.first_error;
+}
+
+void AsyncIo::Run(const Request& request) {
+  Status s = request.op.Run();
+  num_in_flight_.IncrementBy(-1);
+  request.done.Run(s);
+}
+
+} // namespace kudu
@@ -0,0 +1,102 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_UTIL_ASYNC_IO_H
+#define KUDU_UTIL_ASYNC_IO_H
+
+#include <cstdint>
+#include <vector>
+
+#include "kudu/gutil/callback.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+#include "kudu/util/status_callback.h"
+
+namespace kudu {
+
+class RandomAccessFile;
+class RWFile;
+class ThreadPool;
+
+// Performs blocking file I/O on behalf of its callers, so that a single
+// thread can keep many reads and writes in flight. Fast devices such as NVMe
+// SSDs only reach their full bandwidth with dozens of outstanding requests,
+// which threads issuing their own blocking reads rarely add up to.
+//
+// Requests are submitted in batches, run concurrently and complete in any
+// order, each by calling its callback on an I/O thread. The requests are run
+// by a pool of up to 'queue_depth' threads: that many requests may be in
+// flight at once, and the others wait for their turn.
+//
+// Thread-safe.
+class AsyncIo {
+ public:
+  // A request, run by calling 'op'. Once it returns, 'done' is called with
+  // its result. Neither may wait for other requests to complete.
+  struct Request {
+    // A read of 'length' bytes at 'offset' of 'file' into 'scratch',
+    // setting 'result' as RandomAccessFile::Read() does.
+    static Request Read(const RandomAccessFile* file, uint64_t offset, size_t length,
+                        uint8_t* scratch, Slice* result, const StatusCallback& done);
+
+    // A write of 'data' at 'offset' of 'file'. The memory of 'data' must be
+    // live until the request completes.
+    static Request Write(RWFile* file, uint64_t offset, const Slice& data,
+                         const StatusCallback& done);
+
+    // Any other blocking I/O, such as a read which also verifies its data.
+    static Request Custom(const StatusClosure& op, const StatusCallback& done);
+
+    StatusClosure op;
+    StatusCallback done;
+  };
+
+  // The instance shared by the whole process, with a queue depth of
+  // --async_io_queue_depth.
+  static AsyncIo* Default();
+
+  explicit AsyncIo(int queue_depth);
+
+  // Waits for the requests in flight to complete.
+  ~AsyncIo();
+
+  // Submits 'requests', which are run in the order they are submitted. A
+  // request which can't be run is completed with an error.
+  void Submit(const std::vector<Request>& requests);
+
+  // Submits 'requests' and waits for all of them to complete. Returns the
+  // first error any of them had.
+  Status SubmitAndWait(const std::vector<Request>& requests);
+
+  // The number of requests submitted but not completed yet.
+  int num_in_flight() const { return num_in_flight_.Load(); }
+
+ private:
+  // Runs 'request' on an I/O thread.
+  void Run(const Request& request);
+
+  gscoped_ptr<ThreadPool> pool_;
+
+  AtomicInt<int32_t> num_in_flight_;
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncIo);
+};
+
+} // namespace kudu
+#endif /* KUDU_UTIL_ASYNC_IO_H */
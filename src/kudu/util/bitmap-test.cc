@@ -20,6 +20,8 @@
 
 #include "kudu/gutil/strings/join.h"
 #include "kudu/util/bitmap.h"
+#include "kudu/util/random.h"
+#include "kudu/util/test_util.h"
 
 namespace kudu {
 
@@ -220,4 +222,46 @@ TEST(TestBitMap, TestBitmapIteration) {
   ASSERT_EQ(expected_sizes[i], size);
 }
 
+// The word-at-a-time operations must agree with bit-at-a-time ones for
+// every length, including those ending partway through a word.
+TEST(TestBitMap, TestWordOperations) {
+  const size_t kBytes = 40;
+  uint8_t a[kBytes];
+  uint8_t b[kBytes];
+  Random rng(SeedRandom());
+  for (size_t i = 0; i < kBytes; i++) {
+    a[i] = rng.Next() & 0xff;
+    b[i] = rng.Next() & 0xff;
+  }
+
+  for (size_t n_bits = 0; n_bits <= kBytes * 8; n_bits++) {
+    SCOPED_TRACE(n_bits);
+    size_t expected_count = 0;
+    std::vector<size_t> expected_set;
+    for (size_t i = 0; i < n_bits; i++) {
+      if (BitmapTest(a, i)) {
+        expected_count++;
+        expected_set.push_back(i);
+      }
+    }
+    ASSERT_EQ(expected_count, BitmapCount(a, n_bits));
+    std::vector<size_t> set;
+    BitmapForEachSetBit(a, n_bits, [&](size_t i) { set.push_back(i); });
+    ASSERT_EQ(expected_set, set);
+
+    uint8_t and_bm[kBytes], or_bm[kBytes], and_not_bm[kBytes];
+    memcpy(and_bm, a, kBytes);
+    memcpy(or_bm, a, kBytes);
+    memcpy(and_not_bm, a, kBytes);
+    BitmapMergeAnd(and_bm, b, n_bits);
+    BitmapMergeOr(or_bm, b, n_bits);
+    BitmapMergeAndNot(and_not_bm, b, n_bits);
+    for (size_t i = 0; i < n_bits; i++) {
+      ASSERT_EQ(BitmapTest(a, i) && BitmapTest(b, i), BitmapTest(and_bm, i));
+      ASSERT_EQ(BitmapTest(a, i) || BitmapTest(b, i), BitmapTest(or_bm, i));
+      ASSERT_EQ(BitmapTest(a, i) && !BitmapTest(b, i), BitmapTest(and_not_bm, i));
+    }
+  }
+}
+
 } // namespace kudu
@@ -92,6 +92,12 @@ bool BitmapFindFirst(const uint8_t *bitmap, size_t offset, size_t bitmap_size,
     num_bits -= 64;
     u64++;
   }
+  if (num_bits >= 64) {
+    // The word has a 'value' bit: find the lowest one.
+    uint64_t word = value ? *u64 : ~*u64;
+    *idx = (((const uint8_t *)u64 - bitmap) << 3) + Bits::FindLSBSetNonZero64(word);
+    return true;
+  }
 
   // check 8bit at the time for a 'value' bit
   p = (const uint8_t *)u64;
@@ -112,6 +118,23 @@ bool BitmapFindFirst(const uint8_t *bitmap, size_t offset, size_t bitmap_size,
   return false;
 }
 
+size_t BitmapCount(const uint8_t *bitmap, size_t n_bits) {
+  size_t n_words = n_bits / 64;
+  size_t count = 0;
+  for (size_t i = 0; i < n_words; i++) {
+    uint64_t word;
+    memcpy(&word, bitmap + i * 8, 8);
+    count += __builtin_popcountll(word);
+  }
+  size_t tail_bits = n_bits - n_words * 64;
+  if (tail_bits > 0) {
+    uint64_t word = bitmap_internal::BitmapLoadWord(bitmap, n_words * 8, BitmapSize(n_bits));
+    word &= (1ULL << tail_bits) - 1;
+    count += __builtin_popcountll(word);
+  }
+  return count;
+}
+
 std::string BitmapToString(const uint8_t *bitmap, size_t num_bits) {
   std::string s;
   size_t index = 0;
@@ -19,6 +19,8 @@
 #ifndef KUDU_UTIL_BITMAP_H
 #define KUDU_UTIL_BITMAP_H
 
+#include <algorithm>
+#include <cstring>
 #include <string>
 #include "kudu/gutil/bits.h"
 
@@ -49,12 +51,76 @@ inline bool BitmapTest(const uint8_t *bitmap, size_t idx) {
   return bitmap[idx >> 3] & (1 << (idx & 7));
 }
 
+namespace bitmap_internal {
+
+// Combines 'src' into 'dst' a 64-bit word at a time, which the compiler
+// vectorizes, then byte by byte for the tail of the last partial word.
+template<class Op>
+inline void BitmapMerge(uint8_t *dst, const uint8_t *src, size_t n_bits, Op op) {
+  size_t n_bytes = BitmapSize(n_bits);
+  size_t n_words = n_bytes / 8;
+  for (size_t i = 0; i < n_words; i++) {
+    uint64_t d, s;
+    memcpy(&d, dst + i * 8, 8);
+    memcpy(&s, src + i * 8, 8);
+    d = op(d, s);
+    memcpy(dst + i * 8, &d, 8);
+  }
+  for (size_t i = n_words * 8; i < n_bytes; i++) {
+    dst[i] = op(dst[i], src[i]);
+  }
+}
+
+// Loads the 64 bits of the bitmap starting at byte 'byte_idx', zero-filled
+// past 'n_bytes'. Bit i of the result is bit (byte_idx * 8 + i) of the bitmap.
+inline uint64_t BitmapLoadWord(const uint8_t *bitmap, size_t byte_idx, size_t n_bytes) {
+  uint64_t word = 0;
+  memcpy(&word, bitmap + byte_idx, std::min<size_t>(8, n_bytes - byte_idx));
+  return word;
+}
+
+} // namespace bitmap_internal
+
 // Merge the two bitmaps using bitwise or. Both bitmaps should have at least
 // n_bits valid bits.
 inline void BitmapMergeOr(uint8_t *dst, const uint8_t *src, size_t n_bits) {
+  bitmap_internal::BitmapMerge(dst, src, n_bits,
+                               [](uint64_t d, uint64_t s) { return d | s; });
+}
+
+// Merge the two bitmaps using bitwise and. Both bitmaps should have at least
+// n_bits valid bits.
+inline void BitmapMergeAnd(uint8_t *dst, const uint8_t *src, size_t n_bits) {
+  bitmap_internal::BitmapMerge(dst, src, n_bits,
+                               [](uint64_t d, uint64_t s) { return d & s; });
+}
+
+// Clear the bits of 'dst' which are set in 'src'. Both bitmaps should have
+// at least n_bits valid bits.
+inline void BitmapMergeAndNot(uint8_t *dst, const uint8_t *src, size_t n_bits) {
+  bitmap_internal::BitmapMerge(dst, src, n_bits,
+                               [](uint64_t d, uint64_t s) { return d & ~s; });
+}
+
+// Return the number of set bits among the first n_bits bits of the bitmap.
+size_t BitmapCount(const uint8_t *bitmap, size_t n_bits);
+
+// Call 'f' with the index of each set bit among the first n_bits bits of
+// the bitmap, in increasing order. The bitmap is read a word at a time, so
+// 'f' may set or clear bits of the word it's called for.
+template<class F>
+inline void BitmapForEachSetBit(const uint8_t *bitmap, size_t n_bits, const F& f) {
   size_t n_bytes = BitmapSize(n_bits);
-  for (size_t i = 0; i < n_bytes; i++) {
-    *dst++ |= *src++;
+  for (size_t byte_idx = 0; byte_idx < n_bytes; byte_idx += 8) {
+    uint64_t word = bitmap_internal::BitmapLoadWord(bitmap, byte_idx, n_bytes);
+    size_t word_bits = n_bits - byte_idx * 8;
+    if (word_bits < 64) {
+      word &= (1ULL << word_bits) - 1;
+    }
+    while (word != 0) {
+      f(byte_idx * 8 + Bits::FindLSBSetNonZero64(word));
+      word &= word - 1;
+    }
   }
 }
 
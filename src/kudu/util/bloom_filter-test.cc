@@ -18,8 +18,15 @@
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <stdlib.h>
+
+#include <thread>
+#include <vector>
+
 #include "kudu/util/bloom_filter.h"
 
+using std::thread;
+using std::vector;
+
 namespace kudu {
 
 static const int kRandomSeed = 0xdeadbeef;
@@ -84,4 +91,88 @@ TEST(TestBloomFilter, TestInsertAndProbe) {
   ASSERT_NEAR(fp_rate, expected_fp_rate, 0.20*expected_fp_rate);
 }
 
+TEST(TestBloomFilter, TestBlockedInsertAndProbe) {
+  int n_keys = 2000;
+  BloomFilterBuilder bfb(
+    BloomFilterSizing::ByCountAndFPRate(n_keys, 0.01, BLOCKED_BLOOM_LAYOUT));
+  ASSERT_EQ(BLOCKED_BLOOM_LAYOUT, bfb.layout());
+  ASSERT_EQ(0, bfb.n_bytes() % BloomFilter::kBlockedLineBytes);
+
+  // The sizing should have grown the filter until the estimate meets the
+  // target, using more bits per key than the classic layout.
+  double expected_fp_rate = bfb.false_positive_rate();
+  ASSERT_LE(expected_fp_rate, 0.01);
+  ASSERT_GT(bfb.n_bits() / n_keys, 9);
+
+  AddRandomKeys(kRandomSeed, n_keys, &bfb);
+
+  BloomFilter bf(bfb.slice(), bfb.n_hashes(), BLOCKED_BLOOM_LAYOUT);
+  CheckRandomKeys(kRandomSeed, n_keys, bf);
+
+  uint32_t num_queries = 100000;
+  uint32_t num_positives = 0;
+  for (int i = 0; i < num_queries; i++) {
+    uint64_t key = random();
+    Slice key_slice(reinterpret_cast<const uint8_t *>(&key), sizeof(key));
+    BloomKeyProbe probe(key_slice);
+    if (bf.MayContainKey(probe)) {
+      num_positives++;
+    }
+  }
+
+  double fp_rate = static_cast<double>(num_positives) / static_cast<double>(num_queries);
+  LOG(INFO) << "FP rate: " << fp_rate << " (" << num_positives << "/" << num_queries << ")";
+  LOG(INFO) << "Expected FP rate: " << expected_fp_rate;
+  ASSERT_NEAR(fp_rate, expected_fp_rate, 0.20*expected_fp_rate);
+}
+
+// Keys added from several threads at once are all found.
+TEST(TestBloomFilter, TestConcurrentInsertAndProbe) {
+  const int kNumThreads = 4;
+  const int kKeysPerThread = 2000;
+  ConcurrentBloomFilter bf(
+      BloomFilterSizing::ByCountAndFPRate(kNumThreads * kKeysPerThread, 0.01,
+                                          BLOCKED_BLOOM_LAYOUT).n_bytes());
+  ASSERT_EQ(0, bf.n_bytes() % BloomFilter::kBlockedLineBytes);
+
+  vector<thread> threads;
+  for (int t = 0; t < kNumThreads; t++) {
+    threads.emplace_back([&, t]() {
+      for (uint64_t key = t; key < kNumThreads * kKeysPerThread; key += kNumThreads) {
+        bf.AddKey(BloomKeyProbe(Slice(reinterpret_cast<const uint8_t*>(&key), sizeof(key))));
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  for (uint64_t key = 0; key < kNumThreads * kKeysPerThread; key++) {
+    ASSERT_TRUE(bf.MayContainKey(
+        BloomKeyProbe(Slice(reinterpret_cast<const uint8_t*>(&key), sizeof(key)))));
+  }
+  int num_positives = 0;
+  const int kNumQueries = 10000;
+  for (uint64_t key = 1000000; key < 1000000 + kNumQueries; key++) {
+    if (bf.MayContainKey(
+            BloomKeyProbe(Slice(reinterpret_cast<const uint8_t*>(&key), sizeof(key))))) {
+      num_positives++;
+    }
+  }
+  ASSERT_LT(num_positives, kNumQueries * 0.02);
+}
+
+TEST(TestBloomFilter, TestBlockedSizingBySize) {
+  BloomFilterSizing classic = BloomFilterSizing::BySizeAndFPRate(4096, 0.0001);
+  BloomFilterSizing blocked = BloomFilterSizing::BySizeAndFPRate(4096, 0.0001,
+                                                                 BLOCKED_BLOOM_LAYOUT);
+  ASSERT_EQ(4096, blocked.n_bytes());
+  // The blocked layout fits fewer keys into the same space at the same rate.
+  ASSERT_LT(blocked.expected_count(), classic.expected_count());
+
+  BloomFilterBuilder bfb(blocked);
+  AddRandomKeys(kRandomSeed, blocked.expected_count(), &bfb);
+  ASSERT_LE(bfb.false_positive_rate(), 0.0001);
+}
+
 } // namespace kudu
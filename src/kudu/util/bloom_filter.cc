@@ -17,6 +17,8 @@
 
 #include <math.h>
 
+#include <algorithm>
+
 #include "kudu/util/bloom_filter.h"
 #include "kudu/util/bitmap.h"
 
@@ -24,14 +26,41 @@ namespace kudu {
 
 static double kNaturalLog2 = 0.69314;
 
+const size_t BloomFilter::kBlockedLineBytes;
+const size_t BloomFilter::kBlockedHashes;
+
 static int ComputeOptimalHashCount(size_t n_bits, size_t elems) {
   int n_hashes = n_bits * kNaturalLog2 / elems;
   if (n_hashes < 1) n_hashes = 1;
   return n_hashes;
 }
 
+// Estimate the false positive rate of a blocked bloom filter with 'n_lines'
+// lines after 'n_keys' insertions.
+//
+// The number of keys landing in a given line is approximately Poisson
+// distributed; a key in a line with L keys is a false positive if each of
+// its lane bits was set by one of the other L keys.
+static double BlockedFalsePositiveRate(size_t n_lines, size_t n_keys) {
+  const int kLaneBits = 64;
+  double lambda = static_cast<double>(n_keys) / n_lines;
+  int max_load = static_cast<int>(lambda + 10 * sqrt(lambda) + 10);
+  double p_load = exp(-lambda);
+  double fp_rate = 0;
+  for (int load = 0; load <= max_load; load++) {
+    if (load > 0) {
+      p_load *= lambda / load;
+    }
+    double p_bit_set = 1 - pow(1 - 1.0 / kLaneBits, load);
+    fp_rate += p_load * pow(p_bit_set, BloomFilter::kBlockedHashes);
+  }
+  return fp_rate;
+}
+
+static const size_t kBitsPerLine = BloomFilter::kBlockedLineBytes * 8;
+
 BloomFilterSizing BloomFilterSizing::ByCountAndFPRate(
-  size_t expected_count, double fp_rate) {
+  size_t expected_count, double fp_rate, BloomFilterLayout layout) {
   CHECK_GT(fp_rate, 0);
   CHECK_LT(fp_rate, 1);
 
@@ -41,24 +70,60 @@ BloomFilterSizing BloomFilterSizing::ByCountAndFPRate(
   CHECK_GT(n_bytes, 0)
     << "expected_count: " << expected_count
     << " fp_rate: " << fp_rate;
-  return BloomFilterSizing(n_bytes, expected_count);
+
+  if (layout == BLOCKED_BLOOM_LAYOUT) {
+    // Start from the classic size and grow until the blocked estimate
+    // meets the target. The blocked layout needs 20-50% more bits for
+    // typical rates, so this takes few iterations.
+    size_t n_lines = std::max<size_t>(1, (n_bits + kBitsPerLine - 1) / kBitsPerLine);
+    while (BlockedFalsePositiveRate(n_lines, expected_count) > fp_rate) {
+      n_lines += std::max<size_t>(1, n_lines / 32);
+    }
+    n_bytes = n_lines * BloomFilter::kBlockedLineBytes;
+  }
+  return BloomFilterSizing(n_bytes, expected_count, layout);
 }
 
-BloomFilterSizing BloomFilterSizing::BySizeAndFPRate(size_t n_bytes, double fp_rate) {
+BloomFilterSizing BloomFilterSizing::BySizeAndFPRate(size_t n_bytes, double fp_rate,
+                                                     BloomFilterLayout layout) {
   size_t n_bits = n_bytes * 8;
   double expected_elems = -static_cast<double>(n_bits) * kNaturalLog2 * kNaturalLog2 /
     log(fp_rate);
   DCHECK_GT(expected_elems, 1);
-  return BloomFilterSizing(n_bytes, (size_t)ceil(expected_elems));
-}
 
+  if (layout == BLOCKED_BLOOM_LAYOUT) {
+    // Round down to whole lines, then find the largest count which still
+    // meets the target rate.
+    size_t n_lines = std::max<size_t>(1, n_bits / kBitsPerLine);
+    n_bytes = n_lines * BloomFilter::kBlockedLineBytes;
+    size_t lo = 1;
+    size_t hi = static_cast<size_t>(ceil(expected_elems));
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo + 1) / 2;
+      if (BlockedFalsePositiveRate(n_lines, mid) <= fp_rate) {
+        lo = mid;
+      } else {
+        hi = mid - 1;
+      }
+    }
+    return BloomFilterSizing(n_bytes, lo, layout);
+  }
+  return BloomFilterSizing(n_bytes, (size_t)ceil(expected_elems), layout);
+}
 
 BloomFilterBuilder::BloomFilterBuilder(const BloomFilterSizing &sizing)
-  : n_bits_(sizing.n_bytes() * 8),
+  : layout_(sizing.layout()),
+    n_bits_(sizing.n_bytes() * 8),
     bitmap_(new uint8_t[sizing.n_bytes()]),
-    n_hashes_(ComputeOptimalHashCount(n_bits_, sizing.expected_count())),
+    n_hashes_(layout_ == BLOCKED_BLOOM_LAYOUT ?
+              BloomFilter::kBlockedHashes :
+              ComputeOptimalHashCount(n_bits_, sizing.expected_count())),
     expected_count_(sizing.expected_count()),
     n_inserted_(0) {
+  if (layout_ == BLOCKED_BLOOM_LAYOUT) {
+    CHECK_EQ(0, sizing.n_bytes() % BloomFilter::kBlockedLineBytes)
+        << "blocked bloom filters must be a whole number of lines";
+  }
   Clear();
 }
 
@@ -72,15 +137,31 @@ double BloomFilterBuilder::false_positive_rate() const {
     << "expected_count_ not initialized: can't call this function on "
     << "a BloomFilter initialized from external data";
 
+  if (layout_ == BLOCKED_BLOOM_LAYOUT) {
+    return BlockedFalsePositiveRate(n_bits_ / kBitsPerLine, expected_count_);
+  }
   return pow(1 - exp(-static_cast<double>(n_hashes_) * expected_count_ / n_bits_), n_hashes_);
 }
 
-BloomFilter::BloomFilter(const Slice &data, size_t n_hashes)
-  : n_bits_(data.size() * 8),
+BloomFilter::BloomFilter(const Slice &data, size_t n_hashes, BloomFilterLayout layout)
+  : layout_(layout),
+    n_bits_(data.size() * 8),
     bitmap_(reinterpret_cast<const uint8_t *>(data.data())),
     n_hashes_(n_hashes)
 {}
 
+const size_t ConcurrentBloomFilter::kLanesPerLine;
+
+ConcurrentBloomFilter::ConcurrentBloomFilter(size_t n_bytes)
+  : n_lines_(std::max<size_t>(1, (n_bytes + BloomFilter::kBlockedLineBytes - 1) /
+                                 BloomFilter::kBlockedLineBytes)),
+    lanes_(new std::atomic<uint64_t>[n_lines_ * kLanesPerLine]) {
+  static_assert(kLanesPerLine == BloomFilter::kBlockedHashes,
+                "a key sets one bit per lane");
+  for (size_t i = 0; i < n_lines_ * kLanesPerLine; i++) {
+    lanes_[i].store(0, std::memory_order_relaxed);
+  }
+}
 
 
 } // namespace kudu
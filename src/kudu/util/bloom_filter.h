@@ -17,6 +17,15 @@
 #ifndef KUDU_UTIL_BLOOM_FILTER_H
 #define KUDU_UTIL_BLOOM_FILTER_H
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <string.h>
+
+#include <atomic>
+#include <memory>
+
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/hash/city.h"
 #include "kudu/gutil/macros.h"
@@ -25,6 +34,23 @@
 
 namespace kudu {
 
+// The way in which a bloom filter maps a key to bit positions.
+enum BloomFilterLayout {
+  // Each of the k hashes picks a bit anywhere in the filter, so a probe
+  // touches up to k cache lines.
+  CLASSIC_BLOOM_LAYOUT,
+
+  // All bits for a key fall into a single 64-byte cache line (a "blocked"
+  // or "split block" bloom filter). The line is treated as eight 64-bit
+  // lanes and each key sets exactly one bit in every lane, so a probe costs
+  // one cache miss and a handful of independent ALU operations.
+  //
+  // For the same number of bits per key the false positive rate is
+  // somewhat higher than the classic layout; BloomFilterSizing accounts for
+  // this when asked to size a blocked filter.
+  BLOCKED_BLOOM_LAYOUT
+};
+
 // Probe calculated from a given key. This caches the calculated
 // hash values which are necessary for probing into a Bloom Filter,
 // so that when many bloom filters have to be consulted for a given
@@ -73,6 +99,11 @@ class BloomKeyProbe {
     return h + h_2_;
   }
 
+  // The second hash value, used directly by the blocked layout.
+  uint32_t second_hash() const {
+    return h_2_;
+  }
+
  private:
   Slice key_;
 
@@ -89,24 +120,29 @@ class BloomFilterSizing {
   // Size the bloom filter by a fixed size and false positive rate.
   //
   // Picks the number of entries to achieve the above.
-  static BloomFilterSizing BySizeAndFPRate(size_t n_bytes, double fp_rate);
+  static BloomFilterSizing BySizeAndFPRate(size_t n_bytes, double fp_rate,
+                                           BloomFilterLayout layout = CLASSIC_BLOOM_LAYOUT);
 
   // Size the bloom filer by an expected count and false positive rate.
   //
   // Picks the number of bytes to achieve the above.
-  static BloomFilterSizing ByCountAndFPRate(size_t expected_count, double fp_rate);
+  static BloomFilterSizing ByCountAndFPRate(size_t expected_count, double fp_rate,
+                                            BloomFilterLayout layout = CLASSIC_BLOOM_LAYOUT);
 
   size_t n_bytes() const { return n_bytes_; }
   size_t expected_count() const { return expected_count_; }
+  BloomFilterLayout layout() const { return layout_; }
 
  private:
-  BloomFilterSizing(size_t n_bytes, size_t expected_count) :
+  BloomFilterSizing(size_t n_bytes, size_t expected_count, BloomFilterLayout layout) :
     n_bytes_(n_bytes),
-    expected_count_(expected_count)
+    expected_count_(expected_count),
+    layout_(layout)
   {}
 
   size_t n_bytes_;
   size_t expected_count_;
+  BloomFilterLayout layout_;
 };
 
 
@@ -114,7 +150,8 @@ class BloomFilterSizing {
 class BloomFilterBuilder {
  public:
   // Create a bloom filter.
-  // See BloomFilterSizing static methods to specify this argument.
+  // See BloomFilterSizing static methods to specify this argument. The
+  // filter's layout is taken from 'sizing'.
   explicit BloomFilterBuilder(const BloomFilterSizing &sizing);
 
   // Clear all entries, reset insertion count.
@@ -144,6 +181,8 @@ class BloomFilterBuilder {
   // in the bloom filter.
   size_t n_hashes() const { return n_hashes_; }
 
+  BloomFilterLayout layout() const { return layout_; }
+
   size_t expected_count() const { return expected_count_; }
 
   // Return the number of keys inserted.
@@ -152,6 +191,8 @@ class BloomFilterBuilder {
  private:
   DISALLOW_COPY_AND_ASSIGN(BloomFilterBuilder);
 
+  BloomFilterLayout layout_;
+
   size_t n_bits_;
   gscoped_array<uint8_t> bitmap_;
 
@@ -169,15 +210,52 @@ class BloomFilterBuilder {
 // Wrapper around a byte array for reading it as a bloom filter.
 class BloomFilter {
  public:
-  BloomFilter(const Slice &data, size_t n_hashes);
+  // 'n_hashes' is ignored for the blocked layout.
+  BloomFilter(const Slice &data, size_t n_hashes,
+              BloomFilterLayout layout = CLASSIC_BLOOM_LAYOUT);
 
   // Return true if the filter may contain the given key.
   bool MayContainKey(const BloomKeyProbe &probe) const;
 
+  // Issue a prefetch for the part of the bitmap which MayContainKey(probe)
+  // will read first. Used when checking a batch of keys against the same
+  // filter to overlap the cache miss for the next key with the current one.
+  void Prefetch(const BloomKeyProbe &probe) const;
+
+  // Return the bitmap which the filter wraps.
+  Slice data() const {
+    return Slice(bitmap_, n_bits_ / 8);
+  }
+
+  size_t n_hashes() const { return n_hashes_; }
+
+  BloomFilterLayout layout() const { return layout_; }
+
+  // Size of a single line of a blocked bloom filter.
+  static const size_t kBlockedLineBytes = 64;
+
+  // Number of bits set per key in a blocked bloom filter: one per 64-bit
+  // lane of the line.
+  static const size_t kBlockedHashes = 8;
+
  private:
   friend class BloomFilterBuilder;
+  friend class ConcurrentBloomFilter;
   static uint32_t PickBit(uint32_t hash, size_t n_bits);
 
+  // Return the index of the line of a blocked filter with 'n_lines' lines
+  // to which 'hash' maps.
+  static size_t PickLine(uint32_t hash, size_t n_lines);
+
+  // Return the bit within lane 'lane' of a blocked filter's line which a
+  // key with second hash 'hash' sets.
+  static uint32_t PickLaneBit(uint32_t hash, int lane);
+
+  bool MayContainKeyClassic(const BloomKeyProbe &probe) const;
+  bool MayContainKeyBlocked(const BloomKeyProbe &probe) const;
+
+  BloomFilterLayout layout_;
+
   size_t n_bits_;
   const uint8_t *bitmap_;
 
@@ -185,6 +263,36 @@ class BloomFilter {
 };
 
 
+// An in-memory bloom filter with the blocked layout, to which keys may be
+// added while other threads probe it, without locking.
+//
+// The bits are set and read with relaxed atomics: a probe is only
+// guaranteed to see the keys added before it if something else, such as a
+// lock, orders it after them.
+class ConcurrentBloomFilter {
+ public:
+  // Create an empty filter of 'n_bytes', rounded up to a whole line.
+  explicit ConcurrentBloomFilter(size_t n_bytes);
+
+  // Add the given key to the filter.
+  void AddKey(const BloomKeyProbe &probe);
+
+  // Return true if the filter may contain the given key.
+  bool MayContainKey(const BloomKeyProbe &probe) const;
+
+  size_t n_bytes() const {
+    return n_lines_ * BloomFilter::kBlockedLineBytes;
+  }
+
+ private:
+  static const size_t kLanesPerLine = BloomFilter::kBlockedLineBytes / sizeof(uint64_t);
+
+  const size_t n_lines_;
+  std::unique_ptr<std::atomic<uint64_t>[]> lanes_;
+
+  DISALLOW_COPY_AND_ASSIGN(ConcurrentBloomFilter);
+};
+
 ////////////////////////////////////////////////////////////
 // Inline implementations
 ////////////////////////////////////////////////////////////
@@ -201,7 +309,39 @@ inline uint32_t BloomFilter::PickBit(uint32_t hash, size_t n_bits) {
   }
 }
 
+// Odd multipliers used to derive one bit position per lane of a blocked
+// bloom filter line from a single 32-bit hash.
+static const uint32_t kBlockedBloomSalts[BloomFilter::kBlockedHashes] = {
+  0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+  0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+inline size_t BloomFilter::PickLine(uint32_t hash, size_t n_lines) {
+  // Multiply-shift maps the hash uniformly onto [0, n_lines) without a
+  // division.
+  return (static_cast<uint64_t>(hash) * n_lines) >> 32;
+}
+
+inline uint32_t BloomFilter::PickLaneBit(uint32_t hash, int lane) {
+  // The top 6 bits of the product select one of the lane's 64 bits.
+  return (hash * kBlockedBloomSalts[lane]) >> 26;
+}
+
 inline void BloomFilterBuilder::AddKey(const BloomKeyProbe &probe) {
+  if (layout_ == BLOCKED_BLOOM_LAYOUT) {
+    size_t n_lines = n_bits_ / (BloomFilter::kBlockedLineBytes * 8);
+    uint8_t* line = &bitmap_[BloomFilter::PickLine(probe.initial_hash(), n_lines) *
+                             BloomFilter::kBlockedLineBytes];
+    for (int i = 0; i < BloomFilter::kBlockedHashes; i++) {
+      uint64_t lane;
+      memcpy(&lane, line + i * sizeof(lane), sizeof(lane));
+      lane |= 1ULL << BloomFilter::PickLaneBit(probe.second_hash(), i);
+      memcpy(line + i * sizeof(lane), &lane, sizeof(lane));
+    }
+    n_inserted_++;
+    return;
+  }
+
   uint32_t h = probe.initial_hash();
   for (size_t i = 0; i < n_hashes_; i++) {
     uint32_t bitpos = BloomFilter::PickBit(h, n_bits_);
@@ -212,6 +352,79 @@ inline void BloomFilterBuilder::AddKey(const BloomKeyProbe &probe) {
 }
 
 inline bool BloomFilter::MayContainKey(const BloomKeyProbe &probe) const {
+  if (layout_ == BLOCKED_BLOOM_LAYOUT) {
+    return MayContainKeyBlocked(probe);
+  }
+  return MayContainKeyClassic(probe);
+}
+
+inline void BloomFilter::Prefetch(const BloomKeyProbe &probe) const {
+  const uint8_t* addr;
+  if (layout_ == BLOCKED_BLOOM_LAYOUT) {
+    size_t n_lines = n_bits_ / (kBlockedLineBytes * 8);
+    addr = bitmap_ + PickLine(probe.initial_hash(), n_lines) * kBlockedLineBytes;
+  } else {
+    addr = bitmap_ + PickBit(probe.initial_hash(), n_bits_) / 8;
+  }
+  __builtin_prefetch(addr, 0 /* read */, 3 /* high temporal locality */);
+}
+
+inline bool BloomFilter::MayContainKeyBlocked(const BloomKeyProbe &probe) const {
+  size_t n_lines = n_bits_ / (kBlockedLineBytes * 8);
+  const uint8_t* line = bitmap_ + PickLine(probe.initial_hash(), n_lines) * kBlockedLineBytes;
+
+#ifdef __AVX2__
+  // Compute all eight bit positions at once, widen them to 64-bit lanes,
+  // and check that every selected bit is set in the line.
+  const __m256i salts = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i*>(kBlockedBloomSalts));
+  __m256i shifts = _mm256_srli_epi32(
+      _mm256_mullo_epi32(_mm256_set1_epi32(probe.second_hash()), salts), 26);
+  const __m256i ones = _mm256_set1_epi64x(1);
+  __m256i mask_lo = _mm256_sllv_epi64(
+      ones, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(shifts)));
+  __m256i mask_hi = _mm256_sllv_epi64(
+      ones, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(shifts, 1)));
+  __m256i data_lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(line));
+  __m256i data_hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(line + 32));
+  return _mm256_testc_si256(data_lo, mask_lo) && _mm256_testc_si256(data_hi, mask_hi);
+#else
+  // Branch-free so that the eight lane checks can issue in parallel.
+  uint64_t missing = 0;
+  for (int i = 0; i < kBlockedHashes; i++) {
+    uint64_t lane;
+    memcpy(&lane, line + i * sizeof(lane), sizeof(lane));
+    missing |= ~lane & (1ULL << PickLaneBit(probe.second_hash(), i));
+  }
+  return missing == 0;
+#endif
+}
+
+inline void ConcurrentBloomFilter::AddKey(const BloomKeyProbe &probe) {
+  std::atomic<uint64_t>* line =
+      &lanes_[BloomFilter::PickLine(probe.initial_hash(), n_lines_) * kLanesPerLine];
+  for (int i = 0; i < BloomFilter::kBlockedHashes; i++) {
+    uint64_t bit = 1ULL << BloomFilter::PickLaneBit(probe.second_hash(), i);
+    // Skip the write if the bit is already set, so that adding keys which
+    // are mostly present doesn't keep invalidating the line in other caches.
+    if ((line[i].load(std::memory_order_relaxed) & bit) == 0) {
+      line[i].fetch_or(bit, std::memory_order_relaxed);
+    }
+  }
+}
+
+inline bool ConcurrentBloomFilter::MayContainKey(const BloomKeyProbe &probe) const {
+  const std::atomic<uint64_t>* line =
+      &lanes_[BloomFilter::PickLine(probe.initial_hash(), n_lines_) * kLanesPerLine];
+  uint64_t missing = 0;
+  for (int i = 0; i < BloomFilter::kBlockedHashes; i++) {
+    missing |= ~line[i].load(std::memory_order_relaxed) &
+        (1ULL << BloomFilter::PickLaneBit(probe.second_hash(), i));
+  }
+  return missing == 0;
+}
+
+inline bool BloomFilter::MayContainKeyClassic(const BloomKeyProbe &probe) const {
   uint32_t h = probe.initial_hash();
 
   // Basic unrolling by 2s gives a small benefit here since the two bit positions
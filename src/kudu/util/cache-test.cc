@@ -5,7 +5,9 @@
 #include <glog/logging.h>
 #include <gflags/gflags.h>
 #include <gtest/gtest.h>
+#include <atomic>
 #include <memory>
+#include <thread>
 
 #include <vector>
 #include "kudu/util/cache.h"
@@ -15,9 +17,16 @@
 #include "kudu/util/test_util.h"
 
 #if defined(__linux__)
+DECLARE_bool(nvm_cache_persistent);
 DECLARE_string(nvm_cache_path);
 #endif // defined(__linux__)
 
+METRIC_DECLARE_counter(block_cache_probationary_segment_hits);
+METRIC_DECLARE_counter(block_cache_protected_segment_hits);
+METRIC_DECLARE_gauge_uint64(block_cache_usage);
+METRIC_DECLARE_gauge_uint64(block_cache_probationary_segment_usage);
+METRIC_DECLARE_gauge_uint64(block_cache_protected_segment_usage);
+
 namespace kudu {
 
 // Conversions between numeric keys/values and the types expected by Cache.
@@ -31,9 +40,8 @@ static int DecodeInt(const Slice& k) {
   return DecodeFixed32(k.data());
 }
 
-class CacheTest : public KuduTest,
-                  public ::testing::WithParamInterface<CacheType>,
-                  public Cache::EvictionCallback {
+class CacheBaseTest : public KuduTest,
+                      public Cache::EvictionCallback {
  public:
 
   // Implementation of the EvictionCallback interface
@@ -49,6 +57,41 @@ class CacheTest : public KuduTest,
 
   static const int kCacheSize = 14*1024*1024;
 
+  int Lookup(int key, Cache::CacheBehavior behavior = Cache::EXPECT_IN_CACHE) {
+    Cache::Handle* handle = cache_->Lookup(EncodeInt(key), behavior);
+    const int r = (handle == nullptr) ? -1 : DecodeInt(cache_->Value(handle));
+    if (handle != nullptr) {
+      cache_->Release(handle);
+    }
+    return r;
+  }
+
+  void Insert(int key, int value, int charge = 1,
+              Cache::Priority priority = Cache::NORMAL_PRIORITY) {
+    string key_str = EncodeInt(key);
+    string val_str = EncodeInt(value);
+    Cache::PendingHandle* handle = CHECK_NOTNULL(cache_->Allocate(key_str, val_str.size(), charge));
+    memcpy(cache_->MutableValue(handle), val_str.data(), val_str.size());
+
+    cache_->Release(cache_->Insert(handle, this, priority));
+  }
+
+  void Erase(int key) {
+    cache_->Erase(EncodeInt(key));
+  }
+
+ protected:
+  void SetUpMetrics() {
+    entity_ = METRIC_ENTITY_server.Instantiate(&metric_registry_, "test");
+    cache_->SetMetrics(entity_);
+  }
+
+  scoped_refptr<MetricEntity> entity_;
+};
+
+class CacheTest : public CacheBaseTest,
+                  public ::testing::WithParamInterface<CacheType> {
+ public:
   virtual void SetUp() OVERRIDE {
 
 #if defined(__linux__)
@@ -67,31 +110,7 @@ class CacheTest : public KuduTest,
       ASSERT_TRUE(mem_tracker_.get());
     }
 
-    scoped_refptr<MetricEntity> entity = METRIC_ENTITY_server.Instantiate(
-        &metric_registry_, "test");
-    cache_->SetMetrics(entity);
-  }
-
-  int Lookup(int key) {
-    Cache::Handle* handle = cache_->Lookup(EncodeInt(key), Cache::EXPECT_IN_CACHE);
-    const int r = (handle == nullptr) ? -1 : DecodeInt(cache_->Value(handle));
-    if (handle != nullptr) {
-      cache_->Release(handle);
-    }
-    return r;
-  }
-
-  void Insert(int key, int value, int charge = 1) {
-    string key_str = EncodeInt(key);
-    string val_str = EncodeInt(value);
-    Cache::PendingHandle* handle = CHECK_NOTNULL(cache_->Allocate(key_str, val_str.size(), charge));
-    memcpy(cache_->MutableValue(handle), val_str.data(), val_str.size());
-
-    cache_->Release(cache_->Insert(handle, this));
-  }
-
-  void Erase(int key) {
-    cache_->Erase(EncodeInt(key));
+    SetUpMetrics();
   }
 };
 
@@ -231,4 +250,225 @@ TEST_P(CacheTest, NewId) {
   ASSERT_NE(a, b);
 }
 
+class SLRUCacheTest : public CacheBaseTest {
+ public:
+  virtual void SetUp() OVERRIDE {
+    cache_.reset(NewSLRUCache(kCacheSize, 0.5, "slru_cache_test"));
+    SetUpMetrics();
+  }
+
+  // Insert more than the cache's capacity worth of entries, each of which is
+  // looked up exactly once, as a large scan would.
+  void Scan(int first_key) {
+    const int kNumElems = 2000;
+    const int kSizePerElem = kCacheSize / 1000;
+    for (int i = 0; i < kNumElems; i++) {
+      ASSERT_EQ(-1, Lookup(first_key + i));
+      Insert(first_key + i, i, kSizePerElem);
+    }
+  }
+
+  uint64_t GaugeValue(const GaugePrototype<uint64_t>& proto) {
+    return proto.Instantiate(entity_, 0)->value();
+  }
+};
+
+TEST_F(SLRUCacheTest, ScanResistance) {
+  // A key which has been read twice is protected...
+  Insert(100, 101);
+  ASSERT_EQ(101, Lookup(100));
+  // ...but one which was only read once isn't.
+  Insert(200, 201);
+
+  ASSERT_NO_FATAL_FAILURE(Scan(1000));
+
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(-1, Lookup(200));
+}
+
+TEST_F(SLRUCacheTest, HighPriorityInsert) {
+  Insert(100, 101, 1, Cache::HIGH_PRIORITY);
+  ASSERT_NO_FATAL_FAILURE(Scan(1000));
+  ASSERT_EQ(101, Lookup(100));
+}
+
+TEST_F(SLRUCacheTest, NonCachingLookupsDoNotPromote) {
+  Insert(100, 101);
+  ASSERT_EQ(101, Lookup(100, Cache::NO_EXPECT_IN_CACHE));
+  ASSERT_NO_FATAL_FAILURE(Scan(1000));
+  ASSERT_EQ(-1, Lookup(100));
+}
+
+TEST_F(SLRUCacheTest, ProtectedSegmentOverflows) {
+  // Promote far more than the protected segment can hold. The oldest
+  // protected entries are demoted rather than evicted, and the total stays
+  // within capacity.
+  const int kNumElems = 1000;
+  const int kSizePerElem = kCacheSize / 100;
+  for (int i = 0; i < kNumElems; i++) {
+    Insert(i, i, kSizePerElem);
+    ASSERT_EQ(i, Lookup(i));
+  }
+  ASSERT_EQ(kNumElems - 1, Lookup(kNumElems - 1));
+
+  uint64_t probationary = GaugeValue(METRIC_block_cache_probationary_segment_usage);
+  uint64_t protected_usage = GaugeValue(METRIC_block_cache_protected_segment_usage);
+  ASSERT_EQ(GaugeValue(METRIC_block_cache_usage), probationary + protected_usage);
+  ASSERT_LE(protected_usage, kCacheSize / 2 + kCacheSize / 10);
+  ASSERT_LE(probationary + protected_usage, kCacheSize + kCacheSize / 10);
+  ASSERT_GT(probationary, 0);
+}
+
+TEST_F(SLRUCacheTest, SegmentHitMetrics) {
+  Insert(100, 101);
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(1, METRIC_block_cache_probationary_segment_hits.Instantiate(entity_)->value());
+  ASSERT_EQ(1, METRIC_block_cache_protected_segment_hits.Instantiate(entity_)->value());
+}
+
+class ClockCacheTest : public CacheBaseTest {
+ public:
+  virtual void SetUp() OVERRIDE {
+    cache_.reset(NewClockCache(kCacheSize, "clock_cache_test"));
+    SetUpMetrics();
+  }
+};
+
+// Entries looked up since the clock hand last passed them get a second
+// chance, the others are evicted in the order they were inserted.
+TEST_F(ClockCacheTest, SecondChance) {
+  Insert(100, 101);
+  Insert(200, 201);
+
+  const int kNumElems = 1000;
+  const int kSizePerElem = kCacheSize / kNumElems;
+  for (int i = 0; i < kNumElems * 2; i++) {
+    Insert(1000 + i, 2000 + i, kSizePerElem);
+    ASSERT_EQ(101, Lookup(100));
+  }
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(-1, Lookup(200));
+  ASSERT_EQ(-1, Lookup(1000));
+  ASSERT_EQ(2000 + kNumElems * 2 - 1, Lookup(1000 + kNumElems * 2 - 1));
+  ASSERT_LE(METRIC_block_cache_usage.Instantiate(entity_, 0)->value(),
+            kCacheSize + kCacheSize / 10);
+}
+
+TEST_F(ClockCacheTest, EntriesArePinned) {
+  Insert(100, 101);
+  Cache::Handle* h = cache_->Lookup(EncodeInt(100), Cache::EXPECT_IN_CACHE);
+  Erase(100);
+  ASSERT_EQ(-1, Lookup(100));
+  ASSERT_EQ(0, evicted_keys_.size());
+  ASSERT_EQ(101, DecodeInt(cache_->Value(h)));
+  cache_->Release(h);
+  ASSERT_EQ(1, evicted_keys_.size());
+}
+
+// Lookups of the same hot entries from many threads share their shards.
+TEST_F(ClockCacheTest, ConcurrentLookups) {
+  const int kNumKeys = 16;
+  const int kNumThreads = 8;
+  const int kLookupsPerThread = AllowSlowTests() ? 1000000 : 10000;
+  for (int k = 0; k < kNumKeys; k++) {
+    Insert(k, k + 1000);
+  }
+  std::vector<std::thread> threads;
+  std::atomic<int> misses(0);
+  for (int t = 0; t < kNumThreads; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < kLookupsPerThread; i++) {
+        int k = (i + t) % kNumKeys;
+        if (Lookup(k) != k + 1000) {
+          misses++;
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(0, misses);
+  ASSERT_EQ(0, evicted_keys_.size());
+}
+
+#if defined(__linux__)
+class PersistentNvmCacheTest : public CacheBaseTest {
+ public:
+  virtual void SetUp() OVERRIDE {
+    FLAGS_nvm_cache_persistent = true;
+    FLAGS_nvm_cache_path = GetTestPath("nvm-cache");
+    ASSERT_OK(Env::Default()->CreateDir(FLAGS_nvm_cache_path));
+    Reopen();
+  }
+
+  // Destroys the cache, as a restart would, and opens it again.
+  void Reopen() {
+    cache_.reset();
+    cache_.reset(NewLRUCache(NVM_CACHE, kCacheSize, "persistent_cache_test"));
+    SetUpMetrics();
+  }
+
+  uint64_t Usage() {
+    return METRIC_block_cache_usage.Instantiate(entity_, 0)->value();
+  }
+};
+
+TEST_F(PersistentNvmCacheTest, EntriesSurviveReopening) {
+  const int kNumElems = 100;
+  for (int i = 0; i < kNumElems; i++) {
+    Insert(i, i + 1000);
+  }
+  Erase(0);
+  // An entry which was allocated but never inserted, as when a read fails or
+  // the server crashes before inserting it, isn't recovered.
+  Cache::PendingHandle* pending = cache_->Allocate(EncodeInt(kNumElems), 4, 1);
+  ASSERT_TRUE(pending != nullptr);
+  memcpy(cache_->MutableValue(pending), EncodeInt(1).data(), 4);
+  uint64_t usage = Usage();
+
+  Reopen();
+  ASSERT_EQ(-1, Lookup(0));
+  for (int i = 1; i < kNumElems; i++) {
+    ASSERT_EQ(i + 1000, Lookup(i));
+  }
+  ASSERT_EQ(-1, Lookup(kNumElems));
+  ASSERT_EQ(usage, Usage());
+
+  // The recovered cache is fully functional.
+  Insert(1, 2);
+  ASSERT_EQ(2, Lookup(1));
+  Reopen();
+  ASSERT_EQ(2, Lookup(1));
+}
+
+// The LRU order of the entries is that of their insertion after reopening.
+TEST_F(PersistentNvmCacheTest, EvictionOrderSurvivesReopening) {
+  const int kSizePerElem = kCacheSize / 100;
+  for (int i = 0; i < 50; i++) {
+    Insert(i, i, kSizePerElem);
+  }
+  Reopen();
+  for (int i = 50; i < 150; i++) {
+    Insert(i, i, kSizePerElem);
+  }
+  ASSERT_EQ(-1, Lookup(0));
+  ASSERT_EQ(149, Lookup(149));
+}
+
+TEST_F(PersistentNvmCacheTest, EraseMatching) {
+  for (int i = 0; i < 100; i++) {
+    Insert(i, i);
+  }
+  ASSERT_EQ(50, cache_->EraseMatching([](const Slice& key) {
+      return DecodeInt(key) % 2 == 0;
+    }));
+  Reopen();
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(i % 2 == 0 ? -1 : i, Lookup(i));
+  }
+}
+#endif // defined(__linux__)
+
 }  // namespace kudu
@@ -22,6 +22,7 @@
 #include "kudu/util/locks.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/numa.h"
 
 #if !defined(__APPLE__)
 #include "kudu/util/nvm_cache.h"
@@ -41,6 +42,10 @@ using std::vector;
 
 typedef simple_spinlock MutexType;
 
+// With CLOCK eviction, each eviction frees this fraction of a shard's
+// capacity in one go, so that the following inserts don't each sweep.
+const int kClockEvictionBatchDivisor = 64;
+
 // LRU cache implementation
 
 // An entry is a variable length heap-allocated structure.  Entries
@@ -56,6 +61,18 @@ struct LRUHandle {
   Atomic32 refs;
   uint32_t hash;      // Hash of key(); used for fast sharding and comparisons
 
+  // Whether the entry was looked up since the clock hand last passed it.
+  // Always 0 in LRU caches.
+  Atomic32 referenced;
+
+  // Whether the entry is in the protected segment of a segmented cache.
+  // Always false in plain LRU caches.
+  bool in_protected_segment;
+
+  // The NUMA node of the thread which allocated the entry, and so of the
+  // shard it goes to in a ShardedLRUCache.
+  uint8_t numa_node;
+
   // The storage for the key/value pair itself. The data is stored as:
   //   [key bytes ...] [padding up to 8-byte boundary] [value bytes ...]
   uint8_t kv_data[1];   // Beginning of key/value pair
@@ -165,6 +182,12 @@ class HandleTable {
 };
 
 // A single shard of sharded cache.
+//
+// By default this is a plain LRU cache. If a protected capacity is set, it
+// instead uses segmented LRU: 'lru_' holds the probationary segment and
+// 'protected_lru_' the protected one, and 'capacity_' bounds the two
+// together. With CLOCK eviction, 'lru_' is the ring swept by the clock hand,
+// from its oldest entry on.
 class LRUCache {
  public:
   explicit LRUCache(MemTracker* tracker);
@@ -173,17 +196,41 @@ class LRUCache {
   // Separate from constructor so caller can easily make an array of LRUCache
   void SetCapacity(size_t capacity) { capacity_ = capacity; }
 
+  // Enable segmented LRU, with a protected segment of at most 'capacity'
+  // bytes. Must be called before the cache is used.
+  void SetProtectedCapacity(size_t capacity) {
+    segmented_ = true;
+    protected_capacity_ = capacity;
+  }
+
+  // Use CLOCK eviction; see NewClockCache(). Must be called before the
+  // cache is used.
+  void SetClock() { clock_ = true; }
+
   void SetMetrics(CacheMetrics* metrics) { metrics_ = metrics; }
 
-  Cache::Handle* Insert(LRUHandle* handle, Cache::EvictionCallback* eviction_callback);
+  Cache::Handle* Insert(LRUHandle* handle, Cache::EvictionCallback* eviction_callback,
+                        Cache::Priority priority);
   // Like Cache::Lookup, but with an extra "hash" parameter.
   Cache::Handle* Lookup(const Slice& key, uint32_t hash, bool caching);
   void Release(Cache::Handle* handle);
   void Erase(const Slice& key, uint32_t hash);
 
  private:
+  // Unlink 'e' from whichever list it is on, and subtract its charge
+  // from the usage of its segment.
   void LRU_Remove(LRUHandle* e);
+  // Make 'e' the newest entry of the list for its segment, and add its
+  // charge to the usage of that segment.
   void LRU_Append(LRUHandle* e);
+  // Demote the oldest protected entries to the probationary segment until
+  // the protected segment fits in its capacity.
+  void EnforceProtectedCapacity();
+  // Sweep the clock hand over the entries, giving those referenced since
+  // its last pass a second chance and evicting the others, until a batch of
+  // capacity is free. The evicted entries whose last reference was dropped
+  // are prepended to '*to_remove_head'.
+  void ClockEvict(LRUHandle** to_remove_head);
   // Just reduce the reference count by 1.
   // Return true if last reference
   bool Unref(LRUHandle* e);
@@ -192,15 +239,24 @@ class LRUCache {
 
   // Initialized before use.
   size_t capacity_;
-
-  // mutex_ protects the following state.
-  MutexType mutex_;
+  bool segmented_;
+  size_t protected_capacity_;
+  bool clock_;
+
+  // mutex_ protects the following state. With CLOCK eviction, lookups only
+  // take it shared: they don't touch the lists, and 'referenced' and the
+  // reference counts are atomic.
+  rw_spinlock mutex_;
   size_t usage_;
+  size_t protected_usage_;
 
-  // Dummy head of LRU list.
+  // Dummy head of LRU list (the probationary segment, if segmented).
   // lru.prev is newest entry, lru.next is oldest entry.
   LRUHandle lru_;
 
+  // Dummy head of the protected segment's LRU list. Empty unless segmented.
+  LRUHandle protected_lru_;
+
   HandleTable table_;
 
   MemTracker* mem_tracker_;
@@ -209,22 +265,30 @@ class LRUCache {
 };
 
 LRUCache::LRUCache(MemTracker* tracker)
- : usage_(0),
+ : segmented_(false),
+   protected_capacity_(0),
+   clock_(false),
+   usage_(0),
+   protected_usage_(0),
    mem_tracker_(tracker),
    metrics_(nullptr) {
-  // Make empty circular linked list
+  // Make empty circular linked lists
   lru_.next = &lru_;
   lru_.prev = &lru_;
+  protected_lru_.next = &protected_lru_;
+  protected_lru_.prev = &protected_lru_;
 }
 
 LRUCache::~LRUCache() {
-  for (LRUHandle* e = lru_.next; e != &lru_; ) {
-    LRUHandle* next = e->next;
-    DCHECK_EQ(e->refs, 1);  // Error if caller has an unreleased handle
-    if (Unref(e)) {
-      FreeEntry(e);
+  for (LRUHandle* list : { &lru_, &protected_lru_ }) {
+    for (LRUHandle* e = list->next; e != list; ) {
+      LRUHandle* next = e->next;
+      DCHECK_EQ(e->refs, 1);  // Error if caller has an unreleased handle
+      if (Unref(e)) {
+        FreeEntry(e);
+      }
+      e = next;
     }
-    e = next;
   }
 }
 
@@ -250,26 +314,102 @@ void LRUCache::LRU_Remove(LRUHandle* e) {
   e->next->prev = e->prev;
   e->prev->next = e->next;
   usage_ -= e->charge;
+  if (e->in_protected_segment) {
+    protected_usage_ -= e->charge;
+  }
+  if (segmented_ && PREDICT_TRUE(metrics_)) {
+    if (e->in_protected_segment) {
+      metrics_->protected_segment_usage->DecrementBy(e->charge);
+    } else {
+      metrics_->probationary_segment_usage->DecrementBy(e->charge);
+    }
+  }
 }
 
 void LRUCache::LRU_Append(LRUHandle* e) {
-  // Make "e" newest entry by inserting just before lru_
-  e->next = &lru_;
-  e->prev = lru_.prev;
+  // Make "e" newest entry by inserting just before the list head
+  LRUHandle* list = e->in_protected_segment ? &protected_lru_ : &lru_;
+  e->next = list;
+  e->prev = list->prev;
   e->prev->next = e;
   e->next->prev = e;
   usage_ += e->charge;
+  if (e->in_protected_segment) {
+    protected_usage_ += e->charge;
+  }
+  if (segmented_ && PREDICT_TRUE(metrics_)) {
+    if (e->in_protected_segment) {
+      metrics_->protected_segment_usage->IncrementBy(e->charge);
+    } else {
+      metrics_->probationary_segment_usage->IncrementBy(e->charge);
+    }
+  }
+}
+
+void LRUCache::EnforceProtectedCapacity() {
+  while (protected_usage_ > protected_capacity_ && protected_lru_.next != &protected_lru_) {
+    LRUHandle* old = protected_lru_.next;
+    LRU_Remove(old);
+    old->in_protected_segment = false;
+    LRU_Append(old);
+  }
+}
+
+void LRUCache::ClockEvict(LRUHandle** to_remove_head) {
+  if (usage_ <= capacity_) {
+    return;
+  }
+  // Lookups can't set 'referenced' while the lock is held exclusively, so
+  // this ends within two sweeps of the ring.
+  const size_t target = capacity_ - capacity_ / kClockEvictionBatchDivisor;
+  while (usage_ > target && lru_.next != &lru_) {
+    LRUHandle* old = lru_.next;
+    LRU_Remove(old);
+    if (base::subtle::NoBarrier_Load(&old->referenced)) {
+      base::subtle::NoBarrier_Store(&old->referenced, 0);
+      LRU_Append(old);
+      continue;
+    }
+    table_.Remove(old->key(), old->hash);
+    if (Unref(old)) {
+      old->next = *to_remove_head;
+      *to_remove_head = old;
+    }
+  }
 }
 
 Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash, bool caching) {
   LRUHandle* e;
-  {
-    std::lock_guard<MutexType> l(mutex_);
+  bool was_protected = false;
+  if (clock_) {
+    shared_lock<rw_spinlock> l(mutex_);
     e = table_.Lookup(key, hash);
     if (e != nullptr) {
       base::RefCountInc(&e->refs);
+      // Hot entries are looked up by many threads: only write the flag if
+      // it isn't set already, so their cache line stays shared.
+      if (!base::subtle::NoBarrier_Load(&e->referenced)) {
+        base::subtle::NoBarrier_Store(&e->referenced, 1);
+      }
+    }
+  } else {
+    std::lock_guard<rw_spinlock> l(mutex_);
+    e = table_.Lookup(key, hash);
+    if (e != nullptr) {
+      base::RefCountInc(&e->refs);
+      was_protected = e->in_protected_segment;
       LRU_Remove(e);
+      // In a segmented cache, a second access from a caller which wants the
+      // block cached is what earns an entry its place in the protected
+      // segment. Lookups which don't expect to cache (e.g. from scans with
+      // caching disabled) only refresh the entry within its segment.
+      if (segmented_ && caching) {
+        e->in_protected_segment = true;
+      }
       LRU_Append(e);
+      if (segmented_) {
+        EnforceProtectedCapacity();
+      }
     }
   }
 
@@ -283,6 +423,13 @@ Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash, bool caching) {
       } else {
         metrics_->cache_hits->Increment();
       }
+      if (segmented_) {
+        if (was_protected) {
+          metrics_->protected_segment_hits->Increment();
+        } else {
+          metrics_->probationary_segment_hits->Increment();
+        }
+      }
     } else {
       if (caching) {
         metrics_->cache_misses_caching->Increment();
@@ -303,11 +450,14 @@ void LRUCache::Release(Cache::Handle* handle) {
   }
 }
 
-Cache::Handle* LRUCache::Insert(LRUHandle* e, Cache::EvictionCallback *eviction_callback) {
+Cache::Handle* LRUCache::Insert(LRUHandle* e, Cache::EvictionCallback *eviction_callback,
+                               Cache::Priority priority) {
 
   // Set the remaining LRUHandle members which were not already allocated during
   // Allocate().
   e->eviction_callback = eviction_callback;
+  e->in_protected_segment = segmented_ && priority == Cache::HIGH_PRIORITY;
+  e->referenced = 0;
   e->refs = 2;  // One from LRUCache, one for the returned handle
   mem_tracker_->Consume(e->charge);
   if (PREDICT_TRUE(metrics_)) {
@@ -317,7 +467,7 @@ Cache::Handle* LRUCache::Insert(LRUHandle* e, Cache::EvictionCallback *eviction_
 
   LRUHandle* to_remove_head = nullptr;
   {
-    std::lock_guard<MutexType> l(mutex_);
+    std::lock_guard<rw_spinlock> l(mutex_);
 
     LRU_Append(e);
 
@@ -330,8 +480,25 @@ Cache::Handle* LRUCache::Insert(LRUHandle* e, Cache::EvictionCallback *eviction_
       }
     }
 
-    while (usage_ > capacity_ && lru_.next != &lru_) {
-      LRUHandle* old = lru_.next;
+    if (segmented_) {
+      EnforceProtectedCapacity();
+    }
+
+    if (clock_) {
+      ClockEvict(&to_remove_head);
+    }
+
+    // Evict from the probationary segment first; the protected segment only
+    // loses entries once nothing else is left.
+    while (!clock_ && usage_ > capacity_) {
+      LRUHandle* old;
+      if (lru_.next != &lru_) {
+        old = lru_.next;
+      } else if (protected_lru_.next != &protected_lru_) {
+        old = protected_lru_.next;
+      } else {
+        break;
+      }
       LRU_Remove(old);
       table_.Remove(old->key(), old->hash);
       if (Unref(old)) {
@@ -356,7 +523,7 @@ void LRUCache::Erase(const Slice& key, uint32_t hash) {
   LRUHandle* e;
   bool last_reference = false;
   {
-    std::lock_guard<MutexType> l(mutex_);
+    std::lock_guard<rw_spinlock> l(mutex_);
     e = table_.Remove(key, hash);
     if (e != nullptr) {
       LRU_Remove(e);
@@ -386,33 +553,52 @@ class ShardedLRUCache : public Cache {
   MutexType id_mutex_;
   uint64_t last_id_;
 
-  // Number of bits of hash used to determine the shard.
+  // Number of bits of hash used to determine the shard within a node.
   const int shard_bits_;
 
+  // The shards are split evenly between the NUMA nodes (see NumaNodeCount()),
+  // so that threads use the entries which they allocated on their node. An
+  // entry used on several nodes is cached once per node.
+  const int num_nodes_;
+
   static inline uint32_t HashSlice(const Slice& s) {
     return util_hash::CityHash64(
       reinterpret_cast<const char *>(s.data()), s.size());
   }
 
-  uint32_t Shard(uint32_t hash) {
-    return hash >> (32 - shard_bits_);
+  uint32_t Shard(uint32_t hash, int node) {
+    return (node << shard_bits_) + (hash >> (32 - shard_bits_));
+  }
+
+  LRUCache* ShardOf(const LRUHandle* h) {
+    return shards_[Shard(h->hash, h->numa_node)];
   }
 
  public:
-  explicit ShardedLRUCache(size_t capacity, const string& id)
+  // If 'protected_ratio' is positive, each shard uses segmented LRU with
+  // that fraction of its capacity reserved for the protected segment. If
+  // 'clock' is true, each shard uses CLOCK eviction instead.
+  ShardedLRUCache(size_t capacity, double protected_ratio, bool clock, const string& id)
       : last_id_(0),
-        shard_bits_(DetermineShardBits()) {
+        shard_bits_(DetermineShardBits()),
+        num_nodes_(NumaNodeCount()) {
     // A cache is often a singleton, so:
     // 1. We reuse its MemTracker if one already exists, and
     // 2. It is directly parented to the root MemTracker.
     mem_tracker_ = MemTracker::FindOrCreateTracker(
         -1, strings::Substitute("$0-sharded_lru_cache", id));
 
-    int num_shards = 1 << shard_bits_;
+    int num_shards = num_nodes_ << shard_bits_;
     const size_t per_shard = (capacity + (num_shards - 1)) / num_shards;
     for (int s = 0; s < num_shards; s++) {
       gscoped_ptr<LRUCache> shard(new LRUCache(mem_tracker_.get()));
       shard->SetCapacity(per_shard);
+      if (protected_ratio > 0) {
+        shard->SetProtectedCapacity(static_cast<size_t>(per_shard * protected_ratio));
+      }
+      if (clock) {
+        shard->SetClock();
+      }
       shards_.push_back(shard.release());
     }
   }
@@ -422,21 +608,24 @@ class ShardedLRUCache : public Cache {
   }
 
   virtual Handle* Insert(PendingHandle* handle,
-                         Cache::EvictionCallback* eviction_callback) OVERRIDE {
+                         Cache::EvictionCallback* eviction_callback,
+                         Cache::Priority priority) OVERRIDE {
     LRUHandle* h = reinterpret_cast<LRUHandle*>(DCHECK_NOTNULL(handle));
-    return shards_[Shard(h->hash)]->Insert(h, eviction_callback);
+    return ShardOf(h)->Insert(h, eviction_callback, priority);
   }
   virtual Handle* Lookup(const Slice& key, CacheBehavior caching) OVERRIDE {
     const uint32_t hash = HashSlice(key);
-    return shards_[Shard(hash)]->Lookup(key, hash, caching == EXPECT_IN_CACHE);
+    return shards_[Shard(hash, CurrentNumaNode())]->Lookup(key, hash,
+                                                           caching == EXPECT_IN_CACHE);
   }
   virtual void Release(Handle* handle) OVERRIDE {
-    LRUHandle* h = reinterpret_cast<LRUHandle*>(handle);
-    shards_[Shard(h->hash)]->Release(handle);
+    ShardOf(reinterpret_cast<LRUHandle*>(handle))->Release(handle);
   }
   virtual void Erase(const Slice& key) OVERRIDE {
     const uint32_t hash = HashSlice(key);
-    shards_[Shard(hash)]->Erase(key, hash);
+    for (int node = 0; node < num_nodes_; node++) {
+      shards_[Shard(hash, node)]->Erase(key, hash);
+    }
   }
   virtual Slice Value(Handle* handle) OVERRIDE {
     return reinterpret_cast<LRUHandle*>(handle)->value();
@@ -467,6 +656,7 @@ class ShardedLRUCache : public Cache {
     handle->val_length = val_len;
     handle->charge = charge;
     handle->hash = HashSlice(key);
+    handle->numa_node = CurrentNumaNode();
     memcpy(handle->kv_data, key.data(), key_len);
 
     return reinterpret_cast<PendingHandle*>(handle);
@@ -488,7 +678,7 @@ class ShardedLRUCache : public Cache {
 Cache* NewLRUCache(CacheType type, size_t capacity, const string& id) {
   switch (type) {
     case DRAM_CACHE:
-      return new ShardedLRUCache(capacity, id);
+      return new ShardedLRUCache(capacity, 0, false, id);
 #if !defined(__APPLE__)
     case NVM_CACHE:
       return NewLRUNvmCache(capacity, id);
@@ -498,4 +688,14 @@ Cache* NewLRUCache(CacheType type, size_t capacity, const string& id) {
   }
 }
 
+Cache* NewSLRUCache(size_t capacity, double protected_ratio, const string& id) {
+  CHECK_GT(protected_ratio, 0);
+  CHECK_LT(protected_ratio, 1);
+  return new ShardedLRUCache(capacity, protected_ratio, false, id);
+}
+
+Cache* NewClockCache(size_t capacity, const string& id) {
+  return new ShardedLRUCache(capacity, 0, true, id);
+}
+
 }  // namespace kudu
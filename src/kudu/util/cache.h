@@ -19,6 +19,7 @@
 #define KUDU_UTIL_CACHE_H_
 
 #include <stdint.h>
+#include <functional>
 #include <string>
 
 #include "kudu/gutil/macros.h"
@@ -40,6 +41,29 @@ enum CacheType {
 // of Cache uses a least-recently-used eviction policy.
 Cache* NewLRUCache(CacheType type, size_t capacity, const std::string& id);
 
+// Create a new DRAM cache with a fixed size capacity which uses a
+// segmented LRU ("SLRU") eviction policy.
+//
+// Entries start out in a probationary segment and are promoted to a
+// protected segment, which may use up to 'protected_ratio' of the capacity,
+// when they are looked up again (or immediately, if inserted with
+// HIGH_PRIORITY). Entries overflowing the protected segment are demoted
+// back to probationary, and eviction always takes the least recently used
+// probationary entry first. As a result, a large scan which touches each
+// entry once can only churn the probationary segment and cannot displace
+// the frequently used working set.
+Cache* NewSLRUCache(size_t capacity, double protected_ratio, const std::string& id);
+
+// Create a new DRAM cache with a fixed size capacity which uses CLOCK
+// eviction, an approximation of LRU.
+//
+// Lookups only flag the entry as referenced, so they don't need exclusive
+// access to their shard and scale with the number of threads hitting the
+// same shard. When the cache is full, the clock hand sweeps the entries
+// from the oldest inserted on, giving those referenced since its last pass
+// a second chance and evicting the others, a small batch at a time.
+Cache* NewClockCache(size_t capacity, const std::string& id);
+
 class Cache {
  public:
   // Callback interface which is called when an entry is evicted from the
@@ -69,6 +93,14 @@ class Cache {
     NO_EXPECT_IN_CACHE
   };
 
+  // A hint about how valuable an entry is, passed on insertion. Segmented
+  // caches (see NewSLRUCache()) place HIGH_PRIORITY entries directly into
+  // their protected segment; other caches ignore it.
+  enum Priority {
+    NORMAL_PRIORITY,
+    HIGH_PRIORITY
+  };
+
   // If the cache has no mapping for "key", returns NULL.
   //
   // Else return a handle that corresponds to the mapping.  The caller
@@ -92,6 +124,18 @@ class Cache {
   // to it have been released.
   virtual void Erase(const Slice& key) = 0;
 
+  // Erases the entries whose key 'pred' returns true for, returning how many
+  // were erased. This walks the whole cache, with 'pred' called while parts
+  // of it are locked.
+  //
+  // This is meant for caches whose entries may outlive the data they were
+  // read from, such as a persistent NVM cache reopened after a restart (see
+  // --nvm_cache_persistent). Volatile caches don't implement it: entries for
+  // data which went away are simply never looked up again, and age out.
+  virtual size_t EraseMatching(const std::function<bool(const Slice& key)>& pred) {
+    return 0;
+  }
+
   // Return a new numeric id.  May be used by multiple clients who are
   // sharing the same cache to partition the key space.  Typically the
   // client will allocate a new id at startup and prepend the id to
@@ -156,7 +200,13 @@ class Cache {
   //
   // If 'eviction_callback' is non-NULL, then it will be called when the
   // entry is later evicted or when the cache shuts down.
-  virtual Handle* Insert(PendingHandle* pending, EvictionCallback* eviction_callback) = 0;
+  virtual Handle* Insert(PendingHandle* pending, EvictionCallback* eviction_callback,
+                         Priority priority) = 0;
+
+  // Same as above, with NORMAL_PRIORITY.
+  Handle* Insert(PendingHandle* pending, EvictionCallback* eviction_callback) {
+    return Insert(pending, eviction_callback, NORMAL_PRIORITY);
+  }
 
   // Free 'ptr', which must have been previously allocated using 'Allocate'.
   virtual void Free(PendingHandle* ptr) = 0;
@@ -49,6 +49,53 @@ METRIC_DEFINE_gauge_uint64(server, block_cache_usage, "Block Cache Memory Usage"
                            kudu::MetricUnit::kBytes,
                            "Memory consumed by the block cache");
 
+METRIC_DEFINE_counter(server, block_cache_probationary_segment_hits,
+                      "Block Cache Probationary Segment Hits", kudu::MetricUnit::kBlocks,
+                      "Number of lookups that found a block in the probationary segment "
+                      "of a segmented (SLRU) block cache");
+METRIC_DEFINE_counter(server, block_cache_protected_segment_hits,
+                      "Block Cache Protected Segment Hits", kudu::MetricUnit::kBlocks,
+                      "Number of lookups that found a block in the protected segment "
+                      "of a segmented (SLRU) block cache");
+METRIC_DEFINE_gauge_uint64(server, block_cache_probationary_segment_usage,
+                           "Block Cache Probationary Segment Memory Usage",
+                           kudu::MetricUnit::kBytes,
+                           "Memory consumed by the probationary segment of a segmented "
+                           "(SLRU) block cache");
+METRIC_DEFINE_gauge_uint64(server, block_cache_protected_segment_usage,
+                           "Block Cache Protected Segment Memory Usage",
+                           kudu::MetricUnit::kBytes,
+                           "Memory consumed by the protected segment of a segmented "
+                           "(SLRU) block cache");
+
+METRIC_DEFINE_counter(server, block_cache_compressed_tier_inserts,
+                      "Block Cache Compressed Tier Inserts", kudu::MetricUnit::kBlocks,
+                      "Number of compressed blocks inserted in the compressed tier "
+                      "of the block cache");
+METRIC_DEFINE_counter(server, block_cache_compressed_tier_evictions,
+                      "Block Cache Compressed Tier Evictions", kudu::MetricUnit::kBlocks,
+                      "Number of compressed blocks evicted from the compressed tier "
+                      "of the block cache");
+METRIC_DEFINE_counter(server, block_cache_compressed_tier_hits,
+                      "Block Cache Compressed Tier Hits", kudu::MetricUnit::kBlocks,
+                      "Number of blocks missing from the decompressed tier of the block "
+                      "cache which were decompressed from the compressed tier instead "
+                      "of being read from disk");
+METRIC_DEFINE_counter(server, block_cache_compressed_tier_misses,
+                      "Block Cache Compressed Tier Misses", kudu::MetricUnit::kBlocks,
+                      "Number of compressed blocks missing from both tiers of the block "
+                      "cache, which were read from disk");
+METRIC_DEFINE_gauge_uint64(server, block_cache_compressed_tier_usage,
+                           "Block Cache Compressed Tier Memory Usage",
+                           kudu::MetricUnit::kBytes,
+                           "Memory consumed by the compressed tier of the block cache");
+
+METRIC_DEFINE_counter(server, block_cache_dram_tier_hits,
+                      "Block Cache DRAM Tier Hits", kudu::MetricUnit::kBlocks,
+                      "Number of lookups of blocks served by the DRAM tier in front of "
+                      "an NVM block cache, which aren't counted as lookups of the NVM "
+                      "cache");
+
 namespace kudu {
 
 #define MINIT(member, x) member(METRIC_##x.Instantiate(entity))
@@ -61,7 +108,17 @@ CacheMetrics::CacheMetrics(const scoped_refptr<MetricEntity>& entity)
     MINIT(cache_hits_caching, block_cache_hits_caching),
     MINIT(cache_misses, block_cache_misses),
     MINIT(cache_misses_caching, block_cache_misses_caching),
-    GINIT(cache_usage, block_cache_usage) {
+    GINIT(cache_usage, block_cache_usage),
+    MINIT(probationary_segment_hits, block_cache_probationary_segment_hits),
+    MINIT(protected_segment_hits, block_cache_protected_segment_hits),
+    GINIT(probationary_segment_usage, block_cache_probationary_segment_usage),
+    GINIT(protected_segment_usage, block_cache_protected_segment_usage),
+    MINIT(compressed_tier_inserts, block_cache_compressed_tier_inserts),
+    MINIT(compressed_tier_evictions, block_cache_compressed_tier_evictions),
+    MINIT(compressed_tier_hits, block_cache_compressed_tier_hits),
+    MINIT(compressed_tier_misses, block_cache_compressed_tier_misses),
+    GINIT(compressed_tier_usage, block_cache_compressed_tier_usage),
+    MINIT(dram_tier_hits, block_cache_dram_tier_hits) {
 }
 #undef MINIT
 #undef GINIT
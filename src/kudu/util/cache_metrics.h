@@ -41,6 +41,24 @@ struct CacheMetrics {
   scoped_refptr<Counter> cache_misses_caching;
 
   scoped_refptr<AtomicGauge<uint64_t> > cache_usage;
+
+  // Only updated by segmented (SLRU) caches.
+  scoped_refptr<Counter> probationary_segment_hits;
+  scoped_refptr<Counter> protected_segment_hits;
+  scoped_refptr<AtomicGauge<uint64_t> > probationary_segment_usage;
+  scoped_refptr<AtomicGauge<uint64_t> > protected_segment_usage;
+
+  // Only updated by the block cache's tier of compressed blocks. The fields
+  // above then describe the tier of decompressed blocks in front of it.
+  scoped_refptr<Counter> compressed_tier_inserts;
+  scoped_refptr<Counter> compressed_tier_evictions;
+  scoped_refptr<Counter> compressed_tier_hits;
+  scoped_refptr<Counter> compressed_tier_misses;
+  scoped_refptr<AtomicGauge<uint64_t> > compressed_tier_usage;
+
+  // Only updated by the block cache's DRAM tier in front of an NVM cache.
+  // The fields above then describe the NVM cache.
+  scoped_refptr<Counter> dram_tier_hits;
 };
 
 } // namespace kudu
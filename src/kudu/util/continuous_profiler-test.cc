@@ -0,0 +1,90 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/continuous_profiler.h"
+
+#include <sstream>
+#include <string>
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include "kudu/gutil/spinlock.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+#include "kudu/util/thread.h"
+
+DECLARE_int32(continuous_cpu_profiling_hz);
+DECLARE_int64(continuous_contention_profiling_period_cycles);
+
+// See spinlock_profiling-test.cc for why this isn't included from
+// gutil/synchronization_profiling.h.
+namespace gutil {
+extern void SubmitSpinLockProfileData(const void *, int64);
+} // namespace gutil
+
+using std::string;
+
+namespace kudu {
+
+class ContinuousProfilerTest : public KuduTest {
+ public:
+  ContinuousProfilerTest() {
+    // The profiler starts once per process, so this only matters to the
+    // first test.
+    FLAGS_continuous_cpu_profiling_hz = 1000;
+    CHECK_OK(StartContinuousProfiling());
+  }
+};
+
+// Test that the CPU samples of a thread are attributed to its category.
+TEST_F(ContinuousProfilerTest, TestCpuSamples) {
+  AtomicBool stop(false);
+  scoped_refptr<Thread> spinner;
+  ASSERT_OK(Thread::Create("test-spinner", "spinner", [&]() {
+    while (!stop.Load()) {
+    }
+  }, &spinner));
+
+  AssertEventually([&]() {
+    std::ostringstream out;
+    DumpContinuousCpuProfile(&out);
+    ASSERT_STR_CONTAINS(out.str(), "test-spinner;");
+  });
+  stop.Store(true);
+  spinner->Join();
+}
+
+// Test that contention samples are attributed to the thread pool that
+// waited.
+TEST_F(ContinuousProfilerTest, TestContentionSamples) {
+  FLAGS_continuous_contention_profiling_period_cycles = 1000;
+  base::SpinLock lock;
+  scoped_refptr<Thread> waiter;
+  ASSERT_OK(Thread::Create("thread pool", "test-pool [worker]", [&]() {
+    gutil::SubmitSpinLockProfileData(&lock, 1000000);
+  }, &waiter));
+  waiter->Join();
+
+  std::ostringstream out;
+  DumpContinuousContentionProfile(&out);
+  ASSERT_STR_CONTAINS(out.str(), "test-pool;");
+  ASSERT_EQ(string::npos, out.str().find("[worker]"));
+}
+
+} // namespace kudu
@@ -0,0 +1,426 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/continuous_profiler.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/atomicops.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/once.h"
+#include "kudu/gutil/spinlock.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/debug-util.h"
+#include "kudu/util/errno.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/thread.h"
+
+DEFINE_int32(continuous_cpu_profiling_hz, 10,
+             "Number of times per second of CPU consumed by the process that the "
+             "continuous profiler samples the stack of the thread consuming it. "
+             "0 disables continuous CPU profiling.");
+TAG_FLAG(continuous_cpu_profiling_hz, advanced);
+
+DEFINE_int64(continuous_contention_profiling_period_cycles, 20000000,
+             "Number of cycles a thread spends waiting on contended spinlocks "
+             "between the samples of its stack taken by the continuous profiler. "
+             "0 disables continuous contention profiling.");
+TAG_FLAG(continuous_contention_profiling_period_cycles, advanced);
+TAG_FLAG(continuous_contention_profiling_period_cycles, runtime);
+
+DEFINE_int32(continuous_profiling_window_secs, 300,
+             "Number of seconds of samples that the continuous profiler keeps.");
+TAG_FLAG(continuous_profiling_window_secs, advanced);
+
+// GLog already implements symbolization. Just import their hidden symbol.
+namespace google {
+bool Symbolize(void *pc, char *out, int out_size);
+}
+
+using base::SpinLock;
+using base::SpinLockHolder;
+using std::deque;
+using std::map;
+using std::ostream;
+using std::string;
+using std::unordered_map;
+
+namespace kudu {
+
+namespace {
+
+// The signal which the CPU timer of the process delivers to the thread
+// consuming CPU. SIGPROF belongs to the on-demand gperftools profiler.
+int CpuSampleSignal() {
+  return SIGRTMIN + 1;
+}
+
+// Copies the group that the samples of the calling thread are attributed
+// to into 'group'. Async-safe.
+void GetThreadGroup(char* group, size_t size) {
+  const Thread* t = Thread::current_thread();
+  const char* name = "other";
+  size_t len = strlen(name);
+  if (t != nullptr && t->category() == "thread pool") {
+    // Thread pool workers are named "<pool name> [worker]".
+    name = t->name().c_str();
+    const char* suffix = strstr(name, " [");
+    len = suffix ? suffix - name : t->name().size();
+  } else if (t != nullptr) {
+    name = t->category().c_str();
+    len = t->category().size();
+  }
+  len = std::min(len, size - 1);
+  memcpy(group, name, len);
+  group[len] = '\0';
+}
+
+// A fixed-size, linear-probing hashtable of sampled stacks, which signal
+// handlers may add to. It's modeled after ContentionStacks in
+// spinlock_profiling.cc: a thread never waits on an entry's lock, so a sample
+// which finds its entries locked or claimed by other stacks is dropped.
+class SampleTable {
+ public:
+  enum {
+    kMaxGroupLength = 32
+  };
+
+  // Adds 'weight' to the samples of 'stack' taken on a thread of 'group'.
+  void Add(const StackTrace& stack, const char* group, int64_t weight) {
+    uint64_t hash = stack.HashCode();
+    for (int i = 0; i < kNumLinearProbeAttempts; i++) {
+      Entry* e = &entries_[(hash + i) % kNumEntries];
+      if (!e->lock.TryLock()) {
+        continue;
+      }
+      if (e->weight == 0) {
+        e->hash = hash;
+        e->trace.CopyFrom(stack);
+        strncpy(e->group, group, kMaxGroupLength);
+      } else if (e->hash != hash || !e->trace.Equals(stack) ||
+                 strncmp(e->group, group, kMaxGroupLength) != 0) {
+        e->lock.Unlock();
+        continue;
+      }
+      e->weight += weight;
+      e->lock.Unlock();
+      return;
+    }
+  }
+
+  // Calls 'f(stack, group, weight)' for each sample added since the last
+  // call, emptying the table.
+  template<class F>
+  void Drain(const F& f) {
+    StackTrace trace;
+    char group[kMaxGroupLength];
+    for (Entry& e : entries_) {
+      int64_t weight;
+      {
+        SpinLockHolder l(&e.lock);
+        if (e.weight == 0) {
+          continue;
+        }
+        weight = e.weight;
+        trace.CopyFrom(e.trace);
+        memcpy(group, e.group, kMaxGroupLength);
+        e.weight = 0;
+      }
+      f(trace, group, weight);
+    }
+  }
+
+ private:
+  enum {
+    kNumEntries = 1024,
+    kNumLinearProbeAttempts = 4
+  };
+
+  struct Entry {
+    SpinLock lock;
+
+    // The total weight of the samples of this entry. If this is 0, then the
+    // entry is unclaimed and the other fields are not valid.
+    int64_t weight = 0;
+    uint64_t hash;
+    StackTrace trace;
+    char group[kMaxGroupLength];
+  };
+
+  Entry entries_[kNumEntries];
+};
+
+class ContinuousProfiler {
+ public:
+  ContinuousProfiler();
+
+  Status Start();
+
+  // Writes the samples of 'table' in the window to 'out', dividing their
+  // weights by 'divisor'.
+  void Dump(SampleTable* table, double divisor, ostream* out);
+
+  SampleTable* cpu_samples() { return &cpu_samples_; }
+  SampleTable* contention_samples() { return &contention_samples_; }
+
+ private:
+  // The samples of each table, keyed by their folded stack.
+  typedef unordered_map<const SampleTable*, unordered_map<string, int64_t>> Bucket;
+
+  // The window is made of this many buckets, the oldest of which is
+  // discarded as a new one is started.
+  static const int kNumBuckets = 10;
+
+  void RunThread();
+
+  // Moves the samples of the tables into the newest bucket.
+  void FlushUnlocked();
+
+  // Returns the folded form of 'stack', without its group.
+  string FoldStackUnlocked(const StackTrace& stack);
+
+  SampleTable cpu_samples_;
+  SampleTable contention_samples_;
+
+  // Protects the fields below.
+  std::mutex lock_;
+
+  // The buckets of the window, oldest first.
+  deque<Bucket> buckets_;
+
+  // The symbols of the frames seen so far.
+  unordered_map<void*, string> symbols_;
+
+  scoped_refptr<Thread> thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(ContinuousProfiler);
+};
+
+ContinuousProfiler* g_profiler = nullptr;
+Status* g_start_status = nullptr;
+
+#if defined(__linux__)
+void HandleCpuSample(int signum) {
+  int saved_errno = errno;
+  auto profiler = reinterpret_cast<ContinuousProfiler*>(
+      base::subtle::Acquire_Load(reinterpret_cast<AtomicWord*>(&g_profiler)));
+  if (profiler) {
+    StackTrace stack;
+    // Skip Collect() and this handler.
+    stack.Collect(2);
+    char group[SampleTable::kMaxGroupLength];
+    GetThreadGroup(group, sizeof(group));
+    profiler->cpu_samples()->Add(stack, group, 1);
+  }
+  errno = saved_errno;
+}
+#endif // defined(__linux__)
+
+ContinuousProfiler::ContinuousProfiler()
+    : buckets_(1) {
+}
+
+Status ContinuousProfiler::Start() {
+  if (FLAGS_continuous_cpu_profiling_hz > 0) {
+#if defined(__linux__)
+    struct sigaction act;
+    memset(&act, 0, sizeof(act));
+    act.sa_handler = &HandleCpuSample;
+    act.sa_flags = SA_RESTART;
+    if (sigaction(CpuSampleSignal(), &act, nullptr) != 0) {
+      int err = errno;
+      return Status::RuntimeError("Unable to install the CPU sample handler",
+                                  ErrnoToString(err), err);
+    }
+
+    // The timer counts the CPU time of the whole process, and the kernel
+    // delivers its signal to the thread that was running when it expired.
+    struct sigevent sev;
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_SIGNAL;
+    sev.sigev_signo = CpuSampleSignal();
+    timer_t timer;
+    if (timer_create(CLOCK_PROCESS_CPUTIME_ID, &sev, &timer) != 0) {
+      int err = errno;
+      return Status::RuntimeError("Unable to create the CPU sample timer",
+                                  ErrnoToString(err), err);
+    }
+    int64_t period_nanos = MonoTime::kNanosecondsPerSecond / FLAGS_continuous_cpu_profiling_hz;
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = period_nanos / MonoTime::kNanosecondsPerSecond;
+    spec.it_interval.tv_nsec = period_nanos % MonoTime::kNanosecondsPerSecond;
+    spec.it_value = spec.it_interval;
+    if (timer_settime(timer, 0, &spec, nullptr) != 0) {
+      int err = errno;
+      return Status::RuntimeError("Unable to start the CPU sample timer",
+                                  ErrnoToString(err), err);
+    }
+#else
+    LOG(WARNING) << "Continuous CPU profiling is only supported on Linux";
+#endif // defined(__linux__)
+  }
+  return Thread::Create("profiler", "continuous-profiler",
+                        &ContinuousProfiler::RunThread, this, &thread_);
+}
+
+void ContinuousProfiler::RunThread() {
+  while (true) {
+    int64_t bucket_millis = std::max<int64_t>(
+        1, FLAGS_continuous_profiling_window_secs * 1000LL / kNumBuckets);
+    SleepFor(MonoDelta::FromMilliseconds(bucket_millis));
+    std::lock_guard<std::mutex> l(lock_);
+    FlushUnlocked();
+    buckets_.emplace_back();
+    while (buckets_.size() > kNumBuckets) {
+      buckets_.pop_front();
+    }
+  }
+}
+
+void ContinuousProfiler::FlushUnlocked() {
+  for (SampleTable* table : { &cpu_samples_, &contention_samples_ }) {
+    auto& samples = buckets_.back()[table];
+    table->Drain(
+        [&](const StackTrace& stack, const char* group, int64_t weight) {
+          samples[strings::Substitute("$0$1", group, FoldStackUnlocked(stack))] += weight;
+        });
+  }
+}
+
+string ContinuousProfiler::FoldStackUnlocked(const StackTrace& stack) {
+  string folded;
+  for (int i = stack.num_frames() - 1; i >= 0; i--) {
+    void* pc = stack.frame(i);
+    auto it = symbols_.find(pc);
+    if (it == symbols_.end()) {
+      char symbol[1024];
+      // As in StackTrace::Symbolize(), point at the 'call' rather than at the
+      // return address.
+      if (!google::Symbolize(reinterpret_cast<char*>(pc) - 1, symbol, sizeof(symbol))) {
+        snprintf(symbol, sizeof(symbol), "%p", pc);
+      }
+      it = symbols_.emplace(pc, symbol).first;
+    }
+    folded += ';';
+    folded += it->second;
+  }
+  return folded;
+}
+
+void ContinuousProfiler::Dump(SampleTable* table, double divisor, ostream* out) {
+  map<string, int64_t> merged;
+  {
+    std::lock_guard<std::mutex> l(lock_);
+    FlushUnlocked();
+    for (const Bucket& bucket : buckets_) {
+      auto it = bucket.find(table);
+      if (it == bucket.end()) {
+        continue;
+      }
+      for (const auto& sample : it->second) {
+        merged[sample.first] += sample.second;
+      }
+    }
+  }
+  for (const auto& sample : merged) {
+    int64_t value = static_cast<int64_t>(sample.second / divisor);
+    if (value > 0) {
+      *out << sample.first << " " << value << "\n";
+    }
+  }
+}
+
+void DoStart() {
+  auto profiler = new ContinuousProfiler();
+  g_start_status = new Status(profiler->Start());
+  base::subtle::Release_Store(reinterpret_cast<AtomicWord*>(&g_profiler),
+                              reinterpret_cast<AtomicWord>(profiler));
+}
+
+ContinuousProfiler* GetProfiler() {
+  return reinterpret_cast<ContinuousProfiler*>(
+      base::subtle::Acquire_Load(reinterpret_cast<AtomicWord*>(&g_profiler)));
+}
+
+} // anonymous namespace
+
+Status StartContinuousProfiling() {
+  static GoogleOnceType once = GOOGLE_ONCE_INIT;
+  GoogleOnceInit(&once, &DoStart);
+  return *g_start_status;
+}
+
+void DumpContinuousCpuProfile(ostream* out) {
+  ContinuousProfiler* profiler = GetProfiler();
+  if (profiler) {
+    profiler->Dump(profiler->cpu_samples(), 1, out);
+  }
+}
+
+void DumpContinuousContentionProfile(ostream* out) {
+  ContinuousProfiler* profiler = GetProfiler();
+  if (profiler) {
+    profiler->Dump(profiler->contention_samples(),
+                   base::CyclesPerSecond() / MonoTime::kMicrosecondsPerSecond, out);
+  }
+}
+
+void MaybeSampleContention(int64_t wait_cycles) {
+  int64_t period = FLAGS_continuous_contention_profiling_period_cycles;
+  if (period <= 0) {
+    return;
+  }
+  ContinuousProfiler* profiler = GetProfiler();
+  if (!profiler) {
+    return;
+  }
+  // The cycles waited since the last sample of this thread. A sample stands
+  // for whole periods, the rest carrying over to the next one.
+  static __thread int64_t pending_cycles = 0;
+  pending_cycles += wait_cycles;
+  if (PREDICT_TRUE(pending_cycles < period)) {
+    return;
+  }
+  int64_t weight = pending_cycles - pending_cycles % period;
+  pending_cycles -= weight;
+
+  StackTrace stack;
+  stack.Collect(2);
+  char group[SampleTable::kMaxGroupLength];
+  GetThreadGroup(group, sizeof(group));
+  profiler->contention_samples()->Add(stack, group, weight);
+}
+
+} // namespace kudu
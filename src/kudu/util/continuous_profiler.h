@@ -0,0 +1,56 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_UTIL_CONTINUOUS_PROFILER_H
+#define KUDU_UTIL_CONTINUOUS_PROFILER_H
+
+#include <cstdint>
+#include <iosfwd>
+
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+// A low-overhead profiler which runs for the life of the process, so that
+// there's a profile to look at after a latency problem has come and gone.
+//
+// The profiler samples the stack of the thread consuming CPU at
+// --continuous_cpu_profiling_hz, and the stack of a thread waiting on a
+// contended spinlock once per --continuous_contention_profiling_period_cycles
+// spent waiting. The samples of the last --continuous_profiling_window_secs
+// are kept, attributed to the group of the thread they were taken on: the
+// name of its thread pool for thread pool workers, or else its category.
+
+// Starts profiling. Subsequent calls do nothing and return the status of
+// the first one.
+Status StartContinuousProfiling();
+
+// Writes the CPU samples of the window to 'out' as folded stacks, ready to
+// be rendered by flamegraph.pl. Each line holds a distinct stack and its
+// number of samples:
+//   <thread group>;<outermost frame>;...;<innermost frame> <samples>
+void DumpContinuousCpuProfile(std::ostream* out);
+
+// Same as above, for the contention samples, weighted by the number of
+// microseconds spent waiting.
+void DumpContinuousContentionProfile(std::ostream* out);
+
+// Called by the spinlock contention hook after waiting 'wait_cycles' on a
+// lock, to sample the stack of the calling thread if it's due.
+void MaybeSampleContention(int64_t wait_cycles);
+
+} // namespace kudu
+#endif /* KUDU_UTIL_CONTINUOUS_PROFILER_H */
@@ -153,6 +153,15 @@ class StackTrace {
 
   uint64_t HashCode() const;
 
+  int num_frames() const {
+    return num_frames_;
+  }
+
+  // Returns the return address of the 'i'th frame, innermost first.
+  void* frame(int i) const {
+    return frames_[i];
+  }
+
  private:
   enum {
     // The maximum number of stack frames to collect.
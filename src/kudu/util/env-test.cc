@@ -737,6 +737,34 @@ TEST_F(TestEnv, TestCopyFile) {
   NO_FATALS(ReadAndVerifyTestData(copy.get(), 0, kFileSize));
 }
 
+// Test that a file opened for direct I/O returns the right bytes for
+// unaligned offsets and lengths, including reads which run off the end of
+// the file.
+TEST_F(TestEnv, TestDirectIORead) {
+  string path = GetTestPath("test");
+  const int kFileSize = 64 * 1024 + 11; // Not a multiple of the alignment.
+
+  Env* env = Env::Default();
+  NO_FATALS(WriteTestFile(env, path, kFileSize));
+  RandomAccessFileOptions opts;
+  opts.direct_io = true;
+  gscoped_ptr<RandomAccessFile> raf;
+  ASSERT_OK(env->NewRandomAccessFile(opts, path, &raf));
+
+  NO_FATALS(ReadAndVerifyTestData(raf.get(), 0, kFileSize));
+  NO_FATALS(ReadAndVerifyTestData(raf.get(), 4096, 8192));
+  NO_FATALS(ReadAndVerifyTestData(raf.get(), 1, 1));
+  NO_FATALS(ReadAndVerifyTestData(raf.get(), 4095, 4098));
+  NO_FATALS(ReadAndVerifyTestData(raf.get(), kFileSize - 100, 100));
+
+  // A read past the end of the file is short.
+  uint8_t scratch[200];
+  Slice s;
+  ASSERT_OK(raf->Read(kFileSize - 100, sizeof(scratch), &s, scratch));
+  ASSERT_EQ(100, s.size());
+  NO_FATALS(VerifyTestData(s, kFileSize - 100));
+}
+
 // Simple regression test for NewTempRWFile().
 TEST_F(TestEnv, TestTempRWFile) {
   string tmpl = "foo.XXXXXX";
@@ -348,7 +348,16 @@ struct WritableFileOptions {
 
 // Options specified when a file is opened for random access.
 struct RandomAccessFileOptions {
-  RandomAccessFileOptions() {}
+  // Bypass the operating system's page cache (O_DIRECT on Linux), for
+  // callers which cache the data themselves. Reads need not be aligned:
+  // unaligned reads are widened and bounced through an aligned buffer.
+  //
+  // If the filesystem does not support direct I/O, the file is opened
+  // normally instead.
+  bool direct_io;
+
+  RandomAccessFileOptions()
+    : direct_io(false) {}
 };
 
 // A file abstraction for sequential writing.  The implementation
@@ -2,12 +2,14 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
+#include <algorithm>
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <fts.h>
 #include <glog/logging.h>
 #include <limits.h>
+#include <memory>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -28,6 +30,7 @@
 #include "kudu/gutil/callback.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/alignment.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/env.h"
 #include "kudu/util/errno.h"
@@ -39,6 +42,7 @@
 #include "kudu/util/slice.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/thread_restrictions.h"
+#include "kudu/util/threadlocal.h"
 #include "kudu/util/trace.h"
 
 #if defined(__APPLE__)
@@ -266,19 +270,61 @@ class PosixSequentialFile: public SequentialFile {
 };
 
 // pread() based random-access
+// The alignment of file offsets, lengths and buffers for direct I/O. Logical
+// block sizes are at most this on the devices we care about.
+const size_t kDirectIoAlignment = 4096;
+
+// An aligned bounce buffer for unaligned direct reads, reused by all of the
+// reads of a thread. It only grows, to the largest read so far.
+class DirectIoBuffer {
+ public:
+  DirectIoBuffer() : data_(nullptr), capacity_(0) {}
+  ~DirectIoBuffer() { free(data_); }
+
+  // Returns a buffer of at least 'size' bytes aligned to kDirectIoAlignment,
+  // or null if it can't be allocated. Previous contents are not preserved.
+  uint8_t* Reserve(size_t size) {
+    if (size > capacity_) {
+      void* buf;
+      if (posix_memalign(&buf, kDirectIoAlignment, size) != 0) {
+        return nullptr;
+      }
+      free(data_);
+      data_ = static_cast<uint8_t*>(buf);
+      capacity_ = size;
+    }
+    return data_;
+  }
+
+ private:
+  uint8_t* data_;
+  size_t capacity_;
+
+  DISALLOW_COPY_AND_ASSIGN(DirectIoBuffer);
+};
+
 class PosixRandomAccessFile: public RandomAccessFile {
  private:
   std::string filename_;
   int fd_;
 
+  // Whether 'fd_' was opened for direct I/O.
+  bool direct_io_;
+
  public:
-  PosixRandomAccessFile(std::string fname, int fd)
-      : filename_(std::move(fname)), fd_(fd) {}
+  PosixRandomAccessFile(std::string fname, int fd, bool direct_io = false)
+      : filename_(std::move(fname)), fd_(fd), direct_io_(direct_io) {}
   virtual ~PosixRandomAccessFile() { close(fd_); }
 
   virtual Status Read(uint64_t offset, size_t n, Slice* result,
                       uint8_t *scratch) const OVERRIDE {
     ThreadRestrictions::AssertIOAllowed();
+    if (direct_io_ &&
+        (offset % kDirectIoAlignment != 0 ||
+         n % kDirectIoAlignment != 0 ||
+         reinterpret_cast<uintptr_t>(scratch) % kDirectIoAlignment != 0)) {
+      return ReadUnalignedDirect(offset, n, result, scratch);
+    }
     Status s;
     ssize_t r;
     RETRY_ON_EINTR(r, pread(fd_, scratch, n, offset));
@@ -290,6 +336,33 @@ class PosixRandomAccessFile: public RandomAccessFile {
     return s;
   }
 
+  // Direct I/O requires an aligned offset, length and buffer, so read the
+  // enclosing aligned range into the thread's aligned bounce buffer and copy
+  // out the requested bytes.
+  Status ReadUnalignedDirect(uint64_t offset, size_t n, Slice* result,
+                             uint8_t *scratch) const {
+    uint64_t aligned_offset = offset - offset % kDirectIoAlignment;
+    size_t head = offset - aligned_offset;
+    size_t aligned_n = KUDU_ALIGN_UP(head + n, kDirectIoAlignment);
+    BLOCK_STATIC_THREAD_LOCAL(DirectIoBuffer, direct_io_buffer);
+    uint8_t* buf = direct_io_buffer->Reserve(aligned_n);
+    if (buf == nullptr) {
+      return Status::RuntimeError("unable to allocate aligned buffer", filename_);
+    }
+
+    ssize_t r;
+    RETRY_ON_EINTR(r, pread(fd_, buf, aligned_n, aligned_offset));
+    if (r < 0) {
+      *result = Slice(scratch, 0);
+      return IOError(filename_, errno);
+    }
+    size_t nread = static_cast<size_t>(r);
+    size_t available = nread > head ? std::min(n, nread - head) : 0;
+    memcpy(scratch, buf + head, available);
+    *result = Slice(scratch, available);
+    return Status::OK();
+  }
+
   virtual Status Size(uint64_t *size) const OVERRIDE {
     TRACE_EVENT1("io", "PosixRandomAccessFile::Size", "path", filename_);
     ThreadRestrictions::AssertIOAllowed();
@@ -736,12 +809,30 @@ class PosixEnv : public Env {
                                      gscoped_ptr<RandomAccessFile>* result) OVERRIDE {
     TRACE_EVENT1("io", "PosixEnv::NewRandomAccessFile", "path", fname);
     ThreadRestrictions::AssertIOAllowed();
-    int fd = open(fname.c_str(), O_RDONLY);
+    bool direct_io = false;
+    int fd = -1;
+#if defined(O_DIRECT)
+    if (opts.direct_io) {
+      fd = open(fname.c_str(), O_RDONLY | O_DIRECT);
+      if (fd >= 0) {
+        direct_io = true;
+      } else if (errno == EINVAL) {
+        // Some filesystems (e.g. tmpfs) don't support direct I/O.
+        KLOG_FIRST_N(WARNING, 1) << "The filesystem does not support O_DIRECT; "
+                                 << "reading " << fname << " through the page cache";
+      } else {
+        return IOError(fname, errno);
+      }
+    }
+#endif
+    if (fd < 0) {
+      fd = open(fname.c_str(), O_RDONLY);
+    }
     if (fd < 0) {
       return IOError(fname, errno);
     }
 
-    result->reset(new PosixRandomAccessFile(fname, fd));
+    result->reset(new PosixRandomAccessFile(fname, fd, direct_io));
     return Status::OK();
   }
 
@@ -87,8 +87,14 @@ Status OpenFileForWrite(const WritableFileOptions& opts,
 
 Status OpenFileForRandom(Env *env, const string &path,
                          shared_ptr<RandomAccessFile> *file) {
+  return OpenFileForRandom(RandomAccessFileOptions(), env, path, file);
+}
+
+Status OpenFileForRandom(const RandomAccessFileOptions& opts,
+                         Env *env, const string &path,
+                         shared_ptr<RandomAccessFile> *file) {
   gscoped_ptr<RandomAccessFile> r;
-  RETURN_NOT_OK(env->NewRandomAccessFile(path, &r));
+  RETURN_NOT_OK(env->NewRandomAccessFile(opts, path, &r));
   file->reset(r.release());
   return Status::OK();
 }
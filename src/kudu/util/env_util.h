@@ -36,6 +36,10 @@ Status OpenFileForWrite(const WritableFileOptions& opts,
 Status OpenFileForRandom(Env *env, const std::string &path,
                          std::shared_ptr<RandomAccessFile> *file);
 
+Status OpenFileForRandom(const RandomAccessFileOptions& opts,
+                         Env *env, const std::string &path,
+                         std::shared_ptr<RandomAccessFile> *file);
+
 Status OpenFileForSequential(Env *env, const std::string &path,
                              std::shared_ptr<SequentialFile> *file);
 
@@ -17,6 +17,7 @@
 
 #include "kudu/util/faststring.h"
 
+#include <algorithm>
 #include <glog/logging.h>
 
 #include "kudu/gutil/gscoped_ptr.h"
@@ -53,5 +54,29 @@ void faststring::GrowArray(size_t newcapacity) {
   ASAN_POISON_MEMORY_REGION(data_ + len_, capacity_ - len_);
 }
 
+void faststring::swap(faststring& other) {
+  if (&other == this) return;
+  const bool was_inline = data_ == initial_data_;
+  const bool other_was_inline = other.data_ == other.initial_data_;
+
+  ASAN_UNPOISON_MEMORY_REGION(initial_data_, arraysize(initial_data_));
+  ASAN_UNPOISON_MEMORY_REGION(other.initial_data_, arraysize(other.initial_data_));
+  uint8_t tmp[kInitialCapacity];
+  memcpy(tmp, initial_data_, kInitialCapacity);
+  memcpy(initial_data_, other.initial_data_, kInitialCapacity);
+  memcpy(other.initial_data_, tmp, kInitialCapacity);
+
+  std::swap(data_, other.data_);
+  std::swap(len_, other.len_);
+  std::swap(capacity_, other.capacity_);
+  if (was_inline) other.data_ = other.initial_data_;
+  if (other_was_inline) data_ = initial_data_;
+
+  ASAN_POISON_MEMORY_REGION(initial_data_, arraysize(initial_data_));
+  ASAN_UNPOISON_MEMORY_REGION(data_, len_);
+  ASAN_POISON_MEMORY_REGION(other.initial_data_, arraysize(other.initial_data_));
+  ASAN_UNPOISON_MEMORY_REGION(other.data_, other.len_);
+}
+
 
 } // namespace kudu
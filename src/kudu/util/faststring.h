@@ -204,6 +204,11 @@ class faststring {
                        len_);
   }
 
+  // Exchange the contents of this string with those of 'other'. Contents
+  // held in the inline buffer are copied, and heap buffers are handed over,
+  // so this never allocates.
+  void swap(faststring& other);
+
  private:
   DISALLOW_COPY_AND_ASSIGN(faststring);
 
@@ -0,0 +1,134 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/file_cache.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/env.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/test_util.h"
+
+METRIC_DECLARE_counter(file_cache_hits);
+METRIC_DECLARE_counter(file_cache_misses);
+METRIC_DECLARE_counter(file_cache_evictions);
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+
+class FileCacheTest : public KuduTest {
+ public:
+  FileCacheTest()
+      : entity_(METRIC_ENTITY_server.Instantiate(&registry_, "test")) {
+  }
+
+ protected:
+  // Writes 'contents' to a new file named 'name', returning its path.
+  string WriteFile(const string& name, const string& contents) {
+    string path = GetTestPath(name);
+    CHECK_OK(WriteStringToFile(env_.get(), contents, path));
+    return path;
+  }
+
+  // Reads the whole of 'file' into a string.
+  static string ReadAll(const shared_ptr<RandomAccessFile>& file) {
+    uint64_t size;
+    CHECK_OK(file->Size(&size));
+    string scratch(size, '\0');
+    Slice result;
+    CHECK_OK(file->Read(0, size, &result, reinterpret_cast<uint8_t*>(&scratch[0])));
+    return result.ToString();
+  }
+
+  int64_t CounterValue(CounterPrototype* prototype) {
+    return prototype->Instantiate(entity_)->value();
+  }
+
+  MetricRegistry registry_;
+  scoped_refptr<MetricEntity> entity_;
+};
+
+// Test that files are reopened as needed when there are more of them than
+// the cache keeps open.
+TEST_F(FileCacheTest, TestEvictAndReopen) {
+  FileCache cache(env_.get(), 2, entity_);
+  vector<shared_ptr<RandomAccessFile>> files;
+  for (int i = 0; i < 4; i++) {
+    string path = WriteFile(Substitute("f$0", i), Substitute("contents $0", i));
+    shared_ptr<RandomAccessFile> file;
+    ASSERT_OK(cache.OpenExistingFile(path, RandomAccessFileOptions(), &file));
+    ASSERT_EQ(path, file->filename());
+    files.push_back(file);
+  }
+  ASSERT_EQ(2, cache.num_open_files());
+  ASSERT_EQ(2, CounterValue(&METRIC_file_cache_evictions));
+
+  // Every file still reads back, without holding more than two open.
+  for (int i = 0; i < 4; i++) {
+    ASSERT_EQ(Substitute("contents $0", i), ReadAll(files[i]));
+    ASSERT_LE(cache.num_open_files(), 2);
+  }
+  ASSERT_GT(CounterValue(&METRIC_file_cache_hits), 0);
+  ASSERT_GT(CounterValue(&METRIC_file_cache_misses), 4);
+
+  // Files are closed along with their last descriptor.
+  files.clear();
+  ASSERT_EQ(0, cache.num_open_files());
+
+  // Missing files are reported when opened.
+  shared_ptr<RandomAccessFile> file;
+  Status s = cache.OpenExistingFile(GetTestPath("missing"), RandomAccessFileOptions(), &file);
+  ASSERT_TRUE(s.IsNotFound()) << s.ToString();
+}
+
+// Test that deleting a file with descriptors is deferred until they're
+// all destroyed, even if the file was evicted meanwhile.
+TEST_F(FileCacheTest, TestDeleteWithDescriptors) {
+  FileCache cache(env_.get(), 1, entity_);
+  string path = WriteFile("deleted", "deleted contents");
+  shared_ptr<RandomAccessFile> file;
+  ASSERT_OK(cache.OpenExistingFile(path, RandomAccessFileOptions(), &file));
+  ASSERT_OK(cache.DeleteFile(path));
+  ASSERT_TRUE(env_->FileExists(path));
+
+  // The file can't be opened again.
+  shared_ptr<RandomAccessFile> other;
+  Status s = cache.OpenExistingFile(path, RandomAccessFileOptions(), &other);
+  ASSERT_TRUE(s.IsNotFound()) << s.ToString();
+
+  // Evict it by opening another file; it's still readable.
+  string other_path = WriteFile("other", "other contents");
+  ASSERT_OK(cache.OpenExistingFile(other_path, RandomAccessFileOptions(), &other));
+  ASSERT_EQ("deleted contents", ReadAll(file));
+
+  file.reset();
+  ASSERT_FALSE(env_->FileExists(path));
+
+  // Without descriptors, files are deleted right away.
+  other.reset();
+  ASSERT_OK(cache.DeleteFile(other_path));
+  ASSERT_FALSE(env_->FileExists(other_path));
+}
+
+} // namespace kudu
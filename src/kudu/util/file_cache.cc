@@ -0,0 +1,239 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/file_cache.h"
+
+#include <glog/logging.h>
+#include <mutex>
+
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/env_util.h"
+#include "kudu/util/malloc.h"
+#include "kudu/util/metrics.h"
+
+METRIC_DEFINE_counter(server, file_cache_hits,
+                      "File Cache Hits", kudu::MetricUnit::kCacheHits,
+                      "Number of file reads which found their file open in the file cache");
+METRIC_DEFINE_counter(server, file_cache_misses,
+                      "File Cache Misses", kudu::MetricUnit::kCacheQueries,
+                      "Number of file reads which had to open their file");
+METRIC_DEFINE_counter(server, file_cache_evictions,
+                      "File Cache Evictions", kudu::MetricUnit::kFiles,
+                      "Number of files closed by the file cache to stay within its "
+                      "limit of open files");
+METRIC_DEFINE_gauge_uint64(server, file_cache_open_files,
+                           "File Cache Open Files", kudu::MetricUnit::kFiles,
+                           "Number of files held open by the file cache");
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+
+namespace internal {
+
+// A RandomAccessFile which gets its underlying file from a FileCache on
+// each use.
+class CachedFileDescriptor : public RandomAccessFile {
+ public:
+  CachedFileDescriptor(FileCache* cache, string path, RandomAccessFileOptions opts)
+      : cache_(cache),
+        path_(std::move(path)),
+        opts_(opts) {
+  }
+
+  virtual ~CachedFileDescriptor() {
+    cache_->DescriptorDestroyed(path_);
+  }
+
+  virtual Status Read(uint64_t offset, size_t n, Slice* result,
+                      uint8_t *scratch) const OVERRIDE {
+    shared_ptr<RandomAccessFile> file;
+    RETURN_NOT_OK(cache_->GetFile(path_, opts_, &file));
+    return file->Read(offset, n, result, scratch);
+  }
+
+  virtual Status Size(uint64_t *size) const OVERRIDE {
+    shared_ptr<RandomAccessFile> file;
+    RETURN_NOT_OK(cache_->GetFile(path_, opts_, &file));
+    return file->Size(size);
+  }
+
+  virtual const string& filename() const OVERRIDE {
+    return path_;
+  }
+
+  virtual size_t memory_footprint() const OVERRIDE {
+    return kudu_malloc_usable_size(this) + path_.capacity();
+  }
+
+ private:
+  FileCache* const cache_;
+  const string path_;
+  const RandomAccessFileOptions opts_;
+
+  DISALLOW_COPY_AND_ASSIGN(CachedFileDescriptor);
+};
+
+} // namespace internal
+
+FileCache::FileCache(Env* env, int max_open_files,
+                     const scoped_refptr<MetricEntity>& metric_entity)
+    : env_(DCHECK_NOTNULL(env)),
+      max_open_files_(max_open_files) {
+  CHECK_GT(max_open_files_, 0);
+  if (metric_entity) {
+    hits_ = METRIC_file_cache_hits.Instantiate(metric_entity);
+    misses_ = METRIC_file_cache_misses.Instantiate(metric_entity);
+    evictions_ = METRIC_file_cache_evictions.Instantiate(metric_entity);
+    open_files_gauge_ = METRIC_file_cache_open_files.Instantiate(metric_entity, 0);
+  }
+}
+
+FileCache::~FileCache() {
+  DCHECK(paths_.empty()) << "File cache destroyed with open descriptors";
+}
+
+Status FileCache::OpenExistingFile(const string& path,
+                                   const RandomAccessFileOptions& opts,
+                                   shared_ptr<RandomAccessFile>* file) {
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    const PathState* state = FindOrNull(paths_, path);
+    if (state && state->deleted) {
+      return Status::NotFound(Substitute("File $0 was deleted", path));
+    }
+    paths_[path].num_descriptors++;
+  }
+  // Constructed before opening, so that a failed open drops its descriptor.
+  shared_ptr<RandomAccessFile> descriptor(
+      new internal::CachedFileDescriptor(this, path, opts));
+  shared_ptr<RandomAccessFile> unused;
+  RETURN_NOT_OK(GetFile(path, opts, &unused));
+  *file = std::move(descriptor);
+  return Status::OK();
+}
+
+Status FileCache::DeleteFile(const string& path) {
+  vector<shared_ptr<RandomAccessFile>> closed;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    PathState* state = FindOrNull(paths_, path);
+    if (state) {
+      state->deleted = true;
+      return Status::OK();
+    }
+    EraseUnlocked(path, &closed);
+  }
+  return env_->DeleteFile(path);
+}
+
+int FileCache::num_open_files() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return open_files_.size();
+}
+
+Status FileCache::GetFile(const string& path, const RandomAccessFileOptions& opts,
+                          shared_ptr<RandomAccessFile>* file) {
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    OpenFile* open = FindOrNull(open_files_, path);
+    if (open) {
+      lru_.splice(lru_.begin(), lru_, open->lru_pos);
+      *file = open->file;
+      if (hits_) {
+        hits_->Increment();
+      }
+      return Status::OK();
+    }
+  }
+
+  // Open the file without holding the lock. Concurrent misses on the same
+  // path may each open it; only one of them is kept.
+  shared_ptr<RandomAccessFile> opened;
+  RETURN_NOT_OK(env_util::OpenFileForRandom(opts, env_, path, &opened));
+  vector<shared_ptr<RandomAccessFile>> closed;
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (misses_) {
+    misses_->Increment();
+  }
+  OpenFile* open = FindOrNull(open_files_, path);
+  if (open) {
+    *file = open->file;
+    return Status::OK();
+  }
+  lru_.push_front(path);
+  InsertOrDie(&open_files_, path, { opened, lru_.begin() });
+  *file = std::move(opened);
+  EvictUnlocked(&closed);
+  return Status::OK();
+}
+
+void FileCache::DescriptorDestroyed(const string& path) {
+  vector<shared_ptr<RandomAccessFile>> closed;
+  bool deleted;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    PathState* state = &FindOrDie(paths_, path);
+    if (--state->num_descriptors > 0) {
+      return;
+    }
+    deleted = state->deleted;
+    paths_.erase(path);
+    // Nothing will read the file until it's opened again.
+    EraseUnlocked(path, &closed);
+    if (open_files_gauge_) {
+      open_files_gauge_->set_value(open_files_.size());
+    }
+  }
+  closed.clear();
+  if (deleted) {
+    WARN_NOT_OK(env_->DeleteFile(path), Substitute("Failed to delete file $0", path));
+  }
+}
+
+void FileCache::EvictUnlocked(vector<shared_ptr<RandomAccessFile>>* closed) {
+  DCHECK(lock_.is_locked());
+  while (static_cast<int>(open_files_.size()) > max_open_files_) {
+    auto it = open_files_.find(lru_.back());
+    closed->push_back(std::move(it->second.file));
+    open_files_.erase(it);
+    lru_.pop_back();
+    if (evictions_) {
+      evictions_->Increment();
+    }
+  }
+  if (open_files_gauge_) {
+    open_files_gauge_->set_value(open_files_.size());
+  }
+}
+
+void FileCache::EraseUnlocked(const string& path,
+                              vector<shared_ptr<RandomAccessFile>>* closed) {
+  DCHECK(lock_.is_locked());
+  auto it = open_files_.find(path);
+  if (it != open_files_.end()) {
+    closed->push_back(std::move(it->second.file));
+    lru_.erase(it->second.lru_pos);
+    open_files_.erase(it);
+  }
+}
+
+} // namespace kudu
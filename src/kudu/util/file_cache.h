@@ -0,0 +1,140 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_UTIL_FILE_CACHE_H
+#define KUDU_UTIL_FILE_CACHE_H
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/env.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+template<class T>
+class AtomicGauge;
+class Counter;
+class MetricEntity;
+
+namespace internal {
+class CachedFileDescriptor;
+} // namespace internal
+
+// A cache of open files, which bounds the number of file descriptors held
+// by readers that would otherwise keep their files open for as long as they
+// live.
+//
+// Files are opened through the cache as lightweight descriptors. The cache
+// keeps at most 'max_open_files' underlying files open, closing the least
+// recently used ones as needed; a descriptor whose file was closed reopens
+// it on its next use. A file being read when it's evicted is closed once
+// the read completes.
+//
+// Deleting a file through the cache is deferred until its last descriptor
+// is destroyed, as POSIX does for unlinking open files, so that evicted
+// files can still be reopened by their descriptors.
+//
+// The cache must outlive its descriptors. Thread-safe.
+class FileCache {
+ public:
+  // 'metric_entity' may be null, in which case no metrics are kept.
+  FileCache(Env* env, int max_open_files,
+            const scoped_refptr<MetricEntity>& metric_entity);
+
+  ~FileCache();
+
+  // Opens the existing file at 'path' for random access through the cache.
+  // The file is opened right away, so that a missing file is reported here
+  // rather than on first use. All descriptors of a given path must be
+  // opened with the same 'opts'.
+  Status OpenExistingFile(const std::string& path,
+                          const RandomAccessFileOptions& opts,
+                          std::shared_ptr<RandomAccessFile>* file);
+
+  // Deletes the file at 'path' once it has no more descriptors. Opening the
+  // file through the cache fails from now on.
+  Status DeleteFile(const std::string& path);
+
+  // Returns the number of files currently held open by the cache.
+  int num_open_files() const;
+
+ private:
+  friend class internal::CachedFileDescriptor;
+
+  // An open file and its position in 'lru_'.
+  struct OpenFile {
+    std::shared_ptr<RandomAccessFile> file;
+    std::list<std::string>::iterator lru_pos;
+  };
+
+  // The descriptors of a path.
+  struct PathState {
+    int num_descriptors = 0;
+
+    // Whether the file was deleted through the cache, pending the
+    // destruction of its descriptors.
+    bool deleted = false;
+  };
+
+  // Sets 'file' to the open file at 'path', opening it with 'opts' unless
+  // the cache already holds it open.
+  Status GetFile(const std::string& path, const RandomAccessFileOptions& opts,
+                 std::shared_ptr<RandomAccessFile>* file);
+
+  // Called when a descriptor of 'path' is destroyed.
+  void DescriptorDestroyed(const std::string& path);
+
+  // Removes the least recently used files until at most 'max_open_files_'
+  // are open, and updates the open file metric. The removed files are
+  // appended to 'closed', to be closed once the lock is released.
+  void EvictUnlocked(std::vector<std::shared_ptr<RandomAccessFile>>* closed);
+
+  // Removes 'path' from the open files, if it's there, appending it to
+  // 'closed'.
+  void EraseUnlocked(const std::string& path,
+                     std::vector<std::shared_ptr<RandomAccessFile>>* closed);
+
+  Env* const env_;
+  const int max_open_files_;
+
+  mutable simple_spinlock lock_;
+
+  // The open files, keyed by path.
+  std::unordered_map<std::string, OpenFile> open_files_;
+
+  // The paths in 'open_files_', most recently used first.
+  std::list<std::string> lru_;
+
+  // The paths with descriptors.
+  std::unordered_map<std::string, PathState> paths_;
+
+  scoped_refptr<Counter> hits_;
+  scoped_refptr<Counter> misses_;
+  scoped_refptr<Counter> evictions_;
+  scoped_refptr<AtomicGauge<uint64_t>> open_files_gauge_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileCache);
+};
+
+} // namespace kudu
+#endif /* KUDU_UTIL_FILE_CACHE_H */
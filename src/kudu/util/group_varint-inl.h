@@ -176,6 +176,31 @@ inline const uint8_t *DecodeGroupVarInt32_SSE_Add(
   return src;
 }
 
+// Same as DecodeGroupVarInt32_SSE_Add, but returns the four decoded integers
+// in '*results' instead of extracting them one at a time. Callers which can
+// store the vector straight to its destination (e.g. with a single unaligned
+// store into a ColumnBlock) avoid the extracts altogether.
+//
+// NOTE: the src buffer must be have at least 17 bytes remaining in it, so this
+// code path is not usable at the end of a block.
+inline const uint8_t *DecodeGroupVarInt32_SSE_AddVector(
+  const uint8_t *src,
+  __m128i add,
+  __m128i *results) {
+
+  DCHECK(SSE_TABLE_INITTED);
+
+  uint8_t sel_byte = *src++;
+  __m128i shuffle_mask = _mm_load_si128(
+    reinterpret_cast<__m128i *>(&SSE_TABLE[sel_byte * 16]));
+  __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+
+  *results = _mm_add_epi32(_mm_shuffle_epi8(data, shuffle_mask), add);
+
+  src += VARINT_SELECTOR_LENGTHS[sel_byte];
+  return src;
+}
+
 
 // Append a set of group-varint encoded integers to the given faststring.
 inline void AppendGroupVarInt32(
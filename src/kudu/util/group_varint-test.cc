@@ -60,6 +60,18 @@ static void DoTestRoundTripGVI32(
   ASSERT_EQ(c, ret[2]);
   ASSERT_EQ(d, ret[3]);
   ASSERT_EQ(end, buf.data() + real_size);
+
+  if (use_sse) {
+    // The vector variant also adds its frame of reference to each int.
+    __m128i results;
+    end = DecodeGroupVarInt32_SSE_AddVector(buf.data(), _mm_set1_epi32(1), &results);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(ret), results);
+    ASSERT_EQ(a + 1, ret[0]);
+    ASSERT_EQ(b + 1, ret[1]);
+    ASSERT_EQ(c + 1, ret[2]);
+    ASSERT_EQ(d + 1, ret[3]);
+    ASSERT_EQ(end, buf.data() + real_size);
+  }
 }
 
 
@@ -73,7 +73,8 @@ static const int kExpectedSum =
 static const int kExpectedMax = 1000000;
 static const int kExpectedCount = 100;
 static const int kExpectedMin = 10;
-static void load_percentiles(HdrHistogram* hist) {
+template<class Histogram>
+static void load_percentiles(Histogram* hist) {
   hist->IncrementBy(10, 80);
   hist->IncrementBy(100, 10);
   hist->IncrementBy(1000, 5);
@@ -110,4 +111,33 @@ TEST_F(HdrHistogramTest, PercentileAndCopyTest) {
   ASSERT_EQ(hist.TotalSum(), copy.TotalSum());
 }
 
+TEST_F(HdrHistogramTest, MergeTest) {
+  uint64_t specified_max = 10000;
+  HdrHistogram hist(specified_max, kSigDigits);
+  load_percentiles(&hist);
+
+  // Merging into an empty histogram makes a copy.
+  HdrHistogram merged(specified_max, kSigDigits);
+  merged.MergeFrom(hist);
+  NO_FATALS(validate_percentiles(&merged, specified_max));
+  ASSERT_EQ(hist.TotalSum(), merged.TotalSum());
+  ASSERT_EQ(hist.MinValue(), merged.MinValue());
+  ASSERT_EQ(hist.MaxValue(), merged.MaxValue());
+
+  // Merging again doubles the counts, but leaves the percentiles alone.
+  merged.MergeFrom(hist);
+  NO_FATALS(validate_percentiles(&merged, specified_max));
+  ASSERT_EQ(hist.TotalCount() * 2, merged.TotalCount());
+  ASSERT_EQ(hist.TotalSum() * 2, merged.TotalSum());
+
+  // A sharded histogram reads back the same as a plain one.
+  ShardedHdrHistogram sharded(specified_max, kSigDigits);
+  load_percentiles(&sharded);
+  HdrHistogram snapshot(specified_max, kSigDigits);
+  sharded.MergeInto(&snapshot);
+  NO_FATALS(validate_percentiles(&snapshot, specified_max));
+  ASSERT_EQ(hist.TotalCount(), sharded.TotalCount());
+  ASSERT_EQ(hist.ValueAtPercentile(90), sharded.ValueAtPercentile(90));
+}
+
 } // namespace kudu
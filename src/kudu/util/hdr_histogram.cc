@@ -26,9 +26,11 @@
 #include <algorithm>
 #include <cmath>
 #include <limits>
+#include <vector>
 
 #include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/bits.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/status.h"
 
@@ -37,6 +39,7 @@ using base::subtle::NoBarrier_AtomicIncrement;
 using base::subtle::NoBarrier_Store;
 using base::subtle::NoBarrier_Load;
 using base::subtle::NoBarrier_CompareAndSwap;
+using std::vector;
 using strings::Substitute;
 
 namespace kudu {
@@ -184,6 +187,36 @@ void HdrHistogram::IncrementBy(int64_t value, int64_t count) {
   }
 }
 
+void HdrHistogram::MergeFrom(const HdrHistogram& other) {
+  DCHECK_EQ(highest_trackable_value_, other.highest_trackable_value_);
+  DCHECK_EQ(num_significant_digits_, other.num_significant_digits_);
+  if (other.TotalCount() == 0) {
+    return;
+  }
+  // As when copying, the total is kept consistent with the merged counts.
+  NoBarrier_AtomicIncrement(&total_sum_, NoBarrier_Load(&other.total_sum_));
+  Atomic64 other_min = NoBarrier_Load(&other.min_value_);
+  uint64_t total_merged_count = 0;
+  for (int i = 0; i < counts_array_length_; i++) {
+    uint64_t count = NoBarrier_Load(&other.counts_[i]);
+    if (count > 0) {
+      NoBarrier_AtomicIncrement(&counts_[i], count);
+      total_merged_count += count;
+    }
+  }
+  Atomic64 other_max = NoBarrier_Load(&other.max_value_);
+  NoBarrier_AtomicIncrement(&total_count_, total_merged_count);
+
+  Atomic64 min_val;
+  while (other_min < (min_val = NoBarrier_Load(&min_value_))) {
+    if (NoBarrier_CompareAndSwap(&min_value_, min_val, other_min) == min_val) break;
+  }
+  Atomic64 max_val;
+  while (other_max > (max_val = NoBarrier_Load(&max_value_))) {
+    if (NoBarrier_CompareAndSwap(&max_value_, max_val, other_max) == max_val) break;
+  }
+}
+
 void HdrHistogram::IncrementWithExpectedInterval(int64_t value,
                                                  int64_t expected_interval_between_samples) {
   Increment(value);
@@ -320,6 +353,118 @@ uint64_t HdrHistogram::ValueAtPercentile(double percentile) const {
   return 0;
 }
 
+///////////////////////////////////////////////////////////////////////
+// ShardedHdrHistogram
+///////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// The index of the calling thread, used to pick its shards. Threads are
+// numbered in the order of their first recording, so that as many of them
+// as there are shards each get their own.
+__thread int64_t shard_thread_index = -1;
+Atomic64 next_shard_thread_index = 0;
+
+} // anonymous namespace
+
+ShardedHdrHistogram::ShardedHdrHistogram(uint64_t highest_trackable_value,
+                                         int num_significant_digits)
+  : highest_trackable_value_(highest_trackable_value),
+    num_significant_digits_(num_significant_digits),
+    num_shards_(base::NumCPUs()),
+    shards_(new Atomic64[num_shards_]()) {
+  CHECK(HdrHistogram::IsValidHighestTrackableValue(highest_trackable_value));
+  CHECK(HdrHistogram::IsValidNumSignificantDigits(num_significant_digits));
+}
+
+ShardedHdrHistogram::~ShardedHdrHistogram() {
+  for (int i = 0; i < num_shards_; i++) {
+    delete shard(i);
+  }
+}
+
+HdrHistogram* ShardedHdrHistogram::GetShard() {
+  if (PREDICT_FALSE(shard_thread_index < 0)) {
+    shard_thread_index = NoBarrier_AtomicIncrement(&next_shard_thread_index, 1) - 1;
+  }
+  Atomic64* slot = &shards_[shard_thread_index % num_shards_];
+  HdrHistogram* shard = reinterpret_cast<HdrHistogram*>(base::subtle::Acquire_Load(slot));
+  if (PREDICT_TRUE(shard != nullptr)) {
+    return shard;
+  }
+  gscoped_ptr<HdrHistogram> new_shard(
+      new HdrHistogram(highest_trackable_value_, num_significant_digits_));
+  Atomic64 old = base::subtle::Release_CompareAndSwap(
+      slot, 0, reinterpret_cast<Atomic64>(new_shard.get()));
+  if (old != 0) {
+    // Another thread of the same shard won the race.
+    return reinterpret_cast<HdrHistogram*>(old);
+  }
+  return new_shard.release();
+}
+
+void ShardedHdrHistogram::IncrementBy(int64_t value, int64_t count) {
+  GetShard()->IncrementBy(value, count);
+}
+
+uint64_t ShardedHdrHistogram::TotalCount() const {
+  uint64_t count = 0;
+  for (int i = 0; i < num_shards_; i++) {
+    const HdrHistogram* s = shard(i);
+    if (s) {
+      count += s->TotalCount();
+    }
+  }
+  return count;
+}
+
+uint64_t ShardedHdrHistogram::ValueAtPercentile(double percentile) const {
+  // Same as HdrHistogram::ValueAtPercentile(), summing the counts of the
+  // shards rather than merging them into a new histogram.
+  vector<const HdrHistogram*> shards;
+  uint64_t count = 0;
+  for (int i = 0; i < num_shards_; i++) {
+    const HdrHistogram* s = shard(i);
+    if (s) {
+      shards.push_back(s);
+      count += s->TotalCount();
+    }
+  }
+  if (PREDICT_FALSE(count == 0)) return 0;
+
+  double requested_percentile = std::min(percentile, 100.0);
+  uint64_t count_at_percentile =
+    static_cast<uint64_t>(((requested_percentile / 100.0) * count) + 0.5);
+  count_at_percentile = std::max(count_at_percentile, static_cast<uint64_t>(1));
+
+  const HdrHistogram* first = shards[0];
+  uint64_t total_to_current_iJ = 0;
+  for (int i = 0; i < first->bucket_count_; i++) {
+    int j = (i == 0) ? 0 : (first->sub_bucket_count_ / 2);
+    for (; j < first->sub_bucket_count_; j++) {
+      for (const HdrHistogram* s : shards) {
+        total_to_current_iJ += s->CountAt(i, j);
+      }
+      if (total_to_current_iJ >= count_at_percentile) {
+        return HdrHistogram::ValueFromIndex(i, j);
+      }
+    }
+  }
+  // The counts of the shards are read after their totals, so they can only
+  // have grown meanwhile.
+  LOG(DFATAL) << "Fell through while iterating, likely concurrent modification of histogram";
+  return 0;
+}
+
+void ShardedHdrHistogram::MergeInto(HdrHistogram* histogram) const {
+  for (int i = 0; i < num_shards_; i++) {
+    const HdrHistogram* s = shard(i);
+    if (s) {
+      histogram->MergeFrom(*s);
+    }
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////
 // AbstractHistogramIterator
 ///////////////////////////////////////////////////////////////////////
@@ -88,6 +88,10 @@ class HdrHistogram {
   void Increment(int64_t value);
   void IncrementBy(int64_t value, int64_t count);
 
+  // Add the values recorded in 'other', which must have the same
+  // configuration. Like copying, this is not a consistent snapshot of 'other'.
+  void MergeFrom(const HdrHistogram& other);
+
   // Record new data, correcting for "coordinated omission".
   //
   // See https://groups.google.com/d/msg/mechanical-sympathy/icNZJejUHfE/BfDekfBEs_sJ
@@ -169,6 +173,7 @@ class HdrHistogram {
 
  private:
   friend class AbstractHistogramIterator;
+  friend class ShardedHdrHistogram;
 
   static const uint64_t kMinHighestTrackableValue = 2;
   static const int kMinValidNumSignificantDigits = 1;
@@ -198,6 +203,58 @@ class HdrHistogram {
   HdrHistogram& operator=(const HdrHistogram& other); // Disable assignment operator.
 };
 
+// A histogram for values recorded concurrently by many threads.
+//
+// Every HdrHistogram update touches its shared total count, sum and counts
+// array, so a histogram updated by all cores, such as the latency of every
+// RPC, bounces those cache lines around. This one instead records into one
+// of several HdrHistogram shards chosen by a hash of the recording thread,
+// as Striped64 does for counters, so that the shards' cache lines mostly
+// stay with the core of their thread. The shards are only merged when the
+// histogram is read.
+//
+// Shards are allocated on their first use, so a histogram only recorded by
+// a few threads costs only a few shards.
+class ShardedHdrHistogram {
+ public:
+  ShardedHdrHistogram(uint64_t highest_trackable_value, int num_significant_digits);
+  ~ShardedHdrHistogram();
+
+  // Record new data.
+  void Increment(int64_t value) { IncrementBy(value, 1); }
+  void IncrementBy(int64_t value, int64_t count);
+
+  uint64_t highest_trackable_value() const { return highest_trackable_value_; }
+  int num_significant_digits() const { return num_significant_digits_; }
+
+  // See HdrHistogram. These merge the shards as they're read, so they cost
+  // a pass over the counts of every allocated shard.
+  uint64_t TotalCount() const;
+  uint64_t ValueAtPercentile(double percentile) const;
+
+  // Add the values recorded in all of the shards to 'histogram', which must
+  // have the same configuration. The result is not a consistent snapshot.
+  void MergeInto(HdrHistogram* histogram) const;
+
+ private:
+  // Returns the shard of the calling thread, allocating it if needed.
+  HdrHistogram* GetShard();
+
+  // Returns shard 'i', or nullptr if it wasn't allocated.
+  const HdrHistogram* shard(int i) const {
+    return reinterpret_cast<const HdrHistogram*>(base::subtle::Acquire_Load(&shards_[i]));
+  }
+
+  const uint64_t highest_trackable_value_;
+  const int num_significant_digits_;
+  const int num_shards_;
+
+  // The HdrHistogram* of each shard, or null if it wasn't allocated.
+  gscoped_array<base::subtle::Atomic64> shards_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShardedHdrHistogram);
+};
+
 // Value returned from iterators.
 struct HistogramIterationValue {
   HistogramIterationValue()
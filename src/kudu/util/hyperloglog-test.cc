@@ -0,0 +1,96 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <string>
+
+#include "kudu/gutil/hash/city.h"
+#include "kudu/util/hyperloglog.h"
+#include "kudu/util/test_macros.h"
+
+using std::string;
+
+namespace kudu {
+
+static void AddValues(int64_t start, int64_t count, HyperLogLog* hll) {
+  for (int64_t i = start; i < start + count; i++) {
+    hll->AddHash(util_hash::CityHash64(reinterpret_cast<const char*>(&i), sizeof(i)));
+  }
+}
+
+// Assert that the estimate of 'hll' is within 'tolerance' of 'expected'.
+static void AssertEstimateNear(int64_t expected, double tolerance, const HyperLogLog& hll) {
+  int64_t estimate = hll.Estimate();
+  SCOPED_TRACE(estimate);
+  ASSERT_LE(std::abs(estimate - expected), std::max(1.0, expected * tolerance));
+}
+
+TEST(TestHyperLogLog, TestEstimates) {
+  for (int64_t n : { 0, 1, 10, 1000, 10000, 1000000 }) {
+    SCOPED_TRACE(n);
+    HyperLogLog hll;
+    AddValues(0, n, &hll);
+    // Five standard errors of the default precision.
+    NO_FATALS(AssertEstimateNear(n, 0.08, hll));
+
+    // Adding the same values again does not change the estimate.
+    int64_t estimate = hll.Estimate();
+    AddValues(0, n, &hll);
+    ASSERT_EQ(estimate, hll.Estimate());
+  }
+}
+
+TEST(TestHyperLogLog, TestMerge) {
+  HyperLogLog a;
+  HyperLogLog b;
+  HyperLogLog both;
+  AddValues(0, 60000, &a);
+  AddValues(40000, 60000, &b);
+  AddValues(0, 100000, &both);
+  ASSERT_OK(a.Merge(b));
+  ASSERT_EQ(both.Estimate(), a.Estimate());
+  ASSERT_EQ(both.registers(), a.registers());
+
+  HyperLogLog other_precision(HyperLogLog::kDefaultPrecision + 1);
+  Status s = a.Merge(other_precision);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+}
+
+TEST(TestHyperLogLog, TestParse) {
+  HyperLogLog hll(HyperLogLog::kMinPrecision);
+  AddValues(0, 1000, &hll);
+
+  HyperLogLog parsed;
+  ASSERT_OK(HyperLogLog::Parse(hll.registers(), &parsed));
+  ASSERT_EQ(HyperLogLog::kMinPrecision, parsed.precision());
+  ASSERT_EQ(hll.Estimate(), parsed.Estimate());
+
+  // The number of registers must be a supported power of two.
+  string registers = hll.registers().ToString();
+  Status s = HyperLogLog::Parse(Slice(registers.data(), registers.size() - 1), &parsed);
+  ASSERT_TRUE(s.IsCorruption()) << s.ToString();
+  s = HyperLogLog::Parse(Slice(registers.data(), registers.size() / 2), &parsed);
+  ASSERT_TRUE(s.IsCorruption()) << s.ToString();
+
+  // No register can exceed the number of hash bits it is computed from.
+  registers[0] = 64;
+  s = HyperLogLog::Parse(Slice(registers), &parsed);
+  ASSERT_TRUE(s.IsCorruption()) << s.ToString();
+}
+
+} // namespace kudu
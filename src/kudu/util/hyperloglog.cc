@@ -0,0 +1,110 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/hyperloglog.h"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+
+#include "kudu/gutil/bits.h"
+#include "kudu/gutil/strings/substitute.h"
+
+using strings::Substitute;
+
+namespace kudu {
+
+HyperLogLog::HyperLogLog(int precision)
+  : precision_(precision),
+    registers_(1 << precision, 0) {
+  DCHECK_GE(precision, kMinPrecision);
+  DCHECK_LE(precision, kMaxPrecision);
+}
+
+Status HyperLogLog::Parse(const Slice& registers, HyperLogLog* sketch) {
+  const size_t size = registers.size();
+  if ((size & (size - 1)) != 0 ||
+      size < (1 << kMinPrecision) || size > (1 << kMaxPrecision)) {
+    return Status::Corruption(
+        Substitute("invalid HyperLogLog sketch size: $0 registers", size));
+  }
+  const int precision = Bits::Log2Floor(size);
+  // A register holds the position of the first set bit of the hash bits
+  // which do not select the register.
+  const uint8_t max_rank = 64 - precision + 1;
+  for (size_t i = 0; i < size; i++) {
+    if (PREDICT_FALSE(registers[i] > max_rank)) {
+      return Status::Corruption(
+          Substitute("invalid HyperLogLog register value $0 at index $1", registers[i], i));
+    }
+  }
+  sketch->precision_ = precision;
+  sketch->registers_.assign(registers.data(), registers.data() + size);
+  return Status::OK();
+}
+
+void HyperLogLog::AddHash(uint64_t hash) {
+  // The top bits of the hash select the register, and the rest are used to
+  // compute the rank. The sentinel bit caps the rank at 64 - precision + 1.
+  const uint32_t idx = hash >> (64 - precision_);
+  const uint64_t rest = (hash << precision_) | (1ULL << (precision_ - 1));
+  const uint8_t rank = __builtin_clzll(rest) + 1;
+  registers_[idx] = std::max(registers_[idx], rank);
+}
+
+Status HyperLogLog::Merge(const HyperLogLog& other) {
+  if (PREDICT_FALSE(other.precision_ != precision_)) {
+    return Status::InvalidArgument(
+        Substitute("cannot merge HyperLogLog sketches of precision $0 and $1",
+                   precision_, other.precision_));
+  }
+  for (size_t i = 0; i < registers_.size(); i++) {
+    registers_[i] = std::max(registers_[i], other.registers_[i]);
+  }
+  return Status::OK();
+}
+
+int64_t HyperLogLog::Estimate() const {
+  const double m = registers_.size();
+  double alpha;
+  switch (registers_.size()) {
+    case 16: alpha = 0.673; break;
+    case 32: alpha = 0.697; break;
+    case 64: alpha = 0.709; break;
+    default: alpha = 0.7213 / (1 + 1.079 / m); break;
+  }
+
+  double sum = 0;
+  int num_zeros = 0;
+  for (uint8_t r : registers_) {
+    sum += std::ldexp(1.0, -r);
+    if (r == 0) {
+      num_zeros++;
+    }
+  }
+  double estimate = alpha * m * m / sum;
+
+  // The raw estimate is biased for small cardinalities, for which linear
+  // counting over the empty registers is more accurate. The 64-bit hash makes
+  // the large range correction of the original paper unnecessary.
+  if (estimate <= 2.5 * m && num_zeros > 0) {
+    estimate = m * std::log(m / num_zeros);
+  }
+  return std::llround(estimate);
+}
+
+} // namespace kudu
@@ -0,0 +1,75 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_UTIL_HYPERLOGLOG_H
+#define KUDU_UTIL_HYPERLOGLOG_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+// A HyperLogLog sketch, which estimates the number of distinct values added
+// to it in a fixed amount of memory (Flajolet et al., "HyperLogLog: the
+// analysis of a near-optimal cardinality estimation algorithm", 2007).
+//
+// The sketch has 2^precision one-byte registers. Its relative standard error
+// is about 1.04 / sqrt(2^precision): 1.6% for the default precision of 12.
+//
+// Sketches of the same precision can be merged, which yields the sketch of
+// the union of their values.
+class HyperLogLog {
+ public:
+  static const int kMinPrecision = 4;
+  static const int kMaxPrecision = 16;
+  static const int kDefaultPrecision = 12;
+
+  explicit HyperLogLog(int precision = kDefaultPrecision);
+
+  // Parse a sketch serialized as its registers() into 'sketch'.
+  static Status Parse(const Slice& registers, HyperLogLog* sketch);
+
+  // Add a value, given its 64-bit hash. The hash function must mix its input
+  // well, e.g. CityHash64.
+  void AddHash(uint64_t hash);
+
+  // Merge 'other' into this sketch. Returns InvalidArgument if the sketches
+  // have different precisions.
+  Status Merge(const HyperLogLog& other);
+
+  // Return the estimated number of distinct values added to the sketch.
+  int64_t Estimate() const;
+
+  int precision() const {
+    return precision_;
+  }
+
+  // Return the registers of the sketch, which are also its serialized form.
+  Slice registers() const {
+    return Slice(registers_.data(), registers_.size());
+  }
+
+ private:
+  int precision_;
+  std::vector<uint8_t> registers_;
+};
+
+} // namespace kudu
+
+#endif
@@ -34,6 +34,12 @@ using std::shared_ptr;
 using std::vector;
 using strings::Substitute;
 
+DECLARE_bool(maintenance_manager_adaptive);
+DECLARE_int32(maintenance_manager_adjustment_interval_ms);
+DECLARE_int32(maintenance_manager_max_ops_per_io_target);
+DECLARE_int32(maintenance_manager_max_threads);
+DECLARE_int32(maintenance_manager_reserved_threads);
+
 METRIC_DEFINE_entity(test);
 METRIC_DEFINE_gauge_uint32(test, maintenance_ops_running,
                            "Number of Maintenance Operations Running",
@@ -152,8 +158,18 @@ class TestMaintenanceOp : public MaintenanceOp {
     return maintenance_ops_running_;
   }
 
+  virtual std::string io_target() const OVERRIDE {
+    std::lock_guard<Mutex> guard(lock_);
+    return io_target_;
+  }
+
+  void set_io_target(const std::string& io_target) {
+    std::lock_guard<Mutex> guard(lock_);
+    io_target_ = io_target;
+  }
+
  private:
-  Mutex lock_;
+  mutable Mutex lock_;
 
   ScopedTrackedConsumption consumption_;
   uint64_t logs_retained_bytes_;
@@ -169,6 +185,8 @@ class TestMaintenanceOp : public MaintenanceOp {
 
   // The amount of time each op invocation will sleep.
   MonoDelta sleep_time_;
+
+  std::string io_target_;
 };
 
 // Create an op and wait for it to start running.  Unregister it while it is
@@ -299,4 +317,150 @@ TEST_F(MaintenanceManagerTest, TestCompletedOpsHistory) {
   }
 }
 
+// Test that ops which don't free memory can't take the threads reserved for
+// those that do.
+TEST_F(MaintenanceManagerTest, TestReservedThreads) {
+  // The manager has two threads, one of which is reserved by default.
+  TestMaintenanceOp perf_op1("perf_op1", MaintenanceOp::HIGH_IO_USAGE, test_tracker_);
+  TestMaintenanceOp perf_op2("perf_op2", MaintenanceOp::HIGH_IO_USAGE, test_tracker_);
+  for (TestMaintenanceOp* op : { &perf_op1, &perf_op2 }) {
+    op->set_ram_anchored(0);
+    op->set_perf_improvement(1);
+    op->set_sleep_time(MonoDelta::FromSeconds(1));
+  }
+  manager_->RegisterOp(&perf_op1);
+  manager_->RegisterOp(&perf_op2);
+  AssertEventually([&]() {
+      ASSERT_EQ(1, perf_op1.RunningGauge()->value() + perf_op2.RunningGauge()->value());
+    });
+
+  // An op freeing log retention may still run alongside.
+  TestMaintenanceOp reclaim_op("reclaim_op", MaintenanceOp::HIGH_IO_USAGE, test_tracker_);
+  reclaim_op.set_ram_anchored(0);
+  reclaim_op.set_logs_retained_bytes(100);
+  reclaim_op.set_sleep_time(MonoDelta::FromMilliseconds(100));
+  manager_->RegisterOp(&reclaim_op);
+  AssertEventually([&]() {
+      ASSERT_EQ(1, reclaim_op.DurationHistogram()->TotalCount());
+    });
+  ASSERT_EQ(1, perf_op1.DurationHistogram()->TotalCount() +
+               perf_op2.DurationHistogram()->TotalCount() +
+               perf_op1.RunningGauge()->value() + perf_op2.RunningGauge()->value());
+
+  manager_->UnregisterOp(&reclaim_op);
+  manager_->UnregisterOp(&perf_op1);
+  manager_->UnregisterOp(&perf_op2);
+}
+
+// Test that ops against the same IO target are limited, and that the
+// per-class queueing statistics are reported.
+TEST_F(MaintenanceManagerTest, TestMaxOpsPerIOTarget) {
+  manager_->Shutdown();
+  FLAGS_maintenance_manager_max_ops_per_io_target = 1;
+  FLAGS_maintenance_manager_reserved_threads = 0;
+  MaintenanceManager::Options options;
+  options.num_threads = 3;
+  options.polling_interval_ms = 1;
+  options.parent_mem_tracker = test_tracker_;
+  manager_.reset(new MaintenanceManager(options));
+  ASSERT_OK(manager_->Init());
+
+  TestMaintenanceOp op_a1("op_a1", MaintenanceOp::HIGH_IO_USAGE, test_tracker_);
+  TestMaintenanceOp op_a2("op_a2", MaintenanceOp::HIGH_IO_USAGE, test_tracker_);
+  TestMaintenanceOp op_b("op_b", MaintenanceOp::HIGH_IO_USAGE, test_tracker_);
+  for (TestMaintenanceOp* op : { &op_a1, &op_a2, &op_b }) {
+    op->set_ram_anchored(0);
+    op->set_perf_improvement(1);
+    op->set_sleep_time(MonoDelta::FromMilliseconds(200));
+    manager_->RegisterOp(op);
+  }
+  op_a1.set_io_target("a");
+  op_a2.set_io_target("a");
+  op_b.set_io_target("b");
+
+  AssertEventually([&]() {
+      ASSERT_EQ(1, op_a1.DurationHistogram()->TotalCount());
+      ASSERT_EQ(1, op_a2.DurationHistogram()->TotalCount());
+      ASSERT_EQ(1, op_b.DurationHistogram()->TotalCount());
+      ASSERT_LE(op_a1.RunningGauge()->value() + op_a2.RunningGauge()->value(), 1);
+    });
+
+  MaintenanceManagerStatusPB status_pb;
+  manager_->GetMaintenanceManagerStatusDump(&status_pb);
+  bool found_perf_class = false;
+  for (const auto& class_pb : status_pb.op_classes()) {
+    if (class_pb.name() == "perf") {
+      found_perf_class = true;
+      ASSERT_EQ(3, class_pb.launched());
+      ASSERT_GT(class_pb.max_queue_time_micros(), 0);
+    }
+  }
+  ASSERT_TRUE(found_perf_class);
+
+  for (TestMaintenanceOp* op : { &op_a1, &op_a2, &op_b }) {
+    manager_->UnregisterOp(op);
+  }
+}
+
+// Test that the adaptive manager adds threads while ops wait for them and
+// removes them once idle, and scales the flush thresholds with the memory
+// pressure.
+TEST_F(MaintenanceManagerTest, TestAdaptiveThreadsAndFlushThresholds) {
+  manager_->Shutdown();
+  FLAGS_maintenance_manager_adaptive = true;
+  FLAGS_maintenance_manager_max_threads = 3;
+  FLAGS_maintenance_manager_reserved_threads = 0;
+  FLAGS_maintenance_manager_adjustment_interval_ms = 10;
+  shared_ptr<MemTracker> tracker = MemTracker::CreateTracker(1000 * 1000, "adaptive");
+  MaintenanceManager::Options options;
+  options.num_threads = 1;
+  options.polling_interval_ms = 1;
+  options.parent_mem_tracker = tracker;
+  manager_.reset(new MaintenanceManager(options));
+  ASSERT_OK(manager_->Init());
+
+  TestMaintenanceOp op1("op1", MaintenanceOp::HIGH_IO_USAGE, tracker);
+  TestMaintenanceOp op2("op2", MaintenanceOp::HIGH_IO_USAGE, tracker);
+  TestMaintenanceOp op3("op3", MaintenanceOp::HIGH_IO_USAGE, tracker);
+  for (TestMaintenanceOp* op : { &op1, &op2, &op3 }) {
+    op->set_ram_anchored(0);
+    op->set_perf_improvement(1);
+    op->set_sleep_time(MonoDelta::FromMilliseconds(500));
+    manager_->RegisterOp(op);
+  }
+
+  // The ops don't all fit on the single thread, so more are added.
+  AssertEventually([&]() {
+      ASSERT_GE(op1.RunningGauge()->value() + op2.RunningGauge()->value() +
+                op3.RunningGauge()->value(), 2);
+    });
+  AssertEventually([&]() {
+      ASSERT_EQ(1, op1.DurationHistogram()->TotalCount());
+      ASSERT_EQ(1, op2.DurationHistogram()->TotalCount());
+      ASSERT_EQ(1, op3.DurationHistogram()->TotalCount());
+    });
+
+  // Once idle with plenty of memory, the threads are removed again and the
+  // flush thresholds are raised.
+  AssertEventually([&]() {
+      MaintenanceManagerStatusPB status_pb;
+      manager_->GetMaintenanceManagerStatusDump(&status_pb);
+      ASSERT_EQ(1, status_pb.num_threads());
+      ASSERT_GT(status_pb.flush_threshold_scale(), 1);
+      ASSERT_GT(status_pb.adjustments_size(), 0);
+    });
+
+  // Under memory pressure, they're lowered.
+  ScopedTrackedConsumption consumption(tracker, 700 * 1000);
+  AssertEventually([&]() {
+      MaintenanceManagerStatusPB status_pb;
+      manager_->GetMaintenanceManagerStatusDump(&status_pb);
+      ASSERT_LT(status_pb.flush_threshold_scale(), 1);
+    });
+
+  for (TestMaintenanceOp* op : { &op1, &op2, &op3 }) {
+    manager_->UnregisterOp(op);
+  }
+}
+
 } // namespace kudu
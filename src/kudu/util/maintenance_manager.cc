@@ -17,13 +17,16 @@
 
 #include "kudu/util/maintenance_manager.h"
 
+#include <algorithm>
 #include <gflags/gflags.h>
 #include <memory>
 #include <stdint.h>
 #include <string>
 #include <utility>
 
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/debug/trace_logging.h"
@@ -36,6 +39,8 @@
 
 using std::pair;
 using std::shared_ptr;
+using std::string;
+using std::vector;
 using strings::Substitute;
 
 DEFINE_int32(maintenance_manager_num_threads, 1,
@@ -44,6 +49,38 @@ DEFINE_int32(maintenance_manager_num_threads, 1,
              "not be above the number of devices.");
 TAG_FLAG(maintenance_manager_num_threads, stable);
 
+DEFINE_bool(maintenance_manager_adaptive, false,
+            "Whether the maintenance manager adapts to the load. If set, it varies the "
+            "number of threads operations may use between --maintenance_manager_num_threads "
+            "and --maintenance_manager_max_threads according to the backlog of operations, "
+            "and scales the tablets' flush thresholds according to the memory pressure, so "
+            "that larger rowsets are flushed while memory is plentiful.");
+TAG_FLAG(maintenance_manager_adaptive, experimental);
+
+DEFINE_int32(maintenance_manager_max_threads, 0,
+             "Maximum number of threads the maintenance manager may use when "
+             "--maintenance_manager_adaptive is set. 0 means twice "
+             "--maintenance_manager_num_threads.");
+TAG_FLAG(maintenance_manager_max_threads, experimental);
+
+DEFINE_int32(maintenance_manager_adjustment_interval_ms, 10000,
+             "Interval at which the adaptive maintenance manager reconsiders its number "
+             "of threads and flush thresholds, in milliseconds.");
+TAG_FLAG(maintenance_manager_adjustment_interval_ms, hidden);
+
+DEFINE_int32(maintenance_manager_reserved_threads, 1,
+             "Number of maintenance manager threads reserved for operations which "
+             "free memory or log retention, such as flushes, so that long compactions "
+             "can't hold all of the threads. At least one thread is always left for "
+             "other operations.");
+TAG_FLAG(maintenance_manager_reserved_threads, advanced);
+
+DEFINE_int32(maintenance_manager_max_ops_per_io_target, 0,
+             "Maximum number of maintenance operations which don't free memory or log "
+             "retention, such as compactions, that may run against the same storage at "
+             "once. 0 means no limit.");
+TAG_FLAG(maintenance_manager_max_ops_per_io_target, advanced);
+
 DEFINE_int32(maintenance_manager_polling_interval_ms, 250,
        "Polling interval for the maintenance manager scheduler, "
        "in milliseconds.");
@@ -59,6 +96,21 @@ TAG_FLAG(enable_maintenance_manager, unsafe);
 
 namespace kudu {
 
+// Memory consumption, as a percentage of the limit, above which the adaptive
+// maintenance manager lowers the flush thresholds and below which it may
+// raise them.
+static const double kHighMemoryPressurePct = 60;
+static const double kLowMemoryPressurePct = 30;
+
+// Bounds of the flush threshold scale, and the factor by which it is raised
+// when there is little memory pressure. It is halved under memory pressure.
+static const double kMinFlushThresholdScale = 0.25;
+static const double kMaxFlushThresholdScale = 4;
+static const double kFlushThresholdScaleStep = 1.25;
+
+// The number of adaptive decisions kept for the status dump.
+static const int kAdjustmentHistorySize = 8;
+
 MaintenanceOpStats::MaintenanceOpStats() {
   Clear();
 }
@@ -83,6 +135,10 @@ MaintenanceOp::~MaintenanceOp() {
          << " Op before destroying it.";
 }
 
+double MaintenanceOp::flush_threshold_scale() const {
+  return manager_ ? manager_->flush_threshold_scale() : 1;
+}
+
 void MaintenanceOp::Unregister() {
   CHECK(manager_.get()) << "Op " << name_ << " was never registered.";
   manager_->UnregisterOp(this);
@@ -98,6 +154,17 @@ const MaintenanceManager::Options MaintenanceManager::DEFAULT_OPTIONS = {
 MaintenanceManager::MaintenanceManager(const Options& options)
   : num_threads_(options.num_threads <= 0 ?
       FLAGS_maintenance_manager_num_threads : options.num_threads),
+    max_threads_(!FLAGS_maintenance_manager_adaptive ? num_threads_ :
+        std::max(num_threads_, FLAGS_maintenance_manager_max_threads > 0 ?
+                 FLAGS_maintenance_manager_max_threads : 2 * num_threads_)),
+    num_active_threads_(num_threads_),
+    flush_threshold_scale_(1),
+    last_adjustment_time_(MonoTime::Now()),
+    adjustments_(kAdjustmentHistorySize),
+    adjustments_count_(0),
+    num_reserved_threads_(std::max(0, std::min(FLAGS_maintenance_manager_reserved_threads,
+                                               num_threads_ - 1))),
+    max_ops_per_io_target_(std::max(0, FLAGS_maintenance_manager_max_ops_per_io_target)),
     cond_(&lock_),
     shutdown_(false),
     running_ops_(0),
@@ -108,7 +175,7 @@ MaintenanceManager::MaintenanceManager(const Options& options)
     parent_mem_tracker_(!options.parent_mem_tracker ?
         MemTracker::GetRootTracker() : options.parent_mem_tracker) {
   CHECK_OK(ThreadPoolBuilder("MaintenanceMgr").set_min_threads(num_threads_)
-               .set_max_threads(num_threads_).Build(&thread_pool_));
+               .set_max_threads(max_threads_).Build(&thread_pool_));
   uint32_t history_size = options.history_size == 0 ?
                           FLAGS_maintenance_manager_history_size :
                           options.history_size;
@@ -197,6 +264,12 @@ void MaintenanceManager::RunSchedulerThread() {
       return;
     }
 
+    if (FLAGS_maintenance_manager_adaptive &&
+        MonoTime::Now().GetDeltaSince(last_adjustment_time_).ToMilliseconds() >=
+        FLAGS_maintenance_manager_adjustment_interval_ms) {
+      AdjustToLoad();
+    }
+
     // Find the best op.
     MaintenanceOp* op = FindBestOp();
     if (!op) {
@@ -205,26 +278,96 @@ void MaintenanceManager::RunSchedulerThread() {
     }
 
     // Prepare the maintenance operation.
-    op->running_++;
-    running_ops_++;
+    OpClass op_class = ClassifyOp(FindOrDie(ops_, op));
+    string io_target = op->io_target();
+    AddRunningOp(op, op_class, io_target);
     guard.unlock();
     bool ready = op->Prepare();
     guard.lock();
     if (!ready) {
       LOG(INFO) << "Prepare failed for " << op->name()
                 << ".  Re-running scheduler.";
-      op->running_--;
-      op->cond_->Signal();
+      RemoveRunningOp(op, op_class, io_target);
       continue;
     }
 
+    // Account for the time the op waited to run. Any further instance of it
+    // waits anew.
+    OpClassStats& class_stats = op_class_stats_[op_class];
+    int64_t queue_micros = 0;
+    if (op->runnable_since_.Initialized()) {
+      queue_micros = MonoTime::Now().GetDeltaSince(op->runnable_since_).ToMicroseconds();
+    }
+    class_stats.launched++;
+    class_stats.total_queue_micros += queue_micros;
+    class_stats.max_queue_micros = std::max(class_stats.max_queue_micros, queue_micros);
+    op->runnable_since_ = MonoTime();
+
     // Run the maintenance operation.
     Status s = thread_pool_->SubmitFunc(boost::bind(
-          &MaintenanceManager::LaunchOp, this, op));
+          &MaintenanceManager::LaunchOp, this, op, op_class, io_target));
     CHECK(s.ok());
   }
 }
 
+MaintenanceManager::OpClass MaintenanceManager::ClassifyOp(const MaintenanceOpStats& stats) {
+  if (stats.valid() && (stats.ram_anchored() > 0 || stats.logs_retained_bytes() > 0)) {
+    return kReclaimOpClass;
+  }
+  return kPerfOpClass;
+}
+
+const char* MaintenanceManager::OpClassName(OpClass op_class) {
+  switch (op_class) {
+    case kReclaimOpClass: return "reclaim";
+    case kPerfOpClass: return "perf";
+    default: LOG(FATAL) << "Unknown op class " << op_class;
+  }
+  return "";
+}
+
+bool MaintenanceManager::CanLaunch(const MaintenanceOp* op, OpClass op_class) const {
+  if (op_class == kReclaimOpClass) {
+    return true;
+  }
+  if (op_class_stats_[kPerfOpClass].running >= num_active_threads_ - num_reserved_threads_) {
+    return false;
+  }
+  if (max_ops_per_io_target_ > 0) {
+    string io_target = op->io_target();
+    if (!io_target.empty() &&
+        FindWithDefault(running_perf_ops_by_io_target_, io_target, 0) >= max_ops_per_io_target_) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void MaintenanceManager::AddRunningOp(MaintenanceOp* op, OpClass op_class,
+                                      const string& io_target) {
+  op->running_++;
+  running_ops_++;
+  op_class_stats_[op_class].running++;
+  if (op_class == kPerfOpClass && !io_target.empty()) {
+    running_perf_ops_by_io_target_[io_target]++;
+  }
+}
+
+void MaintenanceManager::RemoveRunningOp(MaintenanceOp* op, OpClass op_class,
+                                         const string& io_target) {
+  if (op_class == kPerfOpClass && !io_target.empty()) {
+    auto iter = running_perf_ops_by_io_target_.find(io_target);
+    DCHECK(iter != running_perf_ops_by_io_target_.end());
+    if (--iter->second == 0) {
+      running_perf_ops_by_io_target_.erase(iter);
+    }
+  }
+  op_class_stats_[op_class].running--;
+  running_ops_--;
+  op->running_--;
+  op->cond_->Signal();
+}
+
 // Finding the best operation goes through four filters:
 // - If there's an Op that we can run quickly that frees log retention, we run it.
 // - If we've hit the overall process memory limit (note: this includes memory that the Ops cannot
@@ -240,6 +383,10 @@ void MaintenanceManager::RunSchedulerThread() {
 //
 // In the third priority we're at a point where nothing's urgent and there's nothing we can run
 // quickly.
+//
+// Ops which don't free memory or log retention are only considered if there's a thread which
+// isn't reserved for those that do, and if fewer than --maintenance_manager_max_ops_per_io_target
+// of them are already running against the same storage; see CanLaunch().
 // TODO We currently optimize for freeing log retention but we could consider having some sort of
 // sliding priority between log retention and RAM usage. For example, is an Op that frees
 // 128MB of log retention and 12MB of RAM always better than an op that frees 12MB of log retention
@@ -251,8 +398,7 @@ MaintenanceOp* MaintenanceManager::FindBestOp() {
     VLOG_AND_TRACE("maintenance", 1) << "Maintenance manager is disabled. Doing nothing";
     return nullptr;
   }
-  size_t free_threads = num_threads_ - running_ops_;
-  if (free_threads == 0) {
+  if (running_ops_ >= static_cast<uint64_t>(num_active_threads_)) {
     VLOG_AND_TRACE("maintenance", 1) << "there are no free threads, so we can't run anything.";
     return nullptr;
   }
@@ -276,6 +422,13 @@ MaintenanceOp* MaintenanceManager::FindBestOp() {
     stats.Clear();
     op->UpdateStats(&stats);
     if (op->cancelled() || !stats.valid() || !stats.runnable()) {
+      op->runnable_since_ = MonoTime();
+      continue;
+    }
+    if (!op->runnable_since_.Initialized()) {
+      op->runnable_since_ = MonoTime::Now();
+    }
+    if (!CanLaunch(op, ClassifyOp(stats))) {
       continue;
     }
     if (stats.logs_retained_bytes() > low_io_most_logs_retained_bytes &&
@@ -353,18 +506,101 @@ MaintenanceOp* MaintenanceManager::FindBestOp() {
   return nullptr;
 }
 
-void MaintenanceManager::LaunchOp(MaintenanceOp* op) {
+void MaintenanceManager::AdjustToLoad() {
+  MonoTime now = MonoTime::Now();
+  MonoDelta interval = now.GetDeltaSince(last_adjustment_time_);
+  last_adjustment_time_ = now;
+
+  // Count the ops that FindBestOp() would run if it had the threads, and
+  // how long the longest-waiting of them has been runnable.
+  int num_waiting = 0;
+  MonoDelta max_wait = MonoDelta::FromSeconds(0);
+  for (const OpMapTy::value_type& val : ops_) {
+    const MaintenanceOp* op = val.first;
+    const MaintenanceOpStats& stats = val.second;
+    if (op->cancelled() || !stats.valid() || !stats.runnable() ||
+        (stats.perf_improvement() <= 0 && stats.logs_retained_bytes() <= 0)) {
+      continue;
+    }
+    num_waiting++;
+    if (op->runnable_since_.Initialized()) {
+      MonoDelta wait = now.GetDeltaSince(op->runnable_since_);
+      if (wait.MoreThan(max_wait)) {
+        max_wait = wait;
+      }
+    }
+  }
+
+  double memory_pct = 0;
+  if (parent_mem_tracker_->has_limit() && parent_mem_tracker_->limit() > 0) {
+    memory_pct = 100.0 * parent_mem_tracker_->consumption() / parent_mem_tracker_->limit();
+  }
+
+  // Add a thread while ops have waited for one for a whole interval, and
+  // remove one once nothing is waiting.
+  int32_t num_threads = num_active_threads_;
+  vector<string> reasons;
+  bool all_threads_busy = running_ops_ >= static_cast<uint64_t>(num_active_threads_);
+  if (num_waiting > 0 && all_threads_busy && max_wait.MoreThan(interval) &&
+      num_threads < max_threads_) {
+    num_threads++;
+    reasons.push_back(Substitute("$0 ops waiting for up to $1", num_waiting, max_wait.ToString()));
+  } else if (num_waiting == 0 && !all_threads_busy && num_threads > num_threads_) {
+    num_threads--;
+    reasons.push_back("no ops waiting");
+  }
+
+  // Flush earlier under memory pressure, and later while memory is plentiful
+  // and there's nothing else to do.
+  double scale = flush_threshold_scale_;
+  if (memory_pct >= kHighMemoryPressurePct) {
+    scale = std::max(kMinFlushThresholdScale, scale / 2);
+  } else if (memory_pct < kLowMemoryPressurePct && num_waiting == 0) {
+    scale = std::min(kMaxFlushThresholdScale, scale * kFlushThresholdScaleStep);
+  } else if (memory_pct >= kLowMemoryPressurePct && scale > 1) {
+    scale = std::max(1.0, scale / kFlushThresholdScaleStep);
+  } else if (memory_pct < kHighMemoryPressurePct && scale < 1) {
+    scale = std::min(1.0, scale * kFlushThresholdScaleStep);
+  }
+  if (scale != flush_threshold_scale_) {
+    reasons.push_back(StringPrintf("memory at %.1f%% of the limit", memory_pct));
+  }
+
+  if (reasons.empty()) {
+    return;
+  }
+  num_active_threads_ = num_threads;
+  flush_threshold_scale_ = scale;
+  Adjustment& adjustment = adjustments_[adjustments_count_ % adjustments_.size()];
+  adjustment.time = now;
+  adjustment.num_threads = num_threads;
+  adjustment.flush_threshold_scale = scale;
+  adjustment.reason = JoinStrings(reasons, ", ");
+  adjustments_count_++;
+  LOG(INFO) << Substitute("Maintenance manager now using $0 threads and a flush threshold "
+                          "scale of $1: $2", num_threads, scale, adjustment.reason);
+}
+
+void MaintenanceManager::LaunchOp(MaintenanceOp* op, OpClass op_class,
+                                  const string& io_target) {
   MonoTime start_time(MonoTime::Now());
   op->RunningGauge()->Increment();
 
   scoped_refptr<Trace> trace(new Trace);
+  Stopwatch cpu_sw(Stopwatch::THIS_THREAD);
+  cpu_sw.start();
   LOG_TIMING(INFO, Substitute("running $0", op->name())) {
     ADOPT_TRACE(trace.get());
     TRACE_EVENT1("maintenance", "MaintenanceManager::LaunchOp",
                  "name", op->name());
     op->Perform();
   }
+  cpu_sw.stop();
   LOG(INFO) << op->name() << " metrics: " << trace->MetricsAsJSON();
+  scoped_refptr<Counter> cpu_time = op->CpuTimeCounter();
+  if (cpu_time) {
+    cpu_time->IncrementBy((cpu_sw.elapsed().user + cpu_sw.elapsed().system) / 1000);
+  }
 
   op->RunningGauge()->Decrement();
   MonoTime end_time(MonoTime::Now());
@@ -379,9 +615,7 @@ void MaintenanceManager::LaunchOp(MaintenanceOp* op) {
 
   op->DurationHistogram()->Increment(delta.ToMilliseconds());
 
-  running_ops_--;
-  op->running_--;
-  op->cond_->Signal();
+  RemoveRunningOp(op, op_class, io_target);
 }
 
 void MaintenanceManager::GetMaintenanceManagerStatusDump(MaintenanceManagerStatusPB* out_pb) {
@@ -394,6 +628,10 @@ void MaintenanceManager::GetMaintenanceManagerStatusDump(MaintenanceManagerStatu
     MaintenanceOpStats& stat(val.second);
     op_pb->set_name(op->name());
     op_pb->set_running(op->running());
+    string io_target = op->io_target();
+    if (!io_target.empty()) {
+      op_pb->set_io_target(io_target);
+    }
     if (stat.valid()) {
       op_pb->set_runnable(stat.runnable());
       op_pb->set_ram_anchored_bytes(stat.ram_anchored());
@@ -425,6 +663,30 @@ void MaintenanceManager::GetMaintenanceManagerStatusDump(MaintenanceManagerStatu
       completed_pb->set_secs_since_start(delta.ToSeconds());
     }
   }
+
+  out_pb->set_num_threads(num_active_threads_);
+  out_pb->set_flush_threshold_scale(flush_threshold_scale_);
+  for (int n = 1; n <= adjustments_.size(); n++) {
+    int64_t i = adjustments_count_ - n;
+    if (i < 0) break;
+    const Adjustment& adjustment = adjustments_[i % adjustments_.size()];
+    MaintenanceManagerStatusPB_AdjustmentPB* adjustment_pb = out_pb->add_adjustments();
+    adjustment_pb->set_num_threads(adjustment.num_threads);
+    adjustment_pb->set_flush_threshold_scale(adjustment.flush_threshold_scale);
+    adjustment_pb->set_reason(adjustment.reason);
+    adjustment_pb->set_secs_since_adjustment(
+        MonoTime::Now().GetDeltaSince(adjustment.time).ToSeconds());
+  }
+
+  for (int i = 0; i < kNumOpClasses; i++) {
+    const OpClassStats& class_stats = op_class_stats_[i];
+    MaintenanceManagerStatusPB_OpClassPB* class_pb = out_pb->add_op_classes();
+    class_pb->set_name(OpClassName(static_cast<OpClass>(i)));
+    class_pb->set_running(class_stats.running);
+    class_pb->set_launched(class_stats.launched);
+    class_pb->set_total_queue_time_micros(class_stats.total_queue_micros);
+    class_pb->set_max_queue_time_micros(class_stats.max_queue_micros);
+  }
 }
 
 } // namespace kudu
@@ -39,6 +39,7 @@ namespace kudu {
 
 template<class T>
 class AtomicGauge;
+class Counter;
 class Histogram;
 class MaintenanceManager;
 class MemTracker;
@@ -172,6 +173,23 @@ class MaintenanceOp {
   // Returns the gauge for this op that tracks when this op is running. Cannot be NULL.
   virtual scoped_refptr<AtomicGauge<uint32_t> > RunningGauge() const = 0;
 
+  // Returns the counter for this op that tracks the CPU time spent performing
+  // it, in microseconds, or NULL if it isn't tracked.
+  virtual scoped_refptr<Counter> CpuTimeCounter() const { return nullptr; }
+
+  // Returns an identifier of the storage this op does most of its IO against,
+  // such as the data directories or the WAL directory, or an empty string if
+  // it isn't tied to any. The manager limits how many ops which don't free
+  // memory may run against the same target at once. This will be run under
+  // the MaintenanceManager lock, so it should be cheap.
+  virtual std::string io_target() const { return ""; }
+
+  // Returns the factor by which ops which free memory should scale the
+  // thresholds at which they consider themselves worth running, as adapted
+  // to the load by the manager this op is registered with. Returns 1 if the
+  // op isn't registered. Must only be called from UpdateStats().
+  double flush_threshold_scale() const;
+
   uint32_t running() { return running_; }
 
   std::string name() const { return name_; }
@@ -216,6 +234,10 @@ class MaintenanceOp {
   std::shared_ptr<MaintenanceManager> manager_;
 
   IOUsage io_usage_;
+
+  // When this op became runnable without being launched since, or
+  // uninitialized if it isn't runnable. Protected by the manager's lock.
+  MonoTime runnable_since_;
 };
 
 struct MaintenanceOpComparator {
@@ -261,6 +283,11 @@ class MaintenanceManager : public std::enable_shared_from_this<MaintenanceManage
 
   void GetMaintenanceManagerStatusDump(MaintenanceManagerStatusPB* out_pb);
 
+  // The factor by which ops which free memory should currently scale their
+  // thresholds. Always 1 unless --maintenance_manager_adaptive is set.
+  // Requires 'lock_', which is held while ops' stats are updated.
+  double flush_threshold_scale() const { return flush_threshold_scale_; }
+
   static const Options DEFAULT_OPTIONS;
 
  private:
@@ -268,14 +295,87 @@ class MaintenanceManager : public std::enable_shared_from_this<MaintenanceManage
   typedef std::map<MaintenanceOp*, MaintenanceOpStats,
           MaintenanceOpComparator> OpMapTy;
 
+  // Classes of ops which are scheduled with separate limits.
+  enum OpClass {
+    // Ops which free memory or log retention, such as flushes and log GC.
+    // They may use any thread, including the reserved ones.
+    kReclaimOpClass = 0,
+    // Everything else, run for their performance improvement. They may not
+    // use the reserved threads, and are limited per IO target.
+    kPerfOpClass = 1,
+    kNumOpClasses = 2
+  };
+
+  // Scheduling statistics of an op class.
+  struct OpClassStats {
+    OpClassStats() : running(0), launched(0), total_queue_micros(0), max_queue_micros(0) {}
+
+    int32_t running;
+    int64_t launched;
+    int64_t total_queue_micros;
+    int64_t max_queue_micros;
+  };
+
+  // A decision of the adaptive controller.
+  struct Adjustment {
+    MonoTime time;
+    int32_t num_threads;
+    double flush_threshold_scale;
+    std::string reason;
+  };
+
+  static OpClass ClassifyOp(const MaintenanceOpStats& stats);
+  static const char* OpClassName(OpClass op_class);
+
   void RunSchedulerThread();
 
   // find the best op, or null if there is nothing we want to run
   MaintenanceOp* FindBestOp();
 
-  void LaunchOp(MaintenanceOp* op);
+  // Returns true if the class and IO target limits allow another instance
+  // of 'op' to run now.
+  bool CanLaunch(const MaintenanceOp* op, OpClass op_class) const;
+
+  // Accounts for an instance of 'op' starting (or finishing) to run.
+  void AddRunningOp(MaintenanceOp* op, OpClass op_class, const std::string& io_target);
+  void RemoveRunningOp(MaintenanceOp* op, OpClass op_class, const std::string& io_target);
+
+  void LaunchOp(MaintenanceOp* op, OpClass op_class, const std::string& io_target);
 
+  // Grows or shrinks the number of threads ops may use, and scales the flush
+  // thresholds, according to the memory pressure and the backlog of ops seen
+  // by the latest FindBestOp().
+  void AdjustToLoad();
+
+  // The minimum and maximum number of threads ops may use.
   const int32_t num_threads_;
+  const int32_t max_threads_;
+
+  // The number of threads ops may currently use, between 'num_threads_' and
+  // 'max_threads_'.
+  int32_t num_active_threads_;
+
+  // See flush_threshold_scale().
+  double flush_threshold_scale_;
+
+  // When AdjustToLoad() last ran, and its most recent decisions as a
+  // circular buffer indexed like 'completed_ops_'.
+  MonoTime last_adjustment_time_;
+  std::vector<Adjustment> adjustments_;
+  int64_t adjustments_count_;
+
+  // The number of threads only ops of kReclaimOpClass may use.
+  const int32_t num_reserved_threads_;
+
+  // The number of ops of kPerfOpClass allowed to run against a single IO
+  // target at once, or 0 for no limit.
+  const int32_t max_ops_per_io_target_;
+
+  OpClassStats op_class_stats_[kNumOpClasses];
+
+  // The number of ops of kPerfOpClass running against each IO target.
+  std::map<std::string, int32_t> running_perf_ops_by_io_target_;
+
   OpMapTy ops_; // registered operations
   Mutex lock_;
   scoped_refptr<kudu::Thread> monitor_thread_;
@@ -30,6 +30,7 @@
 #include "kudu/util/test_util.h"
 
 DECLARE_int32(memory_limit_soft_percentage);
+DECLARE_int64(mem_tracker_thread_buffer_bytes);
 
 namespace kudu {
 
@@ -113,6 +114,43 @@ TEST(MemTrackerTest, TrackerHierarchy) {
   c2->Release(60);
 }
 
+// Test that the updates of ancestors buffered by a thread are applied when the
+// thread exits, and that trackers close to their limits are updated exactly.
+TEST(MemTrackerTest, ThreadBufferedUpdates) {
+  google::FlagSaver saver;
+  FLAGS_mem_tracker_thread_buffer_bytes = 1024;
+  const int64_t kLimit = 1024L * 1024 * 1024;
+  shared_ptr<MemTracker> p = MemTracker::CreateTracker(kLimit, "p");
+  shared_ptr<MemTracker> c = MemTracker::CreateTracker(-1, "c", p);
+
+  std::thread t([&]() {
+    c->Consume(10);
+    // The tracker's own consumption is always exact.
+    ASSERT_EQ(10, c->consumption());
+    // A read flushes the thread's updates.
+    ASSERT_EQ(10, p->consumption());
+    c->Consume(10);
+  });
+  t.join();
+  ASSERT_EQ(20, p->consumption());
+
+  // Past half of the soft limit, updates aren't buffered, so other threads
+  // see them right away.
+  int64_t large = kLimit * FLAGS_memory_limit_soft_percentage / 200;
+  c->Consume(large);
+  ASSERT_EQ(large + 20, p->consumption());
+  std::thread t2([&]() {
+    c->Consume(1);
+  });
+  t2.join();
+  ASSERT_EQ(large + 21, p->consumption());
+  ASSERT_FALSE(p->LimitExceeded());
+  c->Consume(kLimit - large);
+  ASSERT_TRUE(p->LimitExceeded());
+  c->Release(kLimit + 21);
+  ASSERT_EQ(0, p->consumption());
+}
+
 class GcFunctionHelper {
  public:
   static const int NUM_RELEASE_BYTES = 1;
@@ -24,6 +24,7 @@
 #include <memory>
 #include <mutex>
 #include <sstream>
+#include <unordered_set>
 
 #include <gperftools/malloc_extension.h>
 
@@ -59,6 +60,13 @@ DEFINE_int32(memory_limit_warn_threshold_percentage, 98,
              "consume before WARNING level messages are periodically logged.");
 TAG_FLAG(memory_limit_warn_threshold_percentage, advanced);
 
+DEFINE_int64(mem_tracker_thread_buffer_bytes, 64 * 1024,
+             "Number of bytes of consumption updates to a memory tracker's ancestor "
+             "which each thread buffers before applying them to the ancestor. If 0, "
+             "updates are never buffered.");
+TAG_FLAG(mem_tracker_thread_buffer_bytes, advanced);
+TAG_FLAG(mem_tracker_thread_buffer_bytes, runtime);
+
 #ifdef TCMALLOC_ENABLED
 DEFINE_int32(tcmalloc_max_free_bytes_percentage, 10,
              "Maximum percentage of the RSS that tcmalloc is allowed to use for "
@@ -76,6 +84,7 @@ using std::list;
 using std::ostringstream;
 using std::shared_ptr;
 using std::string;
+using std::unordered_set;
 using std::vector;
 using std::weak_ptr;
 
@@ -89,6 +98,126 @@ static GoogleOnceType root_tracker_once = GOOGLE_ONCE_INIT;
 // is greater than GC_RELEASE_SIZE, this will trigger a tcmalloc gc.
 static Atomic64 released_memory_since_gc;
 
+// Updates of trackers with lower limits are never buffered: the updates buffered by
+// all threads could add up to a large part of the limit.
+static const int64_t kMinBufferedLimit = 256 * 1024 * 1024L;
+
+DEFINE_STATIC_THREAD_LOCAL(MemTracker::ThreadBuffer, MemTracker, thread_buffer_);
+
+struct MemTracker::ThreadBuffer {
+  ThreadBuffer() : num_entries(0) {
+    Registry* r = registry();
+    MutexLock l(r->lock);
+    r->buffers.insert(this);
+  }
+
+  ~ThreadBuffer() {
+    // Applied before unregistering, so that none of the trackers is destroyed
+    // in the meantime.
+    {
+      std::lock_guard<simple_spinlock> l(lock);
+      FlushAllUnlocked();
+    }
+    Registry* r = registry();
+    MutexLock l(r->lock);
+    r->buffers.erase(this);
+  }
+
+  // Adds 'bytes' to the buffered update of 'tracker', applying the update once it
+  // reaches 'max_bytes' either way.
+  void Add(MemTracker* tracker, int64_t bytes, int64_t max_bytes) {
+    std::lock_guard<simple_spinlock> l(lock);
+    Entry* e = Find(tracker);
+    if (!e) {
+      if (num_entries == kMaxEntries) {
+        FlushAllUnlocked();
+      }
+      e = &entries[num_entries++];
+      e->tracker = tracker;
+      e->bytes = 0;
+      if (!tracker->ever_buffered_.Load()) {
+        tracker->ever_buffered_.Store(true);
+      }
+    }
+    e->bytes += bytes;
+    if (e->bytes >= max_bytes || e->bytes <= -max_bytes) {
+      Apply(e);
+    }
+  }
+
+  // Applies the buffered update of 'tracker', if any.
+  void Flush(MemTracker* tracker) {
+    std::lock_guard<simple_spinlock> l(lock);
+    Entry* e = Find(tracker);
+    if (e) {
+      Apply(e);
+    }
+  }
+
+  void FlushAll() {
+    std::lock_guard<simple_spinlock> l(lock);
+    FlushAllUnlocked();
+  }
+
+  // Applies the updates of 'tracker' buffered by any thread.
+  static void FlushEverywhere(MemTracker* tracker) {
+    Registry* r = registry();
+    MutexLock l(r->lock);
+    for (ThreadBuffer* buffer : r->buffers) {
+      buffer->Flush(tracker);
+    }
+  }
+
+ private:
+  struct Entry {
+    MemTracker* tracker;
+    int64_t bytes;
+  };
+
+  // All of the threads' buffers.
+  struct Registry {
+    Mutex lock;
+    unordered_set<ThreadBuffer*> buffers;
+  };
+
+  static Registry* registry() {
+    static Registry* r = new Registry();
+    return r;
+  }
+
+  Entry* Find(MemTracker* tracker) {
+    DCHECK(lock.is_locked());
+    for (int i = 0; i < num_entries; i++) {
+      if (entries[i].tracker == tracker) {
+        return &entries[i];
+      }
+    }
+    return nullptr;
+  }
+
+  // Applies the update of 'e' and removes it.
+  void Apply(Entry* e) {
+    DCHECK(lock.is_locked());
+    e->tracker->consumption_.IncrementBy(e->bytes);
+    *e = entries[--num_entries];
+  }
+
+  void FlushAllUnlocked() {
+    DCHECK(lock.is_locked());
+    while (num_entries > 0) {
+      Apply(&entries[num_entries - 1]);
+    }
+  }
+
+  // Only a few trackers are updated by any one thread at a time, and every
+  // consumption update looks through all of the entries.
+  static const int kMaxEntries = 8;
+
+  simple_spinlock lock;
+  Entry entries[kMaxEntries];
+  int num_entries;
+};
+
 // Validate that various flags are percentages.
 static bool ValidatePercentage(const char* flagname, int value) {
   if (value >= 0 && value <= 100) {
@@ -170,6 +299,7 @@ MemTracker::MemTracker(ConsumptionFunction consumption_func, int64_t byte_limit,
       descr_(Substitute("memory consumption for $0", id)),
       parent_(std::move(parent)),
       consumption_(0),
+      ever_buffered_(false),
       consumption_func_(std::move(consumption_func)),
       rand_(GetRandomSeed32()),
       enable_logging_(false),
@@ -180,10 +310,20 @@ MemTracker::MemTracker(ConsumptionFunction consumption_func, int64_t byte_limit,
   }
   soft_limit_ = (limit_ == -1)
       ? -1 : (limit_ * FLAGS_memory_limit_soft_percentage) / 100;
+  if (limit_ < 0) {
+    buffer_limit_ = std::numeric_limits<int64_t>::max();
+  } else if (limit_ < kMinBufferedLimit) {
+    buffer_limit_ = std::numeric_limits<int64_t>::min();
+  } else {
+    buffer_limit_ = soft_limit_ / 2;
+  }
 }
 
 MemTracker::~MemTracker() {
   VLOG(1) << "Destroying tracker " << ToString();
+  if (ever_buffered_.Load()) {
+    ThreadBuffer::FlushEverywhere(this);
+  }
   if (parent_) {
     DCHECK(consumption() == 0) << "Memory tracker " << ToString()
         << " has unreleased consumption " << consumption();
@@ -292,15 +432,55 @@ void MemTracker::Consume(int64_t bytes) {
   if (PREDICT_FALSE(enable_logging_)) {
     LogUpdate(true, bytes);
   }
-  for (auto& tracker : all_trackers_) {
+  AddConsumption(bytes);
+}
+
+void MemTracker::AddConsumption(int64_t bytes) {
+  consumption_.IncrementBy(bytes);
+  if (all_trackers_.size() == 1) {
+    return;
+  }
+  int64_t max_buffered = FLAGS_mem_tracker_thread_buffer_bytes;
+  ThreadBuffer* buffer = nullptr;
+  if (max_buffered > 0) {
+    INIT_STATIC_THREAD_LOCAL(ThreadBuffer, thread_buffer_);
+    buffer = thread_buffer_;
+  } else if (thread_buffer_) {
+    // Buffering was just disabled.
+    thread_buffer_->FlushAll();
+  }
+  for (int i = 1; i < all_trackers_.size(); i++) {
+    MemTracker* tracker = all_trackers_[i];
+    if (buffer) {
+      if (tracker->CanBufferUpdates()) {
+        buffer->Add(tracker, bytes, max_buffered);
+        continue;
+      }
+      // The update is made exactly, along with any buffered one.
+      buffer->Flush(tracker);
+    }
     tracker->consumption_.IncrementBy(bytes);
-    if (!tracker->consumption_func_.empty()) {
+    // If a UDF calls FunctionContext::TrackAllocation() but allocates less than the
+    // reported amount, the subsequent call to FunctionContext::Free() may cause the
+    // process mem tracker to go negative until it is synced back to the tcmalloc
+    // metric. Don't blow up in this case. (Note that this doesn't affect non-process
+    // trackers since we can enforce that the reported memory usage is internally
+    // consistent.)
+    if (bytes > 0 && !tracker->consumption_func_.empty()) {
       DCHECK_GE(tracker->consumption_.current_value(), 0);
     }
   }
 }
 
+void MemTracker::FlushThreadBuffer() {
+  if (thread_buffer_) {
+    thread_buffer_->FlushAll();
+  }
+}
+
 bool MemTracker::TryConsume(int64_t bytes) {
+  // The limits are checked exactly.
+  FlushThreadBuffer();
   if (!consumption_func_.empty()) {
     UpdateConsumption();
   }
@@ -376,19 +556,7 @@ void MemTracker::Release(int64_t bytes) {
   if (PREDICT_FALSE(enable_logging_)) {
     LogUpdate(false, bytes);
   }
-
-  for (auto& tracker : all_trackers_) {
-    tracker->consumption_.IncrementBy(-bytes);
-    // If a UDF calls FunctionContext::TrackAllocation() but allocates less than the
-    // reported amount, the subsequent call to FunctionContext::Free() may cause the
-    // process mem tracker to go negative until it is synced back to the tcmalloc
-    // metric. Don't blow up in this case. (Note that this doesn't affect non-process
-    // trackers since we can enforce that the reported memory usage is internally
-    // consistent.)
-    if (!tracker->consumption_func_.empty()) {
-      DCHECK_GE(tracker->consumption_.current_value(), 0);
-    }
-  }
+  AddConsumption(-bytes);
 }
 
 bool MemTracker::AnyLimitExceeded() {
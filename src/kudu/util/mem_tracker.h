@@ -25,10 +25,12 @@
 #include <vector>
 
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/util/atomic.h"
 #include "kudu/util/high_water_mark.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/mutex.h"
 #include "kudu/util/random.h"
+#include "kudu/util/threadlocal.h"
 
 namespace kudu {
 
@@ -69,6 +71,14 @@ class MemTracker;
 // this will be called before the process limit is reported as exceeded. GcFunctions are
 // called in the order they are added, so expensive functions should be added last.
 //
+// Consume() and Release() update the consumption of the tracker exactly, but each
+// thread buffers its updates of the tracker's ancestors, up to
+// --mem_tracker_thread_buffer_bytes per ancestor, so that the trackers shared by the
+// whole process aren't updated by every core on every call. A thread's buffered
+// updates are applied before it reads the consumption of any tracker, such as when
+// checking limits, and when the thread exits. Updates of an ancestor with a limit are
+// buffered only while its consumption is well under the limit.
+//
 // This class is thread-safe.
 //
 // NOTE: this class has been partially ported over from Impala with
@@ -149,6 +159,9 @@ class MemTracker : public std::enable_shared_from_this<MemTracker> {
   void UpdateConsumption();
 
   // Increases consumption of this tracker and its ancestors by 'bytes'.
+  //
+  // The increase of the ancestors' consumption may be buffered by the calling thread;
+  // see the class comment.
   void Consume(int64_t bytes);
 
   // Try to expand the limit (by asking the resource broker for more memory) by at least
@@ -200,10 +213,17 @@ class MemTracker : public std::enable_shared_from_this<MemTracker> {
   const std::string& id() const { return id_; }
 
   // Returns the memory consumed in bytes.
+  //
+  // Reflects all of the calling thread's updates, but those of other threads to the
+  // consumption of this tracker's descendants may still be buffered.
   int64_t consumption() const {
+    FlushThreadBuffer();
     return consumption_.current_value();
   }
 
+  // Applies the calling thread's buffered updates to the consumption of trackers.
+  static void FlushThreadBuffer();
+
   // Note that if consumption_ is based on consumption_func_, this
   // will be the max value we've recorded in consumption(), not
   // necessarily the highest value consumption_func_ has ever
@@ -264,6 +284,18 @@ class MemTracker : public std::enable_shared_from_this<MemTracker> {
   // Further initializes the tracker.
   void Init();
 
+  // A thread's buffered updates of tracker consumption.
+  struct ThreadBuffer;
+
+  // Adds 'bytes', which may be negative, to the consumption of this tracker and of
+  // its ancestors, buffering the latter where possible.
+  void AddConsumption(int64_t bytes);
+
+  // Returns true if updates of this tracker's consumption may be buffered.
+  bool CanBufferUpdates() const {
+    return consumption_.current_value() < buffer_limit_;
+  }
+
   // Adds tracker to child_trackers_.
   //
   // child_trackers_lock_ must be held.
@@ -311,6 +343,16 @@ class MemTracker : public std::enable_shared_from_this<MemTracker> {
 
   HighWaterMark consumption_;
 
+  // Updates of the consumption are only buffered while it's below this.
+  int64_t buffer_limit_;
+
+  // Whether any thread ever buffered an update of the consumption. If so, the
+  // tracker applies the updates still buffered by any thread when it's destroyed.
+  AtomicBool ever_buffered_;
+
+  // The calling thread's buffered updates, if it made any.
+  DECLARE_STATIC_THREAD_LOCAL(ThreadBuffer, thread_buffer_);
+
   ConsumptionFunction consumption_func_;
 
   // this tracker plus all of its ancestors
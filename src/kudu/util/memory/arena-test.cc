@@ -31,6 +31,8 @@ DEFINE_int32(num_threads, 16, "Number of threads to test");
 DEFINE_int32(allocs_per_thread, 10000, "Number of allocations each thread should do");
 DEFINE_int32(alloc_size, 4, "number of bytes in each allocation");
 
+DECLARE_int64(arena_pool_max_retained_bytes);
+
 namespace kudu {
 
 using std::shared_ptr;
@@ -187,4 +189,66 @@ TEST(TestArena, TestSTLAllocator) {
   }
 }
 
+// Test that the components of destroyed arenas are reused by new ones, up to
+// the cap on the pool's idle bytes.
+TEST(TestArena, TestPooledComponents) {
+  google::FlagSaver saver;
+  PoolingBufferAllocator* pool = PoolingBufferAllocator::Get();
+  shared_ptr<MemTracker> tracker;
+  ASSERT_TRUE(MemTracker::FindTracker("arena_component_pool", &tracker,
+                                      MemTracker::GetRootTracker()));
+  pool->FreeRetained();
+  ASSERT_EQ(0, pool->retained_bytes());
+
+  // Two 8KB components, the second of them filled, are kept once the arena
+  // is destroyed.
+  {
+    Arena arena(8192, 8192);
+    ASSERT_TRUE(arena.AllocateBytes(8192) != nullptr);
+    ASSERT_EQ(16384, arena.memory_footprint());
+  }
+  ASSERT_EQ(16384, pool->retained_bytes());
+  ASSERT_EQ(16384, tracker->consumption());
+
+  // Sizes are rounded up to their class, and so reuse the same components.
+  {
+    Arena arena(5000, 8192);
+    ASSERT_EQ(8192, arena.memory_footprint());
+    ASSERT_EQ(8192, pool->retained_bytes());
+  }
+  ASSERT_EQ(16384, pool->retained_bytes());
+
+  // Components too small for the pool aren't kept.
+  {
+    Arena arena(256, 256);
+  }
+  ASSERT_EQ(16384, pool->retained_bytes());
+
+  // The components of arenas destroyed by exited threads are still reused.
+  thread t([]() {
+      Arena arena(65536, 65536);
+    });
+  t.join();
+  ASSERT_EQ(16384 + 65536, pool->retained_bytes());
+  {
+    Arena arena(65536, 65536);
+    ASSERT_EQ(16384, pool->retained_bytes());
+  }
+
+  // Beyond the cap, components go back to the heap.
+  pool->FreeRetained();
+  FLAGS_arena_pool_max_retained_bytes = 16384;
+  {
+    Arena arena(8192, 8192);
+    ASSERT_TRUE(arena.AllocateBytes(8192) != nullptr);
+    ASSERT_TRUE(arena.AllocateBytes(8192) != nullptr);
+    ASSERT_EQ(3 * 8192, arena.memory_footprint());
+  }
+  ASSERT_EQ(16384, pool->retained_bytes());
+
+  pool->FreeRetained();
+  ASSERT_EQ(0, pool->retained_bytes());
+  ASSERT_EQ(0, tracker->consumption());
+}
+
 } // namespace kudu
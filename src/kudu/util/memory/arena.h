@@ -91,7 +91,8 @@ class ArenaBase {
             size_t max_buffer_size);
 
   // Creates an arena using a default (heap) allocator with unbounded capacity.
-  // Discretion advised.
+  // Discretion advised. Components are drawn from and returned to the pool of
+  // PoolingBufferAllocator, so that short-lived arenas reuse each other's.
   ArenaBase(size_t initial_buffer_size, size_t max_buffer_size);
 
   // Adds content of the specified Slice to the arena, and returns a
@@ -20,6 +20,7 @@
 
 #include "kudu/util/memory/memory.h"
 
+#include "kudu/gutil/dynamic_annotations.h"
 #include "kudu/util/alignment.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/memory/overwrite.h"
@@ -29,6 +30,7 @@
 #include <string.h>
 
 #include <algorithm>
+#include <mutex>
 using std::copy;
 using std::max;
 using std::min;
@@ -85,6 +87,12 @@ DEFINE_bool(allocator_aligned_mode, false,
             "unless explicitly specified otherwise - to boost SIMD");
 TAG_FLAG(allocator_aligned_mode, hidden);
 
+DEFINE_int64(arena_pool_max_retained_bytes, 64 * 1024 * 1024,
+             "Maximum number of bytes of freed arena components to keep for "
+             "reuse by other arenas, rather than returning them to the heap.");
+TAG_FLAG(arena_pool_max_retained_bytes, advanced);
+TAG_FLAG(arena_pool_max_retained_bytes, runtime);
+
 HeapBufferAllocator::HeapBufferAllocator()
   : aligned_mode_(FLAGS_allocator_aligned_mode) {
 }
@@ -170,6 +178,149 @@ void* HeapBufferAllocator::Realloc(void* previousData, size_t previousSize,
   }
 }
 
+const size_t PoolingBufferAllocator::kMinPooledSize;
+const size_t PoolingBufferAllocator::kMaxPooledSize;
+const size_t PoolingBufferAllocator::kMaxThreadCachedBytes;
+const int PoolingBufferAllocator::kNumSizeClasses;
+
+DEFINE_STATIC_THREAD_LOCAL(PoolingBufferAllocator::ThreadCache, PoolingBufferAllocator,
+                           thread_cache_);
+
+struct PoolingBufferAllocator::ThreadCache {
+  ThreadCache() : bytes(0) {}
+
+  // Hands the buffers over to the shared free lists, where they stay
+  // charged to the pool.
+  ~ThreadCache() {
+    PoolingBufferAllocator* pool = PoolingBufferAllocator::Get();
+    std::lock_guard<simple_spinlock> l(pool->lock_);
+    for (int i = 0; i < kNumSizeClasses; i++) {
+      pool->shared_[i].insert(pool->shared_[i].end(), lists[i].begin(), lists[i].end());
+    }
+  }
+
+  std::vector<void*> lists[kNumSizeClasses];
+  size_t bytes;
+};
+
+PoolingBufferAllocator::PoolingBufferAllocator()
+    : heap_(HeapBufferAllocator::Get()),
+      mem_tracker_(MemTracker::FindOrCreateTracker(-1, "arena_component_pool",
+                                                   MemTracker::GetRootTracker())),
+      retained_bytes_(0) {
+}
+
+int PoolingBufferAllocator::SizeClass(size_t size) {
+  if (size < kMinPooledSize || size > kMaxPooledSize) return -1;
+  int size_class = 0;
+  while (ClassSize(size_class) < size) size_class++;
+  return size_class;
+}
+
+void* PoolingBufferAllocator::TakeIdle(int size_class) {
+  const int64_t size = ClassSize(size_class);
+  void* data = nullptr;
+  if (thread_cache_ != nullptr && !thread_cache_->lists[size_class].empty()) {
+    data = thread_cache_->lists[size_class].back();
+    thread_cache_->lists[size_class].pop_back();
+    thread_cache_->bytes -= size;
+  } else {
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (!shared_[size_class].empty()) {
+      data = shared_[size_class].back();
+      shared_[size_class].pop_back();
+    }
+  }
+  if (data != nullptr) {
+    retained_bytes_.IncrementBy(-size);
+    mem_tracker_->Release(size);
+  }
+  return data;
+}
+
+bool PoolingBufferAllocator::PutIdle(int size_class, void* data) {
+  const int64_t size = ClassSize(size_class);
+  if (retained_bytes_.IncrementBy(size) > FLAGS_arena_pool_max_retained_bytes) {
+    retained_bytes_.IncrementBy(-size);
+    return false;
+  }
+  mem_tracker_->Consume(size);
+  // Arenas poison their components, and the buffer that reuses this one will
+  // overwrite it in debug builds.
+  ASAN_UNPOISON_MEMORY_REGION(data, size);
+  INIT_STATIC_THREAD_LOCAL(ThreadCache, thread_cache_);
+  if (thread_cache_->bytes + size <= kMaxThreadCachedBytes) {
+    thread_cache_->lists[size_class].push_back(data);
+    thread_cache_->bytes += size;
+  } else {
+    std::lock_guard<simple_spinlock> l(lock_);
+    shared_[size_class].push_back(data);
+  }
+  return true;
+}
+
+void PoolingBufferAllocator::FreeRetained() {
+  std::vector<void*> idle[kNumSizeClasses];
+  if (thread_cache_ != nullptr) {
+    for (int i = 0; i < kNumSizeClasses; i++) {
+      idle[i].swap(thread_cache_->lists[i]);
+    }
+    thread_cache_->bytes = 0;
+  }
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    for (int i = 0; i < kNumSizeClasses; i++) {
+      idle[i].insert(idle[i].end(), shared_[i].begin(), shared_[i].end());
+      shared_[i].clear();
+    }
+  }
+  for (int i = 0; i < kNumSizeClasses; i++) {
+    for (void* data : idle[i]) {
+      free(data);
+    }
+    const int64_t freed = static_cast<int64_t>(idle[i].size() * ClassSize(i));
+    retained_bytes_.IncrementBy(-freed);
+    mem_tracker_->Release(freed);
+  }
+}
+
+Buffer* PoolingBufferAllocator::AllocateInternal(size_t requested,
+                                                 size_t minimal,
+                                                 BufferAllocator* originator) {
+  int size_class = SizeClass(requested);
+  if (size_class >= 0) {
+    const size_t size = ClassSize(size_class);
+    void* data = TakeIdle(size_class);
+    if (data != nullptr) {
+      return CreateBuffer(data, size, originator);
+    }
+    Buffer* buffer = DelegateAllocate(heap_, size, size, originator);
+    if (buffer != nullptr) {
+      return buffer;
+    }
+  }
+  // Unpooled sizes, and size classes that couldn't be allocated whole, are
+  // left to the heap.
+  return DelegateAllocate(heap_, requested, minimal, originator);
+}
+
+bool PoolingBufferAllocator::ReallocateInternal(size_t requested,
+                                                size_t minimal,
+                                                Buffer* buffer,
+                                                BufferAllocator* originator) {
+  // The buffer is pooled again when freed if it ends up the size of a class.
+  return DelegateReallocate(heap_, requested, minimal, buffer, originator);
+}
+
+void PoolingBufferAllocator::FreeInternal(Buffer* buffer) {
+  int size_class = SizeClass(buffer->size());
+  if (size_class < 0 ||
+      ClassSize(size_class) != buffer->size() ||
+      !PutIdle(size_class, buffer->data())) {
+    DelegateFree(heap_, buffer);
+  }
+}
+
 Buffer* ClearingBufferAllocator::AllocateInternal(size_t requested,
                                                   size_t minimal,
                                                   BufferAllocator* originator) {
@@ -39,9 +39,12 @@
 #include <stddef.h>
 #include <vector>
 
+#include "kudu/util/atomic.h"
 #include "kudu/util/boost_mutex_utils.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/memory/overwrite.h"
 #include "kudu/util/mutex.h"
+#include "kudu/util/threadlocal.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/logging-inl.h"
 #include "kudu/gutil/macros.h"
@@ -291,6 +294,96 @@ class HeapBufferAllocator : public BufferAllocator {
   DISALLOW_COPY_AND_ASSIGN(HeapBufferAllocator);
 };
 
+// Allocates buffers on the heap like HeapBufferAllocator, but keeps freed
+// buffers of common sizes around for reuse. This spares arenas that are
+// created and destroyed per scan batch or per write a malloc() and free() of
+// every component.
+//
+// Requests between kMinPooledSize and kMaxPooledSize bytes are rounded up to
+// a power-of-two size class. A freed buffer of a size class is kept in a free
+// list of the freeing thread, which needs no locking, or in a shared free list
+// of its class once the thread holds kMaxThreadCachedBytes. Allocations look
+// in the same lists, in the same order, before going to the heap.
+//
+// The idle buffers are charged to the "arena_component_pool" MemTracker, and
+// at most --arena_pool_max_retained_bytes of them are kept; the buffers freed
+// beyond that go back to the heap.
+//
+// Thread-safe.
+class PoolingBufferAllocator : public BufferAllocator {
+ public:
+  static const size_t kMinPooledSize = 4 * 1024;
+  static const size_t kMaxPooledSize = 4 * 1024 * 1024;
+  static const size_t kMaxThreadCachedBytes = 256 * 1024;
+
+  virtual ~PoolingBufferAllocator() {}
+
+  // Returns a singleton instance of the pooling allocator.
+  static PoolingBufferAllocator* Get() {
+    return Singleton<PoolingBufferAllocator>::get();
+  }
+
+  virtual size_t Available() const OVERRIDE {
+    return numeric_limits<size_t>::max();
+  }
+
+  // Returns the number of bytes held in idle buffers, across all threads.
+  int64_t retained_bytes() const { return retained_bytes_.Load(); }
+
+  // Frees the idle buffers of the calling thread and of the shared free lists.
+  // The buffers held by other threads are kept.
+  void FreeRetained();
+
+ private:
+  friend class Singleton<PoolingBufferAllocator>;
+  struct ThreadCache;
+
+  // Size classes from kMinPooledSize to kMaxPooledSize, inclusive.
+  static const int kNumSizeClasses = 11;
+
+  PoolingBufferAllocator();
+
+  // Returns the size class for buffers of 'size' bytes, or -1 if they aren't
+  // pooled.
+  static int SizeClass(size_t size);
+
+  static size_t ClassSize(int size_class) {
+    return kMinPooledSize << size_class;
+  }
+
+  // Returns an idle buffer of 'size_class', or NULL if there isn't one.
+  void* TakeIdle(int size_class);
+
+  // Keeps 'data', a buffer of 'size_class', for reuse. Returns false if the
+  // pool is full, in which case the caller must free it.
+  bool PutIdle(int size_class, void* data);
+
+  virtual Buffer* AllocateInternal(size_t requested,
+                                   size_t minimal,
+                                   BufferAllocator* originator) OVERRIDE;
+
+  virtual bool ReallocateInternal(size_t requested,
+                                  size_t minimal,
+                                  Buffer* buffer,
+                                  BufferAllocator* originator) OVERRIDE;
+
+  virtual void FreeInternal(Buffer* buffer) OVERRIDE;
+
+  HeapBufferAllocator* const heap_;
+  const std::shared_ptr<MemTracker> mem_tracker_;
+
+  // The number of bytes held in idle buffers, in thread and shared free lists.
+  AtomicInt<int64_t> retained_bytes_;
+
+  // Protects 'shared_'.
+  simple_spinlock lock_;
+  std::vector<void*> shared_[kNumSizeClasses];
+
+  DECLARE_STATIC_THREAD_LOCAL(ThreadCache, thread_cache_);
+
+  DISALLOW_COPY_AND_ASSIGN(PoolingBufferAllocator);
+};
+
 // Wrapper around the delegate allocator, that clears all newly allocated
 // (and reallocated) memory.
 class ClearingBufferAllocator : public BufferAllocator {
@@ -23,6 +23,7 @@
 
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/hdr_histogram.h"
 #include "kudu/util/jsonreader.h"
 #include "kudu/util/jsonwriter.h"
@@ -32,6 +33,7 @@
 using std::string;
 using std::unordered_set;
 using std::vector;
+using strings::Substitute;
 
 DECLARE_int32(metrics_retirement_age_ms);
 
@@ -201,6 +203,49 @@ TEST_F(MetricsTest, JsonPrintTest) {
   ASSERT_EQ("", out.str());
 }
 
+TEST_F(MetricsTest, PrometheusPrintTest) {
+  scoped_refptr<Counter> reqs = METRIC_reqs_pending.Instantiate(entity_);
+  reqs->IncrementBy(3);
+  scoped_refptr<Histogram> hist = METRIC_test_hist.Instantiate(entity_);
+  hist->Increment(2);
+  entity_->SetAttribute("test attr", "attr \"val\"");
+
+  std::ostringstream out;
+  ASSERT_OK(registry_.WriteAsPrometheus(&out, { "*" }, MetricPrometheusOptions()));
+  string text = out.str();
+  const string labels =
+      "entity_type=\"test_entity\",entity_id=\"my-test\",test_attr=\"attr \\\"val\\\"\"";
+  ASSERT_STR_CONTAINS(text, "# TYPE kudu_reqs_pending counter\n");
+  ASSERT_STR_CONTAINS(text, "kudu_reqs_pending{" + labels + "} 3\n");
+  ASSERT_STR_CONTAINS(text, "# TYPE kudu_test_hist summary\n");
+  ASSERT_STR_CONTAINS(text, "kudu_test_hist{" + labels + ",quantile=\"0.99\"} 2\n");
+  ASSERT_STR_CONTAINS(text, "kudu_test_hist_count{" + labels + "} 1\n");
+
+  // Verify that only the requested entity types are written.
+  MetricPrometheusOptions opts;
+  opts.entity_types = { "server" };
+  out.str("");
+  ASSERT_OK(registry_.WriteAsPrometheus(&out, { "*" }, opts));
+  ASSERT_EQ(string::npos, out.str().find("kudu_reqs_pending"));
+
+  // Verify that only the metrics modified since the previous scrape are
+  // written when asked for.
+  opts.entity_types.clear();
+  opts.only_modified_in_or_after_epoch = Metric::current_epoch();
+  out.str("");
+  ASSERT_OK(registry_.WriteAsPrometheus(&out, { "*" }, opts));
+  ASSERT_EQ(string::npos, out.str().find("kudu_test_hist"));
+  ASSERT_STR_CONTAINS(out.str(),
+                      Substitute("# kudu_metrics_epoch $0\n", Metric::current_epoch()));
+
+  hist->Increment(2);
+  opts.only_modified_in_or_after_epoch = Metric::current_epoch();
+  out.str("");
+  ASSERT_OK(registry_.WriteAsPrometheus(&out, { "*" }, opts));
+  ASSERT_STR_CONTAINS(out.str(), "kudu_test_hist_count{" + labels + "} 2\n");
+  ASSERT_EQ(string::npos, out.str().find("kudu_reqs_pending"));
+}
+
 // Test that metrics are retired when they are no longer referenced.
 TEST_F(MetricsTest, RetirementTest) {
   FLAGS_metrics_retirement_age_ms = 100;
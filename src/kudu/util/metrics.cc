@@ -16,6 +16,7 @@
 // under the License.
 #include "kudu/util/metrics.h"
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <map>
@@ -28,6 +29,8 @@
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/singleton.h"
 #include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/strings/ascii_ctype.h"
+#include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/hdr_histogram.h"
@@ -49,6 +52,7 @@ METRIC_DEFINE_entity(server);
 namespace kudu {
 
 using std::string;
+using std::unordered_set;
 using std::vector;
 using strings::Substitute;
 
@@ -106,6 +110,8 @@ const char* MetricUnit::Name(Type unit) {
       return "messages";
     case kContextSwitches:
       return "context switches";
+    case kFiles:
+      return "files";
     default:
       return "UNKNOWN UNIT";
   }
@@ -190,6 +196,47 @@ bool MatchMetricInList(const string& metric_name,
   return false;
 }
 
+// Returns 'value' escaped as a Prometheus label value.
+string EscapePrometheusLabelValue(const string& value) {
+  string escaped;
+  escaped.reserve(value.size());
+  for (char c : value) {
+    switch (c) {
+      case '\\': escaped.append("\\\\"); break;
+      case '"': escaped.append("\\\""); break;
+      case '\n': escaped.append("\\n"); break;
+      default: escaped.push_back(c);
+    }
+  }
+  return escaped;
+}
+
+// Returns 'name' with the characters not allowed in Prometheus label names
+// replaced with underscores.
+string SanitizePrometheusLabelName(const string& name) {
+  string sanitized = name;
+  for (char& c : sanitized) {
+    if (!ascii_isalnum(c) && c != '_') {
+      c = '_';
+    }
+  }
+  return sanitized;
+}
+
+const char* PrometheusType(MetricType::Type type) {
+  switch (type) {
+    case MetricType::kCounter: return "counter";
+    case MetricType::kGauge: return "gauge";
+    case MetricType::kHistogram: return "summary";
+  }
+  LOG(FATAL) << "Unknown metric type: " << type;
+  return "untyped";
+}
+
+string PrometheusName(const MetricPrototype* prototype) {
+  return Substitute("kudu_$0", prototype->name());
+}
+
 } // anonymous namespace
 
 
@@ -252,6 +299,56 @@ Status MetricEntity::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+Status MetricEntity::WriteAsPrometheus(std::ostream* out,
+                                       const vector<string>& requested_metrics,
+                                       const MetricPrometheusOptions& opts,
+                                       unordered_set<const MetricPrototype*>* described) const {
+  if (!opts.entity_types.empty() &&
+      std::find(opts.entity_types.begin(), opts.entity_types.end(), prototype_->name()) ==
+      opts.entity_types.end()) {
+    return Status::OK();
+  }
+  bool select_all = MatchMetricInList(id(), requested_metrics);
+
+  typedef std::map<const char*, scoped_refptr<Metric> > OrderedMetricMap;
+  OrderedMetricMap metrics;
+  AttributeMap attrs;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    attrs = attributes_;
+    for (const MetricMap::value_type& val : metric_map_) {
+      const MetricPrototype* prototype = val.first;
+      const scoped_refptr<Metric>& metric = val.second;
+      if ((select_all || MatchMetricInList(prototype->name(), requested_metrics)) &&
+          metric->ModifiedInOrAfterEpoch(opts.only_modified_in_or_after_epoch)) {
+        InsertOrDie(&metrics, prototype->name(), metric);
+      }
+    }
+  }
+  if (metrics.empty()) {
+    return Status::OK();
+  }
+
+  string labels = Substitute("entity_type=\"$0\",entity_id=\"$1\"",
+                             prototype_->name(), EscapePrometheusLabelValue(id_));
+  for (const AttributeMap::value_type& val : attrs) {
+    labels.append(Substitute(",$0=\"$1\"", SanitizePrometheusLabelName(val.first),
+                             EscapePrometheusLabelValue(val.second)));
+  }
+  for (const OrderedMetricMap::value_type& val : metrics) {
+    const MetricPrototype* prototype = val.second->prototype();
+    // Prometheus takes the samples of a metric from different entities even
+    // if they aren't grouped together, but only one HELP and TYPE line each.
+    if (described->insert(prototype).second) {
+      const string name = PrometheusName(prototype);
+      *out << "# HELP " << name << " " << prototype->description() << "\n";
+      *out << "# TYPE " << name << " " << PrometheusType(prototype->type()) << "\n";
+    }
+    val.second->WriteAsPrometheus(out, labels);
+  }
+  return Status::OK();
+}
+
 void MetricEntity::RetireOldMetrics() {
   MonoTime now(MonoTime::Now());
 
@@ -348,6 +445,31 @@ Status MetricRegistry::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+Status MetricRegistry::WriteAsPrometheus(std::ostream* out,
+                                         const vector<string>& requested_metrics,
+                                         const MetricPrometheusOptions& opts) const {
+  // Modifications from now on are caught by a scrape starting at the new
+  // epoch.
+  int64_t next_epoch = Metric::IncrementEpoch();
+  EntityMap entities;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    entities = entities_;
+  }
+
+  *out << "# kudu_metrics_epoch " << next_epoch << "\n";
+  unordered_set<const MetricPrototype*> described;
+  for (const EntityMap::value_type& e : entities) {
+    WARN_NOT_OK(e.second->WriteAsPrometheus(out, requested_metrics, opts, &described),
+                Substitute("Failed to write entity $0 in Prometheus format", e.second->id()));
+  }
+
+  // See WriteAsJson().
+  entities.clear();
+  const_cast<MetricRegistry*>(this)->RetireOldMetrics();
+  return Status::OK();
+}
+
 void MetricRegistry::RetireOldMetrics() {
   std::lock_guard<simple_spinlock> l(lock_);
   for (auto it = entities_.begin(); it != entities_.end();) {
@@ -480,8 +602,11 @@ scoped_refptr<MetricEntity> MetricRegistry::FindOrCreateEntity(
 //
 // Metric
 //
+AtomicInt<int64_t> Metric::current_epoch_(0);
+
 Metric::Metric(const MetricPrototype* prototype)
-  : prototype_(prototype) {
+  : prototype_(prototype),
+    m_epoch_(current_epoch()) {
 }
 
 Metric::~Metric() {
@@ -504,6 +629,14 @@ Status Gauge::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+void Gauge::WriteAsPrometheus(std::ostream* out, const string& labels) const {
+  double value;
+  if (!NumericValue(&value)) {
+    return;
+  }
+  *out << PrometheusName(prototype_) << "{" << labels << "} " << SimpleDtoa(value) << "\n";
+}
+
 //
 // StringGauge
 //
@@ -518,6 +651,7 @@ std::string StringGauge::value() const {
 }
 
 void StringGauge::set_value(const std::string& value) {
+  UpdateModificationEpoch();
   std::lock_guard<simple_spinlock> l(lock_);
   value_ = value;
 }
@@ -526,6 +660,10 @@ void StringGauge::WriteValue(JsonWriter* writer) const {
   writer->String(value());
 }
 
+bool StringGauge::NumericValue(double* /* value */) const {
+  return false;
+}
+
 //
 // Counter
 //
@@ -547,6 +685,7 @@ void Counter::Increment() {
 }
 
 void Counter::IncrementBy(int64_t amount) {
+  UpdateModificationEpoch();
   value_.IncrementBy(amount);
 }
 
@@ -563,6 +702,10 @@ Status Counter::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+void Counter::WriteAsPrometheus(std::ostream* out, const string& labels) const {
+  *out << PrometheusName(prototype_) << "{" << labels << "} " << value() << "\n";
+}
+
 /////////////////////////////////////////////////
 // HistogramPrototype
 /////////////////////////////////////////////////
@@ -592,15 +735,34 @@ scoped_refptr<Histogram> HistogramPrototype::Instantiate(
 
 Histogram::Histogram(const HistogramPrototype* proto)
   : Metric(proto),
-    histogram_(new HdrHistogram(proto->max_trackable_value(), proto->num_sig_digits())) {
+    histogram_(proto->sharded() ? nullptr :
+               new HdrHistogram(proto->max_trackable_value(), proto->num_sig_digits())),
+    sharded_(proto->sharded() ?
+             new ShardedHdrHistogram(proto->max_trackable_value(), proto->num_sig_digits()) :
+             nullptr) {
 }
 
 void Histogram::Increment(int64_t value) {
-  histogram_->Increment(value);
+  IncrementBy(value, 1);
 }
 
 void Histogram::IncrementBy(int64_t value, int64_t amount) {
-  histogram_->IncrementBy(value, amount);
+  UpdateModificationEpoch();
+  if (sharded_) {
+    sharded_->IncrementBy(value, amount);
+  } else {
+    histogram_->IncrementBy(value, amount);
+  }
+}
+
+gscoped_ptr<HdrHistogram> Histogram::Snapshot() const {
+  if (!sharded_) {
+    return gscoped_ptr<HdrHistogram>(new HdrHistogram(*histogram_));
+  }
+  gscoped_ptr<HdrHistogram> snapshot(
+      new HdrHistogram(sharded_->highest_trackable_value(), sharded_->num_significant_digits()));
+  sharded_->MergeInto(snapshot.get());
+  return snapshot.Pass();
 }
 
 Status Histogram::WriteAsJson(JsonWriter* writer,
@@ -612,9 +774,23 @@ Status Histogram::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+void Histogram::WriteAsPrometheus(std::ostream* out, const string& labels) const {
+  static const double kQuantiles[] = { 0.5, 0.75, 0.95, 0.99, 0.999, 0.9999 };
+  gscoped_ptr<HdrHistogram> snapshot_ptr(Snapshot());
+  const HdrHistogram& snapshot = *snapshot_ptr;
+  const string name = PrometheusName(prototype_);
+  for (double q : kQuantiles) {
+    *out << name << "{" << labels << ",quantile=\"" << SimpleDtoa(q) << "\"} "
+         << snapshot.ValueAtPercentile(q * 100) << "\n";
+  }
+  *out << name << "_sum{" << labels << "} " << snapshot.TotalSum() << "\n";
+  *out << name << "_count{" << labels << "} " << snapshot.TotalCount() << "\n";
+}
+
 Status Histogram::GetHistogramSnapshotPB(HistogramSnapshotPB* snapshot_pb,
                                          const MetricJsonOptions& opts) const {
-  HdrHistogram snapshot(*histogram_);
+  gscoped_ptr<HdrHistogram> snapshot_ptr(Snapshot());
+  const HdrHistogram& snapshot = *snapshot_ptr;
   snapshot_pb->set_name(prototype_->name());
   if (opts.include_schema_info) {
     snapshot_pb->set_type(MetricType::Name(prototype_->type()));
@@ -636,7 +812,7 @@ Status Histogram::GetHistogramSnapshotPB(HistogramSnapshotPB* snapshot_pb,
   snapshot_pb->set_max(snapshot.MaxValue());
 
   if (opts.include_raw_histograms) {
-    RecordedValuesIterator iter(&snapshot);
+    RecordedValuesIterator iter(snapshot_ptr.get());
     while (iter.HasNext()) {
       HistogramIterationValue value;
       RETURN_NOT_OK(iter.Next(&value));
@@ -648,22 +824,28 @@ Status Histogram::GetHistogramSnapshotPB(HistogramSnapshotPB* snapshot_pb,
 }
 
 uint64_t Histogram::CountInBucketForValueForTests(uint64_t value) const {
-  return histogram_->CountInBucketForValue(value);
+  return Snapshot()->CountInBucketForValue(value);
 }
 
 uint64_t Histogram::TotalCount() const {
-  return histogram_->TotalCount();
+  return sharded_ ? sharded_->TotalCount() : histogram_->TotalCount();
+}
+
+uint64_t Histogram::ValueAtPercentile(double percentile) const {
+  return sharded_ ? sharded_->ValueAtPercentile(percentile) :
+      histogram_->ValueAtPercentile(percentile);
 }
 
 uint64_t Histogram::MinValueForTests() const {
-  return histogram_->MinValue();
+  return Snapshot()->MinValue();
 }
 
 uint64_t Histogram::MaxValueForTests() const {
-  return histogram_->MaxValue();
+  return Snapshot()->MaxValue();
 }
+
 double Histogram::MeanValueForTests() const {
-  return histogram_->MeanValue();
+  return Snapshot()->MeanValue();
 }
 
 ScopedLatencyMetric::ScopedLatencyMetric(Histogram* latency_hist)
@@ -221,12 +221,33 @@
 //      ...
 // ]
 //
+// =================
+// Prometheus output
+// =================
+//
+// Metrics may also be written in the Prometheus text exposition format, one
+// entity at a time. Each metric is named after its prototype with a "kudu_"
+// prefix, and its samples are labeled with the type, id and attributes of
+// its entity. Histograms are written as summaries of a few quantiles.
+//
+// Example Prometheus output:
+//
+// # HELP kudu_log_reader_bytes_read Number of bytes read since tablet start
+// # TYPE kudu_log_reader_bytes_read counter
+// kudu_log_reader_bytes_read{entity_type="tablet",entity_id="e95e57ba8d4d48458e7c7d35020d4a46",table_id="12345",table_name="my_table"} 0
+//
+// Scrapers which keep the last values of the metrics may ask for only those
+// modified since their previous scrape, using the epoch it reported.
+//
 /////////////////////////////////////////////////////
 
 #include <algorithm>
+#include <iosfwd>
+#include <limits>
 #include <mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <gtest/gtest_prod.h>
@@ -279,9 +300,9 @@
   ::kudu::GaugePrototype<double> METRIC_##name(                      \
       ::kudu::MetricPrototype::CtorArgs(#entity, #name, label, unit, desc, ## __VA_ARGS__))
 
-#define METRIC_DEFINE_histogram(entity, name, label, unit, desc, max_val, num_sig_digits) \
+#define METRIC_DEFINE_histogram(entity, name, label, unit, desc, max_val, num_sig_digits, ...) \
   ::kudu::HistogramPrototype METRIC_##name(                                       \
-      ::kudu::MetricPrototype::CtorArgs(#entity, #name, label, unit, desc), \
+      ::kudu::MetricPrototype::CtorArgs(#entity, #name, label, unit, desc, ## __VA_ARGS__), \
     max_val, num_sig_digits)
 
 // The following macros act as forward declarations for entity types and metric prototypes.
@@ -336,6 +357,7 @@ class MetricPrototype;
 class MetricRegistry;
 
 class HdrHistogram;
+class ShardedHdrHistogram;
 class Histogram;
 class HistogramPrototype;
 class HistogramSnapshotPB;
@@ -379,6 +401,7 @@ struct MetricUnit {
     kTasks,
     kMessages,
     kContextSwitches,
+    kFiles,
   };
   static const char* Name(Type unit);
 };
@@ -411,6 +434,21 @@ struct MetricJsonOptions {
   bool include_schema_info;
 };
 
+struct MetricPrometheusOptions {
+  MetricPrometheusOptions() :
+    only_modified_in_or_after_epoch(0) {
+  }
+
+  // The types of the entities whose metrics are written, e.g. "tablet".
+  // Default: empty, meaning all types.
+  std::vector<std::string> entity_types;
+
+  // Only write the metrics modified in or after this epoch. See
+  // Metric::current_epoch().
+  // Default: 0, meaning all metrics.
+  int64_t only_modified_in_or_after_epoch;
+};
+
 class MetricEntityPrototype {
  public:
   explicit MetricEntityPrototype(const char* name);
@@ -465,6 +503,13 @@ class MetricEntity : public RefCountedThreadSafe<MetricEntity> {
                      const std::vector<std::string>& requested_metrics,
                      const MetricJsonOptions& opts) const;
 
+  // See MetricRegistry::WriteAsPrometheus(). The metrics whose HELP and TYPE
+  // lines were already written are in 'described', which is updated.
+  Status WriteAsPrometheus(std::ostream* out,
+                           const std::vector<std::string>& requested_metrics,
+                           const MetricPrometheusOptions& opts,
+                           std::unordered_set<const MetricPrototype*>* described) const;
+
   const MetricMap& UnsafeMetricsMapForTests() const { return metric_map_; }
 
   // Mark that the given metric should never be retired until the metric
@@ -527,14 +572,44 @@ class Metric : public RefCountedThreadSafe<Metric> {
   virtual Status WriteAsJson(JsonWriter* writer,
                              const MetricJsonOptions& opts) const = 0;
 
+  // Writes the samples of the metric in the Prometheus text format, with
+  // 'labels' as their comma-separated label pairs.
+  virtual void WriteAsPrometheus(std::ostream* out, const std::string& labels) const = 0;
+
   const MetricPrototype* prototype() const { return prototype_; }
 
+  // Returns true if the metric was modified in or after 'epoch'.
+  bool ModifiedInOrAfterEpoch(int64_t epoch) const {
+    return m_epoch_.Load() >= epoch;
+  }
+
+  // The epoch in which metrics are being modified. Each scrape of a registry
+  // starts a new one.
+  static int64_t current_epoch() { return current_epoch_.Load(); }
+
+  // Starts a new epoch, returning it.
+  static int64_t IncrementEpoch() { return current_epoch_.Increment(); }
+
  protected:
   explicit Metric(const MetricPrototype* prototype);
   virtual ~Metric();
 
+  // Records that the metric is modified in the current epoch. Must be called
+  // by every modification of the value of the metric.
+  void UpdateModificationEpoch() {
+    // Cheap when the metric was already modified in this epoch, which is the
+    // common case.
+    int64_t epoch = current_epoch();
+    if (PREDICT_FALSE(m_epoch_.Load() < epoch)) {
+      m_epoch_.StoreMax(epoch);
+    }
+  }
+
   const MetricPrototype* const prototype_;
 
+  // The last epoch in which the metric was modified.
+  AtomicInt<int64_t> m_epoch_;
+
  private:
   friend class MetricEntity;
   friend class RefCountedThreadSafe<Metric>;
@@ -544,6 +619,8 @@ class Metric : public RefCountedThreadSafe<Metric> {
   // uninitialized.
   MonoTime retire_time_;
 
+  static AtomicInt<int64_t> current_epoch_;
+
   DISALLOW_COPY_AND_ASSIGN(Metric);
 };
 
@@ -573,6 +650,18 @@ class MetricRegistry {
                      const std::vector<std::string>& requested_metrics,
                      const MetricJsonOptions& opts) const;
 
+  // Writes metrics in this registry to 'out' in the Prometheus text
+  // exposition format, preceded by a comment with the epoch to pass as
+  // 'opts.only_modified_in_or_after_epoch' to the next call in order to get
+  // the metrics modified since this one.
+  //
+  // 'requested_metrics' is as in WriteAsJson(). The entities are written one
+  // at a time, so that the registry is only briefly locked and none of the
+  // output is buffered here.
+  Status WriteAsPrometheus(std::ostream* out,
+                           const std::vector<std::string>& requested_metrics,
+                           const MetricPrometheusOptions& opts) const;
+
   // For each registered entity, retires orphaned metrics. If an entity has no more
   // metrics and there are no external references, entities are removed as well.
   //
@@ -637,7 +726,12 @@ class MetricPrototypeRegistry {
 enum PrototypeFlags {
   // Flag which causes a Gauge prototype to expose itself as if it
   // were a counter.
-  EXPOSE_AS_COUNTER = 1 << 0
+  EXPOSE_AS_COUNTER = 1 << 0,
+
+  // Flag which causes a Histogram to record into per-thread shards, for
+  // histograms recorded by many threads at high rates such as per-RPC
+  // latencies. See ShardedHdrHistogram.
+  SHARDED_HISTOGRAM = 1 << 1
 };
 
 class MetricPrototype {
@@ -732,8 +826,14 @@ class Gauge : public Metric {
   virtual ~Gauge() {}
   virtual Status WriteAsJson(JsonWriter* w,
                              const MetricJsonOptions& opts) const OVERRIDE;
+  virtual void WriteAsPrometheus(std::ostream* out,
+                                 const std::string& labels) const OVERRIDE;
  protected:
   virtual void WriteValue(JsonWriter* writer) const = 0;
+
+  // Sets 'value' to the value of the gauge, returning false if it's not
+  // numeric.
+  virtual bool NumericValue(double* value) const = 0;
  private:
   DISALLOW_COPY_AND_ASSIGN(Gauge);
 };
@@ -747,6 +847,7 @@ class StringGauge : public Gauge {
   void set_value(const std::string& value);
  protected:
   virtual void WriteValue(JsonWriter* writer) const OVERRIDE;
+  virtual bool NumericValue(double* value) const OVERRIDE;
  private:
   std::string value_;
   mutable simple_spinlock lock_;  // Guards value_
@@ -765,12 +866,15 @@ class AtomicGauge : public Gauge {
     return static_cast<T>(value_.Load(kMemOrderRelease));
   }
   virtual void set_value(const T& value) {
+    UpdateModificationEpoch();
     value_.Store(static_cast<int64_t>(value), kMemOrderNoBarrier);
   }
   void Increment() {
+    UpdateModificationEpoch();
     value_.IncrementBy(1, kMemOrderNoBarrier);
   }
   virtual void IncrementBy(int64_t amount) {
+    UpdateModificationEpoch();
     value_.IncrementBy(amount, kMemOrderNoBarrier);
   }
   void Decrement() {
@@ -784,6 +888,10 @@ class AtomicGauge : public Gauge {
   virtual void WriteValue(JsonWriter* writer) const OVERRIDE {
     writer->Value(value());
   }
+  virtual bool NumericValue(double* value) const OVERRIDE {
+    *value = static_cast<double>(this->value());
+    return true;
+  }
   AtomicInt<int64_t> value_;
  private:
   DISALLOW_COPY_AND_ASSIGN(AtomicGauge);
@@ -836,6 +944,21 @@ class FunctionGaugeDetacher {
   DISALLOW_COPY_AND_ASSIGN(FunctionGaugeDetacher);
 };
 
+namespace internal {
+
+// Sets 'out' to 'value' as a double, returning false if it isn't numeric.
+template<typename T>
+bool ToNumericValue(const T& value, double* out) {
+  *out = static_cast<double>(value);
+  return true;
+}
+
+inline bool ToNumericValue(const std::string& /* value */, double* /* out */) {
+  return false;
+}
+
+} // namespace internal
+
 
 // A Gauge that calls back to a function to get its value.
 //
@@ -859,6 +982,10 @@ class FunctionGauge : public Gauge {
     writer->Value(value());
   }
 
+  virtual bool NumericValue(double* value) const OVERRIDE {
+    return internal::ToNumericValue(this->value(), value);
+  }
+
   // Reset this FunctionGauge to return a specific value.
   // This should be used during destruction. If you want a settable
   // Gauge, use a normal Gauge instead of a FunctionGauge.
@@ -899,7 +1026,10 @@ class FunctionGauge : public Gauge {
   friend class MetricEntity;
 
   FunctionGauge(const GaugePrototype<T>* proto, Callback<T()> function)
-      : Gauge(proto), function_(std::move(function)) {}
+      : Gauge(proto), function_(std::move(function)) {
+    // The value may change whenever it's computed.
+    m_epoch_.Store(std::numeric_limits<int64_t>::max());
+  }
 
   static T Return(T v) {
     return v;
@@ -937,6 +1067,8 @@ class Counter : public Metric {
   void IncrementBy(int64_t amount);
   virtual Status WriteAsJson(JsonWriter* w,
                              const MetricJsonOptions& opts) const OVERRIDE;
+  virtual void WriteAsPrometheus(std::ostream* out,
+                                 const std::string& labels) const OVERRIDE;
 
  private:
   FRIEND_TEST(MetricsTest, SimpleCounterTest);
@@ -957,6 +1089,7 @@ class HistogramPrototype : public MetricPrototype {
 
   uint64_t max_trackable_value() const { return max_trackable_value_; }
   int num_sig_digits() const { return num_sig_digits_; }
+  bool sharded() const { return args_.flags_ & SHARDED_HISTOGRAM; }
   virtual MetricType::Type type() const OVERRIDE { return MetricType::kHistogram; }
 
  private:
@@ -979,9 +1112,17 @@ class Histogram : public Metric {
   // or IncrementBy()).
   uint64_t TotalCount() const;
 
+  // Return the value below which the given percentage of the values added to
+  // the histogram fall.
+  uint64_t ValueAtPercentile(double percentile) const;
+
   virtual Status WriteAsJson(JsonWriter* w,
                              const MetricJsonOptions& opts) const OVERRIDE;
 
+  // Writes the histogram as a summary of its quantiles.
+  virtual void WriteAsPrometheus(std::ostream* out,
+                                 const std::string& labels) const OVERRIDE;
+
   // Returns a snapshot of this histogram including the bucketed values and counts.
   Status GetHistogramSnapshotPB(HistogramSnapshotPB* snapshot,
                                 const MetricJsonOptions& opts) const;
@@ -996,7 +1137,13 @@ class Histogram : public Metric {
   friend class MetricEntity;
   explicit Histogram(const HistogramPrototype* proto);
 
+  // Returns a snapshot of the recorded values.
+  gscoped_ptr<HdrHistogram> Snapshot() const;
+
+  // Exactly one of these is set, depending on whether the prototype is
+  // sharded.
   const gscoped_ptr<HdrHistogram> histogram_;
+  const gscoped_ptr<ShardedHdrHistogram> sharded_;
   DISALLOW_COPY_AND_ASSIGN(Histogram);
 };
 
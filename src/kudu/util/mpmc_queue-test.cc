@@ -0,0 +1,187 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/mpmc_queue.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "kudu/util/monotime.h"
+
+using std::string;
+using std::thread;
+using std::vector;
+
+namespace kudu {
+
+namespace {
+
+struct LengthLogicalSize {
+  static size_t logical_size(const string& s) {
+    return s.length();
+  }
+};
+
+} // anonymous namespace
+
+TEST(MpmcQueueTest, TestPutAndDrain) {
+  MpmcQueue<int32_t> queue(10, 4);
+  ASSERT_TRUE(queue.empty());
+  for (int32_t i = 0; i < 4; i++) {
+    ASSERT_EQ(QUEUE_SUCCESS, queue.Put(i));
+  }
+  // The ring is full before the logical size is.
+  ASSERT_EQ(QUEUE_FULL, queue.Put(4));
+
+  int32_t i;
+  ASSERT_TRUE(queue.BlockingGet(&i));
+  ASSERT_EQ(0, i);
+  vector<int32_t> out;
+  ASSERT_TRUE(queue.BlockingDrainTo(&out, 2));
+  ASSERT_EQ((vector<int32_t>{ 1, 2 }), out);
+  ASSERT_TRUE(queue.BlockingDrainTo(&out));
+  ASSERT_EQ((vector<int32_t>{ 1, 2, 3 }), out);
+  ASSERT_TRUE(queue.empty());
+}
+
+TEST(MpmcQueueTest, TestLogicalSize) {
+  MpmcQueue<string, LengthLogicalSize> queue(4, 16);
+  ASSERT_EQ(QUEUE_SUCCESS, queue.Put("a"));
+  // One element may take the queue over its capacity.
+  ASSERT_EQ(QUEUE_SUCCESS, queue.Put("bcde"));
+  ASSERT_EQ(QUEUE_FULL, queue.Put("f"));
+  string s;
+  ASSERT_TRUE(queue.BlockingGet(&s));
+  ASSERT_EQ("a", s);
+  ASSERT_EQ(QUEUE_FULL, queue.Put("f"));
+  ASSERT_TRUE(queue.BlockingGet(&s));
+  ASSERT_EQ(QUEUE_SUCCESS, queue.Put("f"));
+}
+
+// Test that blocked producers and consumers are woken up.
+TEST(MpmcQueueTest, TestBlocking) {
+  MpmcQueue<int32_t> queue(1, 2);
+  thread consumer([&]() {
+    int32_t i;
+    CHECK(queue.BlockingGet(&i));
+    CHECK_EQ(1, i);
+  });
+  SleepFor(MonoDelta::FromMilliseconds(10));
+  ASSERT_TRUE(queue.BlockingPut(1));
+  consumer.join();
+
+  ASSERT_TRUE(queue.BlockingPut(2));
+  thread producer([&]() {
+    CHECK(queue.BlockingPut(3));
+  });
+  SleepFor(MonoDelta::FromMilliseconds(10));
+  vector<int32_t> out;
+  ASSERT_TRUE(queue.BlockingDrainTo(&out));
+  producer.join();
+  ASSERT_TRUE(queue.BlockingDrainTo(&out));
+  ASSERT_EQ((vector<int32_t>{ 2, 3 }), out);
+}
+
+// Test that a drain with a deadline gives up once it passes, and otherwise
+// returns the elements put while it waits.
+TEST(MpmcQueueTest, TestDrainWithDeadline) {
+  MpmcQueue<int32_t> queue(10, 4);
+  vector<int32_t> out;
+  MonoTime start = MonoTime::Now();
+  ASSERT_TRUE(queue.BlockingDrainTo(&out, start + MonoDelta::FromMilliseconds(50)));
+  ASSERT_TRUE(out.empty());
+  ASSERT_GE((MonoTime::Now() - start).ToMilliseconds(), 50);
+
+  thread producer([&]() {
+    SleepFor(MonoDelta::FromMilliseconds(10));
+    CHECK_EQ(QUEUE_SUCCESS, queue.Put(1));
+  });
+  ASSERT_TRUE(queue.BlockingDrainTo(&out, MonoTime::Now() + MonoDelta::FromSeconds(30)));
+  producer.join();
+  ASSERT_EQ((vector<int32_t>{ 1 }), out);
+
+  queue.Shutdown();
+  ASSERT_FALSE(queue.BlockingDrainTo(&out, MonoTime::Now() + MonoDelta::FromSeconds(30)));
+}
+
+// Test that elements drain out after a shutdown, which wakes up blocked
+// threads.
+TEST(MpmcQueueTest, TestShutdown) {
+  MpmcQueue<int32_t> queue(1, 2);
+  ASSERT_EQ(QUEUE_SUCCESS, queue.Put(1));
+  thread producer([&]() {
+    CHECK(!queue.BlockingPut(2));
+  });
+  SleepFor(MonoDelta::FromMilliseconds(10));
+  queue.Shutdown();
+  producer.join();
+  ASSERT_EQ(QUEUE_SHUTDOWN, queue.Put(3));
+
+  int32_t i;
+  ASSERT_TRUE(queue.BlockingGet(&i));
+  ASSERT_EQ(1, i);
+  ASSERT_FALSE(queue.BlockingGet(&i));
+  vector<int32_t> out;
+  ASSERT_FALSE(queue.BlockingDrainTo(&out));
+}
+
+// Test that every element put by concurrent producers is taken exactly once
+// by concurrent consumers.
+TEST(MpmcQueueTest, TestMultipleProducersAndConsumers) {
+  const int kNumThreads = 4;
+  const int64_t kNumPerProducer = 20000;
+  MpmcQueue<int64_t> queue(64, 64);
+  std::atomic<int64_t> sum(0);
+  std::atomic<int64_t> count(0);
+
+  vector<thread> consumers;
+  for (int i = 0; i < kNumThreads; i++) {
+    consumers.emplace_back([&]() {
+      vector<int64_t> vals;
+      while (queue.BlockingDrainTo(&vals, 16)) {
+        for (int64_t val : vals) {
+          sum += val;
+        }
+        count += vals.size();
+        vals.clear();
+      }
+    });
+  }
+  vector<thread> producers;
+  for (int i = 0; i < kNumThreads; i++) {
+    producers.emplace_back([&]() {
+      for (int64_t val = 1; val <= kNumPerProducer; val++) {
+        CHECK(queue.BlockingPut(val));
+      }
+    });
+  }
+  for (auto& t : producers) {
+    t.join();
+  }
+  queue.Shutdown();
+  for (auto& t : consumers) {
+    t.join();
+  }
+  ASSERT_EQ(kNumThreads * kNumPerProducer, count.load());
+  ASSERT_EQ(kNumThreads * kNumPerProducer * (kNumPerProducer + 1) / 2, sum.load());
+}
+
+} // namespace kudu
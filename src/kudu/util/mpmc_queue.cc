@@ -0,0 +1,60 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/mpmc_queue.h"
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <climits>
+
+#include "kudu/util/monotime.h"
+
+namespace kudu {
+namespace internal {
+
+static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t),
+              "futexes operate on plain 32-bit words");
+
+void FutexWait(std::atomic<int32_t>* word, int32_t expected, const MonoDelta& timeout) {
+#if defined(__linux__)
+  struct timespec ts;
+  if (timeout.Initialized()) {
+    timeout.ToTimeSpec(&ts);
+  }
+  syscall(SYS_futex, reinterpret_cast<int32_t*>(word), FUTEX_WAIT_PRIVATE, expected,
+          timeout.Initialized() ? &ts : nullptr, nullptr, 0);
+#else
+  // Without futexes, poll for the word to change.
+  if (word->load() == expected) {
+    SleepFor(MonoDelta::FromMilliseconds(1));
+  }
+#endif
+}
+
+void FutexWake(std::atomic<int32_t>* word, bool all) {
+#if defined(__linux__)
+  syscall(SYS_futex, reinterpret_cast<int32_t*>(word), FUTEX_WAKE_PRIVATE, all ? INT_MAX : 1,
+          nullptr, nullptr, 0);
+#endif
+}
+
+} // namespace internal
+} // namespace kudu
@@ -0,0 +1,366 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_UTIL_MPMC_QUEUE_H
+#define KUDU_UTIL_MPMC_QUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/bits.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/port.h"
+#include "kudu/util/blocking_queue.h"
+#include "kudu/util/monotime.h"
+
+namespace kudu {
+
+namespace internal {
+
+// Blocks the calling thread until woken by FutexWake() on 'word', unless
+// 'word' no longer holds 'expected', or for at most 'timeout' if it's
+// initialized. May return spuriously.
+void FutexWait(std::atomic<int32_t>* word, int32_t expected,
+               const MonoDelta& timeout = MonoDelta());
+
+// Wakes one, or all, of the threads blocked in FutexWait() on 'word'.
+void FutexWake(std::atomic<int32_t>* word, bool all);
+
+// The threads waiting for a condition on a lock-free structure to hold.
+// Notifiers only make a system call when there are waiters.
+class WaitList {
+ public:
+  WaitList() : seq_(0), num_waiters_(0) {}
+
+  // Blocks the calling thread unless 'ready()' holds, until a Notify()
+  // following the change that made it hold, or for at most 'timeout' if it's
+  // initialized. May return spuriously.
+  template<class F>
+  void WaitUnless(const F& ready, const MonoDelta& timeout = MonoDelta()) {
+    int32_t seq = seq_.load();
+    num_waiters_.fetch_add(1);
+    if (!ready()) {
+      FutexWait(&seq_, seq, timeout);
+    }
+    num_waiters_.fetch_sub(1);
+  }
+
+  // Wakes one, or all, of the waiting threads. Must be called after the
+  // change to the structure that the waiters may be waiting for.
+  void Notify(bool all) {
+    seq_.fetch_add(1);
+    if (num_waiters_.load() > 0) {
+      FutexWake(&seq_, all);
+    }
+  }
+
+ private:
+  std::atomic<int32_t> seq_;
+  std::atomic<int32_t> num_waiters_;
+
+  DISALLOW_COPY_AND_ASSIGN(WaitList);
+};
+
+} // namespace internal
+
+// A bounded multi-producer, multi-consumer queue with the interface of
+// BlockingQueue, for queues hot enough for their lock to be contended.
+//
+// Producers and consumers claim the slots of a ring with atomic operations
+// (after Dmitry Vyukov's bounded MPMC queue), and only block, on a futex,
+// when the queue is full or empty. Rather than a consumer being signalled
+// per element, a consumer woken up can take all the queued elements at once
+// with BlockingDrainTo().
+//
+// As with BlockingQueue, the capacity is the total LOGICAL_SIZE of the
+// elements (e.g. their size in bytes), and one element may take the queue
+// over it. The ring also bounds the number of elements.
+template <typename T, class LOGICAL_SIZE = DefaultLogicalSize>
+class MpmcQueue {
+ public:
+  // If T is a pointer, this will be the base type.  If T is not a pointer, you
+  // can ignore this and the functions which make use of it.
+  typedef typename std::remove_pointer<T>::type T_VAL;
+
+  // 'max_elements' is rounded up to a power of two.
+  MpmcQueue(size_t max_size, size_t max_elements)
+    : max_size_(max_size),
+      mask_((1ULL << Bits::Log2Ceiling64(std::max<size_t>(max_elements, 2))) - 1),
+      slots_(new Slot[mask_ + 1]),
+      size_(0),
+      pending_puts_(0),
+      shutdown_(false),
+      enqueue_pos_(0),
+      dequeue_pos_(0) {
+    for (size_t i = 0; i <= mask_; i++) {
+      slots_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // If the queue holds a bare pointer, it must be empty on destruction, since
+  // it may have ownership of the pointer.
+  ~MpmcQueue() {
+    DCHECK(empty() || !std::is_pointer<T>::value)
+        << "MpmcQueue holds bare pointers at destruction time";
+  }
+
+  // Get an element from the queue.  Returns false if we were shut down prior to
+  // getting the element.
+  bool BlockingGet(T* out) {
+    while (true) {
+      bool done = ShutDownAndIdle();
+      if (TryPop(out)) {
+        not_full_.Notify(false);
+        return true;
+      }
+      if (done) {
+        return false;
+      }
+      not_empty_.WaitUnless([&]() { return !empty() || ShutDownAndIdle(); });
+    }
+  }
+
+  // Get an element from the queue.  Returns false if the queue is empty and
+  // we were shut down prior to getting the element.
+  bool BlockingGet(gscoped_ptr<T_VAL>* out) {
+    T t = NULL;
+    bool got_element = BlockingGet(&t);
+    if (!got_element) {
+      return false;
+    }
+    out->reset(t);
+    return true;
+  }
+
+  // Waits for elements, then appends up to 'max_elements' of them to 'out'.
+  // Returns false if shut down prior to getting any elements.
+  bool BlockingDrainTo(std::vector<T>* out,
+                       size_t max_elements = std::numeric_limits<size_t>::max()) {
+    return BlockingDrainTo(out, MonoTime(), max_elements);
+  }
+
+  // Like the above, but gives up waiting at 'deadline', if it's initialized,
+  // in which case it returns true without appending any elements.
+  bool BlockingDrainTo(std::vector<T>* out, const MonoTime& deadline,
+                       size_t max_elements = std::numeric_limits<size_t>::max()) {
+    while (true) {
+      // Once shut down without puts in flight, nothing else can be queued, so
+      // the queue being empty from then on is final.
+      bool done = ShutDownAndIdle();
+      size_t num_drained = 0;
+      T val;
+      while (num_drained < max_elements && TryPop(&val)) {
+        out->push_back(val);
+        num_drained++;
+      }
+      if (num_drained > 0) {
+        not_full_.Notify(true);
+        return true;
+      }
+      if (done) {
+        return false;
+      }
+      MonoDelta timeout;
+      if (deadline.Initialized()) {
+        MonoTime now = MonoTime::Now();
+        if (now >= deadline) {
+          return true;
+        }
+        timeout = deadline - now;
+      }
+      not_empty_.WaitUnless([&]() { return !empty() || ShutDownAndIdle(); }, timeout);
+    }
+  }
+
+  // Attempts to put the given value in the queue.
+  // Returns:
+  //   QUEUE_SUCCESS: if successfully inserted
+  //   QUEUE_FULL: if the queue has reached max_size or max_elements
+  //   QUEUE_SHUTDOWN: if someone has already called Shutdown()
+  QueueStatus Put(const T& val) {
+    pending_puts_.fetch_add(1);
+    QueueStatus s = PutInFlight(val);
+    // Wake consumers waiting for the last put in flight during a shutdown.
+    if (pending_puts_.fetch_sub(1) == 1 && shutdown_.load()) {
+      not_empty_.Notify(true);
+    } else if (s == QUEUE_SUCCESS) {
+      not_empty_.Notify(false);
+    }
+    return s;
+  }
+
+  // Returns the same as the other Put() overload above.
+  // If the element was inserted, the gscoped_ptr releases its contents.
+  QueueStatus Put(gscoped_ptr<T_VAL>* val) {
+    QueueStatus s = Put(val->get());
+    if (s == QUEUE_SUCCESS) {
+      ignore_result<>(val->release());
+    }
+    return s;
+  }
+
+  // Puts the given value in the queue, blocking while the queue is full.
+  // Returns false if we were shutdown prior to enqueueing the element.
+  bool BlockingPut(const T& val) {
+    while (true) {
+      QueueStatus s = Put(val);
+      if (s != QUEUE_FULL) {
+        return s == QUEUE_SUCCESS;
+      }
+      not_full_.WaitUnless([&]() { return HasRoom() || shutdown_.load(); });
+    }
+  }
+
+  // Same as other BlockingPut() overload above. If the element was
+  // enqueued, gscoped_ptr releases its contents.
+  bool BlockingPut(gscoped_ptr<T_VAL>* val) {
+    bool ret = BlockingPut(val->get());
+    if (ret) {
+      ignore_result(val->release());
+    }
+    return ret;
+  }
+
+  // Shut down the queue.
+  // When a queue is shut down, no more elements can be added to it, and Put()
+  // will return QUEUE_SHUTDOWN. Existing elements will drain out of it, and
+  // then BlockingGet() will start returning false.
+  void Shutdown() {
+    shutdown_.store(true);
+    not_empty_.Notify(true);
+    not_full_.Notify(true);
+  }
+
+  bool empty() const {
+    return enqueue_pos_.load() == dequeue_pos_.load();
+  }
+
+  size_t max_size() const {
+    return max_size_;
+  }
+
+ private:
+  struct Slot {
+    // The position of the element in the slot plus one once it's queued,
+    // or the position of the next element to go in the slot once it's free.
+    std::atomic<size_t> seq;
+    T value;
+  };
+
+  // Put(), once counted in 'pending_puts_'.
+  QueueStatus PutInFlight(const T& val) {
+    if (shutdown_.load()) {
+      return QUEUE_SHUTDOWN;
+    }
+    size_t logical_size = LOGICAL_SIZE::logical_size(val);
+    size_t size = size_.load();
+    do {
+      if (size >= max_size_) {
+        return QUEUE_FULL;
+      }
+    } while (!size_.compare_exchange_weak(size, size + logical_size));
+    if (!TryPush(val)) {
+      size_.fetch_sub(logical_size);
+      return QUEUE_FULL;
+    }
+    return QUEUE_SUCCESS;
+  }
+
+  // Queues 'val' unless the ring is full.
+  bool TryPush(const T& val) {
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    while (true) {
+      Slot* slot = &slots_[pos & mask_];
+      intptr_t diff = static_cast<intptr_t>(slot->seq.load()) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1)) {
+          slot->value = val;
+          slot->seq.store(pos + 1);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Dequeues the oldest element into 'out' unless the queue is empty, or the
+  // oldest element is still being queued.
+  bool TryPop(T* out) {
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    while (true) {
+      Slot* slot = &slots_[pos & mask_];
+      intptr_t diff = static_cast<intptr_t>(slot->seq.load()) -
+                      static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1)) {
+          *out = slot->value;
+          slot->seq.store(pos + mask_ + 1);
+          size_.fetch_sub(LOGICAL_SIZE::logical_size(*out));
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool HasRoom() const {
+    return size_.load() < max_size_ &&
+        enqueue_pos_.load() - dequeue_pos_.load() <= mask_;
+  }
+
+  bool ShutDownAndIdle() const {
+    return shutdown_.load() && pending_puts_.load() == 0;
+  }
+
+  const size_t max_size_;
+  const size_t mask_;
+  gscoped_array<Slot> slots_;
+
+  // The total logical size of the queued elements.
+  std::atomic<size_t> size_;
+
+  // The number of Put() calls in progress.
+  std::atomic<int32_t> pending_puts_;
+
+  std::atomic<bool> shutdown_;
+
+  internal::WaitList not_empty_;
+  internal::WaitList not_full_;
+
+  // Kept on their own cache lines, since producers and consumers each
+  // update one of them.
+  std::atomic<size_t> enqueue_pos_ CACHELINE_ALIGNED;
+  std::atomic<size_t> dequeue_pos_ CACHELINE_ALIGNED;
+
+  DISALLOW_COPY_AND_ASSIGN(MpmcQueue);
+};
+
+} // namespace kudu
+
+#endif
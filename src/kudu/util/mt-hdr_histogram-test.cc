@@ -23,6 +23,7 @@
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/hdr_histogram.h"
 #include "kudu/util/status.h"
+#include "kudu/util/stopwatch.h"
 #include "kudu/util/test_util.h"
 #include "kudu/util/thread.h"
 
@@ -48,12 +49,33 @@ class MtHdrHistogramTest : public KuduTest {
 };
 
 // Increment a counter a bunch of times in the same bucket
-static void IncrementSameHistValue(HdrHistogram* hist, uint64_t value, uint64_t times) {
+template<class Histogram>
+static void IncrementSameHistValue(Histogram* hist, uint64_t value, uint64_t times) {
   for (uint64_t i = 0; i < times; i++) {
     hist->Increment(value);
   }
 }
 
+// Increment a counter a bunch of times in different buckets.
+template<class Histogram>
+static void IncrementHistValues(Histogram* hist, uint64_t times) {
+  for (uint64_t i = 0; i < times; i++) {
+    hist->Increment(i % 1000);
+  }
+}
+
+template<class Histogram>
+static void RunThreads(int num_threads, Histogram* hist, uint64_t times) {
+  vector<scoped_refptr<kudu::Thread>> threads(num_threads);
+  for (int i = 0; i < num_threads; i++) {
+    CHECK_OK(kudu::Thread::Create("test", strings::Substitute("thread-$0", i),
+        IncrementHistValues<Histogram>, hist, times, &threads[i]));
+  }
+  for (int i = 0; i < num_threads; i++) {
+    CHECK_OK(ThreadJoiner(threads[i].get()).Join());
+  }
+}
+
 TEST_F(MtHdrHistogramTest, ConcurrentWriteTest) {
   const uint64_t kValue = 1LU;
 
@@ -62,7 +84,7 @@ TEST_F(MtHdrHistogramTest, ConcurrentWriteTest) {
   auto threads = new scoped_refptr<kudu::Thread>[num_threads_];
   for (int i = 0; i < num_threads_; i++) {
     CHECK_OK(kudu::Thread::Create("test", strings::Substitute("thread-$0", i),
-        IncrementSameHistValue, &hist, kValue, num_times_, &threads[i]));
+        IncrementSameHistValue<HdrHistogram>, &hist, kValue, num_times_, &threads[i]));
   }
   for (int i = 0; i < num_threads_; i++) {
     CHECK_OK(ThreadJoiner(threads[i].get()).Join());
@@ -84,7 +106,7 @@ TEST_F(MtHdrHistogramTest, ConcurrentCopyWhileWritingTest) {
   auto threads = new scoped_refptr<kudu::Thread>[num_threads_];
   for (int i = 0; i < num_threads_; i++) {
     CHECK_OK(kudu::Thread::Create("test", strings::Substitute("thread-$0", i),
-        IncrementSameHistValue, &hist, kValue, num_times_, &threads[i]));
+        IncrementSameHistValue<HdrHistogram>, &hist, kValue, num_times_, &threads[i]));
   }
 
   // This is somewhat racy but the goal is to catch this issue at least
@@ -108,4 +130,61 @@ TEST_F(MtHdrHistogramTest, ConcurrentCopyWhileWritingTest) {
   delete[] threads;
 }
 
+// Merge the shards while writing, and ensure the merged counts are
+// consistent and complete once the writers are done.
+TEST_F(MtHdrHistogramTest, ShardedConcurrentWriteTest) {
+  const uint64_t kValue = 1;
+  ShardedHdrHistogram hist(100000LU, 3);
+
+  auto threads = new scoped_refptr<kudu::Thread>[num_threads_];
+  for (int i = 0; i < num_threads_; i++) {
+    CHECK_OK(kudu::Thread::Create("test", strings::Substitute("thread-$0", i),
+        IncrementSameHistValue<ShardedHdrHistogram>, &hist, kValue, num_times_, &threads[i]));
+  }
+  for (int i = 0; i < 10; i++) {
+    HdrHistogram snapshot(100000LU, 3);
+    hist.MergeInto(&snapshot);
+    ASSERT_EQ(snapshot.TotalCount(), snapshot.CountInBucketForValue(kValue));
+    if (hist.TotalCount() > 0) {
+      ASSERT_EQ(kValue, hist.ValueAtPercentile(99));
+    }
+    SleepFor(MonoDelta::FromMicroseconds(100));
+  }
+  for (int i = 0; i < num_threads_; i++) {
+    CHECK_OK(ThreadJoiner(threads[i].get()).Join());
+  }
+
+  HdrHistogram snapshot(100000LU, 3);
+  hist.MergeInto(&snapshot);
+  ASSERT_EQ(num_threads_ * num_times_, snapshot.CountInBucketForValue(kValue));
+  ASSERT_EQ(num_threads_ * num_times_, hist.TotalCount());
+  ASSERT_EQ(kValue, snapshot.MinValue());
+  ASSERT_EQ(kValue, snapshot.MaxValue());
+
+  delete[] threads;
+}
+
+// Compare the cost of recording into a shared histogram and into a sharded
+// one from many threads.
+TEST_F(MtHdrHistogramTest, BenchmarkShardedWrites) {
+  const uint64_t kNumTimes = num_times_ * 10;
+  HdrHistogram shared(60000000LU, 2);
+  LOG_TIMING(INFO, strings::Substitute("$0 threads recording into a shared histogram",
+                                      num_threads_)) {
+    RunThreads(num_threads_, &shared, kNumTimes);
+  }
+  ShardedHdrHistogram sharded(60000000LU, 2);
+  LOG_TIMING(INFO, strings::Substitute("$0 threads recording into a sharded histogram",
+                                      num_threads_)) {
+    RunThreads(num_threads_, &sharded, kNumTimes);
+  }
+
+  HdrHistogram merged(60000000LU, 2);
+  sharded.MergeInto(&merged);
+  ASSERT_EQ(shared.TotalCount(), merged.TotalCount());
+  ASSERT_EQ(shared.TotalSum(), merged.TotalSum());
+  ASSERT_EQ(shared.ValueAtPercentile(99), merged.ValueAtPercentile(99));
+  ASSERT_EQ(shared.ValueAtPercentile(99), sharded.ValueAtPercentile(99));
+}
+
 } // namespace kudu
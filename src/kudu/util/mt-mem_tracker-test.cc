@@ -0,0 +1,133 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/mem_tracker.h"
+#include "kudu/util/stopwatch.h"
+#include "kudu/util/test_util.h"
+#include "kudu/util/thread.h"
+
+DEFINE_int32(mt_mem_tracker_test_num_threads, 8,
+             "Number of threads to spawn in mt mem tracker tests");
+DEFINE_int32(mt_mem_tracker_test_num_updates, 1000000,
+             "Number of consumption updates made by each thread");
+
+DECLARE_int64(mem_tracker_thread_buffer_bytes);
+
+namespace kudu {
+
+using std::shared_ptr;
+using std::vector;
+using strings::Substitute;
+
+class MultiThreadedMemTrackerTest : public KuduTest {
+ protected:
+  // Has each of the threads consume and release memory through its own child
+  // of 'parent', leaving 'leftover' bytes consumed.
+  static void RunThreads(const shared_ptr<MemTracker>& parent, int64_t leftover) {
+    int num_threads = FLAGS_mt_mem_tracker_test_num_threads;
+    vector<shared_ptr<MemTracker>> children;
+    vector<scoped_refptr<Thread>> threads;
+    for (int i = 0; i < num_threads; i++) {
+      children.push_back(MemTracker::CreateTracker(-1, Substitute("child$0", i), parent));
+      scoped_refptr<Thread> thread;
+      CHECK_OK(Thread::Create("test", Substitute("thread$0", i),
+                              &ConsumeAndRelease, children.back().get(), leftover,
+                              &thread));
+      threads.push_back(thread);
+    }
+    for (const auto& thread : threads) {
+      ASSERT_OK(ThreadJoiner(thread.get()).Join());
+    }
+    // The threads' buffers were flushed as they exited.
+    for (const auto& child : children) {
+      ASSERT_EQ(leftover, child->consumption());
+      child->Release(leftover);
+    }
+  }
+
+  static void ConsumeAndRelease(MemTracker* tracker, int64_t leftover) {
+    for (int i = 0; i < FLAGS_mt_mem_tracker_test_num_updates; i++) {
+      tracker->Consume(100);
+      tracker->Release(100);
+    }
+    tracker->Consume(leftover);
+  }
+};
+
+// Compare the cost of accounting with and without per-thread buffering, with
+// all of the threads updating the same ancestors.
+TEST_F(MultiThreadedMemTrackerTest, TestBufferedConsumption) {
+  const int64_t kLeftover = 12345;
+  for (int64_t buffer_bytes : { 0L, FLAGS_mem_tracker_thread_buffer_bytes }) {
+    FLAGS_mem_tracker_thread_buffer_bytes = buffer_bytes;
+    shared_ptr<MemTracker> parent = MemTracker::CreateTracker(
+        -1, Substitute("parent-$0", buffer_bytes));
+    LOG_TIMING(INFO, Substitute("consumption updates with $0 buffered bytes", buffer_bytes)) {
+      NO_FATALS(RunThreads(parent, kLeftover));
+    }
+    ASSERT_EQ(0, parent->consumption());
+  }
+}
+
+// Test that a tracker close to its limit sees the updates made by other
+// threads right away.
+TEST_F(MultiThreadedMemTrackerTest, TestExactNearLimit) {
+  const int64_t kLimit = 1024L * 1024 * 1024;
+  const int64_t kFilled = kLimit - 1024 * 1024;
+  shared_ptr<MemTracker> parent = MemTracker::CreateTracker(kLimit, "parent");
+  shared_ptr<MemTracker> filler = MemTracker::CreateTracker(-1, "filler", parent);
+  filler->Consume(kFilled);
+
+  int num_threads = FLAGS_mt_mem_tracker_test_num_threads;
+  vector<shared_ptr<MemTracker>> children;
+  vector<scoped_refptr<Thread>> threads;
+  CountDownLatch consumed(num_threads);
+  CountDownLatch checked(1);
+  for (int i = 0; i < num_threads; i++) {
+    children.push_back(MemTracker::CreateTracker(-1, Substitute("child$0", i), parent));
+    MemTracker* child = children.back().get();
+    scoped_refptr<Thread> thread;
+    CHECK_OK(Thread::Create("test", Substitute("thread$0", i),
+                            [&, child]() {
+                              child->Consume(1);
+                              consumed.CountDown();
+                              checked.Wait();
+                              child->Release(1);
+                            }, &thread));
+    threads.push_back(thread);
+  }
+  consumed.Wait();
+  ASSERT_EQ(kFilled + num_threads, parent->consumption());
+  checked.CountDown();
+  for (const auto& thread : threads) {
+    ASSERT_OK(ThreadJoiner(thread.get()).Join());
+  }
+  filler->Release(kFilled);
+  ASSERT_EQ(0, parent->consumption());
+}
+
+} // namespace kudu
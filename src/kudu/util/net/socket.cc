@@ -169,6 +169,22 @@ Status Socket::SetNoDelay(bool enabled) {
   return Status::OK();
 }
 
+Status Socket::GetIncomingCpu(int* cpu) const {
+#if defined(SO_INCOMING_CPU)
+  int val;
+  socklen_t len = sizeof(val);
+  if (getsockopt(fd_, SOL_SOCKET, SO_INCOMING_CPU, &val, &len) == -1) {
+    int err = errno;
+    return Status::NetworkError(std::string("failed to get SO_INCOMING_CPU: ") +
+                                ErrnoToString(err), Slice(), err);
+  }
+  *cpu = val;
+  return Status::OK();
+#else
+  return Status::NotSupported("SO_INCOMING_CPU is not supported on this platform");
+#endif
+}
+
 Status Socket::SetNonBlocking(bool enabled) {
   int curflags = ::fcntl(fd_, F_GETFL, 0);
   if (curflags == -1) {
@@ -241,6 +257,17 @@ Status Socket::SetReuseAddr(bool flag) {
   return Status::OK();
 }
 
+Status Socket::SetReusePort(bool flag) {
+  int err;
+  int int_flag = flag ? 1 : 0;
+  if (setsockopt(fd_, SOL_SOCKET, SO_REUSEPORT, &int_flag, sizeof(int_flag)) == -1) {
+    err = errno;
+    return Status::NetworkError(std::string("failed to set SO_REUSEPORT: ") +
+                                ErrnoToString(err), Slice(), err);
+  }
+  return Status::OK();
+}
+
 Status Socket::BindAndListen(const Sockaddr &sockaddr,
                              int listenQueueSize) {
   RETURN_NOT_OK(SetReuseAddr(true));
@@ -67,6 +67,11 @@ class Socket {
   // Set or clear TCP_NODELAY
   Status SetNoDelay(bool enabled);
 
+  // Get the CPU which processed the latest packets received on the socket
+  // (SO_INCOMING_CPU). Returns Status::NotSupported if the platform can't
+  // tell.
+  Status GetIncomingCpu(int* cpu) const;
+
   // Set or clear O_NONBLOCK
   Status SetNonBlocking(bool enabled);
   Status IsNonBlocking(bool* is_nonblock) const;
@@ -80,6 +85,10 @@ class Socket {
   // Sets SO_REUSEADDR to 'flag'. Should be used prior to Bind().
   Status SetReuseAddr(bool flag);
 
+  // Sets SO_REUSEPORT to 'flag', allowing several sockets to listen on the
+  // same address. Should be used prior to Bind().
+  Status SetReusePort(bool flag);
+
   // Convenience method to invoke the common sequence:
   // 1) SetReuseAddr(true)
   // 2) Bind()
@@ -0,0 +1,34 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/numa.h"
+
+#include <gtest/gtest.h>
+
+#include "kudu/util/test_macros.h"
+
+namespace kudu {
+
+// Test that without --enable_numa_awareness, everything runs on one node.
+TEST(NumaTest, TestSingleNodeByDefault) {
+  ASSERT_EQ(1, NumaNodeCount());
+  ASSERT_EQ(0, CurrentNumaNode());
+  ASSERT_EQ(0, NumaNodeOfCpu(0));
+  ASSERT_OK(BindCurrentThreadToNumaNode(3));
+}
+
+} // namespace kudu
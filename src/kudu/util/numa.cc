@@ -0,0 +1,174 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/numa.h"
+
+#include <algorithm>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <sched.h>
+#include <string>
+#include <vector>
+
+#include "kudu/gutil/once.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/env.h"
+#include "kudu/util/errno.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/flag_tags.h"
+
+DEFINE_bool(enable_numa_awareness, false,
+            "Whether to place RPC reactor and service threads, and block cache "
+            "shards, on the NUMA nodes of the machine. Each node gets its own "
+            "threads and cache shards, and connections are handled on the "
+            "node whose CPUs receive their packets.");
+TAG_FLAG(enable_numa_awareness, advanced);
+TAG_FLAG(enable_numa_awareness, experimental);
+
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+
+namespace {
+
+struct NumaTopology {
+  // The CPUs of each node.
+  vector<vector<int>> node_cpus;
+
+  // The node of each CPU.
+  vector<int> cpu_nodes;
+};
+
+GoogleOnceType g_topology_once;
+NumaTopology* g_topology;
+
+// Parses a list of CPUs as found in sysfs, e.g. "0-3,8-11".
+bool ParseCpuList(const string& list, vector<int>* cpus) {
+  vector<string> ranges = strings::Split(list, ",", strings::SkipWhitespace());
+  for (const string& range : ranges) {
+    vector<string> bounds = strings::Split(range, "-");
+    int32_t first;
+    int32_t last;
+    if (bounds.size() > 2 ||
+        !safe_strto32(bounds[0], &first) ||
+        !safe_strto32(bounds.back(), &last) ||
+        first > last) {
+      return false;
+    }
+    for (int cpu = first; cpu <= last; cpu++) {
+      cpus->push_back(cpu);
+    }
+  }
+  return true;
+}
+
+void InitTopology() {
+  // The instance lives as long as the process.
+  g_topology = new NumaTopology();
+  if (!FLAGS_enable_numa_awareness) {
+    return;
+  }
+
+  Env* env = Env::Default();
+  vector<vector<int>> node_cpus;
+  for (int node = 0; ; node++) {
+    string path = Substitute("/sys/devices/system/node/node$0/cpulist", node);
+    if (!env->FileExists(path)) {
+      break;
+    }
+    faststring contents;
+    vector<int> cpus;
+    Status s = ReadFileToString(env, path, &contents);
+    if (!s.ok() || !ParseCpuList(contents.ToString(), &cpus)) {
+      LOG(WARNING) << "Unable to read the CPUs of NUMA node " << node << " from " << path
+                   << ", disabling NUMA awareness: " << s.ToString();
+      return;
+    }
+    node_cpus.push_back(std::move(cpus));
+  }
+  if (node_cpus.size() <= 1) {
+    return;
+  }
+
+  for (int node = 0; node < node_cpus.size(); node++) {
+    for (int cpu : node_cpus[node]) {
+      if (cpu >= g_topology->cpu_nodes.size()) {
+        g_topology->cpu_nodes.resize(cpu + 1, 0);
+      }
+      g_topology->cpu_nodes[cpu] = node;
+    }
+  }
+  g_topology->node_cpus = std::move(node_cpus);
+  LOG(INFO) << "NUMA awareness enabled for " << g_topology->node_cpus.size() << " nodes";
+}
+
+const NumaTopology& Topology() {
+  GoogleOnceInit(&g_topology_once, &InitTopology);
+  return *g_topology;
+}
+
+} // anonymous namespace
+
+int NumaNodeCount() {
+  return std::max<int>(1, Topology().node_cpus.size());
+}
+
+int CurrentNumaNode() {
+  const NumaTopology& topology = Topology();
+  if (topology.node_cpus.empty()) {
+    return 0;
+  }
+#if defined(__linux__)
+  return NumaNodeOfCpu(sched_getcpu());
+#else
+  return 0;
+#endif
+}
+
+int NumaNodeOfCpu(int cpu) {
+  const NumaTopology& topology = Topology();
+  if (cpu < 0 || cpu >= topology.cpu_nodes.size()) {
+    return 0;
+  }
+  return topology.cpu_nodes[cpu];
+}
+
+Status BindCurrentThreadToNumaNode(int node) {
+  const NumaTopology& topology = Topology();
+  if (topology.node_cpus.empty()) {
+    return Status::OK();
+  }
+#if defined(__linux__)
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  for (int cpu : topology.node_cpus[node % topology.node_cpus.size()]) {
+    CPU_SET(cpu, &cpus);
+  }
+  if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+    int err = errno;
+    return Status::RuntimeError(Substitute("Unable to bind thread to NUMA node $0", node),
+                                ErrnoToString(err), err);
+  }
+#endif
+  return Status::OK();
+}
+
+} // namespace kudu
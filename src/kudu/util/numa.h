@@ -0,0 +1,47 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_UTIL_NUMA_H
+#define KUDU_UTIL_NUMA_H
+
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+// Helpers to keep threads, and the memory they use, on the NUMA node they
+// belong to. The topology is read from /sys/devices/system/node when first
+// needed.
+//
+// Unless --enable_numa_awareness is set, or on machines with a single node,
+// the process is treated as running on one node: NumaNodeCount() returns 1,
+// CurrentNumaNode() returns 0, and threads aren't bound to any CPUs.
+
+// Returns the number of NUMA nodes that threads and memory are placed on.
+int NumaNodeCount();
+
+// Returns the node of the CPU that the calling thread is running on, between
+// 0 and NumaNodeCount() - 1. This is cheap enough to call per operation.
+int CurrentNumaNode();
+
+// Returns the node of 'cpu', or 0 if it's unknown.
+int NumaNodeOfCpu(int cpu);
+
+// Restricts the calling thread to the CPUs of 'node', taken modulo
+// NumaNodeCount(), so that memory it first touches is allocated on that node.
+Status BindCurrentThreadToNumaNode(int node);
+
+} // namespace kudu
+#endif /* KUDU_UTIL_NUMA_H */
@@ -17,12 +17,23 @@
 // Currently, we only store key/value in NVM. All other data structures such as the
 // ShardedLRUCache instances, hash table, etc are in DRAM. The assumption is that
 // the ratio of data stored vs overhead is quite high.
+//
+// By default, the NVM is used as volatile memory through libvmem, and the cache
+// is lost when the process exits. With --nvm_cache_persistent, the entries are
+// allocated from a libpmemobj pool instead. Each entry is then a persistent
+// object holding its key and value, which is marked as committed once it has
+// been inserted. When the pool is reopened, the committed entries are put back
+// into the DRAM index, in the order they were inserted; lookups don't persist
+// the LRU order, which would cost a write to NVM per lookup.
 
 #include "kudu/util/nvm_cache.h"
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <libpmemobj.h>
 #include <libvmem.h>
 #include <memory>
 #include <mutex>
@@ -37,16 +48,25 @@
 #include "kudu/util/atomic.h"
 #include "kudu/util/cache.h"
 #include "kudu/util/cache_metrics.h"
+#include "kudu/util/env.h"
 #include "kudu/util/flags.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/path_util.h"
 
 DEFINE_string(nvm_cache_path, "/vmem",
               "The path at which the NVM cache will try to allocate its memory. "
               "This can be a tmpfs or ramfs for testing purposes.");
 TAG_FLAG(nvm_cache_path, experimental);
 
+DEFINE_bool(nvm_cache_persistent, false,
+            "If true, the NVM cache keeps its entries in a libpmemobj pool file "
+            "in --nvm_cache_path, which is reopened when the server restarts, so "
+            "that the cache is still warm after a restart or an upgrade. The "
+            "pool must not be shared by several servers.");
+TAG_FLAG(nvm_cache_persistent, experimental);
+
 DEFINE_int32(nvm_cache_allocation_retry_count, 10,
              "The number of times that the NVM cache will retry attempts to allocate "
              "memory for new entries. In between attempts, a cache entry will be "
@@ -68,9 +88,22 @@ namespace {
 
 using std::shared_ptr;
 using std::vector;
+using strings::Substitute;
 
 typedef simple_spinlock MutexType;
 
+// The layout name of the persistent pools. Pools written by an incompatible
+// version of the cache must use a different one, so that they are recreated
+// rather than misread.
+const char* const kPoolLayout = "kudu_nvm_cache_v1";
+
+// The type number of the entries in persistent pools.
+const unsigned int kEntryTypeNum = 1;
+
+// The value of LRUHandle::persisted_magic of the entries of persistent pools
+// which have been inserted, and whose key and value were persisted.
+const uint64_t kCommittedEntryMagic = 0x6b756475636e7631ULL;
+
 // LRU cache implementation
 
 // An entry is a variable length heap-allocated structure.  Entries
@@ -87,6 +120,11 @@ struct LRUHandle {
   uint32_t hash;      // Hash of key(); used for fast sharding and comparisons
   uint8_t* kv_data;
 
+  // Only used with persistent pools, to recover the entries on restart. All
+  // the other fields but the lengths and the charge are set anew then.
+  uint64_t persisted_magic;
+  uint64_t insert_seqno;
+
   Slice key() const {
     return Slice(kv_data, key_length);
   }
@@ -186,10 +224,103 @@ class HandleTable {
   }
 };
 
+// The memory from which the entries of the cache are allocated.
+class NvmPool {
+ public:
+  virtual ~NvmPool() {}
+
+  // Returns NULL if the pool is out of memory.
+  virtual void* Allocate(size_t size) = 0;
+  virtual void Free(void* ptr) = 0;
+
+  // Whether the pool outlives the cache, so that its entries must be
+  // persisted and recovered.
+  virtual bool persistent() const { return false; }
+
+  // Makes the 'len' bytes at 'addr' durable.
+  virtual void Persist(const void* addr, size_t len) {}
+};
+
+// A libvmem pool. Per the note at the top of this file, the cache is then
+// entirely volatile, so the pool is deleted along with it.
+class VmemPool : public NvmPool {
+ public:
+  explicit VmemPool(VMEM* vmp) : vmp_(vmp) {}
+  ~VmemPool() { vmem_delete(vmp_); }
+
+  void* Allocate(size_t size) OVERRIDE { return vmem_malloc(vmp_, size); }
+  void Free(void* ptr) OVERRIDE { vmem_free(vmp_, ptr); }
+
+ private:
+  VMEM* const vmp_;
+};
+
+// A libpmemobj pool, whose objects are the entries of the cache.
+class PmemObjPool : public NvmPool {
+ public:
+  explicit PmemObjPool(PMEMobjpool* pop)
+      : pop_(pop),
+        // Any object of the pool carries its UUID, which is needed to turn
+        // the pointers to entries back into object IDs.
+        pool_uuid_lo_(pmemobj_root(pop, sizeof(uint64_t)).pool_uuid_lo) {
+  }
+  ~PmemObjPool() { pmemobj_close(pop_); }
+
+  void* Allocate(size_t size) OVERRIDE {
+    PMEMoid oid;
+    if (pmemobj_alloc(pop_, &oid, size, kEntryTypeNum, nullptr, nullptr) != 0) {
+      return nullptr;
+    }
+    return pmemobj_direct(oid);
+  }
+
+  void Free(void* ptr) OVERRIDE {
+    PMEMoid oid = ToOid(ptr);
+    pmemobj_free(&oid);
+  }
+
+  bool persistent() const OVERRIDE { return true; }
+
+  void Persist(const void* addr, size_t len) OVERRIDE {
+    pmemobj_persist(pop_, addr, len);
+  }
+
+  // Calls 'f' with each object of the pool and its usable size.
+  void ForEachObject(const std::function<void(void* ptr, size_t size)>& f) {
+    for (PMEMoid oid = pmemobj_first(pop_, kEntryTypeNum); !OID_IS_NULL(oid);
+         oid = pmemobj_next(oid)) {
+      f(pmemobj_direct(oid), pmemobj_alloc_usable_size(oid));
+    }
+  }
+
+ private:
+  PMEMoid ToOid(void* ptr) const {
+    PMEMoid oid;
+    oid.pool_uuid_lo = pool_uuid_lo_;
+    oid.off = reinterpret_cast<uintptr_t>(ptr) - reinterpret_cast<uintptr_t>(pop_);
+    return oid;
+  }
+
+  PMEMobjpool* const pop_;
+  const uint64_t pool_uuid_lo_;
+};
+
+// Returns the memory of 'e' to 'pool'. In a persistent pool, the entry is
+// first marked as not committed: a crash may leave it allocated, and the
+// memory may later be reused for another entry, whose header would then
+// still look committed until it is overwritten.
+void FreeToPool(NvmPool* pool, LRUHandle* e) {
+  if (pool->persistent()) {
+    e->persisted_magic = 0;
+    pool->Persist(&e->persisted_magic, sizeof(e->persisted_magic));
+  }
+  pool->Free(e);
+}
+
 // A single shard of sharded cache.
 class NvmLRUCache {
  public:
-  explicit NvmLRUCache(VMEM *vmp);
+  explicit NvmLRUCache(NvmPool* pool);
   ~NvmLRUCache();
 
   // Separate from constructor so caller can easily make an array of LRUCache
@@ -203,8 +334,14 @@ class NvmLRUCache {
   Cache::Handle* Lookup(const Slice& key, uint32_t hash, bool caching);
   void Release(Cache::Handle* handle);
   void Erase(const Slice& key, uint32_t hash);
+  size_t EraseMatching(const std::function<bool(const Slice& key)>& pred);
   void* AllocateAndRetry(size_t size);
 
+  size_t usage() {
+    std::lock_guard<MutexType> l(mutex_);
+    return usage_;
+  }
+
  private:
   void NvmLRU_Remove(LRUHandle* e);
   void NvmLRU_Append(LRUHandle* e);
@@ -221,8 +358,9 @@ class NvmLRUCache {
   // as its head.
   void FreeLRUEntries(LRUHandle* to_free_head);
 
-  // Wrapper around vmem_malloc which injects failures based on a flag.
-  void* VmemMalloc(size_t size);
+  // Wrapper around the pool's allocation which injects failures based on a
+  // flag.
+  void* PoolMalloc(size_t size);
 
   // Initialized before use.
   size_t capacity_;
@@ -237,14 +375,14 @@ class NvmLRUCache {
 
   HandleTable table_;
 
-  VMEM* vmp_;
+  NvmPool* const pool_;
 
   CacheMetrics* metrics_;
 };
 
-NvmLRUCache::NvmLRUCache(VMEM* vmp)
+NvmLRUCache::NvmLRUCache(NvmPool* pool)
   : usage_(0),
-  vmp_(vmp),
+  pool_(pool),
   metrics_(NULL) {
   // Make empty circular linked list
   lru_.next = &lru_;
@@ -252,6 +390,11 @@ NvmLRUCache::NvmLRUCache(VMEM* vmp)
 }
 
 NvmLRUCache::~NvmLRUCache() {
+  // The entries of a persistent pool are left in it, to be recovered when
+  // it's reopened. Their eviction callbacks aren't called.
+  if (pool_->persistent()) {
+    return;
+  }
   for (LRUHandle* e = lru_.next; e != &lru_; ) {
     LRUHandle* next = e->next;
     DCHECK_EQ(e->refs, 1);  // Error if caller has an unreleased handle
@@ -262,11 +405,11 @@ NvmLRUCache::~NvmLRUCache() {
   }
 }
 
-void* NvmLRUCache::VmemMalloc(size_t size) {
+void* NvmLRUCache::PoolMalloc(size_t size) {
   if (PREDICT_FALSE(FLAGS_nvm_cache_simulate_allocation_failure)) {
     return NULL;
   }
-  return vmem_malloc(vmp_, size);
+  return pool_->Allocate(size);
 }
 
 bool NvmLRUCache::Unref(LRUHandle* e) {
@@ -283,7 +426,7 @@ void NvmLRUCache::FreeEntry(LRUHandle* e) {
     metrics_->cache_usage->DecrementBy(e->charge);
     metrics_->evictions->Increment();
   }
-  vmem_free(vmp_, e);
+  FreeToPool(pool_, e);
 }
 
 // Allocate nvm memory. Try until successful or FLAGS_nvm_cache_allocation_retry_count
@@ -297,7 +440,7 @@ void *NvmLRUCache::AllocateAndRetry(size_t size) {
   // return NULL, which will cause the caller to not insert anything
   // into the cache.
   LRUHandle *to_remove_head = NULL;
-  tmp = VmemMalloc(size);
+  tmp = PoolMalloc(size);
 
   if (tmp == NULL) {
     std::unique_lock<MutexType> l(mutex_);
@@ -308,7 +451,7 @@ void *NvmLRUCache::AllocateAndRetry(size_t size) {
 
       // Unlock while allocating memory.
       l.unlock();
-      tmp = VmemMalloc(size);
+      tmp = PoolMalloc(size);
       l.lock();
     }
   }
@@ -451,6 +594,30 @@ void NvmLRUCache::Erase(const Slice& key, uint32_t hash) {
     FreeEntry(e);
   }
 }
+
+size_t NvmLRUCache::EraseMatching(const std::function<bool(const Slice& key)>& pred) {
+  LRUHandle* to_remove_head = NULL;
+  size_t num_erased = 0;
+  {
+    std::lock_guard<MutexType> l(mutex_);
+    for (LRUHandle* e = lru_.next; e != &lru_; ) {
+      LRUHandle* next = e->next;
+      if (pred(e->key())) {
+        NvmLRU_Remove(e);
+        table_.Remove(e->key(), e->hash);
+        if (Unref(e)) {
+          e->next = to_remove_head;
+          to_remove_head = e;
+        }
+        num_erased++;
+      }
+      e = next;
+    }
+  }
+  FreeLRUEntries(to_remove_head);
+  return num_erased;
+}
+
 static const int kNumShardBits = 4;
 static const int kNumShards = 1 << kNumShardBits;
 
@@ -460,7 +627,10 @@ class ShardedLRUCache : public Cache {
   vector<NvmLRUCache*> shards_;
   MutexType id_mutex_;
   uint64_t last_id_;
-  VMEM* vmp_;
+  gscoped_ptr<NvmPool> pool_;
+
+  // The insertion sequence number of the last entry inserted.
+  AtomicInt<uint64_t> last_insert_seqno_;
 
   static inline uint32_t HashSlice(const Slice& s) {
     return util_hash::CityHash64(
@@ -472,13 +642,14 @@ class ShardedLRUCache : public Cache {
   }
 
  public:
-  explicit ShardedLRUCache(size_t capacity, const string& id, VMEM* vmp)
+  ShardedLRUCache(size_t capacity, const string& id, gscoped_ptr<NvmPool> pool)
         : last_id_(0),
-          vmp_(vmp) {
+          pool_(std::move(pool)),
+          last_insert_seqno_(0) {
 
     const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
     for (int s = 0; s < kNumShards; s++) {
-      gscoped_ptr<NvmLRUCache> shard(new NvmLRUCache(vmp_));
+      gscoped_ptr<NvmLRUCache> shard(new NvmLRUCache(pool_.get()));
       shard->SetCapacity(per_shard);
       shards_.push_back(shard.release());
     }
@@ -486,15 +657,62 @@ class ShardedLRUCache : public Cache {
 
   virtual ~ShardedLRUCache() {
     STLDeleteElements(&shards_);
-    // Per the note at the top of this file, our cache is entirely volatile.
-    // Hence, when the cache is destructed, we delete the underlying
-    // VMEM pool.
-    vmem_delete(vmp_);
   }
 
+  // Puts the committed entries of 'pool' back into the cache, and frees the
+  // others, which were allocated but never inserted.
+  void Recover(PmemObjPool* pool) {
+    vector<LRUHandle*> entries;
+    vector<void*> incomplete;
+    int64_t recovered_bytes = 0;
+    pool->ForEachObject([&](void* ptr, size_t size) {
+        LRUHandle* h = reinterpret_cast<LRUHandle*>(ptr);
+        if (size < sizeof(LRUHandle) ||
+            h->persisted_magic != kCommittedEntryMagic ||
+            sizeof(LRUHandle) + h->key_length + h->val_length > size) {
+          incomplete.push_back(ptr);
+          return;
+        }
+        h->kv_data = reinterpret_cast<uint8_t*>(ptr) + sizeof(LRUHandle);
+        h->hash = HashSlice(h->key());
+        entries.push_back(h);
+        recovered_bytes += h->charge;
+      });
+    for (void* ptr : incomplete) {
+      pool->Free(ptr);
+    }
+
+    // Inserting the entries in their original order restores their LRU
+    // order, as of their insertion. If the capacity is now lower, the
+    // oldest entries are evicted.
+    std::sort(entries.begin(), entries.end(), [](const LRUHandle* a, const LRUHandle* b) {
+        return a->insert_seqno < b->insert_seqno;
+      });
+    for (LRUHandle* h : entries) {
+      NvmLRUCache* shard = shards_[Shard(h->hash)];
+      shard->Release(shard->Insert(h, nullptr));
+    }
+    if (!entries.empty()) {
+      last_insert_seqno_.Store(entries.back()->insert_seqno);
+    }
+    LOG(INFO) << Substitute("Recovered $0 entries ($1 bytes) of the persistent NVM cache, "
+                            "and dropped $2 incomplete entries",
+                            entries.size(), recovered_bytes, incomplete.size());
+  }
+
+  // The NVM cache is plain LRU, so 'priority' is ignored.
   virtual Handle* Insert(PendingHandle* handle,
-                         Cache::EvictionCallback* eviction_callback) OVERRIDE {
+                         Cache::EvictionCallback* eviction_callback,
+                         Cache::Priority /* priority */) OVERRIDE {
     LRUHandle* h = reinterpret_cast<LRUHandle*>(DCHECK_NOTNULL(handle));
+    if (pool_->persistent()) {
+      // The entry must be complete in the pool before it's marked as
+      // committed.
+      h->insert_seqno = last_insert_seqno_.Increment();
+      pool_->Persist(h, sizeof(LRUHandle) + h->key_length + h->val_length);
+      h->persisted_magic = kCommittedEntryMagic;
+      pool_->Persist(&h->persisted_magic, sizeof(h->persisted_magic));
+    }
     return shards_[Shard(h->hash)]->Insert(h, eviction_callback);
   }
   virtual Handle* Lookup(const Slice& key, CacheBehavior caching) OVERRIDE {
@@ -509,6 +727,13 @@ class ShardedLRUCache : public Cache {
     const uint32_t hash = HashSlice(key);
     shards_[Shard(hash)]->Erase(key, hash);
   }
+  virtual size_t EraseMatching(const std::function<bool(const Slice& key)>& pred) OVERRIDE {
+    size_t num_erased = 0;
+    for (NvmLRUCache* cache : shards_) {
+      num_erased += cache->EraseMatching(pred);
+    }
+    return num_erased;
+  }
   virtual Slice Value(Handle* handle) OVERRIDE {
     return reinterpret_cast<LRUHandle*>(handle)->value();
   }
@@ -522,9 +747,13 @@ class ShardedLRUCache : public Cache {
   }
   virtual void SetMetrics(const scoped_refptr<MetricEntity>& entity) OVERRIDE {
     metrics_.reset(new CacheMetrics(entity));
+    // A persistent cache may already hold recovered entries.
+    uint64_t usage = 0;
     for (NvmLRUCache* cache : shards_) {
       cache->SetMetrics(metrics_.get());
+      usage += cache->usage();
     }
+    metrics_->cache_usage->set_value(usage);
   }
   virtual PendingHandle* Allocate(Slice key, int val_len, int charge) OVERRIDE {
     int key_len = key.size();
@@ -545,6 +774,7 @@ class ShardedLRUCache : public Cache {
         handle->key_length = key_len;
         handle->charge = charge + key.size();
         handle->hash = HashSlice(key);
+        handle->persisted_magic = 0;
         memcpy(handle->kv_data, key.data(), key.size());
         return reinterpret_cast<PendingHandle*>(handle);
       }
@@ -554,13 +784,46 @@ class ShardedLRUCache : public Cache {
   }
 
   virtual void Free(PendingHandle* ph) OVERRIDE {
-    vmem_free(vmp_, ph);
+    FreeToPool(pool_.get(), reinterpret_cast<LRUHandle*>(ph));
   }
 };
 
+// Opens the persistent pool of the cache 'id', creating it if there's none.
+PMEMobjpool* OpenPersistentPool(size_t capacity, const std::string& id) {
+  Env* env = Env::Default();
+  string path = JoinPathSegments(FLAGS_nvm_cache_path, id + ".pool");
+  if (env->FileExists(path)) {
+    PMEMobjpool* pop = pmemobj_open(path.c_str(), kPoolLayout);
+    if (pop != nullptr) {
+      return pop;
+    }
+    // The pool may have been left by an incompatible version of the cache,
+    // or be corrupt. Either way, the cache just starts cold.
+    LOG(WARNING) << "Could not open persistent NVM cache pool " << path << ": "
+                 << pmemobj_errormsg() << "; recreating it";
+    CHECK_OK(env->DeleteFile(path));
+  }
+  CHECK_GE(capacity, PMEMOBJ_MIN_POOL)
+    << "configured capacity " << capacity << " bytes is less than "
+    << "the minimum capacity for a persistent NVM cache: " << PMEMOBJ_MIN_POOL;
+  PMEMobjpool* pop = pmemobj_create(path.c_str(), kPoolLayout, capacity, 0600);
+  PLOG_IF(FATAL, pop == nullptr) << "Could not create persistent NVM cache pool "
+                                 << path << ": " << pmemobj_errormsg();
+  return pop;
+}
+
 } // end anonymous namespace
 
 Cache* NewLRUNvmCache(size_t capacity, const std::string& id) {
+  if (FLAGS_nvm_cache_persistent) {
+    gscoped_ptr<PmemObjPool> pool(new PmemObjPool(OpenPersistentPool(capacity, id)));
+    PmemObjPool* pool_ptr = pool.get();
+    gscoped_ptr<ShardedLRUCache> cache(
+        new ShardedLRUCache(capacity, id, gscoped_ptr<NvmPool>(pool.release())));
+    cache->Recover(pool_ptr);
+    return cache.release();
+  }
+
   // vmem_create() will fail if the capacity is too small, but with
   // an inscrutable error. So, we'll check ourselves.
   CHECK_GE(capacity, VMEM_MIN_POOL)
@@ -572,7 +835,7 @@ Cache* NewLRUNvmCache(size_t capacity, const std::string& id) {
   PLOG_IF(FATAL, vmp == NULL) << "Could not initialize NVM cache library in path "
                               << FLAGS_nvm_cache_path.c_str();
 
-  return new ShardedLRUCache(capacity, id, vmp);
+  return new ShardedLRUCache(capacity, id, gscoped_ptr<NvmPool>(new VmemPool(vmp)));
 }
 
 }  // namespace kudu
@@ -23,6 +23,12 @@ namespace kudu {
 class Cache;
 
 // Create a cache in persistent memory with the given capacity.
+//
+// With --nvm_cache_persistent, the entries of the cache 'id' are kept in a
+// pool which outlives the cache, and are recovered by the next cache created
+// with the same 'id'. They may then refer to data which no longer exists,
+// so the caller must erase those (see Cache::EraseMatching()) before any
+// lookups.
 Cache* NewLRUNvmCache(size_t capacity, const std::string& id);
 
 }  // namespace kudu
@@ -842,10 +842,13 @@ Status ReadPBContainerFromPath(Env* env, const std::string& path, Message* msg)
   return pb_file.Close();
 }
 
-Status WritePBContainerToPath(Env* env, const std::string& path,
-                              const Message& msg,
-                              CreateMode create,
-                              SyncMode sync) {
+namespace {
+
+Status DoWritePBContainerToPath(Env* env, const std::string& path,
+                                const Message& msg,
+                                CreateMode create,
+                                SyncMode sync,
+                                bool sync_dir) {
   TRACE_EVENT2("io", "WritePBContainerToPath",
                "path", path,
                "msg_type", msg.GetTypeName());
@@ -871,13 +874,28 @@ Status WritePBContainerToPath(Env* env, const std::string& path,
   RETURN_NOT_OK_PREPEND(env->RenameFile(tmp_path, path),
                         "Failed to rename tmp file to " + path);
   tmp_deleter.Cancel();
-  if (sync == pb_util::SYNC) {
+  if (sync == pb_util::SYNC && sync_dir) {
     RETURN_NOT_OK_PREPEND(env->SyncDir(DirName(path)),
                           "Failed to SyncDir() parent of " + path);
   }
   return Status::OK();
 }
 
+} // anonymous namespace
+
+Status WritePBContainerToPath(Env* env, const std::string& path,
+                              const Message& msg,
+                              CreateMode create,
+                              SyncMode sync) {
+  return DoWritePBContainerToPath(env, path, msg, create, sync, true);
+}
+
+Status WritePBContainerToPathWithoutDirSync(Env* env, const std::string& path,
+                                            const Message& msg,
+                                            CreateMode create) {
+  return DoWritePBContainerToPath(env, path, msg, create, pb_util::SYNC, false);
+}
+
 
 scoped_refptr<debug::ConvertableToTraceFormat> PbTracer::TracePb(const Message& msg) {
   return make_scoped_refptr(new PbTracer(msg));
@@ -428,6 +428,14 @@ Status WritePBContainerToPath(Env* env, const std::string& path,
                               CreateMode create,
                               SyncMode sync);
 
+// Like WritePBContainerToPath() with SYNC, except that the parent directory
+// of 'path' isn't fsynced: the new file is durable, but its rename over 'path'
+// isn't until the caller fsyncs the directory. Callers replacing many files
+// of one directory may then fsync it once for all of them.
+Status WritePBContainerToPathWithoutDirSync(Env* env, const std::string& path,
+                                            const google::protobuf::Message& msg,
+                                            CreateMode create);
+
 // Wrapper for a protobuf message which lazily converts to JSON when
 // the trace buffer is dumped.
 //
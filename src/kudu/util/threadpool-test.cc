@@ -19,17 +19,22 @@
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/promise.h"
+#include "kudu/util/thread.h"
 #include "kudu/util/threadpool.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/trace.h"
 
 using std::shared_ptr;
+using std::unique_ptr;
+using std::vector;
 
 namespace kudu {
 
@@ -259,6 +264,8 @@ METRIC_DEFINE_histogram(test_entity, queue_time, "queue time",
 
 METRIC_DEFINE_histogram(test_entity, run_time, "run time",
                         MetricUnit::kMicroseconds, "run time", 1000, 1);
+METRIC_DEFINE_histogram(test_entity, token_run_time, "token run time",
+                        MetricUnit::kMicroseconds, "token run time", 1000, 1);
 
 TEST(TestThreadPool, TestMetrics) {
   MetricRegistry registry;
@@ -291,6 +298,140 @@ TEST(TestThreadPool, TestMetrics) {
   ASSERT_EQ(kNumItems, run_time->TotalCount());
 }
 
+static void AppendUnderLock(int i, std::mutex* lock, vector<int>* out) {
+  SleepFor(MonoDelta::FromMicroseconds(i % 3));
+  std::lock_guard<std::mutex> l(*lock);
+  out->push_back(i);
+}
+
+// Test that tasks submitted through a SERIAL token run one at a time and in
+// submission order, even though the pool has spare threads.
+TEST(TestThreadPool, TestSerialToken) {
+  gscoped_ptr<ThreadPool> thread_pool;
+  ASSERT_OK(BuildMinMaxTestPool(0, 4, &thread_pool));
+  unique_ptr<ThreadPoolToken> t1 = thread_pool->NewToken(ThreadPool::ExecutionMode::SERIAL);
+  unique_ptr<ThreadPoolToken> t2 = thread_pool->NewToken(ThreadPool::ExecutionMode::SERIAL);
+
+  std::mutex lock;
+  vector<int> out1;
+  vector<int> out2;
+  const int kNumTasks = 100;
+  for (int i = 0; i < kNumTasks; i++) {
+    ASSERT_OK(t1->SubmitFunc(boost::bind(&AppendUnderLock, i, &lock, &out1)));
+    ASSERT_OK(t2->SubmitFunc(boost::bind(&AppendUnderLock, i, &lock, &out2)));
+  }
+  t1->Wait();
+  t2->Wait();
+  ASSERT_EQ(kNumTasks, out1.size());
+  ASSERT_EQ(kNumTasks, out2.size());
+  for (int i = 0; i < kNumTasks; i++) {
+    ASSERT_EQ(i, out1[i]);
+    ASSERT_EQ(i, out2[i]);
+  }
+}
+
+// Test that a CONCURRENT token's tasks may run at the same time.
+TEST(TestThreadPool, TestConcurrentToken) {
+  gscoped_ptr<ThreadPool> thread_pool;
+  ASSERT_OK(BuildMinMaxTestPool(0, 2, &thread_pool));
+  unique_ptr<ThreadPoolToken> t = thread_pool->NewToken(ThreadPool::ExecutionMode::CONCURRENT);
+
+  // Each task waits for the other, so they only complete if both run at once.
+  CountDownLatch latch(2);
+  for (int i = 0; i < 2; i++) {
+    ASSERT_OK(t->SubmitFunc([&latch]() {
+          latch.CountDown();
+          latch.Wait();
+        }));
+  }
+  t->Wait();
+}
+
+// Test that shutting down a token drops its queued tasks, waits for its
+// running one, and leaves the pool and other tokens usable.
+TEST(TestThreadPool, TestTokenShutdown) {
+  gscoped_ptr<ThreadPool> thread_pool;
+  ASSERT_OK(BuildMinMaxTestPool(0, 4, &thread_pool));
+  unique_ptr<ThreadPoolToken> t1 = thread_pool->NewToken(ThreadPool::ExecutionMode::SERIAL);
+  unique_ptr<ThreadPoolToken> t2 = thread_pool->NewToken(ThreadPool::ExecutionMode::SERIAL);
+
+  CountDownLatch started(1);
+  CountDownLatch release(1);
+  Atomic32 counter(0);
+  ASSERT_OK(t1->SubmitFunc([&]() {
+        started.CountDown();
+        release.Wait();
+      }));
+  for (int i = 0; i < 10; i++) {
+    ASSERT_OK(t1->SubmitFunc(boost::bind(&SimpleTaskMethod, 1, &counter)));
+  }
+  started.Wait();
+
+  // Shut the token down from another thread, since it blocks until the
+  // running task finishes.
+  CountDownLatch shut_down(1);
+  scoped_refptr<Thread> shutdown_thread;
+  ASSERT_OK(Thread::Create("test", "shutdown", [&]() {
+        t1->Shutdown();
+        shut_down.CountDown();
+      }, &shutdown_thread));
+  ASSERT_FALSE(shut_down.WaitFor(MonoDelta::FromMilliseconds(100)));
+  release.CountDown();
+  shut_down.Wait();
+  shutdown_thread->Join();
+
+  // None of the queued tasks ran, and the token rejects new ones.
+  ASSERT_EQ(0, base::subtle::NoBarrier_Load(&counter));
+  Status s = t1->SubmitFunc(boost::bind(&SimpleTaskMethod, 1, &counter));
+  ASSERT_TRUE(s.IsServiceUnavailable()) << s.ToString();
+  t1->Wait();
+
+  // The other token and the pool are unaffected.
+  ASSERT_OK(t2->SubmitFunc(boost::bind(&SimpleTaskMethod, 1, &counter)));
+  ASSERT_OK(thread_pool->SubmitFunc(boost::bind(&SimpleTaskMethod, 1, &counter)));
+  t2->Wait();
+  thread_pool->Wait();
+  ASSERT_EQ(2, base::subtle::NoBarrier_Load(&counter));
+
+  // Shutting the pool down quiesces its tokens.
+  thread_pool->Shutdown();
+  s = t2->SubmitFunc(boost::bind(&SimpleTaskMethod, 1, &counter));
+  ASSERT_TRUE(s.IsServiceUnavailable()) << s.ToString();
+  t2->Wait();
+}
+
+TEST(TestThreadPool, TestTokenMetrics) {
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity = METRIC_ENTITY_test_entity.Instantiate(
+      &registry, "test entity");
+
+  gscoped_ptr<ThreadPool> thread_pool;
+  ASSERT_OK(BuildMinMaxTestPool(1, 1, &thread_pool));
+  scoped_refptr<Histogram> pool_run_time = METRIC_run_time.Instantiate(entity);
+  thread_pool->SetRunTimeMicrosHistogram(pool_run_time);
+
+  ThreadPoolMetrics metrics;
+  metrics.queue_length_histogram = METRIC_queue_length.Instantiate(entity);
+  metrics.queue_time_us_histogram = METRIC_queue_time.Instantiate(entity);
+  metrics.run_time_us_histogram = METRIC_token_run_time.Instantiate(entity);
+  unique_ptr<ThreadPoolToken> t = thread_pool->NewTokenWithMetrics(
+      ThreadPool::ExecutionMode::SERIAL, metrics);
+
+  const int kNumTokenItems = 50;
+  for (int i = 0; i < kNumTokenItems; i++) {
+    ASSERT_OK(t->SubmitFunc(boost::bind(&usleep, i)));
+  }
+  ASSERT_OK(thread_pool->SubmitFunc(boost::bind(&usleep, 1)));
+  thread_pool->Wait();
+
+  // The token's histograms only see the token's tasks, while the pool's see
+  // every task.
+  ASSERT_EQ(kNumTokenItems, metrics.queue_length_histogram->TotalCount());
+  ASSERT_EQ(kNumTokenItems, metrics.queue_time_us_histogram->TotalCount());
+  ASSERT_EQ(kNumTokenItems, metrics.run_time_us_histogram->TotalCount());
+  ASSERT_EQ(kNumTokenItems + 1, pool_run_time->TotalCount());
+}
+
 // Test that a thread pool will crash if asked to run its own blocking
 // functions in a pool thread.
 //
@@ -22,6 +22,7 @@
 #include <glog/logging.h>
 #include <limits>
 #include <string>
+#include <utility>
 
 #include "kudu/gutil/callback.h"
 #include "kudu/gutil/stl_util.h"
@@ -34,6 +35,7 @@
 
 namespace kudu {
 
+using std::unique_ptr;
 using strings::Substitute;
 
 ////////////////////////////////////////////////////////
@@ -98,6 +100,159 @@ Status ThreadPoolBuilder::Build(gscoped_ptr<ThreadPool>* pool) const {
   return Status::OK();
 }
 
+namespace {
+
+// Releases the trace references held by queued entries which will never run.
+// The entries' runnables are destroyed along with 'entries'.
+template<class Entries>
+void ReleaseEntries(Entries* entries) {
+  for (auto& e : *entries) {
+    if (e.trace) {
+      e.trace->Release();
+    }
+  }
+  entries->clear();
+}
+
+} // anonymous namespace
+
+////////////////////////////////////////////////////////
+// ThreadPoolToken
+////////////////////////////////////////////////////////
+
+ThreadPoolToken::ThreadPoolToken(ThreadPool* pool,
+                                 ThreadPool::ExecutionMode mode,
+                                 ThreadPoolMetrics metrics)
+    : mode_(mode),
+      metrics_(std::move(metrics)),
+      pool_(pool),
+      state_(State::IDLE),
+      not_running_cond_(&pool->lock_),
+      active_threads_(0) {
+}
+
+ThreadPoolToken::~ThreadPoolToken() {
+  Shutdown();
+  pool_->ReleaseToken(this);
+}
+
+Status ThreadPoolToken::SubmitClosure(const Closure& task) {
+  return SubmitFunc(boost::bind(&Closure::Run, task));
+}
+
+Status ThreadPoolToken::SubmitFunc(const boost::function<void()>& func) {
+  return Submit(std::shared_ptr<Runnable>(new FunctionRunnable(func)));
+}
+
+Status ThreadPoolToken::Submit(const std::shared_ptr<Runnable>& task) {
+  return pool_->DoSubmit(task, this);
+}
+
+void ThreadPoolToken::Shutdown() {
+  MutexLock unique_lock(pool_->lock_);
+  pool_->CheckNotPoolThreadUnlocked();
+
+  // Clear the queue under the lock, but release the tasks outside of it, as
+  // in ThreadPool::Shutdown().
+  std::deque<ThreadPool::QueueEntry> to_release = std::move(entries_);
+  entries_.clear();
+  pool_->queue_size_ -= to_release.size();
+
+  switch (state_) {
+    case State::IDLE:
+      Transition(State::QUIESCED);
+      break;
+    case State::RUNNING:
+      // Remove the token from the pool's queue so no worker picks it up
+      // again. This is O(n) in the size of the queue, but shutting a token
+      // down is expected to be infrequent.
+      for (auto it = pool_->queue_.begin(); it != pool_->queue_.end();) {
+        if (*it == this) {
+          it = pool_->queue_.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      if (active_threads_ == 0) {
+        Transition(State::QUIESCED);
+        break;
+      }
+      // The worker running the token's last task will quiesce it.
+      Transition(State::QUIESCING);
+      FALLTHROUGH_INTENDED;
+    case State::QUIESCING:
+      while (state_ != State::QUIESCED) {
+        not_running_cond_.Wait();
+      }
+      break;
+    default:
+      break;
+  }
+
+  unique_lock.Unlock();
+  ReleaseEntries(&to_release);
+}
+
+void ThreadPoolToken::Wait() {
+  MutexLock unique_lock(pool_->lock_);
+  pool_->CheckNotPoolThreadUnlocked();
+  while (IsActive()) {
+    not_running_cond_.Wait();
+  }
+}
+
+bool ThreadPoolToken::WaitUntil(const MonoTime& until) {
+  return WaitFor(until - MonoTime::Now());
+}
+
+bool ThreadPoolToken::WaitFor(const MonoDelta& delta) {
+  MutexLock unique_lock(pool_->lock_);
+  pool_->CheckNotPoolThreadUnlocked();
+  while (IsActive()) {
+    if (!not_running_cond_.TimedWait(delta)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ThreadPoolToken::Transition(State new_state) {
+#ifndef NDEBUG
+  CHECK(state_ != new_state);
+  switch (state_) {
+    case State::IDLE:
+      CHECK(new_state == State::RUNNING || new_state == State::QUIESCED);
+      break;
+    case State::RUNNING:
+      CHECK(new_state == State::IDLE ||
+            new_state == State::QUIESCING ||
+            new_state == State::QUIESCED);
+      break;
+    case State::QUIESCING:
+      CHECK(new_state == State::QUIESCED);
+      break;
+    case State::QUIESCED:
+      LOG(FATAL) << "QUIESCED is a terminal state";
+      break;
+  }
+#endif
+  state_ = new_state;
+
+  if (!IsActive()) {
+    not_running_cond_.Broadcast();
+  }
+}
+
+const char* ThreadPoolToken::StateToString(State s) {
+  switch (s) {
+    case State::IDLE: return "IDLE";
+    case State::RUNNING: return "RUNNING";
+    case State::QUIESCING: return "QUIESCING";
+    case State::QUIESCED: return "QUIESCED";
+  }
+  return "<cannot reach here>";
+}
+
 ////////////////////////////////////////////////////////
 // ThreadPool
 ////////////////////////////////////////////////////////
@@ -114,7 +269,8 @@ ThreadPool::ThreadPool(const ThreadPoolBuilder& builder)
     not_empty_(&lock_),
     num_threads_(0),
     active_threads_(0),
-    queue_size_(0) {
+    queue_size_(0),
+    tokenless_(NewToken(ExecutionMode::CONCURRENT)) {
 
   string prefix = !builder.trace_metric_prefix_.empty() ?
       builder.trace_metric_prefix_ : builder.name_;
@@ -128,6 +284,10 @@ ThreadPool::ThreadPool(const ThreadPoolBuilder& builder)
 }
 
 ThreadPool::~ThreadPool() {
+  // There should only be one live token: the one used in tokenless submission.
+  CHECK_EQ(1, tokens_.size()) << Substitute(
+      "Threadpool $0 destroyed with $1 allocated tokens",
+      name_, tokens_.size());
   Shutdown();
 }
 
@@ -147,22 +307,38 @@ Status ThreadPool::Init() {
   return Status::OK();
 }
 
-void ThreadPool::ClearQueue() {
-  for (QueueEntry& e : queue_) {
-    if (e.trace) {
-      e.trace->Release();
-    }
-  }
-  queue_.clear();
-  queue_size_ = 0;
-}
-
 void ThreadPool::Shutdown() {
   MutexLock unique_lock(lock_);
   CheckNotPoolThreadUnlocked();
 
   pool_status_ = Status::ServiceUnavailable("The pool has been shut down.");
-  ClearQueue();
+
+  // Clear the tokens' queues under the lock, but release the tasks outside of
+  // it: their destructors may acquire other locks, or even call back into
+  // the pool.
+  std::vector<std::deque<QueueEntry>> to_release;
+  for (ThreadPoolToken* t : tokens_) {
+    if (!t->entries_.empty()) {
+      to_release.emplace_back(std::move(t->entries_));
+      t->entries_.clear();
+    }
+    switch (t->state_) {
+      case ThreadPoolToken::State::IDLE:
+        t->Transition(ThreadPoolToken::State::QUIESCED);
+        break;
+      case ThreadPoolToken::State::RUNNING:
+        // With its queue emptied, the token is done once its running tasks
+        // (if any) finish.
+        t->Transition(t->active_threads_ > 0 ?
+                      ThreadPoolToken::State::QUIESCING :
+                      ThreadPoolToken::State::QUIESCED);
+        break;
+      default:
+        break;
+    }
+  }
+  queue_.clear();
+  queue_size_ = 0;
   not_empty_.Broadcast();
 
   // The Runnable doesn't have Abort() so we must wait
@@ -170,6 +346,35 @@ void ThreadPool::Shutdown() {
   while (num_threads_ > 0) {
     no_threads_cond_.Wait();
   }
+
+  // All the threads have exited, so no token may still be running a task.
+  for (ThreadPoolToken* t : tokens_) {
+    DCHECK(!t->IsActive()) << ThreadPoolToken::StateToString(t->state_);
+  }
+
+  unique_lock.Unlock();
+  for (auto& entries : to_release) {
+    ReleaseEntries(&entries);
+  }
+}
+
+unique_ptr<ThreadPoolToken> ThreadPool::NewToken(ExecutionMode mode) {
+  return NewTokenWithMetrics(mode, {});
+}
+
+unique_ptr<ThreadPoolToken> ThreadPool::NewTokenWithMetrics(ExecutionMode mode,
+                                                            ThreadPoolMetrics metrics) {
+  MutexLock guard(lock_);
+  unique_ptr<ThreadPoolToken> t(new ThreadPoolToken(this, mode, std::move(metrics)));
+  InsertOrDie(&tokens_, t.get());
+  return t;
+}
+
+void ThreadPool::ReleaseToken(ThreadPoolToken* t) {
+  MutexLock guard(lock_);
+  CHECK(!t->IsActive()) << Substitute("Token with state $0 may not be released",
+                                      ThreadPoolToken::StateToString(t->state_));
+  CHECK_EQ(1, tokens_.erase(t));
 }
 
 Status ThreadPool::SubmitClosure(const Closure& task) {
@@ -183,6 +388,11 @@ Status ThreadPool::SubmitFunc(const boost::function<void()>& func) {
 }
 
 Status ThreadPool::Submit(const std::shared_ptr<Runnable>& task) {
+  return DoSubmit(task, tokenless_.get());
+}
+
+Status ThreadPool::DoSubmit(const std::shared_ptr<Runnable>& task, ThreadPoolToken* token) {
+  DCHECK(token);
   MonoTime submit_time = MonoTime::Now();
 
   MutexLock guard(lock_);
@@ -190,14 +400,24 @@ Status ThreadPool::Submit(const std::shared_ptr<Runnable>& task) {
     return pool_status_;
   }
 
+  if (PREDICT_FALSE(!token->MaySubmitNewTasks())) {
+    return Status::ServiceUnavailable("Thread pool token was shut down");
+  }
+
   // Size limit check.
   if (queue_size_ == max_queue_size_) {
     return Status::ServiceUnavailable(Substitute("Thread pool queue is full ($0 items)",
                                                  queue_size_));
   }
 
+  // A SERIAL token which is already queued or running will have the task
+  // picked up by the thread that runs its current one, so the token is only
+  // queued (and a thread possibly needed) if it's idle or CONCURRENT.
+  bool queue_token = token->state_ == ThreadPoolToken::State::IDLE ||
+                     token->mode_ == ExecutionMode::CONCURRENT;
+
   // Should we create another thread?
-  // We assume that each current inactive thread will grab one item from the
+  // We assume that each current inactive thread will grab one token from the
   // queue.  If it seems like we'll need another thread, we create one.
   // In theory, a currently active thread could finish immediately after this
   // calculation.  This would mean we created a thread we didn't really need.
@@ -206,8 +426,8 @@ Status ThreadPool::Submit(const std::shared_ptr<Runnable>& task) {
   //
   // Of course, we never create more than max_threads_ threads no matter what.
   int inactive_threads = num_threads_ - active_threads_;
-  int additional_threads = (queue_size_ + 1) - inactive_threads;
-  if (additional_threads > 0 && num_threads_ < max_threads_) {
+  int additional_threads = (static_cast<int>(queue_.size()) + 1) - inactive_threads;
+  if (queue_token && additional_threads > 0 && num_threads_ < max_threads_) {
     Status status = CreateThreadUnlocked();
     if (!status.ok()) {
       if (num_threads_ == 0) {
@@ -232,15 +452,27 @@ Status ThreadPool::Submit(const std::shared_ptr<Runnable>& task) {
   }
   e.submit_time = submit_time;
 
-  queue_.push_back(e);
+  int token_length_at_submit = token->entries_.size();
+  token->entries_.push_back(std::move(e));
+  if (queue_token) {
+    queue_.push_back(token);
+    if (token->state_ == ThreadPoolToken::State::IDLE) {
+      token->Transition(ThreadPoolToken::State::RUNNING);
+    }
+  }
   int length_at_submit = queue_size_++;
 
   guard.Unlock();
-  not_empty_.Signal();
+  if (queue_token) {
+    not_empty_.Signal();
+  }
 
   if (queue_length_histogram_) {
     queue_length_histogram_->Increment(length_at_submit);
   }
+  if (token->metrics_.queue_length_histogram) {
+    token->metrics_.queue_length_histogram->Increment(token_length_at_submit);
+  }
 
   return Status::OK();
 }
@@ -312,12 +544,22 @@ void ThreadPool::DispatchThread(bool permanent) {
       continue;
     }
 
-    // Fetch a pending task
-    QueueEntry entry = queue_.front();
+    // Fetch the next token with a pending task, and its task.
+    ThreadPoolToken* token = queue_.front();
     queue_.pop_front();
+    DCHECK(token->state_ == ThreadPoolToken::State::RUNNING)
+        << ThreadPoolToken::StateToString(token->state_);
+    DCHECK(!token->entries_.empty());
+    QueueEntry entry = std::move(token->entries_.front());
+    token->entries_.pop_front();
+    token->active_threads_++;
     queue_size_--;
     ++active_threads_;
 
+    // The token can't be released while it has a running task, so its
+    // metrics remain valid until we retake the lock below.
+    const ThreadPoolMetrics& token_metrics = token->metrics_;
+
     unique_lock.Unlock();
 
     // Release the reference which was held by the queued item.
@@ -333,6 +575,9 @@ void ThreadPool::DispatchThread(bool permanent) {
     if (queue_time_us_histogram_) {
       queue_time_us_histogram_->Increment(queue_time_us);
     }
+    if (token_metrics.queue_time_us_histogram) {
+      token_metrics.queue_time_us_histogram->Increment(queue_time_us);
+    }
 
     // Execute the task
     {
@@ -347,11 +592,32 @@ void ThreadPool::DispatchThread(bool permanent) {
       if (run_time_us_histogram_) {
         run_time_us_histogram_->Increment(wall_us);
       }
+      if (token_metrics.run_time_us_histogram) {
+        token_metrics.run_time_us_histogram->Increment(wall_us);
+      }
       TRACE_COUNTER_INCREMENT(run_wall_time_trace_metric_name_, wall_us);
       TRACE_COUNTER_INCREMENT(run_cpu_time_trace_metric_name_, cpu_us);
     }
+
+    // Destroy the task before retaking the lock, since its destructor may do
+    // arbitrary work.
+    entry.runnable.reset();
     unique_lock.Lock();
 
+    // The token was either shut down while its task ran, in which case it
+    // becomes QUIESCED once its last running task is done, or it goes back
+    // to IDLE if it has nothing left to run. A SERIAL token with more tasks
+    // is requeued now that its running task is done.
+    if (--token->active_threads_ == 0) {
+      if (token->state_ == ThreadPoolToken::State::QUIESCING) {
+        DCHECK(token->entries_.empty());
+        token->Transition(ThreadPoolToken::State::QUIESCED);
+      } else if (token->entries_.empty()) {
+        token->Transition(ThreadPoolToken::State::IDLE);
+      } else if (token->mode_ == ExecutionMode::SERIAL) {
+        queue_.push_back(token);
+      }
+    }
     if (--active_threads_ == 0) {
       idle_cond_.Broadcast();
     }
@@ -19,7 +19,7 @@
 
 #include <boost/function.hpp>
 #include <gtest/gtest_prod.h>
-#include <list>
+#include <deque>
 #include <memory>
 #include <unordered_set>
 #include <string>
@@ -40,6 +40,7 @@ namespace kudu {
 class Histogram;
 class Thread;
 class ThreadPool;
+class ThreadPoolToken;
 class Trace;
 
 class Runnable {
@@ -48,6 +49,21 @@ class Runnable {
   virtual ~Runnable() {}
 };
 
+// Histograms which a ThreadPoolToken can record for the tasks submitted
+// through it. Any of them may be left unset.
+struct ThreadPoolMetrics {
+  // Measures the number of the token's tasks already waiting when a new
+  // task is submitted through the token.
+  scoped_refptr<Histogram> queue_length_histogram;
+
+  // Measures the amount of time that the token's tasks spend waiting in the
+  // queue.
+  scoped_refptr<Histogram> queue_time_us_histogram;
+
+  // Measures the amount of time that the token's tasks spend running.
+  scoped_refptr<Histogram> run_time_us_histogram;
+};
+
 // ThreadPool takes a lot of arguments. We provide sane defaults with a builder.
 //
 // name: Used for debugging output and default names of the worker threads.
@@ -141,12 +157,30 @@ class ThreadPoolBuilder {
 //            .Build(&thread_pool));
 //    thread_pool->Submit(shared_ptr<Runnable>(new Task()));
 //    thread_pool->Submit(boost::bind(&Func, 10));
+//
+// Tasks may also be submitted through a ThreadPoolToken (see NewToken()),
+// which groups them so that they can be run serially, waited on or shut down
+// independently of the rest of the pool. This allows many components (e.g.
+// the tablets of a tablet server) to share one pool of threads rather than
+// each owning its own.
 class ThreadPool {
  public:
   ~ThreadPool();
 
+  // How the tasks submitted through a ThreadPoolToken are executed.
+  enum class ExecutionMode {
+    // Tasks are run one at a time, in the order in which they were submitted.
+    SERIAL,
+
+    // Tasks may be run concurrently, as if they were submitted directly to
+    // the pool.
+    CONCURRENT,
+  };
+
   // Wait for the running tasks to complete and then shutdown the threads.
-  // All the other pending tasks in the queue will be removed.
+  // All the other pending tasks in the queue will be removed, including those
+  // submitted through tokens. Tokens may outlive the shutdown, but further
+  // submissions through them fail.
   // NOTE: That the user may implement an external abort logic for the
   //       runnables, that must be called before Shutdown(), if the system
   //       should know about the non-execution of these tasks, or the runnable
@@ -175,8 +209,19 @@ class ThreadPool {
   // Returns true if the pool reached the idle state, false otherwise.
   bool WaitFor(const MonoDelta& delta);
 
-  // Return the current number of tasks waiting in the queue.
-  // Typically used for metrics.
+  // Allocates a new token for use in token-based task submission. All tokens
+  // must be destroyed before their pool is destroyed.
+  //
+  // There is no limit on the number of tokens that may be allocated.
+  std::unique_ptr<ThreadPoolToken> NewToken(ExecutionMode mode);
+
+  // Like NewToken(), but the token also records 'metrics' for its tasks, in
+  // addition to any histograms attached to the pool itself.
+  std::unique_ptr<ThreadPoolToken> NewTokenWithMetrics(ExecutionMode mode,
+                                                       ThreadPoolMetrics metrics);
+
+  // Return the current number of tasks waiting in the queue, including those
+  // submitted through tokens. Typically used for metrics.
   int queue_length() const {
     return ANNOTATE_UNPROTECTED_READ(queue_size_);
   }
@@ -194,6 +239,7 @@ class ThreadPool {
 
  private:
   friend class ThreadPoolBuilder;
+  friend class ThreadPoolToken;
 
   // Create a new thread pool using a builder.
   explicit ThreadPool(const ThreadPoolBuilder& builder);
@@ -201,8 +247,12 @@ class ThreadPool {
   // Initialize the thread pool by starting the minimum number of threads.
   Status Init();
 
-  // Clear all entries from queue_. Requires that lock_ is held.
-  void ClearQueue();
+  // Submits a task to be run via 'token'. Plain submissions go through
+  // 'tokenless_'.
+  Status DoSubmit(const std::shared_ptr<Runnable>& task, ThreadPoolToken* token);
+
+  // Releases token 't' and invalidates it.
+  void ReleaseToken(ThreadPoolToken* t);
 
   // Dispatcher responsible for dequeueing and executing the tasks
   void DispatchThread(bool permanent);
@@ -238,8 +288,24 @@ class ThreadPool {
   ConditionVariable not_empty_;
   int num_threads_;
   int active_threads_;
+
+  // Total number of tasks waiting across all tokens' queues.
   int queue_size_;
-  std::list<QueueEntry> queue_;
+
+  // Tokens which have tasks ready to be run, in the order in which they should
+  // be serviced. A SERIAL token appears here at most once, and only while none
+  // of its tasks is running; a CONCURRENT token appears once per queued task.
+  //
+  // Protected by lock_.
+  std::deque<ThreadPoolToken*> queue_;
+
+  // All allocated tokens, including 'tokenless_'.
+  //
+  // Protected by lock_.
+  std::unordered_set<ThreadPoolToken*> tokens_;
+
+  // The token used for submissions made directly to the pool.
+  std::unique_ptr<ThreadPoolToken> tokenless_;
 
   // Pointers to all running threads. Raw pointers are safe because a Thread
   // may only go out of scope after being removed from threads_.
@@ -258,5 +324,109 @@ class ThreadPool {
   DISALLOW_COPY_AND_ASSIGN(ThreadPool);
 };
 
+// Entry point for token-based task submission and blocking for a particular
+// group of tasks. Tokens are allocated by ThreadPool::NewToken() and share
+// the threads, queue limit and lifecycle of their pool.
+//
+// Thread-safe.
+class ThreadPoolToken {
+ public:
+  // Destroys the token, shutting it down first if necessary.
+  ~ThreadPoolToken();
+
+  // Submits a function using the kudu Closure system.
+  Status SubmitClosure(const Closure& task) WARN_UNUSED_RESULT;
+
+  // Submits a function bound using boost::bind(&FuncName, args...).
+  Status SubmitFunc(const boost::function<void()>& func) WARN_UNUSED_RESULT;
+
+  // Submits a Runnable class.
+  Status Submit(const std::shared_ptr<Runnable>& task) WARN_UNUSED_RESULT;
+
+  // Marks the token as unusable for future submissions. Any queued tasks are
+  // removed without being run, and any running tasks are waited on.
+  //
+  // It is safe to shut down a token more than once.
+  void Shutdown();
+
+  // Waits until all of the token's tasks have completed.
+  void Wait();
+
+  // Waits for all of the token's tasks to complete, or until 'until' time is
+  // reached. Returns true if they completed, false otherwise.
+  bool WaitUntil(const MonoTime& until);
+
+  // Waits for all of the token's tasks to complete, or until 'delta' time
+  // elapses. Returns true if they completed, false otherwise.
+  bool WaitFor(const MonoDelta& delta);
+
+ private:
+  friend class ThreadPool;
+
+  // All possible token states. Legal state transitions:
+  //   IDLE      -> RUNNING: task is submitted via the token
+  //   IDLE      -> QUIESCED: token or pool is shut down
+  //   RUNNING   -> IDLE: worker thread finishes executing the token's last task
+  //   RUNNING   -> QUIESCING: token or pool is shut down while a task runs
+  //   RUNNING   -> QUIESCED: token or pool is shut down with no running tasks
+  //   QUIESCING -> QUIESCED: worker thread finishes executing the token's
+  //                          last running task
+  enum class State {
+    // The token has no queued or running tasks.
+    IDLE,
+
+    // A worker thread is running one of the token's tasks, or one is queued.
+    RUNNING,
+
+    // The token has been shut down and is waiting for its running tasks to
+    // finish. No new tasks may be submitted.
+    QUIESCING,
+
+    // The token has been shut down and has no queued or running tasks.
+    QUIESCED,
+  };
+
+  ThreadPoolToken(ThreadPool* pool,
+                  ThreadPool::ExecutionMode mode,
+                  ThreadPoolMetrics metrics);
+
+  // Changes the token's state to 'new_state', waking any waiters if the token
+  // is no longer active. Requires that the pool's lock_ is held.
+  void Transition(State new_state);
+
+  // Returns true if the token has queued or running tasks.
+  bool IsActive() const {
+    return state_ == State::RUNNING || state_ == State::QUIESCING;
+  }
+
+  // Returns true if new tasks may be submitted through the token.
+  bool MaySubmitNewTasks() const {
+    return state_ != State::QUIESCING && state_ != State::QUIESCED;
+  }
+
+  // Returns a string representation of 's' for logging.
+  static const char* StateToString(State s);
+
+  const ThreadPool::ExecutionMode mode_;
+  const ThreadPoolMetrics metrics_;
+
+  // The pool that owns the token. All of the fields below are protected by
+  // its lock_.
+  ThreadPool* const pool_;
+
+  State state_;
+
+  // The token's queued tasks.
+  std::deque<ThreadPool::QueueEntry> entries_;
+
+  // Signalled when the token transitions to IDLE or QUIESCED.
+  ConditionVariable not_running_cond_;
+
+  // Number of worker threads currently running the token's tasks.
+  int active_threads_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadPoolToken);
+};
+
 } // namespace kudu
 #endif
@@ -74,4 +74,20 @@ TEST_F(ThrottlerTest, TestBurst) {
   ASSERT_FALSE(t0.Take(now, 1, 1));
 }
 
+TEST_F(ThrottlerTest, TestSetByteRate) {
+  MonoTime now = MonoTime::Now();
+  Throttler t0(now, 0, 1000*1000, 1);
+  // Fill up bucket
+  now += MonoDelta::FromMilliseconds(2000);
+  // Lowering the rate drops the tokens above the new burst rate.
+  t0.SetByteRate(100*1000);
+  ASSERT_TRUE(t0.Take(now, 0, 10000));
+  ASSERT_FALSE(t0.Take(now, 0, 1));
+  // Raising it again lets more bytes through each refill period.
+  t0.SetByteRate(1000*1000);
+  now += MonoDelta::FromMilliseconds(100);
+  ASSERT_TRUE(t0.Take(now, 0, 100000));
+  ASSERT_FALSE(t0.Take(now, 0, 1));
+}
+
 } // namespace kudu
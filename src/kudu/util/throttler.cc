@@ -22,6 +22,7 @@
 namespace kudu {
 
 Throttler::Throttler(MonoTime now, uint64_t op_rate, uint64_t byte_rate, double burst_factor) :
+    burst_factor_(burst_factor),
     next_refill_(now) {
   op_refill_ = op_rate / (MonoTime::kMicrosecondsPerSecond / kRefillPeriodMicros);
   op_token_ = 0;
@@ -50,6 +51,13 @@ bool Throttler::Take(MonoTime now, uint64_t op, uint64_t byte) {
   return false;
 }
 
+void Throttler::SetByteRate(uint64_t byte_rate) {
+  std::lock_guard<simple_spinlock> lock(lock_);
+  byte_refill_ = byte_rate / (MonoTime::kMicrosecondsPerSecond / kRefillPeriodMicros);
+  byte_token_max_ = static_cast<uint64_t>(byte_refill_ * burst_factor_);
+  byte_token_ = std::min(byte_token_, byte_token_max_);
+}
+
 void Throttler::Refill(MonoTime now) {
   int64_t d = (now - next_refill_).ToMicroseconds();
   if (d < 0) {
@@ -45,9 +45,14 @@ class Throttler {
   // Return false if there are not enough tokens, and operation is throttled.
   bool Take(MonoTime now, uint64_t op, uint64_t byte);
 
+  // Change the max IO bytes per second, keeping the burst factor. Tokens
+  // already in the bucket beyond the new burst rate are dropped.
+  void SetByteRate(uint64_t byte_per_sec);
+
  private:
   void Refill(MonoTime now);
 
+  const double burst_factor_;
   MonoTime next_refill_;
   uint64_t op_refill_;
   uint64_t op_token_;
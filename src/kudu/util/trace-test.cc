@@ -18,6 +18,7 @@
 #include <gtest/gtest.h>
 #include <glog/stl_logging.h>
 #include <string>
+#include <thread>
 #include <rapidjson/document.h>
 #include <rapidjson/rapidjson.h>
 
@@ -25,6 +26,7 @@
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/debug/trace_event_synthetic_delay.h"
 #include "kudu/util/debug/trace_logging.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_util.h"
 
@@ -105,6 +107,45 @@ TEST_F(TraceTest, TestChildTrace) {
             "XXXX XX:XX:XX.XXXXXX trace-test.cc:XXX] hello from traceB\n");
 }
 
+// Test that binary events are formatted into the dump in timestamp order,
+// whichever thread recorded them, and that overwritten ones are accounted for.
+TEST_F(TraceTest, TestBinaryEvents) {
+  scoped_refptr<Trace> t(new Trace);
+  {
+    ADOPT_TRACE(t.get());
+    TRACE("hello");
+    SleepFor(MonoDelta::FromMilliseconds(1));
+    TRACE_BINARY("scanned $0 rows in $1 blocks", 10, 2);
+    SleepFor(MonoDelta::FromMilliseconds(1));
+    std::thread thr([&]() {
+        ADOPT_TRACE(t.get());
+        TRACE_BINARY("from another thread");
+      });
+    thr.join();
+    SleepFor(MonoDelta::FromMilliseconds(1));
+    TRACE("goodbye");
+  }
+  TRACE_BINARY("this goes nowhere");
+  EXPECT_EQ(XOutDigits(t->DumpToString(Trace::NO_FLAGS)),
+            "XXXX XX:XX:XX.XXXXXX trace-test.cc:XXX] hello\n"
+            "XXXX XX:XX:XX.XXXXXX trace-test.cc:XXX] scanned XX rows in X blocks\n"
+            "XXXX XX:XX:XX.XXXXXX trace-test.cc:XXX] from another thread\n"
+            "XXXX XX:XX:XX.XXXXXX trace-test.cc:XXX] goodbye\n");
+
+  // The ring of a thread keeps only its latest events.
+  scoped_refptr<Trace> busy(new Trace);
+  {
+    ADOPT_TRACE(busy.get());
+    for (int i = 0; i < 1000; i++) {
+      TRACE_BINARY("event $0", i);
+    }
+  }
+  string dump = busy->DumpToString(Trace::NO_FLAGS);
+  ASSERT_STR_CONTAINS(dump, "(488 earlier binary trace events were overwritten)");
+  ASSERT_STR_CONTAINS(dump, "event 999");
+  ASSERT_EQ(string::npos, dump.find("event 487\n"));
+}
+
 static void GenerateTraceEvents(int thread_id,
                                 int num_events) {
   for (int i = 0; i < num_events; i++) {
@@ -17,6 +17,7 @@
 
 #include "kudu/util/trace.h"
 
+#include <algorithm>
 #include <iomanip>
 #include <ios>
 #include <iostream>
@@ -27,10 +28,12 @@
 #include <utility>
 #include <vector>
 
+#include "kudu/gutil/dynamic_annotations.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/walltime.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/jsonwriter.h"
+#include "kudu/util/threadlocal.h"
 
 namespace kudu {
 
@@ -38,10 +41,146 @@ using strings::internal::SubstituteArg;
 
 __thread Trace* Trace::threadlocal_trace_;
 
+namespace {
+
+// The source of Trace::binary_events_id_.
+Atomic64 next_binary_events_id = 0;
+
+// An event recorded by Trace::RecordBinaryEvent().
+struct BinaryTraceEvent {
+  MicrosecondsInt64 timestamp_micros;
+  int64_t trace_id;
+  const char* file_path;
+  const char* format;
+  int line_number;
+  int64_t args[3];
+};
+
+// A ring buffer of the latest binary events recorded by a thread.
+//
+// Only the owning thread appends to the ring, without locking; any thread
+// may collect the events of a trace meanwhile. Events overwritten while
+// being collected are detected and dropped, as with a seqlock.
+class BinaryEventRing {
+ public:
+  static const int kCapacity = 512;
+
+  BinaryEventRing() : next_(0) {}
+
+  void Append(const BinaryTraceEvent& event) {
+    // Stores aren't reordered with each other on x86, so the event can't be
+    // written before the previous position is published; the acquire load
+    // keeps the compiler from doing so.
+    const int64_t pos = base::subtle::Acquire_Load(&next_);
+    events_[pos % kCapacity] = event;
+    base::subtle::Release_Store(&next_, pos + 1);
+  }
+
+  // Appends the events of 'trace_id' still in the ring to 'events'.
+  void Collect(int64_t trace_id, vector<BinaryTraceEvent>* events) const {
+    const int64_t end = base::subtle::Acquire_Load(&next_);
+    vector<pair<int64_t, BinaryTraceEvent>> found;
+    ANNOTATE_IGNORE_READS_BEGIN();
+    for (int64_t i = std::max<int64_t>(0, end - kCapacity); i < end; i++) {
+      const BinaryTraceEvent& e = events_[i % kCapacity];
+      if (e.trace_id == trace_id) {
+        found.emplace_back(i, e);
+      }
+    }
+    ANNOTATE_IGNORE_READS_END();
+
+    // Drop the events whose slots may have been rewritten while being copied.
+    base::subtle::MemoryBarrier();
+    const int64_t now = base::subtle::NoBarrier_Load(&next_);
+    for (const auto& f : found) {
+      if (f.first > now - kCapacity) {
+        events->push_back(f.second);
+      }
+    }
+  }
+
+ private:
+  BinaryTraceEvent events_[kCapacity];
+
+  // The position of the next event to be appended.
+  Atomic64 next_;
+
+  DISALLOW_COPY_AND_ASSIGN(BinaryEventRing);
+};
+
+// All the binary event rings of the process. Rings are never freed: a
+// thread's ring is reused by the next thread to record events after it exits,
+// so that the events of exited threads stay around for a while.
+class BinaryEventRings {
+ public:
+  static BinaryEventRings* Get() {
+    // Never destroyed, so that threads exiting during shutdown can still
+    // hand their rings back.
+    static BinaryEventRings* rings = new BinaryEventRings();
+    return rings;
+  }
+
+  BinaryEventRing* Acquire() {
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (!free_.empty()) {
+      BinaryEventRing* ring = free_.back();
+      free_.pop_back();
+      return ring;
+    }
+    all_.push_back(new BinaryEventRing());
+    return all_.back();
+  }
+
+  void Release(BinaryEventRing* ring) {
+    std::lock_guard<simple_spinlock> l(lock_);
+    free_.push_back(ring);
+  }
+
+  // Returns the events of 'trace_id' still in any of the rings, oldest first.
+  void Collect(int64_t trace_id, vector<BinaryTraceEvent>* events) {
+    vector<BinaryEventRing*> rings;
+    {
+      std::lock_guard<simple_spinlock> l(lock_);
+      rings = all_;
+    }
+    for (const BinaryEventRing* ring : rings) {
+      ring->Collect(trace_id, events);
+    }
+    std::stable_sort(events->begin(), events->end(),
+                     [](const BinaryTraceEvent& a, const BinaryTraceEvent& b) {
+                       return a.timestamp_micros < b.timestamp_micros;
+                     });
+  }
+
+ private:
+  simple_spinlock lock_;
+  vector<BinaryEventRing*> all_;
+  vector<BinaryEventRing*> free_;
+};
+
+// Holds the ring of a thread for as long as it lives.
+class ThreadBinaryEventRing {
+ public:
+  ThreadBinaryEventRing() : ring_(BinaryEventRings::Get()->Acquire()) {}
+  ~ThreadBinaryEventRing() { BinaryEventRings::Get()->Release(ring_); }
+
+  BinaryEventRing* ring() const { return ring_; }
+
+ private:
+  BinaryEventRing* const ring_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadBinaryEventRing);
+};
+
+} // anonymous namespace
+
 Trace::Trace()
   : arena_(new ThreadSafeArena(1024, 128*1024)),
     entries_head_(nullptr),
-    entries_tail_(nullptr) {
+    entries_tail_(nullptr),
+    sampled_trace_id_(0),
+    binary_events_id_(base::subtle::NoBarrier_AtomicIncrement(&next_binary_events_id, 1)),
+    num_binary_events_(0) {
 }
 
 Trace::~Trace() {
@@ -95,6 +234,23 @@ void Trace::SubstituteAndTrace(const char* file_path,
   AddEntry(entry);
 }
 
+void Trace::RecordBinaryEvent(const char* file_path, int line_number,
+                              const char* format,
+                              int64_t arg0, int64_t arg1, int64_t arg2) {
+  BLOCK_STATIC_THREAD_LOCAL(ThreadBinaryEventRing, thread_ring);
+  BinaryTraceEvent event;
+  event.timestamp_micros = GetCurrentTimeMicros();
+  event.trace_id = binary_events_id_;
+  event.file_path = file_path;
+  event.format = format;
+  event.line_number = line_number;
+  event.args[0] = arg0;
+  event.args[1] = arg1;
+  event.args[2] = arg2;
+  thread_ring->ring()->Append(event);
+  base::subtle::NoBarrier_AtomicIncrement(&num_binary_events_, 1);
+}
+
 TraceEntry* Trace::NewEntry(int msg_len, const char* file_path, int line_number) {
   int size = sizeof(TraceEntry) + msg_len;
   uint8_t* dst = reinterpret_cast<uint8_t*>(arena_->AllocateBytes(size));
@@ -136,23 +292,46 @@ void Trace::Dump(std::ostream* out, int flags) const {
 
     child_traces = child_traces_;
   }
+  vector<BinaryTraceEvent> binary_events;
+  BinaryEventRings::Get()->Collect(binary_events_id_, &binary_events);
+  int64_t num_overwritten =
+      base::subtle::NoBarrier_Load(&num_binary_events_) - binary_events.size();
 
   // Save original flags.
   std::ios::fmtflags save_flags(out->flags());
 
+  if (num_overwritten > 0) {
+    *out << "(" << num_overwritten << " earlier binary trace events were overwritten)"
+         << std::endl;
+  }
+
   int64_t prev_usecs = 0;
-  for (TraceEntry* e : entries) {
+  auto entry_it = entries.begin();
+  auto event_it = binary_events.begin();
+  while (entry_it != entries.end() || event_it != binary_events.end()) {
+    // Merge the two by timestamp, with messages first on ties.
+    const TraceEntry* e = nullptr;
+    const BinaryTraceEvent* b = nullptr;
+    if (event_it == binary_events.end() ||
+        (entry_it != entries.end() &&
+         (*entry_it)->timestamp_micros <= event_it->timestamp_micros)) {
+      e = *entry_it++;
+    } else {
+      b = &*event_it++;
+    }
+    const MicrosecondsInt64 timestamp_micros = e ? e->timestamp_micros : b->timestamp_micros;
+
     // Log format borrowed from glog/logging.cc
-    time_t secs_since_epoch = e->timestamp_micros / 1000000;
-    int usecs = e->timestamp_micros % 1000000;
+    time_t secs_since_epoch = timestamp_micros / 1000000;
+    int usecs = timestamp_micros % 1000000;
     struct tm tm_time;
     localtime_r(&secs_since_epoch, &tm_time);
 
     int64_t usecs_since_prev = 0;
     if (prev_usecs != 0) {
-      usecs_since_prev = e->timestamp_micros - prev_usecs;
+      usecs_since_prev = timestamp_micros - prev_usecs;
     }
-    prev_usecs = e->timestamp_micros;
+    prev_usecs = timestamp_micros;
 
     using std::setw;
     out->fill('0');
@@ -168,10 +347,15 @@ void Trace::Dump(std::ostream* out, int flags) const {
       out->fill(' ');
       *out << "(+" << setw(6) << usecs_since_prev << "us) ";
     }
-    *out << const_basename(e->file_path) << ':' << e->line_number
-         << "] ";
-    out->write(reinterpret_cast<char*>(e) + sizeof(TraceEntry),
-               e->message_len);
+    if (e) {
+      *out << const_basename(e->file_path) << ':' << e->line_number
+           << "] ";
+      out->write(reinterpret_cast<const char*>(e) + sizeof(TraceEntry),
+                 e->message_len);
+    } else {
+      *out << const_basename(b->file_path) << ':' << b->line_number
+           << "] " << strings::Substitute(b->format, b->args[0], b->args[1], b->args[2]);
+    }
     *out << std::endl;
   }
 
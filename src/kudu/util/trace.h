@@ -22,6 +22,9 @@
 #include <utility>
 #include <vector>
 
+#include <glog/logging.h>
+
+#include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/strings/stringpiece.h"
 #include "kudu/gutil/strings/substitute.h"
@@ -55,6 +58,26 @@
 #define TRACE_TO(trace, format, substitutions...) \
   (trace)->SubstituteAndTrace(__FILE__, __LINE__, (format), ##substitutions)
 
+// Issue a binary trace event, if tracing is enabled in the current thread.
+// See Trace::RecordBinaryEvent for arguments.
+//
+// Unlike TRACE(), this doesn't format anything or take any lock: the format
+// and up to three integer arguments are copied into a ring buffer of the
+// calling thread, and formatted only if the trace is dumped. This makes it
+// cheap enough for tracepoints on hot paths.
+//
+// NOTE: the 'format' MUST be a string which stays alive forever, typically a
+// string literal.
+// Example:
+//  TRACE_BINARY("Scanned $0 rows in $1 blocks", num_rows, num_blocks);
+#define TRACE_BINARY(format, args...) \
+  do { \
+    kudu::Trace* _trace = Trace::CurrentTrace(); \
+    if (_trace) { \
+      _trace->RecordBinaryEvent(__FILE__, __LINE__, (format), ##args); \
+    } \
+  } while (0);
+
 // Increment a counter associated with the current trace.
 //
 // Each trace contains a map of counters which can be used to keep
@@ -155,7 +178,18 @@ class Trace : public RefCountedThreadSafe<Trace> {
                           const strings::internal::SubstituteArg& arg9 =
                             strings::internal::SubstituteArg::NoArg);
 
-  // Dump the trace buffer to the given output stream.
+  // Records a binary event into the calling thread's ring buffer. The event
+  // is formatted with strings::Substitute when the trace is dumped, as long
+  // as the ring hasn't wrapped around it by then.
+  //
+  // N.B.: neither the file path nor the format are copied, so both should be
+  // static constants (eg __FILE__ and a string literal).
+  void RecordBinaryEvent(const char* file_path, int line_number,
+                         const char* format,
+                         int64_t arg0 = 0, int64_t arg1 = 0, int64_t arg2 = 0);
+
+  // Dump the trace buffer to the given output stream. Binary events are
+  // interleaved with the other messages in timestamp order.
   //
   enum {
     NO_FLAGS = 0,
@@ -184,6 +218,20 @@ class Trace : public RefCountedThreadSafe<Trace> {
   // Return a copy of the current set of related "child" traces.
   std::vector<std::pair<StringPiece, scoped_refptr<Trace>>> ChildTraces() const;
 
+  // Mark this trace as part of the sampled distributed trace 'trace_id',
+  // which must be non-zero. The RPC system keeps sampled traces regardless of
+  // their latency and passes their ID on to the calls made under them.
+  void SetSampled(uint64_t trace_id) {
+    DCHECK_NE(trace_id, 0);
+    base::subtle::NoBarrier_Store(&sampled_trace_id_, trace_id);
+  }
+
+  // Return the ID of the sampled distributed trace this trace is part of, or
+  // 0 if it is not sampled.
+  uint64_t sampled_trace_id() const {
+    return base::subtle::NoBarrier_Load(&sampled_trace_id_);
+  }
+
   // Return the current trace attached to this thread, if there is one.
   static Trace* CurrentTrace() {
     return threadlocal_trace_;
@@ -233,6 +281,17 @@ class Trace : public RefCountedThreadSafe<Trace> {
 
   TraceMetrics metrics_;
 
+  // See sampled_trace_id().
+  Atomic64 sampled_trace_id_;
+
+  // Identifies this trace's events in the binary event rings. Unlike the
+  // address of the trace, it's never reused.
+  const int64_t binary_events_id_;
+
+  // The number of binary events recorded, so that those overwritten in their
+  // rings before the dump can be accounted for.
+  Atomic64 num_binary_events_;
+
   DISALLOW_COPY_AND_ASSIGN(Trace);
 };
 
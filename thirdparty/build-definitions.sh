@@ -217,6 +217,12 @@ build_lz4() {
   make -j$PARALLEL install
 }
 
+build_zstd() {
+  cd $ZSTD_DIR
+  CFLAGS="$EXTRA_CFLAGS -fPIC -O3" \
+    make -C lib -j$PARALLEL PREFIX=$PREFIX install
+}
+
 build_bitshuffle() {
   cd $BITSHUFFLE_DIR
   # bitshuffle depends on lz4, therefore set the flag I$PREFIX/include
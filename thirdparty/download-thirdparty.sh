@@ -242,6 +242,10 @@ if [ ! -d $LZ4_DIR ]; then
   echo
 fi
 
+if [ ! -d $ZSTD_DIR ]; then
+  fetch_and_expand zstd-${ZSTD_VERSION}.tar.gz
+fi
+
 if [ ! -d $BITSHUFFLE_DIR ]; then
   fetch_and_expand bitshuffle-${BITSHUFFLE_VERSION}.tar.gz
 fi